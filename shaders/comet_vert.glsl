@@ -1,6 +1,6 @@
 attribute vec4 in_Position;
 attribute vec3 in_Normal;
-attribute float brightness;
+attribute float in_Intensity;
 
 uniform vec3 color;
 uniform vec3 viewDir;
@@ -10,6 +10,6 @@ varying float shade;
 
 void main(void)
 {
-    shade = abs(dot(viewDir.xyz, in_Normal.xyz) * brightness * fadeFactor);
+    shade = abs(dot(viewDir.xyz, in_Normal.xyz) * in_Intensity * fadeFactor);
     set_vp(in_Position);
 }
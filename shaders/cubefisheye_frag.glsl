@@ -0,0 +1,54 @@
+varying vec2 position;
+
+uniform sampler2D frontTex;
+uniform sampler2D rightTex;
+uniform sampler2D leftTex;
+uniform sampler2D topTex;
+uniform sampler2D bottomTex;
+uniform float halfFov;
+
+// Texture coordinates of a direction in the camera space of a face looking
+// along -z, given its x and y components and the distance along -z
+vec2 faceCoord(vec2 v, float depth)
+{
+    return v / depth * 0.5 + 0.5;
+}
+
+void main(void)
+{
+    float r = length(position);
+    if (r > 1.0)
+    {
+        gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+
+    // Equidistant projection: the angle from the center of the dome grows
+    // linearly with the distance from the center of the view
+    float theta = r * halfFov;
+    vec2 lateral = r > 0.0 ? position / r * sin(theta) : vec2(0.0);
+    vec3 dir = vec3(lateral, -cos(theta));
+    vec3 a = abs(dir);
+
+    vec3 color = vec3(0.0);
+    if (a.x >= a.y && a.x >= a.z)
+    {
+        if (dir.x > 0.0)
+            color = texture2D(rightTex, faceCoord(vec2(dir.z, dir.y), dir.x)).rgb;
+        else
+            color = texture2D(leftTex, faceCoord(vec2(-dir.z, dir.y), -dir.x)).rgb;
+    }
+    else if (a.y >= a.z)
+    {
+        if (dir.y > 0.0)
+            color = texture2D(topTex, faceCoord(vec2(dir.x, dir.z), dir.y)).rgb;
+        else
+            color = texture2D(bottomTex, faceCoord(vec2(dir.x, -dir.z), -dir.y)).rgb;
+    }
+    else if (dir.z < 0.0)
+    {
+        color = texture2D(frontTex, faceCoord(dir.xy, -dir.z)).rgb;
+    }
+
+    gl_FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,12 @@
+attribute vec2 in_Position;
+
+varying vec2 position;
+
+uniform float aspectRatio;
+
+void main(void)
+{
+    gl_Position = vec4(in_Position.xy, 0.0, 1.0);
+    // The dome fills the height of the view
+    position = vec2(in_Position.x * aspectRatio, in_Position.y);
+}
@@ -0,0 +1,13 @@
+// Time window of the plot relative to its time origin
+uniform float windowStart;
+uniform float windowEnd;
+
+varying vec4 lineColor;
+varying float time;
+
+void main(void)
+{
+    if (time < windowStart || time > windowEnd)
+        discard;
+    gl_FragColor = lineColor;
+}
@@ -0,0 +1,17 @@
+attribute vec3 in_Position;
+// Time of the vertex relative to the time origin of the plot
+attribute float in_TexCoord0;
+
+uniform vec4 color;
+uniform float fadeOffset;
+uniform float fadeRate;
+
+varying vec4 lineColor;
+varying float time;
+
+void main(void)
+{
+    time = in_TexCoord0;
+    lineColor = vec4(color.rgb, color.a * clamp(fadeOffset + fadeRate * in_TexCoord0, 0.0, 1.0));
+    set_vp(vec4(in_Position, 1.0));
+}
@@ -1,24 +1,44 @@
-attribute vec4 in_Position;
+attribute vec3 in_Position;
 attribute vec4 in_TexCoord0;
-//attribute float in_ColorIndex;
-//attribute float in_Alpha;
 
 uniform sampler2D colorTex;
+uniform mat3 m;
+uniform vec3 offset;
+uniform mat3 viewMat;
+uniform float size;
+uniform float alphaScale;
 
 varying vec4 color;
 varying vec2 texCoord;
 
+const float spriteScaleFactor = 1.0 / 1.55;
+
 void main(void)
 {
-    // we pass color index as short int
-    // reusing gl_MultiTexCoord0.z
+    // in_TexCoord0.x is the corner of the sprite quad, 0 to 3
+    // counterclockwise from the bottom left corner
+    float corner = in_TexCoord0.x;
+    texCoord = vec2(step(0.5, corner) * step(corner, 2.5), step(1.5, corner));
+
+    // the sprite size is divided by spriteScaleFactor for each level
+    float spriteSize = size * pow(spriteScaleFactor, in_TexCoord0.y);
+    vec3 p = m * in_Position + offset;
+    float screenFrac = spriteSize / length(p);
+    if (screenFrac >= 0.1)
+    {
+        // move the sprite out of the view volume
+        color = vec4(0.0);
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        return;
+    }
+
+    // we pass color index and brightness as unsigned bytes
     // we use 255 only because we have 256 color indices
     float t = in_TexCoord0.z / 255.0; // [0, 255] -> [0, 1]
-    // we pass alpha values as as short int
-    // reusing gl_MultiTexCoord0.w
-    // we use 65535 for better precision
-    float a = in_TexCoord0.w / 65535.0; // [0, 65535] -> [0, 1]
+    float br = in_TexCoord0.w / 255.0;
+    float a = min(1.0, alphaScale * (0.1 - screenFrac) * br);
     color = vec4(texture2D(colorTex, vec2(t, 0.0)).rgb, a);
-    texCoord = in_TexCoord0.st;
-    set_vp(in_Position);
+
+    vec3 v = viewMat * vec3(texCoord * 2.0 - 1.0, 0.0) * spriteSize;
+    set_vp(vec4(p + v, 1.0));
 }
@@ -2,11 +2,15 @@ attribute vec3 in_Position;
 attribute vec4 in_Color;
 attribute float starSize;
 attribute float eta;
+attribute float starIndex;
+// per-cluster values: the first three rows of the model transform, whose
+// translation is the offset of the cluster from the observer, and the
+// brightness, pixel weight and number of stars
+attribute vec4 in_InstanceRow0;
+attribute vec4 in_InstanceRow1;
+attribute vec4 in_InstanceRow2;
+attribute vec3 in_InstanceParams;
 
-uniform mat3 m;
-uniform vec3 offset;
-uniform float brightness;
-uniform float pixelWeight;
 uniform float RRatio;
 uniform float scale;
 
@@ -40,17 +44,36 @@ float relStarDensity(void)
 
 void main(void)
 {
-    vec3 p = m * in_Position.xyz;
+    if (starIndex >= in_InstanceParams.z)
+    {
+        // the cluster has fewer stars than the others drawn with it
+        color = vec4(0.0);
+        gl_PointSize = 1.0;
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        return;
+    }
+
+    vec4 position = vec4(in_Position, 1.0);
+    vec3 p = vec3(dot(in_InstanceRow0, position),
+                  dot(in_InstanceRow1, position),
+                  dot(in_InstanceRow2, position));
+    vec3 offset = vec3(in_InstanceRow0.w, in_InstanceRow1.w, in_InstanceRow2.w);
+    float brightness = in_InstanceParams.x;
+    float pixelWeight = in_InstanceParams.y;
     float br = 2.0 * brightness;
 
-    vec4 mod = ModelViewMatrix * vec4(in_Position, 1.0);
+    // sprite sizes are computed at twice the offset of the cluster
+    vec4 mod = ModelViewMatrix * vec4(in_Position + 2.0 * offset, 1.0);
     float s = 2000.0 / -mod.z * br * starSize * scale;
 
-    float obsDistanceToStarRatio = length(p + offset) / clipDistance;
+    float obsDistanceToStarRatio = length(p) / clipDistance;
     // "Morph" the star-sprite sizes at close observer distance such that
     // the overdense globular core is dissolved upon closing in.
     gl_PointSize = s * min(obsDistanceToStarRatio, 1.0);
 
     color = vec4(in_Color.rgb, min(1.0, br * (1.0 - pixelWeight * relStarDensity())));
     set_vp(vec4(p, 1.0));
+    // clusters drawn together have different near and far planes, so
+    // don't clip the stars against them
+    gl_Position.z = 0.0;
 }
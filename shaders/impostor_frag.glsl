@@ -0,0 +1,8 @@
+varying vec2 texCoord;
+
+uniform sampler2D impostorTex;
+
+void main(void)
+{
+    gl_FragColor = texture2D(impostorTex, texCoord);
+}
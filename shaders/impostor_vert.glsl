@@ -0,0 +1,13 @@
+attribute vec3 in_Position;
+attribute vec2 in_TexCoord0;
+
+varying vec2 texCoord;
+
+void main(void)
+{
+    texCoord = in_TexCoord0.st;
+    set_vp(vec4(in_Position, 1.0));
+    // billboards are far beyond the planes of the projection used for
+    // deep sky objects, so don't clip them against these
+    gl_Position.z = 0.0;
+}
@@ -0,0 +1,6 @@
+varying vec4 color;
+
+void main(void)
+{
+    gl_FragColor = color;
+}
@@ -0,0 +1,16 @@
+// Vertex of the outline of the marker symbol
+attribute vec2 in_Position;
+// Position of the marker center in pixels and depth
+attribute vec3 in_TexCoord0;
+// Scale of the symbol in pixels
+attribute float in_TexCoord1;
+attribute vec4 in_Color;
+
+varying vec4 color;
+
+void main(void)
+{
+    color = in_Color;
+    vec2 p = in_TexCoord0.xy + in_Position * in_TexCoord1;
+    gl_Position = MVPMatrix * vec4(p, in_TexCoord0.z, 1.0);
+}
@@ -0,0 +1,16 @@
+// Cosine and sine of the eccentric anomaly
+attribute vec2 in_Position;
+// Center and semiaxes of the orbit ellipse relative to the observer
+attribute vec3 in_TexCoord0;
+attribute vec3 in_TexCoord1;
+attribute vec3 in_TexCoord2;
+attribute vec4 in_Color;
+
+varying vec4 color;
+
+void main(void)
+{
+    color = in_Color;
+    vec3 position = in_TexCoord0 + in_Position.x * in_TexCoord1 + in_Position.y * in_TexCoord2;
+    set_vp(vec4(position, 1.0));
+}
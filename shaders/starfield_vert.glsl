@@ -0,0 +1,73 @@
+attribute vec3 in_Position;
+// Space velocity in light years per year
+attribute vec3 in_Normal;
+attribute vec2 in_TexCoord0;
+attribute vec4 in_Color;
+
+uniform vec3 obsPos;
+uniform float motionYears;
+uniform float limitingMag;
+uniform float faintestMag;
+uniform float brightnessScale;
+uniform float brightnessBias;
+uniform float satPoint;
+uniform float discSize;
+uniform float minDistance;
+uniform float maxDistance;
+// 1.0 for scaled disc stars
+uniform float scaledDiscs;
+// 1.0 when drawing the glare around bright stars instead of the stars
+uniform float glarePass;
+
+varying vec4 color;
+
+const float LY_PER_PARSEC = 3.26167;
+const float MaxScaledDiscStarSize = 8.0;
+const float GlareOpacity = 0.65;
+
+// Same as Renderer::calculatePointSize()
+void main(void)
+{
+    vec3 relPos = in_Position + in_Normal * motionYears - obsPos;
+    float distance = length(relPos);
+    float appMag = in_TexCoord0.x - 5.0 + 5.0 * log2(distance / LY_PER_PARSEC) / log2(10.0)
+                 + in_TexCoord0.y * distance;
+
+    float alpha = max(0.0, (faintestMag - appMag) * brightnessScale + brightnessBias);
+    float size = discSize;
+    float glareSize = 0.0;
+    float glareAlpha = 0.0;
+    if (alpha > 1.0)
+    {
+        if (scaledDiscs > 0.5)
+        {
+            float discScale = min(MaxScaledDiscStarSize, pow(2.0, 0.3 * (satPoint - appMag)));
+            size *= max(1.0, discScale);
+            glareAlpha = min(0.5, discScale / 4.0);
+            glareSize = size * 3.0;
+        }
+        else
+        {
+            float discScale = min(100.0, satPoint - appMag + 2.0);
+            glareAlpha = min(GlareOpacity, (discScale - 2.0) / 4.0);
+            glareSize = 2.0 * discScale * discSize;
+        }
+        alpha = 1.0;
+    }
+
+    // Stars that are too faint, too close or drawn by the CPU are moved
+    // outside of the clip volume.
+    bool visible = appMag < limitingMag && distance >= minDistance && distance <= maxDistance && in_Color.a > 0.0;
+    if (glarePass > 0.5)
+    {
+        size = glareSize;
+        alpha = glareAlpha;
+        visible = visible && glareSize > 0.0;
+    }
+
+    gl_PointSize = visible ? size : 0.0;
+    color = vec4(in_Color.rgb, alpha);
+    set_vp(vec4(relPos, 1.0));
+    if (!visible)
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+}
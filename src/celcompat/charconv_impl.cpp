@@ -12,13 +12,16 @@
 #include <algorithm>
 #include <cctype>
 #include <cerrno>
+#include <cfloat>
 #include <clocale>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 
 #include <config.h>
 
 #include "charconv_impl.h"
+#include "charconv_pow5.h"
 
 namespace celestia::compat
 {
@@ -182,6 +185,342 @@ parse_value(const char* start, char** end, long double& value)
     value = std::strtold(start, end);
 }
 
+// Fast path for decimal numbers, after Lemire, "Number Parsing at a
+// Gigabyte per Second" (2021). Numbers are parsed into at most 19
+// significant digits and a decimal exponent, which are converted exactly
+// with Clinger's algorithm when both fit the floating point type, or with
+// the Eisel-Lemire algorithm otherwise. The cases where these can't round
+// correctly, or where strtod would set errno, are left to the slow path.
+
+struct DecimalNumber
+{
+    std::uint64_t mantissa{ 0 };
+    std::int64_t exponent{ 0 };
+    bool negative{ false };
+    // Non-zero digits were dropped after the first 19 significant ones
+    bool truncated{ false };
+};
+
+constexpr int max_mantissa_digits = 19;
+constexpr std::int64_t max_exponent_value = 0x10000;
+
+inline bool
+is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// Returns nullptr if the text isn't a decimal number in the format, which
+// includes infinities and NaN, leaving these to the slow path
+const char*
+parse_decimal(const char* first, const char* last, chars_format fmt, DecimalNumber& number)
+{
+    const char* p = first;
+    if (p < last && *p == '-')
+    {
+        number.negative = true;
+        p++;
+    }
+
+    int digits = 0;
+    bool any_digits = false;
+    auto add_digit = [&](char c, bool fraction)
+    {
+        auto digit = static_cast<std::uint64_t>(c - '0');
+        any_digits = true;
+        if (digits == 0 && digit == 0)
+        {
+            // Leading zeros aren't significant
+            if (fraction) { number.exponent--; }
+        }
+        else if (digits < max_mantissa_digits)
+        {
+            number.mantissa = number.mantissa * 10 + digit;
+            digits++;
+            if (fraction) { number.exponent--; }
+        }
+        else
+        {
+            if (digit != 0) { number.truncated = true; }
+            if (!fraction) { number.exponent++; }
+        }
+    };
+
+    for (; p < last && is_digit(*p); p++)
+        add_digit(*p, false);
+    if (p < last && *p == '.')
+    {
+        for (p++; p < last && is_digit(*p); p++)
+            add_digit(*p, true);
+    }
+    if (!any_digits) { return nullptr; }
+
+    bool has_exponent = false;
+    if ((fmt & chars_format::scientific) == chars_format::scientific
+        && p < last && (*p == 'e' || *p == 'E'))
+    {
+        const char* q = p + 1;
+        bool negative_exponent = false;
+        if (q < last && (*q == '+' || *q == '-'))
+        {
+            negative_exponent = *q == '-';
+            q++;
+        }
+        if (q < last && is_digit(*q))
+        {
+            std::int64_t exponent = 0;
+            for (; q < last && is_digit(*q); q++)
+            {
+                if (exponent < max_exponent_value)
+                    exponent = exponent * 10 + (*q - '0');
+            }
+            number.exponent += negative_exponent ? -exponent : exponent;
+            has_exponent = true;
+            p = q;
+        }
+    }
+
+    if (fmt == chars_format::scientific && !has_exponent) { return nullptr; }
+    return p;
+}
+
+template<typename T>
+struct BinaryFormat;
+
+template<>
+struct BinaryFormat<double>
+{
+    using Bits = std::uint64_t;
+    static constexpr int mantissa_bits = 52;
+    static constexpr int minimum_exponent = -1023;
+    static constexpr int infinite_power = 0x7ff;
+    static constexpr std::int64_t smallest_power_of_ten = -342;
+    static constexpr std::int64_t largest_power_of_ten = 308;
+    static constexpr std::int64_t min_exponent_round_to_even = -4;
+    static constexpr std::int64_t max_exponent_round_to_even = 23;
+    static constexpr std::int64_t max_exponent_fast_path = 22;
+    static constexpr std::uint64_t max_mantissa_fast_path = UINT64_C(2) << mantissa_bits;
+    static constexpr double powers_of_ten[] =
+    {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+};
+
+template<>
+struct BinaryFormat<float>
+{
+    using Bits = std::uint32_t;
+    static constexpr int mantissa_bits = 23;
+    static constexpr int minimum_exponent = -127;
+    static constexpr int infinite_power = 0xff;
+    static constexpr std::int64_t smallest_power_of_ten = -65;
+    static constexpr std::int64_t largest_power_of_ten = 38;
+    static constexpr std::int64_t min_exponent_round_to_even = -17;
+    static constexpr std::int64_t max_exponent_round_to_even = 10;
+    static constexpr std::int64_t max_exponent_fast_path = 10;
+    static constexpr std::uint64_t max_mantissa_fast_path = UINT64_C(2) << mantissa_bits;
+    static constexpr float powers_of_ten[] =
+    {
+        1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f,
+    };
+};
+
+struct UInt128
+{
+    std::uint64_t high;
+    std::uint64_t low;
+};
+
+inline UInt128
+full_multiplication(std::uint64_t a, std::uint64_t b)
+{
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    return { static_cast<std::uint64_t>(product >> 64), static_cast<std::uint64_t>(product) };
+#else
+    std::uint64_t a_lo = a & UINT64_C(0xffffffff);
+    std::uint64_t a_hi = a >> 32;
+    std::uint64_t b_lo = b & UINT64_C(0xffffffff);
+    std::uint64_t b_hi = b >> 32;
+    std::uint64_t lo_lo = a_lo * b_lo;
+    std::uint64_t hi_lo = a_hi * b_lo;
+    std::uint64_t lo_hi = a_lo * b_hi;
+    std::uint64_t hi_hi = a_hi * b_hi;
+    std::uint64_t cross = (lo_lo >> 32) + (hi_lo & UINT64_C(0xffffffff)) + lo_hi;
+    return { hi_hi + (hi_lo >> 32) + (cross >> 32), (cross << 32) | (lo_lo & UINT64_C(0xffffffff)) };
+#endif
+}
+
+inline int
+leading_zeros(std::uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(x);
+#else
+    int n = 0;
+    for (std::uint64_t bit = UINT64_C(1) << 63; (x & bit) == 0; bit >>= 1)
+        n++;
+    return n;
+#endif
+}
+
+// Mantissa and biased binary exponent of the floating point number nearest
+// to w * 10^q, for w != 0. Returns false if it can't be decided.
+template<typename T>
+bool
+eisel_lemire(std::int64_t q, std::uint64_t w, std::uint64_t& mantissa, int& power2)
+{
+    using Format = BinaryFormat<T>;
+
+    if (q < Format::smallest_power_of_ten)
+    {
+        mantissa = 0;
+        power2 = 0;
+        return true;
+    }
+    if (q > Format::largest_power_of_ten)
+    {
+        mantissa = 0;
+        power2 = Format::infinite_power;
+        return true;
+    }
+
+    int lz = leading_zeros(w);
+    w <<= lz;
+
+    // Multiply by the power of five, refining the product with the low
+    // word of the power when the truncated bits might carry into the result
+    constexpr std::uint64_t precision_mask = UINT64_MAX >> (Format::mantissa_bits + 3);
+    auto index = static_cast<std::size_t>(2 * (q - detail::smallest_power_of_five));
+    UInt128 product = full_multiplication(w, detail::powers_of_five_128[index]);
+    if ((product.high & precision_mask) == precision_mask)
+    {
+        UInt128 second = full_multiplication(w, detail::powers_of_five_128[index + 1]);
+        product.low += second.high;
+        if (second.high > product.low)
+            product.high++;
+        if (product.low == UINT64_MAX && (q < -27 || q > 55))
+            return false;
+    }
+
+    int upperbit = static_cast<int>(product.high >> 63);
+    int shift = upperbit + 64 - Format::mantissa_bits - 3;
+    mantissa = product.high >> shift;
+    // floor(log2(10^q)) + 63, biased
+    power2 = static_cast<int>((((152170 + 65536) * q) >> 16) + 63)
+             + upperbit - lz - Format::minimum_exponent;
+
+    if (power2 <= 0)
+    {
+        // Subnormal
+        if (-power2 + 1 >= 64)
+        {
+            mantissa = 0;
+            power2 = 0;
+            return true;
+        }
+        mantissa >>= -power2 + 1;
+        mantissa += mantissa & 1;
+        mantissa >>= 1;
+        power2 = mantissa < (UINT64_C(1) << Format::mantissa_bits) ? 0 : 1;
+        return true;
+    }
+
+    // Round ties to even when the product is exact
+    if (product.low <= 1
+        && q >= Format::min_exponent_round_to_even
+        && q <= Format::max_exponent_round_to_even
+        && (mantissa & 3) == 1
+        && (mantissa << shift) == product.high)
+    {
+        mantissa &= ~UINT64_C(1);
+    }
+
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= (UINT64_C(2) << Format::mantissa_bits))
+    {
+        mantissa = UINT64_C(1) << Format::mantissa_bits;
+        power2++;
+    }
+    mantissa &= ~(UINT64_C(1) << Format::mantissa_bits);
+    if (power2 >= Format::infinite_power)
+    {
+        mantissa = 0;
+        power2 = Format::infinite_power;
+    }
+    return true;
+}
+
+template<typename T>
+bool
+fast_from_chars(const char* first, const char* last, T& value, chars_format fmt, from_chars_result& result)
+{
+    using Format = BinaryFormat<T>;
+
+    if (fmt == chars_format::hex) { return false; }
+
+    DecimalNumber number;
+    const char* end = parse_decimal(first, last, fmt, number);
+    if (end == nullptr) { return false; }
+
+    if (number.mantissa == 0)
+    {
+        value = number.negative ? -T(0) : T(0);
+        result = { end, std::errc{} };
+        return true;
+    }
+
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+    if (!number.truncated
+        && number.mantissa <= Format::max_mantissa_fast_path
+        && number.exponent >= -Format::max_exponent_fast_path
+        && number.exponent <= Format::max_exponent_fast_path)
+    {
+        // Both the mantissa and the power of ten are exact, so the result
+        // is rounded once
+        auto parsed = static_cast<T>(number.mantissa);
+        if (number.exponent < 0)
+            parsed /= Format::powers_of_ten[-number.exponent];
+        else
+            parsed *= Format::powers_of_ten[number.exponent];
+        value = number.negative ? -parsed : parsed;
+        result = { end, std::errc{} };
+        return true;
+    }
+#endif
+
+    std::uint64_t mantissa;
+    int power2;
+    if (!eisel_lemire<T>(number.exponent, number.mantissa, mantissa, power2))
+        return false;
+
+    if (number.truncated)
+    {
+        // The number lies between the mantissa and the next one up
+        std::uint64_t upper_mantissa;
+        int upper_power2;
+        if (!eisel_lemire<T>(number.exponent, number.mantissa + 1, upper_mantissa, upper_power2)
+            || upper_mantissa != mantissa || upper_power2 != power2)
+        {
+            return false;
+        }
+    }
+
+    // Underflows and overflows are reported by the slow path
+    if (power2 <= 0 || power2 >= Format::infinite_power)
+        return false;
+
+    auto bits = static_cast<typename Format::Bits>(mantissa)
+              | (static_cast<typename Format::Bits>(power2) << Format::mantissa_bits);
+    if (number.negative)
+        bits |= static_cast<typename Format::Bits>(1) << (sizeof(T) * 8 - 1);
+    std::memcpy(&value, &bits, sizeof(T));
+    result = { end, std::errc{} };
+    return true;
+}
+
 template<typename T>
 from_chars_result
 from_chars_impl(const char* first, const char* last, T& value, chars_format fmt)
@@ -221,12 +560,18 @@ from_chars_impl(const char* first, const char* last, T& value, chars_format fmt)
 from_chars_result
 from_chars(const char* first, const char* last, float &value, chars_format fmt)
 {
+    from_chars_result result;
+    if (fast_from_chars(first, last, value, fmt, result))
+        return result;
     return from_chars_impl(first, last, value, fmt);
 }
 
 from_chars_result
 from_chars(const char* first, const char* last, double &value, chars_format fmt)
 {
+    from_chars_result result;
+    if (fast_from_chars(first, last, value, fmt, result))
+        return result;
     return from_chars_impl(first, last, value, fmt);
 }
 
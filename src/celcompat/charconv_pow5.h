@@ -0,0 +1,24 @@
+// charconv_pow5.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Powers of five used by the fast path of from_chars().
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+
+namespace celestia::compat::detail
+{
+
+constexpr int smallest_power_of_five = -342;
+constexpr int largest_power_of_five = 308;
+
+extern const std::uint64_t powers_of_five_128[2 * (largest_power_of_five - smallest_power_of_five + 1)];
+
+} // end namespace celestia::compat::detail
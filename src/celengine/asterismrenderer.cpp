@@ -26,7 +26,7 @@ bool AsterismRenderer::sameAsterisms(const AsterismList *asterisms) const
     return m_asterisms == asterisms;
 }
 
-/*! Draw visible asterisms.
+/*! Draw active asterisms.
  */
 void AsterismRenderer::render(const Renderer &renderer, const Color &defaultColor, const Matrices &mvp)
 {
@@ -61,43 +61,102 @@ void AsterismRenderer::render(const Renderer &renderer, const Color &defaultColo
         m_vo.setVertices(3, GL_FLOAT, false, sizeof(LineEnds) * 3, offsetof(LineEnds, point1), AttributesType::Alternative1);
     }
 
+    updateRanges();
+
     prog->use();
     prog->setMVPMatrices(*mvp.projection, *mvp.modelview);
-    glVertexAttrib(CelestiaGLProgram::ColorAttributeIndex, defaultColor);
     if (lineAsTriangles)
     {
         prog->lineWidthX = renderer.getLineWidthX();
         prog->lineWidthY = renderer.getLineWidthY();
-        m_vo.draw(GL_TRIANGLES, m_totalLineCount * 6);
     }
-    else
+
+    float opacity = defaultColor.alpha();
+    for (const auto &range : m_ranges)
     {
-        m_vo.draw(GL_LINES, m_totalLineCount * 2);
+        if (range.color < 0)
+            glVertexAttrib(CelestiaGLProgram::ColorAttributeIndex, defaultColor);
+        else
+            glVertexAttrib(CelestiaGLProgram::ColorAttributeIndex, Color(m_overrideColors[range.color], opacity));
+
+        if (lineAsTriangles)
+            m_vo.draw(GL_TRIANGLES, range.count * 6, range.first * 6);
+        else
+            m_vo.draw(GL_LINES, range.count * 2, range.first * 2);
     }
 
+    m_vo.unbind();
+}
+
+/*! Rebuild the draw ranges if an asterism was activated or deactivated or
+ *  its override color changed since the last frame. The geometry of all
+ *  asterisms stays in the vertex buffer.
+ */
+void AsterismRenderer::updateRanges()
+{
     assert(m_asterisms->size() == m_lineCount.size());
 
-    ptrdiff_t offset = 0;
-    float opacity = defaultColor.alpha();
-    for (size_t size = m_asterisms->size(), i = 0; i < size; i++)
+    size_t size = m_asterisms->size();
+    if (m_activeMask.empty())
+    {
+        m_activeMask.resize((size + 31) / 32, 0);
+        m_overrideMask.resize((size + 31) / 32, 0);
+        m_overrideColors.resize(size);
+    }
+
+    bool changed = !m_rangesValid;
+    for (size_t i = 0; i < size; i++)
     {
         auto *ast = (*m_asterisms)[i];
-        if (!ast->getActive() || !ast->isColorOverridden())
+        bool active = ast->getActive();
+        bool overridden = active && ast->isColorOverridden();
+        uint32_t bit = 1u << (i % 32);
+
+        if (((m_activeMask[i / 32] & bit) != 0) != active)
         {
-            offset += m_lineCount[i];
-            continue;
+            m_activeMask[i / 32] ^= bit;
+            changed = true;
         }
+        if (((m_overrideMask[i / 32] & bit) != 0) != overridden)
+        {
+            m_overrideMask[i / 32] ^= bit;
+            changed = true;
+        }
+        if (overridden && m_overrideColors[i] != ast->getOverrideColor())
+        {
+            m_overrideColors[i] = ast->getOverrideColor();
+            changed = true;
+        }
+    }
 
-        Color color = {ast->getOverrideColor(), opacity};
-        glVertexAttrib(CelestiaGLProgram::ColorAttributeIndex, color);
-        if (lineAsTriangles)
-            m_vo.draw(GL_TRIANGLES, m_lineCount[i] * 6, offset * 6);
-        else
-            m_vo.draw(GL_LINES, m_lineCount[i] * 2, offset * 2);
-        offset += m_lineCount[i];
+    if (!changed)
+        return;
+
+    // Merge consecutive asterisms with the same color into a single draw
+    m_ranges.clear();
+    for (size_t i = 0; i < size; i++)
+    {
+        uint32_t bit = 1u << (i % 32);
+        if ((m_activeMask[i / 32] & bit) == 0 || m_lineCount[i] == 0)
+            continue;
+
+        int color = (m_overrideMask[i / 32] & bit) != 0 ? static_cast<int>(i) : -1;
+        if (!m_ranges.empty())
+        {
+            auto &last = m_ranges.back();
+            bool sameColor = last.color < 0
+                ? color < 0
+                : color >= 0 && m_overrideColors[last.color] == m_overrideColors[color];
+            if (sameColor && last.first + last.count == m_firstLine[i])
+            {
+                last.count += m_lineCount[i];
+                continue;
+            }
+        }
+        m_ranges.push_back({ m_firstLine[i], m_lineCount[i], color });
     }
 
-    m_vo.unbind();
+    m_rangesValid = true;
 }
 
 bool AsterismRenderer::prepare(std::vector<LineEnds> &data)
@@ -117,6 +176,7 @@ bool AsterismRenderer::prepare(std::vector<LineEnds> &data)
                 ast_vtx_num += s - 1;
         }
 
+        m_firstLine.push_back(vtx_num);
         m_lineCount.push_back(ast_vtx_num);
         vtx_num += ast_vtx_num;
     }
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <vector>
 #include <celengine/asterism.h>
 #include <celutil/color.h>
@@ -34,11 +35,30 @@ class AsterismRenderer
     bool sameAsterisms(const AsterismList *asterisms) const;
 
  private:
+    // A run of consecutive asterisms drawn with the same color; color is
+    // the index of the asterism with the override color or -1 for the
+    // default color.
+    struct DrawRange
+    {
+        GLsizei first;
+        GLsizei count;
+        int     color;
+    };
+
     bool prepare(std::vector<LineEnds> &data);
+    void updateRanges();
 
     celgl::VertexObject     m_vo        { GL_ARRAY_BUFFER, 0, GL_STATIC_DRAW };
     ShaderProperties        m_shadprop;
     std::vector<GLsizei>    m_lineCount;
+    std::vector<GLsizei>    m_firstLine;
+
+    // Active and color overridden asterisms the draw ranges were built for
+    std::vector<std::uint32_t> m_activeMask;
+    std::vector<std::uint32_t> m_overrideMask;
+    std::vector<Color>         m_overrideColors;
+    std::vector<DrawRange>     m_ranges;
+    bool                       m_rangesValid { false };
 
     const AsterismList     *m_asterisms { nullptr };
     GLsizei                 m_totalLineCount  { 0 };
@@ -1,3 +1,4 @@
+#include <vector>
 #include <celutil/logger.h>
 #include "parseobject.h"
 #include "astroobj.h"
@@ -5,6 +6,35 @@
 
 using celestia::util::GetLogger;
 
+namespace
+{
+// Category sets of all objects, indexed by AstroObject::m_catsIndex. Index 0
+// is never used; released slots are reused.
+std::vector<AstroObject::CategorySet*> categorySets{ nullptr };
+std::vector<std::uint32_t> freeCategorySets;
+
+std::uint32_t allocateCategorySet()
+{
+    if (!freeCategorySets.empty())
+    {
+        std::uint32_t index = freeCategorySets.back();
+        freeCategorySets.pop_back();
+        categorySets[index] = new AstroObject::CategorySet;
+        return index;
+    }
+
+    categorySets.push_back(new AstroObject::CategorySet);
+    return static_cast<std::uint32_t>(categorySets.size() - 1);
+}
+
+void releaseCategorySet(std::uint32_t index)
+{
+    delete categorySets[index];
+    categorySets[index] = nullptr;
+    freeCategorySets.push_back(index);
+}
+} // end unnamed namespace
+
 void AstroObject::setIndex(AstroCatalog::IndexNumber nr)
 {
     if (m_mainIndexNumber != AstroCatalog::InvalidIndex)
@@ -17,11 +47,22 @@ Selection AstroObject::toSelection()
     return Selection(this);
 }
 
+AstroObject::CategorySet* AstroObject::getCategories() const
+{
+    return categorySets[m_catsIndex];
+}
+
+int AstroObject::categoriesCount() const
+{
+    CategorySet* cats = getCategories();
+    return cats == nullptr ? 0 : cats->size();
+}
+
 bool AstroObject::_addToCategory(UserCategory *c)
 {
-    if (m_cats == nullptr)
-        m_cats = new CategorySet;
-    m_cats->insert(c);
+    if (m_catsIndex == 0)
+        m_catsIndex = allocateCategorySet();
+    categorySets[m_catsIndex]->insert(c);
     return true;
 }
 
@@ -49,11 +90,12 @@ bool AstroObject::_removeFromCategory(UserCategory *c)
 {
     if (!isInCategory(c))
         return false;
-    m_cats->erase(c);
-    if (m_cats->empty())
+    CategorySet* cats = categorySets[m_catsIndex];
+    cats->erase(c);
+    if (cats->empty())
     {
-        delete m_cats;
-        m_cats = nullptr;
+        releaseCategorySet(m_catsIndex);
+        m_catsIndex = 0;
     }
     return true;
 }
@@ -76,9 +118,9 @@ bool AstroObject::removeFromCategory(const std::string &s)
 bool AstroObject::clearCategories()
 {
     bool ret = true;
-    while(m_cats != nullptr)
+    while(m_catsIndex != 0)
     {
-        UserCategory *c = *(m_cats->begin());
+        UserCategory *c = *(categorySets[m_catsIndex]->begin());
         if (!removeFromCategory(c))
             ret = false;
     }
@@ -87,9 +129,10 @@ bool AstroObject::clearCategories()
 
 bool AstroObject::isInCategory(UserCategory *c) const
 {
-    if (m_cats == nullptr)
+    CategorySet* cats = getCategories();
+    if (cats == nullptr)
         return false;
-    return m_cats->count(c) > 0;
+    return cats->count(c) > 0;
 }
 
 bool AstroObject::isInCategory(const std::string &s) const
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <unordered_set>
 #include <celengine/selection.h>
@@ -17,6 +18,10 @@ class AstroCatalog
 class AstroObject
 {
     AstroCatalog::IndexNumber m_mainIndexNumber { AstroCatalog::InvalidIndex };
+    // Few objects are in any category, so category sets are kept in a side
+    // table instead of in every object; this is the index of the set of
+    // the object in that table, or 0. Copies of an object share the set.
+    std::uint32_t m_catsIndex { 0 };
 public:
     virtual ~AstroObject() = default;
 
@@ -26,8 +31,6 @@ public:
 // Category stuff
     typedef std::unordered_set<UserCategory*> CategorySet;
 
-private:
-    CategorySet *m_cats { nullptr };
 protected:
     bool _addToCategory(UserCategory*);
     bool _removeFromCategory(UserCategory*);
@@ -40,8 +43,8 @@ public:
     bool clearCategories();
     bool isInCategory(UserCategory*) const;
     bool isInCategory(const std::string&) const;
-    int categoriesCount() const { return m_cats == nullptr ? 0 : m_cats->size(); }
-    CategorySet *getCategories() const { return m_cats; };
+    int categoriesCount() const;
+    CategorySet *getCategories() const;
     bool loadCategories(Hash*, DataDisposition = DataDisposition::Add, const std::string &domain = "");
     friend UserCategory;
 };
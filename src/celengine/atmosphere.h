@@ -11,11 +11,13 @@
 #ifndef _CELENGINE_ATMOSPHERE_H_
 #define _CELENGINE_ATMOSPHERE_H_
 
+#include <memory>
 #include <celutil/reshandle.h>
 #include <celutil/color.h>
 #include <celengine/multitexture.h>
 #include <Eigen/Core>
 
+class ScatteringTable;
 
 class Atmosphere
 {
@@ -59,6 +61,10 @@ class Atmosphere
     Eigen::Vector3f absorptionCoeff;
 
     float cloudShadowDepth;
+
+    // Precomputed scattering tables; when set, they're used for the sky
+    // instead of evaluating the scattering parameters above in the shaders
+    std::shared_ptr<ScatteringTable> scatteringTable;
 };
 
 // Atmosphere density is modeled with a exp(-y/H) falloff, where
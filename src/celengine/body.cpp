@@ -10,6 +10,7 @@
 #include <cstdlib>
 #include <cassert>
 #include <algorithm>
+#include <atomic>
 #include <celcompat/numbers.h>
 #include <celmath/mathlib.h>
 #include <celutil/gettext.h>
@@ -22,6 +23,7 @@
 #include "timeline.h"
 #include "timelinephase.h"
 #include "frametree.h"
+#include "locationindex.h"
 #include "referencemark.h"
 #include "selection.h"
 
@@ -29,6 +31,18 @@ using namespace Eigen;
 using namespace std;
 using namespace celmath;
 
+namespace
+{
+std::atomic<std::uint32_t> nameGeneration{ 0 };
+
+std::string normalizeName(std::string_view name)
+{
+    std::string key;
+    UTF8Normalize(name, key);
+    return key;
+}
+} // end unnamed namespace
+
 
 Body::Body(PlanetarySystem* _system, const string& _name) :
     system(_system),
@@ -112,7 +126,7 @@ const vector<string>& Body::getNames() const
 /*! Return the primary name for the body; if i18n, return the
  *  localized name of the body.
  */
-string Body::getName(bool i18n) const
+const string& Body::getName(bool i18n) const
 {
     if (i18n && hasLocalizedName())
         return localizedName;
@@ -123,7 +137,7 @@ string Body::getName(bool i18n) const
 /*! Get the localized name for the body. If no localized name
  *  has been set, the primary name is returned.
  */
-string Body::getLocalizedName() const
+const string& Body::getLocalizedName() const
 {
     return hasLocalizedName() ? localizedName : names[0];
 }
@@ -597,7 +611,7 @@ UniversalCoord Body::getPosition(double tdb) const
     if (frame->getCenter().star())
         return frame->getCenter().star()->getPosition(tdb).offsetKm(position);
     else
-        return frame->getCenter().getPosition(tdb).offsetKm(position);
+        return frame->getCenterPosition(tdb).offsetKm(position);
 }
 
 
@@ -623,7 +637,7 @@ Vector3d Body::getVelocity(double tdb) const
 
     if (!orbitFrame->isInertial())
     {
-        Vector3d r = Selection(const_cast<Body*>(this)).getPosition(tdb).offsetFromKm(orbitFrame->getCenter().getPosition(tdb));
+        Vector3d r = Selection(const_cast<Body*>(this)).getPosition(tdb).offsetFromKm(orbitFrame->getCenterPosition(tdb));
         v += orbitFrame->getAngularVelocity(tdb).cross(r);
     }
 
@@ -960,6 +974,24 @@ void Body::addLocation(Location* loc)
         locations = new vector<Location*>();
     locations->push_back(loc);
     loc->setParentBody(this);
+    locationIndex.reset();
+    ++nameGeneration;
+}
+
+
+void Body::updateLocation(Location* location, const Location& from)
+{
+    location->setPosition(from.getPosition());
+    location->setSize(from.getSize());
+    location->setImportance(from.getImportance());
+    location->setFeatureType(from.getFeatureType());
+    location->setInfoURL(from.getInfoURL());
+    location->setLabelColor(from.getLabelColor());
+    location->setLabelColorOverridden(from.isLabelColorOverridden());
+
+    // The position is moved to the surface of the mesh again
+    locationsComputed = false;
+    locationIndex.reset();
 }
 
 
@@ -969,6 +1001,17 @@ vector<Location*>* Body::getLocations() const
 }
 
 
+const LocationIndex* Body::getLocationIndex() const
+{
+    if (!locations)
+        return nullptr;
+
+    if (!locationIndex)
+        locationIndex = std::make_unique<LocationIndex>(*locations);
+    return locationIndex.get();
+}
+
+
 Location* Body::findLocation(const string& name, bool i18n) const
 {
     if (!locations)
@@ -1025,6 +1068,9 @@ void Body::computeLocations()
             location->setPosition(v);
         }
     }
+
+    // The positions have changed
+    locationIndex.reset();
 }
 
 
@@ -1232,7 +1278,8 @@ void PlanetarySystem::addAlias(Body* body, const string& alias)
 {
     assert(body->getSystem() == this);
 
-    objectIndex.insert(make_pair(alias, body));
+    objectIndex.try_emplace(normalizeName(alias), IndexEntry{ alias, body });
+    ++nameGeneration;
 }
 
 
@@ -1244,12 +1291,13 @@ void PlanetarySystem::removeAlias(const Body* body, const string& alias)
 {
     assert(body->getSystem() == this);
 
-    ObjectIndex::iterator iter = objectIndex.find(alias);
+    ObjectIndex::iterator iter = objectIndex.find(normalizeName(alias));
     if (iter != objectIndex.end())
     {
-        if (iter->second == body)
+        if (iter->second.body == body)
             objectIndex.erase(iter);
     }
+    ++nameGeneration;
 }
 
 
@@ -1266,8 +1314,9 @@ void PlanetarySystem::addBodyToNameIndex(Body* body)
     const vector<string>& names = body->getNames();
     for (const auto& name : names)
     {
-        objectIndex.insert(make_pair(name, body));
+        objectIndex.try_emplace(normalizeName(name), IndexEntry{ name, body });
     }
+    ++nameGeneration;
 }
 
 
@@ -1316,10 +1365,10 @@ void PlanetarySystem::replaceBody(Body* oldBody, Body* newBody)
  */
 Body* PlanetarySystem::find(const string& _name, bool deepSearch, bool i18n) const
 {
-    auto firstMatch = objectIndex.find(_name);
+    auto firstMatch = objectIndex.find(normalizeName(_name));
     if (firstMatch != objectIndex.end())
     {
-        Body* matchedBody = firstMatch->second;
+        Body* matchedBody = firstMatch->second.body;
 
         if (i18n)
             return matchedBody;
@@ -1375,7 +1424,7 @@ std::vector<std::string> PlanetarySystem::getCompletion(const std::string& _name
     // Search through all names in this planetary system.
     for (const auto& index : objectIndex)
     {
-        const string& alias = index.first;
+        const string& alias = index.second.name;
 
         if (!UTF8StringCompare(alias, _name, _name_length))
             completion.push_back(alias);
@@ -1404,6 +1453,12 @@ std::vector<std::string> PlanetarySystem::getCompletion(const std::string& _name
 }
 
 
+std::uint32_t PlanetarySystem::getNameGeneration()
+{
+    return nameGeneration;
+}
+
+
 /*! Get the order of the object in the list of children. Returns -1 if the
  *  specified body is not a child object.
  */
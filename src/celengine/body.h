@@ -20,7 +20,9 @@
 #include <celutil/utf8.h>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
+#include <cstdint>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <map>
 #include <memory>
@@ -32,6 +34,7 @@ class Body;
 class FrameTree;
 class ReferenceMark;
 class Atmosphere;
+class LocationIndex;
 
 class PlanetarySystem
 {
@@ -65,12 +68,24 @@ class PlanetarySystem
     Body* find(const std::string&, bool deepSearch = false, bool i18n = false) const;
     std::vector<std::string> getCompletion(const std::string& _name, bool i18n, bool rec = true) const;
 
+    // Changes whenever a body or location name is added to or removed from
+    // any system, so that caches of lookups by name can tell they're stale
+    static std::uint32_t getNameGeneration();
+
  private:
     void addBodyToNameIndex(Body* body);
     void removeBodyFromNameIndex(const Body* body);
 
  private:
-    typedef std::map<std::string, Body*, UTF8StringOrderingPredicate> ObjectIndex;
+    struct IndexEntry
+    {
+        std::string name;
+        Body* body;
+    };
+
+    // Names are looked up by the form in which UTF8StringCompare() compares
+    // them, see UTF8Normalize()
+    typedef std::unordered_map<std::string, IndexEntry> ObjectIndex;
 
  private:
     Star* star;
@@ -80,18 +95,6 @@ class PlanetarySystem
 };
 
 
-class RingRenderData
-{
- public:
-    RingRenderData() = default;
-    virtual ~RingRenderData() = default;
-    RingRenderData(const RingRenderData&) = delete;
-    RingRenderData(RingRenderData&&) = delete;
-    RingRenderData& operator=(const RingRenderData&) = delete;
-    RingRenderData& operator=(RingRenderData&&) = delete;
-};
-
-
 class RingSystem
 {
  public:
@@ -99,7 +102,6 @@ class RingSystem
     float outerRadius;
     Color color;
     MultiResTexture texture;
-    std::shared_ptr<RingRenderData> renderData;
 
     RingSystem(float inner, float outer) :
         innerRadius(inner), outerRadius(outer),
@@ -197,8 +199,10 @@ class Body : public AstroObject
 
     PlanetarySystem* getSystem() const;
     const std::vector<std::string>& getNames() const;
-    std::string getName(bool i18n = false) const;
-    std::string getLocalizedName() const;
+    // The names are references to the body's own strings, which are
+    // valid until the names change
+    const std::string& getName(bool i18n = false) const;
+    const std::string& getLocalizedName() const;
     bool hasLocalizedName() const;
     void addAlias(const std::string& alias);
 
@@ -314,7 +318,13 @@ class Body : public AstroObject
     std::vector<std::string>* getAlternateSurfaceNames() const;
 
     std::vector<Location*>* getLocations() const;
+    // Spatial index of the locations, built when it's first needed; null
+    // if the body has no locations
+    const LocationIndex* getLocationIndex() const;
     void addLocation(Location*);
+    // Copy the properties of a location read again from a catalog to one
+    // of the locations of the body
+    void updateLocation(Location* location, const Location& from);
     Location* findLocation(const std::string&, bool i18n = false) const;
     void computeLocations();
 
@@ -412,6 +422,7 @@ class Body : public AstroObject
 
     std::vector<Location*>* locations{ nullptr };
     mutable bool locationsComputed{ false };
+    mutable std::unique_ptr<LocationIndex> locationIndex;
 
     std::list<ReferenceMark*>* referenceMarks{ nullptr };
 
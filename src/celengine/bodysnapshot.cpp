@@ -0,0 +1,64 @@
+// bodysnapshot.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Positions of the bodies of nearby solar systems computed ahead of a frame.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <celephem/orbit.h>
+#include "body.h"
+#include "frametree.h"
+#include "solarsys.h"
+#include "universe.h"
+#include "bodysnapshot.h"
+
+void BodySnapshot::compute(const Universe& universe,
+                           const UniversalCoord& position,
+                           float radius,
+                           double _time)
+{
+    clear();
+    time = _time;
+
+    stars.clear();
+    universe.getNearStars(position, radius, stars);
+    for (const Star* star : stars)
+    {
+        const SolarSystem* solarSystem = universe.getSolarSystem(star);
+        if (solarSystem != nullptr && solarSystem->getFrameTree() != nullptr)
+            addTree(*solarSystem->getFrameTree());
+    }
+}
+
+void BodySnapshot::clear()
+{
+    offsets.clear();
+}
+
+const Eigen::Vector3d* BodySnapshot::find(const TimelinePhase& phase) const
+{
+    auto it = offsets.find(&phase);
+    return it == offsets.end() ? nullptr : &it->second.offset;
+}
+
+void BodySnapshot::addTree(const FrameTree& tree)
+{
+    for (unsigned int i = 0; i < tree.childCount(); i++)
+    {
+        const auto& phase = tree.getChild(i);
+        if (!phase->includes(time))
+            continue;
+
+        // The same expression as Renderer::getBodyPosition()
+        Eigen::Vector3d offset = phase->orbitFrame()->getOrientation(time).conjugate() * phase->orbit()->positionAtTime(time);
+        offsets.try_emplace(phase.get(), Entry{ phase, offset });
+
+        const FrameTree* children = phase->body()->getFrameTree();
+        if (children != nullptr)
+            addTree(*children);
+    }
+}
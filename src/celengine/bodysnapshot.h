@@ -0,0 +1,61 @@
+// bodysnapshot.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Positions of the bodies of nearby solar systems computed ahead of a frame.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include <Eigen/Core>
+#include <celengine/timelinephase.h>
+
+class FrameTree;
+class Star;
+class Universe;
+class UniversalCoord;
+
+// BodySnapshot holds the positions of all of the bodies of the solar
+// systems near a position at one time, so that they can be computed on a
+// worker thread before the frame which draws them. The renderer looks the
+// positions up instead of evaluating the orbits, see
+// Renderer::setBodySnapshot().
+class BodySnapshot
+{
+ public:
+    // Compute the positions at time of the bodies of the solar systems
+    // of the stars within radius light years of position
+    void compute(const Universe& universe,
+                 const UniversalCoord& position,
+                 float radius,
+                 double time);
+    void clear();
+
+    double getTime() const { return time; }
+    bool empty() const { return offsets.empty(); }
+
+    // Return the position of the body of phase relative to the center of
+    // its orbit frame, rotated to the frame of the solar system, or null if
+    // it isn't in the snapshot
+    const Eigen::Vector3d* find(const TimelinePhase& phase) const;
+
+ private:
+    void addTree(const FrameTree& tree);
+
+    struct Entry
+    {
+        // Keeps the phase, and so its address, from being reused
+        TimelinePhase::SharedConstPtr phase;
+        Eigen::Vector3d offset;
+    };
+
+    double time{ 0.0 };
+    std::unordered_map<const TimelinePhase*, Entry> offsets;
+    std::vector<const Star*> stars;
+};
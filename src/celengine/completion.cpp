@@ -0,0 +1,178 @@
+// completion.cpp
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// Incremental completion of object names.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <string_view>
+#include <utility>
+#include <celutil/greek.h>
+#include <celutil/strnatcmp.h>
+#include <celutil/utf8.h>
+#include "completion.h"
+
+namespace
+{
+bool startsWith(std::string_view s, std::string_view prefix)
+{
+    return s.substr(0, prefix.size()) == prefix;
+}
+} // end unnamed namespace
+
+
+CompletionSearch::CompletionSearch(std::size_t limit,
+                                   const std::atomic<bool>* cancelled) :
+    limit(limit),
+    cancelled(cancelled)
+{
+}
+
+
+bool CompletionSearch::isCancelled() const
+{
+    return cancelled != nullptr && cancelled->load(std::memory_order_relaxed);
+}
+
+
+void CompletionSearch::reset()
+{
+    results.clear();
+    complete = false;
+}
+
+
+bool CompletionSearch::start(const std::string& query,
+                             bool _i18n,
+                             const Selection* _contexts,
+                             int nContexts,
+                             bool _withLocations)
+{
+    std::string::size_type pos = query.rfind('/');
+    bool _isPath = pos != std::string::npos;
+    std::string_view _path;
+    std::string_view _name = query;
+    if (_isPath)
+    {
+        _path = std::string_view(query).substr(0, pos);
+        _name = std::string_view(query).substr(pos + 1);
+    }
+
+    // A longer query can only match fewer names. Greek letter
+    // abbreviations are the exception: once completed they are matched
+    // as letters, so the replaced names must extend each other too.
+    // Star and deep sky object names aren't completed for empty queries.
+    bool reusable = complete
+        && _isPath == isPath
+        && _path == path
+        && _i18n == i18n
+        && _withLocations == withLocations
+        && std::equal(_contexts, _contexts + nContexts, contexts.begin(), contexts.end())
+        && !name.empty()
+        && startsWith(_name, name)
+        && startsWith(ReplaceGreekLetter(_name), ReplaceGreekLetter(name));
+
+    isPath = _isPath;
+    path = _path;
+    name = _name;
+    i18n = _i18n;
+    withLocations = _withLocations;
+    contexts.assign(_contexts, _contexts + nContexts);
+
+    nYielded = 0;
+    stopped = false;
+    if (!reusable)
+    {
+        results.clear();
+        complete = false;
+    }
+    return reusable;
+}
+
+
+bool CompletionSearch::filter(const Callback& callback)
+{
+    int nameLength = UTF8Length(name);
+    std::string folded;
+    bool foldedValid = UTF8FoldCase(ReplaceGreekLetter(name), folded);
+
+    std::string key;
+    auto last = std::remove_if(results.begin(), results.end(),
+                               [&](const Result& result)
+                               {
+                                   switch (result.match)
+                                   {
+                                   case MatchType::Exact:
+                                       return UTF8StringCompare(result.name, name, nameLength) != 0;
+                                   case MatchType::IgnoreCase:
+                                       UTF8FoldCase(result.name, key);
+                                       return !foldedValid || !startsWith(key, folded);
+                                   default:
+                                       return false;
+                                   }
+                               });
+    results.erase(last, results.end());
+
+    for (const Result& result : results)
+    {
+        if (!yield(result.name, callback) || isCancelled())
+            break;
+    }
+
+    // The filtered results are complete even if yielding them stopped
+    complete = true;
+    return !stopped && !isCancelled();
+}
+
+
+bool CompletionSearch::add(std::vector<std::string>&& names,
+                           MatchType match,
+                           const Callback& callback)
+{
+    if (isCancelled())
+        return false;
+
+    std::vector<std::pair<int, std::string>> ranked;
+    ranked.reserve(names.size());
+    for (std::string& n : names)
+        ranked.emplace_back(UTF8Length(n), std::move(n));
+    std::sort(ranked.begin(), ranked.end(),
+              [](const auto& r0, const auto& r1)
+              {
+                  return r0.first != r1.first ? r0.first < r1.first : strnatcmp(r0.second, r1.second) < 0;
+              });
+
+    // Names are still collected after the limit is reached, so that the
+    // next query can reuse them
+    results.reserve(results.size() + ranked.size());
+    for (auto& r : ranked)
+    {
+        yield(r.second, callback);
+        results.push_back({ std::move(r.second), match });
+    }
+
+    return !stopped && !isCancelled();
+}
+
+
+void CompletionSearch::finish(bool _complete)
+{
+    complete = _complete && !isCancelled();
+}
+
+
+bool CompletionSearch::yield(const std::string& result, const Callback& callback)
+{
+    if (stopped || (limit != 0 && nYielded >= limit))
+        return false;
+
+    ++nYielded;
+    if (!callback(result))
+        stopped = true;
+    return !stopped;
+}
@@ -0,0 +1,94 @@
+// completion.h
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// Incremental completion of object names.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+#include <celengine/selection.h>
+
+/*! State of a name completion search run by Universe::getCompletion().
+ *  The names found by the last search are kept, so that when the next
+ *  query only appends characters to the previous one they are filtered
+ *  rather than looked up in the catalogs again.
+ */
+class CompletionSearch
+{
+ public:
+    // Receives each name found; returning false stops the search
+    using Callback = std::function<bool(const std::string&)>;
+
+    // How a name was matched, which decides how it is checked against a
+    // longer query
+    enum class MatchType
+    {
+        Exact,      // body and location names, see PlanetarySystem::getCompletion()
+        IgnoreCase, // star and deep sky object names, see NameDatabase::getCompletion()
+        Any,        // names matching every query in the same context
+    };
+
+    CompletionSearch() = default;
+    explicit CompletionSearch(std::size_t limit,
+                              const std::atomic<bool>* cancelled = nullptr);
+
+    // Maximum number of names passed to the callback, 0 for no limit
+    std::size_t limit{ 0 };
+    // When set, the search stops as soon as it becomes true
+    const std::atomic<bool>* cancelled{ nullptr };
+
+    bool isCancelled() const;
+    // Forget the results of the previous search
+    void reset();
+
+ private:
+    friend class Universe;
+
+    struct Result
+    {
+        std::string name;
+        MatchType match;
+    };
+
+    /*! Begin a search for query. Returns true if the previous results
+     *  can be filtered instead of searching the catalogs.
+     */
+    bool start(const std::string& query,
+               bool i18n,
+               const Selection* contexts,
+               int nContexts,
+               bool withLocations);
+    bool filter(const Callback& callback);
+    /*! Add the names found in one catalog, ranked shortest first. Returns
+     *  false if the search should stop.
+     */
+    bool add(std::vector<std::string>&& names, MatchType match, const Callback& callback);
+    void finish(bool complete);
+
+    bool yield(const std::string& name, const Callback& callback);
+
+    // The query is split at its last slash into a path and the name to
+    // complete
+    std::string path;
+    std::string name;
+    bool isPath{ false };
+    bool i18n{ false };
+    bool withLocations{ false };
+    std::vector<Selection> contexts;
+
+    std::vector<Result> results;
+    // Whether results holds every name matching the query
+    bool complete{ false };
+    std::size_t nYielded{ 0 };
+    bool stopped{ false };
+};
@@ -0,0 +1,340 @@
+// crossindex.cpp
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// Cross indices from HD, SAO and Gliese numbers to Celestia catalog
+// numbers.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <iterator>
+#include <ostream>
+#include <utility>
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
+#include <celutil/gettext.h>
+#include <celutil/logger.h>
+#include "crossindex.h"
+
+using celestia::util::GetLogger;
+namespace celutil = celestia::util;
+
+/* Cross index files start with a header:
+ *
+ *   char[8]  "CELINDEX"
+ *   uint16   version
+ *
+ * Version 0x0100 is followed by records up to the end of the file, in no
+ * particular order. Packed files, version 0x0200, continue with
+ *
+ *   uint16   reserved, 0
+ *   uint32   number of records
+ *   char[56] reserved, 0
+ *
+ * and then the records in Eytzinger order of catalog number. A record is
+ * a pair of uint32, the catalog number and the Celestia catalog number.
+ * All numbers are little endian.
+ *
+ * The padding places the records so that, in a mapping aligned to a page
+ * boundary, the descendants of a record three levels down share a cache
+ * line; see CrossIndex::find().
+ */
+
+namespace
+{
+constexpr const char CROSSINDEX_FILE_HEADER[] = "CELINDEX";
+constexpr std::size_t HEADER_SIZE = sizeof(CROSSINDEX_FILE_HEADER) - 1;
+constexpr std::size_t VERSION_HEADER_SIZE = HEADER_SIZE + sizeof(std::uint16_t);
+constexpr std::size_t PACKED_HEADER_SIZE = VERSION_HEADER_SIZE + sizeof(std::uint16_t) + sizeof(std::uint32_t);
+constexpr std::size_t RECORD_SIZE = 2 * sizeof(std::uint32_t);
+constexpr std::size_t CACHE_LINE_SIZE = 64;
+// Record k - 1 is followed by records 8k - 1 to 8k + 6 in a search, so the
+// address of record 8k - 1 must be a multiple of the cache line size
+constexpr std::size_t RECORDS_OFFSET = CACHE_LINE_SIZE + RECORD_SIZE;
+
+// Searches advanced together by the batch lookup
+constexpr std::size_t BATCH_SIZE = 16;
+
+// Store sorted[i...] at the Eytzinger positions of the subtree rooted at
+// k, returning the index of the next entry to store
+std::size_t buildEytzinger(const std::vector<CrossIndexEntry>& sorted,
+                           char* records,
+                           std::size_t i,
+                           std::size_t k)
+{
+    if (k > sorted.size())
+        return i;
+
+    i = buildEytzinger(sorted, records, i, 2 * k);
+    char* record = records + (k - 1) * RECORD_SIZE;
+    // Converting to little endian is the same swap as converting from it
+    std::uint32_t catalogNumber = celutil::fromMemoryLE<std::uint32_t>(&sorted[i].catalogNumber);
+    std::uint32_t celCatalogNumber = celutil::fromMemoryLE<std::uint32_t>(&sorted[i].celCatalogNumber);
+    std::memcpy(record, &catalogNumber, sizeof(catalogNumber));
+    std::memcpy(record + sizeof(catalogNumber), &celCatalogNumber, sizeof(celCatalogNumber));
+    return buildEytzinger(sorted, records, i + 1, 2 * k + 1);
+}
+
+inline void prefetch(const char* p)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(p);
+#else
+    (void) p;
+#endif
+}
+} // end unnamed namespace
+
+
+bool CrossIndexEntry::operator<(const CrossIndexEntry& e) const
+{
+    return catalogNumber < e.catalogNumber;
+}
+
+
+CrossIndex::CrossIndex(std::vector<CrossIndexEntry> entries) :
+    nEntries(entries.size())
+{
+    // Keep the file order of duplicate catalog numbers, the first one is
+    // found
+    std::stable_sort(entries.begin(), entries.end());
+    char* data = allocate(nEntries);
+    buildEytzinger(entries, data, 0, 1);
+    records = data;
+}
+
+
+std::unique_ptr<CrossIndex> CrossIndex::read(std::istream& in)
+{
+    std::string data(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>{});
+    if (in.bad())
+    {
+        GetLogger()->error(_("Loading cross index failed\n"));
+        return nullptr;
+    }
+
+    auto xindex = read(data.data(), data.size());
+    if (xindex != nullptr && xindex->buffer.empty())
+    {
+        // Packed records point into data
+        char* copy = xindex->allocate(xindex->nEntries);
+        std::memcpy(copy, xindex->records, xindex->nEntries * RECORD_SIZE);
+        xindex->records = copy;
+    }
+    return xindex;
+}
+
+
+std::unique_ptr<CrossIndex> CrossIndex::read(const fs::path& path)
+{
+    celutil::MemoryMappedFile file;
+    if (!file.open(path, celutil::MemoryMappedFile::AccessHint::Random))
+        return nullptr;
+
+    auto xindex = read(file.data(), file.size());
+    if (xindex != nullptr && xindex->buffer.empty())
+        xindex->file = std::move(file);
+    return xindex;
+}
+
+
+// Packed records are left in data; the caller must keep them alive
+std::unique_ptr<CrossIndex> CrossIndex::read(const char* data, std::size_t size)
+{
+    if (size < VERSION_HEADER_SIZE || std::memcmp(data, CROSSINDEX_FILE_HEADER, HEADER_SIZE) != 0)
+    {
+        GetLogger()->error(_("Bad header for cross index\n"));
+        return nullptr;
+    }
+
+    auto version = celutil::fromMemoryLE<std::uint16_t>(data + HEADER_SIZE);
+    if (version == PACKED_FILE_VERSION)
+    {
+        std::uint32_t nRecords = 0;
+        if (size >= PACKED_HEADER_SIZE)
+            nRecords = celutil::fromMemoryLE<std::uint32_t>(data + VERSION_HEADER_SIZE + sizeof(std::uint16_t));
+        if (size < RECORDS_OFFSET || (size - RECORDS_OFFSET) / RECORD_SIZE < nRecords)
+        {
+            GetLogger()->error(_("Loading cross index failed\n"));
+            return nullptr;
+        }
+
+        auto xindex = std::make_unique<CrossIndex>();
+        xindex->records = data + RECORDS_OFFSET;
+        xindex->nEntries = nRecords;
+        return xindex;
+    }
+
+    if (version != FILE_VERSION)
+    {
+        GetLogger()->error(_("Bad version for cross index\n"));
+        return nullptr;
+    }
+
+    std::size_t nRecords = (size - VERSION_HEADER_SIZE) / RECORD_SIZE;
+    if (nRecords * RECORD_SIZE != size - VERSION_HEADER_SIZE)
+    {
+        GetLogger()->error(_("Loading cross index failed at record {}\n"), nRecords);
+        return nullptr;
+    }
+
+    std::vector<CrossIndexEntry> entries(nRecords);
+    const char* record = data + VERSION_HEADER_SIZE;
+    for (CrossIndexEntry& entry : entries)
+    {
+        entry.catalogNumber = celutil::fromMemoryLE<std::uint32_t>(record);
+        entry.celCatalogNumber = celutil::fromMemoryLE<std::uint32_t>(record + sizeof(std::uint32_t));
+        record += RECORD_SIZE;
+    }
+
+    return std::make_unique<CrossIndex>(std::move(entries));
+}
+
+
+bool CrossIndex::write(std::ostream& out, bool packed) const
+{
+    out.write(CROSSINDEX_FILE_HEADER, HEADER_SIZE);
+    if (!celutil::writeLE<std::uint16_t>(out, packed ? PACKED_FILE_VERSION : FILE_VERSION))
+        return false;
+
+    if (packed)
+    {
+        if (!celutil::writeLE<std::uint16_t>(out, 0)
+            || !celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(nEntries)))
+            return false;
+        const char padding[RECORDS_OFFSET - PACKED_HEADER_SIZE] = {};
+        out.write(padding, sizeof(padding));
+        out.write(records, nEntries * RECORD_SIZE);
+        return out.good();
+    }
+
+    // Unpacked files are written in catalog number order
+    std::vector<CrossIndexEntry> entries(nEntries);
+    for (std::size_t i = 0; i < nEntries; i++)
+        entries[i] = { key(i), value(i) };
+    std::stable_sort(entries.begin(), entries.end());
+    for (const CrossIndexEntry& entry : entries)
+    {
+        if (!celutil::writeLE<std::uint32_t>(out, entry.catalogNumber)
+            || !celutil::writeLE<std::uint32_t>(out, entry.celCatalogNumber))
+            return false;
+    }
+    return true;
+}
+
+
+AstroCatalog::IndexNumber CrossIndex::find(AstroCatalog::IndexNumber catalogNumber) const
+{
+    std::size_t k = 1;
+    while (k <= nEntries)
+    {
+        // Eight records fill a cache line, which holds the descendants
+        // of k three levels down
+        if (8 * k <= nEntries)
+            prefetch(records + (8 * k - 1) * RECORD_SIZE);
+        k = 2 * k + (key(k - 1) < catalogNumber ? 1 : 0);
+    }
+
+    k = lowerBound(k);
+    if (k == 0 || key(k - 1) != catalogNumber)
+        return AstroCatalog::InvalidIndex;
+    return value(k - 1);
+}
+
+
+void CrossIndex::find(const AstroCatalog::IndexNumber* catalogNumbers,
+                      std::size_t count,
+                      AstroCatalog::IndexNumber* celCatalogNumbers) const
+{
+    std::size_t k[BATCH_SIZE];
+    for (std::size_t start = 0; start < count; start += BATCH_SIZE)
+    {
+        std::size_t n = std::min(BATCH_SIZE, count - start);
+        const AstroCatalog::IndexNumber* batch = catalogNumbers + start;
+        std::fill_n(k, n, 1);
+
+        // All searches take the same number of steps, give or take one
+        for (bool searching = nEntries > 0; searching;)
+        {
+            searching = false;
+            for (std::size_t i = 0; i < n; i++)
+            {
+                if (k[i] > nEntries)
+                    continue;
+                k[i] = 2 * k[i] + (key(k[i] - 1) < batch[i] ? 1 : 0);
+                if (k[i] <= nEntries)
+                {
+                    prefetch(records + (k[i] - 1) * RECORD_SIZE);
+                    searching = true;
+                }
+            }
+        }
+
+        for (std::size_t i = 0; i < n; i++)
+        {
+            std::size_t lb = lowerBound(k[i]);
+            celCatalogNumbers[start + i] = lb != 0 && key(lb - 1) == batch[i]
+                ? value(lb - 1)
+                : AstroCatalog::InvalidIndex;
+        }
+    }
+}
+
+
+std::size_t CrossIndex::memoryUsage() const
+{
+    return buffer.empty() ? nEntries * RECORD_SIZE : buffer.capacity();
+}
+
+
+AstroCatalog::IndexNumber CrossIndex::findCatalogNumber(AstroCatalog::IndexNumber celCatalogNumber) const
+{
+    // The order of the records doesn't help here; the smallest catalog
+    // number is returned as with a sorted index
+    AstroCatalog::IndexNumber result = AstroCatalog::InvalidIndex;
+    for (std::size_t i = 0; i < nEntries; i++)
+    {
+        if (value(i) == celCatalogNumber && key(i) < result)
+            result = key(i);
+    }
+    return result;
+}
+
+
+inline AstroCatalog::IndexNumber CrossIndex::key(std::size_t index) const
+{
+    return celutil::fromMemoryLE<std::uint32_t>(records + index * RECORD_SIZE);
+}
+
+
+inline AstroCatalog::IndexNumber CrossIndex::value(std::size_t index) const
+{
+    return celutil::fromMemoryLE<std::uint32_t>(records + index * RECORD_SIZE + sizeof(std::uint32_t));
+}
+
+
+// Allocate records for n entries, aligned as in a packed file
+char* CrossIndex::allocate(std::size_t n)
+{
+    buffer.resize(n * RECORD_SIZE + CACHE_LINE_SIZE);
+    auto address = reinterpret_cast<std::uintptr_t>(buffer.data());
+    std::size_t offset = (RECORDS_OFFSET - address % CACHE_LINE_SIZE) % CACHE_LINE_SIZE;
+    return buffer.data() + offset;
+}
+
+
+// A search ends below a leaf, after a run of right turns following the
+// last left turn; that left turn was at the lower bound. Returns 0 if all
+// keys were smaller.
+std::size_t CrossIndex::lowerBound(std::size_t k)
+{
+    while ((k & 1) != 0)
+        k >>= 1;
+    return k >> 1;
+}
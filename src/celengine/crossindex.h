@@ -0,0 +1,88 @@
+// crossindex.h
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// Cross indices from HD, SAO and Gliese numbers to Celestia catalog
+// numbers.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <vector>
+#include <celcompat/filesystem.h>
+#include <celengine/astroobj.h>
+#include <celutil/mmapfile.h>
+
+struct CrossIndexEntry
+{
+    AstroCatalog::IndexNumber catalogNumber;
+    AstroCatalog::IndexNumber celCatalogNumber;
+
+    bool operator<(const CrossIndexEntry&) const;
+};
+
+/*! Entries of a cross index sorted by catalog number and stored in
+ *  Eytzinger order: the entry at position k (counting from 1) is followed
+ *  by the entries at 2k and 2k + 1 in a binary search, so the first levels
+ *  of every search share a few cache lines. Packed cross index files
+ *  store the entries in this order and are used in place from a memory
+ *  mapping; older files are sorted when they are loaded.
+ */
+class CrossIndex
+{
+ public:
+    // Version 0x0100 files hold unsorted records, version 0x0200 files are
+    // packed
+    static constexpr std::uint16_t FILE_VERSION = 0x0100;
+    static constexpr std::uint16_t PACKED_FILE_VERSION = 0x0200;
+
+    CrossIndex() = default;
+    explicit CrossIndex(std::vector<CrossIndexEntry> entries);
+
+    CrossIndex(const CrossIndex&) = delete;
+    CrossIndex& operator=(const CrossIndex&) = delete;
+
+    static std::unique_ptr<CrossIndex> read(std::istream&);
+    static std::unique_ptr<CrossIndex> read(const fs::path&);
+
+    bool write(std::ostream&, bool packed = true) const;
+
+    std::size_t size() const { return nEntries; }
+    //! Bytes of the records, whether they're allocated or mapped
+    std::size_t memoryUsage() const;
+
+    //! Return the Celestia catalog number for catalogNumber
+    AstroCatalog::IndexNumber find(AstroCatalog::IndexNumber catalogNumber) const;
+    /*! Look up count catalog numbers at once, storing the Celestia catalog
+     *  numbers in celCatalogNumbers. The searches are interleaved so that
+     *  their cache misses overlap.
+     */
+    void find(const AstroCatalog::IndexNumber* catalogNumbers,
+              std::size_t count,
+              AstroCatalog::IndexNumber* celCatalogNumbers) const;
+    //! Return the catalog number for celCatalogNumber, a linear search
+    AstroCatalog::IndexNumber findCatalogNumber(AstroCatalog::IndexNumber celCatalogNumber) const;
+
+ private:
+    static std::unique_ptr<CrossIndex> read(const char* data, std::size_t size);
+
+    AstroCatalog::IndexNumber key(std::size_t index) const;
+    AstroCatalog::IndexNumber value(std::size_t index) const;
+    // The lower bound for a search that ended at position k
+    static std::size_t lowerBound(std::size_t k);
+    char* allocate(std::size_t n);
+
+    // Little endian records, either in buffer or in file
+    const char* records{ nullptr };
+    std::size_t nEntries{ 0 };
+    std::vector<char> buffer;
+    celestia::util::MemoryMappedFile file;
+};
@@ -0,0 +1,721 @@
+// cubespheremesh.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Sphere mesh made of quadtrees of chunks over the faces of a cube.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <celcompat/numbers.h>
+#include <celutil/jobsystem.h>
+#include "cubespheremesh.h"
+#include "glstate.h"
+#include "shadermanager.h"
+
+using celmath::Frustum;
+
+namespace
+{
+
+// Quads along each side of a chunk
+constexpr int GridSize = 16;
+constexpr int GridVertexCount = (GridSize + 1) * (GridSize + 1);
+// A copy of each edge of the grid, lowered below the surface
+constexpr int SkirtVertexCount = 4 * (GridSize + 1);
+constexpr int ChunkVertexCount = GridVertexCount + SkirtVertexCount;
+// Two triangles per quad of the grid, and four per quad of the skirts,
+// whose sides both face out as the crack they hide may be on either side
+constexpr int IndexCount = GridSize * GridSize * 6 + 4 * GridSize * 12;
+// Position, tangent and texture coordinates, as in the static vertices of
+// LODSphereMesh
+constexpr int VertexSize = 3 + 3 + 2;
+
+// The quadtrees are drawn from their second level, so that the poles at
+// the centers of the faces +Y and -Y are at the corners of chunks and the
+// seam of the texture at longitude 0 runs along the edges of chunks
+constexpr int FirstLevel = 1;
+// About ten meters between the vertices of the Earth
+constexpr int MaxLevel = 16;
+
+// Largest height in pixels of the surface above the flat triangles, and
+// largest size in pixels of the cells of the grid, beyond which a chunk is
+// split
+constexpr float MaxSagittaPixels = 0.5f;
+constexpr float MaxCellPixels = 32.0f;
+
+constexpr int SlotsPerBuffer = 128;
+constexpr int MaxChunks = 2048;
+constexpr std::size_t MaxPendingBuilds = 16;
+constexpr std::size_t MaxUploadsPerFrame = 32;
+
+struct Face
+{
+    Eigen::Vector3d normal;
+    Eigen::Vector3d u;
+    Eigen::Vector3d v;
+};
+
+// u x v is the normal, so that the grids wind counterclockwise seen from
+// outside of the sphere
+const Face faces[6] =
+{
+    { {  1.0,  0.0,  0.0 }, {  0.0,  1.0,  0.0 }, {  0.0,  0.0,  1.0 } },
+    { { -1.0,  0.0,  0.0 }, {  0.0,  0.0,  1.0 }, {  0.0,  1.0,  0.0 } },
+    { {  0.0,  1.0,  0.0 }, {  0.0,  0.0,  1.0 }, {  1.0,  0.0,  0.0 } },
+    { {  0.0, -1.0,  0.0 }, {  1.0,  0.0,  0.0 }, {  0.0,  0.0,  1.0 } },
+    { {  0.0,  0.0,  1.0 }, {  1.0,  0.0,  0.0 }, {  0.0,  1.0,  0.0 } },
+    { {  0.0,  0.0, -1.0 }, {  0.0,  1.0,  0.0 }, {  1.0,  0.0,  0.0 } },
+};
+
+// Map a point of a face, with s and t from 0 to 1, to the unit sphere. The
+// mapping spreads the vertices more evenly than normalizing the point on
+// the cube.
+Eigen::Vector3d
+cubeToSphere(int face, double s, double t)
+{
+    Eigen::Vector3d p = faces[face].normal +
+                        (2.0 * s - 1.0) * faces[face].u +
+                        (2.0 * t - 1.0) * faces[face].v;
+    Eigen::Vector3d p2 = p.cwiseProduct(p);
+    return Eigen::Vector3d(p.x() * std::sqrt(1.0 - p2.y() / 2.0 - p2.z() / 2.0 + p2.y() * p2.z() / 3.0),
+                           p.y() * std::sqrt(1.0 - p2.z() / 2.0 - p2.x() / 2.0 + p2.z() * p2.x() / 3.0),
+                           p.z() * std::sqrt(1.0 - p2.x() / 2.0 - p2.y() / 2.0 + p2.x() * p2.y() / 3.0));
+}
+
+float
+angleBetween(const Eigen::Vector3d& a, const Eigen::Vector3d& b)
+{
+    return static_cast<float>(std::acos(std::clamp(a.dot(b), -1.0, 1.0)));
+}
+
+int
+gridIndex(int i, int j)
+{
+    return j * (GridSize + 1) + i;
+}
+
+// Grid coordinates of the vertex k of an edge of the grid
+void
+edgeVertex(int edge, int k, int& i, int& j)
+{
+    switch (edge)
+    {
+    case 0:
+        i = k;
+        j = 0;
+        break;
+    case 1:
+        i = GridSize;
+        j = k;
+        break;
+    case 2:
+        i = k;
+        j = GridSize;
+        break;
+    default:
+        i = 0;
+        j = k;
+        break;
+    }
+}
+
+void
+buildIndices(std::vector<std::uint16_t>& indices)
+{
+    indices.reserve(IndexCount);
+    for (int j = 0; j < GridSize; j++)
+    {
+        for (int i = 0; i < GridSize; i++)
+        {
+            auto a = static_cast<std::uint16_t>(gridIndex(i, j));
+            auto b = static_cast<std::uint16_t>(gridIndex(i + 1, j));
+            auto c = static_cast<std::uint16_t>(gridIndex(i + 1, j + 1));
+            auto d = static_cast<std::uint16_t>(gridIndex(i, j + 1));
+            indices.insert(indices.end(), { a, b, c, a, c, d });
+        }
+    }
+
+    for (int edge = 0; edge < 4; edge++)
+    {
+        for (int k = 0; k < GridSize; k++)
+        {
+            int i0, j0, i1, j1;
+            edgeVertex(edge, k, i0, j0);
+            edgeVertex(edge, k + 1, i1, j1);
+            auto p0 = static_cast<std::uint16_t>(gridIndex(i0, j0));
+            auto p1 = static_cast<std::uint16_t>(gridIndex(i1, j1));
+            auto s0 = static_cast<std::uint16_t>(GridVertexCount + edge * (GridSize + 1) + k);
+            auto s1 = static_cast<std::uint16_t>(s0 + 1);
+            indices.insert(indices.end(), { p0, s0, s1, p0, s1, p1,
+                                            p0, s1, s0, p0, p1, s1 });
+        }
+    }
+}
+
+// Compute the vertices of a chunk, with the texture coordinates and
+// tangents of LODSphereMesh. Called by the job system.
+void
+buildChunkVertices(int face, int level, int x, int y, float skirtDepth,
+                   std::vector<float>& vertices)
+{
+    struct GridVertex
+    {
+        Eigen::Vector3f position;
+        Eigen::Vector3f tangent;
+        float u;
+        float v;
+        bool pole;
+    };
+
+    constexpr double twoPi = 2.0 * celestia::numbers::pi;
+    double size = 1.0 / static_cast<double>(1 << level);
+    std::vector<GridVertex> grid(GridVertexCount);
+    float minU = 1.0f;
+    float maxU = 0.0f;
+    for (int j = 0; j <= GridSize; j++)
+    {
+        for (int i = 0; i <= GridSize; i++)
+        {
+            Eigen::Vector3d p = cubeToSphere(face,
+                                             (x + static_cast<double>(i) / GridSize) * size,
+                                             (y + static_cast<double>(j) / GridSize) * size);
+            GridVertex& vertex = grid[gridIndex(i, j)];
+            vertex.position = p.cast<float>();
+            vertex.v = static_cast<float>(0.5 - std::asin(std::clamp(p.y(), -1.0, 1.0)) / celestia::numbers::pi);
+
+            double r = std::hypot(p.x(), p.z());
+            vertex.pole = r < 1.0e-12;
+            if (vertex.pole)
+                continue;
+
+            double theta = std::atan2(p.z(), p.x());
+            if (theta < 0.0)
+                theta += twoPi;
+            vertex.u = static_cast<float>(1.0 - theta / twoPi);
+            vertex.tangent = Eigen::Vector3f(static_cast<float>(p.z() / r), 0.0f, static_cast<float>(-p.x() / r));
+            minU = std::min(minU, vertex.u);
+            maxU = std::max(maxU, vertex.u);
+        }
+    }
+
+    // A chunk along the seam at longitude 0 has coordinates near both 0
+    // and 1, which would wrap the whole texture across it; those near 0
+    // are moved past 1, relying on the textures repeating.
+    if (maxU - minU > 0.5f)
+    {
+        for (GridVertex& vertex : grid)
+        {
+            if (!vertex.pole && vertex.u < 0.5f)
+                vertex.u += 1.0f;
+        }
+    }
+
+    // The longitude of a pole is that of the neighbouring vertex inside
+    // the chunk
+    for (int j = 0; j <= GridSize; j++)
+    {
+        for (int i = 0; i <= GridSize; i++)
+        {
+            GridVertex& vertex = grid[gridIndex(i, j)];
+            if (!vertex.pole)
+                continue;
+            const GridVertex& neighbour = grid[gridIndex(i < GridSize ? i + 1 : i - 1,
+                                                         j < GridSize ? j + 1 : j - 1)];
+            vertex.u = neighbour.u;
+            vertex.tangent = neighbour.tangent;
+        }
+    }
+
+    vertices.resize(static_cast<std::size_t>(ChunkVertexCount) * VertexSize);
+    float* out = vertices.data();
+    auto addVertex = [&out](const GridVertex& vertex, float scale)
+    {
+        Eigen::Map<Eigen::Vector3f> position(out);
+        Eigen::Map<Eigen::Vector3f> tangent(out + 3);
+        position = vertex.position * scale;
+        tangent = vertex.tangent;
+        out[6] = vertex.u;
+        out[7] = vertex.v;
+        out += VertexSize;
+    };
+
+    for (const GridVertex& vertex : grid)
+        addVertex(vertex, 1.0f);
+
+    for (int edge = 0; edge < 4; edge++)
+    {
+        for (int k = 0; k <= GridSize; k++)
+        {
+            int i, j;
+            edgeVertex(edge, k, i, j);
+            addVertex(grid[gridIndex(i, j)], 1.0f - skirtDepth);
+        }
+    }
+}
+
+// TODO: figure out how to use std eigen's methods instead
+Eigen::Vector3f
+intersect3(const Frustum::PlaneType& p0,
+           const Frustum::PlaneType& p1,
+           const Frustum::PlaneType& p2)
+{
+    Eigen::Matrix3f m;
+    m.row(0) = p0.normal();
+    m.row(1) = p1.normal();
+    m.row(2) = p2.normal();
+    float d = m.determinant();
+
+    return (p0.offset() * p1.normal().cross(p2.normal()) +
+            p1.offset() * p2.normal().cross(p0.normal()) +
+            p2.offset() * p0.normal().cross(p1.normal())) * (1.0f / d);
+}
+
+} // end unnamed namespace
+
+
+struct CubeSphereMesh::ChunkBuild
+{
+    std::vector<float> vertices;
+    std::atomic<bool> done{ false };
+};
+
+
+struct CubeSphereMesh::Chunk
+{
+    int face{ 0 };
+    int level{ 0 };
+    int x{ 0 };
+    int y{ 0 };
+
+    // Unit vector to the center of the chunk, and the largest angle of its
+    // edges from it
+    Eigen::Vector3f direction{ Eigen::Vector3f::UnitX() };
+    float angularRadius{ 0.0f };
+    // Bounding sphere, skirts included
+    Eigen::Vector3f center{ Eigen::Vector3f::Zero() };
+    float radius{ 0.0f };
+    // Angle between neighbouring vertices, and the height of the surface
+    // above the diagonal of a cell
+    float cellAngle{ 0.0f };
+    float sagitta{ 0.0f };
+    float skirtDepth{ 0.0f };
+
+    // Slot of the vertices in the vertex buffers, or -1 if they aren't
+    // loaded
+    int slot{ -1 };
+    unsigned int lastUsed{ 0 };
+    std::shared_ptr<ChunkBuild> build;
+    std::array<std::unique_ptr<Chunk>, 4> children;
+};
+
+
+struct CubeSphereMesh::View
+{
+    explicit View(const Frustum& _frustum) : frustum(_frustum) {}
+
+    const Frustum& frustum;
+    Eigen::Vector3f eye{ Eigen::Vector3f::Zero() };
+    float eyeDistance{ 0.0f };
+    // Angle from the direction of the eye beyond which the sphere is
+    // hidden
+    float horizonAngle{ static_cast<float>(celestia::numbers::pi) };
+    float pixelsPerRadian{ 0.0f };
+};
+
+
+CubeSphereMesh::CubeSphereMesh() = default;
+
+
+CubeSphereMesh::~CubeSphereMesh()
+{
+    if (!vertexBuffers.empty())
+        glDeleteBuffers(static_cast<GLsizei>(vertexBuffers.size()), vertexBuffers.data());
+    if (indexBuffer != 0)
+        glDeleteBuffers(1, &indexBuffer);
+}
+
+
+bool
+CubeSphereMesh::init()
+{
+    std::vector<std::uint16_t> indices;
+    buildIndices(indices);
+    glGenBuffers(1, &indexBuffer);
+    if (indexBuffer == 0)
+        return false;
+    celestia::gl::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    celestia::gl::bufferData(GL_ELEMENT_ARRAY_BUFFER,
+                             indices.size() * sizeof(indices[0]),
+                             indices.data(),
+                             GL_STATIC_DRAW);
+
+    // The first level is built right away, so that there's always a chunk
+    // to draw
+    std::vector<float> vertices;
+    for (int face = 0; face < 6; face++)
+    {
+        for (int y = 0; y < (1 << FirstLevel); y++)
+        {
+            for (int x = 0; x < (1 << FirstLevel); x++)
+            {
+                auto chunk = createChunk(face, FirstLevel, x, y);
+                buildChunkVertices(face, FirstLevel, x, y, chunk->skirtDepth, vertices);
+                upload(*chunk, vertices);
+                roots.push_back(std::move(chunk));
+            }
+        }
+    }
+
+    initialized = true;
+    return true;
+}
+
+
+std::unique_ptr<CubeSphereMesh::Chunk>
+CubeSphereMesh::createChunk(int face, int level, int x, int y) const
+{
+    auto chunk = std::make_unique<Chunk>();
+    chunk->face = face;
+    chunk->level = level;
+    chunk->x = x;
+    chunk->y = y;
+
+    // Corners of the chunk in the order of its edges, and the middles of
+    // the edges
+    constexpr double corners[4][2] = { { 0.0, 0.0 }, { 1.0, 0.0 }, { 1.0, 1.0 }, { 0.0, 1.0 } };
+    constexpr double middles[4][2] = { { 0.5, 0.0 }, { 1.0, 0.5 }, { 0.5, 1.0 }, { 0.0, 0.5 } };
+
+    double size = 1.0 / static_cast<double>(1 << level);
+    Eigen::Vector3d direction = cubeToSphere(face, (x + 0.5) * size, (y + 0.5) * size);
+    float edgeAngle = 0.0f;
+    for (int i = 0; i < 4; i++)
+    {
+        Eigen::Vector3d corner = cubeToSphere(face, (x + corners[i][0]) * size, (y + corners[i][1]) * size);
+        Eigen::Vector3d next = cubeToSphere(face, (x + corners[(i + 1) % 4][0]) * size, (y + corners[(i + 1) % 4][1]) * size);
+        Eigen::Vector3d middle = cubeToSphere(face, (x + middles[i][0]) * size, (y + middles[i][1]) * size);
+        chunk->angularRadius = std::max({ chunk->angularRadius,
+                                          angleBetween(direction, corner),
+                                          angleBetween(direction, middle) });
+        edgeAngle = std::max(edgeAngle, angleBetween(corner, next));
+    }
+    // The edges bulge a little between the points sampled
+    chunk->angularRadius *= 1.05f;
+
+    chunk->cellAngle = edgeAngle / GridSize;
+    chunk->sagitta = 1.0f - std::cos(chunk->cellAngle * static_cast<float>(celestia::numbers::sqrt2) / 2.0f);
+    // Deeper than the cracks next to chunks a few levels coarser
+    chunk->skirtDepth = chunk->cellAngle / 2.0f;
+
+    chunk->direction = direction.cast<float>();
+    chunk->center = chunk->direction * std::cos(chunk->angularRadius);
+    chunk->radius = std::sin(chunk->angularRadius) + chunk->skirtDepth;
+
+    return chunk;
+}
+
+
+void
+CubeSphereMesh::render(const Frustum& frustum, float pixWidth, int nTextures)
+{
+    if (!initialized && !init())
+        return;
+
+    frame++;
+    finishBuilds();
+
+    // The planes of the sides of the frustum meet at the eye
+    View view(frustum);
+    view.eye = intersect3(frustum.plane(Frustum::Left),
+                          frustum.plane(Frustum::Right),
+                          frustum.plane(Frustum::Top));
+    view.eyeDistance = view.eye.norm();
+    if (view.eyeDistance > 1.0f)
+    {
+        view.horizonAngle = std::acos(1.0f / view.eyeDistance);
+        view.pixelsPerRadian = pixWidth / (2.0f * std::asin(1.0f / view.eyeDistance));
+    }
+    else
+    {
+        view.pixelsPerRadian = pixWidth;
+    }
+
+    drawList.clear();
+    for (const auto& root : roots)
+        selectChunks(*root, view);
+
+    drawChunks(nTextures);
+}
+
+
+void
+CubeSphereMesh::selectChunks(Chunk& chunk, const View& view)
+{
+    // Cull the chunks beyond the horizon, then those outside of the frustum
+    if (view.eyeDistance > 1.0f)
+    {
+        float cosAngle = chunk.direction.dot(view.eye) / view.eyeDistance;
+        float angle = std::acos(std::clamp(cosAngle, -1.0f, 1.0f));
+        if (angle - chunk.angularRadius > view.horizonAngle)
+            return;
+    }
+    if (view.frustum.testSphere(chunk.center, chunk.radius) == Frustum::Outside)
+        return;
+
+    chunk.lastUsed = frame;
+
+    float distance = std::max((view.eye - chunk.center).norm() - chunk.radius, 1.0e-6f);
+    float pixelsPerUnit = view.pixelsPerRadian / distance;
+    if (chunk.level < MaxLevel &&
+        (chunk.sagitta * pixelsPerUnit > MaxSagittaPixels ||
+         chunk.cellAngle * pixelsPerUnit > MaxCellPixels))
+    {
+        if (chunk.children[0] == nullptr)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                chunk.children[i] = createChunk(chunk.face, chunk.level + 1,
+                                                chunk.x * 2 + (i & 1),
+                                                chunk.y * 2 + (i >> 1));
+            }
+        }
+
+        bool ready = true;
+        for (const auto& child : chunk.children)
+        {
+            if (child->slot < 0)
+            {
+                ready = false;
+                requestBuild(*child);
+            }
+            child->lastUsed = frame;
+        }
+
+        if (ready)
+        {
+            for (const auto& child : chunk.children)
+                selectChunks(*child, view);
+            return;
+        }
+    }
+
+    if (chunk.slot >= 0)
+        drawList.push_back(&chunk);
+    else
+        requestBuild(chunk);
+}
+
+
+void
+CubeSphereMesh::requestBuild(Chunk& chunk)
+{
+    if (chunk.slot >= 0 || chunk.build != nullptr || building.size() >= MaxPendingBuilds)
+        return;
+
+    auto build = std::make_shared<ChunkBuild>();
+    chunk.build = build;
+    building.push_back(&chunk);
+
+    std::function<void()> job = [build,
+                                 face = chunk.face,
+                                 level = chunk.level,
+                                 x = chunk.x,
+                                 y = chunk.y,
+                                 skirtDepth = chunk.skirtDepth]
+    {
+        buildChunkVertices(face, level, x, y, skirtDepth, build->vertices);
+        build->done.store(true, std::memory_order_release);
+    };
+    if (auto jobs = celestia::util::GetJobSystem(); jobs != nullptr)
+        jobs->submit(std::move(job), celestia::util::JobPriority::Streaming);
+    else
+        job();
+}
+
+
+void
+CubeSphereMesh::finishBuilds()
+{
+    std::size_t uploads = 0;
+    for (auto it = building.begin(); it != building.end() && uploads < MaxUploadsPerFrame;)
+    {
+        Chunk* chunk = *it;
+        if (!chunk->build->done.load(std::memory_order_acquire))
+        {
+            ++it;
+            continue;
+        }
+
+        // Try again next frame when every slot holds a chunk in use
+        if (!upload(*chunk, chunk->build->vertices))
+            break;
+        chunk->build = nullptr;
+        it = building.erase(it);
+        uploads++;
+    }
+}
+
+
+bool
+CubeSphereMesh::upload(Chunk& chunk, const std::vector<float>& vertices)
+{
+    int slot = allocateSlot();
+    if (slot < 0)
+        return false;
+
+    constexpr GLsizeiptr chunkBytes = ChunkVertexCount * VertexSize * sizeof(float);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, vertexBuffers[slot / SlotsPerBuffer]);
+    celestia::gl::bufferSubData(GL_ARRAY_BUFFER,
+                                (slot % SlotsPerBuffer) * chunkBytes,
+                                chunkBytes,
+                                vertices.data());
+
+    chunk.slot = slot;
+    resident.push_back(&chunk);
+    return true;
+}
+
+
+int
+CubeSphereMesh::allocateSlot()
+{
+    if (freeSlots.empty() && vertexBuffers.size() * SlotsPerBuffer < static_cast<std::size_t>(MaxChunks))
+    {
+        GLuint vbo = 0;
+        glGenBuffers(1, &vbo);
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, vbo);
+        celestia::gl::bufferData(GL_ARRAY_BUFFER,
+                                 SlotsPerBuffer * ChunkVertexCount * VertexSize * sizeof(float),
+                                 nullptr,
+                                 GL_STATIC_DRAW);
+        int first = static_cast<int>(vertexBuffers.size()) * SlotsPerBuffer;
+        for (int slot = first + SlotsPerBuffer - 1; slot >= first; slot--)
+            freeSlots.push_back(slot);
+        vertexBuffers.push_back(vbo);
+    }
+
+    if (freeSlots.empty())
+    {
+        // Drop the chunk drawn least recently, keeping the first level and
+        // the parents of loaded chunks
+        Chunk* oldest = nullptr;
+        for (Chunk* chunk : resident)
+        {
+            if (chunk->level == FirstLevel || chunk->lastUsed == frame)
+                continue;
+            if (oldest != nullptr && chunk->lastUsed >= oldest->lastUsed)
+                continue;
+            if (std::any_of(chunk->children.begin(), chunk->children.end(),
+                            [](const auto& child) { return child != nullptr && child->slot >= 0; }))
+                continue;
+            oldest = chunk;
+        }
+        if (oldest == nullptr)
+            return -1;
+        evict(*oldest);
+    }
+
+    int slot = freeSlots.back();
+    freeSlots.pop_back();
+    return slot;
+}
+
+
+void
+CubeSphereMesh::evict(Chunk& chunk)
+{
+    freeSlots.push_back(chunk.slot);
+    chunk.slot = -1;
+    resident.erase(std::find(resident.begin(), resident.end(), &chunk));
+
+    // Forget the descendants unless some are still loaded or being built
+    std::function<bool(const Chunk&)> isUnused = [&isUnused](const Chunk& c)
+    {
+        if (c.slot >= 0 || c.build != nullptr)
+            return false;
+        return std::all_of(c.children.begin(), c.children.end(),
+                           [&isUnused](const auto& child) { return child == nullptr || isUnused(*child); });
+    };
+    if (std::all_of(chunk.children.begin(), chunk.children.end(),
+                    [&isUnused](const auto& child) { return child == nullptr || isUnused(*child); }))
+    {
+        for (auto& child : chunk.children)
+            child = nullptr;
+    }
+}
+
+
+void
+CubeSphereMesh::drawChunks(int nTextures)
+{
+    if (drawList.empty())
+        return;
+
+    // Draw the chunks of each vertex buffer with one call
+    std::sort(drawList.begin(), drawList.end(),
+              [](const Chunk* a, const Chunk* b) { return a->slot < b->slot; });
+
+    celestia::gl::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    auto stride = static_cast<GLsizei>(VertexSize * sizeof(float));
+    float* vertexBase = nullptr;
+
+    std::size_t i = 0;
+    while (i < drawList.size())
+    {
+        int buffer = drawList[i]->slot / SlotsPerBuffer;
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, vertexBuffers[buffer]);
+        glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
+                              3, GL_FLOAT, GL_FALSE,
+                              stride, vertexBase);
+        glVertexAttribPointer(CelestiaGLProgram::NormalAttributeIndex,
+                              3, GL_FLOAT, GL_FALSE,
+                              stride, vertexBase);
+        glVertexAttribPointer(CelestiaGLProgram::TangentAttributeIndex,
+                              3, GL_FLOAT, GL_FALSE,
+                              stride, vertexBase + 3);
+        // All textures share the same coordinates
+        for (int tc = 0; tc < nTextures; tc++)
+        {
+            glVertexAttribPointer(CelestiaGLProgram::TextureCoord0AttributeIndex + tc,
+                                  2, GL_FLOAT, GL_FALSE,
+                                  stride, vertexBase + 6);
+        }
+
+        baseVertices.clear();
+        indexCounts.clear();
+        indexOffsets.clear();
+        for (; i < drawList.size() && drawList[i]->slot / SlotsPerBuffer == buffer; i++)
+        {
+            baseVertices.push_back((drawList[i]->slot % SlotsPerBuffer) * ChunkVertexCount);
+            indexCounts.push_back(IndexCount);
+            indexOffsets.push_back(nullptr);
+        }
+
+#ifdef GL_ES
+        for (std::size_t j = 0; j < baseVertices.size(); j++)
+        {
+            celestia::gl::drawElementsBaseVertex(GL_TRIANGLES,
+                                                 indexCounts[j],
+                                                 GL_UNSIGNED_SHORT,
+                                                 indexOffsets[j],
+                                                 baseVertices[j]);
+        }
+#else
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES,
+                                      indexCounts.data(),
+                                      GL_UNSIGNED_SHORT,
+                                      indexOffsets.data(),
+                                      static_cast<GLsizei>(baseVertices.size()),
+                                      baseVertices.data());
+#endif
+    }
+}
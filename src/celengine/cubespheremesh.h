@@ -0,0 +1,85 @@
+// cubespheremesh.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Sphere mesh made of quadtrees of chunks over the faces of a cube.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <celengine/glsupport.h>
+#include <celmath/frustum.h>
+
+/**
+ * A unit sphere projected from a cube, each face of which is the root of a
+ * quadtree of chunks with a square grid of vertices. The chunks drawn are
+ * chosen for each view: they are split where their error on screen is too
+ * large, and culled against the frustum and the horizon, so that the
+ * triangles are spent on the visible part of the sphere near the observer
+ * instead of on whole rings of latitude.
+ *
+ * The vertices of the chunks are built by the job system and kept in
+ * graphics memory, up to a number of chunks beyond which those drawn least
+ * recently are dropped. A chunk is drawn in place of its children until
+ * all of them are ready. The edges of the chunks have skirts hanging below
+ * the surface, which hide the cracks between neighbours of different
+ * levels.
+ *
+ * The vertices have the position, tangent and texture coordinates of the
+ * static vertices of LODSphereMesh, for an equirectangular map, so only
+ * textures which aren't split into tiles can be drawn on the chunks.
+ */
+class CubeSphereMesh
+{
+ public:
+    CubeSphereMesh();
+    ~CubeSphereMesh();
+    CubeSphereMesh(const CubeSphereMesh&) = delete;
+    CubeSphereMesh& operator=(const CubeSphereMesh&) = delete;
+
+    // Draw the chunks needed for a view, with the frustum in the
+    // coordinates of the sphere and pixWidth the size of the sphere on
+    // screen. The textures must be bound and the arrays of the vertex
+    // attributes used enabled, with nTextures texture coordinates.
+    void render(const celmath::Frustum& frustum, float pixWidth, int nTextures);
+
+ private:
+    struct Chunk;
+    struct ChunkBuild;
+    struct View;
+
+    bool init();
+    std::unique_ptr<Chunk> createChunk(int face, int level, int x, int y) const;
+    void selectChunks(Chunk& chunk, const View& view);
+    void requestBuild(Chunk& chunk);
+    void finishBuilds();
+    bool upload(Chunk& chunk, const std::vector<float>& vertices);
+    int allocateSlot();
+    void evict(Chunk& chunk);
+    void drawChunks(int nTextures);
+
+    bool initialized{ false };
+    GLuint indexBuffer{ 0 };
+    // Each buffer holds the vertices of a fixed number of chunks
+    std::vector<GLuint> vertexBuffers;
+    std::vector<int> freeSlots;
+
+    // The chunks of the first level drawn, which are never dropped
+    std::vector<std::unique_ptr<Chunk>> roots;
+    std::vector<Chunk*> resident;
+    std::vector<Chunk*> building;
+    // Counts the views drawn, to find the chunks drawn least recently
+    unsigned int frame{ 0 };
+
+    std::vector<const Chunk*> drawList;
+    std::vector<GLint> baseVertices;
+    std::vector<GLsizei> indexCounts;
+    std::vector<const void*> indexOffsets;
+};
@@ -36,6 +36,8 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <limits>
 #include <vector>
 
 #if DEBUG_ADAPTIVE_SPLINE
@@ -44,6 +46,8 @@
 #include "curveplot.h"
 #include "glsupport.h"
 #include "shadermanager.h"
+#include "streambuffer.h"
+#include "glstate.h"
 
 namespace {
 
@@ -163,22 +167,23 @@ public:
         currentPosition = 0;
 
         this->lineAsTriangles = lineAsTriangles;
-        if (vbobj)
+        GLuint buffer = streamBuffer != nullptr ? streamBuffer->getBuffer() : vbobj;
+        if (buffer)
         {
-            glBindBuffer(GL_ARRAY_BUFFER, vbobj);
+            celestia::gl::bindBuffer(GL_ARRAY_BUFFER, buffer);
         }
 
         glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
         glEnableVertexAttribArray(CelestiaGLProgram::ColorAttributeIndex);
         int stride = lineAsTriangles ? sizeof(Vertex) : sizeof(Vertex) * 2;
 
-        const Eigen::Vector4f* vertexBase = vbobj
+        const Eigen::Vector4f* vertexBase = buffer
             ? reinterpret_cast<const Eigen::Vector4f*>(offsetof(Vertex, position))
             : &data[0].position;
         glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
                               3, GL_FLOAT, GL_FALSE, stride, vertexBase);
 
-        const Eigen::Vector4f* colorBase = vbobj
+        const Eigen::Vector4f* colorBase = buffer
             ? reinterpret_cast<const Eigen::Vector4f*>(offsetof(Vertex, color))
             : &data[0].color;
         glVertexAttribPointer(CelestiaGLProgram::ColorAttributeIndex,
@@ -188,13 +193,13 @@ public:
             glEnableVertexAttribArray(CelestiaGLProgram::NextVCoordAttributeIndex);
             glEnableVertexAttribArray(CelestiaGLProgram::ScaleFactorAttributeIndex);
 
-            const float* scaleBase = vbobj
+            const float* scaleBase = buffer
                 ? reinterpret_cast<const float*>(offsetof(Vertex, scale))
                 : &data[0].scale;
             glVertexAttribPointer(CelestiaGLProgram::ScaleFactorAttributeIndex,
                                   1, GL_FLOAT, GL_FALSE, stride, scaleBase);
 
-            const Eigen::Vector4f* nextVertexBase = vbobj
+            const Eigen::Vector4f* nextVertexBase = buffer
                 ? reinterpret_cast<const Eigen::Vector4f*>(offsetof(Vertex, position) + (2 * sizeof(Vertex)))
                 : &data[2].position;
             glVertexAttribPointer(CelestiaGLProgram::NextVCoordAttributeIndex,
@@ -213,8 +218,8 @@ public:
             glDisableVertexAttribArray(CelestiaGLProgram::NextVCoordAttributeIndex);
             glDisableVertexAttribArray(CelestiaGLProgram::ScaleFactorAttributeIndex);
         }
-        if (vbobj)
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        if (vbobj || streamBuffer != nullptr)
+            celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
 #endif
     }
 
@@ -332,15 +337,27 @@ public:
             if (endIfNeeded && currentStripLength > 1)
                 end(false);
 
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Vertex) * currentPosition * 2, data);
-
             unsigned int startIndex = 0;
+            GLsizeiptr size = sizeof(Vertex) * currentPosition * 2;
+            if (streamBuffer != nullptr)
+            {
+                // The range is aligned to both strides, so the vertices
+                // are addressed from its start
+                GLintptr offset = streamBuffer->allocate(size, 2 * sizeof(Vertex));
+                streamBuffer->write(offset, data, size);
+                startIndex = static_cast<unsigned int>(offset / (2 * sizeof(Vertex)));
+            }
+            else
+            {
+                celestia::gl::bufferSubData(GL_ARRAY_BUFFER, 0, size, data);
+            }
+
             for (unsigned int lineCount : stripLengths)
             {
                 if (lineAsTriangles)
-                    glDrawArrays(GL_TRIANGLE_STRIP, startIndex * 2, lineCount * 2);
+                    celestia::gl::drawArrays(GL_TRIANGLE_STRIP, startIndex * 2, lineCount * 2);
                 else
-                    glDrawArrays(GL_LINE_STRIP, startIndex, lineCount);
+                    celestia::gl::drawArrays(GL_LINE_STRIP, startIndex, lineCount);
                 startIndex += lineCount + 1;
             }
 
@@ -355,18 +372,23 @@ public:
     void createVertexBuffer()
     {
 #if USE_VERTEX_BUFFER
-        if (!vbobj)
+        if (!vbobj && streamBuffer == nullptr)
         {
             glGenBuffers(1, &vbobj);
-            glBindBuffer(GL_ARRAY_BUFFER, vbobj);
-            glBufferData(GL_ARRAY_BUFFER,
-                         (2 * (capacity + 1)) * sizeof(Vertex),
-                         nullptr,
-                         GL_STREAM_DRAW);
+            celestia::gl::bindBuffer(GL_ARRAY_BUFFER, vbobj);
+            celestia::gl::bufferData(GL_ARRAY_BUFFER,
+                                     (2 * (capacity + 1)) * sizeof(Vertex),
+                                     nullptr,
+                                     GL_STREAM_DRAW);
         }
 #endif
     }
 
+    void setStreamBuffer(celgl::StreamBuffer* buffer)
+    {
+        streamBuffer = buffer;
+    }
+
     void setColor(const Eigen::Vector4f &aColor)
     {
 #if USE_VERTEX_BUFFER
@@ -388,6 +410,7 @@ private:
 
     Vertex* data;
     GLuint vbobj;
+    celgl::StreamBuffer* streamBuffer{ nullptr };
     unsigned int currentStripLength;
     std::vector<unsigned int> stripLengths;
     Eigen::Vector4f color;
@@ -574,17 +597,73 @@ private:
 
 HighPrec_VertexBuffer vbuf;
 
+// Smallest number of samples the ring buffer of a plot is made for
+constexpr std::size_t MinBufferedSamples = 64;
 
-
+// Largest error of a buffered plot, in pixels, beyond which renderBuffered()
+// leaves the plot to the adaptive subdivision of render()
+constexpr double MaxBufferedError = 0.5;
 
 } // end unnamed namespace
 
 
+/** The vertices of a plot in graphics memory. Each sample owns a slot of
+  * SubdivisionFactor vertices along the cubic from it to the next sample,
+  * and the slots form a ring starting at the first sample, which moves as
+  * samples are added and removed at either end. The vertex past the last
+  * slot repeats the first, so that a line strip wrapping around the end of
+  * the ring is drawn in two parts.
+  */
+class CurvePlotBuffer
+{
+public:
+    struct Vertex
+    {
+        float position[3];
+        float time;
+    };
+
+    CurvePlotBuffer() = default;
+    ~CurvePlotBuffer()
+    {
+        if (vbo != 0)
+            glDeleteBuffers(1, &vbo);
+    }
+    CurvePlotBuffer(const CurvePlotBuffer&) = delete;
+    CurvePlotBuffer& operator=(const CurvePlotBuffer&) = delete;
+
+    std::size_t vertexCount() const { return capacity * SubdivisionFactor + 1; }
+
+    GLuint vbo{ 0 };
+    // Number of slots and the slot of the first sample
+    std::size_t capacity{ 0 };
+    std::size_t head{ 0 };
+    // The vertices are relative to the position and time of the first
+    // sample when the buffer was filled
+    Eigen::Vector3d origin{ Eigen::Vector3d::Zero() };
+    double timeOrigin{ 0.0 };
+    // Largest distance of a vertex from the origin, and largest distance
+    // of the curve from the lines between the vertices, both in kilometers
+    double extent{ 0.0 };
+    double chordError{ 0.0 };
+};
+
+
 CurvePlot::CurvePlot()
 {
 }
 
 
+CurvePlot::~CurvePlot() = default;
+
+
+void
+CurvePlot::setStreamBuffer(celgl::StreamBuffer* streamBuffer)
+{
+    vbuf.setStreamBuffer(streamBuffer);
+}
+
+
 /** Add a new sample to the path. If the sample time is less than the first time,
   * it is added at the end. If it is greater than the last time, it is appended
   * to the path. The sample is ignored if it has a time in between the first and
@@ -610,9 +689,15 @@ CurvePlot::addSample(const CurvePlotSample& sample)
     }
 
     if (addToBack)
+    {
         m_samples.push_back(sample);
+        m_backAdded++;
+    }
     else
+    {
         m_samples.push_front(sample);
+        m_frontAdded++;
+    }
 
     if (m_samples.size() > 1)
     {
@@ -654,6 +739,19 @@ CurvePlot::removeSamplesBefore(double t)
     while (!m_samples.empty() && m_samples.front().t < t)
     {
         m_samples.pop_front();
+        if (m_frontAdded > 0)
+        {
+            m_frontAdded--;
+        }
+        else if (m_bufferedSamples > 0)
+        {
+            m_bufferedSamples--;
+            m_frontRemoved++;
+        }
+        else
+        {
+            m_backAdded--;
+        }
     }
 }
 
@@ -666,10 +764,40 @@ CurvePlot::removeSamplesAfter(double t)
     while (!m_samples.empty() && m_samples.back().t > t)
     {
         m_samples.pop_back();
+        if (m_backAdded > 0)
+            m_backAdded--;
+        else if (m_bufferedSamples > 0)
+            m_bufferedSamples--;
+        else
+            m_frontAdded--;
     }
 }
 
 
+std::size_t
+CurvePlot::memoryUsage() const
+{
+    std::size_t bytes = m_samples.size() * sizeof(CurvePlotSample);
+    if (m_buffer != nullptr)
+        bytes += m_buffer->vertexCount() * sizeof(CurvePlotBuffer::Vertex);
+    return bytes;
+}
+
+
+/** Return the distance from point to the closest sample, or infinity if
+  * there are no samples.
+  */
+double
+CurvePlot::nearestSampleDistance(const Eigen::Vector3d& point) const
+{
+    double distance2 = std::numeric_limits<double>::infinity();
+    for (const auto& sample : m_samples)
+        distance2 = std::min(distance2, (sample.position - point).squaredNorm());
+
+    return std::sqrt(distance2);
+}
+
+
 void
 CurvePlot::setDuration(double duration)
 {
@@ -1166,3 +1294,235 @@ CurvePlot::renderFaded(const Eigen::Affine3d& modelview,
     vbuf.flush();
     vbuf.finish();
 }
+
+
+/** Bring the ring buffer up to date with the samples. Only the slots of the
+  * samples added since the last update are written, and that of the sample
+  * before those added at the back, whose cubic they extend. The buffer is
+  * filled again from scratch when the samples outgrow it or none of those
+  * it holds are left.
+  */
+void
+CurvePlot::updateBuffer()
+{
+    if (m_buffer == nullptr)
+        m_buffer = std::make_unique<CurvePlotBuffer>();
+    CurvePlotBuffer& buf = *m_buffer;
+
+    std::size_t nSamples = m_samples.size();
+    if (buf.vbo == 0 || m_bufferedSamples == 0 || nSamples > buf.capacity)
+    {
+        // Leave room for the window of a periodic orbit to shift without
+        // growing the buffer again
+        std::size_t capacity = MinBufferedSamples;
+        while (capacity < nSamples * 2)
+            capacity *= 2;
+
+        if (buf.vbo == 0)
+            glGenBuffers(1, &buf.vbo);
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, buf.vbo);
+        if (capacity != buf.capacity)
+        {
+            buf.capacity = capacity;
+            celestia::gl::bufferData(GL_ARRAY_BUFFER,
+                                     buf.vertexCount() * sizeof(CurvePlotBuffer::Vertex),
+                                     nullptr,
+                                     GL_DYNAMIC_DRAW);
+        }
+
+        buf.head = 0;
+        buf.origin = m_samples.front().position;
+        buf.timeOrigin = m_samples.front().t;
+        buf.extent = 0.0;
+        buf.chordError = 0.0;
+        writeBufferSlots(0, nSamples);
+    }
+    else
+    {
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, buf.vbo);
+        buf.head = (buf.head + m_frontRemoved + buf.capacity - m_frontAdded) % buf.capacity;
+        if (m_frontAdded > 0)
+            writeBufferSlots(0, m_frontAdded);
+        if (m_backAdded > 0)
+            writeBufferSlots(nSamples - m_backAdded - 1, m_backAdded + 1);
+    }
+
+    m_bufferedSamples = nSamples;
+    m_frontAdded = 0;
+    m_backAdded = 0;
+    m_frontRemoved = 0;
+}
+
+
+/** Write the slots of count samples from firstSample into the bound ring
+  * buffer.
+  */
+void
+CurvePlot::writeBufferSlots(std::size_t firstSample, std::size_t count)
+{
+    CurvePlotBuffer& buf = *m_buffer;
+    std::vector<CurvePlotBuffer::Vertex> vertices(count * SubdivisionFactor);
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const CurvePlotSample& s0 = m_samples[firstSample + i];
+        CurvePlotBuffer::Vertex* slot = &vertices[i * SubdivisionFactor];
+        Eigen::Vector3d p0 = s0.position - buf.origin;
+        buf.extent = std::max(buf.extent, p0.norm());
+
+        // Only the first vertex of the slot of the last sample is drawn
+        if (firstSample + i + 1 == m_samples.size())
+        {
+            for (unsigned int k = 0; k < SubdivisionFactor; k++)
+            {
+                Eigen::Map<Eigen::Vector3f> position(slot[k].position);
+                position = p0.cast<float>();
+                slot[k].time = static_cast<float>(s0.t - buf.timeOrigin);
+            }
+            continue;
+        }
+
+        const CurvePlotSample& s1 = m_samples[firstSample + i + 1];
+        double dt = s1.t - s0.t;
+        Eigen::Matrix4d coeff = cubicHermiteCoefficients(zeroExtend(p0),
+                                                         zeroExtend(s1.position - buf.origin),
+                                                         zeroExtend(s0.velocity * dt),
+                                                         zeroExtend(s1.velocity * dt));
+        auto curvePoint = [&coeff](double u)
+        {
+            return (coeff * Eigen::Vector4d(1.0, u, u * u, u * u * u)).head<3>().eval();
+        };
+
+        for (unsigned int k = 0; k < SubdivisionFactor; k++)
+        {
+            double u = k * InvSubdivisionFactor;
+            Eigen::Vector3d point = k == 0 ? p0 : curvePoint(u);
+            Eigen::Map<Eigen::Vector3f> position(slot[k].position);
+            position = point.cast<float>();
+            slot[k].time = static_cast<float>(s0.t + u * dt - buf.timeOrigin);
+
+            Eigen::Vector3d nextPoint = curvePoint(u + InvSubdivisionFactor);
+            Eigen::Vector3d midPoint = curvePoint(u + 0.5 * InvSubdivisionFactor);
+            buf.chordError = std::max(buf.chordError, (midPoint - 0.5 * (point + nextPoint)).norm());
+            buf.extent = std::max(buf.extent, point.norm());
+        }
+    }
+
+    // Copy the slots to the ring, in two parts if they wrap around its end
+    constexpr std::size_t VertexSize = sizeof(CurvePlotBuffer::Vertex);
+    std::size_t firstSlot = (buf.head + firstSample) % buf.capacity;
+    std::size_t headCount = std::min(count, buf.capacity - firstSlot);
+    celestia::gl::bufferSubData(GL_ARRAY_BUFFER,
+                                firstSlot * SubdivisionFactor * VertexSize,
+                                headCount * SubdivisionFactor * VertexSize,
+                                vertices.data());
+    if (headCount < count)
+    {
+        celestia::gl::bufferSubData(GL_ARRAY_BUFFER,
+                                    0,
+                                    (count - headCount) * SubdivisionFactor * VertexSize,
+                                    &vertices[headCount * SubdivisionFactor]);
+    }
+
+    // Repeat the first vertex of the ring after its end
+    if (firstSlot + count > buf.capacity || firstSlot == 0)
+    {
+        std::size_t first = ((buf.capacity - firstSlot) % buf.capacity) * SubdivisionFactor;
+        celestia::gl::bufferSubData(GL_ARRAY_BUFFER,
+                                    buf.capacity * SubdivisionFactor * VertexSize,
+                                    VertexSize,
+                                    &vertices[first]);
+    }
+}
+
+
+bool
+CurvePlot::renderBuffered(CelestiaGLProgram& prog,
+                          const Eigen::Affine3d& modelview,
+                          const Eigen::Matrix4f& projection,
+                          double viewerDistance,
+                          double pixelSize,
+                          double startTime,
+                          double endTime,
+                          const Eigen::Vector4f& color,
+                          double fadeStartTime,
+                          double fadeEndTime)
+{
+    if (m_samples.size() < 2)
+        return true;
+
+    updateBuffer();
+    const CurvePlotBuffer& buf = *m_buffer;
+
+    // The positions are off by the error of the lines and the rounding of
+    // the vertices and of the translation to the origin
+    double error = buf.chordError +
+                   std::numeric_limits<float>::epsilon() * (2.0 * buf.extent + viewerDistance);
+    if (error > MaxBufferedError * pixelSize * viewerDistance)
+    {
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+        return false;
+    }
+
+    if (endTime <= m_samples.front().t || startTime >= m_samples.back().t)
+    {
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+        return true;
+    }
+
+    // Draw from the last sample at or before startTime to the first at or
+    // after endTime; the shader clips the lines to the window.
+    auto byTime = [](const CurvePlotSample& sample, double t) { return sample.t < t; };
+    std::size_t startSample = std::lower_bound(m_samples.begin(), m_samples.end(), startTime, byTime) - m_samples.begin();
+    if (startSample > 0 && m_samples[startSample].t > startTime)
+        startSample--;
+    std::size_t endSample = std::lower_bound(m_samples.begin(), m_samples.end(), endTime, byTime) - m_samples.begin();
+    endSample = std::min(endSample, m_samples.size() - 1);
+
+    Eigen::Affine3d bufferModelview = modelview * Eigen::Translation3d(buf.origin);
+    prog.use();
+    prog.setMVPMatrices(projection, bufferModelview.matrix().cast<float>());
+    prog.vec4Param("color") = color;
+    prog.floatParam("windowStart") = static_cast<float>(startTime - buf.timeOrigin);
+    prog.floatParam("windowEnd") = static_cast<float>(endTime - buf.timeOrigin);
+    // The opacity is fadeOffset + fadeRate * time
+    if (fadeStartTime == fadeEndTime)
+    {
+        prog.floatParam("fadeOffset") = 1.0f;
+        prog.floatParam("fadeRate") = 0.0f;
+    }
+    else
+    {
+        double fadeRate = 1.0 / (fadeEndTime - fadeStartTime);
+        prog.floatParam("fadeOffset") = static_cast<float>((buf.timeOrigin - fadeStartTime) * fadeRate);
+        prog.floatParam("fadeRate") = static_cast<float>(fadeRate);
+    }
+
+    glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
+    glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
+                          3, GL_FLOAT, GL_FALSE, sizeof(CurvePlotBuffer::Vertex),
+                          reinterpret_cast<const void*>(offsetof(CurvePlotBuffer::Vertex, position)));
+    glEnableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
+    glVertexAttribPointer(CelestiaGLProgram::TextureCoord0AttributeIndex,
+                          1, GL_FLOAT, GL_FALSE, sizeof(CurvePlotBuffer::Vertex),
+                          reinterpret_cast<const void*>(offsetof(CurvePlotBuffer::Vertex, time)));
+
+    std::size_t ringSize = buf.capacity * SubdivisionFactor;
+    std::size_t first = ((buf.head + startSample) % buf.capacity) * SubdivisionFactor;
+    std::size_t count = (endSample - startSample) * SubdivisionFactor + 1;
+    if (first + count <= ringSize + 1)
+    {
+        celestia::gl::drawArrays(GL_LINE_STRIP, static_cast<GLint>(first), static_cast<GLsizei>(count));
+    }
+    else
+    {
+        celestia::gl::drawArrays(GL_LINE_STRIP, static_cast<GLint>(first), static_cast<GLsizei>(ringSize + 1 - first));
+        celestia::gl::drawArrays(GL_LINE_STRIP, 0, static_cast<GLsizei>(count - (ringSize - first)));
+    }
+
+    glDisableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
+    glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+
+    return true;
+}
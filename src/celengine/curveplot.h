@@ -29,11 +29,20 @@
 
 #pragma once
 
+#include <cstddef>
 #include <deque>
+#include <memory>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
+namespace celgl
+{
+class StreamBuffer;
+}
+
+class CelestiaGLProgram;
+class CurvePlotBuffer;
 
 class CurvePlotSample
 {
@@ -49,6 +58,7 @@ class CurvePlot
 {
  public:
     CurvePlot();
+    ~CurvePlot();
 
     double duration() const { return m_duration; }
     void setDuration(double duration);
@@ -97,9 +107,34 @@ class CurvePlot
                      double fadeEndTime,
                      bool lineAsTriangles) const;
 
+    // Draw the part of the plot between startTime and endTime as a line
+    // strip from a ring buffer in graphics memory, with the program of the
+    // shader "curveplot". The buffer holds the cubics subdivided into a
+    // fixed number of lines, with positions relative to the first sample
+    // in single precision; the samples added or removed since the last
+    // call are its only vertices uploaded. Nothing is drawn and false is
+    // returned when the error of the buffer is visible to a viewer at
+    // viewerDistance from the nearest sample, with pixelSize the angle of a
+    // pixel; render() or renderFaded() must be used instead. The fade is
+    // that of renderFaded(), none if fadeStartTime equals fadeEndTime.
+    bool renderBuffered(CelestiaGLProgram& prog,
+                        const Eigen::Affine3d& modelview,
+                        const Eigen::Matrix4f& projection,
+                        double viewerDistance,
+                        double pixelSize,
+                        double startTime,
+                        double endTime,
+                        const Eigen::Vector4f& color,
+                        double fadeStartTime,
+                        double fadeEndTime);
+
     unsigned int lastUsed() const { return m_lastUsed; }
     void setLastUsed(unsigned int lastUsed) { m_lastUsed = lastUsed; }
 
+    // Tolerance in kilometers that the samples were taken with
+    double tolerance() const { return m_tolerance; }
+    void setTolerance(double tolerance) { m_tolerance = tolerance; }
+
     void addSample(const CurvePlotSample& sample);
     void removeSamplesBefore(double t);
     void removeSamplesAfter(double t);
@@ -107,12 +142,32 @@ class CurvePlot
     bool empty() const { return m_samples.empty(); }
 
     unsigned int sampleCount() const { return m_samples.size(); }
+    std::size_t memoryUsage() const;
+
+    double nearestSampleDistance(const Eigen::Vector3d& point) const;
+
+    // Stream the vertices of all plots through a shared buffer rather than
+    // one of their own; nullptr goes back to the latter
+    static void setStreamBuffer(celgl::StreamBuffer* streamBuffer);
 
  private:
+    void updateBuffer();
+    void writeBufferSlots(std::size_t firstSample, std::size_t count);
+
     std::deque<CurvePlotSample> m_samples;
 
+    // Created by the first call to renderBuffered()
+    std::unique_ptr<CurvePlotBuffer> m_buffer;
+    // Changes to the samples since the buffer was last updated: the number
+    // still in it, and those added and removed at each end
+    std::size_t m_bufferedSamples{ 0 };
+    std::size_t m_frontAdded{ 0 };
+    std::size_t m_backAdded{ 0 };
+    std::size_t m_frontRemoved{ 0 };
+
     double m_duration{ 0.0 };
 
     unsigned int m_lastUsed{ 0 };
+    double m_tolerance{ 1.0 };
 };
 
@@ -75,6 +75,26 @@ void DeepSkyObject::setInfoURL(const string& s)
     infoURL = s;
 }
 
+void DeepSkyObject::setInfoURL(const string& s, const fs::path& resPath)
+{
+    if (s.find(':') != string::npos)
+    {
+        infoURL = s;
+    }
+    else
+    {
+        // Relative URL, the base directory is the current one,
+        // not the main installation directory
+        if (resPath.c_str()[1] == ':')
+            // Absolute Windows path, file:/// is required
+            infoURL = "file:///" + resPath.string() + "/" + s;
+        else if (!resPath.empty())
+            infoURL = resPath.string() + "/" + s;
+        else
+            infoURL = s;
+    }
+}
+
 
 bool DeepSkyObject::pick(const Eigen::ParametrizedLine<double, 3>& ray,
                          double& distanceToPicker,
@@ -184,19 +204,7 @@ bool DeepSkyObject::load(AssociativeArray* params, const fs::path& resPath)
 
     string infoURL; // FIXME: infourl class
     if (params->getString("InfoURL", infoURL))
-    {
-        if (infoURL.find(':') == string::npos)
-        {
-            // Relative URL, the base directory is the current one,
-            // not the main installation directory
-            if (resPath.c_str()[1] == ':')
-                // Absolute Windows path, file:/// is required
-                infoURL = "file:///" + resPath.string() + "/" + infoURL;
-            else if (!resPath.empty())
-                infoURL = resPath.string() + "/" + infoURL;
-        }
-        setInfoURL(infoURL);
-    }
+        setInfoURL(infoURL, resPath);
 
     bool visible = true;
     if (params->getBoolean("Visible", visible))
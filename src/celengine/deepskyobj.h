@@ -68,6 +68,8 @@ class DeepSkyObject : public AstroObject
 
     const std::string& getInfoURL() const;
     void setInfoURL(const std::string&);
+    // Relative URLs are resolved against resPath
+    void setInfoURL(const std::string&, const fs::path& resPath);
 
     bool isVisible() const { return visible; }
     void setVisible(bool _visible) { visible = _visible; }
@@ -88,6 +90,16 @@ class DeepSkyObject : public AstroObject
                         const Matrices& m,
                         Renderer*) = 0;
 
+    /*! Return the radius of a sphere containing everything render() draws
+     *  when the object is far away, or zero if the object can't be drawn from a
+     *  cached billboard.
+     */
+    virtual float getImpostorRadius() const { return 0.0f; }
+    /*! Return a value which changes with the appearance of the object
+     *  drawn at brightness; cached billboards are rendered again when it does.
+     */
+    virtual float getImpostorBrightness(float brightness) const { return brightness; }
+
     virtual uint64_t getRenderMask() const { return 0; }
     virtual unsigned int getLabelMask() const { return 0; }
 
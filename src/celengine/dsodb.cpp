@@ -13,14 +13,19 @@
 #include <cmath>
 #include <cstdlib>
 #include <cassert>
+#include <cstring>
 #include <algorithm>
+#include <fstream>
+#include <iterator>
 
 #include <fmt/printf.h>
 
 #include <celmath/mathlib.h>
 #include <celutil/logger.h>
 #include <celutil/gettext.h>
+#include <celutil/binaryread.h>
 #include <celutil/bytes.h>
+#include <celutil/mmapfile.h>
 #include <celutil/utf8.h>
 #include <celutil/tokenizer.h>
 #include "astro.h"
@@ -42,12 +47,12 @@ using namespace Eigen;
 using namespace std;
 using celestia::util::GetLogger;
 
+namespace celutil = celestia::util;
+
 constexpr const float DSO_OCTREE_MAGNITUDE   = 8.0f;
 //constexpr const float DSO_EXTRA_ROOM         = 0.01f; // Reserve 1% capacity for extra DSOs
                                                       // (useful as a complement of binary loaded DSOs)
 
-//constexpr char FILE_HEADER[]                 = "CEL_DSOs";
-
 // Used to sort DSO pointers by catalog number
 struct PtrCatalogNumberOrderingPredicate
 {
@@ -64,7 +69,6 @@ struct PtrCatalogNumberOrderingPredicate
 
 DSODatabase::~DSODatabase()
 {
-    delete [] DSOs;
     delete [] catalogNumberIndex;
 }
 
@@ -137,6 +141,16 @@ string DSODatabase::getDSOName(const DeepSkyObject* const & dso, bool i18n) cons
 }
 
 
+// A version of getDSOName that returns a view of the name database instead
+// of allocating a string, for labels drawn every frame
+std::string_view DSODatabase::getDSONameView(const DeepSkyObject* dso, bool i18n) const
+{
+    if (namesDB == nullptr)
+        return {};
+    return namesDB->getPrimaryName(dso->getIndex(), i18n);
+}
+
+
 string DSODatabase::getDSONameList(const DeepSkyObject* const & dso, const unsigned int maxNames) const
 {
     string dsoNames;
@@ -160,16 +174,13 @@ string DSODatabase::getDSONameList(const DeepSkyObject* const & dso, const unsig
 }
 
 
-void DSODatabase::findVisibleDSOs(DSOHandler&    dsoHandler,
-                                  const Vector3d& obsPos,
-                                  const Quaternionf& obsOrient,
-                                  float fovY,
-                                  float aspectRatio,
-                                  float limitingMag,
-                                  OctreeProcStats *stats) const
+void DSODatabase::computeFrustumPlanes(Hyperplane<double, 3>* frustumPlanes,
+                                       const Vector3d& obsPos,
+                                       const Quaternionf& obsOrient,
+                                       float fovY,
+                                       float aspectRatio)
 {
     // Compute the bounding planes of an infinite view frustum
-    Hyperplane<double, 3> frustumPlanes[5];
     Vector3d  planeNormals[5];
 
     Quaterniond obsOrientd = obsOrient.cast<double>();
@@ -188,13 +199,63 @@ void DSODatabase::findVisibleDSOs(DSOHandler&    dsoHandler,
         planeNormals[i]    = rot * planeNormals[i].normalized();
         frustumPlanes[i]   = Hyperplane<double, 3>(planeNormals[i], obsPos);
     }
+}
 
-    octreeRoot->processVisibleObjects(dsoHandler,
-                                      obsPos,
-                                      frustumPlanes,
-                                      limitingMag,
-                                      DSO_OCTREE_ROOT_SIZE,
-                                      stats);
+
+void DSODatabase::findVisibleDSONodes(std::vector<FlatDSOOctree::VisibleNode>& nodes,
+                                      const Vector3d& obsPos,
+                                      const Quaternionf& obsOrient,
+                                      float fovY,
+                                      float aspectRatio,
+                                      float limitingMag) const
+{
+    Hyperplane<double, 3> frustumPlanes[5];
+    if (fovY > 0.0f)
+        computeFrustumPlanes(frustumPlanes, obsPos, obsOrient, fovY, aspectRatio);
+    else
+        std::fill(std::begin(frustumPlanes), std::end(frustumPlanes), Hyperplane<double, 3>(Vector3d::Zero(), 1.0));
+
+    nodes.clear();
+    octree.visitVisibleNodeIndices([&nodes](std::uint32_t node, std::uint32_t /*count*/, double dimmest)
+                                   {
+                                       nodes.push_back({ node, dimmest });
+                                   },
+                                   obsPos,
+                                   frustumPlanes,
+                                   limitingMag);
+}
+
+
+void DSODatabase::findVisibleDSOs(DSOHandler&    dsoHandler,
+                                  const Vector3d& obsPos,
+                                  const Quaternionf& obsOrient,
+                                  float fovY,
+                                  float aspectRatio,
+                                  float limitingMag,
+                                  OctreeProcStats *stats) const
+{
+    Hyperplane<double, 3> frustumPlanes[5];
+    computeFrustumPlanes(frustumPlanes, obsPos, obsOrient, fovY, aspectRatio);
+
+    octree.processVisibleObjects(dsoHandler,
+                                 obsPos,
+                                 frustumPlanes,
+                                 limitingMag,
+                                 stats);
+}
+
+
+void DSODatabase::findDSOsInCone(DSOHandler&     dsoHandler,
+                                 const Vector3d& obsPos,
+                                 const Vector3d& direction,
+                                 double          angle,
+                                 float           limitingMag) const
+{
+    octree.processObjectsInCone(dsoHandler,
+                                obsPos,
+                                direction,
+                                angle,
+                                limitingMag);
 }
 
 
@@ -202,10 +263,9 @@ void DSODatabase::findCloseDSOs(DSOHandler&     dsoHandler,
                                 const Vector3d& obsPos,
                                 float           radius) const
 {
-    octreeRoot->processCloseObjects(dsoHandler,
-                                    obsPos,
-                                    radius,
-                                    DSO_OCTREE_ROOT_SIZE);
+    octree.processCloseObjects(dsoHandler,
+                               obsPos,
+                               radius);
 }
 
 
@@ -215,6 +275,35 @@ DSONameDatabase* DSODatabase::getNameDatabase() const
 }
 
 
+void DSODatabase::accountMemory(celestia::util::MemoryUsage& parent) const
+{
+    // The objects don't know their size, so they're counted by type
+    std::size_t objectBytes = 0;
+    for (int i = 0; i < nDSOs; ++i)
+    {
+        const DeepSkyObject* dso = DSOs[i];
+        if (dynamic_cast<const Galaxy*>(dso) != nullptr)
+            objectBytes += sizeof(Galaxy);
+        else if (dynamic_cast<const Globular*>(dso) != nullptr)
+            objectBytes += sizeof(Globular);
+        else if (dynamic_cast<const OpenCluster*>(dso) != nullptr)
+            objectBytes += sizeof(OpenCluster);
+        else if (dynamic_cast<const Nebula*>(dso) != nullptr)
+            objectBytes += sizeof(Nebula);
+        else
+            objectBytes += sizeof(DeepSkyObject);
+    }
+
+    auto& usage = parent.add("deep sky objects", objectBytes, nDSOs);
+    usage.add("object array", static_cast<std::size_t>(capacity) * sizeof(DeepSkyObject*));
+    usage.add("catalog number index", catalogNumberIndex == nullptr ? 0 : static_cast<std::size_t>(nDSOs) * sizeof(DeepSkyObject*));
+    usage.add("octree", octree.memoryUsage(), octree.nodeCount());
+
+    if (namesDB != nullptr)
+        namesDB->accountMemory(usage);
+}
+
+
 void DSODatabase::setNameDatabase(DSONameDatabase* _namesDB)
 {
     namesDB    = _namesDB;
@@ -225,7 +314,20 @@ bool DSODatabase::load(istream& in, const fs::path& resourcePath)
 {
     Tokenizer tokenizer(&in);
     Parser    parser(&tokenizer);
+    return load(tokenizer, parser, resourcePath);
+}
 
+
+bool DSODatabase::load(PreparsedCatalog& catalog, const fs::path& resourcePath)
+{
+    Tokenizer tokenizer(catalog.getTokens());
+    Parser    parser(&tokenizer, &catalog);
+    return load(tokenizer, parser, resourcePath);
+}
+
+
+bool DSODatabase::load(Tokenizer& tokenizer, Parser& parser, const fs::path& resourcePath)
+{
 #ifdef ENABLE_NLS
     string s = resourcePath.string();
     const char *d = s.c_str();
@@ -286,78 +388,336 @@ bool DSODatabase::load(istream& in, const fs::path& resourcePath)
         else if (compareIgnoringCase(objType, "OpenCluster") == 0)
             obj = new OpenCluster();
 
-        if (obj != nullptr && obj->load(objParams, resourcePath))
+        if (obj != nullptr && rejectedUpdates != nullptr && obj->load(objParams, resourcePath))
+        {
+            if (!updateObject(obj, objName, objParams, resourcePath))
+            {
+                ++*rejectedUpdates;
+                GetLogger()->warn(_("Deep sky object {} can't be updated without rebuilding the catalog.\n"), objName);
+            }
+            delete obj;
+            delete objParamsValue;
+        }
+        else if (obj != nullptr && obj->load(objParams, resourcePath))
         {
             obj->loadCategories(objParams, DataDisposition::Add, resourcePath.string());
             delete objParamsValue;
 
             // Ensure that the DSO array is large enough
-            if (nDSOs == capacity)
-            {
-                // Grow the array by 5%--this may be too little, but the
-                // assumption here is that there will be small numbers of
-                // DSOs in text files added to a big collection loaded from
-                // a binary file.
-                capacity = (int) (capacity * 1.05);
+            reserve(nDSOs + 1);
+            DSOs[nDSOs++] = obj;
+
+            obj->setIndex(objCatalogNumber);
+            addNames(objCatalogNumber, objName);
+        }
+        else
+        {
+            GetLogger()->warn("Bad Deep Sky Object definition--will continue parsing file.\n");
+            delete objParamsValue;
+            return false;
+        }
+    }
+    return true;
+}
 
-                // 100 DSOs seems like a reasonable minimum
-                if (capacity < 100)
-                    capacity = 100;
 
-                DeepSkyObject** newDSOs = new DeepSkyObject*[capacity];
+std::size_t DSODatabase::update(istream& in, const fs::path& resourcePath)
+{
+    std::size_t rejected = 0;
+    rejectedUpdates = &rejected;
 
-                if (DSOs != nullptr)
-                {
-                    copy(DSOs, DSOs + nDSOs, newDSOs);
-                    delete[] DSOs;
-                }
-                DSOs = newDSOs;
-            }
+    Tokenizer tokenizer(&in);
+    Parser    parser(&tokenizer);
+    if (!load(tokenizer, parser, resourcePath))
+        GetLogger()->error(_("Error reading updated deep sky catalog {}\n"), resourcePath);
 
-            DSOs[nDSOs++] = obj;
+    rejectedUpdates = nullptr;
+    return rejected;
+}
 
-            obj->setIndex(objCatalogNumber);
 
-            if (namesDB != nullptr && !objName.empty())
+/*! Copy the definition read into obj to the object of the database with
+ *  the same type and first name, if it stays in its octree node. The
+ *  object is loaded again from the definition rather than assigned, so
+ *  that pointers to it remain valid.
+ */
+bool DSODatabase::updateObject(DeepSkyObject* obj,
+                               const std::string& names,
+                               Hash* params,
+                               const fs::path& resourcePath)
+{
+    DeepSkyObject* existing = find(names.substr(0, names.find(':')), false);
+    if (existing == nullptr || std::strcmp(existing->getObjTypeName(), obj->getObjTypeName()) != 0)
+        return false;
+
+    DeepSkyObject** slot = std::find(DSOs.get(), DSOs.get() + nDSOs, existing);
+    if (!octree.canUpdateObject(slot, obj->getPosition(),
+                                obj->getBoundingSphereRadius(),
+                                obj->getAbsoluteMagnitude()))
+    {
+        return false;
+    }
+
+    existing->load(params, resourcePath);
+    existing->loadCategories(params, DataDisposition::Replace, resourcePath.string());
+    return true;
+}
+
+
+bool DSODatabase::loadBinary(istream& in, const fs::path& resourcePath)
+{
+    vector<char> data{ istreambuf_iterator<char>(in), istreambuf_iterator<char>() };
+    if (in.bad())
+        return false;
+
+    return loadBinary(data.data(), data.size(), resourcePath);
+}
+
+
+/*! Load a binary deep sky catalog by mapping it into memory. The records
+ *  are decoded in place, so no text parsing or per-object property hash
+ *  is involved.
+ */
+bool DSODatabase::loadBinary(const fs::path& path, const fs::path& resourcePath)
+{
+    celutil::MemoryMappedFile file;
+    if (!file.open(path, celutil::MemoryMappedFile::AccessHint::Sequential))
+    {
+        GetLogger()->debug("Unable to map {}, falling back to stream reader\n", path);
+        ifstream in(path, ios::in | ios::binary);
+        return in.good() && loadBinary(in, resourcePath);
+    }
+
+    return loadBinary(file.data(), file.size(), resourcePath);
+}
+
+
+/*! Each object record is DSO_BINARY_RECORD_SIZE bytes long:
+ *
+ *   0  uint32   catalog number, AstroCatalog::InvalidIndex to assign one
+ *   4  uint8    object class (DSOBinaryClass)
+ *   5  uint8    flags (DSO_BINARY_VISIBLE, DSO_BINARY_CLICKABLE)
+ *   6  uint16   reserved
+ *   8  double   position x, y, z in light years
+ *  32  float    orientation quaternion w, x, y, z
+ *  48  float    radius in light years
+ *  52  float    absolute magnitude
+ *  56  float    detail (galaxies and globulars)
+ *  60  float    core radius in arcminutes (globulars)
+ *  64  float    King concentration (globulars)
+ *  68  uint32   names, separated by ':'
+ *  72  uint32   type name (galaxies)
+ *  76  uint32   custom template (galaxies) or mesh (nebulae)
+ *  80  uint32   info URL
+ *  84  uint32   categories, separated by '\t'
+ *
+ *  String fields are offsets into the string pool or DSO_BINARY_NO_STRING.
+ */
+bool DSODatabase::loadBinary(const char* data, size_t size, const fs::path& resourcePath)
+{
+    size_t headerLength = strlen(DSO_BINARY_FILE_HEADER);
+    if (size < headerLength + DSO_BINARY_HEADER_SIZE
+        || strncmp(data, DSO_BINARY_FILE_HEADER, headerLength))
+    {
+        return false;
+    }
+
+    const char* ptr = data + headerLength;
+    if (celutil::fromMemoryLE<uint16_t>(ptr) != DSO_BINARY_VERSION)
+        return false;
+
+    uint32_t nObjects = celutil::fromMemoryLE<uint32_t>(ptr + 2);
+    uint32_t poolSize = celutil::fromMemoryLE<uint32_t>(ptr + 6);
+    ptr += DSO_BINARY_HEADER_SIZE;
+
+    // Make sure that the records and the string pool are all there
+    size_t remaining = size - (ptr - data);
+    if (remaining / DSO_BINARY_RECORD_SIZE < nObjects
+        || remaining - nObjects * DSO_BINARY_RECORD_SIZE < poolSize)
+    {
+        GetLogger()->error("Binary deep sky catalog is truncated\n");
+        return false;
+    }
+
+    const char* pool = ptr + nObjects * DSO_BINARY_RECORD_SIZE;
+    if (poolSize > 0 && pool[poolSize - 1] != '\0')
+    {
+        GetLogger()->error("Bad string pool in binary deep sky catalog\n");
+        return false;
+    }
+
+    auto getString = [pool, poolSize](const char* field) -> const char*
+    {
+        uint32_t offset = celutil::fromMemoryLE<uint32_t>(field);
+        return offset < poolSize ? pool + offset : nullptr;
+    };
+
+    string domain = resourcePath.string();
+#ifdef ENABLE_NLS
+    const char *d = domain.c_str();
+    bindtextdomain(d, d); // domain name is the same as resource path
+#endif
+
+    reserve(nDSOs + static_cast<int>(nObjects));
+
+    for (uint32_t i = 0; i < nObjects; ++i, ptr += DSO_BINARY_RECORD_SIZE)
+    {
+        const char* model = getString(ptr + 76);
+        float detail = celutil::fromMemoryLE<float>(ptr + 56);
+
+        DeepSkyObject* obj = nullptr;
+        switch (static_cast<DSOBinaryClass>(ptr[4]))
+        {
+        case DSOBinaryClass::Galaxy:
+            {
+                const char* typeName = getString(ptr + 72);
+                auto* galaxy = new Galaxy();
+                galaxy->setDetail(detail);
+                galaxy->setType(typeName == nullptr ? "" : typeName);
+                galaxy->setForm(model == nullptr ? "" : model);
+                obj = galaxy;
+            }
+            break;
+
+        case DSOBinaryClass::Globular:
             {
-                // List of names will replace any that already exist for
-                // this DSO.
-                namesDB->erase(objCatalogNumber);
-
-                // Iterate through the string for names delimited
-                // by ':', and insert them into the DSO database.
-                // Note that db->add() will skip empty names.
-                string::size_type startPos   = 0;
-                while (startPos != string::npos)
+                auto* globular = new Globular();
+                globular->setDetail(detail);
+                globular->setCoreRadius(celutil::fromMemoryLE<float>(ptr + 60));
+                globular->setConcentration(celutil::fromMemoryLE<float>(ptr + 64));
+                obj = globular;
+            }
+            break;
+
+        case DSOBinaryClass::Nebula:
+            {
+                auto* nebula = new Nebula();
+                if (model != nullptr)
                 {
-                    string::size_type next    = objName.find(':', startPos);
-                    string::size_type length  = string::npos;
-                    if (next != string::npos)
-                    {
-                        length = next - startPos;
-                        ++next;
-                    }
-                    string DSOName = objName.substr(startPos, length);
-                    namesDB->add(objCatalogNumber, DSOName);
-                    startPos   = next;
+                    GeometryInfo info(fs::path(model), resourcePath);
+                    nebula->setGeometry(GetGeometryManager()->getHandle(info));
                 }
+                obj = nebula;
             }
+            break;
+
+        case DSOBinaryClass::OpenCluster:
+            obj = new OpenCluster();
+            break;
+
+        default:
+            GetLogger()->error("Bad object class in binary deep sky catalog\n");
+            return false;
         }
-        else
+
+        obj->setPosition(Vector3d(celutil::fromMemoryLE<double>(ptr + 8),
+                                  celutil::fromMemoryLE<double>(ptr + 16),
+                                  celutil::fromMemoryLE<double>(ptr + 24)));
+        obj->setOrientation(Quaternionf(celutil::fromMemoryLE<float>(ptr + 32),
+                                        celutil::fromMemoryLE<float>(ptr + 36),
+                                        celutil::fromMemoryLE<float>(ptr + 40),
+                                        celutil::fromMemoryLE<float>(ptr + 44)));
+        obj->setRadius(celutil::fromMemoryLE<float>(ptr + 48));
+        obj->setAbsoluteMagnitude(celutil::fromMemoryLE<float>(ptr + 52));
+
+        auto flags = static_cast<uint8_t>(ptr[5]);
+        obj->setVisible((flags & DSO_BINARY_VISIBLE) != 0);
+        obj->setClickable((flags & DSO_BINARY_CLICKABLE) != 0);
+
+        if (const char* infoURL = getString(ptr + 80); infoURL != nullptr)
+            obj->setInfoURL(infoURL, resourcePath);
+
+        if (const char* categories = getString(ptr + 84); categories != nullptr)
         {
-            GetLogger()->warn("Bad Deep Sky Object definition--will continue parsing file.\n");
-            delete objParamsValue;
-            return false;
+            for (const char* c = categories; *c != '\0';)
+            {
+                const char* next = strchr(c, '\t');
+                size_t length = next == nullptr ? strlen(c) : static_cast<size_t>(next - c);
+                if (length > 0)
+                    obj->addToCategory(string(c, length), true, domain);
+                c += next == nullptr ? length : length + 1;
+            }
         }
+
+        AstroCatalog::IndexNumber catalogNumber = celutil::fromMemoryLE<AstroCatalog::IndexNumber>(ptr);
+        if (catalogNumber == AstroCatalog::InvalidIndex)
+            catalogNumber = nextAutoCatalogNumber--;
+
+        DSOs[nDSOs++] = obj;
+        obj->setIndex(catalogNumber);
+
+        if (const char* names = getString(ptr + 68); names != nullptr)
+            addNames(catalogNumber, names);
     }
+
+    GetLogger()->debug("{} deep sky objects in binary catalog\n", nObjects);
+
     return true;
 }
 
 
-bool DSODatabase::loadBinary(istream&)
+void DSODatabase::reserve(int n)
 {
-    // TODO: define a binary dso file format
-    return true;
+    if (n <= capacity)
+        return;
+
+    // Grow the array by at least 5%--this may be too little, but the
+    // assumption here is that there will be small numbers of DSOs in text
+    // files added to a big collection loaded from a binary file.
+    capacity = max(n, (int) (capacity * 1.05));
+
+    // 100 DSOs seems like a reasonable minimum
+    if (capacity < 100)
+        capacity = 100;
+
+    auto newDSOs = celestia::util::makeCatalogArray<DeepSkyObject*>(capacity);
+
+    if (DSOs != nullptr)
+        copy(DSOs.get(), DSOs.get() + nDSOs, newDSOs.get());
+    DSOs = std::move(newDSOs);
+}
+
+
+void DSODatabase::addNames(AstroCatalog::IndexNumber catalogNumber, const string& names)
+{
+    if (namesDB == nullptr || names.empty())
+        return;
+
+    // List of names will replace any that already exist for
+    // this DSO.
+    namesDB->erase(catalogNumber);
+
+    // Iterate through the string for names delimited
+    // by ':', and insert them into the DSO database.
+    // Note that db->add() will skip empty names.
+    string::size_type startPos   = 0;
+    while (startPos != string::npos)
+    {
+        string::size_type next    = names.find(':', startPos);
+        string::size_type length  = string::npos;
+        if (next != string::npos)
+        {
+            length = next - startPos;
+            ++next;
+        }
+        string DSOName = names.substr(startPos, length);
+        namesDB->add(catalogNumber, DSOName);
+        startPos   = next;
+    }
+}
+
+
+// Set the number of threads used to build the octree in finish(); 0 uses
+// one thread per core.
+void DSODatabase::setLoaderThreads(unsigned int nThreads)
+{
+    loaderThreads = nThreads;
+}
+
+
+void DSODatabase::setOctreeSplitPolicy(const OctreeSplitPolicy& policy)
+{
+    octreeSplitPolicy = policy;
 }
 
 
@@ -386,30 +746,46 @@ void DSODatabase::buildOctree()
     // TODO: investigate using a different center--it's possible that more
     // objects end up straddling the base level nodes when the center of the
     // octree is at the origin.
-    DynamicDSOOctree* root   = new DynamicDSOOctree(Vector3d::Zero(), absMag);
-    for (int i = 0; i < nDSOs; ++i)
+    DynamicDSOOctree* root   = new DynamicDSOOctree(Vector3d::Zero(), absMag, octreeSplitPolicy);
+    celestia::util::ThreadPool pool(loaderThreads);
+    if (pool.size() > 1)
     {
-        root->insertObject(DSOs[i], DSO_OCTREE_ROOT_SIZE);
+        std::vector<DeepSkyObject* const*> objects;
+        objects.reserve(nDSOs);
+        for (int i = 0; i < nDSOs; ++i)
+            objects.push_back(&DSOs[i]);
+        root->insertObjects(std::move(objects), DSO_OCTREE_ROOT_SIZE, &pool);
+    }
+    else
+    {
+        for (int i = 0; i < nDSOs; ++i)
+        {
+            root->insertObject(DSOs[i], DSO_OCTREE_ROOT_SIZE);
+        }
     }
 
     GetLogger()->debug("Spatially sorting DSOs for improved locality of reference . . .\n");
-    DeepSkyObject** sortedDSOs    = new DeepSkyObject*[nDSOs];
-    DeepSkyObject** firstDSO      = sortedDSOs;
+    auto sortedDSOs               = celestia::util::makeCatalogArray<DeepSkyObject*>(nDSOs);
+    DeepSkyObject** firstDSO      = sortedDSOs.get();
 
     // The spatial sorting part is useless for DSOs since we
     // are storing pointers to objects and not the objects themselves:
-    root->rebuildAndSort(octreeRoot, firstDSO);
+    DSOOctree* octreeRoot = nullptr;
+    root->rebuildAndSort(octreeRoot, firstDSO, &pool);
 
     GetLogger()->debug("{} DSOs total.\nOctree has {} nodes and {} DSOs.\n",
-                       static_cast<int>(firstDSO - sortedDSOs),
+                       static_cast<int>(firstDSO - sortedDSOs.get()),
                        1 + octreeRoot->countChildren(),
                        octreeRoot->countObjects());
 
+    octree = FlatDSOOctree(*octreeRoot, DSO_OCTREE_ROOT_SIZE);
+
     // Clean up . . .
-    delete[] DSOs;
     delete   root;
+    delete   octreeRoot;
 
-    DSOs = sortedDSOs;
+    DSOs = std::move(sortedDSOs);
+    capacity = nDSOs;
 }
 
 void DSODatabase::calcAvgAbsMag()
@@ -427,7 +803,8 @@ void DSODatabase::calcAvgAbsMag()
             nDSOeff--;
         //cout << nDSOs<<"  "<<DSOmag<<"  "<<nDSOeff<<endl;
     }
-    avgAbsMag /= (double) nDSOeff;
+    if (nDSOeff > 0)
+        avgAbsMag /= (double) nDSOeff;
     //cout<<avgAbsMag<<endl;
 }
 
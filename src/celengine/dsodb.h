@@ -13,12 +13,19 @@
 #ifndef _DSODB_H_
 #define _DSODB_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 #include <celengine/dsoname.h>
 #include <celengine/deepskyobj.h>
 #include <celengine/dsooctree.h>
 #include <celengine/parser.h>
+#include <celutil/catalogalloc.h>
+#include <celutil/memoryusage.h>
 
 
 constexpr inline unsigned int MAX_DSO_NAMES = 10;
@@ -26,6 +33,28 @@ constexpr inline unsigned int MAX_DSO_NAMES = 10;
 // 100 Gly - on the order of the current size of the universe
 constexpr inline float DSO_OCTREE_ROOT_SIZE = 1.0e11f;
 
+// Binary deep sky catalogs (.dsb) start with DSO_BINARY_FILE_HEADER, a
+// 16-bit version, the object count and the size of the string pool. The
+// header is followed by fixed size little-endian object records and a
+// pool of NUL-terminated strings referenced by byte offset from the
+// records. See DSODatabase::loadBinary() for the record layout.
+constexpr inline char          DSO_BINARY_FILE_HEADER[] = "CELDSOS";
+constexpr inline std::uint16_t DSO_BINARY_VERSION       = 0x0100;
+constexpr inline std::size_t   DSO_BINARY_HEADER_SIZE   = 10;
+constexpr inline std::size_t   DSO_BINARY_RECORD_SIZE   = 88;
+constexpr inline std::uint32_t DSO_BINARY_NO_STRING     = 0xffffffff;
+
+enum class DSOBinaryClass : std::uint8_t
+{
+    Galaxy      = 0,
+    Globular    = 1,
+    Nebula      = 2,
+    OpenCluster = 3,
+};
+
+constexpr inline std::uint8_t DSO_BINARY_VISIBLE   = 0x01;
+constexpr inline std::uint8_t DSO_BINARY_CLICKABLE = 0x02;
+
 //NOTE: this one and starDatabase should be derived from a common base class since they share lots of code and functionality.
 class DSODatabase
 {
@@ -50,18 +79,83 @@ class DSODatabase
                          float limitingMag,
                          OctreeProcStats * = nullptr) const;
 
+    // Like findVisibleDSOs, but the visitor is called once per octree
+    // node with the objects of the node, see FlatOctree::visitVisibleNodes.
+    template <class VISITOR>
+    void findVisibleDSOBatches(VISITOR&& visitor,
+                               const Eigen::Vector3d& obsPosition,
+                               const Eigen::Quaternionf& obsOrientation,
+                               float fovY,
+                               float aspectRatio,
+                               float limitingMag,
+                               OctreeProcStats *stats = nullptr) const
+    {
+        Eigen::Hyperplane<double, 3> frustumPlanes[5];
+        computeFrustumPlanes(frustumPlanes, obsPosition, obsOrientation, fovY, aspectRatio);
+        octree.visitVisibleNodes(std::forward<VISITOR>(visitor),
+                                 obsPosition,
+                                 frustumPlanes,
+                                 limitingMag,
+                                 stats);
+    }
+
+    // Collect the visible octree nodes for a traversal shared by views from
+    // obsPosition, see StarDatabase::findVisibleStarNodes().
+    void findVisibleDSONodes(std::vector<FlatDSOOctree::VisibleNode>& nodes,
+                             const Eigen::Vector3d& obsPosition,
+                             const Eigen::Quaternionf& obsOrientation,
+                             float fovY,
+                             float aspectRatio,
+                             float limitingMag) const;
+
+    // Like findVisibleDSOBatches, for the nodes of a shared traversal
+    template <class VISITOR>
+    void findVisibleDSOBatches(VISITOR&& visitor,
+                               const std::vector<FlatDSOOctree::VisibleNode>& nodes,
+                               const Eigen::Vector3d& obsPosition,
+                               const Eigen::Quaternionf& obsOrientation,
+                               float fovY,
+                               float aspectRatio) const
+    {
+        Eigen::Hyperplane<double, 3> frustumPlanes[5];
+        computeFrustumPlanes(frustumPlanes, obsPosition, obsOrientation, fovY, aspectRatio);
+        octree.visitNodesInFrustum(std::forward<VISITOR>(visitor), nodes, frustumPlanes);
+    }
+
+    // Find the objects that may lie within angle radians of the ray from
+    // obsPosition along the unit vector direction, for picking
+    void findDSOsInCone(DSOHandler& dsoHandler,
+                        const Eigen::Vector3d& obsPosition,
+                        const Eigen::Vector3d& direction,
+                        double angle,
+                        float limitingMag) const;
+
     void findCloseDSOs(DSOHandler& dsoHandler,
                        const Eigen::Vector3d& obsPosition,
                        float radius) const;
 
     std::string getDSOName    (const DeepSkyObject* const &, bool i18n = false) const;
+    std::string_view getDSONameView(const DeepSkyObject* dso, bool i18n = false) const;
     std::string getDSONameList(const DeepSkyObject* const &, const unsigned int maxNames = MAX_DSO_NAMES) const;
 
     DSONameDatabase* getNameDatabase() const;
     void setNameDatabase(DSONameDatabase*);
 
+    // Add a node of the objects, their indexes and names to parent
+    void accountMemory(celestia::util::MemoryUsage& parent) const;
+
     bool load(std::istream&, const fs::path& resourcePath = fs::path());
-    bool loadBinary(std::istream&);
+    bool load(PreparsedCatalog&, const fs::path& resourcePath = fs::path());
+    bool loadBinary(std::istream&, const fs::path& resourcePath = fs::path());
+    bool loadBinary(const fs::path&, const fs::path& resourcePath = fs::path());
+    // Apply the definitions of a deep sky catalog edited after finish().
+    // Objects of the same type and name are changed in place as long as
+    // they stay in their octree node; returns the number of definitions
+    // that couldn't be applied, new objects and ones that moved out of
+    // their node, which need the database to be built again.
+    std::size_t update(std::istream&, const fs::path& resourcePath = fs::path());
+    void setLoaderThreads(unsigned int);
+    void setOctreeSplitPolicy(const OctreeSplitPolicy&);
     void finish();
 
     static DSODatabase* read(std::istream&);
@@ -69,25 +163,41 @@ class DSODatabase
     double getAverageAbsoluteMagnitude() const;
 
 private:
+    static void computeFrustumPlanes(Eigen::Hyperplane<double, 3>* frustumPlanes,
+                                     const Eigen::Vector3d& obsPosition,
+                                     const Eigen::Quaternionf& obsOrientation,
+                                     float fovY,
+                                     float aspectRatio);
+
+    bool load(Tokenizer&, Parser&, const fs::path& resourcePath);
+    bool updateObject(DeepSkyObject* obj, const std::string& names,
+                      Hash* params, const fs::path& resourcePath);
+    bool loadBinary(const char* data, std::size_t size, const fs::path& resourcePath);
+    void reserve(int);
+    void addNames(AstroCatalog::IndexNumber, const std::string&);
     void buildIndexes();
     void buildOctree();
     void calcAvgAbsMag();
 
     int              nDSOs{ 0 };
     int              capacity{ 0 };
-    DeepSkyObject**  DSOs{ nullptr };
+    celestia::util::CatalogArray<DeepSkyObject*> DSOs;
     DSONameDatabase* namesDB{ nullptr };
     DeepSkyObject**  catalogNumberIndex{ nullptr };
-    DSOOctree*       octreeRoot{ nullptr };
+    FlatDSOOctree    octree;
     AstroCatalog::IndexNumber nextAutoCatalogNumber{ 0xfffffffe };
 
     double           avgAbsMag{ 0.0 };
+    unsigned int     loaderThreads{ 1 };
+    OctreeSplitPolicy octreeSplitPolicy{ DynamicDSOOctree::defaultSplitPolicy };
+    // Count of the definitions rejected by update(), null outside of it
+    std::size_t*     rejectedUpdates{ nullptr };
 };
 
 
 DeepSkyObject* DSODatabase::getDSO(const uint32_t n) const
 {
-    return *(DSOs + n);
+    return DSOs[n];
 }
 
 
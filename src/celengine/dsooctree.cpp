@@ -36,9 +36,9 @@ bool dsoStraddlesNodesPredicate(const Vector3d& cellCenterPos, DeepSkyObject* co
 }
 
 
-double dsoAbsoluteMagnitudeDecayFunction(const double excludingFactor)
+float dsoAbsoluteMagnitude(DeepSkyObject* const & _dso)
 {
-    return excludingFactor + 0.5f;
+    return _dso->getAbsoluteMagnitude();
 }
 
 
@@ -56,13 +56,13 @@ DynamicDSOOctree* DynamicDSOOctree::getChild(DeepSkyObject* const & _obj, const
 }
 
 
-template<> unsigned int DynamicDSOOctree::SPLIT_THRESHOLD = 10;
+template<> const OctreeSplitPolicy DynamicDSOOctree::defaultSplitPolicy{ 10, 0.5f };
 template<> DynamicDSOOctree::LimitingFactorPredicate*
            DynamicDSOOctree::limitingFactorPredicate = dsoAbsoluteMagnitudePredicate;
 template<> DynamicDSOOctree::StraddlingPredicate*
            DynamicDSOOctree::straddlingPredicate = dsoStraddlesNodesPredicate;
-template<> DynamicDSOOctree::ExclusionFactorDecayFunction*
-           DynamicDSOOctree::decayFunction = dsoAbsoluteMagnitudeDecayFunction;
+template<> DynamicDSOOctree::ObjectMagnitudeFunction*
+           DynamicDSOOctree::magnitudeFunction = dsoAbsoluteMagnitude;
 
 
 // total specialization of the StaticOctree template process*() methods for DSOs:
@@ -110,14 +110,17 @@ void DSOOctree::processVisibleObjects(DSOHandler&    processor,
 #endif
         DeepSkyObject* _obj = _firstObject[i];
         float  absMag      = _obj->getAbsoluteMagnitude();
-        if (absMag < dimmest)
-        {
-            double distance    = (obsPosition - _obj->getPosition()).norm() - _obj->getBoundingSphereRadius();
-            float appMag = (float) ((distance >= 32.6167) ? astro::absToAppMag((double) absMag, distance) : absMag);
 
-            if ( appMag < limitingFactor)
-                processor.process(_obj, distance, absMag);
-        }
+        // The DSOs of a node are sorted by absolute magnitude, so the rest
+        // are all too faint
+        if (absMag >= dimmest)
+            break;
+
+        double distance    = (obsPosition - _obj->getPosition()).norm() - _obj->getBoundingSphereRadius();
+        float appMag = (float) ((distance >= 32.6167) ? astro::absToAppMag((double) absMag, distance) : absMag);
+
+        if ( appMag < limitingFactor)
+            processor.process(_obj, distance, absMag);
     }
 
     // See if any of the objects in child nodes are potentially included
@@ -195,3 +198,56 @@ void DSOOctree::processCloseObjects(DSOHandler&    processor,
         }
     }
 }
+
+
+// specialization of the FlatOctree per-node object processing for DSOs;
+// this mirrors the object loops of the StaticOctree methods above.
+template<>
+void FlatDSOOctree::processNodeObjects(DSOHandler&                 processor,
+                                       const PointType&            obsPosition,
+                                       float                       limitingFactor,
+                                       DeepSkyObject* const*       objects,
+                                       std::uint32_t               nObjects,
+                                       double                      dimmest) const
+{
+    for (std::uint32_t i = 0; i < nObjects; ++i)
+    {
+        DeepSkyObject* _obj = objects[i];
+        float  absMag      = _obj->getAbsoluteMagnitude();
+        if (absMag >= dimmest)
+            break;
+
+        double distance    = (obsPosition - _obj->getPosition()).norm() - _obj->getBoundingSphereRadius();
+        float appMag = (float) ((distance >= 32.6167) ? astro::absToAppMag((double) absMag, distance) : absMag);
+
+        if ( appMag < limitingFactor)
+            processor.process(_obj, distance, absMag);
+    }
+}
+
+
+template<>
+void FlatDSOOctree::processCloseNodeObjects(DSOHandler&      processor,
+                                            const PointType& obsPosition,
+                                            double           boundingRadius,
+                                            std::uint32_t    node) const
+{
+    // Compute distance squared to avoid having to sqrt for distance
+    // comparison.
+    double radiusSquared    = boundingRadius * boundingRadius;
+
+    DeepSkyObject** firstObject = m_firstObject[node];
+    std::uint32_t nObjects = m_objectCount[node];
+    for (std::uint32_t i = 0; i < nObjects; ++i)
+    {
+        DeepSkyObject* _obj = firstObject[i];
+
+        if ((obsPosition - _obj->getPosition()).squaredNorm() < radiusSquared)
+        {
+            float  absMag      = _obj->getAbsoluteMagnitude();
+            double distance    = (obsPosition - _obj->getPosition()).norm() - _obj->getBoundingSphereRadius();
+
+            processor.process(_obj, distance, absMag);
+        }
+    }
+}
@@ -15,10 +15,12 @@
 
 #include <celengine/deepskyobj.h>
 #include <celengine/octree.h>
+#include <celengine/flatoctree.h>
 
 
 typedef DynamicOctree  <DeepSkyObject*, double> DynamicDSOOctree;
 typedef StaticOctree   <DeepSkyObject*, double> DSOOctree;
 typedef OctreeProcessor<DeepSkyObject*, double> DSOHandler;
+typedef FlatOctree     <DeepSkyObject*, double> FlatDSOOctree;
 
 #endif  // _CELENGINE_DSOOCTREE_H_
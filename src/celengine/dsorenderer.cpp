@@ -12,6 +12,7 @@
 #include <celengine/deepskyobj.h>
 #include <celmath/geomutil.h>
 #include "glsupport.h"
+#include "impostorcache.h"
 #include "render.h"
 #include "vecgl.h"
 #include "dsorenderer.h"
@@ -36,9 +37,45 @@ DSORenderer::DSORenderer() :
 void DSORenderer::process(DeepSkyObject* const &dso,
                           double distanceToDSO,
                           float absMag)
+{
+    Candidate candidate;
+    if (makeCandidate(dso, distanceToDSO, absMag, candidate))
+        render(candidate);
+}
+
+void DSORenderer::addCandidates(DeepSkyObject* const* objects,
+                                std::uint32_t nObjects,
+                                double dimmest,
+                                float limitingMag,
+                                celestia::util::ArenaVector<Candidate>& candidates) const
+{
+    // Same test as FlatDSOOctree::processNodeObjects(); the objects of a
+    // node are sorted by absolute magnitude, so the rest are too faint
+    for (std::uint32_t i = 0; i < nObjects; ++i)
+    {
+        DeepSkyObject* dso = objects[i];
+        float absMag = dso->getAbsoluteMagnitude();
+        if (absMag >= dimmest)
+            break;
+
+        double distanceToDSO = (obsPos - dso->getPosition()).norm() - dso->getBoundingSphereRadius();
+        float appMag = (float) ((distanceToDSO >= pc10) ? astro::absToAppMag((double) absMag, distanceToDSO) : absMag);
+        if (appMag >= limitingMag)
+            continue;
+
+        Candidate candidate;
+        if (makeCandidate(dso, distanceToDSO, absMag, candidate))
+            candidates.push_back(candidate);
+    }
+}
+
+bool DSORenderer::makeCandidate(DeepSkyObject* dso,
+                                double distanceToDSO,
+                                float absMag,
+                                Candidate& candidate) const
 {
     if (distanceToDSO > distanceLimit || !dso->isVisible())
-        return;
+        return false;
 
     Vector3f relPos = (dso->getPosition() - obsPos).cast<float>();
     Vector3f center = orientationMatrix.transpose() * relPos;
@@ -49,7 +86,12 @@ void DSORenderer::process(DeepSkyObject* const &dso,
     // pipeline.
     double dsoRadius = dso->getBoundingSphereRadius();
     if (frustum.testSphere(center, (float) dsoRadius) == Frustum::Outside)
-        return;
+        return false;
+
+    candidate.renderMask = dso->getRenderMask();
+    candidate.rendered = (renderFlags & candidate.renderMask) != 0;
+    if (!candidate.rendered && (dso->getLabelMask() & labelMode) == 0)
+        return false;
 
     float appMag;
     if (distanceToDSO >= pc10)
@@ -57,64 +99,96 @@ void DSORenderer::process(DeepSkyObject* const &dso,
     else
         appMag = absMag + (float) (enhance * tanh(distanceToDSO/pc10 - 1.0));
 
-    if ((renderFlags & dso->getRenderMask()) != 0)
-    {
-        dsosProcessed++;
+    // Input: display looks satisfactory for 0.2 < brightness < O(1.0)
+    // Ansatz: brightness = a - b * appMag(distanceToDSO), emulating eye sensitivity...
+    // determine a,b such that
+    // a - b * absMag = absMag / avgAbsMag ~ 1; a - b * faintestMag = 0.2.
+    // The 2nd eq. guarantees that the faintest galaxies are still visible.
+
+    double typeAvgAbsMag = avgAbsMag;
+    if (!strcmp(dso->getObjTypeName(), "globular"))
+        typeAvgAbsMag = -6.86; // average over 150 globulars in globulars.dsc.
+    else if (!strcmp(dso->getObjTypeName(), "galaxy"))
+        typeAvgAbsMag = -19.04; // average over 10937 galaxies in galaxies.dsc.
 
-        // Input: display looks satisfactory for 0.2 < brightness < O(1.0)
-        // Ansatz: brightness = a - b * appMag(distanceToDSO), emulating eye sensitivity...
-        // determine a,b such that
-        // a - b * absMag = absMag / avgAbsMag ~ 1; a - b * faintestMag = 0.2.
-        // The 2nd eq. guarantees that the faintest galaxies are still visible.
+    float r = absMag / (float)typeAvgAbsMag;
+    float brightness = r - (r - 0.2f) * (absMag - appMag) / (absMag - faintestMag);
 
-        if (!strcmp(dso->getObjTypeName(), "globular"))
-            avgAbsMag = -6.86; // average over 150 globulars in globulars.dsc.
-        else if (!strcmp(dso->getObjTypeName(), "galaxy"))
-            avgAbsMag = -19.04; // average over 10937 galaxies in galaxies.dsc.
+    // obviously, brightness(appMag = absMag) = r and
+    // brightness(appMag = faintestMag) = 0.2, as desired.
 
-        float r = absMag / (float)avgAbsMag;
-        float brightness = r - (r - 0.2f) * (absMag - appMag) / (absMag - faintestMag);
+    brightness *= 2.3f * (faintestMag - 4.75f) / renderer->getFaintestAM45deg();
 
-        // obviously, brightness(appMag = absMag) = r and
-        // brightness(appMag = faintestMag) = 0.2, as desired.
+    if (brightness < 0)
+        brightness = 0;
 
-        brightness *= 2.3f * (faintestMag - 4.75f) / renderer->getFaintestAM45deg();
+    candidate.dso = dso;
+    candidate.relPos = relPos;
+    candidate.distanceToDSO = distanceToDSO;
+    candidate.appMag = appMag;
+    candidate.brightness = brightness;
+    return true;
+}
 
-        if (brightness < 0)
-            brightness = 0;
+void DSORenderer::render(const Candidate& candidate)
+{
+    DeepSkyObject* dso = candidate.dso;
+    const Vector3f& relPos = candidate.relPos;
+    double distanceToDSO = candidate.distanceToDSO;
+    float brightness = candidate.brightness;
 
-        Matrix4f mv = vecgl::translate(renderer->getModelViewMatrix(), relPos);
-        Matrix4f pr;
+    if (candidate.rendered)
+    {
+        dsosProcessed++;
 
-        if (dsoRadius < 1000.0)
+        // Objects which are small on the screen may be drawn from a cached
+        // billboard instead
+        if (impostorCache == nullptr ||
+            !impostorCache->render(dso, relPos, observer->getOrientationf(),
+                                   brightness, pixelSize, renderer))
         {
-            // Small objects may be prone to clipping; give them special
-            // handling.  We don't want to always set the projection
-            // matrix, since that could be expensive with large galaxy
-            // catalogs.
-            auto nearZ = (float)(distanceToDSO / 2);
-            auto farZ = (float)(distanceToDSO + dsoRadius * 2 * CubeCornerToCenterDistance);
-            if (nearZ < dsoRadius * 0.001)
+            Matrix4f mv = vecgl::translate(renderer->getModelViewMatrix(), relPos);
+            Matrix4f pr;
+
+            double dsoRadius = dso->getBoundingSphereRadius();
+            if (dsoRadius < 1000.0)
             {
-                nearZ = (float)(dsoRadius * 0.001);
-                farZ = nearZ * 10000.0f;
-            }
+                // Small objects may be prone to clipping; give them special
+                // handling.  We don't want to always set the projection
+                // matrix, since that could be expensive with large galaxy
+                // catalogs.
+                auto nearZ = (float)(distanceToDSO / 2);
+                auto farZ = (float)(distanceToDSO + dsoRadius * 2 * CubeCornerToCenterDistance);
+                if (nearZ < dsoRadius * 0.001)
+                {
+                    nearZ = (float)(dsoRadius * 0.001);
+                    farZ = nearZ * 10000.0f;
+                }
 
-            float t = (float)wWidth / (float)wHeight;
-            if (renderer->getProjectionMode() == Renderer::ProjectionMode::FisheyeMode)
-                pr = Ortho(-t, t, -1.0f, 1.0f, nearZ, farZ);
+                float t = (float)wWidth / (float)wHeight;
+                if (renderer->getProjectionMode() == Renderer::ProjectionMode::FisheyeMode)
+                    pr = Ortho(-t, t, -1.0f, 1.0f, nearZ, farZ);
+                else
+                    pr = Perspective(fov, t, nearZ, farZ);
+            }
             else
-                pr = Perspective(fov, t, nearZ, farZ);
-        }
-        else
-        {
-            pr = renderer->getProjectionMatrix();
+            {
+                pr = renderer->getProjectionMatrix();
+            }
+
+            dso->render(relPos, observer->getOrientationf(), brightness,
+                        pixelSize, { &pr, &mv }, renderer);
         }
+    }
 
-        dso->render(relPos, observer->getOrientationf(), brightness,
-                    pixelSize, { &pr, &mv }, renderer);
+    addLabel(candidate);
+}
 
-    } // renderFlags check
+void DSORenderer::addLabel(const Candidate& candidate)
+{
+    DeepSkyObject* dso = candidate.dso;
+    double distanceToDSO = candidate.distanceToDSO;
+    float appMag = candidate.appMag;
 
     // Only render those labels that are in front of the camera:
     // Place labels for DSOs brighter than the specified label threshold brightness
@@ -174,12 +248,13 @@ void DSORenderer::process(DeepSkyObject* const &dso,
             labelColor.alpha(distr * labelColor.alpha());
 
             renderer->addBackgroundAnnotation(rep,
-                                              dsoDB->getDSOName(dso, true),
+                                              dsoDB->getDSONameView(dso, true),
                                               labelColor,
-                                              relPos,
+                                              candidate.relPos,
                                               Renderer::AlignLeft,
                                               Renderer::VerticalAlignCenter,
-                                              symbolSize);
+                                              symbolSize,
+                                              Renderer::getLabelPriority(appMagEff, renderer->getHighlightObject().deepsky() == dso));
         }
     }     // labels enabled
 }
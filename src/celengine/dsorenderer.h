@@ -10,24 +10,59 @@
 
 #pragma once
 
+#include <cstdint>
+#include <vector>
 #include <Eigen/Core>
 #include <celmath/frustum.h>
+#include <celutil/framearena.h>
 #include "objectrenderer.h"
 
 class DeepSkyObject;
+class ImpostorCache;
 
 class DSORenderer : public ObjectRenderer<DeepSkyObject*, double>
 {
  public:
+    // An object which passed the visibility tests, with the values needed
+    // to draw and label it
+    struct Candidate
+    {
+        DeepSkyObject*  dso;
+        Eigen::Vector3f relPos;
+        double          distanceToDSO;
+        float           appMag;
+        float           brightness;
+        std::uint64_t   renderMask;
+        bool            rendered;
+    };
+
     DSORenderer();
 
     void process(DeepSkyObject* const &, double, float);
 
+    // Test the objects of an octree node, as passed by
+    // DSODatabase::findVisibleDSOBatches, and append those which are drawn
+    // or labeled to candidates. This only reads the state of the renderer,
+    // so it may be called from several threads at once.
+    void addCandidates(DeepSkyObject* const* objects,
+                       std::uint32_t nObjects,
+                       double dimmest,
+                       float limitingMag,
+                       celestia::util::ArenaVector<Candidate>& candidates) const;
+
+    // Draw and label an object; only on the render thread
+    void render(const Candidate&);
+
+ private:
+    bool makeCandidate(DeepSkyObject*, double, float, Candidate&) const;
+    void addLabel(const Candidate&);
+
  public:
     Eigen::Vector3d     obsPos;
     Eigen::Matrix3f     orientationMatrix;
     celmath::Frustum    frustum         { 45.0_deg, 1.0f, 1.0f };
     DSODatabase*        dsoDB           { nullptr };
+    ImpostorCache*      impostorCache   { nullptr };
 
     int                 wWidth          { 0 };
     int                 wHeight         { 0 };
@@ -0,0 +1,205 @@
+// ephemeriscache.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Shared orbits, rotation models and reference frames of solar system
+// objects.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "ephemeriscache.h"
+
+#include <cstring>
+#include <type_traits>
+#include <celephem/orbit.h>
+#include <celephem/rotation.h>
+#include "selection.h"
+
+namespace
+{
+
+std::uint64_t
+keyBits(double x)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    return bits;
+}
+
+// Floats are converted exactly
+std::uint64_t
+keyBits(float x)
+{
+    return keyBits(static_cast<double>(x));
+}
+
+} // end unnamed namespace
+
+
+EphemerisCache::~EphemerisCache() = default;
+
+
+template<typename... ARGS>
+EphemerisCache::Key
+EphemerisCache::makeKey(Kind kind, ARGS... args)
+{
+    static_assert(sizeof...(ARGS) < std::tuple_size_v<Key>);
+    Key key{ static_cast<std::uint64_t>(kind) };
+    std::size_t i = 1;
+    ((key[i++] = keyBits(args)), ...);
+    return key;
+}
+
+
+Orbit*
+EphemerisCache::fixedOrbit(const Eigen::Vector3d& position)
+{
+    Key key = makeKey(Kind::FixedOrbit, position.x(), position.y(), position.z());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    requests++;
+    auto& orbit = orbits[key];
+    if (orbit == nullptr)
+    {
+        orbit = std::make_unique<FixedOrbit>(position);
+        created++;
+    }
+    return orbit.get();
+}
+
+
+Orbit*
+EphemerisCache::ellipticalOrbit(double pericenterDistance,
+                                double eccentricity,
+                                double inclination,
+                                double ascendingNode,
+                                double argOfPericenter,
+                                double meanAnomalyAtEpoch,
+                                double period,
+                                double epoch)
+{
+    Key key = makeKey(Kind::EllipticalOrbit,
+                      pericenterDistance, eccentricity, inclination, ascendingNode,
+                      argOfPericenter, meanAnomalyAtEpoch, period, epoch);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    requests++;
+    auto& orbit = orbits[key];
+    if (orbit == nullptr)
+    {
+        orbit = std::make_unique<EllipticalOrbit>(pericenterDistance, eccentricity, inclination, ascendingNode,
+                                                  argOfPericenter, meanAnomalyAtEpoch, period, epoch);
+        created++;
+    }
+    return orbit.get();
+}
+
+
+RotationModel*
+EphemerisCache::constantOrientation(const Eigen::Quaterniond& orientation)
+{
+    Key key = makeKey(Kind::ConstantOrientation,
+                      orientation.w(), orientation.x(), orientation.y(), orientation.z());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    requests++;
+    auto& rotationModel = rotationModels[key];
+    if (rotationModel == nullptr)
+    {
+        rotationModel = std::make_unique<ConstantOrientation>(orientation);
+        created++;
+    }
+    return rotationModel.get();
+}
+
+
+RotationModel*
+EphemerisCache::uniformRotation(double period,
+                                float offset,
+                                double epoch,
+                                float inclination,
+                                float ascendingNode)
+{
+    Key key = makeKey(Kind::UniformRotation, period, offset, epoch, inclination, ascendingNode);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    requests++;
+    auto& rotationModel = rotationModels[key];
+    if (rotationModel == nullptr)
+    {
+        rotationModel = std::make_unique<UniformRotationModel>(period, offset, epoch, inclination, ascendingNode);
+        created++;
+    }
+    return rotationModel.get();
+}
+
+
+template<typename CREATE>
+ReferenceFrame::SharedConstPtr
+EphemerisCache::findFrame(const Key& key, CREATE&& create)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    requests++;
+    auto& entry = frames[key];
+    ReferenceFrame::SharedConstPtr frame = entry.lock();
+    if (frame == nullptr)
+    {
+        frame = create();
+        entry = frame;
+        created++;
+    }
+    return frame;
+}
+
+
+// The frames are identified by the addresses of the objects they refer to,
+// as Selection compares them
+ReferenceFrame::SharedConstPtr
+EphemerisCache::bodyFixedFrame(const Selection& center, const Selection& obj)
+{
+    Key key{ static_cast<std::uint64_t>(Kind::BodyFixedFrame),
+             static_cast<std::uint64_t>(center.getType()),
+             reinterpret_cast<std::uintptr_t>(center.object()),
+             static_cast<std::uint64_t>(obj.getType()),
+             reinterpret_cast<std::uintptr_t>(obj.object()) };
+    return findFrame(key, [&center, &obj] { return std::make_shared<const BodyFixedFrame>(center, obj); });
+}
+
+
+ReferenceFrame::SharedConstPtr
+EphemerisCache::j2000EclipticFrame(const Selection& center)
+{
+    Key key{ static_cast<std::uint64_t>(Kind::J2000EclipticFrame),
+             static_cast<std::uint64_t>(center.getType()),
+             reinterpret_cast<std::uintptr_t>(center.object()) };
+    return findFrame(key, [&center] { return std::make_shared<const J2000EclipticFrame>(center); });
+}
+
+
+ReferenceFrame::SharedConstPtr
+EphemerisCache::j2000EquatorFrame(const Selection& center)
+{
+    Key key{ static_cast<std::uint64_t>(Kind::J2000EquatorFrame),
+             static_cast<std::uint64_t>(center.getType()),
+             reinterpret_cast<std::uintptr_t>(center.object()) };
+    return findFrame(key, [&center] { return std::make_shared<const J2000EquatorFrame>(center); });
+}
+
+
+std::size_t
+EphemerisCache::requestCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return requests;
+}
+
+
+std::size_t
+EphemerisCache::createdCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return created;
+}
@@ -0,0 +1,101 @@
+// ephemeriscache.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Shared orbits, rotation models and reference frames of solar system
+// objects.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <celengine/frame.h>
+
+class Orbit;
+class RotationModel;
+class Selection;
+
+// EphemerisCache hands out a single instance of the immutable orbits,
+// rotation models and reference frames that many bodies of the solar
+// system catalogs define with the same parameters: the fixed positions
+// and orientations of surface objects, synchronous rotations, and frames
+// centered on the same object. Each method returns the object created
+// earlier with bitwise identical parameters, or creates it.
+//
+// Timeline phases don't own their orbits and rotation models, so the
+// cache keeps them until it's destroyed, like the trajectory manager
+// keeps sampled trajectories. Frames are shared through their
+// SharedConstPtr and are only remembered while they're in use.
+class EphemerisCache
+{
+ public:
+    EphemerisCache() = default;
+    ~EphemerisCache();
+    EphemerisCache(const EphemerisCache&) = delete;
+    EphemerisCache& operator=(const EphemerisCache&) = delete;
+
+    Orbit* fixedOrbit(const Eigen::Vector3d& position);
+    Orbit* ellipticalOrbit(double pericenterDistance,
+                           double eccentricity,
+                           double inclination,
+                           double ascendingNode,
+                           double argOfPericenter,
+                           double meanAnomalyAtEpoch,
+                           double period,
+                           double epoch);
+
+    RotationModel* constantOrientation(const Eigen::Quaterniond& orientation);
+    RotationModel* uniformRotation(double period,
+                                   float offset,
+                                   double epoch,
+                                   float inclination,
+                                   float ascendingNode);
+
+    ReferenceFrame::SharedConstPtr bodyFixedFrame(const Selection& center, const Selection& obj);
+    ReferenceFrame::SharedConstPtr j2000EclipticFrame(const Selection& center);
+    ReferenceFrame::SharedConstPtr j2000EquatorFrame(const Selection& center);
+
+    // Number of objects requested from the cache, and of distinct objects
+    // it created for them
+    std::size_t requestCount() const;
+    std::size_t createdCount() const;
+
+ private:
+    enum class Kind : std::uint64_t
+    {
+        FixedOrbit,
+        EllipticalOrbit,
+        ConstantOrientation,
+        UniformRotation,
+        BodyFixedFrame,
+        J2000EclipticFrame,
+        J2000EquatorFrame,
+    };
+
+    // The kind of an object followed by the bits of its parameters
+    using Key = std::array<std::uint64_t, 9>;
+
+    template<typename... ARGS>
+    static Key makeKey(Kind kind, ARGS... args);
+
+    template<typename CREATE>
+    ReferenceFrame::SharedConstPtr findFrame(const Key& key, CREATE&& create);
+
+    std::map<Key, std::unique_ptr<Orbit>> orbits;
+    std::map<Key, std::unique_ptr<RotationModel>> rotationModels;
+    std::map<Key, std::weak_ptr<const ReferenceFrame>> frames;
+    std::size_t requests{ 0 };
+    std::size_t created{ 0 };
+    mutable std::mutex mutex;
+};
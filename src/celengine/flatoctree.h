@@ -0,0 +1,1019 @@
+// flatoctree.h
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// Cache-friendly, array-based form of a StaticOctree.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <queue>
+#include <vector>
+#include <celengine/astro.h>
+#include <celengine/octree.h>
+#include <celutil/catalogalloc.h>
+
+// A FlatOctree holds the same nodes as a StaticOctree, but instead of
+// separately allocated nodes linked by pointers, the nodes are stored in
+// breadth-first order in contiguous arrays, one array per node property.
+// The eight children of a node are always adjacent, so the frustum test for
+// all of them is a single loop over a few small arrays, which the compiler
+// can vectorize, and a traversal walks memory mostly linearly.
+template <class OBJ, class PREC> class FlatOctree
+{
+ public:
+    typedef Eigen::Matrix<PREC, 3, 1> PointType;
+
+    // The properties of one node, see node()
+    struct Node
+    {
+        PointType     center;
+        PREC          scale;
+        float         exclusionFactor;
+        std::uint32_t firstChild;
+        OBJ*          firstObject;
+        std::uint32_t objectCount;
+    };
+
+    FlatOctree() = default;
+    FlatOctree(const StaticOctree<OBJ, PREC>& root, PREC rootScale);
+    // Nodes must be in breadth-first order with the children of a node
+    // adjacent, as returned by node(). The objects may be null when the
+    // octree is only traversed with visitVisibleNodeIndices().
+    explicit FlatOctree(const std::vector<Node>& nodes);
+
+    // Same contract as StaticOctree::processVisibleObjects(); objects are
+    // passed to the processor in the same order.
+    void processVisibleObjects(OctreeProcessor<OBJ, PREC>&       processor,
+                               const PointType&                  obsPosition,
+                               const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                               float                             limitingFactor,
+                               OctreeProcStats*                  stats = nullptr) const;
+
+    // Batch form of processVisibleObjects(): instead of calling a virtual
+    // method for every candidate object, the visitor is called once for
+    // each node that passes the frustum test, as
+    //     visitor(const OBJ* objects, std::uint32_t count, PREC dimmest)
+    // with the contiguous objects stored in that node. Objects with an
+    // absolute magnitude of dimmest or more can't be brighter than
+    // limitingFactor and may be skipped; the exact test is left to the
+    // visitor. Nodes are visited in the same order as the objects passed
+    // to processVisibleObjects().
+    template <class VISITOR>
+    void visitVisibleNodes(VISITOR&&                         visitor,
+                           const PointType&                  obsPosition,
+                           const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                           float                             limitingFactor,
+                           OctreeProcStats*                  stats = nullptr) const;
+
+    // Like visitVisibleNodes(), but the visitor is called as
+    //     visitor(std::uint32_t node, std::uint32_t count, PREC dimmest)
+    // for the nodes with objects, so that the objects can be stored
+    // elsewhere.
+    template <class VISITOR>
+    void visitVisibleNodeIndices(VISITOR&&                         visitor,
+                                 const PointType&                  obsPosition,
+                                 const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                                 float                             limitingFactor,
+                                 OctreeProcStats*                  stats = nullptr) const;
+
+    // A node passed to the visitor of visitVisibleNodeIndices(), see
+    // visitNodesInFrustum()
+    struct VisibleNode
+    {
+        std::uint32_t node;
+        PREC          dimmest;
+    };
+
+    // Visit the nodes of a list collected from visitVisibleNodeIndices()
+    // with a frustum containing this one, from the same position and with
+    // a limiting factor no lower than the caller's. Nodes outside of this
+    // frustum are skipped, and the visitor is called like that of
+    // visitVisibleNodes() for every node it would visit that intersects
+    // the frustum, so several views from one position can share a
+    // traversal. As the plane tests are conservative, visitVisibleNodes()
+    // may also visit a few nodes lying entirely outside of the frustum.
+    template <class VISITOR>
+    void visitNodesInFrustum(VISITOR&&                         visitor,
+                             const std::vector<VisibleNode>&   nodes,
+                             const Eigen::Hyperplane<PREC, 3>* frustumPlanes) const;
+
+    // Visible nodes of a previous traversal. A traversal that is given a
+    // cache also records which nodes are certain to stay visible, and
+    // which are close to the edge of the frustum or of the magnitude
+    // limit, while the observer position moves less than
+    // positionTolerance and no frustum plane normal changes by more than
+    // normalTolerance. As long as the view stays within these limits and
+    // the limiting factor is unchanged, following traversals only retest
+    // the nodes near an edge. The visited nodes are exactly the same as
+    // without a cache, but not necessarily in the same order.
+    class VisibleNodeCache
+    {
+     public:
+        VisibleNodeCache(PREC _positionTolerance, PREC _normalTolerance) :
+            positionTolerance(_positionTolerance),
+            normalTolerance(_normalTolerance)
+        {}
+
+        void clear() { octree = nullptr; }
+
+     private:
+        friend class FlatOctree;
+
+        PREC positionTolerance;
+        PREC normalTolerance;
+
+        const FlatOctree* octree{ nullptr };
+        PointType obsPosition;
+        PointType planeNormals[5];
+        float limitingFactor{ 0.0f };
+
+        // Nodes visited for any view within the tolerances, in traversal
+        // order
+        std::vector<std::uint32_t> stableNodes;
+        // Nodes that have to be tested again, together with all of
+        // their descendants
+        std::vector<std::uint32_t> edgeNodes;
+        // Stable nodes for which it has to be tested again whether their
+        // children are visited
+        std::vector<std::uint32_t> edgeParents;
+    };
+
+    template <class VISITOR>
+    void visitVisibleNodes(VISITOR&&                         visitor,
+                           const PointType&                  obsPosition,
+                           const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                           float                             limitingFactor,
+                           VisibleNodeCache&                 cache,
+                           OctreeProcStats*                  stats = nullptr) const;
+
+    void processCloseObjects(OctreeProcessor<OBJ, PREC>& processor,
+                             const PointType&            obsPosition,
+                             PREC                        boundingRadius) const;
+
+    // Same contract as processVisibleObjects(), for the objects that may
+    // lie within angle radians of the ray from obsPosition along the unit
+    // vector direction. Nodes are culled by the angle between the ray and
+    // their bounding sphere, which for a narrow cone rejects most of the
+    // nodes a frustum around it would let through.
+    void processObjectsInCone(OctreeProcessor<OBJ, PREC>& processor,
+                              const PointType&            obsPosition,
+                              const PointType&            direction,
+                              PREC                        angle,
+                              float                       limitingFactor,
+                              OctreeProcStats*            stats = nullptr) const;
+
+    // Batch form of processObjectsInCone(), with the visitor of
+    // visitVisibleNodes()
+    template <class VISITOR>
+    void visitNodesInCone(VISITOR&&        visitor,
+                          const PointType& obsPosition,
+                          const PointType& direction,
+                          PREC             angle,
+                          float            limitingFactor,
+                          OctreeProcStats* stats = nullptr) const;
+
+    // Visit the nodes with objects in increasing order of a lower bound on
+    // some property of their objects, for searches of the objects with the
+    // smallest values. The visitor is called as
+    //     PREC visitor(const OBJ* objects, std::uint32_t count)
+    // and returns the value that an object has to beat to be of interest;
+    // the traversal ends when no remaining node can contain such an
+    // object. The bound of a node is computed as
+    //     PREC bound(PREC minDistance, float brightest)
+    // from the distance between obsPosition and the node, zero or less if
+    // the node contains obsPosition, and the exclusion factor that the
+    // objects of the node can't be brighter than, which is -infinity for
+    // the root.
+    template <class BOUND, class VISITOR>
+    void visitNodesByBound(BOUND&&          bound,
+                           VISITOR&&        visitor,
+                           const PointType& obsPosition) const;
+
+    // Return true if one of the objects of the octree can be given a new
+    // position, bounding radius and brightness in place: its bounding
+    // sphere has to stay in the cell of its node, it can't become
+    // brighter than the exclusion factor of the parent of the node, which
+    // the traversals assume the objects of the children aren't, and it
+    // has to keep its place in the magnitude order of the node.
+    bool canUpdateObject(const OBJ*       object,
+                         const PointType& position,
+                         PREC             radius,
+                         float            factor) const;
+
+    // Let the objects move away from the positions by which they were
+    // sorted into the nodes, by up to drift(const OBJ&) each. The bounds
+    // of every node are extended by the largest drift of the objects of
+    // the node and its descendants, so that the traversals find objects
+    // anywhere within that distance of their positions.
+    template <class DRIFT>
+    void setObjectDrift(DRIFT&& drift);
+
+    std::uint32_t nodeCount() const { return static_cast<std::uint32_t>(m_scale.size()); }
+
+    // Count the nodes and objects of each level, the root's first
+    void computeStatistics(std::vector<OctreeLevelStatistics>& stats) const;
+
+    // Bytes of the nodes, not including the objects
+    std::size_t memoryUsage() const
+    {
+        return (m_centerX.capacity() + m_centerY.capacity() + m_centerZ.capacity() + m_scale.capacity()) * sizeof(PREC)
+             + m_drift.capacity() * sizeof(PREC)
+             + m_exclusionFactor.capacity() * sizeof(float)
+             + (m_firstChild.capacity() + m_objectCount.capacity()) * sizeof(std::uint32_t)
+             + m_firstObject.capacity() * sizeof(OBJ*);
+    }
+
+    Node node(std::uint32_t index) const
+    {
+        return { center(index), m_scale[index], m_exclusionFactor[index],
+                 m_firstChild[index], m_firstObject[index], m_objectCount[index] };
+    }
+
+ private:
+    static constexpr std::uint32_t NoChildren = 0;
+    static constexpr PREC SQRT3 = (PREC) 1.732050807568877;
+
+    PointType center(std::uint32_t node) const
+    {
+        return PointType(m_centerX[node], m_centerY[node], m_centerZ[node]);
+    }
+
+    PREC drift(std::uint32_t node) const
+    {
+        return m_drift.empty() ? (PREC) 0 : m_drift[node];
+    }
+
+    // The frustum planes in the form used for the node tests
+    struct FrustumPlanes
+    {
+        PREC x[5];
+        PREC y[5];
+        PREC z[5];
+        PREC d[5];
+        PREC extent[5];
+    };
+
+    static void setPlanes(FrustumPlanes&, const Eigen::Hyperplane<PREC, 3>*);
+    // The smallest distance by which the cubic octree node lies inside one
+    // of the five planes that define the infinite view frustum; negative
+    // if the node is outside of the frustum.
+    PREC frustumMargin(const FrustumPlanes&, std::uint32_t node) const;
+
+    // Whether the bounding sphere of node comes within angle of the ray
+    bool intersectsCone(const PointType& obsPosition,
+                        const PointType& direction,
+                        PREC             angle,
+                        std::uint32_t    node) const
+    {
+        PointType offset = center(node) - obsPosition;
+        PREC distance = offset.norm();
+        PREC radius = m_scale[node] * SQRT3 + drift(node);
+        if (distance <= radius)
+            return true;
+
+        PREC cosAngle = std::clamp(offset.dot(direction) / distance, (PREC) -1, (PREC) 1);
+        return std::acos(cosAngle) <= angle + std::asin(radius / distance);
+    }
+
+    // Compute the distance to node; this is equal to the distance to
+    // the center of the node minus the bounding radius of the node.
+    PREC nodeDistance(const PointType& obsPosition, std::uint32_t node) const
+    {
+        return (obsPosition - center(node)).norm() - m_scale[node] * SQRT3 - drift(node);
+    }
+
+    // See if any of the objects in child nodes are potentially included
+    // that we need to recurse deeper.
+    bool descends(PREC minDistance, float limitingFactor, std::uint32_t node) const
+    {
+        return minDistance <= 0
+            || astro::absToAppMag(static_cast<PREC>(m_exclusionFactor[node]), minDistance) <= limitingFactor;
+    }
+
+    // Pass a node with objects to the visitor, as visitor(node, dimmest),
+    // and return whether the children of the node may contain visible
+    // objects. If minDistance is not null, it receives the distance from
+    // the observer to the node.
+    template <class VISITOR>
+    bool visitNode(VISITOR&                          visitor,
+                   const PointType&                  obsPosition,
+                   float                             limitingFactor,
+                   std::uint32_t                     node,
+                   OctreeProcStats*                  stats,
+                   PREC*                             minDistance = nullptr) const;
+
+    // Visit the visible children of node and their subtrees
+    template <class VISITOR>
+    void visitChildren(VISITOR&                          visitor,
+                       std::uint32_t                     node,
+                       const PointType&                  obsPosition,
+                       const FrustumPlanes&              planes,
+                       float                             limitingFactor,
+                       OctreeProcStats*                  stats) const;
+
+    // Visit the visible nodes of the subtree below root, which is assumed
+    // to have passed the frustum test. When cache is not null, the nodes
+    // are also classified for later traversals.
+    template <class VISITOR>
+    void visitSubtree(VISITOR&                          visitor,
+                      std::uint32_t                     root,
+                      const PointType&                  obsPosition,
+                      const FrustumPlanes&              planes,
+                      float                             limitingFactor,
+                      OctreeProcStats*                  stats,
+                      VisibleNodeCache*                 cache) const;
+
+    // Margin by which the frustum test of a node must pass or fail so that
+    // the result is the same for any view within the cache tolerances
+    PREC frustumTolerance(const VisibleNodeCache& cache, const PointType& obsPosition, std::uint32_t node) const
+    {
+        // The last term covers rounding errors of the test
+        PointType nodeCenter = center(node);
+        return cache.normalTolerance * ((nodeCenter - obsPosition).norm() + m_scale[node] * SQRT3)
+             + cache.positionTolerance
+             + 16 * std::numeric_limits<PREC>::epsilon() * (nodeCenter.norm() + obsPosition.norm() + m_scale[node]);
+    }
+
+    // These are implemented per object type, like the StaticOctree
+    // traversal methods. processNodeObjects() handles the objects of a node
+    // that passed the frustum test.
+    void processNodeObjects(OctreeProcessor<OBJ, PREC>& processor,
+                            const PointType&            obsPosition,
+                            float                       limitingFactor,
+                            const OBJ*                  objects,
+                            std::uint32_t               nObjects,
+                            PREC                        dimmest) const;
+
+    void processCloseNodeObjects(OctreeProcessor<OBJ, PREC>& processor,
+                                 const PointType&            obsPosition,
+                                 PREC                        boundingRadius,
+                                 std::uint32_t               node) const;
+
+    // The node arrays of large catalogs span many pages, so they're
+    // allocated like the catalogs themselves
+    template<typename T>
+    using NodeArray = celestia::util::CatalogVector<T>;
+
+    NodeArray<PREC>            m_centerX;
+    NodeArray<PREC>            m_centerY;
+    NodeArray<PREC>            m_centerZ;
+    NodeArray<PREC>            m_scale;
+    // Largest drift of the objects of each subtree; empty if no object
+    // moves, see setObjectDrift()
+    NodeArray<PREC>            m_drift;
+    NodeArray<float>           m_exclusionFactor;
+    // Index of the first of the eight children, or NoChildren for leaves;
+    // the root is node 0 and never a child.
+    NodeArray<std::uint32_t>   m_firstChild;
+    NodeArray<OBJ*>            m_firstObject;
+    NodeArray<std::uint32_t>   m_objectCount;
+    unsigned int               m_height{ 0 };
+};
+
+
+template <class OBJ, class PREC>
+FlatOctree<OBJ, PREC>::FlatOctree(const StaticOctree<OBJ, PREC>& root, PREC rootScale)
+{
+    struct QueueEntry
+    {
+        const StaticOctree<OBJ, PREC>* node;
+        PREC scale;
+        unsigned int level;
+    };
+
+    std::deque<QueueEntry> queue;
+    queue.push_back({ &root, rootScale, 1 });
+
+    while (!queue.empty())
+    {
+        QueueEntry entry = queue.front();
+        queue.pop_front();
+
+        const StaticOctree<OBJ, PREC>& node = *entry.node;
+        m_centerX.push_back(node.cellCenterPos.x());
+        m_centerY.push_back(node.cellCenterPos.y());
+        m_centerZ.push_back(node.cellCenterPos.z());
+        m_scale.push_back(entry.scale);
+        m_exclusionFactor.push_back(node.exclusionFactor);
+        m_firstObject.push_back(node._firstObject);
+        m_objectCount.push_back(node.nObjects);
+        if (entry.level > m_height)
+            m_height = entry.level;
+
+        if (node._children == nullptr)
+        {
+            m_firstChild.push_back(NoChildren);
+            continue;
+        }
+
+        // Children are numbered in the order they are queued, after all
+        // the nodes that are already stored or queued.
+        m_firstChild.push_back(static_cast<std::uint32_t>(m_scale.size() + queue.size()));
+        for (int i = 0; i < 8; ++i)
+            queue.push_back({ node._children[i], entry.scale * (PREC) 0.5, entry.level + 1 });
+    }
+}
+
+
+template <class OBJ, class PREC>
+void FlatOctree<OBJ, PREC>::computeStatistics(std::vector<OctreeLevelStatistics>& stats) const
+{
+    // In breadth-first order, a node's level is known before its children
+    // are reached
+    std::vector<unsigned int> levels(nodeCount(), 0);
+    stats.clear();
+    for (std::uint32_t node = 0; node < nodeCount(); ++node)
+    {
+        unsigned int level = levels[node];
+        if (level >= stats.size())
+            stats.push_back({ 0, 0, 2.0 * m_scale[node] });
+
+        stats[level].nodeCount++;
+        stats[level].objectCount += m_objectCount[node];
+
+        std::uint32_t first = m_firstChild[node];
+        if (first != NoChildren)
+            std::fill_n(levels.begin() + first, 8, level + 1);
+    }
+}
+
+
+template <class OBJ, class PREC>
+FlatOctree<OBJ, PREC>::FlatOctree(const std::vector<Node>& nodes)
+{
+    for (const Node& node : nodes)
+    {
+        m_centerX.push_back(node.center.x());
+        m_centerY.push_back(node.center.y());
+        m_centerZ.push_back(node.center.z());
+        m_scale.push_back(node.scale);
+        m_exclusionFactor.push_back(node.exclusionFactor);
+        m_firstChild.push_back(node.firstChild);
+        m_firstObject.push_back(node.firstObject);
+        m_objectCount.push_back(node.objectCount);
+
+        auto level = static_cast<unsigned int>(std::ilogb(m_scale[0] / node.scale)) + 1;
+        if (level > m_height)
+            m_height = level;
+    }
+}
+
+
+template <class OBJ, class PREC>
+void FlatOctree<OBJ, PREC>::processVisibleObjects(OctreeProcessor<OBJ, PREC>&       processor,
+                                                  const PointType&                  obsPosition,
+                                                  const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                                                  float                             limitingFactor,
+                                                  OctreeProcStats*                  stats) const
+{
+    visitVisibleNodes([&](const OBJ* objects, std::uint32_t nObjects, PREC dimmest)
+                      {
+                          processNodeObjects(processor, obsPosition, limitingFactor,
+                                             objects, nObjects, dimmest);
+                      },
+                      obsPosition, frustumPlanes, limitingFactor, stats);
+}
+
+
+template <class OBJ, class PREC>
+void FlatOctree<OBJ, PREC>::setPlanes(FrustumPlanes& planes, const Eigen::Hyperplane<PREC, 3>* frustumPlanes)
+{
+    for (unsigned int i = 0; i < 5; ++i)
+    {
+        planes.x[i] = frustumPlanes[i].normal().x();
+        planes.y[i] = frustumPlanes[i].normal().y();
+        planes.z[i] = frustumPlanes[i].normal().z();
+        planes.d[i] = frustumPlanes[i].offset();
+        planes.extent[i] = frustumPlanes[i].normal().cwiseAbs().sum();
+    }
+}
+
+
+template <class OBJ, class PREC>
+PREC FlatOctree<OBJ, PREC>::frustumMargin(const FrustumPlanes& planes, std::uint32_t node) const
+{
+    PREC margin = std::numeric_limits<PREC>::max();
+    for (unsigned int i = 0; i < 5; ++i)
+    {
+        PREC distance = planes.x[i] * m_centerX[node] + planes.y[i] * m_centerY[node] + planes.z[i] * m_centerZ[node] + planes.d[i];
+        margin = std::min(margin, distance + m_scale[node] * planes.extent[i]);
+    }
+    return margin + drift(node);
+}
+
+
+template <class OBJ, class PREC>
+template <class VISITOR>
+bool FlatOctree<OBJ, PREC>::visitNode(VISITOR&         visitor,
+                                      const PointType& obsPosition,
+                                      float            limitingFactor,
+                                      std::uint32_t    node,
+                                      OctreeProcStats* stats,
+                                      PREC*            minDistanceOut) const
+{
+    // Nodes and objects are counted for the rendering statistics, the
+    // height only when debugging the octree
+    if (stats != nullptr)
+    {
+        stats->nodes++;
+        stats->objects += m_objectCount[node];
+#ifdef OCTREE_DEBUG
+        auto level = static_cast<size_t>(std::ilogb(m_scale[0] / m_scale[node])) + 1;
+        if (level > stats->height)
+            stats->height = level;
+#endif
+    }
+
+    PREC minDistance = nodeDistance(obsPosition, node);
+    if (minDistanceOut != nullptr)
+        *minDistanceOut = minDistance;
+
+    // Process the objects in this node
+    PREC dimmest = minDistance > 0
+                 ? astro::appToAbsMag(static_cast<PREC>(limitingFactor), minDistance)
+                 : (PREC) 1000;
+    if (m_objectCount[node] > 0)
+        visitor(node, dimmest);
+
+    return descends(minDistance, limitingFactor, node);
+}
+
+
+template <class OBJ, class PREC>
+template <class VISITOR>
+void FlatOctree<OBJ, PREC>::visitChildren(VISITOR&             visitor,
+                                          std::uint32_t        node,
+                                          const PointType&     obsPosition,
+                                          const FrustumPlanes& planes,
+                                          float                limitingFactor,
+                                          OctreeProcStats*     stats) const
+{
+    if (!descends(nodeDistance(obsPosition, node), limitingFactor, node))
+        return;
+
+    std::uint32_t first = m_firstChild[node];
+    for (std::uint32_t j = 0; j < 8; ++j)
+    {
+        if (frustumMargin(planes, first + j) >= 0)
+            visitSubtree(visitor, first + j, obsPosition, planes, limitingFactor, stats, nullptr);
+    }
+}
+
+
+template <class OBJ, class PREC>
+template <class VISITOR>
+void FlatOctree<OBJ, PREC>::visitSubtree(VISITOR&             visitor,
+                                         std::uint32_t        root,
+                                         const PointType&     obsPosition,
+                                         const FrustumPlanes& planes,
+                                         float                limitingFactor,
+                                         OctreeProcStats*     stats,
+                                         VisibleNodeCache*    cache) const
+{
+    // Nodes are visited depth first, children in order, matching the
+    // recursive StaticOctree traversal. While a cache is built, nodes are
+    // stable if they pass the frustum test with room to spare and all
+    // of their ancestors are stable and certain to be descended into.
+    struct StackEntry
+    {
+        std::uint32_t node;
+        bool stable;
+    };
+
+    std::vector<StackEntry> stack;
+    stack.reserve(7 * m_height + 1);
+    stack.push_back({ root, cache != nullptr });
+
+    while (!stack.empty())
+    {
+        StackEntry entry = stack.back();
+        stack.pop_back();
+        std::uint32_t node = entry.node;
+
+        PREC minDistance;
+        bool descend = visitNode(visitor, obsPosition, limitingFactor, node, stats, &minDistance);
+
+        std::uint32_t first = m_firstChild[node];
+        bool stableChildren = false;
+        if (entry.stable)
+        {
+            cache->stableNodes.push_back(node);
+
+            if (first != NoChildren)
+            {
+                // The distance to the node changes by no more than the
+                // observer moves, so compare the distance within which
+                // the children may contain visible objects against the
+                // range of possible node distances.
+                PREC descendDistance = static_cast<PREC>(LY_PER_PARSEC)
+                                     * std::pow((PREC) 10, (static_cast<PREC>(limitingFactor) - m_exclusionFactor[node] + 5) / 5);
+                PREC nearest = minDistance - cache->positionTolerance;
+                PREC farthest = minDistance + cache->positionTolerance;
+                if (farthest <= 0 || farthest < descendDistance * (PREC) 0.999)
+                {
+                    stableChildren = descend;
+                }
+                else if (!(nearest > 0 && nearest > descendDistance * (PREC) 1.001))
+                {
+                    // Can't tell whether the children are visited next
+                    // time; they have to be tested again.
+                    cache->edgeParents.push_back(node);
+                }
+            }
+        }
+
+        if (!descend || first == NoChildren)
+            continue;
+
+        PREC margins[8];
+        for (unsigned int j = 0; j < 8; ++j)
+            margins[j] = std::numeric_limits<PREC>::max();
+        PREC scale = m_scale[first];
+        for (unsigned int i = 0; i < 5; ++i)
+        {
+            PREC r = scale * planes.extent[i];
+            for (unsigned int j = 0; j < 8; ++j)
+            {
+                PREC distance = planes.x[i] * m_centerX[first + j]
+                              + planes.y[i] * m_centerY[first + j]
+                              + planes.z[i] * m_centerZ[first + j]
+                              + planes.d[i];
+                margins[j] = std::min(margins[j], distance + r);
+            }
+        }
+        for (unsigned int j = 0; j < 8; ++j)
+            margins[j] += drift(first + j);
+
+        for (unsigned int j = 8; j-- > 0;)
+        {
+            bool stable = false;
+            if (stableChildren)
+            {
+                PREC tolerance = frustumTolerance(*cache, obsPosition, first + j);
+                if (margins[j] > tolerance)
+                    stable = true;
+                else if (margins[j] >= -tolerance)
+                    cache->edgeNodes.push_back(first + j);
+            }
+
+            if (margins[j] >= 0)
+                stack.push_back({ first + j, stable });
+        }
+    }
+}
+
+
+template <class OBJ, class PREC>
+template <class VISITOR>
+void FlatOctree<OBJ, PREC>::visitVisibleNodes(VISITOR&&                         visitor,
+                                              const PointType&                  obsPosition,
+                                              const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                                              float                             limitingFactor,
+                                              OctreeProcStats*                  stats) const
+{
+    if (m_scale.empty())
+        return;
+
+    auto nodeVisitor = [this, &visitor](std::uint32_t node, PREC dimmest)
+    {
+        visitor(static_cast<const OBJ*>(m_firstObject[node]), m_objectCount[node], dimmest);
+    };
+
+    FrustumPlanes planes;
+    setPlanes(planes, frustumPlanes);
+    if (frustumMargin(planes, 0) < 0)
+        return;
+
+    visitSubtree(nodeVisitor, 0, obsPosition, planes, limitingFactor, stats, nullptr);
+}
+
+
+template <class OBJ, class PREC>
+template <class VISITOR>
+void FlatOctree<OBJ, PREC>::visitVisibleNodeIndices(VISITOR&&                         visitor,
+                                                    const PointType&                  obsPosition,
+                                                    const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                                                    float                             limitingFactor,
+                                                    OctreeProcStats*                  stats) const
+{
+    if (m_scale.empty())
+        return;
+
+    auto nodeVisitor = [this, &visitor](std::uint32_t node, PREC dimmest)
+    {
+        visitor(node, m_objectCount[node], dimmest);
+    };
+
+    FrustumPlanes planes;
+    setPlanes(planes, frustumPlanes);
+    if (frustumMargin(planes, 0) < 0)
+        return;
+
+    visitSubtree(nodeVisitor, 0, obsPosition, planes, limitingFactor, stats, nullptr);
+}
+
+
+template <class OBJ, class PREC>
+template <class VISITOR>
+void FlatOctree<OBJ, PREC>::visitNodesInFrustum(VISITOR&&                         visitor,
+                                                const std::vector<VisibleNode>&   nodes,
+                                                const Eigen::Hyperplane<PREC, 3>* frustumPlanes) const
+{
+    // A node outside of the frustum has all of its descendants outside as
+    // well, so testing the listed nodes alone gives the same result as a
+    // traversal.
+    FrustumPlanes planes;
+    setPlanes(planes, frustumPlanes);
+    for (const VisibleNode& visible : nodes)
+    {
+        if (frustumMargin(planes, visible.node) >= 0)
+            visitor(static_cast<const OBJ*>(m_firstObject[visible.node]), m_objectCount[visible.node], visible.dimmest);
+    }
+}
+
+
+template <class OBJ, class PREC>
+template <class VISITOR>
+void FlatOctree<OBJ, PREC>::visitVisibleNodes(VISITOR&&                         visitor,
+                                              const PointType&                  obsPosition,
+                                              const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                                              float                             limitingFactor,
+                                              VisibleNodeCache&                 cache,
+                                              OctreeProcStats*                  stats) const
+{
+    if (m_scale.empty())
+        return;
+
+    auto nodeVisitor = [this, &visitor](std::uint32_t node, PREC dimmest)
+    {
+        visitor(static_cast<const OBJ*>(m_firstObject[node]), m_objectCount[node], dimmest);
+    };
+
+    FrustumPlanes planes;
+    setPlanes(planes, frustumPlanes);
+
+    bool reuse = cache.octree == this
+              && cache.limitingFactor == limitingFactor
+              && (obsPosition - cache.obsPosition).norm() <= cache.positionTolerance;
+    for (unsigned int i = 0; i < 5 && reuse; ++i)
+        reuse = (frustumPlanes[i].normal() - cache.planeNormals[i]).norm() <= cache.normalTolerance;
+
+    if (reuse)
+    {
+        for (std::uint32_t node : cache.stableNodes)
+            visitNode(nodeVisitor, obsPosition, limitingFactor, node, stats);
+        for (std::uint32_t node : cache.edgeNodes)
+        {
+            if (frustumMargin(planes, node) >= 0)
+                visitSubtree(nodeVisitor, node, obsPosition, planes, limitingFactor, stats, nullptr);
+        }
+        for (std::uint32_t node : cache.edgeParents)
+            visitChildren(nodeVisitor, node, obsPosition, planes, limitingFactor, stats);
+        return;
+    }
+
+    cache.octree = this;
+    cache.obsPosition = obsPosition;
+    for (unsigned int i = 0; i < 5; ++i)
+        cache.planeNormals[i] = frustumPlanes[i].normal();
+    cache.limitingFactor = limitingFactor;
+    cache.stableNodes.clear();
+    cache.edgeNodes.clear();
+    cache.edgeParents.clear();
+
+    // The root has no parent that could be culled, so it is classified
+    // like the children of a stable node.
+    PREC margin = frustumMargin(planes, 0);
+    PREC tolerance = frustumTolerance(cache, obsPosition, 0);
+    if (margin > tolerance)
+    {
+        visitSubtree(nodeVisitor, 0, obsPosition, planes, limitingFactor, stats, &cache);
+        return;
+    }
+
+    if (margin >= -tolerance)
+        cache.edgeNodes.push_back(0);
+    if (margin >= 0)
+        visitSubtree(nodeVisitor, 0, obsPosition, planes, limitingFactor, stats, nullptr);
+}
+
+
+template <class OBJ, class PREC>
+void FlatOctree<OBJ, PREC>::processCloseObjects(OctreeProcessor<OBJ, PREC>& processor,
+                                                const PointType&            obsPosition,
+                                                PREC                        boundingRadius) const
+{
+    if (m_scale.empty())
+        return;
+
+    std::vector<std::uint32_t> stack;
+    stack.reserve(7 * m_height + 1);
+    stack.push_back(0);
+
+    while (!stack.empty())
+    {
+        std::uint32_t node = stack.back();
+        stack.pop_back();
+
+        // Compute the distance to node; this is equal to the distance to
+        // the center of the node minus the bounding radius of the node.
+        PREC nodeDistance = (obsPosition - center(node)).norm() - m_scale[node] * SQRT3 - drift(node);
+        if (nodeDistance > boundingRadius)
+            continue;
+
+        processCloseNodeObjects(processor, obsPosition, boundingRadius, node);
+
+        std::uint32_t first = m_firstChild[node];
+        if (first == NoChildren)
+            continue;
+
+        for (unsigned int j = 8; j-- > 0;)
+            stack.push_back(first + j);
+    }
+}
+
+
+template <class OBJ, class PREC>
+void FlatOctree<OBJ, PREC>::processObjectsInCone(OctreeProcessor<OBJ, PREC>& processor,
+                                                 const PointType&            obsPosition,
+                                                 const PointType&            direction,
+                                                 PREC                        angle,
+                                                 float                       limitingFactor,
+                                                 OctreeProcStats*            stats) const
+{
+    visitNodesInCone([&](const OBJ* objects, std::uint32_t nObjects, PREC dimmest)
+                     {
+                         processNodeObjects(processor, obsPosition, limitingFactor,
+                                            objects, nObjects, dimmest);
+                     },
+                     obsPosition, direction, angle, limitingFactor, stats);
+}
+
+
+template <class OBJ, class PREC>
+template <class VISITOR>
+void FlatOctree<OBJ, PREC>::visitNodesInCone(VISITOR&&        visitor,
+                                             const PointType& obsPosition,
+                                             const PointType& direction,
+                                             PREC             angle,
+                                             float            limitingFactor,
+                                             OctreeProcStats* stats) const
+{
+    if (m_scale.empty() || !intersectsCone(obsPosition, direction, angle, 0))
+        return;
+
+    auto nodeVisitor = [this, &visitor](std::uint32_t node, PREC dimmest)
+    {
+        visitor(static_cast<const OBJ*>(m_firstObject[node]), m_objectCount[node], dimmest);
+    };
+
+    std::vector<std::uint32_t> stack;
+    stack.reserve(7 * m_height + 1);
+    stack.push_back(0);
+
+    while (!stack.empty())
+    {
+        std::uint32_t node = stack.back();
+        stack.pop_back();
+
+        std::uint32_t first = m_firstChild[node];
+        if (!visitNode(nodeVisitor, obsPosition, limitingFactor, node, stats) || first == NoChildren)
+            continue;
+
+        for (unsigned int j = 8; j-- > 0;)
+        {
+            if (intersectsCone(obsPosition, direction, angle, first + j))
+                stack.push_back(first + j);
+        }
+    }
+}
+
+
+template <class OBJ, class PREC>
+template <class BOUND, class VISITOR>
+void FlatOctree<OBJ, PREC>::visitNodesByBound(BOUND&&          bound,
+                                              VISITOR&&        visitor,
+                                              const PointType& obsPosition) const
+{
+    if (m_scale.empty())
+        return;
+
+    struct QueueEntry
+    {
+        PREC          value;
+        std::uint32_t node;
+
+        // Order the queue with the lowest bound on top
+        bool operator<(const QueueEntry& other) const { return value > other.value; }
+    };
+
+    std::priority_queue<QueueEntry> queue;
+    queue.push({ bound(nodeDistance(obsPosition, 0), -std::numeric_limits<float>::infinity()), 0 });
+
+    PREC limit = std::numeric_limits<PREC>::infinity();
+    while (!queue.empty() && queue.top().value < limit)
+    {
+        std::uint32_t node = queue.top().node;
+        queue.pop();
+
+        if (m_objectCount[node] > 0)
+            limit = visitor(static_cast<const OBJ*>(m_firstObject[node]), m_objectCount[node]);
+
+        // Objects brighter than the exclusion factor of a node stay in the
+        // node, so it bounds the brightness of the objects of the children
+        std::uint32_t first = m_firstChild[node];
+        if (first == NoChildren)
+            continue;
+
+        for (std::uint32_t j = 0; j < 8; ++j)
+            queue.push({ bound(nodeDistance(obsPosition, first + j), m_exclusionFactor[node]), first + j });
+    }
+}
+
+
+template <class OBJ, class PREC>
+template <class DRIFT>
+void FlatOctree<OBJ, PREC>::setObjectDrift(DRIFT&& objectDrift)
+{
+    auto nodes = nodeCount();
+    m_drift.assign(nodes, (PREC) 0);
+
+    bool moving = false;
+    for (std::uint32_t node = 0; node < nodes; ++node)
+    {
+        const OBJ* objects = m_firstObject[node];
+        for (std::uint32_t i = 0; i < m_objectCount[node]; ++i)
+            m_drift[node] = std::max(m_drift[node], static_cast<PREC>(objectDrift(objects[i])));
+        moving = moving || m_drift[node] > 0;
+    }
+
+    if (!moving)
+    {
+        m_drift.clear();
+        m_drift.shrink_to_fit();
+        return;
+    }
+
+    // Children are stored after their parents, so a pass in reverse order
+    // carries the drift of every subtree up to its root. The extended
+    // bounds of a node then still contain those of its children, which
+    // the traversals rely on when they skip the subtree of a culled node.
+    for (std::uint32_t node = nodes; node-- > 0;)
+    {
+        std::uint32_t first = m_firstChild[node];
+        if (first == NoChildren)
+            continue;
+        for (std::uint32_t j = 0; j < 8; ++j)
+            m_drift[node] = std::max(m_drift[node], m_drift[first + j]);
+    }
+}
+
+
+template <class OBJ, class PREC>
+bool FlatOctree<OBJ, PREC>::canUpdateObject(const OBJ*       object,
+                                            const PointType& position,
+                                            PREC             radius,
+                                            float            factor) const
+{
+    auto nodes = nodeCount();
+    std::uint32_t node = 0;
+    for (; node < nodes; ++node)
+    {
+        if (object >= m_firstObject[node] && object < m_firstObject[node] + m_objectCount[node])
+            break;
+    }
+    if (node == nodes)
+        return false;
+
+    if ((position - center(node)).cwiseAbs().maxCoeff() + radius > m_scale[node])
+        return false;
+
+    auto magnitude = DynamicOctree<OBJ, PREC>::magnitudeFunction;
+    if (object > m_firstObject[node] && factor < magnitude(object[-1]))
+        return false;
+    if (object + 1 < m_firstObject[node] + m_objectCount[node] && factor > magnitude(object[1]))
+        return false;
+
+    if (node == 0)
+        return true;
+
+    for (std::uint32_t parent = 0; parent < node; ++parent)
+    {
+        std::uint32_t firstChild = m_firstChild[parent];
+        if (firstChild != NoChildren && node >= firstChild && node < firstChild + 8)
+            return factor >= m_exclusionFactor[parent];
+    }
+
+    return false;
+}
@@ -57,7 +57,7 @@ static UniversalCoord rotate(const UniversalCoord& uc, const Quaterniond& q)
 UniversalCoord
 ReferenceFrame::convertFromUniversal(const UniversalCoord& uc, double tjd) const
 {
-    UniversalCoord uc1 = uc - centerObject.getPosition(tjd);
+    UniversalCoord uc1 = uc - getCenterPosition(tjd);
     return rotate(uc1, getOrientation(tjd).conjugate());
 }
 
@@ -83,7 +83,7 @@ ReferenceFrame::convertFromUniversal(const Quaterniond& q, double tjd) const
 UniversalCoord
 ReferenceFrame::convertToUniversal(const UniversalCoord& uc, double tjd) const
 {
-    return centerObject.getPosition(tjd) + rotate(uc, getOrientation(tjd));
+    return getCenterPosition(tjd) + rotate(uc, getOrientation(tjd));
 }
 
 
@@ -147,6 +147,13 @@ ReferenceFrame::getCenter() const
 }
 
 
+UniversalCoord
+ReferenceFrame::getCenterPosition(double tjd) const
+{
+    return centerObject.getPosition(tjd);
+}
+
+
 Vector3d
 ReferenceFrame::getAngularVelocity(double tjd) const
 {
@@ -261,14 +268,14 @@ J2000EquatorFrame::nestingDepth(unsigned int depth,
 /*** BodyFixedFrame ***/
 
 BodyFixedFrame::BodyFixedFrame(Selection center, Selection obj) :
-    ReferenceFrame(center),
+    CachingFrame(center),
     fixObject(obj)
 {
 }
 
 
 Quaterniond
-BodyFixedFrame::getOrientation(double tjd) const
+BodyFixedFrame::computeOrientation(double tjd) const
 {
     // Rotation of 180 degrees about the y axis is required
     // TODO: this rotation could go in getEclipticalToBodyFixed()
@@ -292,7 +299,7 @@ BodyFixedFrame::getOrientation(double tjd) const
 
 
 Vector3d
-BodyFixedFrame::getAngularVelocity(double tjd) const
+BodyFixedFrame::computeAngularVelocity(double tjd) const
 {
     switch (fixObject.getType())
     {
@@ -340,7 +347,7 @@ BodyFixedFrame::nestingDepth(unsigned int depth,
 
 BodyMeanEquatorFrame::BodyMeanEquatorFrame(Selection center,
                                            Selection obj) :
-    ReferenceFrame(center),
+    CachingFrame(center),
     equatorObject(obj),
     freezeEpoch(astro::J2000),
     isFrozen(false)
@@ -351,7 +358,7 @@ BodyMeanEquatorFrame::BodyMeanEquatorFrame(Selection center,
 BodyMeanEquatorFrame::BodyMeanEquatorFrame(Selection center,
                                            Selection obj,
                                            double freeze) :
-    ReferenceFrame(center),
+    CachingFrame(center),
     equatorObject(obj),
     freezeEpoch(freeze),
     isFrozen(true)
@@ -360,7 +367,7 @@ BodyMeanEquatorFrame::BodyMeanEquatorFrame(Selection center,
 
 
 Quaterniond
-BodyMeanEquatorFrame::getOrientation(double tjd) const
+BodyMeanEquatorFrame::computeOrientation(double tjd) const
 {
     double t = isFrozen ? freezeEpoch : tjd;
 
@@ -377,7 +384,7 @@ BodyMeanEquatorFrame::getOrientation(double tjd) const
 
 
 Vector3d
-BodyMeanEquatorFrame::getAngularVelocity(double tjd) const
+BodyMeanEquatorFrame::computeAngularVelocity(double tjd) const
 {
     if (isFrozen)
     {
@@ -449,22 +456,31 @@ CachingFrame::CachingFrame(Selection _center) :
     lastOrientation(Quaterniond::Identity()),
     lastAngularVelocity(0.0, 0.0, 0.0),
     orientationCacheValid(false),
-    angularVelocityCacheValid(false)
+    angularVelocityCacheValid(false),
+    centerPositionCacheValid(false)
 {
 }
 
 
-Quaterniond
-CachingFrame::getOrientation(double tjd) const
+// Drop the cached values when the time changes
+void
+CachingFrame::setTime(double tjd) const
 {
     if (tjd != lastTime)
     {
         lastTime = tjd;
-        lastOrientation = computeOrientation(tjd);
-        orientationCacheValid = true;
+        orientationCacheValid = false;
         angularVelocityCacheValid = false;
+        centerPositionCacheValid = false;
     }
-    else if (!orientationCacheValid)
+}
+
+
+Quaterniond
+CachingFrame::getOrientation(double tjd) const
+{
+    setTime(tjd);
+    if (!orientationCacheValid)
     {
         lastOrientation = computeOrientation(tjd);
         orientationCacheValid = true;
@@ -476,20 +492,28 @@ CachingFrame::getOrientation(double tjd) const
 
 Vector3d CachingFrame::getAngularVelocity(double tjd) const
 {
-    if (tjd != lastTime)
+    setTime(tjd);
+    if (!angularVelocityCacheValid)
     {
-        lastTime = tjd;
         lastAngularVelocity = computeAngularVelocity(tjd);
-        orientationCacheValid = false;
         angularVelocityCacheValid = true;
     }
-    else if (!angularVelocityCacheValid)
+
+    return lastAngularVelocity;
+}
+
+
+UniversalCoord
+CachingFrame::getCenterPosition(double tjd) const
+{
+    setTime(tjd);
+    if (!centerPositionCacheValid)
     {
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        angularVelocityCacheValid = true;
+        lastCenterPosition = ReferenceFrame::getCenterPosition(tjd);
+        centerPositionCacheValid = true;
     }
 
-    return lastAngularVelocity;
+    return lastCenterPosition;
 }
 
 
@@ -43,9 +43,16 @@ class ReferenceFrame
 
     virtual Eigen::Quaterniond getOrientation(double tjd) const = 0;
     virtual Eigen::Vector3d getAngularVelocity(double tdb) const;
+    // Position of the center object in universal coordinates
+    virtual UniversalCoord getCenterPosition(double tjd) const;
 
     virtual bool isInertial() const = 0;
 
+    // Return true if the orientation may be computed from several threads
+    // at once. Frames that cache their last result aren't. Conversions to
+    // astrocentric coordinates additionally depend on the center object.
+    virtual bool isThreadSafe() const { return false; }
+
     enum FrameType
     {
         PositionFrame = 1,
@@ -64,7 +71,9 @@ class ReferenceFrame
 
 
 /*! Base class for complex frames where there may be some benefit
- *  to caching the last calculated orientation.
+ *  to caching the last calculated orientation. The position of the
+ *  center is cached along with it, so that a frame that is shared by
+ *  many objects is evaluated only once for each simulation time.
  */
 class CachingFrame : public ReferenceFrame
 {
@@ -76,15 +85,20 @@ class CachingFrame : public ReferenceFrame
 
     Eigen::Quaterniond getOrientation(double tjd) const;
     Eigen::Vector3d getAngularVelocity(double tjd) const;
+    UniversalCoord getCenterPosition(double tjd) const;
     virtual Eigen::Quaterniond computeOrientation(double tjd) const = 0;
     virtual Eigen::Vector3d computeAngularVelocity(double tjd) const;
 
  private:
+    void setTime(double tjd) const;
+
     mutable double lastTime;
     mutable Eigen::Quaterniond lastOrientation;
     mutable Eigen::Vector3d lastAngularVelocity;
+    mutable UniversalCoord lastCenterPosition;
     mutable bool orientationCacheValid;
     mutable bool angularVelocityCacheValid;
+    mutable bool centerPositionCacheValid;
 };
 
 
@@ -103,6 +117,7 @@ class J2000EclipticFrame : public ReferenceFrame
     }
 
     virtual bool isInertial() const;
+    virtual bool isThreadSafe() const { return true; }
 
     virtual unsigned int nestingDepth(unsigned int depth,
                                       unsigned int maxDepth,
@@ -120,6 +135,7 @@ class J2000EquatorFrame : public ReferenceFrame
     virtual ~J2000EquatorFrame() {};
     Eigen::Quaterniond getOrientation(double tjd) const;
     virtual bool isInertial() const;
+    virtual bool isThreadSafe() const { return true; }
     virtual unsigned int nestingDepth(unsigned int depth,
                                       unsigned int maxDepth,
                                       FrameType frameType) const;
@@ -132,15 +148,15 @@ class J2000EquatorFrame : public ReferenceFrame
  *  y-axis is the cross product of x and z, and points toward the 90
  *  meridian.
  */
-class BodyFixedFrame : public ReferenceFrame
+class BodyFixedFrame : public CachingFrame
 {
  public:
     SHARED_TYPES(BodyFixedFrame)
 
     BodyFixedFrame(Selection center, Selection obj);
     virtual ~BodyFixedFrame() {};
-    Eigen::Quaterniond getOrientation(double tjd) const;
-    virtual Eigen::Vector3d getAngularVelocity(double tjd) const;
+    Eigen::Quaterniond computeOrientation(double tjd) const;
+    virtual Eigen::Vector3d computeAngularVelocity(double tjd) const;
     virtual bool isInertial() const;
     virtual unsigned int nestingDepth(unsigned int depth,
                                       unsigned int maxDepth,
@@ -151,7 +167,7 @@ class BodyFixedFrame : public ReferenceFrame
 };
 
 
-class BodyMeanEquatorFrame : public ReferenceFrame
+class BodyMeanEquatorFrame : public CachingFrame
 {
  public:
     SHARED_TYPES(BodyMeanEquatorFrame)
@@ -159,8 +175,8 @@ class BodyMeanEquatorFrame : public ReferenceFrame
     BodyMeanEquatorFrame(Selection center, Selection obj, double freeze);
     BodyMeanEquatorFrame(Selection center, Selection obj);
     virtual ~BodyMeanEquatorFrame() {};
-    Eigen::Quaterniond getOrientation(double tjd) const;
-    virtual Eigen::Vector3d getAngularVelocity(double tjd) const;
+    Eigen::Quaterniond computeOrientation(double tjd) const;
+    virtual Eigen::Vector3d computeAngularVelocity(double tjd) const;
     virtual bool isInertial() const;
     virtual unsigned int nestingDepth(unsigned int depth,
                                       unsigned int maxDepth,
@@ -9,6 +9,7 @@
 // of the License, or (at your option) any later version.
 
 #include "framebuffer.h"
+#include "glstate.h"
 
 FramebufferObject::FramebufferObject(GLuint width, GLuint height, unsigned int attachments) :
     m_width(width),
@@ -30,7 +31,8 @@ FramebufferObject::FramebufferObject(FramebufferObject &&other) :
     m_colorTexId(other.m_colorTexId),
     m_depthTexId(other.m_depthTexId),
     m_fboId(other.m_fboId),
-    m_status(other.m_status)
+    m_status(other.m_status),
+    m_floatDepth(other.m_floatDepth)
 {
     other.m_fboId  = 0;
     other.m_status = GL_FRAMEBUFFER_UNSUPPORTED;
@@ -44,6 +46,7 @@ FramebufferObject& FramebufferObject::operator=(FramebufferObject &&other)
     m_depthTexId   = other.m_depthTexId;
     m_fboId        = other.m_fboId;
     m_status       = other.m_status;
+    m_floatDepth   = other.m_floatDepth;
 
     other.m_fboId  = 0;
     other.m_status = GL_FRAMEBUFFER_UNSUPPORTED;
@@ -78,7 +81,7 @@ FramebufferObject::generateColorTexture()
 {
     // Create and bind the texture
     glGenTextures(1, &m_colorTexId);
-    glBindTexture(GL_TEXTURE_2D, m_colorTexId);
+    celestia::gl::bindTexture(GL_TEXTURE_2D, m_colorTexId);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -96,7 +99,7 @@ FramebufferObject::generateColorTexture()
 #endif
 
     // Unbind the texture
-    glBindTexture(GL_TEXTURE_2D, 0);
+    celestia::gl::bindTexture(GL_TEXTURE_2D, 0);
 }
 
 #ifdef GL_ES
@@ -106,11 +109,11 @@ FramebufferObject::generateColorTexture()
 #endif
 
 void
-FramebufferObject::generateDepthTexture()
+FramebufferObject::generateDepthTexture(bool floatDepth)
 {
     // Create and bind the texture
     glGenTextures(1, &m_depthTexId);
-    glBindTexture(GL_TEXTURE_2D, m_depthTexId);
+    celestia::gl::bindTexture(GL_TEXTURE_2D, m_depthTexId);
 
 #ifndef GL_ES
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
@@ -128,11 +131,22 @@ FramebufferObject::generateDepthTexture()
 
     // Set the texture dimensions
     // Do we need to set GL_DEPTH_COMPONENT24 here?
-
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, m_width, m_height, 0, GL_DEPTH_COMPONENT, CEL_DEPTH_FORMAT, nullptr);
+#ifndef GL_ES
+    if (floatDepth)
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, m_width, m_height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        m_floatDepth = true;
+    }
+    else
+#else
+    (void) floatDepth;
+#endif
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, m_width, m_height, 0, GL_DEPTH_COMPONENT, CEL_DEPTH_FORMAT, nullptr);
+    }
 
     // Unbind the texture
-    glBindTexture(GL_TEXTURE_2D, 0);
+    celestia::gl::bindTexture(GL_TEXTURE_2D, 0);
 }
 
 void
@@ -170,7 +184,7 @@ FramebufferObject::generateFbo(unsigned int attachments)
 
     if ((attachments & DepthAttachment) != 0)
     {
-        generateDepthTexture();
+        generateDepthTexture((attachments & FloatDepth) != 0);
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_depthTexId, 0);
         m_status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
         if (m_status != GL_FRAMEBUFFER_COMPLETE)
@@ -200,12 +214,12 @@ FramebufferObject::cleanup()
 
     if (m_colorTexId != 0)
     {
-        glDeleteTextures(1, &m_colorTexId);
+        celestia::gl::deleteTextures(1, &m_colorTexId);
     }
 
     if (m_depthTexId != 0)
     {
-        glDeleteTextures(1, &m_depthTexId);
+        celestia::gl::deleteTextures(1, &m_depthTexId);
     }
 }
 
@@ -18,7 +18,10 @@ class FramebufferObject
     enum
     {
         ColorAttachment = 0x1,
-        DepthAttachment = 0x2
+        DepthAttachment = 0x2,
+        // With DepthAttachment, a 32-bit floating point depth buffer;
+        // ignored with GLES
+        FloatDepth      = 0x4
     };
     FramebufferObject() = delete;
     FramebufferObject(GLuint width, GLuint height, unsigned int attachments);
@@ -46,9 +49,14 @@ class FramebufferObject
     bool bind();
     bool unbind(GLint oldfboId);
 
+    bool hasFloatDepth() const
+    {
+        return m_floatDepth;
+    }
+
  private:
     void generateColorTexture();
-    void generateDepthTexture();
+    void generateDepthTexture(bool floatDepth);
     void generateFbo(unsigned int attachments);
     void cleanup();
 
@@ -59,6 +67,7 @@ class FramebufferObject
     GLuint m_depthTexId;
     GLuint m_fboId;
     GLenum m_status;
+    bool m_floatDepth{ false };
 };
 
 bool FramebufferObject::isSupported()
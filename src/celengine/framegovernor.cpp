@@ -0,0 +1,201 @@
+// framegovernor.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Adjustment of the render resolution and detail to a target frame time.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include "framegovernor.h"
+
+namespace
+{
+
+// Weight of a new frame in the smoothed frame time
+constexpr double Smoothing = 0.2;
+
+// The band around the target frame time where nothing changes: the
+// resolution and detail are lowered above it, and raised below it. The
+// lower bound leaves room for the next resolution step, so that raising
+// it doesn't push the frame time over the upper bound.
+constexpr double SlowMargin = 1.05;
+constexpr double FastMargin = 0.75;
+
+// Frames out of the band before a change; lowering the quality is quick,
+// raising it back is more cautious.
+constexpr int SlowFramesToDegrade = 5;
+constexpr int FastFramesToImprove = 60;
+
+// Frames ignored after a change, in addition to those already pending
+constexpr int SettleFrames = 4;
+
+constexpr float ResolutionStep = 0.1f;
+constexpr float DetailStep = 0.25f;
+constexpr float Tolerance = 1.0e-3f;
+
+// Queries are dropped when the results don't come, so that they don't
+// pile up
+constexpr std::size_t MaxPendingFrames = 16;
+
+} // end unnamed namespace
+
+FrameGovernor::FrameGovernor(const Settings& _settings) :
+    settings(_settings)
+{
+    settings.minResolutionScale = std::clamp(settings.minResolutionScale, 0.1f, 1.0f);
+    settings.maxResolutionScale = std::clamp(settings.maxResolutionScale, settings.minResolutionScale, 1.0f);
+    settings.minDetail = std::clamp(settings.minDetail, 0.0f, 1.0f);
+    resolutionScale = settings.maxResolutionScale;
+}
+
+FrameGovernor::~FrameGovernor()
+{
+    for (const Frame& frame : frames)
+    {
+        freeQueries.push_back(frame.startQuery);
+        freeQueries.push_back(frame.endQuery);
+    }
+    if (!freeQueries.empty())
+        glDeleteQueries(static_cast<GLsizei>(freeQueries.size()), freeQueries.data());
+}
+
+bool
+FrameGovernor::isSupported()
+{
+    return celestia::gl::ARB_timer_query;
+}
+
+GLuint
+FrameGovernor::newQuery()
+{
+    if (freeQueries.empty())
+    {
+        GLuint query = 0;
+        glGenQueries(1, &query);
+        return query;
+    }
+
+    GLuint query = freeQueries.back();
+    freeQueries.pop_back();
+    return query;
+}
+
+void
+FrameGovernor::beginFrame()
+{
+    if (frameStarted)
+        return;
+
+    if (frames.size() >= MaxPendingFrames)
+    {
+        freeQueries.push_back(frames.front().startQuery);
+        freeQueries.push_back(frames.front().endQuery);
+        frames.pop_front();
+    }
+
+    Frame frame{ newQuery(), newQuery() };
+    glQueryCounter(frame.startQuery, GL_TIMESTAMP);
+    frames.push_back(frame);
+    frameStarted = true;
+}
+
+void
+FrameGovernor::endFrame()
+{
+    if (!frameStarted)
+        return;
+
+    glQueryCounter(frames.back().endQuery, GL_TIMESTAMP);
+    frameStarted = false;
+
+    // Queries complete in order, so the first unavailable result ends the
+    // available ones.
+    while (!frames.empty())
+    {
+        const Frame& frame = frames.front();
+        GLint available = 0;
+        glGetQueryObjectiv(frame.endQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available == 0)
+            break;
+
+        GLuint64 start = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(frame.startQuery, GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(frame.endQuery, GL_QUERY_RESULT, &end);
+        freeQueries.push_back(frame.startQuery);
+        freeQueries.push_back(frame.endQuery);
+        frames.pop_front();
+
+        if (end > start)
+            addFrameTime(static_cast<double>(end - start) * 1.0e-9);
+    }
+}
+
+void
+FrameGovernor::addFrameTime(double seconds)
+{
+    // The average starts over with the first frame drawn after a change
+    if (averageTime == 0.0 || settleFrames == 1)
+        averageTime = seconds;
+    else
+        averageTime += (seconds - averageTime) * Smoothing;
+
+    if (settleFrames > 0)
+    {
+        settleFrames--;
+        return;
+    }
+
+    double target = settings.targetFrameTime;
+    if (averageTime > target * SlowMargin)
+    {
+        fastFrames = 0;
+        if (++slowFrames >= SlowFramesToDegrade)
+            degrade();
+    }
+    else if (averageTime < target * FastMargin)
+    {
+        slowFrames = 0;
+        if (++fastFrames >= FastFramesToImprove)
+            improve();
+    }
+    else
+    {
+        slowFrames = 0;
+        fastFrames = 0;
+    }
+}
+
+void
+FrameGovernor::degrade()
+{
+    if (resolutionScale > settings.minResolutionScale + Tolerance)
+        resolutionScale = std::max(settings.minResolutionScale, resolutionScale - ResolutionStep);
+    else if (detail > settings.minDetail + Tolerance)
+        detail = std::max(settings.minDetail, detail - DetailStep);
+    else
+        return;
+
+    slowFrames = 0;
+    fastFrames = 0;
+    settleFrames = SettleFrames + static_cast<int>(frames.size());
+}
+
+void
+FrameGovernor::improve()
+{
+    if (detail < 1.0f - Tolerance)
+        detail = std::min(1.0f, detail + DetailStep);
+    else if (resolutionScale < settings.maxResolutionScale - Tolerance)
+        resolutionScale = std::min(settings.maxResolutionScale, resolutionScale + ResolutionStep);
+    else
+        return;
+
+    slowFrames = 0;
+    fastFrames = 0;
+    settleFrames = SettleFrames + static_cast<int>(frames.size());
+}
@@ -0,0 +1,93 @@
+// framegovernor.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Adjustment of the render resolution and detail to a target frame time.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <deque>
+#include <vector>
+#include "glsupport.h"
+
+// FrameGovernor measures the GPU time of the frames with timestamp queries
+// and trades image quality for speed when they take longer than the
+// target: first the resolution the scene is rendered at, which is then
+// upscaled to the view, then the detail of the stars, galaxies and
+// globular clusters. When the frames take well under the target, the
+// detail is restored before the resolution, undoing the changes in reverse.
+//
+// The results of the queries are read without waiting for the GPU, a few
+// frames late, so a change is only made after the frame time has stayed
+// out of its band for a while, and none is made until the frames drawn
+// with the previous one are measured.
+class FrameGovernor
+{
+ public:
+    struct Settings
+    {
+        // Seconds
+        float targetFrameTime{ 1.0f / 60.0f };
+        // Bounds of the fraction of the view size that the scene is
+        // rendered at
+        float minResolutionScale{ 0.5f };
+        float maxResolutionScale{ 1.0f };
+        // Lower bound of the detail, from 0 to 1
+        float minDetail{ 0.25f };
+    };
+
+    explicit FrameGovernor(const Settings& settings);
+    ~FrameGovernor();
+    FrameGovernor(const FrameGovernor&) = delete;
+    FrameGovernor& operator=(const FrameGovernor&) = delete;
+
+    static bool isSupported();
+
+    // Time the GPU commands issued between beginFrame() and endFrame(),
+    // and adjust the settings to the frames whose results are available
+    void beginFrame();
+    void endFrame();
+
+    // Adjust the settings to the GPU time of a frame in seconds; called by
+    // endFrame() with the measured frames
+    void addFrameTime(double seconds);
+
+    // Fraction of the view size to render the scene at
+    float getResolutionScale() const { return resolutionScale; }
+    // Fraction of the detail to draw, from minDetail to 1
+    float getDetail() const { return detail; }
+    // Smoothed GPU time of the last frames in seconds
+    double getFrameTime() const { return averageTime; }
+
+ private:
+    struct Frame
+    {
+        GLuint startQuery;
+        GLuint endQuery;
+    };
+
+    GLuint newQuery();
+    void degrade();
+    void improve();
+
+    Settings settings;
+    float resolutionScale;
+    float detail{ 1.0f };
+
+    double averageTime{ 0.0 };
+    // Consecutive frames slower and faster than the band around the target
+    int slowFrames{ 0 };
+    int fastFrames{ 0 };
+    // Frames to ignore after a change, drawn before it took effect
+    int settleFrames{ 0 };
+
+    // Frames waiting for their results, in the order they started
+    std::deque<Frame> frames;
+    std::vector<GLuint> freeQueries;
+    bool frameStarted{ false };
+};
@@ -0,0 +1,132 @@
+// framereader.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Asynchronous frame buffer readback.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "framereader.h"
+#include "glstate.h"
+
+using celestia::PixelFormat;
+
+namespace
+{
+int bytesPerPixel(PixelFormat format)
+{
+    return format == PixelFormat::RGB || format == PixelFormat::BGR ? 3 : 4;
+}
+}
+
+FrameReader::FrameReader(int _width, int _height, PixelFormat _format, std::size_t bufferCount) :
+    width(_width),
+    height(_height),
+    format(_format),
+    // Rows are padded to the default GL_PACK_ALIGNMENT of four bytes
+    rowSize((_width * bytesPerPixel(_format) + 3) & ~3),
+    buffers(bufferCount)
+{
+#ifndef GL_ES
+    auto size = static_cast<GLsizeiptr>(rowSize) * height;
+    for (Buffer& buffer : buffers)
+    {
+        glGenBuffers(1, &buffer.pbo);
+        celestia::gl::bindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo);
+        celestia::gl::bufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    }
+    celestia::gl::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+#endif
+}
+
+FrameReader::~FrameReader()
+{
+#ifndef GL_ES
+    for (Buffer& buffer : buffers)
+    {
+        if (buffer.fence != nullptr)
+            glDeleteSync(buffer.fence);
+        celestia::gl::deleteBuffers(1, &buffer.pbo);
+    }
+#endif
+}
+
+bool FrameReader::isSupported()
+{
+#ifdef GL_ES
+    return false;
+#else
+    return celestia::gl::ARB_sync;
+#endif
+}
+
+bool FrameReader::isTopDown() const
+{
+    return celestia::gl::MESA_pack_invert;
+}
+
+bool FrameReader::read(int x, int y)
+{
+#ifdef GL_ES
+    return false;
+#else
+    if (full())
+        return false;
+
+    Buffer& buffer = buffers[(first + pendingCount) % buffers.size()];
+    celestia::gl::bindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo);
+    glReadPixels(x, y, width, height, static_cast<GLenum>(format), GL_UNSIGNED_BYTE, nullptr);
+    celestia::gl::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (glGetError() != GL_NO_ERROR)
+        return false;
+
+    buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pendingCount++;
+    return true;
+#endif
+}
+
+bool FrameReader::retrieve(bool wait, const std::function<void(const std::uint8_t*)>& consumer)
+{
+#ifdef GL_ES
+    return false;
+#else
+    if (pendingCount == 0)
+        return false;
+
+    Buffer& buffer = buffers[first];
+    if (buffer.fence != nullptr)
+    {
+        GLuint64 timeout = wait ? 1000000 : 0; // 1 ms
+        GLenum status;
+        do
+        {
+            status = glClientWaitSync(buffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        }
+        while (wait && status == GL_TIMEOUT_EXPIRED);
+
+        if (status == GL_TIMEOUT_EXPIRED)
+            return false;
+
+        glDeleteSync(buffer.fence);
+        buffer.fence = nullptr;
+    }
+
+    auto size = static_cast<GLsizeiptr>(rowSize) * height;
+    celestia::gl::bindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo);
+    const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (data != nullptr)
+    {
+        consumer(static_cast<const std::uint8_t*>(data));
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    celestia::gl::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    first = (first + 1) % buffers.size();
+    pendingCount--;
+    return data != nullptr;
+#endif
+}
@@ -0,0 +1,73 @@
+// framereader.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Asynchronous frame buffer readback.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "glsupport.h"
+#include "pixelformat.h"
+
+// FrameReader reads rectangles of the frame buffer through a ring of pixel
+// buffer objects. read() only queues the transfer; the pixels are retrieved
+// a few frames later, when the GPU has finished writing them, so that the
+// transfer overlaps with rendering instead of stalling it.
+//
+// The rows of a retrieved frame are bottom to top unless the
+// MESA_pack_invert extension is available, and each row is padded to a
+// multiple of four bytes.
+class FrameReader
+{
+ public:
+    FrameReader(int width, int height, celestia::PixelFormat format, std::size_t bufferCount = 3);
+    ~FrameReader();
+    FrameReader(const FrameReader&) = delete;
+    FrameReader& operator=(const FrameReader&) = delete;
+
+    // Return true if the OpenGL implementation supports pixel buffer
+    // objects and fences
+    static bool isSupported();
+
+    // Start reading the rectangle of the frame buffer with the lower left
+    // corner at x, y. Returns false if every buffer holds a frame which
+    // hasn't been retrieved yet.
+    bool read(int x, int y);
+
+    // Pass the pixels of the oldest frame read to consumer, waiting for the
+    // transfer to complete if wait is set. Returns false if no frame is
+    // pending or, without wait, if the oldest one isn't available yet.
+    bool retrieve(bool wait, const std::function<void(const std::uint8_t*)>& consumer);
+
+    std::size_t pending() const { return pendingCount; }
+    bool full() const { return pendingCount == buffers.size(); }
+
+    int getRowSize() const { return rowSize; }
+    bool isTopDown() const;
+
+ private:
+    struct Buffer
+    {
+        GLuint pbo{ 0 };
+        GLsync fence{ nullptr };
+    };
+
+    int width;
+    int height;
+    celestia::PixelFormat format;
+    int rowSize;
+
+    std::vector<Buffer> buffers;
+    // Index of the oldest pending buffer and number of pending buffers
+    std::size_t first{ 0 };
+    std::size_t pendingCount{ 0 };
+};
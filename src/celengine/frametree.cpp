@@ -122,15 +122,20 @@ FrameTree::recomputeBoundingSphere()
     {
         m_boundingSphereRadius = 0.0;
         m_maxChildRadius = 0.0;
+        m_maxChildCullingRadius = 0.0;
         m_containsSecondaryIlluminators = false;
         m_childClassMask = 0;
+        m_childBounds.clear();
+        m_childBounds.reserve(children.size());
 
         for (const auto &phase : children)
         {
             double bodyRadius = phase->body()->getRadius();
             double r = phase->body()->getCullingRadius() + phase->orbit()->getBoundingRadius();
+            ChildBounds bounds;
+            bounds.maxCullingRadius = phase->body()->getCullingRadius();
+            bounds.secondaryIlluminators = phase->body()->isSecondaryIlluminator();
             m_maxChildRadius = max(m_maxChildRadius, bodyRadius);
-            m_containsSecondaryIlluminators = m_containsSecondaryIlluminators || phase->body()->isSecondaryIlluminator();
             m_childClassMask |= phase->body()->getClassification();
 
             FrameTree* tree = phase->body()->getFrameTree();
@@ -139,11 +144,16 @@ FrameTree::recomputeBoundingSphere()
                 tree->recomputeBoundingSphere();
                 r += tree->m_boundingSphereRadius;
                 m_maxChildRadius = max(m_maxChildRadius, tree->m_maxChildRadius);
-                m_containsSecondaryIlluminators = m_containsSecondaryIlluminators || tree->containsSecondaryIlluminators();
+                bounds.maxCullingRadius = max(bounds.maxCullingRadius, tree->m_maxChildCullingRadius);
+                bounds.secondaryIlluminators = bounds.secondaryIlluminators || tree->containsSecondaryIlluminators();
                 m_childClassMask |= tree->childClassMask();
             }
 
+            bounds.radius = r;
+            m_childBounds.push_back(bounds);
             m_boundingSphereRadius = max(m_boundingSphereRadius, r);
+            m_maxChildCullingRadius = max(m_maxChildCullingRadius, bounds.maxCullingRadius);
+            m_containsSecondaryIlluminators = m_containsSecondaryIlluminators || bounds.secondaryIlluminators;
         }
     }
 }
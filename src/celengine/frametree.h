@@ -25,6 +25,20 @@ class Body;
 class FrameTree
 {
 public:
+    /*! Bounds of a child and everything orbiting it, used to cull the
+     *  child before its orbit is evaluated.
+     */
+    struct ChildBounds
+    {
+        // Radius of a sphere around the frame origin containing the
+        // child's orbit and its subtree
+        double radius;
+        // Largest culling radius of the child and the bodies in its subtree
+        double maxCullingRadius;
+        // Whether the child or its subtree contain secondary illuminators
+        bool secondaryIlluminators;
+    };
+
     FrameTree(Star*);
     FrameTree(Body*);
     ~FrameTree() = default;
@@ -73,6 +87,22 @@ public:
         return m_maxChildRadius;
     }
 
+    /*! Get the largest culling radius of the bodies in the tree; unlike
+     *  maxChildRadius() this includes atmospheres, rings and comet tails.
+     */
+    double maxChildCullingRadius() const
+    {
+        return m_maxChildCullingRadius;
+    }
+
+    /*! Return the bounds of child n, or nullptr if they haven't been
+     *  computed since the tree last changed.
+     */
+    const ChildBounds* getChildBounds(unsigned int n) const
+    {
+        return m_changed || n >= m_childBounds.size() ? nullptr : &m_childBounds[n];
+    }
+
     /*! Return whether any of the children of this frame
      *  are secondary illuminators.
      */
@@ -96,6 +126,8 @@ private:
 
     double m_boundingSphereRadius{ 0.0 };
     double m_maxChildRadius{ 0.0 };
+    double m_maxChildCullingRadius{ 0.0 };
+    std::vector<ChildBounds> m_childBounds;
     bool m_containsSecondaryIlluminators{ false };
     bool m_changed{ false };
     int m_childClassMask{ 0 };
@@ -11,20 +11,35 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
 #include <iterator>
+#include <limits>
 #include <map>
+#include <memory>
 #include <optional>
 #include <ostream>
+#include <random>
+#include <system_error>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#include <fmt/format.h>
 #include <fmt/printf.h>
 
 #include <celmath/ellipsoid.h>
 #include <celmath/intersect.h>
 #include <celmath/randutils.h>
 #include <celmath/ray.h>
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
+#include <celutil/cachekey.h>
 #include <celutil/gettext.h>
+#include <celutil/jobsystem.h>
 #include <celutil/logger.h>
 #include "galaxy.h"
 #include "glsupport.h"
@@ -33,6 +48,8 @@
 #include "render.h"
 #include "texture.h"
 #include "vecgl.h"
+#include "vertexobject.h"
+#include "glstate.h"
 
 namespace vecgl = celestia::vecgl;
 
@@ -58,6 +75,8 @@ class GalacticForm
 public:
     BlobVector blobs;
     Eigen::Vector3f scale;
+    // Sprites of all blobs, created the first time the form is drawn
+    mutable std::unique_ptr<celgl::VertexObject> vo;
 };
 
 constexpr int width = 128;
@@ -69,8 +88,6 @@ constexpr unsigned int GALAXY_POINTS = 3500;
 constexpr float RADIUS_CORRECTION     = 0.025f;
 constexpr float MAX_SPIRAL_THICKNESS  = 0.06f;
 
-bool formsInitialized = false;
-
 Texture* galaxyTex = nullptr;
 Texture* colorTex  = nullptr;
 
@@ -130,105 +147,218 @@ void colorTextureEval(float u, float /*v*/, float /*w*/, std::uint8_t *pixel)
     pixel[2] = static_cast<std::uint8_t>(b * 255.99f);
 }
 
+constexpr float spriteScaleFactor = 1.0f / 1.55f;
+
 struct GalaxyVertex
 {
-    Eigen::Vector4f position;
-    Eigen::Matrix<GLushort, 4, 1> texCoord; // texCoord.x = x, texCoord.y = y, texCoord.z = color index, texCoord.w = alpha
+    Eigen::Vector3f position;
+    // texCoord.x = quad corner, texCoord.y = sprite level,
+    // texCoord.z = color index, texCoord.w = brightness
+    Eigen::Matrix<GLubyte, 4, 1> texCoord;
 };
 
-void draw(const GalaxyVertex *v, std::size_t count, const GLushort *indices)
+// Build two triangles for the sprite of each blob. The sprite size is
+// divided by spriteScaleFactor at every power of two of the blob index,
+// which the shader computes from the sprite level.
+void initGalaxyData(celgl::VertexObject& vo, const BlobVector& points)
 {
-    glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
-                          4, GL_FLOAT, GL_FALSE,
-                          sizeof(GalaxyVertex), v[0].position.data());
-    glVertexAttribPointer(CelestiaGLProgram::TextureCoord0AttributeIndex,
-                          4, GL_UNSIGNED_SHORT, GL_FALSE,
-                          sizeof(GalaxyVertex), v[0].texCoord.data());
-    glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_SHORT, indices);
+    constexpr GLubyte quadCorners[] = { 0, 1, 2, 0, 2, 3 };
+
+    std::vector<GalaxyVertex> vertices;
+    vertices.reserve(points.size() * std::size(quadCorners));
+
+    GLubyte level = 0;
+    std::size_t pow2 = 1;
+    for (std::size_t i = 0; i < points.size(); ++i)
+    {
+        if ((i & pow2) != 0)
+        {
+            pow2 <<= 1;
+            ++level;
+        }
+
+        const Blob& b = points[i];
+        auto color = static_cast<GLubyte>(b.colorIndex);
+        auto brightness = static_cast<GLubyte>(std::clamp(b.brightness, 0.0f, 255.0f));
+        for (GLubyte corner : quadCorners)
+            vertices.push_back({ b.position.head<3>(), { corner, level, color, brightness } });
+    }
+
+    vo.allocate(vertices.size() * sizeof(GalaxyVertex), vertices.data());
+    vo.setVertices(3, GL_FLOAT, false, sizeof(GalaxyVertex), offsetof(GalaxyVertex, position));
+    vo.setTextureCoords(4, GL_UNSIGNED_BYTE, false, sizeof(GalaxyVertex), offsetof(GalaxyVertex, texCoord));
 }
 
-GalaxyVertex *g_vertices = nullptr;
-GLushort *g_indices = nullptr;
-constexpr const std::size_t maxPoints = 8192; // 256k buffer
+// Bump when the generation of the forms changes, so that forms generated
+// by an older version aren't loaded from the cache.
+constexpr std::uint32_t GalacticFormCacheRevision = 1;
+constexpr char GalacticFormCacheMagic[8] = { 'C', 'E', 'L', 'G', 'A', 'L', 'F', '\0' };
+constexpr const char* GalacticFormCacheExtension = ".galaxy";
+
+// Seed of the random streams of the standard forms; each form uses its own
+// streams, so that the forms stay the same from run to run
+constexpr std::uint64_t GalacticFormSeed = UINT64_C(0x6a09e667f3bcc908);
 
-std::optional<GalacticForm> buildGalacticForm(const fs::path& filename)
+// The irregular form is generated in this many parts, whatever the number
+// of threads
+constexpr unsigned int IrregularFormStreams = 16;
+constexpr std::size_t ImageRowsPerJob = 8;
+
+fs::path galacticFormCacheDir;
+
+enum class FormKind
 {
-    Blob b;
-    BlobVector galacticPoints;
+    Irregular,
+    Image,
+    Elliptical,
+};
 
-    // Load templates in standard .png format
-    int width, height, rgb, j = 0, kmin = 9;
-    unsigned char value;
-    float h = 0.75f;
-    Image* img = LoadImageFromFile(filename);
-    if (img == nullptr)
-    {
-        celestia::util::GetLogger()->error("The galaxy template *** {} *** could not be loaded!\n", filename);
-        return std::nullopt;
-    }
-    width  = img->getWidth();
-    height = img->getHeight();
-    rgb    = img->getComponents();
+// What a form is generated from; forms are only generated when a galaxy
+// using them is first drawn
+struct FormSource
+{
+    FormKind kind;
+    fs::path image;
+    std::uint64_t seed;
+    Eigen::Vector3f scale;
+};
 
-    auto& rng = celmath::getRNG();
-    for (int i = 0; i < width * height; i++)
+BlobVector buildIrregularBlobs(std::uint64_t seed)
+{
+    std::vector<BlobVector> parts(IrregularFormStreams);
+    celestia::util::ParallelFor(0, IrregularFormStreams, 1, [&](std::size_t first, std::size_t last)
     {
-        value = img->getPixels()[rgb * i];
-        if (value > 10)
+        std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        for (std::size_t part = first; part < last; ++part)
         {
-            float idxf = static_cast<float>(i);
-            float wf = static_cast<float>(width);
-            float hf = static_cast<float>(height);
-            float z = std::floor(idxf / wf);
-            float x = (idxf - wf * z - 0.5f * (wf - 1.0f)) / wf;
-            z  = (0.5f * (hf - 1.0f) - z) / hf;
-            x  += celmath::RealDists<float>::SignedUnit(rng) * 0.008f;
-            z  += celmath::RealDists<float>::SignedUnit(rng) * 0.008f;
-            float r2 = x * x + z * z;
-
-            float y;
-            if (filename != "models/E0.png")
-            {
-                float y0 = 0.5f * MAX_SPIRAL_THICKNESS * std::sqrt(static_cast<float>(value)/256.0f) * std::exp(- 5.0f * r2);
-                float B = (r2 > 0.35f) ? 1.0f: 0.75f; // the darkness of the "dust lane", 0 < B < 1
-                float p0 = 1.0f - B * std::exp(-h * h); // the uniform reference probability, envelopping prob*p0.
-                float yr, prob;
-                do
-                {
-                    // generate "thickness" y of spirals with emulation of a dust lane
-                    // in galctic plane (y=0)
-
-                    yr =  celmath::RealDists<float>::SignedUnit(rng) * h;
-                    prob = (1.0f - B * exp(-yr * yr))/p0;
-                } while (celmath::RealDists<float>::Unit(rng) > prob);
-                b.brightness  = value * prob;
-                y = y0 * yr / h;
-            }
-            else
+            celmath::CounterRNG rng(seed, part);
+            std::size_t count = GALAXY_POINTS * (part + 1) / IrregularFormStreams
+                              - GALAXY_POINTS * part / IrregularFormStreams;
+            BlobVector& points = parts[part];
+            points.reserve(count);
+            while (points.size() < count)
             {
-                // generate spherically symmetric distribution from E0.png
-                float yy, prob;
-                do
+                Eigen::Vector3f p(signedUnit(rng), signedUnit(rng), signedUnit(rng));
+                float r  = p.norm();
+                if (r >= 1)
+                    continue;
+
+                float prob = (1 - r) * (celmath::fractalsum(Eigen::Vector3f(p.x() + 5, p.y() + 5, p.z() + 5), 8) + 1) * 0.5f;
+                if (unit(rng) < prob)
                 {
-                    yy = celmath::RealDists<float>::SignedUnit(rng);
-                    float ry2 = 1.0f - yy * yy;
-                    prob = ry2 > 0 ? std::sqrt(ry2): 0.0f;
-                } while (celmath::RealDists<float>::Unit(rng) > prob);
-                y = yy * std::sqrt(0.25f - r2) ;
-                b.brightness  = value;
-                kmin = 12;
+                    Blob b;
+                    b.position   = Eigen::Vector4f(p.x(), p.y(), p.z(), 1.0f);
+                    b.brightness = 64u;
+                    auto rr      = static_cast<unsigned int>(r * 511);
+                    b.colorIndex = rr < 256 ? rr : 255;
+                    points.push_back(b);
+                }
             }
+        }
+    });
+
+    BlobVector irregularPoints;
+    irregularPoints.reserve(GALAXY_POINTS);
+    for (const BlobVector& part : parts)
+        irregularPoints.insert(irregularPoints.end(), part.begin(), part.end());
+    return irregularPoints;
+}
+
+// Generate the blobs of the pixels of a row of a form template, with a
+// random stream of its own
+void buildImageRow(Image& img, int row, bool spherical, std::uint64_t seed, BlobVector& points)
+{
+    constexpr float h = 0.75f;
+
+    std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    celmath::CounterRNG rng(seed, static_cast<std::uint64_t>(row));
 
-            b.position    = Eigen::Vector4f(x, y, z, 1.0f);
-            unsigned int rr =  static_cast<unsigned int>(b.position.head(3).norm() * 511);
-            b.colorIndex  = rr < 256 ? rr : 255;
-            galacticPoints.push_back(b);
-            j++;
+    int width = img.getWidth();
+    int rgb = img.getComponents();
+    float wf = static_cast<float>(width);
+    float hf = static_cast<float>(img.getHeight());
+    const unsigned char* pixels = img.getPixels() + static_cast<std::size_t>(row) * width * rgb;
+    for (int col = 0; col < width; col++)
+    {
+        unsigned char value = pixels[rgb * col];
+        if (value <= 10)
+            continue;
+
+        float x = (static_cast<float>(col) - 0.5f * (wf - 1.0f)) / wf;
+        float z = (0.5f * (hf - 1.0f) - static_cast<float>(row)) / hf;
+        x  += signedUnit(rng) * 0.008f;
+        z  += signedUnit(rng) * 0.008f;
+        float r2 = x * x + z * z;
+
+        Blob b;
+        float y;
+        if (!spherical)
+        {
+            float y0 = 0.5f * MAX_SPIRAL_THICKNESS * std::sqrt(static_cast<float>(value)/256.0f) * std::exp(- 5.0f * r2);
+            float B = (r2 > 0.35f) ? 1.0f: 0.75f; // the darkness of the "dust lane", 0 < B < 1
+            float p0 = 1.0f - B * std::exp(-h * h); // the uniform reference probability, envelopping prob*p0.
+            float yr, prob;
+            do
+            {
+                // generate "thickness" y of spirals with emulation of a dust lane
+                // in galctic plane (y=0)
+
+                yr =  signedUnit(rng) * h;
+                prob = (1.0f - B * exp(-yr * yr))/p0;
+            } while (unit(rng) > prob);
+            b.brightness  = value * prob;
+            y = y0 * yr / h;
+        }
+        else
+        {
+            // generate spherically symmetric distribution from E0.png
+            float yy, prob;
+            do
+            {
+                yy = signedUnit(rng);
+                float ry2 = 1.0f - yy * yy;
+                prob = ry2 > 0 ? std::sqrt(ry2): 0.0f;
+            } while (unit(rng) > prob);
+            y = yy * std::sqrt(0.25f - r2) ;
+            b.brightness  = value;
         }
+
+        b.position    = Eigen::Vector4f(x, y, z, 1.0f);
+        unsigned int rr =  static_cast<unsigned int>(b.position.head(3).norm() * 511);
+        b.colorIndex  = rr < 256 ? rr : 255;
+        points.push_back(b);
+    }
+}
+
+std::optional<BlobVector> buildImageBlobs(const fs::path& filename, std::uint64_t seed)
+{
+    // Load templates in standard .png format
+    std::unique_ptr<Image> img(LoadImageFromFile(filename));
+    if (img == nullptr)
+    {
+        celestia::util::GetLogger()->error("The galaxy template *** {} *** could not be loaded!\n", filename);
+        return std::nullopt;
     }
 
-    delete img;
-    galacticPoints.reserve(j);
+    bool spherical = filename == "models/E0.png";
+    int height = img->getHeight();
+    std::vector<BlobVector> rows(static_cast<std::size_t>(height));
+    celestia::util::ParallelFor(0, rows.size(), ImageRowsPerJob, [&](std::size_t first, std::size_t last)
+    {
+        for (std::size_t row = first; row < last; ++row)
+            buildImageRow(*img, static_cast<int>(row), spherical, seed, rows[row]);
+    });
+
+    std::size_t count = 0;
+    for (const BlobVector& row : rows)
+        count += row.size();
+
+    BlobVector galacticPoints;
+    galacticPoints.reserve(count);
+    for (const BlobVector& row : rows)
+        galacticPoints.insert(galacticPoints.end(), row.begin(), row.end());
 
     // sort to start with the galaxy center region (x^2 + y^2 + z^2 ~ 0), such that
     // the biggest (brightest) sprites will be localized there!
@@ -238,11 +368,120 @@ std::optional<GalacticForm> buildGalacticForm(const fs::path& filename)
     // reshuffle the galaxy points randomly...except the first kmin+1 in the center!
     // the higher that number the stronger the central "glow"
 
-    std::shuffle(galacticPoints.begin() + kmin, galacticPoints.end(), celmath::getRNG());
+    std::size_t kmin = spherical ? 12 : 9;
+    if (galacticPoints.size() > kmin)
+    {
+        std::shuffle(galacticPoints.begin() + kmin, galacticPoints.end(),
+                     celmath::CounterRNG(seed, static_cast<std::uint64_t>(height)));
+    }
+
+    return galacticPoints;
+}
+
+// Name of the cached blobs of a form, which changes whenever its template
+// is modified
+fs::path getFormCachePath(const FormSource& source)
+{
+    celestia::util::CacheKey key;
+    key.add(GalacticFormCacheRevision);
+    key.add(static_cast<std::uint64_t>(source.kind));
+    key.add(source.seed);
+    key.add(GALAXY_POINTS);
+    if (source.kind != FormKind::Irregular)
+        key.addFile(source.image);
+
+    return galacticFormCacheDir / fmt::format("{:016x}{}", key.value(), GalacticFormCacheExtension);
+}
+
+bool loadCachedBlobs(const fs::path& cachePath, BlobVector& blobs)
+{
+    std::ifstream in(cachePath, std::ios::in | std::ios::binary);
+    if (!in.good())
+        return false;
+
+    char magic[sizeof(GalacticFormCacheMagic)];
+    std::uint32_t blobSize;
+    std::uint64_t count;
+    if (!in.read(magic, sizeof(magic))
+        || std::memcmp(magic, GalacticFormCacheMagic, sizeof(magic)) != 0
+        || !celestia::util::readNative(in, blobSize)
+        || blobSize != sizeof(Blob)
+        || !celestia::util::readNative(in, count)
+        || count > std::numeric_limits<std::uint32_t>::max())
+    {
+        return false;
+    }
+
+    blobs.resize(static_cast<std::size_t>(count));
+    if (!in.read(reinterpret_cast<char*>(blobs.data()), static_cast<std::streamsize>(count * sizeof(Blob))))
+    {
+        blobs.clear();
+        return false;
+    }
+
+    return true;
+}
+
+void saveCachedBlobs(const BlobVector& blobs, const fs::path& cachePath)
+{
+    // Write to a file of its own and rename it into place when complete, so
+    // that another instance never reads a partial file
+    fs::path tempPath = cachePath;
+    tempPath += fmt::format(".{:x}", std::hash<std::thread::id>()(std::this_thread::get_id()));
+
+    bool saved;
+    {
+        std::ofstream out(tempPath, std::ios::out | std::ios::binary);
+        saved = out.write(GalacticFormCacheMagic, sizeof(GalacticFormCacheMagic))
+             && celestia::util::writeNative(out, static_cast<std::uint32_t>(sizeof(Blob)))
+             && celestia::util::writeNative(out, static_cast<std::uint64_t>(blobs.size()))
+             && out.write(reinterpret_cast<const char*>(blobs.data()),
+                          static_cast<std::streamsize>(blobs.size() * sizeof(Blob)));
+    }
+
+    std::error_code ec;
+    if (saved)
+        fs::rename(tempPath, cachePath, ec);
+    if (!saved || ec)
+    {
+        celestia::util::GetLogger()->warn("Failed to write galaxy form cache file {}\n", cachePath);
+        fs::remove(tempPath, ec);
+    }
+}
+
+std::optional<GalacticForm> buildGalacticForm(const FormSource& source)
+{
+    fs::path cachePath;
+    if (!galacticFormCacheDir.empty())
+        cachePath = getFormCachePath(source);
 
     std::optional<GalacticForm> galacticForm(std::in_place);
-    galacticForm->blobs = std::move(galacticPoints);
-    galacticForm->scale = Eigen::Vector3f::Ones();
+    galacticForm->scale = source.scale;
+    if (!cachePath.empty() && loadCachedBlobs(cachePath, galacticForm->blobs))
+        return galacticForm;
+
+    if (source.kind == FormKind::Irregular)
+    {
+        galacticForm->blobs = buildIrregularBlobs(source.seed);
+    }
+    else
+    {
+        std::optional<BlobVector> blobs = buildImageBlobs(source.image, source.seed);
+        if (!blobs.has_value())
+            return std::nullopt;
+        galacticForm->blobs = std::move(*blobs);
+    }
+
+    if (source.kind == FormKind::Elliptical)
+    {
+        for (Blob& blob : galacticForm->blobs)
+        {
+            blob.colorIndex = static_cast<unsigned int>(std::ceil(0.76f * static_cast<float>(blob.colorIndex)));
+        }
+    }
+
+    if (!cachePath.empty())
+        saveCachedBlobs(galacticForm->blobs, cachePath);
 
     return galacticForm;
 }
@@ -258,21 +497,36 @@ class GalacticFormManager
         initializeStandardForms();
     }
 
-    const GalacticForm* getForm(std::size_t) const;
+    const GalacticForm* getForm(std::size_t);
     std::size_t getCustomForm(const fs::path& path);
 
  private:
+    struct FormEntry
+    {
+        FormSource source;
+        std::optional<GalacticForm> form{ };
+        bool built{ false };
+    };
+
     void initializeStandardForms();
 
-    std::vector<std::optional<GalacticForm>> galacticForms{ };
+    std::vector<FormEntry> galacticForms{ };
     std::map<fs::path, std::size_t> customForms{ };
 };
 
-const GalacticForm* GalacticFormManager::getForm(std::size_t form) const
+// Generate the form the first time it's used
+const GalacticForm* GalacticFormManager::getForm(std::size_t form)
 {
     assert(form < galacticForms.size());
-    return galacticForms[form].has_value()
-        ? &*galacticForms[form]
+    FormEntry& entry = galacticForms[form];
+    if (!entry.built)
+    {
+        entry.form = buildGalacticForm(entry.source);
+        entry.built = true;
+    }
+
+    return entry.form.has_value()
+        ? &*entry.form
         : nullptr;
 }
 
@@ -286,56 +540,29 @@ std::size_t GalacticFormManager::getCustomForm(const fs::path& path)
 
     std::size_t result = galacticForms.size();
     customForms[path] = result;
-    galacticForms.push_back(buildGalacticForm(path));
+
+    celestia::util::CacheKey seed;
+    seed.add(GalacticFormSeed);
+    seed.add(path.generic_string());
+    galacticForms.push_back({ { FormKind::Image, path, seed.value(), Eigen::Vector3f::Ones() } });
     return result;
 }
 
 void GalacticFormManager::initializeStandardForms()
 {
+    galacticForms.reserve(GalacticFormsReserve);
+
     // Irregular Galaxies
-    unsigned int galaxySize = GALAXY_POINTS, ip = 0;
-    Blob b;
-    Eigen::Vector3f p;
+    galacticForms.push_back({ { FormKind::Irregular, fs::path(), GalacticFormSeed, Eigen::Vector3f::Constant(0.5f) } });
 
-    BlobVector irregularPoints;
-    irregularPoints.reserve(galaxySize);
+    // Spiral Galaxies, 7 classical Hubble types
 
-    auto& rng = celmath::getRNG();
-    while (ip < galaxySize)
+    for (const char* image : { "models/S0.png", "models/Sa.png", "models/Sb.png", "models/Sc.png",
+                               "models/SBa.png", "models/SBb.png", "models/SBc.png" })
     {
-        p = Eigen::Vector3f(celmath::RealDists<float>::SignedUnit(rng),
-                            celmath::RealDists<float>::SignedUnit(rng),
-                            celmath::RealDists<float>::SignedUnit(rng));
-        float r  = p.norm();
-        if (r < 1)
-        {
-            float prob = (1 - r) * (celmath::fractalsum(Eigen::Vector3f(p.x() + 5, p.y() + 5, p.z() + 5), 8) + 1) * 0.5f;
-            if (celmath::RealDists<float>::Unit(rng) < prob)
-            {
-                b.position   = Eigen::Vector4f(p.x(), p.y(), p.z(), 1.0f);
-                b.brightness = 64u;
-                auto rr      = static_cast<unsigned int>(r * 511);
-                b.colorIndex = rr < 256 ? rr : 255;
-                irregularPoints.push_back(b);
-                ++ip;
-            }
-        }
+        galacticForms.push_back({ { FormKind::Image, image, GalacticFormSeed + galacticForms.size(), Eigen::Vector3f::Ones() } });
     }
 
-    std::optional<GalacticForm>& irregularForm = galacticForms.emplace_back(std::in_place);
-    irregularForm->blobs = std::move(irregularPoints);
-    irregularForm->scale = Eigen::Vector3f::Constant(0.5f);
-
-    // Spiral Galaxies, 7 classical Hubble types
-
-    galacticForms.push_back(buildGalacticForm("models/S0.png"));
-    galacticForms.push_back(buildGalacticForm("models/Sa.png"));
-    galacticForms.push_back(buildGalacticForm("models/Sb.png"));
-    galacticForms.push_back(buildGalacticForm("models/Sc.png"));
-    galacticForms.push_back(buildGalacticForm("models/SBa.png"));
-    galacticForms.push_back(buildGalacticForm("models/SBb.png"));
-    galacticForms.push_back(buildGalacticForm("models/SBc.png"));
-
     // Elliptical Galaxies , 8 classical Hubble types, E0..E7,
     //
     // To save space: generate spherical E0 template from S0 disk
@@ -347,21 +574,9 @@ void GalacticFormManager::initializeStandardForms()
 
         // note the correct x,y-alignment of 'ell' scaling!!
         // build all elliptical templates from rescaling E0
-        std::optional<GalacticForm> ellipticalForm = buildGalacticForm("models/E0.png");
-        if (ellipticalForm.has_value())
-        {
-            ellipticalForm->scale = Eigen::Vector3f(ell, ell, 1.0f);
-
-            for (Blob& blob : ellipticalForm->blobs)
-            {
-                blob.colorIndex = static_cast<unsigned int>(std::ceil(0.76f * static_cast<float>(blob.colorIndex)));
-            }
-        }
-
-        galacticForms.push_back(std::move(ellipticalForm));
+        galacticForms.push_back({ { FormKind::Elliptical, "models/E0.png", GalacticFormSeed + galacticForms.size(),
+                                    Eigen::Vector3f(ell, ell, 1.0f) } });
     }
-
-    formsInitialized = true;
 }
 
 GalacticFormManager* getGalacticFormManager()
@@ -471,9 +686,6 @@ void Galaxy::render(const Eigen::Vector3f& offset,
                     const Matrices& ms,
                     Renderer* renderer)
 {
-    const GalacticForm* galacticForm = getGalacticFormManager()->getForm(form);
-    if (galacticForm == nullptr) { return; }
-
     /* We'll first see if the galaxy's apparent size is big enough to
        be noticeable on screen; if it's not we'll break right here,
        avoiding all the overhead of the matrix transformations and
@@ -488,6 +700,10 @@ void Galaxy::render(const Eigen::Vector3f& offset,
     if (size < minimumFeatureSize)
         return;
 
+    // Forms are generated when a galaxy using them is first big enough
+    const GalacticForm* galacticForm = getGalacticFormManager()->getForm(form);
+    if (galacticForm == nullptr) { return; }
+
     auto *prog = renderer->getShaderManager().getShader("galaxy");
     if (prog == nullptr)
         return;
@@ -498,7 +714,7 @@ void Galaxy::render(const Eigen::Vector3f& offset,
                                             galaxyTextureEval);
     }
     assert(galaxyTex != nullptr);
-    glActiveTexture(GL_TEXTURE0);
+    celestia::gl::activeTexture(GL_TEXTURE0);
     galaxyTex->bind();
 
     if (colorTex == nullptr)
@@ -509,31 +725,32 @@ void Galaxy::render(const Eigen::Vector3f& offset,
                                            Texture::NoMipMaps);
     }
     assert(colorTex != nullptr);
-    glActiveTexture(GL_TEXTURE1);
+    celestia::gl::activeTexture(GL_TEXTURE1);
     colorTex->bind();
 
     Eigen::Matrix3f viewMat = viewerOrientation.conjugate().toRotationMatrix();
-    Eigen::Vector4f v0(Eigen::Vector4f::Zero());
-    Eigen::Vector4f v1(Eigen::Vector4f::Zero());
-    Eigen::Vector4f v2(Eigen::Vector4f::Zero());
-    Eigen::Vector4f v3(Eigen::Vector4f::Zero());
-    v0.head(3) = viewMat * Eigen::Vector3f(-1, -1, 0) * size;
-    v1.head(3) = viewMat * Eigen::Vector3f( 1, -1, 0) * size;
-    v2.head(3) = viewMat * Eigen::Vector3f( 1,  1, 0) * size;
-    v3.head(3) = viewMat * Eigen::Vector3f(-1,  1, 0) * size;
 
     Eigen::Quaternionf orientation = getOrientation().conjugate();
     Eigen::Matrix3f mScale = galacticForm->scale.asDiagonal() * size;
     Eigen::Matrix3f mLinear = orientation.toRotationMatrix() * mScale;
 
-    Eigen::Matrix4f m = Eigen::Matrix4f::Identity();
-    m.topLeftCorner(3,3) = mLinear;
-    m.block<3,1>(0, 3) = offset;
+    const BlobVector& points = galacticForm->blobs;
+    float detailFraction = std::clamp(getDetail() * renderer->getDetailScale(), 0.0f, 1.0f);
+    unsigned int nPoints = static_cast<unsigned int>(points.size() * detailFraction);
 
-    int pow2 = 1;
+    // Sprites shrink at every power of two of the blob index; skip the
+    // blobs whose sprites are smaller than a feature on the screen.
+    float spriteSize = size;
+    for (unsigned int pow2 = 1; pow2 < nPoints; pow2 <<= 1)
+    {
+        spriteSize *= spriteScaleFactor;
+        if (spriteSize < minimumFeatureSize)
+        {
+            nPoints = pow2;
+            break;
+        }
+    }
 
-    const BlobVector& points = galacticForm->blobs;
-    unsigned int nPoints = static_cast<unsigned int>(points.size() * std::clamp(getDetail(), 0.0f, 1.0f));
     // corrections to avoid excessive brightening if viewed e.g. edge-on
 
     float brightness_corr = 1.0f;
@@ -557,20 +774,21 @@ void Galaxy::render(const Eigen::Vector3f& offset,
     Eigen::Matrix4f mv = vecgl::translate(*ms.modelview, Eigen::Vector3f(-offset));
 
     const float btot = (type == GalaxyType::Irr || type >= GalaxyType::E0) ? 2.5f : 5.0f;
-    const float spriteScaleFactor = 1.0f / 1.55f;
 
-    glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
-    glEnableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
-
-    if (g_vertices == nullptr)
-        g_vertices = new GalaxyVertex[maxPoints];
-    if (g_indices == nullptr)
-        g_indices = new GLushort[(maxPoints / 4 + 1) * 6];
-
-    GLushort j = 0;
+    if (galacticForm->vo == nullptr)
+        galacticForm->vo = std::make_unique<celgl::VertexObject>(GL_ARRAY_BUFFER, 0, GL_STATIC_DRAW);
+    celgl::VertexObject& vo = *galacticForm->vo;
+    vo.bind();
+    if (!vo.initialized())
+        initGalaxyData(vo, points);
 
     prog->use();
     prog->setMVPMatrices(*ms.projection, mv);
+    prog->mat3Param("m") = mLinear;
+    prog->vec3Param("offset") = offset;
+    prog->mat3Param("viewMat") = viewMat;
+    prog->floatParam("size") = size;
+    prog->floatParam("alphaScale") = (4.0f * lightGain + 1.0f) * btot * brightness_corr * brightness;
     prog->samplerParam("galaxyTex") = 0;
     prog->samplerParam("colorTex") = 1;
 
@@ -580,60 +798,21 @@ void Galaxy::render(const Eigen::Vector3f& offset,
     ps.smoothLines = true;
     renderer->setPipelineState(ps);
 
-    std::size_t vertex = 0, index = 0;
-    for (unsigned int i = 0; i < nPoints; ++i)
-    {
-        if ((i & pow2) != 0)
-        {
-            pow2 <<= 1;
-            size *= spriteScaleFactor;
-            v0 *= spriteScaleFactor;
-            v1 *= spriteScaleFactor;
-            v2 *= spriteScaleFactor;
-            v3 *= spriteScaleFactor;
-            if (size < minimumFeatureSize)
-                break;
-        }
-
-        const Blob& b = points[i];
-        Eigen::Vector4f p  = m * b.position;
-        float br = b.brightness / 255.0f;
+    vo.draw(GL_TRIANGLES, static_cast<GLsizei>(nPoints * 6));
 
-        float screenFrac = size / p.norm();
-        if (screenFrac < 0.1f)
-        {
-            float a = (4.0f * lightGain + 1.0f) * btot * (0.1f - screenFrac) * brightness_corr * brightness * br;
-            GLushort alpha = static_cast<GLushort>(std::min(1.0f, a) * 65535.99f);
-            GLushort color = static_cast<GLushort>(b.colorIndex);
-            g_vertices[vertex++] = { p + v0, { 0, 0, color, alpha } };
-            g_vertices[vertex++] = { p + v1, { 1, 0, color, alpha } };
-            g_vertices[vertex++] = { p + v2, { 1, 1, color, alpha } };
-            g_vertices[vertex++] = { p + v3, { 0, 1, color, alpha } };
-
-            g_indices[index++] = j;
-            g_indices[index++] = j + 1;
-            g_indices[index++] = j + 2;
-            g_indices[index++] = j;
-            g_indices[index++] = j + 2;
-            g_indices[index++] = j + 3;
-            j += 4;
-
-            if (vertex + 4 > maxPoints)
-            {
-                draw(g_vertices, index, g_indices);
-                index = 0;
-                vertex = 0;
-                j = 0;
-            }
-        }
-    }
+    vo.unbind();
+    celestia::gl::activeTexture(GL_TEXTURE0);
+}
 
-    if (index > 0)
-        draw(g_vertices, index, g_indices);
+float Galaxy::getImpostorRadius() const
+{
+    // Sprites near the edge extend up to about twice the radius beyond it
+    return 3.0f * getRadius();
+}
 
-    glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
-    glDisableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
-    glActiveTexture(GL_TEXTURE0);
+float Galaxy::getImpostorBrightness(float brightness) const
+{
+    return (4.0f * lightGain + 1.0f) * brightness;
 }
 
 std::uint64_t Galaxy::getRenderMask() const
@@ -670,6 +849,19 @@ void Galaxy::setLightGain(float lg)
     lightGain = std::clamp(lg, 0.0f, 1.0f);
 }
 
+void Galaxy::setFormCache(const fs::path& dir)
+{
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec)
+    {
+        celestia::util::GetLogger()->error("Failed to create galaxy form cache directory {}\n", dir);
+        return;
+    }
+
+    galacticFormCacheDir = dir;
+}
+
 std::ostream& operator<<(std::ostream& s, const GalaxyType& sc)
 {
     return s << GalaxyTypeNames[static_cast<std::size_t>(sc)].name;
@@ -67,19 +67,29 @@ class Galaxy : public DeepSkyObject
                 const Matrices& m,
                 Renderer* r) override;
 
+    float getImpostorRadius() const override;
+    float getImpostorBrightness(float brightness) const override;
+
     static void  increaseLightGain();
     static void  decreaseLightGain();
     static float getLightGain();
     static void  setLightGain(float);
 
+    // Store the blobs of the galaxy forms in dir once they are generated,
+    // so that later runs load them instead
+    static void setFormCache(const fs::path& dir);
+
     std::uint64_t getRenderMask() const override;
     unsigned int getLabelMask() const override;
 
     const char* getObjTypeName() const override;
 
- private:
+    // Select the custom template with the given name, or the template of
+    // the galaxy type if the name is empty; call after setType().
     void setForm(const std::string&);
 
+ private:
+
     float       detail{ 1.0f };
     GalaxyType  type{ GalaxyType::Irr };
     std::size_t form{ 0 };
@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <cstddef>
+
 #include <Eigen/Geometry>
 
 #include <celmodel/material.h>
@@ -49,8 +51,22 @@ public:
         return false;
     }
 
+    /*! Return true if several copies of the geometry can be drawn at
+     *  once by ModelInstances.
+     */
+    virtual bool supportsInstancing() const
+    {
+        return false;
+    }
+
     /*! Load all textures used by the model. */
     virtual void loadTextures()
     {
     }
+
+    /*! Return the estimated number of bytes held by the geometry. */
+    virtual std::size_t getMemoryUsage() const
+    {
+        return 0;
+    }
 };
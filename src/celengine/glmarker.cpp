@@ -8,11 +8,15 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <cstddef>
 #include <vector>
 #include <celcompat/numbers.h>
 #include <celmath/frustum.h>
 #include <celmath/mathlib.h>
+#include "glstate.h"
 #include "marker.h"
+#include "markerbatch.h"
 #include "render.h"
 #include "vecgl.h"
 #include "vertexobject.h"
@@ -123,6 +127,33 @@ static GLfloat Crosshair[CrosshairCount * 2] =
 
 constexpr const int StaticVtxCount = CrosshairOffset + CrosshairCount;
 
+constexpr const int DiamondCount  = 4;
+static GLfloat Diamond[DiamondCount * 2] =
+{
+     0.0f,  1.0f,
+     1.0f,  0.0f,
+     0.0f, -1.0f,
+    -1.0f,  0.0f
+};
+
+constexpr const int PlusCount  = 4;
+static GLfloat Plus[PlusCount * 2] =
+{
+     0.0f,  1.0f,
+     0.0f, -1.0f,
+     1.0f,  0.0f,
+    -1.0f,  0.0f
+};
+
+constexpr const int XCount  = 4;
+static GLfloat X[XCount * 2] =
+{
+    -1.0f, -1.0f,
+     1.0f,  1.0f,
+     1.0f, -1.0f,
+    -1.0f,  1.0f
+};
+
 constexpr const int SmallCircleOffset = StaticVtxCount;
 constexpr const int SmallCircleCount  = 10;
 constexpr const int LargeCircleOffset = SmallCircleOffset + SmallCircleCount;
@@ -252,31 +283,6 @@ static void initVO(VertexObject& vo)
 
 static void initLineVO(VertexObject& vo)
 {
-    constexpr const int DiamondCount  = 4;
-    static GLfloat Diamond[DiamondCount * 2] =
-    {
-         0.0f,  1.0f,
-         1.0f,  0.0f,
-         0.0f, -1.0f,
-        -1.0f,  0.0f
-    };
-    constexpr const int PlusCount  = 4;
-    GLfloat Plus[PlusCount * 2] =
-    {
-         0.0f,  1.0f,
-         0.0f, -1.0f,
-         1.0f,  0.0f,
-        -1.0f,  0.0f
-    };
-    constexpr const int XCount  = 4;
-    GLfloat X[XCount * 2] =
-    {
-        -1.0f, -1.0f,
-         1.0f,  1.0f,
-         1.0f, -1.0f,
-        -1.0f,  1.0f
-    };
-
     GLfloat SmallCircle[SmallCircleCount * 2];
     GLfloat LargeCircle[LargeCircleCount * 2];
     fillCircleValue(SmallCircle, SmallCircleCount, 1.0f);
@@ -632,3 +638,203 @@ void Renderer::renderCrosshair(float selectionSizeInPixels,
     }
     markerVO.unbind();
 }
+
+MarkerBatch::~MarkerBatch()
+{
+    if (vertexBuffer != 0)
+        celestia::gl::deleteBuffers(1, &vertexBuffer);
+    if (instanceBuffer != 0)
+        celestia::gl::deleteBuffers(1, &instanceBuffer);
+}
+
+bool MarkerBatch::isSupported()
+{
+    return celestia::gl::ARB_instanced_arrays;
+}
+
+bool MarkerBatch::canBatch(MarkerRepresentation::Symbol symbol, bool lineAsTriangles)
+{
+    switch (symbol)
+    {
+    case MarkerRepresentation::Diamond:
+    case MarkerRepresentation::Plus:
+    case MarkerRepresentation::X:
+    case MarkerRepresentation::Square:
+    case MarkerRepresentation::Triangle:
+    case MarkerRepresentation::Circle:
+        return !lineAsTriangles;
+    case MarkerRepresentation::Crosshair:
+        return false;
+    default:
+        return true;
+    }
+}
+
+// The shape drawn for a symbol, the same as in Renderer::renderMarker()
+int MarkerBatch::shapeOf(MarkerRepresentation::Symbol symbol, float size)
+{
+    switch (symbol)
+    {
+    case MarkerRepresentation::Diamond:      return DiamondShape;
+    case MarkerRepresentation::Plus:         return PlusShape;
+    case MarkerRepresentation::X:            return XShape;
+    case MarkerRepresentation::Square:       return SquareShape;
+    case MarkerRepresentation::FilledSquare: return FilledSquareShape;
+    case MarkerRepresentation::Triangle:     return TriangleShape;
+    case MarkerRepresentation::RightArrow:   return RightArrowShape;
+    case MarkerRepresentation::LeftArrow:    return LeftArrowShape;
+    case MarkerRepresentation::UpArrow:      return UpArrowShape;
+    case MarkerRepresentation::DownArrow:    return DownArrowShape;
+    case MarkerRepresentation::Circle:       return size <= 40.0f ? SmallCircleShape : LargeCircleShape;
+    case MarkerRepresentation::Disk:         return size <= 40.0f ? SmallDiskShape : LargeDiskShape;
+    default:                                 return -1;
+    }
+}
+
+void MarkerBatch::add(MarkerRepresentation::Symbol symbol,
+                      float size,
+                      float scaleFactor,
+                      const Color& color,
+                      const Vector3f& position)
+{
+    int shape = shapeOf(symbol, size);
+    if (shape < 0)
+        return;
+
+    MarkerInstance& instance = instances[shape].emplace_back();
+    for (int i = 0; i < 3; i++)
+        instance.position[i] = position[i];
+    instance.scale = size / 2.0f * scaleFactor;
+    Vector4f c = color.toVector4();
+    for (int i = 0; i < 4; i++)
+        instance.color[i] = static_cast<unsigned char>(std::clamp(c[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+    count++;
+}
+
+void MarkerBatch::createVertexBuffer()
+{
+    if (vertexBuffer != 0)
+        return;
+
+    std::vector<GLfloat> vertices;
+    auto addShape = [&](Shape shape, GLenum mode, const GLfloat* data, int vertexCount)
+    {
+        shapes[shape] = { mode, static_cast<GLint>(vertices.size() / 2), vertexCount };
+        vertices.insert(vertices.end(), data, data + vertexCount * 2);
+    };
+    // Closed outlines are drawn as the lines between consecutive points
+    auto addLoop = [&](Shape shape, const GLfloat* data, int vertexCount)
+    {
+        shapes[shape] = { GL_LINES, static_cast<GLint>(vertices.size() / 2), vertexCount * 2 };
+        for (int i = 0; i < vertexCount; i++)
+        {
+            int next = (i + 1) % vertexCount;
+            vertices.insert(vertices.end(), { data[i * 2], data[i * 2 + 1], data[next * 2], data[next * 2 + 1] });
+        }
+    };
+
+    GLfloat SmallCircle[SmallCircleCount * 2];
+    GLfloat LargeCircle[LargeCircleCount * 2];
+    fillCircleValue(SmallCircle, SmallCircleCount, 1.0f);
+    fillCircleValue(LargeCircle, LargeCircleCount, 1.0f);
+
+    addShape(FilledSquareShape, GL_TRIANGLE_FAN, Square, SquareCount);
+    addShape(RightArrowShape, GL_TRIANGLES, RightArrow, RightArrowCount);
+    addShape(LeftArrowShape, GL_TRIANGLES, LeftArrow, LeftArrowCount);
+    addShape(UpArrowShape, GL_TRIANGLES, UpArrow, UpArrowCount);
+    addShape(DownArrowShape, GL_TRIANGLES, DownArrow, DownArrowCount);
+    addShape(SmallDiskShape, GL_TRIANGLE_FAN, SmallCircle, SmallCircleCount);
+    addShape(LargeDiskShape, GL_TRIANGLE_FAN, LargeCircle, LargeCircleCount);
+    addLoop(DiamondShape, Diamond, DiamondCount);
+    addShape(PlusShape, GL_LINES, Plus, PlusCount);
+    addShape(XShape, GL_LINES, X, XCount);
+    addLoop(SquareShape, Square, SquareCount);
+    addLoop(TriangleShape, Triangle, TriangleCount);
+    addLoop(SmallCircleShape, SmallCircle, SmallCircleCount);
+    addLoop(LargeCircleShape, LargeCircle, LargeCircleCount);
+
+    glGenBuffers(1, &vertexBuffer);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    celestia::gl::bufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void MarkerBatch::draw()
+{
+    if (count == 0)
+        return;
+
+    createVertexBuffer();
+
+    // The instances of all of the shapes go into one buffer, one shape
+    // after another
+    if (instanceBuffer == 0)
+        glGenBuffers(1, &instanceBuffer);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    // Orphan the buffer of the previous batch before filling it
+    celestia::gl::bufferData(GL_ARRAY_BUFFER, count * sizeof(MarkerInstance), nullptr, GL_STREAM_DRAW);
+    std::size_t offset = 0;
+    for (const auto& shapeInstances : instances)
+    {
+        if (shapeInstances.empty())
+            continue;
+        celestia::gl::bufferSubData(GL_ARRAY_BUFFER, offset * sizeof(MarkerInstance),
+                                    shapeInstances.size() * sizeof(MarkerInstance), shapeInstances.data());
+        offset += shapeInstances.size();
+    }
+
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
+    glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
+                          2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+    // The other attributes advance once per marker
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    const GLuint instanceAttributes[] =
+    {
+        CelestiaGLProgram::TextureCoord0AttributeIndex,
+        CelestiaGLProgram::TextureCoord1AttributeIndex,
+        CelestiaGLProgram::ColorAttributeIndex,
+    };
+    for (GLuint index : instanceAttributes)
+    {
+        glEnableVertexAttribArray(index);
+        glVertexAttribDivisor(index, 1);
+    }
+
+    offset = 0;
+    for (int shape = 0; shape < ShapeCount; shape++)
+    {
+        auto& shapeInstances = instances[shape];
+        if (shapeInstances.empty())
+            continue;
+
+        std::size_t base = offset * sizeof(MarkerInstance);
+        glVertexAttribPointer(CelestiaGLProgram::TextureCoord0AttributeIndex,
+                              3, GL_FLOAT, GL_FALSE, sizeof(MarkerInstance),
+                              reinterpret_cast<const void*>(base + offsetof(MarkerInstance, position)));
+        glVertexAttribPointer(CelestiaGLProgram::TextureCoord1AttributeIndex,
+                              1, GL_FLOAT, GL_FALSE, sizeof(MarkerInstance),
+                              reinterpret_cast<const void*>(base + offsetof(MarkerInstance, scale)));
+        glVertexAttribPointer(CelestiaGLProgram::ColorAttributeIndex,
+                              4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(MarkerInstance),
+                              reinterpret_cast<const void*>(base + offsetof(MarkerInstance, color)));
+
+        const ShapeVertices& shapeVertices = shapes[shape];
+        celestia::gl::drawArraysInstanced(shapeVertices.mode, shapeVertices.first, shapeVertices.count,
+                                          static_cast<GLsizei>(shapeInstances.size()));
+
+        offset += shapeInstances.size();
+        shapeInstances.clear();
+    }
+    count = 0;
+
+    // Other vertex arrays expect every attribute to advance per vertex
+    for (GLuint index : instanceAttributes)
+    {
+        glVertexAttribDivisor(index, 0);
+        glDisableVertexAttribArray(index);
+    }
+    glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+}
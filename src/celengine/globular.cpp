@@ -12,11 +12,13 @@
 // of the License, or (at your option) any later version.
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
 #include <cstddef>
-#include <optional>
+#include <memory>
 #include <utility>
+#include <vector>
 
 #include <fmt/printf.h>
 
@@ -32,6 +34,8 @@
 #include "render.h"
 #include "texture.h"
 #include "vecgl.h"
+#include "vertexobject.h"
+#include "glstate.h"
 
 namespace vecgl = celestia::vecgl;
 
@@ -45,8 +49,26 @@ struct GlobularForm
         float radius_2d;
     };
 
+    // Per-cluster data of the star sprites, drawn instanced
+    struct Instance
+    {
+        // First three rows of the model transform; the translation is the
+        // offset of the cluster from the observer
+        float rows[3][4];
+        // brightness, pixel weight and number of stars
+        float params[3];
+    };
+
     std::vector<Blob> gblobs{ };
     Eigen::Vector3f scale{ };
+
+    // Vertices of the tidal quad and the star sprites, shared by all
+    // clusters with this form
+    celgl::VertexObject vo{ GL_ARRAY_BUFFER, 0, GL_STATIC_DRAW };
+
+    // Clusters waiting for Globular::renderInstances
+    std::vector<Instance> instances{ };
+    GLsizei maxCount{ 0 };
 };
 
 
@@ -160,7 +182,8 @@ void centerCloudTexEval(float u, float v, float /*w*/, std::uint8_t *pixel)
 void initGlobularData(celgl::VertexObject& vo,
                       const std::vector<GlobularForm::Blob>& points,
                       GLint sizeLoc,
-                      GLint etaLoc)
+                      GLint etaLoc,
+                      GLint indexLoc)
 {
     struct GlobularVtx
     {
@@ -168,15 +191,16 @@ void initGlobularData(celgl::VertexObject& vo,
         Color color;
         float starSize;
         float eta;
+        float starIndex;
     };
     std::vector<GlobularVtx> globularVtx;
     globularVtx.reserve(4 + points.size());
 
     // Reuse the buffer for a tidal
-    globularVtx.push_back({{-1.0f, -1.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, 0.0f, 0.0f});
-    globularVtx.push_back({{ 1.0f, -1.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, 1.0f, 0.0f});
-    globularVtx.push_back({{ 1.0f,  1.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, 1.0f, 1.0f});
-    globularVtx.push_back({{-1.0f,  1.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, 0.0f, 1.0f});
+    globularVtx.push_back({{-1.0f, -1.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, 0.0f, 0.0f, 0.0f});
+    globularVtx.push_back({{ 1.0f, -1.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, 1.0f, 0.0f, 0.0f});
+    globularVtx.push_back({{ 1.0f,  1.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, 1.0f, 1.0f, 0.0f});
+    globularVtx.push_back({{-1.0f,  1.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, 0.0f, 1.0f, 0.0f});
 
     // regarding used constants:
     // pow2 = 128;           // Associate "Red Giants" with the 128 biggest star-sprites
@@ -207,6 +231,7 @@ void initGlobularData(celgl::VertexObject& vo,
         vtx.starSize = starSize;
         vtx.position = b.position;
         vtx.eta      = b.radius_2d;
+        vtx.starIndex = static_cast<float>(i);
 
         /* Colors of normal globular stars are given by color profile.
          * Associate orange "Red Giant" stars with the largest sprite
@@ -224,9 +249,10 @@ void initGlobularData(celgl::VertexObject& vo,
     vo.setColors(4, GL_UNSIGNED_BYTE, true, sizeof(GlobularVtx), offsetof(GlobularVtx, color));
     vo.setVertexAttribArray(sizeLoc, 1, GL_FLOAT, false, sizeof(GlobularVtx), offsetof(GlobularVtx, starSize));
     vo.setVertexAttribArray(etaLoc,  1, GL_FLOAT, false, sizeof(GlobularVtx), offsetof(GlobularVtx, eta));
+    vo.setVertexAttribArray(indexLoc, 1, GL_FLOAT, false, sizeof(GlobularVtx), offsetof(GlobularVtx, starIndex));
 }
 
-GlobularForm buildGlobularForm(float c)
+std::unique_ptr<GlobularForm> buildGlobularForm(float c)
 {
     GlobularForm::Blob b{};
     std::vector<GlobularForm::Blob> globularPoints;
@@ -323,38 +349,101 @@ GlobularForm buildGlobularForm(float c)
     // Check for efficiency of sprite-star generation => close to 100 %!
     //cout << "c =  "<< c <<"  i =  " << i - 1 <<"  k =  " << k - 1 << "  Efficiency:  " << 100.0f * i / (float)k<<"%" << endl;
 
-    GlobularForm globularForm;
-    globularForm.gblobs = std::move(globularPoints);
-    globularForm.scale  = Eigen::Vector3f::Ones();
+    auto globularForm = std::make_unique<GlobularForm>();
+    globularForm->gblobs = std::move(globularPoints);
+    globularForm->scale  = Eigen::Vector3f::Ones();
 
     return globularForm;
 }
 
+const GLchar* const InstanceAttributes[] =
+{
+    "in_InstanceRow0",
+    "in_InstanceRow1",
+    "in_InstanceRow2",
+    "in_InstanceParams",
+};
+
+// Set the per-cluster attributes of the globular shader to constant values
+void setInstanceValues(const CelestiaGLProgram* prog,
+                       const GlobularForm::Instance& instance)
+{
+    for (int row = 0; row < 3; row++)
+        glVertexAttrib4fv(prog->attribIndex(InstanceAttributes[row]), instance.rows[row]);
+    glVertexAttrib3fv(prog->attribIndex(InstanceAttributes[3]), instance.params);
+}
+
+// Read the per-cluster attributes of the globular shader from the bound
+// instance buffer, starting at offset
+void setInstanceArrays(const CelestiaGLProgram* prog, std::size_t offset)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        GLint index = prog->attribIndex(InstanceAttributes[i]);
+        std::size_t attributeOffset = i < 3
+            ? offset + offsetof(GlobularForm::Instance, rows) + i * 4 * sizeof(float)
+            : offset + offsetof(GlobularForm::Instance, params);
+        glEnableVertexAttribArray(index);
+        glVertexAttribPointer(index, i < 3 ? 4 : 3, GL_FLOAT, GL_FALSE,
+                              sizeof(GlobularForm::Instance),
+                              reinterpret_cast<const void*>(attributeOffset));
+        glVertexAttribDivisor(index, 1);
+    }
+}
+
+// Other vertex arrays expect every attribute to advance per vertex
+void resetInstanceArrays(const CelestiaGLProgram* prog)
+{
+    for (const GLchar* name : InstanceAttributes)
+    {
+        GLint index = prog->attribIndex(name);
+        glVertexAttribDivisor(index, 0);
+        glDisableVertexAttribArray(index);
+    }
+}
+
 class GlobularInfoManager
 {
  public:
     GlobularInfoManager()
     {
-        initializeForms();
+        initializeColorTable();
         centerTex.fill(nullptr);
     }
 
-    const GlobularForm* getForm(unsigned int) const;
+    GlobularForm* getForm(unsigned int);
     Texture* getCenterTex(unsigned int);
     Texture* getGlobularTex();
 
+    void addInstance(GlobularForm*,
+                     const GlobularForm::Instance&,
+                     const Eigen::Matrix4f& projection,
+                     const Eigen::Matrix4f& modelview);
+    void drawInstances(Renderer*);
+
  private:
-    void initializeForms();
+    void initializeColorTable();
 
-    std::array<GlobularForm, GlobularBuckets> globularForms{ };
+    // Forms are built the first time a cluster of their bin is drawn
+    std::array<std::unique_ptr<GlobularForm>, GlobularBuckets> globularForms{ };
     std::array<Texture*, GlobularBuckets> centerTex{ };
     Texture* globularTex{ nullptr };
+
+    GLuint instanceBuffer{ 0 };
+    std::vector<GlobularForm::Instance> uploadData{ };
+    Eigen::Matrix4f instanceProjection{ Eigen::Matrix4f::Identity() };
+    Eigen::Matrix4f instanceModelView{ Eigen::Matrix4f::Identity() };
 };
 
-const GlobularForm* GlobularInfoManager::getForm(unsigned int form) const
+GlobularForm* GlobularInfoManager::getForm(unsigned int form)
 {
     assert(form < globularForms.size());
-    return &globularForms[form];
+    if (globularForms[form] == nullptr)
+    {
+        float cBin = MinC + (static_cast<float>(form) + 0.5f) * BinWidth;
+        globularForms[form] = buildGlobularForm(cBin);
+    }
+    return globularForms[form].get();
 }
 
 Texture* GlobularInfoManager::getCenterTex(unsigned int form)
@@ -382,7 +471,95 @@ Texture* GlobularInfoManager::getGlobularTex()
     return globularTex;
 }
 
-void GlobularInfoManager::initializeForms()
+void GlobularInfoManager::addInstance(GlobularForm* form,
+                                      const GlobularForm::Instance& instance,
+                                      const Eigen::Matrix4f& projection,
+                                      const Eigen::Matrix4f& modelview)
+{
+    // The projections of the clusters only differ by their near and far
+    // planes, which the shader doesn't clip against.
+    instanceProjection = projection;
+    instanceModelView = modelview;
+
+    form->instances.push_back(instance);
+    form->maxCount = std::max(form->maxCount, static_cast<GLsizei>(instance.params[2]));
+}
+
+void GlobularInfoManager::drawInstances(Renderer* renderer)
+{
+    uploadData.clear();
+    for (const auto& form : globularForms)
+    {
+        if (form != nullptr)
+            uploadData.insert(uploadData.end(), form->instances.begin(), form->instances.end());
+    }
+    if (uploadData.empty())
+        return;
+
+    auto *globProg = renderer->getShaderManager().getShader("globular");
+    if (globProg == nullptr)
+        return;
+
+    if (instanceBuffer == 0)
+        glGenBuffers(1, &instanceBuffer);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    // Orphan the buffer of the previous frame before filling it
+    celestia::gl::bufferData(GL_ARRAY_BUFFER, uploadData.size() * sizeof(GlobularForm::Instance), nullptr, GL_STREAM_DRAW);
+    celestia::gl::bufferSubData(GL_ARRAY_BUFFER, 0, uploadData.size() * sizeof(GlobularForm::Instance), uploadData.data());
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+
+#ifndef GL_ES
+    celestia::gl::enable(GL_POINT_SPRITE);
+    celestia::gl::enable(GL_VERTEX_PROGRAM_POINT_SIZE);
+#endif
+
+    Renderer::PipelineState ps;
+    ps.blending = true;
+    ps.blendFunc = {GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA};
+    ps.smoothLines = true;
+    renderer->setPipelineState(ps);
+
+    globProg->use();
+    getGlobularTex()->bind();
+    globProg->setMVPMatrices(instanceProjection, instanceModelView);
+    globProg->floatParam("scale")     = renderer->getScreenDpi() / 25.4f / 3.78f;
+    globProg->samplerParam("starTex") = 0;
+
+    std::size_t firstInstance = 0;
+    for (unsigned int ic = 0; ic < GlobularBuckets; ++ic)
+    {
+        GlobularForm* form = globularForms[ic].get();
+        if (form == nullptr || form->instances.empty())
+            continue;
+
+        float cBin = MinC + (static_cast<float>(ic) + 0.5f) * BinWidth;
+        globProg->floatParam("RRatio") = std::pow(10.0f, cBin);
+
+        // Forms are always drawn once with the tidal shader before their
+        // instances, so their vertex objects are initialized here.
+        form->vo.bind();
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        setInstanceArrays(globProg, firstInstance * sizeof(GlobularForm::Instance));
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+
+        celestia::gl::drawArraysInstanced(GL_POINTS, 4, form->maxCount,
+                                          static_cast<GLsizei>(form->instances.size()));
+
+        resetInstanceArrays(globProg);
+        form->vo.unbind();
+
+        firstInstance += form->instances.size();
+        form->instances.clear();
+        form->maxCount = 0;
+    }
+
+#ifndef GL_ES
+    celestia::gl::disable(GL_POINT_SPRITE);
+    celestia::gl::disable(GL_VERTEX_PROGRAM_POINT_SIZE);
+#endif
+}
+
+void GlobularInfoManager::initializeColorTable()
 {
     // Build RGB color table, using hue, saturation, value as input.
     // Hue in degrees.
@@ -422,13 +599,6 @@ void GlobularInfoManager::initializeForms()
         DeepSkyObject::hsv2rgb(&Rr, &Gg, &Bb, hue, sat, 0.85f);
         colorTable[i] = Color(Rr, Gg, Bb);
     }
-    // Define globularForms corresponding to 8 different bins of King concentration c
-
-    for (unsigned int ic  = 0; ic < GlobularBuckets; ++ic)
-    {
-        float CBin = MinC + (static_cast<float>(ic) + 0.5f) * BinWidth;
-        globularForms[ic] = buildGlobularForm(CBin);
-    }
 }
 
 GlobularInfoManager* getGlobularInfoManager()
@@ -506,10 +676,15 @@ void Globular::setConcentration(const float conc)
     c = conc;
     // For saving time, account for the c dependence via 8 bins only,
 
-    form = getGlobularInfoManager()->getForm(cSlot(conc));
+    hasForm = true;
     recomputeTidalRadius();
 }
 
+GlobularForm* Globular::getForm() const
+{
+    return hasForm ? getGlobularInfoManager()->getForm(cSlot(c)) : nullptr;
+}
+
 std::string Globular::getDescription() const
 {
    return fmt::sprintf(_("Globular (core radius: %4.2f', King concentration: %4.2f)"), r_c, c);
@@ -526,6 +701,11 @@ bool Globular::pick(const Eigen::ParametrizedLine<double, 3>& ray,
 {
     if (!isVisible())
         return false;
+
+    const GlobularForm* form = getForm();
+    if (form == nullptr)
+        return false;
+
     /*
      * The selection ellipsoid should be slightly larger to compensate for the fact
      * that blobs are considered points when globulars are built, but have size
@@ -574,7 +754,7 @@ void Globular::render(const Eigen::Vector3f& offset,
                       const Matrices& m,
                       Renderer* renderer)
 {
-    if (form == nullptr)
+    if (!hasForm)
         return;
 
     float distanceToDSO = offset.norm() - getRadius();
@@ -620,11 +800,7 @@ void Globular::render(const Eigen::Vector3f& offset,
     XI = 1.0f / std::sqrt(1.0f + RRatio * RRatio);
 
     GlobularInfoManager* globularInfoManager = getGlobularInfoManager();
-
-#ifndef GL_ES
-    glEnable(GL_POINT_SPRITE);
-    glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
-#endif
+    GlobularForm* form = globularInfoManager->getForm(ic);
 
     float tidalSize = 2.0f * tidalRadius;
 
@@ -632,12 +808,14 @@ void Globular::render(const Eigen::Vector3f& offset,
      * distance from center or resolution increases sufficiently.
      */
 
+    celgl::VertexObject& vo = form->vo;
     vo.bind();
     if (!vo.initialized())
     {
         auto i = globProg->attribIndex("starSize");
         auto j = globProg->attribIndex("eta");
-        initGlobularData(vo, form->gblobs, i, j);
+        auto k = globProg->attribIndex("starIndex");
+        initGlobularData(vo, form->gblobs, i, j, k);
     }
 
     tidalProg->use();
@@ -666,35 +844,63 @@ void Globular::render(const Eigen::Vector3f& offset,
      * or when distance from globular center decreases.
      */
 
-    GLsizei count = static_cast<GLsizei>(form->gblobs.size() * std::clamp(getDetail(), 0.0f, 1.0f));
+    float detailFraction = std::clamp(getDetail() * renderer->getDetailScale(), 0.0f, 1.0f);
+    GLsizei count = static_cast<GLsizei>(form->gblobs.size() * detailFraction);
     float t = std::pow(2.0f, 1.0f + std::log2(minimumFeatureSize / brightness) / std::log2(1.0f/1.25f));
     count = std::min(count, static_cast<GLsizei>(std::clamp(t, 128.0f, static_cast<float>(std::max(count, 128)))));
 
+    Eigen::Matrix3f mx = Eigen::Scaling(form->scale) * getOrientation().toRotationMatrix() * Eigen::Scaling(tidalSize);
+    GlobularForm::Instance instance;
+    for (int row = 0; row < 3; row++)
+    {
+        for (int col = 0; col < 3; col++)
+            instance.rows[row][col] = mx(row, col);
+        instance.rows[row][3] = offset[row];
+    }
+    instance.params[0] = brightness;
+    instance.params[1] = pixelWeight;
+    instance.params[2] = static_cast<float>(count);
+
+    // The stars are positioned relative to the observer
+    Eigen::Matrix4f mv = vecgl::translate(*m.modelview, Eigen::Vector3f(-offset));
+
+    if (celestia::gl::ARB_instanced_arrays)
+    {
+        vo.unbind();
+        globularInfoManager->addInstance(form, instance, *m.projection, mv);
+        return;
+    }
+
+#ifndef GL_ES
+    celestia::gl::enable(GL_POINT_SPRITE);
+    celestia::gl::enable(GL_VERTEX_PROGRAM_POINT_SIZE);
+#endif
+
     globProg->use();
 
     globularInfoManager->getGlobularTex()->bind();
-    globProg->setMVPMatrices(*m.projection, *m.modelview);
-    // TODO: model view matrix should not be reset here
-    globProg->ModelViewMatrix = vecgl::translate(*m.modelview, offset);
-    Eigen::Matrix3f mx = Eigen::Scaling(form->scale) * getOrientation().toRotationMatrix() * Eigen::Scaling(tidalSize);
-    globProg->mat3Param("m")            = mx;
-    globProg->vec3Param("offset")       = offset;
-    globProg->floatParam("brightness")  = brightness;
-    globProg->floatParam("pixelWeight") = pixelWeight;
+    globProg->setMVPMatrices(*m.projection, mv);
     globProg->floatParam("RRatio")      = RRatio;
     globProg->floatParam("scale")       = renderer->getScreenDpi() / 25.4f / 3.78f;
     globProg->samplerParam("starTex")   = 0;
+    setInstanceValues(globProg, instance);
 
     vo.draw(GL_POINTS, count, 4);
 
     vo.unbind();
 #ifndef GL_ES
-    glDisable(GL_POINT_SPRITE);
-    glDisable(GL_VERTEX_PROGRAM_POINT_SIZE);
+    celestia::gl::disable(GL_POINT_SPRITE);
+    celestia::gl::disable(GL_VERTEX_PROGRAM_POINT_SIZE);
 #endif
     // These should be called but stars are broken then
     // TODO: find and fix
-    //glDisable(GL_BLEND);
+    //celestia::gl::disable(GL_BLEND);
+}
+
+void Globular::renderInstances(Renderer* renderer)
+{
+    if (celestia::gl::ARB_instanced_arrays)
+        getGlobularInfoManager()->drawInstances(renderer);
 }
 
 std::uint64_t Globular::getRenderMask() const
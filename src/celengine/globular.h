@@ -23,7 +23,6 @@
 
 #include <celcompat/filesystem.h>
 #include "deepskyobj.h"
-#include "vertexobject.h"
 
 struct GlobularForm;
 struct Matrices;
@@ -64,18 +63,23 @@ class Globular : public DeepSkyObject
     unsigned int getLabelMask() const override;
     const char* getObjTypeName() const override;
 
+    // Draw the stars of the clusters rendered since the last call, all
+    // clusters sharing a form at once. Does nothing unless instanced
+    // drawing is supported.
+    static void renderInstances(Renderer*);
+
  private:
     // Reference values ( = data base averages) of core radius, King concentration
     // and mu25 isophote radius:
     static constexpr float R_c_ref = 0.83f, C_ref = 2.1f, R_mu25 = 40.32f;
 
     void recomputeTidalRadius();
+    GlobularForm* getForm() const;
 
     float detail{ 1.0f };
-    const GlobularForm* form{ nullptr };
+    // The form is selected by the concentration bin
+    bool hasForm{ false };
     float r_c{ R_c_ref };
     float c{ C_ref };
     float tidalRadius{ 0.0f };
-
-    celgl::VertexObject vo{ GL_ARRAY_BUFFER, 0, GL_STATIC_DRAW };
 };
@@ -10,6 +10,7 @@
 #include <iostream>
 #include <celutil/logger.h>
 #include "glshader.h"
+#include "glstate.h"
 
 using namespace std;
 using celestia::util::GetLogger;
@@ -35,7 +36,7 @@ GLShader::getID() const
 
 
 GLShaderStatus
-GLShader::compile(const vector<string>& source)
+GLShader::compile(const vector<string>& source, bool checkStatus)
 {
     if (source.empty())
         return ShaderStatus_EmptyProgram;
@@ -51,6 +52,8 @@ GLShader::compile(const vector<string>& source)
 
     // Actually compile the shader
     glCompileShader(id);
+    if (!checkStatus)
+        return ShaderStatus_OK;
 
     GLint compileSuccess;
     glGetShaderiv(id, GL_COMPILE_STATUS, &compileSuccess);
@@ -83,7 +86,7 @@ FloatShaderParameter::FloatShaderParameter(GLuint obj, const char* name)
 FloatShaderParameter&
 FloatShaderParameter::operator=(float f)
 {
-    if (slot != -1)
+    if (slot != -1 && celestia::gl::uniformChanged(slot, &f, 1))
         glUniform1f(slot, f);
     return *this;
 }
@@ -102,7 +105,7 @@ Vec3ShaderParameter::Vec3ShaderParameter(GLuint obj, const char* name)
 Vec3ShaderParameter&
 Vec3ShaderParameter::operator=(const Eigen::Vector3f& v)
 {
-    if (slot != -1)
+    if (slot != -1 && celestia::gl::uniformChanged(slot, v.data(), 3))
         glUniform3fv(slot, 1, v.data());
     return *this;
 }
@@ -120,7 +123,7 @@ Vec4ShaderParameter::Vec4ShaderParameter(GLuint obj, const char* name)
 Vec4ShaderParameter&
 Vec4ShaderParameter::operator=(const Eigen::Vector4f& v)
 {
-    if (slot != -1)
+    if (slot != -1 && celestia::gl::uniformChanged(slot, v.data(), 4))
         glUniform4fv(slot, 1, v.data());
     return *this;
 }
@@ -139,7 +142,7 @@ IntegerShaderParameter::IntegerShaderParameter(GLuint obj, const char* name)
 IntegerShaderParameter&
 IntegerShaderParameter::operator=(int i)
 {
-    if (slot != -1)
+    if (slot != -1 && celestia::gl::uniformChanged(slot, &i, 1))
         glUniform1i(slot, i);
     return *this;
 }
@@ -158,7 +161,7 @@ Mat3ShaderParameter::Mat3ShaderParameter(GLuint obj, const char* name)
 Mat3ShaderParameter&
 Mat3ShaderParameter::operator=(const Eigen::Matrix3f& v)
 {
-    if (slot != -1)
+    if (slot != -1 && celestia::gl::uniformChanged(slot, v.data(), 9))
         glUniformMatrix3fv(slot, 1, GL_FALSE, v.data());
     return *this;
 }
@@ -177,7 +180,7 @@ Mat4ShaderParameter::Mat4ShaderParameter(GLuint obj, const char* name)
 Mat4ShaderParameter&
 Mat4ShaderParameter::operator=(const Eigen::Matrix4f& v)
 {
-    if (slot != -1)
+    if (slot != -1 && celestia::gl::uniformChanged(slot, v.data(), 16))
         glUniformMatrix4fv(slot, 1, GL_FALSE, v.data());
     return *this;
 }
@@ -193,14 +196,14 @@ GLProgram::GLProgram(GLuint _id) :
 
 GLProgram::~GLProgram()
 {
-    glDeleteProgram(id);
+    celestia::gl::deleteProgram(id);
 }
 
 
 void
 GLProgram::use() const
 {
-    glUseProgram(id);
+    celestia::gl::useProgram(id);
 }
 
 
@@ -213,9 +216,34 @@ GLProgram::attach(const GLShader& shader)
 
 GLShaderStatus
 GLProgram::link()
+{
+    startLink();
+    return linkStatus();
+}
+
+
+void
+GLProgram::startLink()
 {
     glLinkProgram(id);
+}
+
+
+bool
+GLProgram::isLinkDone() const
+{
+    if (!celestia::gl::KHR_parallel_shader_compile)
+        return true;
 
+    GLint done = GL_FALSE;
+    glGetProgramiv(id, GL_COMPLETION_STATUS_KHR, &done);
+    return done == GL_TRUE;
+}
+
+
+GLShaderStatus
+GLProgram::linkStatus()
+{
     GLint linkSuccess;
     glGetProgramiv(id, GL_LINK_STATUS, &linkSuccess);
     if (linkSuccess != GL_TRUE)
@@ -232,17 +260,34 @@ GLProgram::link()
 }
 
 
+bool
+GLProgram::getBinary(GLenum& format, vector<char>& binary) const
+{
+    GLint length = 0;
+    glGetProgramiv(id, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return false;
+
+    binary.resize(length);
+    GLsizei written = 0;
+    glGetProgramBinary(id, length, &written, &format, binary.data());
+    binary.resize(written);
+    return written > 0;
+}
+
+
 //************* GLShaderLoader ************
 
 GLShaderStatus
 GLShaderLoader::CreateVertexShader(const vector<string>& source,
-                                   GLVertexShader** vs)
+                                   GLVertexShader** vs,
+                                   bool checkStatus)
 {
     GLuint vsid = glCreateShader(GL_VERTEX_SHADER);
 
     auto* shader = new GLVertexShader(vsid);
 
-    GLShaderStatus status = shader->compile(source);
+    GLShaderStatus status = shader->compile(source, checkStatus);
     if (status != ShaderStatus_OK)
     {
         if (g_shaderLogFile != nullptr)
@@ -262,13 +307,14 @@ GLShaderLoader::CreateVertexShader(const vector<string>& source,
 
 GLShaderStatus
 GLShaderLoader::CreateFragmentShader(const vector<string>& source,
-                                     GLFragmentShader** fs)
+                                     GLFragmentShader** fs,
+                                     bool checkStatus)
 {
     GLuint fsid = glCreateShader(GL_FRAGMENT_SHADER);
 
     auto* shader = new GLFragmentShader(fsid);
 
-    GLShaderStatus status = shader->compile(source);
+    GLShaderStatus status = shader->compile(source, checkStatus);
     if (status != ShaderStatus_OK)
     {
         if (g_shaderLogFile != nullptr)
@@ -288,22 +334,24 @@ GLShaderLoader::CreateFragmentShader(const vector<string>& source,
 
 GLShaderStatus
 GLShaderLoader::CreateVertexShader(const string& source,
-                                   GLVertexShader** vs)
+                                   GLVertexShader** vs,
+                                   bool checkStatus)
 
 {
     vector<string> v;
     v.push_back(source);
-    return CreateVertexShader(v, vs);
+    return CreateVertexShader(v, vs, checkStatus);
 }
 
 
 GLShaderStatus
 GLShaderLoader::CreateFragmentShader(const string& source,
-                                     GLFragmentShader** fs)
+                                     GLFragmentShader** fs,
+                                     bool checkStatus)
 {
     vector<string> v;
     v.push_back(source);
-    return CreateFragmentShader(v, fs);
+    return CreateFragmentShader(v, fs, checkStatus);
 }
 
 
@@ -376,6 +424,29 @@ GLShaderLoader::CreateProgram(const string& vsSource,
 }
 
 
+GLShaderStatus
+GLShaderLoader::CreateProgramFromBinary(GLenum format,
+                                        const vector<char>& binary,
+                                        GLProgram** progOut)
+{
+    GLuint progid = glCreateProgram();
+    glProgramBinary(progid, format, binary.data(), (GLsizei) binary.size());
+
+    // Drivers reject binaries made by other driver versions
+    GLint linkSuccess;
+    glGetProgramiv(progid, GL_LINK_STATUS, &linkSuccess);
+    if (linkSuccess != GL_TRUE)
+    {
+        celestia::gl::deleteProgram(progid);
+        return ShaderStatus_LinkError;
+    }
+
+    *progOut = new GLProgram(progid);
+
+    return ShaderStatus_OK;
+}
+
+
 const string
 GetInfoLog(GLuint obj)
 {
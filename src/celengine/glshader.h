@@ -39,7 +39,7 @@ class GLShader
  private:
     GLuint id;
 
-    GLShaderStatus compile(const std::vector<std::string>& source);
+    GLShaderStatus compile(const std::vector<std::string>& source, bool checkStatus);
 
     friend class GLShaderLoader;
 };
@@ -75,6 +75,15 @@ class GLProgram
 
     GLShaderStatus link();
 
+    // With KHR_parallel_shader_compile, linking started by startLink() runs
+    // in the background; linkStatus() waits for it and checks the result.
+    void startLink();
+    bool isLinkDone() const;
+    GLShaderStatus linkStatus();
+
+    // Retrieve the linked program in the driver's binary format
+    bool getBinary(GLenum& format, std::vector<char>& binary) const;
+
     void use() const;
     GLuint getID() const { return id; }
 
@@ -166,14 +175,20 @@ class Mat4ShaderParameter
 class GLShaderLoader
 {
  public:
+    // Unless checkStatus is set, compile errors only show when linking, so
+    // that the driver may compile in the background
     static GLShaderStatus CreateVertexShader(const std::vector<std::string>&,
-                                             GLVertexShader**);
+                                             GLVertexShader**,
+                                             bool checkStatus = true);
     static GLShaderStatus CreateFragmentShader(const std::vector<std::string>&,
-                                               GLFragmentShader**);
+                                               GLFragmentShader**,
+                                               bool checkStatus = true);
     static GLShaderStatus CreateVertexShader(const std::string&,
-                                             GLVertexShader**);
+                                             GLVertexShader**,
+                                             bool checkStatus = true);
     static GLShaderStatus CreateFragmentShader(const std::string&,
-                                               GLFragmentShader**);
+                                               GLFragmentShader**,
+                                               bool checkStatus = true);
 
     static GLShaderStatus CreateProgram(const GLVertexShader& vs,
                                         const GLFragmentShader& fs,
@@ -184,6 +199,10 @@ class GLShaderLoader
     static GLShaderStatus CreateProgram(const std::string& vsSource,
                                         const std::string& fsSource,
                                         GLProgram**);
+    // Create a linked program from a binary returned by GLProgram::getBinary
+    static GLShaderStatus CreateProgramFromBinary(GLenum format,
+                                                  const std::vector<char>& binary,
+                                                  GLProgram**);
 };
 
 
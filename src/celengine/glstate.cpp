@@ -0,0 +1,503 @@
+// glstate.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Cache of the OpenGL state set by the renderer.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <unordered_map>
+#include "glstate.h"
+
+namespace celestia::gl
+{
+
+namespace
+{
+
+constexpr GLuint Unknown = ~GLuint(0);
+
+// Texture units and targets whose bindings are cached; bindings of other
+// units and targets are passed to GL
+constexpr unsigned int MaxTextureUnits = 16;
+constexpr std::array<GLenum, 4> TextureTargets =
+{
+    GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_3D, GL_TEXTURE_2D_ARRAY
+};
+
+// Capabilities whose state is cached
+constexpr std::array<GLenum, 4> Capabilities =
+{
+    GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_POLYGON_OFFSET_FILL
+};
+
+// Up to a 4x4 matrix, as the bits of floats or integers
+struct UniformValue
+{
+    std::array<std::uint32_t, 16> bits;
+    int count;
+};
+
+using UniformMap = std::unordered_map<GLint, UniformValue>;
+
+struct State
+{
+    bool active{ false };
+
+    GLuint program{ Unknown };
+    // Uniforms of each program set in the current frame; uniforms points
+    // to those of the program in use, or is null if it's unknown
+    std::unordered_map<GLuint, UniformMap> programUniforms;
+    UniformMap* uniforms{ nullptr };
+
+    GLuint vertexArray{ Unknown };
+    GLuint arrayBuffer{ Unknown };
+    // Part of the state of the vertex array
+    GLuint elementArrayBuffer{ Unknown };
+
+    unsigned int textureUnit{ Unknown };
+    std::array<std::array<GLuint, TextureTargets.size()>, MaxTextureUnits> textures;
+
+    // 0 or 1, Unknown if unknown
+    std::array<GLuint, Capabilities.size()> capabilities;
+    GLenum blendSrc{ Unknown };
+    GLenum blendDst{ Unknown };
+    GLuint depthMask{ Unknown };
+
+    StateCacheStats frameStats;
+    StateCacheStats lastStats;
+    DrawStats frameDrawStats;
+    DrawStats lastDrawStats;
+};
+
+// There's a single GL context
+State state;
+
+// Return true if the call can be skipped because it sets the value that
+// is already cached; otherwise cache the value
+template<typename T>
+bool
+skip(T& cached, T value)
+{
+    if (!state.active)
+        return false;
+
+    if (cached == value)
+    {
+        state.frameStats.skipped++;
+        return true;
+    }
+
+    cached = value;
+    state.frameStats.issued++;
+    return false;
+}
+
+// Count a call that isn't covered by the cache
+void
+issue()
+{
+    if (state.active)
+        state.frameStats.issued++;
+}
+
+template<typename T, std::size_t N>
+int
+indexOf(const std::array<T, N>& values, T value)
+{
+    auto it = std::find(values.begin(), values.end(), value);
+    return it == values.end() ? -1 : static_cast<int>(it - values.begin());
+}
+
+void
+forgetAll()
+{
+    state.program = Unknown;
+    state.programUniforms.clear();
+    state.uniforms = nullptr;
+    state.vertexArray = Unknown;
+    state.arrayBuffer = Unknown;
+    state.elementArrayBuffer = Unknown;
+    state.textureUnit = Unknown;
+    for (auto& unit : state.textures)
+        unit.fill(Unknown);
+    state.capabilities.fill(Unknown);
+    state.blendSrc = Unknown;
+    state.blendDst = Unknown;
+    state.depthMask = Unknown;
+}
+
+bool
+uniformValueChanged(GLint location, const void* value, int count)
+{
+    if (!state.active || state.uniforms == nullptr)
+    {
+        issue();
+        return true;
+    }
+
+    UniformValue& cached = (*state.uniforms)[location];
+    auto size = static_cast<std::size_t>(count) * sizeof(std::uint32_t);
+    if (cached.count == count && std::memcmp(cached.bits.data(), value, size) == 0)
+    {
+        state.frameStats.skipped++;
+        return false;
+    }
+
+    cached.count = count;
+    std::memcpy(cached.bits.data(), value, size);
+    state.frameStats.issued++;
+    return true;
+}
+
+// Count a draw call of count vertices, drawn instances times
+void
+countDraw(GLenum mode, GLsizei count, GLsizei instances)
+{
+    if (!state.active)
+        return;
+
+    DrawStats& stats = state.frameDrawStats;
+    stats.drawCalls++;
+
+    auto n = static_cast<std::uint64_t>(std::max(count, 0));
+    auto i = static_cast<std::uint64_t>(std::max(instances, 0));
+    switch (mode)
+    {
+    case GL_TRIANGLES:
+        stats.triangles += n / 3 * i;
+        break;
+    case GL_TRIANGLE_STRIP:
+    case GL_TRIANGLE_FAN:
+        stats.triangles += (n < 3 ? 0 : n - 2) * i;
+        break;
+    case GL_LINES:
+        stats.lines += n / 2 * i;
+        break;
+    case GL_LINE_STRIP:
+        stats.lines += (n < 2 ? 0 : n - 1) * i;
+        break;
+    case GL_LINE_LOOP:
+        stats.lines += (n < 2 ? 0 : n) * i;
+        break;
+    case GL_POINTS:
+        stats.points += n * i;
+        break;
+    default:
+        break;
+    }
+}
+
+UploadType
+uploadType(GLenum target)
+{
+    switch (target)
+    {
+    case GL_ARRAY_BUFFER:
+        return UploadType::Vertex;
+    case GL_ELEMENT_ARRAY_BUFFER:
+        return UploadType::Index;
+    case GL_UNIFORM_BUFFER:
+        return UploadType::Uniform;
+    default:
+        return UploadType::Other;
+    }
+}
+
+} // end unnamed namespace
+
+void
+beginStateCache()
+{
+    forgetAll();
+    state.frameStats = {};
+    state.frameDrawStats = {};
+    state.active = true;
+}
+
+void
+endStateCache()
+{
+    state.active = false;
+    state.lastStats = state.frameStats;
+    state.lastDrawStats = state.frameDrawStats;
+}
+
+StateCacheStats
+getStateCacheStats()
+{
+    return state.lastStats;
+}
+
+DrawStats
+getDrawStats()
+{
+    return state.lastDrawStats;
+}
+
+void
+useProgram(GLuint program)
+{
+    if (skip(state.program, program))
+        return;
+
+    glUseProgram(program);
+    if (state.active)
+        state.frameDrawStats.programChanges++;
+    state.uniforms = state.active ? &state.programUniforms[program] : nullptr;
+}
+
+void
+deleteProgram(GLuint program)
+{
+    // A program in use is only deleted when it isn't used anymore, but its
+    // name may then be reused
+    if (state.program == program)
+    {
+        state.program = Unknown;
+        state.uniforms = nullptr;
+    }
+    state.programUniforms.erase(program);
+    issue();
+    glDeleteProgram(program);
+}
+
+void
+bindVertexArray(GLuint array)
+{
+    if (skip(state.vertexArray, array))
+        return;
+
+    glBindVertexArray(array);
+    state.elementArrayBuffer = Unknown;
+}
+
+void
+deleteVertexArrays(GLsizei n, const GLuint* arrays)
+{
+    for (GLsizei i = 0; i < n; i++)
+    {
+        if (state.vertexArray == arrays[i])
+        {
+            state.vertexArray = 0;
+            state.elementArrayBuffer = Unknown;
+        }
+    }
+    issue();
+    glDeleteVertexArrays(n, arrays);
+}
+
+void
+bindBuffer(GLenum target, GLuint buffer)
+{
+    if (target == GL_ARRAY_BUFFER)
+    {
+        if (skip(state.arrayBuffer, buffer))
+            return;
+    }
+    else if (target == GL_ELEMENT_ARRAY_BUFFER)
+    {
+        if (skip(state.elementArrayBuffer, buffer))
+            return;
+    }
+    else
+    {
+        issue();
+    }
+
+    glBindBuffer(target, buffer);
+}
+
+void
+deleteBuffers(GLsizei n, const GLuint* buffers)
+{
+    for (GLsizei i = 0; i < n; i++)
+    {
+        if (state.arrayBuffer == buffers[i])
+            state.arrayBuffer = 0;
+        if (state.elementArrayBuffer == buffers[i])
+            state.elementArrayBuffer = Unknown;
+    }
+    issue();
+    glDeleteBuffers(n, buffers);
+}
+
+void
+activeTexture(GLenum unit)
+{
+    if (skip(state.textureUnit, static_cast<unsigned int>(unit - GL_TEXTURE0)))
+        return;
+
+    glActiveTexture(unit);
+}
+
+void
+bindTexture(GLenum target, GLuint texture)
+{
+    int index = indexOf(TextureTargets, target);
+    if (state.textureUnit < MaxTextureUnits && index >= 0)
+    {
+        if (skip(state.textures[state.textureUnit][index], texture))
+            return;
+    }
+    else
+    {
+        issue();
+    }
+
+    glBindTexture(target, texture);
+    if (state.active)
+        state.frameDrawStats.textureBinds++;
+}
+
+void
+deleteTextures(GLsizei n, const GLuint* textures)
+{
+    // Deleted textures are unbound from all units
+    for (auto& unit : state.textures)
+    {
+        for (GLuint& bound : unit)
+        {
+            if (std::find(textures, textures + n, bound) != textures + n)
+                bound = 0;
+        }
+    }
+    issue();
+    glDeleteTextures(n, textures);
+}
+
+void
+enable(GLenum capability)
+{
+    int index = indexOf(Capabilities, capability);
+    if (index >= 0 && skip(state.capabilities[index], GLuint(1)))
+        return;
+    if (index < 0)
+        issue();
+
+    glEnable(capability);
+}
+
+void
+disable(GLenum capability)
+{
+    int index = indexOf(Capabilities, capability);
+    if (index >= 0 && skip(state.capabilities[index], GLuint(0)))
+        return;
+    if (index < 0)
+        issue();
+
+    glDisable(capability);
+}
+
+void
+blendFunc(GLenum src, GLenum dst)
+{
+    if (state.active && state.blendSrc == src && state.blendDst == dst)
+    {
+        state.frameStats.skipped++;
+        return;
+    }
+
+    if (state.active)
+    {
+        state.blendSrc = src;
+        state.blendDst = dst;
+    }
+    issue();
+    glBlendFunc(src, dst);
+}
+
+void
+depthMask(GLboolean flag)
+{
+    if (skip(state.depthMask, GLuint(flag)))
+        return;
+
+    glDepthMask(flag);
+}
+
+bool
+uniformChanged(GLint location, const GLfloat* value, int count)
+{
+    return uniformValueChanged(location, value, count);
+}
+
+bool
+uniformChanged(GLint location, const GLint* value, int count)
+{
+    return uniformValueChanged(location, value, count);
+}
+
+void
+drawArrays(GLenum mode, GLint first, GLsizei count)
+{
+    countDraw(mode, count, 1);
+    glDrawArrays(mode, first, count);
+}
+
+void
+drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances)
+{
+    countDraw(mode, count, instances);
+    glDrawArraysInstanced(mode, first, count, instances);
+}
+
+void
+drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+{
+    countDraw(mode, count, 1);
+    glDrawElements(mode, count, type, indices);
+}
+
+void
+drawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices, GLint baseVertex)
+{
+    countDraw(mode, count, 1);
+    glDrawElementsBaseVertex(mode, count, type, indices, baseVertex);
+}
+
+void
+drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances)
+{
+    countDraw(mode, count, instances);
+    glDrawElementsInstanced(mode, count, type, indices, instances);
+}
+
+void
+drawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices,
+                                GLsizei instances, GLint baseVertex)
+{
+    countDraw(mode, count, instances);
+    glDrawElementsInstancedBaseVertex(mode, count, type, indices, instances, baseVertex);
+}
+
+void
+bufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+    if (data != nullptr)
+        countUpload(uploadType(target), static_cast<std::size_t>(size));
+    glBufferData(target, size, data, usage);
+}
+
+void
+bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+{
+    countUpload(uploadType(target), static_cast<std::size_t>(size));
+    glBufferSubData(target, offset, size, data);
+}
+
+void
+countUpload(UploadType type, std::size_t size)
+{
+    if (state.active)
+        state.frameDrawStats.uploadedBytes[static_cast<std::size_t>(type)] += size;
+}
+
+} // end namespace celestia::gl
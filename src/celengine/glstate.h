@@ -0,0 +1,118 @@
+// glstate.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Cache of the OpenGL state set by the renderer.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "glsupport.h"
+
+namespace celestia::gl
+{
+
+// The functions below replace the GL calls of the same names. While the
+// renderer draws a frame, between beginStateCache() and endStateCache(),
+// they remember the state they set and skip the calls that wouldn't change
+// it: the program in use and its uniforms, the vertex array and buffer
+// bindings, the texture bound to each unit, and the capabilities, blend
+// function and depth mask. Outside of a frame they call GL directly, as
+// the front ends may change the state between frames.
+//
+// Within a frame, the state they cover must only be changed through them.
+// Objects must be deleted through them too, since GL unbinds a deleted
+// object and may reuse its name.
+
+// Number of calls made and skipped in a frame
+struct StateCacheStats
+{
+    std::uint32_t issued{ 0 };
+    std::uint32_t skipped{ 0 };
+};
+
+// Kinds of data uploaded to GL
+enum class UploadType
+{
+    Vertex,
+    Index,
+    Uniform,
+    Texture,
+    Other,
+};
+
+constexpr std::size_t UploadTypeCount = 5;
+
+// Work submitted to GL in a frame. Primitives are counted from the
+// vertices of the draw calls and their instances.
+struct DrawStats
+{
+    std::uint32_t drawCalls{ 0 };
+    std::uint64_t triangles{ 0 };
+    std::uint64_t lines{ 0 };
+    std::uint64_t points{ 0 };
+    // Program and texture bindings made, which are also counted as state
+    // calls made
+    std::uint32_t programChanges{ 0 };
+    std::uint32_t textureBinds{ 0 };
+    // Bytes uploaded, indexed by UploadType
+    std::array<std::uint64_t, UploadTypeCount> uploadedBytes{};
+};
+
+// Forget the state, which becomes unknown, and start caching it
+void beginStateCache();
+// Stop caching the state
+void endStateCache();
+// The counts of the last frame
+StateCacheStats getStateCacheStats();
+DrawStats getDrawStats();
+
+void useProgram(GLuint program);
+void deleteProgram(GLuint program);
+
+void bindVertexArray(GLuint array);
+void deleteVertexArrays(GLsizei n, const GLuint* arrays);
+
+void bindBuffer(GLenum target, GLuint buffer);
+void deleteBuffers(GLsizei n, const GLuint* buffers);
+
+void activeTexture(GLenum unit);
+void bindTexture(GLenum target, GLuint texture);
+void deleteTextures(GLsizei n, const GLuint* textures);
+
+void enable(GLenum capability);
+void disable(GLenum capability);
+void blendFunc(GLenum src, GLenum dst);
+void depthMask(GLboolean flag);
+
+// Return false if the uniform at location of the program in use already
+// has the value of count floats or integers, in which case setting it can
+// be skipped; otherwise remember the value and return true.
+bool uniformChanged(GLint location, const GLfloat* value, int count);
+bool uniformChanged(GLint location, const GLint* value, int count);
+
+// The draw calls and uploads below are counted in the DrawStats of the
+// frame. Data written to GL otherwise, to a mapped buffer or a texture, is
+// counted by countUpload().
+void drawArrays(GLenum mode, GLint first, GLsizei count);
+void drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances);
+void drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices);
+void drawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices, GLint baseVertex);
+void drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances);
+void drawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices,
+                                     GLsizei instances, GLint baseVertex);
+
+// Uploads are counted by the type of their target; allocating a buffer
+// without data isn't counted
+void bufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+void bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data);
+void countUpload(UploadType type, std::size_t size);
+
+} // end namespace celestia::gl
@@ -10,11 +10,25 @@ bool OES_texture_border_clamp       = false;
 #else
 bool ARB_vertex_array_object        = false;
 bool EXT_framebuffer_object         = false;
+bool ARB_buffer_storage             = false;
+bool ARB_sync                       = false;
+bool ARB_sparse_texture             = false;
 #endif
 bool ARB_shader_texture_lod         = false;
 bool EXT_texture_compression_s3tc   = false;
 bool EXT_texture_filter_anisotropic = false;
 bool MESA_pack_invert               = false;
+bool EXT_unpack_subimage            = false;
+bool ARB_get_program_binary         = false;
+bool KHR_parallel_shader_compile    = false;
+bool ARB_instanced_arrays           = false;
+bool ARB_draw_elements_base_vertex  = false;
+bool ARB_texture_float              = false;
+bool ARB_half_float_vertex          = false;
+bool OVR_multiview                  = false;
+bool ARB_timer_query                = false;
+bool ARB_uniform_buffer_object      = false;
+bool ARB_clip_control               = false;
 GLint maxPointSize                  = 0;
 GLint maxTextureSize                = 0;
 GLfloat maxLineWidth                = 0.0f;
@@ -41,11 +55,36 @@ bool init(util::array_view<std::string> ignore) noexcept
 #else
     ARB_vertex_array_object        = check_extension(ignore, "GL_ARB_vertex_array_object");
     EXT_framebuffer_object         = check_extension(ignore, "GL_EXT_framebuffer_object");
+    ARB_buffer_storage             = check_extension(ignore, "GL_ARB_buffer_storage");
+    ARB_sync                       = check_extension(ignore, "GL_ARB_sync");
 #endif
     ARB_shader_texture_lod         = check_extension(ignore, "GL_ARB_shader_texture_lod");
     EXT_texture_compression_s3tc   = check_extension(ignore, "GL_EXT_texture_compression_s3tc");
     EXT_texture_filter_anisotropic = check_extension(ignore, "GL_EXT_texture_filter_anisotropic");
     MESA_pack_invert               = check_extension(ignore, "GL_MESA_pack_invert");
+    KHR_parallel_shader_compile    = check_extension(ignore, "GL_KHR_parallel_shader_compile");
+#ifdef GL_ES
+    EXT_unpack_subimage            = checkVersion(30) || check_extension(ignore, "GL_EXT_unpack_subimage");
+    ARB_get_program_binary         = checkVersion(30) || check_extension(ignore, "GL_OES_get_program_binary");
+    ARB_instanced_arrays           = checkVersion(30);
+    ARB_draw_elements_base_vertex  = checkVersion(32) || check_extension(ignore, "GL_OES_draw_elements_base_vertex") ||
+                                                          check_extension(ignore, "GL_EXT_draw_elements_base_vertex");
+    ARB_texture_float              = checkVersion(30) && check_extension(ignore, "GL_OES_texture_3D");
+    ARB_half_float_vertex          = checkVersion(30);
+#else
+    EXT_unpack_subimage            = true;
+    ARB_get_program_binary         = checkVersion(41) || check_extension(ignore, "GL_ARB_get_program_binary");
+    ARB_instanced_arrays           = checkVersion(33) || (check_extension(ignore, "GL_ARB_instanced_arrays") &&
+                                                          check_extension(ignore, "GL_ARB_draw_instanced"));
+    ARB_draw_elements_base_vertex  = checkVersion(32) || check_extension(ignore, "GL_ARB_draw_elements_base_vertex");
+    ARB_texture_float              = checkVersion(30) || check_extension(ignore, "GL_ARB_texture_float");
+    ARB_half_float_vertex          = checkVersion(30) || check_extension(ignore, "GL_ARB_half_float_vertex");
+    OVR_multiview                  = checkVersion(30) && check_extension(ignore, "GL_OVR_multiview");
+    ARB_timer_query                = checkVersion(33) || check_extension(ignore, "GL_ARB_timer_query");
+    ARB_uniform_buffer_object      = check_extension(ignore, "GL_ARB_uniform_buffer_object");
+    ARB_clip_control               = checkVersion(45) || (checkVersion(30) && check_extension(ignore, "GL_ARB_clip_control"));
+    ARB_sparse_texture             = checkVersion(42) && check_extension(ignore, "GL_ARB_sparse_texture");
+#endif
 
     GLint pointSizeRange[2];
     GLfloat lineWidthRange[2];
@@ -61,6 +100,18 @@ bool init(util::array_view<std::string> ignore) noexcept
 
     glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
 
+    // Let the driver choose how many threads compile shaders
+    if (KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(0xffffffffu);
+
+    // Drivers may support the extension without any binary formats
+    if (ARB_get_program_binary)
+    {
+        GLint nFormats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nFormats);
+        ARB_get_program_binary = nFormats > 0;
+    }
+
     if (gl::EXT_texture_filter_anisotropic)
         glGetIntegerv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxTextureAnisotropy);
 
@@ -25,12 +25,43 @@ extern bool ARB_shader_texture_lod;
 extern bool EXT_texture_compression_s3tc;
 extern bool EXT_texture_filter_anisotropic;
 extern bool MESA_pack_invert;
+// GL_UNPACK_ROW_LENGTH and the skip parameters, core in OpenGL and GLES 3
+extern bool EXT_unpack_subimage;
+// glGetProgramBinary, core in OpenGL 4.1 and GLES 3
+extern bool ARB_get_program_binary;
+extern bool KHR_parallel_shader_compile;
+// glDrawArraysInstanced and glVertexAttribDivisor, core in OpenGL 3.3 and GLES 3
+extern bool ARB_instanced_arrays;
+// glDrawElementsBaseVertex, core in OpenGL 3.2 and GLES 3.2
+extern bool ARB_draw_elements_base_vertex;
+// Floating point textures, core in OpenGL 3.0 and GLES 3; on GLES the 3D
+// textures of the shading language are also needed
+extern bool ARB_texture_float;
+// Half float vertex attributes, core in OpenGL 3.0 and GLES 3
+extern bool ARB_half_float_vertex;
+// Rendering to several layers of a texture array in one pass; only used
+// with desktop OpenGL, as the shaders for GLES are written in ESSL 1.00
+extern bool OVR_multiview;
+// Timestamp queries, core in OpenGL 3.3; not used with GLES, where they
+// need EXT_disjoint_timer_query
+extern bool ARB_timer_query;
+// Uniform blocks, core in OpenGL 3.1; only used with desktop OpenGL, and
+// only through the extension, as the shaders are written in GLSL 1.20
+extern bool ARB_uniform_buffer_object;
+// glClipControl, core in OpenGL 4.5, together with the floating point
+// depth buffers of OpenGL 3.0; only used with desktop OpenGL
+extern bool ARB_clip_control;
 #ifdef GL_ES
 extern bool OES_vertex_array_object;
 extern bool OES_texture_border_clamp;
 #else
 extern bool ARB_vertex_array_object;
 extern bool EXT_framebuffer_object;
+extern bool ARB_buffer_storage;
+extern bool ARB_sync;
+// Textures whose pages are committed to memory separately, together with
+// the immutable storage and format queries of OpenGL 4.2
+extern bool ARB_sparse_texture;
 #endif
 extern GLint maxPointSize;
 extern GLint maxTextureSize;
@@ -0,0 +1,146 @@
+// gpuorbits.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Elliptical orbit paths generated by the vertex shader.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <celcompat/numbers.h>
+#include "shadermanager.h"
+#include "gpuorbits.h"
+#include "glstate.h"
+
+namespace
+{
+// Number of line segments in every orbit path. Points at uniform steps of
+// eccentric anomaly crowd together around the pericenter, where eccentric
+// orbits bend the most.
+constexpr int OrbitPathSegments = 256;
+}
+
+GPUOrbitPaths::~GPUOrbitPaths()
+{
+    if (vertexBuffer != 0)
+        celestia::gl::deleteBuffers(1, &vertexBuffer);
+    if (instanceBuffer != 0)
+        celestia::gl::deleteBuffers(1, &instanceBuffer);
+}
+
+bool GPUOrbitPaths::isSupported()
+{
+    return celestia::gl::ARB_instanced_arrays;
+}
+
+void GPUOrbitPaths::clear()
+{
+    instances.clear();
+    uploaded = false;
+}
+
+void GPUOrbitPaths::add(const Eigen::Vector3d& center,
+                        const Eigen::Vector3d& majorAxis,
+                        const Eigen::Vector3d& minorAxis,
+                        const Eigen::Vector4f& color)
+{
+    OrbitInstance& instance = instances.emplace_back();
+    for (int i = 0; i < 3; i++)
+    {
+        instance.center[i] = static_cast<float>(center[i]);
+        instance.majorAxis[i] = static_cast<float>(majorAxis[i]);
+        instance.minorAxis[i] = static_cast<float>(minorAxis[i]);
+    }
+    for (int i = 0; i < 4; i++)
+        instance.color[i] = static_cast<unsigned char>(std::clamp(color[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+void GPUOrbitPaths::createVertexBuffer()
+{
+    if (vertexBuffer != 0)
+        return;
+
+    // Cosine and sine of the eccentric anomaly, with the first point
+    // repeated at the end to close the path
+    std::vector<float> vertices;
+    vertices.reserve((OrbitPathSegments + 1) * 2);
+    for (int i = 0; i <= OrbitPathSegments; i++)
+    {
+        double E = 2.0 * celestia::numbers::pi * (i % OrbitPathSegments) / OrbitPathSegments;
+        vertices.push_back(static_cast<float>(std::cos(E)));
+        vertices.push_back(static_cast<float>(std::sin(E)));
+    }
+
+    glGenBuffers(1, &vertexBuffer);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    celestia::gl::bufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GPUOrbitPaths::draw()
+{
+    if (instances.empty())
+        return;
+
+    createVertexBuffer();
+
+    if (!uploaded)
+    {
+        if (instanceBuffer == 0)
+            glGenBuffers(1, &instanceBuffer);
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        // Orphan the buffer of the previous frame before filling it
+        celestia::gl::bufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(OrbitInstance), nullptr, GL_STREAM_DRAW);
+        celestia::gl::bufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(OrbitInstance), instances.data());
+        uploaded = true;
+    }
+
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
+    glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
+                          2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+    // The other attributes advance once per orbit
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    const GLuint instanceAttributes[] =
+    {
+        CelestiaGLProgram::TextureCoord0AttributeIndex,
+        CelestiaGLProgram::TextureCoord1AttributeIndex,
+        CelestiaGLProgram::TextureCoord2AttributeIndex,
+        CelestiaGLProgram::ColorAttributeIndex,
+    };
+    for (GLuint index : instanceAttributes)
+    {
+        glEnableVertexAttribArray(index);
+        glVertexAttribDivisor(index, 1);
+    }
+    glVertexAttribPointer(CelestiaGLProgram::TextureCoord0AttributeIndex,
+                          3, GL_FLOAT, GL_FALSE, sizeof(OrbitInstance),
+                          reinterpret_cast<const void*>(offsetof(OrbitInstance, center)));
+    glVertexAttribPointer(CelestiaGLProgram::TextureCoord1AttributeIndex,
+                          3, GL_FLOAT, GL_FALSE, sizeof(OrbitInstance),
+                          reinterpret_cast<const void*>(offsetof(OrbitInstance, majorAxis)));
+    glVertexAttribPointer(CelestiaGLProgram::TextureCoord2AttributeIndex,
+                          3, GL_FLOAT, GL_FALSE, sizeof(OrbitInstance),
+                          reinterpret_cast<const void*>(offsetof(OrbitInstance, minorAxis)));
+    glVertexAttribPointer(CelestiaGLProgram::ColorAttributeIndex,
+                          4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(OrbitInstance),
+                          reinterpret_cast<const void*>(offsetof(OrbitInstance, color)));
+
+    celestia::gl::drawArraysInstanced(GL_LINE_STRIP, 0, OrbitPathSegments + 1,
+                                      static_cast<GLsizei>(instances.size()));
+
+    // Other vertex arrays expect every attribute to advance per vertex
+    for (GLuint index : instanceAttributes)
+    {
+        glVertexAttribDivisor(index, 0);
+        glDisableVertexAttribArray(index);
+    }
+    glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+}
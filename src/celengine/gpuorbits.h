@@ -0,0 +1,67 @@
+// gpuorbits.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Elliptical orbit paths generated by the vertex shader.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <vector>
+#include <Eigen/Core>
+#include "glsupport.h"
+
+// GPUOrbitPaths draws the paths of orbits that are fixed ellipses without
+// sampling them on the CPU. A static vertex buffer holds the cosine and
+// sine of eccentric anomalies around the ellipse, and each orbit is one
+// instance with the center and the semiaxes of its ellipse, from which the
+// vertex shader computes the points of the path. All of the orbits of a
+// frame are drawn with a single instanced draw call.
+//
+// The ellipses are given relative to the observer, and are computed in
+// double precision on the CPU, so that single precision is enough on the
+// GPU even for orbits far from the origin of the universal frame.
+class GPUOrbitPaths
+{
+ public:
+    GPUOrbitPaths() = default;
+    ~GPUOrbitPaths();
+    GPUOrbitPaths(const GPUOrbitPaths&) = delete;
+    GPUOrbitPaths& operator=(const GPUOrbitPaths&) = delete;
+
+    // Return true if the OpenGL implementation supports instanced drawing
+    static bool isSupported();
+
+    void clear();
+    // Add the ellipse center + cos(E) * majorAxis + sin(E) * minorAxis,
+    // with coordinates relative to the observer in the universal frame.
+    void add(const Eigen::Vector3d& center,
+             const Eigen::Vector3d& majorAxis,
+             const Eigen::Vector3d& minorAxis,
+             const Eigen::Vector4f& color);
+    bool empty() const { return instances.empty(); }
+
+    // Draw the orbits added since clear() with the currently bound program.
+    // The first call after clear() uploads them.
+    void draw();
+
+ private:
+    struct OrbitInstance
+    {
+        float center[3];
+        float majorAxis[3];
+        float minorAxis[3];
+        unsigned char color[4];
+    };
+
+    void createVertexBuffer();
+
+    GLuint vertexBuffer{ 0 };
+    GLuint instanceBuffer{ 0 };
+    std::vector<OrbitInstance> instances;
+    bool uploaded{ false };
+};
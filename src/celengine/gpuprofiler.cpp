@@ -0,0 +1,138 @@
+// gpuprofiler.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Timer queries measuring the GPU time of profiler zones.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "gpuprofiler.h"
+
+#include <chrono>
+
+using celestia::util::Profiler;
+
+namespace
+{
+
+// Queries are dropped when the results don't come, so that they don't
+// pile up
+constexpr std::size_t MaxPendingIntervals = 1024;
+
+} // end unnamed namespace
+
+GPUProfiler::GPUProfiler(Profiler& _profiler) :
+    profiler(_profiler)
+{
+}
+
+GPUProfiler::~GPUProfiler()
+{
+    for (const Interval& interval : intervals)
+    {
+        freeQueries.push_back(interval.startQuery);
+        freeQueries.push_back(interval.endQuery);
+    }
+    if (!freeQueries.empty())
+        glDeleteQueries(static_cast<GLsizei>(freeQueries.size()), freeQueries.data());
+}
+
+bool
+GPUProfiler::isSupported()
+{
+    return celestia::gl::ARB_timer_query;
+}
+
+void
+GPUProfiler::update()
+{
+    // The timestamps are converted with the latest offset between the
+    // clocks, so the zones of the GPU may drift a little on traces.
+    GLint64 gpuNow = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    gpuEpoch = Profiler::clock::now() - std::chrono::duration_cast<Profiler::clock::duration>(std::chrono::nanoseconds(gpuNow));
+
+    // Queries complete in order, so the first unavailable result ends the
+    // available ones.
+    while (!intervals.empty())
+    {
+        const Interval& interval = intervals.front();
+        if (!interval.ended)
+            break;
+
+        GLint available = 0;
+        glGetQueryObjectiv(interval.endQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available == 0)
+            break;
+
+        GLuint64 start = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(interval.startQuery, GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(interval.endQuery, GL_QUERY_RESULT, &end);
+        profiler.addTime(interval.zone, interval.frame, toProfilerTime(start), toProfilerTime(end));
+
+        freeQueries.push_back(interval.startQuery);
+        freeQueries.push_back(interval.endQuery);
+        intervals.pop_front();
+        firstId++;
+    }
+}
+
+std::uint64_t
+GPUProfiler::begin(const char* name)
+{
+    if (intervals.size() >= MaxPendingIntervals)
+    {
+        freeQueries.push_back(intervals.front().startQuery);
+        freeQueries.push_back(intervals.front().endQuery);
+        intervals.pop_front();
+        firstId++;
+    }
+
+    Interval interval;
+    interval.zone = profiler.getZone(name, Profiler::Source::GPU, depth++);
+    interval.frame = profiler.getFrame();
+    interval.startQuery = newQuery();
+    interval.endQuery = newQuery();
+    interval.ended = false;
+    glQueryCounter(interval.startQuery, GL_TIMESTAMP);
+    intervals.push_back(interval);
+
+    return firstId + intervals.size() - 1;
+}
+
+void
+GPUProfiler::end(std::uint64_t id)
+{
+    depth--;
+    // The interval may have been dropped
+    if (id < firstId)
+        return;
+
+    Interval& interval = intervals[id - firstId];
+    glQueryCounter(interval.endQuery, GL_TIMESTAMP);
+    interval.ended = true;
+}
+
+GLuint
+GPUProfiler::newQuery()
+{
+    if (freeQueries.empty())
+    {
+        freeQueries.resize(16);
+        glGenQueries(static_cast<GLsizei>(freeQueries.size()), freeQueries.data());
+    }
+
+    GLuint query = freeQueries.back();
+    freeQueries.pop_back();
+    return query;
+}
+
+Profiler::clock::time_point
+GPUProfiler::toProfilerTime(GLuint64 timestamp) const
+{
+    return gpuEpoch + std::chrono::duration_cast<Profiler::clock::duration>(std::chrono::nanoseconds(timestamp));
+}
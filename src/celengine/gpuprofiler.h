@@ -0,0 +1,91 @@
+// gpuprofiler.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Timer queries measuring the GPU time of profiler zones.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <celutil/profiler.h>
+#include "glsupport.h"
+
+// GPUProfiler times zones on the GPU with a pair of timestamp queries, so
+// that zones can nest, which isn't possible with GL_TIME_ELAPSED queries.
+// The results are read without waiting for the GPU in update(), usually
+// a few frames later, and added to the frames of their zones.
+class GPUProfiler
+{
+ public:
+    explicit GPUProfiler(celestia::util::Profiler& profiler);
+    ~GPUProfiler();
+    GPUProfiler(const GPUProfiler&) = delete;
+    GPUProfiler& operator=(const GPUProfiler&) = delete;
+
+    static bool isSupported();
+
+    // Add the available results to the profiler
+    void update();
+
+    // Start a zone, returning its identifier for end()
+    std::uint64_t begin(const char* name);
+    void end(std::uint64_t id);
+
+ private:
+    struct Interval
+    {
+        std::size_t zone;
+        std::uint64_t frame;
+        GLuint startQuery;
+        GLuint endQuery;
+        bool ended;
+    };
+
+    GLuint newQuery();
+    celestia::util::Profiler::clock::time_point toProfilerTime(GLuint64) const;
+
+    celestia::util::Profiler& profiler;
+    // Intervals waiting for their results, in the order they started
+    std::deque<Interval> intervals;
+    // Identifier of the first interval
+    std::uint64_t firstId{ 0 };
+    std::vector<GLuint> freeQueries;
+    int depth{ 0 };
+    // Time of the profiler clock at GPU timestamp zero
+    celestia::util::Profiler::clock::time_point gpuEpoch;
+};
+
+// GPUProfileZone times a zone on the CPU, and on the GPU when gpuProfiler
+// isn't nullptr.
+class GPUProfileZone
+{
+ public:
+    GPUProfileZone(GPUProfiler* _gpuProfiler, const char* name) :
+        cpuZone(name),
+        gpuProfiler(_gpuProfiler)
+    {
+        if (gpuProfiler != nullptr)
+            id = gpuProfiler->begin(name);
+    }
+
+    ~GPUProfileZone()
+    {
+        if (gpuProfiler != nullptr)
+            gpuProfiler->end(id);
+    }
+
+    GPUProfileZone(const GPUProfileZone&) = delete;
+    GPUProfileZone& operator=(const GPUProfileZone&) = delete;
+
+ private:
+    celestia::util::ProfileZone cpuZone;
+    GPUProfiler* gpuProfiler;
+    std::uint64_t id{ 0 };
+};
@@ -0,0 +1,160 @@
+// gpustarfield.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Star catalog kept in GPU memory for point star rendering.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <cstddef>
+#include <celutil/color.h>
+#include <celutil/logger.h>
+#include "shadermanager.h"
+#include "star.h"
+#include "starcolors.h"
+#include "stardb.h"
+#include "gpustarfield.h"
+#include "glstate.h"
+
+using celestia::util::GetLogger;
+
+GPUStarField::~GPUStarField()
+{
+    if (vbo != 0)
+        celestia::gl::deleteBuffers(1, &vbo);
+    if (velocityVbo != 0)
+        celestia::gl::deleteBuffers(1, &velocityVbo);
+}
+
+bool GPUStarField::update(const StarDatabase& _starDB, const ColorTemperatureTable* _colorTemp)
+{
+    if (&_starDB == starDB && _starDB.size() == nStars && _colorTemp == colorTemp)
+        return vbo != 0;
+
+    starDB = &_starDB;
+    colorTemp = _colorTemp;
+    nStars = _starDB.size();
+    firstStar = nStars > 0 ? _starDB.getStar(0) : nullptr;
+    cpuStars.clear();
+
+    if (nStars == 0 || colorTemp == nullptr)
+        return false;
+
+    std::vector<StarVertex> vertices(nStars);
+    std::vector<Eigen::Vector3f> velocities(nStars);
+    bool hasMotion = false;
+    for (std::uint32_t i = 0; i < nStars; i++)
+    {
+        const Star& star = firstStar[i];
+        StarVertex& vertex = vertices[i];
+        const Eigen::Vector3f& position = star.getPosition();
+        vertex.position[0] = position.x();
+        vertex.position[1] = position.y();
+        vertex.position[2] = position.z();
+        vertex.magnitude[0] = star.getAbsoluteMagnitude();
+        vertex.magnitude[1] = star.getExtinction();
+        colorTemp->lookupColor(star.getTemperature()).get(vertex.color);
+        vertex.color[3] = 255;
+        velocities[i] = star.getSpaceVelocity();
+        hasMotion = hasMotion || velocities[i] != Eigen::Vector3f::Zero();
+        if (star.getOrbit() != nullptr)
+        {
+            vertex.color[3] = 0;
+            cpuStars.push_back(&star);
+        }
+    }
+
+    if (vbo == 0)
+        glGenBuffers(1, &vbo);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, vbo);
+    celestia::gl::bufferData(GL_ARRAY_BUFFER, sizeof(StarVertex) * nStars, vertices.data(), GL_STATIC_DRAW);
+
+    if (hasMotion)
+    {
+        if (velocityVbo == 0)
+            glGenBuffers(1, &velocityVbo);
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, velocityVbo);
+        celestia::gl::bufferData(GL_ARRAY_BUFFER, sizeof(float) * 3 * nStars, velocities.data(), GL_STATIC_DRAW);
+    }
+    else if (velocityVbo != 0)
+    {
+        celestia::gl::deleteBuffers(1, &velocityVbo);
+        velocityVbo = 0;
+    }
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+
+    GetLogger()->debug("Uploaded {} stars to the GPU, {} are drawn on the CPU.\n",
+                       nStars, cpuStars.size());
+    return true;
+}
+
+void GPUStarField::clearRanges()
+{
+    rangeFirst.clear();
+    rangeCount.clear();
+}
+
+void GPUStarField::addRange(const Star* first, std::uint32_t count)
+{
+    auto start = static_cast<GLint>(first - firstStar);
+    // Sibling nodes are usually adjacent in the star array; merge their
+    // ranges to keep the number of draws down.
+    if (!rangeFirst.empty() && rangeFirst.back() + rangeCount.back() == start)
+    {
+        rangeCount.back() += static_cast<GLsizei>(count);
+        return;
+    }
+
+    rangeFirst.push_back(start);
+    rangeCount.push_back(static_cast<GLsizei>(count));
+}
+
+void GPUStarField::draw() const
+{
+    if (rangeFirst.empty())
+        return;
+
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, vbo);
+    glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
+    glEnableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
+    glEnableVertexAttribArray(CelestiaGLProgram::ColorAttributeIndex);
+    glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
+                          3, GL_FLOAT, GL_FALSE, sizeof(StarVertex),
+                          reinterpret_cast<const void*>(offsetof(StarVertex, position)));
+    glVertexAttribPointer(CelestiaGLProgram::TextureCoord0AttributeIndex,
+                          2, GL_FLOAT, GL_FALSE, sizeof(StarVertex),
+                          reinterpret_cast<const void*>(offsetof(StarVertex, magnitude)));
+    glVertexAttribPointer(CelestiaGLProgram::ColorAttributeIndex,
+                          4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(StarVertex),
+                          reinterpret_cast<const void*>(offsetof(StarVertex, color)));
+
+    if (velocityVbo != 0)
+    {
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, velocityVbo);
+        glEnableVertexAttribArray(CelestiaGLProgram::NormalAttributeIndex);
+        glVertexAttribPointer(CelestiaGLProgram::NormalAttributeIndex,
+                              3, GL_FLOAT, GL_FALSE, 0, nullptr);
+    }
+    else
+    {
+        glVertexAttrib3f(CelestiaGLProgram::NormalAttributeIndex, 0.0f, 0.0f, 0.0f);
+    }
+
+#ifdef GL_ES
+    for (std::size_t i = 0; i < rangeFirst.size(); i++)
+        celestia::gl::drawArrays(GL_POINTS, rangeFirst[i], rangeCount[i]);
+#else
+    glMultiDrawArrays(GL_POINTS, rangeFirst.data(), rangeCount.data(),
+                      static_cast<GLsizei>(rangeFirst.size()));
+#endif
+
+    if (velocityVbo != 0)
+        glDisableVertexAttribArray(CelestiaGLProgram::NormalAttributeIndex);
+    glDisableVertexAttribArray(CelestiaGLProgram::ColorAttributeIndex);
+    glDisableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
+    glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+}
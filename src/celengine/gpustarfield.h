@@ -0,0 +1,76 @@
+// gpustarfield.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Star catalog kept in GPU memory for point star rendering.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "glsupport.h"
+
+class ColorTemperatureTable;
+class Star;
+class StarDatabase;
+
+// GPUStarField holds a copy of the star catalog in a static vertex buffer.
+// The stars are stored in the order of the star database, which is the
+// order of the star octree, so the stars of every octree node are one
+// contiguous range of vertices. Each frame only the ranges of the visible
+// nodes are drawn and the vertex shader computes the apparent magnitude,
+// the point size and whether the star is drawn at all; no per-star data is
+// sent to the GPU. The space velocities of the stars are kept in a second
+// buffer, only created when some stars move, from which the vertex shader
+// propagates the positions to the time of the observer.
+//
+// Stars with orbits move, and are left to the CPU star renderer.
+class GPUStarField
+{
+ public:
+    GPUStarField() = default;
+    ~GPUStarField();
+    GPUStarField(const GPUStarField&) = delete;
+    GPUStarField& operator=(const GPUStarField&) = delete;
+
+    // Upload the stars of starDB unless they are already uploaded with the
+    // same color table. Returns false if the stars can't be uploaded.
+    bool update(const StarDatabase& starDB, const ColorTemperatureTable* colorTemp);
+
+    // Stars that are not drawn from the vertex buffer
+    const std::vector<const Star*>& getCPUStars() const { return cpuStars; }
+
+    void clearRanges();
+    // Add the stars of an octree node to the stars drawn by draw(); stars
+    // must be part of the uploaded database.
+    void addRange(const Star* first, std::uint32_t count);
+    // Draw the collected ranges with the currently bound program.
+    void draw() const;
+
+ private:
+    struct StarVertex
+    {
+        float position[3];
+        // Absolute magnitude and extinction
+        float magnitude[2];
+        // The alpha channel is zero for stars that are drawn by the CPU
+        unsigned char color[4];
+    };
+
+    GLuint vbo{ 0 };
+    // Space velocities, or 0 if none of the stars move
+    GLuint velocityVbo{ 0 };
+    const StarDatabase* starDB{ nullptr };
+    const ColorTemperatureTable* colorTemp{ nullptr };
+    const Star* firstStar{ nullptr };
+    std::uint32_t nStars{ 0 };
+
+    std::vector<const Star*> cpuStars;
+    std::vector<GLint> rangeFirst;
+    std::vector<GLsizei> rangeCount;
+};
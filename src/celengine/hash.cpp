@@ -8,6 +8,7 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <utility>
 #include <celutil/color.h>
 #include <celutil/fsutils.h>
@@ -28,19 +29,35 @@ AssociativeArray::~AssociativeArray()
 }
 
 
+namespace
+{
+bool entryLess(const HashEntry& entry, const string& key)
+{
+    return entry.first < key;
+}
+} // end unnamed namespace
+
+
 Value* AssociativeArray::getValue(const string& key) const
 {
-    map<string, Value*>::const_iterator iter = assoc.find(key);
-    if (iter == assoc.end())
+    auto iter = std::lower_bound(assoc.begin(), assoc.end(), key, entryLess);
+    if (iter == assoc.end() || iter->first != key)
         return nullptr;
 
     return iter->second;
 }
 
 
-void AssociativeArray::addValue(const string& key, Value& val)
+void AssociativeArray::addValue(string key, Value& val)
 {
-    assoc.insert(map<string, Value*>::value_type(key, &val));
+    auto iter = std::lower_bound(assoc.begin(), assoc.end(), key, entryLess);
+    if (iter != assoc.end() && iter->first == key)
+    {
+        delete &val;
+        return;
+    }
+
+    assoc.emplace(iter, std::move(key), &val);
 }
 
 
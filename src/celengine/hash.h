@@ -10,7 +10,9 @@
 
 #pragma once
 
-#include <map>
+#include <string>
+#include <utility>
+#include <vector>
 #include <celcompat/filesystem.h>
 #include <celmath/mathlib.h>
 #include <Eigen/Geometry>
@@ -19,7 +21,8 @@
 class Color;
 class Value;
 
-using HashIterator = std::map<std::string, Value*>::const_iterator;
+using HashEntry = std::pair<std::string, Value*>;
+using HashIterator = std::vector<HashEntry>::const_iterator;
 
 class AssociativeArray
 {
@@ -32,7 +35,9 @@ class AssociativeArray
     AssociativeArray& operator=(AssociativeArray&) = delete;
 
     Value* getValue(const std::string&) const;
-    void addValue(const std::string&, Value&);
+    // Takes ownership of the value; if the key is already present the
+    // first value is kept and the new one deleted.
+    void addValue(std::string, Value&);
 
     bool getNumber(const std::string&, double&) const;
     bool getNumber(const std::string&, float&) const;
@@ -78,7 +83,9 @@ class AssociativeArray
     }
 
  private:
-    std::map<std::string, Value*> assoc;
+    // Sorted by key. Object definitions have a few dozen properties at
+    // most, so a flat table is smaller and faster to build than a map.
+    std::vector<HashEntry> assoc;
 };
 
 using Hash = AssociativeArray;
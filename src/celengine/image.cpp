@@ -9,12 +9,16 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstddef>
 #include <fstream>
 #include <iostream>
+#include <Eigen/Core>
 #include <celengine/glsupport.h>
 #include <celutil/logger.h>
 #include <celutil/filetype.h>
 #include <celutil/gettext.h>
+#include <celutil/jobsystem.h>
 #include <celimage/imageformats.h>
 #include "image.h"
 
@@ -143,7 +147,7 @@ uint8_t* Image::getPixels()
 
 uint8_t* Image::getPixelRow(int mip, int row)
 {
-    /*int w = max(width >> mip, 1); Unused*/
+    int w = max(width >> mip, 1);
     int h = max(height >> mip, 1);
     if (mip >= mipLevels || row >= h)
         return nullptr;
@@ -152,7 +156,7 @@ uint8_t* Image::getPixelRow(int mip, int row)
     if (isCompressed())
         return nullptr;
 
-    return getMipLevel(mip) + row * pitch;
+    return getMipLevel(mip) + row * pad(w * components);
 }
 
 uint8_t* Image::getPixelRow(int row)
@@ -209,11 +213,55 @@ bool Image::hasAlpha() const
     }
 }
 
+namespace
+{
+// Rows of the normal map computed by each job
+constexpr std::size_t NormalMapBandRows = 32;
+
+// Compute the normals of a row from the differences between the heights
+// h0 of the row and h1 of the previous row, and between adjacent texels;
+// the first texel is differenced with texel first1 of the row. The
+// differences are gathered into arrays so that the normalization runs on
+// vectors: the scalar loop can't be vectorized because sqrt() may set errno.
+void computeNormalRow(const uint8_t* h0, const uint8_t* h1, int width,
+                      int components, int j0, int first1, float scale,
+                      Eigen::ArrayXf& dx, Eigen::ArrayXf& dy,
+                      uint8_t* normals)
+{
+    dx.resize(width);
+    dy.resize(width);
+    dx[0] = (float) (h0[first1 * components] - h0[j0 * components]);
+    dy[0] = (float) (h1[j0 * components] - h0[j0 * components]);
+    for (int j = 1; j < width; j++)
+    {
+        dx[j] = (float) (h0[(j - 1) * components] - h0[j * components]);
+        dy[j] = (float) (h1[j * components] - h0[j * components]);
+    }
+
+    dx *= scale * (1.0f / 255.0f);
+    dy *= scale * (1.0f / 255.0f);
+    Eigen::ArrayXf rmag = (dx.square() + dy.square() + 1.0f).sqrt().inverse();
+    dx *= rmag;
+    dy *= rmag;
+
+    for (int j = 0; j < width; j++)
+    {
+        uint8_t* n = normals + j * 4;
+        n[0] = (uint8_t) (128 + 127 * dx[j]);
+        n[1] = (uint8_t) (128 + 127 * dy[j]);
+        n[2] = (uint8_t) (128 + 127 * rmag[j]);
+        n[3] = 255;
+    }
+}
+} // anonymous namespace
+
 /**
  * Convert an input height map to a normal map.  Ideally, a single channel
  * input should be used.  If not, the first color channel of the input image
  * is the one only one used when generating normals.  This produces the
  * expected results for grayscale values in RGB images.
+ *
+ * Bands of rows are converted in parallel on the job system.
  */
 Image* Image::computeNormalMap(float scale, bool wrap) const
 {
@@ -227,15 +275,20 @@ Image* Image::computeNormalMap(float scale, bool wrap) const
     uint8_t* nmPixels = normalMap->getPixels();
     int nmPitch = normalMap->getPitch();
 
-    // Compute normals using differences between adjacent texels.
-    for (int i = 0; i < height; i++)
+    // Compute normals using differences between adjacent texels. At the
+    // edges, the heights either wrap around, or the differences of the
+    // next row or column are used.
+    int j0 = wrap ? 0 : std::min(1, width - 1);
+    int first1 = wrap ? width - 1 : 0;
+    celestia::util::ParallelFor(0, height, NormalMapBandRows,
+                                [&](std::size_t first, std::size_t last)
     {
-        for (int j = 0; j < width; j++)
+        Eigen::ArrayXf dx;
+        Eigen::ArrayXf dy;
+        for (auto i = static_cast<int>(first); i < static_cast<int>(last); i++)
         {
             int i0 = i;
-            int j0 = j;
             int i1 = i - 1;
-            int j1 = j - 1;
             if (i1 < 0)
             {
                 if (wrap)
@@ -244,40 +297,17 @@ Image* Image::computeNormalMap(float scale, bool wrap) const
                 }
                 else
                 {
-                    i0++;
-                    i1++;
+                    i0 = std::min(1, height - 1);
+                    i1 = 0;
                 }
             }
-            if (j1 < 0)
-            {
-                if (wrap)
-                {
-                    j1 = width - 1;
-                }
-                else
-                {
-                    j0++;
-                    j1++;
-                }
-            }
-
-            auto h00 = (int) pixels[i0 * pitch + j0 * components];
-            auto h10 = (int) pixels[i0 * pitch + j1 * components];
-            auto h01 = (int) pixels[i1 * pitch + j0 * components];
-
-            float dx = (float) (h10 - h00) * (1.0f / 255.0f) * scale;
-            float dy = (float) (h01 - h00) * (1.0f / 255.0f) * scale;
 
-            auto mag = (float) sqrt(dx * dx + dy * dy + 1.0f);
-            float rmag = 1.0f / mag;
-
-            int n = i * nmPitch + j * 4;
-            nmPixels[n]     = (uint8_t) (128 + 127 * dx * rmag);
-            nmPixels[n + 1] = (uint8_t) (128 + 127 * dy * rmag);
-            nmPixels[n + 2] = (uint8_t) (128 + 127 * rmag);
-            nmPixels[n + 3] = 255;
+            computeNormalRow(pixels.get() + i0 * pitch,
+                             pixels.get() + i1 * pitch,
+                             width, components, j0, first1, scale, dx, dy,
+                             nmPixels + i * nmPitch);
         }
-    }
+    });
 
     return normalMap;
 }
@@ -309,6 +339,9 @@ Image* LoadImageFromFile(const fs::path& filename)
     case Content_DXT5NormalMap:
         img = LoadDDSImage(filename);
         break;
+    case Content_KTX2:
+        img = LoadKTX2Image(filename);
+        break;
     default:
         GetLogger()->error("{}: unrecognized or unsupported image file type.\n", filename);
         break;
@@ -0,0 +1,338 @@
+// impostorcache.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Billboard impostors of distant deep sky objects.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <celmath/mathlib.h>
+#include <celmath/geomutil.h>
+#include <celutil/logger.h>
+#include "deepskyobj.h"
+#include "framebuffer.h"
+#include "impostorcache.h"
+#include "render.h"
+#include "shadermanager.h"
+#include "vecgl.h"
+#include "glstate.h"
+
+using celestia::util::GetLogger;
+
+namespace
+{
+constexpr int AtlasSize = 1024;
+constexpr int CellSize = 64;
+constexpr int CellsPerRow = AtlasSize / CellSize;
+constexpr int CellCount = CellsPerRow * CellsPerRow;
+
+// Objects smaller than this on the screen are cheap enough to draw directly
+constexpr float MinImpostorPixels = 4.0f;
+// Largest number of billboards rendered in a frame
+constexpr unsigned int MaxUpdatesPerFrame = 16;
+
+// A billboard is rendered again once the direction to the observer changes
+// by more than about one degree, or the distance, brightness or pixel size
+// by more than five percent.
+constexpr float MinDirectionCos = 0.99985f;
+constexpr float MaxRelativeChange = 0.05f;
+
+bool withinTolerance(float value, float reference)
+{
+    return std::abs(value - reference) <= MaxRelativeChange * std::abs(reference);
+}
+}
+
+ImpostorCache::~ImpostorCache()
+{
+    if (atlasFbo != 0)
+        glDeleteFramebuffers(1, &atlasFbo);
+    if (atlasTexture != 0)
+        celestia::gl::deleteTextures(1, &atlasTexture);
+    if (vertexBuffer != 0)
+        celestia::gl::deleteBuffers(1, &vertexBuffer);
+}
+
+bool ImpostorCache::isSupported()
+{
+    return FramebufferObject::isSupported();
+}
+
+bool ImpostorCache::createAtlas()
+{
+    if (atlasTexture != 0)
+        return true;
+    if (atlasFailed)
+        return false;
+
+    glGenTextures(1, &atlasTexture);
+    celestia::gl::bindTexture(GL_TEXTURE_2D, atlasTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, AtlasSize, AtlasSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    celestia::gl::bindTexture(GL_TEXTURE_2D, 0);
+
+    GLint oldFboId;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFboId);
+    glGenFramebuffers(1, &atlasFbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, atlasFbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlasTexture, 0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, oldFboId);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        GetLogger()->warn("Error creating impostor atlas.\n");
+        glDeleteFramebuffers(1, &atlasFbo);
+        celestia::gl::deleteTextures(1, &atlasTexture);
+        atlasFbo = 0;
+        atlasTexture = 0;
+        atlasFailed = true;
+        return false;
+    }
+
+    freeCells.reserve(CellCount);
+    for (int cell = CellCount - 1; cell >= 0; cell--)
+        freeCells.push_back(cell);
+
+    return true;
+}
+
+void ImpostorCache::beginFrame()
+{
+    frame++;
+    updates = 0;
+    vertices.clear();
+}
+
+bool ImpostorCache::isCurrent(const Entry& entry,
+                              const Eigen::Vector3f& direction,
+                              float distance,
+                              float brightness,
+                              float pixelSize) const
+{
+    return direction.dot(entry.direction) >= MinDirectionCos &&
+           withinTolerance(distance, entry.distance) &&
+           withinTolerance(brightness, entry.brightness) &&
+           withinTolerance(pixelSize, entry.pixelSize);
+}
+
+// Return a free cell of the atlas, evicting the least recently used
+// billboard not drawn in this frame if needed, or -1 if every cell is in use.
+int ImpostorCache::allocateCell()
+{
+    if (!freeCells.empty())
+    {
+        int cell = freeCells.back();
+        freeCells.pop_back();
+        return cell;
+    }
+
+    auto oldest = entries.end();
+    for (auto iter = entries.begin(); iter != entries.end(); ++iter)
+    {
+        if (iter->second.lastUsed != frame &&
+            (oldest == entries.end() || iter->second.lastUsed < oldest->second.lastUsed))
+        {
+            oldest = iter;
+        }
+    }
+
+    if (oldest == entries.end())
+        return -1;
+
+    int cell = oldest->second.cell;
+    entries.erase(oldest);
+    return cell;
+}
+
+bool ImpostorCache::render(DeepSkyObject* dso,
+                           const Eigen::Vector3f& offset,
+                           const Eigen::Quaternionf& viewerOrientation,
+                           float brightness,
+                           float pixelSize,
+                           Renderer* renderer)
+{
+    float radius = dso->getImpostorRadius();
+    if (radius <= 0.0f)
+        return false;
+
+    float distance = offset.norm();
+    float pixels = 2.0f * radius / (distance * pixelSize);
+    if (pixels > static_cast<float>(CellSize) || pixels < MinImpostorPixels)
+        return false;
+
+    if (!createAtlas())
+        return false;
+
+    Eigen::Vector3f direction = offset / distance;
+    float impostorBrightness = dso->getImpostorBrightness(brightness);
+
+    Entry* entry;
+    if (auto iter = entries.find(dso); iter != entries.end())
+    {
+        entry = &iter->second;
+        if (updates < MaxUpdatesPerFrame &&
+            !isCurrent(*entry, direction, distance, impostorBrightness, pixelSize))
+        {
+            renderEntry(*entry, dso, offset, viewerOrientation, radius, brightness, pixelSize, renderer);
+        }
+    }
+    else
+    {
+        if (updates >= MaxUpdatesPerFrame)
+            return false;
+
+        int cell = allocateCell();
+        if (cell < 0)
+            return false;
+
+        entry = &entries[dso];
+        entry->cell = cell;
+        renderEntry(*entry, dso, offset, viewerOrientation, radius, brightness, pixelSize, renderer);
+    }
+
+    entry->lastUsed = frame;
+
+    // The billboard faces the direction it was rendered from and is
+    // centered on the current position of the object.
+    float s0 = static_cast<float>(entry->cell % CellsPerRow) / static_cast<float>(CellsPerRow);
+    float t0 = static_cast<float>(entry->cell / CellsPerRow) / static_cast<float>(CellsPerRow);
+    float s1 = s0 + 1.0f / static_cast<float>(CellsPerRow);
+    float t1 = t0 + 1.0f / static_cast<float>(CellsPerRow);
+
+    Vertex v0 = { offset - entry->right - entry->up, { s0, t0 } };
+    Vertex v1 = { offset + entry->right - entry->up, { s1, t0 } };
+    Vertex v2 = { offset + entry->right + entry->up, { s1, t1 } };
+    Vertex v3 = { offset - entry->right + entry->up, { s0, t1 } };
+    vertices.insert(vertices.end(), { v0, v1, v2, v0, v2, v3 });
+
+    return true;
+}
+
+void ImpostorCache::renderEntry(Entry& entry,
+                                DeepSkyObject* dso,
+                                const Eigen::Vector3f& offset,
+                                const Eigen::Quaternionf& viewerOrientation,
+                                float radius,
+                                float brightness,
+                                float pixelSize,
+                                Renderer* renderer)
+{
+    updates++;
+
+    float distance = offset.norm();
+    Eigen::Vector3f direction = offset / distance;
+
+    // Keep the billboard upright on the screen
+    Eigen::Vector3f viewerUp = viewerOrientation.conjugate() * Eigen::Vector3f::UnitY();
+    Eigen::Vector3f up = viewerUp - direction * direction.dot(viewerUp);
+    if (up.squaredNorm() < 1.0e-6f)
+        up = direction.unitOrthogonal();
+    up.normalize();
+    Eigen::Vector3f right = direction.cross(up);
+
+    // Look at the object from the observer, with a field of view just
+    // containing its impostor sphere
+    float tanHalfFov = radius / std::sqrt(distance * distance - radius * radius);
+    float halfSize = distance * tanHalfFov;
+
+    Eigen::Matrix3f cameraToWorld;
+    cameraToWorld << right, up, -direction;
+    Eigen::Quaternionf orientation(cameraToWorld.transpose());
+
+    Eigen::Matrix4f modelview = Eigen::Matrix4f::Identity();
+    modelview.topLeftCorner<3, 3>() = cameraToWorld.transpose();
+    modelview = celestia::vecgl::translate(modelview, offset);
+    Eigen::Matrix4f projection = celmath::Perspective(celmath::radToDeg(2.0f * std::atan(tanHalfFov)),
+                                                      1.0f,
+                                                      distance - radius,
+                                                      distance + radius);
+
+    // The impostor is drawn from the observer, not from the eyes
+    ShaderManager::SingleViewScope singleView(renderer->getShaderManager());
+    std::array<int, 4> viewport;
+    renderer->getViewport(viewport);
+    GLint oldFboId;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFboId);
+
+    int x = (entry.cell % CellsPerRow) * CellSize;
+    int y = (entry.cell / CellsPerRow) * CellSize;
+    glBindFramebuffer(GL_FRAMEBUFFER, atlasFbo);
+    glViewport(x, y, CellSize, CellSize);
+
+    Renderer::PipelineState ps;
+    ps.scissor = true;
+    renderer->setPipelineState(ps);
+    glScissor(x, y, CellSize, CellSize);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    dso->render(offset, orientation, brightness, pixelSize, { &projection, &modelview }, renderer);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, oldFboId);
+    renderer->setViewport(viewport);
+
+    entry.direction = direction;
+    entry.distance = distance;
+    entry.brightness = dso->getImpostorBrightness(brightness);
+    entry.pixelSize = pixelSize;
+    entry.right = right * halfSize;
+    entry.up = up * halfSize;
+}
+
+void ImpostorCache::draw(Renderer* renderer,
+                         const Eigen::Matrix4f& projection,
+                         const Eigen::Matrix4f& modelview)
+{
+    if (vertices.empty())
+        return;
+
+    auto *prog = renderer->getShaderManager().getShader("impostor");
+    if (prog == nullptr)
+        return;
+
+    if (vertexBuffer == 0)
+        glGenBuffers(1, &vertexBuffer);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    // Orphan the buffer of the previous frame before filling it
+    celestia::gl::bufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), nullptr, GL_STREAM_DRAW);
+    celestia::gl::bufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(Vertex), vertices.data());
+
+    glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
+    glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
+                          3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          reinterpret_cast<const void*>(offsetof(Vertex, position)));
+    glEnableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
+    glVertexAttribPointer(CelestiaGLProgram::TextureCoord0AttributeIndex,
+                          2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          reinterpret_cast<const void*>(offsetof(Vertex, texCoord)));
+
+    // The billboards hold colors premultiplied by their alpha
+    Renderer::PipelineState ps;
+    ps.blending = true;
+    ps.blendFunc = {GL_ONE, GL_ONE_MINUS_SRC_ALPHA};
+    renderer->setPipelineState(ps);
+
+    celestia::gl::activeTexture(GL_TEXTURE0);
+    celestia::gl::bindTexture(GL_TEXTURE_2D, atlasTexture);
+
+    prog->use();
+    prog->setMVPMatrices(projection, modelview);
+    prog->samplerParam("impostorTex") = 0;
+
+    celestia::gl::drawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(vertices.size()));
+
+    glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
+    glDisableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,104 @@
+// impostorcache.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Billboard impostors of distant deep sky objects.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include "glsupport.h"
+
+class DeepSkyObject;
+class Renderer;
+
+// ImpostorCache draws deep sky objects which are small on the screen from
+// billboards kept in a texture atlas. An object is rendered into its cell
+// of the atlas from the direction of the observer, and the billboard is
+// reused until the direction, distance, brightness or pixel size change
+// by more than a small tolerance. Only a limited number of billboards are
+// rendered each frame; objects waiting for an update keep their outdated
+// billboard in the meantime.
+//
+// Only objects with a non-zero impostor radius are drawn from billboards.
+class ImpostorCache
+{
+ public:
+    ImpostorCache() = default;
+    ~ImpostorCache();
+    ImpostorCache(const ImpostorCache&) = delete;
+    ImpostorCache& operator=(const ImpostorCache&) = delete;
+
+    // Return true if the OpenGL implementation supports rendering to
+    // textures
+    static bool isSupported();
+
+    // Start collecting the billboards of a frame
+    void beginFrame();
+
+    // Add the billboard of dso, rendering it first if needed. offset is the
+    // position of the object relative to the observer. Returns false if the
+    // object must be rendered directly.
+    bool render(DeepSkyObject* dso,
+                const Eigen::Vector3f& offset,
+                const Eigen::Quaternionf& viewerOrientation,
+                float brightness,
+                float pixelSize,
+                Renderer* renderer);
+
+    // Draw the billboards added since beginFrame
+    void draw(Renderer* renderer,
+              const Eigen::Matrix4f& projection,
+              const Eigen::Matrix4f& modelview);
+
+ private:
+    struct Entry
+    {
+        int cell;
+        std::uint32_t lastUsed;
+        // Observer direction and distance the billboard was rendered from
+        Eigen::Vector3f direction;
+        float distance;
+        float brightness;
+        float pixelSize;
+        // Half-axes of the billboard
+        Eigen::Vector3f right;
+        Eigen::Vector3f up;
+    };
+
+    struct Vertex
+    {
+        Eigen::Vector3f position;
+        Eigen::Vector2f texCoord;
+    };
+
+    bool createAtlas();
+    bool isCurrent(const Entry&, const Eigen::Vector3f& direction, float distance,
+                   float brightness, float pixelSize) const;
+    int allocateCell();
+    void renderEntry(Entry&, DeepSkyObject*, const Eigen::Vector3f& offset,
+                     const Eigen::Quaternionf& viewerOrientation,
+                     float radius, float brightness, float pixelSize,
+                     Renderer*);
+
+    GLuint atlasTexture{ 0 };
+    GLuint atlasFbo{ 0 };
+    bool atlasFailed{ false };
+
+    std::unordered_map<const DeepSkyObject*, Entry> entries;
+    std::vector<int> freeCells;
+    std::uint32_t frame{ 0 };
+    unsigned int updates{ 0 };
+
+    GLuint vertexBuffer{ 0 };
+    std::vector<Vertex> vertices;
+};
@@ -0,0 +1,94 @@
+// labeldeclutter.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Screen space overlap tests for labels.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <cmath>
+#include <cstddef>
+#include "labeldeclutter.h"
+
+namespace
+{
+// Cells are only dropped when there are more than this many; labels which
+// are far off the screen may add cells
+constexpr std::size_t MaxCells = 16384;
+}
+
+LabelDeclutter::LabelDeclutter(float _cellSize) :
+    cellSize(_cellSize)
+{
+}
+
+void LabelDeclutter::clear()
+{
+    rects.clear();
+    // Keep the cell vectors of the previous frame; labels tend to stay in
+    // the same place
+    if (cells.size() > MaxCells)
+    {
+        cells.clear();
+        return;
+    }
+    for (auto& [key, indices] : cells)
+        indices.clear();
+}
+
+std::uint64_t LabelDeclutter::cellKey(int x, int y) const
+{
+    return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32) |
+           static_cast<std::uint32_t>(y);
+}
+
+Eigen::Vector2i LabelDeclutter::cellIndex(const Eigen::Vector2f& point) const
+{
+    return Eigen::Vector2i(static_cast<int>(std::floor(point.x() / cellSize)),
+                           static_cast<int>(std::floor(point.y() / cellSize)));
+}
+
+bool LabelDeclutter::overlaps(const Eigen::AlignedBox2f& rect) const
+{
+    Eigen::Vector2i first = cellIndex(rect.min());
+    Eigen::Vector2i last = cellIndex(rect.max());
+    for (int y = first.y(); y <= last.y(); y++)
+    {
+        for (int x = first.x(); x <= last.x(); x++)
+        {
+            auto it = cells.find(cellKey(x, y));
+            if (it == cells.end())
+                continue;
+
+            for (std::uint32_t index : it->second)
+            {
+                // Rectangles which only touch don't overlap
+                const Eigen::AlignedBox2f& other = rects[index];
+                if (rect.min().x() < other.max().x() && other.min().x() < rect.max().x() &&
+                    rect.min().y() < other.max().y() && other.min().y() < rect.max().y())
+                {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+void LabelDeclutter::add(const Eigen::AlignedBox2f& rect)
+{
+    auto index = static_cast<std::uint32_t>(rects.size());
+    rects.push_back(rect);
+
+    Eigen::Vector2i first = cellIndex(rect.min());
+    Eigen::Vector2i last = cellIndex(rect.max());
+    for (int y = first.y(); y <= last.y(); y++)
+    {
+        for (int x = first.x(); x <= last.x(); x++)
+            cells[cellKey(x, y)].push_back(index);
+    }
+}
@@ -0,0 +1,42 @@
+// labeldeclutter.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Screen space overlap tests for labels.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+// LabelDeclutter keeps the screen rectangles of the labels placed so far in
+// a spatial hash of square cells, so that testing a new label only looks
+// at the labels close to it.
+class LabelDeclutter
+{
+ public:
+    explicit LabelDeclutter(float cellSize = 64.0f);
+
+    void clear();
+
+    // Return true if rect overlaps a rectangle added before
+    bool overlaps(const Eigen::AlignedBox2f& rect) const;
+    void add(const Eigen::AlignedBox2f& rect);
+
+ private:
+    std::uint64_t cellKey(int x, int y) const;
+    Eigen::Vector2i cellIndex(const Eigen::Vector2f& point) const;
+
+    float cellSize;
+    std::vector<Eigen::AlignedBox2f> rects;
+    // Indices into rects of the rectangles touching each cell
+    std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> cells;
+};
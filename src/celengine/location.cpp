@@ -99,9 +99,9 @@ FeatureNameEntry FeatureNames[] =
 };
 
 
-string Location::getName(bool i18n) const
+const string& Location::getName(bool i18n) const
 {
-    if (!i18n || i18nName == "") return name;
+    if (!i18n || i18nName.empty()) return name;
     return i18nName;
 }
 
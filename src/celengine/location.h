@@ -25,7 +25,8 @@ public:
 
     Selection toSelection() override;
 
-    std::string getName(bool i18n = false) const;
+    // The localized name is looked up once by setName()
+    const std::string& getName(bool i18n = false) const;
     void setName(const std::string&);
 
     Eigen::Vector3f getPosition() const;
@@ -0,0 +1,298 @@
+// locationindex.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Spatial index of the surface features of a body, for labeling.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <celcompat/numbers.h>
+#include "location.h"
+#include "locationindex.h"
+
+namespace
+{
+// A node keeps this many of the largest features of its area
+constexpr std::uint32_t BucketSize = 16;
+// Nodes at this depth keep all of their features
+constexpr int MaxLevel = 12;
+
+// Margins that keep the tests of a node conservative, so that rounding
+// can't skip a feature that the renderer would label: the label is drawn
+// slightly above the surface, and the pixel size is computed in single
+// precision.
+constexpr double SizeMargin = 1.0e-3;
+constexpr double RadiusMargin = 1.0e-3;
+constexpr double AngleMargin = 1.0e-4;
+
+float
+effectiveSize(const Location& location)
+{
+    float size = location.getImportance();
+    return size < 0.0f ? location.getSize() : size;
+}
+
+// The cube face of the direction of v, and the coordinates of its
+// projection onto the face, from -1 to 1
+int
+cubeFace(const Eigen::Vector3f& v, Eigen::Vector2f& coords)
+{
+    Eigen::Vector3f::Index axis;
+    float major = v.cwiseAbs().maxCoeff(&axis);
+    if (major == 0.0f)
+    {
+        coords = Eigen::Vector2f::Zero();
+        return 0;
+    }
+
+    auto u = static_cast<int>((axis + 1) % 3);
+    auto w = static_cast<int>((axis + 2) % 3);
+    coords = Eigen::Vector2f(v[u], v[w]) / major;
+    return static_cast<int>(axis) * 2 + (v[axis] < 0.0f ? 1 : 0);
+}
+
+// The angle between two vectors; the vectors don't need to be normalized
+double
+angleBetween(const Eigen::Vector3d& a, const Eigen::Vector3d& b)
+{
+    return std::atan2(a.cross(b).norm(), a.dot(b));
+}
+}
+
+LocationIndex::LocationIndex(const std::vector<Location*>& _locations)
+{
+    locations.reserve(_locations.size());
+    std::vector<Eigen::Vector2f> faceCoords(_locations.size());
+    std::vector<std::uint32_t> faceItems[6];
+    for (std::uint32_t i = 0; i < _locations.size(); i++)
+    {
+        const Location* location = _locations[i];
+        locations.push_back({ location, effectiveSize(*location), i });
+        faceItems[cubeFace(location->getPosition(), faceCoords[i])].push_back(i);
+    }
+
+    // Collect the items in the order of the nodes, so that the features of
+    // each node end up consecutive
+    std::vector<std::uint32_t> items;
+    items.reserve(locations.size());
+    Eigen::AlignedBox2f face(Eigen::Vector2f(-1.0f, -1.0f), Eigen::Vector2f(1.0f, 1.0f));
+    for (int i = 0; i < 6; i++)
+    {
+        if (faceItems[i].empty())
+        {
+            faceRoots[i] = NoChildren;
+            continue;
+        }
+
+        auto begin = static_cast<std::uint32_t>(items.size());
+        items.insert(items.end(), faceItems[i].begin(), faceItems[i].end());
+        faceRoots[i] = static_cast<std::uint32_t>(nodes.size());
+        nodes.emplace_back();
+        build(faceRoots[i], items, faceCoords, begin, static_cast<std::uint32_t>(items.size()), face, 0);
+    }
+
+    std::vector<Entry> sorted;
+    sorted.reserve(items.size());
+    for (std::uint32_t item : items)
+        sorted.push_back(locations[item]);
+    locations = std::move(sorted);
+}
+
+void
+LocationIndex::build(std::uint32_t node,
+                     std::vector<std::uint32_t>& items,
+                     const std::vector<Eigen::Vector2f>& faceCoords,
+                     std::uint32_t begin,
+                     std::uint32_t end,
+                     const Eigen::AlignedBox2f& area,
+                     int level)
+{
+    // Bounds of the whole subtree
+    Eigen::AlignedBox3f bounds;
+    Eigen::Vector3d axis = Eigen::Vector3d::Zero();
+    float maxRadius = 0.0f;
+    std::uint64_t featureTypes = 0;
+    bool atCenter = false;
+    for (std::uint32_t i = begin; i < end; i++)
+    {
+        const Location* location = locations[items[i]].location;
+        Eigen::Vector3f position = location->getPosition();
+        bounds.extend(position);
+        float radius = position.norm();
+        maxRadius = std::max(maxRadius, radius);
+        if (radius > 0.0f)
+            axis += position.cast<double>() / radius;
+        else
+            atCenter = true;
+        featureTypes |= location->getFeatureType();
+    }
+
+    float coneAngle = static_cast<float>(celestia::numbers::pi);
+    if (!atCenter && axis.norm() > 0.0)
+    {
+        double maxAngle = 0.0;
+        for (std::uint32_t i = begin; i < end; i++)
+            maxAngle = std::max(maxAngle, angleBetween(axis, locations[items[i]].location->getPosition().cast<double>()));
+        coneAngle = static_cast<float>(maxAngle);
+    }
+
+    // Largest first; features of the same size keep their order
+    std::sort(items.begin() + begin, items.begin() + end,
+              [this](std::uint32_t a, std::uint32_t b)
+              {
+                  return locations[a].size > locations[b].size ||
+                         (locations[a].size == locations[b].size && a < b);
+              });
+
+    std::uint32_t count = end - begin;
+    if (level < MaxLevel)
+        count = std::min(count, BucketSize);
+
+    Node& n = nodes[node];
+    n.bounds = bounds;
+    n.coneAxis = axis.norm() > 0.0 ? Eigen::Vector3f(axis.normalized().cast<float>()) : Eigen::Vector3f::UnitZ();
+    n.coneAngle = coneAngle;
+    n.maxRadius = maxRadius;
+    n.maxSize = end > begin ? locations[items[begin]].size : -std::numeric_limits<float>::infinity();
+    n.featureTypes = featureTypes;
+    n.firstLocation = begin;
+    n.locationCount = count;
+    n.firstChild = NoChildren;
+
+    std::uint32_t childBegin = begin + count;
+    if (childBegin == end)
+        return;
+
+    // Sort the rest into the quadrants of the area
+    Eigen::Vector2f center = area.center();
+    auto quadrant = [&](std::uint32_t item)
+    {
+        const Eigen::Vector2f& coords = faceCoords[item];
+        return (coords.x() < center.x() ? 0 : 1) + (coords.y() < center.y() ? 0 : 2);
+    };
+    std::sort(items.begin() + childBegin, items.begin() + end,
+              [&](std::uint32_t a, std::uint32_t b)
+              {
+                  return quadrant(a) < quadrant(b);
+              });
+
+    auto firstChild = static_cast<std::uint32_t>(nodes.size());
+    nodes[node].firstChild = firstChild;
+    nodes.resize(nodes.size() + 4);
+    for (int q = 0; q < 4; q++)
+    {
+        std::uint32_t childEnd = childBegin;
+        while (childEnd < end && quadrant(items[childEnd]) == q)
+            childEnd++;
+
+        Eigen::AlignedBox2f childArea(area.min(), center);
+        if (q & 1)
+        {
+            childArea.min().x() = center.x();
+            childArea.max().x() = area.max().x();
+        }
+        if (q & 2)
+        {
+            childArea.min().y() = center.y();
+            childArea.max().y() = area.max().y();
+        }
+
+        build(firstChild + q, items, faceCoords, childBegin, childEnd, childArea, level + 1);
+        childBegin = childEnd;
+    }
+}
+
+// Return true if none of the features of the node or its descendants can
+// pass the tests of the query; otherwise minDistance is set to the
+// distance of the closest one that the viewer could have.
+bool
+LocationIndex::isCulled(const Node& node, const Query& query, double& minDistance) const
+{
+    if ((node.featureTypes & query.featureTypes) == 0 || node.bounds.isEmpty())
+        return true;
+
+    Eigen::AlignedBox3d bounds = node.bounds.cast<double>();
+
+    // Behind the viewer
+    Eigen::Vector3d halfSize = bounds.sizes() * 0.5;
+    double front = (bounds.center() - query.viewerPosition).dot(query.viewDirection) +
+                   halfSize.dot(query.viewDirection.cwiseAbs());
+    if (front <= 0.0)
+        return true;
+
+    // Too small
+    minDistance = bounds.exteriorDistance(query.viewerPosition);
+    if (node.maxSize <= query.minSizePerDistance * minDistance * (1.0 - SizeMargin))
+        return true;
+
+    // Behind the horizon of the occluding sphere, as seen from the viewer.
+    // A point at radius r can be seen from the viewer at radius d across
+    // a sphere of radius R if the angle between them is less than
+    // acos(R / d) + acos(R / r).
+    double viewerRadius = query.viewerPosition.norm();
+    if (query.occluderRadius > 0.0 && viewerRadius > query.occluderRadius)
+    {
+        double radius = node.maxRadius * (1.0 + RadiusMargin);
+        double horizon = std::acos(query.occluderRadius / viewerRadius);
+        if (radius > query.occluderRadius)
+            horizon += std::acos(query.occluderRadius / radius);
+        double angle = angleBetween(query.viewerPosition, node.coneAxis.cast<double>()) - node.coneAngle;
+        if (angle > horizon + AngleMargin)
+            return true;
+    }
+
+    return false;
+}
+
+void
+LocationIndex::find(const Query& query, std::vector<const Location*>& result) const
+{
+    result.clear();
+
+    std::vector<const Entry*> found;
+    std::vector<std::uint32_t> stack;
+    for (std::uint32_t root : faceRoots)
+    {
+        if (root != NoChildren)
+            stack.push_back(root);
+    }
+
+    while (!stack.empty())
+    {
+        const Node& node = nodes[stack.back()];
+        stack.pop_back();
+
+        double minDistance = 0.0;
+        if (isCulled(node, query, minDistance))
+            continue;
+
+        double minSize = query.minSizePerDistance * minDistance * (1.0 - SizeMargin);
+        const Entry* entries = locations.data() + node.firstLocation;
+        for (std::uint32_t i = 0; i < node.locationCount; i++)
+        {
+            // The rest of the features of the node are smaller
+            if (entries[i].size <= minSize)
+                break;
+            if ((entries[i].location->getFeatureType() & query.featureTypes) != 0)
+                found.push_back(&entries[i]);
+        }
+
+        if (node.firstChild != NoChildren)
+        {
+            for (std::uint32_t i = 0; i < 4; i++)
+                stack.push_back(node.firstChild + i);
+        }
+    }
+
+    std::sort(found.begin(), found.end(),
+              [](const Entry* a, const Entry* b) { return a->order < b->order; });
+    result.reserve(found.size());
+    for (const Entry* entry : found)
+        result.push_back(entry->location);
+}
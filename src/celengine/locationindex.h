@@ -0,0 +1,109 @@
+// locationindex.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Spatial index of the surface features of a body, for labeling.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+class Location;
+
+// LocationIndex sorts the locations of a body into six quadtrees, one for
+// each face of a cube around the body, by the direction of their
+// planetocentric positions. Like the star octree, every node keeps the
+// largest features of its area, ordered by their effective size (the
+// importance when it is set, otherwise the size), and passes the smaller
+// ones down to its children. A search can then skip the nodes whose
+// features are all behind the body, behind the viewer or too small to be
+// labeled at their distance, and stop in a node at the first feature that
+// is too small.
+//
+// Positions are in the body-fixed frame, in kilometers. The index has to be
+// rebuilt when the locations change.
+class LocationIndex
+{
+ public:
+    explicit LocationIndex(const std::vector<Location*>& locations);
+
+    struct Query
+    {
+        // The viewer position in the body-fixed frame
+        Eigen::Vector3d viewerPosition;
+        // Unit view direction in the body-fixed frame; features behind the
+        // plane through the viewer perpendicular to it are skipped
+        Eigen::Vector3d viewDirection;
+        // Features are skipped unless their effective size is larger than
+        // minSizePerDistance times their distance from the viewer
+        double minSizePerDistance;
+        // Features are skipped unless their type is in this mask
+        std::uint64_t featureTypes;
+        // Radius of a sphere around the body center that is inside the
+        // body; features hidden by it are skipped. Zero to keep all
+        // features on the far side, which has to be done when the viewer
+        // is inside the body.
+        double occluderRadius;
+    };
+
+    // Find the locations that may pass the tests of the query, in the
+    // order of the vector the index was built from. Some of the locations
+    // found can still fail the tests, but none that pass is missed.
+    void find(const Query& query, std::vector<const Location*>& result) const;
+
+    std::size_t size() const { return locations.size(); }
+
+ private:
+    static constexpr std::uint32_t NoChildren = ~std::uint32_t(0);
+
+    struct Entry
+    {
+        const Location* location;
+        // Effective size
+        float size;
+        // Index in the vector the index was built from
+        std::uint32_t order;
+    };
+
+    // The bounds of a node cover its own features and the ones of all of
+    // its descendants
+    struct Node
+    {
+        Eigen::AlignedBox3f bounds;
+        // All directions are within coneAngle radians of coneAxis
+        Eigen::Vector3f coneAxis;
+        float coneAngle;
+        float maxRadius;
+        float maxSize;
+        std::uint64_t featureTypes;
+        // The features of the node, largest first, are
+        // [firstLocation, firstLocation + locationCount) in locations
+        std::uint32_t firstLocation;
+        std::uint32_t locationCount;
+        // The four children are consecutive, in the order of the quadrants
+        std::uint32_t firstChild;
+    };
+
+    void build(std::uint32_t node,
+               std::vector<std::uint32_t>& items,
+               const std::vector<Eigen::Vector2f>& faceCoords,
+               std::uint32_t begin,
+               std::uint32_t end,
+               const Eigen::AlignedBox2f& area,
+               int level);
+    bool isCulled(const Node& node, const Query& query, double& minDistance) const;
+
+    std::vector<Entry> locations;
+    std::vector<Node> nodes;
+    // The root nodes of the six faces, NoChildren for faces without
+    // features
+    std::uint32_t faceRoots[6];
+};
@@ -14,9 +14,11 @@
 #include <algorithm>
 #include <celcompat/numbers.h>
 #include <celmath/mathlib.h>
+#include "cubespheremesh.h"
 #include "glsupport.h"
 #include "lodspheremesh.h"
 #include "shadermanager.h"
+#include "glstate.h"
 
 using namespace std;
 using namespace Eigen;
@@ -26,6 +28,9 @@ constexpr const int maxDivisions = 16384;
 constexpr const int thetaDivisions = maxDivisions;
 constexpr const int phiDivisions = maxDivisions / 2;
 constexpr const int minStep = 128;
+constexpr const int minSphereLOD = -3;
+// position, tangent and texture coordinates
+constexpr const int StaticVertexSize = 3 + 3 + 2;
 static bool trigArraysInitialized = false;
 static float* sinPhi = nullptr;
 static float* cosPhi = nullptr;
@@ -102,6 +107,43 @@ static int getSphereLOD(float discSizeInPixels)
 }
 
 
+// Return true if the texture coordinates of the level of detail of tex
+// don't need to be adjusted to a tile.
+static bool isUntiled(Texture* tex, int lod)
+{
+    if (tex->getUTileCount(lod) != 1 || tex->getVTileCount(lod) != 1)
+        return false;
+
+    TextureTile tile = tex->getTile(lod, 0, 0);
+    return tile.u == 0.0f && tile.v == 0.0f && tile.du == 1.0f && tile.dv == 1.0f;
+}
+
+
+static void buildStripIndices(unsigned short* indices, int nRings, int nSlices)
+{
+    int n2 = 0;
+    for (int i = 0; i < nRings; i++)
+    {
+        if (i > 0)
+        {
+            indices[n2 + 0] = i * (nSlices + 1) + 0;
+            n2++;
+        }
+        for (int j = 0; j <= nSlices; j++)
+        {
+            indices[n2 + 0] = i * (nSlices + 1) + j;
+            indices[n2 + 1] = (i + 1) * (nSlices + 1) + j;
+            n2 += 2;
+        }
+        if (i < nRings - 1)
+        {
+            indices[n2] = (i + 1) * (nSlices + 1) + nSlices;
+            n2++;
+        }
+    }
+}
+
+
 LODSphereMesh::LODSphereMesh()
 {
     if (!trigArraysInitialized)
@@ -125,6 +167,15 @@ LODSphereMesh::~LODSphereMesh()
 }
 
 
+void LODSphereMesh::setCubeSphere(bool enable)
+{
+    if (!enable)
+        cubeSphere = nullptr;
+    else if (cubeSphere == nullptr)
+        cubeSphere = std::make_unique<CubeSphereMesh>();
+}
+
+
 static Vector3f spherePoint(int theta, int phi)
 {
     return Vector3f(cosPhi[phi] * cosTheta[theta],
@@ -224,6 +275,29 @@ void LODSphereMesh::render(unsigned int attributes,
             ri.step /= ri.step / phiExtent;
     }
 
+    // Unless a texture is split into tiles, the vertices don't depend on
+    // the textures and can be drawn from the static buffers of this level
+    // of detail.
+    currentStaticLOD = nullptr;
+    bool useCubeSphere = false;
+    if (celestia::gl::ARB_draw_elements_base_vertex)
+    {
+        bool untiled = true;
+        for (i = 0; i < nTextures && untiled; i++)
+            untiled = isUntiled(tex[i], ri.texLOD[i]);
+        if (untiled && cubeSphere != nullptr)
+        {
+            useCubeSphere = true;
+        }
+        else if (untiled)
+        {
+            StaticLOD& staticLOD = staticLODs[lodBias - minSphereLOD];
+            if (staticLOD.vertexBuffer == 0)
+                initStaticLOD(staticLOD, ri.step, split);
+            currentStaticLOD = &staticLOD;
+        }
+    }
+
     // Set the current textures
     nTexturesUsed = nTextures;
     for (i = 0; i < nTextures; i++)
@@ -232,10 +306,24 @@ void LODSphereMesh::render(unsigned int attributes,
         textures[i] = tex[i];
         subtextures[i] = 0;
         if (nTextures > 1)
-            glActiveTexture(GL_TEXTURE0 + i);
+            celestia::gl::activeTexture(GL_TEXTURE0 + i);
+        if (currentStaticLOD != nullptr || useCubeSphere)
+        {
+            subtextures[i] = tex[i]->getTile(ri.texLOD[i], 0, 0).texID;
+            celestia::gl::bindTexture(GL_TEXTURE_2D, subtextures[i]);
+        }
     }
 
-    if (!vertexBuffersInitialized)
+    if (useCubeSphere)
+    {
+        // The chunks are drawn from their own buffers
+    }
+    else if (currentStaticLOD != nullptr)
+    {
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, currentStaticLOD->vertexBuffer);
+        celestia::gl::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, currentStaticLOD->indexBuffer);
+    }
+    else if (!vertexBuffersInitialized)
     {
         // TODO: assumes that the same context is used every time we
         // render.  Valid now, but not necessarily in the future.  Still,
@@ -248,57 +336,45 @@ void LODSphereMesh::render(unsigned int attributes,
         vertexBuffersInitialized = true;
         for (auto vertexBuffer : vertexBuffers)
         {
-            glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-            glBufferData(GL_ARRAY_BUFFER,
-                         maxVertices * MaxVertexSize * sizeof(float),
-                         nullptr,
-                         GL_STREAM_DRAW);
+            celestia::gl::bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+            celestia::gl::bufferData(GL_ARRAY_BUFFER,
+                                     maxVertices * MaxVertexSize * sizeof(float),
+                                     nullptr,
+                                     GL_STREAM_DRAW);
         }
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
 
         glGenBuffers(1, &indexBuffer);
     }
 
-    currentVB = 0;
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffers[currentVB]);
-
-    // Set up the mesh vertices
-    int nRings = phiExtent / ri.step;
-    int nSlices = thetaExtent / ri.step;
-
-    int n2 = 0;
-    for (i = 0; i < nRings; i++)
+    if (currentStaticLOD == nullptr && !useCubeSphere)
     {
-        if (i > 0)
-        {
-            indices[n2 + 0] = i * (nSlices + 1) + 0;
-            n2++;
-        }
-        for (int j = 0; j <= nSlices; j++)
-        {
-            indices[n2 + 0] = i * (nSlices + 1) + j;
-            indices[n2 + 1] = (i + 1) * (nSlices + 1) + j;
-            n2 += 2;
-        }
-        if (i < nRings - 1)
-        {
-            indices[n2] = (i + 1) * (nSlices + 1) + nSlices;
-            n2++;
-        }
+        currentVB = 0;
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, vertexBuffers[currentVB]);
+
+        // Set up the mesh vertices
+        int nRings = phiExtent / ri.step;
+        int nSlices = thetaExtent / ri.step;
+
+        buildStripIndices(indices, nRings, nSlices);
+
+        celestia::gl::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        celestia::gl::bufferData(GL_ELEMENT_ARRAY_BUFFER,
+                                 nIndices * sizeof(indices[0]),
+                                 indices,
+                                 GL_DYNAMIC_DRAW);
+
+        // Compute the size of a vertex
+        vertexSize = 3;
+        if ((attributes & Tangents) != 0)
+            vertexSize += 3;
+        for (i = 0; i < nTextures; i++)
+            vertexSize += 2;
+    }
+    else
+    {
+        vertexSize = StaticVertexSize;
     }
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                 nIndices * sizeof(indices[0]),
-                 indices,
-                 GL_DYNAMIC_DRAW);
-
-    // Compute the size of a vertex
-    vertexSize = 3;
-    if ((attributes & Tangents) != 0)
-        vertexSize += 3;
-    for (i = 0; i < nTextures; i++)
-        vertexSize += 2;
 
     glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
     if ((attributes & Normals) != 0)
@@ -312,7 +388,11 @@ void LODSphereMesh::render(unsigned int attributes,
     if ((attributes & Tangents) != 0)
         glEnableVertexAttribArray(CelestiaGLProgram::TangentAttributeIndex);
 
-    if (split == 1)
+    if (useCubeSphere)
+    {
+        cubeSphere->render(frustum, pixWidth, nTextures);
+    }
+    else if (split == 1)
     {
         renderSection(0, 0, thetaExtent, ri);
     }
@@ -358,6 +438,9 @@ void LODSphereMesh::render(unsigned int attributes,
         }
     }
 
+    if (currentStaticLOD != nullptr)
+        drawStaticPatches();
+
     glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
     if ((attributes & Normals) != 0)
         glDisableVertexAttribArray(CelestiaGLProgram::NormalAttributeIndex);
@@ -373,11 +456,11 @@ void LODSphereMesh::render(unsigned int attributes,
 
     if (nTextures > 1)
     {
-        glActiveTexture(GL_TEXTURE0);
+        celestia::gl::activeTexture(GL_TEXTURE0);
     }
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+    celestia::gl::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
 
@@ -462,6 +545,12 @@ void LODSphereMesh::renderSection(int phi0, int theta0, int extent,
                                   const RenderInfo& ri)
 
 {
+    if (currentStaticLOD != nullptr)
+    {
+        addStaticPatch(phi0, theta0, extent);
+        return;
+    }
+
     auto stride = (GLsizei) (vertexSize * sizeof(float));
     int texCoordOffset = ((ri.attributes & Tangents) != 0) ? 6 : 3;
     float* vertexBase = nullptr;
@@ -539,7 +628,7 @@ void LODSphereMesh::renderSection(int phi0, int theta0, int extent,
             v /= patchesPerVSubtex;
 
             if (nTexturesUsed > 1)
-                glActiveTexture(GL_TEXTURE0 + tex);
+                celestia::gl::activeTexture(GL_TEXTURE0 + tex);
             TextureTile tile = textures[tex]->getTile(ri.texLOD[tex],
                                                       uTexSplit - u - 1,
                                                       vTexSplit - v - 1);
@@ -552,7 +641,7 @@ void LODSphereMesh::renderSection(int phi0, int theta0, int extent,
             // texture state changes.
             if (tile.texID != subtextures[tex])
             {
-                glBindTexture(GL_TEXTURE_2D, tile.texID);
+                celestia::gl::bindTexture(GL_TEXTURE_2D, tile.texID);
                 subtextures[tex] = tile.texID;
             }
         }
@@ -613,18 +702,144 @@ void LODSphereMesh::renderSection(int phi0, int theta0, int extent,
         }
     }
 
-    glBufferSubData(GL_ARRAY_BUFFER, 0, vindex * sizeof(float), vertices);
+    celestia::gl::bufferSubData(GL_ARRAY_BUFFER, 0, vindex * sizeof(float), vertices);
 
     int nRings = phiExtent / ri.step;
     int nSlices = thetaExtent / ri.step;
-    glDrawElements(GL_TRIANGLE_STRIP,
-                   nRings * (nSlices + 2) * 2 - 2,
-                   GL_UNSIGNED_SHORT,
-                   nullptr);
+    celestia::gl::drawElements(GL_TRIANGLE_STRIP,
+                               nRings * (nSlices + 2) * 2 - 2,
+                               GL_UNSIGNED_SHORT,
+                               nullptr);
 
     // Cycle through the vertex buffers
     currentVB++;
     if (currentVB == NUM_SPHERE_VERTEX_BUFFERS)
         currentVB = 0;
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffers[currentVB]);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, vertexBuffers[currentVB]);
+}
+
+
+void LODSphereMesh::initStaticLOD(StaticLOD& lod, int step, int split)
+{
+    int thetaExtent = maxDivisions / split;
+    int phiExtent = thetaExtent / 2;
+    int nRings = phiExtent / step;
+    int nSlices = thetaExtent / step;
+
+    lod.split = split;
+    lod.patchVertexCount = (nRings + 1) * (nSlices + 1);
+    lod.indexCount = nRings * (nSlices + 2) * 2 - 2;
+
+    // Every patch has its own copy of its edge vertices, so that all of
+    // them can be drawn with the same triangle strip.
+    std::vector<float> patchVertices;
+    patchVertices.reserve(static_cast<std::size_t>(split * split * lod.patchVertexCount * StaticVertexSize));
+    float du = 1.0f / thetaDivisions;
+    float dv = 1.0f / phiDivisions;
+    for (int i = 0; i < split; i++)
+    {
+        for (int j = 0; j < split; j++)
+        {
+            int phi0 = i * phiExtent;
+            int theta0 = j * thetaExtent;
+            for (int phi = phi0; phi <= phi0 + phiExtent; phi += step)
+            {
+                float cphi = cosPhi[phi];
+                float sphi = sinPhi[phi];
+                for (int theta = theta0; theta <= theta0 + thetaExtent; theta += step)
+                {
+                    float ctheta = cosTheta[theta];
+                    float stheta = sinTheta[theta];
+                    float vertex[StaticVertexSize] =
+                    {
+                        cphi * ctheta, sphi, cphi * stheta,
+                        stheta, 0.0f, -ctheta,
+                        1.0f - theta * du, 1.0f - phi * dv,
+                    };
+                    patchVertices.insert(patchVertices.end(), vertex, vertex + StaticVertexSize);
+                }
+            }
+        }
+    }
+
+    glGenBuffers(1, &lod.vertexBuffer);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, lod.vertexBuffer);
+    celestia::gl::bufferData(GL_ARRAY_BUFFER,
+                             patchVertices.size() * sizeof(float),
+                             patchVertices.data(),
+                             GL_STATIC_DRAW);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+
+    std::vector<unsigned short> patchIndices(lod.indexCount);
+    buildStripIndices(patchIndices.data(), nRings, nSlices);
+
+    glGenBuffers(1, &lod.indexBuffer);
+    celestia::gl::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, lod.indexBuffer);
+    celestia::gl::bufferData(GL_ELEMENT_ARRAY_BUFFER,
+                             patchIndices.size() * sizeof(unsigned short),
+                             patchIndices.data(),
+                             GL_STATIC_DRAW);
+    celestia::gl::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+
+void LODSphereMesh::addStaticPatch(int phi0, int theta0, int extent)
+{
+    int thetaExtent = extent;
+    int phiExtent = extent / 2;
+    int patch = (phi0 / phiExtent) * currentStaticLOD->split + theta0 / thetaExtent;
+
+    patchBaseVertices.push_back(patch * currentStaticLOD->patchVertexCount);
+    patchIndexCounts.push_back(currentStaticLOD->indexCount);
+    patchIndexOffsets.push_back(nullptr);
+}
+
+
+void LODSphereMesh::drawStaticPatches()
+{
+    if (!patchBaseVertices.empty())
+    {
+        auto stride = (GLsizei) (StaticVertexSize * sizeof(float));
+        float* vertexBase = nullptr;
+
+        glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
+                              3, GL_FLOAT, GL_FALSE,
+                              stride, vertexBase);
+        glVertexAttribPointer(CelestiaGLProgram::NormalAttributeIndex,
+                              3, GL_FLOAT, GL_FALSE,
+                              stride, vertexBase);
+        glVertexAttribPointer(CelestiaGLProgram::TangentAttributeIndex,
+                              3, GL_FLOAT, GL_FALSE,
+                              stride, vertexBase + 3);
+        // All textures share the same coordinates
+        for (int tc = 0; tc < nTexturesUsed; tc++)
+        {
+            glVertexAttribPointer(CelestiaGLProgram::TextureCoord0AttributeIndex + tc,
+                                  2, GL_FLOAT, GL_FALSE,
+                                  stride, vertexBase + 6);
+        }
+
+#ifdef GL_ES
+        for (std::size_t i = 0; i < patchBaseVertices.size(); i++)
+        {
+            celestia::gl::drawElementsBaseVertex(GL_TRIANGLE_STRIP,
+                                                 patchIndexCounts[i],
+                                                 GL_UNSIGNED_SHORT,
+                                                 patchIndexOffsets[i],
+                                                 patchBaseVertices[i]);
+        }
+#else
+        glMultiDrawElementsBaseVertex(GL_TRIANGLE_STRIP,
+                                      patchIndexCounts.data(),
+                                      GL_UNSIGNED_SHORT,
+                                      patchIndexOffsets.data(),
+                                      (GLsizei) patchBaseVertices.size(),
+                                      patchBaseVertices.data());
+#endif
+    }
+
+    patchBaseVertices.clear();
+    patchIndexCounts.clear();
+    patchIndexOffsets.clear();
+    currentStaticLOD = nullptr;
 }
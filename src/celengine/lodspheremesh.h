@@ -11,6 +11,8 @@
 #ifndef CELENGINE_LODSPHEREMESH_H_
 #define CELENGINE_LODSPHEREMESH_H_
 
+#include <memory>
+#include <vector>
 #include <celengine/texture.h>
 #include <Eigen/Geometry>
 #include <celmath/frustum.h>
@@ -18,6 +20,9 @@
 
 #define MAX_SPHERE_MESH_TEXTURES 6
 #define NUM_SPHERE_VERTEX_BUFFERS 2
+#define NUM_SPHERE_LODS 8
+
+class CubeSphereMesh;
 
 class LODSphereMesh
 {
@@ -33,6 +38,11 @@ public:
     void render(const celmath::Frustum&, float pixWidth,
                 Texture** tex, int nTextures);
 
+    // Draw the sphere from the chunks of a CubeSphereMesh instead of the
+    // patches of latitude and longitude, when no texture is split into
+    // tiles
+    void setCubeSphere(bool enable);
+
     enum
     {
         Normals    = 0x01,
@@ -64,6 +74,23 @@ public:
 
     void renderSection(int phi0, int theta0, int extent, const RenderInfo&);
 
+    // The vertices of every patch of one level of detail, computed once
+    // and kept in GPU memory. They can be used when no texture is split
+    // into tiles, so that the texture coordinates of a vertex don't
+    // depend on the patch it's drawn in.
+    struct StaticLOD
+    {
+        GLuint vertexBuffer{ 0 };
+        GLuint indexBuffer{ 0 };
+        GLsizei indexCount{ 0 };
+        GLint patchVertexCount{ 0 };
+        int split{ 0 };
+    };
+
+    void initStaticLOD(StaticLOD&, int step, int split);
+    void addStaticPatch(int phi0, int theta0, int extent);
+    void drawStaticPatches();
+
     float* vertices{ nullptr };
 
     int maxVertices{ 0 };
@@ -80,6 +107,16 @@ public:
     GLuint currentVB{ 0 };
     GLuint vertexBuffers[NUM_SPHERE_VERTEX_BUFFERS];
     GLuint indexBuffer{ 0 };
+
+    StaticLOD staticLODs[NUM_SPHERE_LODS];
+    // Set while rendering from staticLODs
+    const StaticLOD* currentStaticLOD{ nullptr };
+    // Visible patches of currentStaticLOD, drawn with one call
+    std::vector<GLint> patchBaseVertices;
+    std::vector<GLsizei> patchIndexCounts;
+    std::vector<const void*> patchIndexOffsets;
+
+    std::unique_ptr<CubeSphereMesh> cubeSphere;
 };
 
 #endif // CELENGINE_LODSPHEREMESH_H_
@@ -12,8 +12,8 @@
 #include <cmath>
 #include <cstring>
 #include <fstream>
+#include <celutil/dircache.h>
 #include <celutil/logger.h>
-#include <celutil/fsutils.h>
 #include "mapmanager.h"
 
 using namespace std;
@@ -129,7 +129,7 @@ fs::path WarpMeshInfo::resolve(const fs::path& baseDir)
 
     if (wildcard)
     {
-        fs::path matched = util::ResolveWildcard(filename, extensions);
+        fs::path matched = util::GetDirectoryCache().resolveWildcard(filename, extensions);
         if (!matched.empty())
             return matched;
     }
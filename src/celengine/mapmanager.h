@@ -43,11 +43,12 @@ class WarpMeshInfo : public ResourceInfo<WarpMesh>
 
     fs::path resolve(const fs::path&) override;
     WarpMesh* load(const fs::path&) override;
+    std::size_t hash() const { return fs::hash_value(source); }
 };
 
-inline bool operator<(const WarpMeshInfo& wi0, const WarpMeshInfo& wi1)
+inline bool operator==(const WarpMeshInfo& wi0, const WarpMeshInfo& wi1)
 {
-    return wi0.source < wi1.source;
+    return wi0.source == wi1.source;
 }
 
 typedef ResourceManager<WarpMeshInfo> WarpMeshManager;
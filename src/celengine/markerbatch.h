@@ -0,0 +1,96 @@
+// markerbatch.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Annotation markers drawn with instanced draw calls.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+#include <Eigen/Core>
+#include <celutil/color.h>
+#include "glsupport.h"
+#include "marker.h"
+
+// MarkerBatch draws the markers of the annotations of a frame with one
+// instanced draw call per shape of symbol, instead of one draw call per
+// marker. A static vertex buffer holds the outlines of the symbols, and
+// each marker is an instance with its position in pixels, its scale and
+// its color.
+class MarkerBatch
+{
+ public:
+    MarkerBatch() = default;
+    ~MarkerBatch();
+    MarkerBatch(const MarkerBatch&) = delete;
+    MarkerBatch& operator=(const MarkerBatch&) = delete;
+
+    // Return true if the OpenGL implementation supports instanced drawing
+    static bool isSupported();
+    // Symbols drawn with lines can be batched only when the lines aren't
+    // drawn as triangles; crosshairs are never batched.
+    static bool canBatch(celestia::MarkerRepresentation::Symbol symbol, bool lineAsTriangles);
+
+    // Add a marker of the given size in pixels at position, which is in
+    // pixels with the depth as z; scaleFactor is the scale of the display
+    void add(celestia::MarkerRepresentation::Symbol symbol,
+             float size,
+             float scaleFactor,
+             const Color& color,
+             const Eigen::Vector3f& position);
+    bool empty() const { return count == 0; }
+
+    // Draw the markers added since the last call with the currently bound
+    // program, and remove them
+    void draw();
+
+ private:
+    enum Shape
+    {
+        FilledSquareShape,
+        RightArrowShape,
+        LeftArrowShape,
+        UpArrowShape,
+        DownArrowShape,
+        SmallDiskShape,
+        LargeDiskShape,
+        DiamondShape,
+        PlusShape,
+        XShape,
+        SquareShape,
+        TriangleShape,
+        SmallCircleShape,
+        LargeCircleShape,
+        ShapeCount,
+    };
+
+    struct ShapeVertices
+    {
+        GLenum mode;
+        GLint first;
+        GLsizei count;
+    };
+
+    struct MarkerInstance
+    {
+        float position[3];
+        float scale;
+        unsigned char color[4];
+    };
+
+    static int shapeOf(celestia::MarkerRepresentation::Symbol symbol, float size);
+    void createVertexBuffer();
+
+    GLuint vertexBuffer{ 0 };
+    GLuint instanceBuffer{ 0 };
+    std::array<ShapeVertices, ShapeCount> shapes;
+    std::array<std::vector<MarkerInstance>, ShapeCount> instances;
+    std::size_t count{ 0 };
+};
@@ -12,8 +12,12 @@
 #include <cstdint>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -26,6 +30,7 @@
 #include <celmodel/mesh.h>
 #include <celmodel/model.h>
 #include <celmodel/modelfile.h>
+#include <celutil/dircache.h>
 #include <celutil/filetype.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
@@ -369,44 +374,111 @@ Convert3DSModel(const M3DScene& scene, const fs::path& texPath)
 
 constexpr const char UniqueSuffixChar = '!';
 
-} // end unnamed namespace
+// Bump when the conversion of 3DS files changes, so that models converted
+// by an older version aren't used.
+constexpr std::uint32_t ModelCacheRevision = 1;
+constexpr const char* ModelCacheExtension = ".cmod";
 
+fs::path modelCacheDir;
 
-GeometryManager*
-GetGeometryManager()
+
+// Name of the cached conversion of a 3DS file, which changes whenever the
+// file is modified. Returns an empty path if the file can't be examined.
+fs::path
+GetModelCachePath(const fs::path& filename)
 {
-    static GeometryManager geometryManager("models");
-    return &geometryManager;
+    std::error_code ec;
+    fs::path source = fs::absolute(filename, ec);
+    if (ec)
+        return fs::path();
+    auto modified = fs::last_write_time(filename, ec);
+    if (ec)
+        return fs::path();
+    auto fileSize = fs::file_size(filename, ec);
+    if (ec)
+        return fs::path();
+
+    return modelCacheDir / fmt::format("{:016x}-{:x}-{:x}-{}{}",
+                                       std::hash<std::string>()(source.string()),
+                                       modified.time_since_epoch().count(),
+                                       fileSize,
+                                       ModelCacheRevision,
+                                       ModelCacheExtension);
 }
 
 
-fs::path
-GeometryInfo::resolve(const fs::path& baseDir)
+void
+SaveCachedModel(const cmod::Model& model, const fs::path& cachePath)
 {
-    // Ensure that models with different centers get resolved to different objects by
-    // adding a 'uniquifying' suffix to the filename that encodes the center value.
-    // This suffix is stripped before the file is actually loaded.
-    auto uniquifyingSuffix = fmt::format("{}{},{},{},{},{}", UniqueSuffixChar,
-                                         center.x(), center.y(), center.z(),
-                                         scale, static_cast<int>(isNormalized));
+    // Models may be converted on several loader threads at once, so each
+    // writes a file of its own and renames it into place when complete.
+    fs::path tempPath = cachePath;
+    tempPath += fmt::format(".{:x}", std::hash<std::thread::id>()(std::this_thread::get_id()));
 
-    if (!path.empty())
+    bool saved;
     {
-        fs::path filename = path / "models" / source;
-        std::ifstream in(filename);
-        if (in.good())
+        std::ofstream out(tempPath, std::ios::out | std::ios::binary);
+        saved = out.good() &&
+                cmod::SaveModelBinary(&model, out,
+                                      [](ResourceHandle h)
+                                      {
+                                          const TextureInfo* info = GetTextureManager()->getResourceInfo(h);
+                                          return info == nullptr ? fs::path() : info->source;
+                                      });
+    }
+
+    std::error_code ec;
+    if (saved)
+        fs::rename(tempPath, cachePath, ec);
+    if (!saved || ec)
+    {
+        GetLogger()->warn("Failed to write model cache file {}\n", cachePath);
+        fs::remove(tempPath, ec);
+    }
+}
+
+
+// Read a 3DS file, converting it only the first time when a model cache
+// directory is set.
+std::unique_ptr<cmod::Model>
+Load3DSModel(const fs::path& filename, const fs::path& texPath)
+{
+    fs::path cachePath;
+    if (!modelCacheDir.empty())
+        cachePath = GetModelCachePath(filename);
+
+    if (!cachePath.empty())
+    {
+        std::error_code ec;
+        if (fs::exists(cachePath, ec))
         {
-            resolvedToPath = true;
-            return filename += uniquifyingSuffix;
+            auto model = cmod::LoadModel(
+                cachePath,
+                [&](const fs::path& name)
+                {
+                    return GetTextureManager()->getHandle(TextureInfo(name, texPath, TextureInfo::WrapTexture));
+                });
+            if (model != nullptr)
+                return model;
+            GetLogger()->warn("Ignoring invalid model cache file {}\n", cachePath);
         }
     }
 
-    return (baseDir / source) += uniquifyingSuffix;
+    std::unique_ptr<M3DScene> scene = Read3DSFile(filename);
+    if (scene == nullptr)
+        return nullptr;
+
+    auto model = Convert3DSModel(*scene, texPath);
+    if (!cachePath.empty())
+        SaveCachedModel(*model, cachePath);
+    return model;
 }
 
 
-Geometry*
-GeometryInfo::load(const fs::path& resolvedFilename)
+// Load the model and condition it for optimal rendering; the texture
+// handles it refers to are created, but no textures are loaded.
+std::unique_ptr<cmod::Model>
+LoadGeometryModel(const GeometryInfo& info, const fs::path& resolvedFilename)
 {
     // Strip off the uniquifying suffix
     auto uniquifyingSuffixStart = resolvedFilename.string().rfind(UniqueSuffixChar);
@@ -418,38 +490,29 @@ GeometryInfo::load(const fs::path& resolvedFilename)
 
     if (fileType == Content_3DStudio)
     {
-        std::unique_ptr<M3DScene> scene = Read3DSFile(filename);
-        if (scene != nullptr)
+        model = Load3DSModel(filename, info.resolvedToPath ? info.path : fs::path());
+        if (model != nullptr)
         {
-            if (resolvedToPath)
-                model = Convert3DSModel(*scene, path);
-            else
-                model = Convert3DSModel(*scene, "");
-
-            if (isNormalized)
-                model->normalize(center);
+            if (info.isNormalized)
+                model->normalize(info.center);
             else
-                model->transform(center, scale);
+                model->transform(info.center, info.scale);
         }
     }
     else if (fileType == Content_CelestiaModel)
     {
-        std::ifstream in(filename, std::ios::binary);
-        if (in.good())
-        {
-            model = cmod::LoadModel(
-                in,
-                [&](const fs::path& name)
-                {
-                    return GetTextureManager()->getHandle(TextureInfo(name, path, TextureInfo::WrapTexture));
-                });
-            if (model != nullptr)
+        model = cmod::LoadModel(
+            filename,
+            [&](const fs::path& name)
             {
-                if (isNormalized)
-                    model->normalize(center);
-                else
-                    model->transform(center, scale);
-            }
+                return GetTextureManager()->getHandle(TextureInfo(name, info.path, TextureInfo::WrapTexture));
+            });
+        if (model != nullptr)
+        {
+            if (info.isNormalized)
+                model->normalize(info.center);
+            else
+                model->transform(info.center, info.scale);
         }
     }
     else if (fileType == Content_CelestiaMesh)
@@ -457,10 +520,10 @@ GeometryInfo::load(const fs::path& resolvedFilename)
         model = LoadCelestiaMesh(filename);
         if (model != nullptr)
         {
-            if (isNormalized)
-                model->normalize(center);
+            if (info.isNormalized)
+                model->normalize(info.center);
             else
-                model->transform(center, scale);
+                model->transform(info.center, info.scale);
         }
     }
 
@@ -482,6 +545,10 @@ GeometryInfo::load(const fs::path& resolvedFilename)
 
         model->determineOpacity();
 
+        // Simplified versions of the model are drawn when it's small on
+        // screen.
+        model->generateLODs();
+
         // Display some statics for the model
         GetLogger()->verbose(
                         _("   Model statistics: {} vertices, {} primitives, {} materials ({} unique)\n"),
@@ -490,11 +557,121 @@ GeometryInfo::load(const fs::path& resolvedFilename)
                         originalMaterialCount,
                         model->getMaterialCount());
 
-        return new ModelGeometry(std::move(model));
     }
     else
     {
         GetLogger()->error(_("Error loading model '{}'\n"), filename);
-        return nullptr;
     }
+
+    return model;
+}
+
+
+// Parses and conditions the model on a loader thread; the render thread
+// only uploads it
+class ModelLoader : public ResourceInfo<Geometry>::AsyncLoader
+{
+ public:
+    ModelLoader(const GeometryInfo& info, const fs::path& name) :
+        info(info),
+        name(name)
+    {
+    }
+
+    bool decode() override
+    {
+        std::unique_ptr<cmod::Model> model = LoadGeometryModel(info, name);
+        if (model == nullptr)
+            return false;
+
+        geometry = std::make_unique<ModelGeometry>(std::move(model));
+        bufferSize = geometry->getBufferSize();
+        return true;
+    }
+
+    Geometry* create() override
+    {
+        geometry->createBuffers();
+        return geometry.release();
+    }
+
+    std::size_t size() const override
+    {
+        return bufferSize;
+    }
+
+ private:
+    GeometryInfo info;
+    fs::path name;
+    std::unique_ptr<ModelGeometry> geometry;
+    std::size_t bufferSize{ 0 };
+};
+
+} // end unnamed namespace
+
+
+GeometryManager*
+GetGeometryManager()
+{
+    static GeometryManager geometryManager("models");
+    return &geometryManager;
+}
+
+
+void
+SetModelCache(const fs::path& dir)
+{
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec)
+    {
+        GetLogger()->error("Failed to create model cache directory {}\n", dir);
+        return;
+    }
+
+    modelCacheDir = dir;
+}
+
+
+fs::path
+GeometryInfo::resolve(const fs::path& baseDir)
+{
+    // Ensure that models with different centers get resolved to different objects by
+    // adding a 'uniquifying' suffix to the filename that encodes the center value.
+    // This suffix is stripped before the file is actually loaded.
+    auto uniquifyingSuffix = fmt::format("{}{},{},{},{},{}", UniqueSuffixChar,
+                                         center.x(), center.y(), center.z(),
+                                         scale, static_cast<int>(isNormalized));
+
+    if (!path.empty())
+    {
+        fs::path filename = path / "models" / source;
+        if (celestia::util::GetDirectoryCache().exists(filename))
+        {
+            resolvedToPath = true;
+            return filename += uniquifyingSuffix;
+        }
+    }
+
+    return (baseDir / source) += uniquifyingSuffix;
+}
+
+
+Geometry*
+GeometryInfo::load(const fs::path& resolvedFilename)
+{
+    std::unique_ptr<cmod::Model> model = LoadGeometryModel(*this, resolvedFilename);
+    if (model == nullptr)
+        return nullptr;
+
+    return new ModelGeometry(std::move(model));
+}
+
+
+std::unique_ptr<ResourceInfo<Geometry>::AsyncLoader>
+GeometryInfo::asyncLoader(const fs::path& resolvedFilename)
+{
+    // The loader keeps its own copy of the parameters, since the resource
+    // table may be reallocated while the model is decoded.
+    return std::make_unique<ModelLoader>(*this, resolvedFilename);
 }
@@ -51,26 +51,37 @@ class GeometryInfo : public ResourceInfo<Geometry>
 
     virtual fs::path resolve(const fs::path&);
     virtual Geometry* load(const fs::path&);
+    std::unique_ptr<AsyncLoader> asyncLoader(const fs::path&) override;
+    std::size_t hash() const
+    {
+        std::hash<float> floatHash;
+        std::size_t h = fs::hash_value(source);
+        h = ResourceHashCombine(h, fs::hash_value(path));
+        h = ResourceHashCombine(h, isNormalized ? 1 : 0);
+        h = ResourceHashCombine(h, floatHash(scale));
+        h = ResourceHashCombine(h, floatHash(center.x()));
+        h = ResourceHashCombine(h, floatHash(center.y()));
+        return ResourceHashCombine(h, floatHash(center.z()));
+    }
+    std::size_t getMemoryUsage() const override
+    {
+        return resource != nullptr ? resource->getMemoryUsage() : 0;
+    }
 };
 
-inline bool operator<(const GeometryInfo& g0, const GeometryInfo& g1)
+inline bool operator==(const GeometryInfo& g0, const GeometryInfo& g1)
 {
-    if (g0.source != g1.source)
-        return g0.source < g1.source;
-    else if (g0.path != g1.path)
-        return g0.path < g1.path;
-    else if (g0.isNormalized != g1.isNormalized)
-        return (int) g0.isNormalized < (int) g1.isNormalized;
-    else if (g0.scale != g1.scale)
-        return g0.scale < g1.scale;
-    else if (g0.center.x() != g1.center.x())
-        return g0.center.x() < g1.center.x();
-    else if (g0.center.y() != g1.center.y())
-        return g0.center.y() < g1.center.y();
-    else
-        return g0.center.z() < g1.center.z();
+    return g0.source == g1.source &&
+           g0.path == g1.path &&
+           g0.isNormalized == g1.isNormalized &&
+           g0.scale == g1.scale &&
+           g0.center == g1.center;
 }
 
 typedef ResourceManager<GeometryInfo> GeometryManager;
 
 extern GeometryManager* GetGeometryManager();
+
+// Store the conversions of 3DS models as binary CMOD files in dir, so that
+// each 3DS file is only converted when it first loads or is modified
+void SetModelCache(const fs::path& dir);
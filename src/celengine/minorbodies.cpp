@@ -0,0 +1,813 @@
+// minorbodies.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Compact table of the minor planets orbiting a star.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <istream>
+#include <limits>
+#include <celcompat/charconv.h>
+#include <celcompat/numbers.h>
+#include <celephem/orbit.h>
+#include <celephem/rotation.h>
+#include <celmath/geomutil.h>
+#include <celmath/mathlib.h>
+#include <celutil/jobsystem.h>
+#include <celutil/logger.h>
+#include <celutil/stringutils.h>
+#include "astro.h"
+#include "body.h"
+#include "frametree.h"
+#include "minorbodies.h"
+#include "parseobject.h"
+#include "solarsys.h"
+#include "timeline.h"
+#include "timelinephase.h"
+#include "universe.h"
+
+using celestia::numbers::pi;
+using celestia::util::GetLogger;
+
+namespace
+{
+
+// Geometric albedo assumed for the sizes of minor planets
+constexpr double TypicalAlbedo = 0.15;
+
+// Diameter in kilometers of a body of absolute magnitude 0 and unit albedo
+constexpr double DiameterAtH0 = 1329.0;
+
+// Rows scanned by each task of findVisible()
+constexpr std::size_t ScanGrain = 16384;
+
+// Bytes of a file read at a time, and lines parsed by each task
+constexpr std::size_t LoadBlockSize = 16 * 1024 * 1024;
+constexpr std::size_t LoadGrain = 4096;
+
+// Mean motion in degrees per day of a body at 1 AU from the Sun
+constexpr double GaussianGravitationalConstant = 0.9856076686;
+
+// Slope parameter of the H, G system for bodies which don't have one
+constexpr double DefaultSlope = 0.15;
+
+// Smallest angle compared when picking, in radians
+constexpr double AngularResolution = 3.5e-6;
+
+std::string_view
+trim(std::string_view s)
+{
+    while (!s.empty() && s.front() == ' ')
+        s.remove_prefix(1);
+    while (!s.empty() && s.back() == ' ')
+        s.remove_suffix(1);
+    return s;
+}
+
+template<typename T>
+bool
+parseField(std::string_view line, std::size_t begin, std::size_t end, T& value)
+{
+    if (line.size() < end)
+        return false;
+    std::string_view field = trim(line.substr(begin, end - begin));
+    if (field.empty())
+        return false;
+    auto result = celestia::compat::from_chars(field.data(), field.data() + field.size(), value);
+    return result.ec == std::errc() && result.ptr == field.data() + field.size();
+}
+
+// Split a line of comma separated values. Fields may be quoted, and the
+// quotes are removed from them.
+void
+splitCSV(std::string_view line, std::vector<std::string_view>& fields)
+{
+    fields.clear();
+    std::size_t pos = 0;
+    for (;;)
+    {
+        std::size_t end;
+        if (pos < line.size() && line[pos] == '"')
+        {
+            std::size_t close = line.find('"', pos + 1);
+            if (close == std::string_view::npos)
+                close = line.size();
+            fields.push_back(line.substr(pos + 1, close - pos - 1));
+            end = line.find(',', close);
+        }
+        else
+        {
+            end = line.find(',', pos);
+            fields.push_back(line.substr(pos, end == std::string_view::npos ? end : end - pos));
+        }
+
+        if (end == std::string_view::npos)
+            break;
+        pos = end + 1;
+    }
+}
+
+// The digits of the packed forms of the MPC: 0-9, then A-Z for 10-35 and
+// a-z for 36-61
+int
+unpackDigit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A' + 10;
+    if (c >= 'a' && c <= 'z')
+        return c - 'a' + 36;
+    return -1;
+}
+
+// Decode a packed epoch such as K239D for 2023 September 13, 0h TT
+bool
+unpackEpoch(std::string_view packed, double& jd)
+{
+    if (packed.size() != 5)
+        return false;
+    int century = unpackDigit(packed[0]);
+    int month = unpackDigit(packed[3]);
+    int day = unpackDigit(packed[4]);
+    if (century < 10 || month < 1 || month > 12 || day < 1 || day > 31 ||
+        !std::isdigit(static_cast<unsigned char>(packed[1])) ||
+        !std::isdigit(static_cast<unsigned char>(packed[2])))
+    {
+        return false;
+    }
+
+    int year = century * 100 + (packed[1] - '0') * 10 + (packed[2] - '0');
+    jd = static_cast<double>(astro::Date(year, month, day));
+    return true;
+}
+
+// Phase function of the H, G magnitude system, for the angle between the
+// directions of the star and of the observer seen from the body
+double
+phaseFunction(double cosPhase, double slope)
+{
+    double tanHalf = std::sqrt(std::max(0.0, (1.0 - cosPhase) / (1.0 + cosPhase)));
+    double phi1 = std::exp(-3.33 * std::pow(tanHalf, 0.63));
+    double phi2 = std::exp(-1.87 * std::pow(tanHalf, 1.22));
+    return (1.0 - slope) * phi1 + slope * phi2;
+}
+
+} // end unnamed namespace
+
+
+MinorBodyTable::MinorBodyTable(Universe& universe, Star& star) :
+    m_universe(&universe),
+    m_star(&star)
+{
+}
+
+
+// The elements of a row as read from a file, in days, AU and degrees
+struct MinorBodyTable::Elements
+{
+    double epoch;
+    double meanAnomaly;
+    double meanMotion;
+    double semiMajorAxis;
+    double eccentricity;
+    double inclination;
+    double ascendingNode;
+    double argOfPeriapsis;
+    double absMag;
+    double slope{ DefaultSlope };
+    std::uint32_t number{ 0 };
+    std::string_view name;
+};
+
+
+struct MinorBodyTable::SBDBColumns
+{
+    int eccentricity{ -1 };
+    int semiMajorAxis{ -1 };
+    int perihelion{ -1 };
+    int inclination{ -1 };
+    int ascendingNode{ -1 };
+    int argOfPeriapsis{ -1 };
+    int meanAnomaly{ -1 };
+    int meanMotion{ -1 };
+    int epoch{ -1 };
+    int absMag{ -1 };
+    int slope{ -1 };
+    int fullName{ -1 };
+    int name{ -1 };
+    int designation{ -1 };
+
+    // Find the columns in the header line; false if any of the elements
+    // is missing
+    bool parseHeader(std::string_view header)
+    {
+        std::vector<std::string_view> fields;
+        splitCSV(header, fields);
+        for (std::size_t i = 0; i < fields.size(); i++)
+        {
+            std::string_view field = fields[i];
+            auto column = static_cast<int>(i);
+            if (field == "e")
+                eccentricity = column;
+            else if (field == "a")
+                semiMajorAxis = column;
+            else if (field == "q")
+                perihelion = column;
+            else if (field == "i")
+                inclination = column;
+            else if (field == "om")
+                ascendingNode = column;
+            else if (field == "w")
+                argOfPeriapsis = column;
+            else if (field == "ma")
+                meanAnomaly = column;
+            else if (field == "n")
+                meanMotion = column;
+            else if (field == "epoch")
+                epoch = column;
+            else if (field == "H")
+                absMag = column;
+            else if (field == "G")
+                slope = column;
+            else if (field == "full_name")
+                fullName = column;
+            else if (field == "name")
+                name = column;
+            else if (field == "pdes")
+                designation = column;
+        }
+
+        return eccentricity >= 0 && (semiMajorAxis >= 0 || perihelion >= 0) &&
+               inclination >= 0 && ascendingNode >= 0 && argOfPeriapsis >= 0 &&
+               meanAnomaly >= 0 && epoch >= 0 && absMag >= 0;
+    }
+};
+
+
+unsigned int
+MinorBodyTable::classifyOrbit(double perihelion, double semiMajorAxis)
+{
+    if (perihelion < 1.3)
+        return NearEarth;
+    if (perihelion < 1.666)
+        return MarsCrosser;
+    if (semiMajorAxis < 4.6)
+        return MainBelt;
+    if (semiMajorAxis < 5.5)
+        return JupiterTrojan;
+    if (semiMajorAxis < 30.1)
+        return Centaur;
+    return TransNeptunian;
+}
+
+
+unsigned int
+MinorBodyTable::parseOrbitClass(std::string_view name)
+{
+    if (compareIgnoringCase(name, "NEO") == 0)
+        return NearEarth;
+    if (compareIgnoringCase(name, "MarsCrosser") == 0)
+        return MarsCrosser;
+    if (compareIgnoringCase(name, "MainBelt") == 0)
+        return MainBelt;
+    if (compareIgnoringCase(name, "Trojan") == 0)
+        return JupiterTrojan;
+    if (compareIgnoringCase(name, "Centaur") == 0)
+        return Centaur;
+    if (compareIgnoringCase(name, "TNO") == 0)
+        return TransNeptunian;
+    return 0;
+}
+
+
+std::size_t
+MinorBodyTable::loadMPCORB(std::istream& in, const Filter& filter)
+{
+    return loadLines(in, filter, [](std::string_view line, Elements& elements)
+    {
+        return parseMPCORBLine(line, elements);
+    });
+}
+
+
+std::size_t
+MinorBodyTable::loadSBDB(std::istream& in, const Filter& filter)
+{
+    std::string header;
+    SBDBColumns columns;
+    if (!std::getline(in, header) || !columns.parseHeader(trim(header)))
+    {
+        GetLogger()->error("Small body database file is missing columns of the orbital elements.\n");
+        return 0;
+    }
+
+    return loadLines(in, filter, [&columns](std::string_view line, Elements& elements)
+    {
+        return parseSBDBLine(line, columns, elements);
+    });
+}
+
+
+// Read the file in blocks of whole lines, each of which is parsed in
+// parallel into bands of rows that are appended in the order of the file
+template<typename F>
+std::size_t
+MinorBodyTable::loadLines(std::istream& in, const Filter& filter, F&& parse)
+{
+    std::size_t firstRow = size();
+    std::string block;
+    std::vector<std::string_view> lines;
+    std::vector<std::vector<Elements>> bands;
+    while (in)
+    {
+        std::size_t kept = block.size();
+        block.resize(kept + LoadBlockSize);
+        in.read(block.data() + kept, LoadBlockSize);
+        block.resize(kept + static_cast<std::size_t>(in.gcount()));
+
+        // Keep the last line for the next block unless it's the end
+        std::size_t end = block.size();
+        if (in)
+        {
+            std::size_t newline = block.rfind('\n');
+            end = newline == std::string::npos ? 0 : newline + 1;
+        }
+
+        lines.clear();
+        std::string_view text(block.data(), end);
+        while (!text.empty())
+        {
+            std::size_t newline = text.find('\n');
+            std::string_view line = text.substr(0, newline);
+            if (!line.empty() && line.back() == '\r')
+                line.remove_suffix(1);
+            lines.push_back(line);
+            text.remove_prefix(newline == std::string_view::npos ? text.size() : newline + 1);
+        }
+
+        bands.clear();
+        bands.resize((lines.size() + LoadGrain - 1) / LoadGrain);
+        celestia::util::ParallelFor(0, lines.size(), LoadGrain, [&](std::size_t first, std::size_t last)
+        {
+            std::vector<Elements>& band = bands[first / LoadGrain];
+            band.reserve(last - first);
+            Elements elements;
+            for (std::size_t i = first; i < last; i++)
+            {
+                elements = Elements();
+                if (parse(lines[i], elements) && accepts(filter, elements))
+                    band.push_back(elements);
+            }
+        }, celestia::util::JobPriority::Interactive);
+
+        // The names are views of the block, so the rows are appended before
+        // the block is reused
+        for (const auto& band : bands)
+        {
+            for (const auto& elements : band)
+                append(elements);
+        }
+
+        block.erase(0, end);
+    }
+
+    buildIndexes();
+    return size() - firstRow;
+}
+
+
+bool
+MinorBodyTable::accepts(const Filter& filter, const Elements& elements)
+{
+    if (elements.absMag > filter.maxAbsMag)
+        return false;
+    double perihelion = elements.semiMajorAxis * (1.0 - elements.eccentricity);
+    return (classifyOrbit(perihelion, elements.semiMajorAxis) & filter.orbitClasses) != 0;
+}
+
+
+// Columns of MPCORB.DAT, counted from zero
+bool
+MinorBodyTable::parseMPCORBLine(std::string_view line, Elements& elements)
+{
+    if (!parseField(line, 8, 13, elements.absMag) ||
+        !parseField(line, 26, 35, elements.meanAnomaly) ||
+        !parseField(line, 37, 46, elements.argOfPeriapsis) ||
+        !parseField(line, 48, 57, elements.ascendingNode) ||
+        !parseField(line, 59, 68, elements.inclination) ||
+        !parseField(line, 70, 79, elements.eccentricity) ||
+        !parseField(line, 80, 91, elements.meanMotion) ||
+        !parseField(line, 92, 103, elements.semiMajorAxis) ||
+        !unpackEpoch(trim(line.substr(20, 5)), elements.epoch))
+    {
+        return false;
+    }
+
+    // The slope is left out for many bodies
+    parseField(line, 14, 19, elements.slope);
+
+    // The readable designation is either "(number) name" or a provisional
+    // designation
+    std::string_view name;
+    if (line.size() > 166)
+        name = trim(line.substr(166, 28));
+    if (name.empty())
+        name = trim(line.substr(0, 7));
+    if (!name.empty() && name.front() == '(')
+    {
+        std::size_t close = name.find(')');
+        if (close != std::string_view::npos)
+        {
+            celestia::compat::from_chars(name.data() + 1, name.data() + close, elements.number);
+            name = trim(name.substr(close + 1));
+        }
+    }
+    elements.name = name;
+
+    return isPeriodic(elements);
+}
+
+
+// Lines of the CSV files exported by the small body database search of
+// JPL, with the elements in AU and degrees and the epoch a Julian date
+bool
+MinorBodyTable::parseSBDBLine(std::string_view line,
+                              const SBDBColumns& columns,
+                              Elements& elements)
+{
+    // One vector per thread, to avoid allocating for each line
+    thread_local std::vector<std::string_view> fields;
+    splitCSV(line, fields);
+
+    auto get = [](std::string_view field, double& value)
+    {
+        if (field.empty())
+            return false;
+        auto result = celestia::compat::from_chars(field.data(), field.data() + field.size(), value);
+        return result.ec == std::errc() && result.ptr == field.data() + field.size();
+    };
+    auto column = [](int index)
+    {
+        return index >= 0 && static_cast<std::size_t>(index) < fields.size()
+            ? trim(fields[index])
+            : std::string_view();
+    };
+
+    if (!get(column(columns.eccentricity), elements.eccentricity) ||
+        !get(column(columns.inclination), elements.inclination) ||
+        !get(column(columns.ascendingNode), elements.ascendingNode) ||
+        !get(column(columns.argOfPeriapsis), elements.argOfPeriapsis) ||
+        !get(column(columns.meanAnomaly), elements.meanAnomaly) ||
+        !get(column(columns.epoch), elements.epoch) ||
+        !get(column(columns.absMag), elements.absMag))
+    {
+        return false;
+    }
+
+    if (!get(column(columns.semiMajorAxis), elements.semiMajorAxis))
+    {
+        double perihelion;
+        if (!get(column(columns.perihelion), perihelion) || elements.eccentricity >= 1.0)
+            return false;
+        elements.semiMajorAxis = perihelion / (1.0 - elements.eccentricity);
+    }
+
+    // The mean motion follows from the semi-major axis when it's left out
+    if (!get(column(columns.meanMotion), elements.meanMotion) && elements.semiMajorAxis > 0.0)
+        elements.meanMotion = GaussianGravitationalConstant / (elements.semiMajorAxis * std::sqrt(elements.semiMajorAxis));
+
+    get(column(columns.slope), elements.slope);
+
+    // The full name is "number name (designation)" for numbered bodies and
+    // "(designation)" for the others
+    std::string_view name = column(columns.name);
+    std::string_view fullName = column(columns.fullName);
+    if (!fullName.empty())
+    {
+        std::size_t digits = 0;
+        while (digits < fullName.size() && std::isdigit(static_cast<unsigned char>(fullName[digits])))
+            digits++;
+        celestia::compat::from_chars(fullName.data(), fullName.data() + digits, elements.number);
+        fullName = trim(fullName.substr(digits));
+
+        std::size_t open = fullName.rfind('(');
+        if (open != std::string_view::npos && fullName.back() == ')')
+        {
+            std::string_view designation = fullName.substr(open + 1, fullName.size() - open - 2);
+            fullName = trim(fullName.substr(0, open));
+            if (fullName.empty())
+                fullName = designation;
+        }
+        if (name.empty())
+            name = fullName;
+    }
+    if (name.empty())
+        name = column(columns.designation);
+    elements.name = name;
+
+    return isPeriodic(elements);
+}
+
+
+// Parabolic and hyperbolic orbits don't have the periodic form that the
+// rows are computed with
+bool
+MinorBodyTable::isPeriodic(const Elements& elements)
+{
+    return elements.eccentricity >= 0.0 && elements.eccentricity < 1.0 &&
+           elements.semiMajorAxis > 0.0 && elements.meanMotion > 0.0;
+}
+
+
+void
+MinorBodyTable::append(const Elements& elements)
+{
+    m_epoch.push_back(elements.epoch);
+    m_meanAnomaly.push_back(celmath::degToRad(elements.meanAnomaly));
+    m_meanMotion.push_back(celmath::degToRad(elements.meanMotion));
+    m_semiMajorAxis.push_back(astro::AUtoKilometers(elements.semiMajorAxis));
+    m_eccentricity.push_back(elements.eccentricity);
+    m_inclination.push_back(celmath::degToRad(elements.inclination));
+    m_ascendingNode.push_back(celmath::degToRad(elements.ascendingNode));
+    m_argOfPeriapsis.push_back(celmath::degToRad(elements.argOfPeriapsis));
+
+    // As in EllipticalOrbit, converted to Celestia's internal coordinates
+    Eigen::Matrix3d orbitPlane = (celmath::ZRotation(m_ascendingNode.back()) *
+                                  celmath::XRotation(m_inclination.back()) *
+                                  celmath::ZRotation(m_argOfPeriapsis.back())).toRotationMatrix();
+    Eigen::Vector3d major = orbitPlane.col(0);
+    Eigen::Vector3d minor = orbitPlane.col(1);
+    m_majorDirection.emplace_back(major.x(), major.z(), -major.y());
+    m_minorDirection.emplace_back(minor.x(), minor.z(), -minor.y());
+
+    m_absMag.push_back(static_cast<float>(elements.absMag));
+    m_slope.push_back(static_cast<float>(elements.slope));
+    m_fluxFactor.push_back(static_cast<float>(std::pow(10.0, -elements.absMag / 5.0)));
+    m_perihelion.push_back(static_cast<float>(elements.semiMajorAxis * (1.0 - elements.eccentricity)));
+    m_aphelion.push_back(static_cast<float>(elements.semiMajorAxis * (1.0 + elements.eccentricity)));
+
+    if (m_nameOffsets.empty())
+        m_nameOffsets.push_back(0);
+    m_names.append(elements.name);
+    m_nameOffsets.push_back(static_cast<std::uint32_t>(m_names.size()));
+    m_numbers.push_back(elements.number);
+    m_isPromoted.push_back(false);
+}
+
+
+void
+MinorBodyTable::buildIndexes()
+{
+    m_nameIndex.resize(size());
+    for (std::uint32_t row = 0; row < size(); row++)
+        m_nameIndex[row] = row;
+    std::sort(m_nameIndex.begin(), m_nameIndex.end(),
+              [this](std::uint32_t a, std::uint32_t b)
+              {
+                  return compareIgnoringCase(getName(a), getName(b)) < 0;
+              });
+
+    m_numberIndex.clear();
+    for (std::uint32_t row = 0; row < size(); row++)
+    {
+        if (m_numbers[row] != 0)
+            m_numberIndex.push_back(row);
+    }
+    std::sort(m_numberIndex.begin(), m_numberIndex.end(),
+              [this](std::uint32_t a, std::uint32_t b) { return m_numbers[a] < m_numbers[b]; });
+}
+
+
+std::string_view
+MinorBodyTable::getName(std::uint32_t row) const
+{
+    return std::string_view(m_names).substr(m_nameOffsets[row],
+                                            m_nameOffsets[row + 1] - m_nameOffsets[row]);
+}
+
+
+float
+MinorBodyTable::getRadius(std::uint32_t row) const
+{
+    return static_cast<float>(0.5 * DiameterAtH0 / std::sqrt(TypicalAlbedo)) * m_fluxFactor[row];
+}
+
+
+std::uint32_t
+MinorBodyTable::find(std::string_view name) const
+{
+    if (name.size() > 2 && name.front() == '(' && name.back() == ')')
+    {
+        std::uint32_t number = 0;
+        auto result = celestia::compat::from_chars(name.data() + 1, name.data() + name.size() - 1, number);
+        if (result.ec != std::errc() || result.ptr != name.data() + name.size() - 1)
+            return InvalidRow;
+
+        auto iter = std::lower_bound(m_numberIndex.begin(), m_numberIndex.end(), number,
+                                     [this](std::uint32_t row, std::uint32_t n) { return m_numbers[row] < n; });
+        if (iter != m_numberIndex.end() && m_numbers[*iter] == number)
+            return *iter;
+        return InvalidRow;
+    }
+
+    auto iter = std::lower_bound(m_nameIndex.begin(), m_nameIndex.end(), name,
+                                 [this](std::uint32_t row, std::string_view s)
+                                 {
+                                     return compareIgnoringCase(getName(row), s) < 0;
+                                 });
+    if (iter != m_nameIndex.end() && compareIgnoringCase(getName(*iter), name) == 0)
+        return *iter;
+    return InvalidRow;
+}
+
+
+double
+MinorBodyTable::eccentricAnomaly(std::uint32_t row, double tdb) const
+{
+    double e = m_eccentricity[row];
+    double M = std::remainder(m_meanAnomaly[row] + m_meanMotion[row] * (tdb - m_epoch[row]), 2.0 * pi);
+
+    // Newton's method, from a start which converges for all eccentricities
+    double E = e < 0.8 ? M : std::copysign(pi, M);
+    for (int i = 0; i < 16; i++)
+    {
+        double dE = (E - e * std::sin(E) - M) / (1.0 - e * std::cos(E));
+        E -= dE;
+        if (std::abs(dE) < 1.0e-12)
+            break;
+    }
+
+    return E;
+}
+
+
+Eigen::Vector3d
+MinorBodyTable::getPosition(std::uint32_t row, double tdb) const
+{
+    double E = eccentricAnomaly(row, tdb);
+    double a = m_semiMajorAxis[row];
+    double e = m_eccentricity[row];
+    return a * (std::cos(E) - e) * m_majorDirection[row] +
+           a * std::sqrt(1.0 - e * e) * std::sin(E) * m_minorDirection[row];
+}
+
+
+void
+MinorBodyTable::getOrbitEllipse(std::uint32_t row,
+                                Eigen::Vector3d& center,
+                                Eigen::Vector3d& majorAxis,
+                                Eigen::Vector3d& minorAxis) const
+{
+    double a = m_semiMajorAxis[row];
+    double e = m_eccentricity[row];
+    center = -a * e * m_majorDirection[row];
+    majorAxis = a * m_majorDirection[row];
+    minorAxis = a * std::sqrt(1.0 - e * e) * m_minorDirection[row];
+}
+
+
+void
+MinorBodyTable::findVisible(const Eigen::Vector3d& observerPosition,
+                            double tdb,
+                            float faintestMag,
+                            float pixelSize,
+                            std::vector<VisibleBody>& visible) const
+{
+    visible.clear();
+
+    // A row can't be brighter than at perihelion and at the least distance
+    // from the observer of the shell between perihelion and aphelion,
+    // where H + 5 log10(q * delta) < faintestMag. The bound is compared as
+    // q * delta < 10^(faintestMag / 5) * 10^(-H / 5).
+    auto observerDistance = static_cast<float>(astro::kilometersToAU(observerPosition.norm()));
+    auto brightnessLimit = static_cast<float>(std::pow(10.0, faintestMag / 5.0));
+    // A disc of a pixel is seen out to a distance of diameter / pixelSize
+    float resolvedLimit = pixelSize > 0.0f
+        ? static_cast<float>(DiameterAtH0 / std::sqrt(TypicalAlbedo) / KM_PER_AU) / pixelSize
+        : 0.0f;
+
+    std::size_t nRows = size();
+    std::vector<std::vector<VisibleBody>> bands((nRows + ScanGrain - 1) / ScanGrain);
+    celestia::util::ParallelFor(0, nRows, ScanGrain, [&](std::size_t first, std::size_t last)
+    {
+        std::vector<VisibleBody>& band = bands[first / ScanGrain];
+        for (auto row = static_cast<std::uint32_t>(first); row < last; row++)
+        {
+            float minDistance = std::max({ m_perihelion[row] - observerDistance,
+                                           observerDistance - m_aphelion[row],
+                                           0.0f });
+            if (m_perihelion[row] * minDistance >= brightnessLimit * m_fluxFactor[row] &&
+                minDistance >= resolvedLimit * m_fluxFactor[row])
+            {
+                continue;
+            }
+            if (m_isPromoted[row])
+                continue;
+
+            Eigen::Vector3d position = getPosition(row, tdb);
+            Eigen::Vector3d relative = position - observerPosition;
+            double r = position.norm();
+            double delta = relative.norm();
+            double cosPhase = position.dot(relative) / (r * delta);
+            double appMag = m_absMag[row]
+                          + 5.0 * std::log10(astro::kilometersToAU(r) * astro::kilometersToAU(delta))
+                          - 2.5 * std::log10(std::max(phaseFunction(cosPhase, m_slope[row]), 1.0e-10));
+            float discSize = pixelSize > 0.0f
+                ? 2.0f * getRadius(row) / static_cast<float>(delta * pixelSize)
+                : 0.0f;
+            if (appMag < faintestMag || discSize >= 1.0f)
+                band.push_back({ row, position, static_cast<float>(appMag), discSize });
+        }
+    }, celestia::util::JobPriority::Interactive);
+
+    for (const auto& band : bands)
+        visible.insert(visible.end(), band.begin(), band.end());
+}
+
+
+std::uint32_t
+MinorBodyTable::pick(const Eigen::Vector3d& origin,
+                     const Eigen::Vector3d& direction,
+                     double tdb,
+                     float faintestMag,
+                     float tolerance) const
+{
+    std::vector<VisibleBody> visible;
+    findVisible(origin, tdb, faintestMag, 0.0f, visible);
+
+    double sinAngle2Closest = std::max(std::sin(tolerance / 2.0), AngularResolution);
+    std::uint32_t closest = InvalidRow;
+    for (const auto& body : visible)
+    {
+        double sinAngle2 = ((body.position - origin).normalized() - direction).norm() / 2.0;
+        if (sinAngle2 <= sinAngle2Closest)
+        {
+            sinAngle2Closest = std::max(sinAngle2, AngularResolution);
+            closest = body.row;
+        }
+    }
+
+    return closest;
+}
+
+
+Body*
+MinorBodyTable::promote(std::uint32_t row)
+{
+    if (auto iter = m_promoted.find(row); iter != m_promoted.end())
+        return iter->second;
+
+    SolarSystem* solarSystem = m_universe->getSolarSystem(m_star);
+    if (solarSystem == nullptr)
+        solarSystem = m_universe->createSolarSystem(m_star);
+
+    auto* body = new Body(solarSystem->getPlanets(), std::string(getName(row)));
+    body->setClassification(Body::Asteroid);
+    body->setSemiAxes(Eigen::Vector3f::Constant(getRadius(row)));
+    body->setGeomAlbedo(static_cast<float>(TypicalAlbedo));
+
+    // Orbits and rotation models aren't owned by their timeline phases
+    double period = 2.0 * pi / m_meanMotion[row];
+    auto* orbit = new EllipticalOrbit(m_semiMajorAxis[row] * (1.0 - m_eccentricity[row]),
+                                      m_eccentricity[row],
+                                      m_inclination[row],
+                                      m_ascendingNode[row],
+                                      m_argOfPeriapsis[row],
+                                      m_meanAnomaly[row],
+                                      period,
+                                      m_epoch[row]);
+    RotationModel* rotationModel = CreateDefaultRotationModel(period);
+
+    const auto& frame = solarSystem->getFrameTree()->getDefaultReferenceFrame();
+    auto phase = TimelinePhase::CreateTimelinePhase(*m_universe,
+                                                    body,
+                                                    -std::numeric_limits<double>::infinity(),
+                                                    std::numeric_limits<double>::infinity(),
+                                                    frame,
+                                                    *orbit,
+                                                    frame,
+                                                    *rotationModel);
+    auto* timeline = new Timeline();
+    timeline->appendPhase(phase);
+    body->setTimeline(timeline);
+
+    m_promoted.try_emplace(row, body);
+    m_isPromoted[row] = true;
+    return body;
+}
+
+
+Body*
+MinorBodyTable::getPromoted(std::uint32_t row) const
+{
+    auto iter = m_promoted.find(row);
+    return iter == m_promoted.end() ? nullptr : iter->second;
+}
@@ -0,0 +1,202 @@
+// minorbodies.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Compact table of the minor planets orbiting a star.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <Eigen/Core>
+
+class Body;
+class Star;
+class Universe;
+
+/**
+ * Minor planets kept as rows of Keplerian elements in a structure of
+ * arrays, rather than as a Body each with its names, surface, timeline and
+ * orbit object. A catalog of a million asteroids takes about a hundred
+ * bytes per row, and loads without going through the parser of solar
+ * system catalogs.
+ *
+ * The renderer draws the rows as points, orbits and labels straight from
+ * the table, and the pick and name lookups of Universe search it. A row
+ * is promoted to a Body in the planetary system of the star when it's
+ * selected, or when it comes close enough to show a disc; from then on the
+ * body stands in for it.
+ *
+ * Positions are relative to the star, in kilometers, in the ecliptic and
+ * equinox of J2000 with the axes of Celestia's universal frame.
+ */
+class MinorBodyTable
+{
+ public:
+    static constexpr std::uint32_t InvalidRow = ~std::uint32_t(0);
+
+    // Classes of orbits, by perihelion distance q and semi-major axis a
+    enum OrbitClass : unsigned int
+    {
+        // q < 1.3 AU
+        NearEarth       = 0x01,
+        // q < 1.666 AU
+        MarsCrosser     = 0x02,
+        // a < 4.6 AU
+        MainBelt        = 0x04,
+        // a < 5.5 AU
+        JupiterTrojan   = 0x08,
+        // a < 30.1 AU
+        Centaur         = 0x10,
+        TransNeptunian  = 0x20,
+        AllOrbitClasses = 0x3f,
+    };
+
+    // The rows of a file kept by the loaders
+    struct Filter
+    {
+        float maxAbsMag{ std::numeric_limits<float>::infinity() };
+        unsigned int orbitClasses{ AllOrbitClasses };
+    };
+
+    struct VisibleBody
+    {
+        std::uint32_t row;
+        // Relative to the star
+        Eigen::Vector3d position;
+        float appMag;
+        // Diameter on screen, in pixels
+        float discSize;
+    };
+
+    MinorBodyTable(Universe& universe, Star& star);
+    ~MinorBodyTable() = default;
+    MinorBodyTable(const MinorBodyTable&) = delete;
+    MinorBodyTable& operator=(const MinorBodyTable&) = delete;
+
+    // Append the orbits of a file in the format of MPCORB.DAT, the orbit
+    // database of the Minor Planet Center, and return the number of rows
+    // read. Lines which aren't orbits, such as the header, are skipped.
+    // The file is read in large blocks, the lines of which are parsed in
+    // parallel on the job system.
+    std::size_t loadMPCORB(std::istream& in, const Filter& filter);
+    std::size_t loadMPCORB(std::istream& in) { return loadMPCORB(in, Filter()); }
+    // Append the orbits of a CSV file exported from the small body
+    // database of JPL. The header names the columns; e, a or q, i, om, w,
+    // ma, epoch and H are needed, and n, G, full_name, name and pdes are
+    // used when present.
+    std::size_t loadSBDB(std::istream& in, const Filter& filter);
+    std::size_t loadSBDB(std::istream& in) { return loadSBDB(in, Filter()); }
+
+    // The class of an orbit with distances in AU
+    static unsigned int classifyOrbit(double perihelion, double semiMajorAxis);
+    // The class named NEO, MarsCrosser, MainBelt, Trojan, Centaur or TNO,
+    // ignoring case; 0 for other names
+    static unsigned int parseOrbitClass(std::string_view name);
+
+    std::uint32_t size() const { return static_cast<std::uint32_t>(m_absMag.size()); }
+    Star* getStar() const { return m_star; }
+
+    std::string_view getName(std::uint32_t row) const;
+    float getAbsoluteMagnitude(std::uint32_t row) const { return m_absMag[row]; }
+    // Radius estimated from the absolute magnitude for a typical albedo
+    float getRadius(std::uint32_t row) const;
+
+    // Find a row by name or provisional designation, ignoring case, or by
+    // number in the form "(433)"
+    std::uint32_t find(std::string_view name) const;
+
+    Eigen::Vector3d getPosition(std::uint32_t row, double tdb) const;
+    // The orbit is center + cos(E) * majorAxis + sin(E) * minorAxis
+    void getOrbitEllipse(std::uint32_t row,
+                         Eigen::Vector3d& center,
+                         Eigen::Vector3d& majorAxis,
+                         Eigen::Vector3d& minorAxis) const;
+
+    // Find the rows brighter than faintestMag for an observer at
+    // observerPosition, relative to the star, skipping those promoted.
+    // Rows are ruled out by a bound on their brightness from the distances
+    // of perihelion and aphelion before their positions are computed, and
+    // the table is scanned in parallel on the job system. With pixelSize
+    // non-zero, rows with discs of a pixel or more are found whatever
+    // their brightness.
+    void findVisible(const Eigen::Vector3d& observerPosition,
+                     double tdb,
+                     float faintestMag,
+                     float pixelSize,
+                     std::vector<VisibleBody>& visible) const;
+
+    // Find the row brighter than faintestMag closest to a ray from origin,
+    // relative to the star, within an angle of tolerance
+    std::uint32_t pick(const Eigen::Vector3d& origin,
+                       const Eigen::Vector3d& direction,
+                       double tdb,
+                       float faintestMag,
+                       float tolerance) const;
+
+    // Return the body standing in for a row, creating it on the first call
+    Body* promote(std::uint32_t row);
+    Body* getPromoted(std::uint32_t row) const;
+
+ private:
+    struct Elements;
+    struct SBDBColumns;
+
+    template<typename F>
+    std::size_t loadLines(std::istream& in, const Filter& filter, F&& parse);
+    static bool parseMPCORBLine(std::string_view line, Elements& elements);
+    static bool parseSBDBLine(std::string_view line, const SBDBColumns& columns, Elements& elements);
+    static bool isPeriodic(const Elements& elements);
+    static bool accepts(const Filter& filter, const Elements& elements);
+    void append(const Elements& elements);
+    void buildIndexes();
+    double eccentricAnomaly(std::uint32_t row, double tdb) const;
+
+    Universe* m_universe;
+    Star* m_star;
+
+    // Elements, in days, kilometers and radians
+    std::vector<double> m_epoch;
+    std::vector<double> m_meanAnomaly;
+    std::vector<double> m_meanMotion;
+    std::vector<double> m_semiMajorAxis;
+    std::vector<double> m_eccentricity;
+    std::vector<double> m_inclination;
+    std::vector<double> m_ascendingNode;
+    std::vector<double> m_argOfPeriapsis;
+    // Unit vectors toward the periapsis, and 90 degrees ahead of it in the
+    // plane of the orbit
+    std::vector<Eigen::Vector3d> m_majorDirection;
+    std::vector<Eigen::Vector3d> m_minorDirection;
+
+    // Magnitudes in the H, G system
+    std::vector<float> m_absMag;
+    std::vector<float> m_slope;
+    // 10^(-H/5), which scales the brightness bound of findVisible()
+    std::vector<float> m_fluxFactor;
+    // Perihelion and aphelion distances in AU
+    std::vector<float> m_perihelion;
+    std::vector<float> m_aphelion;
+
+    // The names of all rows in one string
+    std::string m_names;
+    std::vector<std::uint32_t> m_nameOffsets;
+    std::vector<std::uint32_t> m_numbers;
+    // Rows sorted by name and by number, for binary searches
+    std::vector<std::uint32_t> m_nameIndex;
+    std::vector<std::uint32_t> m_numberIndex;
+
+    std::unordered_map<std::uint32_t, Body*> m_promoted;
+    std::vector<bool> m_isPromoted;
+};
@@ -8,40 +8,68 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
-#include <map>
 #include <utility>
+#include <vector>
 
+#include <celmodel/vertexpacking.h>
 #include "glsupport.h"
 #include "modelgeometry.h"
+#include "modelheap.h"
 #include "rendcontext.h"
+#include "glstate.h"
 
 
-// Vertex buffer object support
-
-// VBO optimization is only worthwhile for large enough vertex lists
-static const unsigned int MinVBOSize = 4096;
-
-
+// Location of a mesh's data in the model geometry heap. Ranges with a zero
+// buffer weren't uploaded and are drawn from client memory.
 class ModelOpenGLData
 {
 public:
+    struct GroupData
+    {
+        HeapRange indices;
+        GLenum indexType{ GL_UNSIGNED_INT };
+        HeapRange overrideVertices;
+        HeapRange overrideIndices;
+        std::vector<HeapRange> lodIndices;
+    };
+
+    struct MeshData
+    {
+        HeapRange vertices;
+        // Layout of the vertices in the heap, which may be packed
+        cmod::VertexDescription vertexDescription;
+        std::vector<GroupData> groups;
+    };
+
     ModelOpenGLData() = default;
 
-    ~ModelOpenGLData()
+    void free(const cmod::Model& model)
     {
-        for (auto vboId : vbos)
+        ModelGeometryHeap* heap = GetModelGeometryHeap();
+        for (unsigned int i = 0; i < meshes.size(); ++i)
         {
-            if (vboId.second)
+            const cmod::Mesh* mesh = model.getMesh(i);
+            heap->freeVertices(meshes[i].vertexDescription.strideBytes, meshes[i].vertices);
+            for (unsigned int j = 0; j < meshes[i].groups.size(); ++j)
             {
-                glDeleteBuffers(1, &vboId.second);
+                const GroupData& group = meshes[i].groups[j];
+                heap->freeIndices(group.indices);
+                heap->freeVertices(mesh->getGroup(j)->vertexDescriptionOverride.strideBytes, group.overrideVertices);
+                heap->freeIndices(group.overrideIndices);
+                for (const HeapRange& lod : group.lodIndices)
+                    heap->freeIndices(lod);
             }
         }
+        meshes.clear();
     }
 
-    std::map<const cmod::VWord*, GLuint> vbos; // vertex buffer objects
+    std::vector<MeshData> meshes;
 };
 
 
+bool ModelGeometry::s_packVertices = false;
+
+
 /** Create a new ModelGeometry wrapping the specified model.
   * The ModelGeoemtry takes ownership of the model.
   */
@@ -49,6 +77,35 @@ ModelGeometry::ModelGeometry(std::unique_ptr<cmod::Model>&& model) :
     m_model(std::move(model)),
     m_glData(std::make_unique<ModelOpenGLData>())
 {
+    // The instanced shaders light triangles with vertex normals, and
+    // don't support normal maps.
+    if (m_model->usesTextureType(cmod::TextureSemantic::NormalMap))
+        m_supportsInstancing = false;
+    for (unsigned int i = 0; i < m_model->getMeshCount() && m_supportsInstancing; ++i)
+    {
+        const cmod::Mesh* mesh = m_model->getMesh(i);
+        if (mesh->getVertexDescription().getAttribute(cmod::VertexAttributeSemantic::Normal).format !=
+            cmod::VertexAttributeFormat::Float3)
+        {
+            m_supportsInstancing = false;
+        }
+        for (unsigned int j = 0; j < mesh->getGroupCount(); ++j)
+        {
+            cmod::PrimitiveGroupType prim = mesh->getGroup(j)->prim;
+            if (prim != cmod::PrimitiveGroupType::TriList &&
+                prim != cmod::PrimitiveGroupType::TriStrip &&
+                prim != cmod::PrimitiveGroupType::TriFan)
+            {
+                m_supportsInstancing = false;
+            }
+        }
+    }
+}
+
+
+ModelGeometry::~ModelGeometry()
+{
+    m_glData->free(*m_model);
 }
 
 
@@ -59,105 +116,217 @@ ModelGeometry::pick(const Eigen::ParametrizedLine<double, 3>& r, double& distanc
 }
 
 
-/*! Render the model; the time parameter is ignored right now
- *  since this class doesn't currently support animation.
+/*! Copy the vertices and indices into the shared model geometry heap, so
+ *  that meshes of every model are drawn from a few large buffer objects.
+ *  This duplicates the vertex data; the original is still needed for
+ *  picking. With packing enabled, normals and tangents are uploaded in two
+ *  16-bit components and texture coordinates as half floats; positions
+ *  stay floats, as every shader drawing models reads them directly.
+ *  Called by the first render() if it hasn't been already.
  */
 void
-ModelGeometry::render(RenderContext& rc, double /* t */)
+ModelGeometry::createBuffers()
 {
-    // The first time the mesh is rendered, we will try and place the
-    // vertex data in a vertex buffer object and potentially get a huge
-    // rendering performance boost.  This can consume a great deal of
-    // memory, since we're duplicating the vertex data.  TODO: investigate
-    // the possibility of deleting the original data.  We can always map
-    // read-only later on for things like picking, but this could be a low
-    // performance path.
-    if (!m_vbInitialized)
+    if (m_vbInitialized)
+        return;
+    m_vbInitialized = true;
+
+    unsigned int packing = 0;
+    if (s_packVertices)
+        packing = celestia::gl::ARB_half_float_vertex ? cmod::PackNormals | cmod::PackTexCoords : cmod::PackNormals;
+
+    ModelGeometryHeap* heap = GetModelGeometryHeap();
+    m_glData->meshes.resize(m_model->getMeshCount());
+    for (unsigned int i = 0; i < m_model->getMeshCount(); ++i)
     {
-        m_vbInitialized = true;
+        const cmod::Mesh* mesh = m_model->getMesh(i);
+        ModelOpenGLData::MeshData& meshData = m_glData->meshes[i];
+        meshData.vertexDescription = packing != 0
+            ? cmod::packVertexDescription(mesh->getVertexDescription(), packing)
+            : mesh->getVertexDescription().clone();
 
-        for (unsigned int i = 0; i < m_model->getMeshCount(); ++i)
+        if (cmod::isPacked(meshData.vertexDescription))
+        {
+            std::vector<cmod::VWord> packed = cmod::convertVertices(mesh->getVertexDescription(),
+                                                                    mesh->getVertexData(),
+                                                                    mesh->getVertexCount(),
+                                                                    meshData.vertexDescription,
+                                                                    Eigen::AlignedBox3f());
+            meshData.vertices = heap->allocateVertices(meshData.vertexDescription.strideBytes,
+                                                       mesh->getVertexCount(),
+                                                       packed.data());
+        }
+        else
         {
-            const cmod::Mesh* mesh = m_model->getMesh(i);
-            const cmod::VertexDescription& vertexDesc = mesh->getVertexDescription();
+            meshData.vertices = heap->allocateVertices(meshData.vertexDescription.strideBytes,
+                                                       mesh->getVertexCount(),
+                                                       mesh->getVertexData());
+        }
 
-            GLuint vboId = 0;
-            if (mesh->getVertexCount() * vertexDesc.strideBytes > MinVBOSize)
+        meshData.groups.resize(mesh->getGroupCount());
+        for (unsigned int groupIndex = 0; groupIndex < mesh->getGroupCount(); ++groupIndex)
+        {
+            const cmod::PrimitiveGroup* group = mesh->getGroup(groupIndex);
+            ModelOpenGLData::GroupData& groupData = meshData.groups[groupIndex];
+            if (!group->indices16.empty())
             {
-                glGenBuffers(1, &vboId);
-                if (vboId != 0)
-                {
-                    glBindBuffer(GL_ARRAY_BUFFER, vboId);
-                    glBufferData(GL_ARRAY_BUFFER,
-                                 mesh->getVertexCount() * vertexDesc.strideBytes,
-                                 mesh->getVertexData(),
-                                 GL_STATIC_DRAW);
-                    glBindBuffer(GL_ARRAY_BUFFER, 0);
-                    m_glData->vbos[mesh->getVertexData()] = vboId;
-                }
+                groupData.indexType = GL_UNSIGNED_SHORT;
+                groupData.indices = heap->allocateIndices(group->indices16.size() * sizeof(cmod::Index16),
+                                                          sizeof(cmod::Index16),
+                                                          group->indices16.data());
+            }
+            else
+            {
+                groupData.indices = heap->allocateIndices(group->indices.size() * sizeof(cmod::Index32),
+                                                          sizeof(cmod::Index32),
+                                                          group->indices.data());
             }
 
-            for (unsigned int groupIndex = 0; groupIndex < mesh->getGroupCount(); ++groupIndex)
+            // Levels of detail use the same index type as the full
+            // resolution indices.
+            for (const auto& lod : group->lodIndices)
             {
-                const cmod::PrimitiveGroup* group = mesh->getGroup(groupIndex);
-                if (!group->vertexOverride.empty()
-                    && group->vertexCountOverride * group->vertexDescriptionOverride.strideBytes > MinVBOSize)
+                if (groupData.indexType == GL_UNSIGNED_SHORT)
                 {
-                    glGenBuffers(1, &vboId);
-                    if (vboId != 0)
-                    {
-                        glBindBuffer(GL_ARRAY_BUFFER, vboId);
-                        glBufferData(GL_ARRAY_BUFFER,
-                                     group->vertexCountOverride * group->vertexDescriptionOverride.strideBytes,
-                                     group->vertexOverride.data(), GL_STATIC_DRAW);
-                        glBindBuffer(GL_ARRAY_BUFFER, 0);
-                        m_glData->vbos[group->vertexOverride.data()] = vboId;
-                    }
+                    std::vector<cmod::Index16> lod16(lod.begin(), lod.end());
+                    groupData.lodIndices.push_back(heap->allocateIndices(lod16.size() * sizeof(cmod::Index16),
+                                                                         sizeof(cmod::Index16),
+                                                                         lod16.data()));
+                }
+                else
+                {
+                    groupData.lodIndices.push_back(heap->allocateIndices(lod.size() * sizeof(cmod::Index32),
+                                                                         sizeof(cmod::Index32),
+                                                                         lod.data()));
                 }
             }
+
+            if (!group->vertexOverride.empty())
+            {
+                groupData.overrideVertices = heap->allocateVertices(group->vertexDescriptionOverride.strideBytes,
+                                                                    group->vertexCountOverride,
+                                                                    group->vertexOverride.data());
+                groupData.overrideIndices = heap->allocateIndices(group->indicesOverride.size() * sizeof(cmod::Index32),
+                                                                  sizeof(cmod::Index32),
+                                                                  group->indicesOverride.data());
+            }
         }
     }
+}
+
+
+std::size_t
+ModelGeometry::getBufferSize() const
+{
+    std::size_t size = 0;
+    for (unsigned int i = 0; i < m_model->getMeshCount(); ++i)
+    {
+        const cmod::Mesh* mesh = m_model->getMesh(i);
+        const cmod::VertexDescription& desc = i < m_glData->meshes.size()
+            ? m_glData->meshes[i].vertexDescription
+            : mesh->getVertexDescription();
+        size += static_cast<std::size_t>(mesh->getVertexCount()) * desc.strideBytes;
+        for (unsigned int j = 0; j < mesh->getGroupCount(); ++j)
+        {
+            const cmod::PrimitiveGroup* group = mesh->getGroup(j);
+            std::size_t indexSize = group->indices16.empty() ? sizeof(cmod::Index32) : sizeof(cmod::Index16);
+            size += group->indices.size() * indexSize;
+            for (const auto& lod : group->lodIndices)
+                size += lod.size() * indexSize;
+        }
+    }
+
+    return size;
+}
+
+
+/*! Render the model; the time parameter is ignored right now
+ *  since this class doesn't currently support animation.
+ */
+void
+ModelGeometry::render(RenderContext& rc, double /* t */)
+{
+    if (!m_vbInitialized)
+        createBuffers();
 
     unsigned int lastMaterial = ~0u;
     unsigned int materialCount = m_model->getMaterialCount();
+    unsigned int lod = m_model->getLOD(rc.getModelPixelScale());
+
+    // Vertex array state is only set up again when the buffer or vertex
+    // format changes. Without base vertex support, the attribute pointers
+    // have to be moved to the first vertex of every mesh instead.
+    bool useBaseVertex = celestia::gl::ARB_draw_elements_base_vertex;
+    const cmod::VWord* currentData = nullptr;
+    const cmod::VertexDescription* currentDescription = nullptr;
+    GLuint currentVboId = 0;
+    GLintptr currentVboOffset = 0;
+    GLuint currentIboId = 0;
 
     // Iterate over all meshes in the model
     for (unsigned int meshIndex = 0; meshIndex < m_model->getMeshCount(); ++meshIndex)
     {
         const cmod::Mesh* mesh = m_model->getMesh(meshIndex);
-
-        const void* currentData = nullptr;
-        GLuint currentVboId = 0;
+        const ModelOpenGLData::MeshData& meshData = m_glData->meshes[meshIndex];
 
         // Iterate over all primitive groups in the mesh
         for (unsigned int groupIndex = 0; groupIndex < mesh->getGroupCount(); ++groupIndex)
         {
             const cmod::PrimitiveGroup* group = mesh->getGroup(groupIndex);
+            const ModelOpenGLData::GroupData& groupData = meshData.groups[groupIndex];
             bool useOverrideValue = !group->vertexOverride.empty() && rc.shouldDrawLineAsTriangles();
 
             const cmod::VWord* data = useOverrideValue ? group->vertexOverride.data() : mesh->getVertexData();
-            const auto& vertexDescription = useOverrideValue ? group->vertexDescriptionOverride : mesh->getVertexDescription();
+            const HeapRange& vertices = useOverrideValue ? groupData.overrideVertices : meshData.vertices;
+            const HeapRange* indices = &groupData.indices;
+            GLsizei indexCount = static_cast<GLsizei>(group->indices.size());
+            if (useOverrideValue)
+            {
+                indices = &groupData.overrideIndices;
+                indexCount = static_cast<GLsizei>(group->indicesOverride.size());
+            }
+            else if (lod > 0 && !group->lodIndices.empty() && groupData.lodIndices[lod - 1].buffer != 0)
+            {
+                indices = &groupData.lodIndices[lod - 1];
+                indexCount = static_cast<GLsizei>(group->lodIndices[lod - 1].size());
+            }
 
-            if (currentData != data)
+            // Fall back to client memory unless both the vertices and the
+            // indices are in the heap.
+            bool useHeap = vertices.buffer != 0 && indices->buffer != 0;
+            GLuint vboId = useHeap ? vertices.buffer : 0;
+
+            // Vertices in client memory are never packed
+            const cmod::VertexDescription* description = &mesh->getVertexDescription();
+            if (useOverrideValue)
+                description = &group->vertexDescriptionOverride;
+            else if (useHeap)
+                description = &meshData.vertexDescription;
+            const cmod::VertexDescription& vertexDescription = *description;
+            GLintptr vboOffset = useHeap && !useBaseVertex ? vertices.offset : 0;
+
+            if (vboId != currentVboId)
+                celestia::gl::bindBuffer(GL_ARRAY_BUFFER, vboId);
+
+            if (vboId != currentVboId || vboOffset != currentVboOffset ||
+                (vboId == 0 && data != currentData) ||
+                currentDescription == nullptr || !(*currentDescription == vertexDescription))
             {
-                GLuint vboId = m_glData->vbos[data];
                 if (vboId != 0)
-                {
-                    // Bind the vertex buffer object.
-                    glBindBuffer(GL_ARRAY_BUFFER, vboId);
-                    rc.setVertexArrays(vertexDescription, nullptr);
-                }
+                    rc.setVertexArrays(vertexDescription, reinterpret_cast<const cmod::VWord*>(vboOffset));
                 else
-                {
-                    if (currentVboId != 0)
-                    {
-                        glBindBuffer(GL_ARRAY_BUFFER, 0);
-                    }
-                    // No vertex buffer object; just use normal vertex arrays
                     rc.setVertexArrays(vertexDescription, data);
-                }
                 currentData = data;
+                currentDescription = &vertexDescription;
                 currentVboId = vboId;
+                currentVboOffset = vboOffset;
+            }
+
+            GLuint iboId = useHeap ? indices->buffer : 0;
+            if (iboId != currentIboId)
+            {
+                celestia::gl::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboId);
+                currentIboId = iboId;
             }
 
             rc.updateShader(vertexDescription, group->prim);
@@ -171,15 +340,28 @@ ModelGeometry::render(RenderContext& rc, double /* t */)
             }
 
             rc.setMaterial(material);
-            rc.drawGroup(*group, useOverrideValue);
-        }
-
-        // If we set a VBO, unbind it.
-        if (currentVboId != 0)
-        {
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            if (useHeap)
+            {
+                IndexBufferRange indexBuffer;
+                indexBuffer.type = useOverrideValue ? GL_UNSIGNED_INT : groupData.indexType;
+                indexBuffer.offset = indices->offset;
+                indexBuffer.count = indexCount;
+                if (useBaseVertex)
+                    indexBuffer.baseVertex = static_cast<GLint>(vertices.offset / vertexDescription.strideBytes);
+                rc.drawGroup(*group, useOverrideValue, &indexBuffer);
+            }
+            else
+            {
+                rc.drawGroup(*group, useOverrideValue);
+            }
         }
     }
+
+    // If we set buffer objects, unbind them.
+    if (currentVboId != 0)
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+    if (currentIboId != 0)
+        celestia::gl::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
 
@@ -197,6 +379,13 @@ ModelGeometry::isNormalized() const
 }
 
 
+bool
+ModelGeometry::supportsInstancing() const
+{
+    return m_supportsInstancing;
+}
+
+
 bool
 ModelGeometry::usesTextureType(cmod::TextureSemantic t) const
 {
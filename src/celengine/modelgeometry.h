@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <memory>
 
 #include <Eigen/Geometry>
@@ -25,7 +26,7 @@ class ModelGeometry : public Geometry
 {
  public:
     ModelGeometry(std::unique_ptr<cmod::Model>&& model);
-    ~ModelGeometry() = default;
+    ~ModelGeometry() override;
 
     /*! Find the closest intersection between the ray and the
      *  model.  If the ray intersects the model, return true
@@ -37,14 +38,29 @@ class ModelGeometry : public Geometry
     //! Render the model in the current OpenGL context
     void render(RenderContext&, double t = 0.0) override;
 
+    //! Upload the model to graphics memory ahead of the first render()
+    void createBuffers();
+
+    //! Bytes of vertex and index data uploaded by createBuffers()
+    std::size_t getBufferSize() const;
+    std::size_t getMemoryUsage() const override { return getBufferSize(); }
+
     bool usesTextureType(cmod::TextureSemantic) const override;
     bool isOpaque() const override;
     bool isNormalized() const override;
+    bool supportsInstancing() const override;
 
     void loadTextures() override;
 
+    //! Upload the normals, tangents and texture coordinates of models in
+    //! compact formats from then on
+    static void setPackVertices(bool pack) { s_packVertices = pack; }
+
  private:
+    static bool s_packVertices;
+
     std::unique_ptr<cmod::Model> m_model;
     bool m_vbInitialized{ false };
+    bool m_supportsInstancing{ true };
     std::unique_ptr<ModelOpenGLData> m_glData;
 };
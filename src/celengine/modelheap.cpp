@@ -0,0 +1,212 @@
+// modelheap.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Shared vertex and index buffers for model geometry.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <iterator>
+#include "modelheap.h"
+#include "glstate.h"
+
+namespace
+{
+
+// Sizes of the buffers models are packed into
+constexpr const GLsizeiptr VertexBlockSize = 4 * 1024 * 1024;
+constexpr const GLsizeiptr IndexBlockSize = 1024 * 1024;
+
+ModelGeometryHeap* modelGeometryHeap = nullptr;
+
+GLintptr alignUp(GLintptr offset, GLsizeiptr alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+} // end unnamed namespace
+
+
+BufferHeap::BufferHeap(GLenum _target, GLsizeiptr _blockSize) :
+    target(_target),
+    blockSize(_blockSize)
+{
+}
+
+
+BufferHeap::~BufferHeap()
+{
+    for (const auto& block : blocks)
+        celestia::gl::deleteBuffers(1, &block->buffer);
+}
+
+
+bool
+BufferHeap::allocateFromBlock(Block& block, GLsizeiptr size, GLsizeiptr alignment, HeapRange& range)
+{
+    for (auto iter = block.freeRanges.begin(); iter != block.freeRanges.end(); ++iter)
+    {
+        GLintptr start = alignUp(iter->first, alignment);
+        GLintptr end = iter->first + iter->second;
+        if (start + size > end)
+            continue;
+
+        GLintptr freeStart = iter->first;
+        block.freeRanges.erase(iter);
+        if (start > freeStart)
+            block.freeRanges.emplace(freeStart, start - freeStart);
+        if (start + size < end)
+            block.freeRanges.emplace(start + size, end - start - size);
+
+        block.used += size;
+        range.buffer = block.buffer;
+        range.offset = start;
+        range.size = size;
+        return true;
+    }
+
+    return false;
+}
+
+
+HeapRange
+BufferHeap::allocate(GLsizeiptr size, GLsizeiptr alignment, const void* data)
+{
+    HeapRange range;
+    if (size <= 0)
+        return range;
+
+    bool found = false;
+    for (const auto& block : blocks)
+    {
+        if (allocateFromBlock(*block, size, alignment, range))
+        {
+            found = true;
+            break;
+        }
+    }
+
+    if (!found)
+    {
+        auto block = std::make_unique<Block>();
+        GLsizeiptr newBlockSize = std::max(size, blockSize);
+        glGenBuffers(1, &block->buffer);
+        if (block->buffer == 0)
+            return range;
+
+        celestia::gl::bindBuffer(target, block->buffer);
+        celestia::gl::bufferData(target, newBlockSize, nullptr, GL_STATIC_DRAW);
+        celestia::gl::bindBuffer(target, 0);
+        if (glGetError() == GL_OUT_OF_MEMORY)
+        {
+            celestia::gl::deleteBuffers(1, &block->buffer);
+            return range;
+        }
+
+        block->freeRanges.emplace(0, newBlockSize);
+        allocateFromBlock(*block, size, alignment, range);
+        blocks.push_back(std::move(block));
+    }
+
+    celestia::gl::bindBuffer(target, range.buffer);
+    celestia::gl::bufferSubData(target, range.offset, size, data);
+    celestia::gl::bindBuffer(target, 0);
+
+    return range;
+}
+
+
+void
+BufferHeap::free(const HeapRange& range)
+{
+    if (range.buffer == 0)
+        return;
+
+    auto blockIter = std::find_if(blocks.begin(), blocks.end(),
+                                  [&range](const auto& block) { return block->buffer == range.buffer; });
+    if (blockIter == blocks.end())
+        return;
+
+    Block& block = **blockIter;
+    block.used -= range.size;
+    if (block.used == 0)
+    {
+        celestia::gl::deleteBuffers(1, &block.buffer);
+        blocks.erase(blockIter);
+        return;
+    }
+
+    // Merge the range with the free ranges on either side
+    GLintptr start = range.offset;
+    GLintptr end = range.offset + range.size;
+    auto next = block.freeRanges.lower_bound(start);
+    if (next != block.freeRanges.begin())
+    {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == start)
+        {
+            start = prev->first;
+            block.freeRanges.erase(prev);
+        }
+    }
+    if (next != block.freeRanges.end() && next->first == end)
+    {
+        end += next->second;
+        block.freeRanges.erase(next);
+    }
+
+    block.freeRanges.emplace(start, end - start);
+}
+
+
+ModelGeometryHeap::ModelGeometryHeap() :
+    indexHeap(GL_ELEMENT_ARRAY_BUFFER, IndexBlockSize)
+{
+}
+
+
+HeapRange
+ModelGeometryHeap::allocateVertices(unsigned int stride, unsigned int count, const void* data)
+{
+    if (stride == 0)
+        return HeapRange();
+
+    // Round the block size down to a whole number of vertices
+    auto iter = vertexHeaps.try_emplace(stride, GL_ARRAY_BUFFER, VertexBlockSize / stride * stride).first;
+    return iter->second.allocate(static_cast<GLsizeiptr>(stride) * count, stride, data);
+}
+
+
+void
+ModelGeometryHeap::freeVertices(unsigned int stride, const HeapRange& range)
+{
+    auto iter = vertexHeaps.find(stride);
+    if (iter != vertexHeaps.end())
+        iter->second.free(range);
+}
+
+
+HeapRange
+ModelGeometryHeap::allocateIndices(GLsizeiptr size, GLsizeiptr indexSize, const void* data)
+{
+    return indexHeap.allocate(size, indexSize, data);
+}
+
+
+void
+ModelGeometryHeap::freeIndices(const HeapRange& range)
+{
+    indexHeap.free(range);
+}
+
+
+ModelGeometryHeap* GetModelGeometryHeap()
+{
+    if (modelGeometryHeap == nullptr)
+        modelGeometryHeap = new ModelGeometryHeap();
+    return modelGeometryHeap;
+}
@@ -0,0 +1,83 @@
+// modelheap.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Shared vertex and index buffers for model geometry.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <vector>
+#include "glsupport.h"
+
+// A sub-allocation of a buffer object; buffer is 0 if the allocation failed.
+struct HeapRange
+{
+    GLuint buffer{ 0 };
+    GLintptr offset{ 0 };
+    GLsizeiptr size{ 0 };
+};
+
+// A set of large buffer objects bound to the same target which are carved
+// up into ranges. Requests larger than the block size get a block of their
+// own. Blocks are released as soon as they are empty.
+class BufferHeap
+{
+ public:
+    BufferHeap(GLenum target, GLsizeiptr blockSize);
+    ~BufferHeap();
+    BufferHeap(const BufferHeap&) = delete;
+    BufferHeap& operator=(const BufferHeap&) = delete;
+
+    // Copy size bytes of data to a range whose offset is a multiple of
+    // alignment. The buffer binding of the target is reset to 0.
+    HeapRange allocate(GLsizeiptr size, GLsizeiptr alignment, const void* data);
+    void free(const HeapRange&);
+
+ private:
+    struct Block
+    {
+        GLuint buffer{ 0 };
+        GLsizeiptr used{ 0 };
+        // Free ranges, offset -> size
+        std::map<GLintptr, GLsizeiptr> freeRanges;
+    };
+
+    bool allocateFromBlock(Block&, GLsizeiptr size, GLsizeiptr alignment, HeapRange&);
+
+    GLenum target;
+    GLsizeiptr blockSize;
+    std::vector<std::unique_ptr<Block>> blocks;
+};
+
+/*! Vertex and index data of all loaded models. Vertices are kept in
+ *  separate heaps for each vertex stride, with every mesh starting on a
+ *  multiple of the stride, so that consecutive meshes can be drawn from the
+ *  same attribute pointers by passing the first vertex of the mesh as the
+ *  base vertex of the draw call.
+ */
+class ModelGeometryHeap
+{
+ public:
+    ModelGeometryHeap();
+    ModelGeometryHeap(const ModelGeometryHeap&) = delete;
+    ModelGeometryHeap& operator=(const ModelGeometryHeap&) = delete;
+
+    HeapRange allocateVertices(unsigned int stride, unsigned int count, const void* data);
+    void freeVertices(unsigned int stride, const HeapRange&);
+
+    HeapRange allocateIndices(GLsizeiptr size, GLsizeiptr indexSize, const void* data);
+    void freeIndices(const HeapRange&);
+
+ private:
+    std::map<unsigned int, BufferHeap> vertexHeaps;
+    BufferHeap indexHeap;
+};
+
+ModelGeometryHeap* GetModelGeometryHeap();
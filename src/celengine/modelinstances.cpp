@@ -0,0 +1,203 @@
+// modelinstances.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Instanced drawing of bodies which share a model.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include "geometry.h"
+#include "meshmanager.h"
+#include "modelinstances.h"
+#include "rendcontext.h"
+#include "render.h"
+#include "glstate.h"
+
+namespace
+{
+// Largest angle between the directions of a light at two bodies of the
+// same batch, about one degree
+constexpr float MinLightDirectionCos = 0.99985f;
+// Largest relative difference in the brightness of a light at two bodies
+// of the same batch
+constexpr float MaxIrradianceDifference = 0.02f;
+
+constexpr GLuint InstanceAttributes[] =
+{
+    CelestiaGLProgram::InstanceRow0AttributeIndex,
+    CelestiaGLProgram::InstanceRow1AttributeIndex,
+    CelestiaGLProgram::InstanceRow2AttributeIndex,
+};
+}
+
+ModelInstances::~ModelInstances()
+{
+    if (instanceBuffer != 0)
+        celestia::gl::deleteBuffers(1, &instanceBuffer);
+}
+
+bool ModelInstances::isSupported()
+{
+    return celestia::gl::ARB_instanced_arrays;
+}
+
+void ModelInstances::clear()
+{
+    batches.clear();
+}
+
+bool ModelInstances::isCompatible(const Batch& batch,
+                                  const LightingState& ls,
+                                  float lunarLambert)
+{
+    if (batch.lunarLambert != lunarLambert || batch.lighting.nLights != ls.nLights)
+        return false;
+
+    for (unsigned int i = 0; i < ls.nLights; i++)
+    {
+        const DirectionalLight& light = ls.lights[i];
+        const DirectionalLight& batchLight = batch.lighting.lights[i];
+        if (light.color != batchLight.color ||
+            light.direction_eye.dot(batchLight.direction_eye) < MinLightDirectionCos ||
+            std::abs(light.irradiance - batchLight.irradiance) > MaxIrradianceDifference * batchLight.irradiance)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void ModelInstances::add(ResourceHandle geometry,
+                         const Eigen::Affine3f& transform,
+                         const LightingState& ls,
+                         float lunarLambert,
+                         float pixelScale)
+{
+    std::vector<Batch>& geometryBatches = batches[geometry];
+    Batch* batch = nullptr;
+    for (Batch& b : geometryBatches)
+    {
+        if (isCompatible(b, ls, lunarLambert))
+        {
+            batch = &b;
+            break;
+        }
+    }
+
+    if (batch == nullptr)
+    {
+        batch = &geometryBatches.emplace_back();
+        batch->lunarLambert = lunarLambert;
+        batch->pixelScale = pixelScale;
+
+        // The shaders take the light directions and the eye position in
+        // the frame the vertices are transformed to, which is the
+        // camera-centered universal frame.
+        LightingState& lighting = batch->lighting;
+        lighting.nLights = ls.nLights;
+        for (unsigned int i = 0; i < ls.nLights; i++)
+        {
+            lighting.lights[i] = ls.lights[i];
+            lighting.lights[i].direction_obj = ls.lights[i].direction_eye;
+        }
+        for (auto& shadows : lighting.shadows)
+            shadows = nullptr;
+        lighting.eyePos_obj = Eigen::Vector3f::Zero();
+        lighting.eyeDir_obj = -transform.translation().normalized();
+        lighting.ambientColor = ls.ambientColor;
+    }
+    else
+    {
+        // Every body of the batch is drawn with the level of detail
+        // needed by the one nearest to the camera.
+        batch->pixelScale = std::max(batch->pixelScale, pixelScale);
+    }
+
+    Instance& instance = batch->instances.emplace_back();
+    for (int row = 0; row < 3; row++)
+    {
+        for (int col = 0; col < 4; col++)
+            instance.rows[row][col] = transform.matrix()(row, col);
+    }
+}
+
+void ModelInstances::draw(Renderer* renderer, const Matrices& m, double tsec)
+{
+    if (batches.empty())
+        return;
+
+    uploadData.clear();
+    for (const auto& [handle, geometryBatches] : batches)
+    {
+        for (const Batch& batch : geometryBatches)
+            uploadData.insert(uploadData.end(), batch.instances.begin(), batch.instances.end());
+    }
+
+    if (instanceBuffer == 0)
+        glGenBuffers(1, &instanceBuffer);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    // Orphan the buffer of the previous draw before filling it
+    celestia::gl::bufferData(GL_ARRAY_BUFFER, uploadData.size() * sizeof(Instance), nullptr, GL_STREAM_DRAW);
+    celestia::gl::bufferSubData(GL_ARRAY_BUFFER, 0, uploadData.size() * sizeof(Instance), uploadData.data());
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+
+    for (GLuint index : InstanceAttributes)
+    {
+        glEnableVertexAttribArray(index);
+        glVertexAttribDivisor(index, 1);
+    }
+
+    std::size_t firstInstance = 0;
+    for (const auto& [handle, geometryBatches] : batches)
+    {
+        Geometry* geometry = GetGeometryManager()->find(handle);
+        for (const Batch& batch : geometryBatches)
+        {
+            std::size_t offset = firstInstance * sizeof(Instance);
+            firstInstance += batch.instances.size();
+            if (geometry == nullptr)
+                continue;
+
+            // The attribute pointers keep the instance buffer while the
+            // model binds its own vertex buffer.
+            celestia::gl::bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+            for (int row = 0; row < 3; row++)
+            {
+                glVertexAttribPointer(InstanceAttributes[row],
+                                      4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                                      reinterpret_cast<const void*>(offset + offsetof(Instance, rows) + row * 4 * sizeof(float)));
+            }
+            celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+
+            GLSL_RenderContext rc(renderer, batch.lighting, 1.0f,
+                                  Eigen::Quaternionf::Identity(),
+                                  m.modelview, m.projection);
+            rc.setInstanceCount(static_cast<GLsizei>(batch.instances.size()));
+            rc.setModelPixelScale(batch.pixelScale);
+            rc.setLunarLambert(batch.lunarLambert);
+
+            Renderer::PipelineState ps;
+            ps.depthMask = true;
+            ps.depthTest = true;
+            renderer->setPipelineState(ps);
+
+            geometry->render(rc, tsec);
+        }
+    }
+
+    // Other vertex arrays expect every attribute to advance per vertex
+    for (GLuint index : InstanceAttributes)
+    {
+        glVertexAttribDivisor(index, 0);
+        glDisableVertexAttribArray(index);
+    }
+
+    clear();
+}
@@ -0,0 +1,80 @@
+// modelinstances.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Instanced drawing of bodies which share a model.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <map>
+#include <vector>
+#include <Eigen/Geometry>
+#include <celutil/reshandle.h>
+#include "glsupport.h"
+#include "lightenv.h"
+
+class Renderer;
+struct Matrices;
+
+// ModelInstances collects bodies that are drawn with the same model, such
+// as the satellites of a constellation or the members of an asteroid swarm,
+// and draws all of them with one draw call per primitive group of the
+// model. The transform of each body is an instanced vertex attribute, and
+// the lighting is done in the camera-centered universal frame rather than
+// in the frame of each body.
+//
+// Bodies are only batched when they are lit by the same light sources
+// from nearly the same directions; the lighting of the first body of a
+// batch is used for all of them.
+class ModelInstances
+{
+ public:
+    ModelInstances() = default;
+    ~ModelInstances();
+    ModelInstances(const ModelInstances&) = delete;
+    ModelInstances& operator=(const ModelInstances&) = delete;
+
+    // Return true if the OpenGL implementation supports instanced drawing
+    static bool isSupported();
+
+    void clear();
+    bool empty() const { return batches.empty(); }
+
+    // Add a body drawn with geometry, where transform maps model
+    // coordinates to the camera-centered universal frame. pixelScale is the
+    // size in pixels of one unit of model coordinates.
+    void add(ResourceHandle geometry,
+             const Eigen::Affine3f& transform,
+             const LightingState& ls,
+             float lunarLambert,
+             float pixelScale);
+
+    // Draw the bodies added since the last call and clear them
+    void draw(Renderer* renderer, const Matrices& m, double tsec);
+
+ private:
+    struct Instance
+    {
+        // First three rows of the model transform
+        float rows[3][4];
+    };
+
+    struct Batch
+    {
+        LightingState lighting;
+        float lunarLambert;
+        float pixelScale;
+        std::vector<Instance> instances;
+    };
+
+    static bool isCompatible(const Batch&, const LightingState&, float lunarLambert);
+
+    GLuint instanceBuffer{ 0 };
+    std::map<ResourceHandle, std::vector<Batch>> batches;
+    std::vector<Instance> uploadData;
+};
@@ -7,6 +7,7 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <iterator>
 #include "multitexture.h"
 #include "texmanager.h"
 
@@ -42,10 +43,13 @@ void MultiResTexture::setTexture(const string& source,
                                  const fs::path& path,
                                  unsigned int flags)
 {
-    TextureManager* texMan = GetTextureManager();
-    tex[lores] = texMan->getHandle(TextureInfo(source, path, flags, lores));
-    tex[medres] = texMan->getHandle(TextureInfo(source, path, flags, medres));
-    tex[hires] = texMan->getHandle(TextureInfo(source, path, flags, hires));
+    const TextureInfo infos[] =
+    {
+        TextureInfo(source, path, flags, lores),
+        TextureInfo(source, path, flags, medres),
+        TextureInfo(source, path, flags, hires),
+    };
+    GetTextureManager()->getHandles(std::begin(infos), std::end(infos), tex);
 }
 
 
@@ -54,10 +58,13 @@ void MultiResTexture::setTexture(const string& source,
                                  float bumpHeight,
                                  unsigned int flags)
 {
-    TextureManager* texMan = GetTextureManager();
-    tex[lores] = texMan->getHandle(TextureInfo(source, path, bumpHeight, flags, lores));
-    tex[medres] = texMan->getHandle(TextureInfo(source, path, bumpHeight, flags, medres));
-    tex[hires] = texMan->getHandle(TextureInfo(source, path, bumpHeight, flags, hires));
+    const TextureInfo infos[] =
+    {
+        TextureInfo(source, path, bumpHeight, flags, lores),
+        TextureInfo(source, path, bumpHeight, flags, medres),
+        TextureInfo(source, path, bumpHeight, flags, hires),
+    };
+    GetTextureManager()->getHandles(std::begin(infos), std::end(infos), tex);
 }
 
 
@@ -90,14 +97,19 @@ Texture* MultiResTexture::find(unsigned int resolution)
         break;
     }
 
-    tex[resolution] = tex[secondChoice];
-    res = texMan->find(tex[resolution]);
+    // A texture that is still being loaded is drawn with one of the other
+    // resolutions in the meantime; only a failed one is replaced for good.
+    bool loading = texMan->isLoading(tex[resolution]);
+    if (!loading)
+        tex[resolution] = tex[secondChoice];
+    res = texMan->find(tex[secondChoice]);
     if (res != nullptr)
         return res;
 
-    tex[resolution] = tex[lastResort];
+    if (!loading && !texMan->isLoading(tex[secondChoice]))
+        tex[resolution] = tex[lastResort];
 
-    return texMan->find(tex[resolution]);
+    return texMan->find(tex[lastResort]);
 }
 
 
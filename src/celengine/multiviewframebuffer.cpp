@@ -0,0 +1,119 @@
+// multiviewframebuffer.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Framebuffer of layered color and depth textures, rendered with
+// OVR_multiview.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "multiviewframebuffer.h"
+#include "glstate.h"
+
+namespace
+{
+
+GLuint
+createTextureArray(GLenum internalFormat, GLenum format, GLenum type, GLsizei width, GLsizei height, GLsizei layers)
+{
+    GLuint texId = 0;
+    glGenTextures(1, &texId);
+    celestia::gl::bindTexture(GL_TEXTURE_2D_ARRAY, texId);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, internalFormat, width, height, layers, 0, format, type, nullptr);
+    celestia::gl::bindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    return texId;
+}
+
+} // end unnamed namespace
+
+MultiviewFramebuffer::MultiviewFramebuffer(GLsizei width, GLsizei height, GLsizei views) :
+    m_width(width),
+    m_height(height),
+    m_views(views)
+{
+#ifndef GL_ES
+    if (!celestia::gl::OVR_multiview)
+        return;
+
+    GLint oldFboId;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFboId);
+
+    m_colorTexId = createTextureArray(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height, views);
+    m_depthTexId = createTextureArray(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, width, height, views);
+
+    glGenFramebuffers(1, &m_fboId);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fboId);
+    glFramebufferTextureMultiviewOVR(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_colorTexId, 0, 0, views);
+    glFramebufferTextureMultiviewOVR(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthTexId, 0, 0, views);
+    m_status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+    glGenFramebuffers(1, &m_readFboId);
+    glBindFramebuffer(GL_FRAMEBUFFER, oldFboId);
+
+    if (m_status != GL_FRAMEBUFFER_COMPLETE)
+        cleanup();
+#endif
+}
+
+MultiviewFramebuffer::~MultiviewFramebuffer()
+{
+    cleanup();
+}
+
+bool
+MultiviewFramebuffer::bind()
+{
+    if (!isValid())
+        return false;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fboId);
+    return true;
+}
+
+void
+MultiviewFramebuffer::copyView(GLsizei view, GLuint fboId, GLint x, GLint y)
+{
+#ifndef GL_ES
+    if (!isValid() || view >= m_views)
+        return;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_readFboId);
+    glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_colorTexId, 0, view);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fboId);
+    glBlitFramebuffer(0, 0, m_width, m_height,
+                      x, y, x + m_width, y + m_height,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, fboId);
+#else
+    (void) view;
+    (void) fboId;
+    (void) x;
+    (void) y;
+#endif
+}
+
+void
+MultiviewFramebuffer::cleanup()
+{
+    if (m_readFboId != 0)
+        glDeleteFramebuffers(1, &m_readFboId);
+    if (m_fboId != 0)
+        glDeleteFramebuffers(1, &m_fboId);
+    if (m_colorTexId != 0)
+        celestia::gl::deleteTextures(1, &m_colorTexId);
+    if (m_depthTexId != 0)
+        celestia::gl::deleteTextures(1, &m_depthTexId);
+
+    m_readFboId = 0;
+    m_fboId = 0;
+    m_colorTexId = 0;
+    m_depthTexId = 0;
+}
@@ -0,0 +1,50 @@
+// multiviewframebuffer.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Framebuffer of layered color and depth textures, rendered with
+// OVR_multiview.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include "glsupport.h"
+
+// MultiviewFramebuffer holds a layer for each view drawn by the programs
+// of ShaderManager in multiview mode. The layers are copied into the
+// regions of the views in another framebuffer when done.
+class MultiviewFramebuffer
+{
+ public:
+    MultiviewFramebuffer(GLsizei width, GLsizei height, GLsizei views);
+    ~MultiviewFramebuffer();
+    MultiviewFramebuffer(const MultiviewFramebuffer&) = delete;
+    MultiviewFramebuffer& operator=(const MultiviewFramebuffer&) = delete;
+
+    bool isValid() const { return m_status == GL_FRAMEBUFFER_COMPLETE; }
+    GLsizei width() const { return m_width; }
+    GLsizei height() const { return m_height; }
+    GLsizei views() const { return m_views; }
+
+    bool bind();
+    // Copy the layer of view into the rectangle of the same size at x, y
+    // of framebuffer fboId, which is left bound.
+    void copyView(GLsizei view, GLuint fboId, GLint x, GLint y);
+
+ private:
+    void cleanup();
+
+    GLsizei m_width;
+    GLsizei m_height;
+    GLsizei m_views;
+    GLuint m_colorTexId{ 0 };
+    GLuint m_depthTexId{ 0 };
+    GLuint m_fboId{ 0 };
+    // Framebuffer reading from a single layer of the color texture
+    GLuint m_readFboId{ 0 };
+    GLenum m_status{ GL_FRAMEBUFFER_UNSUPPORTED };
+};
@@ -1,8 +1,341 @@
+#include <algorithm>
+#include <clocale>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+#include <unordered_map>
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
+#include <celutil/cachekey.h>
 #include <celutil/logger.h>
 #include <celutil/gettext.h>
 #include <celutil/greek.h>
+#include <celutil/mmapfile.h>
 #include "name.h"
 
+namespace celutil = celestia::util;
+using celestia::util::GetLogger;
+
+namespace
+{
+constexpr const char NAME_CACHE_HEADER[] = "CELNAMES";
+constexpr const std::uint16_t NAME_CACHE_VERSION = 0x0100;
+// version, key, string pool size
+constexpr const std::size_t NAME_CACHE_HEADER_SIZE = 14;
+
+
+char upper(char c)
+{
+    return static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+}
+
+
+// Hash consistent with compareIgnoringCase()
+std::size_t hashIgnoringCase(std::string_view name)
+{
+    std::uint64_t hash = UINT64_C(14695981039346656037);
+    for (char c : name)
+    {
+        hash ^= static_cast<unsigned char>(upper(c));
+        hash *= UINT64_C(1099511628211);
+    }
+    return static_cast<std::size_t>(hash);
+}
+
+
+bool equalIgnoringCase(std::string_view s1, std::string_view s2)
+{
+    return s1.size() == s2.size()
+        && std::equal(s1.begin(), s1.end(), s2.begin(),
+                      [](char c1, char c2) { return upper(c1) == upper(c2); });
+}
+
+
+// Translations and the case mapping of the hash depend on the locale, so
+// they are part of the key
+std::uint64_t nameCacheKey(std::uint64_t sourcesKey)
+{
+    celutil::CacheKey key;
+    key.add(sourcesKey);
+    const char* locale = std::setlocale(LC_ALL, nullptr);
+    key.add(std::string_view(locale == nullptr ? "" : locale));
+    // The translation of the empty string is the header of the message
+    // catalog, which changes with each of its revisions
+    key.add(std::string_view(D_("")));
+    return key.value();
+}
+
+
+} // end unnamed namespace
+
+
+// Names are written once to a string pool and referred to by offset and
+// length, so the names shared by the indexes are only stored once
+class NameDatabase::CacheWriter
+{
+ public:
+    void writeNumber(std::uint32_t value)
+    {
+        celutil::writeLE<std::uint32_t>(records, value);
+    }
+
+    void writeString(std::string_view str)
+    {
+        auto [iter, inserted] = offsets.try_emplace(str, static_cast<std::uint32_t>(pool.size()));
+        if (inserted)
+            pool.append(str);
+        writeNumber(iter->second);
+        writeNumber(static_cast<std::uint32_t>(str.size()));
+    }
+
+    const std::string& getPool() const { return pool; }
+    std::string getRecords() const { return records.str(); }
+
+ private:
+    std::string pool;
+    std::unordered_map<std::string_view, std::uint32_t> offsets;
+    std::ostringstream records;
+};
+
+
+class NameDatabase::CacheReader
+{
+ public:
+    CacheReader(std::string_view _pool, const char* _data, std::size_t _size) :
+        pool(_pool), data(_data), size(_size)
+    {
+    }
+
+    bool readNumber(std::uint32_t& value)
+    {
+        if (size - pos < sizeof(std::uint32_t))
+            return false;
+        value = celutil::fromMemoryLE<std::uint32_t>(data + pos);
+        pos += sizeof(std::uint32_t);
+        return true;
+    }
+
+    bool readString(std::string_view& str)
+    {
+        std::uint32_t offset;
+        std::uint32_t length;
+        if (!readNumber(offset) || !readNumber(length)
+            || offset > pool.size() || length > pool.size() - offset)
+        {
+            return false;
+        }
+        str = pool.substr(offset, length);
+        return true;
+    }
+
+    // Whether count records of recordSize bytes are left, checked before
+    // reserving room for them
+    bool canRead(std::uint32_t count, std::size_t recordSize) const
+    {
+        return (size - pos) / recordSize >= count;
+    }
+
+    bool atEnd() const { return pos == size; }
+
+ private:
+    std::string_view pool;
+    const char* data;
+    std::size_t size;
+    std::size_t pos{ 0 };
+};
+
+
+void NameDatabase::NameIndex::set(const std::string& name, AstroCatalog::IndexNumber catalogNumber)
+{
+    if (slots.empty())
+        rehash(64);
+
+    std::size_t slot = findSlot(name);
+    if (slots[slot] != 0)
+    {
+        // The first spelling of a name is kept, as with a map
+        entries[slots[slot] - 1].catalogNumber = catalogNumber;
+        return;
+    }
+
+    entries.push_back({ name, catalogNumber });
+    slots[slot] = static_cast<std::uint32_t>(entries.size());
+    if (entries.size() * 2 > slots.size())
+        rehash(slots.size() * 2);
+
+    std::lock_guard<std::mutex> lock(completionMutex);
+    completionKeys.clear();
+}
+
+
+AstroCatalog::IndexNumber NameDatabase::NameIndex::find(std::string_view name) const
+{
+    if (slots.empty())
+        return AstroCatalog::InvalidIndex;
+
+    std::uint32_t index = slots[findSlot(name)];
+    return index == 0 ? AstroCatalog::InvalidIndex : entries[index - 1].catalogNumber;
+}
+
+
+void NameDatabase::NameIndex::getCompletion(std::vector<std::string>& completion, std::string_view folded) const
+{
+    std::lock_guard<std::mutex> lock(completionMutex);
+    updateCompletionKeys();
+
+    auto iter = std::lower_bound(completionKeys.begin(), completionKeys.end(), folded,
+                                 [](const auto& key, std::string_view prefix) { return key.first < prefix; });
+    for (; iter != completionKeys.end() && iter->first.compare(0, folded.size(), folded) == 0; ++iter)
+        completion.push_back(entries[iter->second].name);
+}
+
+
+void NameDatabase::NameIndex::updateCompletionKeys() const
+{
+    if (completionKeys.size() == entries.size())
+        return;
+
+    completionKeys.clear();
+    completionKeys.reserve(entries.size());
+    std::string key;
+    for (std::size_t i = 0; i < entries.size(); i++)
+    {
+        // Names that aren't valid UTF-8 can only be completed up to
+        // the invalid sequence
+        UTF8FoldCase(entries[i].name, key);
+        completionKeys.emplace_back(key, static_cast<std::uint32_t>(i));
+    }
+    std::sort(completionKeys.begin(), completionKeys.end());
+}
+
+
+// Linear probing; the table is kept at most half full
+std::size_t NameDatabase::NameIndex::findSlot(std::string_view name) const
+{
+    std::size_t mask = slots.size() - 1;
+    std::size_t slot = hashIgnoringCase(name) & mask;
+    while (slots[slot] != 0 && !equalIgnoringCase(entries[slots[slot] - 1].name, name))
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+
+void NameDatabase::NameIndex::rehash(std::size_t nSlots)
+{
+    slots.assign(nSlots, 0);
+    std::size_t mask = nSlots - 1;
+    for (std::size_t i = 0; i < entries.size(); i++)
+    {
+        std::size_t slot = hashIgnoringCase(entries[i].name) & mask;
+        while (slots[slot] != 0)
+            slot = (slot + 1) & mask;
+        slots[slot] = static_cast<std::uint32_t>(i + 1);
+    }
+}
+
+
+std::size_t NameDatabase::NameIndex::memoryUsage() const
+{
+    std::size_t bytes = celestia::util::VectorMemory(entries) + celestia::util::VectorMemory(slots);
+    for (const Entry& entry : entries)
+        bytes += celestia::util::StringMemory(entry.name);
+
+    std::lock_guard<std::mutex> lock(completionMutex);
+    bytes += celestia::util::VectorMemory(completionKeys);
+    for (const auto& key : completionKeys)
+        bytes += celestia::util::StringMemory(key.first);
+    return bytes;
+}
+
+
+void NameDatabase::NameIndex::clear()
+{
+    entries.clear();
+    slots.clear();
+
+    std::lock_guard<std::mutex> lock(completionMutex);
+    completionKeys.clear();
+}
+
+
+void NameDatabase::NameIndex::write(CacheWriter& writer) const
+{
+    std::lock_guard<std::mutex> lock(completionMutex);
+    updateCompletionKeys();
+
+    writer.writeNumber(static_cast<std::uint32_t>(entries.size()));
+    writer.writeNumber(static_cast<std::uint32_t>(slots.size()));
+    writer.writeNumber(static_cast<std::uint32_t>(completionKeys.size()));
+    for (const Entry& entry : entries)
+    {
+        writer.writeString(entry.name);
+        writer.writeNumber(entry.catalogNumber);
+    }
+    for (std::uint32_t slot : slots)
+        writer.writeNumber(slot);
+    for (const auto& key : completionKeys)
+    {
+        writer.writeString(key.first);
+        writer.writeNumber(key.second);
+    }
+}
+
+
+bool NameDatabase::NameIndex::read(CacheReader& reader)
+{
+    std::uint32_t nEntries;
+    std::uint32_t nSlots;
+    std::uint32_t nKeys;
+    if (!reader.readNumber(nEntries) || !reader.readNumber(nSlots) || !reader.readNumber(nKeys))
+        return false;
+
+    // The slot count is a power of two, with at least one free slot to
+    // end the probing
+    if ((nSlots & (nSlots - 1)) != 0
+        || (nEntries > 0 && nSlots <= nEntries)
+        || (nKeys != 0 && nKeys != nEntries)
+        || !reader.canRead(nEntries, 12))
+    {
+        return false;
+    }
+
+    entries.reserve(nEntries);
+    for (std::uint32_t i = 0; i < nEntries; i++)
+    {
+        std::string_view name;
+        std::uint32_t catalogNumber;
+        if (!reader.readString(name) || !reader.readNumber(catalogNumber))
+            return false;
+        entries.push_back({ std::string(name), catalogNumber });
+    }
+
+    if (!reader.canRead(nSlots, 4))
+        return false;
+    slots.resize(nSlots);
+    for (std::uint32_t& slot : slots)
+    {
+        if (!reader.readNumber(slot) || slot > nEntries)
+            return false;
+    }
+
+    if (!reader.canRead(nKeys, 12))
+        return false;
+    std::lock_guard<std::mutex> lock(completionMutex);
+    completionKeys.reserve(nKeys);
+    for (std::uint32_t i = 0; i < nKeys; i++)
+    {
+        std::string_view key;
+        std::uint32_t entry;
+        if (!reader.readString(key) || !reader.readNumber(entry) || entry >= nEntries)
+            return false;
+        completionKeys.emplace_back(std::string(key), entry);
+    }
+
+    return true;
+}
+
+
 uint32_t NameDatabase::getNameCount() const
 {
     return nameIndex.size();
@@ -21,10 +354,10 @@ void NameDatabase::add(const AstroCatalog::IndexNumber catalogNumber, const std:
         //nameIndex.insert(NameIndex::value_type(name, catalogNumber));
         std::string fname = ReplaceGreekLetterAbbr(name);
 
-        nameIndex[fname] = catalogNumber;
+        nameIndex.set(fname, catalogNumber);
         std::string lname = D_(fname.c_str());
         if (lname != fname)
-            localizedNameIndex[lname] = catalogNumber;
+            localizedNameIndex.set(lname, catalogNumber);
         numberIndex.insert(NumberIndex::value_type(catalogNumber, fname));
     }
 }
@@ -35,15 +368,15 @@ void NameDatabase::erase(const AstroCatalog::IndexNumber catalogNumber)
 
 AstroCatalog::IndexNumber NameDatabase::getCatalogNumberByName(const std::string& name, bool i18n) const
 {
-    auto iter = nameIndex.find(name);
-    if (iter != nameIndex.end())
-        return iter->second;
+    AstroCatalog::IndexNumber catalogNumber = nameIndex.find(name);
+    if (catalogNumber != AstroCatalog::InvalidIndex)
+        return catalogNumber;
 
     if (i18n)
     {
-        iter = localizedNameIndex.find(name);
-        if (iter != localizedNameIndex.end())
-            return iter->second;
+        catalogNumber = localizedNameIndex.find(name);
+        if (catalogNumber != AstroCatalog::InvalidIndex)
+            return catalogNumber;
     }
 
     auto replacedGreek = ReplaceGreekLetterAbbr(name);
@@ -75,6 +408,17 @@ std::string NameDatabase::getNameByCatalogNumber(const AstroCatalog::IndexNumber
 }
 
 
+std::string_view NameDatabase::getPrimaryName(const AstroCatalog::IndexNumber catalogNumber, bool i18n) const
+{
+    NumberIndex::const_iterator iter = getFirstNameIter(catalogNumber);
+    if (iter == numberIndex.end())
+        return {};
+
+    // The message catalog returns its argument when there's no translation
+    return i18n ? std::string_view(D_(iter->second.c_str())) : std::string_view(iter->second);
+}
+
+
 // Return the first name matching the catalog number or end()
 // if there are no matching names.  The first name *should* be the
 // proper name of the OBJ, if one exists. This requires the
@@ -100,23 +444,145 @@ NameDatabase::NumberIndex::const_iterator NameDatabase::getFinalNameIter() const
 
 std::vector<std::string> NameDatabase::getCompletion(const std::string& name, bool i18n) const
 {
-    std::string name2 = ReplaceGreekLetter(name);
-
     std::vector<std::string> completion;
-    const int name_length = UTF8Length(name2);
+    std::string folded;
+    if (!UTF8FoldCase(ReplaceGreekLetter(name), folded))
+        return completion;
+
+    nameIndex.getCompletion(completion, folded);
+    if (i18n)
+        localizedNameIndex.getCompletion(completion, folded);
+    return completion;
+}
+
+
+void NameDatabase::accountMemory(celestia::util::MemoryUsage& parent) const
+{
+    using namespace celestia::util;
+
+    auto& usage = parent.add("names", 0, nameIndex.size());
+    usage.add("name index", nameIndex.memoryUsage(), nameIndex.size());
+    usage.add("localized name index", localizedNameIndex.memoryUsage(), localizedNameIndex.size());
+
+    std::size_t numberBytes = numberIndex.size() * NodeMemory<NumberIndex::value_type>();
+    for (const auto& entry : numberIndex)
+        numberBytes += StringMemory(entry.second);
+    usage.add("number index", numberBytes, numberIndex.size());
+}
 
-    for (const auto &[n, _] : nameIndex)
+
+bool NameDatabase::loadCache(const fs::path& path, std::uint64_t sourcesKey)
+{
+    celutil::MemoryMappedFile file;
+    if (!file.open(path, celutil::MemoryMappedFile::AccessHint::Sequential))
+        return false;
+
+    const char* ptr = file.data();
+    std::size_t headerLength = std::strlen(NAME_CACHE_HEADER);
+    if (file.size() < headerLength + NAME_CACHE_HEADER_SIZE
+        || std::strncmp(ptr, NAME_CACHE_HEADER, headerLength) != 0)
     {
-        if (!UTF8StringCompare(n, name2, name_length, true))
-            completion.push_back(n);
+        GetLogger()->warn(_("Bad header for name cache {}\n"), path);
+        return false;
     }
-    if (i18n)
+    ptr += headerLength;
+
+    if (celutil::fromMemoryLE<std::uint16_t>(ptr) != NAME_CACHE_VERSION
+        || celutil::fromMemoryLE<std::uint64_t>(ptr + 2) != nameCacheKey(sourcesKey))
     {
-        for (const auto &[n, _] : localizedNameIndex)
+        GetLogger()->info(_("Name cache {} is out of date\n"), path);
+        return false;
+    }
+
+    auto poolSize = celutil::fromMemoryLE<std::uint32_t>(ptr + 10);
+    ptr += NAME_CACHE_HEADER_SIZE;
+    std::size_t remaining = file.size() - static_cast<std::size_t>(ptr - file.data());
+    if (poolSize > remaining)
+    {
+        GetLogger()->warn(_("Name cache {} is corrupt\n"), path);
+        return false;
+    }
+
+    nameIndex.clear();
+    localizedNameIndex.clear();
+    numberIndex.clear();
+
+    CacheReader reader(std::string_view(ptr, poolSize), ptr + poolSize, remaining - poolSize);
+    std::uint32_t nNumbers = 0;
+    bool ok = nameIndex.read(reader)
+        && localizedNameIndex.read(reader)
+        && reader.readNumber(nNumbers)
+        && reader.canRead(nNumbers, 12);
+
+    // The names of each catalog number are stored in order, so they are
+    // appended at the end of the map
+    for (std::uint32_t i = 0; ok && i < nNumbers; i++)
+    {
+        std::uint32_t catalogNumber;
+        std::string_view name;
+        ok = reader.readNumber(catalogNumber) && reader.readString(name);
+        if (ok)
+            numberIndex.emplace_hint(numberIndex.end(), catalogNumber, std::string(name));
+    }
+
+    if (!ok || !reader.atEnd())
+    {
+        GetLogger()->warn(_("Name cache {} is corrupt\n"), path);
+        nameIndex.clear();
+        localizedNameIndex.clear();
+        numberIndex.clear();
+        return false;
+    }
+
+    GetLogger()->info(_("Loaded names from cache {}\n"), path);
+    return true;
+}
+
+
+void NameDatabase::saveCache(const fs::path& path, std::uint64_t sourcesKey) const
+{
+    CacheWriter writer;
+    nameIndex.write(writer);
+    localizedNameIndex.write(writer);
+    writer.writeNumber(static_cast<std::uint32_t>(numberIndex.size()));
+    for (const auto& [catalogNumber, name] : numberIndex)
+    {
+        writer.writeNumber(catalogNumber);
+        writer.writeString(name);
+    }
+
+    // Write to a temporary file first so that an interrupted write never
+    // leaves a truncated cache behind.
+    fs::path tmpFile = path;
+    tmpFile += ".tmp";
+    {
+        std::string records = writer.getRecords();
+        const std::string& pool = writer.getPool();
+
+        std::ofstream out(tmpFile, std::ios::out | std::ios::binary);
+        out.write(NAME_CACHE_HEADER, std::strlen(NAME_CACHE_HEADER));
+        bool ok = out.good()
+            && celutil::writeLE<std::uint16_t>(out, NAME_CACHE_VERSION)
+            && celutil::writeLE<std::uint64_t>(out, nameCacheKey(sourcesKey))
+            && celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(pool.size()))
+            && out.write(pool.data(), static_cast<std::streamsize>(pool.size())).good()
+            && out.write(records.data(), static_cast<std::streamsize>(records.size())).good();
+        out.close();
+
+        if (!ok || !out.good())
         {
-            if (!UTF8StringCompare(n, name2, name_length, true))
-                completion.push_back(n);
+            GetLogger()->warn(_("Error writing name cache {}\n"), tmpFile);
+            std::error_code ec;
+            fs::remove(tmpFile, ec);
+            return;
         }
     }
-    return completion;
+
+    std::error_code ec;
+    fs::rename(tmpFile, path, ec);
+    if (ec)
+    {
+        GetLogger()->warn(_("Error writing name cache {}\n"), path);
+        fs::remove(tmpFile, ec);
+    }
 }
@@ -12,10 +12,16 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <map>
+#include <mutex>
+#include <utility>
 #include <vector>
+#include <celcompat/filesystem.h>
+#include <celutil/memoryusage.h>
 #include <celutil/stringutils.h>
 #include <celutil/utf8.h>
 #include <celengine/astroobj.h>
@@ -24,10 +30,62 @@
 // lies the one and only need for type genericity.
 class NameDatabase
 {
+    // Binary cache helpers, defined in name.cpp
+    class CacheWriter;
+    class CacheReader;
+
  public:
-    typedef std::map<std::string, AstroCatalog::IndexNumber, CompareIgnoringCasePredicate> NameIndex;
     typedef std::multimap<AstroCatalog::IndexNumber, std::string> NumberIndex;
 
+    /*! Catalog numbers by name, ignoring case. Exact lookups go through
+     *  an open addressing hash table. Completion uses an array of case
+     *  folded names, sorted on first use after names are added, so that
+     *  the names sharing a prefix are found by binary search.
+     */
+    class NameIndex
+    {
+     public:
+        NameIndex() = default;
+        NameIndex(const NameIndex&) = delete;
+        NameIndex& operator=(const NameIndex&) = delete;
+
+        std::size_t size() const { return entries.size(); }
+        void clear();
+
+        // Add a name or change the catalog number of an existing one
+        void set(const std::string& name, AstroCatalog::IndexNumber catalogNumber);
+        AstroCatalog::IndexNumber find(std::string_view name) const;
+        // Append the names whose folded form starts with folded
+        void getCompletion(std::vector<std::string>& completion, std::string_view folded) const;
+
+        std::size_t memoryUsage() const;
+
+        // Binary form used by NameDatabase::saveCache(), including the
+        // hash table and the sorted completion keys
+        void write(CacheWriter& writer) const;
+        bool read(CacheReader& reader);
+
+     private:
+        struct Entry
+        {
+            std::string name;
+            AstroCatalog::IndexNumber catalogNumber;
+        };
+
+        std::size_t findSlot(std::string_view name) const;
+        void rehash(std::size_t nSlots);
+        // Called with completionMutex held
+        void updateCompletionKeys() const;
+
+        std::vector<Entry> entries;
+        // Index + 1 of the entry in each slot, 0 for empty slots
+        std::vector<std::uint32_t> slots;
+
+        mutable std::mutex completionMutex;
+        // Folded names and their entry indices, sorted by folded name
+        mutable std::vector<std::pair<std::string, std::uint32_t>> completionKeys;
+    };
+
  public:
     NameDatabase() {};
 
@@ -41,12 +99,29 @@ class NameDatabase
 
     AstroCatalog::IndexNumber getCatalogNumberByName(const std::string&, bool i18n) const;
     std::string getNameByCatalogNumber(const AstroCatalog::IndexNumber) const;
+    // The first name of an object, or its translation, without copying
+    // it: a view of the stored name, whose Greek letters are already
+    // replaced, or of the message catalog. Empty if the object has no
+    // name; valid until the names of the object change.
+    std::string_view getPrimaryName(const AstroCatalog::IndexNumber, bool i18n) const;
 
     NumberIndex::const_iterator getFirstNameIter(const AstroCatalog::IndexNumber catalogNumber) const;
     NumberIndex::const_iterator getFinalNameIter() const;
 
     std::vector<std::string> getCompletion(const std::string& name, bool i18n) const;
 
+    // Add a node of the names to parent
+    void accountMemory(celestia::util::MemoryUsage& parent) const;
+
+    /*! Binary copy of the names with their Greek letters and translations
+     *  already resolved and their indexes already built, so that loading
+     *  it only copies them. sourcesKey identifies the files the names were
+     *  read from; the current locale and translations are added to it.
+     *  A cache with a different key isn't loaded.
+     */
+    bool loadCache(const fs::path& path, std::uint64_t sourcesKey);
+    void saveCache(const fs::path& path, std::uint64_t sourcesKey) const;
+
  protected:
     NameIndex   nameIndex;
     NameIndex   localizedNameIndex;
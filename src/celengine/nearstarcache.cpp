@@ -0,0 +1,98 @@
+// nearstarcache.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Reuse of the stars found near the observer between frames.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cmath>
+#include "nearstarcache.h"
+#include "stardb.h"
+#include "univcoord.h"
+
+namespace
+{
+
+// Cells kept for different views
+constexpr std::size_t MaxCells = 4;
+
+// Radius of the stars kept for a cell around its center, relative to its
+// width: the search distance plus half the diagonal, with some room for
+// rounding
+constexpr float CellRadius = 1.0f + 0.8660254f + 0.01f;
+
+class CellStarFinder : public StarHandler
+{
+ public:
+    explicit CellStarFinder(std::vector<const Star*>& _stars) : stars(_stars) {}
+    void process(const Star& star, float /*distance*/, float /*appMag*/) override
+    {
+        stars.push_back(&star);
+    }
+
+ private:
+    std::vector<const Star*>& stars;
+};
+
+} // end unnamed namespace
+
+void
+NearStarCache::find(const StarDatabase& starDB,
+                    const UniversalCoord& position,
+                    float maxDistance,
+                    std::vector<const Star*>& nearStars)
+{
+    Eigen::Vector3d posLy = position.toLy();
+    Eigen::Vector3d index = (posLy / maxDistance).array().floor();
+
+    ++useCount;
+    auto iter = std::find_if(cells.begin(), cells.end(),
+                             [&](const Cell& cell)
+                             {
+                                 return cell.starDB == &starDB &&
+                                        cell.maxDistance == maxDistance &&
+                                        cell.index == index;
+                             });
+    if (iter == cells.end())
+    {
+        if (cells.size() < MaxCells)
+        {
+            iter = cells.emplace(cells.end());
+        }
+        else
+        {
+            iter = std::min_element(cells.begin(), cells.end(),
+                                    [](const Cell& a, const Cell& b) { return a.lastUsed < b.lastUsed; });
+        }
+
+        iter->starDB = &starDB;
+        iter->index = index;
+        iter->maxDistance = maxDistance;
+        iter->stars.clear();
+
+        Eigen::Vector3d center = (index.array() + 0.5) * maxDistance;
+        CellStarFinder finder(iter->stars);
+        starDB.findCloseStars(finder, center.cast<float>(), maxDistance * CellRadius);
+    }
+    iter->lastUsed = useCount;
+
+    // The same test as the octree's for the stars of a node
+    Eigen::Vector3f obsPosition = posLy.cast<float>();
+    float radiusSquared = maxDistance * maxDistance;
+    for (const Star* star : iter->stars)
+    {
+        if ((obsPosition - star->getPosition()).squaredNorm() < radiusSquared)
+            nearStars.push_back(star);
+    }
+}
+
+void
+NearStarCache::clear()
+{
+    cells.clear();
+}
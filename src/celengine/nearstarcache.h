@@ -0,0 +1,61 @@
+// nearstarcache.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Reuse of the stars found near the observer between frames.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <Eigen/Core>
+
+class Star;
+class StarDatabase;
+class UniversalCoord;
+
+// NearStarCache finds the stars near a position like
+// StarDatabase::findCloseStars(), but queries the octree only when the
+// position enters a new cell of a grid. The grid cells are as wide as the
+// search distance; the stars within the search distance of anywhere in a
+// cell are kept, and those close enough to the position are picked from
+// them. The result is the same as the octree query's, in the same order.
+//
+// The octree only holds the static positions of the stars, so the cache
+// doesn't depend on the time. A few cells are kept, so that views with
+// observers in different places don't evict each other's stars.
+class NearStarCache
+{
+ public:
+    NearStarCache() = default;
+    ~NearStarCache() = default;
+    NearStarCache(const NearStarCache&) = delete;
+    NearStarCache& operator=(const NearStarCache&) = delete;
+
+    // Append the stars closer than maxDistance light years to position
+    void find(const StarDatabase& starDB,
+              const UniversalCoord& position,
+              float maxDistance,
+              std::vector<const Star*>& nearStars);
+
+    // Forget the stars found, after their positions were changed
+    void clear();
+
+ private:
+    struct Cell
+    {
+        const StarDatabase* starDB{ nullptr };
+        Eigen::Vector3d index{ Eigen::Vector3d::Zero() };
+        float maxDistance{ 0.0f };
+        std::uint32_t lastUsed{ 0 };
+        std::vector<const Star*> stars;
+    };
+
+    std::vector<Cell> cells;
+    std::uint32_t useCount{ 0 };
+};
@@ -107,6 +107,15 @@ void Nebula::render(const Vector3f& /*offset*/,
 }
 
 
+float Nebula::getImpostorRadius() const
+{
+    if (geometry == InvalidResource)
+        return 0.0f;
+    // Leave room for point sprites at the edge of the mesh
+    return 1.25f * getRadius();
+}
+
+
 uint64_t Nebula::getRenderMask() const
 {
     return Renderer::ShowNebulae;
@@ -33,6 +33,8 @@ class Nebula : public DeepSkyObject
                 const Matrices& m,
                 Renderer* renderer) override;
 
+    float getImpostorRadius() const override;
+
     uint64_t getRenderMask() const override;
     unsigned int getLabelMask() const override;
 
@@ -11,6 +11,7 @@
 #include "observer.h"
 #include "simulation.h"
 #include "frametree.h"
+#include "prefetcher.h"
 #include <celmath/mathlib.h>
 #include <celmath/solve.h>
 #include <celmath/geomutil.h>
@@ -80,6 +81,8 @@ Observer::Observer(const Observer& o) :
     trackingOrientation(o.trackingOrientation),
     fov(o.fov),
     reverseFlag(o.reverseFlag),
+    eyeSeparation(o.eyeSeparation),
+    convergenceDistance(o.convergenceDistance),
     locationFilter(o.locationFilter),
     displayedSurface(o.displayedSurface)
 {
@@ -105,6 +108,8 @@ Observer& Observer::operator=(const Observer& o)
     trackingOrientation = o.trackingOrientation;
     fov = o.fov;
     reverseFlag = o.reverseFlag;
+    eyeSeparation = o.eyeSeparation;
+    convergenceDistance = o.convergenceDistance;
     locationFilter = o.locationFilter;
     displayedSurface = o.displayedSurface;
 
@@ -538,6 +543,9 @@ void Observer::computeGotoParameters(const Selection& destination,
     UniversalCoord targetPosition = destination.getPosition(getTime());
     //Vector3d v = targetPosition.offsetFromKm(getPosition()).normalized();
 
+    if (ResourcePrefetcher* prefetcher = GetResourcePrefetcher(); prefetcher != nullptr)
+        prefetcher->addGoal(destination, gotoTime);
+
     jparams.traj = Linear;
     jparams.duration = gotoTime;
     jparams.startTime = realTime;
@@ -601,6 +609,9 @@ void Observer::computeGotoParametersGC(const Selection& destination,
     UniversalCoord targetPosition = destination.getPosition(getTime());
     //Vector3d v = targetPosition.offsetFromKm(getPosition()).normalized();
 
+    if (ResourcePrefetcher* prefetcher = GetResourcePrefetcher(); prefetcher != nullptr)
+        prefetcher->addGoal(destination, gotoTime);
+
     jparams.traj = GreatCircle;
     jparams.duration = gotoTime;
     jparams.startTime = realTime;
@@ -1348,6 +1359,37 @@ void Observer::setFOV(float _fov)
 }
 
 
+double Observer::getEyeSeparation() const
+{
+    return eyeSeparation;
+}
+
+
+void Observer::setEyeSeparation(double separation)
+{
+    eyeSeparation = separation;
+}
+
+
+double Observer::getConvergenceDistance() const
+{
+    return convergenceDistance;
+}
+
+
+void Observer::setConvergenceDistance(double distance)
+{
+    convergenceDistance = distance;
+}
+
+
+Vector3d Observer::getEyeOffset(int eye) const
+{
+    double x = eye == 0 ? -0.5 * eyeSeparation : 0.5 * eyeSeparation;
+    return Vector3d(x, 0.0, 0.0);
+}
+
+
 Vector3f Observer::getPickRay(float x, float y) const
 {
     float s = 2 * (float) tan(fov / 2.0);
@@ -136,6 +136,16 @@ public:
     float          getFOV() const;
     void           setFOV(float);
 
+    // Stereo views: distance between the eyes in kilometers, and the
+    // distance at which the views of both eyes coincide, or zero for
+    // parallel views.
+    double         getEyeSeparation() const;
+    void           setEyeSeparation(double);
+    double         getConvergenceDistance() const;
+    void           setConvergenceDistance(double);
+    // Position of the left (0) or right (1) eye in the camera frame
+    Eigen::Vector3d getEyeOffset(int eye) const;
+
     void           update(double dt, double timeScale);
 
     Eigen::Vector3f getPickRay(float x, float y) const;
@@ -316,6 +326,9 @@ public:
     float fov{ static_cast<float>(celestia::numbers::pi / 4.0) };
     bool reverseFlag{ false };
 
+    double eyeSeparation{ 0.0 };
+    double convergenceDistance{ 0.0 };
+
     uint64_t locationFilter{ ~0ull };
     std::string displayedSurface;
 };
@@ -16,6 +16,8 @@
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 #include <celengine/observer.h>
+#include <celutil/threadpool.h>
+#include <algorithm>
 #include <vector>
 
 // The DynamicOctree and StaticOctree template arguments are:
@@ -51,7 +53,33 @@ struct OctreeLevelStatistics
 };
 
 
+// How a DynamicOctree subdivides space. A node splits once it holds
+// splitThreshold objects and another one that fits into a child arrives,
+// and the exclusion factor of its children is magnitudeStep fainter than
+// its own. A higher threshold gives fewer, fuller nodes, which suits
+// dense catalogs; sparse catalogs cull better with a lower one.
+struct OctreeSplitPolicy
+{
+    unsigned int splitThreshold;
+    float        magnitudeStep;
+};
+
+
+// Flat description of a StaticOctree node, used to save the structure of an
+// octree and rebuild it later without re-sorting the objects. Nodes are
+// listed in depth-first order, the same order in which their objects are
+// stored.
+template <class PREC> struct OctreeNodeLayout
+{
+    Eigen::Matrix<PREC, 3, 1> cellCenterPos;
+    float        exclusionFactor;
+    unsigned int nObjects;
+    bool         hasChildren;
+};
+
+
 template <class OBJ, class PREC> class StaticOctree;
+template <class OBJ, class PREC> class FlatOctree;
 template <class OBJ, class PREC> class DynamicOctree
 {
 public:
@@ -63,51 +91,78 @@ private:
 
     typedef bool (LimitingFactorPredicate)     (const OBJ&, const float);
     typedef bool (StraddlingPredicate)         (const Eigen::Matrix<PREC, 3, 1>&, const OBJ&, const float);
-    typedef PREC (ExclusionFactorDecayFunction)(const PREC);
 
  public:
     DynamicOctree(const Eigen::Matrix<PREC, 3, 1>& cellCenterPos,
-                  const float         exclusionFactor);
+                  const float         exclusionFactor,
+                  const OctreeSplitPolicy& policy = defaultSplitPolicy);
     ~DynamicOctree();
 
     void insertObject  (const OBJ&, const PREC);
+    // Copy the objects to _sortedObjects in depth-first order of the nodes,
+    // and build the static octree over them. The objects of each node are
+    // sorted by magnitude, brightest first, so that traversals can stop
+    // scanning a node at the first object too faint to be visible.
     void rebuildAndSort(StaticOctree<OBJ, PREC>*&, OBJ*&);
 
+    // Insert a batch of objects into an empty node. The resulting tree is
+    // identical to the one built by calling insertObject() for each object
+    // in order, but if a thread pool is given, independent subtrees are
+    // built concurrently.
+    void insertObjects (std::vector<const OBJ*>&&, const PREC, celestia::util::ThreadPool*);
+    // Same as rebuildAndSort(), with large subtrees copied concurrently.
+    void rebuildAndSort(StaticOctree<OBJ, PREC>*&, OBJ*&, celestia::util::ThreadPool*);
+
+    // The magnitude by which the objects of each node are sorted
+    typedef float (ObjectMagnitudeFunction)(const OBJ&);
+    static ObjectMagnitudeFunction* magnitudeFunction;
+
+    // The policy of octrees built without one
+    static const OctreeSplitPolicy defaultSplitPolicy;
+
  private:
-   static unsigned int SPLIT_THRESHOLD;
+   // Subtrees with fewer objects than this are processed by the thread that
+   // reaches them rather than on a separate task.
+   static constexpr unsigned int PARALLEL_GRAIN = 16384;
 
    static LimitingFactorPredicate*      limitingFactorPredicate;
    static StraddlingPredicate*          straddlingPredicate;
-   static ExclusionFactorDecayFunction* decayFunction;
 
  private:
     void           add  (const OBJ&);
     void           split(const PREC);
+    void           createChildren(const PREC);
     void           sortIntoChildNodes();
+    void           distribute(ObjectList*, const PREC, celestia::util::ThreadPool*);
+    void           rebuildSubtree(StaticOctree<OBJ, PREC>*&, OBJ*, celestia::util::ThreadPool*);
+    static void    sortByMagnitude(OBJ*, OBJ*);
+    unsigned int   countObjects() const;
     DynamicOctree* getChild(const OBJ&, const Eigen::Matrix<PREC, 3, 1>&);
 
     DynamicOctree**            _children;
     Eigen::Matrix<PREC, 3, 1>  cellCenterPos;
     PREC                       exclusionFactor;
     ObjectList*                _objects;
+    OctreeSplitPolicy          policy;
 };
 
 // make clang happy
 #ifndef _MSC_VER
-template<> DynamicOctree<Star, float>::ExclusionFactorDecayFunction* DynamicOctree<Star, float>::decayFunction;
 template<> DynamicOctree<Star, float>::LimitingFactorPredicate* DynamicOctree<Star, float>::limitingFactorPredicate;
 template<> DynamicOctree<Star, float>::StraddlingPredicate* DynamicOctree<Star, float>::straddlingPredicate;
-template<> unsigned int DynamicOctree<Star, float>::SPLIT_THRESHOLD;
+template<> DynamicOctree<Star, float>::ObjectMagnitudeFunction* DynamicOctree<Star, float>::magnitudeFunction;
+template<> const OctreeSplitPolicy DynamicOctree<Star, float>::defaultSplitPolicy;
 
-template<> DynamicOctree<DeepSkyObject*, double>::ExclusionFactorDecayFunction* DynamicOctree<DeepSkyObject*, double>::decayFunction;
 template<> DynamicOctree<DeepSkyObject*, double>::LimitingFactorPredicate* DynamicOctree<DeepSkyObject *, double>::limitingFactorPredicate;
 template<> DynamicOctree<DeepSkyObject*, double>::StraddlingPredicate* DynamicOctree<DeepSkyObject *, double>::straddlingPredicate;
-template<> unsigned int DynamicOctree<DeepSkyObject*, double>::SPLIT_THRESHOLD;
+template<> DynamicOctree<DeepSkyObject*, double>::ObjectMagnitudeFunction* DynamicOctree<DeepSkyObject*, double>::magnitudeFunction;
+template<> const OctreeSplitPolicy DynamicOctree<DeepSkyObject*, double>::defaultSplitPolicy;
 #endif
 
 template <class OBJ, class PREC> class StaticOctree
 {
  friend class DynamicOctree<OBJ, PREC>;
+ friend class FlatOctree<OBJ, PREC>;
 
  public:
     typedef Eigen::Matrix<PREC, 3, 1> PointType;
@@ -145,11 +200,25 @@ template <class OBJ, class PREC> class StaticOctree
     int countChildren() const;
     int countObjects()  const;
 
+    void getLayout(std::vector<OctreeNodeLayout<PREC>>& layout) const;
+
+    // Rebuild an octree saved with getLayout() over objects that are
+    // already sorted. Returns nullptr if the layout is inconsistent or
+    // doesn't account for exactly nObjects objects.
+    static StaticOctree* fromLayout(const std::vector<OctreeNodeLayout<PREC>>& layout,
+                                    OBJ*         firstObject,
+                                    unsigned int nObjects);
+
     void computeStatistics(std::vector<OctreeLevelStatistics>& stats, unsigned int level = 0);
 
  private:
     static const PREC SQRT3;
 
+    static StaticOctree* fromLayout(const OctreeNodeLayout<PREC>*& node,
+                                    const OctreeNodeLayout<PREC>*  end,
+                                    OBJ*&                          firstObject,
+                                    OBJ*                           lastObject);
+
  private:
     StaticOctree** _children;
     Eigen::Matrix<PREC, 3, 1>   cellCenterPos;
@@ -179,17 +248,19 @@ enum
     ZPos = 4,
 };
 
-// The SPLIT_THRESHOLD is the number of objects a node must contain before its
-// children are generated. Increasing this number will decrease the number of
-// octree nodes in the tree, which will use less memory but make culling less
-// efficient.
+// The split threshold of the policy is the number of objects a node must
+// contain before its children are generated. Increasing this number will
+// decrease the number of octree nodes in the tree, which will use less memory
+// but make culling less efficient.
 template <class OBJ, class PREC>
 inline DynamicOctree<OBJ, PREC>::DynamicOctree(const Eigen::Matrix<PREC, 3, 1>& cellCenterPos,
-                                               const float                      exclusionFactor):
+                                               const float                      exclusionFactor,
+                                               const OctreeSplitPolicy&         policy):
     _children      (nullptr),
     cellCenterPos  (cellCenterPos),
     exclusionFactor(exclusionFactor),
-    _objects       (nullptr)
+    _objects       (nullptr),
+    policy         (policy)
 {
 }
 
@@ -220,7 +291,7 @@ inline void DynamicOctree<OBJ, PREC>::insertObject(const OBJ& obj, const PREC sc
     {
         // If we haven't allocated child nodes yet, try to fit
         // the object in this node, even though it could be put
-        // in a child. Only if there are more than SPLIT_THRESHOLD
+        // in a child. Only if there are more than splitThreshold
         // objects in the node will we attempt to place the
         // object into a child node.  This is done in order
         // to avoid having the octree degenerate into one object
@@ -228,7 +299,7 @@ inline void DynamicOctree<OBJ, PREC>::insertObject(const OBJ& obj, const PREC sc
         if (_children == nullptr)
         {
             // Make sure that there's enough room left in this node
-            if (_objects != nullptr && _objects->size() >= DynamicOctree<OBJ, PREC>::SPLIT_THRESHOLD)
+            if (_objects != nullptr && _objects->size() >= policy.splitThreshold)
                 split(scale * 0.5f);
             add(obj);
         }
@@ -252,6 +323,14 @@ inline void DynamicOctree<OBJ, PREC>::add(const OBJ& obj)
 
 template <class OBJ, class PREC>
 inline void DynamicOctree<OBJ, PREC>::split(const PREC scale)
+{
+    createChildren(scale);
+    sortIntoChildNodes();
+}
+
+
+template <class OBJ, class PREC>
+inline void DynamicOctree<OBJ, PREC>::createChildren(const PREC scale)
 {
     _children = new DynamicOctree*[8];
 
@@ -263,16 +342,10 @@ inline void DynamicOctree<OBJ, PREC>::split(const PREC scale)
                                                ((i & YPos) != 0) ? scale : -scale,
                                                ((i & ZPos) != 0) ? scale : -scale);
 
-#if 0
-        centerPos.x     += ((i & XPos) != 0) ? scale : -scale;
-        centerPos.y     += ((i & YPos) != 0) ? scale : -scale;
-        centerPos.z     += ((i & ZPos) != 0) ? scale : -scale;
-#endif
-
         _children[i] = new DynamicOctree(centerPos,
-                                         decayFunction(exclusionFactor));
+                                         exclusionFactor + (PREC) policy.magnitudeStep,
+                                         policy);
     }
-    sortIntoChildNodes();
 }
 
 
@@ -314,6 +387,8 @@ inline void DynamicOctree<OBJ, PREC>::rebuildAndSort(StaticOctree<OBJ, PREC>*& _
             *_sortedObjects++ = **iter;
         }
 
+    sortByMagnitude(_firstObject, _sortedObjects);
+
     unsigned int nObjects  = (unsigned int) (_sortedObjects - _firstObject);
     _staticNode            = new StaticOctree<OBJ, PREC>(cellCenterPos, exclusionFactor, _firstObject, nObjects);
 
@@ -327,6 +402,172 @@ inline void DynamicOctree<OBJ, PREC>::rebuildAndSort(StaticOctree<OBJ, PREC>*& _
 }
 
 
+template <class OBJ, class PREC>
+inline void DynamicOctree<OBJ, PREC>::sortByMagnitude(OBJ* first, OBJ* last)
+{
+    // Objects of the same magnitude keep their insertion order
+    std::stable_sort(first, last,
+                     [](const OBJ& a, const OBJ& b) { return magnitudeFunction(a) < magnitudeFunction(b); });
+}
+
+
+template <class OBJ, class PREC>
+inline void DynamicOctree<OBJ, PREC>::insertObjects(std::vector<const OBJ*>&& objects,
+                                                    const PREC scale,
+                                                    celestia::util::ThreadPool* pool)
+{
+    // ASSERT(_objects == nullptr && _children == nullptr);
+    distribute(new ObjectList(std::move(objects)), scale, pool);
+    if (pool != nullptr)
+        pool->wait();
+}
+
+
+// Place a list of objects, in insertion order, into this node and its
+// descendants. This reproduces the outcome of insertObject(): the node only
+// splits when an object that fits into a child arrives while the node
+// already holds splitThreshold objects. That object and every object that
+// can't be placed into a child stay here; the rest go to the children in
+// their original order, so each child can be processed independently.
+template <class OBJ, class PREC>
+void DynamicOctree<OBJ, PREC>::distribute(ObjectList* objects,
+                                          const PREC scale,
+                                          celestia::util::ThreadPool* pool)
+{
+    auto staysHere = [this](const OBJ& obj)
+    {
+        return limitingFactorPredicate(obj, exclusionFactor) ||
+               straddlingPredicate(cellCenterPos, obj, exclusionFactor);
+    };
+
+    size_t nObjects = objects->size();
+    size_t splitIndex = nObjects;
+    for (size_t i = policy.splitThreshold; i < nObjects; ++i)
+    {
+        if (!staysHere(*(*objects)[i]))
+        {
+            splitIndex = i;
+            break;
+        }
+    }
+
+    if (splitIndex == nObjects)
+    {
+        if (nObjects > 0)
+            _objects = objects;
+        else
+            delete objects;
+        return;
+    }
+
+    createChildren(scale * (PREC) 0.5);
+
+    ObjectList* childObjects[8];
+    for (int i = 0; i < 8; ++i)
+        childObjects[i] = new ObjectList;
+
+    size_t nKeptInParent = 0;
+    for (size_t i = 0; i < nObjects; ++i)
+    {
+        const OBJ* obj = (*objects)[i];
+        if (i == splitIndex || staysHere(*obj))
+            (*objects)[nKeptInParent++] = obj;
+        else
+        {
+            DynamicOctree* child = getChild(*obj, cellCenterPos);
+            childObjects[std::find(_children, _children + 8, child) - _children]->push_back(obj);
+        }
+    }
+
+    objects->resize(nKeptInParent);
+    _objects = objects;
+
+    for (int i = 0; i < 8; ++i)
+    {
+        DynamicOctree* child = _children[i];
+        ObjectList* list = childObjects[i];
+        if (pool != nullptr && list->size() >= PARALLEL_GRAIN)
+            pool->submit([child, list, scale, pool]() { child->distribute(list, scale * (PREC) 0.5, pool); });
+        else
+            child->distribute(list, scale * (PREC) 0.5, pool);
+    }
+}
+
+
+template <class OBJ, class PREC>
+unsigned int DynamicOctree<OBJ, PREC>::countObjects() const
+{
+    unsigned int count = _objects != nullptr ? (unsigned int) _objects->size() : 0;
+
+    if (_children != nullptr)
+        for (int i = 0; i < 8; ++i)
+            count += _children[i]->countObjects();
+
+    return count;
+}
+
+
+template <class OBJ, class PREC>
+inline void DynamicOctree<OBJ, PREC>::rebuildAndSort(StaticOctree<OBJ, PREC>*& _staticNode,
+                                                     OBJ*& _sortedObjects,
+                                                     celestia::util::ThreadPool* pool)
+{
+    if (pool == nullptr || pool->size() < 2)
+    {
+        rebuildAndSort(_staticNode, _sortedObjects);
+        return;
+    }
+
+    unsigned int nObjects = countObjects();
+    rebuildSubtree(_staticNode, _sortedObjects, pool);
+    pool->wait();
+    _sortedObjects += nObjects;
+}
+
+
+// Copy the objects of this subtree to _sortedObjects in the same order as
+// rebuildAndSort(). Each child's offset is known from the object counts, so
+// large child subtrees are copied on separate tasks.
+template <class OBJ, class PREC>
+void DynamicOctree<OBJ, PREC>::rebuildSubtree(StaticOctree<OBJ, PREC>*& _staticNode,
+                                              OBJ* _sortedObjects,
+                                              celestia::util::ThreadPool* pool)
+{
+    OBJ* _firstObject = _sortedObjects;
+
+    if (_objects != nullptr)
+        for (const OBJ* obj : *_objects)
+            *_sortedObjects++ = *obj;
+
+    sortByMagnitude(_firstObject, _sortedObjects);
+
+    unsigned int nObjects  = (unsigned int) (_sortedObjects - _firstObject);
+    _staticNode            = new StaticOctree<OBJ, PREC>(cellCenterPos, exclusionFactor, _firstObject, nObjects);
+
+    if (_children != nullptr)
+    {
+        _staticNode->_children    = new StaticOctree<OBJ, PREC>*[8];
+
+        for (int i=0; i<8; ++i)
+        {
+            DynamicOctree* child = _children[i];
+            StaticOctree<OBJ, PREC>*& childNode = _staticNode->_children[i];
+            unsigned int childObjects = child->countObjects();
+            if (childObjects >= PARALLEL_GRAIN)
+            {
+                OBJ* childFirst = _sortedObjects;
+                pool->submit([child, &childNode, childFirst, pool]() { child->rebuildSubtree(childNode, childFirst, pool); });
+                _sortedObjects += childObjects;
+            }
+            else
+            {
+                child->rebuildAndSort(childNode, _sortedObjects);
+            }
+        }
+    }
+}
+
+
 //MS VC++ wants this to be placed here:
 template <class OBJ, class PREC>
 const PREC StaticOctree<OBJ, PREC>::SQRT3 = (PREC) 1.732050807568877;
@@ -384,6 +625,68 @@ inline int StaticOctree<OBJ, PREC>::countObjects() const
 }
 
 
+template <class OBJ, class PREC>
+void StaticOctree<OBJ, PREC>::getLayout(std::vector<OctreeNodeLayout<PREC>>& layout) const
+{
+    layout.push_back({ cellCenterPos, exclusionFactor, nObjects, _children != nullptr });
+
+    if (_children != nullptr)
+        for (int i = 0; i < 8; ++i)
+            _children[i]->getLayout(layout);
+}
+
+
+template <class OBJ, class PREC>
+StaticOctree<OBJ, PREC>* StaticOctree<OBJ, PREC>::fromLayout(const std::vector<OctreeNodeLayout<PREC>>& layout,
+                                                             OBJ*         firstObject,
+                                                             unsigned int nObjects)
+{
+    const OctreeNodeLayout<PREC>* node = layout.data();
+    const OctreeNodeLayout<PREC>* end  = node + layout.size();
+    OBJ* lastObject = firstObject + nObjects;
+
+    StaticOctree* root = fromLayout(node, end, firstObject, lastObject);
+    if (root != nullptr && (node != end || firstObject != lastObject))
+    {
+        delete root;
+        return nullptr;
+    }
+
+    return root;
+}
+
+
+template <class OBJ, class PREC>
+StaticOctree<OBJ, PREC>* StaticOctree<OBJ, PREC>::fromLayout(const OctreeNodeLayout<PREC>*& node,
+                                                             const OctreeNodeLayout<PREC>*  end,
+                                                             OBJ*&                          firstObject,
+                                                             OBJ*                           lastObject)
+{
+    if (node == end || node->nObjects > (unsigned int) (lastObject - firstObject))
+        return nullptr;
+
+    const OctreeNodeLayout<PREC>& desc = *node++;
+    auto staticNode = new StaticOctree(desc.cellCenterPos, desc.exclusionFactor, firstObject, desc.nObjects);
+    firstObject += desc.nObjects;
+
+    if (desc.hasChildren)
+    {
+        staticNode->_children = new StaticOctree*[8]();
+        for (int i = 0; i < 8; ++i)
+        {
+            staticNode->_children[i] = fromLayout(node, end, firstObject, lastObject);
+            if (staticNode->_children[i] == nullptr)
+            {
+                delete staticNode;
+                return nullptr;
+            }
+        }
+    }
+
+    return staticNode;
+}
+
+
 template <class OBJ, class PREC>
 void StaticOctree<OBJ, PREC>::computeStatistics(std::vector<OctreeLevelStatistics>& stats, unsigned int level)
 {
@@ -20,8 +20,11 @@ public:
     std::vector<CurvePlotSample> samples;
 
     OrbitSampler() = default;
+    explicit OrbitSampler(double tolerance) : m_tolerance(tolerance) {}
 
-    void sample(double t, const Eigen::Vector3d& position, const Eigen::Vector3d& velocity)
+    double tolerance() const override { return m_tolerance; }
+
+    void sample(double t, const Eigen::Vector3d& position, const Eigen::Vector3d& velocity) override
     {
         CurvePlotSample samp;
         samp.t = t;
@@ -45,4 +48,7 @@ public:
             plot->addSample(*iter);
         }
     }
+
+ private:
+    double m_tolerance{ 1.0 };
 };
@@ -65,6 +65,7 @@ void Overlay::setFont(const std::shared_ptr<TextureFont>& f)
             font->flush();
         font = f;
         fontChanged = true;
+        newSpan = true;
     }
 }
 
@@ -82,8 +83,31 @@ void Overlay::beginText()
     }
 }
 
+bool Overlay::beginCachedText(OverlayTextBlock& block, std::uint64_t key)
+{
+    beginText();
+    if (block.valid && block.key == key)
+    {
+        drawTextBlock(block);
+        return false;
+    }
+
+    block.spans.clear();
+    block.key = key;
+    block.valid = true;
+    recording = &block;
+    recordingLevel = textBlock;
+    recordX = global.x;
+    recordY = global.y;
+    newSpan = true;
+    return true;
+}
+
 void Overlay::endText()
 {
+    if (recording != nullptr && textBlock == recordingLevel)
+        recording = nullptr;
+
     if (textBlock > 0)
     {
         textBlock--;
@@ -93,17 +117,61 @@ void Overlay::endText()
 }
 
 
+void Overlay::bindFont()
+{
+    if (!useTexture || fontChanged)
+    {
+        font->bind();
+        font->setMVPMatrices(projection);
+        useTexture = true;
+        fontChanged = false;
+    }
+}
+
+
+// Add a character written at the current position to the block being
+// recorded
+void Overlay::record(std::uint32_t c)
+{
+    if (c == '\n')
+    {
+        newSpan = true;
+        return;
+    }
+
+    if (newSpan)
+    {
+        recording->spans.push_back({ font, color,
+                                     global.x + xoffset - recordX,
+                                     global.y + yoffset - recordY,
+                                     {} });
+        newSpan = false;
+    }
+    UTF8Encode(c, recording->spans.back().text);
+}
+
+
+void Overlay::drawTextBlock(const OverlayTextBlock& block)
+{
+    std::shared_ptr<TextureFont> blockFont = font;
+    for (const auto& span : block.spans)
+    {
+        setFont(span.font);
+        setColor(span.color[0], span.color[1], span.color[2], span.color[3]);
+        bindFont();
+        font->render(span.text, global.x + span.x, global.y + span.y);
+    }
+    setFont(blockFont);
+}
+
+
 void Overlay::print(wchar_t c)
 {
     if (font != nullptr)
     {
-        if (!useTexture || fontChanged)
-        {
-            font->bind();
-            font->setMVPMatrices(projection);
-            useTexture = true;
-            fontChanged = false;
-        }
+        bindFont();
+        if (recording != nullptr)
+            record(static_cast<std::uint32_t>(c));
 
         switch (c)
         {
@@ -128,13 +196,9 @@ void Overlay::print(char c)
 {
     if (font != nullptr)
     {
-        if (!useTexture || fontChanged)
-        {
-            font->bind();
-            font->setMVPMatrices(projection);
-            useTexture = true;
-            fontChanged = false;
-        }
+        bindFont();
+        if (recording != nullptr)
+            record(static_cast<unsigned char>(c));
 
         switch (c)
         {
@@ -180,6 +244,8 @@ void Overlay::setColor(float r, float g, float b, float a)
 {
     if (font != nullptr)
         font->flush();
+    color = { r, g, b, a };
+    newSpan = true;
     glVertexAttrib4f(CelestiaGLProgram::ColorAttributeIndex, r, g, b, a);
 }
 
@@ -187,6 +253,8 @@ void Overlay::setColor(const Color& c)
 {
     if (font != nullptr)
         font->flush();
+    color = { c.red(), c.green(), c.blue(), c.alpha() };
+    newSpan = true;
     glVertexAttrib4f(CelestiaGLProgram::ColorAttributeIndex,
                      c.red(), c.green(), c.blue(), c.alpha());
 }
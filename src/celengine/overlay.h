@@ -10,7 +10,10 @@
 #ifndef _OVERLAY_H_
 #define _OVERLAY_H_
 
+#include <array>
+#include <cstdint>
 #include <iosfwd>
+#include <memory>
 #include <string>
 #include <vector>
 #include <fmt/printf.h>
@@ -53,6 +56,37 @@ class OverlayStreamBuf : public std::streambuf
 };
 
 
+// The text written to an Overlay between beginCachedText() and endText(),
+// kept as runs of text with their font, color and position, so that it
+// can be drawn again without being composed.
+class OverlayTextBlock
+{
+ public:
+    OverlayTextBlock() = default;
+    OverlayTextBlock(const OverlayTextBlock&) = delete;
+    OverlayTextBlock& operator=(const OverlayTextBlock&) = delete;
+
+    void invalidate() { valid = false; }
+
+ private:
+    struct Span
+    {
+        std::shared_ptr<TextureFont> font;
+        std::array<float, 4> color;
+        // Relative to the position of the block
+        float x;
+        float y;
+        std::string text;
+    };
+
+    std::vector<Span> spans;
+    std::uint64_t key{ 0 };
+    bool valid{ false };
+
+    friend class Overlay;
+};
+
+
 class Overlay : public std::ostream
 {
  public:
@@ -82,6 +116,14 @@ class Overlay : public std::ostream
 
     void beginText();
     void endText();
+
+    /*! Begin a text block whose contents are determined by key. If block
+     *  holds the text written for the same key, the text is drawn from it
+     *  and false is returned. Otherwise the text written until endText()
+     *  is recorded in block, and true is returned.
+     */
+    bool beginCachedText(OverlayTextBlock& block, std::uint64_t key);
+
     void print(wchar_t);
     void print(char);
     template <typename... T>
@@ -97,6 +139,9 @@ class Overlay : public std::ostream
 
  private:
     void print_impl(const std::string&);
+    void bindFont();
+    void record(std::uint32_t c);
+    void drawTextBlock(const OverlayTextBlock&);
 
     int windowWidth{ 1 };
     int windowHeight{ 1 };
@@ -104,6 +149,14 @@ class Overlay : public std::ostream
     bool useTexture{ false };
     bool fontChanged{ false };
     int textBlock{ 0 };
+    std::array<float, 4> color{ 1.0f, 1.0f, 1.0f, 1.0f };
+
+    // Block being recorded, at the text block level it was begun at
+    OverlayTextBlock* recording{ nullptr };
+    int recordingLevel{ 0 };
+    float recordX{ 0.0f };
+    float recordY{ 0.0f };
+    bool newSpan{ true };
 
     float xoffset{ 0.0f };
     float yoffset{ 0.0f };
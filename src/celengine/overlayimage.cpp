@@ -1,19 +1,102 @@
 #include <algorithm>
 #include <iostream>
 #include <celmath/mathlib.h>
+#include <celutil/logger.h>
+#include "image.h"
 #include "overlayimage.h"
 #include "rectangle.h"
 #include "render.h"
 
 using namespace celmath;
+using celestia::util::GetLogger;
+
+namespace
+{
+
+OverlayImageManager* imageManager = nullptr;
+
+// Decodes the image on a loader thread; only the upload is left to the
+// render thread. Unlike textures, images are never replaced by a reduced
+// version first, which would change their size on screen.
+class OverlayImageLoader : public ResourceInfo<Texture>::AsyncLoader
+{
+ public:
+    explicit OverlayImageLoader(const fs::path& _name) : name(_name) {}
+
+    bool decode() override
+    {
+        image.reset(LoadImageFromFile(name));
+        return image != nullptr;
+    }
+
+    Texture* create() override
+    {
+        Texture* tex = CreateTextureFromImage(*image, Texture::EdgeClamp, Texture::NoMipMaps);
+        image.reset();
+        return tex;
+    }
+
+    std::size_t size() const override
+    {
+        return image == nullptr ? 0 : static_cast<std::size_t>(image->getSize());
+    }
+
+ private:
+    fs::path name;
+    std::unique_ptr<Image> image;
+};
+
+} // end unnamed namespace
+
+OverlayImageManager* GetOverlayImageManager()
+{
+    if (imageManager == nullptr)
+        imageManager = new OverlayImageManager("images");
+    return imageManager;
+}
+
+void PreloadOverlayImage(const fs::path& filename)
+{
+    OverlayImageManager* manager = GetOverlayImageManager();
+    ResourceHandle h = manager->getHandle(OverlayImageInfo(filename));
+    // Without loader threads, the image is read now rather than when it's
+    // shown
+    if (!manager->prefetch(h) && !manager->isLoading(h))
+        manager->find(h);
+}
+
+fs::path OverlayImageInfo::resolve(const fs::path& baseDir)
+{
+    return baseDir / source;
+}
+
+Texture* OverlayImageInfo::load(const fs::path& name)
+{
+    GetLogger()->debug("Loading overlay image: {}\n", name);
+    return LoadTextureFromFile(name, Texture::EdgeClamp, Texture::NoMipMaps);
+}
+
+std::unique_ptr<ResourceInfo<Texture>::AsyncLoader>
+OverlayImageInfo::asyncLoader(const fs::path& name)
+{
+    GetLogger()->debug("Loading overlay image asynchronously: {}\n", name);
+    return std::make_unique<OverlayImageLoader>(name);
+}
 
 OverlayImage::OverlayImage(fs::path f, Renderer *r) :
     filename(std::move(f)),
     renderer(r)
 {
-    texture = std::unique_ptr<Texture>(LoadTextureFromFile(fs::path("images") / filename,
-                                                           Texture::EdgeClamp,
-                                                           Texture::NoMipMaps));
+    OverlayImageManager* manager = GetOverlayImageManager();
+    handle = manager->getHandle(OverlayImageInfo(filename));
+    if (manager->findLoaded(handle) != nullptr)
+        texture = manager->acquire(handle);
+}
+
+OverlayImage::~OverlayImage()
+{
+    if (texture != nullptr)
+        GetOverlayImageManager()->release(handle);
 }
 
 void OverlayImage::setColor(const Color& c)
@@ -57,7 +140,7 @@ void OverlayImage::render(float curr_time, int width, int height)
     }
 
     celestia::Rect r(left, bottom, xSize, ySize);
-    r.tex = texture.get();
+    r.tex = texture;
     for (size_t i = 0; i < colors.size(); i++)
     {
         r.colors[i] = Color(colors[i], colors[i].alpha() * alpha);
@@ -3,16 +3,52 @@
 #include <array>
 #include <memory>
 #include <celcompat/filesystem.h>
+#include <celutil/resmanager.h>
 #include "texture.h"
 
 class Renderer;
 
+// Images of the images directory shown by scripts. They stay loaded until
+// the memory budget of the manager is exceeded, so that slides shown
+// again don't have to be read again.
+class OverlayImageInfo : public ResourceInfo<Texture>
+{
+ public:
+    explicit OverlayImageInfo(const fs::path& _source) : source(_source) {};
+
+    fs::path resolve(const fs::path&) override;
+    Texture* load(const fs::path&) override;
+    std::unique_ptr<AsyncLoader> asyncLoader(const fs::path&) override;
+    std::size_t hash() const { return fs::hash_value(source); }
+    std::size_t getMemoryUsage() const override
+    {
+        return resource != nullptr ? resource->getMemoryUsage() : 0;
+    }
+
+    fs::path source;
+};
+
+inline bool operator==(const OverlayImageInfo& ii0, const OverlayImageInfo& ii1)
+{
+    return ii0.source == ii1.source;
+}
+
+typedef ResourceManager<OverlayImageInfo> OverlayImageManager;
+
+extern OverlayImageManager* GetOverlayImageManager();
+
+// Start loading an image that a script will show, on a loader thread when
+// asynchronous loading is enabled, so that showing it doesn't wait for it
+extern void PreloadOverlayImage(const fs::path&);
+
 class OverlayImage
 {
  public:
+    // The image is loaded, or waited for if it's being preloaded, so that
+    // it's shown from the first frame
     OverlayImage(fs::path, Renderer*);
     OverlayImage()               = delete;
-    ~OverlayImage()              = default;
+    ~OverlayImage();
     OverlayImage(OverlayImage&)  = delete;
     OverlayImage(OverlayImage&&) = delete;
 
@@ -55,6 +91,8 @@ class OverlayImage
     std::array<Color, 4> colors;
 
     fs::path filename;
-    std::unique_ptr<Texture> texture;
+    ResourceHandle handle { InvalidResource };
+    // Acquired from the manager until the image is destroyed
+    Texture *texture { nullptr };
     Renderer *renderer { nullptr };
 };
@@ -12,6 +12,7 @@
 // of the License, or (at your option) any later version.
 
 #include "parseobject.h"
+#include "ephemeriscache.h"
 #include "frame.h"
 #include "trajmanager.h"
 #include "rotationmanager.h"
@@ -133,9 +134,10 @@ ParseDate(Hash* hash, const string& name, double& jd)
  *     Period is in Julian days
  *     SemiMajorAxis or PericenterDistance is in kilometers.
  */
-static EllipticalOrbit*
+static Orbit*
 CreateEllipticalOrbit(Hash* orbitData,
-                      bool usePlanetUnits)
+                      bool usePlanetUnits,
+                      EphemerisCache* cache)
 {
 
     // default units for planets are AU and years, otherwise km and days
@@ -203,6 +205,18 @@ CreateEllipticalOrbit(Hash* orbitData,
     if (semiMajorAxis != 0.0)
         pericenterDistance = semiMajorAxis * (1.0 - eccentricity);
 
+    if (cache != nullptr)
+    {
+        return cache->ellipticalOrbit(pericenterDistance,
+                                      eccentricity,
+                                      degToRad(inclination),
+                                      degToRad(ascendingNode),
+                                      degToRad(argOfPericenter),
+                                      degToRad(anomalyAtEpoch),
+                                      period,
+                                      epoch);
+    }
+
     return new EllipticalOrbit(pericenterDistance,
                                eccentricity,
                                degToRad(inclination),
@@ -258,7 +272,8 @@ CreateSampledTrajectory(Hash* trajData, const fs::path& path)
 
     GetLogger()->verbose("Attempting to load sampled trajectory from source '{}'\n", sourceName);
     ResourceHandle orbitHandle = GetTrajectoryManager()->getHandle(TrajectoryInfo(sourceName, path, interpolation, precision));
-    Orbit* orbit = GetTrajectoryManager()->find(orbitHandle);
+    // Bodies keep the pointer, so the trajectory is never evicted
+    Orbit* orbit = GetTrajectoryManager()->acquire(orbitHandle);
     if (orbit == nullptr)
     {
         GetLogger()->error("Could not load sampled trajectory from '{}'\n", sourceName);
@@ -282,7 +297,14 @@ CreateSampledTrajectory(Hash* trajData, const fs::path& path)
  * is BodyFixed.
  */
 static Orbit*
-CreateFixedPosition(Hash* trajData, const Selection& centralObject, bool usePlanetUnits)
+NewFixedOrbit(const Vector3d& position, EphemerisCache* cache)
+{
+    return cache != nullptr ? cache->fixedOrbit(position) : new FixedOrbit(position);
+}
+
+
+static Orbit*
+CreateFixedPosition(Hash* trajData, const Selection& centralObject, bool usePlanetUnits, EphemerisCache* cache)
 {
     double distanceScale;
     GetDefaultUnits(usePlanetUnits, distanceScale);
@@ -324,7 +346,7 @@ CreateFixedPosition(Hash* trajData, const Selection& centralObject, bool usePlan
         return nullptr;
     }
 
-    return new FixedOrbit(position);
+    return NewFixedOrbit(position, cache);
 }
 
 
@@ -673,7 +695,8 @@ Orbit*
 CreateOrbit(const Selection& centralObject,
             Hash* planetData,
             const fs::path& path,
-            bool usePlanetUnits)
+            bool usePlanetUnits,
+            EphemerisCache* cache)
 {
     Orbit* orbit = nullptr;
 
@@ -750,7 +773,7 @@ CreateOrbit(const Selection& centralObject,
                                                              path,
                                                              TrajectoryInterpolationCubic,
                                                              TrajectoryPrecisionSingle));
-        orbit = GetTrajectoryManager()->find(orbitHandle);
+        orbit = GetTrajectoryManager()->acquire(orbitHandle);
         if (orbit != nullptr)
         {
             return orbit;
@@ -768,7 +791,8 @@ CreateOrbit(const Selection& centralObject,
         }
 
         return CreateEllipticalOrbit(orbitDataValue->getHash(),
-                                     usePlanetUnits);
+                                     usePlanetUnits,
+                                     cache);
     }
 
     // Create an 'orbit' that places the object at a fixed point in its
@@ -798,11 +822,11 @@ CreateOrbit(const Selection& centralObject,
                                      fixedPosition.z(),
                                      -fixedPosition.y());
 
-            return new FixedOrbit(fixedPosition);
+            return NewFixedOrbit(fixedPosition, cache);
         }
         if (fixedPositionValue->getType() == Value::HashType)
         {
-            return CreateFixedPosition(fixedPositionValue->getHash(), centralObject, usePlanetUnits);
+            return CreateFixedPosition(fixedPositionValue->getHash(), centralObject, usePlanetUnits, cache);
         }
 
         GetLogger()->error("Object has incorrect FixedPosition syntax.\n");
@@ -829,22 +853,46 @@ CreateOrbit(const Selection& centralObject,
 }
 
 
-static ConstantOrientation*
+static RotationModel*
+NewConstantOrientation(const Quaterniond& q, EphemerisCache* cache)
+{
+    return cache != nullptr ? cache->constantOrientation(q) : new ConstantOrientation(q);
+}
+
+
+static RotationModel*
+NewUniformRotationModel(double period,
+                        float offset,
+                        double epoch,
+                        float inclination,
+                        float ascendingNode,
+                        EphemerisCache* cache)
+{
+    if (cache != nullptr)
+        return cache->uniformRotation(period, offset, epoch, inclination, ascendingNode);
+
+    return new UniformRotationModel(period, offset, epoch, inclination, ascendingNode);
+}
+
+
+static RotationModel*
 CreateFixedRotationModel(double offset,
                          double inclination,
-                         double ascendingNode)
+                         double ascendingNode,
+                         EphemerisCache* cache)
 {
     Quaterniond q = YRotation(-celestia::numbers::pi - offset) *
                     XRotation(-inclination) *
                     YRotation(-ascendingNode);
 
-    return new ConstantOrientation(q);
+    return NewConstantOrientation(q, cache);
 }
 
 
 static RotationModel*
 CreateUniformRotationModel(Hash* rotationData,
-                           double syncRotationPeriod)
+                           double syncRotationPeriod,
+                           EphemerisCache* cache)
 {
     // Default to synchronous rotation
     double period = syncRotationPeriod;
@@ -877,21 +925,22 @@ CreateUniformRotationModel(Hash* rotationData,
     // orientation instead.
     if (period == 0.0)
     {
-        return CreateFixedRotationModel(offset, inclination, ascendingNode);
+        return CreateFixedRotationModel(offset, inclination, ascendingNode, cache);
     }
     else
     {
-        return new UniformRotationModel(period,
-                                        offset,
-                                        epoch,
-                                        inclination,
-                                        ascendingNode);
+        return NewUniformRotationModel(period,
+                                       offset,
+                                       epoch,
+                                       inclination,
+                                       ascendingNode,
+                                       cache);
     }
 }
 
 
-static ConstantOrientation*
-CreateFixedRotationModel(Hash* rotationData)
+static RotationModel*
+CreateFixedRotationModel(Hash* rotationData, EphemerisCache* cache)
 {
     double offset = 0.0;
     if (rotationData->getAngle("MeridianAngle", offset))
@@ -915,12 +964,12 @@ CreateFixedRotationModel(Hash* rotationData)
                     XRotation(-inclination) *
                     YRotation(-ascendingNode);
 
-    return new ConstantOrientation(q);
+    return NewConstantOrientation(q, cache);
 }
 
 
-static ConstantOrientation*
-CreateFixedAttitudeRotationModel(Hash* rotationData)
+static RotationModel*
+CreateFixedAttitudeRotationModel(Hash* rotationData, EphemerisCache* cache)
 {
     double heading = 0.0;
     if (rotationData->getAngle("Heading", heading))
@@ -944,13 +993,14 @@ CreateFixedAttitudeRotationModel(Hash* rotationData)
                     XRotation(-tilt) *
                     ZRotation(-roll);
 
-    return new ConstantOrientation(q);
+    return NewConstantOrientation(q, cache);
 }
 
 
 static RotationModel*
 CreatePrecessingRotationModel(Hash* rotationData,
-                              double syncRotationPeriod)
+                              double syncRotationPeriod,
+                              EphemerisCache* cache)
 {
     // Default to synchronous rotation
     double period = syncRotationPeriod;
@@ -988,7 +1038,7 @@ CreatePrecessingRotationModel(Hash* rotationData,
     // orientation instead.
     if (period == 0.0)
     {
-        return CreateFixedRotationModel(offset, inclination, ascendingNode);
+        return CreateFixedRotationModel(offset, inclination, ascendingNode, cache);
     }
     else
     {
@@ -1047,7 +1097,8 @@ CreateScriptedRotation(Hash* rotationData,
 RotationModel*
 CreateRotationModel(Hash* planetData,
                     const fs::path& path,
-                    double syncRotationPeriod)
+                    double syncRotationPeriod,
+                    EphemerisCache* cache)
 {
     RotationModel* rotationModel = nullptr;
 
@@ -1133,7 +1184,8 @@ CreateRotationModel(Hash* planetData,
         }
 
         return CreatePrecessingRotationModel(precessingRotationValue->getHash(),
-                                             syncRotationPeriod);
+                                             syncRotationPeriod,
+                                             cache);
     }
 
     Value* uniformRotationValue = planetData->getValue("UniformRotation");
@@ -1145,7 +1197,8 @@ CreateRotationModel(Hash* planetData,
             return nullptr;
         }
         return CreateUniformRotationModel(uniformRotationValue->getHash(),
-                                          syncRotationPeriod);
+                                          syncRotationPeriod,
+                                          cache);
     }
 
     Value* fixedRotationValue = planetData->getValue("FixedRotation");
@@ -1157,7 +1210,7 @@ CreateRotationModel(Hash* planetData,
             return nullptr;
         }
 
-        return CreateFixedRotationModel(fixedRotationValue->getHash());
+        return CreateFixedRotationModel(fixedRotationValue->getHash(), cache);
     }
 
     Value* fixedAttitudeValue = planetData->getValue("FixedAttitude");
@@ -1169,7 +1222,7 @@ CreateRotationModel(Hash* planetData,
             return nullptr;
         }
 
-        return CreateFixedAttitudeRotationModel(fixedAttitudeValue->getHash());
+        return CreateFixedAttitudeRotationModel(fixedAttitudeValue->getHash(), cache);
     }
 
     // For backward compatibility we need to support rotation parameters
@@ -1225,15 +1278,16 @@ CreateRotationModel(Hash* planetData,
             // rotation period is zero, indicating that the object
             // doesn't have a periodic orbit. Default to a constant
             // orientation instead.
-            rm = CreateFixedRotationModel(offset, inclination, ascendingNode);
+            rm = CreateFixedRotationModel(offset, inclination, ascendingNode, cache);
         }
         else if (precessionRate == 0.0)
         {
-            rm = new UniformRotationModel(period,
-                                          offset,
-                                          epoch,
-                                          inclination,
-                                          ascendingNode);
+            rm = NewUniformRotationModel(period,
+                                         offset,
+                                         epoch,
+                                         inclination,
+                                         ascendingNode,
+                                         cache);
         }
         else
         {
@@ -1255,21 +1309,22 @@ CreateRotationModel(Hash* planetData,
 }
 
 
-RotationModel* CreateDefaultRotationModel(double syncRotationPeriod)
+RotationModel* CreateDefaultRotationModel(double syncRotationPeriod, EphemerisCache* cache)
 {
     if (syncRotationPeriod == 0.0)
     {
         // If syncRotationPeriod is 0, the orbit of the object is
         // aperiodic and we'll just return a FixedRotation.
-        return new ConstantOrientation(Quaterniond::Identity());
+        return NewConstantOrientation(Quaterniond::Identity(), cache);
     }
     else
     {
-        return new UniformRotationModel(syncRotationPeriod,
-                                        0.0f,
-                                        astro::J2000,
-                                        0.0f,
-                                        0.0f);
+        return NewUniformRotationModel(syncRotationPeriod,
+                                       0.0f,
+                                       astro::J2000,
+                                       0.0f,
+                                       0.0f,
+                                       cache);
     }
 }
 
@@ -1304,7 +1359,7 @@ getFrameCenter(const Universe& universe, Hash* frameData, const Selection& defau
 }
 
 
-static BodyFixedFrame::SharedConstPtr
+static ReferenceFrame::SharedConstPtr
 CreateBodyFixedFrame(const Universe& universe,
                      Hash* frameData,
                      const Selection& defaultCenter)
@@ -1313,7 +1368,7 @@ CreateBodyFixedFrame(const Universe& universe,
     if (center.empty())
         return nullptr;
 
-    return shared_ptr<BodyFixedFrame>(new BodyFixedFrame(center, center));
+    return universe.getEphemerisCache()->bodyFixedFrame(center, center);
 }
 
 
@@ -1636,7 +1691,7 @@ CreateTwoVectorFrame(const Universe& universe,
 }
 
 
-static shared_ptr<const J2000EclipticFrame>
+static ReferenceFrame::SharedConstPtr
 CreateJ2000EclipticFrame(const Universe& universe,
                          Hash* frameData,
                          const Selection& defaultCenter)
@@ -1646,11 +1701,11 @@ CreateJ2000EclipticFrame(const Universe& universe,
     if (center.empty())
         return nullptr;
 
-    return shared_ptr<J2000EclipticFrame>(new J2000EclipticFrame(center));
+    return universe.getEphemerisCache()->j2000EclipticFrame(center);
 }
 
 
-static shared_ptr<const J2000EquatorFrame>
+static ReferenceFrame::SharedConstPtr
 CreateJ2000EquatorFrame(const Universe& universe,
                         Hash* frameData,
                         const Selection& defaultCenter)
@@ -1660,7 +1715,7 @@ CreateJ2000EquatorFrame(const Universe& universe,
     if (center.empty())
         return nullptr;
 
-    return shared_ptr<J2000EquatorFrame>(new J2000EquatorFrame(center));
+    return universe.getEphemerisCache()->j2000EquatorFrame(center);
 }
 
 
@@ -22,6 +22,7 @@
 #include "parser.h"
 
 class Body;
+class EphemerisCache;
 class Star;
 class Universe;
 class Selection;
@@ -36,16 +37,25 @@ enum class DataDisposition
 
 bool ParseDate(Hash* hash, const std::string& name, double& jd);
 
+// With a cache, the simple orbits and rotation models are shared with the
+// other objects defining them with the same parameters, see EphemerisCache;
+// the caller mustn't delete them.
 Orbit* CreateOrbit(const Selection& centralObject,
                    Hash* planetData,
                    const fs::path& path,
-                   bool usePlanetUnits);
+                   bool usePlanetUnits,
+                   EphemerisCache* cache = nullptr);
 
 RotationModel* CreateRotationModel(Hash* rotationData,
                                    const fs::path& path,
-                                   double syncRotationPeriod);
+                                   double syncRotationPeriod,
+                                   EphemerisCache* cache = nullptr);
 
-RotationModel* CreateDefaultRotationModel(double syncRotationPeriod);
+RotationModel* CreateDefaultRotationModel(double syncRotationPeriod,
+                                          EphemerisCache* cache = nullptr);
+
+// The body-fixed and J2000 frames are shared through the ephemeris cache
+// of the universe
 
 ReferenceFrame::SharedConstPtr CreateReferenceFrame(const Universe& universe,
                                      Value* frameValue,
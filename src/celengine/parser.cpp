@@ -8,8 +8,13 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <istream>
+#include <ostream>
 #include <string_view>
+#include <utility>
 
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
 #include <celutil/tokenizer.h>
 #include "astro.h"
 #include "parser.h"
@@ -19,6 +24,8 @@ using namespace std;
 using namespace Eigen;
 using namespace celmath;
 
+namespace celutil = celestia::util;
+
 
 /****** Parser method implementation ******/
 
@@ -28,6 +35,13 @@ Parser::Parser(Tokenizer* _tokenizer) :
 }
 
 
+Parser::Parser(Tokenizer* _tokenizer, PreparsedCatalog* _preparsed) :
+    tokenizer(_tokenizer),
+    preparsed(_preparsed)
+{
+}
+
+
 ValueArray* Parser::readArray()
 {
     Tokenizer::TokenType tok = tokenizer->nextToken();
@@ -187,6 +201,8 @@ Value* Parser::readValue()
         }
 
     case Tokenizer::TokenBeginArray:
+        if (preparsed != nullptr)
+            return preparsed->takeValue(tokenizer->getRecordedIndex());
         tokenizer->pushBack();
         {
             auto* array = readArray();
@@ -197,6 +213,8 @@ Value* Parser::readValue()
         }
 
     case Tokenizer::TokenBeginGroup:
+        if (preparsed != nullptr)
+            return preparsed->takeValue(tokenizer->getRecordedIndex());
         tokenizer->pushBack();
         {
             Hash* hash = readHash();
@@ -211,3 +229,347 @@ Value* Parser::readValue()
         return nullptr;
     }
 }
+
+
+/****** PreparsedCatalog method implementation ******/
+
+namespace
+{
+constexpr const char PREPARSED_CATALOG_HEADER[] = "CELPCAT";
+constexpr const std::uint16_t PREPARSED_CATALOG_VERSION = 0x0100;
+
+/* Catalog file layout, all values little-endian:
+ *
+ *   header    "CELPCAT"
+ *   uint16    version
+ *   uint64    key of the source file
+ *   uint32    token count
+ *   tokens    uint8 type, int32 line number, then
+ *             names and strings:  string text
+ *             numbers:            string text, float64 value
+ *             groups and arrays:  uint8 1 followed by the value, or 0
+ *
+ * Strings are a uint32 length followed by the bytes. A value is its
+ * uint8 Value::ValueType followed by a float64 number, a string, a uint8
+ * boolean, a uint32 count and the array elements, or a uint32 count and
+ * the key string and value of each hash entry.
+ */
+
+bool hasText(Tokenizer::TokenType type)
+{
+    return type == Tokenizer::TokenName
+        || type == Tokenizer::TokenString
+        || type == Tokenizer::TokenNumber;
+}
+
+
+bool hasValue(Tokenizer::TokenType type)
+{
+    return type == Tokenizer::TokenBeginGroup || type == Tokenizer::TokenBeginArray;
+}
+
+
+bool writeString(std::ostream& out, std::string_view s)
+{
+    return celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(s.size()))
+        && out.write(s.data(), s.size()).good();
+}
+
+
+bool writeValue(std::ostream& out, const Value& value)
+{
+    if (!celutil::writeLE<std::uint8_t>(out, static_cast<std::uint8_t>(value.getType())))
+        return false;
+
+    switch (value.getType())
+    {
+    case Value::NumberType:
+        return celutil::writeLE<double>(out, value.getNumber());
+    case Value::StringType:
+        return writeString(out, value.getString());
+    case Value::BooleanType:
+        return celutil::writeLE<std::uint8_t>(out, value.getBoolean() ? 1 : 0);
+    case Value::ArrayType:
+        if (!celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(value.getArray()->size())))
+            return false;
+        for (const Value* element : *value.getArray())
+        {
+            if (!writeValue(out, *element))
+                return false;
+        }
+        return true;
+    case Value::HashType:
+        if (!celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(std::distance(value.getHash()->begin(),
+                                                                                               value.getHash()->end()))))
+            return false;
+        for (const auto& entry : *value.getHash())
+        {
+            if (!writeString(out, entry.first) || !writeValue(out, *entry.second))
+                return false;
+        }
+        return true;
+    default:
+        return true;
+    }
+}
+
+
+// Bounds checked reading from a saved catalog
+class CatalogReader
+{
+ public:
+    explicit CatalogReader(std::string_view data) :
+        ptr(data.data()),
+        end(data.data() + data.size())
+    {
+    }
+
+    template<typename T> bool read(T& value)
+    {
+        if (static_cast<std::size_t>(end - ptr) < sizeof(T))
+            return false;
+        value = celutil::fromMemoryLE<T>(ptr);
+        ptr += sizeof(T);
+        return true;
+    }
+
+    bool readString(std::string_view& s)
+    {
+        std::uint32_t length;
+        if (!read(length) || static_cast<std::size_t>(end - ptr) < length)
+            return false;
+        s = std::string_view(ptr, length);
+        ptr += length;
+        return true;
+    }
+
+    bool atEnd() const { return ptr == end; }
+
+ private:
+    const char* ptr;
+    const char* end;
+};
+
+
+std::unique_ptr<Value> readValue(CatalogReader& reader)
+{
+    std::uint8_t type;
+    if (!reader.read(type))
+        return nullptr;
+
+    switch (type)
+    {
+    case Value::NullType:
+        return std::make_unique<Value>();
+    case Value::NumberType:
+        {
+            double d;
+            return reader.read(d) ? std::make_unique<Value>(d) : nullptr;
+        }
+    case Value::StringType:
+        {
+            std::string_view s;
+            return reader.readString(s) ? std::make_unique<Value>(s) : nullptr;
+        }
+    case Value::BooleanType:
+        {
+            std::uint8_t b;
+            return reader.read(b) ? std::make_unique<Value>(b != 0) : nullptr;
+        }
+    case Value::ArrayType:
+        {
+            std::uint32_t count;
+            if (!reader.read(count))
+                return nullptr;
+            auto value = std::make_unique<Value>(new ValueArray());
+            for (std::uint32_t i = 0; i < count; i++)
+            {
+                std::unique_ptr<Value> element = readValue(reader);
+                if (element == nullptr)
+                    return nullptr;
+                value->getArray()->push_back(element.release());
+            }
+            return value;
+        }
+    case Value::HashType:
+        {
+            std::uint32_t count;
+            if (!reader.read(count))
+                return nullptr;
+            auto value = std::make_unique<Value>(new Hash());
+            for (std::uint32_t i = 0; i < count; i++)
+            {
+                std::string_view key;
+                if (!reader.readString(key))
+                    return nullptr;
+                std::unique_ptr<Value> element = readValue(reader);
+                if (element == nullptr)
+                    return nullptr;
+                value->getHash()->addValue(std::string(key), *element.release());
+            }
+            return value;
+        }
+    default:
+        return nullptr;
+    }
+}
+} // end unnamed namespace
+
+
+PreparsedCatalog::PreparsedCatalog(std::istream& in)
+{
+    Tokenizer tokenizer(&in);
+    read(tokenizer);
+}
+
+
+PreparsedCatalog::PreparsedCatalog(std::string_view buffer)
+{
+    Tokenizer tokenizer(buffer);
+    read(tokenizer);
+}
+
+
+PreparsedCatalog::~PreparsedCatalog()
+{
+    for (Value* value : values)
+        delete value;
+}
+
+
+void PreparsedCatalog::read(Tokenizer& tokenizer)
+{
+    Parser parser(&tokenizer);
+
+    for (;;)
+    {
+        Tokenizer::TokenType tok = tokenizer.nextToken();
+        Value* value = nullptr;
+        if (tok == Tokenizer::TokenBeginArray || tok == Tokenizer::TokenBeginGroup)
+        {
+            tokenizer.pushBack();
+            value = parser.readValue();
+        }
+
+        // Groups are recorded with the line they end on, which is where the
+        // loaders report errors in the objects they define.
+        tokens.push_back({ tok,
+                           std::string(tokenizer.getStringValue()),
+                           tokenizer.getNumberValue(),
+                           tokenizer.getLineNumber() });
+        values.push_back(value);
+
+        // The loaders give up at the first unreadable group, so there's no
+        // point reading past one.
+        if (tok == Tokenizer::TokenEnd || tok == Tokenizer::TokenError ||
+            ((tok == Tokenizer::TokenBeginArray || tok == Tokenizer::TokenBeginGroup) && value == nullptr))
+        {
+            break;
+        }
+    }
+}
+
+
+Value* PreparsedCatalog::takeValue(std::size_t index)
+{
+    return index < values.size() ? std::exchange(values[index], nullptr) : nullptr;
+}
+
+
+bool PreparsedCatalog::write(std::ostream& out, std::uint64_t key) const
+{
+    out.write(PREPARSED_CATALOG_HEADER, sizeof(PREPARSED_CATALOG_HEADER) - 1);
+    if (!out.good()
+        || !celutil::writeLE<std::uint16_t>(out, PREPARSED_CATALOG_VERSION)
+        || !celutil::writeLE<std::uint64_t>(out, key)
+        || !celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(tokens.size())))
+    {
+        return false;
+    }
+
+    for (std::size_t i = 0; i < tokens.size(); i++)
+    {
+        const Tokenizer::RecordedToken& token = tokens[i];
+        if (!celutil::writeLE<std::uint8_t>(out, static_cast<std::uint8_t>(token.type))
+            || !celutil::writeLE<std::int32_t>(out, token.lineNumber))
+        {
+            return false;
+        }
+
+        if (hasText(token.type) && !writeString(out, token.text))
+            return false;
+        if (token.type == Tokenizer::TokenNumber && !celutil::writeLE<double>(out, token.value))
+            return false;
+        if (hasValue(token.type))
+        {
+            if (!celutil::writeLE<std::uint8_t>(out, values[i] == nullptr ? 0 : 1))
+                return false;
+            if (values[i] != nullptr && !writeValue(out, *values[i]))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+
+std::unique_ptr<PreparsedCatalog> PreparsedCatalog::read(std::string_view data, std::uint64_t key)
+{
+    constexpr std::size_t headerLength = sizeof(PREPARSED_CATALOG_HEADER) - 1;
+    if (data.substr(0, headerLength) != std::string_view(PREPARSED_CATALOG_HEADER, headerLength))
+        return nullptr;
+
+    CatalogReader reader(data.substr(headerLength));
+    std::uint16_t version;
+    std::uint64_t savedKey;
+    std::uint32_t nTokens;
+    if (!reader.read(version) || version != PREPARSED_CATALOG_VERSION
+        || !reader.read(savedKey) || savedKey != key
+        || !reader.read(nTokens))
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr<PreparsedCatalog> catalog(new PreparsedCatalog());
+    for (std::uint32_t i = 0; i < nTokens; i++)
+    {
+        std::uint8_t type;
+        Tokenizer::RecordedToken token{ Tokenizer::TokenBegin, {}, std::nan(""), 0 };
+        if (!reader.read(type) || type > Tokenizer::TokenEndUnits || !reader.read(token.lineNumber))
+            return nullptr;
+        token.type = static_cast<Tokenizer::TokenType>(type);
+
+        if (hasText(token.type))
+        {
+            std::string_view text;
+            if (!reader.readString(text))
+                return nullptr;
+            token.text = text;
+        }
+        if (token.type == Tokenizer::TokenNumber && !reader.read(token.value))
+            return nullptr;
+
+        Value* value = nullptr;
+        if (hasValue(token.type))
+        {
+            std::uint8_t present;
+            if (!reader.read(present))
+                return nullptr;
+            if (present != 0)
+            {
+                std::unique_ptr<Value> v = readValue(reader);
+                if (v == nullptr)
+                    return nullptr;
+                value = v.release();
+            }
+        }
+
+        catalog->tokens.push_back(std::move(token));
+        catalog->values.push_back(value);
+    }
+
+    if (!reader.atEnd())
+        return nullptr;
+
+    return catalog;
+}
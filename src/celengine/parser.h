@@ -10,23 +10,75 @@
 
 #pragma once
 
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include <celutil/tokenizer.h>
 #include "hash.h"
 #include "value.h"
 
-class Tokenizer;
+class PreparsedCatalog;
 class Value;
 
 class Parser
 {
  public:
     Parser(Tokenizer*);
+    // Parse a tokenizer replaying a preparsed catalog's tokens
+    Parser(Tokenizer*, PreparsedCatalog*);
 
     Value* readValue();
 
  private:
     Tokenizer* tokenizer;
+    PreparsedCatalog* preparsed{ nullptr };
 
     bool readUnits(const std::string&, Hash*);
     Array* readArray();
     Hash* readHash();
 };
+
+
+/*! A catalog file with its top-level groups and arrays already parsed.
+ *  Parsing is the costly part of loading a catalog, and it doesn't touch
+ *  any shared state, so catalogs can be preparsed on worker threads and
+ *  then loaded in order. The loader reads it through a replay tokenizer
+ *  and a Parser constructed from the catalog.
+ */
+class PreparsedCatalog
+{
+ public:
+    explicit PreparsedCatalog(std::istream&);
+    explicit PreparsedCatalog(std::string_view buffer);
+    ~PreparsedCatalog();
+
+    PreparsedCatalog(const PreparsedCatalog&) = delete;
+    PreparsedCatalog& operator=(const PreparsedCatalog&) = delete;
+
+    const std::vector<Tokenizer::RecordedToken>* getTokens() const { return &tokens; }
+
+    /*! Save the catalog in binary form together with a key identifying
+     *  its source. Must be called before the catalog is loaded, which
+     *  hands its values over to the loader.
+     */
+    bool write(std::ostream&, std::uint64_t key) const;
+    /*! Load a catalog saved by write(). Returns null if the data is
+     *  damaged or was saved with a different key.
+     */
+    static std::unique_ptr<PreparsedCatalog> read(std::string_view data, std::uint64_t key);
+
+ private:
+    PreparsedCatalog() = default;
+
+    void read(Tokenizer&);
+    // Hand over the value parsed at a token; null if parsing failed
+    Value* takeValue(std::size_t index);
+
+    std::vector<Tokenizer::RecordedToken> tokens;
+    // Parsed value for each group or array token, null for other tokens
+    std::vector<Value*> values;
+
+    friend class Parser;
+};
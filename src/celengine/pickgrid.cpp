@@ -0,0 +1,165 @@
+// pickgrid.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Screen space index of the stars drawn in a frame, for picking.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "pickgrid.h"
+
+namespace
+{
+// The observer may move by this fraction of the pick angle times the
+// distance of the closest star, so that no star shifts by more than this
+// fraction of the pick angle
+constexpr float ParallaxFraction = 0.01f;
+}
+
+PickGrid::PickGrid(unsigned int _rows) :
+    rows(std::max(_rows, 1u))
+{
+}
+
+void PickGrid::begin(const Eigen::Vector3d& _position,
+                     const Eigen::Quaternionf& _orientation,
+                     float fovY,
+                     float aspectRatio,
+                     float _limitingMag)
+{
+    clear();
+    position = _position;
+    orientation = _orientation;
+    tanY = std::tan(fovY / 2.0f);
+    tanX = tanY * aspectRatio;
+    columns = std::max(static_cast<unsigned int>(std::ceil(rows * aspectRatio)), 1u);
+    limitingMag = _limitingMag;
+    minDistance = std::numeric_limits<float>::max();
+}
+
+void PickGrid::add(const Star* star, const Eigen::Vector3f& relPos, float appMag)
+{
+    Eigen::Vector3f v = orientation * relPos;
+    if (v.z() >= 0.0f)
+        return;
+
+    Eigen::Vector2f p = project(v);
+    if (std::abs(p.x()) > tanX || std::abs(p.y()) > tanY)
+        return;
+
+    float distance = relPos.norm();
+    minDistance = std::min(minDistance, distance);
+    points.push_back({ star, relPos / distance, appMag });
+    pointCells.push_back(static_cast<std::uint32_t>(row(p.y()) * columns + column(p.x())));
+}
+
+void PickGrid::finish()
+{
+    // Counting sort of the points by cell
+    cellStarts.assign(rows * columns + 1, 0);
+    for (std::uint32_t cell : pointCells)
+        cellStarts[cell + 1]++;
+    for (std::size_t i = 1; i < cellStarts.size(); i++)
+        cellStarts[i] += cellStarts[i - 1];
+
+    sorted.resize(points.size());
+    std::vector<std::uint32_t> next(cellStarts.begin(), cellStarts.end() - 1);
+    for (std::size_t i = 0; i < points.size(); i++)
+        sorted[next[pointCells[i]]++] = static_cast<std::uint32_t>(i);
+
+    pointCells.clear();
+    finished = true;
+}
+
+void PickGrid::clear()
+{
+    points.clear();
+    pointCells.clear();
+    cellStarts.clear();
+    sorted.clear();
+    finished = false;
+}
+
+int PickGrid::column(float x) const
+{
+    auto c = static_cast<int>(std::floor((x + tanX) / (2.0f * tanX) * columns));
+    return std::clamp(c, 0, static_cast<int>(columns) - 1);
+}
+
+int PickGrid::row(float y) const
+{
+    auto r = static_cast<int>(std::floor((y + tanY) / (2.0f * tanY) * rows));
+    return std::clamp(r, 0, static_cast<int>(rows) - 1);
+}
+
+bool PickGrid::pick(const Eigen::Vector3d& pickPosition,
+                    const Eigen::Vector3f& direction,
+                    float angle,
+                    float faintestMag,
+                    const Star*& star) const
+{
+    star = nullptr;
+    if (!finished || faintestMag > limitingMag)
+        return false;
+
+    // Without any stars there's no bound on the parallax, so the observer
+    // mustn't have moved at all
+    auto shift = static_cast<float>((pickPosition - position).norm());
+    if (points.empty() ? shift > 0.0f : shift > ParallaxFraction * angle * minDistance)
+        return false;
+
+    // All of the cone around the ray must lie inside the four side planes
+    // of the frame, or stars outside of it could be closer
+    Eigen::Vector3f v = orientation * direction;
+    float sinAngle = std::sin(angle);
+    float normX = std::sqrt(1.0f + tanX * tanX);
+    float normY = std::sqrt(1.0f + tanY * tanY);
+    if ((-tanX * v.z() - std::abs(v.x())) / normX < sinAngle ||
+        (-tanY * v.z() - std::abs(v.y())) / normY < sinAngle)
+    {
+        return false;
+    }
+
+    // The image plane scale grows with the square of the secant of the
+    // angle off the view axis; bound it by the edge of the cone farthest
+    // from the axis
+    float offAxis = std::acos(std::clamp(-v.z(), -1.0f, 1.0f));
+    float cosMax = std::cos(offAxis + angle);
+    float radius = angle / (cosMax * cosMax) * 1.001f;
+
+    Eigen::Vector2f p = project(v);
+    int firstColumn = column(p.x() - radius);
+    int lastColumn = column(p.x() + radius);
+    int firstRow = row(p.y() - radius);
+    int lastRow = row(p.y() + radius);
+
+    // Same measure as StarPicker: the sine of half the angle to the ray
+    float sinAngle2Closest = std::sin(angle / 2.0f);
+    for (int r = firstRow; r <= lastRow; r++)
+    {
+        std::uint32_t rowStart = static_cast<std::uint32_t>(r) * columns;
+        std::uint32_t first = cellStarts[rowStart + firstColumn];
+        std::uint32_t last = cellStarts[rowStart + lastColumn + 1];
+        for (std::uint32_t i = first; i < last; i++)
+        {
+            const Point& point = points[sorted[i]];
+            if (point.appMag >= faintestMag)
+                continue;
+
+            float sinAngle2 = (point.direction - direction).norm() / 2.0f;
+            if (sinAngle2 <= sinAngle2Closest)
+            {
+                sinAngle2Closest = sinAngle2;
+                star = point.star;
+            }
+        }
+    }
+
+    return true;
+}
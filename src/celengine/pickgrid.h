@@ -0,0 +1,100 @@
+// pickgrid.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Screen space index of the stars drawn in a frame, for picking.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+class Star;
+
+// PickGrid keeps the directions of the stars drawn in a frame, sorted into
+// the cells of a uniform grid over the image plane, so that a click on the
+// same view is resolved by testing the few stars close to the pick ray
+// instead of traversing the star octree.
+class PickGrid
+{
+ public:
+    explicit PickGrid(unsigned int _rows = 64);
+
+    // Start recording a frame drawn from position (in light years) with
+    // the given orientation, vertical field of view in radians and aspect
+    // ratio. Stars of magnitude limitingMag or fainter aren't drawn.
+    void begin(const Eigen::Vector3d& _position,
+               const Eigen::Quaternionf& _orientation,
+               float fovY,
+               float aspectRatio,
+               float _limitingMag);
+    // Record a star drawn at relPos relative to the observer; stars
+    // outside of the frame are ignored.
+    void add(const Star* star, const Eigen::Vector3f& relPos, float appMag);
+    // Sort the recorded stars into the cells; the grid can only be picked
+    // from after this.
+    void finish();
+    void clear();
+
+    // Find the star closest to the ray from position along the unit vector
+    // direction, within angle radians and brighter than faintestMag. The
+    // result is false when the recorded frame can't answer the query
+    // because the observer has moved, the cone around the ray leaves the
+    // frame or fainter stars are asked for than were drawn; otherwise star
+    // is the star found, or null if there is none.
+    bool pick(const Eigen::Vector3d& pickPosition,
+              const Eigen::Vector3f& direction,
+              float angle,
+              float faintestMag,
+              const Star*& star) const;
+
+    std::size_t size() const { return points.size(); }
+
+ private:
+    struct Point
+    {
+        const Star* star;
+        Eigen::Vector3f direction;
+        float appMag;
+    };
+
+    // Image plane coordinates of the view space direction v, at unit
+    // distance in front of the observer
+    static Eigen::Vector2f project(const Eigen::Vector3f& v)
+    {
+        return Eigen::Vector2f(v.x(), v.y()) / -v.z();
+    }
+
+    int column(float x) const;
+    int row(float y) const;
+
+    unsigned int rows;
+    unsigned int columns{ 0 };
+    bool finished{ false };
+
+    Eigen::Vector3d position{ Eigen::Vector3d::Zero() };
+    Eigen::Quaternionf orientation{ Eigen::Quaternionf::Identity() };
+    // Half extents of the frame in the image plane
+    float tanX{ 0.0f };
+    float tanY{ 0.0f };
+    float limitingMag{ 0.0f };
+    // Distance of the closest star recorded, which bounds the parallax
+    // of an observer movement
+    float minDistance{ 0.0f };
+
+    std::vector<Point> points;
+    // Index of each point's cell while recording
+    std::vector<std::uint32_t> pointCells;
+    // Points sorted by cell; the points of cell i are
+    // [cellStarts[i], cellStarts[i + 1]) in sorted
+    std::vector<std::uint32_t> cellStarts;
+    std::vector<std::uint32_t> sorted;
+};
@@ -19,6 +19,7 @@
 #include "planetgrid.h"
 #include "render.h"
 #include "vecgl.h"
+#include "vertexobject.h"
 
 using namespace std;
 using namespace Eigen;
@@ -26,16 +27,53 @@ using namespace celmath;
 using namespace celestia;
 
 
-unsigned int PlanetographicGrid::circleSubdivisions = 100;
-std::vector<LineStripEnd> PlanetographicGrid::xyCircle;
-std::vector<LineStripEnd> PlanetographicGrid::xzCircle;
+namespace
+{
+
+constexpr unsigned int CircleSubdivisions = 100;
+
+// Number of line strip ends of a circle: two per point, and one point
+// more than the subdivisions, plus another so that the next point of the
+// last one exists
+constexpr GLsizei CircleLength = (CircleSubdivisions + 2) * 2;
+
+// Both circles are the same for all bodies, so they're kept in a static
+// buffer shared by the grids, a unit circle in the xz plane followed by
+// one in the xy plane. The lines of a grid are drawn from them with
+// transformations; as line strips, the two ends of a point are joined
+// by segments of zero length.
+void
+initGridVO(celgl::VertexObject& vo)
+{
+    std::vector<LineStripEnd> vertices;
+    vertices.reserve(CircleLength * 2);
+    for (int plane = 0; plane < 2; plane++)
+    {
+        for (unsigned int i = 0; i <= CircleSubdivisions + 1; i++)
+        {
+            float theta = (float) (2.0 * celestia::numbers::pi) * (float) i / (float) CircleSubdivisions;
+            float s, c;
+            sincos(theta, s, c);
+            Vector3f point = plane == 0 ? Vector3f(c, 0.0f, s) : Vector3f(c, s, 0.0f);
+            vertices.emplace_back(point, -0.5f);
+            vertices.emplace_back(point,  0.5f);
+        }
+    }
+
+    vo.allocate(vertices.size() * sizeof(LineStripEnd), vertices.data());
+    vo.setVertices(3, GL_FLOAT, false, sizeof(LineStripEnd), offsetof(LineStripEnd, point));
+    vo.setVertexAttribArray(CelestiaGLProgram::NextVCoordAttributeIndex, 3, GL_FLOAT, false,
+                            sizeof(LineStripEnd), offsetof(LineStripEnd, point) + 2 * sizeof(LineStripEnd));
+    vo.setVertexAttribArray(CelestiaGLProgram::ScaleFactorAttributeIndex, 1, GL_FLOAT, false,
+                            sizeof(LineStripEnd), offsetof(LineStripEnd, scale));
+}
+
+} // end unnamed namespace
 
 
 PlanetographicGrid::PlanetographicGrid(const Body& _body) :
     body(_body)
 {
-    if (xyCircle.empty())
-        InitializeGeometry();
     setTag("planetographic grid");
     setIAULongLatConvention();
 }
@@ -135,23 +173,11 @@ PlanetographicGrid::render(Renderer* renderer,
     Matrix4f projection = *m.projection;
     Matrix4f modelView = *m.modelview * transform.matrix();
 
-    glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
-    if (lineAsTriangles)
-    {
-        glEnableVertexAttribArray(CelestiaGLProgram::NextVCoordAttributeIndex);
-        glEnableVertexAttribArray(CelestiaGLProgram::ScaleFactorAttributeIndex);
-        glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
-                              3, GL_FLOAT, GL_FALSE, sizeof(LineStripEnd), &xzCircle[0].point);
-        glVertexAttribPointer(CelestiaGLProgram::NextVCoordAttributeIndex,
-                              3, GL_FLOAT, GL_FALSE, sizeof(LineStripEnd), &xzCircle[2].point);
-        glVertexAttribPointer(CelestiaGLProgram::ScaleFactorAttributeIndex,
-                              1, GL_FLOAT, GL_FALSE, sizeof(LineStripEnd), &xzCircle[0].scale);
-    }
-    else
-    {
-        glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
-                              3, GL_FLOAT, GL_FALSE, sizeof(LineStripEnd) * 2, &xzCircle[0].point);
-    }
+    auto &vo = renderer->getVertexObject(VOType::PlanetGrid, GL_ARRAY_BUFFER, 0, GL_STATIC_DRAW);
+    vo.bind();
+    if (!vo.initialized())
+        initGridVO(vo);
+    GLenum primitive = lineAsTriangles ? GL_TRIANGLE_STRIP : GL_LINE_STRIP;
 
     // Only show the coordinate labels if the body is sufficiently large on screen
     bool showCoordinateLabels = false;
@@ -200,16 +226,9 @@ PlanetographicGrid::render(Renderer* renderer,
             }
         }
         prog->setMVPMatrices(projection, modelView * vecgl::translate(0.0f, sin(phi), 0.0f) * vecgl::scale(r));
-        if (lineAsTriangles)
-        {
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, xzCircle.size() - 2);
-        }
-        else
-        {
-            glDrawArrays(GL_LINE_STRIP, 0, (xzCircle.size() - 2) / 2);
-            if (latitude == 0.0f)
-                glLineWidth(renderer->getRasterizedLineWidth(1.0f));
-        }
+        vo.draw(primitive, CircleLength - 2);
+        if (!lineAsTriangles && latitude == 0.0f)
+            glLineWidth(renderer->getRasterizedLineWidth(1.0f));
 
         if (showCoordinateLabels)
         {
@@ -228,30 +247,12 @@ PlanetographicGrid::render(Renderer* renderer,
         }
     }
 
-    if (lineAsTriangles)
-    {
-        glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
-                              3, GL_FLOAT, GL_FALSE, sizeof(LineStripEnd), &xyCircle[0].point);
-        glVertexAttribPointer(CelestiaGLProgram::NextVCoordAttributeIndex,
-                              3, GL_FLOAT, GL_FALSE, sizeof(LineStripEnd), &xyCircle[2].point);
-        glVertexAttribPointer(CelestiaGLProgram::ScaleFactorAttributeIndex,
-                              1, GL_FLOAT, GL_FALSE, sizeof(LineStripEnd), &xyCircle[0].scale);
-    }
-    else
-    {
-        glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
-                              3, GL_FLOAT, GL_FALSE, sizeof(LineStripEnd) * 2, &xyCircle[0].point);
-    }
-
     glVertexAttrib(CelestiaGLProgram::ColorAttributeIndex,
                    Renderer::PlanetographicGridColor);
     for (float longitude = 0.0f; longitude <= 180.0f; longitude += longitudeStep)
     {
         prog->setMVPMatrices(projection, modelView * vecgl::rotate(AngleAxisf(degToRad(longitude), Vector3f::UnitY())));
-        if (lineAsTriangles)
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, xyCircle.size() - 2);
-        else
-            glDrawArrays(GL_LINE_STRIP, 0, (xyCircle.size() - 2) / 2);
+        vo.draw(primitive, CircleLength - 2, CircleLength);
 
         if (showCoordinateLabels)
         {
@@ -304,12 +305,7 @@ PlanetographicGrid::render(Renderer* renderer,
         }
     }
 
-    glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
-    if (lineAsTriangles)
-    {
-        glDisableVertexAttribArray(CelestiaGLProgram::NextVCoordAttributeIndex);
-        glDisableVertexAttribArray(CelestiaGLProgram::ScaleFactorAttributeIndex);
-    }
+    vo.unbind();
 }
 
 
@@ -347,22 +343,3 @@ PlanetographicGrid::setIAULongLatConvention()
     }
 }
 
-
-void
-PlanetographicGrid::InitializeGeometry()
-{
-    xyCircle.reserve((circleSubdivisions + 2) * 2);
-    xzCircle.reserve((circleSubdivisions + 2) * 2);
-    for (unsigned int i = 0; i <= circleSubdivisions + 1; i++)
-    {
-        float theta = (float) (2.0 * celestia::numbers::pi) * (float) i / (float) circleSubdivisions;
-        float s, c;
-        sincos(theta, s, c);
-        Vector3f thisPointXY(c, s, 0.0f);
-        Vector3f thisPointXZ(c, 0.0f, s);
-        xyCircle.emplace_back(thisPointXY, -0.5f);
-        xyCircle.emplace_back(thisPointXY,  0.5f);
-        xzCircle.emplace_back(thisPointXZ, -0.5f);
-        xzCircle.emplace_back(thisPointXZ,  0.5f);
-    }
-}
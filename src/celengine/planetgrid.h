@@ -16,7 +16,6 @@
 #include <celengine/referencemark.h>
 
 class Body;
-struct LineStripEnd;
 
 class PlanetographicGrid : public ReferenceMark
 {
@@ -58,9 +57,6 @@ public:
 
     void setIAULongLatConvention();
 
-private:
-    static void InitializeGeometry();
-
 private:
     const Body& body;
 
@@ -69,10 +65,6 @@ private:
 
     LongitudeConvention longitudeConvention{ Westward };
     NorthDirection northDirection{ NorthNormal };
-
-    static unsigned int circleSubdivisions;
-    static std::vector<LineStripEnd> xyCircle;
-    static std::vector<LineStripEnd> xzCircle;
 };
 
 #endif // _CELENGINE_PLANETGRID_H_
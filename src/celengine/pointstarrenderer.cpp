@@ -8,9 +8,13 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <celengine/astro.h>
 #include <celengine/starcolors.h>
 #include <celengine/star.h>
+#include <celengine/staroctree.h>
 #include <celengine/univcoord.h>
+#include "pickgrid.h"
 #include "pointstarvertexbuffer.h"
 #include "render.h"
 #include "pointstarrenderer.h"
@@ -18,14 +22,11 @@
 using namespace std;
 using namespace Eigen;
 
-// Convert a position in the universal coordinate system to astrocentric
-// coordinates, taking into account possible orbital motion of the star.
-static Vector3d astrocentricPosition(const UniversalCoord& pos,
-                                     const Star& star,
-                                     double t)
-{
-    return pos.offsetFromKm(star.getPosition(t));
-}
+// Number of stars processed together by PointStarRenderer::processBatch()
+static constexpr std::uint32_t StarBlockSize = 64;
+
+// Size of the buffers the names of labeled stars are written to
+static constexpr unsigned int LabelBufferSize = 128;
 
 PointStarRenderer::PointStarRenderer() :
     ObjectRenderer<Star, float>(StarDistanceLimit)
@@ -33,11 +34,121 @@ PointStarRenderer::PointStarRenderer() :
 }
 
 void PointStarRenderer::process(const Star& star, float distance, float appMag)
+{
+    if (gpuPoints && star.getOrbit() != nullptr)
+        return;
+    renderStar(star, distance, appMag);
+}
+
+void PointStarRenderer::processBatch(const Star* stars,
+                                     std::uint32_t nStars,
+                                     float dimmest,
+                                     float limitingMag)
+{
+    // Same selection as the star octree traversal, but without a virtual
+    // call per star. The stars of a node are sorted by absolute magnitude,
+    // so those bright enough are a prefix of the batch. They're handled in
+    // blocks: the distance and apparent magnitude are computed for a whole
+    // block in short loops without branches or calls, which the compiler
+    // can vectorize for the target, before the stars are rendered one by
+    // one.
+    float distances[StarBlockSize];
+    float appMags[StarBlockSize];
+
+    nStars = countBrighterStars(stars, nStars, dimmest);
+    Vector3f obsPosf = obsPos.cast<float>();
+    for (std::uint32_t blockStart = 0; blockStart < nStars; blockStart += StarBlockSize)
+    {
+        const Star* block = stars + blockStart;
+        std::uint32_t blockSize = std::min(StarBlockSize, nStars - blockStart);
+
+        for (std::uint32_t i = 0; i < blockSize; ++i)
+            distances[i] = (obsPosf - block[i].getPositionAfter(motionYears)).norm();
+
+        // Equivalent to Star::getApparentMagnitude(), inlined
+        for (std::uint32_t i = 0; i < blockSize; ++i)
+        {
+            const Star& star = block[i];
+            appMags[i] = astro::absToAppMag(star.getAbsoluteMagnitude(), distances[i])
+                       + star.getExtinction() * distances[i];
+        }
+
+        for (std::uint32_t i = 0; i < blockSize; ++i)
+        {
+            const Star& star = block[i];
+            if (gpuPoints && (distances[i] < SolarSystemMaxDistance || star.getOrbit() != nullptr))
+                continue;
+            if (appMags[i] < limitingMag || (distances[i] < MAX_STAR_ORBIT_RADIUS && star.getOrbit()))
+                renderStar(star, distances[i], appMags[i]);
+        }
+    }
+}
+
+void PointStarRenderer::processCPUStars(const std::vector<const Star*>& stars, float limitingMag)
+{
+    Vector3f obsPosf = obsPos.cast<float>();
+    for (const Star* star : stars)
+    {
+        float distance = (obsPosf - star->getPositionAfter(motionYears)).norm();
+        float appMag   = star->getApparentMagnitude(distance);
+        if (appMag < limitingMag || distance < MAX_STAR_ORBIT_RADIUS)
+            renderStar(*star, distance, appMag);
+    }
+}
+
+void PointStarRenderer::processFaintBatch(const Star* stars,
+                                         std::uint32_t nStars,
+                                         float minDistance,
+                                         float brightMag,
+                                         float limitingMag)
+{
+    Vector3f obsPosf = obsPos.cast<float>();
+    for (std::uint32_t i = 0; i < nStars; ++i)
+    {
+        const Star& star = stars[i];
+        float distance = (obsPosf - star.getPositionAfter(motionYears)).norm();
+
+        // Stars with orbits this close are never skipped by processBatch()
+        if (distance < minDistance || (distance < MAX_STAR_ORBIT_RADIUS && star.getOrbit() != nullptr))
+            continue;
+
+        float appMag = star.getApparentMagnitude(distance);
+        if (appMag >= brightMag && appMag < limitingMag)
+            renderStar(star, distance, appMag);
+    }
+}
+
+void PointStarRenderer::processAggregate(const Vector3f& position, float absMag, float temperature)
+{
+    // Nodes are only combined when they are far away, so there's no need
+    // for the precise distance of renderStar()
+    Vector3f relPos = (position.cast<double>() - obsPos).cast<float>();
+    float distance = relPos.norm();
+    if (distance > distanceLimit || relPos.dot(viewNormal) <= 0.0f)
+        return;
+
+    float appMag = astro::absToAppMag(absMag, distance);
+    float pointSize, alpha, glareSize, glareAlpha;
+    renderer->calculatePointSize(appMag,
+                                 starDiscSize,
+                                 pointSize,
+                                 alpha,
+                                 glareSize,
+                                 glareAlpha);
+
+    Color color = colorTemp->lookupColor(temperature);
+    if (glareSize != 0.0f)
+        glareVertexBuffer->addStar(relPos, Color(color, glareAlpha), glareSize);
+    if (pointSize != 0.0f)
+        starVertexBuffer->addStar(relPos, Color(color, alpha), pointSize);
+}
+
+void PointStarRenderer::renderStar(const Star& star, float distance, float appMag)
 {
     if (distance > distanceLimit)
         return;
 
-    Vector3f starPos = star.getPosition();
+    Vector3f starPos = star.getPositionAfter(motionYears);
 
     // Calculate the difference at double precision *before* converting to float.
     // This is very important for stars that are far from the origin.
@@ -76,9 +187,9 @@ void PointStarRenderer::process(const Star& star, float distance, float appMag)
             // This is a much more accurate (and expensive) distance
             // calculation than the previous one which used the observer's
             // position rounded off to floats.
-            Vector3d hPos = astrocentricPosition(observer->getPosition(),
-                                                 star,
-                                                 observer->getTime());
+            // Stars with orbits are looked up in the positions the
+            // renderer computed for this frame.
+            Vector3d hPos = observer->getPosition().offsetFromKm(starDB->getStarPosition(star, observer->getTime()));
             relPos = hPos.cast<float>() * -astro::kilometersToLightYears(1.0f);
             distance = relPos.norm();
 
@@ -88,24 +199,29 @@ void PointStarRenderer::process(const Star& star, float distance, float appMag)
             discSizeInPixels = star.getRadius() / astro::lightYearsToKilometers(distance) / pixelSize;
         }
 
+        if (pickGrid != nullptr)
+            pickGrid->add(&star, relPos, appMag);
+
         // Stars closer than the maximum solar system size are actually
         // added to the render list and depth sorted, since they may occlude
         // planets.
         if (distance > SolarSystemMaxDistance)
         {
             float pointSize, alpha, glareSize, glareAlpha;
-            float size = BaseStarDiscSize * static_cast<float>(renderer->getScreenDpi()) / 96.0f;
             renderer->calculatePointSize(appMag,
-                                         size,
+                                         starDiscSize,
                                          pointSize,
                                          alpha,
                                          glareSize,
                                          glareAlpha);
 
-            if (glareSize != 0.0f)
-                glareVertexBuffer->addStar(relPos, Color(starColor, glareAlpha), glareSize);
-            if (pointSize != 0.0f)
-                starVertexBuffer->addStar(relPos, Color(starColor, alpha), pointSize);
+            if (!gpuPoints || star.getOrbit() != nullptr)
+            {
+                if (glareSize != 0.0f)
+                    glareVertexBuffer->addStar(relPos, Color(starColor, glareAlpha), glareSize);
+                if (pointSize != 0.0f)
+                    starVertexBuffer->addStar(relPos, Color(starColor, alpha), pointSize);
+            }
 
             // Place labels for stars brighter than the specified label threshold brightness
             if (((labelMode & Renderer::StarLabels) != 0) && appMag < labelThresholdMag)
@@ -115,10 +231,17 @@ void PointStarRenderer::process(const Star& star, float distance, float appMag)
                 {
                     float distr = min(1.0f, 3.5f * (labelThresholdMag - appMag)/labelThresholdMag);
                     Color color = Color(Renderer::StarLabelColor, distr * Renderer::StarLabelColor.alpha());
+                    // The renderer copies the name, so the catalog
+                    // designation of unnamed stars is kept on the stack
+                    char nameBuffer[LabelBufferSize];
                     renderer->addBackgroundAnnotation(nullptr,
-                                                      starDB->getStarName(star, true),
+                                                      starDB->getStarName(star, nameBuffer, LabelBufferSize, true),
                                                       color,
-                                                      relPos);
+                                                      relPos,
+                                                      Renderer::AlignLeft,
+                                                      Renderer::VerticalAlignBottom,
+                                                      0.0f,
+                                                      Renderer::getLabelPriority(appMag, renderer->getHighlightObject().star() == &star));
                 }
             }
         }
@@ -151,10 +274,15 @@ void PointStarRenderer::process(const Star& star, float distance, float appMag)
                 Vector3f pos = rle.position;
                 pos = pos * (1.0f - star.getRadius() * 1.01f / pos.norm());
 
+                char nameBuffer[LabelBufferSize];
                 renderer->addSortedAnnotation(nullptr,
-                                              starDB->getStarName(star, true),
+                                              starDB->getStarName(star, nameBuffer, LabelBufferSize, true),
                                               Renderer::StarLabelColor,
-                                              pos);
+                                              pos,
+                                              Renderer::AlignLeft,
+                                              Renderer::VerticalAlignBottom,
+                                              0.0f,
+                                              Renderer::getLabelPriority(appMag, renderer->getHighlightObject().star() == &star));
             }
         }
     }
@@ -10,12 +10,14 @@
 
 #pragma once
 
-#include <Eigen/Core>
+#include <cstdint>
 #include <vector>
+#include <Eigen/Core>
 #include "objectrenderer.h"
 #include "renderlistentry.h"
 
 class ColorTemperatureTable;
+class PickGrid;
 class PointStarVertexBuffer;
 class Star;
 class StarDatabase;
@@ -42,6 +44,27 @@ class PointStarRenderer : public ObjectRenderer<Star, float>
     PointStarRenderer();
     void process(const Star &star, float distance, float appMag);
 
+    // Process the stars of one octree node, see
+    // StarDatabase::findVisibleStarBatches; this has the same result as
+    // calling process() for each star the octree traversal would select.
+    void processBatch(const Star* stars,
+                      std::uint32_t nStars,
+                      float dimmest,
+                      float limitingMag);
+    // Process stars that GPUStarField leaves to the CPU
+    void processCPUStars(const std::vector<const Star*>& stars, float limitingMag);
+    // Process the stars of a batch from brightMag to limitingMag, which
+    // processBatch() with a limit of brightMag skipped, other than those
+    // closer than minDistance
+    void processFaintBatch(const Star* stars,
+                           std::uint32_t nStars,
+                           float minDistance,
+                           float brightMag,
+                           float limitingMag);
+    // Draw the combined light of the stars of a distant octree node as a
+    // point, see StarAggregates
+    void processAggregate(const Eigen::Vector3f& position, float absMag, float temperature);
+
     Eigen::Vector3d obsPos;
     Eigen::Vector3f viewNormal;
     std::vector<RenderListEntry>* renderList    { nullptr };
@@ -51,4 +74,18 @@ class PointStarRenderer : public ObjectRenderer<Star, float>
     const ColorTemperatureTable* colorTemp      { nullptr };
     float SolarSystemMaxDistance                { 1.0f };
     float cosFOV                                { 1.0f };
+    // Base star disc size in pixels, scaled for the screen DPI
+    float starDiscSize                          { BaseStarDiscSize };
+    // When set, the points of distant stars without orbits are drawn by
+    // GPUStarField; those stars are still processed for labels, and nearby
+    // stars are expected to come from findCloseStars().
+    bool gpuPoints                              { false };
+    // When set, the stars drawn are recorded for picking
+    PickGrid* pickGrid                          { nullptr };
+    // Years of space motion of the stars at the time of the observer, see
+    // Star::GetMotionYears()
+    float motionYears                           { 0.0f };
+
+ private:
+    void renderStar(const Star &star, float distance, float appMag);
 };
@@ -9,12 +9,15 @@
 // of the License, or (at your option) any later version.
 
 #include "glsupport.h"
+#include <algorithm>
+#include <cstddef>
 #include <celutil/color.h>
 #include "objectrenderer.h"
 #include "shadermanager.h"
 #include "render.h"
 #include "texture.h"
 #include "pointstarvertexbuffer.h"
+#include "glstate.h"
 
 PointStarVertexBuffer* PointStarVertexBuffer::current = nullptr;
 
@@ -23,13 +26,114 @@ PointStarVertexBuffer::PointStarVertexBuffer(const Renderer& _renderer,
     renderer(_renderer),
     capacity(_capacity)
 {
-    vertices = new StarVertex[capacity];
+    clientVertices = new StarVertex[capacity];
+    vertices = clientVertices;
 }
 
 PointStarVertexBuffer::~PointStarVertexBuffer()
 {
-    delete[] vertices;
+#ifndef GL_ES
+    for (GLsync fence : fences)
+    {
+        if (fence != nullptr)
+            glDeleteSync(fence);
+    }
+    if (mappedVertices != nullptr)
+    {
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, vbo);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+#endif
+    if (vbo != 0)
+        celestia::gl::deleteBuffers(1, &vbo);
+    delete[] clientVertices;
+}
+
+// The buffer object is created on first use rather than in the constructor,
+// as there may be no current GL context yet when the renderer is created.
+void PointStarVertexBuffer::initBuffer()
+{
+    bufferInitialized = true;
+    glGenBuffers(1, &vbo);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, vbo);
+
+#ifndef GL_ES
+    if (celestia::gl::ARB_buffer_storage && celestia::gl::ARB_sync)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        GLsizeiptr size = static_cast<GLsizeiptr>(sizeof(StarVertex)) * capacity * RingSize;
+        glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+        mappedVertices = static_cast<StarVertex*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+        if (mappedVertices != nullptr)
+            return;
+
+        // Buffer storage is immutable, so start over with a new buffer
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+        celestia::gl::deleteBuffers(1, &vbo);
+        glGenBuffers(1, &vbo);
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, vbo);
+    }
+#endif
+
+    celestia::gl::bufferData(GL_ARRAY_BUFFER, sizeof(StarVertex) * capacity, nullptr, GL_STREAM_DRAW);
+}
+
+// Make the pending vertices available to the GPU and return the offset of
+// the first one in the bound buffer object, as expected by
+// glVertexAttribPointer.
+const char* PointStarVertexBuffer::uploadVertices()
+{
+    if (!bufferInitialized)
+        initBuffer();
+    else
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, vbo);
+
+#ifndef GL_ES
+    if (mappedVertices != nullptr)
+    {
+        StarVertex* segmentVertices = mappedVertices + segment * capacity;
+        // Only the first batch after the buffer is created is still in the
+        // client array.
+        if (vertices != segmentVertices)
+            std::copy(vertices, vertices + nStars, segmentVertices);
+        celestia::gl::countUpload(celestia::gl::UploadType::Vertex, sizeof(StarVertex) * nStars);
+        return reinterpret_cast<const char*>(sizeof(StarVertex) * segment * capacity);
+    }
+#endif
+
+    // Orphan the old storage so that the driver doesn't have to wait for
+    // the previous draw to complete before accepting the new vertices.
+    celestia::gl::bufferData(GL_ARRAY_BUFFER, sizeof(StarVertex) * capacity, nullptr, GL_STREAM_DRAW);
+    celestia::gl::bufferSubData(GL_ARRAY_BUFFER, 0, sizeof(StarVertex) * nStars, vertices);
+    return nullptr;
+}
+
+#ifndef GL_ES
+// Switch addStar() to the next segment of the ring, waiting for the GPU
+// to finish drawing from it if necessary.
+void PointStarVertexBuffer::nextSegment()
+{
+    fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    segment = (segment + 1) % RingSize;
+
+    GLsync fence = fences[segment];
+    if (fence != nullptr)
+    {
+        constexpr GLuint64 timeout = 1000000; // 1 ms
+        GLenum status;
+        do
+        {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        }
+        while (status == GL_TIMEOUT_EXPIRED);
+        glDeleteSync(fence);
+        fences[segment] = nullptr;
+    }
+
+    vertices = mappedVertices + segment * capacity;
 }
+#endif
 
 void PointStarVertexBuffer::startSprites()
 {
@@ -51,22 +155,28 @@ void PointStarVertexBuffer::render()
     if (nStars != 0)
     {
         makeCurrent();
+        const char* base = uploadVertices();
         unsigned int stride = sizeof(StarVertex);
         glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
                               3, GL_FLOAT, GL_FALSE,
-                              stride, &vertices[0].position);
+                              stride, base + offsetof(StarVertex, position));
         glVertexAttribPointer(CelestiaGLProgram::ColorAttributeIndex,
                               4, GL_UNSIGNED_BYTE, GL_TRUE,
-                              stride, &vertices[0].color);
+                              stride, base + offsetof(StarVertex, color));
 
         if (pointSizeFromVertex)
             glVertexAttribPointer(CelestiaGLProgram::PointSizeAttributeIndex,
                                   1, GL_FLOAT, GL_FALSE,
-                                  stride, &vertices[0].size);
+                                  stride, base + offsetof(StarVertex, size));
 
         if (texture != nullptr)
             texture->bind();
-        glDrawArrays(GL_POINTS, 0, nStars);
+        celestia::gl::drawArrays(GL_POINTS, 0, nStars);
+#ifndef GL_ES
+        if (mappedVertices != nullptr)
+            nextSegment();
+#endif
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
         nStars = 0;
     }
 }
@@ -110,16 +220,16 @@ void PointStarVertexBuffer::finish()
 void PointStarVertexBuffer::enable()
 {
 #ifndef GL_ES
-    glEnable(GL_POINT_SPRITE);
-    glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+    celestia::gl::enable(GL_POINT_SPRITE);
+    celestia::gl::enable(GL_VERTEX_PROGRAM_POINT_SIZE);
 #endif
 }
 
 void PointStarVertexBuffer::disable()
 {
 #ifndef GL_ES
-    glDisable(GL_VERTEX_PROGRAM_POINT_SIZE);
-    glDisable(GL_POINT_SPRITE);
+    celestia::gl::disable(GL_VERTEX_PROGRAM_POINT_SIZE);
+    celestia::gl::disable(GL_POINT_SPRITE);
 #endif
 }
 
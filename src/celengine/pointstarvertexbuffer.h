@@ -10,7 +10,9 @@
 
 #pragma once
 
+#include <array>
 #include <Eigen/Core>
+#include "glsupport.h"
 
 class Color;
 class Renderer;
@@ -18,6 +20,14 @@ class Texture;
 class CelestiaGLProgram;
 
 // PointStarVertexBuffer is used when hardware supports point sprites.
+//
+// Vertices are streamed to the GPU through a buffer object. When
+// ARB_buffer_storage and ARB_sync are available, the buffer is a ring of
+// persistently mapped segments: stars are written straight into one
+// segment while the GPU still draws from the others, and a fence per
+// segment keeps the CPU from overwriting vertices that haven't been drawn
+// yet. Otherwise each batch is uploaded into freshly orphaned storage so
+// the upload does not wait for the previous draw either.
 class PointStarVertexBuffer
 {
 public:
@@ -51,11 +61,25 @@ private:
         float pad;
     };
 
+    // Number of segments in the persistently mapped ring
+    static constexpr unsigned int RingSize = 3;
+
     const Renderer& renderer;
     capacity_t capacity;
 
     capacity_t nStars           { 0 };
+    // Where addStar() writes: either clientVertices or the current segment
+    // of the mapped ring
     StarVertex* vertices        { nullptr };
+    StarVertex* clientVertices  { nullptr };
+
+    GLuint vbo                  { 0 };
+    bool bufferInitialized      { false };
+#ifndef GL_ES
+    StarVertex* mappedVertices  { nullptr };
+    unsigned int segment        { 0 };
+    std::array<GLsync, RingSize> fences {};
+#endif
     Texture* texture            { nullptr };
     bool pointSizeFromVertex    { false };
     float pointScale            { 1.0f };
@@ -64,6 +88,11 @@ private:
     static PointStarVertexBuffer* current;
 
     void makeCurrent();
+    void initBuffer();
+    const char* uploadVertices();
+#ifndef GL_ES
+    void nextSegment();
+#endif
 };
 
 inline void PointStarVertexBuffer::addStar(const Eigen::Vector3f& pos,
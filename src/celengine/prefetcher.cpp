@@ -0,0 +1,166 @@
+// prefetcher.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Loading of the resources of the objects the observers travel to.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cstddef>
+#include "atmosphere.h"
+#include "body.h"
+#include "location.h"
+#include "meshmanager.h"
+#include "multitexture.h"
+#include "prefetcher.h"
+#include "selection.h"
+#include "texmanager.h"
+
+namespace
+{
+
+ResourcePrefetcher* prefetcher = nullptr;
+
+// Satellites of the goal loaded with it, the largest first
+constexpr std::size_t MaxNeighbours = 16;
+
+// Loads started per frame
+constexpr int MaxLoadsPerFrame = 4;
+
+// Goals are kept a little past their arrival, until the view of the
+// destination has found its resources itself
+constexpr std::chrono::seconds GoalLinger{ 2 };
+
+} // end unnamed namespace
+
+
+void
+ResourcePrefetcher::addTexture(Goal& goal, const MultiResTexture& texture) const
+{
+    if (!texture.isValid())
+        return;
+
+    // The resolution drawn, or the one drawn in its place
+    for (unsigned int res : { textureResolution, 1u, 0u, 2u })
+    {
+        if (res < TEXTURE_RESOLUTION && texture.tex[res] != InvalidResource)
+        {
+            goal.textures.push_back(texture.tex[res]);
+            return;
+        }
+    }
+}
+
+
+void
+ResourcePrefetcher::addBody(Goal& goal, const Body& body) const
+{
+    if (body.getGeometry() != InvalidResource)
+        goal.models.push_back(body.getGeometry());
+
+    const Surface& surface = body.getSurface();
+    addTexture(goal, surface.baseTexture);
+    addTexture(goal, surface.bumpTexture);
+    addTexture(goal, surface.nightTexture);
+    addTexture(goal, surface.specularTexture);
+    addTexture(goal, surface.overlayTexture);
+
+    if (const Atmosphere* atmosphere = body.getAtmosphere(); atmosphere != nullptr)
+    {
+        addTexture(goal, atmosphere->cloudTexture);
+        addTexture(goal, atmosphere->cloudNormalMap);
+    }
+    if (const RingSystem* rings = body.getRings(); rings != nullptr)
+        addTexture(goal, rings->texture);
+}
+
+
+void
+ResourcePrefetcher::addGoal(const Selection& sel, double travelTime)
+{
+    Body* body = sel.body();
+    if (sel.location() != nullptr)
+        body = sel.location()->getParentBody();
+    if (body == nullptr)
+        return;
+
+    Goal goal;
+    goal.arrival = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(std::max(travelTime, 0.0)));
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // The destination, the body it orbits, then its largest satellites
+    addBody(goal, *body);
+    if (PlanetarySystem* system = body->getSystem(); system != nullptr && system->getPrimaryBody() != nullptr)
+        addBody(goal, *system->getPrimaryBody());
+
+    if (PlanetarySystem* satellites = body->getSatellites(); satellites != nullptr)
+    {
+        std::vector<const Body*> neighbours;
+        for (int i = 0; i < satellites->getSystemSize(); i++)
+        {
+            if (const Body* satellite = satellites->getBody(i); satellite->isVisible())
+                neighbours.push_back(satellite);
+        }
+        std::size_t count = std::min(neighbours.size(), MaxNeighbours);
+        std::partial_sort(neighbours.begin(), neighbours.begin() + count, neighbours.end(),
+                          [](const Body* a, const Body* b) { return a->getRadius() > b->getRadius(); });
+        for (std::size_t i = 0; i < count; i++)
+            addBody(goal, *neighbours[i]);
+    }
+
+    goals.push_back(std::move(goal));
+}
+
+
+void
+ResourcePrefetcher::update(unsigned int resolution)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    textureResolution = resolution;
+
+    auto now = Clock::now();
+    goals.erase(std::remove_if(goals.begin(), goals.end(),
+                               [now](const Goal& goal) { return goal.arrival + GoalLinger < now; }),
+                goals.end());
+    std::stable_sort(goals.begin(), goals.end(),
+                     [](const Goal& a, const Goal& b) { return a.arrival < b.arrival; });
+
+    // Prefetching the resources already loaded keeps them from being
+    // evicted before arrival
+    int loads = 0;
+    for (const Goal& goal : goals)
+    {
+        for (ResourceHandle h : goal.models)
+        {
+            if (loads < MaxLoadsPerFrame && GetGeometryManager()->prefetch(h))
+                loads++;
+        }
+        for (ResourceHandle h : goal.textures)
+        {
+            if (loads < MaxLoadsPerFrame && GetTextureManager()->prefetch(h))
+                loads++;
+        }
+        if (loads >= MaxLoadsPerFrame)
+            break;
+    }
+}
+
+
+ResourcePrefetcher*
+GetResourcePrefetcher()
+{
+    return prefetcher;
+}
+
+
+void
+EnableResourcePrefetch()
+{
+    if (prefetcher == nullptr)
+        prefetcher = new ResourcePrefetcher();
+}
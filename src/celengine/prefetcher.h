@@ -0,0 +1,68 @@
+// prefetcher.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Loading of the resources of the objects the observers travel to.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <celutil/reshandle.h>
+
+class Body;
+class MultiResTexture;
+class Selection;
+
+/**
+ * Starts the asynchronous loads of the textures and models of the bodies
+ * the observers travel to, and of the bodies around them, when the travel
+ * starts instead of when they come into view, so that they're drawn at
+ * full detail on arrival. The loads of the goals reached first are started
+ * first, a few per frame so that they don't hold up the resources needed
+ * on screen.
+ *
+ * Resources which can't be loaded asynchronously are left to be loaded
+ * when they are drawn.
+ */
+class ResourcePrefetcher
+{
+ public:
+    // Load the resources of the object sel and of its neighbours within
+    // travelTime seconds. Called by observers starting to travel, on any
+    // thread.
+    void addGoal(const Selection& sel, double travelTime);
+
+    // Start the loads of the goals in the order of their arrival, and keep
+    // the resources loaded for them until then, with textures of
+    // resolution. Called once per frame on the thread which updates the
+    // resource managers.
+    void update(unsigned int resolution);
+
+ private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Goal
+    {
+        Clock::time_point arrival;
+        std::vector<ResourceHandle> textures;
+        std::vector<ResourceHandle> models;
+    };
+
+    void addTexture(Goal&, const MultiResTexture&) const;
+    void addBody(Goal&, const Body&) const;
+
+    std::mutex mutex;
+    std::vector<Goal> goals;
+    unsigned int textureResolution{ 1 };
+};
+
+// Null unless EnableResourcePrefetch() was called
+ResourcePrefetcher* GetResourcePrefetcher();
+void EnableResourcePrefetch();
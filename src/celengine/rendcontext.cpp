@@ -19,6 +19,7 @@
 #include "shadowmap.h" // GL_ONLY_SHADOWS definition
 #include "texmanager.h"
 #include "texture.h"
+#include "glstate.h"
 
 
 namespace
@@ -44,6 +45,10 @@ constexpr GLenum GLComponentTypes[static_cast<std::size_t>(cmod::VertexAttribute
      GL_FLOAT,          // Float3
      GL_FLOAT,          // Float4,
      GL_UNSIGNED_BYTE,  // UByte4
+     GL_HALF_FLOAT,     // Half2
+     GL_HALF_FLOAT,     // Half4
+     GL_SHORT,          // Short4
+     GL_SHORT,          // Oct16
 };
 
 constexpr int GLComponentCounts[static_cast<std::size_t>(cmod::VertexAttributeFormat::FormatMax)] =
@@ -53,6 +58,10 @@ constexpr int GLComponentCounts[static_cast<std::size_t>(cmod::VertexAttributeFo
      3,  // Float3
      4,  // Float4,
      4,  // UByte4
+     2,  // Half2
+     4,  // Half4
+     4,  // Short4
+     2,  // Oct16
 };
 
 
@@ -75,14 +84,17 @@ setStandardVertexArrays(const cmod::VertexDescription& desc,
                           3, GL_FLOAT, GL_FALSE, desc.strideBytes,
                           vertexData + position.offsetWords);
 
-    // Set up the normal array
+    // Set up the normal array; packed normals are unpacked by the shader
     switch (normal.format)
     {
     case cmod::VertexAttributeFormat::Float3:
+    case cmod::VertexAttributeFormat::Oct16:
         glEnableVertexAttribArray(CelestiaGLProgram::NormalAttributeIndex);
         glVertexAttribPointer(CelestiaGLProgram::NormalAttributeIndex,
-                              3, GLComponentTypes[static_cast<std::size_t>(normal.format)],
-                              GL_FALSE, desc.strideBytes,
+                              GLComponentCounts[static_cast<std::size_t>(normal.format)],
+                              GLComponentTypes[static_cast<std::size_t>(normal.format)],
+                              normal.format == cmod::VertexAttributeFormat::Oct16 ? GL_TRUE : GL_FALSE,
+                              desc.strideBytes,
                               vertexData + normal.offsetWords);
         break;
     default:
@@ -117,6 +129,7 @@ setStandardVertexArrays(const cmod::VertexDescription& desc,
     case cmod::VertexAttributeFormat::Float2:
     case cmod::VertexAttributeFormat::Float3:
     case cmod::VertexAttributeFormat::Float4:
+    case cmod::VertexAttributeFormat::Half2:
         glEnableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
         glVertexAttribPointer(CelestiaGLProgram::TextureCoord0AttributeIndex,
                               GLComponentCounts[static_cast<std::size_t>(texCoord0.format)],
@@ -140,11 +153,12 @@ setExtendedVertexArrays(const cmod::VertexDescription& desc,
     switch (tangent.format)
     {
     case cmod::VertexAttributeFormat::Float3:
+    case cmod::VertexAttributeFormat::Oct16:
         glEnableVertexAttribArray(CelestiaGLProgram::TangentAttributeIndex);
         glVertexAttribPointer(CelestiaGLProgram::TangentAttributeIndex,
                                       GLComponentCounts[static_cast<std::size_t>(tangent.format)],
                                       GLComponentTypes[static_cast<std::size_t>(tangent.format)],
-                                      GL_FALSE,
+                                      tangent.format == cmod::VertexAttributeFormat::Oct16 ? GL_TRUE : GL_FALSE,
                                       desc.strideBytes,
                                       vertexData + tangent.offsetWords);
         break;
@@ -298,7 +312,8 @@ RenderContext::getCameraOrientation() const
 
 
 void
-RenderContext::drawGroup(const cmod::PrimitiveGroup& group, bool useOverride)
+RenderContext::drawGroup(const cmod::PrimitiveGroup& group, bool useOverride,
+                         const IndexBufferRange* indexBuffer)
 {
     // Skip rendering if this is the emissive pass but there's no
     // emissive texture.
@@ -316,21 +331,66 @@ RenderContext::drawGroup(const cmod::PrimitiveGroup& group, bool useOverride)
         if (group.prim == cmod::PrimitiveGroupType::PointList)
             glVertexAttrib1f(CelestiaGLProgram::PointSizeAttributeIndex, 1.0f);
 #ifndef GL_ES
-        glEnable(GL_POINT_SPRITE);
-        glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+        celestia::gl::enable(GL_POINT_SPRITE);
+        celestia::gl::enable(GL_VERTEX_PROGRAM_POINT_SIZE);
 #endif
-        glActiveTexture(GL_TEXTURE0);
+        celestia::gl::activeTexture(GL_TEXTURE0);
     }
 
-    glDrawElements(GLPrimitiveModes[(int)(useOverride ? group.primOverride : group.prim)],
-                   useOverride ? group.indicesOverride.size() :  group.indices.size(),
-                   GL_UNSIGNED_INT,
-                   useOverride ? group.indicesOverride.data() : group.indices.data());
+    GLenum mode;
+    GLsizei count;
+    GLenum type;
+    const void* indices;
+    GLint baseVertex = 0;
+    if (indexBuffer != nullptr)
+    {
+        mode = GLPrimitiveModes[(int)(useOverride ? group.primOverride : group.prim)];
+        count = indexBuffer->count;
+        type = indexBuffer->type;
+        indices = reinterpret_cast<const void*>(indexBuffer->offset);
+        baseVertex = indexBuffer->baseVertex;
+    }
+    else if (useOverride)
+    {
+        mode = GLPrimitiveModes[(int)group.primOverride];
+        count = group.indicesOverride.size();
+        type = GL_UNSIGNED_INT;
+        indices = group.indicesOverride.data();
+    }
+    else if (!group.indices16.empty())
+    {
+        mode = GLPrimitiveModes[(int)group.prim];
+        count = group.indices16.size();
+        type = GL_UNSIGNED_SHORT;
+        indices = group.indices16.data();
+    }
+    else
+    {
+        mode = GLPrimitiveModes[(int)group.prim];
+        count = group.indices.size();
+        type = GL_UNSIGNED_INT;
+        indices = group.indices.data();
+    }
+
+    if (instanceCount > 0)
+    {
+        if (baseVertex != 0)
+            celestia::gl::drawElementsInstancedBaseVertex(mode, count, type, indices, instanceCount, baseVertex);
+        else
+            celestia::gl::drawElementsInstanced(mode, count, type, indices, instanceCount);
+    }
+    else
+    {
+        if (baseVertex != 0)
+            celestia::gl::drawElementsBaseVertex(mode, count, type, indices, baseVertex);
+        else
+            celestia::gl::drawElements(mode, count, type, indices);
+    }
 #ifndef GL_ES
     if (drawPoints)
     {
-        glDisable(GL_POINT_SPRITE);
-        glDisable(GL_VERTEX_PROGRAM_POINT_SIZE);
+        celestia::gl::disable(GL_POINT_SPRITE);
+        celestia::gl::disable(GL_VERTEX_PROGRAM_POINT_SIZE);
     }
 #endif
 }
@@ -353,8 +413,10 @@ RenderContext::updateShader(const cmod::VertexDescription& desc, cmod::Primitive
     // or disappear in the new set of vertex arrays.
     bool usePointSizeNow = (desc.getAttribute(cmod::VertexAttributeSemantic::PointSize).format
                             == cmod::VertexAttributeFormat::Float1);
-    bool useNormalsNow = (desc.getAttribute(cmod::VertexAttributeSemantic::Normal).format
-                          == cmod::VertexAttributeFormat::Float3);
+    cmod::VertexAttributeFormat normalFormat = desc.getAttribute(cmod::VertexAttributeSemantic::Normal).format;
+    bool useNormalsNow = (normalFormat == cmod::VertexAttributeFormat::Float3 ||
+                          normalFormat == cmod::VertexAttributeFormat::Oct16);
+    bool usePackedNormalsNow = (normalFormat == cmod::VertexAttributeFormat::Oct16);
     bool useColorsNow = (desc.getAttribute(cmod::VertexAttributeSemantic::Color0).format
                          != cmod::VertexAttributeFormat::InvalidFormat);
     bool useTexCoordsNow = (desc.getAttribute(cmod::VertexAttributeSemantic::Texture0).format
@@ -366,6 +428,7 @@ RenderContext::updateShader(const cmod::VertexDescription& desc, cmod::Primitive
     if (usePointSizeNow         != usePointSize       ||
         useStaticPointSizeNow   != useStaticPointSize ||
         useNormalsNow           != useNormals         ||
+        usePackedNormalsNow     != usePackedNormals   ||
         useColorsNow            != useColors          ||
         useTexCoordsNow         != useTexCoords       ||
         drawLineNow             != drawLine)
@@ -373,6 +436,7 @@ RenderContext::updateShader(const cmod::VertexDescription& desc, cmod::Primitive
         usePointSize = usePointSizeNow;
         useStaticPointSize = useStaticPointSizeNow;
         useNormals = useNormalsNow;
+        usePackedNormals = usePackedNormalsNow;
         useColors = useColorsNow;
         useTexCoords = useTexCoordsNow;
         drawLine = drawLineNow;
@@ -549,7 +613,7 @@ GLSL_RenderContext::makeCurrent(const cmod::Material& m)
         Texture* ringsTex = lightingState.shadowingRingSystem->texture.find(medres);
         if (ringsTex != nullptr)
         {
-            glActiveTexture(GL_TEXTURE0 + nTextures);
+            celestia::gl::activeTexture(GL_TEXTURE0 + nTextures);
             ringsTex->bind();
             textures[nTextures++] = ringsTex;
 
@@ -571,7 +635,7 @@ GLSL_RenderContext::makeCurrent(const cmod::Material& m)
 #ifdef GL_ES
             }
 #endif
-            glActiveTexture(GL_TEXTURE0);
+            celestia::gl::activeTexture(GL_TEXTURE0);
 
             shaderProps.texUsage |= ShaderProperties::RingShadowTexture;
             for (unsigned int lightIndex = 0; lightIndex < lightingState.nLights; lightIndex++)
@@ -611,6 +675,12 @@ GLSL_RenderContext::makeCurrent(const cmod::Material& m)
     if (hasShadowMap)
         shaderProps.texUsage |= ShaderProperties::ShadowMapTexture;
 
+    if (getInstanceCount() > 0)
+        shaderProps.texUsage |= ShaderProperties::Instanced;
+
+    if (useNormals && usePackedNormals)
+        shaderProps.texUsage |= ShaderProperties::PackedNormals;
+
     // Get a shader for the current rendering configuration
     assert(renderer != nullptr);
     CelestiaGLProgram* prog = renderer->getShaderManager().getShader(shaderProps);
@@ -622,14 +692,14 @@ GLSL_RenderContext::makeCurrent(const cmod::Material& m)
 
     for (unsigned int i = 0; i < nTextures; i++)
     {
-        glActiveTexture(GL_TEXTURE0 + i);
+        celestia::gl::activeTexture(GL_TEXTURE0 + i);
         textures[i]->bind();
     }
 
     if (hasShadowMap)
     {
-        glActiveTexture(GL_TEXTURE0 + nTextures);
-        glBindTexture(GL_TEXTURE_2D, shadowMap);
+        celestia::gl::activeTexture(GL_TEXTURE0 + nTextures);
+        celestia::gl::bindTexture(GL_TEXTURE_2D, shadowMap);
 #if GL_ONLY_SHADOWS
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_R_TO_TEXTURE);
 #endif
@@ -846,7 +916,7 @@ GLSLUnlit_RenderContext::makeCurrent(const cmod::Material& m)
 
     for (unsigned int i = 0; i < nTextures; i++)
     {
-        glActiveTexture(GL_TEXTURE0 + i);
+        celestia::gl::activeTexture(GL_TEXTURE0 + i);
         textures[i]->bind();
     }
 
@@ -25,6 +25,16 @@ class Color;
 class LightingState;
 class Renderer;
 
+// Location of the indices of a primitive group in the bound element array
+// buffer. The base vertex is added to every index.
+struct IndexBufferRange
+{
+    GLenum type{ GL_UNSIGNED_INT };
+    GLintptr offset{ 0 };
+    GLsizei count{ 0 };
+    GLint baseVertex{ 0 };
+};
+
 class RenderContext
 {
  public:
@@ -36,7 +46,8 @@ class RenderContext
     virtual void setVertexArrays(const cmod::VertexDescription& desc,
                                  const cmod::VWord* vertexData);
     virtual void updateShader(const cmod::VertexDescription& desc, cmod::PrimitiveGroupType primType);
-    virtual void drawGroup(const cmod::PrimitiveGroup& group, bool useOverride);
+    virtual void drawGroup(const cmod::PrimitiveGroup& group, bool useOverride,
+                           const IndexBufferRange* indexBuffer = nullptr);
 
     const cmod::Material* getMaterial() const;
     void setMaterial(const cmod::Material*);
@@ -60,11 +71,23 @@ class RenderContext
     void setCameraOrientation(const Eigen::Quaternionf& q);
     Eigen::Quaternionf getCameraOrientation() const;
 
+    // Size in pixels of one unit of model coordinates, used to pick the
+    // level of detail of models; zero draws them at full resolution.
+    void setModelPixelScale(float scale) { modelPixelScale = scale; }
+    float getModelPixelScale() const { return modelPixelScale; }
+
+    // Number of instances drawn by drawGroup() with the per-instance
+    // attributes set up by ModelInstances; zero for a single model.
+    void setInstanceCount(GLsizei count) { instanceCount = count; }
+    GLsizei getInstanceCount() const { return instanceCount; }
+
  protected:
     Renderer* renderer { nullptr };
     bool usePointSize{ false };
     bool useStaticPointSize{ false };
     bool useNormals{ true };
+    // Normals and tangents packed by octahedral mapping
+    bool usePackedNormals{ false };
     bool useColors{ false };
     bool useTexCoords{ true };
     bool drawLine { false };
@@ -74,6 +97,8 @@ class RenderContext
     bool locked{ false };
     RenderPass renderPass{ PrimaryPass };
     float pointScale{ 1.0f };
+    float modelPixelScale{ 0.0f };
+    GLsizei instanceCount{ 0 };
     Eigen::Quaternionf cameraOrientation;  // required for drawing billboards
 };
 
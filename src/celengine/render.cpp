@@ -19,6 +19,7 @@
 #include "render.h"
 #include "boundaries.h"
 #include "dsorenderer.h"
+#include "globular.h"
 #include "asterism.h"
 #include "astro.h"
 #include "vecgl.h"
@@ -29,6 +30,7 @@
 #include "geometry.h"
 #include "texmanager.h"
 #include "meshmanager.h"
+#include "minorbodies.h"
 #include "renderinfo.h"
 #include "renderglsl.h"
 #include "axisarrow.h"
@@ -40,12 +42,23 @@
 #include "shadermanager.h"
 #include "rectangle.h"
 #include "framebuffer.h"
+#include "multiviewframebuffer.h"
 #include "pointstarvertexbuffer.h"
+#include "gpuorbits.h"
+#include "markerbatch.h"
+#include "gpuprofiler.h"
+#include "gpustarfield.h"
+#include "modelinstances.h"
+#include "impostorcache.h"
+#include "labeldeclutter.h"
+#include "locationindex.h"
 #include "pointstarrenderer.h"
 #include "orbitsampler.h"
 #include "asterismrenderer.h"
+#include "bodysnapshot.h"
 #include "boundariesrenderer.h"
 #include "rendcontext.h"
+#include "streambuffer.h"
 #include "vertexobject.h"
 #include <celengine/observer.h>
 #include <celmath/frustum.h>
@@ -53,16 +66,20 @@
 #include <celmath/intersect.h>
 #include <celmath/geomutil.h>
 #include <celutil/logger.h>
+#include <celutil/memoryusage.h>
+#include <celutil/threadpool.h>
 #include <celutil/utf8.h>
 #include <celutil/timer.h>
 #include <celttf/truetypefont.h>
 #include "glsupport.h"
+#include "glstate.h"
 #include <algorithm>
 #include <cstring>
 #include <cassert>
 #include <sstream>
 #include <iomanip>
 #include <numeric>
+#include <optional>
 #ifdef _MSC_VER
 #include <malloc.h>
 #ifndef alloca
@@ -74,6 +91,8 @@ using namespace Eigen;
 using namespace std;
 using namespace celestia;
 using namespace celmath;
+using celestia::util::ArenaAllocator;
+using celestia::util::ArenaVector;
 using celestia::util::GetLogger;
 
 #define FOV           45.0f
@@ -140,10 +159,36 @@ static const int MaxSkyRings = 32;
 static const int MaxSkySlices = 180;
 static const int MinSkySlices = 30;
 
-// Size at which the orbit cache will be flushed of old orbit paths
-static const unsigned int OrbitCacheCullThreshold = 200;
-// Age in frames at which unused orbit paths may be eliminated from the cache
-static const uint32_t OrbitCacheRetireAge = 16;
+// Default memory for orbit path samples in the cache, beyond which the
+// least recently used paths are eliminated
+static const std::size_t DefaultOrbitCacheBudget = 16 * 1024 * 1024;
+// Largest error of orbit paths in pixels
+static const double OrbitPathPixelTolerance = 0.25;
+// Orbit paths are never sampled more finely than this, in kilometers
+static const double MinOrbitPathTolerance = 1.0;
+
+// Frame trees with fewer children are culled on the render thread only
+static const unsigned int MinParallelRenderListChildren = 1024;
+// Number of children culled by one render list task
+static const unsigned int RenderListBatchSize = 512;
+// Deep sky objects are tested in parallel when the visible octree nodes
+// hold at least this many, in tasks of about DSOBatchSize objects
+static const std::uint32_t MinParallelDSOs = 4096;
+static const std::uint32_t DSOBatchSize = 1024;
+
+// Views share octree traversals when their observers are closer than this,
+// in light years
+static const double SharedViewPositionTolerance = 1.0e-9;
+// Added to the half angle of the frustum containing the shared views, in
+// radians, so that it still contains them after rounding
+static const float SharedViewAngleMargin = 1.0e-3f;
+// Views spanning a wider half angle are only culled by brightness in the
+// shared traversal
+static const float MaxSharedViewHalfAngle = celmath::degToRad(80.0f);
+
+// The shadow map of a model is reused while the direction of the light in
+// model space stays within about 0.1 degrees of the one it was drawn for
+static const float MinShadowLightDirectionCos = 0.9999985f;
 
 Color Renderer::StarLabelColor          (0.471f, 0.356f, 0.682f);
 Color Renderer::PlanetLabelColor        (0.407f, 0.333f, 0.964f);
@@ -245,6 +290,7 @@ Renderer::Renderer() :
     textureResolution(medres),
     frameCount(0),
     lastOrbitCacheFlush(0),
+    orbitCacheBudget(DefaultOrbitCacheBudget),
     minOrbitSize(MinOrbitSizeForLabel),
     distanceLimit(1.0e6f),
     minFeatureSize(MinFeatureSizeForLabel),
@@ -267,6 +313,8 @@ Renderer::Renderer() :
 
     shaderManager = new ShaderManager();
     m_VertexObjects.fill(nullptr);
+    m_streamBuffer = std::make_unique<celgl::StreamBuffer>();
+    CurvePlot::setStreamBuffer(m_streamBuffer.get());
 }
 
 
@@ -283,6 +331,8 @@ Renderer::~Renderer()
 
     for (auto p : m_VertexObjects)
         delete p;
+
+    CurvePlot::setStreamBuffer(nullptr);
 }
 
 
@@ -535,7 +585,7 @@ bool Renderer::init(
         commonDataInitialized = true;
     }
 
-    glEnable(GL_CULL_FACE);
+    celestia::gl::enable(GL_CULL_FACE);
     glCullFace(GL_BACK);
 
 #ifndef GL_ES
@@ -546,6 +596,9 @@ bool Renderer::init(
     // LEQUAL rather than LESS required for multipass rendering
     glDepthFunc(GL_LEQUAL);
 
+    if (util::GetProfiler() != nullptr && GPUProfiler::isSupported())
+        gpuProfiler = std::make_unique<GPUProfiler>(*util::GetProfiler());
+
     resize(winWidth, winHeight);
 
     return true;
@@ -811,13 +864,14 @@ void Renderer::setDistanceLimit(float distanceLimit_)
 
 void Renderer::addAnnotation(vector<Annotation>& annotations,
                              const celestia::MarkerRepresentation* markerRep,
-                             const string& labelText,
+                             std::string_view labelText,
                              Color color,
                              const Vector3f& pos,
                              LabelAlignment halign,
                              LabelVerticalAlignment valign,
                              float size,
-                             bool special)
+                             bool special,
+                             float priority)
 {
     GLint view[4] = { 0, 0, windowWidth, windowHeight };
     Vector3f win;
@@ -838,51 +892,56 @@ void Renderer::addAnnotation(vector<Annotation>& annotations,
 
         Annotation a;
         if (!special || markerRep == nullptr)
-             a.labelText = labelText;
+             a.labelText = frameArena.copy(labelText);
         a.markerRep = markerRep;
         a.color = color;
         a.position = win;
         a.halign = halign;
         a.valign = valign;
         a.size = size;
+        a.priority = priority;
         annotations.push_back(a);
+        frameStats.annotations++;
     }
 }
 
 
 void Renderer::addForegroundAnnotation(const celestia::MarkerRepresentation* markerRep,
-                                       const string& labelText,
+                                       std::string_view labelText,
                                        Color color,
                                        const Vector3f& pos,
                                        LabelAlignment halign,
                                        LabelVerticalAlignment valign,
-                                       float size)
+                                       float size,
+                                       float priority)
 {
-    addAnnotation(foregroundAnnotations, markerRep, labelText, color, pos, halign, valign, size);
+    addAnnotation(foregroundAnnotations, markerRep, labelText, color, pos, halign, valign, size, false, priority);
 }
 
 
 void Renderer::addBackgroundAnnotation(const celestia::MarkerRepresentation* markerRep,
-                                       const string& labelText,
+                                       std::string_view labelText,
                                        Color color,
                                        const Vector3f& pos,
                                        LabelAlignment halign,
                                        LabelVerticalAlignment valign,
-                                       float size)
+                                       float size,
+                                       float priority)
 {
-    addAnnotation(backgroundAnnotations, markerRep, labelText, color, pos, halign, valign, size);
+    addAnnotation(backgroundAnnotations, markerRep, labelText, color, pos, halign, valign, size, false, priority);
 }
 
 
 void Renderer::addSortedAnnotation(const celestia::MarkerRepresentation* markerRep,
-                                   const string& labelText,
+                                   std::string_view labelText,
                                    Color color,
                                    const Vector3f& pos,
                                    LabelAlignment halign,
                                    LabelVerticalAlignment valign,
-                                   float size)
+                                   float size,
+                                   float priority)
 {
-    addAnnotation(depthSortedAnnotations, markerRep, labelText, color, pos, halign, valign, size, true);
+    addAnnotation(depthSortedAnnotations, markerRep, labelText, color, pos, halign, valign, size, true, priority);
 }
 
 
@@ -944,7 +1003,7 @@ void Renderer::endObjectAnnotations()
 
 
 void Renderer::addObjectAnnotation(const celestia::MarkerRepresentation* markerRep,
-                                   const string& labelText,
+                                   std::string_view labelText,
                                    Color color,
                                    const Vector3f& pos)
 {
@@ -1009,6 +1068,78 @@ Vector4f renderOrbitColor(const Body *body, bool selected, float opacity)
     return Vector4f(orbitColor.red(), orbitColor.green(), orbitColor.blue(), opacity * orbitColor.alpha());
 }
 
+// Tolerance in kilometers for sampling an orbit path whose closest point is
+// distance kilometers from the viewer
+static double orbitPathTolerance(double distance, float pixelSize)
+{
+    return max(distance * pixelSize * OrbitPathPixelTolerance, MinOrbitPathTolerance);
+}
+
+
+// Sample a path covering the orbit period preceding t, or the whole valid
+// range of an aperiodic trajectory
+static std::unique_ptr<CurvePlot> sampleOrbitPath(const Orbit* orbit, double t, double tolerance)
+{
+    auto plot = std::make_unique<CurvePlot>();
+    plot->setTolerance(tolerance);
+
+    double startTime = t - orbit->getPeriod();
+    if (!orbit->isPeriodic())
+    {
+        double begin = 0.0, end = 0.0;
+        orbit->getValidRange(begin, end);
+
+        // If the orbit is aperiodic and doesn't have a finite duration, we
+        // don't render it. A compromise would be to pick some time window
+        // centered at the current time, but we'd have to pick some
+        // arbitrary duration.
+        if (begin == end)
+            return plot;
+
+        startTime = begin;
+    }
+
+    OrbitSampler sampler(tolerance);
+    orbit->sample(startTime, startTime + orbit->getPeriod(), sampler);
+    sampler.insertForward(plot.get());
+
+    return plot;
+}
+
+
+// Eliminate the least recently used orbit paths from the cache until the
+// samples fit in the budget. Paths used in the current frame are kept.
+// This is checked at most once per frame.
+void Renderer::trimOrbitCache()
+{
+    if (lastOrbitCacheFlush == frameCount)
+        return;
+    lastOrbitCacheFlush = frameCount;
+
+    std::size_t cacheSize = 0;
+    for (const auto& entry : orbitCache)
+        cacheSize += entry.second->memoryUsage();
+    if (cacheSize <= orbitCacheBudget)
+        return;
+
+    std::vector<OrbitCache::iterator> entries;
+    entries.reserve(orbitCache.size());
+    for (auto iter = orbitCache.begin(); iter != orbitCache.end(); ++iter)
+        entries.push_back(iter);
+    std::sort(entries.begin(), entries.end(),
+              [](const OrbitCache::iterator& a, const OrbitCache::iterator& b)
+              { return a->second->lastUsed() < b->second->lastUsed(); });
+
+    for (auto iter : entries)
+    {
+        if (cacheSize <= orbitCacheBudget || iter->second->lastUsed() == frameCount)
+            break;
+        cacheSize -= iter->second->memoryUsage();
+        orbitCache.erase(iter);
+    }
+}
+
+
 void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
                            double t,
                            const Quaterniond& cameraOrientation,
@@ -1037,79 +1168,51 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
     else
         orbit = orbitPath.star->getOrbit();
 
+    Quaterniond orientation = Quaterniond::Identity();
+    if (body)
+    {
+        orientation = body->getOrbitFrame(t)->getOrientation(t);
+    }
+
+    // Position of the viewer in the orbit frame
+    Vector3d viewerPosition = orientation * -orbitPath.origin;
+
     CurvePlot* cachedOrbit = nullptr;
     OrbitCache::iterator cached = orbitCache.find(orbit);
     if (cached != orbitCache.end())
     {
-        cachedOrbit = cached->second;
+        cachedOrbit = cached->second.get();
         cachedOrbit->setLastUsed(frameCount);
+
+        // Resample the path if the viewer has come so close that its error
+        // is visible, or moved so far away that it has many more samples
+        // than needed.
+        double tolerance = orbitPathTolerance(cachedOrbit->nearestSampleDistance(viewerPosition), pixelSize);
+        if (cachedOrbit->tolerance() > tolerance * 2.0 || cachedOrbit->tolerance() < tolerance * 0.0625)
+        {
+            cached->second = sampleOrbitPath(orbit, t, tolerance);
+            cachedOrbit = cached->second.get();
+            cachedOrbit->setLastUsed(frameCount);
+            trimOrbitCache();
+        }
     }
 
     // If it's not in the cache already
     if (cachedOrbit == nullptr)
     {
-        double startTime = t;
-        int nSamples = detailOptions.orbitPathSamplePoints;
+        // Until there are samples, the distance to the bounding sphere of
+        // the orbit is the best guess for the distance to the path
+        double distance = max(orbitPath.origin.norm() - orbit->getBoundingRadius(), 0.0);
+        auto plot = sampleOrbitPath(orbit, t, orbitPathTolerance(distance, pixelSize));
 
-        // Adjust the number of samples used for aperiodic orbits--these aren't
-        // true orbits, but are sampled trajectories, generally of spacecraft.
-        // Better control is really needed--some sort of adaptive sampling would
-        // be ideal.
-        if (!orbit->isPeriodic())
-        {
-            double begin = 0.0, end = 0.0;
-            orbit->getValidRange(begin, end);
-
-            if (begin != end)
-            {
-                startTime = begin;
-                nSamples = (int) (orbit->getPeriod() * 100.0);
-                nSamples = max(min(nSamples, 1000), 100);
-            }
-            else
-            {
-                // If the orbit is aperiodic and doesn't have a
-                // finite duration, we don't render it. A compromise
-                // would be to pick some time window centered at the
-                // current time, but we'd have to pick some arbitrary
-                // duration.
-                nSamples = 0;
-            }
-        }
-        else
-        {
-            startTime = t - orbit->getPeriod();
-        }
+        double tolerance = orbitPathTolerance(plot->nearestSampleDistance(viewerPosition), pixelSize);
+        if (plot->tolerance() > tolerance * 2.0)
+            plot = sampleOrbitPath(orbit, t, tolerance);
 
-        cachedOrbit = new CurvePlot();
+        cachedOrbit = plot.get();
         cachedOrbit->setLastUsed(frameCount);
-
-        OrbitSampler sampler;
-        orbit->sample(startTime,
-                      startTime + orbit->getPeriod(),
-                      sampler);
-        sampler.insertForward(cachedOrbit);
-
-        // If the orbit cache is full, first try and eliminate some old orbits
-        if (orbitCache.size() > OrbitCacheCullThreshold)
-        {
-            // Check for old orbits at most once per frame
-            if (lastOrbitCacheFlush != frameCount)
-            {
-                for (auto iter = orbitCache.begin(); iter != orbitCache.end();)
-                {
-                    // Tricky code to eliminate a node in the orbit cache without screwing
-                    // up the iterator. Should work in all STL implementations.
-                    if (frameCount - iter->second->lastUsed() > OrbitCacheRetireAge)
-                        orbitCache.erase(iter++);
-                    else
-                        ++iter;
-                }
-                lastOrbitCacheFlush = frameCount;
-            }
-        }
-
-        orbitCache[orbit] = cachedOrbit;
+        orbitCache[orbit] = std::move(plot);
+        trimOrbitCache();
     }
 
     if (cachedOrbit->empty())
@@ -1162,7 +1265,7 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
             cachedOrbit->removeSamplesBefore(cachedOrbit->startTime() * (1.0 + 1.0e-15));
 
             // Add the new samples
-            OrbitSampler sampler;
+            OrbitSampler sampler(cachedOrbit->tolerance());
             orbit->sample(newWindowStart, min(currentWindowStart, newWindowEnd), sampler);
             sampler.insertBackward(cachedOrbit);
 #if DEBUG_ORBIT_CACHE
@@ -1178,7 +1281,7 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
             cachedOrbit->removeSamplesAfter(cachedOrbit->endTime() * (1.0 - 1.0e-15));
 
             // Add the new samples
-            OrbitSampler sampler;
+            OrbitSampler sampler(cachedOrbit->tolerance());
             orbit->sample(max(currentWindowEnd, newWindowStart), newWindowEnd, sampler);
             sampler.insertForward(cachedOrbit);
 #if DEBUG_ORBIT_CACHE
@@ -1190,16 +1293,7 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
     // We perform vertex tranformations on the CPU because double precision is necessary to
     // render orbits properly. Start by computing the modelview matrix, to transform orbit
     // vertices into camera space.
-    Affine3d modelview;
-    {
-        Quaterniond orientation = Quaterniond::Identity();
-        if (body)
-        {
-            orientation = body->getOrbitFrame(t)->getOrientation(t);
-        }
-
-        modelview = cameraOrientation * Translation3d(orbitPath.origin) * orientation.conjugate();
-    }
+    Affine3d modelview = cameraOrientation * Translation3d(orbitPath.origin) * orientation.conjugate();
 
     bool highlight;
     if (body != nullptr)
@@ -1210,19 +1304,30 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
 
 #ifdef STIPPLED_LINES
     glLineStipple(3, 0x5555);
-    glEnable(GL_LINE_STIPPLE);
+    celestia::gl::enable(GL_LINE_STIPPLE);
 #endif
 
-    double subdivisionThreshold = pixelSize * 40.0;
-
-    Eigen::Vector3d viewFrustumPlaneNormals[4];
-    for (int i = 0; i < 4; i++)
+    // The interval of time drawn, and the one over which the path fades in
+    double windowStart = cachedOrbit->startTime();
+    double windowEnd = cachedOrbit->endTime();
+    double fadeStart = 0.0;
+    double fadeEnd = 0.0;
+    if (orbit->isPeriodic())
     {
-        viewFrustumPlaneNormals[i] = frustum.plane(i).normal().cast<double>();
+        double period = orbit->getPeriod();
+        windowEnd = t + period * OrbitWindowEnd;
+        windowStart = windowEnd - period * OrbitPeriodsShown;
+        if (LinearFadeFraction != 0.0f && (renderFlags & ShowFadingOrbits) != 0)
+        {
+            fadeStart = windowStart;
+            fadeEnd = windowEnd - (windowEnd - windowStart) * (1.0 - LinearFadeFraction);
+        }
+    }
+    else if ((renderFlags & ShowPartialTrajectories) != 0)
+    {
+        // Show the trajectory from the start time until the current simulation time
+        windowEnd = t;
     }
-
-    prog->use();
-    prog->setMVPMatrices(*m.projection);
 
     Renderer::PipelineState ps;
     ps.blending = true;
@@ -1232,72 +1337,92 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
 
     setPipelineState(ps);
 
+    // Draw the path from its buffer in graphics memory unless the view is
+    // close enough to need the double precision of the CPU path
+    if (!lineAsTriangles)
+    {
+        auto *bufferProg = shaderManager->getShader("curveplot");
+        if (bufferProg != nullptr &&
+            cachedOrbit->renderBuffered(*bufferProg, modelview, *m.projection,
+                                        cachedOrbit->nearestSampleDistance(viewerPosition),
+                                        pixelSize,
+                                        windowStart, windowEnd,
+                                        orbitColor,
+                                        fadeStart, fadeEnd))
+        {
+#ifdef STIPPLED_LINES
+            celestia::gl::disable(GL_LINE_STIPPLE);
+#endif
+            return;
+        }
+    }
+
+    double subdivisionThreshold = pixelSize * 40.0;
+
+    Eigen::Vector3d viewFrustumPlaneNormals[4];
+    for (int i = 0; i < 4; i++)
+    {
+        viewFrustumPlaneNormals[i] = frustum.plane(i).normal().cast<double>();
+    }
+
+    prog->use();
+    prog->setMVPMatrices(*m.projection);
+
     if (lineAsTriangles)
     {
         prog->lineWidthX = getPointWidth();
         prog->lineWidthY = getPointHeight();
     }
-    if (orbit->isPeriodic())
+    if (fadeStart != fadeEnd)
     {
-        double period = orbit->getPeriod();
-        double windowEnd = t + period * OrbitWindowEnd;
-        double windowStart = windowEnd - period * OrbitPeriodsShown;
-        double windowDuration = windowEnd - windowStart;
-
-        if (LinearFadeFraction == 0.0f || (renderFlags & ShowFadingOrbits) == 0)
-        {
-            cachedOrbit->render(modelview,
-                                nearZ, farZ, viewFrustumPlaneNormals,
-                                subdivisionThreshold,
-                                windowStart, windowEnd,
-                                orbitColor, lineAsTriangles);
-        }
-        else
-        {
-            cachedOrbit->renderFaded(modelview,
-                                     nearZ, farZ, viewFrustumPlaneNormals,
-                                     subdivisionThreshold,
-                                     windowStart, windowEnd,
-                                     orbitColor,
-                                     windowStart,
-                                     windowEnd - windowDuration * (1.0 - LinearFadeFraction),
-                                     lineAsTriangles);
-        }
+        cachedOrbit->renderFaded(modelview,
+                                 nearZ, farZ, viewFrustumPlaneNormals,
+                                 subdivisionThreshold,
+                                 windowStart, windowEnd,
+                                 orbitColor,
+                                 fadeStart, fadeEnd,
+                                 lineAsTriangles);
+    }
+    else if (orbit->isPeriodic() || (renderFlags & ShowPartialTrajectories) != 0)
+    {
+        cachedOrbit->render(modelview,
+                            nearZ, farZ, viewFrustumPlaneNormals,
+                            subdivisionThreshold,
+                            windowStart, windowEnd,
+                            orbitColor, lineAsTriangles);
     }
     else
     {
-        if ((renderFlags & ShowPartialTrajectories) != 0)
-        {
-            // Show the trajectory from the start time until the current simulation time
-            cachedOrbit->render(modelview,
-                                nearZ, farZ, viewFrustumPlaneNormals,
-                                subdivisionThreshold,
-                                cachedOrbit->startTime(), t,
-                                orbitColor, lineAsTriangles);
-        }
-        else
-        {
-            // Show the entire trajectory
-            cachedOrbit->render(modelview,
-                                nearZ, farZ, viewFrustumPlaneNormals,
-                                subdivisionThreshold,
-                                orbitColor, lineAsTriangles);
-        }
+        // Show the entire trajectory
+        cachedOrbit->render(modelview,
+                            nearZ, farZ, viewFrustumPlaneNormals,
+                            subdivisionThreshold,
+                            orbitColor, lineAsTriangles);
     }
 
 #ifdef STIPPLED_LINES
-    glDisable(GL_LINE_STIPPLE);
+    celestia::gl::disable(GL_LINE_STIPPLE);
 #endif
 }
 
 
-// Convert a position in the universal coordinate system to astrocentric
-// coordinates, taking into account possible orbital motion of the star.
-static Vector3d astrocentricPosition(const UniversalCoord& pos,
-                                     const Star& star,
-                                     double t)
+void Renderer::renderGPUOrbits(const Matrices& m)
 {
-    return pos.offsetFromKm(star.getPosition(t));
+    auto *prog = shaderManager->getShader("orbit");
+    if (prog == nullptr)
+        return;
+
+    prog->use();
+    prog->setMVPMatrices(*m.projection, *m.modelview);
+
+    Renderer::PipelineState ps;
+    ps.blending = true;
+    ps.blendFunc = {GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA};
+    ps.depthTest = true;
+    ps.smoothLines = true;
+    setPipelineState(ps);
+
+    gpuOrbitPaths->draw();
 }
 
 
@@ -1318,6 +1443,7 @@ void Renderer::autoMag(float& faintestMag)
 // coordinates.
 static void
 setupLightSources(const vector<const Star*>& nearStars,
+                  const StarDatabase& starDB,
                   const UniversalCoord& observerPos,
                   double t,
                   vector<LightSource>& lightSources,
@@ -1329,7 +1455,7 @@ setupLightSources(const vector<const Star*>& nearStars,
     {
         if (star->getVisibility())
         {
-            Vector3d v = star->getPosition(t).offsetFromKm(observerPos);
+            Vector3d v = starDB.getStarPosition(*star, t).offsetFromKm(observerPos);
             LightSource ls;
             ls.position = v;
             ls.luminosity = star->getLuminosity();
@@ -1448,18 +1574,86 @@ void Renderer::render(const Observer& observer,
                       float faintestMagNight,
                       const Selection& sel)
 {
+    m_starProcStats = {};
+    m_dsoProcStats = {};
+
+    // Redundant state changes are skipped while the frame is drawn
+    celestia::gl::beginStateCache();
     draw(observer, universe, faintestMagNight, sel);
+    celestia::gl::endStateCache();
+    m_streamBuffer->endFrame();
+
+    auto drawStats = celestia::gl::getDrawStats();
+    frameStats.draw.drawCalls += drawStats.drawCalls;
+    frameStats.draw.triangles += drawStats.triangles;
+    frameStats.draw.lines += drawStats.lines;
+    frameStats.draw.points += drawStats.points;
+    frameStats.draw.programChanges += drawStats.programChanges;
+    frameStats.draw.textureBinds += drawStats.textureBinds;
+    for (std::size_t i = 0; i < celestia::gl::UploadTypeCount; i++)
+        frameStats.draw.uploadedBytes[i] += drawStats.uploadedBytes[i];
+
+    auto stateStats = celestia::gl::getStateCacheStats();
+    frameStats.stateCalls += stateStats.issued;
+    frameStats.stateCallsSkipped += stateStats.skipped;
+
+    frameStats.starNodes += m_starProcStats.nodes;
+    frameStats.stars += m_starProcStats.objects;
+    frameStats.dsoNodes += m_dsoProcStats.nodes;
+    frameStats.dsos += m_dsoProcStats.objects;
+    frameStats.renderListEntries += renderList.size();
+    frameStats.orbitPaths += orbitPathList.size();
+
+    // Resources loaded between frames are counted in the next one
+    std::uint64_t loads = GetTextureManager()->getLoadCount() + GetGeometryManager()->getLoadCount();
+    frameStats.resourcesLoaded += loads - resourceLoadMark;
+    resourceLoadMark = loads;
+    frameStats.views++;
+}
+
+
+void Renderer::beginFrameStats()
+{
+    frameStats = {};
+}
+
+// Return true if the bound framebuffer has a floating point depth buffer;
+// with a fixed point one the reversed depth gains nothing.
+static bool hasFloatDepthBuffer()
+{
+#ifdef GL_ES
+    return false;
+#else
+    GLint fbo = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &fbo);
+    GLint type = GL_NONE;
+    glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER,
+                                          fbo == 0 ? GL_DEPTH : GL_DEPTH_ATTACHMENT,
+                                          GL_FRAMEBUFFER_ATTACHMENT_COMPONENT_TYPE,
+                                          &type);
+    return type == GL_FLOAT;
+#endif
 }
 
+
 void Renderer::draw(const Observer& observer,
                     const Universe& universe,
                     float faintestMagNight,
                     const Selection& sel)
 {
+    if (gpuProfiler != nullptr)
+        gpuProfiler->update();
+    GPUProfileZone renderZone(gpuProfiler.get(), "Render");
+
     // Get the observer's time
     double now = observer.getTime();
     realTime = observer.getRealTime();
 
+    // The positions of stars with orbits are needed several times per
+    // frame, for drawing, lighting and picking; compute them all at once.
+    if (universe.getStarCatalog() != nullptr)
+        universe.getStarCatalog()->updateOrbitingStarPositions(now);
+
     frameCount++;
     settingsChanged = false;
 
@@ -1477,17 +1671,10 @@ void Renderer::draw(const Observer& observer,
 
     m_cameraOrientation = observer.getOrientationf();
 
-    // Get the view frustum used for culling in camera space.
-    Frustum frustum(degToRad(fov), getAspectRatio(), MinNearPlaneDistance);
-
-    // Get the transformed frustum, used for culling in the astrocentric coordinate
-    // system.
-    Frustum xfrustum(frustum);
-    xfrustum.transform(getCameraOrientation().conjugate().toRotationMatrix());
-
     // Set up the projection and modelview matrices.
     // We'll usethem for positioning star and planet labels.
     float aspectRatio = getAspectRatio();
+    setupCullingFrustum(aspectRatio);
     if (getProjectionMode() == Renderer::ProjectionMode::FisheyeMode)
         m_projMatrix = Ortho(-aspectRatio, aspectRatio, -1.0f, 1.0f, NEAR_DIST, FAR_DIST);
     else
@@ -1495,16 +1682,40 @@ void Renderer::draw(const Observer& observer,
     m_modelMatrix = Affine3f(getCameraOrientation()).matrix();
     m_MVPMatrix = m_projMatrix * m_modelMatrix;
 
+    // The projections of the eyes are shifted sideways, so the culling
+    // frustum is widened to contain them.
+    float projectionShift = setupEyes(observer);
+
+    // Get the view frustum used for culling in camera space.
+    Frustum frustum(cullingFov, cullingAspectRatio * (1.0f + projectionShift), MinNearPlaneDistance);
+
+    // Get the transformed frustum, used for culling in the astrocentric coordinate
+    // system.
+    Frustum xfrustum(frustum);
+    xfrustum.transform(getCameraOrientation().conjugate().toRotationMatrix());
+
     depthSortedAnnotations.clear();
     foregroundAnnotations.clear();
     backgroundAnnotations.clear();
     objectAnnotations.clear();
+    frameArena.reset();
 
     // Put all solar system bodies into the render list.  Stars close and
     // large enough to have discernible surface detail are also placed in
     // renderList.
     renderList.clear();
     orbitPathList.clear();
+
+    // The GPU draws whole ellipses, so orbits that are partly drawn or
+    // faded are left to renderOrbit(), as are wide lines.
+    useGPUOrbits = gpuOrbitPaths != nullptr
+                && GPUOrbitPaths::isSupported()
+                && !shouldDrawLineAsTriangles()
+                && detailOptions.orbitPeriodsShown >= 1.0
+                && (detailOptions.linearFadeFraction == 0.0 || (renderFlags & ShowFadingOrbits) == 0)
+                && shaderManager->getShader("orbit") != nullptr;
+    if (gpuOrbitPaths != nullptr)
+        gpuOrbitPaths->clear();
     lightSourceList.clear();
     secondaryIlluminators.clear();
     nearStars.clear();
@@ -1521,8 +1732,11 @@ void Renderer::draw(const Observer& observer,
     }
 
     faintestPlanetMag = faintestMag;
+    if (detailScale < 1.0f)
+        faintestMag += std::log2(std::max(detailScale, 1.0f / 64.0f));
     if ((renderFlags & (ShowSolarSystemObjects | ShowOrbits)) != 0)
     {
+        util::ProfileZone zone("Render lists");
         buildNearSystemsLists(universe, observer, xfrustum, now);
     }
 
@@ -1558,6 +1772,9 @@ void Renderer::draw(const Observer& observer,
 
     ambientColor = Color(ambientLightLevel, ambientLightLevel, ambientLightLevel);
 
+    // Everything drawn from here on is seen from the newest orientation
+    latchOrientation(observer);
+
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glLineWidth(getScaleFactor());
@@ -1568,14 +1785,28 @@ void Renderer::draw(const Observer& observer,
     // Render deep sky objects
     if ((renderFlags & ShowDeepSpaceObjects) != 0 && universe.getDSOCatalog() != nullptr)
     {
+        GPUProfileZone zone(gpuProfiler.get(), "DSOs");
         renderDeepSkyObjects(universe, observer, faintestMag);
     }
 
     // Render stars
     if ((renderFlags & ShowStars) != 0 && universe.getStarCatalog() != nullptr)
     {
+        GPUProfileZone zone(gpuProfiler.get(), "Stars");
         renderPointStars(*universe.getStarCatalog(), faintestMag, observer);
     }
+    else
+    {
+        // The stars of an earlier frame may have been unloaded since
+        pickGrids.erase(&observer);
+    }
+
+    // Render the minor bodies which haven't been promoted to bodies
+    if ((renderFlags & ShowAsteroids) != 0 && universe.getMinorBodies() != nullptr)
+    {
+        GPUProfileZone zone(gpuProfiler.get(), "Minor bodies");
+        renderMinorBodies(*universe.getMinorBodies(), observer, now);
+    }
 
     // Translate the camera before rendering the asterisms and boundaries
     // Set up the camera for star rendering; the units of this phase
@@ -1621,6 +1852,7 @@ void Renderer::draw(const Observer& observer,
 
     // Sort the annotations
     sort(depthSortedAnnotations.begin(), depthSortedAnnotations.end());
+    declutterAnnotations(depthSortedAnnotations, FontNormal);
 
     // Sort the orbit paths
     sort(orbitPathList.begin(), orbitPathList.end());
@@ -1629,8 +1861,15 @@ void Renderer::draw(const Observer& observer,
     glPolygonMode(GL_FRONT_AND_BACK, (GLenum) renderMode);
 #endif
 
+    reverseDepthActive = reverseDepth && isReverseDepthSupported() &&
+                         projectionMode != ProjectionMode::FisheyeMode &&
+                         hasFloatDepthBuffer();
     int nIntervals = buildDepthPartitions();
+    // Solar system objects are drawn in kilometers, like the eye offsets;
+    // everything else is too far away for them to matter.
+    shaderManager->setEyeTranslation(true);
     renderSolarSystemObjects(observer, nIntervals, now);
+    shaderManager->setEyeTranslation(false);
 
     renderForegroundAnnotations(FontNormal);
 
@@ -1642,6 +1881,115 @@ void Renderer::draw(const Observer& observer,
 #ifndef GL_ES
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 #endif
+
+    // The eyes only apply to the view of the observer
+    shaderManager->setViews({});
+}
+
+// Set the eyes of the shader manager for the observer, returning the
+// largest shift of their projections.
+float Renderer::setupEyes(const Observer& observer)
+{
+    ShaderViews views;
+    if (stereoEyes == StereoEyes::None)
+    {
+        shaderManager->setViews(views);
+        return 0.0f;
+    }
+
+    int firstEye = stereoEyes == StereoEyes::Right ? 1 : 0;
+    views.nEyes = stereoEyes == StereoEyes::Both ? 2 : 1;
+    views.multiview = stereoEyes == StereoEyes::Both;
+
+    auto convergence = static_cast<float>(observer.getConvergenceDistance());
+    float maxShift = 0.0f;
+    for (unsigned int i = 0; i < views.nEyes; i++)
+    {
+        EyeTransform& eye = views.eyes[i];
+        eye.position = observer.getEyeOffset(firstEye + static_cast<int>(i)).cast<float>();
+        // Objects at the convergence distance in front of the observer are
+        // projected to the center for both eyes
+        if (convergence > 0.0f)
+            eye.projectionShift = eye.position.x() * m_projMatrix(0, 0) / convergence;
+        maxShift = std::max(maxShift, std::abs(eye.projectionShift));
+    }
+
+    shaderManager->setViews(views);
+    return maxShift;
+}
+
+// Set the frustum stars and deep sky objects are culled with, widened on
+// all sides by the largest late rotation of the view
+void Renderer::setupCullingFrustum(float aspectRatio)
+{
+    cullingFov = degToRad(fov);
+    cullingAspectRatio = aspectRatio;
+    if (lateOrientationSource == nullptr || lateOrientationMargin <= 0.0f)
+        return;
+
+    constexpr float maxHalfAngle = celestia::numbers::pi_v<float> * 0.49f;
+    float halfHeight = std::min(cullingFov / 2.0f + lateOrientationMargin, maxHalfAngle);
+    float halfWidth = std::min(std::atan(aspectRatio * std::tan(cullingFov / 2.0f)) + lateOrientationMargin,
+                               maxHalfAngle);
+    cullingFov = 2.0f * halfHeight;
+    cullingAspectRatio = std::tan(halfWidth) / std::tan(halfHeight);
+}
+
+// Rotate the view from the orientation of the observer the frame was
+// culled for to the newest one, by no more than the culling margin
+void Renderer::latchOrientation(const Observer& observer)
+{
+    Quaternionf latest;
+    if (lateOrientationSource == nullptr || !lateOrientationSource->getLatestOrientation(observer, latest))
+        return;
+
+    Quaternionf rotation = (latest * observer.getOrientationf().conjugate()).normalized();
+    float angle = AngleAxisf(rotation).angle();
+    if (angle > lateOrientationMargin)
+        rotation = Quaternionf::Identity().slerp(lateOrientationMargin / angle, rotation);
+
+    // Without stereo, the rotation applies to a single eye at the camera
+    ShaderViews views = shaderManager->getViews();
+    views.nEyes = std::max(views.nEyes, 1u);
+    views.rotation = rotation.toRotationMatrix();
+    shaderManager->setViews(views);
+}
+
+bool Renderer::isMultiviewSupported() const
+{
+    return ShaderManager::isMultiviewSupported();
+}
+
+bool Renderer::beginMultiview(int width, int height)
+{
+    if (!isMultiviewSupported() || width <= 0 || height <= 0)
+        return false;
+
+    if (multiviewFbo == nullptr || multiviewFbo->width() != width || multiviewFbo->height() != height)
+    {
+        multiviewFbo = std::make_unique<MultiviewFramebuffer>(width, height, MaxShaderViews);
+        if (!multiviewFbo->isValid())
+        {
+            GetLogger()->error("Could not create a {}x{} multiview framebuffer.\n", width, height);
+            multiviewFbo = nullptr;
+            return false;
+        }
+    }
+
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &multiviewTargetFbo);
+    multiviewFbo->bind();
+    setRenderRegion(0, 0, width, height, false);
+    stereoEyes = StereoEyes::Both;
+    return true;
+}
+
+void Renderer::endMultiview(int x, int y)
+{
+    stereoEyes = StereoEyes::None;
+    shaderManager->setViews({});
+
+    for (GLsizei i = 0; i < multiviewFbo->views(); i++)
+        multiviewFbo->copyView(i, static_cast<GLuint>(multiviewTargetFbo), x + i * multiviewFbo->width(), y);
 }
 
 static
@@ -2096,10 +2444,10 @@ void Renderer::renderEllipsoidAtmosphere(const Atmosphere& atmosphere,
     prog->setMVPMatrices(*m.projection, *m.modelview);
     for (int i = 0; i < nRings; i++)
     {
-        glDrawElements(GL_TRIANGLE_STRIP,
-                       (nSlices + 1) * 2,
-                       GL_UNSIGNED_INT,
-                       &skyIndices[(nSlices + 1) * 2 * i]);
+        celestia::gl::drawElements(GL_TRIANGLE_STRIP,
+                                   (nSlices + 1) * 2,
+                                   GL_UNSIGNED_INT,
+                                   &skyIndices[(nSlices + 1) * 2 * i]);
     }
 
     glDisableVertexAttribArray(CelestiaGLProgram::ColorAttributeIndex);
@@ -2187,9 +2535,9 @@ Renderer::locationsToAnnotations(const Body& body,
                                  const Vector3d& bodyPosition,
                                  const Quaterniond& bodyOrientation)
 {
-    const vector<Location*>* locations = body.getLocations();
+    const LocationIndex* locationIndex = body.getLocationIndex();
 
-    if (locations == nullptr)
+    if (locationIndex == nullptr)
         return;
 
     Vector3f semiAxes = body.getSemiAxes();
@@ -2208,7 +2556,21 @@ Renderer::locationsToAnnotations(const Body& body,
 
     Matrix3d bodyMatrix = bodyOrientation.conjugate().toRotationMatrix();
 
-    for (const auto location : *locations)
+    // Skip the features that can't pass the tests below. The horizon of the
+    // inscribed sphere can only be used when the viewer is outside of the
+    // ellipsoid, and when the labels are on it.
+    LocationIndex::Query query;
+    query.viewerPosition = viewRayOrigin;
+    query.viewDirection = bodyOrientation * viewNormal;
+    query.minSizePerDistance = minFeatureSize * pixelSize;
+    query.featureTypes = locationFilter;
+    query.occluderRadius = body.isEllipsoid() && viewRayOrigin.norm() > boundingRadius
+                         ? (double) semiAxes.minCoeff()
+                         : 0.0;
+    vector<const Location*> locations;
+    locationIndex->find(query, locations);
+
+    for (const auto location : locations)
     {
         auto featureType = location->getFeatureType();
         if ((featureType & locationFilter) != 0)
@@ -2527,6 +2889,10 @@ void Renderer::renderObject(const Vector3f& pos,
         geometry = GetGeometryManager()->find(obj.geometry);
     }
 
+    // Models still being loaded in the background are drawn as ellipsoids
+    bool isEllipsoid = obj.geometry == InvalidResource ||
+                       (geometry == nullptr && GetGeometryManager()->isLoading(obj.geometry));
+
     // Get the textures . . .
     if (obj.surface->baseTexture.tex[textureResolution] != InvalidResource)
         ri.baseTex = obj.surface->baseTexture.find(textureResolution);
@@ -2586,6 +2952,7 @@ void Renderer::renderObject(const Vector3f& pos,
     ri.orientation = getCameraOrientation() * obj.orientation.conjugate();
 
     ri.pixWidth = discSizeInPixels;
+    ri.modelPixelScale = geometryScale / (max(nearPlaneDistance, altitude) * pixelSize);
 
     // Set up the colors
     if (ri.baseTex == nullptr ||
@@ -2613,7 +2980,7 @@ void Renderer::renderObject(const Vector3f& pos,
     // be seen, make the far plane of the frustum as close to the viewer
     // as possible.
     float frustumFarPlane = farPlaneDistance;
-    if (obj.geometry == InvalidResource)
+    if (isEllipsoid)
     {
         // Only adjust the far plane for ellipsoidal objects
         float d = pos.norm();
@@ -2677,7 +3044,7 @@ void Renderer::renderObject(const Vector3f& pos,
             cloudTexOffset = (float) (-pfmod(now * atmosphere->cloudSpeed / (2 * celestia::numbers::pi), 1.0));
     }
 
-    if (obj.geometry == InvalidResource)
+    if (isEllipsoid)
     {
         // A null model indicates that this body is a sphere
         if (lit)
@@ -2726,7 +3093,7 @@ void Renderer::renderObject(const Vector3f& pos,
                                           astro::daysToSecs(now - astro::J2000),
                                           planetMVP, this);
             }
-            glActiveTexture(GL_TEXTURE0);
+            celestia::gl::activeTexture(GL_TEXTURE0);
         }
     }
 
@@ -2815,7 +3182,7 @@ void Renderer::renderObject(const Vector3f& pos,
             // the viewer.
             if (distance > radius * 1.1f)
             {
-                glEnable(GL_POLYGON_OFFSET_FILL);
+                celestia::gl::enable(GL_POLYGON_OFFSET_FILL);
                 glPolygonOffset(-1.0f, -1.0f);
             }
 
@@ -2838,7 +3205,7 @@ void Renderer::renderObject(const Vector3f& pos,
                 renderCloudsUnlit(ri,viewFrustum, cloudTex, cloudTexOffset, mvp, this);
             }
 
-            glDisable(GL_POLYGON_OFFSET_FILL);
+            celestia::gl::disable(GL_POLYGON_OFFSET_FILL);
             glFrontFace(GL_CCW);
         }
     }
@@ -2865,23 +3232,62 @@ void Renderer::renderObject(const Vector3f& pos,
 }
 
 
+/*! Return true if the body may cast eclipse shadows at the given time.
+ *  Eclipses where the caster is not an ellipsoid are ignored, since we
+ *  can't generate correct shadows in this case.
+ */
+bool Renderer::isEclipseCaster(const Body& body, double now) const
+{
+    return body.hasVisibleGeometry() &&
+           (body.getClassification() & bodyVisibilityMask) != 0 &&
+           body.extant(now) &&
+           body.isEllipsoid();
+}
+
+
+/*! Return the bodies of a planetary system that may cast eclipse shadows,
+ *  with their positions. The list is built the first time it's needed in
+ *  a frame, so that the positions aren't computed again for each receiver
+ *  in the system.
+ */
+const std::vector<EclipseCaster>&
+Renderer::getEclipseCasters(const PlanetarySystem* system, double now)
+{
+    EclipseCasterList& list = eclipseCasters[system];
+    if (list.frame == frameCount)
+        return list.casters;
+
+    list.frame = frameCount;
+    list.casters.clear();
+    int nBodies = system->getSystemSize();
+    for (int i = 0; i < nBodies; i++)
+    {
+        const Body* body = system->getBody(i);
+        if (isEclipseCaster(*body, now))
+            list.casters.push_back({ body, body->getAstrocentricPosition(now), body->getRadius() });
+    }
+
+    // Receivers stop at the first caster too small to shadow them
+    std::sort(list.casters.begin(), list.casters.end(),
+              [](const EclipseCaster& a, const EclipseCaster& b) { return a.radius > b.radius; });
+
+    return list.casters;
+}
+
+
 bool Renderer::testEclipse(const Body& receiver,
-                           const Body& caster,
+                           const Vector3d& posReceiver,
+                           const EclipseCaster& eclipseCaster,
                            LightingState& lightingState,
                            unsigned int lightIndex,
                            double now)
 {
     bool isReceiverShadowed = false;
+    const Body& caster = *eclipseCaster.body;
 
     // Ignore situations where the shadow casting body is much smaller than
-    // the receiver, as these shadows aren't likely to be relevant.  Also,
-    // ignore eclipses where the caster is not an ellipsoid, since we can't
-    // generate correct shadows in this case.
-    if (caster.getRadius() >= receiver.getRadius() * MinRelativeOccluderRadius &&
-        caster.hasVisibleGeometry() &&
-        (caster.getClassification() & bodyVisibilityMask) != 0 &&
-        caster.extant(now) &&
-        caster.isEllipsoid())
+    // the receiver, as these shadows aren't likely to be relevant.
+    if (eclipseCaster.radius >= receiver.getRadius() * MinRelativeOccluderRadius)
     {
         const DirectionalLight& light = lightingState.lights[lightIndex];
         LightingState::EclipseShadowVector& shadows = *lightingState.shadows[lightIndex];
@@ -2894,8 +3300,7 @@ bool Renderer::testEclipse(const Body& receiver,
         // less than the distance between the sun and the receiver.  This
         // approximation works everywhere in the solar system, and is likely
         // valid for any orbitally stable pair of objects orbiting a star.
-        Vector3d posReceiver = receiver.getAstrocentricPosition(now);
-        Vector3d posCaster = caster.getAstrocentricPosition(now);
+        const Vector3d& posCaster = eclipseCaster.position;
 
         //const Star* sun = receiver.getSystem()->getStar();
         //assert(sun != nullptr);
@@ -3014,6 +3419,63 @@ bool Renderer::testEclipse(const Body& receiver,
 }
 
 
+/*! Queue a body for instanced drawing at the end of the opaque pass.
+ *  Returns false if the body has to be drawn by renderObject() instead:
+ *  only opaque, lit, uniformly scaled models without atmospheres, rings,
+ *  shadows or texture overrides are drawn with instancing.
+ */
+bool Renderer::addModelInstance(const Vector3f& pos,
+                                float distance,
+                                float nearPlaneDistance,
+                                const RenderProperties& obj,
+                                const LightingState& ls)
+{
+    if (!collectModelInstances || obj.geometry == InvalidResource)
+        return false;
+
+    if ((obj.surface->appearanceFlags & Surface::Emissive) != 0 ||
+        obj.surface->baseTexture.tex[textureResolution] != InvalidResource ||
+        obj.atmosphere != nullptr ||
+        (obj.rings != nullptr && (renderFlags & ShowPlanetRings) != 0))
+    {
+        return false;
+    }
+
+    if (ls.shadowingRingSystem != nullptr)
+        return false;
+    for (unsigned int i = 0; i < ls.nLights; i++)
+    {
+        if (ls.shadows[i] != nullptr && !ls.shadows[i]->empty())
+            return false;
+    }
+
+    auto* shadowBuffer = getShadowFBO(0);
+    if (shadowBuffer != nullptr && shadowBuffer->isValid())
+        return false;
+
+    const Geometry* geometry = GetGeometryManager()->find(obj.geometry);
+    if (geometry == nullptr || !geometry->isOpaque() || !geometry->supportsInstancing())
+        return false;
+
+    float scale;
+    if (geometry->isNormalized())
+    {
+        if (obj.semiAxes.x() != obj.semiAxes.y() || obj.semiAxes.x() != obj.semiAxes.z())
+            return false;
+        scale = obj.radius * obj.semiAxes.x();
+    }
+    else
+    {
+        scale = obj.geometryScale;
+    }
+
+    Affine3f transform = Translation3f(pos) * obj.orientation.conjugate() * Scaling(scale);
+    float altitude = distance - obj.radius;
+    float pixelScale = scale / (max(nearPlaneDistance, altitude) * pixelSize);
+    modelInstances->add(obj.geometry, transform, ls, obj.surface->lunarLambert, pixelScale);
+    return true;
+}
+
 void Renderer::renderPlanet(Body& body,
                             const Vector3f& pos,
                             float distance,
@@ -3112,6 +3574,8 @@ void Renderer::renderPlanet(Body& body,
             body.getSystem() != nullptr)
         {
             PlanetarySystem* system = body.getSystem();
+            Vector3d posReceiver = body.getAstrocentricPosition(now);
+            float minCasterRadius = body.getRadius() * MinRelativeOccluderRadius;
             if (system->getPrimaryBody() == nullptr)
             {
                 // The body is a planet.  Check for eclipse shadows
@@ -3119,14 +3583,16 @@ void Renderer::renderPlanet(Body& body,
                 PlanetarySystem* satellites = body.getSatellites();
                 if (satellites != nullptr)
                 {
-                    int nSatellites = satellites->getSystemSize();
+                    const auto& casters = getEclipseCasters(satellites, now);
                     for (unsigned int li = 0; li < lights.nLights; li++)
                     {
                         if (lights.lights[li].castsShadows)
                         {
-                            for (int i = 0; i < nSatellites; i++)
+                            for (const auto& caster : casters)
                             {
-                                testEclipse(body, *satellites->getBody(i), lights, li, now);
+                                if (caster.radius < minCasterRadius)
+                                    break;
+                                testEclipse(body, posReceiver, caster, lights, li, now);
                             }
                         }
                     }
@@ -3134,32 +3600,37 @@ void Renderer::renderPlanet(Body& body,
             }
             else
             {
+                // The body is a moon.  Check for eclipse shadows from
+                // the parent planet and all satellites in the system.
+                // Traverse up the hierarchy so that any parent objects
+                // of the parent are also considered (TODO: their child
+                // objects will not be checked for shadows.)
+                std::vector<EclipseCaster>& planets = eclipseParents;
+                planets.clear();
+                for (Body* planet = system->getPrimaryBody(); planet != nullptr;)
+                {
+                    if (isEclipseCaster(*planet, now))
+                        planets.push_back({ planet, planet->getAstrocentricPosition(now), planet->getRadius() });
+                    if (planet->getSystem() != nullptr)
+                        planet = planet->getSystem()->getPrimaryBody();
+                    else
+                        planet = nullptr;
+                }
+
+                const auto& casters = getEclipseCasters(system, now);
                 for (unsigned int li = 0; li < lights.nLights; li++)
                 {
                     if (lights.lights[li].castsShadows)
                     {
-                        // The body is a moon.  Check for eclipse shadows from
-                        // the parent planet and all satellites in the system.
-                        // Traverse up the hierarchy so that any parent objects
-                        // of the parent are also considered (TODO: their child
-                        // objects will not be checked for shadows.)
-                        Body* planet = system->getPrimaryBody();
-                        while (planet != nullptr)
-                        {
-                            testEclipse(body, *planet, lights, li, now);
-                            if (planet->getSystem() != nullptr)
-                                planet = planet->getSystem()->getPrimaryBody();
-                            else
-                                planet = nullptr;
-                        }
+                        for (const auto& planet : planets)
+                            testEclipse(body, posReceiver, planet, lights, li, now);
 
-                        int nSatellites = system->getSystemSize();
-                        for (int i = 0; i < nSatellites; i++)
+                        for (const auto& caster : casters)
                         {
-                            if (system->getBody(i) != &body)
-                            {
-                                testEclipse(body, *system->getBody(i), lights, li, now);
-                            }
+                            if (caster.radius < minCasterRadius)
+                                break;
+                            if (caster.body != &body)
+                                testEclipse(body, posReceiver, caster, lights, li, now);
                         }
                     }
                 }
@@ -3247,9 +3718,12 @@ void Renderer::renderPlanet(Body& body,
             }
         }
 
-        renderObject(pos, distance, now,
-                     nearPlaneDistance, farPlaneDistance,
-                     rp, lights, m);
+        if (!addModelInstance(pos, distance, nearPlaneDistance, rp, lights))
+        {
+            renderObject(pos, distance, now,
+                         nearPlaneDistance, farPlaneDistance,
+                         rp, lights, m);
+        }
 
         if (body.getLocations() != nullptr && (labelMode & LocationLabels) != 0)
         {
@@ -3358,6 +3832,10 @@ void Renderer::renderStar(const Star& star,
 
 static const int MaxCometTailPoints = 120;
 static const int CometTailSlices = 48;
+// The tail is drawn at one of these levels of detail, from 1 to
+// CometTailLODLevels
+static const int CometTailLODLevels = 5;
+
 struct CometTailVertex
 {
     Vector3f point;
@@ -3365,7 +3843,89 @@ struct CometTailVertex
     float brightness;
 };
 
-static CometTailVertex cometTailVertices[CometTailSlices * MaxCometTailPoints];
+// The number of points along the tail and around it at a level of detail
+static void cometTailResolution(int level, int& nTailPoints, int& nTailSlices)
+{
+    float lod = (float) level / (float) CometTailLODLevels;
+    nTailPoints = (int) (MaxCometTailPoints * lod);
+    nTailSlices = (int) (CometTailSlices * lod);
+}
+
+// The number of vertices of the triangle strip of a level of detail:
+// a strip around each section of the tail, joined to the next by a
+// repeated vertex.
+static int cometTailStripLength(int level)
+{
+    int nTailPoints, nTailSlices;
+    cometTailResolution(level, nTailPoints, nTailSlices);
+    return (nTailPoints - 1) * (nTailSlices * 2 + 2) + (nTailPoints - 2);
+}
+
+// The tail of every comet is the same cone, rotated to point away from
+// the sun and scaled by the length of the tail; it's built once, in
+// coordinates where the tail extends from the origin along the z axis
+// with unit length, and drawn with a transformation. The strips of all
+// the levels of detail follow one another.
+static void buildCometTail(vector<CometTailVertex>& vertices)
+{
+    const float tailRadius = 0.1f;
+
+    for (int level = 1; level <= CometTailLODLevels; level++)
+    {
+        int nTailPoints, nTailSlices;
+        cometTailResolution(level, nTailPoints, nTailSlices);
+
+        vector<CometTailVertex> rings(nTailPoints * nTailSlices);
+        for (int i = 0; i < nTailPoints; i++)
+        {
+            float alpha = (float) i / (float) nTailPoints;
+            float z = alpha * alpha;
+            float brightness = 1.0f - (float) i / (float) (nTailPoints - 1);
+            float w0, w1;
+            // Special case the first vertex in the comet tail
+            if (i == 0)
+            {
+                w0 = 1.0f;
+                w1 = 0.0f;
+            }
+            else
+            {
+                float previous = (float) (i - 1) / (float) nTailPoints;
+                float sectionLength = z - previous * previous;
+                float dr = (tailRadius / (float) nTailPoints) / sectionLength;
+                w0 = atan(dr);
+                float d = sqrt(1.0f + w0 * w0);
+                w1 = 1.0f / d;
+                w0 = w0 / d;
+            }
+
+            float radius = (float) i / (float) nTailPoints * tailRadius;
+            for (int j = 0; j < nTailSlices; j++)
+            {
+                float theta = (float) (2 * celestia::numbers::pi * (float) j / nTailSlices);
+                float s, c;
+                sincos(theta, s, c);
+                CometTailVertex& vtx = rings[i * nTailSlices + j];
+                vtx.normal = Vector3f(s * w1, c * w1, w0).normalized();
+                vtx.point = Vector3f(s * radius, c * radius, z);
+                vtx.brightness = brightness;
+            }
+        }
+
+        for (int i = 0; i < nTailPoints - 1; i++)
+        {
+            if (i > 0)
+                vertices.push_back(rings[i * nTailSlices]);
+            for (int j = 0; j < nTailSlices; j++)
+            {
+                vertices.push_back(rings[i * nTailSlices + j]);
+                vertices.push_back(rings[(i + 1) * nTailSlices + j]);
+            }
+            vertices.push_back(rings[i * nTailSlices]);
+            vertices.push_back(rings[(i + 1) * nTailSlices]);
+        }
+    }
+}
 
 // Compute a rough estimate of the visible length of the dust tail.
 // TODO: This is old code that needs to be rewritten. For one thing,
@@ -3391,12 +3951,7 @@ void Renderer::renderCometTail(const Body& body,
 
     double now = observer.getTime();
 
-    Vector3f cometPoints[MaxCometTailPoints];
     Vector3d pos0 = body.getOrbit(now)->positionAtTime(now);
-#if 0
-    Vector3d pos1 = body.getOrbit(now)->positionAtTime(now - 0.01);
-    Vector3d vd = pos1 - pos0;
-#endif
     double t = now;
 
     float distanceFromSun, irradiance_max = 0.0f;
@@ -3404,8 +3959,7 @@ void Renderer::renderCometTail(const Body& body,
     // Adjust the amount of triangles used for the comet tail based on
     // the screen size of the comet.
     float lod = min(1.0f, max(0.2f, discSizeInPixels / 1000.0f));
-    auto nTailPoints = (int) (MaxCometTailPoints * lod);
-    auto nTailSlices = (int) (CometTailSlices * lod);
+    int level = max(1, min(CometTailLODLevels, (int) ceil(lod * CometTailLODLevels)));
 
     // Find the sun with the largest irrradiance of light onto the comet
     // as function of the comet's position;
@@ -3433,86 +3987,36 @@ void Renderer::renderCometTail(const Body& body,
     Vector3f sunDir = (pos.cast<double>() - sunPos).cast<float>().normalized();
 
     float dustTailLength = cometDustTailLength((float) pos0.norm(), body.getRadius());
-    float dustTailRadius = dustTailLength * 0.1f;
 
     Vector3f origin = -sunDir * (body.getRadius() * 100);
 
-    int i;
-    for (i = 0; i < nTailPoints; i++)
-    {
-        float alpha = (float) i / (float) nTailPoints;
-        alpha = alpha * alpha;
-        cometPoints[i] = origin + sunDir * (dustTailLength * alpha);
-    }
-
     // We need three axes to define the coordinate system for rendering the
     // comet.  The first axis is the sun-to-comet direction, and the other
     // two are chose orthogonal to each other and the primary axis.
-    Vector3f v = (cometPoints[1] - cometPoints[0]).normalized();
-    Quaternionf q = body.getEclipticToEquatorial(t).cast<float>();
+    Vector3f v = sunDir;
     Vector3f u = v.unitOrthogonal();
     Vector3f w = u.cross(v);
+    Matrix3f axes;
+    axes << u, w, v;
 
-    for (i = 0; i < nTailPoints; i++)
-    {
-        float brightness = 1.0f - (float) i / (float) (nTailPoints - 1);
-        Vector3f v0, v1;
-        float sectionLength;
-        float w0, w1;
-        // Special case the first vertex in the comet tail
-        if (i == 0)
-        {
-            v0 = cometPoints[1] - cometPoints[0];
-            sectionLength = v0.norm();
-            v0.normalize();
-            v1 = v0;
-            w0 = 1.0f;
-            w1 = 0.0f;
-        }
-        else
-        {
-            v0 = cometPoints[i] - cometPoints[i - 1];
-            sectionLength = v0.norm();
-            v0.normalize();
-
-            if (i == nTailPoints - 1)
-            {
-                v1 = v0;
-            }
-            else
-            {
-                v1 = (cometPoints[i + 1] - cometPoints[i]).normalized();
-                q.setFromTwoVectors(v0, v1);
-                Matrix3f m = q.toRotationMatrix();
-                u = m * u;
-                v = m * v;
-                w = m * w;
-            }
-            float dr = (dustTailRadius / (float) nTailPoints) / sectionLength;
-            w0 = atan(dr);
-            float d = sqrt(1.0f + w0 * w0);
-            w1 = 1.0f / d;
-            w0 = w0 / d;
-        }
+    Matrix4f tailTransform = Matrix4f::Identity();
+    tailTransform.topLeftCorner<3, 3>() = axes * dustTailLength;
+    tailTransform.topRightCorner<3, 1>() = pos + origin;
 
-        float radius = (float) i / (float) nTailPoints * dustTailRadius;
-        for (int j = 0; j < nTailSlices; j++)
-        {
-            float theta = (float) (2 * celestia::numbers::pi * (float) j / nTailSlices);
-            float s, c;
-            sincos(theta, s, c);
-            CometTailVertex& vtx = cometTailVertices[i * nTailSlices + j];
-            vtx.normal = u * (s * w1) + w * (c * w1) + v * w0;
-            vtx.normal.normalize();
-            s *= radius;
-            c *= radius;
-
-            vtx.point = cometPoints[i] + u * s + w * c;
-            vtx.brightness = brightness;
-        }
+    auto &vo = getVertexObject(VOType::CometTail, GL_ARRAY_BUFFER, 0, GL_STATIC_DRAW);
+    vo.bind();
+    if (!vo.initialized())
+    {
+        vector<CometTailVertex> vertices;
+        buildCometTail(vertices);
+        vo.allocate(vertices.size() * sizeof(CometTailVertex), vertices.data());
+        vo.setVertices(3, GL_FLOAT, false, sizeof(CometTailVertex), offsetof(CometTailVertex, point));
+        vo.setNormals(3, GL_FLOAT, false, sizeof(CometTailVertex), offsetof(CometTailVertex, normal));
+        vo.setVertexAttribArray(CelestiaGLProgram::IntensityAttributeIndex, 1, GL_FLOAT, false,
+                                sizeof(CometTailVertex), offsetof(CometTailVertex, brightness));
     }
 
-    glDisable(GL_CULL_FACE);
+    celestia::gl::disable(GL_CULL_FACE);
 
     Renderer::PipelineState ps;
     ps.blending = true;
@@ -3521,55 +4025,23 @@ void Renderer::renderCometTail(const Body& body,
     setPipelineState(ps);
 
     prog->use();
-    prog->setMVPMatrices(*m.projection, (*m.modelview) * vecgl::translate(pos));
+    prog->setMVPMatrices(*m.projection, (*m.modelview) * tailTransform);
 
-    glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
-    glEnableVertexAttribArray(CelestiaGLProgram::NormalAttributeIndex);
-    auto brightness = prog->attribIndex("brightness");
-    if (brightness != -1)
-        glEnableVertexAttribArray(brightness);
     prog->vec3Param("color") = body.getCometTailColor().toVector3();
-    prog->vec3Param("viewDir") = pos.normalized();
+    // The normals are in the coordinates of the tail
+    prog->vec3Param("viewDir") = axes.transpose() * pos.normalized();
     // If fadeDistFromSun = x/x0 >= 1.0, comet tail starts fading,
     // i.e. fadeFactor quickly transits from 1 to 0.
     float fadeFactor = 0.5f * (1.0f - tanh(fadeDistance - 1.0f / fadeDistance));
     prog->floatParam("fadeFactor") = fadeFactor;
 
-    vector<unsigned short> indices;
-    indices.reserve(nTailSlices * 2 + 2);
-    for (int j = 0; j < nTailSlices; j++)
-    {
-        indices.push_back(j);
-        indices.push_back(j + nTailSlices);
-    }
-    indices.push_back(0);
-    indices.push_back(nTailSlices);
+    int first = 0;
+    for (int i = 1; i < level; i++)
+        first += cometTailStripLength(i);
+    vo.draw(GL_TRIANGLE_STRIP, cometTailStripLength(level), first);
 
-    const size_t stride = sizeof(CometTailVertex);
-    for (i = 0; i < nTailPoints - 1; i++)
-    {
-        const auto p = &cometTailVertices[i * nTailSlices];
-        glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
-                              3, GL_FLOAT, GL_FALSE, stride, &p->point);
-        glVertexAttribPointer(CelestiaGLProgram::NormalAttributeIndex,
-                              3, GL_FLOAT, GL_FALSE, stride, &p->normal);
-        if (brightness != -1)
-            glVertexAttribPointer(brightness, 1, GL_FLOAT, GL_FALSE, stride, &p->brightness);
-        glDrawElements(GL_TRIANGLE_STRIP, indices.size(), GL_UNSIGNED_SHORT, indices.data());
-    }
-    glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
-    glDisableVertexAttribArray(CelestiaGLProgram::NormalAttributeIndex);
-    if (brightness != -1)
-        glDisableVertexAttribArray(brightness);
-    glEnable(GL_CULL_FACE);
-
-#ifdef DEBUG_COMET_TAIL
-    glColor4f(0.0f, 1.0f, 1.0f, 0.5f);
-    glEnableClientState(GL_VERTEX_ARRAY);
-    glVertexPointer(3, GL_FLOAT, 0, cometPoints);
-    glDrawArrays(GL_LINE_STRIP, 0, nTailPoints);
-    glDisableClientState(GL_VERTEX_ARRAY);
-#endif
+    vo.unbind();
+    celestia::gl::enable(GL_CULL_FACE);
 }
 
 
@@ -3777,6 +4249,295 @@ void Renderer::addRenderListEntries(RenderListEntry& rle,
 }
 
 
+// Remove the bodies from the render list which are entirely hidden behind
+// one of the largest ellipsoidal bodies in view, taking the sphere
+// inscribed in the ellipsoid as the occluder. Labels are made from the
+// render list, so the hidden bodies aren't labeled either.
+void Renderer::removeOccludedBodies()
+{
+    // Bodies smaller on the screen rarely hide anything
+    constexpr std::size_t MaxOccluders = 4;
+    constexpr float MinOccluderSize = 16.0f;
+
+    std::array<const RenderListEntry*, MaxOccluders> occluders;
+    std::size_t nOccluders = 0;
+    for (const auto& rle : renderList)
+    {
+        if (rle.renderableType != RenderListEntry::RenderableBody ||
+            rle.discSizeInPixels < MinOccluderSize ||
+            !rle.body->isEllipsoid())
+        {
+            continue;
+        }
+
+        // Keep the largest ones, sorted by decreasing size
+        std::size_t i = nOccluders;
+        if (nOccluders < MaxOccluders)
+            nOccluders++;
+        else if (rle.discSizeInPixels <= occluders[i - 1]->discSizeInPixels)
+            continue;
+        else
+            i--;
+        for (; i > 0 && occluders[i - 1]->discSizeInPixels < rle.discSizeInPixels; i--)
+            occluders[i] = occluders[i - 1];
+        occluders[i] = &rle;
+    }
+
+    if (nOccluders == 0)
+        return;
+
+    std::array<Sphered, MaxOccluders> spheres;
+    std::array<const Body*, MaxOccluders> bodies;
+    for (std::size_t i = 0; i < nOccluders; i++)
+    {
+        spheres[i] = Sphered(occluders[i]->position.cast<double>(), occluders[i]->body->getSemiAxes().minCoeff());
+        bodies[i] = occluders[i]->body;
+    }
+
+    auto isHidden = [&](const RenderListEntry& rle)
+    {
+        if (rle.renderableType != RenderListEntry::RenderableBody)
+            return false;
+
+        Sphered object(rle.position.cast<double>(), rle.body->getCullingRadius());
+        for (std::size_t i = 0; i < nOccluders; i++)
+        {
+            if (bodies[i] != rle.body && isOccluded(spheres[i], object))
+                return true;
+        }
+        return false;
+    };
+    renderList.erase(std::remove_if(renderList.begin(), renderList.end(), isHidden), renderList.end());
+}
+
+
+static bool isInViewCone(const Vector3d& pos_v,
+                         const Vector3d& viewPlaneNormal,
+                         double radius,
+                         double sinViewAngle,
+                         double invCosViewAngle)
+{
+    // dist_vn: distance along view normal from the viewer to the
+    // projection of the object's center.
+    double dist_vn = viewPlaneNormal.dot(pos_v);
+    if (dist_vn <= -radius)
+        return false;
+
+    double maxPerpDist = (radius + dist_vn * sinViewAngle) * invCosViewAngle;
+    double perpDistSq = (pos_v - dist_vn * viewPlaneNormal).squaredNorm();
+    return perpDistSq < maxPerpDist * maxPerpDist;
+}
+
+// Return whether anything inside a sphere may be drawn, so that the
+// orbits of the bodies in it don't have to be evaluated when it can't. The
+// sphere must intersect the view frustum and, when testSize is set, contain
+// room for an object larger than a pixel or one bright enough to be seen.
+// As in the subtree test of buildRenderLists, the brightness estimate places
+// an object of maxBodyRadius at opposition, here as close to each light
+// source as the sphere allows.
+bool Renderer::isBoundingSphereVisible(const Vector3d& center_v,
+                                       double radius,
+                                       double maxBodyRadius,
+                                       bool testSize,
+                                       const Frustum& viewFrustum) const
+{
+    if (viewFrustum.testSphere(center_v, radius) == Frustum::Outside)
+        return false;
+
+    // Objects may be very close to a viewer inside the sphere
+    auto minPossibleDistance = (float) (center_v.norm() - radius);
+    if (!testSize || minPossibleDistance <= 1.0f)
+        return true;
+
+    if ((float) maxBodyRadius / minPossibleDistance / pixelSize > 1.0f)
+        return true;
+
+    float lum = 0.0f;
+    for (const auto& lightSource : lightSourceList)
+    {
+        auto sunDistance = (float) (center_v - lightSource.position).norm();
+        // Objects could be arbitrarily close to a light source inside the
+        // sphere, and so arbitrarily bright
+        if (sunDistance <= radius)
+            return true;
+        lum += luminosityAtOpposition(lightSource.luminosity, sunDistance - (float) radius, (float) maxBodyRadius);
+    }
+
+    return astro::lumToAppMag(lum, astro::kilometersToLightYears(minPossibleDistance)) < faintestPlanetMag;
+}
+
+// Test child n of a frame tree against its cached bounds. Children that
+// light other bodies are always accepted, and the size test is skipped for
+// labeled ones since their labels are drawn however small they are.
+bool Renderer::isChildVisible(const FrameTree* tree,
+                              unsigned int n,
+                              const Vector3d& frameCenter_v,
+                              int labelClassMask,
+                              const Frustum& viewFrustum) const
+{
+    const FrameTree::ChildBounds* bounds = tree->getChildBounds(n);
+    if (bounds == nullptr || bounds->secondaryIlluminators)
+        return true;
+
+    bool isLabeled = (tree->getChild(n)->body()->getOrbitClassification() & labelClassMask) != 0;
+    return isBoundingSphereVisible(frameCenter_v, bounds->radius, bounds->maxCullingRadius, !isLabeled, viewFrustum);
+}
+
+// Compute the render list entry of a body inside the view cone; return
+// false if it's too small and faint to be drawn or labeled.
+bool Renderer::makeRenderListEntry(const Body& body,
+                                   const Vector3d& pos_s,
+                                   const Vector3d& pos_v,
+                                   const Vector3f& viewMatZ,
+                                   int labelClassMask,
+                                   RenderListEntry& rle,
+                                   bool& isLabeled) const
+{
+    // Calculate the distance to the viewer
+    double dist_v = pos_v.norm();
+
+    // Calculate the size of the planet/moon disc in pixels
+    float discSize = (body.getCullingRadius() / (float) dist_v) / pixelSize;
+
+    // Compute the apparent magnitude; instead of summing the reflected
+    // light from all nearby stars, we just consider the one with the
+    // highest apparent brightness.
+    float appMag = 100.0f;
+    for (unsigned int li = 0; li < lightSourceList.size(); li++)
+    {
+        Vector3d sunPos = pos_v - lightSourceList[li].position;
+        appMag = min(appMag, body.getApparentMagnitude(lightSourceList[li].luminosity, sunPos, pos_v));
+    }
+
+    bool visibleAsPoint = appMag < faintestPlanetMag && body.isVisibleAsPoint();
+    isLabeled = (body.getOrbitClassification() & labelClassMask) != 0;
+
+    if (!(discSize > 1 || visibleAsPoint || isLabeled) || !isBodyVisible(&body, bodyVisibilityMask))
+        return false;
+
+    rle.position = pos_v.cast<float>();
+    rle.distance = (float) dist_v;
+    rle.centerZ = pos_v.cast<float>().dot(viewMatZ);
+    rle.appMag   = appMag;
+    rle.discSizeInPixels = body.getRadius() / ((float) dist_v * pixelSize);
+
+    // TODO: Remove this. It's only used in two places: for calculating comet tail
+    // length, and for calculating sky brightness to adjust the limiting magnitude.
+    // In both cases, it's the wrong quantity to use (e.g. for objects with orbits
+    // defined relative to the SSB.)
+    rle.sun = -pos_s.cast<float>();
+
+    return true;
+}
+
+// Cull the children of a large frame tree, such as those of an asteroid
+// belt, on the render list threads. Only bodies without a frame tree of
+// their own that don't illuminate others and have a thread safe orbit are
+// handled; their entries are added in child order once all tasks are done.
+// Return for each child whether it still has to be processed.
+ArenaVector<bool>
+Renderer::buildRenderListsParallel(const Vector3d& astrocentricObserverPos,
+                                   const Frustum& viewFrustum,
+                                   const Vector3d& viewPlaneNormal,
+                                   const Vector3d& frameCenter,
+                                   const FrameTree* tree,
+                                   const Vector3f& viewMatZ,
+                                   double now)
+{
+    struct Entry
+    {
+        unsigned int child;
+        bool isLabeled;
+        RenderListEntry rle;
+    };
+
+    constexpr unsigned int NotCulled = ~0u;
+
+    int labelClassMask = translateLabelModeToClassMask(labelMode);
+    double invCosViewAngle = 1.0 / cosViewConeAngle;
+    double sinViewAngle = sqrt(1.0 - square(cosViewConeAngle));
+
+    unsigned int nChildren = tree->childCount();
+    ArenaVector<bool> culled(nChildren, false, ArenaAllocator<bool>(frameArena));
+
+    // Frames may use rotation models that aren't thread safe, so their
+    // orientations are computed here; siblings nearly always share one.
+    ArenaVector<Quaterniond> orientations{ ArenaAllocator<Quaterniond>(frameArena) };
+    ArenaVector<unsigned int> orientationIndex(nChildren, NotCulled, ArenaAllocator<unsigned int>(frameArena));
+    const ReferenceFrame* lastFrame = nullptr;
+    for (unsigned int i = 0; i < nChildren; i++)
+    {
+        const auto& phase = tree->getChild(i);
+        if (!phase->includes(now) ||
+            !isChildVisible(tree, i, frameCenter - astrocentricObserverPos, labelClassMask, viewFrustum))
+        {
+            culled[i] = true;
+            continue;
+        }
+
+        const Body* body = phase->body();
+        if (body->getFrameTree() != nullptr || body->isSecondaryIlluminator() || !phase->orbit()->isThreadSafe())
+            continue;
+
+        if (phase->orbitFrame().get() != lastFrame)
+        {
+            lastFrame = phase->orbitFrame().get();
+            orientations.push_back(lastFrame->getOrientation(now).conjugate());
+        }
+        orientationIndex[i] = orientations.size() - 1;
+        culled[i] = true;
+    }
+
+    const BodySnapshot* snapshot = bodySnapshot != nullptr && bodySnapshot->getTime() == now
+                                 ? bodySnapshot
+                                 : nullptr;
+
+    // The arena isn't thread safe, so the batches get their full capacity
+    // here and the tasks never grow them.
+    unsigned int nBatches = (nChildren + RenderListBatchSize - 1) / RenderListBatchSize;
+    ArenaVector<ArenaVector<Entry>> batches{ ArenaAllocator<ArenaVector<Entry>>(frameArena) };
+    batches.reserve(nBatches);
+    for (unsigned int b = 0; b < nBatches; b++)
+        batches.emplace_back(ArenaAllocator<Entry>(frameArena)).reserve(RenderListBatchSize);
+    for (unsigned int b = 0; b < nBatches; b++)
+    {
+        renderListPool->submit([&, b]
+        {
+            unsigned int end = std::min(nChildren, (b + 1) * RenderListBatchSize);
+            for (unsigned int i = b * RenderListBatchSize; i < end; i++)
+            {
+                if (orientationIndex[i] == NotCulled)
+                    continue;
+
+                const auto& phase = tree->getChild(i);
+                const Vector3d* offset = snapshot != nullptr ? snapshot->find(*phase) : nullptr;
+                Vector3d pos_s = offset != nullptr
+                               ? frameCenter + *offset
+                               : frameCenter + orientations[orientationIndex[i]] * phase->orbit()->positionAtTime(now);
+                Vector3d pos_v = pos_s - astrocentricObserverPos;
+                const Body& body = *phase->body();
+                if (!isInViewCone(pos_v, viewPlaneNormal, body.getCullingRadius(), sinViewAngle, invCosViewAngle))
+                    continue;
+
+                Entry entry;
+                entry.child = i;
+                if (makeRenderListEntry(body, pos_s, pos_v, viewMatZ, labelClassMask, entry.rle, entry.isLabeled))
+                    batches[b].push_back(entry);
+            }
+        });
+    }
+    renderListPool->wait();
+
+    for (auto& batch : batches)
+    {
+        for (auto& entry : batch)
+            addRenderListEntries(entry.rle, *tree->getChild(entry.child)->body(), entry.isLabeled);
+    }
+
+    return culled;
+}
+
+
 void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
                                 const Frustum& viewFrustum,
                                 const Vector3d& viewPlaneNormal,
@@ -3793,23 +4554,35 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
     double sinViewAngle = sqrt(1.0 - square(cosViewConeAngle));
 
     unsigned int nChildren = tree != nullptr ? tree->childCount() : 0;
+
+    ArenaVector<bool> culled{ ArenaAllocator<bool>(frameArena) };
+    if (renderListPool != nullptr && nChildren >= MinParallelRenderListChildren)
+        culled = buildRenderListsParallel(astrocentricObserverPos, viewFrustum, viewPlaneNormal, frameCenter, tree, viewMatZ, now);
+
     for (unsigned int i = 0; i < nChildren; i++)
     {
+        if (!culled.empty() && culled[i])
+            continue;
+
         auto phase = tree->getChild(i);
 
         // No need to do anything if the phase isn't active now
         if (!phase->includes(now))
             continue;
 
+        // Reject the body and its subtree before evaluating the orbit when
+        // the sphere containing them is outside the view frustum or too
+        // far away for anything in it to be seen.
+        if (!isChildVisible(tree, i, frameCenter - astrocentricObserverPos, labelClassMask, viewFrustum))
+            continue;
+
         Body* body = phase->body();
 
         // pos_s: sun-relative position of object
         // pos_v: viewer-relative position of object
 
         // Get the position of the body relative to the sun.
-        Vector3d p = phase->orbit()->positionAtTime(now);
-        auto frame = phase->orbitFrame();
-        Vector3d pos_s = frameCenter + frame->getOrientation(now).conjugate() * p;
+        Vector3d pos_s = getBodyPosition(*phase, frameCenter, now);
 
         // We now have the positions of the observer and the planet relative
         // to the sun.  From these, compute the position of the body
@@ -3863,57 +4636,15 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
             }
         }
 
-        bool insideViewCone = false;
-        if (!viewConeTestFailed)
-        {
-            float radius = body->getCullingRadius();
-            if (dist_vn > -radius)
-            {
-                double maxPerpDist = (radius + dist_vn * sinViewAngle) * invCosViewAngle;
-                double perpDistSq = toViewNormal.squaredNorm();
-                insideViewCone = perpDistSq < maxPerpDist * maxPerpDist;
-            }
-        }
+        bool insideViewCone = !viewConeTestFailed
+            && isInViewCone(pos_v, viewPlaneNormal, body->getCullingRadius(), sinViewAngle, invCosViewAngle);
 
         if (insideViewCone)
         {
-            // Calculate the distance to the viewer
-            double dist_v = pos_v.norm();
-
-            // Calculate the size of the planet/moon disc in pixels
-            float discSize = (body->getCullingRadius() / (float) dist_v) / pixelSize;
-
-            // Compute the apparent magnitude; instead of summing the reflected
-            // light from all nearby stars, we just consider the one with the
-            // highest apparent brightness.
-            float appMag = 100.0f;
-            for (unsigned int li = 0; li < lightSourceList.size(); li++)
-            {
-                Vector3d sunPos = pos_v - lightSourceList[li].position;
-                appMag = min(appMag, body->getApparentMagnitude(lightSourceList[li].luminosity, sunPos, pos_v));
-            }
-
-            bool visibleAsPoint = appMag < faintestPlanetMag && body->isVisibleAsPoint();
-            bool isLabeled = (body->getOrbitClassification() & labelClassMask) != 0;
-
-            if ((discSize > 1 || visibleAsPoint || isLabeled) && isBodyVisible(body, bodyVisibilityMask))
-            {
-                RenderListEntry rle;
-
-                rle.position = pos_v.cast<float>();
-                rle.distance = (float) dist_v;
-                rle.centerZ = pos_v.cast<float>().dot(viewMatZ);
-                rle.appMag   = appMag;
-                rle.discSizeInPixels = body->getRadius() / ((float) dist_v * pixelSize);
-
-                // TODO: Remove this. It's only used in two places: for calculating comet tail
-                // length, and for calculating sky brightness to adjust the limiting magnitude.
-                // In both cases, it's the wrong quantity to use (e.g. for objects with orbits
-                // defined relative to the SSB.)
-                rle.sun = -pos_s.cast<float>();
-
+            RenderListEntry rle;
+            bool isLabeled;
+            if (makeRenderListEntry(*body, pos_s, pos_v, viewMatZ, labelClassMask, rle, isLabeled))
                 addRenderListEntries(rle, *body, isLabeled);
-            }
         }
 
         const FrameTree* subtree = body->getFrameTree();
@@ -4067,6 +4798,21 @@ void Renderer::buildOrbitLists(const Vector3d& astrocentricObserverPos,
                 path.radius = (float) boundingRadius;
                 path.origin = relOrigin;
                 path.opacity = sizeFade(orbitRadiusInPixels, minOrbitSize, 2.0f);
+
+                // The highlighted orbit is drawn by renderOrbit() in its
+                // own color
+                Vector3d center, majorAxis, minorAxis;
+                if (useGPUOrbits && body != highlightObject.body() &&
+                    body->getOrbit(now)->getEllipse(center, majorAxis, minorAxis))
+                {
+                    Quaterniond orientation = body->getOrbitFrame(now)->getOrientation(now).conjugate();
+                    gpuOrbitPaths->add(relOrigin + orientation * center,
+                                       orientation * majorAxis,
+                                       orientation * minorAxis,
+                                       renderOrbitColor(body, false, path.opacity));
+                    path.drawnOnGPU = true;
+                }
+
                 orbitPathList.push_back(path);
             }
         }
@@ -4140,15 +4886,25 @@ void Renderer::buildLabelLists(const Frustum& viewFrustum,
     Body* lastPrimary = nullptr;
     Sphered primarySphere;
 
-    for (auto &ri : renderList)
+    cullCenters.clear();
+    cullRadii.clear();
+    for (const auto &ri : renderList)
     {
+        cullCenters.push_back(ri.position);
+        cullRadii.push_back(ri.radius);
+    }
+    viewFrustum.testSpheres(cullCenters.data(), cullRadii.data(), renderList.size(), cullMask);
+
+    for (std::size_t i = 0; i < renderList.size(); i++)
+    {
+        auto &ri = renderList[i];
         if (ri.renderableType != RenderListEntry::RenderableBody)
             continue;
 
         if ((ri.body->getOrbitClassification() & labelClassMask) == 0)
             continue;
 
-        if (viewFrustum.testSphere(ri.position, ri.radius) == Frustum::Outside)
+        if (!Frustum::isVisible(cullMask, i))
             continue;
 
         const Body* body = ri.body;
@@ -4242,7 +4998,9 @@ void Renderer::buildLabelLists(const Frustum& viewFrustum,
         Color labelColor = getBodyLabelColor(ri.body->getOrbitClassification());
         float opacity = sizeFade(boundingRadiusSize, minOrbitSize, 2.0f);
         labelColor.alpha(opacity * labelColor.alpha());
-        addSortedAnnotation(nullptr, body->getName(true), labelColor, pos);
+        addSortedAnnotation(nullptr, body->getName(true), labelColor, pos,
+                            AlignLeft, VerticalAlignBottom, 0.0f,
+                            getLabelPriority(ri.appMag, body == highlightObject.body()));
     } // for each render list entry
 }
 
@@ -4316,6 +5074,7 @@ void Renderer::renderPointStars(const StarDatabase& starDB,
     starRenderer.starDB            = &starDB;
     starRenderer.observer          = &observer;
     starRenderer.obsPos            = obsPos;
+    starRenderer.motionYears       = Star::GetMotionYears(observer.getTime());
     starRenderer.viewNormal        = observer.getOrientationf().conjugate() * -Vector3f::UnitZ();
     starRenderer.renderList        = &renderList;
     starRenderer.starVertexBuffer  = pointStarVertexBuffer;
@@ -4328,6 +5087,7 @@ void Renderer::renderPointStars(const StarDatabase& starDB,
     starRenderer.distanceLimit     = distanceLimit;
     starRenderer.labelMode         = labelMode;
     starRenderer.SolarSystemMaxDistance = SolarSystemMaxDistance;
+    starRenderer.starDiscSize      = BaseStarDiscSize * static_cast<float>(getScreenDpi()) / 96.0f;
 
     // = 1.0 at startup
     float effDistanceToScreen = mmToInches((float) REF_DISTANCE_TO_SCREEN) * pixelSize * getScreenDpi();
@@ -4353,25 +5113,200 @@ void Renderer::renderPointStars(const StarDatabase& starDB,
     ps.blendFunc = {GL_SRC_ALPHA, GL_ONE};
     setPipelineState(ps);
 
-#ifdef OCTREE_DEBUG
-    m_starProcStats.nodes = 0;
-    m_starProcStats.height = 0;
-    m_starProcStats.objects = 0;
-#endif
-    starDB.findVisibleStars(starRenderer,
-                            obsPos.cast<float>(),
-                            observer.getOrientationf(),
-                            degToRad(fov),
-                            getAspectRatio(),
-                            faintestMagNight,
-#ifdef OCTREE_DEBUG
-                            &m_starProcStats);
-#else
-                            nullptr);
-#endif
+    // Tile stars of the previous frame are no longer referenced
+    starDB.trimTiles();
+
+    // When the limiting magnitude is fainter than starAggregateMag, the
+    // octree traversals below stop there, and the fainter stars are drawn
+    // from the aggregates of the octree nodes afterwards. Stars from tiles
+    // have no aggregates.
+    bool aggregateStars = faintestMagNight > starAggregateMag && !starDB.hasTiles();
+    float starLimitingMag = aggregateStars ? starAggregateMag : faintestMagNight;
+
+    // Reuse the visible octree nodes of the previous frame while the
+    // observer moves less than a thousandth of a light year and turns by
+    // less than about 0.05 degrees.
+    if (starNodeCaches.size() > 16)
+        starNodeCaches.clear();
+    auto& starNodeCache = starNodeCaches.try_emplace(&observer, 1.0e-3f, 1.0e-3f).first->second;
+
+    // Views sharing the observer position traverse the octree only once
+    SharedVisibility* shared = findSharedVisibility(observer);
+    if (shared != nullptr && (shared->starDB != &starDB || !(shared->starLimitingMag >= starLimitingMag)))
+    {
+        starDB.findVisibleStarNodes(shared->starNodes,
+                                    shared->position.cast<float>(),
+                                    shared->orientation,
+                                    shared->fov,
+                                    1.0f,
+                                    starLimitingMag);
+        shared->starDB = &starDB;
+        shared->starLimitingMag = starLimitingMag;
+    }
+
+    auto findStarBatches = [&](auto&& visitor)
+    {
+        if (shared != nullptr)
+        {
+            starDB.findVisibleStarBatches(visitor,
+                                          shared->starNodes,
+                                          obsPos.cast<float>(),
+                                          observer.getOrientationf(),
+                                          cullingFov,
+                                          cullingAspectRatio);
+            return;
+        }
+
+        starDB.findVisibleStarBatches(visitor,
+                                      obsPos.cast<float>(),
+                                      observer.getOrientationf(),
+                                      cullingFov,
+                                      cullingAspectRatio,
+                                      starLimitingMag,
+                                      starNodeCache,
+                                      &m_starProcStats);
+    };
+
+    bool useGPUStarField = gpuStarField != nullptr
+                        && starStyle != PointStars
+                        && gpuStarField->update(starDB, colorTemp);
+
+    // The stars drawn are recorded for picking when they are all drawn
+    // by the CPU through a perspective projection
+    if (pickGrids.size() > 16)
+        pickGrids.clear();
+    PickGrid& pickGrid = pickGrids[&observer];
+    pickGrid.clear();
+    if (!useGPUStarField && getProjectionMode() != ProjectionMode::FisheyeMode)
+    {
+        pickGrid.begin(obsPos, observer.getOrientationf(), degToRad(fov), getAspectRatio(), faintestMagNight);
+        starRenderer.pickGrid = &pickGrid;
+    }
+    if (useGPUStarField)
+    {
+        // The CPU only selects the visible octree nodes; the stars in them
+        // are culled and sized by the vertex shader.
+        gpuStarField->clearRanges();
+        findStarBatches([this](const Star* stars, std::uint32_t nStars, float dimmest)
+                        {
+                            gpuStarField->addRange(stars, countBrighterStars(stars, nStars, dimmest));
+                        });
+
+        // Labels, nearby stars and stars with orbits are still handled on
+        // the CPU.
+        starRenderer.gpuPoints = true;
+        if ((labelMode & StarLabels) != 0)
+        {
+            float labelMag = std::min(faintestMagNight, starRenderer.labelThresholdMag);
+            starDB.findVisibleStarBatches([&starRenderer, labelMag](const Star* stars,
+                                                                    std::uint32_t nStars,
+                                                                    float dimmest)
+                                          {
+                                              starRenderer.processBatch(stars, nStars, dimmest, labelMag);
+                                          },
+                                          obsPos.cast<float>(),
+                                          observer.getOrientationf(),
+                                          cullingFov,
+                                          cullingAspectRatio,
+                                          labelMag);
+        }
+        starDB.findCloseStars(starRenderer, obsPos.cast<float>(), SolarSystemMaxDistance);
+        starRenderer.processCPUStars(gpuStarField->getCPUStars(), starLimitingMag);
+    }
+    else
+    {
+        findStarBatches([&starRenderer, starLimitingMag](const Star* stars,
+                                                         std::uint32_t nStars,
+                                                         float dimmest)
+                        {
+                            starRenderer.processBatch(stars, nStars, dimmest, starLimitingMag);
+                        });
+    }
+
+    // Stars read from tiles aren't part of the GPU star field, so they are
+    // always drawn on the CPU
+    if (starDB.hasTiles())
+    {
+        bool gpuPoints = starRenderer.gpuPoints;
+        starRenderer.gpuPoints = false;
+        starDB.findVisibleTileStarBatches([&starRenderer, faintestMagNight](const Star* stars,
+                                                                            std::uint32_t nStars,
+                                                                            float dimmest)
+                                          {
+                                              starRenderer.processBatch(stars, nStars, dimmest, faintestMagNight);
+                                          },
+                                          obsPos.cast<float>(),
+                                          observer.getOrientationf(),
+                                          cullingFov,
+                                          cullingAspectRatio,
+                                          faintestMagNight);
+        starRenderer.gpuPoints = gpuPoints;
+    }
+
+    // Nodes seen under less than a pixel are drawn as one point for all of
+    // their stars from starAggregateMag to the limiting magnitude
+    if (aggregateStars)
+    {
+        bool gpuPoints = starRenderer.gpuPoints;
+        starRenderer.gpuPoints = false;
+        // The GPU star field path already had findCloseStars() process the
+        // nearby stars
+        float minDistance = useGPUStarField ? SolarSystemMaxDistance : 0.0f;
+        starDB.findFaintStars([&starRenderer, this, faintestMagNight, minDistance](const Star* stars,
+                                                                                   std::uint32_t nStars)
+                              {
+                                  starRenderer.processFaintBatch(stars, nStars, minDistance,
+                                                                 starAggregateMag, faintestMagNight);
+                              },
+                              [&starRenderer](const Vector3f& position, float absMag, float temperature)
+                              {
+                                  starRenderer.processAggregate(position, absMag, temperature);
+                              },
+                              obsPos.cast<float>(),
+                              observer.getOrientationf(),
+                              cullingFov,
+                              cullingAspectRatio,
+                              starAggregateMag,
+                              faintestMagNight,
+                              pixelSize);
+        starRenderer.gpuPoints = gpuPoints;
+    }
 
     starRenderer.starVertexBuffer->finish();
     starRenderer.glareVertexBuffer->finish();
+    if (starRenderer.pickGrid != nullptr)
+        starRenderer.pickGrid->finish();
+
+    if (useGPUStarField)
+    {
+        CelestiaGLProgram* prog = shaderManager->getShader("starfield");
+        if (prog != nullptr)
+        {
+            prog->use();
+            prog->setMVPMatrices(getCurrentProjectionMatrix(), getCurrentModelViewMatrix());
+            prog->samplerParam("starTex") = 0;
+            prog->vec3Param("obsPos") = obsPos.cast<float>();
+            prog->floatParam("motionYears") = starRenderer.motionYears;
+            prog->floatParam("limitingMag") = starLimitingMag;
+            prog->floatParam("faintestMag") = faintestMag;
+            prog->floatParam("brightnessScale") = brightnessScale;
+            prog->floatParam("brightnessBias") = brightnessBias;
+            prog->floatParam("satPoint") = satPoint;
+            prog->floatParam("discSize") = starRenderer.starDiscSize;
+            prog->floatParam("minDistance") = SolarSystemMaxDistance;
+            prog->floatParam("maxDistance") = distanceLimit;
+            prog->floatParam("scaledDiscs") = starStyle == ScaledDiscStars ? 1.0f : 0.0f;
+
+            prog->floatParam("glarePass") = 1.0f;
+            gaussianGlareTex->bind();
+            gpuStarField->draw();
+
+            prog->floatParam("glarePass") = 0.0f;
+            gaussianDiscTex->bind();
+            gpuStarField->draw();
+        }
+    }
+
     PointStarVertexBuffer::disable();
 
 #ifndef GL_ES
@@ -4380,6 +5315,92 @@ void Renderer::renderPointStars(const StarDatabase& starDB,
 #endif
 }
 
+// Draw the rows of a minor body table as points along with the stars, and
+// add their labels and orbits. Rows which come close enough to show a disc
+// are promoted to bodies, which are drawn with the solar system from the
+// next frame on.
+void Renderer::renderMinorBodies(MinorBodyTable& table,
+                                 const Observer& observer,
+                                 double now)
+{
+    Vector3d obsPos = observer.getPosition().offsetFromKm(table.getStar()->getPosition(now));
+    if (astro::kilometersToLightYears(obsPos.norm()) > SolarSystemMaxDistance)
+        return;
+
+    std::vector<MinorBodyTable::VisibleBody> visible;
+    table.findVisible(obsPos, now, faintestPlanetMag, pixelSize, visible);
+    if (visible.empty())
+        return;
+
+    // The points are drawn at a fixed distance in their direction, in
+    // front of the near plane of the star pass
+    constexpr float PointDistance = 1000.0f;
+
+    float scale = static_cast<float>(screenDpi) / 96.0f;
+    float effDistanceToScreen = mmToInches((float) REF_DISTANCE_TO_SCREEN) * pixelSize * getScreenDpi();
+    float labelThresholdMag = 1.2f * max(1.0f, (faintestPlanetMag - 4.0f) * (1.0f - 0.5f * (float) log10(effDistanceToScreen)));
+    bool showLabels = (labelMode & AsteroidLabels) != 0;
+    bool showOrbits = useGPUOrbits && (renderFlags & ShowOrbits) != 0 && (orbitMask & Body::Asteroid) != 0;
+
+    gaussianDiscTex->bind();
+    pointStarVertexBuffer->setTexture(gaussianDiscTex);
+    pointStarVertexBuffer->setPointScale(scale);
+    PointStarVertexBuffer::enable();
+    if (starStyle == PointStars)
+        pointStarVertexBuffer->startBasicPoints();
+    else
+        pointStarVertexBuffer->startSprites();
+
+    Renderer::PipelineState ps;
+    ps.blending = true;
+    ps.blendFunc = {GL_SRC_ALPHA, GL_ONE};
+    setPipelineState(ps);
+
+    for (const auto& body : visible)
+    {
+        if (body.discSize >= 1.0f)
+        {
+            table.promote(body.row);
+            continue;
+        }
+
+        Vector3d relPos = body.position - obsPos;
+        Vector3f pointPos = relPos.normalized().cast<float>() * PointDistance;
+
+        float pointSize, alpha, glareSize, glareAlpha;
+        calculatePointSize(body.appMag, BaseStarDiscSize * scale, pointSize, alpha, glareSize, glareAlpha);
+        pointStarVertexBuffer->addStar(pointPos, {Color::White, alpha}, std::min(pointSize, static_cast<float>(gl::maxPointSize)));
+
+        if (showLabels && body.appMag < labelThresholdMag)
+        {
+            addBackgroundAnnotation(nullptr,
+                                    table.getName(body.row),
+                                    AsteroidLabelColor,
+                                    pointPos,
+                                    AlignLeft,
+                                    VerticalAlignBottom,
+                                    0.0f,
+                                    getLabelPriority(body.appMag, false));
+        }
+
+        if (showOrbits)
+        {
+            Vector3d center, majorAxis, minorAxis;
+            table.getOrbitEllipse(body.row, center, majorAxis, minorAxis);
+            auto orbitRadiusInPixels = static_cast<float>(majorAxis.norm() / (relPos.norm() * pixelSize));
+            if (orbitRadiusInPixels > minOrbitSize)
+            {
+                Color color(AsteroidOrbitColor, sizeFade(orbitRadiusInPixels, minOrbitSize, 2.0f));
+                gpuOrbitPaths->add(center - obsPos, majorAxis, minorAxis, color.toVector4());
+            }
+        }
+    }
+
+    pointStarVertexBuffer->finish();
+    PointStarVertexBuffer::disable();
+}
+
+
 void Renderer::renderDeepSkyObjects(const Universe& universe,
                                     const Observer& observer,
                                     const float     faintestMagNight)
@@ -4405,8 +5426,16 @@ void Renderer::renderDeepSkyObjects(const Universe& universe,
     dsoRenderer.wWidth           = windowWidth;
     dsoRenderer.wHeight          = windowHeight;
 
-    dsoRenderer.frustum = Frustum(degToRad(fov),
-                                  getAspectRatio(),
+    // Billboards are drawn with the perspective projection only
+    if (impostorCache != nullptr && ImpostorCache::isSupported() &&
+        getProjectionMode() != ProjectionMode::FisheyeMode)
+    {
+        impostorCache->beginFrame();
+        dsoRenderer.impostorCache = impostorCache.get();
+    }
+
+    dsoRenderer.frustum = Frustum(cullingFov,
+                                  cullingAspectRatio,
                                   MinNearPlaneDistance);
     // Use pixelSize * screenDpi instead of FoV, to eliminate windowHeight dependence.
     // = 1.0 at startup
@@ -4420,23 +5449,127 @@ void Renderer::renderDeepSkyObjects(const Universe& universe,
     openClusterRep = MarkerRepresentation(MarkerRepresentation::Circle,   8.0f, OpenClusterLabelColor);
     globularRep    = MarkerRepresentation(MarkerRepresentation::Circle,   8.0f, GlobularLabelColor);
 
-#ifdef OCTREE_DEBUG
-    m_dsoProcStats.objects = 0;
-    m_dsoProcStats.nodes = 0;
-    m_dsoProcStats.height = 0;
-#endif
 
-    dsoDB->findVisibleDSOs(dsoRenderer,
-                           obsPos,
-                           observer.getOrientationf(),
-                           degToRad(fov),
-                           getAspectRatio(),
-                           2 * faintestMagNight,
-#ifdef OCTREE_DEBUG
-                           &m_dsoProcStats);
-#else
-                            nullptr);
-#endif
+    // The visible objects are found in two passes: the octree nodes which
+    // pass the frustum test are collected first, then the objects of the
+    // nodes are tested and their brightness computed, in parallel when
+    // there are enough of them.
+    struct VisibleNode
+    {
+        DeepSkyObject* const* objects;
+        std::uint32_t nObjects;
+        double dimmest;
+    };
+    ArenaVector<VisibleNode> nodes{ ArenaAllocator<VisibleNode>(frameArena) };
+    std::uint32_t nObjects = 0;
+    float limitingMag = 2 * faintestMagNight;
+    auto addNode = [&](DeepSkyObject* const* objects, std::uint32_t count, double dimmest)
+    {
+        nodes.push_back({ objects, count, dimmest });
+        nObjects += count;
+    };
+
+    // Views sharing the observer position traverse the octree only once
+    SharedVisibility* shared = findSharedVisibility(observer);
+    if (shared != nullptr)
+    {
+        if (shared->dsoDB != dsoDB || !(shared->dsoLimitingMag >= limitingMag))
+        {
+            dsoDB->findVisibleDSONodes(shared->dsoNodes,
+                                       shared->position,
+                                       shared->orientation,
+                                       shared->fov,
+                                       1.0f,
+                                       limitingMag);
+            shared->dsoDB = dsoDB;
+            shared->dsoLimitingMag = limitingMag;
+        }
+
+        dsoDB->findVisibleDSOBatches(addNode,
+                                     shared->dsoNodes,
+                                     obsPos,
+                                     observer.getOrientationf(),
+                                     cullingFov,
+                                     cullingAspectRatio);
+    }
+    else
+    {
+        dsoDB->findVisibleDSOBatches(addNode,
+                                     obsPos,
+                                     observer.getOrientationf(),
+                                     cullingFov,
+                                     cullingAspectRatio,
+                                     limitingMag,
+                                     &m_dsoProcStats);
+    }
+
+    using CandidateVector = ArenaVector<DSORenderer::Candidate>;
+    CandidateVector candidates{ ArenaAllocator<DSORenderer::Candidate>(frameArena) };
+    if (renderListPool != nullptr && nObjects >= MinParallelDSOs)
+    {
+        // Each task tests whole nodes with about DSOBatchSize objects. The
+        // arena isn't thread safe, so each batch gets room for all of its
+        // objects here and the tasks never grow them.
+        CandidateVector::allocator_type allocator(frameArena);
+        ArenaVector<CandidateVector> batches{ ArenaAllocator<CandidateVector>(frameArena) };
+        ArenaVector<std::size_t> batchStarts(1, 0, ArenaAllocator<std::size_t>(frameArena));
+        std::uint32_t batchObjects = 0;
+        for (std::size_t i = 0; i < nodes.size(); i++)
+        {
+            batchObjects += nodes[i].nObjects;
+            if (batchObjects >= DSOBatchSize || i + 1 == nodes.size())
+            {
+                batchStarts.push_back(i + 1);
+                batches.emplace_back(allocator).reserve(batchObjects);
+                batchObjects = 0;
+            }
+        }
+
+        std::size_t nBatches = batches.size();
+        for (std::size_t b = 0; b < nBatches; b++)
+        {
+            renderListPool->submit([&, b]
+            {
+                for (std::size_t i = batchStarts[b]; i < batchStarts[b + 1]; i++)
+                    dsoRenderer.addCandidates(nodes[i].objects, nodes[i].nObjects, nodes[i].dimmest, limitingMag, batches[b]);
+            });
+        }
+        renderListPool->wait();
+
+        std::size_t nCandidates = 0;
+        for (const auto& batch : batches)
+            nCandidates += batch.size();
+        candidates.reserve(nCandidates);
+        for (const auto& batch : batches)
+            candidates.insert(candidates.end(), batch.begin(), batch.end());
+    }
+    else
+    {
+        for (const VisibleNode& node : nodes)
+            dsoRenderer.addCandidates(node.objects, node.nObjects, node.dimmest, limitingMag, candidates);
+    }
+
+    // Draw the objects of each type together, so that they share their
+    // GL state; objects of the same type keep the octree order. The indexes
+    // are sorted rather than the candidates, as std::stable_sort() would
+    // allocate a buffer each frame.
+    ArenaVector<std::uint32_t> order(candidates.size(), 0, ArenaAllocator<std::uint32_t>(frameArena));
+    for (std::uint32_t i = 0; i < (std::uint32_t) candidates.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(),
+              [&candidates](std::uint32_t a, std::uint32_t b)
+              {
+                  return candidates[a].renderMask < candidates[b].renderMask
+                      || (candidates[a].renderMask == candidates[b].renderMask && a < b);
+              });
+    for (std::uint32_t i : order)
+        dsoRenderer.render(candidates[i]);
+
+    // Globulars sharing a form are drawn together after all the others
+    Globular::renderInstances(this);
+
+    if (dsoRenderer.impostorCache != nullptr)
+        dsoRenderer.impostorCache->draw(this, getProjectionMatrix(), getModelViewMatrix());
 
     // clog << "DSOs processed: " << dsoRenderer.dsosProcessed << endl;
 }
@@ -4452,31 +5585,40 @@ void Renderer::renderSkyGrids(const Observer& observer)
 {
     if ((renderFlags & ShowCelestialSphere) != 0)
     {
-        SkyGrid grid;
-        grid.setOrientation(Quaterniond(AngleAxis<double>(astro::J2000Obliquity, Vector3d::UnitX())));
-        grid.setLineColor(EquatorialGridColor);
-        grid.setLabelColor(EquatorialGridLabelColor);
-        grid.render(*this, observer, windowWidth, windowHeight);
+        if (equatorialGrid == nullptr)
+        {
+            equatorialGrid = std::make_unique<SkyGrid>();
+            equatorialGrid->setOrientation(Quaterniond(AngleAxis<double>(astro::J2000Obliquity, Vector3d::UnitX())));
+        }
+        equatorialGrid->setLineColor(EquatorialGridColor);
+        equatorialGrid->setLabelColor(EquatorialGridLabelColor);
+        equatorialGrid->render(*this, observer, windowWidth, windowHeight);
     }
 
     if ((renderFlags & ShowGalacticGrid) != 0)
     {
-        SkyGrid galacticGrid;
-        galacticGrid.setOrientation((astro::eclipticToEquatorial() * astro::equatorialToGalactic()).conjugate());
-        galacticGrid.setLineColor(GalacticGridColor);
-        galacticGrid.setLabelColor(GalacticGridLabelColor);
-        galacticGrid.setLongitudeUnits(SkyGrid::LongitudeDegrees);
-        galacticGrid.render(*this, observer, windowWidth, windowHeight);
+        if (galacticGrid == nullptr)
+        {
+            galacticGrid = std::make_unique<SkyGrid>();
+            galacticGrid->setOrientation((astro::eclipticToEquatorial() * astro::equatorialToGalactic()).conjugate());
+            galacticGrid->setLongitudeUnits(SkyGrid::LongitudeDegrees);
+        }
+        galacticGrid->setLineColor(GalacticGridColor);
+        galacticGrid->setLabelColor(GalacticGridLabelColor);
+        galacticGrid->render(*this, observer, windowWidth, windowHeight);
     }
 
     if ((renderFlags & ShowEclipticGrid) != 0)
     {
-        SkyGrid grid;
-        grid.setOrientation(Quaterniond::Identity());
-        grid.setLineColor(EclipticGridColor);
-        grid.setLabelColor(EclipticGridLabelColor);
-        grid.setLongitudeUnits(SkyGrid::LongitudeDegrees);
-        grid.render(*this, observer, windowWidth, windowHeight);
+        if (eclipticGrid == nullptr)
+        {
+            eclipticGrid = std::make_unique<SkyGrid>();
+            eclipticGrid->setOrientation(Quaterniond::Identity());
+            eclipticGrid->setLongitudeUnits(SkyGrid::LongitudeDegrees);
+        }
+        eclipticGrid->setLineColor(EclipticGridColor);
+        eclipticGrid->setLabelColor(EclipticGridLabelColor);
+        eclipticGrid->render(*this, observer, windowWidth, windowHeight);
     }
 
     if ((renderFlags & ShowHorizonGrid) != 0)
@@ -4487,11 +5629,14 @@ void Renderer::renderSkyGrids(const Observer& observer)
 
         if (body != nullptr)
         {
-            SkyGrid grid;
-            grid.setLineColor(HorizonGridColor);
-            grid.setLabelColor(HorizonGridLabelColor);
-            grid.setLongitudeUnits(SkyGrid::LongitudeDegrees);
-            grid.setLongitudeDirection(SkyGrid::IncreasingClockwise);
+            if (horizonGrid == nullptr)
+            {
+                horizonGrid = std::make_unique<SkyGrid>();
+                horizonGrid->setLongitudeUnits(SkyGrid::LongitudeDegrees);
+                horizonGrid->setLongitudeDirection(SkyGrid::IncreasingClockwise);
+            }
+            horizonGrid->setLineColor(HorizonGridColor);
+            horizonGrid->setLabelColor(HorizonGridLabelColor);
 
             Vector3d zenithDirection = observer.getPosition().offsetFromKm(body->getPosition(tdb)).normalized();
 
@@ -4513,9 +5658,9 @@ void Renderer::renderSkyGrids(const Observer& observer)
                 m.row(0) = u;
                 m.row(1) = v;
                 m.row(2) = zenithDirection;
-                grid.setOrientation(Quaterniond(m));
+                horizonGrid->setOrientation(Quaterniond(m));
 
-                grid.render(*this, observer, windowWidth, windowHeight);
+                horizonGrid->render(*this, observer, windowWidth, windowHeight);
             }
         }
     }
@@ -4577,43 +5722,14 @@ void Renderer::labelConstellations(const AsterismList& asterisms,
                                             ast->getName((labelMode & I18nConstellationLabels) != 0),
                                             Color(labelColor, opacity),
                                             rpos,
-                                            AlignCenter, VerticalAlignCenter);
-                }
-            }
-        }
-    }
-}
-
-
-void Renderer::renderParticles(const vector<Particle>& particles)
-{
-    ShaderProperties shaderprop;
-    shaderprop.lightModel = ShaderProperties::ParticleModel;
-    shaderprop.texUsage = ShaderProperties::PointSprite;
-    auto *prog = shaderManager->getShader(shaderprop);
-    if (prog == nullptr)
-        return;
-    prog->use();
-
-#ifndef GL_ES
-    glEnable(GL_POINT_SPRITE);
-#endif
-    glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
-    glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
-                          3, GL_FLOAT, GL_FALSE, sizeof(Particle), &particles[0].center);
-    glEnableVertexAttribArray(CelestiaGLProgram::PointSizeAttributeIndex);
-    glVertexAttribPointer(CelestiaGLProgram::PointSizeAttributeIndex,
-                          1, GL_FLOAT, GL_FALSE,
-                          sizeof(Particle), &particles[0].size);
-    glDrawArrays(GL_POINTS, 0, particles.size());
-
-    glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
-    glDisableVertexAttribArray(CelestiaGLProgram::PointSizeAttributeIndex);
-#ifndef GL_ES
-    glDisable(GL_POINT_SPRITE);
-#endif
+                                            AlignCenter, VerticalAlignCenter);
+                }
+            }
+        }
+    }
 }
 
+
 void
 Renderer::renderAnnotationMarker(const Annotation &a,
                                  FontStyle fs,
@@ -4625,12 +5741,13 @@ Renderer::renderAnnotationMarker(const Annotation &a,
 
     glVertexAttrib(CelestiaGLProgram::ColorAttributeIndex, a.color);
 
-    Matrix4f mv = vecgl::translate(*m.modelview, (float)(int)a.position.x(), (float)(int)a.position.y(), depth);
+    Vector3f position((float)(int)a.position.x(), (float)(int)a.position.y(), depth);
+    Matrix4f mv = vecgl::translate(*m.modelview, position);
     Matrices mm = { m.projection, &mv };
 
     if (markerRep.symbol() == celestia::MarkerRepresentation::Crosshair)
         renderCrosshair(size, realTime, a.color, mm);
-    else
+    else if (!addMarkerToBatch(markerRep.symbol(), size, a.color, position))
         markerRep.render(*this, size, mm);
 
     if (!markerRep.label().empty())
@@ -4638,12 +5755,10 @@ Renderer::renderAnnotationMarker(const Annotation &a,
         if (auto font = getFont(fs); font != nullptr)
         {
             int labelOffset = (int)markerRep.size() / 2;
-            float x = labelOffset + PixelOffset;
-            float y = -labelOffset - font->getHeight() + PixelOffset;
-            font->bind();
-            font->setMVPMatrices(*m.projection, mv);
-            font->render(markerRep.label(), x, y);
-            font->flush();
+            Vector3f position((float)(int)a.position.x() + labelOffset + PixelOffset,
+                              (float)(int)a.position.y() - labelOffset - font->getHeight() + PixelOffset,
+                              depth);
+            font->render(markerRep.label(), position, a.color);
         }
     }
 }
@@ -4653,24 +5768,134 @@ Renderer::renderAnnotationLabel(const Annotation &a,
                                 FontStyle fs,
                                 int hOffset,
                                 int vOffset,
-                                float depth,
-                                const Matrices &m)
+                                float depth)
 {
-    glVertexAttrib(CelestiaGLProgram::ColorAttributeIndex, a.color);
+    auto font = getFont(fs);
+    if (font == nullptr)
+        return;
+
+    // Labels are queued and drawn together by flushAnnotationLabels()
+    Vector3f position((float)((int)a.position.x() + hOffset) + PixelOffset,
+                      (float)((int)a.position.y() + vOffset) + PixelOffset,
+                      depth);
+    font->render(a.labelText, position, a.color);
+}
+
+// Queue a marker to be drawn by renderMarkerBatch() together with the
+// other markers of the same shape, if instancing is available
+bool
+Renderer::addMarkerToBatch(celestia::MarkerRepresentation::Symbol symbol,
+                           float size,
+                           const Color& color,
+                           const Vector3f& position)
+{
+    if (!MarkerBatch::canBatch(symbol, shouldDrawLineAsTriangles()))
+        return false;
+
+    if (markerBatch == nullptr)
+    {
+        if (!MarkerBatch::isSupported() || shaderManager->getShader("marker") == nullptr)
+            return false;
+        markerBatch = std::make_unique<MarkerBatch>();
+    }
+
+    markerBatch->add(symbol, size, getScaleFactor(), color, position);
+    return true;
+}
+
+void
+Renderer::renderMarkerBatch(const Matrices &m)
+{
+    if (markerBatch == nullptr || markerBatch->empty())
+        return;
+
+    auto *prog = shaderManager->getShader("marker");
+    prog->use();
+    prog->setMVPMatrices(*m.projection, *m.modelview);
+    markerBatch->draw();
+}
+
+void
+Renderer::flushAnnotationLabels(TextureFont& font, const Matrices &m)
+{
+    font.setMVPMatrices(*m.projection, *m.modelview);
+    font.bind();
+    font.flush();
+}
 
-    Matrix4f mv = vecgl::translate(*m.modelview,
-                                   (int)a.position.x() + hOffset + PixelOffset,
-                                   (int)a.position.y() + vOffset + PixelOffset,
-                                   depth);
+// Hide the labels which overlap a label of higher priority; the markers of
+// the annotations are kept.
+void Renderer::declutterAnnotations(vector<Annotation>& annotations,
+                                    FontStyle fs)
+{
+    if (labelDeclutter == nullptr)
+        return;
 
     auto font = getFont(fs);
     if (font == nullptr)
         return;
 
-    font->bind();
-    font->setMVPMatrices(*m.projection, mv);
-    font->render(a.labelText, 0.0f, 0.0f);
-    font->flush();
+    // Sorted by priority, keeping the order of labels of equal priority;
+    // std::stable_sort() would allocate a buffer each frame.
+    ArenaVector<std::uint32_t> order{ ArenaAllocator<std::uint32_t>(frameArena) };
+    order.reserve(annotations.size());
+    for (std::uint32_t i = 0; i < (std::uint32_t) annotations.size(); i++)
+    {
+        if (!annotations[i].labelText.empty())
+            order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(),
+              [&annotations](std::uint32_t a, std::uint32_t b)
+              {
+                  float priorityA = annotations[a].priority;
+                  float priorityB = annotations[b].priority;
+                  return priorityA > priorityB || (priorityA == priorityB && a < b);
+              });
+
+    labelDeclutter->clear();
+    int labelHeight = font->getHeight();
+    for (std::uint32_t i : order)
+    {
+        Annotation& a = annotations[i];
+
+        // Same placement as in renderAnnotations()
+        int labelWidth = font->getWidth(a.labelText);
+        int hOffset = 2;
+        int vOffset = 0;
+        switch (a.halign)
+        {
+        case AlignCenter:
+            hOffset = -labelWidth / 2;
+            break;
+        case AlignRight:
+            hOffset = -(labelWidth + 2);
+            break;
+        case AlignLeft:
+            if (a.markerRep != nullptr)
+                hOffset = 2 + (int) a.markerRep->size() / 2;
+            break;
+        }
+        switch (a.valign)
+        {
+        case VerticalAlignCenter:
+            vOffset = -labelHeight / 2;
+            break;
+        case VerticalAlignTop:
+            vOffset = -labelHeight;
+            break;
+        case VerticalAlignBottom:
+            vOffset = 0;
+            break;
+        }
+
+        Vector2f corner((float) ((int) a.position.x() + hOffset),
+                        (float) ((int) a.position.y() + vOffset));
+        AlignedBox2f rect(corner, corner + Vector2f((float) labelWidth, (float) labelHeight));
+        if (a.priority != AlwaysShownLabelPriority && labelDeclutter->overlaps(rect))
+            a.labelText = {};
+        else
+            labelDeclutter->add(rect);
+    }
 }
 
 // stars and constellations. DSOs
@@ -4727,10 +5952,12 @@ void Renderer::renderAnnotations(const vector<Annotation>& annotations,
                 vOffset = 0;
                 break;
             }
-            renderAnnotationLabel(annotations[i], fs, hOffset, vOffset, 0.0f, m);
+            renderAnnotationLabel(annotations[i], fs, hOffset, vOffset, 0.0f);
         }
     }
 
+    renderMarkerBatch(m);
+    flushAnnotationLabels(*font, m);
     font->unbind();
 }
 
@@ -4738,6 +5965,8 @@ void Renderer::renderAnnotations(const vector<Annotation>& annotations,
 void
 Renderer::renderBackgroundAnnotations(FontStyle fs)
 {
+    GPUProfileZone zone(gpuProfiler.get(), "Labels");
+
     Renderer::PipelineState ps;
     ps.blending = true;
     ps.blendFunc = {GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA};
@@ -4745,6 +5974,7 @@ Renderer::renderBackgroundAnnotations(FontStyle fs)
     ps.smoothLines = true;
     setPipelineState(ps);
 
+    declutterAnnotations(backgroundAnnotations, fs);
     renderAnnotations(backgroundAnnotations, fs);
     backgroundAnnotations.clear();
 }
@@ -4753,6 +5983,8 @@ Renderer::renderBackgroundAnnotations(FontStyle fs)
 void
 Renderer::renderForegroundAnnotations(FontStyle fs)
 {
+    GPUProfileZone zone(gpuProfiler.get(), "Labels");
+
     Renderer::PipelineState ps;
     ps.blending = true;
     ps.blendFunc = {GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA};
@@ -4760,6 +5992,7 @@ Renderer::renderForegroundAnnotations(FontStyle fs)
     ps.smoothLines = true;
     setPipelineState(ps);
 
+    declutterAnnotations(foregroundAnnotations, fs);
     renderAnnotations(foregroundAnnotations, fs);
     foregroundAnnotations.clear();
 }
@@ -4772,6 +6005,8 @@ Renderer::renderSortedAnnotations(vector<Annotation>::iterator iter,
                                   float farDist,
                                   FontStyle fs)
 {
+    GPUProfileZone zone(gpuProfiler.get(), "Labels");
+
     Renderer::PipelineState ps;
     ps.blending = true;
     ps.blendFunc = {GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA};
@@ -4813,7 +6048,13 @@ Renderer::renderAnnotations(vector<Annotation>::iterator startIter,
     for (; iter != endIter && iter->position.z() > nearDist; ++iter)
     {
         // Compute normalized device z
-        float z = fisheye ? (1.0f - (iter->position.z() - nearDist) / d0 * 2.0f) : (d1 + d2 / -iter->position.z());
+        float z;
+        if (fisheye)
+            z = 1.0f - (iter->position.z() - nearDist) / d0 * 2.0f;
+        else if (reverseDepthActive)
+            z = -nearDist * (farDist - iter->position.z()) / (iter->position.z() * d0);
+        else
+            z = d1 + d2 / -iter->position.z();
         float ndc_z = std::clamp(z, -1.0f, 1.0f);
 
         // Offsets to left align label
@@ -4830,10 +6071,12 @@ Renderer::renderAnnotations(vector<Annotation>::iterator startIter,
             if (iter->markerRep != nullptr)
                 labelHOffset += (int) iter->markerRep->size() / 2 + 3;
 
-            renderAnnotationLabel(*iter, fs, labelHOffset, labelVOffset, ndc_z, m);
+            renderAnnotationLabel(*iter, fs, labelHOffset, labelVOffset, ndc_z);
         }
     }
 
+    renderMarkerBatch(m);
+    flushAnnotationLabels(*font, m);
     font->unbind();
 
     return iter;
@@ -4953,6 +6196,12 @@ void Renderer::invalidateOrbitCache()
 }
 
 
+void Renderer::invalidateNearStars()
+{
+    nearStarCache.clear();
+}
+
+
 bool Renderer::settingsHaveChanged() const
 {
     return settingsChanged;
@@ -5054,7 +6303,7 @@ void Renderer::setScissor(int x, int y, int w, int h)
 {
     if (!m_pipelineState.scissor)
     {
-        glEnable(GL_SCISSOR_TEST);
+        celestia::gl::enable(GL_SCISSOR_TEST);
         m_pipelineState.scissor = true;
     }
     glScissor(x, y, w, h);
@@ -5064,7 +6313,7 @@ void Renderer::removeScissor()
 {
     if (m_pipelineState.scissor)
     {
-        glDisable(GL_SCISSOR_TEST);
+        celestia::gl::disable(GL_SCISSOR_TEST);
         m_pipelineState.scissor = false;
     }
 }
@@ -5074,7 +6323,7 @@ void Renderer::enableMSAA() noexcept
 #ifndef GL_ES
     if (!m_pipelineState.multisample)
     {
-        glEnable(GL_MULTISAMPLE);
+        celestia::gl::enable(GL_MULTISAMPLE);
         m_pipelineState.multisample = true;
     }
 #endif
@@ -5084,7 +6333,7 @@ void Renderer::disableMSAA() noexcept
 #ifndef GL_ES
     if (m_pipelineState.multisample)
     {
-        glDisable(GL_MULTISAMPLE);
+        celestia::gl::disable(GL_MULTISAMPLE);
         m_pipelineState.multisample = false;
     }
 #endif
@@ -5247,11 +6496,11 @@ void Renderer::drawRectangle(const celestia::Rect &r, int fishEyeOverrideMode, c
     {
         prog->lineWidthX = getLineWidthX() * r.lw;
         prog->lineWidthY = getLineWidthY() * r.lw;
-        glDrawElements(GL_TRIANGLES, lineAsTriangleIndcies.size(), GL_UNSIGNED_SHORT, lineAsTriangleIndcies.data());
+        celestia::gl::drawElements(GL_TRIANGLES, lineAsTriangleIndcies.size(), GL_UNSIGNED_SHORT, lineAsTriangleIndcies.data());
     }
     else
     {
-        glDrawArrays(solid ? GL_TRIANGLE_FAN : GL_LINE_LOOP, 0, 4);
+        celestia::gl::drawArrays(solid ? GL_TRIANGLE_FAN : GL_LINE_LOOP, 0, 4);
     }
 
     glDisableVertexAttribArray(CelestiaGLProgram::ColorAttributeIndex);
@@ -5361,7 +6610,11 @@ Renderer::getVertexObject(VOType owner, GLenum type, GLsizeiptr size, GLenum str
 {
     auto i = static_cast<size_t>(owner);
     if (m_VertexObjects[i] == nullptr)
+    {
         m_VertexObjects[i] = new celgl::VertexObject(type, size, stream);
+        if (stream == GL_STREAM_DRAW)
+            m_VertexObjects[i]->setStreamBuffer(m_streamBuffer.get());
+    }
 
     return *m_VertexObjects[i];
 }
@@ -5372,9 +6625,35 @@ Renderer::getShadowFBO(int index) const
     return index == 0 ? m_shadowFBO.get() : nullptr;
 }
 
+bool
+Renderer::getCachedShadow(const Geometry* geometry,
+                          const Vector3f& lightDirection,
+                          Matrix4f* lightMatrix) const
+{
+    if (geometry == nullptr || geometry != m_shadowMapContents.geometry ||
+        lightDirection.dot(m_shadowMapContents.lightDirection) < MinShadowLightDirectionCos)
+    {
+        return false;
+    }
+
+    *lightMatrix = m_shadowMapContents.lightMatrix;
+    return true;
+}
+
+void
+Renderer::setCachedShadow(const Geometry* geometry,
+                          const Vector3f& lightDirection,
+                          const Matrix4f& lightMatrix)
+{
+    m_shadowMapContents.geometry = geometry;
+    m_shadowMapContents.lightDirection = lightDirection;
+    m_shadowMapContents.lightMatrix = lightMatrix;
+}
+
 void
 Renderer::createShadowFBO()
 {
+    m_shadowMapContents = ShadowMapContents();
     m_shadowFBO = unique_ptr<FramebufferObject>(new FramebufferObject(m_shadowMapSize,
                                                                       m_shadowMapSize,
                                                                       FramebufferObject::DepthAttachment));
@@ -5385,6 +6664,265 @@ Renderer::createShadowFBO()
     }
 }
 
+void
+Renderer::setGPUStarField(bool enable)
+{
+    if (!enable)
+        gpuStarField = nullptr;
+    else if (gpuStarField == nullptr)
+        gpuStarField = std::make_unique<GPUStarField>();
+}
+
+void
+Renderer::setGPUOrbits(bool enable)
+{
+    if (!enable)
+        gpuOrbitPaths = nullptr;
+    else if (gpuOrbitPaths == nullptr)
+        gpuOrbitPaths = std::make_unique<GPUOrbitPaths>();
+}
+
+void
+Renderer::setModelInstancing(bool enable)
+{
+    if (!enable)
+        modelInstances = nullptr;
+    else if (modelInstances == nullptr)
+        modelInstances = std::make_unique<ModelInstances>();
+}
+
+void
+Renderer::setDSOImpostors(bool enable)
+{
+    if (!enable)
+        impostorCache = nullptr;
+    else if (impostorCache == nullptr)
+        impostorCache = std::make_unique<ImpostorCache>();
+}
+
+bool
+Renderer::isReverseDepthSupported()
+{
+#ifdef GL_ES
+    return false;
+#else
+    return gl::ARB_clip_control;
+#endif
+}
+
+void
+Renderer::setDepthConvention(bool reverse)
+{
+#ifdef GL_ES
+    (void) reverse;
+#else
+    if (reverse)
+    {
+        glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+        glClearDepth(0.0);
+        glDepthFunc(GL_GEQUAL);
+    }
+    else
+    {
+        glClipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
+        glClearDepth(1.0);
+        glDepthFunc(GL_LEQUAL);
+    }
+#endif
+}
+
+void
+Renderer::setLabelDeclutter(bool enable)
+{
+    if (!enable)
+        labelDeclutter = nullptr;
+    else if (labelDeclutter == nullptr)
+        labelDeclutter = std::make_unique<LabelDeclutter>();
+}
+
+void
+Renderer::setRenderListThreads(unsigned int nThreads)
+{
+    if (nThreads == 1)
+        renderListPool = nullptr;
+    else
+        renderListPool = std::make_unique<celestia::util::ThreadPool>(nThreads);
+}
+
+void
+Renderer::setCubeSphereGeometry(bool enable)
+{
+    g_lodSphere->setCubeSphere(enable);
+}
+
+void
+Renderer::setOrbitCacheBudget(std::size_t budget)
+{
+    orbitCacheBudget = budget;
+}
+
+const PickGrid*
+Renderer::getPickGrid(const Observer& observer) const
+{
+    auto it = pickGrids.find(&observer);
+    return it == pickGrids.end() ? nullptr : &it->second;
+}
+
+void
+Renderer::accountMemory(celestia::util::MemoryUsage& parent) const
+{
+    std::size_t orbitBytes = 0;
+    for (const auto& entry : orbitCache)
+        orbitBytes += entry.second->memoryUsage();
+
+    auto& usage = parent.add("renderer");
+    usage.add("orbit cache", orbitBytes, orbitCache.size());
+    usage.add("frame arena", frameArena.capacity());
+}
+
+namespace
+{
+// Find a square frustum containing the frusta of views from one position,
+// widened by margin radians. Its field of view is set to zero if they span
+// too wide an angle.
+void
+getBoundingFrustum(const std::vector<Renderer::SharedView>& views,
+                   float margin,
+                   Quaternionf& orientation,
+                   float& fov)
+{
+    Vector3f axis = Vector3f::Zero();
+    std::vector<Vector3f> corners;
+    for (const Renderer::SharedView& view : views)
+    {
+        Matrix3f toWorld = view.orientation.conjugate().toRotationMatrix();
+        axis += toWorld * -Vector3f::UnitZ();
+
+        float h = std::tan(view.fov / 2.0f);
+        float w = h * view.aspectRatio;
+        for (float x : { -w, w })
+        {
+            for (float y : { -h, h })
+                corners.push_back((toWorld * Vector3f(x, y, -1.0f)).normalized());
+        }
+    }
+
+    fov = 0.0f;
+    if (axis.norm() < 1.0e-3f)
+        return;
+
+    axis.normalize();
+    float minCos = 1.0f;
+    for (const Vector3f& corner : corners)
+        minCos = std::min(minCos, axis.dot(corner));
+
+    float halfAngle = std::acos(std::max(minCos, -1.0f)) + SharedViewAngleMargin + margin;
+    if (halfAngle >= MaxSharedViewHalfAngle)
+        return;
+
+    // Frustum planes are computed for the view direction -z
+    orientation = Quaternionf::FromTwoVectors(axis, -Vector3f::UnitZ());
+    fov = 2.0f * halfAngle;
+}
+} // end unnamed namespace
+
+void
+Renderer::setSharedViews(const std::vector<SharedView>& views)
+{
+    sharedVisibility.clear();
+    for (const SharedView& view : views)
+    {
+        Vector3d position = view.position.toLy();
+        auto iter = std::find_if(sharedVisibility.begin(), sharedVisibility.end(),
+                                 [&position](const SharedVisibility& shared)
+                                 {
+                                     return (shared.position - position).norm() <= SharedViewPositionTolerance;
+                                 });
+        if (iter == sharedVisibility.end())
+        {
+            iter = sharedVisibility.emplace(sharedVisibility.end());
+            iter->position = position;
+        }
+        iter->views.push_back(view);
+    }
+
+    // Views alone at their position are drawn as usual
+    sharedVisibility.erase(std::remove_if(sharedVisibility.begin(), sharedVisibility.end(),
+                                          [](const SharedVisibility& shared) { return shared.views.size() < 2; }),
+                           sharedVisibility.end());
+    // The views may be rotated after they are culled
+    float margin = lateOrientationSource != nullptr ? lateOrientationMargin : 0.0f;
+    for (SharedVisibility& shared : sharedVisibility)
+        getBoundingFrustum(shared.views, margin, shared.orientation, shared.fov);
+
+    sharedBodyPositions.clear();
+}
+
+void
+Renderer::clearSharedViews()
+{
+    sharedVisibility.clear();
+    sharedBodyPositions.clear();
+}
+
+// Return the shared visibility of the views that include the one being
+// drawn for observer, or null if it isn't shared.
+Renderer::SharedVisibility*
+Renderer::findSharedVisibility(const Observer& observer)
+{
+    if (sharedVisibility.empty())
+        return nullptr;
+
+    Vector3d position = observer.getPosition().toLy();
+    Quaternionf orientation = observer.getOrientationf();
+    float viewFov = degToRad(fov);
+    float aspectRatio = getAspectRatio();
+    for (SharedVisibility& shared : sharedVisibility)
+    {
+        if ((shared.position - position).norm() > SharedViewPositionTolerance)
+            continue;
+
+        for (const SharedView& view : shared.views)
+        {
+            if (std::abs(view.orientation.dot(orientation)) > 0.999999f &&
+                std::abs(view.fov - viewFov) < 1.0e-5f &&
+                std::abs(view.aspectRatio - aspectRatio) < 1.0e-4f)
+            {
+                return &shared;
+            }
+        }
+    }
+
+    return nullptr;
+}
+
+// Return the sun-relative position of the body of phase, computing it only
+// once for all shared views
+Vector3d
+Renderer::getBodyPosition(const TimelinePhase& phase, const Vector3d& frameCenter, double now)
+{
+    if (bodySnapshot != nullptr && bodySnapshot->getTime() == now)
+    {
+        const Vector3d* offset = bodySnapshot->find(phase);
+        if (offset != nullptr)
+            return frameCenter + *offset;
+    }
+
+    if (sharedVisibility.empty())
+        return frameCenter + phase.orbitFrame()->getOrientation(now).conjugate() * phase.orbit()->positionAtTime(now);
+
+    if (now != sharedPositionTime)
+    {
+        sharedBodyPositions.clear();
+        sharedPositionTime = now;
+    }
+
+    auto [iter, inserted] = sharedBodyPositions.try_emplace(&phase);
+    if (inserted)
+        iter->second = frameCenter + phase.orbitFrame()->getOrientation(now).conjugate() * phase.orbit()->positionAtTime(now);
+    return iter->second;
+}
+
 void
 Renderer::setShadowMapSize(unsigned size)
 {
@@ -5401,62 +6939,96 @@ Renderer::setShadowMapSize(unsigned size)
         createShadowFBO();
 }
 
-void
-Renderer::removeInvisibleItems(const Frustum &frustum)
+namespace
 {
-    // Remove objects from the render list that lie completely outside the
-    // view frustum.
-    auto notCulled = renderList.begin();
-    for (auto &ri : renderList)
+// Bounding sphere of a render list entry and the shape information used to
+// place its near and far planes
+struct CullBounds
+{
+    float radius{ 1.0f };
+    float cullRadius{ 1.0f };
+    float cloudHeight{ 0.0f };
+    bool convex{ true };
+};
+
+CullBounds getCullBounds(const RenderListEntry& ri)
+{
+    CullBounds b;
+
+    switch (ri.renderableType)
     {
-        bool convex = true;
-        float radius = 1.0f;
-        float cullRadius = 1.0f;
-        float cloudHeight = 0.0f;
+    case RenderListEntry::RenderableStar:
+        b.radius = ri.star->getRadius();
+        b.cullRadius = b.radius * (1.0f + CoronaHeight);
+        break;
+
+    case RenderListEntry::RenderableCometTail:
+    case RenderListEntry::RenderableReferenceMark:
+        b.radius = ri.radius;
+        b.cullRadius = b.radius;
+        b.convex = false;
+        break;
 
-        switch (ri.renderableType)
+    case RenderListEntry::RenderableBody:
+        b.radius = ri.body->getBoundingRadius();
+        if (ri.body->getRings() != nullptr)
         {
-        case RenderListEntry::RenderableStar:
-            radius = ri.star->getRadius();
-            cullRadius = radius * (1.0f + CoronaHeight);
-            break;
+            b.radius = ri.body->getRings()->outerRadius;
+            b.convex = false;
+        }
 
-        case RenderListEntry::RenderableCometTail:
-        case RenderListEntry::RenderableReferenceMark:
-            radius = ri.radius;
-            cullRadius = radius;
-            convex = false;
-            break;
+        if (!ri.body->isEllipsoid())
+            b.convex = false;
 
-        case RenderListEntry::RenderableBody:
-            radius = ri.body->getBoundingRadius();
-            if (ri.body->getRings() != nullptr)
-            {
-                radius = ri.body->getRings()->outerRadius;
-                convex = false;
-            }
+        b.cullRadius = b.radius;
+        if (ri.body->getAtmosphere() != nullptr)
+        {
+            auto *a = ri.body->getAtmosphere();
+            b.cullRadius += a->height;
+            b.cloudHeight = max(a->cloudHeight,
+                                a->mieScaleHeight * -log(AtmosphereExtinctionThreshold));
+        }
+        break;
 
-            if (!ri.body->isEllipsoid())
-                convex = false;
+    default:
+        break;
+    }
 
-            cullRadius = radius;
-            if (ri.body->getAtmosphere() != nullptr)
-            {
-                auto *a = ri.body->getAtmosphere();
-                cullRadius += a->height;
-                cloudHeight = max(a->cloudHeight,
-                                  a->mieScaleHeight * -log(AtmosphereExtinctionThreshold));
-            }
-            break;
+    return b;
+}
+} // end unnamed namespace
 
-        default:
-            break;
-        }
+void
+Renderer::removeInvisibleItems(const Frustum &frustum)
+{
+    // Test the bounding spheres of all objects against the view frustum at
+    // once.
+    Matrix3f cameraMatrix = getCameraOrientation().toRotationMatrix();
+    ArenaVector<CullBounds> bounds{ ArenaAllocator<CullBounds>(frameArena) };
+    bounds.reserve(renderList.size());
+    cullCenters.clear();
+    cullRadii.clear();
+    for (const auto &ri : renderList)
+    {
+        const CullBounds& b = bounds.emplace_back(getCullBounds(ri));
+        cullCenters.push_back(cameraMatrix * ri.position);
+        cullRadii.push_back(b.cullRadius);
+    }
+    frustum.testSpheres(cullCenters.data(), cullRadii.data(), renderList.size(), cullMask);
 
-        Vector3f center = getCameraOrientation().toRotationMatrix() * ri.position;
-        // Test the object's bounding sphere against the view frustum
-        if (frustum.testSphere(center, cullRadius) != Frustum::Outside)
+    // Remove objects from the render list that lie completely outside the
+    // view frustum.
+    auto notCulled = renderList.begin();
+    for (std::size_t i = 0; i < renderList.size(); i++)
+    {
+        if (Frustum::isVisible(cullMask, i))
         {
+            auto &ri = renderList[i];
+            const Vector3f& center = cullCenters[i];
+            float radius = bounds[i].radius;
+            float cloudHeight = bounds[i].cloudHeight;
+            bool convex = bounds[i].convex;
+
             float nearZ = center.norm() - radius;
             float maxSpan = hypot((float) windowWidth, (float) windowHeight);
             float nearZcoeff = cos(degToRad(fov / 2.0f)) * ((float) windowHeight / maxSpan);
@@ -5631,12 +7203,13 @@ Renderer::buildNearSystemsLists(const Universe &universe,
     UniversalCoord observerPos = observer.getPosition();
     Eigen::Quaterniond observerOrient = observer.getOrientation();
 
-    universe.getNearStars(observerPos, SolarSystemMaxDistance, nearStars);
+    // The octree is only queried when the observer enters a new cell
+    nearStarCache.find(*universe.getStarCatalog(), observerPos, SolarSystemMaxDistance, nearStars);
 
     // Set up direct light sources (i.e. just stars at the moment)
     // Skip if only star orbits to be shown
     if ((renderFlags & ShowSolarSystemObjects) != 0)
-        setupLightSources(nearStars, observerPos, now, lightSourceList, renderFlags);
+        setupLightSources(nearStars, *universe.getStarCatalog(), observerPos, now, lightSourceList, renderFlags);
 
     // Traverse the frame trees of each nearby solar system and
     // build the list of objects to be rendered.
@@ -5663,12 +7236,23 @@ Renderer::buildNearSystemsLists(const Universe &universe,
         }
 
         // Compute the position of the observer in astrocentric coordinates
-        Vector3d astrocentricObserverPos = astrocentricPosition(observerPos, *sun, now);
+        Vector3d astrocentricObserverPos = observerPos.offsetFromKm(universe.getStarCatalog()->getStarPosition(*sun, now));
+
+        // Build render lists for bodies and orbits paths. The bodies of
+        // solar systems entirely outside the view frustum, or too far away
+        // for any of them to be seen, are skipped unless some are labeled;
+        // their orbits are culled separately.
+        bool testSize = (solarSysTree->childClassMask() & translateLabelModeToClassMask(labelMode)) == 0;
+        if (isBoundingSphereVisible(-astrocentricObserverPos,
+                                    solarSysTree->boundingSphereRadius(),
+                                    solarSysTree->maxChildCullingRadius(),
+                                    testSize, xfrustum))
+        {
+            buildRenderLists(astrocentricObserverPos, xfrustum,
+                             observerOrient.conjugate() * -Vector3d::UnitZ(),
+                             Vector3d::Zero(), solarSysTree, observer, now);
+        }
 
-        // Build render lists for bodies and orbits paths
-        buildRenderLists(astrocentricObserverPos, xfrustum,
-                         observerOrient.conjugate() * -Vector3d::UnitZ(),
-                         Vector3d::Zero(), solarSysTree, observer, now);
         if ((renderFlags & ShowOrbits) != 0)
         {
             buildOrbitLists(astrocentricObserverPos, observerOrient,
@@ -5676,6 +7260,9 @@ Renderer::buildNearSystemsLists(const Universe &universe,
         }
     }
 
+    if ((renderFlags & ShowSolarSystemObjects) != 0)
+        removeOccludedBodies();
+
     if ((labelMode & BodyLabelMask) != 0)
         buildLabelLists(xfrustum, now);
 }
@@ -5817,6 +7404,15 @@ Renderer::buildDepthPartitions()
                                       orbitPathList.back().centerZ - orbitPathList.back().radius);
     }
 
+    // With the reversed floating point depth, one partition from the
+    // nearest to the farthest object has enough precision for all of them.
+    if (reverseDepthActive)
+    {
+        depthPartitions.front().nearZ = min(depthPartitions.back().nearZ, -MinNearPlaneDistance);
+        depthPartitions.resize(1);
+        nIntervals = 1;
+    }
+
     // We want to avoid overpartitioning the depth buffer. In this stage, we
     // coalesce partitions that have small spans in the depth buffer.
     // TODO: Implement this step!
@@ -5832,6 +7428,19 @@ Renderer::renderSolarSystemObjects(const Observer &observer,
     auto annotation = depthSortedAnnotations.begin();
     float intervalSize = 1.0f / static_cast<float>(max(1, nIntervals));
     int i = static_cast<int>(renderList.size()) - 1;
+
+    // The depth of the objects drawn before is conventional
+    if (reverseDepthActive)
+    {
+        Renderer::PipelineState ps;
+        ps.depthMask = true;
+        ps.depthTest = true;
+        setPipelineState(ps);
+
+        setDepthConvention(true);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
     for (int interval = 0; interval < nIntervals; interval++)
     {
         currentIntervalIndex = interval;
@@ -5851,6 +7460,8 @@ Renderer::renderSolarSystemObjects(const Observer &observer,
         Matrix4f proj;
         if (getProjectionMode() == Renderer::ProjectionMode::FisheyeMode)
             proj = Ortho(-aspectRatio, aspectRatio, -1.0f, 1.0f, nearPlaneDistance, farPlaneDistance);
+        else if (reverseDepthActive)
+            proj = PerspectiveReverseZ(fov, aspectRatio, nearPlaneDistance, farPlaneDistance);
         else
             proj = Perspective(fov, aspectRatio, nearPlaneDistance, farPlaneDistance);
         Matrices m = { &proj, &m_modelMatrix };
@@ -5864,7 +7475,12 @@ Renderer::renderSolarSystemObjects(const Observer &observer,
 
         int firstInInterval = i;
 
+        // Opaque models shared by several bodies are collected while
+        // rendering the opaque objects and drawn together afterwards.
+        collectModelInstances = modelInstances != nullptr && ModelInstances::isSupported();
+
         // Render just the opaque objects in the first pass
+        std::optional<GPUProfileZone> planetsZone(std::in_place, gpuProfiler.get(), "Planets");
         while (i >= 0 && renderList[i].farZ < depthPartitions[interval].nearZ)
         {
             // This interval should completely contain the item
@@ -5879,12 +7495,24 @@ Renderer::renderSolarSystemObjects(const Observer &observer,
             i--;
         }
 
+        if (collectModelInstances)
+        {
+            collectModelInstances = false;
+            if (!modelInstances->empty())
+                modelInstances->draw(this, m, astro::daysToSecs(now - astro::J2000));
+        }
+        planetsZone.reset();
+
         // Render orbit paths
         if (!orbitPathList.empty())
         {
+            GPUProfileZone orbitsZone(gpuProfiler.get(), "Orbits");
             // Scan through the list of orbits and render any that overlap this interval
             for (const auto& orbit : orbitPathList)
             {
+                if (orbit.drawnOnGPU)
+                    continue;
+
                 // Test for overlap
                 float nearZ = -orbit.centerZ - orbit.radius;
                 float farZ = -orbit.centerZ + orbit.radius;
@@ -5901,9 +7529,15 @@ Renderer::renderSolarSystemObjects(const Observer &observer,
                                 m);
                 }
             }
+
+            // All of the orbits drawn by the GPU are drawn in every
+            // interval and clipped to it by the projection.
+            if (useGPUOrbits && !gpuOrbitPaths->empty())
+                renderGPUOrbits(m);
         }
 
         // Render transparent objects in the second pass
+        planetsZone.emplace(gpuProfiler.get(), "Planets");
         i = firstInInterval;
         while (i >= 0 && renderList[i].farZ < depthPartitions[interval].nearZ)
         {
@@ -5930,6 +7564,7 @@ Renderer::renderSolarSystemObjects(const Observer &observer,
         pointStarVertexBuffer->render();
         pointStarVertexBuffer->finish();
         PointStarVertexBuffer::disable();
+        planetsZone.reset();
 
         // Render annotations in this interval
         annotation = renderSortedAnnotations(annotation,
@@ -5941,6 +7576,11 @@ Renderer::renderSolarSystemObjects(const Observer &observer,
 
     // reset the depth range
     glDepthRange(0, 1);
+    if (reverseDepthActive)
+    {
+        setDepthConvention(false);
+        reverseDepthActive = false;
+    }
     setDefaultProjectionMatrix();
 }
 
@@ -5950,27 +7590,27 @@ Renderer::setPipelineState(const Renderer::PipelineState &ps) noexcept
     if (ps.blending != m_pipelineState.blending)
     {
         if (ps.blending)
-            glEnable(GL_BLEND);
+            celestia::gl::enable(GL_BLEND);
         else
-            glDisable(GL_BLEND);
+            celestia::gl::disable(GL_BLEND);
         m_pipelineState.blending = ps.blending;
     }
     if (ps.blending && (ps.blendFunc.src != m_pipelineState.blendFunc.src || ps.blendFunc.dst != m_pipelineState.blendFunc.dst))
     {
-        glBlendFunc(ps.blendFunc.src, ps.blendFunc.dst);
+        celestia::gl::blendFunc(ps.blendFunc.src, ps.blendFunc.dst);
         m_pipelineState.blendFunc = ps.blendFunc;
     }
     if (ps.depthTest != m_pipelineState.depthTest)
     {
         if (ps.depthTest)
-            glEnable(GL_DEPTH_TEST);
+            celestia::gl::enable(GL_DEPTH_TEST);
         else
-            glDisable(GL_DEPTH_TEST);
+            celestia::gl::disable(GL_DEPTH_TEST);
         m_pipelineState.depthTest = ps.depthTest;
     }
     if (ps.depthMask != m_pipelineState.depthMask)
     {
-        glDepthMask(ps.depthMask ? GL_TRUE : GL_FALSE);
+        celestia::gl::depthMask(ps.depthMask ? GL_TRUE : GL_FALSE);
         m_pipelineState.depthMask = ps.depthMask;
     }
     if (ps.smoothLines != m_pipelineState.smoothLines)
@@ -5978,14 +7618,14 @@ Renderer::setPipelineState(const Renderer::PipelineState &ps) noexcept
         if (ps.smoothLines && (renderFlags & ShowSmoothLines) != 0)
         {
             #ifndef GL_ES
-            glEnable(GL_LINE_SMOOTH);
+            celestia::gl::enable(GL_LINE_SMOOTH);
             #endif
             glLineWidth(getRasterizedLineWidth(1.0f));
         }
         else
         {
             #ifndef GL_ES
-            glDisable(GL_LINE_SMOOTH);
+            celestia::gl::disable(GL_LINE_SMOOTH);
             #endif
             glLineWidth(getScaleFactor());
         }
@@ -10,9 +10,14 @@
 
 #pragma once
 
+#include <cstdint>
+#include <limits>
 #include <list>
+#include <map>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include <Eigen/Core>
@@ -22,24 +27,47 @@
 #include <celengine/starcolors.h>
 #include <celengine/rendcontext.h>
 #include <celengine/renderlistentry.h>
+#include <celengine/pickgrid.h>
+#include <celengine/nearstarcache.h>
+#include <celutil/framearena.h>
+#include "glstate.h"
 #include "vertexobject.h"
 
 class RendererWatcher;
+class BodySnapshot;
 class FrameTree;
+class TimelinePhase;
 class ReferenceMark;
 class CurvePlot;
 class PointStarVertexBuffer;
+class GPUOrbitPaths;
+class MarkerBatch;
+class MinorBodyTable;
+class GPUProfiler;
+class ModelInstances;
+class ImpostorCache;
+class LabelDeclutter;
+class SkyGrid;
+class GPUStarField;
 class AsterismRenderer;
 class BoundariesRenderer;
 class Observer;
 class TextureFont;
 class FramebufferObject;
+class MultiviewFramebuffer;
+class Geometry;
 
 namespace celestia
 {
 class Rect;
 }
 
+namespace celestia::util
+{
+class ThreadPool;
+struct MemoryUsage;
+}
+
 namespace celmath
 {
 class Frustum;
@@ -84,6 +112,24 @@ struct SecondaryIlluminator
 };
 
 
+// A body of a planetary system that can cast eclipse shadows
+struct EclipseCaster
+{
+    const Body*     body;
+    Eigen::Vector3d position;         // astrocentric position
+    float           radius;
+};
+
+
+// The eclipse casters of a planetary system, gathered once per frame and
+// sorted by decreasing radius
+struct EclipseCasterList
+{
+    uint32_t frame;
+    std::vector<EclipseCaster> casters;
+};
+
+
 enum class VOType
 {
     Marker     = 0,
@@ -94,7 +140,10 @@ enum class VOType
     AxisLetter = 5,
     MarkerLine = 6,
     Ecliptic   = 7,
-    Count      = 8,
+    CometTail  = 8,
+    PlanetGrid = 9,
+    Rings      = 10,
+    Count      = 11,
 };
 
 enum class RenderMode
@@ -164,6 +213,31 @@ class Renderer
 
     bool getInfo(std::map<std::string, std::string>& info) const;
 
+    // Work done to draw the views of a frame
+    struct FrameStats
+    {
+        celestia::gl::DrawStats draw;
+        // GL state calls made and skipped by the state cache
+        std::uint32_t stateCalls{ 0 };
+        std::uint32_t stateCallsSkipped{ 0 };
+        // Octree nodes visited and objects found in them
+        std::size_t starNodes{ 0 };
+        std::size_t stars{ 0 };
+        std::size_t dsoNodes{ 0 };
+        std::size_t dsos{ 0 };
+        std::size_t renderListEntries{ 0 };
+        std::size_t orbitPaths{ 0 };
+        std::size_t annotations{ 0 };
+        // Textures and models loaded
+        std::uint64_t resourcesLoaded{ 0 };
+        unsigned int views{ 0 };
+    };
+
+    // Start counting the work of a frame, which is drawn by the calls to
+    // render() until the next call
+    void beginFrameStats();
+    const FrameStats& getFrameStats() const { return frameStats; }
+
     enum {
         NoLabels            = 0x000,
         StarLabels          = 0x001,
@@ -313,7 +387,102 @@ class Renderer
     [[deprecated]] bool getVideoSync() const;
     [[deprecated]] void setVideoSync(bool);
     void setSolarSystemMaxDistance(float);
+    float getSolarSystemMaxDistance() const { return SolarSystemMaxDistance; }
     void setShadowMapSize(unsigned);
+    // Keep the star catalog in GPU memory and cull stars by magnitude in
+    // the vertex shader; only used for the fuzzy and scaled disc star styles.
+    void setGPUStarField(bool);
+    // Draw the paths of elliptical orbits with an instanced vertex shader
+    // instead of sampling them on the CPU; needs instanced arrays.
+    void setGPUOrbits(bool);
+    // Draw opaque bodies which share a model with one instanced draw call
+    // per primitive group; needs instanced arrays.
+    void setModelInstancing(bool);
+    // Draw galaxies and nebulae which are small on the screen from cached
+    // billboards; needs framebuffer objects.
+    void setDSOImpostors(bool);
+    // Hide labels which overlap a label of higher priority
+    void setLabelDeclutter(bool);
+    // Timer queries of the frame profiler, or nullptr when the profiler
+    // doesn't exist or timer queries aren't supported
+    GPUProfiler* getGPUProfiler() const { return gpuProfiler.get(); }
+    // Fraction of the detail of stars, galaxies and globular clusters to
+    // draw, from 0 to 1, set by the frame governor. Halving it dims the
+    // faintest stars drawn by a magnitude and halves the points of the
+    // galaxies and clusters.
+    void setDetailScale(float scale) { detailScale = scale; }
+    float getDetailScale() const { return detailScale; }
+    // Draw the solar system objects with a reversed depth, from 1 at the
+    // near plane to 0 at the far plane, in a single depth buffer partition
+    // instead of one per group of overlapping objects. Only used with a
+    // perspective projection, when clip control is supported and the
+    // framebuffer drawn into has a floating point depth buffer.
+    static bool isReverseDepthSupported();
+    void setReverseDepth(bool enable) { reverseDepth = enable; }
+    bool getReverseDepth() const { return reverseDepth; }
+    // Whether the objects are being drawn with the reversed depth
+    bool isReverseDepthActive() const { return reverseDepthActive; }
+    // Set the clip control, depth test and depth clear value for the
+    // reversed depth or the conventional one, for example to draw shadow
+    // maps in the middle of the solar system objects
+    void setDepthConvention(bool reverse);
+    // Number of threads used to cull the bodies of large solar systems;
+    // 1 does all of the work on the render thread, 0 uses one thread per
+    // processor core.
+    void setRenderListThreads(unsigned int);
+    // Draw planets and moons from the chunks of a cube sphere, refined
+    // where they are seen up close, instead of rings of latitude
+    void setCubeSphereGeometry(bool);
+    // Memory in bytes for the samples of orbit paths, beyond which the
+    // least recently used paths are dropped from the cache
+    void setOrbitCacheBudget(std::size_t);
+    // Add a node of the caches of the renderer to parent
+    void accountMemory(celestia::util::MemoryUsage& parent) const;
+    // Positions of bodies computed ahead of the frame, used instead of
+    // evaluating the orbits of the bodies when the time matches; null to
+    // evaluate all of them while drawing
+    void setBodySnapshot(const BodySnapshot* snapshot) { bodySnapshot = snapshot; }
+    // The stars drawn in the last frame of observer's view, or nullptr if
+    // they weren't recorded
+    const PickGrid* getPickGrid(const Observer& observer) const;
+
+    // A view drawn in the same frame as others, see setSharedViews()
+    struct SharedView
+    {
+        UniversalCoord position;
+        Eigen::Quaternionf orientation;
+        // Vertical field of view in radians
+        float fov;
+        float aspectRatio;
+    };
+
+    // Views of one frame whose observers are at the same position, such as
+    // those of stereo or dome setups, share the traversals of the star and
+    // deep sky octrees; each view only culls the nodes found for a frustum
+    // containing them all. Solar system bodies are also positioned once
+    // for all views. The views are set before they are drawn and cleared
+    // afterwards; views that weren't set are drawn as usual.
+    void setSharedViews(const std::vector<SharedView>&);
+    void clearSharedViews();
+
+    // Draw the views of the eyes of the observer instead of the view from
+    // its position, see Observer::getEyeSeparation(). Both eyes are drawn
+    // in a single pass between beginMultiview() and endMultiview().
+    enum class StereoEyes
+    {
+        None,
+        Left,
+        Right,
+        Both,
+    };
+    void setStereoEyes(StereoEyes eyes) { stereoEyes = eyes; }
+    StereoEyes getStereoEyes() const { return stereoEyes; }
+    bool isMultiviewSupported() const;
+    // Draw the following frames into a layer of width x height pixels for
+    // each eye, then copy the layers side by side at x, y of the
+    // framebuffer bound before. Returns false if multiview isn't supported.
+    bool beginMultiview(int width, int height);
+    void endMultiview(int x, int y);
 
     bool captureFrame(int, int, int, int, celestia::PixelFormat format, unsigned char*) const;
 
@@ -389,40 +558,57 @@ class Renderer
         VerticalAlignTop,
     };
 
+    // When labels overlap, those of a higher priority are kept, see
+    // setLabelDeclutter(). Labels of AlwaysShownLabelPriority are never
+    // hidden; the label of the selected object is only hidden by these.
+    static constexpr float AlwaysShownLabelPriority = std::numeric_limits<float>::max();
+    static constexpr float SelectedLabelPriority = 1.0e4f;
+
+    // Priority of the label of an object of apparent magnitude appMag
+    static float getLabelPriority(float appMag, bool selected)
+    {
+        return selected ? SelectedLabelPriority : -appMag;
+    }
+
     struct Annotation
     {
-        std::string labelText;
+        // Copied to the frame arena, valid until the next frame
+        std::string_view labelText;
         const celestia::MarkerRepresentation* markerRep;
         Color color;
         Eigen::Vector3f position;
         LabelAlignment halign : 3;
         LabelVerticalAlignment valign : 3;
         float size;
+        float priority;
 
         bool operator<(const Annotation&) const;
     };
 
     void addForegroundAnnotation(const celestia::MarkerRepresentation* markerRep,
-                                 const std::string& labelText,
+                                 std::string_view labelText,
                                  Color color,
                                  const Eigen::Vector3f& position,
                                  LabelAlignment halign = AlignLeft,
                                  LabelVerticalAlignment valign = VerticalAlignBottom,
-                                 float size = 0.0f);
+                                 float size = 0.0f,
+                                 float priority = AlwaysShownLabelPriority);
     void addBackgroundAnnotation(const celestia::MarkerRepresentation* markerRep,
-                                 const std::string& labelText,
+                                 std::string_view labelText,
                                  Color color,
                                  const Eigen::Vector3f& position,
                                  LabelAlignment halign = AlignLeft,
                                  LabelVerticalAlignment valign = VerticalAlignBottom,
-                                 float size = 0.0f);
+                                 float size = 0.0f,
+                                 float priority = AlwaysShownLabelPriority);
     void addSortedAnnotation(const celestia::MarkerRepresentation* markerRep,
-                             const std::string& labelText,
+                             std::string_view labelText,
                              Color color,
                              const Eigen::Vector3f& position,
                              LabelAlignment halign = AlignLeft,
                              LabelVerticalAlignment valign = VerticalAlignBottom,
-                             float size = 0.0f);
+                             float size = 0.0f,
+                             float priority = AlwaysShownLabelPriority);
 
     ShaderManager& getShaderManager() const { return *shaderManager; }
 
@@ -431,14 +617,41 @@ class Renderer
     // Callbacks for renderables; these belong in a special renderer interface
     // only visible in object's render methods.
     void beginObjectAnnotations();
-    void addObjectAnnotation(const celestia::MarkerRepresentation* markerRep, const std::string& labelText, Color, const Eigen::Vector3f&);
+    void addObjectAnnotation(const celestia::MarkerRepresentation* markerRep, std::string_view labelText, Color, const Eigen::Vector3f&);
     void endObjectAnnotations();
     const Eigen::Quaternionf& getCameraOrientation() const;
+    // The selected object of the frame being rendered
+    const Selection& getHighlightObject() const { return highlightObject; }
     float getNearPlaneDistance() const;
 
     void clearAnnotations(std::vector<Annotation>&);
 
     void invalidateOrbitCache();
+    // Stars fainter than this apparent magnitude are drawn from the
+    // combined light of distant octree nodes, see StarAggregates
+    void setStarAggregateMagnitude(float mag) { starAggregateMag = mag; }
+    float getStarAggregateMagnitude() const { return starAggregateMag; }
+
+    // Supplies the newest orientation of an observer while a frame is
+    // drawn from it, such as one following a head tracker. The view is
+    // rotated to it once the visible objects are found, just before they
+    // are drawn, instead of waiting for the next simulation update.
+    class LateOrientationSource
+    {
+     public:
+        virtual ~LateOrientationSource() = default;
+        // Return false when there's no newer orientation of the observer
+        virtual bool getLatestOrientation(const Observer&, Eigen::Quaternionf&) = 0;
+    };
+
+    // The source isn't owned by the renderer. Objects are culled with a
+    // frustum wider by the margin, in radians, on all sides, and late
+    // rotations are limited to it.
+    void setLateOrientationSource(LateOrientationSource* source) { lateOrientationSource = source; }
+    void setLateOrientationMargin(float margin) { lateOrientationMargin = margin; }
+    // Find the stars near the observer again, after the star catalog
+    // was changed
+    void invalidateNearStars();
 
     struct OrbitPathListEntry
     {
@@ -448,6 +661,8 @@ class Renderer
         const Star* star;
         Eigen::Vector3d origin;
         float opacity;
+        // Drawn by GPUOrbitPaths instead of renderOrbit()
+        bool drawnOnGPU{ false };
 
         bool operator<(const OrbitPathListEntry&) const;
     };
@@ -470,19 +685,20 @@ class Renderer
     void notifyWatchers() const;
 
     FramebufferObject* getShadowFBO(int) const;
+    // The shadow map is only redrawn when it doesn't hold the shadow of the
+    // same geometry lit from nearly the same direction. Returns true and
+    // the light matrix the map was drawn with if it can be reused.
+    bool getCachedShadow(const Geometry*,
+                         const Eigen::Vector3f& lightDirection,
+                         Eigen::Matrix4f* lightMatrix) const;
+    void setCachedShadow(const Geometry*,
+                         const Eigen::Vector3f& lightDirection,
+                         const Eigen::Matrix4f& lightMatrix);
 
  public:
     // Internal types
     // TODO: Figure out how to make these private.  Even with a friend
     //
-    struct Particle
-    {
-        Eigen::Vector3f center;
-        float size;
-        Color color;
-        float pad0, pad1, pad2;
-    };
-
     struct RenderProperties
     {
         Surface* surface{ nullptr };
@@ -496,10 +712,6 @@ class Renderer
         LightingState::EclipseShadowVector* eclipseShadows;
     };
 
-#ifdef OCTREE_DEBUG
-    OctreeProcStats m_starProcStats;
-    OctreeProcStats m_dsoProcStats;
-#endif
  private:
     struct SkyVertex
     {
@@ -554,6 +766,9 @@ class Renderer
     void renderPointStars(const StarDatabase& starDB,
                           float faintestVisible,
                           const Observer& observer);
+    void renderMinorBodies(MinorBodyTable& table,
+                           const Observer& observer,
+                           double now);
     void renderDeepSkyObjects(const Universe&,
                               const Observer&,
                               float faintestMagNight);
@@ -573,6 +788,13 @@ class Renderer
                                const celmath::Frustum &xfrustum,
                                double jd);
 
+    struct SharedVisibility;
+    SharedVisibility* findSharedVisibility(const Observer&);
+    float setupEyes(const Observer&);
+    void setupCullingFrustum(float aspectRatio);
+    void latchOrientation(const Observer&);
+    Eigen::Vector3d getBodyPosition(const TimelinePhase&, const Eigen::Vector3d& frameCenter, double now);
+
     void buildRenderLists(const Eigen::Vector3d& astrocentricObserverPos,
                           const celmath::Frustum& viewFrustum,
                           const Eigen::Vector3d& viewPlaneNormal,
@@ -587,12 +809,37 @@ class Renderer
                          double now);
     void buildLabelLists(const celmath::Frustum& viewFrustum,
                          double now);
+    celestia::util::ArenaVector<bool> buildRenderListsParallel(const Eigen::Vector3d& astrocentricObserverPos,
+                                               const celmath::Frustum& viewFrustum,
+                                               const Eigen::Vector3d& viewPlaneNormal,
+                                               const Eigen::Vector3d& frameCenter,
+                                               const FrameTree* tree,
+                                               const Eigen::Vector3f& viewMatZ,
+                                               double now);
+    bool isBoundingSphereVisible(const Eigen::Vector3d& center_v,
+                                 double radius,
+                                 double maxBodyRadius,
+                                 bool testSize,
+                                 const celmath::Frustum& viewFrustum) const;
+    bool isChildVisible(const FrameTree* tree,
+                        unsigned int n,
+                        const Eigen::Vector3d& frameCenter_v,
+                        int labelClassMask,
+                        const celmath::Frustum& viewFrustum) const;
+    bool makeRenderListEntry(const Body& body,
+                             const Eigen::Vector3d& pos_s,
+                             const Eigen::Vector3d& pos_v,
+                             const Eigen::Vector3f& viewMatZ,
+                             int labelClassMask,
+                             RenderListEntry& rle,
+                             bool& isLabeled) const;
     int buildDepthPartitions();
 
 
     void addRenderListEntries(RenderListEntry& rle,
                               Body& body,
                               bool isLabeled);
+    void removeOccludedBodies();
 
     void addStarOrbitToRenderList(const Star& star,
                                   const Observer& observer,
@@ -609,6 +856,12 @@ class Renderer
                       const LightingState&,
                       const Matrices&);
 
+    bool addModelInstance(const Eigen::Vector3f& pos,
+                          float distance,
+                          float nearPlaneDistance,
+                          const RenderProperties& obj,
+                          const LightingState&);
+
     void renderPlanet(Body& body,
                       const Eigen::Vector3f& pos,
                       float distance,
@@ -676,25 +929,30 @@ class Renderer
                     const Matrices&);
 
     bool testEclipse(const Body& receiver,
-                     const Body& caster,
+                     const Eigen::Vector3d& posReceiver,
+                     const EclipseCaster& caster,
                      LightingState& lightingState,
                      unsigned int lightIndex,
                      double now);
+    const std::vector<EclipseCaster>& getEclipseCasters(const PlanetarySystem* system,
+                                                        double now);
+    bool isEclipseCaster(const Body& body, double now) const;
 
     void labelConstellations(const AsterismList& asterisms,
                              const Observer& observer);
-    void renderParticles(const std::vector<Particle>& particles);
 
 
     void addAnnotation(std::vector<Annotation>&,
                        const celestia::MarkerRepresentation*,
-                       const std::string& labelText,
+                       std::string_view labelText,
                        Color color,
                        const Eigen::Vector3f& position,
                        LabelAlignment halign = AlignLeft,
                        LabelVerticalAlignment = VerticalAlignBottom,
                        float size = 0.0f,
-                       bool special = false);
+                       bool special = false,
+                       float priority = AlwaysShownLabelPriority);
+    void declutterAnnotations(std::vector<Annotation>&, FontStyle);
     void renderAnnotationMarker(const Annotation &a,
                                 FontStyle fs,
                                 float depth,
@@ -703,8 +961,13 @@ class Renderer
                                FontStyle fs,
                                int hOffset,
                                int vOffset,
-                               float depth,
-                               const Matrices&);
+                               float depth);
+    void flushAnnotationLabels(TextureFont&, const Matrices&);
+    bool addMarkerToBatch(celestia::MarkerRepresentation::Symbol symbol,
+                          float size,
+                          const Color& color,
+                          const Eigen::Vector3f& position);
+    void renderMarkerBatch(const Matrices&);
     void renderAnnotations(const std::vector<Annotation>&,
                            FontStyle fs);
     void renderBackgroundAnnotations(FontStyle fs);
@@ -739,6 +1002,8 @@ class Renderer
                      float nearDist,
                      float farDist,
                      const Matrices&);
+    void renderGPUOrbits(const Matrices&);
+    void trimOrbitCache();
 
     void renderSolarSystemObjects(const Observer &observer,
                                   int nIntervals,
@@ -771,6 +1036,7 @@ class Renderer
     float brightnessBias;
 
     float brightnessScale{ 1.0f };
+    float detailScale{ 1.0f };
     float faintestMag{ 0.0f };
     float faintestPlanetMag{ 0.0f };
     float saturationMagNight;
@@ -783,17 +1049,84 @@ class Renderer
     Eigen::Quaternionf m_cameraOrientation;
     PointStarVertexBuffer* pointStarVertexBuffer;
     PointStarVertexBuffer* glareVertexBuffer;
+    std::unique_ptr<GPUStarField> gpuStarField;
+    std::unique_ptr<GPUOrbitPaths> gpuOrbitPaths;
+    // Set each frame when gpuOrbitPaths can be used
+    bool useGPUOrbits{ false };
+    // Markers of the annotations being drawn, created when first used
+    std::unique_ptr<MarkerBatch> markerBatch;
+    std::unique_ptr<ModelInstances> modelInstances;
+    // Set during the opaque pass of each depth interval, when bodies may be
+    // added to modelInstances instead of being drawn right away
+    bool collectModelInstances{ false };
+    std::unique_ptr<ImpostorCache> impostorCache;
+    std::unique_ptr<GPUProfiler> gpuProfiler;
+    std::unique_ptr<LabelDeclutter> labelDeclutter;
+    // The sky grids are kept between frames for their cached lines
+    std::unique_ptr<SkyGrid> equatorialGrid;
+    std::unique_ptr<SkyGrid> galacticGrid;
+    std::unique_ptr<SkyGrid> eclipticGrid;
+    std::unique_ptr<SkyGrid> horizonGrid;
+    // Visible star octree nodes of the previous frame, per observer
+    std::map<const Observer*, FlatStarOctree::VisibleNodeCache> starNodeCaches;
+    // Stars drawn in the previous frame, per observer
+    std::map<const Observer*, PickGrid> pickGrids;
+
+    // Octree nodes visible from a position shared by several views
+    struct SharedVisibility
+    {
+        Eigen::Vector3d position;
+        std::vector<SharedView> views;
+        // Frustum containing those of all views; the fov is zero when they
+        // span too wide an angle to be contained in one
+        Eigen::Quaternionf orientation;
+        float fov;
+
+        const StarDatabase* starDB{ nullptr };
+        float starLimitingMag;
+        std::vector<FlatStarOctree::VisibleNode> starNodes;
+        const DSODatabase* dsoDB{ nullptr };
+        float dsoLimitingMag;
+        std::vector<FlatDSOOctree::VisibleNode> dsoNodes;
+    };
+    std::vector<SharedVisibility> sharedVisibility;
+    // Sun-relative body positions computed by one of the shared views, for
+    // the time sharedPositionTime
+    std::unordered_map<const TimelinePhase*, Eigen::Vector3d> sharedBodyPositions;
+    double sharedPositionTime{ 0.0 };
+    const BodySnapshot* bodySnapshot{ nullptr };
+    StereoEyes stereoEyes{ StereoEyes::None };
+    std::unique_ptr<MultiviewFramebuffer> multiviewFbo;
+    // Framebuffer the layers of multiviewFbo are copied to
+    GLint multiviewTargetFbo{ 0 };
+    // Memory for the data of a single frame, released at the start of the
+    // next one by draw(). The lists of the frame kept as members below
+    // are cleared rather than freed, so they keep their capacity.
+    celestia::util::FrameArena frameArena;
+    FrameStats frameStats;
+    // Resources loaded when they were last counted in frameStats
+    std::uint64_t resourceLoadMark{ 0 };
+    OctreeProcStats m_starProcStats;
+    OctreeProcStats m_dsoProcStats;
     std::vector<RenderListEntry> renderList;
+    // Bounding spheres of the render list entries and the result of testing
+    // them against the view frustum
+    std::vector<Eigen::Vector3f> cullCenters;
+    std::vector<float> cullRadii;
+    std::vector<std::uint32_t> cullMask;
+    std::unique_ptr<celestia::util::ThreadPool> renderListPool;
     std::vector<SecondaryIlluminator> secondaryIlluminators;
     std::vector<DepthBufferPartition> depthPartitions;
-    std::vector<Particle> glareParticles;
     std::vector<Annotation> backgroundAnnotations;
     std::vector<Annotation> foregroundAnnotations;
     std::vector<Annotation> depthSortedAnnotations;
     std::vector<Annotation> objectAnnotations;
     std::vector<OrbitPathListEntry> orbitPathList;
     LightingState::EclipseShadowVector eclipseShadows[MaxLights];
+    std::unordered_map<const PlanetarySystem*, EclipseCasterList> eclipseCasters;
+    std::vector<EclipseCaster> eclipseParents;
     std::vector<const Star*> nearStars;
+    NearStarCache nearStarCache;
 
     std::vector<LightSource> lightSourceList;
 
@@ -811,14 +1144,17 @@ class Renderer
     uint32_t frameCount;
 
     int currentIntervalIndex{ 0 };
+    bool reverseDepth{ false };
+    bool reverseDepthActive{ false };
 
     PipelineState m_pipelineState;
 
     std::array<int, 4> m_viewport { 0, 0, 0, 0 };
 
-    typedef std::map<const Orbit*, CurvePlot*> OrbitCache;
+    typedef std::map<const Orbit*, std::unique_ptr<CurvePlot>> OrbitCache;
     OrbitCache orbitCache;
     uint32_t lastOrbitCacheFlush;
+    std::size_t orbitCacheBudget;
 
     float minOrbitSize;
     float distanceLimit;
@@ -847,12 +1183,30 @@ class Renderer
     // will not necessarily be rendered correctly. This limit is used for
     // visibility culling of solar systems.
     float SolarSystemMaxDistance{ 1.0f };
+    float starAggregateMag{ std::numeric_limits<float>::infinity() };
+
+    LateOrientationSource* lateOrientationSource{ nullptr };
+    float lateOrientationMargin{ 0.0f };
+    // Vertical field of view in radians and aspect ratio of the frustum
+    // stars and deep sky objects are culled with
+    float cullingFov{ 0.0f };
+    float cullingAspectRatio{ 1.0f };
 
     // Size of a texture used in shadow mapping
     unsigned m_shadowMapSize { 0 };
     std::unique_ptr<FramebufferObject> m_shadowFBO;
+    // What m_shadowFBO currently holds
+    struct ShadowMapContents
+    {
+        const Geometry* geometry{ nullptr };
+        Eigen::Vector3f lightDirection{ Eigen::Vector3f::Zero() };
+        Eigen::Matrix4f lightMatrix{ Eigen::Matrix4f::Identity() };
+    };
+    ShadowMapContents m_shadowMapContents;
 
     std::array<celgl::VertexObject*, static_cast<size_t>(VOType::Count)> m_VertexObjects;
+    // Shared by the vertex objects and curve plots rebuilt every frame
+    std::unique_ptr<celgl::StreamBuffer> m_streamBuffer;
 
     // Saturation magnitude used to calculate a point star size
     float satPoint;
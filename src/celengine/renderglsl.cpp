@@ -31,10 +31,13 @@
 #include "render.h"
 #include "renderglsl.h"
 #include "renderinfo.h"
+#include "scatteringtable.h"
 #include "shadermanager.h"
 #include "shadowmap.h" // GL_ONLY_SHADOWS definition
 #include "texture.h"
 #include "vecgl.h"
+#include "vertexobject.h"
+#include "glstate.h"
 
 using namespace celestia;
 
@@ -71,6 +74,8 @@ void renderGeometryShadow_GLSL(Geometry* geometry,
                                Renderer* renderer,
                                Eigen::Matrix4f *lightMatrix)
 {
+    // The shadow map is drawn from the light, not from the eyes
+    ShaderManager::SingleViewScope singleView(renderer->getShaderManager());
     auto *prog = renderer->getShaderManager().getShader("depth");
     if (prog == nullptr)
         return;
@@ -80,6 +85,12 @@ void renderGeometryShadow_GLSL(Geometry* geometry,
     shadowFbo->bind();
     glViewport(0, 0, shadowFbo->width(), shadowFbo->height());
 
+    // The shadow map has the conventional depth, even when the objects
+    // are drawn with the reversed one
+    bool reverseDepth = renderer->isReverseDepthActive();
+    if (reverseDepth)
+        renderer->setDepthConvention(false);
+
     // Write only to the depth buffer
     glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
     glClear(GL_DEPTH_BUFFER_BIT);
@@ -96,7 +107,7 @@ void renderGeometryShadow_GLSL(Geometry* geometry,
     prog->use();
 
     // Enable poligon offset to decrease "shadow acne"
-    glEnable(GL_POLYGON_OFFSET_FILL);
+    celestia::gl::enable(GL_POLYGON_OFFSET_FILL);
     glPolygonOffset(.001f, .001f);
 
     Eigen::Matrix4f projMat = celmath::Ortho(-1.f, 1.f, -1.f, 1.f, -1.f, 1.f);
@@ -105,10 +116,12 @@ void renderGeometryShadow_GLSL(Geometry* geometry,
     prog->setMVPMatrices(projMat, modelViewMat);
     geometry->render(rc, tsec);
 
-    glDisable(GL_POLYGON_OFFSET_FILL);
+    celestia::gl::disable(GL_POLYGON_OFFSET_FILL);
     // Re-enable the color buffer
     glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
     glCullFace(GL_BACK);
+    if (reverseDepth)
+        renderer->setDepthConvention(true);
     shadowFbo->unbind(oldFboId);
 }
 
@@ -228,9 +241,9 @@ void renderEllipsoid_GLSL(const RenderInfo& ri,
             {
                 shadprop.texUsage |= ShaderProperties::CloudShadowTexture;
                 textures[nTextures++] = cloudTex;
-                glActiveTexture(GL_TEXTURE0 + nTextures);
+                celestia::gl::activeTexture(GL_TEXTURE0 + nTextures);
                 cloudTex->bind();
-                glActiveTexture(GL_TEXTURE0);
+                celestia::gl::activeTexture(GL_TEXTURE0);
 
                 for (unsigned int lightIndex = 0; lightIndex < ls.nLights; lightIndex++)
                 {
@@ -265,7 +278,7 @@ void renderEllipsoid_GLSL(const RenderInfo& ri,
         Texture* ringsTex = ls.shadowingRingSystem->texture.find(textureRes);
         if (ringsTex != nullptr)
         {
-            glActiveTexture(GL_TEXTURE0 + nTextures);
+            celestia::gl::activeTexture(GL_TEXTURE0 + nTextures);
             ringsTex->bind();
             nTextures++;
 
@@ -284,7 +297,7 @@ void renderEllipsoid_GLSL(const RenderInfo& ri,
                 glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER_OES);
 #endif
             }
-            glActiveTexture(GL_TEXTURE0);
+            celestia::gl::activeTexture(GL_TEXTURE0);
 
             shadprop.texUsage |= ShaderProperties::RingShadowTexture;
 
@@ -403,23 +416,27 @@ void renderGeometry_GLSL(Geometry* geometry,
         fmt::printf("bias: %f bits: %f clear: %f range: %f - %f, scale:%f\n", bias, bits, clear, range[0], range[1], scale);
 #endif
 
-        renderGeometryShadow_GLSL(geometry, shadowBuffer, ls, 0,
-                                  tsec, renderer, &lightMatrix);
+        if (!renderer->getCachedShadow(geometry, ls.lights[0].direction_obj, &lightMatrix))
+        {
+            renderGeometryShadow_GLSL(geometry, shadowBuffer, ls, 0,
+                                      tsec, renderer, &lightMatrix);
+            renderer->setCachedShadow(geometry, ls.lights[0].direction_obj, lightMatrix);
+        }
         renderer->setViewport(viewport);
 #ifdef DEPTH_BUFFER_DEBUG
-        glDisable(GL_DEPTH_TEST);
+        celestia::gl::disable(GL_DEPTH_TEST);
         glMatrixMode(GL_PROJECTION);
         glPushMatrix();
         glLoadMatrixf(Ortho2D(0.0f, (float)viewport[2], 0.0f, (float)viewport[3]).data());
         glMatrixMode(GL_MODELVIEW);
         glPushMatrix();
         glLoadIdentity();
-        glUseProgram(0);
+        celestia::gl::useProgram(0);
         glColor4f(1, 1, 1, 1);
 
-        glActiveTexture(GL_TEXTURE0);
-        glEnable(GL_TEXTURE_2D);
-        glBindTexture(GL_TEXTURE_2D, shadowBuffer->depthTexture());
+        celestia::gl::activeTexture(GL_TEXTURE0);
+        celestia::gl::enable(GL_TEXTURE_2D);
+        celestia::gl::bindTexture(GL_TEXTURE_2D, shadowBuffer->depthTexture());
 #if GL_ONLY_SHADOWS
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
 #endif
@@ -440,9 +457,9 @@ void renderGeometry_GLSL(Geometry* geometry,
         glPopMatrix();
         glMatrixMode(GL_PROJECTION);
         glPopMatrix();
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glDisable(GL_TEXTURE_2D);
-        glEnable(GL_DEPTH_TEST);
+        celestia::gl::bindTexture(GL_TEXTURE_2D, 0);
+        celestia::gl::disable(GL_TEXTURE_2D);
+        celestia::gl::enable(GL_DEPTH_TEST);
 #endif
         glDepthRange(range[0], range[1]);
     }
@@ -461,6 +478,7 @@ void renderGeometry_GLSL(Geometry* geometry,
 
     rc.setCameraOrientation(ri.orientation);
     rc.setPointScale(ri.pointScale);
+    rc.setModelPixelScale(ri.modelPixelScale);
 
     // Handle extended material attributes (per model only, not per submesh)
     rc.setLunarLambert(ri.lunarLambert);
@@ -507,6 +525,7 @@ void renderGeometry_GLSL_Unlit(Geometry* geometry,
 {
     GLSLUnlit_RenderContext rc(renderer, geometryScale, m.modelview, m.projection);
     rc.setPointScale(ri.pointScale);
+    rc.setModelPixelScale(ri.modelPixelScale);
 
     Renderer::PipelineState ps;
     ps.depthMask = true;
@@ -579,7 +598,7 @@ void renderClouds_GLSL(const RenderInfo& ri,
         Texture* ringsTex = rings->texture.find(textureRes);
         if (ringsTex != nullptr)
         {
-            glActiveTexture(GL_TEXTURE0 + nTextures);
+            celestia::gl::activeTexture(GL_TEXTURE0 + nTextures);
             ringsTex->bind();
             nTextures++;
 
@@ -589,7 +608,7 @@ void renderClouds_GLSL(const RenderInfo& ri,
             glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, bc);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,
                             GL_CLAMP_TO_BORDER);
-            glActiveTexture(GL_TEXTURE0);
+            celestia::gl::activeTexture(GL_TEXTURE0);
 
             shadprop.texUsage |= ShaderProperties::RingShadowTexture;
         }
@@ -675,6 +694,64 @@ void renderClouds_GLSL(const RenderInfo& ri,
 }
 
 
+// Render the sky sphere from the precomputed scattering tables of the
+// atmosphere. The sphere is sized so that the atmosphere has the same
+// thickness relative to the planet as the tables. Returns false if the
+// tables can't be used.
+static bool
+renderAtmosphereTable_GLSL(const RenderInfo& ri,
+                           const LightingState& ls,
+                           const Atmosphere* atmosphere,
+                           const celmath::Frustum& frustum,
+                           const Matrices &m,
+                           Renderer* renderer)
+{
+    ShaderProperties shadprop;
+    shadprop.nLights = ls.nLights;
+    shadprop.texUsage = ShaderProperties::Scattering | ShaderProperties::ScatteringTables;
+    shadprop.lightModel = ShaderProperties::AtmosphereModel;
+
+    CelestiaGLProgram* prog = renderer->getShaderManager().getShader(shadprop);
+    if (prog == nullptr)
+        return false;
+
+    ScatteringTable* table = atmosphere->scatteringTable.get();
+    if (!table->bind())
+        return false;
+
+    prog->use();
+
+    prog->setLightParameters(ls, ri.color, ri.specularColor, Color::Black);
+
+    // In units of the atmosphere radius
+    float atmScale = table->getShellRadius() / table->getPlanetRadius();
+    prog->eyePosition = ls.eyePos_obj / atmScale;
+    prog->atmosphereRadius = Eigen::Vector3f(1.0f, 1.0f, 1.0f / atmScale);
+    prog->scatteringTableSize = table->getSize();
+    float g = atmosphere->miePhaseAsymmetry;
+    prog->miePhaseAsymmetry = 1.55f * g - 0.55f * g * g * g;
+
+    prog->setMVPMatrices(*m.projection, (*m.modelview) * vecgl::scale(atmScale));
+
+    glFrontFace(GL_CW);
+
+    Renderer::PipelineState ps;
+    ps.blending = true;
+    ps.blendFunc = {GL_ONE, GL_SRC_ALPHA};
+    ps.depthTest = true;
+    renderer->setPipelineState(ps);
+
+    g_lodSphere->render(LODSphereMesh::Normals,
+                        frustum,
+                        ri.pixWidth,
+                        nullptr);
+
+    glFrontFace(GL_CCW);
+
+    return true;
+}
+
+
 // Render the sky sphere for a world with an atmosphere
 void
 renderAtmosphere_GLSL(const RenderInfo& ri,
@@ -692,6 +769,12 @@ renderAtmosphere_GLSL(const RenderInfo& ri,
     if (ls.nLights == 0)
         return;
 
+    if (atmosphere->scatteringTable != nullptr && ScatteringTable::isSupported() &&
+        renderAtmosphereTable_GLSL(ri, ls, atmosphere, frustum, m, renderer))
+    {
+        return;
+    }
+
     ShaderProperties shadprop;
     shadprop.nLights = ls.nLights;
 
@@ -738,24 +821,41 @@ renderAtmosphere_GLSL(const RenderInfo& ri,
     glFrontFace(GL_CCW);
 }
 
-static void renderRingSystem(GLuint *vboId,
-                             float innerRadius,
-                             float outerRadius,
-                             unsigned int nSections = 180)
+namespace
 {
-    struct RingVertex
-    {
-        GLfloat pos[3];
-        GLshort tex[2];
-    };
 
+struct RingVertex
+{
+    GLfloat pos[3];
+    GLshort tex[2];
+};
+
+// The rings are drawn at one of these levels of detail, from the number
+// of sections around them at the lowest one, doubling at each level
+constexpr unsigned int RingLODLevels = 4;
+constexpr unsigned int RingMinSections = 180;
+
+// The number of vertices of the triangle strip of a level of detail
+constexpr GLsizei
+ringStripLength(unsigned int level)
+{
+    return static_cast<GLsizei>(((RingMinSections << level) + 1) * 2);
+}
+
+// All ring systems are an annulus in the xz plane, which differ only by
+// their radii, so the strips of every level of detail are built once in a
+// static buffer shared by all of them. The x and z coordinates of the
+// vertices lie on the unit circle and are scaled in the vertex shader by
+// the inner or the outer radius, selected by the s texture coordinate.
+void
+initRingVO(celgl::VertexObject& vo)
+{
     constexpr const float angle = 2.0f * celestia::numbers::pi_v<float>;
 
-    if (*vboId == 0)
+    std::vector<RingVertex> ringCoord;
+    for (unsigned int level = 0; level < RingLODLevels; level++)
     {
-        struct RingVertex vertex;
-        std::vector<struct RingVertex> ringCoord;
-        ringCoord.reserve(2 * nSections);
+        unsigned int nSections = RingMinSections << level;
         for (unsigned i = 0; i <= nSections; i++)
         {
             float t = static_cast<float>(i) / static_cast<float>(nSections);
@@ -763,68 +863,49 @@ static void renderRingSystem(GLuint *vboId,
             float s = std::sin(theta);
             float c = std::cos(theta);
 
-            // inner point
-            vertex.pos[0] = c * innerRadius;
+            RingVertex vertex;
+            vertex.pos[0] = c;
             vertex.pos[1] = 0.0f;
-            vertex.pos[2] = s * innerRadius;
+            vertex.pos[2] = s;
+            // inner point
             vertex.tex[0] = 0;
             vertex.tex[1] = (i & 1) ^ 1; // even?(i) ? 0 : 1;
             ringCoord.push_back(vertex);
 
             // outer point
-            vertex.pos[0] = c * outerRadius;
-            // vertex.pos[1] = 0.0f;
-            vertex.pos[2] = s * outerRadius;
             vertex.tex[0] = 1;
-            // vertex.tex[1] = (i & 1) ^ 1;
             ringCoord.push_back(vertex);
         }
-
-        glGenBuffers(1, vboId);
-        glBindBuffer(GL_ARRAY_BUFFER, *vboId);
-        glBufferData(GL_ARRAY_BUFFER,
-                     ringCoord.size() * sizeof(struct RingVertex),
-                     ringCoord.data(),
-                     GL_STATIC_DRAW);
-    }
-    else
-    {
-        glBindBuffer(GL_ARRAY_BUFFER, *vboId);
     }
-    glEnableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
-    glVertexAttribPointer(CelestiaGLProgram::TextureCoord0AttributeIndex,
-                          2, GL_SHORT, GL_FALSE,
-                          sizeof(struct RingVertex),
-                          reinterpret_cast<GLvoid*>(offsetof(struct RingVertex, tex)));
 
-    glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
-    glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
-                          3, GL_FLOAT, GL_FALSE,
-                          sizeof(struct RingVertex), 0);
+    vo.allocate(ringCoord.size() * sizeof(RingVertex), ringCoord.data());
+    vo.setVertices(3, GL_FLOAT, false, sizeof(RingVertex), offsetof(RingVertex, pos));
+    vo.setTextureCoords(2, GL_SHORT, false, sizeof(RingVertex), offsetof(RingVertex, tex));
+}
+
+void
+renderRingSystem(Renderer* renderer, unsigned int level)
+{
+    auto &vo = renderer->getVertexObject(VOType::Rings, GL_ARRAY_BUFFER, 0, GL_STATIC_DRAW);
+    vo.bind();
+    if (!vo.initialized())
+        initRingVO(vo);
+
+    GLint first = 0;
+    for (unsigned int i = 0; i < level; i++)
+        first += ringStripLength(i);
 
     // Celestia uses glCullFace(GL_BACK) by default so we just skip it here
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, (nSections+1)*2);
+    vo.draw(GL_TRIANGLE_STRIP, ringStripLength(level), first);
     glCullFace(GL_FRONT);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, (nSections+1)*2);
+    vo.draw(GL_TRIANGLE_STRIP, ringStripLength(level), first);
     glCullFace(GL_BACK);
 
-    glDisableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
-    glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    vo.unbind();
 }
 
+} // end unnamed namespace
 
-class GLRingRenderData : public RingRenderData
-{
- public:
-    ~GLRingRenderData() override
-    {
-        glDeleteBuffers(vboId.size(), vboId.data());
-        vboId.fill(0);
-    }
-
-    std::array<GLuint, 4> vboId {{ 0, 0, 0, 0 }};
-};
 
 // Render a planetary ring system
 void renderRings_GLSL(RingSystem& rings,
@@ -868,6 +949,8 @@ void renderRings_GLSL(RingSystem& rings,
 
     prog->use();
     prog->setMVPMatrices(*m.projection, *m.modelview);
+    prog->ringInnerRadius = inner;
+    prog->ringOuterRadius = outer;
 
     prog->eyePosition = ls.eyePos_obj;
     prog->ambientColor = ri.ambientColor.toVector3();
@@ -937,13 +1020,9 @@ void renderRings_GLSL(RingSystem& rings,
     if (ringsTex != nullptr)
         ringsTex->bind();
 
-    if (rings.renderData == nullptr)
-        rings.renderData = std::make_shared<GLRingRenderData>();
-    auto data = reinterpret_cast<GLRingRenderData*>(rings.renderData.get());
-
-    unsigned nSections = 180;
-    std::size_t i = 0;
-    for (i = 0; i < data->vboId.size() - 1; i++)
+    unsigned int nSections = RingMinSections;
+    unsigned int level = 0;
+    for (level = 0; level < RingLODLevels - 1; level++)
     {
         float s = segmentSizeInPixels * tan(celestia::numbers::pi / nSections);
         if (s < 30.0f) // TODO: make configurable
@@ -958,5 +1037,5 @@ void renderRings_GLSL(RingSystem& rings,
     ps.depthMask = inside;
     renderer->setPipelineState(ps);
 
-    renderRingSystem(&data->vboId[i], inner, outer, nSections);
+    renderRingSystem(renderer, level);
 }
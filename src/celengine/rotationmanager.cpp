@@ -10,6 +10,7 @@
 #include "rotationmanager.h"
 #include <config.h>
 #include <celephem/samporient.h>
+#include <celutil/dircache.h>
 #include <celutil/logger.h>
 #include <iostream>
 #include <fstream>
@@ -33,8 +34,7 @@ fs::path RotationModelInfo::resolve(const fs::path& baseDir)
     if (!path.empty())
     {
         fs::path filename = path / "data" / source;
-        ifstream in(filename);
-        if (in.good())
+        if (celestia::util::GetDirectoryCache().exists(filename))
             return filename;
     }
 
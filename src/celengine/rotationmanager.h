@@ -28,15 +28,16 @@ class RotationModelInfo : public ResourceInfo<RotationModel>
 
     fs::path resolve(const fs::path&) override;
     RotationModel* load(const fs::path&) override;
+    std::size_t hash() const
+    {
+        return ResourceHashCombine(std::hash<std::string>()(source), fs::hash_value(path));
+    }
 };
 
-inline bool operator<(const RotationModelInfo& ti0,
-                      const RotationModelInfo& ti1)
+inline bool operator==(const RotationModelInfo& ti0,
+                       const RotationModelInfo& ti1)
 {
-    if (ti0.source == ti1.source)
-        return ti0.path < ti1.path;
-    else
-        return ti0.source < ti1.source;
+    return ti0.source == ti1.source && ti0.path == ti1.path;
 }
 
 typedef ResourceManager<RotationModelInfo> RotationModelManager;
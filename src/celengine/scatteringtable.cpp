@@ -0,0 +1,175 @@
+// scatteringtable.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Precomputed atmospheric scattering tables.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <celutil/binaryread.h>
+#include <celutil/logger.h>
+#include "scatteringtable.h"
+#include "glstate.h"
+
+using celestia::util::GetLogger;
+
+namespace
+{
+constexpr const char ScatteringTableHeader[] = "atmscatr";
+constexpr std::uint32_t ScatteringTableVersion = 1;
+// Largest number of samples along any dimension of the tables
+constexpr std::uint32_t MaxSamples = 1024;
+
+bool readFloats(std::istream& in, std::vector<float>& values, std::size_t count)
+{
+    values.resize(count);
+    for (float& value : values)
+    {
+        if (!celestia::util::readLE(in, value))
+            return false;
+    }
+    return true;
+}
+
+void setTextureParameters(GLenum target)
+{
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    if (target == GL_TEXTURE_3D)
+        glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+}
+}
+
+ScatteringTable::ScatteringTable(const fs::path& _filename) :
+    filename(_filename)
+{
+}
+
+ScatteringTable::~ScatteringTable()
+{
+    if (transmittanceTex != 0)
+        celestia::gl::deleteTextures(1, &transmittanceTex);
+    if (inscatterTex != 0)
+        celestia::gl::deleteTextures(1, &inscatterTex);
+}
+
+bool ScatteringTable::isSupported()
+{
+    return celestia::gl::ARB_texture_float;
+}
+
+Eigen::Vector3f ScatteringTable::getSize() const
+{
+    return Eigen::Vector3f(static_cast<float>(sunAngleSamples),
+                           static_cast<float>(viewAngleSamples),
+                           static_cast<float>(heightSamples));
+}
+
+bool ScatteringTable::bind()
+{
+    if (!loaded)
+    {
+        if (loadFailed)
+            return false;
+        if (!load())
+        {
+            GetLogger()->error("Error loading scattering table {}\n", filename);
+            loadFailed = true;
+            return false;
+        }
+        loaded = true;
+    }
+
+    celestia::gl::activeTexture(GL_TEXTURE0);
+    celestia::gl::bindTexture(GL_TEXTURE_2D, transmittanceTex);
+    celestia::gl::activeTexture(GL_TEXTURE1);
+    celestia::gl::bindTexture(GL_TEXTURE_3D, inscatterTex);
+    celestia::gl::activeTexture(GL_TEXTURE0);
+
+    return true;
+}
+
+// The file starts with a header and the parameters of the atmosphere,
+// followed by the dimensions and the samples of both tables. All values
+// are little-endian 32-bit integers and floats.
+bool ScatteringTable::load()
+{
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in.good())
+        return false;
+
+    char header[sizeof(ScatteringTableHeader) - 1];
+    if (!in.read(header, sizeof(header)).good() ||
+        std::memcmp(header, ScatteringTableHeader, sizeof(header)) != 0)
+    {
+        return false;
+    }
+
+    std::uint32_t version = 0;
+    if (!celestia::util::readLE(in, version) || version != ScatteringTableVersion)
+        return false;
+
+    // Rayleigh scale height and coefficients, Mie scale height, coefficient
+    // and asymmetry, absorption coefficients and planet radius
+    std::vector<float> parameters;
+    if (!readFloats(in, parameters, 11))
+        return false;
+    float rayleighScaleHeight = parameters[0];
+    float mieScaleHeight = parameters[4];
+    planetRadius = parameters[10];
+    // The scattertable tool ends the atmosphere at eight scale heights
+    shellRadius = planetRadius + std::max(rayleighScaleHeight, mieScaleHeight) * 8.0f;
+    if (planetRadius <= 0.0f || shellRadius <= planetRadius)
+        return false;
+
+    std::uint32_t dims[5];
+    for (std::uint32_t& dim : dims)
+    {
+        if (!celestia::util::readLE(in, dim) || dim < 2 || dim > MaxSamples)
+            return false;
+    }
+    // The transmittance table has the same view angles and heights as the
+    // inscatter table
+    if (dims[0] != dims[3] || dims[1] != dims[4])
+        return false;
+    sunAngleSamples = dims[2];
+    viewAngleSamples = dims[3];
+    heightSamples = dims[4];
+
+    std::vector<float> transmittance;
+    std::vector<float> inscatter;
+    if (!readFloats(in, transmittance, std::size_t(viewAngleSamples) * heightSamples * 3) ||
+        !readFloats(in, inscatter, std::size_t(sunAngleSamples) * viewAngleSamples * heightSamples * 4))
+    {
+        return false;
+    }
+
+    glGenTextures(1, &transmittanceTex);
+    celestia::gl::bindTexture(GL_TEXTURE_2D, transmittanceTex);
+    setTextureParameters(GL_TEXTURE_2D);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F,
+                 viewAngleSamples, heightSamples, 0,
+                 GL_RGB, GL_FLOAT, transmittance.data());
+
+    glGenTextures(1, &inscatterTex);
+    celestia::gl::bindTexture(GL_TEXTURE_3D, inscatterTex);
+    setTextureParameters(GL_TEXTURE_3D);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA16F,
+                 sunAngleSamples, viewAngleSamples, heightSamples, 0,
+                 GL_RGBA, GL_FLOAT, inscatter.data());
+
+    celestia::gl::bindTexture(GL_TEXTURE_2D, 0);
+    celestia::gl::bindTexture(GL_TEXTURE_3D, 0);
+
+    return true;
+}
@@ -0,0 +1,65 @@
+// scatteringtable.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Precomputed atmospheric scattering tables.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <Eigen/Core>
+#include <celcompat/filesystem.h>
+#include "glsupport.h"
+
+// The transmittance and single scattering tables of an atmosphere, as
+// written by the scattertable tool in src/tools/atmosphere. Transmittance
+// is a 2D table of the view angle and height, and inscattered light a 3D
+// table of the sun angle, view angle and height; both are used as textures
+// by the sky shaders.
+//
+// The tables are loaded from the file the first time they are drawn.
+class ScatteringTable
+{
+ public:
+    explicit ScatteringTable(const fs::path& filename);
+    ~ScatteringTable();
+    ScatteringTable(const ScatteringTable&) = delete;
+    ScatteringTable& operator=(const ScatteringTable&) = delete;
+
+    // Return true if the OpenGL implementation supports the float and 3D
+    // textures needed for scattering tables
+    static bool isSupported();
+
+    // Bind the transmittance table to texture unit 0 and the inscatter
+    // table to texture unit 1, loading them first if needed. Returns false
+    // if the tables couldn't be loaded.
+    bool bind();
+
+    // Radius of the planet and of the top of the atmosphere the tables
+    // were computed for, in kilometers
+    float getPlanetRadius() const { return planetRadius; }
+    float getShellRadius() const { return shellRadius; }
+
+    // Number of sun angle, view angle and height samples
+    Eigen::Vector3f getSize() const;
+
+ private:
+    bool load();
+
+    fs::path filename;
+    bool loaded{ false };
+    bool loadFailed{ false };
+
+    float planetRadius{ 1.0f };
+    float shellRadius{ 1.0f };
+    unsigned int sunAngleSamples{ 0 };
+    unsigned int viewAngleSamples{ 0 };
+    unsigned int heightSamples{ 0 };
+
+    GLuint transmittanceTex{ 0 };
+    GLuint inscatterTex{ 0 };
+};
@@ -8,8 +8,12 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -19,11 +23,14 @@
 #include <Eigen/Geometry>
 #include <celcompat/filesystem.h>
 #include <celmath/geomutil.h>
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
 #include <celutil/logger.h>
 #include "glsupport.h"
 #include "vecgl.h"
 #include "shadermanager.h"
 #include "shadowmap.h"
+#include "uniformbuffer.h"
 
 using namespace celestia;
 using namespace Eigen;
@@ -77,6 +84,23 @@ uniform mat4 MVPMatrix;
 invariant gl_Position;
 )glsl";
 
+// Shaders drawing all views at once select the matrices of the view from
+// arrays, so that the rest of the code is the same as for a single view.
+// GLSL 1.30 still has the built-in variables and qualifiers of 1.20.
+static const char* MultiviewVersionHeader = "#version 130\n#extension GL_OVR_multiview : require\n";
+static const char* MultiviewVertexHeader = R"glsl(
+layout(num_views = 2) in;
+uniform mat4 ModelViewMatrices[2];
+uniform mat4 ProjectionMatrices[2];
+uniform mat4 MVPMatrices[2];
+#define ModelViewMatrix ModelViewMatrices[gl_ViewID_OVR]
+#define ProjectionMatrix ProjectionMatrices[gl_ViewID_OVR]
+#define MVPMatrix MVPMatrices[gl_ViewID_OVR]
+
+invariant gl_Position;
+)glsl";
+static_assert(MaxShaderViews == 2, "MultiviewVertexHeader declares two views");
+
 static const char *VPFunction =
     "#ifdef FISHEYE\n"
     "vec4 calc_vp(vec4 in_Position)\n{\n"
@@ -133,6 +157,60 @@ attribute vec4 in_TexCoord3;
 attribute vec4 in_Color;
 )glsl";
 
+// Instanced shaders transform the position and normal of each vertex by
+// the model transform of the instance, a uniform scale followed by a
+// rotation and a translation, before the rest of the shader uses them.
+static const char* InstancedAttribs = R"glsl(
+attribute vec4 in_ObjectPosition;
+attribute vec4 in_InstanceRow0;
+attribute vec4 in_InstanceRow1;
+attribute vec4 in_InstanceRow2;
+attribute vec4 in_TexCoord0;
+attribute vec4 in_TexCoord1;
+attribute vec4 in_TexCoord2;
+attribute vec4 in_TexCoord3;
+attribute vec4 in_Color;
+vec4 in_Position;
+vec3 in_Normal;
+)glsl";
+
+static const char* InstanceTransform = R"glsl(
+in_Position = vec4(dot(in_InstanceRow0, in_ObjectPosition),
+                   dot(in_InstanceRow1, in_ObjectPosition),
+                   dot(in_InstanceRow2, in_ObjectPosition),
+                   1.0);
+in_Normal = vec3(dot(in_InstanceRow0.xyz, in_ObjectNormal),
+                 dot(in_InstanceRow1.xyz, in_ObjectNormal),
+                 dot(in_InstanceRow2.xyz, in_ObjectNormal)) / length(in_InstanceRow0.xyz);
+)glsl";
+
+// Models may have their normals and tangents packed into two components
+// by an octahedral mapping; the attributes with the names used by the rest
+// of the shader are then globals unpacked at the start of main().
+static const char* PackedNormalAttribs = R"glsl(
+attribute vec4 in_Position;
+attribute vec2 in_PackedNormal;
+attribute vec4 in_TexCoord0;
+attribute vec4 in_TexCoord1;
+attribute vec4 in_TexCoord2;
+attribute vec4 in_TexCoord3;
+attribute vec4 in_Color;
+vec3 in_Normal;
+)glsl";
+
+static const char* UnpackOctahedralFunction = R"glsl(
+vec3 unpackOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+    {
+        vec2 s = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+        n.xy = (1.0 - abs(n.yx)) * s;
+    }
+    return normalize(n);
+}
+)glsl";
+
 bool
 ShaderProperties::usesShadows() const
 {
@@ -328,7 +406,8 @@ bool operator<(const ShaderProperties& p0, const ShaderProperties& p1)
 }
 
 
-ShaderManager::ShaderManager()
+ShaderManager::ShaderManager() :
+    uniformBuffer(std::make_unique<gl::UniformBuffer>())
 {
 #if defined(_DEBUG) || defined(DEBUG) || 1
     // Only write to shader log file if this is a debug build
@@ -346,39 +425,84 @@ ShaderManager::ShaderManager()
 
 ShaderManager::~ShaderManager()
 {
-    for(const auto& shader : dynamicShaders)
-        delete shader.second;
+    for (int mode = 0; mode < 2; mode++)
+    {
+        for(const auto& shader : pendingShaders[mode])
+            delete shader.second;
 
-    dynamicShaders.clear();
+        pendingShaders[mode].clear();
 
-    for(const auto& shader : staticShaders)
-        delete shader.second;
+        for(const auto& shader : dynamicShaders[mode])
+            delete shader.second;
 
-    staticShaders.clear();
+        dynamicShaders[mode].clear();
+
+        for(const auto& shader : staticShaders[mode])
+            delete shader.second;
+
+        staticShaders[mode].clear();
+    }
 }
 
 CelestiaGLProgram*
 ShaderManager::getShader(const ShaderProperties& props)
 {
+    auto& dynamicShaders = this->dynamicShaders[views.multiview ? 1 : 0];
+    auto& pendingShaders = this->pendingShaders[views.multiview ? 1 : 0];
     auto iter = dynamicShaders.find(props);
     if (iter != dynamicShaders.end())
     {
         // Shader already exists
         return iter->second;
     }
-    else
+
+    auto pending = pendingShaders.find(props);
+    if (pending != pendingShaders.end())
     {
-        // Create a new shader and add it to the table of created shaders
-        CelestiaGLProgram* prog = buildProgram(props);
-        dynamicShaders[props] = prog;
+        // The fallback used when the build started is still there
+        if (!pending->second->isLinkDone())
+            return getFallbackShader(props);
 
+        GLProgram* program = pending->second;
+        pendingShaders.erase(pending);
+        CelestiaGLProgram* prog = finishProgram(props, program);
+        dynamicShaders[props] = prog;
         return prog;
     }
+
+    // Create a new shader and add it to the table of created shaders
+    CelestiaGLProgram* prog = nullptr;
+    if (!programCacheDir.empty())
+        prog = loadCachedProgram(props);
+
+    if (prog == nullptr && asyncCompilation)
+    {
+        CelestiaGLProgram* fallback = getFallbackShader(props);
+        if (fallback != nullptr)
+        {
+            deferCompileStatus = true;
+            GLProgram* program = createProgram(props);
+            deferCompileStatus = false;
+            if (program != nullptr)
+            {
+                program->startLink();
+                pendingShaders[props] = program;
+                return fallback;
+            }
+        }
+    }
+
+    if (prog == nullptr)
+        prog = buildProgram(props);
+    dynamicShaders[props] = prog;
+
+    return prog;
 }
 
 CelestiaGLProgram*
 ShaderManager::getShader(const string& name, const string& vs, const string& fs)
 {
+    auto& staticShaders = this->staticShaders[views.multiview ? 1 : 0];
     auto iter = staticShaders.find(name);
     if (iter != staticShaders.end())
     {
@@ -396,6 +520,7 @@ ShaderManager::getShader(const string& name, const string& vs, const string& fs)
 CelestiaGLProgram*
 ShaderManager::getShader(const string& name)
 {
+    auto& staticShaders = this->staticShaders[views.multiview ? 1 : 0];
     auto iter = staticShaders.find(name);
     if (iter != staticShaders.end())
     {
@@ -1058,6 +1183,108 @@ DeclareLights(const ShaderProperties& props)
     return stream.str();
 }
 
+// With uniform blocks, the light and shadow parameters of the programs
+// made of buildVertexShader() and buildFragmentShader() are in the two
+// blocks below instead of separate uniforms, so that setting them for an
+// object takes one upload and one binding per block. The blocks are
+// declared with the std140 layout and room for all lights and shadows,
+// so that they are the same in all programs; the structures mirror them.
+constexpr GLuint LightBlockBinding = 0;
+constexpr GLuint ShadowBlockBinding = 1;
+
+static const char* UniformBlockExtension = "#extension GL_ARB_uniform_buffer_object : require\n";
+
+struct LightBlock
+{
+    struct Light
+    {
+        Vector3f direction;
+        float pad0;
+        Vector3f diffuse;
+        float pad1;
+        Vector3f specular;
+        float pad2;
+        Vector3f halfVector;
+        float brightness;
+    };
+
+    struct FragmentLight
+    {
+        Vector3f color;
+        float brightness;
+        Vector3f specColor;
+        float pad;
+    };
+
+    std::array<Light, MaxShaderLights> lights;
+    std::array<FragmentLight, MaxShaderLights> fragLights;
+};
+
+struct ShadowBlock
+{
+    struct Shadow
+    {
+        Vector4f texGenS;
+        Vector4f texGenT;
+        float falloff;
+        float maxDepth;
+        float pad[2];
+    };
+
+    std::array<std::array<Shadow, MaxShaderEclipseShadows>, MaxShaderLights> shadows;
+};
+
+static_assert(sizeof(LightBlock) == MaxShaderLights * (64 + 32), "LightBlock isn't in the std140 layout");
+static_assert(sizeof(ShadowBlock) == MaxShaderLights * MaxShaderEclipseShadows * 48, "ShadowBlock isn't in the std140 layout");
+
+static string
+DeclareLightBlock(const ShaderProperties& props)
+{
+    if (props.nLights == 0)
+        return {};
+
+    ostringstream stream;
+    stream << "struct Light\n{\n";
+    stream << "   vec3 direction;\n";
+    stream << "   vec3 diffuse;\n";
+    stream << "   vec3 specular;\n";
+    stream << "   vec3 halfVector;\n";
+    stream << "   float brightness;\n";
+    stream << "};\n";
+
+    stream << "layout(std140) uniform LightParameters\n{\n";
+    stream << "   Light lights[" << MaxShaderLights << "];\n";
+    for (unsigned int i = 0; i < MaxShaderLights; i++)
+    {
+        stream << "   vec3 " << FragLightProperty(i, "color") << ";\n";
+        stream << "   float " << FragLightProperty(i, "brightness") << ";\n";
+        stream << "   vec3 " << FragLightProperty(i, "specColor") << ";\n";
+    }
+    stream << "};\n";
+
+    return stream.str();
+}
+
+static string
+DeclareShadowBlock()
+{
+    ostringstream stream;
+    stream << "layout(std140) uniform ShadowParameters\n{\n";
+    for (unsigned int i = 0; i < MaxShaderLights; i++)
+    {
+        for (unsigned int j = 0; j < MaxShaderEclipseShadows; j++)
+        {
+            stream << "   vec4 " << IndexedParameter("shadowTexGenS", i, j) << ";\n";
+            stream << "   vec4 " << IndexedParameter("shadowTexGenT", i, j) << ";\n";
+            stream << "   float " << IndexedParameter("shadowFalloff", i, j) << ";\n";
+            stream << "   float " << IndexedParameter("shadowMaxDepth", i, j) << ";\n";
+        }
+    }
+    stream << "};\n";
+
+    return stream.str();
+}
+
 
 static string
 SeparateDiffuse(unsigned int i)
@@ -1752,12 +1979,26 @@ float calculateShadow()
 GLVertexShader*
 ShaderManager::buildVertexShader(const ShaderProperties& props)
 {
-    string source(VersionHeader);
+    bool uniformBlocks = usesUniformBlocks();
+
+    string source(versionHeader());
+    if (uniformBlocks)
+        source += UniformBlockExtension;
     source += CommonHeader;
-    source += VertexHeader;
-    source += CommonAttribs;
+    source += vertexHeader();
+    bool packedNormals = (props.texUsage & ShaderProperties::PackedNormals) != 0;
+    if (props.texUsage & ShaderProperties::Instanced)
+    {
+        source += InstancedAttribs;
+        source += packedNormals ? "attribute vec2 in_PackedNormal;\nvec3 in_ObjectNormal;\n"
+                                : "attribute vec3 in_ObjectNormal;\n";
+    }
+    else
+    {
+        source += packedNormals ? PackedNormalAttribs : CommonAttribs;
+    }
 
-    source += DeclareLights(props);
+    source += uniformBlocks ? DeclareLightBlock(props) : DeclareLights(props);
     if (props.lightModel == ShaderProperties::SpecularModel)
         source += "uniform float shininess;\n";
 
@@ -1776,7 +2017,8 @@ ShaderManager::buildVertexShader(const ShaderProperties& props)
 
     if (props.usesTangentSpaceLighting())
     {
-        source += "attribute vec3 in_Tangent;\n";
+        source += packedNormals ? "attribute vec2 in_PackedTangent;\nvec3 in_Tangent;\n"
+                                : "attribute vec3 in_Tangent;\n";
         for (unsigned int i = 0; i < props.nLights; i++)
         {
             source += "varying vec3 " + LightDir_tan(i) + ";\n";
@@ -1875,9 +2117,22 @@ ShaderManager::buildVertexShader(const ShaderProperties& props)
         source += "#define FISHEYE\n";
 
     source += VPFunction;
+    if (packedNormals)
+        source += UnpackOctahedralFunction;
 
     // Begin main() function
     source += "\nvoid main(void)\n{\n";
+    if (packedNormals)
+    {
+        if (props.texUsage & ShaderProperties::Instanced)
+            source += "in_ObjectNormal = unpackOctahedral(in_PackedNormal);\n";
+        else
+            source += "in_Normal = unpackOctahedral(in_PackedNormal);\n";
+        if (props.usesTangentSpaceLighting())
+            source += "in_Tangent = unpackOctahedral(in_PackedTangent);\n";
+    }
+    if (props.texUsage & ShaderProperties::Instanced)
+        source += InstanceTransform;
     if (props.isViewDependent() || props.hasScattering())
     {
         source += "vec3 eyeDir = normalize(eyePosition - in_Position.xyz);\n";
@@ -2099,7 +2354,7 @@ ShaderManager::buildVertexShader(const ShaderProperties& props)
     DumpVSSource(source);
 
     GLVertexShader* vs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs);
+    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs, !deferCompileStatus);
     return status == ShaderStatus_OK ? vs : nullptr;
 }
 
@@ -2107,7 +2362,11 @@ ShaderManager::buildVertexShader(const ShaderProperties& props)
 GLFragmentShader*
 ShaderManager::buildFragmentShader(const ShaderProperties& props)
 {
-    string source(VersionHeader);
+    bool uniformBlocks = usesUniformBlocks();
+
+    string source(versionHeader());
+    if (uniformBlocks)
+        source += UniformBlockExtension;
     // Without GL_ARB_shader_texture_lod enabled one can use texture2DLod
     // in vertext shaders only
     if (gl::ARB_shader_texture_lod)
@@ -2158,6 +2417,8 @@ ShaderManager::buildFragmentShader(const ShaderProperties& props)
         for (unsigned int i = 0; i < props.nLights; i++)
         {
             source += "varying vec3 " + LightDir_tan(i) + ";\n";
+            if (uniformBlocks)
+                continue;
             source += "uniform vec3 " + FragLightProperty(i, "color") + ";\n";
             if (props.hasSpecular())
             {
@@ -2178,7 +2439,7 @@ ShaderManager::buildFragmentShader(const ShaderProperties& props)
         source += "vec4 spec = vec4(0.0);\n";
         source += "uniform float shininess;\n";
 
-        for (unsigned int i = 0; i < props.nLights; i++)
+        for (unsigned int i = 0; i < props.nLights && !uniformBlocks; i++)
         {
             source += "uniform vec3 " + FragLightProperty(i, "color") + ";\n";
             source += "uniform vec3 " + FragLightProperty(i, "specColor") + ";\n";
@@ -2194,7 +2455,7 @@ ShaderManager::buildFragmentShader(const ShaderProperties& props)
             source += "varying vec4 specFactors;\n";
             source += "vec4 spec = vec4(0.0);\n";
         }
-        for (unsigned int i = 0; i < props.nLights; i++)
+        for (unsigned int i = 0; i < props.nLights && !uniformBlocks; i++)
         {
             source += "uniform vec3 " + FragLightProperty(i, "color") + ";\n";
             if (props.lightModel == ShaderProperties::SpecularModel)
@@ -2229,7 +2490,9 @@ ShaderManager::buildFragmentShader(const ShaderProperties& props)
     if (props.shadowCounts != 0)
     {
         source += "varying vec3 position_obj;\n";
-        for (unsigned int i = 0; i < props.nLights; i++)
+        if (uniformBlocks)
+            source += DeclareShadowBlock();
+        for (unsigned int i = 0; i < props.nLights && !uniformBlocks; i++)
         {
             for (unsigned int j = 0; j < props.getEclipseShadowCountForLight(i); j++)
             {
@@ -2274,7 +2537,7 @@ ShaderManager::buildFragmentShader(const ShaderProperties& props)
         source += CalculateShadow();
     }
 
-    source += DeclareLights(props);
+    source += uniformBlocks ? DeclareLightBlock(props) : DeclareLights(props);
 
     source += "\nvoid main(void)\n{\n";
     source += "vec4 color;\n";
@@ -2544,7 +2807,7 @@ ShaderManager::buildFragmentShader(const ShaderProperties& props)
     DumpFSSource(source);
 
     GLFragmentShader* fs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs);
+    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs, !deferCompileStatus);
     return status == ShaderStatus_OK ? fs : nullptr;
 }
 
@@ -2553,9 +2816,9 @@ ShaderManager::buildFragmentShader(const ShaderProperties& props)
 GLVertexShader*
 ShaderManager::buildRingsVertexShader(const ShaderProperties& props)
 {
-    string source(VersionHeader);
+    string source(versionHeader());
     source += CommonHeader;
-    source += VertexHeader;
+    source += vertexHeader();
     source += CommonAttribs;
 
     source += DeclareLights(props);
@@ -2602,7 +2865,7 @@ ShaderManager::buildRingsVertexShader(const ShaderProperties& props)
     DumpVSSource(source);
 
     GLVertexShader* vs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs);
+    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs, !deferCompileStatus);
     return status == ShaderStatus_OK ? vs : nullptr;
 }
 
@@ -2610,7 +2873,7 @@ ShaderManager::buildRingsVertexShader(const ShaderProperties& props)
 GLFragmentShader*
 ShaderManager::buildRingsFragmentShader(const ShaderProperties& props)
 {
-    string source(VersionHeader);
+    string source(versionHeader());
     source += CommonHeader;
 
     source += "uniform vec3 ambientColor;\n";
@@ -2688,7 +2951,7 @@ ShaderManager::buildRingsFragmentShader(const ShaderProperties& props)
     DumpFSSource(source);
 
     GLFragmentShader* fs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs);
+    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs, !deferCompileStatus);
     return status == ShaderStatus_OK ? fs : nullptr;
 }
 #endif
@@ -2697,9 +2960,9 @@ ShaderManager::buildRingsFragmentShader(const ShaderProperties& props)
 GLVertexShader*
 ShaderManager::buildRingsVertexShader(const ShaderProperties& props)
 {
-    string source(VersionHeader);
+    string source(versionHeader());
     source += CommonHeader;
-    source += VertexHeader;
+    source += vertexHeader();
     source += CommonAttribs;
 
     source += DeclareLights(props);
@@ -2719,30 +2982,37 @@ ShaderManager::buildRingsVertexShader(const ShaderProperties& props)
     if (props.fishEyeOverride != ShaderProperties::FisheyeOverrideModeDisabled && fisheyeEnabled)
         source += "#define FISHEYE\n";
 
+    // The vertices are on the unit circle, and the s texture coordinate
+    // selects the radius, inner or outer
+    source += DeclareUniform("ringInnerRadius", Shader_Float);
+    source += DeclareUniform("ringOuterRadius", Shader_Float);
+
     source += VPFunction;
 
     source += "\nvoid main(void)\n{\n";
 
+    source += "vec4 position = vec4(in_Position.xyz * mix(ringInnerRadius, ringOuterRadius, in_TexCoord0.s), 1.0);\n";
+
     if (props.texUsage & ShaderProperties::DiffuseTexture)
         source += "diffTexCoord = " + TexCoord2D(0) + ";\n";
 
-    source += "position_obj = in_Position.xyz;\n";
+    source += "position_obj = position.xyz;\n";
     if (props.hasEclipseShadows())
     {
         for (unsigned int i = 0; i < props.nLights; i++)
         {
-            source += ShadowDepth(i) + " = dot(in_Position.xyz, " +
+            source += ShadowDepth(i) + " = dot(position.xyz, " +
                        LightProperty(i, "direction") + ");\n";
         }
     }
 
-    source += VertexPosition(props);
+    source += "set_vp(position);\n";
     source += "}\n";
 
     DumpVSSource(source);
 
     GLVertexShader* vs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs);
+    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs, !deferCompileStatus);
     return status == ShaderStatus_OK ? vs : nullptr;
 }
 
@@ -2750,7 +3020,7 @@ ShaderManager::buildRingsVertexShader(const ShaderProperties& props)
 GLFragmentShader*
 ShaderManager::buildRingsFragmentShader(const ShaderProperties& props)
 {
-    string source(VersionHeader);
+    string source(versionHeader());
     source += CommonHeader;
 
     source += "uniform vec3 ambientColor;\n";
@@ -2853,7 +3123,7 @@ ShaderManager::buildRingsFragmentShader(const ShaderProperties& props)
     DumpFSSource(source);
 
     GLFragmentShader* fs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs);
+    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs, !deferCompileStatus);
     return status == ShaderStatus_OK ? fs : nullptr;
 }
 
@@ -2861,9 +3131,9 @@ ShaderManager::buildRingsFragmentShader(const ShaderProperties& props)
 GLVertexShader*
 ShaderManager::buildAtmosphereVertexShader(const ShaderProperties& props)
 {
-    string source(VersionHeader);
+    string source(versionHeader());
     source += CommonHeader;
-    source += VertexHeader;
+    source += vertexHeader();
     source += CommonAttribs;
 
     source += DeclareLights(props);
@@ -2900,7 +3170,7 @@ ShaderManager::buildAtmosphereVertexShader(const ShaderProperties& props)
     DumpVSSource(source);
 
     GLVertexShader* vs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs);
+    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs, !deferCompileStatus);
     return status == ShaderStatus_OK ? vs : nullptr;
 }
 
@@ -2908,7 +3178,7 @@ ShaderManager::buildAtmosphereVertexShader(const ShaderProperties& props)
 GLFragmentShader*
 ShaderManager::buildAtmosphereFragmentShader(const ShaderProperties& props)
 {
-    string source(VersionHeader);
+    string source(versionHeader());
     source += CommonHeader;
 
     source += "varying vec3 scatterEx;\n";
@@ -2957,7 +3227,130 @@ ShaderManager::buildAtmosphereFragmentShader(const ShaderProperties& props)
     DumpFSSource(source);
 
     GLFragmentShader* fs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs);
+    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs, !deferCompileStatus);
+    return status == ShaderStatus_OK ? fs : nullptr;
+}
+
+
+// The sky shaders for precomputed scattering tables only pass the
+// position on the atmosphere shell to the fragment shader, which looks up
+// the light scattered along the view ray from where it enters the
+// atmosphere.
+GLVertexShader*
+ShaderManager::buildScatteringTableVertexShader(const ShaderProperties& props)
+{
+    string source(versionHeader());
+    source += CommonHeader;
+    source += vertexHeader();
+    source += CommonAttribs;
+
+    source += "varying vec3 position_obj;\n";
+
+    if (props.texUsage & ShaderProperties::LineAsTriangles)
+        source += LineDeclaration();
+
+    if (props.fishEyeOverride != ShaderProperties::FisheyeOverrideModeDisabled && fisheyeEnabled)
+        source += "#define FISHEYE\n";
+
+    source += VPFunction;
+
+    source += "\nvoid main(void)\n{\n";
+    source += "    position_obj = in_Position.xyz;\n";
+    source += VertexPosition(props);
+    source += "}\n";
+
+    DumpVSSource(source);
+
+    GLVertexShader* vs = nullptr;
+    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs, !deferCompileStatus);
+    return status == ShaderStatus_OK ? vs : nullptr;
+}
+
+
+// The texture coordinates invert the parameterizations of the height, view
+// angle and sun angle used by the scattertable tool, with the table samples
+// at the texel centers. Distances are in units of the atmosphere radius.
+static const char* ScatteringTableCoords = R"glsl(
+float heightCoord(float r)
+{
+    float v = sqrt(clamp((r - atmosphereRadius.z) / (1.0 - atmosphereRadius.z), 0.0, 1.0));
+    return v + 0.5 / scatteringTableSize.z;
+}
+
+float viewAngleCoord(float mu)
+{
+    float s = mu < -0.15 ? 1.0 : -1.0;
+    float x = (-0.165 - 1.1 * mu) / (s * (mu + 0.15) - 0.1);
+    float u = clamp(x * 0.5 + 0.5, 0.0, 1.0);
+    return (u * (scatteringTableSize.y - 1.0) + 0.5) / scatteringTableSize.y;
+}
+
+float sunAngleCoord(float muS)
+{
+    float w = clamp((1.0 - exp(-2.0 * muS - 0.6)) / (1.0 - exp(-2.6)), 0.0, 1.0);
+    return (w * (scatteringTableSize.x - 1.0) + 0.5) / scatteringTableSize.x;
+}
+)glsl";
+
+
+GLFragmentShader*
+ShaderManager::buildScatteringTableFragmentShader(const ShaderProperties& props)
+{
+    string source(versionHeader());
+#ifdef GL_ES
+    source += "#extension GL_OES_texture_3D : enable\n";
+    source += CommonHeader;
+    source += "precision highp sampler3D;\n";
+#else
+    source += CommonHeader;
+#endif
+
+    source += "varying vec3 position_obj;\n";
+    source += "uniform vec3 eyePosition;\n";
+    source += "uniform vec3 atmosphereRadius;\n";
+    source += "uniform vec3 scatteringTableSize;\n";
+    source += "uniform float mieK;\n";
+    source += "uniform sampler2D transmittanceTex;\n";
+    source += "uniform sampler3D inscatterTex;\n";
+#ifdef USE_GLSL_STRUCTS
+    source += DeclareLights(props);
+#else
+    source += "uniform vec3 " + LightProperty(0, "direction") + ";\n";
+#endif
+
+    source += ScatteringTableCoords;
+
+    source += "\nvoid main(void)\n";
+    source += "{\n";
+    source += "    vec3 V = normalize(position_obj - eyePosition);\n";
+
+    // Start at the eye if it's inside the atmosphere, otherwise where the
+    // view ray enters it
+    source += "    float rq = dot(eyePosition, V);\n";
+    source += "    float qq = dot(eyePosition, eyePosition) - 1.0;\n";
+    source += "    float t = max(0.0, -rq - sqrt(max(rq * rq - qq, 0.0)));\n";
+    source += "    vec3 x = eyePosition + t * V;\n";
+    source += "    float r = length(x);\n";
+    source += "    float mu = dot(x, V) / r;\n";
+    source += "    float muS = dot(x, " + LightProperty(0, "direction") + ") / r;\n";
+
+    source += "    float h = heightCoord(r);\n";
+    source += "    vec3 transmittance = texture2D(transmittanceTex, vec2(viewAngleCoord(mu), h)).rgb;\n";
+    source += "    vec4 inscatter = texture3D(inscatterTex, vec3(sunAngleCoord(muS), viewAngleCoord(mu), h));\n";
+
+    // The tables hold the Rayleigh scattering in rgb and the Mie
+    // scattering in alpha; the phase functions are applied here.
+    source += "    float cosTheta = dot(V, " + LightProperty(0, "direction") + ");\n";
+    source += ScatteringPhaseFunctions(props);
+    source += "    vec3 color = phRayleigh * inscatter.rgb + phMie * inscatter.a;\n";
+
+    source += "    gl_FragColor = vec4(color, dot(transmittance, vec3(0.333, 0.333, 0.333)));\n";
+    source += "}\n";
+
+    DumpFSSource(source);
+
+    GLFragmentShader* fs = nullptr;
+    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs, !deferCompileStatus);
     return status == ShaderStatus_OK ? fs : nullptr;
 }
 
@@ -2967,9 +3360,9 @@ ShaderManager::buildAtmosphereFragmentShader(const ShaderProperties& props)
 GLVertexShader*
 ShaderManager::buildEmissiveVertexShader(const ShaderProperties& props)
 {
-    string source(VersionHeader);
+    string source(versionHeader());
     source += CommonHeader;
-    source += VertexHeader;
+    source += vertexHeader();
     source += CommonAttribs;
 
     source += "uniform float opacity;\n";
@@ -3032,7 +3425,7 @@ ShaderManager::buildEmissiveVertexShader(const ShaderProperties& props)
     DumpVSSource(source);
 
     GLVertexShader* vs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs);
+    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source, &vs, !deferCompileStatus);
     return status == ShaderStatus_OK ? vs : nullptr;
 }
 
@@ -3040,7 +3433,7 @@ ShaderManager::buildEmissiveVertexShader(const ShaderProperties& props)
 GLFragmentShader*
 ShaderManager::buildEmissiveFragmentShader(const ShaderProperties& props)
 {
-    string source(VersionHeader);
+    string source(versionHeader());
     source += CommonHeader;
 
     if (props.texUsage & ShaderProperties::DiffuseTexture)
@@ -3088,7 +3481,7 @@ ShaderManager::buildEmissiveFragmentShader(const ShaderProperties& props)
     DumpFSSource(source);
 
     GLFragmentShader* fs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs);
+    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source, &fs, !deferCompileStatus);
     return status == ShaderStatus_OK ? fs : nullptr;
 }
 
@@ -3098,9 +3491,9 @@ GLVertexShader*
 ShaderManager::buildParticleVertexShader(const ShaderProperties& props)
 {
     ostringstream source;
-    source << VersionHeader;
+    source << versionHeader();
     source << CommonHeader;
-    source << VertexHeader;
+    source << vertexHeader();
     source << CommonAttribs;
 
     source << "// PARTICLE SHADER\n";
@@ -3170,7 +3563,7 @@ ShaderManager::buildParticleVertexShader(const ShaderProperties& props)
     DumpVSSource(source);
 
     GLVertexShader* vs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source.str(), &vs);
+    GLShaderStatus status = GLShaderLoader::CreateVertexShader(source.str(), &vs, !deferCompileStatus);
     return status == ShaderStatus_OK ? vs : nullptr;
 }
 
@@ -3180,7 +3573,7 @@ ShaderManager::buildParticleFragmentShader(const ShaderProperties& props)
 {
     ostringstream source;
 
-    source << VersionHeader << CommonHeader;
+    source << versionHeader() << CommonHeader;
 
     if (props.texUsage & ShaderProperties::DiffuseTexture)
     {
@@ -3238,16 +3631,16 @@ ShaderManager::buildParticleFragmentShader(const ShaderProperties& props)
     DumpFSSource(source);
 
     GLFragmentShader* fs = nullptr;
-    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source.str(), &fs);
+    GLShaderStatus status = GLShaderLoader::CreateFragmentShader(source.str(), &fs, !deferCompileStatus);
     return status == ShaderStatus_OK ? fs : nullptr;
 }
 
-CelestiaGLProgram*
-ShaderManager::buildProgram(const ShaderProperties& props)
+// Compile the shaders for props and attach them to a program which is
+// ready to be linked. With deferCompileStatus set, compile errors are only
+// reported when the program is linked.
+GLProgram*
+ShaderManager::createProgram(const ShaderProperties& props)
 {
-    GLProgram* prog = nullptr;
-    GLShaderStatus status;
-
     GLVertexShader* vs = nullptr;
     GLFragmentShader* fs = nullptr;
 
@@ -3256,6 +3649,12 @@ ShaderManager::buildProgram(const ShaderProperties& props)
         vs = buildRingsVertexShader(props);
         fs = buildRingsFragmentShader(props);
     }
+    else if (props.lightModel == ShaderProperties::AtmosphereModel &&
+             (props.texUsage & ShaderProperties::ScatteringTables) != 0)
+    {
+        vs = buildScatteringTableVertexShader(props);
+        fs = buildScatteringTableFragmentShader(props);
+    }
     else if (props.lightModel == ShaderProperties::AtmosphereModel)
     {
         vs = buildAtmosphereVertexShader(props);
@@ -3277,81 +3676,132 @@ ShaderManager::buildProgram(const ShaderProperties& props)
         fs = buildFragmentShader(props);
     }
 
-    if (vs != nullptr && fs != nullptr)
+    GLProgram* prog = nullptr;
+    if (vs != nullptr && fs != nullptr &&
+        GLShaderLoader::CreateProgram(*vs, *fs, &prog) == ShaderStatus_OK)
     {
-        status = GLShaderLoader::CreateProgram(*vs, *fs, &prog);
-        if (status == ShaderStatus_OK)
+        glBindAttribLocation(prog->getID(),
+                             CelestiaGLProgram::VertexCoordAttributeIndex,
+                             "in_Position");
+
+        glBindAttribLocation(prog->getID(),
+                             CelestiaGLProgram::NormalAttributeIndex,
+                             "in_Normal");
+
+        glBindAttribLocation(prog->getID(),
+                             CelestiaGLProgram::TextureCoord0AttributeIndex,
+                             "in_TexCoord0");
+
+        glBindAttribLocation(prog->getID(),
+                             CelestiaGLProgram::TextureCoord1AttributeIndex,
+                             "in_TexCoord1");
+
+        glBindAttribLocation(prog->getID(),
+                             CelestiaGLProgram::TextureCoord2AttributeIndex,
+                             "in_TexCoord2");
+
+        glBindAttribLocation(prog->getID(),
+                             CelestiaGLProgram::TextureCoord3AttributeIndex,
+                             "in_TexCoord3");
+
+        glBindAttribLocation(prog->getID(),
+                             CelestiaGLProgram::ColorAttributeIndex,
+                             "in_Color");
+
+        glBindAttribLocation(prog->getID(),
+                             CelestiaGLProgram::IntensityAttributeIndex,
+                             "in_Intensity");
+
+        if (props.texUsage & ShaderProperties::Instanced)
         {
             glBindAttribLocation(prog->getID(),
                                  CelestiaGLProgram::VertexCoordAttributeIndex,
-                                 "in_Position");
+                                 "in_ObjectPosition");
 
             glBindAttribLocation(prog->getID(),
                                  CelestiaGLProgram::NormalAttributeIndex,
-                                 "in_Normal");
+                                 "in_ObjectNormal");
 
             glBindAttribLocation(prog->getID(),
-                                 CelestiaGLProgram::TextureCoord0AttributeIndex,
-                                 "in_TexCoord0");
+                                 CelestiaGLProgram::InstanceRow0AttributeIndex,
+                                 "in_InstanceRow0");
 
             glBindAttribLocation(prog->getID(),
-                                 CelestiaGLProgram::TextureCoord1AttributeIndex,
-                                 "in_TexCoord1");
+                                 CelestiaGLProgram::InstanceRow1AttributeIndex,
+                                 "in_InstanceRow1");
 
             glBindAttribLocation(prog->getID(),
-                                 CelestiaGLProgram::TextureCoord2AttributeIndex,
-                                 "in_TexCoord2");
+                                 CelestiaGLProgram::InstanceRow2AttributeIndex,
+                                 "in_InstanceRow2");
+        }
 
+        if (props.texUsage & ShaderProperties::LineAsTriangles)
+        {
             glBindAttribLocation(prog->getID(),
-                                 CelestiaGLProgram::TextureCoord3AttributeIndex,
-                                 "in_TexCoord3");
+                                 CelestiaGLProgram::NextVCoordAttributeIndex,
+                                 "in_PositionNext");
 
             glBindAttribLocation(prog->getID(),
-                                 CelestiaGLProgram::ColorAttributeIndex,
-                                 "in_Color");
+                                 CelestiaGLProgram::ScaleFactorAttributeIndex,
+                                 "in_ScaleFactor");
+        }
 
+        if (props.texUsage & ShaderProperties::NormalTexture)
+        {
             glBindAttribLocation(prog->getID(),
-                                 CelestiaGLProgram::IntensityAttributeIndex,
-                                 "in_Intensity");
-
-            if (props.texUsage & ShaderProperties::LineAsTriangles)
-            {
-                glBindAttribLocation(prog->getID(),
-                                     CelestiaGLProgram::NextVCoordAttributeIndex,
-                                     "in_PositionNext");
-
-                glBindAttribLocation(prog->getID(),
-                                     CelestiaGLProgram::ScaleFactorAttributeIndex,
-                                     "in_ScaleFactor");
-            }
+                                 CelestiaGLProgram::TangentAttributeIndex,
+                                 "in_Tangent");
+        }
 
-            if (props.texUsage & ShaderProperties::NormalTexture)
-            {
-                glBindAttribLocation(prog->getID(),
-                                     CelestiaGLProgram::TangentAttributeIndex,
-                                     "in_Tangent");
-            }
+        if (props.texUsage & ShaderProperties::PackedNormals)
+        {
+            glBindAttribLocation(prog->getID(),
+                                 CelestiaGLProgram::NormalAttributeIndex,
+                                 "in_PackedNormal");
 
-            if (props.usePointSize())
-            {
-                glBindAttribLocation(prog->getID(),
-                                     CelestiaGLProgram::PointSizeAttributeIndex,
-                                     "in_PointSize");
-            }
+            glBindAttribLocation(prog->getID(),
+                                 CelestiaGLProgram::TangentAttributeIndex,
+                                 "in_PackedTangent");
+        }
 
-            status = prog->link();
+        if (props.usePointSize())
+        {
+            glBindAttribLocation(prog->getID(),
+                                 CelestiaGLProgram::PointSizeAttributeIndex,
+                                 "in_PointSize");
         }
-    }
-    else
-    {
-        status = ShaderStatus_CompileError;
+
+#ifndef GL_ES
+        if (!programCacheDir.empty())
+            glProgramParameteri(prog->getID(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
     }
 
+    // The program keeps the shaders it's attached to
     delete vs;
     delete fs;
 
+    return prog;
+}
+
+CelestiaGLProgram*
+ShaderManager::buildProgram(const ShaderProperties& props)
+{
+    GLShaderStatus status = ShaderStatus_CompileError;
+
+    GLProgram* prog = createProgram(props);
+    if (prog != nullptr)
+    {
+        status = prog->link();
+        if (status == ShaderStatus_OK && !programCacheDir.empty())
+            saveCachedProgram(props, *prog);
+    }
+
     if (status != ShaderStatus_OK)
     {
+        delete prog;
+        prog = nullptr;
+
         // If the shader creation failed for some reason, substitute the
         // error shader.
         status = GLShaderLoader::CreateProgram(errorVertexShaderSource,
@@ -3371,7 +3821,7 @@ ShaderManager::buildProgram(const ShaderProperties& props)
     if (prog == nullptr)
         return nullptr;
 
-    return new CelestiaGLProgram(*prog, props);
+    return attachViews(new CelestiaGLProgram(*prog, props));
 }
 
 CelestiaGLProgram*
@@ -3379,8 +3829,8 @@ ShaderManager::buildProgram(const std::string& vs, const std::string& fs)
 {
     GLProgram* prog = nullptr;
     GLShaderStatus status;
-    string _vs = fmt::format("{}{}{}{}{}{}\n", VersionHeader, CommonHeader, VertexHeader, fisheyeEnabled ? "#define FISHEYE\n" : "", VPFunction, vs);
-    string _fs = fmt::format("{}{}{}{}\n", VersionHeader, CommonHeader, FragmentHeader, fs);
+    string _vs = fmt::format("{}{}{}{}{}{}\n", versionHeader(), CommonHeader, vertexHeader(), fisheyeEnabled ? "#define FISHEYE\n" : "", VPFunction, vs);
+    string _fs = fmt::format("{}{}{}{}\n", versionHeader(), CommonHeader, FragmentHeader, fs);
 
     DumpVSSource(_vs);
     DumpFSSource(_fs);
@@ -3452,7 +3902,7 @@ ShaderManager::buildProgram(const std::string& vs, const std::string& fs)
     if (prog == nullptr)
         return nullptr;
 
-    return new CelestiaGLProgram(*prog);
+    return attachViews(new CelestiaGLProgram(*prog));
 }
 
 void ShaderManager::setFisheyeEnabled(bool enabled)
@@ -3460,6 +3910,352 @@ void ShaderManager::setFisheyeEnabled(bool enabled)
     fisheyeEnabled = enabled;
 }
 
+void
+ShaderManager::setViews(const ShaderViews& _views)
+{
+    views = _views;
+    views.nEyes = std::min(views.nEyes, MaxShaderViews);
+    views.multiview = views.multiview && isMultiviewSupported();
+}
+
+void
+ShaderManager::setEyeTranslation(bool enabled)
+{
+    views.translation = enabled;
+}
+
+bool
+ShaderManager::isMultiviewSupported()
+{
+    return gl::OVR_multiview;
+}
+
+ShaderManager::SingleViewScope::SingleViewScope(ShaderManager& _manager) :
+    manager(_manager),
+    savedViews(_manager.getViews())
+{
+    manager.setViews({});
+}
+
+ShaderManager::SingleViewScope::~SingleViewScope()
+{
+    manager.setViews(savedViews);
+}
+
+CelestiaGLProgram*
+ShaderManager::attachViews(CelestiaGLProgram* prog) const
+{
+    prog->views = &views;
+    prog->multiview = views.multiview;
+    prog->uniformBuffer = uniformBuffer.get();
+    return prog;
+}
+
+// Modes of the shader manager changing all generated shaders, which
+// cached programs are only used with: bit 0 for fisheye projection, bit 1
+// for multiview, bit 2 for uniform blocks.
+unsigned int
+ShaderManager::getModeFlags() const
+{
+    return (fisheyeEnabled ? 1 : 0) | (views.multiview ? 2 : 0) | (usesUniformBlocks() ? 4 : 0);
+}
+
+bool
+ShaderManager::usesUniformBlocks() const
+{
+#ifdef USE_GLSL_STRUCTS
+    return gl::ARB_uniform_buffer_object;
+#else
+    // The light block is declared with a structure
+    return false;
+#endif
+}
+
+const char*
+ShaderManager::versionHeader() const
+{
+    return views.multiview ? MultiviewVersionHeader : VersionHeader;
+}
+
+const char*
+ShaderManager::vertexHeader() const
+{
+    return views.multiview ? MultiviewVertexHeader : VertexHeader;
+}
+
+namespace
+{
+constexpr const char ProgramCacheMagic[8] = { 'C', 'E', 'L', 'P', 'R', 'O', 'G', '1' };
+constexpr const char* ProgramCacheExtension = ".glbin";
+
+// Increase when the generated shaders change within a release
+constexpr std::uint32_t ProgramCacheRevision = 3;
+
+// Read a program binary saved by ShaderManager::saveCachedProgram(),
+// rejecting it if it was made by another driver or Celestia version.
+bool
+ReadCachedProgram(const fs::path& path,
+                  const string& driverID,
+                  unsigned int modeFlags,
+                  ShaderProperties& props,
+                  GLenum& format,
+                  vector<char>& binary)
+{
+    using celestia::util::readLE;
+
+    ifstream in(path, ios::in | ios::binary);
+    char magic[sizeof(ProgramCacheMagic)];
+    if (!in.read(magic, sizeof(magic)).good() ||
+        memcmp(magic, ProgramCacheMagic, sizeof(magic)) != 0)
+    {
+        return false;
+    }
+
+    std::uint32_t idLength;
+    if (!readLE(in, idLength) || idLength != driverID.size())
+        return false;
+    string id(idLength, '\0');
+    if (!in.read(&id[0], idLength).good() || id != driverID)
+        return false;
+
+    std::uint8_t mode;
+    std::uint64_t texUsage;
+    std::uint16_t nLights, lightModel, effects;
+    std::uint32_t shadowCounts;
+    std::int32_t fishEyeOverride;
+    std::uint32_t binaryFormat, length;
+    if (!readLE(in, mode) ||
+        !readLE(in, texUsage) ||
+        !readLE(in, nLights) ||
+        !readLE(in, lightModel) ||
+        !readLE(in, effects) ||
+        !readLE(in, shadowCounts) ||
+        !readLE(in, fishEyeOverride) ||
+        !readLE(in, binaryFormat) ||
+        !readLE(in, length) ||
+        mode != modeFlags)
+    {
+        return false;
+    }
+
+    props.texUsage = (unsigned long) texUsage;
+    props.nLights = nLights;
+    props.lightModel = lightModel;
+    props.effects = effects;
+    props.shadowCounts = shadowCounts;
+    props.fishEyeOverride = fishEyeOverride;
+    format = (GLenum) binaryFormat;
+
+    binary.resize(length);
+    return in.read(binary.data(), length).good();
+}
+} // end unnamed namespace
+
+void
+ShaderManager::setAsyncCompilation(bool enabled)
+{
+    asyncCompilation = enabled && gl::KHR_parallel_shader_compile;
+    if (enabled && !asyncCompilation)
+        GetLogger()->info("Parallel shader compilation not supported.\n");
+}
+
+// Wrap up a program whose link was started in the background. If it
+// failed, the program is built again to report the errors and substitute
+// the error shader.
+CelestiaGLProgram*
+ShaderManager::finishProgram(const ShaderProperties& props, GLProgram* program)
+{
+    if (program->linkStatus() != ShaderStatus_OK)
+    {
+        delete program;
+        return buildProgram(props);
+    }
+
+    if (!programCacheDir.empty())
+        saveCachedProgram(props, *program);
+    return attachViews(new CelestiaGLProgram(*program, props));
+}
+
+// Find a built program to draw with while the one for props is compiled,
+// trying variants without shadows, then without the extra surface textures,
+// then with plain diffuse lighting.
+CelestiaGLProgram*
+ShaderManager::getFallbackShader(const ShaderProperties& props) const
+{
+    // Without these the vertex data or the whole look of the object differ
+    // too much to substitute another program
+    constexpr unsigned long ExactTexUsage = ShaderProperties::VertexOpacities |
+                                            ShaderProperties::VertexColors |
+                                            ShaderProperties::PointSprite |
+                                            ShaderProperties::SharedTextureCoords |
+                                            ShaderProperties::StaticPointSize |
+                                            ShaderProperties::LineAsTriangles |
+                                            ShaderProperties::ScatteringTables;
+    if ((props.texUsage & ExactTexUsage) != 0 ||
+        props.lightModel == ShaderProperties::UnlitModel ||
+        props.lightModel == ShaderProperties::ParticleModel ||
+        props.lightModel == ShaderProperties::EmissiveModel)
+    {
+        return nullptr;
+    }
+
+    ShaderProperties fallback = props;
+    fallback.shadowCounts = 0;
+    fallback.texUsage &= ~(ShaderProperties::RingShadowTexture |
+                           ShaderProperties::CloudShadowTexture |
+                           ShaderProperties::ShadowMapTexture);
+    std::array<ShaderProperties, 3> candidates;
+    candidates[0] = fallback;
+
+    fallback.texUsage &= ~(ShaderProperties::SpecularTexture |
+                           ShaderProperties::NormalTexture |
+                           ShaderProperties::NightTexture |
+                           ShaderProperties::SpecularInDiffuseAlpha |
+                           ShaderProperties::OverlayTexture |
+                           ShaderProperties::CompressedNormalTexture |
+                           ShaderProperties::Scattering);
+    candidates[1] = fallback;
+
+    if (fallback.lightModel != ShaderProperties::RingIllumModel &&
+        fallback.lightModel != ShaderProperties::AtmosphereModel)
+    {
+        fallback.lightModel = ShaderProperties::DiffuseModel;
+    }
+    candidates[2] = fallback;
+
+    for (const auto& candidate : candidates)
+    {
+        if (!(candidate < props) && !(props < candidate))
+            continue;
+        auto iter = dynamicShaders[views.multiview ? 1 : 0].find(candidate);
+        if (iter != dynamicShaders[views.multiview ? 1 : 0].end())
+            return iter->second;
+    }
+
+    return nullptr;
+}
+
+void
+ShaderManager::setProgramCache(const fs::path& dir)
+{
+    if (!gl::ARB_get_program_binary)
+    {
+        GetLogger()->info("Program binaries not supported, shader cache disabled.\n");
+        return;
+    }
+
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec)
+    {
+        GetLogger()->error("Failed to create shader cache directory {}\n", dir);
+        return;
+    }
+
+    programCacheDir = dir;
+    driverID = fmt::format("{}\n{}\n{}\n{}\n{}\n{}",
+                           VERSION,
+                           ProgramCacheRevision,
+                           reinterpret_cast<const char*>(glGetString(GL_VENDOR)),
+                           reinterpret_cast<const char*>(glGetString(GL_RENDERER)),
+                           reinterpret_cast<const char*>(glGetString(GL_VERSION)),
+                           reinterpret_cast<const char*>(glGetString(GL_SHADING_LANGUAGE_VERSION)));
+}
+
+void
+ShaderManager::loadCachedPrograms()
+{
+    if (programCacheDir.empty())
+        return;
+
+    std::error_code ec;
+    unsigned int nPrograms = 0;
+    for (const auto& entry : fs::directory_iterator(programCacheDir, ec))
+    {
+        if (entry.path().extension() != ProgramCacheExtension)
+            continue;
+
+        ShaderProperties props;
+        GLenum format;
+        vector<char> binary;
+        auto& dynamicShaders = this->dynamicShaders[views.multiview ? 1 : 0];
+        if (!ReadCachedProgram(entry.path(), driverID, getModeFlags(), props, format, binary) ||
+            dynamicShaders.find(props) != dynamicShaders.end())
+        {
+            continue;
+        }
+
+        GLProgram* prog = nullptr;
+        if (GLShaderLoader::CreateProgramFromBinary(format, binary, &prog) == ShaderStatus_OK)
+        {
+            dynamicShaders[props] = attachViews(new CelestiaGLProgram(*prog, props));
+            nPrograms++;
+        }
+    }
+
+    GetLogger()->info("Loaded {} shaders from cache.\n", nPrograms);
+}
+
+fs::path
+ShaderManager::getCachePath(const ShaderProperties& props) const
+{
+    return programCacheDir / fmt::format("{:x}-{:x}-{:x}-{:x}-{:x}-{}-{}{}",
+                                         props.texUsage,
+                                         props.nLights,
+                                         props.lightModel,
+                                         props.effects,
+                                         props.shadowCounts,
+                                         props.fishEyeOverride,
+                                         getModeFlags(),
+                                         ProgramCacheExtension);
+}
+
+CelestiaGLProgram*
+ShaderManager::loadCachedProgram(const ShaderProperties& props)
+{
+    ShaderProperties cachedProps;
+    GLenum format;
+    vector<char> binary;
+    if (!ReadCachedProgram(getCachePath(props), driverID, getModeFlags(), cachedProps, format, binary))
+        return nullptr;
+
+    GLProgram* prog = nullptr;
+    if (GLShaderLoader::CreateProgramFromBinary(format, binary, &prog) != ShaderStatus_OK)
+        return nullptr;
+
+    return attachViews(new CelestiaGLProgram(*prog, props));
+}
+
+void
+ShaderManager::saveCachedProgram(const ShaderProperties& props, const GLProgram& prog)
+{
+    using celestia::util::writeLE;
+
+    GLenum format;
+    vector<char> binary;
+    if (!prog.getBinary(format, binary))
+        return;
+
+    fs::path path = getCachePath(props);
+    ofstream out(path, ios::out | ios::binary);
+    out.write(ProgramCacheMagic, sizeof(ProgramCacheMagic));
+    writeLE<std::uint32_t>(out, (std::uint32_t) driverID.size());
+    out.write(driverID.data(), driverID.size());
+    writeLE<std::uint8_t>(out, static_cast<std::uint8_t>(getModeFlags()));
+    writeLE<std::uint64_t>(out, props.texUsage);
+    writeLE<std::uint16_t>(out, props.nLights);
+    writeLE<std::uint16_t>(out, props.lightModel);
+    writeLE<std::uint16_t>(out, props.effects);
+    writeLE<std::uint32_t>(out, props.shadowCounts);
+    writeLE<std::int32_t>(out, props.fishEyeOverride);
+    writeLE<std::uint32_t>(out, format);
+    writeLE<std::uint32_t>(out, (std::uint32_t) binary.size());
+    out.write(binary.data(), binary.size());
+
+    if (!out.good())
+        GetLogger()->warn("Failed to write shader cache file {}\n", path);
+}
+
 CelestiaGLProgram::CelestiaGLProgram(GLProgram& _program,
                                      const ShaderProperties& _props) :
     program(&_program),
@@ -3467,6 +4263,7 @@ CelestiaGLProgram::CelestiaGLProgram(GLProgram& _program,
 {
     initParameters();
     initSamplers();
+    initUniformBlocks();
 }
 
 
@@ -3542,6 +4339,13 @@ CelestiaGLProgram::initCommonParameters()
     ModelViewMatrix = mat4Param("ModelViewMatrix");
     ProjectionMatrix = mat4Param("ProjectionMatrix");
     MVPMatrix = mat4Param("MVPMatrix");
+
+    for (unsigned int i = 0; i < MaxShaderViews; i++)
+    {
+        viewModelViewMatrix[i] = mat4Param(fmt::format("ModelViewMatrices[{}]", i));
+        viewProjectionMatrix[i] = mat4Param(fmt::format("ProjectionMatrices[{}]", i));
+        viewMVPMatrix[i] = mat4Param(fmt::format("MVPMatrices[{}]", i));
+    }
 }
 
 void
@@ -3589,6 +4393,12 @@ CelestiaGLProgram::initParameters()
     opacity      = floatParam("opacity");
     ambientColor = vec3Param("ambientColor");
 
+    if (props.lightModel == ShaderProperties::RingIllumModel)
+    {
+        ringInnerRadius      = floatParam("ringInnerRadius");
+        ringOuterRadius      = floatParam("ringOuterRadius");
+    }
+
     if (props.texUsage & ShaderProperties::RingShadowTexture)
     {
         ringWidth            = floatParam("ringWidth");
@@ -3623,6 +4433,11 @@ CelestiaGLProgram::initParameters()
         extinctionCoeff      = vec3Param("extinctionCoeff");
     }
 
+    if (props.texUsage & ShaderProperties::ScatteringTables)
+    {
+        scatteringTableSize  = vec3Param("scatteringTableSize");
+    }
+
     if ((props.lightModel & ShaderProperties::LunarLambertModel) != 0)
     {
         lunarLambert         = floatParam("lunarLambert");
@@ -3641,6 +4456,30 @@ CelestiaGLProgram::initParameters()
 }
 
 
+// Bind the light and shadow blocks of the program, if it has them, to
+// their binding points
+void
+CelestiaGLProgram::initUniformBlocks()
+{
+    if (!gl::ARB_uniform_buffer_object)
+        return;
+
+    GLuint index = glGetUniformBlockIndex(program->getID(), "LightParameters");
+    if (index != GL_INVALID_INDEX)
+    {
+        glUniformBlockBinding(program->getID(), index, LightBlockBinding);
+        hasLightBlock = true;
+    }
+
+    index = glGetUniformBlockIndex(program->getID(), "ShadowParameters");
+    if (index != GL_INVALID_INDEX)
+    {
+        glUniformBlockBinding(program->getID(), index, ShadowBlockBinding);
+        hasShadowBlock = true;
+    }
+}
+
+
 void
 CelestiaGLProgram::initSamplers()
 {
@@ -3710,6 +4549,16 @@ CelestiaGLProgram::initSamplers()
         if (slot != -1)
             glUniform1i(slot, nSamplers++);
     }
+
+    if (props.texUsage & ShaderProperties::ScatteringTables)
+    {
+        int slot = glGetUniformLocation(program->getID(), "transmittanceTex");
+        if (slot != -1)
+            glUniform1i(slot, nSamplers++);
+        slot = glGetUniformLocation(program->getID(), "inscatterTex");
+        if (slot != -1)
+            glUniform1i(slot, nSamplers++);
+    }
 }
 
 
@@ -3728,14 +4577,21 @@ CelestiaGLProgram::setLightParameters(const LightingState& ls,
                            materialSpecular.green(),
                            materialSpecular.blue());
 
+    bool fragmentLighting = props.usesShadows() ||
+                            props.usesFragmentLighting() ||
+                            props.lightModel == ShaderProperties::RingIllumModel;
+
+    LightBlock block{};
     for (unsigned int i = 0; i < nLights; i++)
     {
         const DirectionalLight& light = ls.lights[i];
+        LightBlock::Light& lightParams = block.lights[i];
+        LightBlock::FragmentLight& fragLightParams = block.fragLights[i];
 
         Vector3f lightColor = Vector3f(light.color.red(),
                                        light.color.green(),
                                        light.color.blue()) * light.irradiance;
-        lights[i].direction = light.direction_obj;
+        lightParams.direction = light.direction_obj;
 
         // Include a phase-based normalization factor to prevent planets from appearing
         // too dim when rendered with non-Lambertian photometric functions.
@@ -3746,29 +4602,56 @@ CelestiaGLProgram::setLightParameters(const LightingState& ls,
             lightColor *= photometricNormFactor;
         }
 
-        if (props.usesShadows() ||
-            props.usesFragmentLighting() ||
-            props.lightModel == ShaderProperties::RingIllumModel)
+        if (fragmentLighting)
         {
-            fragLightColor[i] = lightColor.cwiseProduct(diffuseColor);
+            fragLightParams.color = lightColor.cwiseProduct(diffuseColor);
             if (props.hasSpecular())
             {
-                fragLightSpecColor[i] = lightColor.cwiseProduct(specularColor);
+                fragLightParams.specColor = lightColor.cwiseProduct(specularColor);
             }
-            fragLightBrightness[i] = lightColor.maxCoeff();
+            fragLightParams.brightness = lightColor.maxCoeff();
         }
         else
         {
-            lights[i].diffuse = lightColor.cwiseProduct(diffuseColor);
+            lightParams.diffuse = lightColor.cwiseProduct(diffuseColor);
         }
 
-        lights[i].brightness = lightColor.maxCoeff();
-        lights[i].specular = lightColor.cwiseProduct(specularColor);
+        lightParams.brightness = lightColor.maxCoeff();
+        lightParams.specular = lightColor.cwiseProduct(specularColor);
 
         Vector3f halfAngle_obj = ls.eyeDir_obj + light.direction_obj;
         if (halfAngle_obj.norm() != 0.0f)
             halfAngle_obj.normalize();
-        lights[i].halfVector = halfAngle_obj;
+        lightParams.halfVector = halfAngle_obj;
+    }
+
+    if (hasLightBlock && uniformBuffer != nullptr)
+    {
+        uniformBuffer->upload(LightBlockBinding, &block, sizeof(block));
+    }
+    else
+    {
+        for (unsigned int i = 0; i < nLights; i++)
+        {
+            const LightBlock::Light& lightParams = block.lights[i];
+            const LightBlock::FragmentLight& fragLightParams = block.fragLights[i];
+
+            lights[i].direction = lightParams.direction;
+            if (fragmentLighting)
+            {
+                fragLightColor[i] = fragLightParams.color;
+                if (props.hasSpecular())
+                    fragLightSpecColor[i] = fragLightParams.specColor;
+                fragLightBrightness[i] = fragLightParams.brightness;
+            }
+            else
+            {
+                lights[i].diffuse = lightParams.diffuse;
+            }
+            lights[i].brightness = lightParams.brightness;
+            lights[i].specular = lightParams.specular;
+            lights[i].halfVector = lightParams.halfVector;
+        }
     }
 
     eyePosition = ls.eyePos_obj;
@@ -3792,6 +4675,9 @@ CelestiaGLProgram::setEclipseShadowParameters(const LightingState& ls,
     Affine3f rotation(orientation.conjugate());
     Matrix4f modelToWorld = (rotation *  Scaling(scaleFactors)).matrix();
 
+    bool shadowBlock = hasShadowBlock && uniformBuffer != nullptr;
+    ShadowBlock block{};
+
     for (unsigned int li = 0;
          li < min(ls.nLights, MaxShaderLights);
          li++)
@@ -3810,7 +4696,7 @@ CelestiaGLProgram::setEclipseShadowParameters(const LightingState& ls,
             for (unsigned int i = 0; i < nShadows; i++)
             {
                 EclipseShadow& shadow = ls.shadows[li]->at(i);
-                CelestiaGLProgramShadow& shadowParams = shadows[li][i];
+                ShadowBlock::Shadow& shadowParams = block.shadows[li][i];
 
                 // Compute shadow parameters: max depth of at the center of the shadow
                 // (always 1 if an eclipse is total) and the linear falloff
@@ -3839,9 +4725,20 @@ CelestiaGLProgram::setEclipseShadowParameters(const LightingState& ls,
 
                 shadowParams.texGenS = m.row(0);
                 shadowParams.texGenT = m.row(1);
+
+                if (!shadowBlock)
+                {
+                    shadows[li][i].texGenS = shadowParams.texGenS;
+                    shadows[li][i].texGenT = shadowParams.texGenT;
+                    shadows[li][i].falloff = shadowParams.falloff;
+                    shadows[li][i].maxDepth = shadowParams.maxDepth;
+                }
             }
         }
     }
+
+    if (shadowBlock)
+        uniformBuffer->upload(ShadowBlockBinding, &block, sizeof(block));
 }
 
 
@@ -3891,7 +4788,42 @@ CelestiaGLProgram::setAtmosphereParameters(const Atmosphere& atmosphere,
 void
 CelestiaGLProgram::setMVPMatrices(const Matrix4f& p, const Matrix4f& m)
 {
-    ProjectionMatrix = p;
-    ModelViewMatrix = m;
-    MVPMatrix = p * m;
+    if (views == nullptr || views->nEyes == 0)
+    {
+        ProjectionMatrix = p;
+        ModelViewMatrix = m;
+        MVPMatrix = p * m;
+        return;
+    }
+
+    // Single view programs draw the first eye
+    unsigned int nEyes = multiview ? views->nEyes : 1;
+    for (unsigned int i = 0; i < nEyes; i++)
+    {
+        const EyeTransform& eye = views->eyes[i];
+
+        // Shifting x in normalized device coordinates means adding a
+        // multiple of w to x in clip coordinates
+        Matrix4f eyeProjection = p;
+        eyeProjection.row(0) += eye.projectionShift * p.row(3);
+
+        Matrix4f eyeModelView;
+        eyeModelView.topRows<3>() = views->rotation * m.topRows<3>();
+        eyeModelView.row(3) = m.row(3);
+        if (views->translation)
+            eyeModelView.topRows<3>() -= eye.position * m.row(3);
+
+        if (multiview)
+        {
+            viewProjectionMatrix[i] = eyeProjection;
+            viewModelViewMatrix[i] = eyeModelView;
+            viewMVPMatrix[i] = eyeProjection * eyeModelView;
+        }
+        else
+        {
+            ProjectionMatrix = eyeProjection;
+            ModelViewMatrix = eyeModelView;
+            MVPMatrix = eyeProjection * eyeModelView;
+        }
+    }
 }
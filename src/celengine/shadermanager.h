@@ -10,8 +10,12 @@
 #ifndef _CELENGINE_SHADERMANAGER_H_
 #define _CELENGINE_SHADERMANAGER_H_
 
+#include <array>
 #include <map>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <celcompat/filesystem.h>
 #include <celengine/glshader.h>
 #include <celengine/lightenv.h>
 #include <celengine/atmosphere.h>
@@ -19,6 +23,11 @@
 
 #define ADVANCED_CLOUD_SHADOWS 0
 
+namespace celestia::gl
+{
+class UniformBuffer;
+}
+
 class ShaderProperties
 {
  public:
@@ -68,6 +77,12 @@ class ShaderProperties
      SharedTextureCoords     =  0x8000,
      StaticPointSize         = 0x10000,
      LineAsTriangles         = 0x20000,
+     // Model transform given per instance, see ModelInstances
+     Instanced               = 0x40000,
+     // Sky drawn from precomputed tables, see ScatteringTable
+     ScatteringTables        = 0x80000,
+     // Normals and tangents packed in two components, see ModelGeometry
+     PackedNormals           = 0x100000,
  };
 
  enum
@@ -141,6 +156,35 @@ class ShaderProperties
 
 static const unsigned int MaxShaderLights = 4;
 static const unsigned int MaxShaderEclipseShadows = 3;
+static const unsigned int MaxShaderViews = 2;
+
+// Transform from the camera to one eye of a stereo view
+struct EyeTransform
+{
+    // Position of the eye in camera space, in the units of the scene
+    Eigen::Vector3f position{ Eigen::Vector3f::Zero() };
+    // Horizontal shift of the projection in normalized device coordinates,
+    // making the views of the eyes coincide at some distance
+    float projectionShift{ 0.0f };
+};
+
+// Views which CelestiaGLProgram::setMVPMatrices() sets the matrices of.
+// Without eyes, the scene is seen from the camera.
+struct ShaderViews
+{
+    std::array<EyeTransform, MaxShaderViews> eyes;
+    unsigned int nEyes{ 0 };
+    // Whether the eyes are moved to their positions; the positions are
+    // only meaningful for the parts of the scene in the same units.
+    bool translation{ false };
+    // Whether the programs draw all eyes at once with OVR_multiview,
+    // rather than only the first one
+    bool multiview{ false };
+    // Rotation of camera space applied before the eyes are moved, such as
+    // the change of the observer orientation since the scene was culled
+    Eigen::Matrix3f rotation{ Eigen::Matrix3f::Identity() };
+};
+
 struct CelestiaGLProgramLight
 {
     Vec3ShaderParameter direction;
@@ -177,6 +221,8 @@ class CelestiaGLProgram
     void setAtmosphereParameters(const Atmosphere& atmosphere,
                                  float atmPlanetRadius,
                                  float objRadius);
+    // Set the projection and modelview matrices of the camera, adjusted
+    // for the eyes of the current views
     void setMVPMatrices(const Eigen::Matrix4f& p, const Eigen::Matrix4f& m = Eigen::Matrix4f::Identity());
 
     enum
@@ -193,6 +239,9 @@ class CelestiaGLProgram
         IntensityAttributeIndex     = 9,
         NextVCoordAttributeIndex    = 10,
         ScaleFactorAttributeIndex   = 11,
+        InstanceRow0AttributeIndex  = 12,
+        InstanceRow1AttributeIndex  = 13,
+        InstanceRow2AttributeIndex  = 14,
     };
 
  public:
@@ -211,6 +260,11 @@ class CelestiaGLProgram
     Vec4ShaderParameter ringPlane;
     Vec3ShaderParameter ringCenter;
 
+    // Radii of the rings drawn with the ring illumination model, in units
+    // of the planet radius
+    FloatShaderParameter ringInnerRadius;
+    FloatShaderParameter ringOuterRadius;
+
     // Mix of Lambertian and "lunar" (Lommel-Seeliger) photometric models.
     // 0 = pure Lambertian, 1 = L-S
     FloatShaderParameter lunarLambert;
@@ -253,6 +307,10 @@ class CelestiaGLProgram
     //    z = 1/radius
     Vec3ShaderParameter atmosphereRadius;
 
+    // Number of sun angle, view angle and height samples of the scattering
+    // tables
+    Vec3ShaderParameter scatteringTableSize;
+
     // Scale factor for point sprites
     FloatShaderParameter pointScale;
 
@@ -286,9 +344,27 @@ class CelestiaGLProgram
     void initCommonParameters();
     void initParameters();
     void initSamplers();
+    void initUniformBlocks();
 
     GLProgram* program;
     const ShaderProperties props;
+
+    // Set by the ShaderManager which built the program
+    const ShaderViews* views{ nullptr };
+    bool multiview{ false };
+    celestia::gl::UniformBuffer* uniformBuffer{ nullptr };
+
+    // Whether the light and shadow parameters are in uniform blocks,
+    // rather than in the parameters above
+    bool hasLightBlock{ false };
+    bool hasShadowBlock{ false };
+
+    // Matrices of each view of a multiview program
+    Mat4ShaderParameter viewModelViewMatrix[MaxShaderViews];
+    Mat4ShaderParameter viewProjectionMatrix[MaxShaderViews];
+    Mat4ShaderParameter viewMVPMatrix[MaxShaderViews];
+
+    friend class ShaderManager;
 };
 
 
@@ -304,9 +380,62 @@ class ShaderManager
 
     void setFisheyeEnabled(bool enabled);
 
+    // Views which the matrices of the programs are set for. The programs
+    // returned while multiview is set are only usable with framebuffers
+    // of MaxShaderViews layers, see MultiviewFramebuffer.
+    const ShaderViews& getViews() const { return views; }
+    void setViews(const ShaderViews&);
+    void setEyeTranslation(bool enabled);
+    static bool isMultiviewSupported();
+
+    // Draw from the camera with single view programs while in scope, for
+    // passes rendering into other targets than the view like shadow maps
+    class SingleViewScope
+    {
+     public:
+        explicit SingleViewScope(ShaderManager&);
+        ~SingleViewScope();
+        SingleViewScope(const SingleViewScope&) = delete;
+        SingleViewScope& operator=(const SingleViewScope&) = delete;
+
+     private:
+        ShaderManager& manager;
+        ShaderViews savedViews;
+    };
+
+    // Save the binaries of linked programs to dir and use them instead of
+    // compiling the programs again on later runs with the same driver.
+    void setProgramCache(const fs::path& dir);
+    // Load every program in the cache, so that the combinations used on
+    // earlier runs don't have to be compiled while rendering.
+    void loadCachedPrograms();
+
+    // Compile new shader combinations in the background, drawing with a
+    // simpler program that's already built until they're done. This needs
+    // KHR_parallel_shader_compile.
+    void setAsyncCompilation(bool enabled);
+    // True while programs compiled in the background are drawn with
+    // their fallbacks
+    bool hasPendingShaders() const
+    {
+        return !pendingShaders[0].empty() || !pendingShaders[1].empty();
+    }
+
  private:
+    GLProgram* createProgram(const ShaderProperties&);
     CelestiaGLProgram* buildProgram(const ShaderProperties&);
+    CelestiaGLProgram* finishProgram(const ShaderProperties&, GLProgram*);
+    CelestiaGLProgram* getFallbackShader(const ShaderProperties&) const;
+    CelestiaGLProgram* loadCachedProgram(const ShaderProperties&);
+    void saveCachedProgram(const ShaderProperties&, const GLProgram&);
+    fs::path getCachePath(const ShaderProperties&) const;
     CelestiaGLProgram* buildProgram(const std::string&, const std::string&);
+    CelestiaGLProgram* attachViews(CelestiaGLProgram*) const;
+    unsigned int getModeFlags() const;
+    bool usesUniformBlocks() const;
+
+    const char* versionHeader() const;
+    const char* vertexHeader() const;
 
     GLVertexShader* buildVertexShader(const ShaderProperties&);
     GLFragmentShader* buildFragmentShader(const ShaderProperties&);
@@ -316,6 +445,8 @@ class ShaderManager
 
     GLVertexShader* buildAtmosphereVertexShader(const ShaderProperties&);
     GLFragmentShader* buildAtmosphereFragmentShader(const ShaderProperties&);
+    GLVertexShader* buildScatteringTableVertexShader(const ShaderProperties&);
+    GLFragmentShader* buildScatteringTableFragmentShader(const ShaderProperties&);
 
     GLVertexShader* buildEmissiveVertexShader(const ShaderProperties&);
     GLFragmentShader* buildEmissiveFragmentShader(const ShaderProperties&);
@@ -323,10 +454,26 @@ class ShaderManager
     GLVertexShader* buildParticleVertexShader(const ShaderProperties&);
     GLFragmentShader* buildParticleFragmentShader(const ShaderProperties&);
 
-    std::map<ShaderProperties, CelestiaGLProgram*> dynamicShaders;
-    std::map<std::string, CelestiaGLProgram*> staticShaders;
+    // Programs for single view rendering, then for multiview
+    std::map<ShaderProperties, CelestiaGLProgram*> dynamicShaders[2];
+    std::map<std::string, CelestiaGLProgram*> staticShaders[2];
 
     bool fisheyeEnabled { false };
+    ShaderViews views;
+
+    // Light and shadow parameters of the generated programs, when they
+    // are in uniform blocks
+    std::unique_ptr<celestia::gl::UniformBuffer> uniformBuffer;
+
+    // Programs which are compiled and linked in the background
+    std::map<ShaderProperties, GLProgram*> pendingShaders[2];
+    bool asyncCompilation { false };
+    bool deferCompileStatus { false };
+
+    fs::path programCacheDir;
+    // Vendor, renderer and version strings which the cached binaries
+    // were produced with
+    std::string driverID;
 };
 
 #endif // _CELENGINE_SHADERMANAGER_H_
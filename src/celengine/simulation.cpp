@@ -11,6 +11,7 @@
 // of the License, or (at your option) any later version.
 
 #include <algorithm>
+#include <celutil/profiler.h>
 #include <celutil/strnatcmp.h>
 #include "render.h"
 #include "simulation.h"
@@ -112,6 +113,8 @@ double Simulation::getArrivalTime() const
 // Tick the simulation by dt seconds
 void Simulation::update(double dt)
 {
+    celestia::util::ProfileZone zone("Simulation");
+
     realTime += dt;
 
     for (const auto observer : observers)
@@ -148,14 +151,18 @@ void Simulation::setTrackedObject(const Selection& sel)
 }
 
 
-Selection Simulation::pickObject(const Vector3f& pickRay, uint64_t renderFlags, float tolerance)
+Selection Simulation::pickObject(const Vector3f& pickRay,
+                                 uint64_t renderFlags,
+                                 float tolerance,
+                                 const PickGrid* pickGrid)
 {
     return universe->pick(activeObserver->getPosition(),
                           activeObserver->getOrientationf().conjugate() * pickRay,
                           activeObserver->getTime(),
                           renderFlags,
                           faintestVisible,
-                          tolerance);
+                          tolerance,
+                          pickGrid);
 }
 
 void Simulation::reverseObserverOrientation()
@@ -442,6 +449,16 @@ Selection Simulation::findObjectFromPath(string s, bool i18n)
 
 
 vector<std::string> Simulation::getObjectCompletion(string s, bool i18n, bool withLocations)
+{
+    CompletionSearch search;
+    return getObjectCompletion(s, i18n, withLocations, search);
+}
+
+
+vector<std::string> Simulation::getObjectCompletion(const string& s,
+                                                    bool i18n,
+                                                    bool withLocations,
+                                                    CompletionSearch& search)
 {
     Selection path[2];
     int nPathEntries = 0;
@@ -464,7 +481,14 @@ vector<std::string> Simulation::getObjectCompletion(string s, bool i18n, bool wi
         path[nPathEntries++] = Selection(closestSolarSystem->getStar());
     }
 
-    auto completion = universe->getCompletionPath(s, i18n, path, nPathEntries, withLocations);
+    vector<string> completion;
+    universe->getCompletion(s, i18n, search,
+                            [&completion](const string& name)
+                            {
+                                completion.push_back(name);
+                                return true;
+                            },
+                            path, nPathEntries, withLocations);
 
     sort(begin(completion), end(completion),
          [](const string &s1, const string &s2) { return strnatcmp(s1, s2) < 0; });
@@ -23,6 +23,7 @@
 #include <vector>
 
 
+class PickGrid;
 class Renderer;
 
 class Simulation
@@ -42,7 +43,10 @@ class Simulation
     void draw(Renderer&);
     void render(Renderer&, Observer&);
 
-    Selection pickObject(const Eigen::Vector3f& pickRay, uint64_t renderFlags, float tolerance = 0.0f);
+    Selection pickObject(const Eigen::Vector3f& pickRay,
+                         uint64_t renderFlags,
+                         float tolerance = 0.0f,
+                         const PickGrid* pickGrid = nullptr);
 
     Universe* getUniverse() const;
 
@@ -61,6 +65,11 @@ class Simulation
     Selection findObject(std::string s, bool i18n = false);
     Selection findObjectFromPath(std::string s, bool i18n = false);
     std::vector<std::string> getObjectCompletion(std::string s, bool i18n, bool withLocations = false);
+    // Reuses the names found by the previous search while s is extended
+    std::vector<std::string> getObjectCompletion(const std::string& s,
+                                                 bool i18n,
+                                                 bool withLocations,
+                                                 CompletionSearch& search);
     void gotoSelection(double gotoTime,
                        const Eigen::Vector3f& up,
                        ObserverFrame::CoordinateSystem upFrame);
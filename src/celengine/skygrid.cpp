@@ -11,6 +11,7 @@
 // of the License, or (at your option) any later version.
 
 #include <cmath>
+#include <cstddef>
 #include <cstdlib>
 #include <sstream>
 #include <iomanip>
@@ -20,6 +21,7 @@
 #include "render.h"
 #include "vecgl.h"
 #include "skygrid.h"
+#include "glstate.h"
 
 using namespace Eigen;
 using namespace std;
@@ -35,6 +37,18 @@ const double MAX_VISIBLE_ARCS = 10.0;
 // Number of line segments used to approximate one arc of the celestial sphere
 const int ARC_SUBDIVISIONS = 100;
 
+// Fraction of the visible range added on each side of the region covered
+// by the cached grid lines
+const double LINE_CACHE_MARGIN = 0.5;
+
+// The cached grid lines are rebuilt with shorter segments when the visible
+// range becomes smaller than this fraction of the region they cover
+const double LINE_CACHE_MIN_COVERAGE = 0.25;
+
+// Number of line segments used for one arc of the cached grid lines, which
+// cover about twice the visible range
+const int CACHED_ARC_SUBDIVISIONS = 2 * ARC_SUBDIVISIONS;
+
 // Size of the cross indicating the north and south poles
 const double POLAR_CROSS_SIZE = 0.01;
 
@@ -386,6 +400,145 @@ SkyGrid::meridianSpacing(double idealSpacing) const
 }
 
 
+SkyGrid::~SkyGrid()
+{
+    if (m_lineBuffer != 0)
+        celestia::gl::deleteBuffers(1, &m_lineBuffer);
+}
+
+
+// Check whether the cached lines cover the visible range of the grid with
+// the current spacing.
+bool
+SkyGrid::linesCover(double minTheta, double maxTheta,
+                    double minDec, double maxDec,
+                    int raIncrement, int decIncrement) const
+{
+    if (m_lineBuffer == 0 ||
+        raIncrement != m_linesRaIncrement ||
+        decIncrement != m_linesDecIncrement ||
+        m_longitudeUnits != m_linesLongitudeUnits)
+    {
+        return false;
+    }
+
+    if (minDec < m_linesMinDec || maxDec > m_linesMaxDec)
+        return false;
+
+    double thetaSpan = maxTheta - minTheta;
+    double linesThetaSpan = m_linesMaxTheta - m_linesMinTheta;
+    if (linesThetaSpan < 2.0 * celestia::numbers::pi)
+    {
+        double offset = std::fmod(minTheta - m_linesMinTheta, 2.0 * celestia::numbers::pi);
+        if (offset < 0.0)
+            offset += 2.0 * celestia::numbers::pi;
+        if (offset + thetaSpan > linesThetaSpan)
+            return false;
+    }
+
+    return thetaSpan >= linesThetaSpan * LINE_CACHE_MIN_COVERAGE &&
+           maxDec - minDec >= (m_linesMaxDec - m_linesMinDec) * LINE_CACHE_MIN_COVERAGE;
+}
+
+
+// Build the parallels and meridians of a region around the visible range
+// and upload them to the line buffer. Each line is a strip of
+// CACHED_ARC_SUBDIVISIONS + 2 points, stored twice for lines drawn as
+// triangles; the extra point at the end is only used as the next point of
+// the last segment.
+void
+SkyGrid::buildLines(double minTheta, double maxTheta,
+                    double minDec, double maxDec,
+                    int raIncrement, int decIncrement)
+{
+    double thetaMargin = (maxTheta - minTheta) * LINE_CACHE_MARGIN;
+    minTheta -= thetaMargin;
+    maxTheta += thetaMargin;
+    if (maxTheta - minTheta >= 2.0 * celestia::numbers::pi)
+    {
+        minTheta = -celestia::numbers::pi;
+        maxTheta = celestia::numbers::pi;
+    }
+
+    double decMargin = (maxDec - minDec) * LINE_CACHE_MARGIN;
+    minDec = std::max(minDec - decMargin, -celestia::numbers::pi / 2.0);
+    maxDec = std::min(maxDec + decMargin, celestia::numbers::pi / 2.0);
+
+    int totalLongitudeUnits = HOUR_MIN_SEC_TOTAL;
+    if (m_longitudeUnits == LongitudeDegrees)
+        totalLongitudeUnits = DEG_MIN_SEC_TOTAL * 2;
+
+    int startRa  = (int) std::ceil (totalLongitudeUnits * (minTheta / (celestia::numbers::pi * 2.0)) / (float) raIncrement) * raIncrement;
+    int endRa    = (int) std::floor(totalLongitudeUnits * (maxTheta / (celestia::numbers::pi * 2.0)) / (float) raIncrement) * raIncrement;
+    int startDec = (int) std::ceil (DEG_MIN_SEC_TOTAL  * (minDec / celestia::numbers::pi) / (float) decIncrement) * decIncrement;
+    int endDec   = (int) std::floor(DEG_MIN_SEC_TOTAL  * (maxDec / celestia::numbers::pi) / (float) decIncrement) * decIncrement;
+
+    vector<LineStripEnd> vertices;
+    int lineCount = 0;
+
+    double arcStep = (maxTheta - minTheta) / (double) CACHED_ARC_SUBDIVISIONS;
+    for (int dec = startDec; dec <= endDec; dec += decIncrement)
+    {
+        double phi = celestia::numbers::pi * (double) dec / (double) DEG_MIN_SEC_TOTAL;
+        double cosPhi = cos(phi);
+        double sinPhi = sin(phi);
+
+        for (int j = 0; j <= CACHED_ARC_SUBDIVISIONS + 1; j++)
+        {
+            double theta = minTheta + j * arcStep;
+            auto x = (float) (cosPhi * std::cos(theta));
+            auto y = (float) (cosPhi * std::sin(theta));
+            auto z = (float) sinPhi;
+            Vector3f position = {x, z, -y};  // convert to Celestia coords
+            vertices.emplace_back(position, -0.5f);
+            vertices.emplace_back(position, 0.5f);
+        }
+        lineCount++;
+    }
+
+    // Render meridians only to the last latitude circle; this looks better
+    // than spokes radiating from the pole.
+    double maxMeridianAngle = celestia::numbers::pi / 2.0 * (1.0 - 2.0 * (double) decIncrement / (double) DEG_MIN_SEC_TOTAL);
+    double minPhi = std::max(minDec, -maxMeridianAngle);
+    double maxPhi = std::min(maxDec,  maxMeridianAngle);
+    arcStep = (maxPhi - minPhi) / (double) CACHED_ARC_SUBDIVISIONS;
+
+    for (int ra = startRa; ra <= endRa && minPhi < maxPhi; ra += raIncrement)
+    {
+        double theta = 2.0 * celestia::numbers::pi * (double) ra / (double) totalLongitudeUnits;
+        double cosTheta = cos(theta);
+        double sinTheta = sin(theta);
+
+        for (int j = 0; j <= CACHED_ARC_SUBDIVISIONS + 1; j++)
+        {
+            double phi = minPhi + j * arcStep;
+            auto x = (float) (cos(phi) * cosTheta);
+            auto y = (float) (cos(phi) * sinTheta);
+            auto z = (float) sin(phi);
+            Vector3f position = {x, z, -y};  // convert to Celestia coords
+            vertices.emplace_back(position, -0.5f);
+            vertices.emplace_back(position, 0.5f);
+        }
+        lineCount++;
+    }
+
+    if (m_lineBuffer == 0)
+        glGenBuffers(1, &m_lineBuffer);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, m_lineBuffer);
+    celestia::gl::bufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(LineStripEnd), vertices.data(), GL_STATIC_DRAW);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+
+    m_lineCount = lineCount;
+    m_linesRaIncrement = raIncrement;
+    m_linesDecIncrement = decIncrement;
+    m_linesLongitudeUnits = m_longitudeUnits;
+    m_linesMinTheta = minTheta;
+    m_linesMaxTheta = maxTheta;
+    m_linesMinDec = minDec;
+    m_linesMaxDec = maxDec;
+}
+
+
 void
 SkyGrid::render(Renderer& renderer,
                 const Observer& observer,
@@ -568,9 +721,17 @@ SkyGrid::render(Renderer& renderer,
         prog->lineWidthY = renderer.getLineWidthY();
     }
 
-    double arcStep = (maxTheta - minTheta) / (double) ARC_SUBDIVISIONS;
-    double theta0 = minTheta;
-    static vector<LineStripEnd> buffer(2 * (ARC_SUBDIVISIONS + 2), { Vector3f::Identity(), 1.0f });
+    if (!linesCover(minTheta, maxTheta, minDec, maxDec, raIncrement, decIncrement))
+        buildLines(minTheta, maxTheta, minDec, maxDec, raIncrement, decIncrement);
+
+    Renderer::PipelineState ps;
+    ps.blending = true;
+    ps.blendFunc = {GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA};
+    ps.smoothLines = true;
+    renderer.setPipelineState(ps);
+
+    constexpr GLsizei stripSize = 2 * (CACHED_ARC_SUBDIVISIONS + 2);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, m_lineBuffer);
     glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
     if (lineAsTriangles)
     {
@@ -578,46 +739,37 @@ SkyGrid::render(Renderer& renderer,
         glEnableVertexAttribArray(CelestiaGLProgram::ScaleFactorAttributeIndex);
 
         glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
-                              3, GL_FLOAT, GL_FALSE, sizeof(LineStripEnd), &buffer[0].point);
+                              3, GL_FLOAT, GL_FALSE, sizeof(LineStripEnd),
+                              reinterpret_cast<const void*>(offsetof(LineStripEnd, point)));
         glVertexAttribPointer(CelestiaGLProgram::NextVCoordAttributeIndex,
-                              3, GL_FLOAT, GL_FALSE, sizeof(LineStripEnd), &buffer[2].point);
+                              3, GL_FLOAT, GL_FALSE, sizeof(LineStripEnd),
+                              reinterpret_cast<const void*>(2 * sizeof(LineStripEnd) + offsetof(LineStripEnd, point)));
         glVertexAttribPointer(CelestiaGLProgram::ScaleFactorAttributeIndex,
-                              1, GL_FLOAT, GL_FALSE, sizeof(LineStripEnd), &buffer[0].scale);
+                              1, GL_FLOAT, GL_FALSE, sizeof(LineStripEnd),
+                              reinterpret_cast<const void*>(offsetof(LineStripEnd, scale)));
+
+        for (int i = 0; i < m_lineCount; i++)
+            celestia::gl::drawArrays(GL_TRIANGLE_STRIP, i * stripSize, 2 * (CACHED_ARC_SUBDIVISIONS + 1));
     }
     else
     {
         glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
-                              3, GL_FLOAT, GL_FALSE, sizeof(LineStripEnd) * 2, &buffer[0].point);
+                              3, GL_FLOAT, GL_FALSE, sizeof(LineStripEnd) * 2,
+                              reinterpret_cast<const void*>(offsetof(LineStripEnd, point)));
+
+        for (int i = 0; i < m_lineCount; i++)
+            celestia::gl::drawArrays(GL_LINE_STRIP, i * stripSize / 2, CACHED_ARC_SUBDIVISIONS + 1);
     }
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
 
+    // Place labels at the intersections of the view frustum planes and the
+    // visible parallels and meridians.
     for (int dec = startDec; dec <= endDec; dec += decIncrement)
     {
         double phi = celestia::numbers::pi * (double) dec / (double) DEG_MIN_SEC_TOTAL;
         double cosPhi = cos(phi);
         double sinPhi = sin(phi);
 
-        for (int j = 0; j <= ARC_SUBDIVISIONS + 1; j++)
-        {
-            double theta = theta0 + j * arcStep;
-            auto x = (float) (cosPhi * std::cos(theta));
-            auto y = (float) (cosPhi * std::sin(theta));
-            auto z = (float) sinPhi;
-            Vector3f position = {x, z, -y};  // convert to Celestia coords
-            buffer[2 * j] = {position, -0.5f};
-            buffer[2 * j + 1] =  {position, 0.5f};
-        }
-
-        Renderer::PipelineState ps;
-        ps.blending = true;
-        ps.blendFunc = {GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA};
-        ps.smoothLines = true;
-        renderer.setPipelineState(ps);
-
-        if (lineAsTriangles)
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, 2 * (ARC_SUBDIVISIONS + 1));
-        else
-            glDrawArrays(GL_LINE_STRIP, 0, ARC_SUBDIVISIONS + 1);
-
         // Place labels at the intersections of the view frustum planes
         // and the parallels.
         Vector3d center(0.0, 0.0, sinPhi);
@@ -665,16 +817,9 @@ SkyGrid::render(Renderer& renderer,
         }
     }
 
-    // Draw the meridians
-
-    // Render meridians only to the last latitude circle; this looks better
-    // than spokes radiating from the pole.
+    // Meridian labels are only placed up to the last latitude circle, where
+    // the meridians end.
     double maxMeridianAngle = celestia::numbers::pi / 2.0 * (1.0 - 2.0 * (double) decIncrement / (double) DEG_MIN_SEC_TOTAL);
-    minDec = std::max(minDec, -maxMeridianAngle);
-    maxDec = std::min(maxDec,  maxMeridianAngle);
-    arcStep = (maxDec - minDec) / (double) ARC_SUBDIVISIONS;
-    double phi0 = minDec;
-
     double cosMaxMeridianAngle = cos(maxMeridianAngle);
 
     for (int ra = startRa; ra <= endRa; ra += raIncrement)
@@ -683,21 +828,6 @@ SkyGrid::render(Renderer& renderer,
         double cosTheta = cos(theta);
         double sinTheta = sin(theta);
 
-        for (int j = 0; j <= ARC_SUBDIVISIONS + 1; j++)
-        {
-            double phi = phi0 + j * arcStep;
-            auto x = (float) (cos(phi) * cosTheta);
-            auto y = (float) (cos(phi) * sinTheta);
-            auto z = (float) sin(phi);
-            Vector3f position = {x, z, -y};  // convert to Celestia coords
-            buffer[2 * j] = {position, -0.5f};
-            buffer[2 * j + 1] =  {position, 0.5f};
-        }
-        if (lineAsTriangles)
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, 2 * (ARC_SUBDIVISIONS + 1));
-        else
-            glDrawArrays(GL_LINE_STRIP, 0, ARC_SUBDIVISIONS + 1);
-
         // Place labels at the intersections of the view frustum planes
         // and the meridians.
         Vector3d center(0.0, 0.0, 0.0);
@@ -786,13 +916,13 @@ SkyGrid::render(Renderer& renderer,
                               3, GL_FLOAT, GL_FALSE, sizeof(float) * 7, lineAsTriangleVertices.data() + 3);
         glVertexAttribPointer(CelestiaGLProgram::ScaleFactorAttributeIndex,
                               1, GL_FLOAT, GL_FALSE, sizeof(float) * 7, lineAsTriangleVertices.data() + 6);
-        glDrawElements(GL_TRIANGLES, lineAsTriangleIndcies.size(), GL_UNSIGNED_SHORT, lineAsTriangleIndcies.data());
+        celestia::gl::drawElements(GL_TRIANGLES, lineAsTriangleIndcies.size(), GL_UNSIGNED_SHORT, lineAsTriangleIndcies.data());
     }
     else
     {
         glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
                               3, GL_FLOAT, GL_FALSE, sizeof(float) * 7 * 2, lineAsTriangleVertices.data());
-        glDrawArrays(GL_LINES, 0, 8);
+        celestia::gl::drawArrays(GL_LINES, 0, 8);
     }
 
     glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
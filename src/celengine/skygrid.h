@@ -17,6 +17,7 @@
 #include <celutil/color.h>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
+#include "glsupport.h"
 
 class Renderer;
 class Observer;
@@ -38,7 +39,9 @@ public:
     };
 
     SkyGrid() = default;
-    ~SkyGrid() = default;
+    ~SkyGrid();
+    SkyGrid(const SkyGrid&) = delete;
+    SkyGrid& operator=(const SkyGrid&) = delete;
 
     void render(Renderer& renderer,
                 const Observer& observer,
@@ -104,6 +107,12 @@ private:
     std::string longitudeLabel(int longitude, int longitudeStep) const;
     int parallelSpacing(double idealSpacing) const;
     int meridianSpacing(double idealSpacing) const;
+    bool linesCover(double minTheta, double maxTheta,
+                    double minDec, double maxDec,
+                    int raIncrement, int decIncrement) const;
+    void buildLines(double minTheta, double maxTheta,
+                    double minDec, double maxDec,
+                    int raIncrement, int decIncrement);
 
 private:
     Eigen::Quaterniond m_orientation{ Eigen::Quaterniond::Identity() };
@@ -111,6 +120,20 @@ private:
     Color m_labelColor{ Color::White };
     LongitudeUnits m_longitudeUnits{ LongitudeHours };
     LongitudeDirection m_longitudeDirection{ IncreasingCounterclockwise };
+
+    // Parallels and meridians of a region of the sky somewhat larger than
+    // the view, in the grid frame. They are rebuilt only when the view
+    // leaves the region or the line spacing changes; the orientation of
+    // the grid is applied by the modelview matrix.
+    GLuint m_lineBuffer{ 0 };
+    int m_lineCount{ 0 };
+    int m_linesRaIncrement{ 0 };
+    int m_linesDecIncrement{ 0 };
+    LongitudeUnits m_linesLongitudeUnits{ LongitudeHours };
+    double m_linesMinTheta{ 0.0 };
+    double m_linesMaxTheta{ 0.0 };
+    double m_linesMinDec{ 0.0 };
+    double m_linesMaxDec{ 0.0 };
 };
 
 #endif // _CELENGINE_PLANETGRID_H_
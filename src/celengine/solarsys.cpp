@@ -26,10 +26,12 @@
 #include "universe.h"
 #include "multitexture.h"
 #include "parseobject.h"
+#include "ephemeriscache.h"
 #include "frametree.h"
 #include "timeline.h"
 #include "timelinephase.h"
 #include "atmosphere.h"
+#include "scatteringtable.h"
 
 using namespace Eigen;
 using namespace std;
@@ -339,7 +341,8 @@ TimelinePhase::SharedConstPtr CreateTimelinePhase(Body* body,
     bool usePlanetUnits = orbitFrame->getCenter().star() != nullptr;
 
     // Get the orbit
-    Orbit* orbit = CreateOrbit(orbitFrame->getCenter(), phaseData, path, usePlanetUnits);
+    EphemerisCache* cache = universe.getEphemerisCache();
+    Orbit* orbit = CreateOrbit(orbitFrame->getCenter(), phaseData, path, usePlanetUnits, cache);
     if (!orbit)
     {
         GetLogger()->error("Error: missing orbit in timeline phase.\n");
@@ -349,13 +352,13 @@ TimelinePhase::SharedConstPtr CreateTimelinePhase(Body* body,
     // Get the rotation model
     // TIMELINE-TODO: default rotation model is UniformRotation with a period
     // equal to the orbital period. Should we do something else?
-    RotationModel* rotationModel = CreateRotationModel(phaseData, path, orbit->getPeriod());
+    RotationModel* rotationModel = CreateRotationModel(phaseData, path, orbit->getPeriod(), cache);
     if (!rotationModel)
     {
         // TODO: Should distinguish between a missing rotation model (where it's
         // appropriate to use a default one) and a bad rotation model (where
         // we should report an error.)
-        rotationModel = new ConstantOrientation(Quaterniond::Identity());
+        rotationModel = cache->constantOrientation(Quaterniond::Identity());
     }
 
     auto phase = TimelinePhase::CreateTimelinePhase(universe,
@@ -451,7 +454,7 @@ static bool CreateTimeline(Body* body,
     ReferenceFrame::SharedConstPtr defaultBodyFrame;
     if (bodyType == SurfaceObject)
     {
-        defaultOrbitFrame = shared_ptr<BodyFixedFrame>(new BodyFixedFrame(parentObject, parentObject));
+        defaultOrbitFrame = universe.getEphemerisCache()->bodyFixedFrame(parentObject, parentObject);
         defaultBodyFrame = CreateTopocentricFrame(parentObject, parentObject, Selection(body));
     }
     else
@@ -552,7 +555,8 @@ static bool CreateTimeline(Body* body,
     // in AU; otherwise, use kilometers.
     orbitsPlanet = orbitFrame->getCenter().star() == nullptr;
 
-    Orbit* newOrbit = CreateOrbit(orbitFrame->getCenter(), planetData, path, !orbitsPlanet);
+    EphemerisCache* cache = universe.getEphemerisCache();
+    Orbit* newOrbit = CreateOrbit(orbitFrame->getCenter(), planetData, path, !orbitsPlanet, cache);
     if (newOrbit == nullptr && orbit == nullptr)
     {
         if (body->getTimeline() && disposition == DataDisposition::Modify)
@@ -581,7 +585,7 @@ static bool CreateTimeline(Body* body,
 
     // Get the rotation model for this body
     double syncRotationPeriod = orbit->getPeriod();
-    RotationModel* newRotationModel = CreateRotationModel(planetData, path, syncRotationPeriod);
+    RotationModel* newRotationModel = CreateRotationModel(planetData, path, syncRotationPeriod, cache);
 
     // If a new rotation model was given, override the old one
     if (newRotationModel != nullptr)
@@ -597,7 +601,7 @@ static bool CreateTimeline(Body* body,
         // If no rotation model is provided, use a default rotation model--
         // a uniform rotation that's synchronous with the orbit (appropriate
         // for nearly all natural satellites in the solar system.)
-        rotationModel = CreateDefaultRotationModel(syncRotationPeriod);
+        rotationModel = CreateDefaultRotationModel(syncRotationPeriod, cache);
     }
 
     if (ParseDate(planetData, "Beginning", beginning))
@@ -613,8 +617,8 @@ static bool CreateTimeline(Body* body,
     {
         if (beginning >= ending)
         {
+            // The rotation model may be shared, see EphemerisCache
             GetLogger()->error("Beginning time must be before Ending time.\n");
-            delete rotationModel;
             return false;
         }
 
@@ -960,6 +964,15 @@ static Body* CreateBody(const string& name,
                                                            TextureInfo::WrapTexture);
                 }
 
+                string scatteringTable;
+                if (atmosData->getString("ScatteringTable", scatteringTable))
+                {
+                    fs::path filename = fs::path("data") / scatteringTable;
+                    if (!path.empty() && fs::exists(path / "data" / scatteringTable))
+                        filename = path / "data" / scatteringTable;
+                    atmosphere->scatteringTable = std::make_shared<ScatteringTable>(filename);
+                }
+
                 double cloudShadowDepth = 0.0;
                 if (atmosData->getNumber("CloudShadowDepth", cloudShadowDepth))
                 {
@@ -1103,13 +1116,13 @@ static Body* CreateReferencePoint(const string& name,
 }
 
 
-bool LoadSolarSystemObjects(istream& in,
-                            Universe& universe,
-                            const fs::path& directory)
+static bool LoadSolarSystemObjects(Tokenizer& tokenizer,
+                                   Parser& parser,
+                                   Universe& universe,
+                                   const fs::path& directory,
+                                   vector<Body*>* bodies,
+                                   bool reload)
 {
-    Tokenizer tokenizer(&in);
-    Parser parser(&tokenizer);
-
 #ifdef ENABLE_NLS
     string s = directory.string();
     const char* d = s.c_str();
@@ -1252,6 +1265,9 @@ bool LoadSolarSystemObjects(istream& in,
                 Body* existingBody = parentSystem->find(primaryName);
                 if (existingBody)
                 {
+                    if (reload && disposition == DataDisposition::Add)
+                        disposition = DataDisposition::Replace;
+
                     if (disposition == DataDisposition::Add)
                     {
                         sscError(tokenizer, fmt::sprintf(_("warning duplicate definition of %s %s\n"), parentName, primaryName));
@@ -1274,6 +1290,8 @@ bool LoadSolarSystemObjects(istream& in,
                     if (disposition == DataDisposition::Add)
                         for (const auto& name : names)
                             body->addAlias(name);
+                    if (bodies != nullptr)
+                        bodies->push_back(body);
                 }
             }
         }
@@ -1292,9 +1310,16 @@ bool LoadSolarSystemObjects(istream& in,
             if (parent.body() != nullptr)
             {
                 Location* location = CreateLocation(objectData, parent.body());
-                location->loadCategories(objectData, disposition, directory.string());
-                if (location != nullptr)
+                Location* existingLocation = reload ? parent.body()->findLocation(primaryName) : nullptr;
+                if (location != nullptr && existingLocation != nullptr)
+                {
+                    parent.body()->updateLocation(existingLocation, *location);
+                    existingLocation->loadCategories(objectData, DataDisposition::Replace, directory.string());
+                    delete location;
+                }
+                else if (location != nullptr)
                 {
+                    location->loadCategories(objectData, disposition, directory.string());
                     location->setName(primaryName);
                     parent.body()->addLocation(location);
                 }
@@ -1316,6 +1341,39 @@ bool LoadSolarSystemObjects(istream& in,
 }
 
 
+bool LoadSolarSystemObjects(istream& in,
+                            Universe& universe,
+                            const fs::path& directory,
+                            vector<Body*>* bodies)
+{
+    Tokenizer tokenizer(&in);
+    Parser parser(&tokenizer);
+    return LoadSolarSystemObjects(tokenizer, parser, universe, directory, bodies, false);
+}
+
+
+bool LoadSolarSystemObjects(PreparsedCatalog& catalog,
+                            Universe& universe,
+                            const fs::path& directory,
+                            vector<Body*>* bodies)
+{
+    Tokenizer tokenizer(catalog.getTokens());
+    Parser parser(&tokenizer, &catalog);
+    return LoadSolarSystemObjects(tokenizer, parser, universe, directory, bodies, false);
+}
+
+
+bool ReloadSolarSystemObjects(istream& in,
+                              Universe& universe,
+                              const fs::path& directory,
+                              vector<Body*>* bodies)
+{
+    Tokenizer tokenizer(&in);
+    Parser parser(&tokenizer);
+    return LoadSolarSystemObjects(tokenizer, parser, universe, directory, bodies, true);
+}
+
+
 SolarSystem::SolarSystem(Star* _star) :
     star(_star),
     planets(nullptr),
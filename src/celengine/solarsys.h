@@ -13,6 +13,7 @@
 #include <vector>
 #include <map>
 #include <iostream>
+#include <unordered_map>
 #include <celengine/body.h>
 #include <celengine/stardb.h>
 
@@ -35,13 +36,29 @@ class SolarSystem
     FrameTree* frameTree;
 };
 
-typedef std::map<uint32_t, SolarSystem*> SolarSystemCatalog;
+typedef std::unordered_map<uint32_t, SolarSystem*> SolarSystemCatalog;
 
+class PreparsedCatalog;
 class Universe;
 
+// If bodies isn't null, the bodies and reference points defined by the
+// catalog are appended to it
 bool LoadSolarSystemObjects(std::istream& in,
                             Universe& universe,
-                            const fs::path& dir = fs::path());
+                            const fs::path& dir = fs::path(),
+                            std::vector<Body*>* bodies = nullptr);
+bool LoadSolarSystemObjects(PreparsedCatalog& catalog,
+                            Universe& universe,
+                            const fs::path& dir = fs::path(),
+                            std::vector<Body*>* bodies = nullptr);
+
+// Load a catalog again after it was edited. Bodies and locations that
+// already exist are replaced in place, as if their disposition was
+// Replace, so that pointers to them stay valid.
+bool ReloadSolarSystemObjects(std::istream& in,
+                              Universe& universe,
+                              const fs::path& dir,
+                              std::vector<Body*>* bodies);
 
 #endif // _SOLARSYS_H_
 
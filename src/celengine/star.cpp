@@ -8,7 +8,10 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <mutex>
 #include <fmt/format.h>
 #include <celephem/orbit.h>
 #include <celmath/mathlib.h>
@@ -21,6 +24,13 @@ using namespace Eigen;
 using namespace std;
 using namespace celmath;
 
+namespace
+{
+// Guards registration and removal of StarDetails indices
+std::mutex indexMutex;
+std::uint32_t lastIndex = 0;
+}
+
 
 // #define SOLAR_TEMPERATURE    5780.0f
 // https://arxiv.org/abs/1510.07674
@@ -825,6 +835,46 @@ StarDetails::StarDetails(const StarDetails& sd) :
 StarDetails::~StarDetails()
 {
     delete orbitingStars;
+
+    std::uint32_t i = index.load(std::memory_order_relaxed);
+    if (i != 0)
+    {
+        std::lock_guard<std::mutex> lock(indexMutex);
+        indexBlocks[i >> IndexBlockBits].load(std::memory_order_relaxed)[i & (IndexBlockSize - 1)] = nullptr;
+    }
+}
+
+
+std::atomic<StarDetails**> StarDetails::indexBlocks[1u << (32 - StarDetails::IndexBlockBits)];
+
+
+std::uint32_t
+StarDetails::getIndex(StarDetails* sd)
+{
+    if (sd == nullptr)
+        return 0;
+
+    std::uint32_t i = sd->index.load(std::memory_order_acquire);
+    if (i != 0)
+        return i;
+
+    std::lock_guard<std::mutex> lock(indexMutex);
+    i = sd->index.load(std::memory_order_relaxed);
+    if (i != 0)
+        return i;
+
+    // Index 0 is reserved for nullptr
+    i = ++lastIndex;
+    assert(i != 0);
+    StarDetails** block = indexBlocks[i >> IndexBlockBits].load(std::memory_order_relaxed);
+    if (block == nullptr)
+    {
+        block = new StarDetails*[IndexBlockSize]();
+        indexBlocks[i >> IndexBlockBits].store(block, std::memory_order_release);
+    }
+    block[i & (IndexBlockSize - 1)] = sd;
+    sd->index.store(i, std::memory_order_release);
+    return i;
 }
 
 
@@ -963,8 +1013,8 @@ Star::~Star()
     // TODO: Implement reference counting for StarDetails objects so that
     // we can enable this.
 #if 0
-    if (!details->shared())
-        delete details;
+    if (!details()->shared())
+        delete details();
 #endif
 }
 
@@ -972,8 +1022,8 @@ Star::~Star()
 // Return the radius of the star in kilometers
 float Star::getRadius() const
 {
-    if (details->getKnowledge(StarDetails::KnowRadius))
-        return details->getRadius();
+    if (details()->getKnowledge(StarDetails::KnowRadius))
+        return details()->getRadius();
 
 #ifdef NO_BOLOMETRIC_MAGNITUDE_CORRECTION
     auto lum = getLuminosity();
@@ -1022,7 +1072,7 @@ Star::getPosition(double t) const
     const Orbit* orbit = getOrbit();
     if (orbit == nullptr)
     {
-        return UniversalCoord::CreateLy(position.cast<double>());
+        return UniversalCoord::CreateLy(getPositionAfter(GetMotionYears(t)).cast<double>());
     }
     else
     {
@@ -1030,7 +1080,7 @@ Star::getPosition(double t) const
 
         if (barycenter == nullptr)
         {
-            UniversalCoord barycenterPos = UniversalCoord::CreateLy(position.cast<double>());
+            UniversalCoord barycenterPos = UniversalCoord::CreateLy(getPositionAfter(GetMotionYears(t)).cast<double>());
             return UniversalCoord(barycenterPos).offsetKm(orbit->positionAtTime(t));
         }
         else
@@ -1048,7 +1098,7 @@ Star::getOrbitBarycenterPosition(double t) const
 
     if (barycenter == nullptr)
     {
-        return UniversalCoord::CreateLy(position.cast<double>());
+        return UniversalCoord::CreateLy(getPositionAfter(GetMotionYears(t)).cast<double>());
     }
     else
     {
@@ -1062,12 +1112,17 @@ Star::getOrbitBarycenterPosition(double t) const
 Vector3d
 Star::getVelocity(double t) const
 {
+    // Space motion in km per day, which stops at the ends of the time span
+    Vector3d motion = Vector3d::Zero();
+    if (std::abs(t - astro::J2000) < motionTimeSpan * DAYS_PER_YEAR)
+        motion = velocity.cast<double>() * (KM_PER_LY / DAYS_PER_YEAR);
+
     const Orbit* orbit = getOrbit();
     if (orbit == nullptr)
     {
         // The star doesn't have a defined orbit, so the velocity is just
-        // zero. (This will change when stellar proper motion is implemented.)
-        return Vector3d::Zero();
+        // its space motion.
+        return motion;
     }
     else
     {
@@ -1075,9 +1130,9 @@ Star::getVelocity(double t) const
 
         if (barycenter == nullptr)
         {
-            // Star orbit is defined around a fixed point, so the total velocity
-            // is just the star's orbit velocity.
-            return orbit->velocityAtTime(t);
+            // Star orbit is defined around a point moving with the star,
+            // so the total velocity is the sum of both.
+            return motion + orbit->velocityAtTime(t);
         }
         else
         {
@@ -1091,14 +1146,14 @@ Star::getVelocity(double t) const
 MultiResTexture
 Star::getTexture() const
 {
-    return details->getTexture();
+    return details()->getTexture();
 }
 
 
 ResourceHandle
 Star::getGeometry() const
 {
-    return details->getGeometry();
+    return details()->getGeometry();
 }
 
 
@@ -1108,7 +1163,7 @@ Star::getGeometry() const
 const string&
 Star::getInfoURL() const
 {
-    return details->getInfoURL();
+    return details()->getInfoURL();
 }
 
 void Star::setPosition(float x, float y, float z)
@@ -1126,6 +1181,29 @@ void Star::setAbsoluteMagnitude(float mag)
     absMag = mag;
 }
 
+void Star::setSpaceVelocity(const Vector3f& velocityLyPerYear)
+{
+    velocity = velocityLyPerYear;
+}
+
+float Star::motionTimeSpan = 10000.0f;
+
+void Star::SetMotionTimeSpan(float years)
+{
+    motionTimeSpan = std::max(years, 0.0f);
+}
+
+float Star::GetMotionTimeSpan()
+{
+    return motionTimeSpan;
+}
+
+float Star::GetMotionYears(double t)
+{
+    auto years = static_cast<float>((t - astro::J2000) / DAYS_PER_YEAR);
+    return std::clamp(years, -motionTimeSpan, motionTimeSpan);
+}
+
 
 float Star::getApparentMagnitude(float ly) const
 {
@@ -1158,39 +1236,39 @@ float Star::getBolometricLuminosity() const
 
 StarDetails* Star::getDetails() const
 {
-    return details;
+    return details();
 }
 
 void Star::setDetails(StarDetails* sd)
 {
     // TODO: delete existing details if they aren't shared
-    details = sd;
+    detailsIndex = StarDetails::getIndex(sd);
 }
 
 void Star::setOrbitBarycenter(Star* s)
 {
-    if (details->shared())
-        details = new StarDetails(*details);
-    details->setOrbitBarycenter(s);
+    if (details()->shared())
+        setDetails(new StarDetails(*details()));
+    details()->setOrbitBarycenter(s);
 }
 
 void Star::computeOrbitalRadius()
 {
-    details->computeOrbitalRadius();
+    details()->computeOrbitalRadius();
 }
 
 void
 Star::setRotationModel(const RotationModel* rm)
 {
-    details->setRotationModel(rm);
+    details()->setRotationModel(rm);
 }
 
 void
 Star::addOrbitingStar(Star* star)
 {
-    if (details->shared())
-        details = new StarDetails(*details);
-    details->addOrbitingStar(star);
+    if (details()->shared())
+        setDetails(new StarDetails(*details()));
+    details()->addOrbitingStar(star);
 }
 
 Selection Star::toSelection()
@@ -20,6 +20,8 @@
 #include <celengine/multitexture.h>
 #include <celephem/rotation.h>
 #include <Eigen/Core>
+#include <atomic>
+#include <cstdint>
 #include <vector>
 
 class Selection;
@@ -73,6 +75,12 @@ class StarDetails
     bool shared() const;
     inline bool hasCorona() const;
 
+    // Stars refer to their details by a 32-bit index rather than a
+    // pointer to keep the Star objects small. getIndex() assigns an index
+    // to sd on first use; the index of nullptr is 0.
+    static std::uint32_t getIndex(StarDetails* sd);
+    static inline StarDetails* fromIndex(std::uint32_t index);
+
     enum
     {
         KnowRadius   = 0x1,
@@ -112,6 +120,14 @@ class StarDetails
     std::vector<Star*>* orbitingStars{ nullptr };
     bool isShared{ true };
 
+    std::atomic<std::uint32_t> index{ 0 };
+
+    // The index table is allocated in blocks that never move, so it can
+    // be read while details are registered by another thread.
+    static constexpr unsigned int IndexBlockBits = 16;
+    static constexpr std::uint32_t IndexBlockSize = 1u << IndexBlockBits;
+    static std::atomic<StarDetails**> indexBlocks[1u << (32 - IndexBlockBits)];
+
  public:
     struct StarTextureSet
     {
@@ -277,6 +293,31 @@ public:
     void setPosition(float, float, float);
     void setPosition(const Eigen::Vector3f& positionLy);
     void setAbsoluteMagnitude(float);
+
+    // Space motion of the star from its catalog position at the J2000
+    // epoch, in light years per Julian year; zero for most stars.
+    Eigen::Vector3f getSpaceVelocity() const
+    {
+        return velocity;
+    }
+
+    void setSpaceVelocity(const Eigen::Vector3f& velocityLyPerYear);
+
+    // The approximate position of the star after the given years of space
+    // motion, see GetMotionYears()
+    Eigen::Vector3f getPositionAfter(float years) const
+    {
+        return position + velocity * years;
+    }
+
+    // Stars move for at most this many years either way from J2000, so
+    // that the star octree can allow for the distance they cover; beyond
+    // that they stay at the ends of their paths. Must be set before the
+    // star catalogs are loaded.
+    static void SetMotionTimeSpan(float years);
+    static float GetMotionTimeSpan();
+    // Years of space motion at the time t, limited to the time span
+    static float GetMotionYears(double t);
     void setLuminosity(float);
 
     StarDetails* getDetails() const;
@@ -313,76 +354,93 @@ public:
 
 private:
     Eigen::Vector3f position{ Eigen::Vector3f::Zero() };
+    Eigen::Vector3f velocity{ Eigen::Vector3f::Zero() };
     float absMag{ 4.83f };
     float extinction{ 0.0f };
-    StarDetails* details{ nullptr };
+    std::uint32_t detailsIndex{ 0 };
+
+    StarDetails* details() const
+    {
+        return StarDetails::fromIndex(detailsIndex);
+    }
+
+    static float motionTimeSpan;
 };
 
 
+StarDetails*
+StarDetails::fromIndex(std::uint32_t index)
+{
+    if (index == 0)
+        return nullptr;
+    return indexBlocks[index >> IndexBlockBits].load(std::memory_order_acquire)[index & (IndexBlockSize - 1)];
+}
+
+
 float
 Star::getTemperature() const
 {
-    return details->getTemperature();
+    return details()->getTemperature();
 }
 
 const char*
 Star::getSpectralType() const
 {
-    return details->getSpectralType();
+    return details()->getSpectralType();
 }
 
 float
 Star::getBolometricMagnitude() const
 {
-    return absMag + details->getBolometricCorrection();
+    return absMag + details()->getBolometricCorrection();
 }
 
 Orbit*
 Star::getOrbit() const
 {
-    return details->getOrbit();
+    return details()->getOrbit();
 }
 
 float
 Star::getOrbitalRadius() const
 {
-    return details->getOrbitalRadius();
+    return details()->getOrbitalRadius();
 }
 
 Star*
 Star::getOrbitBarycenter() const
 {
-    return details->getOrbitBarycenter();
+    return details()->getOrbitBarycenter();
 }
 
 bool
 Star::getVisibility() const
 {
-    return details->getVisibility();
+    return details()->getVisibility();
 }
 
 const RotationModel*
 Star::getRotationModel() const
 {
-    return details->getRotationModel();
+    return details()->getRotationModel();
 }
 
 Eigen::Vector3f
 Star::getEllipsoidSemiAxes() const
 {
-    return details->getEllipsoidSemiAxes();
+    return details()->getEllipsoidSemiAxes();
 }
 
 const std::vector<Star*>*
 Star::getOrbitingStars() const
 {
-    return details->orbitingStars;
+    return details()->orbitingStars;
 }
 
 bool
 Star::hasCorona() const
 {
-    return details->hasCorona();
+    return details()->hasCorona();
 }
 
 #endif // _CELENGINE_STAR_H_
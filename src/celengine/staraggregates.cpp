@@ -0,0 +1,128 @@
+// staraggregates.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Combined light of the stars below each node of the star octree.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "staraggregates.h"
+
+namespace
+{
+
+// Flux relative to a star of absolute magnitude zero
+inline float
+magToFlux(float absMag)
+{
+    return std::pow(10.0f, -0.4f * absMag);
+}
+
+} // end unnamed namespace
+
+StarAggregates::StarAggregates(const FlatStarOctree& octree)
+{
+    std::uint32_t nNodes = octree.nodeCount();
+    brightest.assign(nNodes, std::numeric_limits<float>::infinity());
+    faintest.assign(nNodes, -std::numeric_limits<float>::infinity());
+    centroids.assign(nNodes, Eigen::Vector3f::Zero());
+    temperatures.assign(nNodes, 0.0f);
+    bins.assign(static_cast<std::size_t>(nNodes) * BinCount, 0.0f);
+
+    // Children come after their parent, so going backwards they are
+    // complete before the parent sums them up. The centroid and the
+    // temperature are summed weighted by flux first.
+    std::vector<float> totalFlux(nNodes, 0.0f);
+    for (std::uint32_t index = nNodes; index-- > 0;)
+    {
+        FlatStarOctree::Node node = octree.node(index);
+        float* nodeBins = &bins[static_cast<std::size_t>(index) * BinCount];
+
+        for (std::uint32_t i = 0; i < node.objectCount; ++i)
+        {
+            const Star& star = node.firstObject[i];
+            float absMag = star.getAbsoluteMagnitude();
+            float f = magToFlux(absMag);
+            auto bin = static_cast<int>(std::floor(absMag - MinBinMag));
+            nodeBins[std::clamp(bin, 0, static_cast<int>(BinCount) - 1)] += f;
+
+            brightest[index] = std::min(brightest[index], absMag);
+            faintest[index] = std::max(faintest[index], absMag);
+            centroids[index] += star.getPosition() * f;
+            temperatures[index] += star.getTemperature() * f;
+            totalFlux[index] += f;
+        }
+
+        if (node.firstChild != 0)
+        {
+            for (std::uint32_t child = node.firstChild; child < node.firstChild + 8; ++child)
+            {
+                const float* childBins = &bins[static_cast<std::size_t>(child) * BinCount];
+                for (unsigned int bin = 0; bin < BinCount; ++bin)
+                    nodeBins[bin] += childBins[bin];
+
+                brightest[index] = std::min(brightest[index], brightest[child]);
+                faintest[index] = std::max(faintest[index], faintest[child]);
+                centroids[index] += centroids[child];
+                temperatures[index] += temperatures[child];
+                totalFlux[index] += totalFlux[child];
+            }
+        }
+    }
+
+    // The weighted sums of the children are needed until their parent is
+    // done, so the means are only taken now
+    for (std::uint32_t index = 0; index < nNodes; ++index)
+    {
+        if (totalFlux[index] > 0.0f)
+        {
+            centroids[index] /= totalFlux[index];
+            temperatures[index] /= totalFlux[index];
+        }
+        else
+        {
+            centroids[index] = octree.node(index).center;
+        }
+    }
+}
+
+float
+StarAggregates::flux(std::uint32_t node, float distance, float brightMag, float limitingMag) const
+{
+    // The apparent magnitude range of a bin is its absolute magnitude
+    // range shifted by the distance modulus
+    float modulus = astro::absToAppMag(0.0f, distance);
+    const float* nodeBins = &bins[static_cast<std::size_t>(node) * BinCount];
+    float f = 0.0f;
+    for (unsigned int bin = 0; bin < BinCount; ++bin)
+    {
+        float low = MinBinMag + static_cast<float>(bin) + modulus;
+        float fraction = std::min(low + 1.0f, limitingMag) - std::max(low, brightMag);
+        if (fraction > 0.0f)
+            f += nodeBins[bin] * std::min(fraction, 1.0f);
+    }
+    return f;
+}
+
+float
+StarAggregates::getAbsoluteMagnitude(std::uint32_t node) const
+{
+    const float* nodeBins = &bins[static_cast<std::size_t>(node) * BinCount];
+    float f = 0.0f;
+    for (unsigned int bin = 0; bin < BinCount; ++bin)
+        f += nodeBins[bin];
+    return f > 0.0f ? -2.5f * std::log10(f) : std::numeric_limits<float>::infinity();
+}
+
+std::size_t
+StarAggregates::memoryUsage() const
+{
+    return (brightest.capacity() + faintest.capacity() + temperatures.capacity() + bins.capacity()) * sizeof(float)
+         + centroids.capacity() * sizeof(Eigen::Vector3f);
+}
@@ -0,0 +1,144 @@
+// staraggregates.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Combined light of the stars below each node of the star octree.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <celengine/staroctree.h>
+
+// StarAggregates stores for each node of a star octree the light of all
+// of the stars in its subtree: their flux in bins of absolute magnitude,
+// its centroid and its mean temperature. A node far enough away that it
+// covers about a pixel can then be drawn as a single point standing in
+// for all of its faint stars, which would otherwise be enumerated one by
+// one only to land in the same pixel.
+//
+// Magnitudes are handled in bins of one magnitude, from the distance to
+// the centroid of a node; a bin partly in a range of apparent magnitudes
+// contributes the same part of its flux. Extinction is ignored.
+class StarAggregates
+{
+ public:
+    explicit StarAggregates(const FlatStarOctree& octree);
+    StarAggregates(const StarAggregates&) = delete;
+    StarAggregates& operator=(const StarAggregates&) = delete;
+
+    // Visit the stars inside the view frustum with an apparent magnitude
+    // from brightMag to limitingMag. The stars of nodes whose bounding
+    // sphere is seen under an angle smaller than maxAngle radians are
+    // combined, and each such node is passed to the visitor as
+    //     aggregateVisitor(const Eigen::Vector3f& position, float absMag, float temperature)
+    // with the absolute magnitude of their summed flux. The stars of the
+    // other nodes are passed as
+    //     starVisitor(const Star* stars, std::uint32_t nStars)
+    // and have to be selected by magnitude by the caller.
+    template <class STAR_VISITOR, class AGGREGATE_VISITOR>
+    void visit(STAR_VISITOR&&                    starVisitor,
+               AGGREGATE_VISITOR&&               aggregateVisitor,
+               const FlatStarOctree&             octree,
+               const Eigen::Vector3f&            obsPosition,
+               const Eigen::Hyperplane<float, 3>* frustumPlanes,
+               float                             brightMag,
+               float                             limitingMag,
+               float                             maxAngle) const;
+
+    // Absolute magnitude of all of the stars below a node together
+    float getAbsoluteMagnitude(std::uint32_t node) const;
+    std::uint32_t nodeCount() const { return static_cast<std::uint32_t>(brightest.size()); }
+    std::size_t memoryUsage() const;
+
+ private:
+    static constexpr float MinBinMag = -6.0f;
+    static constexpr unsigned int BinCount = 24;
+
+    // Flux of the stars of a node from brightMag to limitingMag, seen from
+    // distance light years away
+    float flux(std::uint32_t node, float distance, float brightMag, float limitingMag) const;
+
+    // Smallest and largest absolute magnitudes of the stars below a node,
+    // infinite for nodes without stars
+    std::vector<float> brightest;
+    std::vector<float> faintest;
+    std::vector<Eigen::Vector3f> centroids;
+    std::vector<float> temperatures;
+    // BinCount values per node
+    std::vector<float> bins;
+};
+
+
+template <class STAR_VISITOR, class AGGREGATE_VISITOR>
+void
+StarAggregates::visit(STAR_VISITOR&&                    starVisitor,
+                      AGGREGATE_VISITOR&&               aggregateVisitor,
+                      const FlatStarOctree&             octree,
+                      const Eigen::Vector3f&            obsPosition,
+                      const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                      float                             brightMag,
+                      float                             limitingMag,
+                      float                             maxAngle) const
+{
+    constexpr float SQRT3 = 1.732050807568877f;
+
+    if (nodeCount() == 0)
+        return;
+
+    std::vector<std::uint32_t> stack;
+    stack.push_back(0);
+    while (!stack.empty())
+    {
+        std::uint32_t index = stack.back();
+        stack.pop_back();
+        if (brightest[index] > faintest[index])
+            continue;
+
+        FlatStarOctree::Node node = octree.node(index);
+        float radius = node.scale * SQRT3;
+
+        bool outside = false;
+        for (unsigned int i = 0; i < 5; ++i)
+            outside = outside || frustumPlanes[i].signedDistance(node.center) < -radius;
+        if (outside)
+            continue;
+
+        float distance = (node.center - obsPosition).norm();
+        if (distance > radius)
+        {
+            // All of the stars are too faint, or bright enough to be drawn
+            // by themselves
+            if (astro::absToAppMag(brightest[index], distance - radius) >= limitingMag ||
+                astro::absToAppMag(faintest[index], distance + radius) < brightMag)
+            {
+                continue;
+            }
+
+            if (radius < maxAngle * distance)
+            {
+                const Eigen::Vector3f& centroid = centroids[index];
+                float f = flux(index, (centroid - obsPosition).norm(), brightMag, limitingMag);
+                if (f > 0.0f)
+                    aggregateVisitor(centroid, -2.5f * std::log10(f), temperatures[index]);
+                continue;
+            }
+        }
+
+        if (node.objectCount > 0)
+            starVisitor(node.firstObject, node.objectCount);
+        if (node.firstChild != 0)
+        {
+            for (std::uint32_t i = 0; i < 8; ++i)
+                stack.push_back(node.firstChild + i);
+        }
+    }
+}
@@ -13,11 +13,15 @@
 #include <cstdlib>
 #include <cassert>
 #include <algorithm>
+#include <fstream>
+#include <iterator>
 #include <fmt/format.h>
 #include <celmath/mathlib.h>
 #include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
 #include <celutil/logger.h>
 #include <celutil/gettext.h>
+#include <celutil/mmapfile.h>
 #include <celutil/tokenizer.h>
 #include "stardb.h"
 #include "astro.h"
@@ -57,7 +61,22 @@ constexpr const float STAR_OCTREE_MAGNITUDE   = 6.0f;
 //constexpr const float STAR_EXTRA_ROOM        = 0.01f; // Reserve 1% capacity for extra stars
 
 constexpr const char FILE_HEADER[]            = "CELSTARS";
-constexpr const char CROSSINDEX_FILE_HEADER[] = "CELINDEX";
+
+// Size of the version and star count fields following FILE_HEADER
+constexpr const size_t BINARY_HEADER_SIZE     = 6;
+// catalog number, x, y, z, absolute magnitude, spectral type
+constexpr const size_t BINARY_RECORD_SIZE     = 20;
+// Version 0x0200 records are followed by the space velocity in ly/yr
+constexpr const std::uint16_t BINARY_MOTION_VERSION = 0x0200;
+constexpr const size_t BINARY_MOTION_RECORD_SIZE = 32;
+
+constexpr const char OCTREE_CACHE_HEADER[]    = "CELOCTRC";
+// Version 0x0101 caches have the stars of each node sorted by magnitude
+constexpr const std::uint16_t OCTREE_CACHE_VERSION = 0x0101;
+// version, key, star count, node count
+constexpr const size_t OCTREE_CACHE_HEADER_SIZE = 18;
+// center x, y, z, exclusion factor, object count, child flag
+constexpr const size_t OCTREE_CACHE_NODE_SIZE = 21;
 
 
 // Used to sort stars by catalog number
@@ -179,12 +198,6 @@ static bool parseCelestiaCatalogNumber(const string& name,
 }
 
 
-bool StarDatabase::CrossIndexEntry::operator<(const StarDatabase::CrossIndexEntry& e) const
-{
-    return catalogNumber < e.catalogNumber;
-}
-
-
 StarDatabase::StarDatabase()
 {
     crossIndexes.resize(MaxCatalog);
@@ -193,11 +206,7 @@ StarDatabase::StarDatabase()
 
 StarDatabase::~StarDatabase()
 {
-    delete [] stars;
     delete [] catalogNumberIndex;
-
-    for (const auto index : crossIndexes)
-        delete index;
 }
 
 
@@ -275,18 +284,13 @@ AstroCatalog::IndexNumber StarDatabase::crossIndex(const Catalog catalog, const
     if (static_cast<size_t>(catalog) >= crossIndexes.size())
         return AstroCatalog::InvalidIndex;
 
-    CrossIndex* xindex = crossIndexes[catalog];
+    const CrossIndex* xindex = crossIndexes[catalog].get();
     if (xindex == nullptr)
         return AstroCatalog::InvalidIndex;
 
     // A simple linear search.  We could store cross indices sorted by
     // both catalog numbers and trade memory for speed
-    auto iter = std::find_if(xindex->begin(), xindex->end(),
-                             [celCatalogNumber](CrossIndexEntry& o){ return celCatalogNumber == o.celCatalogNumber; });
-    if (iter != xindex->end())
-        return iter->catalogNumber;
-
-    return AstroCatalog::InvalidIndex;
+    return xindex->findCatalogNumber(celCatalogNumber);
 }
 
 
@@ -297,19 +301,26 @@ AstroCatalog::IndexNumber StarDatabase::searchCrossIndexForCatalogNumber(const C
     if (static_cast<unsigned int>(catalog) >= crossIndexes.size())
         return AstroCatalog::InvalidIndex;
 
-    CrossIndex* xindex = crossIndexes[catalog];
+    const CrossIndex* xindex = crossIndexes[catalog].get();
     if (xindex == nullptr)
         return AstroCatalog::InvalidIndex;
 
-    CrossIndexEntry xindexEnt;
-    xindexEnt.catalogNumber = number;
+    return xindex->find(number);
+}
+
 
-    CrossIndex::iterator iter = lower_bound(xindex->begin(), xindex->end(),
-                                            xindexEnt);
-    if (iter == xindex->end() || iter->catalogNumber != number)
-        return AstroCatalog::InvalidIndex;
-    else
-        return iter->celCatalogNumber;
+vector<AstroCatalog::IndexNumber>
+StarDatabase::searchCrossIndexForCatalogNumbers(const Catalog catalog,
+                                                const vector<AstroCatalog::IndexNumber>& numbers) const
+{
+    vector<AstroCatalog::IndexNumber> celCatalogNumbers(numbers.size(), AstroCatalog::InvalidIndex);
+    if (static_cast<unsigned int>(catalog) >= crossIndexes.size())
+        return celCatalogNumbers;
+
+    const CrossIndex* xindex = crossIndexes[catalog].get();
+    if (xindex != nullptr)
+        xindex->find(numbers.data(), numbers.size(), celCatalogNumbers.data());
+    return celCatalogNumbers;
 }
 
 
@@ -335,12 +346,25 @@ vector<string> StarDatabase::getCompletion(const string& name, bool i18n) const
 }
 
 
-#if 0
-static void catalogNumberToString(AstroCatalog::IndexNumber catalogNumber, char* buf, unsigned int bufSize)
+static std::string_view catalogNumberToString(AstroCatalog::IndexNumber catalogNumber, char* buf, unsigned int bufSize)
 {
-    // TODO: implement using using fmt::write
+    fmt::format_to_n_result<char*> result;
+    if (catalogNumber <= StarDatabase::MAX_HIPPARCOS_NUMBER)
+    {
+        result = fmt::format_to_n(buf, bufSize, "HIP {}", catalogNumber);
+    }
+    else
+    {
+        AstroCatalog::IndexNumber tyc3 = catalogNumber / 1000000000;
+        catalogNumber -= tyc3 * 1000000000;
+        AstroCatalog::IndexNumber tyc2 = catalogNumber / 10000;
+        catalogNumber -= tyc2 * 10000;
+        AstroCatalog::IndexNumber tyc1 = catalogNumber;
+        result = fmt::format_to_n(buf, bufSize, "TYC {}-{}-{}", tyc1, tyc2, tyc3);
+    }
+
+    return { buf, std::min(result.size, static_cast<std::size_t>(bufSize)) };
 }
-#endif
 
 
 static string catalogNumberToString(AstroCatalog::IndexNumber catalogNumber)
@@ -402,10 +426,10 @@ string StarDatabase::getStarName(const Star& star, bool i18n) const
     return catalogNumberToString(catalogNumber);
 }
 
-// A less convenient version of getStarName that writes to a char
-// array instead of a string. The advantage is that no memory allocation
-// will every occur.
-void StarDatabase::getStarName(const Star& star, char* nameBuffer, unsigned int bufferSize, bool i18n) const
+// A version of getStarName that doesn't allocate memory: the name is a
+// view of the name database or, for stars without a name, of the catalog
+// designation written to nameBuffer. The view is valid as long as both.
+std::string_view StarDatabase::getStarName(const Star& star, char* nameBuffer, unsigned int bufferSize, bool i18n) const
 {
     assert(bufferSize != 0);
 
@@ -413,28 +437,12 @@ void StarDatabase::getStarName(const Star& star, char* nameBuffer, unsigned int
 
     if (namesDB != nullptr)
     {
-        StarNameDatabase::NumberIndex::const_iterator iter = namesDB->getFirstNameIter(catalogNumber);
-        if (iter != namesDB->getFinalNameIter() && iter->first == catalogNumber)
-        {
-            if (i18n)
-            {
-                const char * local = D_(iter->second.c_str());
-                if (iter->second != local)
-                {
-                    strncpy(nameBuffer, local, bufferSize);
-                    nameBuffer[bufferSize - 1] = '\0';
-                    return;
-                }
-            }
-
-            strncpy(nameBuffer, iter->second.c_str(), bufferSize);
-            nameBuffer[bufferSize - 1] = '\0';
-            return;
-        }
+        std::string_view name = namesDB->getPrimaryName(catalogNumber, i18n);
+        if (!name.empty())
+            return name;
     }
 
-    strncpy(nameBuffer, catalogNumberToString(catalogNumber).c_str(), bufferSize);
-    nameBuffer[bufferSize - 1] = '\0';
+    return catalogNumberToString(catalogNumber, nameBuffer, bufferSize);
 }
 
 
@@ -508,16 +516,13 @@ string StarDatabase::getStarNameList(const Star& star, const unsigned int maxNam
 }
 
 
-void StarDatabase::findVisibleStars(StarHandler& starHandler,
-                                    const Vector3f& position,
-                                    const Quaternionf& orientation,
-                                    float fovY,
-                                    float aspectRatio,
-                                    float limitingMag,
-                                    OctreeProcStats *stats) const
+void StarDatabase::computeFrustumPlanes(Hyperplane<float, 3>* frustumPlanes,
+                                        const Vector3f& position,
+                                        const Quaternionf& orientation,
+                                        float fovY,
+                                        float aspectRatio)
 {
     // Compute the bounding planes of an infinite view frustum
-    Hyperplane<float, 3> frustumPlanes[5];
     Vector3f planeNormals[5];
     Eigen::Matrix3f rot = orientation.toRotationMatrix();
     float h = (float) tan(fovY / 2);
@@ -532,13 +537,63 @@ void StarDatabase::findVisibleStars(StarHandler& starHandler,
         planeNormals[i] = rot.transpose() * planeNormals[i].normalized();
         frustumPlanes[i] = Hyperplane<float, 3>(planeNormals[i], position);
     }
+}
+
+
+void StarDatabase::findVisibleStarNodes(std::vector<FlatStarOctree::VisibleNode>& nodes,
+                                        const Vector3f& position,
+                                        const Quaternionf& orientation,
+                                        float fovY,
+                                        float aspectRatio,
+                                        float limitingMag) const
+{
+    Hyperplane<float, 3> frustumPlanes[5];
+    if (fovY > 0.0f)
+        computeFrustumPlanes(frustumPlanes, position, orientation, fovY, aspectRatio);
+    else
+        std::fill(std::begin(frustumPlanes), std::end(frustumPlanes), Hyperplane<float, 3>(Vector3f::Zero(), 1.0f));
+
+    nodes.clear();
+    octree.visitVisibleNodeIndices([&nodes](std::uint32_t node, std::uint32_t /*count*/, float dimmest)
+                                   {
+                                       nodes.push_back({ node, dimmest });
+                                   },
+                                   position,
+                                   frustumPlanes,
+                                   limitingMag);
+}
+
+
+void StarDatabase::findVisibleStars(StarHandler& starHandler,
+                                    const Vector3f& position,
+                                    const Quaternionf& orientation,
+                                    float fovY,
+                                    float aspectRatio,
+                                    float limitingMag,
+                                    OctreeProcStats *stats) const
+{
+    Hyperplane<float, 3> frustumPlanes[5];
+    computeFrustumPlanes(frustumPlanes, position, orientation, fovY, aspectRatio);
+
+    octree.processVisibleObjects(starHandler,
+                                 position,
+                                 frustumPlanes,
+                                 limitingMag,
+                                 stats);
+}
 
-    octreeRoot->processVisibleObjects(starHandler,
-                                      position,
-                                      frustumPlanes,
-                                      limitingMag,
-                                      STAR_OCTREE_ROOT_SIZE,
-                                      stats);
+
+void StarDatabase::findStarsInCone(StarHandler& starHandler,
+                                   const Vector3f& position,
+                                   const Vector3f& direction,
+                                   float angle,
+                                   float limitingMag) const
+{
+    octree.processObjectsInCone(starHandler,
+                                position,
+                                direction,
+                                angle,
+                                limitingMag);
 }
 
 
@@ -546,10 +601,9 @@ void StarDatabase::findCloseStars(StarHandler& starHandler,
                                   const Vector3f& position,
                                   float radius) const
 {
-    octreeRoot->processCloseObjects(starHandler,
-                                    position,
-                                    radius,
-                                    STAR_OCTREE_ROOT_SIZE);
+    octree.processCloseObjects(starHandler,
+                               position,
+                               radius);
 }
 
 
@@ -559,75 +613,85 @@ StarNameDatabase* StarDatabase::getNameDatabase() const
 }
 
 
-void StarDatabase::setNameDatabase(StarNameDatabase* _namesDB)
+void StarDatabase::trimTiles() const
 {
-    namesDB    = _namesDB;
+    for (const auto& tileSet : tiles)
+        tileSet->trim();
 }
 
 
-bool StarDatabase::loadCrossIndex(const Catalog catalog, istream& in)
+void StarDatabase::accountMemory(celestia::util::MemoryUsage& parent) const
 {
-    if (static_cast<unsigned int>(catalog) >= crossIndexes.size())
-        return false;
-
-    if (crossIndexes[catalog] != nullptr)
-        delete crossIndexes[catalog];
-
-    // Verify that the star database file has a correct header
+    auto& usage = parent.add("stars", static_cast<std::size_t>(nStars) * sizeof(Star), nStars);
+    usage.add("catalog number index", static_cast<std::size_t>(nStars) * sizeof(Star*));
+    usage.add("octree", octree.memoryUsage(), octree.nodeCount());
+    if (aggregates != nullptr)
+        usage.add("star aggregates", aggregates->memoryUsage(), aggregates->nodeCount());
+
+    std::size_t crossIndexBytes = 0;
+    std::size_t crossIndexEntries = 0;
+    for (const auto& crossIndex : crossIndexes)
     {
-        int headerLength = strlen(CROSSINDEX_FILE_HEADER);
-        char* header = new char[headerLength];
-        if (!in.read(header, headerLength).good()
-            || strncmp(header, CROSSINDEX_FILE_HEADER, headerLength))
-        {
-            GetLogger()->error(_("Bad header for cross index\n"));
-            delete[] header;
-            return false;
-        }
-        delete[] header;
+        if (crossIndex == nullptr)
+            continue;
+        crossIndexBytes += crossIndex->memoryUsage();
+        crossIndexEntries += crossIndex->size();
     }
+    usage.add("cross indexes", crossIndexBytes, crossIndexEntries);
 
-    // Verify the version
+    if (!tiles.empty())
     {
-        std::uint16_t version;
-        if (!celutil::readLE<std::uint16_t>(in, version) || version != 0x0100)
+        std::size_t loadedBytes = 0;
+        std::size_t tileStars = 0;
+        for (const auto& tileSet : tiles)
         {
-            GetLogger()->error(_("Bad version for cross index\n"));
-            return false;
+            loadedBytes += tileSet->loadedSize();
+            tileStars += tileSet->starCount();
         }
+        usage.add("tiles", loadedBytes, tileStars);
     }
 
-    CrossIndex* xindex = new CrossIndex();
+    if (namesDB != nullptr)
+        namesDB->accountMemory(usage);
+}
 
-    unsigned int record = 0;
-    for (;;)
-    {
-        CrossIndexEntry ent;
-        if (!celutil::readLE<AstroCatalog::IndexNumber>(in, ent.catalogNumber))
-        {
-            if (in.eof()) { break; }
-            GetLogger()->error(_("Loading cross index failed\n"));
-            delete xindex;
-            return false;
-        }
 
-        if (!celutil::readLE<AstroCatalog::IndexNumber>(in, ent.celCatalogNumber))
-        {
-            GetLogger()->error(_("Loading cross index failed at record {}\n"), record);
-            delete xindex;
-            return false;
-        }
+void StarDatabase::addTiles(std::unique_ptr<StarTileSet>&& tileSet)
+{
+    if (tileSet != nullptr)
+        tiles.push_back(std::move(tileSet));
+}
 
-        xindex->push_back(ent);
 
-        record++;
-    }
+bool StarDatabase::writeTiles(std::ostream& out) const
+{
+    return StarTileSet::write(out, octree);
+}
 
-    sort(xindex->begin(), xindex->end());
 
-    crossIndexes[catalog] = xindex;
+void StarDatabase::setNameDatabase(StarNameDatabase* _namesDB)
+{
+    namesDB    = _namesDB;
+}
 
-    return true;
+
+bool StarDatabase::loadCrossIndex(const Catalog catalog, istream& in)
+{
+    if (static_cast<unsigned int>(catalog) >= crossIndexes.size())
+        return false;
+
+    crossIndexes[catalog] = CrossIndex::read(in);
+    return crossIndexes[catalog] != nullptr;
+}
+
+
+bool StarDatabase::loadCrossIndex(const Catalog catalog, const fs::path& path)
+{
+    if (static_cast<unsigned int>(catalog) >= crossIndexes.size())
+        return false;
+
+    crossIndexes[catalog] = CrossIndex::read(path);
+    return crossIndexes[catalog] != nullptr;
 }
 
 
@@ -647,12 +711,11 @@ bool StarDatabase::loadBinary(istream& in)
     }
 
     // Verify the version
+    std::uint16_t version;
+    if (!celutil::readLE<std::uint16_t>(in, version)
+        || (version != 0x0100 && version != BINARY_MOTION_VERSION))
     {
-        std::uint16_t version;
-        if (!celutil::readLE<std::uint16_t>(in, version) || version != 0x0100)
-        {
-            return false;
-        }
+        return false;
     }
 
     // Read the star count
@@ -680,26 +743,17 @@ bool StarDatabase::loadBinary(istream& in)
             return false;
         }
 
-        Star star;
-        star.setPosition(x, y, z);
-        star.setAbsoluteMagnitude((float) absMag / 256.0f);
-
-        StarDetails* details = nullptr;
-        StellarClass sc;
-        if (sc.unpackV1(spectralType))
-            details = StarDetails::GetStarDetails(sc);
-
-        if (details == nullptr)
+        Eigen::Vector3f velocity = Eigen::Vector3f::Zero();
+        if (version == BINARY_MOTION_VERSION
+            && (!celutil::readLE<float>(in, velocity.x())
+                || !celutil::readLE<float>(in, velocity.y())
+                || !celutil::readLE<float>(in, velocity.z())))
         {
-            GetLogger()->error(_("Bad spectral type in star database, star #{}\n"), nStars);
             return false;
         }
 
-        star.setDetails(details);
-        star.setIndex(catNo);
-        unsortedStars.add(star);
-
-        nStars++;
+        if (!addBinaryStar(catNo, x, y, z, absMag, spectralType, velocity))
+            return false;
     }
 
     if (in.bad())
@@ -708,12 +762,127 @@ bool StarDatabase::loadBinary(istream& in)
     GetLogger()->debug("StarDatabase::read: nStars = {}\n", nStarsInFile);
     GetLogger()->info(_("{} stars in binary database\n"), nStars);
 
-    // Create the temporary list of stars sorted by catalog number; this
-    // will be used to lookup stars during file loading. After loading is
-    // complete, the stars are sorted into an octree and this list gets
-    // replaced.
+    buildBinFileIndex();
+
+    return true;
+}
+
+
+/*! Load a binary star database by mapping the file into memory and decoding
+ *  the records directly from the mapped pages. This avoids the per-field
+ *  stream reads of loadBinary(istream&), which dominate startup time for
+ *  large catalogs. If the file can't be mapped, the stream reader is used.
+ */
+bool StarDatabase::loadBinary(const fs::path& path)
+{
+    celutil::MemoryMappedFile file;
+    if (!file.open(path, celutil::MemoryMappedFile::AccessHint::Sequential))
+    {
+        GetLogger()->debug("Unable to map {}, falling back to stream reader\n", path);
+        ifstream in(path, ios::in | ios::binary);
+        return in.good() && loadBinary(in);
+    }
+
+    const char* ptr = file.data();
+    const char* end = ptr + file.size();
+
+    // Verify that the star database file has a correct header
+    size_t headerLength = strlen(FILE_HEADER);
+    if (file.size() < headerLength + BINARY_HEADER_SIZE
+        || strncmp(ptr, FILE_HEADER, headerLength))
+    {
+        return false;
+    }
+    ptr += headerLength;
+
+    // Verify the version
+    auto version = celutil::fromMemoryLE<std::uint16_t>(ptr);
+    if (version != 0x0100 && version != BINARY_MOTION_VERSION)
+        return false;
+    ptr += sizeof(std::uint16_t);
+    bool hasMotion = version == BINARY_MOTION_VERSION;
+    size_t recordSize = hasMotion ? BINARY_MOTION_RECORD_SIZE : BINARY_RECORD_SIZE;
+
+    // Read the star count and make sure the records are all there
+    uint32_t nStarsInFile = celutil::fromMemoryLE<std::uint32_t>(ptr);
+    ptr += sizeof(std::uint32_t);
+    if (static_cast<size_t>(end - ptr) / recordSize < nStarsInFile)
+    {
+        GetLogger()->error(_("Star database {} is truncated\n"), path);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < nStarsInFile; ++i, ptr += recordSize)
+    {
+        Eigen::Vector3f velocity = Eigen::Vector3f::Zero();
+        if (hasMotion)
+        {
+            velocity = Eigen::Vector3f(celutil::fromMemoryLE<float>(ptr + 20),
+                                       celutil::fromMemoryLE<float>(ptr + 24),
+                                       celutil::fromMemoryLE<float>(ptr + 28));
+        }
+
+        if (!addBinaryStar(celutil::fromMemoryLE<AstroCatalog::IndexNumber>(ptr),
+                           celutil::fromMemoryLE<float>(ptr + 4),
+                           celutil::fromMemoryLE<float>(ptr + 8),
+                           celutil::fromMemoryLE<float>(ptr + 12),
+                           celutil::fromMemoryLE<std::int16_t>(ptr + 16),
+                           celutil::fromMemoryLE<std::uint16_t>(ptr + 18),
+                           velocity))
+        {
+            return false;
+        }
+    }
+
+    GetLogger()->debug("StarDatabase::read: nStars = {}\n", nStarsInFile);
+    GetLogger()->info(_("{} stars in binary database\n"), nStars);
+
+    buildBinFileIndex();
+
+    return true;
+}
+
+
+bool StarDatabase::addBinaryStar(AstroCatalog::IndexNumber catNo,
+                                 float x, float y, float z,
+                                 std::int16_t absMag,
+                                 std::uint16_t spectralType,
+                                 const Eigen::Vector3f& velocity)
+{
+    Star star;
+    star.setPosition(x, y, z);
+    star.setSpaceVelocity(velocity);
+    star.setAbsoluteMagnitude((float) absMag / 256.0f);
+
+    StarDetails* details = nullptr;
+    StellarClass sc;
+    if (sc.unpackV1(spectralType))
+        details = StarDetails::GetStarDetails(sc);
+
+    if (details == nullptr)
+    {
+        GetLogger()->error(_("Bad spectral type in star database, star #{}\n"), nStars);
+        return false;
+    }
+
+    star.setDetails(details);
+    star.setIndex(catNo);
+    unsortedStars.add(star);
+
+    nStars++;
+    return true;
+}
+
+
+// Create the temporary list of stars sorted by catalog number; this
+// will be used to lookup stars during file loading. After loading is
+// complete, the stars are sorted into an octree and this list gets
+// replaced.
+void StarDatabase::buildBinFileIndex()
+{
     if (unsortedStars.size() > 0)
     {
+        delete[] binFileCatalogNumberIndex;
         binFileStarCount = unsortedStars.size();
         binFileCatalogNumberIndex = new Star*[binFileStarCount];
         for (unsigned int i = 0; i < binFileStarCount; i++)
@@ -723,8 +892,42 @@ bool StarDatabase::loadBinary(istream& in)
         sort(binFileCatalogNumberIndex, binFileCatalogNumberIndex + binFileStarCount,
              PtrCatalogNumberOrderingPredicate());
     }
+}
 
-    return true;
+
+void StarDatabase::addCatalogSource(const fs::path& path)
+{
+    catalogSourcesKey.addFile(path);
+}
+
+
+void StarDatabase::setOctreeCacheFile(const fs::path& path)
+{
+    octreeCacheFile = path;
+}
+
+
+/*! Set the number of threads used to build the octree in finish(); 0 uses
+ *  one thread per core. The result doesn't depend on the thread count.
+ */
+void StarDatabase::setLoaderThreads(unsigned int nThreads)
+{
+    loaderThreads = nThreads;
+}
+
+
+/*! Set how finish() divides the octree. Catalogs with very many stars
+ *  need fewer, fuller nodes than the default.
+ */
+void StarDatabase::setOctreeSplitPolicy(const OctreeSplitPolicy& policy)
+{
+    octreeSplitPolicy = policy;
+}
+
+
+void StarDatabase::getOctreeStatistics(std::vector<OctreeLevelStatistics>& stats) const
+{
+    octree.computeStatistics(stats);
 }
 
 
@@ -732,27 +935,157 @@ void StarDatabase::finish()
 {
     GetLogger()->info(_("Total star count: {}\n"), nStars);
 
-    buildOctree();
+    bool useCache = !octreeCacheFile.empty();
+    bool loadedFromCache = useCache && loadOctreeCache();
+    if (!loadedFromCache)
+        buildOctree();
     buildIndexes();
 
+    if (useCache && !loadedFromCache)
+        saveOctreeCache();
+
+    octree = FlatStarOctree(*octreeRoot, STAR_OCTREE_ROOT_SIZE);
+    delete octreeRoot;
+    octreeRoot = nullptr;
+
     // Delete the temporary indices used only during loading
     delete[] binFileCatalogNumberIndex;
+    binFileCatalogNumberIndex = nullptr;
     stcFileCatalogNumberIndex.clear();
+    spectralTypeDetails.clear();
 
     // Resolve all barycenters; this can't be done before star sorting. There's
     // still a bug here: final orbital radii aren't available until after
     // the barycenters have been resolved, and these are required when building
     // the octree.  This will only rarely cause a problem, but it still needs
     // to be addressed.
+    resolveBarycenters();
+    updateOctreeDrift();
+    buildOrbitingStarList();
+}
+
+
+/*! Let the octree find the stars anywhere along the path of their space
+ *  motion within the time span of Star::GetMotionTimeSpan().
+ */
+void StarDatabase::updateOctreeDrift()
+{
+    float span = Star::GetMotionTimeSpan();
+    octree.setObjectDrift([span](const Star& star)
+    {
+        return star.getSpaceVelocity().norm() * span;
+    });
+}
+
+
+void StarDatabase::buildOrbitingStarList()
+{
+    constexpr auto NoBarycenter = std::numeric_limits<std::uint32_t>::max();
+
+    orbitingStars.clear();
+    for (int i = 0; i < nStars; ++i)
+    {
+        if (stars[i].getOrbit() != nullptr)
+            orbitingStars.push_back(&stars[i]);
+    }
+    std::sort(orbitingStars.begin(), orbitingStars.end());
+
+    auto indexOf = [this](const Star* star)
+    {
+        auto it = std::lower_bound(orbitingStars.begin(), orbitingStars.end(), star);
+        if (it == orbitingStars.end() || *it != star)
+            return NoBarycenter;
+        return static_cast<std::uint32_t>(it - orbitingStars.begin());
+    };
+
+    auto nOrbiting = static_cast<std::uint32_t>(orbitingStars.size());
+    orbitingStarBarycenters.resize(nOrbiting);
+    std::vector<std::uint32_t> depths(nOrbiting, 0);
+    for (std::uint32_t i = 0; i < nOrbiting; ++i)
+    {
+        const Star* barycenter = orbitingStars[i]->getOrbitBarycenter();
+        orbitingStarBarycenters[i] = barycenter == nullptr ? NoBarycenter : indexOf(barycenter);
+
+        // Barycenters orbiting other barycenters are rare and nested only a
+        // few levels deep; the count is capped in case of a cycle.
+        for (const Star* s = barycenter; s != nullptr && s->getOrbit() != nullptr && depths[i] < nOrbiting;
+             s = s->getOrbitBarycenter())
+        {
+            depths[i]++;
+        }
+    }
+
+    orbitingStarOrder.resize(nOrbiting);
+    for (std::uint32_t i = 0; i < nOrbiting; ++i)
+        orbitingStarOrder[i] = i;
+    std::stable_sort(orbitingStarOrder.begin(), orbitingStarOrder.end(),
+                     [&depths](std::uint32_t a, std::uint32_t b) { return depths[a] < depths[b]; });
+
+    orbitingStarPositions.resize(nOrbiting);
+    orbitingStarTime = std::numeric_limits<double>::quiet_NaN();
+}
+
+
+void StarDatabase::updateOrbitingStarPositions(double t) const
+{
+    if (t == orbitingStarTime)
+        return;
+
+    constexpr auto NoBarycenter = std::numeric_limits<std::uint32_t>::max();
+
+    // Same as Star::getPosition(), but with the position of a barycenter
+    // that has an orbit taken from the positions already computed
+    float motionYears = Star::GetMotionYears(t);
+    for (std::uint32_t i : orbitingStarOrder)
+    {
+        const Star* star = orbitingStars[i];
+        const Star* barycenter = star->getOrbitBarycenter();
+        std::uint32_t barycenterIndex = orbitingStarBarycenters[i];
+
+        UniversalCoord barycenterPos;
+        if (barycenter == nullptr)
+            barycenterPos = UniversalCoord::CreateLy(star->getPositionAfter(motionYears).cast<double>());
+        else if (barycenterIndex != NoBarycenter)
+            barycenterPos = orbitingStarPositions[barycenterIndex];
+        else
+            barycenterPos = barycenter->getPosition(t);
+
+        orbitingStarPositions[i] = barycenterPos.offsetKm(star->getOrbit()->positionAtTime(t));
+    }
+
+    orbitingStarTime = t;
+}
+
+
+UniversalCoord StarDatabase::getStarPosition(const Star& star, double t) const
+{
+    if (star.getOrbit() == nullptr || t != orbitingStarTime)
+        return star.getPosition(t);
+
+    auto it = std::lower_bound(orbitingStars.begin(), orbitingStars.end(), &star);
+    if (it == orbitingStars.end() || *it != &star)
+        return star.getPosition(t);
+    return orbitingStarPositions[it - orbitingStars.begin()];
+}
+
+
+void StarDatabase::resolveBarycenters()
+{
     for (const auto& b : barycenters)
     {
         Star* star = find(b.catNo);
         Star* barycenter = find(b.barycenterCatNo);
-        assert(star != nullptr);
-        assert(barycenter != nullptr);
-        if (star != nullptr && barycenter != nullptr)
+        if (star == nullptr || barycenter == nullptr)
+            continue;
+
+        star->setOrbitBarycenter(barycenter);
+        // The star is drawn and sorted at the position of its barycenter
+        star->setSpaceVelocity(barycenter->getSpaceVelocity());
+        // Stars updated in place may already be in the list
+        const auto* orbitingStars = barycenter->getOrbitingStars();
+        if (orbitingStars == nullptr ||
+            std::find(orbitingStars->begin(), orbitingStars->end(), star) == orbitingStars->end())
         {
-            star->setOrbitBarycenter(barycenter);
             barycenter->addOrbitingStar(star);
         }
     }
@@ -761,6 +1094,28 @@ void StarDatabase::finish()
 }
 
 
+std::size_t StarDatabase::update(std::istream& in, const fs::path& resourcePath)
+{
+    std::size_t rejected = 0;
+    rejectedUpdates = &rejected;
+
+    Tokenizer tokenizer(&in);
+    Parser parser(&tokenizer);
+    if (!load(tokenizer, parser, resourcePath))
+        GetLogger()->error(_("Error reading updated star catalog {}\n"), resourcePath);
+
+    rejectedUpdates = nullptr;
+    spectralTypeDetails.clear();
+    resolveBarycenters();
+    updateOctreeDrift();
+    buildOrbitingStarList();
+
+    // The combined light of the nodes changes with the stars
+    aggregates = nullptr;
+    return rejected;
+}
+
+
 static void stcError(const Tokenizer& tok,
                      const string& msg)
 {
@@ -790,8 +1145,14 @@ bool StarDatabase::createStar(Star* star,
     {
         if (starData->getString("SpectralType", spectralType))
         {
-            StellarClass sc = StellarClass::parse(spectralType);
-            details = StarDetails::GetStarDetails(sc);
+            auto iter = spectralTypeDetails.find(spectralType);
+            if (iter == spectralTypeDetails.end())
+            {
+                StellarClass sc = StellarClass::parse(spectralType);
+                iter = spectralTypeDetails.try_emplace(spectralType, StarDetails::GetStarDetails(sc)).first;
+            }
+
+            details = iter->second;
             if (details == nullptr)
             {
                 GetLogger()->error(_("Invalid star: bad spectral type.\n"));
@@ -1088,6 +1449,32 @@ bool StarDatabase::createStar(Star* star,
             Vector3d pos = astro::equatorialToCelestialCart((double) raf, (double) decf, (double) distancef);
             star->setPosition(pos.cast<float>());
         }
+
+        // Proper motion in mas/yr, with the right ascension component
+        // already multiplied by cos(dec), and radial velocity in km/s. The
+        // space velocity is the change of position over one year.
+        double pmRA = 0.0;
+        double pmDec = 0.0;
+        double radialVelocity = 0.0;
+        bool hasMotion = starData->getNumber("ProperMotionRA", pmRA);
+        hasMotion = starData->getNumber("ProperMotionDec", pmDec) || hasMotion;
+        hasMotion = starData->getNumber("RadialVelocity", radialVelocity) || hasMotion;
+        if (hasMotion && distance > 0.0)
+        {
+            constexpr double MAS_PER_DEG = 3600000.0;
+            double cosDec = std::cos(degToRad(dec));
+            double raMotion = cosDec > 1.0e-6 ? pmRA / (cosDec * MAS_PER_DEG * DEG_PER_HRA) : 0.0;
+            double distanceMotion = radialVelocity * DAYS_PER_YEAR * SECONDS_PER_DAY / KM_PER_LY;
+            Vector3d pos0 = astro::equatorialToCelestialCart(ra, dec, distance);
+            Vector3d pos1 = astro::equatorialToCelestialCart(ra + raMotion,
+                                                             dec + pmDec / MAS_PER_DEG,
+                                                             distance + distanceMotion);
+            star->setSpaceVelocity((pos1 - pos0).cast<float>());
+        }
+        else if (disposition != DataDisposition::Modify)
+        {
+            star->setSpaceVelocity(Vector3f::Zero());
+        }
     }
 
     if (isBarycenter)
@@ -1187,7 +1574,20 @@ bool StarDatabase::load(istream& in, const fs::path& resourcePath)
 {
     Tokenizer tokenizer(&in);
     Parser parser(&tokenizer);
+    return load(tokenizer, parser, resourcePath);
+}
 
+
+bool StarDatabase::load(PreparsedCatalog& catalog, const fs::path& resourcePath)
+{
+    Tokenizer tokenizer(catalog.getTokens());
+    Parser parser(&tokenizer, &catalog);
+    return load(tokenizer, parser, resourcePath);
+}
+
+
+bool StarDatabase::load(Tokenizer& tokenizer, Parser& parser, const fs::path& resourcePath)
+{
 #ifdef ENABLE_NLS
     string s = resourcePath.string();
     const char *d = s.c_str();
@@ -1347,15 +1747,46 @@ bool StarDatabase::load(istream& in, const fs::path& resourcePath)
         if (isNewStar)
             star = new Star();
 
+        // Once the octree is built, stars are only changed in place if they
+        // stay in their node, so the changes are made to a copy first
+        bool updating = rejectedUpdates != nullptr;
+        Star updated;
+        Star* target = star;
+        if (updating && !isNewStar)
+        {
+            updated = *star;
+            target = &updated;
+        }
+
         bool ok = false;
+        bool rejected = false;
         if (isNewStar && disposition == DataDisposition::Modify)
         {
             GetLogger()->warn("Modify requested for nonexistent star.\n");
         }
         else
         {
-            ok = createStar(star, disposition, catalogNumber, starData, resourcePath, !isStar);
-            star->loadCategories(starData, disposition, resourcePath.string());
+            std::size_t nBarycenters = barycenters.size();
+            ok = createStar(target, disposition, catalogNumber, starData, resourcePath, !isStar);
+            if (ok && updating)
+            {
+                rejected = isNewStar ||
+                           !octree.canUpdateObject(star, updated.getPosition(),
+                                                   updated.getOrbitalRadius(),
+                                                   updated.getAbsoluteMagnitude());
+                if (rejected)
+                {
+                    ++*rejectedUpdates;
+                    barycenters.resize(nBarycenters);
+                    ok = false;
+                }
+                else
+                {
+                    *star = updated;
+                }
+            }
+            if (!rejected)
+                star->loadCategories(starData, disposition, resourcePath.string());
         }
         delete starDataValue;
 
@@ -1400,7 +1831,10 @@ bool StarDatabase::load(istream& in, const fs::path& resourcePath)
         {
             if (isNewStar)
                 delete star;
-            GetLogger()->info("Bad star definition--will continue parsing file.\n");
+            if (rejected)
+                GetLogger()->warn(_("Star {} can't be updated without rebuilding the star database.\n"), catalogNumber);
+            else
+                GetLogger()->info("Bad star definition--will continue parsing file.\n");
         }
     }
 
@@ -1417,20 +1851,33 @@ void StarDatabase::buildOctree()
     float absMag = astro::appToAbsMag(STAR_OCTREE_MAGNITUDE,
                                       STAR_OCTREE_ROOT_SIZE * (float) sqrt(3.0));
     DynamicStarOctree* root = new DynamicStarOctree(Vector3f(1000.0f, 1000.0f, 1000.0f),
-                                                    absMag);
-    for (unsigned int i = 0; i < unsortedStars.size(); ++i)
+                                                    absMag,
+                                                    octreeSplitPolicy);
+    celutil::ThreadPool pool(loaderThreads);
+    if (pool.size() > 1)
     {
-        root->insertObject(unsortedStars[i], STAR_OCTREE_ROOT_SIZE);
+        std::vector<const Star*> objects;
+        objects.reserve(unsortedStars.size());
+        for (unsigned int i = 0; i < unsortedStars.size(); ++i)
+            objects.push_back(&unsortedStars[i]);
+        root->insertObjects(std::move(objects), STAR_OCTREE_ROOT_SIZE, &pool);
+    }
+    else
+    {
+        for (unsigned int i = 0; i < unsortedStars.size(); ++i)
+        {
+            root->insertObject(unsortedStars[i], STAR_OCTREE_ROOT_SIZE);
+        }
     }
 
     GetLogger()->debug("Spatially sorting stars for improved locality of reference . . .\n");
-    Star* sortedStars    = new Star[nStars];
-    Star* firstStar      = sortedStars;
-    root->rebuildAndSort(octreeRoot, firstStar);
+    auto sortedStars     = celutil::makeCatalogArray<Star>(nStars);
+    Star* firstStar      = sortedStars.get();
+    root->rebuildAndSort(octreeRoot, firstStar, &pool);
 
-    // ASSERT((int) (firstStar - sortedStars) == nStars);
+    // ASSERT((int) (firstStar - sortedStars.get()) == nStars);
     GetLogger()->debug("{} stars total\nOctree has {} nodes and {} stars.\n",
-                       static_cast<int>(firstStar - sortedStars),
+                       static_cast<int>(firstStar - sortedStars.get()),
                        1 + octreeRoot->countChildren(), octreeRoot->countObjects());
 #ifdef PROFILE_OCTREE
     vector<OctreeLevelStatistics> stats;
@@ -1453,7 +1900,167 @@ void StarDatabase::buildOctree()
     unsortedStars.clear();
     delete root;
 
-    stars = sortedStars;
+    stars = std::move(sortedStars);
+}
+
+
+std::uint64_t StarDatabase::getOctreeCacheKey() const
+{
+    // The layout also depends on the octree parameters, so changing them
+    // invalidates existing caches.
+    celutil::CacheKey key = catalogSourcesKey;
+    key.add(static_cast<std::uint64_t>(nStars));
+    key.add(&STAR_OCTREE_ROOT_SIZE, sizeof(STAR_OCTREE_ROOT_SIZE));
+    key.add(&STAR_OCTREE_MAGNITUDE, sizeof(STAR_OCTREE_MAGNITUDE));
+    key.add(static_cast<std::uint64_t>(octreeSplitPolicy.splitThreshold));
+    key.add(&octreeSplitPolicy.magnitudeStep, sizeof(octreeSplitPolicy.magnitudeStep));
+    return key.value();
+}
+
+
+/*! Load the star octree from a cache written by a previous run with the same
+ *  catalog files. The cache stores the node layout and the catalog numbers
+ *  of the stars in octree order, which is enough to rebuild the static
+ *  octree without inserting each star into a dynamic octree and sorting it.
+ */
+bool StarDatabase::loadOctreeCache()
+{
+    celutil::MemoryMappedFile file;
+    if (!file.open(octreeCacheFile, celutil::MemoryMappedFile::AccessHint::Sequential))
+        return false;
+
+    const char* ptr = file.data();
+    size_t headerLength = strlen(OCTREE_CACHE_HEADER);
+    if (file.size() < headerLength + OCTREE_CACHE_HEADER_SIZE
+        || strncmp(ptr, OCTREE_CACHE_HEADER, headerLength))
+    {
+        GetLogger()->warn(_("Bad header for star octree cache {}\n"), octreeCacheFile);
+        return false;
+    }
+    ptr += headerLength;
+
+    if (celutil::fromMemoryLE<std::uint16_t>(ptr) != OCTREE_CACHE_VERSION
+        || celutil::fromMemoryLE<std::uint64_t>(ptr + 2) != getOctreeCacheKey())
+    {
+        GetLogger()->info(_("Star octree cache {} is out of date\n"), octreeCacheFile);
+        return false;
+    }
+
+    auto nStarsInCache = celutil::fromMemoryLE<std::uint32_t>(ptr + 10);
+    auto nNodes = celutil::fromMemoryLE<std::uint32_t>(ptr + 14);
+    ptr += OCTREE_CACHE_HEADER_SIZE;
+
+    if (nStarsInCache != static_cast<std::uint32_t>(nStars)
+        || file.size() - (ptr - file.data()) != static_cast<size_t>(nNodes) * OCTREE_CACHE_NODE_SIZE
+                                              + static_cast<size_t>(nStarsInCache) * sizeof(AstroCatalog::IndexNumber))
+    {
+        GetLogger()->warn(_("Star octree cache {} is corrupt\n"), octreeCacheFile);
+        return false;
+    }
+
+    std::vector<OctreeNodeLayout<float>> layout;
+    layout.reserve(nNodes);
+    for (std::uint32_t i = 0; i < nNodes; ++i, ptr += OCTREE_CACHE_NODE_SIZE)
+    {
+        OctreeNodeLayout<float> node;
+        node.cellCenterPos = Vector3f(celutil::fromMemoryLE<float>(ptr),
+                                      celutil::fromMemoryLE<float>(ptr + 4),
+                                      celutil::fromMemoryLE<float>(ptr + 8));
+        node.exclusionFactor = celutil::fromMemoryLE<float>(ptr + 12);
+        node.nObjects = celutil::fromMemoryLE<std::uint32_t>(ptr + 16);
+        node.hasChildren = ptr[20] != 0;
+        layout.push_back(node);
+    }
+
+    auto sortedStars = celutil::makeCatalogArray<Star>(nStars);
+    for (int i = 0; i < nStars; ++i, ptr += sizeof(AstroCatalog::IndexNumber))
+    {
+        const Star* star = findWhileLoading(celutil::fromMemoryLE<AstroCatalog::IndexNumber>(ptr));
+        if (star == nullptr)
+        {
+            GetLogger()->warn(_("Star octree cache {} doesn't match the catalogs\n"), octreeCacheFile);
+            return false;
+        }
+        sortedStars[i] = *star;
+    }
+
+    octreeRoot = StarOctree::fromLayout(layout, sortedStars.get(), nStars);
+    if (octreeRoot == nullptr)
+    {
+        GetLogger()->warn(_("Star octree cache {} is corrupt\n"), octreeCacheFile);
+        return false;
+    }
+
+    GetLogger()->info(_("Loaded star octree from cache {}\n"), octreeCacheFile);
+
+    unsortedStars.clear();
+    stars = std::move(sortedStars);
+
+    return true;
+}
+
+
+void StarDatabase::saveOctreeCache() const
+{
+    // Stars are matched to cache entries by catalog number, so the cache
+    // can't describe catalogs with duplicate numbers.
+    for (int i = 1; i < nStars; ++i)
+    {
+        if (catalogNumberIndex[i - 1]->getIndex() == catalogNumberIndex[i]->getIndex())
+        {
+            GetLogger()->info("Duplicate catalog numbers, not writing star octree cache\n");
+            return;
+        }
+    }
+
+    std::vector<OctreeNodeLayout<float>> layout;
+    octreeRoot->getLayout(layout);
+
+    // Write to a temporary file first so that an interrupted write never
+    // leaves a truncated cache behind.
+    fs::path tmpFile = octreeCacheFile;
+    tmpFile += ".tmp";
+    {
+        ofstream out(tmpFile, ios::out | ios::binary);
+        out.write(OCTREE_CACHE_HEADER, strlen(OCTREE_CACHE_HEADER));
+        bool ok = out.good()
+            && celutil::writeLE<std::uint16_t>(out, OCTREE_CACHE_VERSION)
+            && celutil::writeLE<std::uint64_t>(out, getOctreeCacheKey())
+            && celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(nStars))
+            && celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(layout.size()));
+
+        for (const auto& node : layout)
+        {
+            if (!ok)
+                break;
+            ok = celutil::writeLE<float>(out, node.cellCenterPos.x())
+                && celutil::writeLE<float>(out, node.cellCenterPos.y())
+                && celutil::writeLE<float>(out, node.cellCenterPos.z())
+                && celutil::writeLE<float>(out, node.exclusionFactor)
+                && celutil::writeLE<std::uint32_t>(out, node.nObjects)
+                && celutil::writeLE<std::uint8_t>(out, node.hasChildren ? 1 : 0);
+        }
+
+        for (int i = 0; ok && i < nStars; ++i)
+            ok = celutil::writeLE<AstroCatalog::IndexNumber>(out, stars[i].getIndex());
+
+        if (!ok)
+        {
+            GetLogger()->warn(_("Error writing star octree cache {}\n"), tmpFile);
+            out.close();
+            std::error_code ec;
+            fs::remove(tmpFile, ec);
+            return;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(tmpFile, octreeCacheFile, ec);
+    if (ec)
+    {
+        GetLogger()->warn(_("Error writing star octree cache {}\n"), octreeCacheFile);
+        fs::remove(tmpFile, ec);
+    }
 }
 
 
@@ -1507,6 +2114,10 @@ Star* StarDatabase::findWhileLoading(AstroCatalog::IndexNumber catalogNumber) co
         return iter->second;
     }
 
+    // Stars of a finished database are found in the final index
+    if (catalogNumberIndex != nullptr)
+        return find(catalogNumber);
+
     // Star not found
     return nullptr;
 }
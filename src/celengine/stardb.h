@@ -11,19 +11,36 @@
 #ifndef _CELENGINE_STARDB_H_
 #define _CELENGINE_STARDB_H_
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include <map>
 #include <celutil/blockarray.h>
+#include <celutil/cachekey.h>
+#include <celutil/catalogalloc.h>
+#include <celutil/memoryusage.h>
 #include <celengine/constellation.h>
+#include <celengine/crossindex.h>
 #include <celengine/starname.h>
 #include <celengine/star.h>
+#include <celengine/staraggregates.h>
 #include <celengine/staroctree.h>
+#include <celengine/startiles.h>
 #include <celengine/parseobject.h>
 
 
 static const unsigned int MAX_STAR_NAMES = 10;
 
+class Parser;
+class PreparsedCatalog;
+class Tokenizer;
+
 
 class StarDatabase
 {
@@ -49,19 +66,236 @@ class StarDatabase
                           float limitingMag,
                           OctreeProcStats * = nullptr) const;
 
+    // Like findVisibleStars, but the visitor is called once per octree
+    // node with the stars of the node, see FlatOctree::visitVisibleNodes.
+    template <class VISITOR>
+    void findVisibleStarBatches(VISITOR&& visitor,
+                                const Eigen::Vector3f& obsPosition,
+                                const Eigen::Quaternionf&   obsOrientation,
+                                float fovY,
+                                float aspectRatio,
+                                float limitingMag,
+                                OctreeProcStats *stats = nullptr) const
+    {
+        Eigen::Hyperplane<float, 3> frustumPlanes[5];
+        computeFrustumPlanes(frustumPlanes, obsPosition, obsOrientation, fovY, aspectRatio);
+        octree.visitVisibleNodes(std::forward<VISITOR>(visitor),
+                                 obsPosition,
+                                 frustumPlanes,
+                                 limitingMag,
+                                 stats);
+    }
+
+    // Same, but the visible octree nodes are reused from the previous
+    // call with the same cache while the view doesn't change much.
+    template <class VISITOR>
+    void findVisibleStarBatches(VISITOR&& visitor,
+                                const Eigen::Vector3f& obsPosition,
+                                const Eigen::Quaternionf&   obsOrientation,
+                                float fovY,
+                                float aspectRatio,
+                                float limitingMag,
+                                FlatStarOctree::VisibleNodeCache& cache,
+                                OctreeProcStats *stats = nullptr) const
+    {
+        Eigen::Hyperplane<float, 3> frustumPlanes[5];
+        computeFrustumPlanes(frustumPlanes, obsPosition, obsOrientation, fovY, aspectRatio);
+        octree.visitVisibleNodes(std::forward<VISITOR>(visitor),
+                                 obsPosition,
+                                 frustumPlanes,
+                                 limitingMag,
+                                 cache,
+                                 stats);
+    }
+
+    // Collect the visible octree nodes for a traversal shared by views from
+    // obsPosition, see FlatOctree::visitNodesInFrustum(). The frustum has
+    // to contain those of the views; with a fovY of zero, nodes are only
+    // culled by brightness.
+    void findVisibleStarNodes(std::vector<FlatStarOctree::VisibleNode>& nodes,
+                              const Eigen::Vector3f& obsPosition,
+                              const Eigen::Quaternionf& obsOrientation,
+                              float fovY,
+                              float aspectRatio,
+                              float limitingMag) const;
+
+    // Like findVisibleStarBatches, for the nodes of a shared traversal
+    template <class VISITOR>
+    void findVisibleStarBatches(VISITOR&& visitor,
+                                const std::vector<FlatStarOctree::VisibleNode>& nodes,
+                                const Eigen::Vector3f& obsPosition,
+                                const Eigen::Quaternionf& obsOrientation,
+                                float fovY,
+                                float aspectRatio) const
+    {
+        Eigen::Hyperplane<float, 3> frustumPlanes[5];
+        computeFrustumPlanes(frustumPlanes, obsPosition, obsOrientation, fovY, aspectRatio);
+        octree.visitNodesInFrustum(std::forward<VISITOR>(visitor), nodes, frustumPlanes);
+    }
+
+    // Visit the stars from brightMag to limitingMag in the view, with the
+    // stars of distant octree nodes combined, see StarAggregates::visit().
+    // The combined light of the nodes is computed by the first call.
+    template <class STAR_VISITOR, class AGGREGATE_VISITOR>
+    void findFaintStars(STAR_VISITOR&& starVisitor,
+                        AGGREGATE_VISITOR&& aggregateVisitor,
+                        const Eigen::Vector3f& obsPosition,
+                        const Eigen::Quaternionf& obsOrientation,
+                        float fovY,
+                        float aspectRatio,
+                        float brightMag,
+                        float limitingMag,
+                        float maxAngle) const
+    {
+        if (aggregates == nullptr)
+            aggregates = std::make_unique<StarAggregates>(octree);
+
+        Eigen::Hyperplane<float, 3> frustumPlanes[5];
+        computeFrustumPlanes(frustumPlanes, obsPosition, obsOrientation, fovY, aspectRatio);
+        aggregates->visit(std::forward<STAR_VISITOR>(starVisitor),
+                          std::forward<AGGREGATE_VISITOR>(aggregateVisitor),
+                          octree,
+                          obsPosition,
+                          frustumPlanes,
+                          brightMag,
+                          limitingMag,
+                          maxAngle);
+    }
+
+    // Find the stars that may lie within angle radians of the ray from
+    // obsPosition along the unit vector direction, for picking
+    void findStarsInCone(StarHandler& starHandler,
+                         const Eigen::Vector3f& obsPosition,
+                         const Eigen::Vector3f& direction,
+                         float angle,
+                         float limitingMag) const;
+
     void findCloseStars(StarHandler& starHandler,
                         const Eigen::Vector3f& obsPosition,
                         float radius) const;
 
+    // Find up to nStars stars for which filter(const Star&) returns true,
+    // nearest to obsPosition first
+    template <class FILTER>
+    std::vector<const Star*> findNearestStars(const Eigen::Vector3f& obsPosition,
+                                              std::uint32_t nStars,
+                                              FILTER&& filter) const
+    {
+        return findBestStars(obsPosition, nStars, std::forward<FILTER>(filter),
+                             [&obsPosition](const Star& star)
+                             {
+                                 return (obsPosition - star.getPosition()).squaredNorm();
+                             },
+                             [](float minDistance, float /* brightest */)
+                             {
+                                 return minDistance > 0.0f ? minDistance * minDistance : 0.0f;
+                             });
+    }
+
+    // Same, for the stars of the lowest apparent magnitude seen from
+    // obsPosition, brightest first
+    template <class FILTER>
+    std::vector<const Star*> findBrightestStars(const UniversalCoord& obsPosition,
+                                                std::uint32_t nStars,
+                                                FILTER&& filter) const
+    {
+        Eigen::Vector3f position = obsPosition.toLy().cast<float>();
+        return findBestStars(position, nStars, std::forward<FILTER>(filter),
+                             [&position, &obsPosition](const Star& star)
+                             {
+                                 // If the star is closer than one light year,
+                                 // use a more precise distance estimate.
+                                 float distance = (position - star.getPosition()).norm();
+                                 if (distance < 1.0f)
+                                     distance = obsPosition.offsetFromLy(star.getPosition()).norm();
+                                 return star.getApparentMagnitude(distance);
+                             },
+                             [](float minDistance, float brightest)
+                             {
+                                 // Extinction only makes stars fainter
+                                 if (minDistance <= 1.0f)
+                                     return -std::numeric_limits<float>::infinity();
+                                 return astro::absToAppMag(brightest, minDistance);
+                             });
+    }
+
+    // Same, for the stars of the lowest absolute magnitude
+    template <class FILTER>
+    std::vector<const Star*> findLuminousStars(std::uint32_t nStars,
+                                               FILTER&& filter) const
+    {
+        return findBestStars(Eigen::Vector3f::Zero(), nStars, std::forward<FILTER>(filter),
+                             [](const Star& star) { return star.getAbsoluteMagnitude(); },
+                             [](float /* minDistance */, float brightest) { return brightest; });
+    }
+
+    // Like findVisibleStarBatches, for the stars of the tile sets. These
+    // aren't returned by the other searches, see StarTileSet.
+    template <class VISITOR>
+    void findVisibleTileStarBatches(VISITOR&& visitor,
+                                    const Eigen::Vector3f& obsPosition,
+                                    const Eigen::Quaternionf&   obsOrientation,
+                                    float fovY,
+                                    float aspectRatio,
+                                    float limitingMag,
+                                    OctreeProcStats *stats = nullptr) const
+    {
+        if (tiles.empty())
+            return;
+
+        Eigen::Hyperplane<float, 3> frustumPlanes[5];
+        computeFrustumPlanes(frustumPlanes, obsPosition, obsOrientation, fovY, aspectRatio);
+        for (const auto& tileSet : tiles)
+        {
+            tileSet->visitVisibleStars(visitor,
+                                       obsPosition,
+                                       frustumPlanes,
+                                       limitingMag,
+                                       stats);
+        }
+    }
+
+    // Stars too many to keep in memory, drawn but not searched. Catalogs
+    // split into magnitude tiers by makestartiers have a tile set for each
+    // tier fainter than the one loaded as the star database; the tiles of
+    // a tier are only read once the limiting magnitude reaches its stars.
+    bool hasTiles() const { return !tiles.empty(); }
+    void addTiles(std::unique_ptr<StarTileSet>&&);
+    // Release the least recently used tiles beyond the budget of each set
+    void trimTiles() const;
+
+    // Add a node of the stars, their indexes and names to parent
+    void accountMemory(celestia::util::MemoryUsage& parent) const;
+    // Write the stars after finish() as a tile set
+    bool writeTiles(std::ostream&) const;
+
+    // Compute the positions of all stars with orbits at the time t, in
+    // order so that each barycenter is done before the stars orbiting it.
+    // The renderer calls this once per frame; it must not run while other
+    // threads call getStarPosition().
+    void updateOrbitingStarPositions(double t) const;
+    // Same as star.getPosition(t), but stars with orbits are looked up in
+    // the positions of the last updateOrbitingStarPositions() call when it
+    // was made for the time t
+    UniversalCoord getStarPosition(const Star& star, double t) const;
+
     std::string getStarName    (const Star&, bool i18n = false) const;
-    void getStarName(const Star& star, char* nameBuffer, unsigned int bufferSize, bool i18n = false) const;
+    std::string_view getStarName(const Star& star, char* nameBuffer, unsigned int bufferSize, bool i18n = false) const;
     std::string getStarNameList(const Star&, const unsigned int maxNames = MAX_STAR_NAMES) const;
 
     StarNameDatabase* getNameDatabase() const;
     void setNameDatabase(StarNameDatabase*);
 
     bool load(std::istream&, const fs::path& resourcePath = fs::path());
+    bool load(PreparsedCatalog&, const fs::path& resourcePath = fs::path());
     bool loadBinary(std::istream&);
+    bool loadBinary(const fs::path&);
+    // Apply the definitions of a star catalog edited after finish(). Stars
+    // are changed in place as long as they stay in their octree node;
+    // returns the number of definitions that couldn't be applied, new
+    // stars and ones that moved out of their node, which need the
+    // database to be built again.
+    std::size_t update(std::istream&, const fs::path& resourcePath = fs::path());
 
     enum Catalog
     {
@@ -75,26 +309,89 @@ class StarDatabase
     // a HIPPARCOS stars.
     static const AstroCatalog::IndexNumber MAX_HIPPARCOS_NUMBER = 999999;
 
-    struct CrossIndexEntry
-    {
-        AstroCatalog::IndexNumber catalogNumber;
-        AstroCatalog::IndexNumber celCatalogNumber;
-
-        bool operator<(const CrossIndexEntry&) const;
-    };
-
-    typedef std::vector<CrossIndexEntry> CrossIndex;
-
     bool   loadCrossIndex  (const Catalog, std::istream&);
+    // Packed cross index files are mapped into memory
+    bool   loadCrossIndex  (const Catalog, const fs::path&);
     AstroCatalog::IndexNumber searchCrossIndexForCatalogNumber(const Catalog, const AstroCatalog::IndexNumber number) const;
+    // Resolve many numbers at once, see CrossIndex::find()
+    std::vector<AstroCatalog::IndexNumber> searchCrossIndexForCatalogNumbers(const Catalog, const std::vector<AstroCatalog::IndexNumber>& numbers) const;
     Star*  searchCrossIndex(const Catalog, const AstroCatalog::IndexNumber number) const;
     AstroCatalog::IndexNumber crossIndex(const Catalog, const AstroCatalog::IndexNumber number) const;
 
+    // Record a catalog file that contributes stars to the database; the
+    // octree cache is only used if none of these files has changed.
+    void addCatalogSource(const fs::path&);
+    void setOctreeCacheFile(const fs::path&);
+    void setLoaderThreads(unsigned int);
+    void setOctreeSplitPolicy(const OctreeSplitPolicy&);
+    // Count the octree nodes and stars of each level after finish()
+    void getOctreeStatistics(std::vector<OctreeLevelStatistics>&) const;
+
     void finish();
 
     static StarDatabase* read(std::istream&);
 
 private:
+    bool load(Tokenizer&, Parser&, const fs::path& resourcePath);
+
+    // Find the nStars stars accepted by filter with the lowest values of
+    // key(star), traversing the octree in the order of bound(), see
+    // FlatOctree::visitNodesByBound().
+    template <class FILTER, class KEY, class BOUND>
+    std::vector<const Star*> findBestStars(const Eigen::Vector3f& obsPosition,
+                                           std::uint32_t nStars,
+                                           FILTER&& filter,
+                                           KEY&& key,
+                                           BOUND&& bound) const
+    {
+        // Max-heap of the best stars found so far
+        std::vector<std::pair<float, const Star*>> best;
+        if (nStars == 0)
+            return {};
+        best.reserve(nStars);
+
+        octree.visitNodesByBound(bound,
+                                 [&](const Star* nodeStars, std::uint32_t count)
+                                 {
+                                     for (std::uint32_t i = 0; i < count; i++)
+                                     {
+                                         const Star& star = nodeStars[i];
+                                         if (best.size() == nStars)
+                                         {
+                                             float value = key(star);
+                                             if (!(value < best.front().first) || !filter(star))
+                                                 continue;
+                                             std::pop_heap(best.begin(), best.end());
+                                             best.back() = { value, &star };
+                                             std::push_heap(best.begin(), best.end());
+                                         }
+                                         else if (filter(star))
+                                         {
+                                             best.emplace_back(key(star), &star);
+                                             std::push_heap(best.begin(), best.end());
+                                         }
+                                     }
+
+                                     return best.size() == nStars
+                                         ? best.front().first
+                                         : std::numeric_limits<float>::infinity();
+                                 },
+                                 obsPosition);
+
+        std::sort_heap(best.begin(), best.end());
+        std::vector<const Star*> result;
+        result.reserve(best.size());
+        for (const auto& entry : best)
+            result.push_back(entry.second);
+        return result;
+    }
+
+    static void computeFrustumPlanes(Eigen::Hyperplane<float, 3>* frustumPlanes,
+                                     const Eigen::Vector3f& obsPosition,
+                                     const Eigen::Quaternionf& obsOrientation,
+                                     float fovY,
+                                     float aspectRatio);
+
     bool createStar(Star* star,
                     DataDisposition disposition,
                     AstroCatalog::IndexNumber catalogNumber,
@@ -102,28 +399,68 @@ private:
                     const fs::path& path,
                     const bool isBarycenter);
 
+    bool addBinaryStar(AstroCatalog::IndexNumber catNo,
+                       float x, float y, float z,
+                       std::int16_t absMag,
+                       std::uint16_t spectralType,
+                       const Eigen::Vector3f& velocity);
+    void buildBinFileIndex();
     void buildOctree();
     void buildIndexes();
+    std::uint64_t getOctreeCacheKey() const;
+    bool loadOctreeCache();
+    void saveOctreeCache() const;
     Star* findWhileLoading(AstroCatalog::IndexNumber catalogNumber) const;
+    void resolveBarycenters();
+    void updateOctreeDrift();
+    void buildOrbitingStarList();
+
+    // Stars per block of unsortedStars, so that each block is a large
+    // catalog allocation
+    static constexpr unsigned int UnsortedStarBlockSize =
+        static_cast<unsigned int>(celestia::util::LargeCatalogAllocation / sizeof(Star));
 
     int nStars{ 0 };
 
-    Star*             stars{ nullptr };
+    celestia::util::CatalogArray<Star> stars;
     StarNameDatabase* namesDB{ nullptr };
     Star**            catalogNumberIndex{ nullptr };
-    StarOctree*       octreeRoot{ nullptr };
+    FlatStarOctree    octree;
+    // Built by the first findFaintStars() call, and again after update()
+    mutable std::unique_ptr<StarAggregates> aggregates;
+    std::vector<std::unique_ptr<StarTileSet>> tiles;
+
+    // Stars with orbits sorted by address, with the index in the same list
+    // of their barycenter if it has an orbit too
+    std::vector<const Star*> orbitingStars;
+    std::vector<std::uint32_t> orbitingStarBarycenters;
+    // Indexes of orbitingStars with barycenters before the stars orbiting
+    // them
+    std::vector<std::uint32_t> orbitingStarOrder;
+    mutable std::vector<UniversalCoord> orbitingStarPositions;
+    mutable double orbitingStarTime{ std::numeric_limits<double>::quiet_NaN() };
     AstroCatalog::IndexNumber nextAutoCatalogNumber{ 0xfffffffe };
 
-    std::vector<CrossIndex*> crossIndexes;
+    std::vector<std::unique_ptr<CrossIndex>> crossIndexes;
+
+    fs::path octreeCacheFile;
+    unsigned int loaderThreads{ 1 };
+    OctreeSplitPolicy octreeSplitPolicy{ DynamicStarOctree::defaultSplitPolicy };
+    celestia::util::CacheKey catalogSourcesKey;
 
     // These values are used by the star database loader; they are
     // not used after loading is complete.
-    BlockArray<Star> unsortedStars;
+    BlockArray<Star, celestia::util::CatalogAllocator<Star>> unsortedStars{ UnsortedStarBlockSize };
+    // Pointer-based octree built from unsortedStars; flattened into octree
+    StarOctree*      octreeRoot{ nullptr };
     // List of stars loaded from binary file, sorted by catalog number
     Star** binFileCatalogNumberIndex{ nullptr };
     unsigned int binFileStarCount{ 0 };
     // Catalog number -> star mapping for stars loaded from stc files
     std::map<AstroCatalog::IndexNumber, Star*> stcFileCatalogNumberIndex;
+    // Spectral type -> details of the stars loaded from stc files, as
+    // catalogs repeat a few thousand spectral types many times
+    std::unordered_map<std::string, StarDetails*> spectralTypeDetails;
 
     struct BarycenterUsage
     {
@@ -131,12 +468,14 @@ private:
         AstroCatalog::IndexNumber barycenterCatNo;
     };
     std::vector<BarycenterUsage> barycenters;
+    // Count of the definitions rejected by update(), null outside of it
+    std::size_t* rejectedUpdates{ nullptr };
 };
 
 
 Star* StarDatabase::getStar(const uint32_t n) const
 {
-    return stars + n;
+    return stars.get() + n;
 }
 
 uint32_t StarDatabase::size() const
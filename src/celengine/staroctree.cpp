@@ -14,16 +14,6 @@
 
 using namespace Eigen;
 
-// Maximum permitted orbital radius for stars, in light years. Orbital
-// radii larger than this value are not guaranteed to give correct
-// results. The problem case is extremely faint stars (such as brown
-// dwarfs.) The distance from the viewer to star's barycenter is used
-// rough estimate of the brightness for the purpose of culling. When the
-// star is very faint, this estimate may not work when the star is
-// far from the barycenter. Thus, the star octree traversal will always
-// render stars with orbits that are closer than MAX_STAR_ORBIT_RADIUS.
-static const float MAX_STAR_ORBIT_RADIUS = 1.0f;
-
 
 // The octree node into which a star is placed is dependent on two properties:
 // its obsPosition and its luminosity--the fainter the star, the deeper the node
@@ -50,9 +40,9 @@ bool starOrbitStraddlesNodesPredicate(const Vector3f& cellCenterPos, const Star&
 }
 
 
-float starAbsoluteMagnitudeDecayFunction(const float excludingFactor)
+float starAbsoluteMagnitude(const Star& star)
 {
-    return astro::lumToAbsMag(astro::absMagToLum(excludingFactor) / 4.0f);
+    return star.getAbsoluteMagnitude();
 }
 
 
@@ -71,16 +61,17 @@ DynamicStarOctree* DynamicStarOctree::getChild(const Star&          obj,
 }
 
 
-// In testing, changing SPLIT_THRESHOLD from 100 to 50 nearly
+// In testing, changing the split threshold from 100 to 50 nearly
 // doubled the number of nodes in the tree, but provided only between a
-// 0 to 5 percent frame rate improvement.
-template<> unsigned int DynamicStarOctree::SPLIT_THRESHOLD = 75;
+// 0 to 5 percent frame rate improvement. Children hold stars a quarter as
+// luminous as their parent's brightest, 2.5 log10(4) magnitudes fainter.
+template<> const OctreeSplitPolicy DynamicStarOctree::defaultSplitPolicy{ 75, 1.50515f };
 template<> DynamicStarOctree::LimitingFactorPredicate*
            DynamicStarOctree::limitingFactorPredicate = starAbsoluteMagnitudePredicate;
 template<> DynamicStarOctree::StraddlingPredicate*
            DynamicStarOctree::straddlingPredicate = starOrbitStraddlesNodesPredicate;
-template<> DynamicStarOctree::ExclusionFactorDecayFunction*
-           DynamicStarOctree::decayFunction = starAbsoluteMagnitudeDecayFunction;
+template<> DynamicStarOctree::ObjectMagnitudeFunction*
+           DynamicStarOctree::magnitudeFunction = starAbsoluteMagnitude;
 
 
 // total specialization of the StaticOctree template process*() methods for stars:
@@ -127,14 +118,16 @@ void StarOctree::processVisibleObjects(StarHandler&    processor,
 #endif
         const Star& obj = _firstObject[i];
 
-        if (obj.getAbsoluteMagnitude() < dimmest)
-        {
-            float distance    = (obsPosition - obj.getPosition()).norm();
-            float appMag      = obj.getApparentMagnitude(distance);
+        // The stars of a node are sorted by absolute magnitude, so the
+        // rest are all too faint
+        if (obj.getAbsoluteMagnitude() >= dimmest)
+            break;
 
-            if (appMag < limitingFactor || (distance < MAX_STAR_ORBIT_RADIUS && obj.getOrbit()))
-                processor.process(obj, distance, appMag);
-        }
+        float distance    = (obsPosition - obj.getPosition()).norm();
+        float appMag      = obj.getApparentMagnitude(distance);
+
+        if (appMag < limitingFactor || (distance < MAX_STAR_ORBIT_RADIUS && obj.getOrbit()))
+            processor.process(obj, distance, appMag);
     }
 
     // See if any of the objects in child nodes are potentially included
@@ -213,3 +206,54 @@ void StarOctree::processCloseObjects(StarHandler&    processor,
         }
     }
 }
+
+
+// specialization of the FlatOctree per-node object processing for stars;
+// this mirrors the object loops of the StaticOctree methods above.
+template<>
+void FlatStarOctree::processNodeObjects(StarHandler&    processor,
+                                        const Vector3f& obsPosition,
+                                        float           limitingFactor,
+                                        const Star*     objects,
+                                        std::uint32_t   nObjects,
+                                        float           dimmest) const
+{
+    nObjects = countBrighterStars(objects, nObjects, dimmest);
+    for (std::uint32_t i = 0; i < nObjects; ++i)
+    {
+        const Star& obj = objects[i];
+
+        float distance    = (obsPosition - obj.getPosition()).norm();
+        float appMag      = obj.getApparentMagnitude(distance);
+
+        if (appMag < limitingFactor || (distance < MAX_STAR_ORBIT_RADIUS && obj.getOrbit()))
+            processor.process(obj, distance, appMag);
+    }
+}
+
+
+template<>
+void FlatStarOctree::processCloseNodeObjects(StarHandler&    processor,
+                                             const Vector3f& obsPosition,
+                                             float           boundingRadius,
+                                             std::uint32_t   node) const
+{
+    // Compute distance squared to avoid having to sqrt for distance
+    // comparison.
+    float radiusSquared    = boundingRadius * boundingRadius;
+
+    Star* firstObject = m_firstObject[node];
+    std::uint32_t nObjects = m_objectCount[node];
+    for (std::uint32_t i = 0; i < nObjects; ++i)
+    {
+        Star& obj = firstObject[i];
+
+        if ((obsPosition - obj.getPosition()).squaredNorm() < radiusSquared)
+        {
+            float distance    = (obsPosition - obj.getPosition()).norm();
+            float appMag      = obj.getApparentMagnitude(distance);
+
+            processor.process(obj, distance, appMag);
+        }
+    }
+}
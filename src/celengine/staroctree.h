@@ -13,12 +13,37 @@
 #ifndef _CELENGINE_STAROCTREE_H_
 #define _CELENGINE_STAROCTREE_H_
 
+#include <algorithm>
+#include <cstdint>
 #include <celengine/star.h>
 #include <celengine/octree.h>
+#include <celengine/flatoctree.h>
 
 
 typedef DynamicOctree  <Star, float> DynamicStarOctree;
 typedef StaticOctree   <Star, float> StarOctree;
 typedef OctreeProcessor<Star, float> StarHandler;
+typedef FlatOctree     <Star, float> FlatStarOctree;
+
+// Maximum permitted orbital radius for stars, in light years. Orbital
+// radii larger than this value are not guaranteed to give correct
+// results. The problem case is extremely faint stars (such as brown
+// dwarfs.) The distance from the viewer to star's barycenter is used
+// rough estimate of the brightness for the purpose of culling. When the
+// star is very faint, this estimate may not work when the star is
+// far from the barycenter. Thus, the star octree traversal will always
+// render stars with orbits that are closer than MAX_STAR_ORBIT_RADIUS.
+constexpr inline float MAX_STAR_ORBIT_RADIUS = 1.0f;
+
+// The stars of each octree node are sorted by absolute magnitude, brightest
+// first. Return how many of the nStars stars of a node are brighter than
+// dimmest, the bound passed to the visitors of the octree traversals.
+inline std::uint32_t
+countBrighterStars(const Star* stars, std::uint32_t nStars, float dimmest)
+{
+    const Star* end = std::partition_point(stars, stars + nStars,
+                                           [dimmest](const Star& star) { return star.getAbsoluteMagnitude() < dimmest; });
+    return static_cast<std::uint32_t>(end - stars);
+}
 
 #endif  // _CELENGINE_STAROCTREE_H_
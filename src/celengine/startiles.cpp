@@ -0,0 +1,270 @@
+// startiles.cpp
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// Star catalogs kept on disk and read one octree node at a time.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <ostream>
+#include <celengine/stellarclass.h>
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
+#include <celutil/gettext.h>
+#include <celutil/logger.h>
+#include "startiles.h"
+
+using celestia::util::GetLogger;
+namespace celutil = celestia::util;
+
+/* Star tile files start with a header:
+ *
+ *   char[8]  "CELSTILE"
+ *   uint16   version, 0x0101
+ *   uint16   reserved, 0
+ *   uint32   number of nodes
+ *   uint32   number of stars
+ *
+ * followed by the octree nodes in breadth-first order:
+ *
+ *   float    center x, y, z
+ *   float    scale
+ *   float    exclusion factor
+ *   float    brightest absolute magnitude of the stars in the node
+ *   uint32   index of the first child, 0 for leaves
+ *   uint32   number of stars in the node
+ *
+ * and the stars of all nodes in the same order, the stars of each node
+ * sorted by absolute magnitude, using the records of the binary star
+ * database:
+ *
+ *   uint32   catalog number
+ *   float    position x, y, z
+ *   int16    absolute magnitude * 256
+ *   uint16   spectral type, see StellarClass::packV1()
+ *
+ * All numbers are little endian.
+ */
+
+namespace
+{
+constexpr const char TILE_FILE_HEADER[] = "CELSTILE";
+constexpr std::uint16_t TILE_FILE_VERSION = 0x0101;
+constexpr std::size_t HEADER_SIZE = sizeof(TILE_FILE_HEADER) - 1 + 12;
+constexpr std::size_t NODE_SIZE = 32;
+constexpr std::size_t STAR_RECORD_SIZE = 20;
+
+bool writeNode(std::ostream& out, const FlatStarOctree::Node& node, float brightest)
+{
+    return celutil::writeLE<float>(out, node.center.x())
+        && celutil::writeLE<float>(out, node.center.y())
+        && celutil::writeLE<float>(out, node.center.z())
+        && celutil::writeLE<float>(out, node.scale)
+        && celutil::writeLE<float>(out, node.exclusionFactor)
+        && celutil::writeLE<float>(out, brightest)
+        && celutil::writeLE<std::uint32_t>(out, node.firstChild)
+        && celutil::writeLE<std::uint32_t>(out, node.objectCount);
+}
+
+bool writeStar(std::ostream& out, const Star& star)
+{
+    Eigen::Vector3f position = star.getPosition();
+    float absMag = std::round(star.getAbsoluteMagnitude() * 256.0f);
+    absMag = std::clamp(absMag,
+                        static_cast<float>(std::numeric_limits<std::int16_t>::min()),
+                        static_cast<float>(std::numeric_limits<std::int16_t>::max()));
+    StellarClass sc = StellarClass::parse(star.getSpectralType());
+
+    return celutil::writeLE<std::uint32_t>(out, star.getIndex())
+        && celutil::writeLE<float>(out, position.x())
+        && celutil::writeLE<float>(out, position.y())
+        && celutil::writeLE<float>(out, position.z())
+        && celutil::writeLE<std::int16_t>(out, static_cast<std::int16_t>(absMag))
+        && celutil::writeLE<std::uint16_t>(out, sc.packV1());
+}
+} // end unnamed namespace
+
+
+std::unique_ptr<StarTileSet> StarTileSet::open(const fs::path& path, std::size_t budget)
+{
+    auto tileSet = std::make_unique<StarTileSet>();
+    celutil::MemoryMappedFile& file = tileSet->file;
+    if (!file.open(path, celutil::MemoryMappedFile::AccessHint::Random))
+    {
+        GetLogger()->error(_("Error opening star tiles {}\n"), path);
+        return nullptr;
+    }
+
+    const char* ptr = file.data();
+    std::size_t headerLength = sizeof(TILE_FILE_HEADER) - 1;
+    if (file.size() < HEADER_SIZE
+        || std::memcmp(ptr, TILE_FILE_HEADER, headerLength) != 0
+        || celutil::fromMemoryLE<std::uint16_t>(ptr + headerLength) != TILE_FILE_VERSION)
+    {
+        GetLogger()->error(_("Bad header for star tiles {}\n"), path);
+        return nullptr;
+    }
+
+    auto nNodes = celutil::fromMemoryLE<std::uint32_t>(ptr + headerLength + 4);
+    auto nStars = celutil::fromMemoryLE<std::uint32_t>(ptr + headerLength + 8);
+    ptr += HEADER_SIZE;
+    if (nNodes == 0
+        || (file.size() - HEADER_SIZE) / NODE_SIZE < nNodes
+        || (file.size() - HEADER_SIZE - nNodes * NODE_SIZE) / STAR_RECORD_SIZE != nStars
+        || (file.size() - HEADER_SIZE - nNodes * NODE_SIZE) % STAR_RECORD_SIZE != 0)
+    {
+        GetLogger()->error(_("Star tiles {} are truncated\n"), path);
+        return nullptr;
+    }
+
+    std::vector<FlatStarOctree::Node> nodes;
+    nodes.reserve(nNodes);
+    tileSet->brightest.reserve(nNodes);
+    tileSet->firstStar.reserve(nNodes);
+    std::uint64_t starIndex = 0;
+    for (std::uint32_t i = 0; i < nNodes; ++i, ptr += NODE_SIZE)
+    {
+        FlatStarOctree::Node node;
+        node.center = Eigen::Vector3f(celutil::fromMemoryLE<float>(ptr),
+                                      celutil::fromMemoryLE<float>(ptr + 4),
+                                      celutil::fromMemoryLE<float>(ptr + 8));
+        node.scale = celutil::fromMemoryLE<float>(ptr + 12);
+        node.exclusionFactor = celutil::fromMemoryLE<float>(ptr + 16);
+        node.firstChild = celutil::fromMemoryLE<std::uint32_t>(ptr + 24);
+        node.firstObject = nullptr;
+        node.objectCount = celutil::fromMemoryLE<std::uint32_t>(ptr + 28);
+
+        // Children follow their parent in breadth-first order
+        bool validChildren = node.firstChild == 0
+                          || (node.firstChild > i && static_cast<std::uint64_t>(node.firstChild) + 8 <= nNodes);
+        if (!validChildren || !(node.scale > 0.0f) || nStars - starIndex < node.objectCount)
+        {
+            GetLogger()->error(_("Star tiles {} are corrupt\n"), path);
+            return nullptr;
+        }
+
+        nodes.push_back(node);
+        tileSet->brightest.push_back(celutil::fromMemoryLE<float>(ptr + 20));
+        tileSet->firstStar.push_back(starIndex);
+        starIndex += node.objectCount;
+    }
+
+    if (starIndex != nStars)
+    {
+        GetLogger()->error(_("Star tiles {} are corrupt\n"), path);
+        return nullptr;
+    }
+
+    tileSet->octree = FlatStarOctree(nodes);
+    tileSet->nStars = nStars;
+    tileSet->tiles.resize(nNodes);
+    tileSet->lruPosition.resize(nNodes, tileSet->lru.end());
+    tileSet->badTiles.resize(nNodes, false);
+    tileSet->budget = budget;
+
+    GetLogger()->info(_("{} stars in {} star tiles {}\n"), nStars, nNodes, path);
+    return tileSet;
+}
+
+
+bool StarTileSet::write(std::ostream& out, const FlatStarOctree& octree)
+{
+    std::uint32_t nNodes = octree.nodeCount();
+    std::uint64_t nStars = 0;
+    for (std::uint32_t i = 0; i < nNodes; ++i)
+        nStars += octree.node(i).objectCount;
+    if (nStars > std::numeric_limits<std::uint32_t>::max())
+        return false;
+
+    out.write(TILE_FILE_HEADER, sizeof(TILE_FILE_HEADER) - 1);
+    bool ok = out.good()
+        && celutil::writeLE<std::uint16_t>(out, TILE_FILE_VERSION)
+        && celutil::writeLE<std::uint16_t>(out, 0)
+        && celutil::writeLE<std::uint32_t>(out, nNodes)
+        && celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(nStars));
+
+    for (std::uint32_t i = 0; ok && i < nNodes; ++i)
+    {
+        FlatStarOctree::Node node = octree.node(i);
+        float brightest = std::numeric_limits<float>::max();
+        for (std::uint32_t j = 0; j < node.objectCount; ++j)
+            brightest = std::min(brightest, node.firstObject[j].getAbsoluteMagnitude());
+        ok = writeNode(out, node, brightest);
+    }
+
+    for (std::uint32_t i = 0; ok && i < nNodes; ++i)
+    {
+        FlatStarOctree::Node node = octree.node(i);
+        for (std::uint32_t j = 0; ok && j < node.objectCount; ++j)
+            ok = writeStar(out, node.firstObject[j]);
+    }
+
+    return ok;
+}
+
+
+void StarTileSet::trim()
+{
+    while (loadedBytes > budget && !lru.empty())
+    {
+        std::uint32_t node = lru.back();
+        lru.pop_back();
+        lruPosition[node] = lru.end();
+        tiles[node].reset();
+        loadedBytes -= octree.node(node).objectCount * sizeof(Star);
+    }
+}
+
+
+const Star* StarTileSet::getTile(std::uint32_t node)
+{
+    if (tiles[node] != nullptr)
+    {
+        lru.splice(lru.begin(), lru, lruPosition[node]);
+        return tiles[node].get();
+    }
+
+    if (badTiles[node])
+        return nullptr;
+
+    std::uint32_t count = octree.node(node).objectCount;
+    const char* ptr = file.data() + HEADER_SIZE
+                    + octree.nodeCount() * NODE_SIZE
+                    + firstStar[node] * STAR_RECORD_SIZE;
+
+    auto stars = std::make_unique<Star[]>(count);
+    for (std::uint32_t i = 0; i < count; ++i, ptr += STAR_RECORD_SIZE)
+    {
+        StellarClass sc;
+        StarDetails* details = nullptr;
+        if (sc.unpackV1(celutil::fromMemoryLE<std::uint16_t>(ptr + 18)))
+            details = StarDetails::GetStarDetails(sc);
+        if (details == nullptr)
+        {
+            GetLogger()->error(_("Bad spectral type in star tile {}\n"), node);
+            badTiles[node] = true;
+            return nullptr;
+        }
+
+        Star& star = stars[i];
+        star.setIndex(celutil::fromMemoryLE<AstroCatalog::IndexNumber>(ptr));
+        star.setPosition(celutil::fromMemoryLE<float>(ptr + 4),
+                         celutil::fromMemoryLE<float>(ptr + 8),
+                         celutil::fromMemoryLE<float>(ptr + 12));
+        star.setAbsoluteMagnitude(static_cast<float>(celutil::fromMemoryLE<std::int16_t>(ptr + 16)) / 256.0f);
+        star.setDetails(details);
+    }
+
+    tiles[node] = std::move(stars);
+    lru.push_front(node);
+    lruPosition[node] = lru.begin();
+    loadedBytes += count * sizeof(Star);
+    return tiles[node].get();
+}
@@ -0,0 +1,99 @@
+// startiles.h
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// Star catalogs kept on disk and read one octree node at a time.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <list>
+#include <memory>
+#include <vector>
+#include <Eigen/Geometry>
+#include <celcompat/filesystem.h>
+#include <celengine/star.h>
+#include <celengine/staroctree.h>
+#include <celutil/mmapfile.h>
+
+/*! Stars of a catalog too large to keep in memory. The file holds the
+ *  octree built by StarDatabase with the stars of each node stored as a
+ *  separate tile. Only the nodes are kept in memory; the tile of a node is
+ *  read when a traversal first reaches the node with a limiting magnitude
+ *  that one of its stars can pass, and the least recently used tiles are
+ *  released by trim() once they take more memory than the budget.
+ *
+ *  The stars are only meant to be drawn. Pointers to them are valid until
+ *  the next call to trim(), and they can't be selected.
+ */
+class StarTileSet
+{
+ public:
+    StarTileSet() = default;
+    StarTileSet(const StarTileSet&) = delete;
+    StarTileSet& operator=(const StarTileSet&) = delete;
+
+    //! Budget is the memory for tiles in bytes
+    static std::unique_ptr<StarTileSet> open(const fs::path&, std::size_t budget);
+    //! Write the stars of an octree built by StarDatabase::finish()
+    static bool write(std::ostream&, const FlatStarOctree&);
+
+    /*! Call visitor(const Star* stars, std::uint32_t count, float dimmest)
+     *  for the visible stars of each node, as with
+     *  FlatOctree::visitVisibleNodes(). Tiles are read as needed.
+     */
+    template <class VISITOR>
+    void visitVisibleStars(VISITOR&&                          visitor,
+                           const Eigen::Vector3f&             obsPosition,
+                           const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                           float                              limitingMag,
+                           OctreeProcStats*                   stats = nullptr)
+    {
+        octree.visitVisibleNodeIndices([this, &visitor](std::uint32_t node, std::uint32_t nStars, float dimmest)
+                                       {
+                                           // None of the stars can be visible
+                                           if (brightest[node] >= dimmest)
+                                               return;
+                                           const Star* stars = getTile(node);
+                                           if (stars != nullptr)
+                                               visitor(stars, nStars, dimmest);
+                                       },
+                                       obsPosition,
+                                       frustumPlanes,
+                                       limitingMag,
+                                       stats);
+    }
+
+    //! Release the least recently used tiles beyond the budget
+    void trim();
+
+    std::size_t starCount() const { return nStars; }
+    std::size_t loadedSize() const { return loadedBytes; }
+
+ private:
+    const Star* getTile(std::uint32_t node);
+
+    FlatStarOctree octree;
+    // The smallest absolute magnitude of the stars of each node
+    std::vector<float> brightest;
+    // The first star of each node in the file
+    std::vector<std::uint64_t> firstStar;
+    std::size_t nStars{ 0 };
+
+    std::vector<std::unique_ptr<Star[]>> tiles;
+    // Loaded tiles, most recently used first
+    std::list<std::uint32_t> lru;
+    std::vector<std::list<std::uint32_t>::iterator> lruPosition;
+    std::vector<bool> badTiles;
+    std::size_t budget{ 0 };
+    std::size_t loadedBytes{ 0 };
+
+    celestia::util::MemoryMappedFile file;
+};
@@ -8,6 +8,8 @@
 // of the License, or (at your option) any later version.
 
 #include <cassert>
+#include <cctype>
+#include <cstring>
 #include "stellarclass.h"
 
 using namespace std;
@@ -214,9 +216,66 @@ enum ParseState
 };
 
 
+// Parse the spectral types most common in catalogs, a class from O to M,
+// a subclass digit and an optional luminosity class, without the state
+// machine. Other strings, including these with extra characters, are left
+// to the state machine, which gives the same results for the common ones.
+static bool
+parseCommonMK(const string& st, StellarClass& sc)
+{
+    if (st.size() < 2 || st.size() > 5 || !isdigit(static_cast<unsigned char>(st[1])))
+        return false;
+
+    StellarClass::SpectralClass specClass;
+    switch (st[0])
+    {
+    case 'O': specClass = StellarClass::Spectral_O; break;
+    case 'B': specClass = StellarClass::Spectral_B; break;
+    case 'A': specClass = StellarClass::Spectral_A; break;
+    case 'F': specClass = StellarClass::Spectral_F; break;
+    case 'G': specClass = StellarClass::Spectral_G; break;
+    case 'K': specClass = StellarClass::Spectral_K; break;
+    case 'M': specClass = StellarClass::Spectral_M; break;
+    default:
+        return false;
+    }
+
+    StellarClass::LuminosityClass lumClass;
+    const char* lum = st.c_str() + 2;
+    if (*lum == '\0')
+        lumClass = StellarClass::Lum_Unknown;
+    else if (!strcmp(lum, "V"))
+        lumClass = StellarClass::Lum_V;
+    else if (!strcmp(lum, "IV"))
+        lumClass = StellarClass::Lum_IV;
+    else if (!strcmp(lum, "III"))
+        lumClass = StellarClass::Lum_III;
+    else if (!strcmp(lum, "II"))
+        lumClass = StellarClass::Lum_II;
+    else if (!strcmp(lum, "Ib"))
+        lumClass = StellarClass::Lum_Ib;
+    else if (!strcmp(lum, "Ia"))
+        lumClass = StellarClass::Lum_Ia;
+    else if (!strcmp(lum, "Ia0"))
+        lumClass = StellarClass::Lum_Ia0;
+    else if (!strcmp(lum, "VI"))
+        lumClass = StellarClass::Lum_VI;
+    else
+        return false;
+
+    sc = StellarClass(StellarClass::NormalStar, specClass,
+                      static_cast<unsigned int>(st[1] - '0'), lumClass);
+    return true;
+}
+
+
 StellarClass
 StellarClass::parse(const string& st)
 {
+    StellarClass common;
+    if (parseCommonMK(st, common))
+        return common;
+
     uint32_t i = 0;
     ParseState state = BeginState;
     StellarClass::StarType starType = StellarClass::NormalStar;
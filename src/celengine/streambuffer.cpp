@@ -0,0 +1,165 @@
+// streambuffer.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Shared buffer for the vertices streamed to the GPU every frame.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <cstring>
+#include "glstate.h"
+#include "streambuffer.h"
+
+namespace celgl
+{
+
+StreamBuffer::StreamBuffer(GLsizeiptr _segmentSize) :
+    segmentSize(_segmentSize)
+{
+}
+
+StreamBuffer::~StreamBuffer()
+{
+#ifndef GL_ES
+    for (GLsync fence : fences)
+    {
+        if (fence != nullptr)
+            glDeleteSync(fence);
+    }
+    if (mapped != nullptr)
+    {
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+#endif
+    if (buffer != 0)
+        celestia::gl::deleteBuffers(1, &buffer);
+}
+
+void
+StreamBuffer::init()
+{
+    initialized = true;
+    glGenBuffers(1, &buffer);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, buffer);
+
+#ifndef GL_ES
+    if (celestia::gl::ARB_buffer_storage && celestia::gl::ARB_sync)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        GLsizeiptr size = segmentSize * RingSize;
+        glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+        mapped = static_cast<char*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+        if (mapped != nullptr)
+            return;
+
+        // Buffer storage is immutable, so start over with a new buffer
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+        celestia::gl::deleteBuffers(1, &buffer);
+        glGenBuffers(1, &buffer);
+        celestia::gl::bindBuffer(GL_ARRAY_BUFFER, buffer);
+    }
+#endif
+
+    celestia::gl::bufferData(GL_ARRAY_BUFFER, segmentSize, nullptr, GL_STREAM_DRAW);
+}
+
+GLuint
+StreamBuffer::getBuffer()
+{
+    if (!initialized)
+        init();
+    return buffer;
+}
+
+GLintptr
+StreamBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+    if (size > segmentSize)
+        return -1;
+
+    if (!initialized)
+        init();
+
+    GLsizeiptr start = (offset + alignment - 1) / alignment * alignment;
+    if (start + size > segmentSize)
+    {
+#ifndef GL_ES
+        if (mapped != nullptr)
+        {
+            nextSegment();
+        }
+        else
+#endif
+        {
+            // Orphan the old storage so that the draws still reading it
+            // don't have to complete first
+            celestia::gl::bindBuffer(GL_ARRAY_BUFFER, buffer);
+            celestia::gl::bufferData(GL_ARRAY_BUFFER, segmentSize, nullptr, GL_STREAM_DRAW);
+        }
+        start = 0;
+    }
+
+    offset = start + size;
+#ifndef GL_ES
+    if (mapped != nullptr)
+        return static_cast<GLintptr>(segment * segmentSize + start);
+#endif
+    return static_cast<GLintptr>(start);
+}
+
+void
+StreamBuffer::write(GLintptr dataOffset, const void* data, GLsizeiptr size)
+{
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, buffer);
+#ifndef GL_ES
+    if (mapped != nullptr)
+    {
+        std::memcpy(mapped + dataOffset, data, size);
+        celestia::gl::countUpload(celestia::gl::UploadType::Vertex, static_cast<std::size_t>(size));
+        return;
+    }
+#endif
+    celestia::gl::bufferSubData(GL_ARRAY_BUFFER, dataOffset, size, data);
+}
+
+void
+StreamBuffer::endFrame()
+{
+#ifndef GL_ES
+    if (mapped != nullptr && offset > 0)
+        nextSegment();
+#endif
+}
+
+#ifndef GL_ES
+// Switch to the next segment of the ring, waiting for the GPU to finish
+// drawing from it if necessary.
+void
+StreamBuffer::nextSegment()
+{
+    fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    segment = (segment + 1) % RingSize;
+    offset = 0;
+
+    GLsync fence = fences[segment];
+    if (fence != nullptr)
+    {
+        constexpr GLuint64 timeout = 1000000; // 1 ms
+        GLenum status;
+        do
+        {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        }
+        while (status == GL_TIMEOUT_EXPIRED);
+        glDeleteSync(fence);
+        fences[segment] = nullptr;
+    }
+}
+#endif
+
+} // end namespace celgl
@@ -0,0 +1,75 @@
+// streambuffer.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Shared buffer for the vertices streamed to the GPU every frame.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include "glsupport.h"
+
+namespace celgl
+{
+
+// StreamBuffer hands out ranges of one large buffer object to the geometry
+// rebuilt every frame, so that it doesn't need a buffer of its own.
+//
+// When ARB_buffer_storage and ARB_sync are available, the buffer is a ring
+// of persistently mapped segments: the ranges of a frame are allocated one
+// after the other in one segment, and the data is written straight into
+// them. A fence at the end of each segment keeps the CPU from writing
+// into one that the GPU may still read. Otherwise the data is uploaded with
+// glBufferSubData and the storage is orphaned when the buffer is full, so
+// the data of a range must be drawn before the next range is allocated.
+//
+// The buffer object is created on first use, as there may be no current
+// GL context when the class is constructed.
+class StreamBuffer
+{
+ public:
+    explicit StreamBuffer(GLsizeiptr _segmentSize = 4 << 20);
+    ~StreamBuffer();
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer(StreamBuffer&&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(StreamBuffer&&) = delete;
+
+    // Reserve size bytes at an offset which is a multiple of alignment and
+    // return the offset, or -1 if size exceeds the size of a segment
+    GLintptr allocate(GLsizeiptr size, GLsizeiptr alignment);
+    // Copy size bytes of data to offset in a range returned by allocate();
+    // the buffer is bound to GL_ARRAY_BUFFER
+    void write(GLintptr offset, const void* data, GLsizeiptr size);
+    GLuint getBuffer();
+    // Called once the draws of a frame are issued; the next frame starts
+    // in a new segment
+    void endFrame();
+
+ private:
+    // Number of segments in the persistently mapped ring
+    static constexpr unsigned int RingSize = 3;
+
+    void init();
+#ifndef GL_ES
+    void nextSegment();
+#endif
+
+    GLsizeiptr segmentSize;
+    // Start of the free space of the current segment
+    GLsizeiptr offset{ 0 };
+    GLuint buffer{ 0 };
+    bool initialized{ false };
+#ifndef GL_ES
+    char* mapped{ nullptr };
+    unsigned int segment{ 0 };
+    std::array<GLsync, RingSize> fences{};
+#endif
+};
+
+} // end namespace celgl
@@ -7,10 +7,19 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <celutil/filetype.h>
+#include <celutil/dircache.h>
 #include <celutil/logger.h>
-#include <celutil/fsutils.h>
-#include <fstream>
+#include <celimage/dxt_compress.h>
+#include <celimage/imageformats.h>
 #include <array>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <system_error>
+#include <thread>
+#include <fmt/format.h>
+#include "glsupport.h"
 #include "multitexture.h"
 #include "texmanager.h"
 
@@ -28,9 +37,9 @@ static std::array<const char*, 3> directories =
 };
 
 #ifdef USE_LIBAVIF
-static constexpr size_t nExt = 7;
+static constexpr size_t nExt = 8;
 #else
-static constexpr size_t nExt = 6;
+static constexpr size_t nExt = 7;
 #endif
 
 static std::array<const char*, nExt> extensions =
@@ -38,6 +47,7 @@ static std::array<const char*, nExt> extensions =
 #ifdef USE_LIBAVIF
     "avif",
 #endif
+    "ktx2",
     "png",
     "jpg",
     "jpeg",
@@ -63,22 +73,20 @@ fs::path TextureInfo::resolve(const fs::path& baseDir)
         // cout << "Resolve: testing [" << filename << "]\n";
         if (wildcard)
         {
-            filename = util::ResolveWildcard(filename, extensions);
+            filename = util::GetDirectoryCache().resolveWildcard(filename, extensions);
             if (!filename.empty())
                 return filename;
         }
-        else
+        else if (util::GetDirectoryCache().exists(filename))
         {
-            ifstream in(filename);
-            if (in.good())
-                return filename;
+            return filename;
         }
     }
 
     fs::path filename = baseDir / directories[resolution] / source;
     if (wildcard)
     {
-        fs::path matched = util::ResolveWildcard(filename, extensions);
+        fs::path matched = util::GetDirectoryCache().resolveWildcard(filename, extensions);
         if (!matched.empty())
             return matched;
     }
@@ -87,25 +95,268 @@ fs::path TextureInfo::resolve(const fs::path& baseDir)
 }
 
 
-Texture* TextureInfo::load(const fs::path& name)
+namespace
+{
+
+// Large JPEG textures are created from a reduced version of at most this
+// size first
+constexpr int PreviewSize = 1024;
+
+// Bump when the compression of textures changes, so that textures
+// compressed by an older version aren't used.
+constexpr std::uint32_t TextureCacheRevision = 1;
+
+bool compressTextures = false;
+fs::path textureCacheDir;
+
+
+// Name of the cached compressed version of a texture, which changes
+// whenever the file is modified. Returns an empty path if there's no cache
+// or the file can't be examined.
+fs::path
+GetTextureCachePath(const fs::path& filename, bool mipmaps)
+{
+    if (textureCacheDir.empty())
+        return fs::path();
+
+    std::error_code ec;
+    fs::path source = fs::absolute(filename, ec);
+    if (ec)
+        return fs::path();
+    auto modified = fs::last_write_time(filename, ec);
+    if (ec)
+        return fs::path();
+    auto fileSize = fs::file_size(filename, ec);
+    if (ec)
+        return fs::path();
+
+    return textureCacheDir / fmt::format("{:016x}-{:x}-{:x}-{}{}.ktx2",
+                                         std::hash<std::string>()(source.string()),
+                                         modified.time_since_epoch().count(),
+                                         fileSize,
+                                         mipmaps ? "m" : "",
+                                         TextureCacheRevision);
+}
+
+
+void
+SaveCachedTexture(Image& image, const fs::path& cachePath)
+{
+    // Textures are compressed on several loader threads at once, so each
+    // writes a file of its own and renames it into place when complete.
+    fs::path tempPath = cachePath;
+    tempPath += fmt::format(".{:x}", std::hash<std::thread::id>()(std::this_thread::get_id()));
+
+    std::error_code ec;
+    bool saved = SaveKTX2Image(tempPath, image);
+    if (saved)
+        fs::rename(tempPath, cachePath, ec);
+    if (!saved || ec)
+    {
+        GetLogger()->warn("Failed to write texture cache file {}\n", cachePath);
+        fs::remove(tempPath, ec);
+    }
+}
+
+// Decodes the image on a loader thread; only the upload is left to the
+// render thread
+class TextureLoader : public ResourceInfo<Texture>::AsyncLoader
+{
+ public:
+    TextureLoader(const fs::path& name,
+                  float bumpHeight,
+                  Texture::AddressMode addressMode,
+                  Texture::MipMapMode mipMode) :
+        name(name),
+        bumpHeight(bumpHeight),
+        addressMode(addressMode),
+        mipMode(mipMode)
+    {
+    }
+
+    bool decode() override
+    {
+        // Textures compressed before are loaded from the cache as they are
+        if (compressible())
+        {
+            cachePath = GetTextureCachePath(name, mipMode != Texture::NoMipMaps);
+            std::error_code ec;
+            if (!cachePath.empty() && fs::exists(cachePath, ec))
+            {
+                image.reset(LoadKTX2Image(cachePath));
+                if (image != nullptr)
+                    return true;
+                GetLogger()->warn("Ignoring invalid texture cache file {}\n", cachePath);
+            }
+        }
+
+        // The DCT of JPEG images can be decoded at a fraction of their
+        // size much faster; the full image replaces it later. Tiled
+        // textures can't be replaced in place.
+        if (bumpHeight == 0.0f && DetermineFileType(name) == Content_JPEG)
+        {
+            int width;
+            int height;
+            image.reset(LoadJPEGPreview(name, PreviewSize, width, height));
+            if (image == nullptr)
+                return false;
+
+            refinement = image->getWidth() < width &&
+                         width <= gl::maxTextureSize &&
+                         height <= gl::maxTextureSize;
+            if (!refinement)
+                compress(image);
+            return true;
+        }
+
+        image.reset(LoadImageFromFile(name));
+        if (image != nullptr && bumpHeight != 0.0f)
+        {
+            image.reset(image->computeNormalMap(bumpHeight, addressMode == Texture::Wrap));
+            mipMode = Texture::DefaultMipMaps;
+        }
+        if (image != nullptr)
+            compress(image);
+        return image != nullptr;
+    }
+
+    Texture* create() override
+    {
+        GetLogger()->debug("Creating texture: {}\n", name);
+        Texture* tex = CreateTextureFromImage(*image, addressMode, mipMode);
+        // See LoadTextureFromFile()
+        if (bumpHeight == 0.0f &&
+            DetermineFileType(name) == Content_DXT5NormalMap &&
+            image->getFormat() == PixelFormat::DXT5)
+        {
+            tex->setFormatOptions(Texture::DXT5NormalMap);
+        }
+        image.reset();
+        return tex;
+    }
+
+    bool refinable() const override
+    {
+        return refinement;
+    }
+
+    bool decodeRefinement() override
+    {
+        fullImage.reset(LoadImageFromFile(name));
+        if (fullImage != nullptr)
+            compress(fullImage);
+        return fullImage != nullptr;
+    }
+
+    void refine(Texture* tex) override
+    {
+        GetLogger()->debug("Refining texture: {}\n", name);
+        static_cast<ImageTexture*>(tex)->replaceImage(*fullImage, mipMode);
+        fullImage.reset();
+    }
+
+    std::size_t size() const override
+    {
+        // The full image is only asked for once it's decoded
+        const Image* pending = image != nullptr ? image.get() : fullImage.get();
+        return pending == nullptr ? 0 : static_cast<std::size_t>(pending->getSize());
+    }
+
+ private:
+    // Normal maps don't survive the compression of colors
+    bool compressible() const
+    {
+        return compressTextures &&
+               gl::EXT_texture_compression_s3tc &&
+               bumpHeight == 0.0f &&
+               DetermineFileType(name) != Content_DXT5NormalMap;
+    }
+
+    // Compress an uncompressed image with its mipmaps, which can't be
+    // generated for compressed textures, and cache it
+    void compress(std::unique_ptr<Image>& img)
+    {
+        if (!compressible() || img->isCompressed() || img->getFormat() == PixelFormat::ALPHA)
+            return;
+
+        if (mipMode != Texture::NoMipMaps)
+            img = BuildMipmaps(*img);
+        img = CompressDXT(*img, img->hasAlpha() ? PixelFormat::DXT5 : PixelFormat::DXT1);
+        if (!cachePath.empty())
+            SaveCachedTexture(*img, cachePath);
+    }
+
+    fs::path name;
+    float bumpHeight;
+    Texture::AddressMode addressMode;
+    Texture::MipMapMode mipMode;
+    std::unique_ptr<Image> image;
+    // Set when image is a reduced version of the full image
+    bool refinement{ false };
+    std::unique_ptr<Image> fullImage;
+    // Where the compressed image is cached, if it is
+    fs::path cachePath;
+};
+
+} // end unnamed namespace
+
+
+void SetTextureCompression(const fs::path& cacheDir)
 {
-    Texture::AddressMode addressMode = Texture::EdgeClamp;
-    Texture::MipMapMode mipMode = Texture::DefaultMipMaps;
+    compressTextures = true;
+    if (cacheDir.empty())
+        return;
+
+    std::error_code ec;
+    fs::create_directories(cacheDir, ec);
+    if (ec)
+    {
+        GetLogger()->error("Failed to create texture cache directory {}\n", cacheDir);
+        return;
+    }
 
+    textureCacheDir = cacheDir;
+}
+
+
+Texture::AddressMode TextureInfo::getAddressMode() const
+{
     if (flags & WrapTexture)
-        addressMode = Texture::Wrap;
-    else if (flags & BorderClamp)
-        addressMode = Texture::BorderClamp;
+        return Texture::Wrap;
+    if (flags & BorderClamp)
+        return Texture::BorderClamp;
+    return Texture::EdgeClamp;
+}
+
 
-    if (flags & NoMipMaps)
-        mipMode = Texture::NoMipMaps;
+Texture::MipMapMode TextureInfo::getMipMapMode() const
+{
+    return (flags & NoMipMaps) ? Texture::NoMipMaps : Texture::DefaultMipMaps;
+}
+
+
+Texture* TextureInfo::load(const fs::path& name)
+{
+    Texture::AddressMode addressMode = getAddressMode();
 
     if (bumpHeight == 0.0f)
     {
         GetLogger()->debug("Loading texture: {}\n", name);
-        return LoadTextureFromFile(name, addressMode, mipMode);
+        return LoadTextureFromFile(name, addressMode, getMipMapMode());
     }
 
     GetLogger()->debug("Loading bump map: {}\n", name);
     return LoadHeightMapFromFile(name, bumpHeight, addressMode);
 }
+
+
+std::unique_ptr<ResourceInfo<Texture>::AsyncLoader>
+TextureInfo::asyncLoader(const fs::path& name)
+{
+    // Virtual textures load their tiles on demand already
+    if (DetermineFileType(name) == Content_CelestiaTexture)
+        return nullptr;
+
+    GetLogger()->debug("Loading texture asynchronously: {}\n", name);
+    return std::make_unique<TextureLoader>(name, bumpHeight, getAddressMode(), getMipMapMode());
+}
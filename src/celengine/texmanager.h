@@ -65,26 +65,38 @@ class TextureInfo : public ResourceInfo<Texture>
 
     fs::path resolve(const fs::path&) override;
     Texture* load(const fs::path&) override;
-};
-
-inline bool operator<(const TextureInfo& ti0, const TextureInfo& ti1)
-{
-    if (ti0.resolution == ti1.resolution)
+    // Hash of the fields compared by operator==
+    std::size_t hash() const
     {
-        if (ti0.source == ti1.source)
-            return ti0.path < ti1.path;
-        else
-            return ti0.source < ti1.source;
+        std::size_t h = fs::hash_value(source);
+        h = ResourceHashCombine(h, fs::hash_value(path));
+        return ResourceHashCombine(h, resolution);
     }
-    else
+    std::unique_ptr<AsyncLoader> asyncLoader(const fs::path&) override;
+    std::size_t getMemoryUsage() const override
     {
-        return ti0.resolution < ti1.resolution;
+        return resource != nullptr ? resource->getMemoryUsage() : 0;
     }
+
+ private:
+    Texture::AddressMode getAddressMode() const;
+    Texture::MipMapMode getMipMapMode() const;
+};
+
+// Textures with the same source and resolution share their handle
+// regardless of their flags
+inline bool operator==(const TextureInfo& ti0, const TextureInfo& ti1)
+{
+    return ti0.resolution == ti1.resolution && ti0.source == ti1.source && ti0.path == ti1.path;
 }
 
 typedef ResourceManager<TextureInfo> TextureManager;
 
 extern TextureManager* GetTextureManager();
 
+// Compress the uncompressed textures loaded asynchronously to DXT1 or DXT5
+// on the loader threads, keeping them in cacheDir unless it's empty
+void SetTextureCompression(const fs::path& cacheDir);
+
 #endif // _TEXMANAGER_H_
 
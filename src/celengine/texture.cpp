@@ -13,6 +13,7 @@
 #include <cmath>
 #include <fstream>
 #include <iostream>
+#include <memory>
 
 #include <Eigen/Core>
 #include "glsupport.h"
@@ -23,6 +24,7 @@
 #include "framebuffer.h"
 #include "texture.h"
 #include "virtualtex.h"
+#include "glstate.h"
 
 
 using namespace celestia;
@@ -225,6 +227,7 @@ static void LoadMipmapSet(Image& img, GLenum target)
                          GL_UNSIGNED_BYTE,
                          img.getMipLevel(mip));
         }
+        celestia::gl::countUpload(celestia::gl::UploadType::Texture, img.getMipLevelSize(mip));
     }
 }
 
@@ -255,6 +258,60 @@ static void LoadMiplessTexture(Image& img, GLenum target)
                      GL_UNSIGNED_BYTE,
                      img.getMipLevel(0));
     }
+    celestia::gl::countUpload(celestia::gl::UploadType::Texture, img.getMipLevelSize(0));
+}
+
+
+// Load the w x h area at (x, y) of a mip level of img as level mip of the
+// bound texture. When GL can unpack subimages, the texels are read in
+// place; otherwise they're copied to the matching level of tile first.
+static void LoadTileLevel(Image& img, int imgMip,
+                          int x, int y, int w, int h,
+                          Image* tile, int mip,
+                          GLenum target)
+{
+    int imgWidth = max(img.getWidth() >> imgMip, 1);
+    int imgHeight = max(img.getHeight() >> imgMip, 1);
+    x = min(x, imgWidth - w);
+    y = min(y, imgHeight - h);
+
+    const unsigned char* texels;
+    if (gl::EXT_unpack_subimage)
+    {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, imgWidth);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, x);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, y);
+        texels = img.getMipLevel(imgMip);
+    }
+    else
+    {
+        int components = img.getComponents();
+        for (int row = 0; row < h; row++)
+        {
+            memcpy(tile->getPixelRow(mip, row),
+                   img.getPixelRow(imgMip, y + row) + x * components,
+                   w * components);
+        }
+        texels = tile->getMipLevel(mip);
+    }
+
+    glTexImage2D(target,
+                 mip,
+                 getInternalFormat(img.getFormat()),
+                 w, h,
+                 0,
+                 (GLenum) img.getFormat(),
+                 GL_UNSIGNED_BYTE,
+                 texels);
+    celestia::gl::countUpload(celestia::gl::UploadType::Texture,
+                              static_cast<std::size_t>(w) * h * img.getComponents());
+
+    if (gl::EXT_unpack_subimage)
+    {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    }
 }
 
 
@@ -278,6 +335,19 @@ static int CalcMipLevelCount(int w, int h)
 }
 
 
+// Estimated bytes of a texture made from img; mipmaps which the image
+// doesn't contain are generated by the driver and add a third.
+static std::size_t TextureMemory(const Image& img, bool mipmap, bool precomputedMipMaps)
+{
+    auto baseSize = static_cast<std::size_t>(img.getMipLevelSize(0));
+    if (!mipmap)
+        return baseSize;
+    if (precomputedMipMaps)
+        return static_cast<std::size_t>(img.getSize());
+    return baseSize + baseSize / 3;
+}
+
+
 Texture::Texture(int w, int h, int d) :
     width(w),
     height(h),
@@ -315,6 +385,14 @@ void Texture::setBorderColor(Color /*unused*/)
 }
 
 
+void Texture::setSize(int w, int h, int d)
+{
+    width = w;
+    height = h;
+    depth = d;
+}
+
+
 int Texture::getWidth() const
 {
     return width;
@@ -352,9 +430,32 @@ ImageTexture::ImageTexture(Image& img,
     glName(0)
 {
     glGenTextures(1, (GLuint*) &glName);
-    glBindTexture(GL_TEXTURE_2D, glName);
+    celestia::gl::bindTexture(GL_TEXTURE_2D, glName);
 
+    GLenum texAddress = GetGLTexAddressMode(addressMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, texAddress);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, texAddress);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    if (gl::EXT_texture_filter_anisotropic && texCaps.preferredAnisotropy > 1)
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, texCaps.preferredAnisotropy);
+    }
+
+    upload(img, mipMapMode);
+}
 
+
+void ImageTexture::replaceImage(Image& img, MipMapMode mipMapMode)
+{
+    celestia::gl::bindTexture(GL_TEXTURE_2D, glName);
+    upload(img, mipMapMode);
+}
+
+
+// Load the image into the bound texture
+void ImageTexture::upload(Image& img, MipMapMode mipMapMode)
+{
     bool mipmap = mipMapMode != NoMipMaps;
     bool precomputedMipMaps = false;
 
@@ -372,18 +473,9 @@ ImageTexture::ImageTexture(Image& img,
         mipmap = false;
     }
 
-    GLenum texAddress = GetGLTexAddressMode(addressMode);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, texAddress);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, texAddress);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
                     mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
 
-    if (gl::EXT_texture_filter_anisotropic && texCaps.preferredAnisotropy > 1)
-    {
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, texCaps.preferredAnisotropy);
-    }
-
     bool genMipmaps = mipmap && !precomputedMipMaps;
 #ifndef GL_ES
     if (genMipmaps && !FramebufferObject::isSupported())
@@ -415,21 +507,23 @@ ImageTexture::ImageTexture(Image& img,
         glGenerateMipmap(GL_TEXTURE_2D);
     DumpTextureMipmapInfo(GL_TEXTURE_2D);
 
+    setSize(img.getWidth(), img.getHeight());
     alpha = img.hasAlpha();
     compressed = img.isCompressed();
+    memoryUsage = TextureMemory(img, mipmap, precomputedMipMaps);
 }
 
 
 ImageTexture::~ImageTexture()
 {
     if (glName != 0)
-        glDeleteTextures(1, (const GLuint*) &glName);
+        celestia::gl::deleteTextures(1, (const GLuint*) &glName);
 }
 
 
 void ImageTexture::bind()
 {
-    glBindTexture(GL_TEXTURE_2D, glName);
+    celestia::gl::bindTexture(GL_TEXTURE_2D, glName);
 }
 
 
@@ -490,15 +584,16 @@ TiledTexture::TiledTexture(Image& img,
         mipmap = false;
 
     GLenum texAddress = GetGLTexAddressMode(EdgeClamp);
-    int components = img.getComponents();
 
-    // Create a temporary image which we'll use for the tile texels
+    // Create a temporary image which we'll use for the tile texels. It's
+    // only needed when the tiles can't be read in place from img.
     int tileWidth = img.getWidth() / uSplit;
     int tileHeight = img.getHeight() / vSplit;
     int tileMipLevelCount = CalcMipLevelCount(tileWidth, tileHeight);
-    Image* tile = new Image(img.getFormat(),
-                            tileWidth, tileHeight,
-                            tileMipLevelCount);
+    int tileLevels = precomputedMipMaps ? tileMipLevelCount : 1;
+    unique_ptr<Image> tile;
+    if (img.isCompressed() || !gl::EXT_unpack_subimage)
+        tile = make_unique<Image>(img.getFormat(), tileWidth, tileHeight, tileLevels);
 
     for (int v = 0; v < vSplit; v++)
     {
@@ -506,7 +601,7 @@ TiledTexture::TiledTexture(Image& img,
         {
             // Create the texture and set up sampling and addressing
             glGenTextures(1, (GLuint*)&glNames[v * uSplit + u]);
-            glBindTexture(GL_TEXTURE_2D, glNames[v * uSplit + u]);
+            celestia::gl::bindTexture(GL_TEXTURE_2D, glNames[v * uSplit + u]);
 
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, texAddress);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, texAddress);
@@ -530,7 +625,7 @@ TiledTexture::TiledTexture(Image& img,
                     {
                         int blockSize = getCompressedBlockSize(img.getFormat());
                         unsigned char* imgMip =
-                            img.getMipLevel(min(mip, mipLevelCount));
+                            img.getMipLevel(min(mip, mipLevelCount - 1));
                         unsigned int mipWidth  = max((unsigned int) img.getWidth() >> mip, 1u);
                         unsigned char* tileMip = tile->getMipLevel(mip);
                         unsigned int tileMipWidth  = max((unsigned int) tile->getWidth() >> mip, 1u);
@@ -551,13 +646,23 @@ TiledTexture::TiledTexture(Image& img,
                                    destBytesPerRow);
                         }
                     }
+                    LoadMipmapSet(*tile, GL_TEXTURE_2D);
                 }
                 else
                 {
-                    // TODO: Handle uncompressed textures with prebuilt mipmaps
+#ifndef GL_ES
+                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, tileMipLevelCount - 1);
+#endif
+                    for (int mip = 0; mip < tileMipLevelCount; mip++)
+                    {
+                        int tileMipWidth = max(tileWidth >> mip, 1);
+                        int tileMipHeight = max(tileHeight >> mip, 1);
+                        LoadTileLevel(img, min(mip, mipLevelCount - 1),
+                                      u * tileMipWidth, v * tileMipHeight,
+                                      tileMipWidth, tileMipHeight,
+                                      tile.get(), mip, GL_TEXTURE_2D);
+                    }
                 }
-
-                LoadMipmapSet(*tile, GL_TEXTURE_2D);
             }
             else
             {
@@ -580,43 +685,27 @@ TiledTexture::TiledTexture(Image& img,
                                destBytesPerRow);
                     }
                 }
-                else
-                {
-                    unsigned char* tilePixels = img.getPixels() +
-                        (v * tileHeight * img.getWidth() + u * tileWidth) * components;
-                    for (int y = 0; y < tileHeight; y++)
-                    {
-                        memcpy(tile->getPixels() + y * tileWidth * components,
-                               tilePixels + y * img.getWidth() * components,
-                               tileWidth * components);
-                    }
-                }
 
-                if (mipmap)
-                {
-                    if (FramebufferObject::isSupported())
-                    {
-                        LoadMiplessTexture(*tile, GL_TEXTURE_2D);
-                        glGenerateMipmap(GL_TEXTURE_2D);
-                    }
 #ifndef GL_ES
-                    else
-                    {
-                        glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
-                        LoadMiplessTexture(*tile, GL_TEXTURE_2D);
-                    }
+                if (mipmap && !FramebufferObject::isSupported())
+                    glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
 #endif
-                }
-                else
-                {
+                if (img.isCompressed())
                     LoadMiplessTexture(*tile, GL_TEXTURE_2D);
-                }
+                else
+                    LoadTileLevel(img, 0,
+                                  u * tileWidth, v * tileHeight,
+                                  tileWidth, tileHeight,
+                                  tile.get(), 0, GL_TEXTURE_2D);
+
+                if (mipmap && FramebufferObject::isSupported())
+                    glGenerateMipmap(GL_TEXTURE_2D);
                 DumpTextureMipmapInfo(GL_TEXTURE_2D);
             }
         }
     }
 
-    delete tile;
+    memoryUsage = TextureMemory(img, mipmap, precomputedMipMaps);
 }
 
 
@@ -627,7 +716,7 @@ TiledTexture::~TiledTexture()
         for (int i = 0; i < uSplit * vSplit; i++)
         {
             if (glNames[i] != 0)
-                glDeleteTextures(1, (const GLuint*) &glNames[i]);
+                celestia::gl::deleteTextures(1, (const GLuint*) &glNames[i]);
         }
         delete[] glNames;
     }
@@ -645,7 +734,7 @@ void TiledTexture::setBorderColor(Color borderColor)
     {
         for (int j = 0; j < uSplit; j++)
         {
-            glBindTexture(GL_TEXTURE_2D, glNames[i * uSplit + j]);
+            celestia::gl::bindTexture(GL_TEXTURE_2D, glNames[i * uSplit + j]);
             SetBorderColor(borderColor, GL_TEXTURE_2D);
         }
     }
@@ -673,6 +762,253 @@ const TextureTile TiledTexture::getTile(int lod, int u, int v)
 }
 
 
+TextureAtlas::TextureAtlas(PixelFormat format, int slotSize, int slotsPerSide) :
+    format(format),
+    slotSize(slotSize),
+    slotsPerSide(slotsPerSide)
+{
+    int size = slotSize * slotsPerSide;
+    int internalFormat = getInternalFormat(format);
+
+    glGenTextures(1, (GLuint*) &glName);
+    celestia::gl::bindTexture(GL_TEXTURE_2D, glName);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+#ifndef GL_ES
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+#endif
+
+    bool isCompressed = format == PixelFormat::DXT1 ||
+                        format == PixelFormat::DXT3 ||
+                        format == PixelFormat::DXT5;
+    if (isCompressed)
+    {
+        // Compressed storage can't be allocated without data
+        int dataSize = (size / 4) * (size / 4) * getCompressedBlockSize(format);
+        std::vector<std::uint8_t> data(dataSize, 0);
+        glCompressedTexImage2D(GL_TEXTURE_2D, 0, internalFormat, size, size, 0,
+                               dataSize, data.data());
+    }
+    else
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, size, size, 0,
+                     (GLenum) format, GL_UNSIGNED_BYTE, nullptr);
+    }
+
+    // Slots are handed out from the start of the atlas
+    for (int i = slotsPerSide * slotsPerSide - 1; i >= 0; i--)
+        freeSlots.push_back(i);
+}
+
+
+TextureAtlas::~TextureAtlas()
+{
+    if (glName != 0)
+        celestia::gl::deleteTextures(1, (const GLuint*) &glName);
+}
+
+
+int TextureAtlas::add(Image& img)
+{
+    if (freeSlots.empty() ||
+        img.getFormat() != format ||
+        img.getWidth() != slotSize ||
+        img.getHeight() != slotSize)
+    {
+        return -1;
+    }
+
+    int slot = freeSlots.back();
+    freeSlots.pop_back();
+
+    int x = (slot % slotsPerSide) * slotSize;
+    int y = (slot / slotsPerSide) * slotSize;
+    celestia::gl::bindTexture(GL_TEXTURE_2D, glName);
+    if (img.isCompressed())
+    {
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, x, y, slotSize, slotSize,
+                                  getInternalFormat(format),
+                                  img.getMipLevelSize(0),
+                                  img.getMipLevel(0));
+    }
+    else
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, slotSize, slotSize,
+                        (GLenum) format, GL_UNSIGNED_BYTE,
+                        img.getMipLevel(0));
+    }
+    celestia::gl::countUpload(celestia::gl::UploadType::Texture, img.getMipLevelSize(0));
+
+    return slot;
+}
+
+
+void TextureAtlas::remove(int slot)
+{
+    freeSlots.push_back(slot);
+}
+
+
+TextureTile TextureAtlas::getTile(int slot, float u, float v, float du, float dv) const
+{
+    // Inset by half a texel so that filtering doesn't blend in the
+    // neighboring slots
+    auto size = (float) (slotSize * slotsPerSide);
+    float scale = (float) (slotSize - 1) / size;
+    float u0 = ((float) ((slot % slotsPerSide) * slotSize) + 0.5f) / size;
+    float v0 = ((float) ((slot / slotsPerSide) * slotSize) + 0.5f) / size;
+
+    return TextureTile(glName, u0 + u * scale, v0 + v * scale, du * scale, dv * scale);
+}
+
+
+#ifndef GL_ES
+// Sized formats of sparse textures, as they need immutable storage
+static GLenum getSparseInternalFormat(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::RGB:
+    case PixelFormat::BGR:
+        return GL_RGB8;
+    case PixelFormat::RGBA:
+    case PixelFormat::BGRA:
+        return GL_RGBA8;
+    case PixelFormat::DXT1:
+    case PixelFormat::DXT3:
+    case PixelFormat::DXT5:
+        return (GLenum) format;
+    default:
+        return GL_NONE;
+    }
+}
+#endif
+
+
+SparseTileTexture::SparseTileTexture(PixelFormat format, int tileSize, int uTiles, int vTiles) :
+    format(format),
+    tileSize(tileSize),
+    uTiles(uTiles),
+    vTiles(vTiles)
+{
+#ifndef GL_ES
+    glGenTextures(1, (GLuint*) &glName);
+    celestia::gl::bindTexture(GL_TEXTURE_2D, glName);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SPARSE_ARB, GL_TRUE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    // Only the address space is reserved; pages are committed per tile
+    glTexStorage2D(GL_TEXTURE_2D, 1, getSparseInternalFormat(format),
+                   tileSize * uTiles, tileSize * vTiles);
+#endif
+}
+
+
+SparseTileTexture::~SparseTileTexture()
+{
+    if (glName != 0)
+        celestia::gl::deleteTextures(1, (const GLuint*) &glName);
+}
+
+
+bool SparseTileTexture::isSupported(PixelFormat format, int tileSize, int uTiles, int vTiles)
+{
+#ifdef GL_ES
+    return false;
+#else
+    if (!celestia::gl::ARB_sparse_texture)
+        return false;
+
+    GLenum internalFormat = getSparseInternalFormat(format);
+    if (internalFormat == GL_NONE)
+        return false;
+
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_SPARSE_TEXTURE_SIZE_ARB, &maxSize);
+    if (tileSize * uTiles > maxSize || tileSize * vTiles > maxSize)
+        return false;
+
+    // Implementations may not support some formats, such as RGB8, at all
+    GLint nPageSizes = 0;
+    glGetInternalformativ(GL_TEXTURE_2D, internalFormat, GL_NUM_VIRTUAL_PAGE_SIZES_ARB, 1, &nPageSizes);
+    if (nPageSizes <= 0)
+        return false;
+
+    // The first page size is the one used by default
+    GLint pageWidth = 0;
+    GLint pageHeight = 0;
+    glGetInternalformativ(GL_TEXTURE_2D, internalFormat, GL_VIRTUAL_PAGE_SIZE_X_ARB, 1, &pageWidth);
+    glGetInternalformativ(GL_TEXTURE_2D, internalFormat, GL_VIRTUAL_PAGE_SIZE_Y_ARB, 1, &pageHeight);
+    return pageWidth > 0 && pageHeight > 0 &&
+           tileSize % pageWidth == 0 && tileSize % pageHeight == 0;
+#endif
+}
+
+
+bool SparseTileTexture::add(int u, int v, Image& img)
+{
+    if (img.getFormat() != format ||
+        img.getWidth() != tileSize ||
+        img.getHeight() != tileSize)
+    {
+        return false;
+    }
+
+#ifdef GL_ES
+    return false;
+#else
+    int x = u * tileSize;
+    int y = v * tileSize;
+    celestia::gl::bindTexture(GL_TEXTURE_2D, glName);
+    glTexPageCommitmentARB(GL_TEXTURE_2D, 0, x, y, 0, tileSize, tileSize, 1, GL_TRUE);
+    if (img.isCompressed())
+    {
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, x, y, tileSize, tileSize,
+                                  getInternalFormat(format),
+                                  img.getMipLevelSize(0),
+                                  img.getMipLevel(0));
+    }
+    else
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, tileSize, tileSize,
+                        (GLenum) format, GL_UNSIGNED_BYTE,
+                        img.getMipLevel(0));
+    }
+    celestia::gl::countUpload(celestia::gl::UploadType::Texture, img.getMipLevelSize(0));
+    return true;
+#endif
+}
+
+
+void SparseTileTexture::remove(int u, int v)
+{
+#ifndef GL_ES
+    celestia::gl::bindTexture(GL_TEXTURE_2D, glName);
+    glTexPageCommitmentARB(GL_TEXTURE_2D, 0, u * tileSize, v * tileSize, 0,
+                           tileSize, tileSize, 1, GL_FALSE);
+#endif
+}
+
+
+TextureTile SparseTileTexture::getTile(int u, int v, float su, float sv, float du, float dv) const
+{
+    // Inset by half a texel, as the neighboring tiles may not be committed
+    auto width = (float) (tileSize * uTiles);
+    auto height = (float) (tileSize * vTiles);
+    float uScale = (float) (tileSize - 1) / width;
+    float vScale = (float) (tileSize - 1) / height;
+    float u0 = ((float) (u * tileSize) + 0.5f) / width;
+    float v0 = ((float) (v * tileSize) + 0.5f) / height;
+
+    return TextureTile(glName, u0 + su * uScale, v0 + sv * vScale, du * uScale, dv * vScale);
+}
+
+
 CubeMap::CubeMap(Image* faces[]) :
     Texture(faces[0]->getWidth(), faces[0]->getHeight()),
     glName(0)
@@ -705,7 +1041,7 @@ CubeMap::CubeMap(Image* faces[]) :
         mipmap = false;
 
     glGenTextures(1, (GLuint*) &glName);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, glName);
+    celestia::gl::bindTexture(GL_TEXTURE_CUBE_MAP, glName);
 
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -740,19 +1076,21 @@ CubeMap::CubeMap(Image* faces[]) :
     if (genMipmaps && FramebufferObject::isSupported())
         glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
     DumpTextureMipmapInfo(GL_TEXTURE_CUBE_MAP_POSITIVE_X);
+
+    memoryUsage = 6 * TextureMemory(*faces[0], mipmap, precomputedMipMaps);
 }
 
 
 CubeMap::~CubeMap()
 {
     if (glName != 0)
-        glDeleteTextures(1, (const GLuint*) &glName);
+        celestia::gl::deleteTextures(1, (const GLuint*) &glName);
 }
 
 
 void CubeMap::bind()
 {
-    glBindTexture(GL_TEXTURE_CUBE_MAP, glName);
+    celestia::gl::bindTexture(GL_TEXTURE_CUBE_MAP, glName);
 }
 
 
@@ -895,9 +1233,9 @@ Texture* CreateProceduralCubeMap(int size,
 }
 
 
-static Texture* CreateTextureFromImage(Image& img,
-                                       Texture::AddressMode addressMode,
-                                       Texture::MipMapMode mipMode)
+Texture* CreateTextureFromImage(Image& img,
+                                Texture::AddressMode addressMode,
+                                Texture::MipMapMode mipMode)
 {
     Texture* tex = nullptr;
 
@@ -10,8 +10,10 @@
 #ifndef _CELENGINE_TEXTURE_H_
 #define _CELENGINE_TEXTURE_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
+#include <vector>
 #include <celutil/color.h>
 #include <celcompat/filesystem.h>
 #include <celengine/image.h>
@@ -71,6 +73,9 @@ class Texture
     int getHeight() const;
     int getDepth() const;
 
+    //! Estimated bytes of the texture in graphics memory
+    virtual std::size_t getMemoryUsage() const { return memoryUsage; }
+
     bool hasAlpha() const { return alpha; }
     bool isCompressed() const { return compressed; }
 
@@ -103,8 +108,11 @@ class Texture
     };
 
  protected:
+    void setSize(int w, int h, int d = 1);
+
     bool alpha{ false };
     bool compressed{ false };
+    std::size_t memoryUsage{ 0 };
 
  private:
     int width;
@@ -127,7 +135,13 @@ class ImageTexture : public Texture
 
     unsigned int getName() const;
 
+    // Replace the texels with those of img, which may have a different
+    // size, keeping the GL texture and its address mode
+    void replaceImage(Image& img, MipMapMode);
+
  private:
+    void upload(Image& img, MipMapMode);
+
     unsigned int glName;
 };
 
@@ -152,6 +166,76 @@ class TiledTexture : public Texture
 };
 
 
+/*! A texture divided into square slots of the same size, each holding
+ *  the image of a tile without mipmaps. Tiles stored in the same atlas are
+ *  drawn without binding another texture.
+ */
+class TextureAtlas
+{
+ public:
+    TextureAtlas(celestia::PixelFormat format, int slotSize, int slotsPerSide);
+    ~TextureAtlas();
+
+    TextureAtlas(const TextureAtlas&) = delete;
+    TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+    //! Copy img to a free slot and return its index, or -1 if the atlas is
+    //! full or img doesn't match the format and slot size.
+    int add(Image& img);
+    void remove(int slot);
+
+    //! Map a rectangle of the tile in slot to the atlas
+    TextureTile getTile(int slot, float u, float v, float du, float dv) const;
+
+    celestia::PixelFormat getFormat() const { return format; }
+    bool isFull() const { return freeSlots.empty(); }
+    bool isEmpty() const { return freeSlots.size() == (std::size_t) (slotsPerSide * slotsPerSide); }
+
+ private:
+    unsigned int glName{ 0 };
+    celestia::PixelFormat format;
+    int slotSize;
+    int slotsPerSide;
+    std::vector<int> freeSlots;
+};
+
+
+//! A level of a virtual texture in one sparse texture, whose tiles only
+//! take graphics memory while they are committed, so that all the tiles of
+//! the level are drawn from the same texture.
+class SparseTileTexture
+{
+ public:
+    SparseTileTexture(celestia::PixelFormat format, int tileSize, int uTiles, int vTiles);
+    ~SparseTileTexture();
+
+    SparseTileTexture(const SparseTileTexture&) = delete;
+    SparseTileTexture& operator=(const SparseTileTexture&) = delete;
+
+    //! Whether a sparse texture of uTiles by vTiles tiles in format can be
+    //! created, with tiles made of whole pages
+    static bool isSupported(celestia::PixelFormat format, int tileSize, int uTiles, int vTiles);
+
+    //! Commit the pages of tile (u, v) and copy img to them; false if img
+    //! doesn't match the format and tile size.
+    bool add(int u, int v, Image& img);
+    //! Release the pages of tile (u, v)
+    void remove(int u, int v);
+
+    //! Map a rectangle of tile (u, v) to the texture
+    TextureTile getTile(int u, int v, float su, float sv, float du, float dv) const;
+
+    celestia::PixelFormat getFormat() const { return format; }
+
+ private:
+    unsigned int glName{ 0 };
+    celestia::PixelFormat format;
+    int tileSize;
+    int uTiles;
+    int vTiles;
+};
+
+
 class CubeMap : public Texture
 {
  public:
@@ -180,6 +264,11 @@ extern Texture* CreateProceduralTexture(int width, int height,
 extern Texture* CreateProceduralCubeMap(int size, celestia::PixelFormat format,
                                         ProceduralTexEval func);
 
+// Requires a GL context, unlike loading the image
+extern Texture* CreateTextureFromImage(Image& img,
+                                       Texture::AddressMode addressMode,
+                                       Texture::MipMapMode mipMode);
+
 extern Texture* LoadTextureFromFile(const fs::path& filename,
                                     Texture::AddressMode addressMode = Texture::EdgeClamp,
                                     Texture::MipMapMode mipMode = Texture::DefaultMipMaps);
@@ -0,0 +1,226 @@
+// tilepack.cpp
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// Virtual texture tiles packed into a single file.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+#include <tuple>
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
+#include <celutil/gettext.h>
+#include <celutil/logger.h>
+#include "image.h"
+#include "tilepack.h"
+
+using celestia::PixelFormat;
+using celestia::util::GetLogger;
+namespace celutil = celestia::util;
+
+/* Tile pack files start with a header:
+ *
+ *   char[8]  "CELTPACK"
+ *   uint16   version, 0x0100
+ *   uint16   reserved, 0
+ *   uint32   number of tiles
+ *
+ * followed by the index of the tiles sorted by level, v and u:
+ *
+ *   uint32   level, 0 for the lowest resolution
+ *   uint32   u, v
+ *   uint32   pixel format, the GL enum of PixelFormat
+ *   uint32   width, height
+ *   uint32   number of mip levels
+ *   uint32   reserved, 0
+ *   uint64   offset of the pixels from the start of the file
+ *   uint64   size of the pixels
+ *
+ * and the pixels of the tiles, each laid out like the pixels of an Image
+ * with the same format, size and mip levels.
+ *
+ * All numbers are little endian.
+ */
+
+namespace
+{
+constexpr const char PACK_FILE_HEADER[] = "CELTPACK";
+constexpr std::uint16_t PACK_FILE_VERSION = 0x0100;
+constexpr std::size_t HEADER_SIZE = sizeof(PACK_FILE_HEADER) - 1 + 8;
+constexpr std::size_t ENTRY_SIZE = 48;
+// Tiles bigger than this are rejected as corrupt
+constexpr std::uint32_t MaxTileSize = 16384;
+
+bool isValidFormat(std::uint32_t format)
+{
+    switch (static_cast<PixelFormat>(format))
+    {
+    case PixelFormat::RGB:
+    case PixelFormat::RGBA:
+    case PixelFormat::BGR:
+    case PixelFormat::BGRA:
+    case PixelFormat::LUM_ALPHA:
+    case PixelFormat::ALPHA:
+    case PixelFormat::LUMINANCE:
+    case PixelFormat::DXT1:
+    case PixelFormat::DXT3:
+    case PixelFormat::DXT5:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// The size of the pixels of img, without the padding of Image::getSize()
+std::uint64_t pixelsSize(const Image& img)
+{
+    std::uint64_t size = 0;
+    for (int mip = 0; mip < img.getMipLevelCount(); mip++)
+        size += static_cast<std::uint64_t>(img.getMipLevelSize(mip));
+    return size;
+}
+
+bool entryLess(const TilePack::Entry& a, const TilePack::Entry& b)
+{
+    return std::tie(a.level, a.v, a.u) < std::tie(b.level, b.v, b.u);
+}
+} // end unnamed namespace
+
+
+std::unique_ptr<TilePack> TilePack::open(const fs::path& path)
+{
+    auto pack = std::make_unique<TilePack>();
+    celutil::MemoryMappedFile& file = pack->file;
+    if (!file.open(path, celutil::MemoryMappedFile::AccessHint::Random))
+    {
+        GetLogger()->error(_("Error opening tile pack {}\n"), path);
+        return nullptr;
+    }
+
+    const char* ptr = file.data();
+    std::size_t headerLength = sizeof(PACK_FILE_HEADER) - 1;
+    if (file.size() < HEADER_SIZE
+        || std::memcmp(ptr, PACK_FILE_HEADER, headerLength) != 0
+        || celutil::fromMemoryLE<std::uint16_t>(ptr + headerLength) != PACK_FILE_VERSION)
+    {
+        GetLogger()->error(_("Bad header for tile pack {}\n"), path);
+        return nullptr;
+    }
+
+    auto nTiles = celutil::fromMemoryLE<std::uint32_t>(ptr + headerLength + 4);
+    ptr += HEADER_SIZE;
+    if ((file.size() - HEADER_SIZE) / ENTRY_SIZE < nTiles)
+    {
+        GetLogger()->error(_("Tile pack {} is truncated\n"), path);
+        return nullptr;
+    }
+
+    pack->index.reserve(nTiles);
+    for (std::uint32_t i = 0; i < nTiles; ++i, ptr += ENTRY_SIZE)
+    {
+        Entry entry;
+        entry.level = celutil::fromMemoryLE<std::uint32_t>(ptr);
+        entry.u = celutil::fromMemoryLE<std::uint32_t>(ptr + 4);
+        entry.v = celutil::fromMemoryLE<std::uint32_t>(ptr + 8);
+        auto format = celutil::fromMemoryLE<std::uint32_t>(ptr + 12);
+        entry.format = static_cast<PixelFormat>(format);
+        entry.width = celutil::fromMemoryLE<std::uint32_t>(ptr + 16);
+        entry.height = celutil::fromMemoryLE<std::uint32_t>(ptr + 20);
+        entry.mipLevels = celutil::fromMemoryLE<std::uint32_t>(ptr + 24);
+        entry.offset = celutil::fromMemoryLE<std::uint64_t>(ptr + 32);
+        entry.size = celutil::fromMemoryLE<std::uint64_t>(ptr + 40);
+
+        bool sorted = pack->index.empty() || entryLess(pack->index.back(), entry);
+        if (!sorted
+            || !isValidFormat(format)
+            || entry.width == 0 || entry.width > MaxTileSize
+            || entry.height == 0 || entry.height > MaxTileSize
+            || entry.mipLevels == 0 || entry.mipLevels > 16
+            || entry.offset > file.size()
+            || entry.size > file.size() - entry.offset)
+        {
+            GetLogger()->error(_("Tile pack {} is corrupt\n"), path);
+            return nullptr;
+        }
+
+        pack->index.push_back(entry);
+    }
+
+    return pack;
+}
+
+
+void TilePack::layout(std::vector<Entry>& entries)
+{
+    std::sort(entries.begin(), entries.end(), entryLess);
+    std::uint64_t offset = HEADER_SIZE + entries.size() * ENTRY_SIZE;
+    for (Entry& entry : entries)
+    {
+        entry.offset = offset;
+        offset += entry.size;
+    }
+}
+
+
+bool TilePack::writeIndex(std::ostream& out, const std::vector<Entry>& entries)
+{
+    out.write(PACK_FILE_HEADER, sizeof(PACK_FILE_HEADER) - 1);
+    if (!celutil::writeLE<std::uint16_t>(out, PACK_FILE_VERSION)
+        || !celutil::writeLE<std::uint16_t>(out, 0)
+        || !celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(entries.size())))
+    {
+        return false;
+    }
+
+    for (const Entry& entry : entries)
+    {
+        if (!celutil::writeLE<std::uint32_t>(out, entry.level)
+            || !celutil::writeLE<std::uint32_t>(out, entry.u)
+            || !celutil::writeLE<std::uint32_t>(out, entry.v)
+            || !celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(entry.format))
+            || !celutil::writeLE<std::uint32_t>(out, entry.width)
+            || !celutil::writeLE<std::uint32_t>(out, entry.height)
+            || !celutil::writeLE<std::uint32_t>(out, entry.mipLevels)
+            || !celutil::writeLE<std::uint32_t>(out, 0)
+            || !celutil::writeLE<std::uint64_t>(out, entry.offset)
+            || !celutil::writeLE<std::uint64_t>(out, entry.size))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+const TilePack::Entry* TilePack::find(std::uint32_t level, std::uint32_t u, std::uint32_t v) const
+{
+    Entry key{ level, u, v, PixelFormat::INVALID, 0, 0, 0, 0, 0 };
+    auto it = std::lower_bound(index.begin(), index.end(), key, entryLess);
+    if (it == index.end() || it->level != level || it->u != u || it->v != v)
+        return nullptr;
+    return &*it;
+}
+
+
+std::unique_ptr<Image> TilePack::load(const Entry& entry) const
+{
+    auto img = std::make_unique<Image>(entry.format,
+                                       static_cast<int>(entry.width),
+                                       static_cast<int>(entry.height),
+                                       static_cast<int>(entry.mipLevels));
+    if (pixelsSize(*img) != entry.size)
+    {
+        GetLogger()->error(_("Tile {} {} {} has the wrong size\n"), entry.level, entry.u, entry.v);
+        return nullptr;
+    }
+
+    std::memcpy(img->getPixels(), file.data() + entry.offset, entry.size);
+    return img;
+}
@@ -0,0 +1,67 @@
+// tilepack.h
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// Virtual texture tiles packed into a single file.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <vector>
+#include <celcompat/filesystem.h>
+#include <celengine/pixelformat.h>
+#include <celutil/mmapfile.h>
+
+class Image;
+
+/*! The tiles of a virtual texture stored in one file with an index, so
+ *  that reading a tile doesn't have to look up and open a file of its own.
+ *  The file is mapped into memory, and the tiles are stored with the pixel
+ *  layout of Image so that they are copied without decoding.
+ */
+class TilePack
+{
+ public:
+    struct Entry
+    {
+        std::uint32_t level;
+        std::uint32_t u;
+        std::uint32_t v;
+        celestia::PixelFormat format;
+        std::uint32_t width;
+        std::uint32_t height;
+        std::uint32_t mipLevels;
+        //! Position and size of the pixels in the file
+        std::uint64_t offset;
+        std::uint64_t size;
+    };
+
+    TilePack() = default;
+    TilePack(const TilePack&) = delete;
+    TilePack& operator=(const TilePack&) = delete;
+
+    static std::unique_ptr<TilePack> open(const fs::path&);
+
+    /*! Sort the entries by level, v and u and set their offsets for
+     *  writing them in that order. The sizes must be set.
+     */
+    static void layout(std::vector<Entry>&);
+    //! Write the header and the index of entries arranged by layout()
+    static bool writeIndex(std::ostream&, const std::vector<Entry>&);
+
+    const std::vector<Entry>& entries() const { return index; }
+    const Entry* find(std::uint32_t level, std::uint32_t u, std::uint32_t v) const;
+    //! Copy the pixels of a tile into a new image
+    std::unique_ptr<Image> load(const Entry&) const;
+
+ private:
+    std::vector<Entry> index;
+    celestia::util::MemoryMappedFile file;
+};
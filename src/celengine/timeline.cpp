@@ -10,6 +10,7 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include "celengine/timeline.h"
 #include "celengine/timelinephase.h"
 #include "celengine/frametree.h"
@@ -45,6 +46,7 @@ Timeline::appendPhase(TimelinePhase::SharedConstPtr &phase)
     }
 
     phases.push_back(phase);
+    endTimes.push_back(phase->endTime());
 
     return true;
 }
@@ -54,23 +56,24 @@ const TimelinePhase::SharedConstPtr&
 Timeline::findPhase(double t) const
 {
     // Find the phase containing time t. The overwhelming common case is
-    // nPhases = 1, so we special case that. Otherwise, we do a simple linear search,
-    // as the number of phases in a timeline should always be quite small.
+    // nPhases = 1, so we special case that. Timelines generated from
+    // mission data can have hundreds of phases though, so otherwise the
+    // phase found last is checked first, as it's usually looked up again
+    // for the same or a close time, then the end times are searched.
     if (phases.size() == 1)
-    {
         return phases[0];
-    }
-    else
-    {
-        for (const auto& phase : phases)
-        {
-            if (t < phase->endTime())
-                return phase;
-        }
-
-        // Time is greater than the end time of the final phase. Just return the final phase.
-        return phases.back();
-    }
+
+    auto last = static_cast<unsigned int>(phases.size() - 1);
+    unsigned int n = lastPhase.load(std::memory_order_relaxed);
+    if ((n == 0 || t >= endTimes[n - 1]) && (n == last || t < endTimes[n]))
+        return phases[n];
+
+    // The first phase ending after t; when t is greater than the end time
+    // of the final phase, just return the final phase.
+    auto iter = std::upper_bound(endTimes.begin(), endTimes.end(), t);
+    n = std::min(static_cast<unsigned int>(iter - endTimes.begin()), last);
+    lastPhase.store(n, std::memory_order_relaxed);
+    return phases[n];
 }
 
 
@@ -13,6 +13,7 @@
 #ifndef _CELENGINE_TIMELINE_H_
 #define _CELENGINE_TIMELINE_H_
 
+#include <atomic>
 #include <memory>
 #include <vector>
 #include "timelinephase.h"
@@ -40,6 +41,10 @@ public:
 
 private:
     std::vector<TimelinePhase::SharedConstPtr> phases;
+    // End times of the phases, searched by findPhase()
+    std::vector<double> endTimes;
+    // Index of the phase last found, which is tried first
+    mutable std::atomic<unsigned int> lastPhase{ 0 };
 };
 
 #endif // _CELENGINE_TIMELINE_H_
@@ -7,10 +7,11 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
-#include <fstream>
 #include <cassert>
 #include <fmt/format.h>
+#include <celephem/chebyshevorbit.h>
 #include <celephem/samporbit.h>
+#include <celutil/dircache.h>
 #include <celutil/logger.h>
 #include <celutil/filetype.h>
 #include "trajmanager.h"
@@ -41,8 +42,7 @@ fs::path TrajectoryInfo::resolve(const fs::path& baseDir)
     if (!path.empty())
     {
         fs::path filename = path / "data" / source;
-        ifstream in(filename);
-        if (in.good())
+        if (celestia::util::GetDirectoryCache().exists(filename))
             return filename += uniquifyingSuffix;
     }
 
@@ -90,6 +90,12 @@ Orbit* TrajectoryInfo::load(const fs::path& filename)
             break;
         }
     }
+    else if (filetype == Content_CelestiaXYZCBinary)
+    {
+        // Chebyshev series are evaluated in double precision and need no
+        // interpolation
+        sampTrajectory = LoadXYZCBinary(strippedFilename);
+    }
     else
     {
         switch (precision)
@@ -33,32 +33,23 @@ class TrajectoryInfo : public ResourceInfo<Orbit>
 
     fs::path resolve(const fs::path&) override;
     Orbit* load(const fs::path&) override;
+    std::size_t hash() const
+    {
+        std::size_t h = std::hash<std::string>()(source);
+        h = ResourceHashCombine(h, fs::hash_value(path));
+        h = ResourceHashCombine(h, static_cast<std::size_t>(interpolation));
+        return ResourceHashCombine(h, static_cast<std::size_t>(precision));
+    }
 };
 
-// Sort trajectory info records. The same trajectory can be loaded multiple times with
-// different attributes for precision and interpolation. How the ordering is defined isn't
-// as important making this operator distinguish between trajectories with either different
-// sources or different attributes.
-inline bool operator<(const TrajectoryInfo& ti0, const TrajectoryInfo& ti1)
+// The same trajectory can be loaded multiple times with different
+// attributes for precision and interpolation, so they are compared too.
+inline bool operator==(const TrajectoryInfo& ti0, const TrajectoryInfo& ti1)
 {
-    if (ti0.interpolation == ti1.interpolation)
-    {
-        if (ti0.precision == ti1.precision)
-        {
-            if (ti0.source == ti1.source)
-                return ti0.path < ti1.path;
-            else
-                return ti0.source < ti1.source;
-        }
-        else
-        {
-            return ti0.precision < ti1.precision;
-        }
-    }
-    else
-    {
-        return ti0.interpolation < ti1.interpolation;
-    }
+    return ti0.interpolation == ti1.interpolation &&
+           ti0.precision == ti1.precision &&
+           ti0.source == ti1.source &&
+           ti0.path == ti1.path;
 }
 
 typedef ResourceManager<TrajectoryInfo> TrajectoryManager;
@@ -0,0 +1,60 @@
+// uniformbuffer.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Streaming of uniform block values to the GPU.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "glstate.h"
+#include "uniformbuffer.h"
+
+namespace celestia::gl
+{
+
+UniformBuffer::UniformBuffer(GLsizeiptr _capacity) :
+    capacity(_capacity)
+{
+}
+
+UniformBuffer::~UniformBuffer()
+{
+    if (buffer != 0)
+        deleteBuffers(1, &buffer);
+}
+
+void
+UniformBuffer::init()
+{
+    glGenBuffers(1, &buffer);
+    bindBuffer(GL_UNIFORM_BUFFER, buffer);
+    celestia::gl::bufferData(GL_UNIFORM_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if (alignment <= 0)
+        alignment = 256;
+}
+
+void
+UniformBuffer::upload(GLuint binding, const void* data, GLsizeiptr size)
+{
+    if (buffer == 0)
+        init();
+    else
+        bindBuffer(GL_UNIFORM_BUFFER, buffer);
+
+    if (offset + size > capacity)
+    {
+        celestia::gl::bufferData(GL_UNIFORM_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+        offset = 0;
+    }
+
+    celestia::gl::bufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, size);
+
+    offset += (size + alignment - 1) / alignment * alignment;
+}
+
+} // end namespace celestia::gl
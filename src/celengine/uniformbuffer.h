@@ -0,0 +1,50 @@
+// uniformbuffer.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Streaming of uniform block values to the GPU.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include "glsupport.h"
+
+namespace celestia::gl
+{
+
+// UniformBuffer uploads the values of uniform blocks into consecutive
+// ranges of one buffer object, aligned as the driver requires, and binds
+// each range to the binding point of its block. When the buffer is full
+// its storage is orphaned, so that an upload never waits for the draws
+// still reading the earlier ranges.
+//
+// The buffer object is created by the first upload, so the class can be
+// constructed before GL is initialized. It needs ARB_uniform_buffer_object.
+class UniformBuffer
+{
+ public:
+    explicit UniformBuffer(GLsizeiptr _capacity = 65536);
+    ~UniformBuffer();
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer(UniformBuffer&&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(UniformBuffer&&) = delete;
+
+    // Copy size bytes of data, laid out like the block, and bind them to
+    // the binding point
+    void upload(GLuint binding, const void* data, GLsizeiptr size);
+
+ private:
+    void init();
+
+    GLsizeiptr capacity;
+    GLsizeiptr offset{ 0 };
+    GLint alignment{ 256 };
+    GLuint buffer{ 0 };
+};
+
+} // end namespace celestia::gl
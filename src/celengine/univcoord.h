@@ -16,6 +16,7 @@
 
 #include <Eigen/Core>
 
+#include <celutil/array_view.h>
 #include <celutil/bigfix.h>
 
 #include "astro.h"
@@ -78,6 +79,23 @@ class UniversalCoord
                                static_cast<double>(z - uc.z)) * astro::microLightYearsToKilometers(1.0);
     }
 
+    /** Get the offsets in kilometers of an array of coordinates from an origin,
+      * as offsetFromKm() does for one coordinate. Loops that need the offsets
+      * of many coordinates should use this method.
+      */
+    static void OffsetsFromKm(celestia::util::array_view<UniversalCoord> coords,
+                              const UniversalCoord& origin,
+                              Eigen::Vector3d* offsets)
+    {
+        constexpr double scale = astro::microLightYearsToKilometers(1.0);
+        for (const UniversalCoord& uc : coords)
+        {
+            *offsets++ = Eigen::Vector3d(static_cast<double>(uc.x - origin.x),
+                                         static_cast<double>(uc.y - origin.y),
+                                         static_cast<double>(uc.z - origin.z)) * scale;
+        }
+    }
+
     /** Get the offset in light years of this coordinate from a point (also with
       * units of light years.) The difference is calculated at high precision and
       * the reduced to single precision.
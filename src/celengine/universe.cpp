@@ -14,7 +14,10 @@
 #include "astro.h"
 #include "asterism.h"
 #include "boundaries.h"
+#include "ephemeriscache.h"
 #include "meshmanager.h"
+#include "minorbodies.h"
+#include "pickgrid.h"
 #include "universe.h"
 #include "timelinephase.h"
 #include "frametree.h"
@@ -23,6 +26,7 @@
 #include <celmath/intersect.h>
 #include <celmath/ray.h>
 #include <celutil/greek.h>
+#include <algorithm>
 #include <cassert>
 
 static const double ANGULAR_RES = 3.5e-6;
@@ -32,7 +36,8 @@ using namespace std;
 using namespace celmath;
 
 
-Universe::Universe()
+Universe::Universe() :
+    ephemerisCache(std::make_unique<EphemerisCache>())
 {
     markers = new celestia::MarkerList();
 }
@@ -52,6 +57,7 @@ StarDatabase* Universe::getStarCatalog() const
 void Universe::setStarCatalog(StarDatabase* catalog)
 {
     starCatalog = catalog;
+    invalidatePathCache();
 }
 
 
@@ -63,6 +69,7 @@ SolarSystemCatalog* Universe::getSolarSystemCatalog() const
 void Universe::setSolarSystemCatalog(SolarSystemCatalog* catalog)
 {
     solarSystemCatalog = catalog;
+    invalidatePathCache();
 }
 
 
@@ -74,6 +81,7 @@ DSODatabase* Universe::getDSOCatalog() const
 void Universe::setDSOCatalog(DSODatabase* catalog)
 {
     dsoCatalog = catalog;
+    invalidatePathCache();
 }
 
 
@@ -97,6 +105,18 @@ void Universe::setBoundaries(ConstellationBoundaries* _boundaries)
     boundaries = _boundaries;
 }
 
+
+MinorBodyTable* Universe::getMinorBodies() const
+{
+    return minorBodies;
+}
+
+void Universe::setMinorBodies(MinorBodyTable* table)
+{
+    minorBodies = table;
+    invalidatePathCache();
+}
+
 // Return the planetary system of a star, or nullptr if it has no planets.
 SolarSystem* Universe::getSolarSystem(const Star* star) const
 {
@@ -167,6 +187,12 @@ celestia::MarkerList* Universe::getMarkers() const
 }
 
 
+EphemerisCache* Universe::getEphemerisCache() const
+{
+    return ephemerisCache.get();
+}
+
+
 void Universe::markObject(const Selection& sel,
                           const celestia::MarkerRepresentation& rep,
                           int priority,
@@ -515,12 +541,13 @@ Selection Universe::pickPlanet(SolarSystem& solarSystem,
 class StarPicker : public StarHandler
 {
 public:
-    StarPicker(const Vector3f&, const Vector3f&, double, float);
+    StarPicker(const StarDatabase&, const Vector3f&, const Vector3f&, double, float);
     ~StarPicker() = default;
 
     void process(const Star& /*star*/, float /*unused*/, float /*unused*/);
 
 public:
+    const StarDatabase& starDB;
     const Star* pickedStar;
     Vector3f pickOrigin;
     Vector3f pickRay;
@@ -528,10 +555,12 @@ public:
     double when;
 };
 
-StarPicker::StarPicker(const Vector3f& _pickOrigin,
+StarPicker::StarPicker(const StarDatabase& _starDB,
+                       const Vector3f& _pickOrigin,
                        const Vector3f& _pickRay,
                        double _when,
                        float angle) :
+    starDB(_starDB),
     pickedStar(nullptr),
     pickOrigin(_pickOrigin),
     pickRay(_pickRay),
@@ -561,7 +590,7 @@ void StarPicker::process(const Star& star, float /*unused*/, float /*unused*/)
                              Spheref(relativeStarPos, orbitalRadius * 2.0f),
                              distance))
         {
-            Vector3d starPos = star.getPosition(when).toLy();
+            Vector3d starPos = starDB.getStarPosition(star, when).toLy();
             starDir = (starPos - pickOrigin.cast<double>()).cast<float>().normalized();
         }
     }
@@ -583,7 +612,8 @@ void StarPicker::process(const Star& star, float /*unused*/, float /*unused*/)
 class CloseStarPicker : public StarHandler
 {
 public:
-    CloseStarPicker(const UniversalCoord& pos,
+    CloseStarPicker(const StarDatabase& starDB,
+                    const UniversalCoord& pos,
                     const Vector3f& dir,
                     double t,
                     float _maxDistance,
@@ -592,6 +622,7 @@ public:
     void process(const Star& star, float lowPrecDistance, float appMag);
 
 public:
+    const StarDatabase& starDB;
     UniversalCoord pickOrigin;
     Vector3f pickDir;
     double now;
@@ -602,11 +633,13 @@ public:
 };
 
 
-CloseStarPicker::CloseStarPicker(const UniversalCoord& pos,
+CloseStarPicker::CloseStarPicker(const StarDatabase& _starDB,
+                                 const UniversalCoord& pos,
                                  const Vector3f& dir,
                                  double t,
                                  float _maxDistance,
                                  float angle) :
+    starDB(_starDB),
     pickOrigin(pos),
     pickDir(dir),
     now(t),
@@ -624,7 +657,7 @@ void CloseStarPicker::process(const Star& star,
     if (lowPrecDistance > maxDistance)
         return;
 
-    Vector3d hPos = star.getPosition(now).offsetFromKm(pickOrigin);
+    Vector3d hPos = starDB.getStarPosition(star, now).offsetFromKm(pickOrigin);
     Vector3f starDir = hPos.cast<float>();
 
     float distance = 0.0f;
@@ -668,7 +701,8 @@ Selection Universe::pickStar(const UniversalCoord& origin,
                              const Vector3f& direction,
                              double when,
                              float faintestMag,
-                             float tolerance)
+                             float tolerance,
+                             const PickGrid* pickGrid)
 {
     Vector3f o = origin.toLy().cast<float>();
 
@@ -678,23 +712,28 @@ Selection Universe::pickStar(const UniversalCoord& origin,
     // precision pick test isn't reliable close to a star and the high
     // precision test isn't nearly fast enough to use on our database of
     // over 100k stars.
-    CloseStarPicker closePicker(origin, direction, when, 1.0f, tolerance);
+    CloseStarPicker closePicker(*starCatalog, origin, direction, when, 1.0f, tolerance);
     starCatalog->findCloseStars(closePicker, o, 1.0f);
     if (closePicker.closestStar != nullptr)
         return Selection(const_cast<Star*>(closePicker.closestStar));
 
-    // Find visible stars expects an orientation, but we just have a direction
-    // vector.  Convert the direction vector into an orientation by computing
-    // the rotation required to map -Z to the direction.
-    Quaternionf rotation;
-    rotation.setFromTwoVectors(-Vector3f::UnitZ(), direction);
-
-    StarPicker picker(o, direction, when, tolerance);
-    starCatalog->findVisibleStars(picker,
-                                  o,
-                                  rotation.conjugate(),
-                                  tolerance, 1.0f,
-                                  faintestMag);
+    // The stars accepted by the picker lie within this angle of the ray
+    StarPicker picker(*starCatalog, o, direction, when, tolerance);
+    auto angle = static_cast<float>(2.0 * asin(picker.sinAngle2Closest));
+
+    // The stars drawn in the last frame answer most clicks without
+    // traversing the octree
+    const Star* gridStar = nullptr;
+    if (pickGrid != nullptr && pickGrid->pick(origin.toLy(), direction, angle, faintestMag, gridStar))
+    {
+        if (gridStar == nullptr)
+            return Selection();
+        if (gridStar->getOrbitBarycenter() != nullptr)
+            gridStar = gridStar->getOrbitBarycenter();
+        return Selection(const_cast<Star*>(gridStar));
+    }
+
+    starCatalog->findStarsInCone(picker, o, direction, angle, faintestMag);
     if (picker.pickedStar != nullptr)
         return Selection(const_cast<Star*>(picker.pickedStar));
     else
@@ -838,16 +877,12 @@ Selection Universe::pickDeepSkyObject(const UniversalCoord& origin,
         return Selection(const_cast<DeepSkyObject*>(closePicker.closestDSO));
     }
 
-    Quaternionf rotation;
-    rotation.setFromTwoVectors(-Vector3f::UnitZ(), direction);
-
     DSOPicker picker(orig, dir, renderFlags, tolerance);
-    dsoCatalog->findVisibleDSOs(picker,
-                                orig,
-                                rotation.conjugate(),
-                                tolerance,
-                                1.0f,
-                                faintestMag);
+    dsoCatalog->findDSOsInCone(picker,
+                               orig,
+                               dir,
+                               2.0 * asin(picker.sinAngle2Closest),
+                               faintestMag);
     if (picker.pickedDSO != nullptr)
         return Selection(const_cast<DeepSkyObject*>(picker.pickedDSO));
     else
@@ -855,12 +890,29 @@ Selection Universe::pickDeepSkyObject(const UniversalCoord& origin,
 }
 
 
+// Rows of the minor body table are promoted to bodies when they're picked
+Selection Universe::pickMinorBody(const UniversalCoord& origin,
+                                  const Vector3f& direction,
+                                  double when,
+                                  float faintestMag,
+                                  float tolerance)
+{
+    Vector3d astrocentricOrigin = origin.offsetFromKm(minorBodies->getStar()->getPosition(when));
+    std::uint32_t row = minorBodies->pick(astrocentricOrigin, direction.cast<double>(),
+                                          when, faintestMag, tolerance);
+    if (row == MinorBodyTable::InvalidRow)
+        return Selection();
+    return Selection(minorBodies->promote(row));
+}
+
+
 Selection Universe::pick(const UniversalCoord& origin,
                          const Vector3f& direction,
                          double when,
                          uint64_t renderFlags,
                          float  faintestMag,
-                         float  tolerance)
+                         float  tolerance,
+                         const PickGrid* pickGrid)
 {
     Selection sel;
 
@@ -884,9 +936,14 @@ Selection Universe::pick(const UniversalCoord& origin,
         }
     }
 
+    if (sel.empty() && (renderFlags & Renderer::ShowAsteroids) && minorBodies != nullptr)
+    {
+        sel = pickMinorBody(origin, direction, when, faintestMag, tolerance);
+    }
+
     if (sel.empty() && (renderFlags & Renderer::ShowStars))
     {
-        sel = pickStar(origin, direction, when, faintestMag, tolerance);
+        sel = pickStar(origin, direction, when, faintestMag, tolerance, pickGrid);
     }
 
     if (sel.empty())
@@ -912,7 +969,18 @@ Selection Universe::findChildObject(const Selection& sel,
             {
                 PlanetarySystem* planets = sys->getPlanets();
                 if (planets != nullptr)
-                    return Selection(planets->find(name, false, i18n));
+                {
+                    Body* body = planets->find(name, false, i18n);
+                    if (body != nullptr)
+                        return Selection(body);
+                }
+            }
+
+            if (minorBodies != nullptr && minorBodies->getStar() == sel.star())
+            {
+                std::uint32_t row = minorBodies->find(name);
+                if (row != MinorBodyTable::InvalidRow)
+                    return Selection(minorBodies->promote(row));
             }
         }
         break;
@@ -1038,6 +1106,14 @@ Selection Universe::find(const string& s,
             return sel;
     }
 
+    // Last, the minor bodies which haven't been promoted yet
+    if (minorBodies != nullptr)
+    {
+        std::uint32_t row = minorBodies->find(s);
+        if (row != MinorBodyTable::InvalidRow)
+            return Selection(minorBodies->promote(row));
+    }
+
     return Selection();
 }
 
@@ -1052,6 +1128,47 @@ Selection Universe::findPath(const string& s,
                              Selection contexts[],
                              int nContexts,
                              bool i18n) const
+{
+    // Resolved paths are kept until a name is added or removed anywhere,
+    // or until they're looked up in other contexts. Scripts look up the
+    // same few paths over and over again.
+    constexpr std::size_t MaxCachedPaths = 4096;
+
+    std::uint32_t nameGeneration = PlanetarySystem::getNameGeneration();
+    if (pathCache.nameGeneration != nameGeneration
+        || !std::equal(contexts, contexts + nContexts,
+                       pathCache.contexts.begin(), pathCache.contexts.end()))
+    {
+        pathCache.paths[0].clear();
+        pathCache.paths[1].clear();
+        pathCache.nameGeneration = nameGeneration;
+        pathCache.contexts.assign(contexts, contexts + nContexts);
+    }
+
+    auto& paths = pathCache.paths[i18n ? 1 : 0];
+    auto iter = paths.find(s);
+    if (iter != paths.end())
+        return iter->second;
+
+    Selection sel = resolvePath(s, contexts, nContexts, i18n);
+    if (paths.size() >= MaxCachedPaths)
+        paths.clear();
+    paths.try_emplace(s, sel);
+    return sel;
+}
+
+
+void Universe::invalidatePathCache()
+{
+    pathCache.paths[0].clear();
+    pathCache.paths[1].clear();
+}
+
+
+Selection Universe::resolvePath(const string& s,
+                                Selection contexts[],
+                                int nContexts,
+                                bool i18n) const
 {
     string::size_type pos = s.find('/', 0);
 
@@ -1083,6 +1200,44 @@ Selection Universe::findPath(const string& s,
 }
 
 
+namespace
+{
+vector<string> getLocationCompletion(const Body* body, const string& s, bool i18n)
+{
+    vector<string> completion;
+    const vector<Location*>* locations = body->getLocations();
+    if (locations == nullptr)
+        return completion;
+
+    int s_length = UTF8Length(s);
+    for (const auto location : *locations)
+    {
+        std::string name = location->getName(false);
+        if (!UTF8StringCompare(s, name, s_length))
+            completion.push_back(name);
+        else if (i18n)
+        {
+            std::string lname = location->getName(true);
+            if (lname != name && !UTF8StringCompare(s, lname, s_length))
+                completion.push_back(lname);
+        }
+    }
+
+    return completion;
+}
+
+
+CompletionSearch::Callback appendTo(vector<string>& completion)
+{
+    return [&completion](const string& name)
+    {
+        completion.push_back(name);
+        return true;
+    };
+}
+} // end unnamed namespace
+
+
 vector<string> Universe::getCompletion(const string& s,
                                        bool i18n,
                                        Selection* contexts,
@@ -1090,110 +1245,115 @@ vector<string> Universe::getCompletion(const string& s,
                                        bool withLocations)
 {
     vector<string> completion;
-    int s_length = UTF8Length(s);
+    CompletionSearch search;
+    getNameCompletion(s, i18n, search, appendTo(completion), contexts, nContexts, withLocations);
+    return completion;
+}
+
+
+vector<string> Universe::getCompletionPath(const string& s,
+                                           bool i18n,
+                                           Selection* contexts,
+                                           int nContexts,
+                                           bool withLocations)
+{
+    vector<string> completion;
+    CompletionSearch search;
+    getCompletion(s, i18n, search, appendTo(completion), contexts, nContexts, withLocations);
+    return completion;
+}
+
+
+bool Universe::getCompletion(const string& s,
+                             bool i18n,
+                             CompletionSearch& search,
+                             const CompletionSearch::Callback& callback,
+                             Selection* contexts,
+                             int nContexts,
+                             bool withLocations) const
+{
+    if (search.start(s, i18n, contexts, nContexts, withLocations))
+        return search.filter(callback);
+
+    bool complete = s.rfind('/') == string::npos
+        ? getNameCompletion(s, i18n, search, callback, contexts, nContexts, withLocations)
+        : getPathCompletion(s, i18n, search, callback, contexts, nContexts, withLocations);
+    search.finish(complete);
+    return complete;
+}
+
+
+bool Universe::getNameCompletion(const string& s,
+                                 bool i18n,
+                                 CompletionSearch& search,
+                                 const CompletionSearch::Callback& callback,
+                                 Selection* contexts,
+                                 int nContexts,
+                                 bool withLocations) const
+{
+    using MatchType = CompletionSearch::MatchType;
 
     // Solar bodies first:
     for (int i = 0; i < nContexts; i++)
     {
         if (withLocations && contexts[i].getType() == Selection::Type_Body)
         {
-            vector<Location*>* locations = contexts[i].body()->getLocations();
-            if (locations != nullptr)
-            {
-                for (const auto location : *locations)
-                {
-                    std::string name = location->getName(false);
-                    if (!UTF8StringCompare(s, name, s_length))
-                        completion.push_back(name);
-                    else if (i18n)
-                    {
-                        std::string lname = location->getName(true);
-                        if (lname != name && !UTF8StringCompare(s, lname, s_length))
-                            completion.push_back(lname);
-                    }
-                }
-            }
+            if (!search.add(getLocationCompletion(contexts[i].body(), s, i18n), MatchType::Exact, callback))
+                return false;
         }
 
         SolarSystem* sys = getSolarSystem(contexts[i]);
         if (sys != nullptr)
         {
             PlanetarySystem* planets = sys->getPlanets();
-            if (planets != nullptr)
-            {
-                vector<string> bodies = planets->getCompletion(s, i18n);
-                completion.insert(completion.end(),
-                                  bodies.begin(), bodies.end());
-            }
+            if (planets != nullptr
+                && !search.add(planets->getCompletion(s, i18n), MatchType::Exact, callback))
+                return false;
         }
     }
 
     // Deep sky objects:
-    if (dsoCatalog != nullptr)
-    {
-        vector<string> dsos  = dsoCatalog->getCompletion(s, i18n);
-        completion.insert(completion.end(), dsos.begin(), dsos.end());
-    }
+    if (dsoCatalog != nullptr
+        && !search.add(dsoCatalog->getCompletion(s, i18n), MatchType::IgnoreCase, callback))
+        return false;
 
     // and finally stars;
-    if (starCatalog != nullptr)
-    {
-        vector<string> stars  = starCatalog->getCompletion(s, i18n);
-        completion.insert(completion.end(), stars.begin(), stars.end());
-    }
+    if (starCatalog != nullptr
+        && !search.add(starCatalog->getCompletion(s, i18n), MatchType::IgnoreCase, callback))
+        return false;
 
-    return completion;
+    return true;
 }
 
 
-vector<string> Universe::getCompletionPath(const string& s,
-                                           bool i18n,
-                                           Selection* contexts,
-                                           int nContexts,
-                                           bool withLocations)
+bool Universe::getPathCompletion(const string& s,
+                                 bool i18n,
+                                 CompletionSearch& search,
+                                 const CompletionSearch::Callback& callback,
+                                 Selection* contexts,
+                                 int nContexts,
+                                 bool withLocations) const
 {
-    vector<string> completion;
-    vector<string> locationCompletion;
-    string::size_type pos = s.rfind('/', s.length());
-
-    if (pos == string::npos)
-        return getCompletion(s, i18n, contexts, nContexts, withLocations);
+    using MatchType = CompletionSearch::MatchType;
 
+    string::size_type pos = s.rfind('/', s.length());
     string base(s, 0, pos);
     Selection sel = findPath(base, contexts, nContexts, i18n);
 
     if (sel.empty())
-    {
-        return completion;
-    }
+        return true;
 
     if (sel.getType() == Selection::Type_DeepSky)
-    {
-        completion.push_back(dsoCatalog->getDSOName(sel.deepsky()));
-        return completion;
-    }
+        return search.add({ dsoCatalog->getDSOName(sel.deepsky()) }, MatchType::Any, callback);
 
+    string search_name = s.substr(pos + 1);
     PlanetarySystem* worlds = nullptr;
+    vector<string> locationCompletion;
     if (sel.getType() == Selection::Type_Body)
     {
         worlds = sel.body()->getSatellites();
-        vector<Location*>* locations = sel.body()->getLocations();
-        if (locations != nullptr && withLocations)
-        {
-            string search = s.substr(pos + 1);
-            for (const auto location : *locations)
-            {
-                std::string name = location->getName(false);
-                if (!UTF8StringCompare(search, name, search.length()))
-                    locationCompletion.push_back(name);
-                else if (i18n)
-                {
-                    std::string lname = location->getName(true);
-                    if (lname != name && !UTF8StringCompare(search, lname, search.length()))
-                        locationCompletion.push_back(lname);
-                }
-            }
-        }
+        if (withLocations)
+            locationCompletion = getLocationCompletion(sel.body(), search_name, i18n);
     }
     else if (sel.getType() == Selection::Type_Star)
     {
@@ -1202,12 +1362,11 @@ vector<string> Universe::getCompletionPath(const string& s,
             worlds = ssys->getPlanets();
     }
 
-    if (worlds != nullptr)
-        completion = worlds->getCompletion(s.substr(pos + 1), i18n, false);
+    if (worlds != nullptr
+        && !search.add(worlds->getCompletion(search_name, i18n, false), MatchType::Exact, callback))
+        return false;
 
-    completion.insert(completion.end(), locationCompletion.begin(), locationCompletion.end());
-
-    return completion;
+    return search.add(std::move(locationCompletion), MatchType::Exact, callback);
 }
 
 
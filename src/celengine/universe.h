@@ -12,6 +12,7 @@
 #define _CELENGINE_UNIVERSE_H_
 
 #include <celengine/univcoord.h>
+#include <celengine/completion.h>
 #include <celengine/stardb.h>
 #include <celengine/dsodb.h>
 #include <celengine/solarsys.h>
@@ -19,10 +20,17 @@
 #include <celengine/marker.h>
 #include <celengine/selection.h>
 #include <celengine/asterism.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 
 class ConstellationBoundaries;
+class EphemerisCache;
+class MinorBodyTable;
+class PickGrid;
 
 class Universe
 {
@@ -45,12 +53,16 @@ class Universe
     ConstellationBoundaries* getBoundaries() const;
     void setBoundaries(ConstellationBoundaries*);
 
+    MinorBodyTable* getMinorBodies() const;
+    void setMinorBodies(MinorBodyTable*);
+
     Selection pick(const UniversalCoord& origin,
                    const Eigen::Vector3f& direction,
                    double when,
                    uint64_t renderFlags,
                    float faintestMag,
-                   float tolerance = 0.0f);
+                   float tolerance = 0.0f,
+                   const PickGrid* pickGrid = nullptr);
 
 
     Selection find(const std::string& s,
@@ -61,6 +73,10 @@ class Universe
                        Selection* contexts = nullptr,
                        int nContexts = 0,
                        bool i18n = false) const;
+    // Forget the paths resolved by findPath(), after objects were changed
+    // other than by adding or removing names
+    void invalidatePathCache();
+
     Selection findChildObject(const Selection& sel,
                               const std::string& name,
                               bool i18n = false) const;
@@ -79,6 +95,22 @@ class Universe
                                                int nContexts = 0,
                                                bool withLocations = false);
 
+    /*! Find the names completing s, which may be a path as for
+     *  getCompletionPath(). Names are passed to callback a catalog at a
+     *  time, bodies and locations first, then deep sky objects and stars,
+     *  each ranked shortest first. When s extends the query of the last
+     *  search with the same state and contexts, the names found then are
+     *  filtered instead. Returns false if the search was cancelled or
+     *  stopped by callback.
+     */
+    bool getCompletion(const std::string& s,
+                       bool i18n,
+                       CompletionSearch& search,
+                       const CompletionSearch::Callback& callback,
+                       Selection* contexts = nullptr,
+                       int nContexts = 0,
+                       bool withLocations = false) const;
+
 
     SolarSystem* getNearestSolarSystem(const UniversalCoord& position) const;
     SolarSystem* getSolarSystem(const Star* star) const;
@@ -99,7 +131,31 @@ class Universe
     bool isMarked(const Selection&, int priority) const;
     celestia::MarkerList* getMarkers() const;
 
+    // Orbits, rotation models and frames shared by the bodies of the
+    // solar system catalogs
+    EphemerisCache* getEphemerisCache() const;
+
  private:
+    Selection resolvePath(const std::string& s,
+                          Selection contexts[],
+                          int nContexts,
+                          bool i18n) const;
+
+    bool getNameCompletion(const std::string& s,
+                           bool i18n,
+                           CompletionSearch& search,
+                           const CompletionSearch::Callback& callback,
+                           Selection* contexts,
+                           int nContexts,
+                           bool withLocations) const;
+    bool getPathCompletion(const std::string& s,
+                           bool i18n,
+                           CompletionSearch& search,
+                           const CompletionSearch::Callback& callback,
+                           Selection* contexts,
+                           int nContexts,
+                           bool withLocations) const;
+
     Selection pickPlanet(SolarSystem& solarSystem,
                          const UniversalCoord& origin,
                          const Eigen::Vector3f& direction,
@@ -107,11 +163,20 @@ class Universe
                          float faintestMag,
                          float tolerance);
 
+    // Stars are looked up in pickGrid first when it's given, see
+    // PickGrid::pick()
     Selection pickStar(const UniversalCoord& origin,
                        const Eigen::Vector3f& direction,
                        double when,
                        float faintest,
-                       float tolerance = 0.0f);
+                       float tolerance = 0.0f,
+                       const PickGrid* pickGrid = nullptr);
+
+    Selection pickMinorBody(const UniversalCoord& origin,
+                            const Eigen::Vector3f& direction,
+                            double when,
+                            float faintestMag,
+                            float tolerance);
 
     Selection pickDeepSkyObject(const UniversalCoord& origin,
                                 const Eigen::Vector3f& direction,
@@ -125,9 +190,21 @@ class Universe
     SolarSystemCatalog* solarSystemCatalog{nullptr};
     AsterismList* asterisms{nullptr};
     ConstellationBoundaries* boundaries{nullptr};
+    MinorBodyTable* minorBodies{nullptr};
     celestia::MarkerList* markers;
+    std::unique_ptr<EphemerisCache> ephemerisCache;
 
     std::vector<const Star*> closeStars;
+
+    // Selections found by findPath(), for the contexts last passed to it,
+    // without and with localized names
+    struct PathCache
+    {
+        std::uint32_t nameGeneration{ 0 };
+        std::vector<Selection> contexts;
+        std::unordered_map<std::string, Selection> paths[2];
+    };
+    mutable PathCache pathCache;
 };
 
 #endif // _CELENGINE_UNIVERSE_H_
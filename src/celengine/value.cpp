@@ -8,16 +8,58 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <utility>
+
 #include "value.h"
 
 /****** Value method implementations *******/
 
 Value::~Value()
+{
+    destroy();
+}
+
+
+Value::Value(Value&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+
+Value& Value::operator=(Value&& other) noexcept
+{
+    if (this == &other)
+        return *this;
+
+    destroy();
+    type = other.type;
+    switch (type)
+    {
+    case StringType:
+        new (&data.s) std::string(std::move(other.data.s));
+        other.data.s.~basic_string();
+        break;
+    case ArrayType:
+        data.a = other.data.a;
+        break;
+    case HashType:
+        data.h = other.data.h;
+        break;
+    default:
+        data.d = other.data.d;
+        break;
+    }
+    other.type = NullType;
+    return *this;
+}
+
+
+void Value::destroy()
 {
     switch (type)
     {
     case StringType:
-        delete data.s;
+        data.s.~basic_string();
         break;
     case ArrayType:
         if (data.a != nullptr)
@@ -11,6 +11,7 @@
 #pragma once
 
 #include <cassert>
+#include <new>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -37,9 +38,9 @@ class Value
     Value() = default;
     ~Value();
     Value(const Value&) = delete;
-    Value(Value&&) = default;
+    Value(Value&&) noexcept;
     Value& operator=(const Value&) = delete;
-    Value& operator=(Value&&) = default;
+    Value& operator=(Value&&) noexcept;
 
     Value(double d) : type(NumberType)
     {
@@ -47,15 +48,15 @@ class Value
     }
     Value(const char *s) : type(StringType)
     {
-        data.s = new std::string(s);
+        new (&data.s) std::string(s);
     }
     explicit Value(const std::string_view sv) : type(StringType)
     {
-        data.s = new std::string(sv);
+        new (&data.s) std::string(sv);
     }
     explicit Value(const std::string &s) : type(StringType)
     {
-        data.s = new std::string(s);
+        new (&data.s) std::string(s);
     }
     Value(Array *a) : type(ArrayType)
     {
@@ -83,10 +84,10 @@ class Value
         assert(type == NumberType);
         return data.d;
     }
-    std::string getString() const
+    const std::string& getString() const
     {
         assert(type == StringType);
-        return *data.s;
+        return data.s;
     }
     Array* getArray() const
     {
@@ -105,9 +106,15 @@ class Value
     }
 
  private:
+    void destroy();
+
+    // Strings are stored in place, so most of them need no allocation
     union Data
     {
-        std::string *s;
+        Data() : d(0.0) {}
+        ~Data() {}
+
+        std::string  s;
         double       d;
         Array       *a;
         Hash        *h;
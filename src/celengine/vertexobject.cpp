@@ -9,8 +9,12 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <numeric>
 #include "shadermanager.h"
+#include "streambuffer.h"
 #include "vertexobject.h"
+#include "glstate.h"
 
 using namespace celestia;
 
@@ -31,10 +35,10 @@ VertexObject::VertexObject(GLenum bufferType, GLsizeiptr bufferSize, GLenum stre
 VertexObject::~VertexObject()
 {
     if (m_vaoId != 0 && isVAOSupported())
-        glDeleteVertexArrays(1, &m_vaoId);
+        celestia::gl::deleteVertexArrays(1, &m_vaoId);
 
     if (m_vboId != 0)
-        glDeleteBuffers(1, &m_vboId);
+        celestia::gl::deleteBuffers(1, &m_vboId);
 }
 
 void VertexObject::bind(AttributesType attributes) noexcept
@@ -45,22 +49,23 @@ void VertexObject::bind(AttributesType attributes) noexcept
         if (isVAOSupported())
         {
             glGenVertexArrays(1, &m_vaoId);
-            glBindVertexArray(m_vaoId);
+            celestia::gl::bindVertexArray(m_vaoId);
         }
-        glGenBuffers(1, &m_vboId);
-        glBindBuffer(m_bufferType, m_vboId);
+        if (m_streamBuffer == nullptr)
+            glGenBuffers(1, &m_vboId);
+        celestia::gl::bindBuffer(m_bufferType, bufferId());
     }
     else
     {
         if (isVAOSupported())
         {
-            glBindVertexArray(m_vaoId);
+            celestia::gl::bindVertexArray(m_vaoId);
             if ((m_state & State::Update) != 0)
-                glBindBuffer(m_bufferType, m_vboId);
+                celestia::gl::bindBuffer(m_bufferType, bufferId());
         }
         else
         {
-            glBindBuffer(m_bufferType, m_vboId);
+            celestia::gl::bindBuffer(m_bufferType, bufferId());
             enableAttribArrays();
         }
     }
@@ -77,13 +82,13 @@ void VertexObject::unbind() noexcept
     if (isVAOSupported())
     {
         if ((m_state & (State::Initialize | State::Update)) != 0)
-            glBindBuffer(m_bufferType, 0);
-        glBindVertexArray(0);
+            celestia::gl::bindBuffer(m_bufferType, 0);
+        celestia::gl::bindVertexArray(0);
     }
     else
     {
         disableAttribArrays();
-        glBindBuffer(m_bufferType, 0);
+        celestia::gl::bindBuffer(m_bufferType, 0);
     }
     m_state = State::NormalState;
     m_currentAttributes = AttributesType::Invalid;
@@ -91,7 +96,11 @@ void VertexObject::unbind() noexcept
 
 bool VertexObject::allocate(const void* data) noexcept
 {
-    glBufferData(m_bufferType, m_bufferSize, data, m_streamType);
+    // The storage of a stream buffer is allocated by setBufferData()
+    if (m_streamBuffer != nullptr)
+        return data != nullptr && !setBufferData(data);
+
+    celestia::gl::bufferData(m_bufferType, m_bufferSize, data, m_streamType);
     return glGetError() != GL_NO_ERROR;
 }
 
@@ -111,7 +120,35 @@ bool VertexObject::allocate(GLenum bufferType, GLsizeiptr bufferSize, const void
 
 bool VertexObject::setBufferData(const void* data, GLintptr offset, GLsizeiptr size) noexcept
 {
-    glBufferSubData(m_bufferType, offset, size == 0 ? m_bufferSize : size, data);
+    if (size == 0)
+        size = m_bufferSize;
+
+    if (m_streamBuffer != nullptr)
+    {
+        if (offset == 0)
+        {
+            // The range starts on a vertex of every attribute set, so that
+            // draw() can address it by shifting the first vertex
+            GLsizei alignment = 1;
+            for (unsigned int i = 0; i < (unsigned int) AttributesType::Count; i++)
+            {
+                GLsizei stride = vertexStride(static_cast<AttributesType>(i));
+                if (stride > 0)
+                    alignment = std::lcm(alignment, stride);
+            }
+
+            m_streamOffset = m_streamBuffer->allocate(std::max(size, m_bufferSize), alignment);
+            if (m_streamOffset < 0)
+            {
+                m_streamOffset = 0;
+                return false;
+            }
+        }
+        m_streamBuffer->write(m_streamOffset + offset, data, size);
+        return true;
+    }
+
+    celestia::gl::bufferSubData(m_bufferType, offset, size, data);
     return glGetError() == GL_NO_ERROR;
 }
 
@@ -120,12 +157,15 @@ void VertexObject::draw(GLenum primitive, GLsizei count, GLint first) noexcept
     if ((m_state & State::Initialize) != 0)
         enableAttribArrays();
 
-    glDrawArrays(primitive, first, count);
+    if (m_streamBuffer != nullptr && m_streamOffset > 0)
+        first += static_cast<GLint>(m_streamOffset / vertexStride(m_currentAttributes));
+
+    celestia::gl::drawArrays(primitive, first, count);
 }
 
 void VertexObject::enableAttribArrays() noexcept
 {
-    glBindBuffer(m_bufferType, m_vboId);
+    celestia::gl::bindBuffer(m_bufferType, bufferId());
     for (const auto& t : m_attribParams[(unsigned int)m_currentAttributes])
     {
         auto  n = t.first;
@@ -143,7 +183,42 @@ void VertexObject::disableAttribArrays() noexcept
     for (const auto& t : m_attribParams[(unsigned int)m_currentAttributes])
         glDisableVertexAttribArray(t.first);
 
-    glBindBuffer(m_bufferType, 0);
+    celestia::gl::bindBuffer(m_bufferType, 0);
+}
+
+GLuint VertexObject::bufferId() const noexcept
+{
+    return m_streamBuffer != nullptr ? m_streamBuffer->getBuffer() : m_vboId;
+}
+
+// Distance between the vertices of an attribute set, 0 if it has no
+// vertex coordinates
+GLsizei VertexObject::vertexStride(AttributesType attributes) const noexcept
+{
+    if (attributes == AttributesType::Invalid)
+        return 0;
+
+    const auto& params = m_attribParams[(unsigned int)attributes];
+    auto it = params.find(CelestiaGLProgram::VertexCoordAttributeIndex);
+    if (it == params.end())
+        return 0;
+
+    const PtrParams& p = it->second;
+    if (p.stride != 0)
+        return p.stride;
+
+    switch (p.type)
+    {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE:
+        return p.count;
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+    case GL_HALF_FLOAT:
+        return p.count * 2;
+    default:
+        return p.count * 4;
+    }
 }
 
 void VertexObject::setVertices(GLint count, GLenum type, bool normalized, GLsizei stride, GLsizeiptr offset, AttributesType attributes) noexcept
@@ -17,6 +17,8 @@
 
 namespace celgl
 {
+class StreamBuffer;
+
 class VertexObject
 {
  public:
@@ -60,6 +62,9 @@ class VertexObject
     void setBufferType(GLenum bufferType) noexcept     { m_bufferType = bufferType; }
     void setBufferSize(GLsizeiptr bufferSize) noexcept { m_bufferSize = bufferSize; }
     void setStreamType(GLenum streamType) noexcept     { m_streamType = streamType; }
+    // Keep the vertices in a range of a shared stream buffer rather than in
+    // a buffer of their own; setBufferData() with offset 0 starts a new range
+    void setStreamBuffer(StreamBuffer* streamBuffer) noexcept { m_streamBuffer = streamBuffer; }
 
  private:
     inline bool isVAOSupported() const
@@ -89,6 +94,8 @@ class VertexObject
 
     void enableAttribArrays() noexcept;
     void disableAttribArrays() noexcept;
+    GLuint bufferId() const noexcept;
+    GLsizei vertexStride(AttributesType attributes) const noexcept;
 
     GLuint     m_vboId{ 0 };
     GLuint     m_vaoId{ 0 };
@@ -98,6 +105,10 @@ class VertexObject
     GLenum     m_bufferType{ 0 };
     GLenum     m_streamType{ 0 };
 
+    StreamBuffer* m_streamBuffer{ nullptr };
+    // Start of the current range of the stream buffer
+    GLintptr   m_streamOffset{ 0 };
+
     AttributesType m_currentAttributes { AttributesType::Invalid };
     std::array<std::map<GLint, PtrParams>, (unsigned int)AttributesType::Count> m_attribParams;
 };
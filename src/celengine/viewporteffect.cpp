@@ -8,11 +8,20 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <cmath>
+#include <Eigen/Geometry>
+#include <celmath/geomutil.h>
+#include <celmath/mathlib.h>
+#include <celutil/logger.h>
 #include "viewporteffect.h"
 #include "framebuffer.h"
 #include "render.h"
 #include "shadermanager.h"
 #include "mapmanager.h"
+#include "glstate.h"
+
+using celestia::util::GetLogger;
 
 static const Renderer::PipelineState ps;
 
@@ -22,6 +31,13 @@ bool ViewportEffect::preprocess(Renderer* renderer, FramebufferObject* fbo)
     return fbo->bind();
 }
 
+bool ViewportEffect::drawScene(Renderer*, FramebufferObject*, int, int,
+                               Observer& observer, const SceneDrawer& drawer)
+{
+    drawer(observer);
+    return true;
+}
+
 bool ViewportEffect::prerender(Renderer* renderer, FramebufferObject* fbo)
 {
     if (!fbo->unbind(oldFboId))
@@ -37,6 +53,25 @@ bool ViewportEffect::distortXY(float &x, float &y)
     return true;
 }
 
+bool ViewportEffect::getPickRay(float, float, Eigen::Vector3f&) const
+{
+    return false;
+}
+
+bool ViewportEffect::usesViewFramebuffer() const
+{
+    return true;
+}
+
+void ViewportEffect::addSharedViews(const Observer& observer, float aspectRatio,
+                                    std::vector<Renderer::SharedView>& views) const
+{
+    views.push_back({ observer.getPosition(),
+                      observer.getOrientationf(),
+                      observer.getFOV(),
+                      aspectRatio });
+}
+
 PassthroughViewportEffect::PassthroughViewportEffect() :
     ViewportEffect(),
     vo(GL_ARRAY_BUFFER, 0, GL_STATIC_DRAW)
@@ -55,10 +90,10 @@ bool PassthroughViewportEffect::render(Renderer* renderer, FramebufferObject* fb
 
     prog->use();
     prog->samplerParam("tex") = 0;
-    glBindTexture(GL_TEXTURE_2D, fbo->colorTexture());
+    celestia::gl::bindTexture(GL_TEXTURE_2D, fbo->colorTexture());
     renderer->setPipelineState(ps);
     draw(vo);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    celestia::gl::bindTexture(GL_TEXTURE_2D, 0);
     vo.unbind();
     return true;
 }
@@ -113,10 +148,10 @@ bool WarpMeshViewportEffect::render(Renderer* renderer, FramebufferObject* fbo,
     prog->use();
     prog->samplerParam("tex") = 0;
     prog->floatParam("screenRatio") = (float)height / width;
-    glBindTexture(GL_TEXTURE_2D, fbo->colorTexture());
+    celestia::gl::bindTexture(GL_TEXTURE_2D, fbo->colorTexture());
     renderer->setPipelineState(ps);
     draw(vo);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    celestia::gl::bindTexture(GL_TEXTURE_2D, 0);
     vo.unbind();
     return true;
 }
@@ -150,3 +185,266 @@ bool WarpMeshViewportEffect::distortXY(float &x, float &y)
     y = v / 2;
     return true;
 }
+
+namespace
+{
+// Rotations from the cameras of the cube faces to that of the observer, in
+// the order of the samplers of the cubefisheye shader
+const std::array<Eigen::Quaternionf, CubeFisheyeViewportEffect::FaceCount>&
+faceRotations()
+{
+    static const std::array<Eigen::Quaternionf, CubeFisheyeViewportEffect::FaceCount> rotations
+    {
+        Eigen::Quaternionf::Identity(),
+        celmath::YRotation(-celestia::numbers::pi_v<float> / 2.0f),
+        celmath::YRotation(celestia::numbers::pi_v<float> / 2.0f),
+        celmath::XRotation(celestia::numbers::pi_v<float> / 2.0f),
+        celmath::XRotation(-celestia::numbers::pi_v<float> / 2.0f),
+    };
+    return rotations;
+}
+
+constexpr const char* faceSamplers[CubeFisheyeViewportEffect::FaceCount] =
+{
+    "frontTex", "rightTex", "leftTex", "topTex", "bottomTex"
+};
+
+// Directions on a face are tested at this many points along each side
+constexpr int FaceSamples = 9;
+
+int
+faceSize(int size, float scale)
+{
+    return std::max(1, static_cast<int>(std::lround(static_cast<float>(size) * scale)));
+}
+
+// Find whether the face seen from the observer through rotation has any
+// direction within the aperture, and any both within the aperture and
+// the fovea, a cone of cosFovea around foveaDirection
+void
+testFace(const Eigen::Quaternionf& rotation,
+         float cosHalfFov,
+         const Eigen::Vector3f& foveaDirection,
+         float cosFovea,
+         bool& visible,
+         bool& foveal)
+{
+    visible = false;
+    foveal = false;
+    for (int i = 0; i < FaceSamples; i++)
+    {
+        for (int j = 0; j < FaceSamples; j++)
+        {
+            float x = 2.0f * static_cast<float>(i) / static_cast<float>(FaceSamples - 1) - 1.0f;
+            float y = 2.0f * static_cast<float>(j) / static_cast<float>(FaceSamples - 1) - 1.0f;
+            Eigen::Vector3f direction = rotation * Eigen::Vector3f(x, y, -1.0f).normalized();
+            if (-direction.z() < cosHalfFov)
+                continue;
+            visible = true;
+            if (direction.dot(foveaDirection) >= cosFovea)
+                foveal = true;
+        }
+    }
+
+    // A fovea narrower than the sample spacing may fall between them
+    Eigen::Vector3f center = rotation.conjugate() * foveaDirection;
+    if (-foveaDirection.z() >= cosHalfFov && center.z() < 0.0f &&
+        std::abs(center.x()) <= -center.z() && std::abs(center.y()) <= -center.z())
+    {
+        foveal = true;
+    }
+}
+}
+
+CubeFisheyeViewportEffect::CubeFisheyeViewportEffect(float fovDegrees) :
+    ViewportEffect(),
+    vo(GL_ARRAY_BUFFER, 0, GL_STATIC_DRAW),
+    halfFov(celmath::degToRad(std::clamp(fovDegrees, 90.0f, 250.0f)) / 2.0f)
+{
+    setFoveation(180.0f, 0.0f, 1.0f);
+}
+
+void CubeFisheyeViewportEffect::setFoveation(float angle, float offset, float peripheryScale)
+{
+    // The pixels on the rim of the dome may sample faces which only touch
+    // the aperture, so these are drawn too
+    float cosHalfFov = std::cos(halfFov + celmath::degToRad(0.5f));
+    float cosFovea = std::cos(celmath::degToRad(std::clamp(angle, 0.0f, 180.0f)));
+    float offsetRadians = celmath::degToRad(offset);
+    Eigen::Vector3f foveaDirection(0.0f, -std::sin(offsetRadians), -std::cos(offsetRadians));
+    peripheryScale = std::clamp(peripheryScale, 0.125f, 1.0f);
+
+    for (int i = 0; i < FaceCount; i++)
+    {
+        bool visible;
+        bool foveal;
+        testFace(faceRotations()[i], cosHalfFov, foveaDirection, cosFovea, visible, foveal);
+        if (!visible)
+            faceScales[i] = 0.0f;
+        else
+            faceScales[i] = foveal ? 1.0f : peripheryScale;
+    }
+
+    // The faces are recreated at their new sizes
+    faces = {};
+}
+
+CubeFisheyeViewportEffect::~CubeFisheyeViewportEffect() = default;
+
+bool CubeFisheyeViewportEffect::usesViewFramebuffer() const
+{
+    return false;
+}
+
+bool CubeFisheyeViewportEffect::preprocess(Renderer*, FramebufferObject*)
+{
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFboId);
+    return true;
+}
+
+// Create the faces with size x size pixels at full resolution, returning
+// false on failure. Faces outside the aperture are left blank at 1x1.
+bool CubeFisheyeViewportEffect::updateFaces(int size)
+{
+    if (faces[0] != nullptr && faces[0]->width() == static_cast<GLuint>(faceSize(size, faceScales[0])))
+        return true;
+
+    for (int i = 0; i < FaceCount; i++)
+    {
+        int scaledSize = faceSize(size, faceScales[i]);
+        faces[i] = std::make_unique<FramebufferObject>(scaledSize, scaledSize,
+                                                       FramebufferObject::ColorAttachment |
+                                                       FramebufferObject::DepthAttachment);
+        if (!faces[i]->isValid())
+        {
+            GetLogger()->error("Could not create a {}x{} cube face framebuffer.\n", scaledSize, scaledSize);
+            faces = {};
+            return false;
+        }
+
+        if (faceScales[i] == 0.0f)
+        {
+            faces[i]->bind();
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+        }
+    }
+    return true;
+}
+
+bool CubeFisheyeViewportEffect::drawScene(Renderer* renderer, FramebufferObject*, int, int height,
+                                          Observer& observer, const SceneDrawer& drawer)
+{
+    // Match the resolution of the faces to that of the center of the dome,
+    // where the faces have the fewest pixels per radian
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    int size = std::clamp(static_cast<int>(std::ceil(static_cast<float>(height) / halfFov)), 1, static_cast<int>(maxSize));
+    if (!updateFaces(size))
+        return false;
+
+    for (int i = 0; i < FaceCount; i++)
+    {
+        if (faceScales[i] == 0.0f)
+            continue;
+
+        Observer& faceObserver = faceObservers[i];
+        faceObserver = observer;
+        faceObserver.setOrientation(faceRotations()[i].conjugate() * observer.getOrientationf());
+        faceObserver.setFOV(celestia::numbers::pi_v<float> / 2.0f);
+
+        faces[i]->bind();
+        int scaledSize = static_cast<int>(faces[i]->width());
+        renderer->setRenderRegion(0, 0, scaledSize, scaledSize, false);
+        drawer(faceObserver);
+    }
+    return true;
+}
+
+bool CubeFisheyeViewportEffect::prerender(Renderer*, FramebufferObject*)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, oldFboId);
+    if (faces[0] == nullptr)
+        return false;
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    return true;
+}
+
+bool CubeFisheyeViewportEffect::render(Renderer* renderer, FramebufferObject*, int width, int height)
+{
+    CelestiaGLProgram *prog = renderer->getShaderManager().getShader("cubefisheye");
+    if (prog == nullptr)
+        return false;
+
+    vo.bind();
+    if (!vo.initialized())
+        initializeVO(vo);
+
+    prog->use();
+    prog->floatParam("aspectRatio") = static_cast<float>(width) / static_cast<float>(height);
+    prog->floatParam("halfFov") = halfFov;
+    for (int i = 0; i < FaceCount; i++)
+    {
+        prog->samplerParam(faceSamplers[i]) = i;
+        celestia::gl::activeTexture(GL_TEXTURE0 + i);
+        celestia::gl::bindTexture(GL_TEXTURE_2D, faces[i]->colorTexture());
+    }
+    renderer->setPipelineState(ps);
+    draw(vo);
+    for (int i = FaceCount - 1; i >= 0; i--)
+    {
+        celestia::gl::activeTexture(GL_TEXTURE0 + i);
+        celestia::gl::bindTexture(GL_TEXTURE_2D, 0);
+    }
+    vo.unbind();
+    return true;
+}
+
+void CubeFisheyeViewportEffect::initializeVO(celgl::VertexObject& vo)
+{
+    static float quadVertices[] = {
+        -1.0f,  1.0f,
+        -1.0f, -1.0f,
+         1.0f, -1.0f,
+
+        -1.0f,  1.0f,
+         1.0f, -1.0f,
+         1.0f,  1.0f,
+    };
+    vo.allocate(sizeof(quadVertices), quadVertices);
+    vo.setVertices(2, GL_FLOAT, false, 2 * sizeof(float), 0);
+}
+
+void CubeFisheyeViewportEffect::draw(celgl::VertexObject& vo)
+{
+    vo.draw(GL_TRIANGLES, 6);
+}
+
+bool CubeFisheyeViewportEffect::getPickRay(float x, float y, Eigen::Vector3f& ray) const
+{
+    // The dome fills the height of the view, whose half is one unit here
+    float r = std::hypot(x, y) * 2.0f;
+    float theta = r * halfFov;
+    float phi = std::atan2(y, x);
+    ray = Eigen::Vector3f(std::sin(theta) * std::cos(phi),
+                          std::sin(theta) * std::sin(phi),
+                          -std::cos(theta));
+    return true;
+}
+
+void CubeFisheyeViewportEffect::addSharedViews(const Observer& observer, float,
+                                               std::vector<Renderer::SharedView>& views) const
+{
+    for (int i = 0; i < FaceCount; i++)
+    {
+        if (faceScales[i] == 0.0f)
+            continue;
+
+        views.push_back({ observer.getPosition(),
+                          faceRotations()[i].conjugate() * observer.getOrientationf(),
+                          celestia::numbers::pi_v<float> / 2.0f,
+                          1.0f });
+    }
+}
@@ -10,26 +10,51 @@
 
 #pragma once
 
+#include <array>
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
+#include <Eigen/Core>
 #include <celengine/glsupport.h>
+#include <celengine/observer.h>
+#include <celengine/render.h>
 #include <celengine/vertexobject.h>
 
 class FramebufferObject;
-class Renderer;
 class CelestiaGLProgram;
 class WarpMesh;
 
 class ViewportEffect
 {
  public:
+    // Draws the scene seen by an observer in the current render region
+    using SceneDrawer = std::function<void(Observer&)>;
+
     virtual ~ViewportEffect() = default;
 
     virtual bool preprocess(Renderer*, FramebufferObject*);
+    // Draw the scene seen by observer into the view of width x height
+    // pixels. Effects resampling the view draw it once into fbo, which
+    // preprocess() bound; others may draw several views of their own.
+    virtual bool drawScene(Renderer*, FramebufferObject* fbo, int width, int height,
+                           Observer& observer, const SceneDrawer&);
     virtual bool prerender(Renderer*, FramebufferObject*);
     virtual bool render(Renderer*, FramebufferObject*, int width, int height) = 0;
     virtual bool distortXY(float& x, float& y);
+    // Set ray to the direction relative to the observer of the point x, y
+    // of the view, in units of its height from its center. Returns false
+    // if the effect doesn't change the projection of the renderer.
+    virtual bool getPickRay(float x, float y, Eigen::Vector3f& ray) const;
 
- private:
+    // Whether the scene is drawn into the framebuffer of the view
+    virtual bool usesViewFramebuffer() const;
+    // Add the views drawn by drawScene() for observer to views, see
+    // Renderer::setSharedViews().
+    virtual void addSharedViews(const Observer& observer, float aspectRatio,
+                                std::vector<Renderer::SharedView>& views) const;
+
+ protected:
     GLint oldFboId;
 };
 
@@ -65,3 +90,51 @@ class WarpMeshViewportEffect : public ViewportEffect
     void initializeVO(celgl::VertexObject&);
     void draw(celgl::VertexObject&);
 };
+
+// Fisheye projection for domes, resampled from five faces of a cube around
+// the observer: the front, right, left, top and bottom ones. The faces use
+// the perspective projection, so unlike the fisheye projection mode, lines
+// and triangles don't need to be tessellated. Apertures up to 250 degrees
+// are covered without the back face.
+class CubeFisheyeViewportEffect : public ViewportEffect
+{
+ public:
+    explicit CubeFisheyeViewportEffect(float fovDegrees = 180.0f);
+    ~CubeFisheyeViewportEffect() override;
+
+    bool preprocess(Renderer*, FramebufferObject*) override;
+    bool drawScene(Renderer*, FramebufferObject*, int width, int height,
+                   Observer& observer, const SceneDrawer&) override;
+    bool prerender(Renderer*, FramebufferObject*) override;
+    bool render(Renderer*, FramebufferObject*, int width, int height) override;
+    bool getPickRay(float x, float y, Eigen::Vector3f& ray) const override;
+
+    bool usesViewFramebuffer() const override;
+    void addSharedViews(const Observer& observer, float aspectRatio,
+                        std::vector<Renderer::SharedView>& views) const override;
+
+    // Draw the faces seen only beyond angle degrees from the direction
+    // of the audience's gaze at peripheryScale times the resolution of
+    // the others. The direction is offset from the center of the dome
+    // toward the bottom of the image by offset degrees. Faces outside the
+    // aperture aren't drawn.
+    void setFoveation(float angle, float offset, float peripheryScale);
+
+    static constexpr int FaceCount = 5;
+
+ private:
+    bool updateFaces(int size);
+
+    celgl::VertexObject vo;
+    // Half of the aperture in radians
+    float halfFov;
+    std::array<std::unique_ptr<FramebufferObject>, FaceCount> faces;
+    // Resolution of each face relative to that of the dome center, zero
+    // for faces outside the aperture
+    std::array<float, FaceCount> faceScales;
+    // The face observers are kept, as the renderer caches data per observer
+    std::array<Observer, FaceCount> faceObservers;
+
+    void initializeVO(celgl::VertexObject&);
+    void draw(celgl::VertexObject&);
+};
@@ -7,20 +7,25 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <cmath>
 #include <cassert>
 #include <cmath>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <functional>
 #include <string>
 #include <utility>
 #include <fmt/format.h>
 #include <celcompat/filesystem.h>
 #include <celutil/filetype.h>
 #include <celutil/logger.h>
+#include <celutil/jobsystem.h>
 #include <celutil/tokenizer.h>
 #include "glsupport.h"
 #include "parser.h"
+#include "tilepack.h"
 #include "virtualtex.h"
 
 
@@ -28,6 +33,21 @@ using namespace std;
 using celestia::util::GetLogger;
 
 static const int MaxResolutionLevels = 13;
+// Tiles being read at once, and created per usage
+static const std::size_t MaxPendingLoads = 8;
+static const unsigned int MaxTileUploads = 4;
+// Movement in tiles per usage above which neighbors are prefetched
+static const float MinTileMotion = 0.01f;
+
+// Size of the texture atlases tiles are stored in
+static const int AtlasSize = 4096;
+
+static bool asyncTileLoading = false;
+static std::size_t tileMemoryBudget = 0;
+static bool atlasTiles = false;
+static bool sparseTiles = false;
+// Tile loads of all virtual textures not created yet
+static std::size_t pendingTileLoads = 0;
 
 
 // Virtual textures are composed of tiles that are loaded from the hard drive
@@ -61,26 +81,37 @@ VirtualTexture::VirtualTexture(const fs::path& _tilePath,
                                unsigned int _baseSplit,
                                unsigned int _tileSize,
                                const string& _tilePrefix,
-                               const string& _tileType) :
+                               const string& _tileType,
+                               std::shared_ptr<const TilePack> _tilePack) :
     Texture(_tileSize << (_baseSplit + 1), _tileSize << _baseSplit),
     tilePath(_tilePath),
     tilePrefix(_tilePrefix),
     baseSplit(_baseSplit),
     tileSize(_tileSize),
     ticks(0),
-    nResolutionLevels(0)
+    nResolutionLevels(0),
+    tilePack(std::move(_tilePack))
 {
     assert(tileSize != 0 && isPow2(tileSize));
     tileTree[0] = new TileQuadtreeNode();
     tileTree[1] = new TileQuadtreeNode();
     tileExt = fmt::format(".{:s}", _tileType);
-    populateTileTree();
+    if (tilePack != nullptr)
+        populateTileTreeFromPack();
+    else
+        populateTileTree();
 
     if (DetermineFileType(tileExt) == Content_DXT5NormalMap)
         setFormatOptions(Texture::DXT5NormalMap);
 }
 
 
+VirtualTexture::~VirtualTexture()
+{
+    pendingTileLoads -= pendingLoads.size();
+}
+
+
 const TextureTile VirtualTexture::getTile(int lod, int u, int v)
 {
     tilesRequested++;
@@ -99,7 +130,9 @@ const TextureTile VirtualTexture::getTile(int lod, int u, int v)
 
     TileQuadtreeNode* node = tileTree[u >> lod];
     Tile* tile = node->tile;
-    unsigned int tileLOD = 0;
+    // The coarsest tile along the path, and the finest one that is resident
+    Tile* base = tile;
+    Tile* resident = tile != nullptr && tile->isResident() ? tile : nullptr;
 
     for (int n = 0; n < lod; n++)
     {
@@ -113,7 +146,10 @@ const TextureTile VirtualTexture::getTile(int lod, int u, int v)
         if (node->tile != nullptr)
         {
             tile = node->tile;
-            tileLOD = n + 1;
+            if (base == nullptr)
+                base = tile;
+            if (tile->isResident())
+                resident = tile;
         }
     }
 
@@ -121,18 +157,37 @@ const TextureTile VirtualTexture::getTile(int lod, int u, int v)
     if (!tile)
         return TextureTile(0);
 
-    // Make the tile resident.
-    unsigned int tileU = u >> (lod - tileLOD);
-    unsigned int tileV = v >> (lod - tileLOD);
-    makeResident(tile, tileLOD, tileU, tileV);
+    if (asyncTileLoading)
+    {
+        // Draw the best resident tile until this one is loaded. Nothing
+        // can be drawn without the base tile, so that one is read now.
+        if (!tile->isResident())
+        {
+            requestTile(tile, 0);
+            if (resident == nullptr)
+            {
+                makeResident(base);
+                resident = base;
+            }
+            tile = resident;
+        }
+        tilesUsed.push_back({ (unsigned int) lod, (unsigned int) u, (unsigned int) v });
+    }
+    else
+    {
+        makeResident(tile);
+    }
 
     // It's possible that we failed to make the tile resident, either
     // because the texture file was bad, or there was an unresolvable
     // out of memory situation.  In that case there is nothing else to
     // do but return a texture tile with a null texture name.
-    if (!tile->tex)
+    if (!tile->isResident())
         return TextureTile(0);
 
+    tile->lastUsed = ticks;
+    unsigned int tileLOD = tile->lod;
+
     // Set up the texture subrect to be the entire texture
     float texU = 0.0f;
     float texV = 0.0f;
@@ -146,6 +201,11 @@ const TextureTile VirtualTexture::getTile(int lod, int u, int v)
     texU = (u & ((1 << lodDiff) - 1)) * texDU;
     texV = (v & ((1 << lodDiff) - 1)) * texDV;
 
+    if (tile->atlas != nullptr)
+        return tile->atlas->getTile(tile->atlasSlot, texU, texV, texDU, texDV);
+    if (tile->sparse != nullptr)
+        return tile->sparse->getTile((int) tile->u, (int) tile->v, texU, texV, texDU, texDV);
+
 #if 0
     cout << "Tile: " << tile->tex->getName() << ", " <<
         texU << ", " << texV << ", " << texDU << ", " << texDV << '\n';
@@ -183,11 +243,82 @@ void VirtualTexture::beginUsage()
 {
     ticks++;
     tilesRequested = 0;
+
+    finishTileLoads();
+    evictTiles();
 }
 
 
 void VirtualTexture::endUsage()
 {
+    if (!asyncTileLoading)
+        return;
+
+    prefetchTiles();
+
+    // Tiles needed for this usage go first, then those predicted
+    std::stable_sort(requests.begin(), requests.end(),
+                     [](const TileRequest& a, const TileRequest& b) { return a.priority < b.priority; });
+    for (const TileRequest& request : requests)
+    {
+        if (pendingLoads.size() >= MaxPendingLoads)
+            break;
+
+        Tile* tile = request.tile;
+        if (tile->isResident() || tile->loadFailed || tile->loading)
+            continue;
+
+        auto load = std::make_shared<TileLoad>();
+        load->tile = tile;
+        tile->loading = true;
+        pendingLoads.push_back(load);
+        pendingTileLoads++;
+
+        std::function<void()> job;
+        if (tilePack != nullptr)
+        {
+            // The pack outlives the texture while the tile is copied
+            const TilePack::Entry* entry = tilePack->find(tile->lod - baseSplit, tile->u, tile->v);
+            job = [load, entry, pack = tilePack]
+            {
+                if (entry != nullptr)
+                    load->image = pack->load(*entry);
+                load->done.store(true, std::memory_order_release);
+            };
+        }
+        else
+        {
+            load->path = getTilePath(tile);
+            job = [load]
+            {
+                load->image.reset(LoadImageFromFile(load->path));
+                load->done.store(true, std::memory_order_release);
+            };
+        }
+        if (auto jobs = celestia::util::GetJobSystem(); jobs != nullptr)
+            jobs->submit(std::move(job), celestia::util::JobPriority::Streaming);
+        else
+            job();
+    }
+
+    // Requests that didn't fit are made again by the next usage
+    requests.clear();
+    tilesUsed.clear();
+}
+
+
+bool VirtualTexture::hasPendingTiles()
+{
+    return pendingTileLoads > 0;
+}
+
+
+void VirtualTexture::setTileLoading(bool async, std::size_t memoryBudget, bool atlas, bool sparse)
+{
+    asyncTileLoading = async;
+    tileMemoryBudget = memoryBudget;
+    atlasTiles = atlas;
+    sparseTiles = sparse;
 }
 
 
@@ -201,46 +332,143 @@ unsigned int VirtualTexture::tileIndex(unsigned int lod,
 #endif
 
 
-ImageTexture* VirtualTexture::loadTileTexture(unsigned int lod, unsigned int u, unsigned int v)
+fs::path VirtualTexture::getTilePath(const Tile* tile) const
 {
-    lod >>= baseSplit;
-    assert(lod < (unsigned)MaxResolutionLevels);
+    unsigned int level = tile->lod - baseSplit;
+    assert(level < (unsigned)MaxResolutionLevels);
 
-    auto path = tilePath /
-                fmt::format("level{:d}", lod) /
-                fmt::format("{:s}{:d}_{:d}{:s}", tilePrefix, u, v, tileExt.string());
+    return tilePath /
+           fmt::format("level{:d}", level) /
+           fmt::format("{:s}{:d}_{:d}{:s}", tilePrefix, tile->u, tile->v, tileExt.string());
+}
 
-    Image* img = LoadImageFromFile(path);
-    if (img == nullptr)
-        return nullptr;
 
-    ImageTexture* tex = nullptr;
+std::unique_ptr<Image> VirtualTexture::loadTileImage(const Tile* tile) const
+{
+    if (tilePack == nullptr)
+        return std::unique_ptr<Image>(LoadImageFromFile(getTilePath(tile)));
 
-    // Only use mip maps for the LOD 0; for higher LODs, the function of mip
-    // mapping is built into the texture.
-    MipMapMode mipMapMode = lod == 0 ? DefaultMipMaps : NoMipMaps;
+    const TilePack::Entry* entry = tilePack->find(tile->lod - baseSplit, tile->u, tile->v);
+    return entry != nullptr ? tilePack->load(*entry) : nullptr;
+}
 
-    if (isPow2(img->getWidth()) && isPow2(img->getHeight()))
-        tex = new ImageTexture(*img, EdgeClamp, mipMapMode);
 
+void VirtualTexture::createTileTexture(Tile* tile, Image& img)
+{
     // TODO: Virtual textures can have tiles in different formats, some
     // compressed and some not. The compression flag doesn't make much
     // sense for them.
-    compressed = img->isCompressed();
+    compressed = img.isCompressed();
+
+    if (!isPow2(img.getWidth()) || !isPow2(img.getHeight()))
+        return;
 
-    delete img;
+    if (!addToSparseTexture(tile, img) && !addToAtlas(tile, img))
+    {
+        // Only use mip maps for the LOD 0; for higher LODs, the function of mip
+        // mapping is built into the texture.
+        MipMapMode mipMapMode = tile->lod == baseSplit ? DefaultMipMaps : NoMipMaps;
+        tile->tex = new ImageTexture(img, EdgeClamp, mipMapMode);
+    }
 
-    return tex;
+    tile->size = static_cast<std::size_t>(img.getSize());
+    residentSize += tile->size;
+    residentTiles.push_back(tile);
 }
 
 
-void VirtualTexture::makeResident(Tile* tile, unsigned int lod, unsigned int u, unsigned int v)
+// Tiles of LOD 0 use mip maps, so they always get a texture of their own
+bool VirtualTexture::addToAtlas(Tile* tile, Image& img)
 {
-    if (tile->tex == nullptr && !tile->loadFailed)
+    int slotsPerSide = std::min(AtlasSize, celestia::gl::maxTextureSize) / (int) tileSize;
+    if (!atlasTiles || tile->lod == baseSplit || slotsPerSide < 2)
+        return false;
+
+    for (const auto& atlas : atlases)
     {
-        // Potentially evict other tiles in order to make this one fit
-        tile->tex = loadTileTexture(lod, u, v);
-        if (tile->tex == nullptr)
+        if (!atlas->isFull() && atlas->getFormat() == img.getFormat())
+        {
+            tile->atlasSlot = atlas->add(img);
+            if (tile->atlasSlot >= 0)
+            {
+                tile->atlas = atlas.get();
+                return true;
+            }
+        }
+    }
+
+    auto atlas = std::make_unique<TextureAtlas>(img.getFormat(), (int) tileSize, slotsPerSide);
+    tile->atlasSlot = atlas->add(img);
+    if (tile->atlasSlot < 0)
+        return false;
+
+    tile->atlas = atlas.get();
+    atlases.push_back(std::move(atlas));
+    return true;
+}
+
+
+// Tiles of LOD 0 use mip maps, so they aren't stored in sparse textures
+// either
+bool VirtualTexture::addToSparseTexture(Tile* tile, Image& img)
+{
+    if (!sparseTiles || tile->lod == baseSplit)
+        return false;
+
+    if (sparseLevels.size() < nResolutionLevels)
+    {
+        sparseLevels.resize(nResolutionLevels);
+        sparseLevelTried.resize(nResolutionLevels, false);
+    }
+
+    auto& level = sparseLevels[tile->lod];
+    if (level == nullptr)
+    {
+        // The format of the first tile decides whether the LOD is sparse
+        if (sparseLevelTried[tile->lod])
+            return false;
+        sparseLevelTried[tile->lod] = true;
+
+        int uTiles = 2 << tile->lod;
+        int vTiles = 1 << tile->lod;
+        if (!SparseTileTexture::isSupported(img.getFormat(), (int) tileSize, uTiles, vTiles))
+            return false;
+        level = std::make_unique<SparseTileTexture>(img.getFormat(), (int) tileSize, uTiles, vTiles);
+    }
+
+    if (!level->add((int) tile->u, (int) tile->v, img))
+        return false;
+
+    tile->sparse = level.get();
+    return true;
+}
+
+
+void VirtualTexture::releaseTile(Tile* tile)
+{
+    if (tile->atlas != nullptr)
+        tile->atlas->remove(tile->atlasSlot);
+    if (tile->sparse != nullptr)
+        tile->sparse->remove((int) tile->u, (int) tile->v);
+    delete tile->tex;
+
+    tile->tex = nullptr;
+    tile->atlas = nullptr;
+    tile->atlasSlot = -1;
+    tile->sparse = nullptr;
+    residentSize -= tile->size;
+    tile->size = 0;
+}
+
+
+void VirtualTexture::makeResident(Tile* tile)
+{
+    if (!tile->isResident() && !tile->loadFailed && !tile->loading)
+    {
+        std::unique_ptr<Image> img = loadTileImage(tile);
+        if (img != nullptr)
+            createTileTexture(tile, *img);
+        if (!tile->isResident())
         {
             // cout << "Texture load failed!\n";
             tile->loadFailed = true;
@@ -249,6 +477,145 @@ void VirtualTexture::makeResident(Tile* tile, unsigned int lod, unsigned int u,
 }
 
 
+void VirtualTexture::requestTile(Tile* tile, int priority)
+{
+    if (tile->isResident() || tile->loadFailed || tile->loading || tile->requested == ticks)
+        return;
+
+    tile->requested = ticks;
+    requests.push_back({ tile, priority });
+}
+
+
+// Guess the tiles needed next from how the tiles drawn moved since the last
+// usage: the tiles of the next LOD when the mean LOD increases, and the
+// neighbors in the direction of motion.
+void VirtualTexture::prefetchTiles()
+{
+    if (tilesUsed.empty())
+        return;
+
+    Eigen::Vector2f center = Eigen::Vector2f::Zero();
+    float meanLOD = 0.0f;
+    for (const TileUse& use : tilesUsed)
+    {
+        center += Eigen::Vector2f((use.u + 0.5f) / (float) (2 << use.lod),
+                                  (use.v + 0.5f) / (float) (1 << use.lod));
+        meanLOD += (float) use.lod;
+    }
+    center /= (float) tilesUsed.size();
+    meanLOD /= (float) tilesUsed.size();
+
+    bool hasLast = lastLOD >= 0.0f;
+    Eigen::Vector2f motion = hasLast ? Eigen::Vector2f(center - lastCenter) : Eigen::Vector2f::Zero();
+    bool zoomingIn = hasLast && meanLOD > lastLOD;
+    lastCenter = center;
+    lastLOD = meanLOD;
+
+    for (const TileUse& use : tilesUsed)
+    {
+        if (zoomingIn)
+        {
+            for (unsigned int i = 0; i < 4; i++)
+            {
+                Tile* child = findTile(use.lod + 1, use.u * 2 + (i & 1), use.v * 2 + (i >> 1));
+                if (child != nullptr)
+                    requestTile(child, 1);
+            }
+        }
+
+        unsigned int uCount = 2 << use.lod;
+        unsigned int vCount = 1 << use.lod;
+        float du = motion.x() * (float) uCount;
+        float dv = motion.y() * (float) vCount;
+        if (std::abs(du) > MinTileMotion)
+        {
+            // The texture wraps around in u
+            unsigned int u = (use.u + (du > 0.0f ? 1 : uCount - 1)) % uCount;
+            if (Tile* tile = findTile(use.lod, u, use.v); tile != nullptr)
+                requestTile(tile, 2);
+        }
+        if (std::abs(dv) > MinTileMotion)
+        {
+            unsigned int v = dv > 0.0f ? use.v + 1 : use.v - 1;
+            if (Tile* tile = findTile(use.lod, use.u, v); tile != nullptr)
+                requestTile(tile, 2);
+        }
+    }
+}
+
+
+// Create the textures of tiles read by the loader threads
+void VirtualTexture::finishTileLoads()
+{
+    unsigned int nCreated = 0;
+    for (auto iter = pendingLoads.begin(); iter != pendingLoads.end() && nCreated < MaxTileUploads;)
+    {
+        TileLoad& load = **iter;
+        if (!load.done.load(std::memory_order_acquire))
+        {
+            ++iter;
+            continue;
+        }
+
+        Tile* tile = load.tile;
+        tile->loading = false;
+        if (load.image != nullptr)
+            createTileTexture(tile, *load.image);
+        if (!tile->isResident())
+            tile->loadFailed = true;
+
+        nCreated++;
+        pendingTileLoads--;
+        iter = pendingLoads.erase(iter);
+    }
+}
+
+
+// Release the least recently used tiles beyond the memory budget. Tiles of
+// the lowest LOD are kept as a fallback, as are those of the last usage.
+void VirtualTexture::evictTiles()
+{
+    if (tileMemoryBudget == 0 || residentSize <= tileMemoryBudget)
+        return;
+
+    std::sort(residentTiles.begin(), residentTiles.end(),
+              [](const Tile* a, const Tile* b) { return a->lastUsed < b->lastUsed; });
+
+    std::size_t nKept = 0;
+    for (Tile* tile : residentTiles)
+    {
+        if (residentSize > tileMemoryBudget && tile->lod > baseSplit && tile->lastUsed + 1 < ticks)
+            releaseTile(tile);
+        else
+        {
+            residentTiles[nKept++] = tile;
+        }
+    }
+    residentTiles.resize(nKept);
+}
+
+
+VirtualTexture::Tile* VirtualTexture::findTile(unsigned int lod,
+                                               unsigned int u, unsigned int v)
+{
+    if (lod >= nResolutionLevels || u >= (2u << lod) || v >= (1u << lod))
+        return nullptr;
+
+    TileQuadtreeNode* node = tileTree[u >> lod];
+    for (unsigned int i = 0; i < lod; i++)
+    {
+        unsigned int mask = 1 << (lod - i - 1);
+        unsigned int child = (((v & mask) << 1) | (u & mask)) >> (lod - i - 1);
+        if (!node->children[child])
+            return nullptr;
+        node = node->children[child];
+    }
+
+    return node->tile;
+}
+
+
 void VirtualTexture::populateTileTree()
 {
     // Count the number of resolution levels present
@@ -278,6 +645,9 @@ void VirtualTexture::populateTileTree()
                     {
                         // Found a tile, so add it to the quadtree
                         Tile* tile = new Tile();
+                        tile->lod = maxLevel;
+                        tile->u = (unsigned int) u;
+                        tile->v = (unsigned int) v;
                         addTileToTree(tile, maxLevel, (unsigned int) u, (unsigned int) v);
                     }
                 }
@@ -289,6 +659,31 @@ void VirtualTexture::populateTileTree()
 }
 
 
+// Add the tiles of the pack's index instead of scanning level directories
+void VirtualTexture::populateTileTreeFromPack()
+{
+    unsigned int maxLevel = 0;
+    for (const TilePack::Entry& entry : tilePack->entries())
+    {
+        if (entry.level >= (unsigned int) MaxResolutionLevels)
+            continue;
+
+        unsigned int lod = entry.level + baseSplit;
+        if (entry.u >= (2u << lod) || entry.v >= (1u << lod))
+            continue;
+
+        Tile* tile = new Tile();
+        tile->lod = lod;
+        tile->u = entry.u;
+        tile->v = entry.v;
+        addTileToTree(tile, lod, entry.u, entry.v);
+        maxLevel = std::max(maxLevel, lod);
+    }
+
+    nResolutionLevels = maxLevel + 1;
+}
+
+
 void VirtualTexture::addTileToTree(Tile* tile, unsigned int lod, unsigned int u, unsigned int v)
 {
     TileQuadtreeNode* node = tileTree[u >> lod];
@@ -314,8 +709,12 @@ void VirtualTexture::addTileToTree(Tile* tile, unsigned int lod, unsigned int u,
 static VirtualTexture* CreateVirtualTexture(Hash* texParams,
                                             const fs::path& path)
 {
+    // Tiles are either packed into one file, or stored in a directory
+    // per level
+    string packFile;
     string imageDirectory;
-    if (!texParams->getString("ImageDirectory", imageDirectory))
+    if (!texParams->getString("TilePack", packFile) &&
+        !texParams->getString("ImageDirectory", imageDirectory))
     {
         GetLogger()->error("ImageDirectory missing in virtual texture.\n");
         return nullptr;
@@ -356,11 +755,24 @@ static VirtualTexture* CreateVirtualTexture(Hash* texParams,
 
     if (directory.is_relative())
         directory = path / directory;
+
+    std::shared_ptr<const TilePack> tilePack;
+    if (!packFile.empty())
+    {
+        fs::path packPath(packFile);
+        if (packPath.is_relative())
+            packPath = path / packPath;
+        tilePack = TilePack::open(packPath);
+        if (tilePack == nullptr)
+            return nullptr;
+    }
+
     return new VirtualTexture(directory,
                               (unsigned int) baseSplit,
                               (unsigned int) tileSize,
                               tilePrefix,
-                              tileType);
+                              tileType,
+                              std::move(tilePack));
 }
 
 
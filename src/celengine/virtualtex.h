@@ -10,9 +10,16 @@
 #ifndef _CELENGINE_VIRTUALTEX_H_
 #define _CELENGINE_VIRTUALTEX_H_
 
+#include <atomic>
+#include <cstddef>
+#include <memory>
 #include <string>
+#include <vector>
+#include <Eigen/Core>
 #include <celengine/texture.h>
 
+class TilePack;
+
 
 class VirtualTexture : public Texture
 {
@@ -21,8 +28,9 @@ class VirtualTexture : public Texture
                    unsigned int _baseSplit,
                    unsigned int _tileSize,
                    const std::string& _tilePrefix,
-                   const std::string& _tileType);
-    ~VirtualTexture() = default;
+                   const std::string& _tileType,
+                   std::shared_ptr<const TilePack> _tilePack = nullptr);
+    ~VirtualTexture();
 
     const TextureTile getTile(int lod, int u, int v) override;
     void bind() override;
@@ -32,6 +40,18 @@ class VirtualTexture : public Texture
     int getVTileCount(int lod) const override;
     void beginUsage() override;
     void endUsage() override;
+    std::size_t getMemoryUsage() const override { return residentSize; }
+
+    // With async set, tiles are read on loader threads and drawn with a
+    // lower resolution tile until they are ready. Tiles that haven't been
+    // used recently are released once a texture holds more than
+    // memoryBudget bytes of them; 0 means no limit. With atlas set, tiles
+    // above the lowest LOD are stored in shared texture atlases. With
+    // sparse set, they are stored in a sparse texture per LOD where it's
+    // supported, and only the pages of resident tiles take memory.
+    static void setTileLoading(bool async, std::size_t memoryBudget, bool atlas, bool sparse);
+    // True while tiles read on loader threads are waiting to be drawn
+    static bool hasPendingTiles();
 
  private:
     struct Tile
@@ -39,7 +59,39 @@ class VirtualTexture : public Texture
         Tile() = default;
         unsigned int lastUsed{ 0 };
         ImageTexture* tex{ nullptr };
+        TextureAtlas* atlas{ nullptr };
+        int atlasSlot{ -1 };
+        SparseTileTexture* sparse{ nullptr };
         bool loadFailed{ false };
+        bool loading{ false };
+        unsigned int requested{ 0 };
+        std::size_t size{ 0 };
+        unsigned int lod{ 0 };
+        unsigned int u{ 0 };
+        unsigned int v{ 0 };
+
+        bool isResident() const { return tex != nullptr || atlas != nullptr || sparse != nullptr; }
+    };
+
+    struct TileLoad
+    {
+        Tile* tile;
+        fs::path path;
+        std::unique_ptr<Image> image;
+        std::atomic<bool> done{ false };
+    };
+
+    struct TileRequest
+    {
+        Tile* tile;
+        int priority;
+    };
+
+    struct TileUse
+    {
+        unsigned int lod;
+        unsigned int u;
+        unsigned int v;
     };
 
     struct TileQuadtreeNode
@@ -50,9 +102,19 @@ class VirtualTexture : public Texture
     };
 
     void populateTileTree();
+    void populateTileTreeFromPack();
     void addTileToTree(Tile* tile, unsigned int lod, unsigned int u, unsigned int v);
-    void makeResident(Tile* tile, unsigned int lod, unsigned int u, unsigned int v);
-    ImageTexture* loadTileTexture(unsigned int lod, unsigned int u, unsigned int v);
+    void makeResident(Tile* tile);
+    fs::path getTilePath(const Tile* tile) const;
+    std::unique_ptr<Image> loadTileImage(const Tile* tile) const;
+    void createTileTexture(Tile* tile, Image& img);
+    bool addToAtlas(Tile* tile, Image& img);
+    bool addToSparseTexture(Tile* tile, Image& img);
+    void releaseTile(Tile* tile);
+    void requestTile(Tile* tile, int priority);
+    void prefetchTiles();
+    void finishTileLoads();
+    void evictTiles();
 
     Tile* tiles{ nullptr };
     Tile* findTile(unsigned int lod,
@@ -68,6 +130,24 @@ class VirtualTexture : public Texture
     unsigned int tilesRequested{ 0 };
     unsigned int nResolutionLevels{ 0 };
 
+    // Tiles packed into one file instead of a file per tile
+    std::shared_ptr<const TilePack> tilePack;
+
+    std::vector<std::unique_ptr<TextureAtlas>> atlases;
+    // Sparse textures of the LODs, created for the first tile of a LOD if
+    // its format can be sparse
+    std::vector<std::unique_ptr<SparseTileTexture>> sparseLevels;
+    std::vector<bool> sparseLevelTried;
+    std::vector<Tile*> residentTiles;
+    std::size_t residentSize{ 0 };
+    std::vector<std::shared_ptr<TileLoad>> pendingLoads;
+    std::vector<TileRequest> requests;
+    // Tiles drawn during the current usage, and the mean position and LOD
+    // of those of the last usage, used to predict the tiles needed next
+    std::vector<TileUse> tilesUsed;
+    Eigen::Vector2f lastCenter{ Eigen::Vector2f::Zero() };
+    float lastLOD{ -1.0f };
+
     enum
     {
         TileNotLoaded  = -1,
@@ -11,9 +11,10 @@
 // of the License, or (at your option) any later version.
 
 #include <cmath>
+#include <vector>
 #include <Eigen/Geometry>
 #include <celcompat/numbers.h>
-#include <celmath/intersect.h>
+#include <celmath/mathlib.h>
 #include "body.h"
 #include "render.h"
 #include "selection.h"
@@ -75,74 +76,46 @@ VisibleRegion::setOpacity(float opacity)
 }
 
 
-constexpr const unsigned maxSections = 360;
-
-static void
-renderTerminator(Renderer* renderer,
-                 const vector<LineStripEnd>& pos,
-                 const Color& color,
-                 const Matrices& mvp)
+namespace
 {
-    /*!
-     * Proper terminator calculation requires double precision floats in GLSL
-     * which were introduced in ARB_gpu_shader_fp64 unavailable with GL2.1.
-     * Because of this we make calculations on a CPU and stream results to GPU.
-     */
-
-    using AttributesType = celgl::VertexObject::AttributesType;
-
-    ShaderProperties shadprop;
-    shadprop.texUsage = ShaderProperties::VertexColors;
-    shadprop.lightModel = ShaderProperties::UnlitModel;
-
-    bool lineAsTriangles = renderer->shouldDrawLineAsTriangles();
-    if (lineAsTriangles)
-        shadprop.texUsage |= ShaderProperties::LineAsTriangles;
-
-    auto *prog = renderer->getShaderManager().getShader(shadprop);
-    if (prog == nullptr)
-        return;
 
-    auto &vo = renderer->getVertexObject(VOType::Terminator, GL_ARRAY_BUFFER, 0, GL_STREAM_DRAW);
-
-    vo.bindWritable(lineAsTriangles ? AttributesType::Default : AttributesType::Alternative1);
-    if (!vo.initialized())
-    {
-        vo.setBufferSize((maxSections + 2) * 2 * sizeof(LineStripEnd));
-        vo.allocate();
-
-        // Attributes for lines drawn as triangles
-        vo.setVertices(3, GL_FLOAT, false, sizeof(LineStripEnd), 0);
-        vo.setVertexAttribArray(CelestiaGLProgram::NextVCoordAttributeIndex,
-                                3, GL_FLOAT, false, sizeof(LineStripEnd)
-                                , 2 * sizeof(LineStripEnd) + offsetof(LineStripEnd, point));
-        vo.setVertexAttribArray(CelestiaGLProgram::ScaleFactorAttributeIndex,
-                                1, GL_FLOAT, false, sizeof(LineStripEnd)
-                                , offsetof(LineStripEnd, scale));
-
-        // Attributes for lines drawn as lines
-        vo.setVertices(3, GL_FLOAT, false, 2 * sizeof(LineStripEnd), 0, AttributesType::Alternative1);
-    }
+constexpr unsigned int CircleSubdivisions = 360;
 
-    vo.setBufferData(pos.data(), 0, pos.size() * sizeof(LineStripEnd));
+// Number of line strip ends of the circle: two per point, and one point
+// more than the subdivisions, plus another so that the next point of the
+// last one exists
+constexpr GLsizei CircleLength = (CircleSubdivisions + 2) * 2;
 
-    prog->use();
-    prog->setMVPMatrices(*mvp.projection, *mvp.modelview);
-    glVertexAttrib(CelestiaGLProgram::ColorAttributeIndex, color);
-    if (lineAsTriangles)
-    {
-        prog->lineWidthX = renderer->getLineWidthX();
-        prog->lineWidthY = renderer->getLineWidthY();
-        vo.draw(GL_TRIANGLE_STRIP, pos.size() - 2);
-    }
-    else
+// The outline of a visible region is an ellipse: the points where the rays
+// from the target touch the body lie in a plane. Every outline is drawn
+// from the same unit circle in the xy plane, kept in a static buffer and
+// transformed to the ellipse by the vertex shader, so that only the
+// transformation is computed for each body.
+void
+initCircleVO(celgl::VertexObject& vo)
+{
+    std::vector<LineStripEnd> vertices;
+    vertices.reserve(CircleLength);
+    for (unsigned int i = 0; i <= CircleSubdivisions + 1; i++)
     {
-        vo.draw(GL_LINE_STRIP, (pos.size() - 2) / 2, 0);
+        float theta = (float) (2.0 * celestia::numbers::pi) * (float) i / (float) CircleSubdivisions;
+        float s, c;
+        sincos(theta, s, c);
+        Vector3f point(c, s, 0.0f);
+        vertices.emplace_back(point, -0.5f);
+        vertices.emplace_back(point,  0.5f);
     }
 
-    vo.unbind();
+    vo.allocate(vertices.size() * sizeof(LineStripEnd), vertices.data());
+    vo.setVertices(3, GL_FLOAT, false, sizeof(LineStripEnd), offsetof(LineStripEnd, point));
+    vo.setVertexAttribArray(CelestiaGLProgram::NextVCoordAttributeIndex, 3, GL_FLOAT, false,
+                            sizeof(LineStripEnd), offsetof(LineStripEnd, point) + 2 * sizeof(LineStripEnd));
+    vo.setVertexAttribArray(CelestiaGLProgram::ScaleFactorAttributeIndex, 1, GL_FLOAT, false,
+                            sizeof(LineStripEnd), offsetof(LineStripEnd, scale));
 }
 
+} // end unnamed namespace
+
 
 void
 VisibleRegion::render(Renderer* renderer,
@@ -169,10 +142,6 @@ VisibleRegion::render(Renderer* renderer,
         return;
     opacity = min(opacity, 1.0f) * m_opacity;
 
-    // Base the amount of subdivision on the apparent size
-    auto nSections = (unsigned int) (30.0f + discSizeInPixels * 0.5f);
-    nSections = min(nSections, maxSections);
-
     Quaterniond q = m_body.getEclipticToBodyFixed(tdb);
     Quaternionf qf = q.cast<float>();
 
@@ -182,7 +151,46 @@ VisibleRegion::render(Renderer* renderer,
     float scale = (discSizeInPixels + 1) / discSizeInPixels;
     scale = max(scale, 1.0001f);
 
-    Vector3f semiAxes = m_body.getSemiAxes();
+    // In order to avoid precision problems and extremely large values, the
+    // target position and semiaxes are scaled such that the largest
+    // semiaxis is 1.0, and then along the axes so that the body becomes
+    // the unit sphere.
+    double maxSemiAxis = m_body.getRadius();
+    Vector3d semiAxes = m_body.getSemiAxes().cast<double>() / maxSemiAxis;
+    Vector3d targetDir = m_body.getPosition(tdb).offsetFromKm(m_target.getPosition(tdb)) / -maxSemiAxis;
+    Vector3d p = (q * targetDir).cwiseQuotient(semiAxes);
+
+    // Nothing is visible from a target inside the body
+    double pp = p.squaredNorm();
+    if (pp <= 1.0)
+        return;
+
+    // Rays from p touch the unit sphere on a circle centered on p / |p|^2,
+    // in the plane normal to p, of radius sqrt(1 - 1 / |p|^2). Scaling
+    // back along the axes turns it into an ellipse.
+    Vector3d normal = p / std::sqrt(pp);
+    Vector3d uAxis = normal.unitOrthogonal();
+    Vector3d vAxis = normal.cross(uAxis);
+    double radius = std::sqrt(1.0 - 1.0 / pp);
+    Vector3d size = semiAxes * (maxSemiAxis * scale);
+
+    Matrix4f circleTransform = Matrix4f::Identity();
+    circleTransform.block<3, 1>(0, 0) = (uAxis * radius).cwiseProduct(size).cast<float>();
+    circleTransform.block<3, 1>(0, 1) = (vAxis * radius).cwiseProduct(size).cast<float>();
+    circleTransform.block<3, 1>(0, 2) = normal.cwiseProduct(size).cast<float>();
+    circleTransform.block<3, 1>(0, 3) = (p / pp).cwiseProduct(size).cast<float>();
+
+    ShaderProperties shadprop;
+    shadprop.texUsage = ShaderProperties::VertexColors;
+    shadprop.lightModel = ShaderProperties::UnlitModel;
+
+    bool lineAsTriangles = renderer->shouldDrawLineAsTriangles();
+    if (lineAsTriangles)
+        shadprop.texUsage |= ShaderProperties::LineAsTriangles;
+
+    auto *prog = renderer->getShaderManager().getShader(shadprop);
+    if (prog == nullptr)
+        return;
 
     Renderer::PipelineState ps;
     ps.blending = true;
@@ -192,49 +200,29 @@ VisibleRegion::render(Renderer* renderer,
     ps.smoothLines = true;
     renderer->setPipelineState(ps);
 
-    double maxSemiAxis = m_body.getRadius();
-
-    // In order to avoid precision problems and extremely large values, scale
-    // the target position and semiaxes such that the largest semiaxis is 1.0.
-    Vector3d lightDir = m_body.getPosition(tdb).offsetFromKm(m_target.getPosition(tdb));
-    lightDir = lightDir / maxSemiAxis;
-    lightDir = q * lightDir;
-
-    // Another measure to prevent precision problems: if the distance to the
-    // object is much greater than the largest semi axis, clamp it to 1e4 times
-    // the radius, as body-to-target rays at that distance are nearly parallel anyhow.
-    if (lightDir.norm() > 10000.0)
-        lightDir *= (10000.0 / lightDir.norm());
-
-    // Pick two orthogonal axes both normal to the light direction
-    Vector3d lightDirNorm = lightDir.normalized();
-
-    Vector3d uAxis = lightDirNorm.unitOrthogonal();
-    Vector3d vAxis = uAxis.cross(lightDirNorm);
-
-    Vector3d recipSemiAxes = maxSemiAxis * semiAxes.cast<double>().cwiseInverse();
-    Vector3d e = -lightDir;
-    Vector3d e_ = e.cwiseProduct(recipSemiAxes);
-    double ee = e_.squaredNorm();
+    Affine3f transform = Translation3f(position) * qf.conjugate();
+    Matrix4f modelView = (*m.modelview) * transform.matrix() * circleTransform;
 
-    vector<LineStripEnd> pos;
-    pos.reserve((nSections + 2) * 2);
+    auto &vo = renderer->getVertexObject(VOType::Terminator, GL_ARRAY_BUFFER, 0, GL_STATIC_DRAW);
+    vo.bind();
+    if (!vo.initialized())
+        initCircleVO(vo);
 
-    for (unsigned i = 0; i <= nSections + 1; i++)
+    prog->use();
+    prog->setMVPMatrices(*m.projection, modelView);
+    glVertexAttrib(CelestiaGLProgram::ColorAttributeIndex, Color(m_color, opacity));
+    if (lineAsTriangles)
     {
-        double theta = (double) i / (double) (nSections) * 2.0 * celestia::numbers::pi;
-        Vector3d w = cos(theta) * uAxis + sin(theta) * vAxis;
-
-        Vector3d toCenter = ellipsoidTangent(recipSemiAxes, w, e, e_, ee);
-        toCenter *= maxSemiAxis * scale;
-        Vector3f thisPoint = toCenter.cast<float>();
-        pos.emplace_back(thisPoint, -0.5);
-        pos.emplace_back(thisPoint, 0.5);
+        prog->lineWidthX = renderer->getLineWidthX();
+        prog->lineWidthY = renderer->getLineWidthY();
+        vo.draw(GL_TRIANGLE_STRIP, CircleLength - 2);
+    }
+    else
+    {
+        vo.draw(GL_LINE_STRIP, CircleLength - 2);
     }
 
-    Affine3f transform = Translation3f(position) * qf.conjugate();
-    Matrix4f modelView = (*m.modelview) * transform.matrix();
-    renderTerminator(renderer, pos, Color(m_color, opacity), { m.projection, &modelView });
+    vo.unbind();
 }
 
 
@@ -0,0 +1,359 @@
+// chebyshevorbit.cpp
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "chebyshevorbit.h"
+#include "xyzvbinary.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <celcompat/numbers.h>
+#include <celutil/bytes.h>
+#include <celutil/gettext.h>
+#include <celutil/logger.h>
+#include <celutil/mmapfile.h>
+
+using namespace Eigen;
+using celestia::util::GetLogger;
+
+
+namespace
+{
+
+// The segments of a long time lapse are dropped once there are this many,
+// so that the cache doesn't grow without limit.
+constexpr std::size_t MaxCachedSegments = 4096;
+
+// Evaluate the Chebyshev series c[0] / 2 + sum c[i] T_i(x) of n terms with
+// Clenshaw's recurrence
+Vector3d
+evaluateSeries(const Vector3d* c, std::size_t n, double x)
+{
+    Vector3d b1 = Vector3d::Zero();
+    Vector3d b2 = Vector3d::Zero();
+    for (std::size_t i = n - 1; i > 0; i--)
+    {
+        Vector3d b0 = 2.0 * x * b1 - b2 + c[i];
+        b2 = b1;
+        b1 = b0;
+    }
+
+    return x * b1 - b2 + 0.5 * c[0];
+}
+
+
+template<std::size_t N> Vector3d
+evaluateSeries(const std::array<Vector3d, N>& c, double x)
+{
+    return evaluateSeries(c.data(), N, x);
+}
+
+
+// Compute the degree coefficients of the derivative of the series c of
+// degree + 1 terms, in the same form as c so that both are evaluated by
+// evaluateSeries()
+void
+differentiateSeries(const Vector3d* c, int degree, Vector3d* d)
+{
+    Vector3d next = Vector3d::Zero();
+    Vector3d current = Vector3d::Zero();
+    for (int j = degree - 1; j >= 0; j--)
+    {
+        Vector3d dj = next + (2.0 * (j + 1)) * c[j + 1];
+        next = current;
+        current = dj;
+        d[j] = dj;
+    }
+}
+
+} // end unnamed namespace
+
+
+ChebyshevOrbit::ChebyshevOrbit(Orbit* _orbit, double _segmentLength) :
+    orbit(_orbit),
+    segmentLength(_segmentLength)
+{
+    assert(_orbit != nullptr);
+    assert(_segmentLength > 0.0);
+}
+
+
+Vector3d ChebyshevOrbit::positionAtTime(double jd) const
+{
+    double x;
+    const Segment& segment = segmentAtTime(jd, x);
+    return evaluateSeries(segment.position, x);
+}
+
+
+Vector3d ChebyshevOrbit::velocityAtTime(double jd) const
+{
+    double x;
+    const Segment& segment = segmentAtTime(jd, x);
+
+    // The derivative coefficients are with respect to x, which covers the
+    // segment in the interval [-1, 1]
+    return evaluateSeries(segment.velocity, x) * (2.0 / segmentLength);
+}
+
+
+double ChebyshevOrbit::getPeriod() const
+{
+    return orbit->getPeriod();
+}
+
+
+double ChebyshevOrbit::getBoundingRadius() const
+{
+    return orbit->getBoundingRadius();
+}
+
+
+bool ChebyshevOrbit::isPeriodic() const
+{
+    return orbit->isPeriodic();
+}
+
+
+void ChebyshevOrbit::getValidRange(double& begin, double& end) const
+{
+    orbit->getValidRange(begin, end);
+}
+
+
+const ChebyshevOrbit::Segment&
+ChebyshevOrbit::segmentAtTime(double jd, double& x) const
+{
+    double n = std::floor(jd / segmentLength);
+    double t0 = n * segmentLength;
+    x = 2.0 * (jd - t0) / segmentLength - 1.0;
+
+    auto index = static_cast<std::int64_t>(n);
+    auto iter = segments.find(index);
+    if (iter != segments.end())
+        return iter->second;
+
+    if (segments.size() >= MaxCachedSegments)
+        segments.clear();
+
+    Segment& segment = segments[index];
+    fit(t0, segment);
+    return segment;
+}
+
+
+// Interpolate the orbit at the Chebyshev nodes of the segment starting at t0,
+// which makes the polynomial very close to the best approximation of its
+// degree.
+void ChebyshevOrbit::fit(double t0, Segment& segment) const
+{
+    constexpr int N = Degree + 1;
+
+    std::array<Vector3d, N> samples;
+    for (int k = 0; k < N; k++)
+    {
+        double x = std::cos(celestia::numbers::pi * (k + 0.5) / N);
+        samples[k] = orbit->positionAtTime(t0 + (x + 1.0) * 0.5 * segmentLength);
+    }
+
+    for (int j = 0; j < N; j++)
+    {
+        Vector3d sum = Vector3d::Zero();
+        for (int k = 0; k < N; k++)
+            sum += samples[k] * std::cos(celestia::numbers::pi * j * (k + 0.5) / N);
+        segment.position[j] = sum * (2.0 / N);
+    }
+
+    differentiateSeries(segment.position.data(), Degree, segment.velocity.data());
+}
+
+
+ChebyshevTrajectory::ChebyshevTrajectory(int _degree,
+                                         std::vector<double>&& _starts,
+                                         std::vector<Vector3d>&& _coefficients) :
+    degree(_degree),
+    starts(std::move(_starts)),
+    coefficients(std::move(_coefficients))
+{
+    assert(starts.size() >= 2);
+    assert(coefficients.size() == (starts.size() - 1) * (2 * degree + 1));
+
+    // The sum of the magnitudes of the terms bounds the position in a
+    // segment, since |T_i(x)| <= 1
+    std::size_t stride = 2 * degree + 1;
+    for (std::size_t i = 0; i + 1 < starts.size(); i++)
+    {
+        const Vector3d* c = &coefficients[i * stride];
+        double bound = 0.5 * c[0].norm();
+        for (int j = 1; j <= degree; j++)
+            bound += c[j].norm();
+        boundingRadius = std::max(boundingRadius, bound);
+    }
+}
+
+
+// Find the segment containing jd, clamped to the valid range, and the
+// position of jd in it, from -1 to 1
+std::size_t ChebyshevTrajectory::findSegment(double jd, double& x) const
+{
+    std::size_t nSegments = starts.size() - 1;
+    jd = std::clamp(jd, starts.front(), starts.back());
+
+    // Consecutive positions are usually in the same segment
+    std::size_t i = lastSegment.load(std::memory_order_relaxed);
+    if (!(jd >= starts[i] && jd <= starts[i + 1]))
+    {
+        auto iter = std::upper_bound(starts.begin(), starts.end() - 1, jd);
+        i = std::min(static_cast<std::size_t>(iter - starts.begin()), nSegments) - 1;
+        lastSegment.store(i, std::memory_order_relaxed);
+    }
+
+    x = 2.0 * (jd - starts[i]) / (starts[i + 1] - starts[i]) - 1.0;
+    return i;
+}
+
+
+Vector3d ChebyshevTrajectory::computePosition(double jd) const
+{
+    double x;
+    std::size_t i = findSegment(jd, x);
+    Vector3d pos = evaluateSeries(&coefficients[i * (2 * degree + 1)], degree + 1, x);
+
+    // Add correction for Celestia's coordinate system
+    return Vector3d(pos.x(), pos.z(), -pos.y());
+}
+
+
+Vector3d ChebyshevTrajectory::computeVelocity(double jd) const
+{
+    if (degree == 0)
+        return Vector3d::Zero();
+
+    double x;
+    std::size_t i = findSegment(jd, x);
+    Vector3d vel = evaluateSeries(&coefficients[i * (2 * degree + 1) + degree + 1], degree, x);
+    vel *= 2.0 / (starts[i + 1] - starts[i]);
+
+    return Vector3d(vel.x(), vel.z(), -vel.y());
+}
+
+
+double ChebyshevTrajectory::getPeriod() const
+{
+    return starts.back() - starts.front();
+}
+
+
+double ChebyshevTrajectory::getBoundingRadius() const
+{
+    return boundingRadius;
+}
+
+
+bool ChebyshevTrajectory::isPeriodic() const
+{
+    return false;
+}
+
+
+void ChebyshevTrajectory::getValidRange(double& begin, double& end) const
+{
+    begin = starts.front();
+    end = starts.back();
+}
+
+
+/*! Load a binary trajectory of Chebyshev series; see XYZCBinaryHeader for
+ *  the layout of the file.
+ */
+Orbit* LoadXYZCBinary(const fs::path& filename)
+{
+    celestia::util::MemoryMappedFile file;
+    if (!file.open(filename, celestia::util::MemoryMappedFile::AccessHint::Sequential))
+    {
+        GetLogger()->error(_("Error opening {}.\n"), filename);
+        return nullptr;
+    }
+
+    XYZCBinaryHeader header;
+    if (file.size() < sizeof(header))
+    {
+        GetLogger()->error(_("Error reading header of {}.\n"), filename);
+        return nullptr;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    if (std::string(header.magic, strnlen(header.magic, sizeof(header.magic))) != "CELXYZC")
+    {
+        GetLogger()->error(_("Bad binary xyzc file {}.\n"), filename);
+        return nullptr;
+    }
+
+    if (header.byteOrder != __BYTE_ORDER__)
+    {
+        GetLogger()->error(_("Unsupported byte order {}, expected {}.\n"),
+                           header.byteOrder, __BYTE_ORDER__);
+        return nullptr;
+    }
+
+    if (header.digits != std::numeric_limits<double>::digits)
+    {
+        GetLogger()->error(_("Unsupported digits number {}, expected {}.\n"),
+                           header.digits, std::numeric_limits<double>::digits);
+        return nullptr;
+    }
+
+    constexpr std::uint32_t MaxDegree = 64;
+    std::size_t segmentSize = (2 + 3 * (std::size_t) (header.degree + 1)) * sizeof(double);
+    if (header.count == 0
+        || header.degree > MaxDegree
+        || (file.size() - sizeof(header)) / segmentSize < header.count)
+    {
+        GetLogger()->error(_("Bad binary xyzc file {}.\n"), filename);
+        return nullptr;
+    }
+
+    auto degree = (int) header.degree;
+    auto nSegments = (std::size_t) header.count;
+    std::vector<double> starts;
+    starts.reserve(nSegments + 1);
+    std::vector<Vector3d> coefficients(nSegments * (2 * degree + 1));
+
+    const char* ptr = file.data() + sizeof(header);
+    for (std::size_t i = 0; i < nSegments; i++, ptr += segmentSize)
+    {
+        double segment[2];
+        std::memcpy(segment, ptr, sizeof(segment));
+        if (!(segment[1] > segment[0]) || (i > 0 && segment[0] != starts.back()))
+        {
+            GetLogger()->error(_("Segments of {} aren't contiguous.\n"), filename);
+            return nullptr;
+        }
+        if (i == 0)
+            starts.push_back(segment[0]);
+        starts.push_back(segment[1]);
+
+        Vector3d* c = &coefficients[i * (2 * degree + 1)];
+        const char* axes = ptr + sizeof(segment);
+        for (int j = 0; j <= degree; j++)
+        {
+            for (int k = 0; k < 3; k++)
+                std::memcpy(&c[j][k], axes + ((std::size_t) k * (degree + 1) + j) * sizeof(double), sizeof(double));
+        }
+
+        // The file has the whole first coefficient, evaluateSeries() expects
+        // half of it
+        c[0] *= 2.0;
+        differentiateSeries(c, degree, c + degree + 1);
+    }
+
+    return new ChebyshevTrajectory(degree, std::move(starts), std::move(coefficients));
+}
@@ -0,0 +1,98 @@
+// chebyshevorbit.h
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <Eigen/Core>
+#include <celcompat/filesystem.h>
+#include "orbit.h"
+
+
+/*! A Chebyshev orbit approximates an expensive orbit, such as one of the
+ *  analytic theories of the custom orbits, with piecewise Chebyshev
+ *  polynomials. The time line is divided into segments of equal length and
+ *  the polynomials for a segment are fitted the first time a position in
+ *  it is requested; after that positions and velocities in the segment
+ *  cost only a polynomial evaluation.
+ *
+ *  The segment length has to be short enough for the polynomials to
+ *  follow the fastest periodic terms of the approximated orbit.
+ */
+class ChebyshevOrbit : public Orbit
+{
+ public:
+    static constexpr int Degree = 12;
+
+    ChebyshevOrbit(Orbit* orbit, double segmentLength);
+    ~ChebyshevOrbit() override = default;
+
+    Eigen::Vector3d positionAtTime(double jd) const override;
+    Eigen::Vector3d velocityAtTime(double jd) const override;
+    double getPeriod() const override;
+    double getBoundingRadius() const override;
+    bool isPeriodic() const override;
+    void getValidRange(double& begin, double& end) const override;
+
+ private:
+    struct Segment
+    {
+        std::array<Eigen::Vector3d, Degree + 1> position;
+        std::array<Eigen::Vector3d, Degree> velocity;
+    };
+
+    const Segment& segmentAtTime(double jd, double& x) const;
+    void fit(double t0, Segment& segment) const;
+
+    std::unique_ptr<Orbit> orbit;
+    double segmentLength;
+    mutable std::unordered_map<std::int64_t, Segment> segments;
+};
+
+
+/*! A trajectory stored as the Chebyshev series of its segments, as written
+ *  by xyzv2xyzc. Finding the segment of a time is a binary search over the
+ *  segment starts, and the position and velocity are each a polynomial
+ *  evaluation. It's much smaller than the samples that it was fitted to,
+ *  though evaluating it costs a little more than interpolating them.
+ */
+class ChebyshevTrajectory : public CachingOrbit
+{
+ public:
+    ChebyshevTrajectory(int degree,
+                        std::vector<double>&& starts,
+                        std::vector<Eigen::Vector3d>&& coefficients);
+    ~ChebyshevTrajectory() override = default;
+
+    Eigen::Vector3d computePosition(double jd) const override;
+    Eigen::Vector3d computeVelocity(double jd) const override;
+    double getPeriod() const override;
+    double getBoundingRadius() const override;
+    bool isPeriodic() const override;
+    void getValidRange(double& begin, double& end) const override;
+
+ private:
+    std::size_t findSegment(double jd, double& x) const;
+
+    int degree;
+    //! Start times of the segments followed by the end of the last one
+    std::vector<double> starts;
+    //! Series of the position, then of the velocity, of each segment
+    std::vector<Eigen::Vector3d> coefficients;
+    double boundingRadius{ 0.0 };
+    mutable std::atomic<std::size_t> lastSegment{ 0 };
+};
+
+
+extern Orbit* LoadXYZCBinary(const fs::path& filename);
@@ -8,6 +8,7 @@
 // of the License, or (at your option) any later version.
 
 #include "customorbit.h"
+#include "chebyshevorbit.h"
 #include "vsop87.h"
 #include "jpleph.h"
 #include <celcompat/numbers.h>
@@ -17,7 +18,6 @@
 #include <celutil/logger.h>
 #include <cassert>
 #include <vector>
-#include <fstream>
 
 using namespace Eigen;
 using namespace std;
@@ -3081,6 +3081,12 @@ class JPLEphOrbit : public CachingOrbit
         return boundingRadius;
     }
 
+    // The ephemeris caches the coefficients of the last record it read
+    bool isThreadSafe() const override
+    {
+        return false;
+    }
+
     Vector3d computePosition(double tjd) const override
     {
         // Get the position relative to the Earth (for the Moon) or
@@ -3143,6 +3149,14 @@ static Orbit* CreateJPLEphOrbit(JPLEphemItem target,
 }
 
 
+// Approximate an expensive analytic theory with Chebyshev polynomials fitted
+// over segments of a fraction of the orbital period.
+static Orbit* CreateChebyshevOrbit(Orbit* orbit, double segmentsPerPeriod)
+{
+    return new ChebyshevOrbit(orbit, orbit->getPeriod() / segmentsPerPeriod);
+}
+
+
 static double yearToJD(int year)
 {
     return (double) astro::Date(year, 1, 1);
@@ -3155,9 +3169,7 @@ Orbit* GetCustomOrbit(const string& name)
     if (!jplephInitialized)
     {
         jplephInitialized = true;
-        ifstream in("data/jpleph.dat", ios::in | ios::binary);
-        if (in.good())
-            jpleph = JPLEphemeris::load(in);
+        jpleph = JPLEphemeris::load("data/jpleph.dat");
         if (jpleph != nullptr)
         {
             string ephemType;
@@ -3180,7 +3192,7 @@ Orbit* GetCustomOrbit(const string& name)
     if (name == "earth")
         return new MixedOrbit(new EarthOrbit(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     if (name == "moon")
-        return new MixedOrbit(new LunarOrbit(), yearToJD(-2000), yearToJD(4000), astro::EarthMass + astro::LunarMass);
+        return new MixedOrbit(CreateChebyshevOrbit(new LunarOrbit(), 16.0), yearToJD(-2000), yearToJD(4000), astro::EarthMass + astro::LunarMass);
     if (name == "mars")
         return new MixedOrbit(new MarsOrbit(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     if (name == "jupiter")
@@ -3192,7 +3204,7 @@ Orbit* GetCustomOrbit(const string& name)
     if (name == "neptune")
         return new MixedOrbit(new NeptuneOrbit(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
     if (name == "pluto")
-        return new MixedOrbit(new PlutoOrbit(), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
+        return new MixedOrbit(CreateChebyshevOrbit(new PlutoOrbit(), 64.0), yearToJD(-4000), yearToJD(4000), astro::SolarMass);
 
     // Two styles of custom orbit name are permitted for JPL ephemeris orbits.
     // The preferred is <ephemeris>-<object>, e.g. jpl-mercury. But the reverse
@@ -3264,31 +3276,31 @@ Orbit* GetCustomOrbit(const string& name)
     if (name == "deimos")
         return new DeimosOrbit();
     if (name == "io")
-        return new IoOrbit();
+        return CreateChebyshevOrbit(new IoOrbit(), 16.0);
     if (name == "europa")
-        return new EuropaOrbit();
+        return CreateChebyshevOrbit(new EuropaOrbit(), 16.0);
     if (name == "ganymede")
-        return new GanymedeOrbit();
+        return CreateChebyshevOrbit(new GanymedeOrbit(), 16.0);
     if (name == "callisto")
-        return new CallistoOrbit();
+        return CreateChebyshevOrbit(new CallistoOrbit(), 16.0);
     if (name == "mimas")
-        return new MimasOrbit();
+        return CreateChebyshevOrbit(new MimasOrbit(), 16.0);
     if (name == "enceladus")
-        return new EnceladusOrbit();
+        return CreateChebyshevOrbit(new EnceladusOrbit(), 16.0);
     if (name == "tethys")
-        return new TethysOrbit();
+        return CreateChebyshevOrbit(new TethysOrbit(), 16.0);
     if (name == "dione")
-        return new DioneOrbit();
+        return CreateChebyshevOrbit(new DioneOrbit(), 16.0);
     if (name == "rhea")
-        return new RheaOrbit();
+        return CreateChebyshevOrbit(new RheaOrbit(), 16.0);
     if (name == "titan")
-        return new TitanOrbit();
+        return CreateChebyshevOrbit(new TitanOrbit(), 16.0);
     if (name == "hyperion")
-        return new HyperionOrbit();
+        return CreateChebyshevOrbit(new HyperionOrbit(), 16.0);
     if (name == "iapetus")
-        return new IapetusOrbit();
+        return CreateChebyshevOrbit(new IapetusOrbit(), 16.0);
     if (name == "phoebe")
-        return new PhoebeOrbit();
+        return CreateChebyshevOrbit(new PhoebeOrbit(), 16.0);
     if (name == "miranda")
         return CreateUranianSatelliteOrbit(1);
     if (name == "ariel")
@@ -11,6 +11,7 @@
 // of the License, or (at your option) any later version.
 
 #include "customrotation.h"
+#include "interpolatedrotation.h"
 #include "rotation.h"
 #include "precession.h"
 #include <celcompat/numbers.h>
@@ -41,6 +42,19 @@ static const double IAU_SECULAR_TERM_VALID_CENTURIES = 50.0;
 // that range, the polynomial terms produce absurd results.
 static const double P03LP_VALID_CENTURIES = 5000.0;
 
+// Largest error of the interpolated rotation models, in radians; about a
+// meter at the surface of the Earth
+static const double INTERPOLATION_TOLERANCE = 1.0e-7;
+
+
+// Interpolate a rotation model with periodic terms, which cost many
+// trigonometric functions per orientation. The IAU models with only linear
+// terms are cheaper to evaluate directly.
+static RotationModel* CreateInterpolatedRotationModel(RotationModel* model)
+{
+    return new InterpolatedRotationModel(model, INTERPOLATION_TOLERANCE);
+}
+
 /*! Base class for IAU rotation models. All IAU rotation models are in the
  *  J2000.0 Earth equatorial frame.
  */
@@ -932,7 +946,7 @@ GetCustomRotationModel(const std::string& name)
     {
         CustomRotationModelsInitialized = true;
 
-        CustomRotationModels["earth-p03lp"] = new EarthRotationModel();
+        CustomRotationModels["earth-p03lp"] = CreateInterpolatedRotationModel(new EarthRotationModel());
 
         // IAU rotation elements for the planets
         CustomRotationModels["iau-mercury"] = new IAUPrecessingRotationModel(281.01, -0.033,
@@ -956,17 +970,17 @@ GetCustomRotationModel(const std::string& name)
         CustomRotationModels["iau-uranus"]  = new IAUPrecessingRotationModel(257.311, 0.0,
                                                                              -15.175, 0.0,
                                                                              203.81, -501.1600928);
-        CustomRotationModels["iau-neptune"] = new IAUNeptuneRotationModel();
+        CustomRotationModels["iau-neptune"] = CreateInterpolatedRotationModel(new IAUNeptuneRotationModel());
         CustomRotationModels["iau-pluto"]   = new IAUPrecessingRotationModel(313.02, 0.0,
                                                                              9.09, 0.0,
                                                                              236.77, -56.3623195);
 
         // IAU elements for satellite of Earth
-        CustomRotationModels["iau-moon"] = new IAULunarRotationModel();
+        CustomRotationModels["iau-moon"] = CreateInterpolatedRotationModel(new IAULunarRotationModel());
 
         // IAU elements for satellites of Mars
-        CustomRotationModels["iau-phobos"] = new IAUPhobosRotationModel();
-        CustomRotationModels["iau-deimos"] = new IAUDeimosRotationModel();
+        CustomRotationModels["iau-phobos"] = CreateInterpolatedRotationModel(new IAUPhobosRotationModel());
+        CustomRotationModels["iau-deimos"] = CreateInterpolatedRotationModel(new IAUDeimosRotationModel());
 
         // IAU elements for satellites of Jupiter
         CustomRotationModels["iau-metis"]    = new IAUPrecessingRotationModel(268.05, -0.009,
@@ -975,12 +989,12 @@ GetCustomRotationModel(const std::string& name)
         CustomRotationModels["iau-adrastea"] = new IAUPrecessingRotationModel(268.05, -0.009,
                                                                               64.49, 0.003,
                                                                               33.29, 1206.9986602);
-        CustomRotationModels["iau-amalthea"] = new IAUAmaltheaRotationModel();
-        CustomRotationModels["iau-thebe"]    = new IAUThebeRotationModel();
-        CustomRotationModels["iau-io"]       = new IAUIoRotationModel();
-        CustomRotationModels["iau-europa"]   = new IAUEuropaRotationModel();
-        CustomRotationModels["iau-ganymede"] = new IAUGanymedeRotationModel();
-        CustomRotationModels["iau-callisto"] = new IAUCallistoRotationModel();
+        CustomRotationModels["iau-amalthea"] = CreateInterpolatedRotationModel(new IAUAmaltheaRotationModel());
+        CustomRotationModels["iau-thebe"]    = CreateInterpolatedRotationModel(new IAUThebeRotationModel());
+        CustomRotationModels["iau-io"]       = CreateInterpolatedRotationModel(new IAUIoRotationModel());
+        CustomRotationModels["iau-europa"]   = CreateInterpolatedRotationModel(new IAUEuropaRotationModel());
+        CustomRotationModels["iau-ganymede"] = CreateInterpolatedRotationModel(new IAUGanymedeRotationModel());
+        CustomRotationModels["iau-callisto"] = CreateInterpolatedRotationModel(new IAUCallistoRotationModel());
 
         // IAU elements for satellites of Saturn
         CustomRotationModels["iau-pan"]        = new IAUPrecessingRotationModel(40.6, -0.036,
@@ -995,23 +1009,23 @@ GetCustomRotationModel(const std::string& name)
         CustomRotationModels["iau-pandora"]    = new IAUPrecessingRotationModel(40.6, -0.036,
                                                                                 83.5, -0.004,
                                                                                 162.92, 572.7891000);
-        CustomRotationModels["iau-mimas"]     = new IAUMimasRotationModel();
+        CustomRotationModels["iau-mimas"]     = CreateInterpolatedRotationModel(new IAUMimasRotationModel());
         CustomRotationModels["iau-enceladus"] = new IAUEnceladusRotationModel();
-        CustomRotationModels["iau-tethys"]    = new IAUTethysRotationModel();
+        CustomRotationModels["iau-tethys"]    = CreateInterpolatedRotationModel(new IAUTethysRotationModel());
         CustomRotationModels["iau-telesto"]   = new IAUTelestoRotationModel();
-        CustomRotationModels["iau-calypso"]   = new IAUCalypsoRotationModel();
+        CustomRotationModels["iau-calypso"]   = CreateInterpolatedRotationModel(new IAUCalypsoRotationModel());
         CustomRotationModels["iau-dione"]     = new IAUDioneRotationModel();
-        CustomRotationModels["iau-helene"]    = new IAUHeleneRotationModel();
-        CustomRotationModels["iau-rhea"]      = new IAURheaRotationModel();
-        CustomRotationModels["iau-titan"]     = new IAUTitanRotationModel();
+        CustomRotationModels["iau-helene"]    = CreateInterpolatedRotationModel(new IAUHeleneRotationModel());
+        CustomRotationModels["iau-rhea"]      = CreateInterpolatedRotationModel(new IAURheaRotationModel());
+        CustomRotationModels["iau-titan"]     = CreateInterpolatedRotationModel(new IAUTitanRotationModel());
         CustomRotationModels["iau-iapetus"]   = new IAUIapetusRotationModel();
         CustomRotationModels["iau-phoebe"]    = new IAUPhoebeRotationModel();
 
-        CustomRotationModels["iau-miranda"]   = new IAUMirandaRotationModel();
-        CustomRotationModels["iau-ariel"]     = new IAUArielRotationModel();
-        CustomRotationModels["iau-umbriel"]   = new IAUUmbrielRotationModel();
-        CustomRotationModels["iau-titania"]   = new IAUTitaniaRotationModel();
-        CustomRotationModels["iau-oberon"]    = new IAUOberonRotationModel();
+        CustomRotationModels["iau-miranda"]   = CreateInterpolatedRotationModel(new IAUMirandaRotationModel());
+        CustomRotationModels["iau-ariel"]     = CreateInterpolatedRotationModel(new IAUArielRotationModel());
+        CustomRotationModels["iau-umbriel"]   = CreateInterpolatedRotationModel(new IAUUmbrielRotationModel());
+        CustomRotationModels["iau-titania"]   = CreateInterpolatedRotationModel(new IAUTitaniaRotationModel());
+        CustomRotationModels["iau-oberon"]    = CreateInterpolatedRotationModel(new IAUOberonRotationModel());
     }
 
     if (CustomRotationModels.count(name) > 0)
@@ -0,0 +1,207 @@
+// interpolatedrotation.cpp
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "interpolatedrotation.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <celengine/astro.h>
+
+using namespace Eigen;
+
+
+namespace
+{
+
+// When a grid has more intervals than this, the cache is emptied so that
+// it doesn't grow without limit.
+constexpr std::size_t MaxCachedIntervals = 4096;
+
+// The step is halved at most this many times while looking for one that
+// meets the tolerance
+constexpr int MaxStepHalvings = 30;
+
+// Longest step tried for the equator, which for most bodies moves by a
+// small angle over a decade
+constexpr double EquatorInitialStep = 4096.0;
+
+// The step is tested on this many intervals spread over two centuries
+// around J2000, at these fractions of each
+constexpr int TestIntervals = 32;
+constexpr double TestPoints[] = { 0.25, 0.5, 0.75 };
+constexpr double TestSpan = 2.0 * 36525.0;
+
+} // end unnamed namespace
+
+
+Quaterniond
+InterpolatedRotationModel::Arc::at(double s) const
+{
+    double halfAngle = 0.5 * s * angle;
+    Vector3d v = axis * std::sin(halfAngle);
+    return start * Quaterniond(std::cos(halfAngle), v.x(), v.y(), v.z());
+}
+
+
+InterpolatedRotationModel::InterpolatedRotationModel(RotationModel* _model, double tolerance) :
+    model(_model)
+{
+    assert(_model != nullptr);
+    assert(tolerance > 0.0);
+
+    // An eighth of a turn keeps the rotation between samples far from the
+    // half turn where the direction becomes ambiguous
+    grids[Spin].step = findStep(Spin, model->isPeriodic() ? model->getPeriod() / 8.0 : 1.0, tolerance);
+    grids[Equator].step = findStep(Equator, EquatorInitialStep, tolerance);
+}
+
+
+Quaterniond
+InterpolatedRotationModel::spin(double tjd) const
+{
+    double s;
+    return arcAtTime(Spin, tjd, s).at(s);
+}
+
+
+Quaterniond
+InterpolatedRotationModel::equatorOrientationAtTime(double tjd) const
+{
+    double s;
+    return arcAtTime(Equator, tjd, s).at(s);
+}
+
+
+void
+InterpolatedRotationModel::spinsAtTimes(celestia::util::array_view<double> tjds, Quaterniond* spins) const
+{
+    for (double tjd : tjds)
+    {
+        double s;
+        *spins++ = arcAtTime(Spin, tjd, s).at(s);
+    }
+}
+
+
+void
+InterpolatedRotationModel::orientationsAtTimes(celestia::util::array_view<double> tjds,
+                                               Quaterniond* orientations) const
+{
+    for (double tjd : tjds)
+    {
+        double s;
+        Quaterniond spin = arcAtTime(Spin, tjd, s).at(s);
+        *orientations++ = spin * arcAtTime(Equator, tjd, s).at(s);
+    }
+}
+
+
+double
+InterpolatedRotationModel::getPeriod() const
+{
+    return model->getPeriod();
+}
+
+
+bool
+InterpolatedRotationModel::isPeriodic() const
+{
+    return model->isPeriodic();
+}
+
+
+void
+InterpolatedRotationModel::getValidRange(double& begin, double& end) const
+{
+    model->getValidRange(begin, end);
+}
+
+
+const InterpolatedRotationModel::Arc&
+InterpolatedRotationModel::arcAtTime(Part part, double tjd, double& s) const
+{
+    Grid& grid = grids[part];
+    double n = std::floor(tjd / grid.step);
+    s = tjd / grid.step - n;
+
+    auto index = static_cast<std::int64_t>(n);
+    if (grid.lastArc != nullptr && index == grid.lastIndex)
+        return *grid.lastArc;
+
+    auto iter = grid.arcs.find(index);
+    if (iter == grid.arcs.end())
+    {
+        if (grid.arcs.size() >= MaxCachedIntervals)
+            grid.arcs.clear();
+        iter = grid.arcs.emplace(index, sampleArc(part, n * grid.step, (n + 1.0) * grid.step)).first;
+    }
+
+    grid.lastIndex = index;
+    grid.lastArc = &iter->second;
+    return iter->second;
+}
+
+
+Quaterniond
+InterpolatedRotationModel::sample(Part part, double tjd) const
+{
+    return part == Spin ? model->spin(tjd) : model->equatorOrientationAtTime(tjd);
+}
+
+
+InterpolatedRotationModel::Arc
+InterpolatedRotationModel::sampleArc(Part part, double t0, double t1) const
+{
+    Arc arc;
+    arc.start = sample(part, t0);
+
+    // Take the shorter way from the first sample to the second
+    Quaterniond delta = arc.start.conjugate() * sample(part, t1);
+    if (delta.w() < 0.0)
+        delta.coeffs() = -delta.coeffs();
+
+    double sinHalfAngle = delta.vec().norm();
+    arc.angle = 2.0 * std::atan2(sinHalfAngle, delta.w());
+    arc.axis = sinHalfAngle > 0.0 ? Vector3d(delta.vec() / sinHalfAngle) : Vector3d::UnitY();
+    return arc;
+}
+
+
+// Return the largest angle between the interpolated and the exact
+// orientations at the test times, when the samples are testStep apart
+double
+InterpolatedRotationModel::maxError(Part part, double testStep) const
+{
+    // The fractional part of multiples of the golden ratio spreads the
+    // intervals evenly without lining them up with any period
+    constexpr double Golden = 0.6180339887498949;
+
+    double error = 0.0;
+    for (int i = 0; i < TestIntervals; i++)
+    {
+        double fraction = std::fmod(i * Golden, 1.0);
+        double t0 = astro::J2000 + (fraction - 0.5) * TestSpan;
+        Arc arc = sampleArc(part, t0, t0 + testStep);
+        for (double s : TestPoints)
+            error = std::max(error, arc.at(s).angularDistance(sample(part, t0 + s * testStep)));
+    }
+
+    return error;
+}
+
+
+// Halve the step until the interpolation meets the tolerance
+double
+InterpolatedRotationModel::findStep(Part part, double initialStep, double tolerance) const
+{
+    double step = initialStep;
+    for (int i = 0; i < MaxStepHalvings && maxError(part, step) > tolerance; i++)
+        step *= 0.5;
+    return step;
+}
@@ -0,0 +1,90 @@
+// interpolatedrotation.h
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <Eigen/Geometry>
+#include "rotation.h"
+
+
+/*! An interpolated rotation model approximates an expensive rotation model,
+ *  such as one of the IAU models with many periodic terms, by sampling its
+ *  spin and equator orientation on grids of times and rotating uniformly
+ *  between the samples. The samples of an interval of a grid are taken the
+ *  first time an orientation in it is requested.
+ *
+ *  The spin and the equator have grids of their own, as the equator, such
+ *  as the precessing equator of date of the Earth, usually moves much more
+ *  slowly than the body spins. The step of each grid is chosen when the
+ *  model is created, as the longest one for which the interpolated
+ *  orientations stay within the angular tolerance at a set of test times.
+ *  Uniform rotations about a fixed axis, like the spin of the IAU models
+ *  without periodic terms in the meridian, are reproduced exactly at any
+ *  step.
+ */
+class InterpolatedRotationModel : public RotationModel
+{
+ public:
+    // Tolerance in radians
+    InterpolatedRotationModel(RotationModel* model, double tolerance);
+    ~InterpolatedRotationModel() override = default;
+
+    Eigen::Quaterniond spin(double tjd) const override;
+    Eigen::Quaterniond equatorOrientationAtTime(double tjd) const override;
+    void spinsAtTimes(celestia::util::array_view<double> tjds,
+                      Eigen::Quaterniond* spins) const override;
+    void orientationsAtTimes(celestia::util::array_view<double> tjds,
+                             Eigen::Quaterniond* orientations) const override;
+    double getPeriod() const override;
+    bool isPeriodic() const override;
+    void getValidRange(double& begin, double& end) const override;
+
+    double getSpinStep() const { return grids[Spin].step; }
+    double getEquatorStep() const { return grids[Equator].step; }
+
+ private:
+    enum Part
+    {
+        Spin    = 0,
+        Equator = 1,
+    };
+
+    // A uniform rotation from start to start * delta, with delta as an
+    // axis and an angle
+    struct Arc
+    {
+        Eigen::Quaterniond start;
+        Eigen::Vector3d axis;
+        double angle;
+
+        Eigen::Quaterniond at(double s) const;
+    };
+
+    // The arcs of the intervals of a grid sampled so far
+    struct Grid
+    {
+        double step{ 1.0 };
+        std::unordered_map<std::int64_t, Arc> arcs;
+        // Consecutive times are usually in the same interval
+        std::int64_t lastIndex{ 0 };
+        const Arc* lastArc{ nullptr };
+    };
+
+    Eigen::Quaterniond sample(Part part, double tjd) const;
+    Arc sampleArc(Part part, double t0, double t1) const;
+    const Arc& arcAtTime(Part part, double tjd, double& s) const;
+    double maxError(Part part, double testStep) const;
+    double findStep(Part part, double initialStep, double tolerance) const;
+
+    std::unique_ptr<RotationModel> model;
+    mutable Grid grids[2];
+};
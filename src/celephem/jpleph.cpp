@@ -10,49 +10,44 @@
 // Load JPL's DE200, DE405, and DE406 ephemerides and compute planet
 // positions.
 
-#include <fstream>
-#include <iomanip>
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstring>
 #include <celutil/bytes.h>
 #include "jpleph.h"
 
 using namespace Eigen;
 using namespace std;
 
+namespace celutil = celestia::util;
+
 constexpr const unsigned int NConstants         =  400;
 constexpr const unsigned int ConstantNameLength =  6;
 
-constexpr const unsigned int MaxChebyshevCoeffs = 32;
-
 constexpr const unsigned int LabelSize = 84;
 
 constexpr const unsigned int INPOP_DE_COMPATIBLE = 100;
 constexpr const unsigned int DE200 = 200;
 
 // Read a big-endian or little endian 32-bit unsigned integer
-static uint32_t readUint(istream& in, bool swap)
+static uint32_t readUint(const char* p, bool swap)
 {
     uint32_t ret;
-    in.read((char*) &ret, sizeof(uint32_t));
+    memcpy(&ret, p, sizeof(uint32_t));
     return swap ? bswap_32(ret) : ret;
 }
 
 // Read a big-endian or little endian 64-bit IEEE double.
 // If the native double format isn't IEEE 754, there will be troubles.
-static double readDouble(istream& in, bool swap)
+static double readDouble(const char* p, bool swap)
 {
     double d;
-    in.read((char*) &d, sizeof(double));
+    memcpy(&d, p, sizeof(double));
     return swap ? bswap_double(d) : d;
 }
 
 
-JPLEphRecord::~JPLEphRecord()
-{
-    delete coeffs;
-}
-
-
 unsigned int JPLEphemeris::getDENumber() const
 {
     return DENum;
@@ -111,39 +106,50 @@ Vector3d JPLEphemeris::getPlanetPosition(JPLEphemItem planet, double tjd) const
     // recNo is always >= 0:
     auto recNo = (unsigned int) ((tjd - startDate) / daysPerInterval);
     // Make sure we don't go past the end of the array if t == endDate
-    if (recNo >= records.size())
-        recNo = records.size() - 1;
-    const JPLEphRecord* rec = &records[recNo];
+    if (recNo >= nRecords)
+        recNo = nRecords - 1;
+    const char* rec = recordData(recNo);
+    double recStartDate = readDouble(rec, swapBytes);
 
     assert(coeffInfo[planet].nGranules >= 1);
     assert(coeffInfo[planet].nGranules <= 32);
     assert(coeffInfo[planet].nCoeffs <= MaxChebyshevCoeffs);
 
     // u is the normalized time (in [-1, 1]) for interpolating
-    // coeffs is a pointer to the Chebyshev coefficients
     double u = 0.0;
-    double* coeffs = nullptr;
+    unsigned int granule = 0;
 
     // nGranules is unsigned int so it will be compared against FFFFFFFF:
     if (coeffInfo[planet].nGranules == (unsigned int) -1)
     {
-        coeffs = rec->coeffs + coeffInfo[planet].offset;
-        u = 2.0 * (tjd - rec->t0) / daysPerInterval - 1.0;
+        u = 2.0 * (tjd - recStartDate) / daysPerInterval - 1.0;
     }
     else
     {
         double daysPerGranule = daysPerInterval / coeffInfo[planet].nGranules;
-        auto granule = (int) ((tjd - rec->t0) / daysPerGranule);
-        double granuleStartDate = rec->t0 + daysPerGranule * (double) granule;
-        coeffs = rec->coeffs + coeffInfo[planet].offset +
-                 granule * coeffInfo[planet].nCoeffs * 3;
+        granule = std::min((unsigned int) std::max((tjd - recStartDate) / daysPerGranule, 0.0),
+                           coeffInfo[planet].nGranules - 1);
+        double granuleStartDate = recStartDate + daysPerGranule * (double) granule;
         u = 2.0 * (tjd - granuleStartDate) / daysPerGranule - 1.0;
     }
 
+    // Decode the coefficients of the granule unless they're the ones used
+    // last time for this item
+    unsigned int nCoeffs = coeffInfo[planet].nCoeffs;
+    CoeffCache& cache = coeffCache[planet];
+    if (cache.record != recNo || cache.granule != granule)
+    {
+        const char* src = rec + (coeffInfo[planet].offset + granule * nCoeffs * 3) * sizeof(double);
+        for (unsigned int i = 0; i < nCoeffs * 3; i++)
+            cache.coeffs[i] = readDouble(src + i * sizeof(double), swapBytes);
+        cache.record = recNo;
+        cache.granule = granule;
+    }
+    const double* coeffs = cache.coeffs.data();
+
     // Evaluate the Chebyshev polynomials
     double sum[3];
     double cc[MaxChebyshevCoeffs];
-    unsigned int nCoeffs = coeffInfo[planet].nCoeffs;
     for (int i = 0; i < 3; i++)
     {
         cc[0] = 1.0;
@@ -159,6 +165,12 @@ Vector3d JPLEphemeris::getPlanetPosition(JPLEphemItem planet, double tjd) const
     return Vector3d(sum[0], sum[1], sum[2]);
 }
 
+
+const char* JPLEphemeris::recordData(unsigned int recNo) const
+{
+    return file.data() + firstRecordOffset + (std::size_t) recNo * recordSize * sizeof(double);
+}
+
 #pragma pack(push, 1)
 struct JPLECoeff
 {
@@ -199,12 +211,17 @@ struct JPLEFileHeader
 #define MAYBE_SWAP_DOUBLE(d) (swapBytes ? bswap_double(d) : (d))
 #define MAYBE_SWAP_UINT32(u) (swapBytes ? bswap_32(u) : (u))
 
-JPLEphemeris* JPLEphemeris::load(istream& in)
+JPLEphemeris* JPLEphemeris::load(const fs::path& path, double begin, double end)
 {
-    JPLEFileHeader fh;
-    in.read((char*) &fh, sizeof(fh));
-    if (!in.good())
+    celutil::MemoryMappedFile file;
+    if (!file.open(path, celutil::MemoryMappedFile::AccessHint::Random) ||
+        file.size() < sizeof(JPLEFileHeader))
+    {
         return nullptr;
+    }
+
+    JPLEFileHeader fh;
+    memcpy(&fh, file.data(), sizeof(fh));
 
     uint32_t deNum = fh.deNum;
     uint32_t deNum2 = bswap_32(deNum);
@@ -250,11 +267,12 @@ JPLEphemeris* JPLEphemeris::load(istream& in)
     eph->au                 = MAYBE_SWAP_DOUBLE(fh.au);
     eph->earthMoonMassRatio = MAYBE_SWAP_DOUBLE(fh.earthMoonMassRatio);
 
-    // Read the coefficient information for each item in the ephemeris
+    // Read the coefficient information for each item in the ephemeris. The
+    // offsets in the file count from 1 at the start of the record.
     eph->recordSize = 0;
     for (unsigned int i = 0; i < JPLEph_NItems; i++)
     {
-        eph->coeffInfo[i].offset        = MAYBE_SWAP_UINT32(fh.coeffInfo[i].offset) - 3;
+        eph->coeffInfo[i].offset        = MAYBE_SWAP_UINT32(fh.coeffInfo[i].offset) - 1;
         eph->coeffInfo[i].nCoeffs       = MAYBE_SWAP_UINT32(fh.coeffInfo[i].nCoeffs);
         eph->coeffInfo[i].nGranules     = MAYBE_SWAP_UINT32(fh.coeffInfo[i].nGranules);
         // last item is the nutation ephemeris (only 2 components)
@@ -271,45 +289,51 @@ JPLEphemeris* JPLEphemeris::load(istream& in)
     // if INPOP ephemeris, read record size
     if (deNum == INPOP_DE_COMPATIBLE)
     {
-       eph->recordSize = readUint(in, eph->swapBytes);
-       // Skip past the rest of the record
-       in.ignore(eph->recordSize * 8 - sizeof(JPLEFileHeader) - sizeof(uint32_t));
+        if (file.size() < sizeof(JPLEFileHeader) + sizeof(uint32_t))
+        {
+            delete eph;
+            return nullptr;
+        }
+        eph->recordSize = readUint(file.data() + sizeof(JPLEFileHeader), eph->swapBytes);
     }
-    else
+
+    // Check that the coefficients of the planets are inside the records, as
+    // they're read straight from the mapped file
+    bool valid = eph->recordSize > 2 && eph->daysPerInterval > 0.0;
+    for (unsigned int i = 0; i < JPLEph_Earth && valid; i++)
     {
-        // Skip past the rest of the record
-        in.ignore(eph->recordSize * 8 - sizeof(JPLEFileHeader));
+        const JPLEphCoeffInfo& info = eph->coeffInfo[i];
+        unsigned int nGranules = info.nGranules == (unsigned int) -1 ? 1 : info.nGranules;
+        valid = info.nCoeffs <= MaxChebyshevCoeffs &&
+                (std::size_t) info.offset + (std::size_t) info.nCoeffs * nGranules * 3 <= eph->recordSize;
     }
 
-    // The next record contains constant values (which we don't need)
-    in.ignore(eph->recordSize * 8);
-    if (!in.good())
+    // The first record is the header, and the next one contains constant
+    // values (which we don't need)
+    std::size_t recordBytes = (std::size_t) eph->recordSize * sizeof(double);
+    auto nRecords = valid
+        ? (unsigned int) ((eph->endDate - eph->startDate) / eph->daysPerInterval)
+        : 0u;
+    if (nRecords == 0 || file.size() < recordBytes * (2 + (std::size_t) nRecords))
     {
         delete eph;
         return nullptr;
     }
 
-    auto nRecords = (unsigned int) ((eph->endDate - eph->startDate) /
-                        eph->daysPerInterval);
-    eph->records.resize(nRecords);
-    for (unsigned i = 0; i < nRecords; i++)
+    unsigned int firstRecord = 0;
+    if (begin < end)
     {
-        eph->records[i].t0 = readDouble(in, eph->swapBytes);
-        eph->records[i].t1 = readDouble(in, eph->swapBytes);
-
-        // Allocate coefficient array for this record; the first two
-        // 'coefficients' are actually the start and end time (t0 and t1)
-        eph->records[i].coeffs = new double[eph->recordSize - 2];
-        for (unsigned int j = 0; j < eph->recordSize - 2; j++)
-            eph->records[i].coeffs[j] = readDouble(in, eph->swapBytes);
-
-        // Make sure that we read this record successfully
-        if (!in.good())
-        {
-            delete eph;
-            return nullptr;
-        }
+        double first = std::floor((begin - eph->startDate) / eph->daysPerInterval);
+        double last = std::ceil((end - eph->startDate) / eph->daysPerInterval);
+        firstRecord = (unsigned int) std::clamp(first, 0.0, (double) (nRecords - 1));
+        nRecords = (unsigned int) std::clamp(last, (double) (firstRecord + 1), (double) nRecords) - firstRecord;
+        eph->startDate += firstRecord * eph->daysPerInterval;
+        eph->endDate = eph->startDate + nRecords * eph->daysPerInterval;
     }
 
+    eph->firstRecordOffset = recordBytes * (2 + (std::size_t) firstRecord);
+    eph->nRecords = nRecords;
+    eph->file = std::move(file);
+
     return eph;
 }
@@ -13,9 +13,10 @@
 #ifndef _CELENGINE_JPLEPH_H_
 #define _CELENGINE_JPLEPH_H_
 
-#include <iostream>
-#include <vector>
+#include <array>
 #include <Eigen/Core>
+#include <celcompat/filesystem.h>
+#include <celutil/mmapfile.h>
 
 enum JPLEphemItem
 {
@@ -45,17 +46,6 @@ struct JPLEphCoeffInfo
 };
 
 
-struct JPLEphRecord
-{
-    JPLEphRecord() = default;
-    ~JPLEphRecord();
-
-    double t0{ 0.0 };
-    double t1{ 0.0 };
-    double* coeffs{ nullptr };
-};
-
-
 class JPLEphemeris
 {
 private:
@@ -66,7 +56,12 @@ public:
 
     Eigen::Vector3d getPlanetPosition(JPLEphemItem, double t) const;
 
-    static JPLEphemeris* load(std::istream&);
+    // Map the ephemeris file at path. Records are decoded when they're
+    // needed, so only the parts of the file that are used are read. If
+    // begin < end, the ephemeris is restricted to the records covering
+    // that span of TDB Julian dates and the rest of the file is never
+    // touched.
+    static JPLEphemeris* load(const fs::path& path, double begin = 0.0, double end = 0.0);
 
     unsigned int getDENumber() const;
     double getStartDate() const;
@@ -75,6 +70,19 @@ public:
     unsigned int getRecordSize() const;
 
 private:
+    static constexpr unsigned int MaxChebyshevCoeffs = 32;
+
+    // The Chebyshev coefficients of the granule most recently used for an
+    // item, decoded to native byte order
+    struct CoeffCache
+    {
+        unsigned int record{ ~0u };
+        unsigned int granule{ ~0u };
+        std::array<double, MaxChebyshevCoeffs * 3> coeffs;
+    };
+
+    const char* recordData(unsigned int recNo) const;
+
     JPLEphCoeffInfo coeffInfo[JPLEph_NItems];
     JPLEphCoeffInfo librationCoeffInfo;
 
@@ -89,7 +97,11 @@ private:
     unsigned int recordSize;  // number of doubles per record
     bool swapBytes;
 
-    std::vector<JPLEphRecord> records;
+    celestia::util::MemoryMappedFile file;
+    std::size_t firstRecordOffset;  // offset of the first record in bytes
+    unsigned int nRecords;
+
+    mutable std::array<CoeffCache, JPLEph_NItems> coeffCache;
 };
 
 #endif // _CELENGINE_JPLEPH_H_
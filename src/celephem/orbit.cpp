@@ -44,10 +44,10 @@ static Vector3d cubicInterpolate(const Vector3d& p0, const Vector3d& v0,
   *
   * Subclasses of orbit should override this method as necessary. The default
   * implementation uses an adaptive sampling scheme with the following defaults:
-  *    tolerance: 1 km
+  *    tolerance: proc.tolerance(), 1 km unless the caller sets it
   *    start step: T / 1e5
   *    min step: T / 1e7
-  *    max step: T / 100
+  *    max step: T / 32
   *
   * Where T is either the mean orbital period for periodic orbits or the valid
   * time span for aperiodic trajectories.
@@ -75,8 +75,8 @@ void Orbit::sample(double startTime, double endTime, OrbitSampleProc& proc) cons
     }
 
     AdaptiveSamplingParameters samplingParams;
-    samplingParams.tolerance = 1.0; // kilometers
-    samplingParams.maxStep = span / 100.0;
+    samplingParams.tolerance = proc.tolerance(); // kilometers
+    samplingParams.maxStep = span / 32.0;
     samplingParams.minStep = span / 1.0e7;
     samplingParams.startStep = span / 1.0e5;
 
@@ -95,6 +95,9 @@ void Orbit::adaptiveSample(double startTime, double endTime, OrbitSampleProc& pr
     double t = startTime;
     const double stepFactor = 1.25;
 
+    // The step that met the tolerance is the first guess for the next one
+    double stepSize = startStepSize * 2.0;
+
     Vector3d lastP = positionAtTime(t);
     Vector3d lastV = velocityAtTime(t);
     proc.sample(t, lastP, lastV);
@@ -105,7 +108,7 @@ void Orbit::adaptiveSample(double startTime, double endTime, OrbitSampleProc& pr
     {
         // Make sure that we don't go past the end of the sample interval
         maxStepSize = min(maxStepSize, endTime - t);
-        double dt = min(maxStepSize, startStepSize * 2.0);
+        double dt = min(maxStepSize, stepSize);
 
         Vector3d p1 = positionAtTime(t + dt);
         Vector3d v1 = velocityAtTime(t + dt);
@@ -163,6 +166,7 @@ void Orbit::adaptiveSample(double startTime, double endTime, OrbitSampleProc& pr
         }
 
         t = t + dt;
+        stepSize = dt;
         lastP = p1;
         lastV = v1;
 
@@ -281,6 +285,20 @@ Vector3d Orbit::velocityAtTime(double tdb) const
 }
 
 
+void Orbit::positionsAtTimes(celestia::util::array_view<double> times, Vector3d* positions) const
+{
+    for (double t : times)
+        *positions++ = positionAtTime(t);
+}
+
+
+void Orbit::velocitiesAtTimes(celestia::util::array_view<double> times, Vector3d* velocities) const
+{
+    for (double t : times)
+        *velocities++ = velocityAtTime(t);
+}
+
+
 double EllipticalOrbit::eccentricAnomaly(double M) const
 {
     if (eccentricity == 0.0)
@@ -423,12 +441,46 @@ Vector3d EllipticalOrbit::velocityAtTime(double t) const
 }
 
 
+void EllipticalOrbit::positionsAtTimes(celestia::util::array_view<double> times, Vector3d* positions) const
+{
+    double meanMotion = 2.0 * celestia::numbers::pi / period;
+    for (double t : times)
+        *positions++ = positionAtE(eccentricAnomaly(meanAnomalyAtEpoch + (t - epoch) * meanMotion));
+}
+
+
+void EllipticalOrbit::velocitiesAtTimes(celestia::util::array_view<double> times, Vector3d* velocities) const
+{
+    double meanMotion = 2.0 * celestia::numbers::pi / period;
+    for (double t : times)
+        *velocities++ = velocityAtE(eccentricAnomaly(meanAnomalyAtEpoch + (t - epoch) * meanMotion));
+}
+
+
 double EllipticalOrbit::getPeriod() const
 {
     return period;
 }
 
 
+bool EllipticalOrbit::getEllipse(Vector3d& center, Vector3d& majorAxis, Vector3d& minorAxis) const
+{
+    if (eccentricity >= 1.0)
+        return false;
+
+    // The same conversion as positionAtE(), which puts a point at
+    // center + cos(E) * majorAxis + sin(E) * minorAxis
+    double a = pericenterDistance / (1.0 - eccentricity);
+    Vector3d p = orbitPlaneRotation.col(0) * a;
+    Vector3d q = orbitPlaneRotation.col(1) * (a * sqrt(1 - square(eccentricity)));
+    majorAxis = Vector3d(p.x(), p.z(), -p.y());
+    minorAxis = Vector3d(q.x(), q.z(), -q.y());
+    center = -eccentricity * majorAxis;
+
+    return true;
+}
+
+
 double EllipticalOrbit::getBoundingRadius() const
 {
     // TODO: watch out for unbounded parabolic and hyperbolic orbits
@@ -438,39 +490,29 @@ double EllipticalOrbit::getBoundingRadius() const
 
 Vector3d CachingOrbit::positionAtTime(double jd) const
 {
-    if (jd != lastTime)
-    {
-        lastTime = jd;
-        lastPosition = computePosition(jd);
-        positionCacheValid = true;
-        velocityCacheValid = false;
-    }
-    else if (!positionCacheValid)
-    {
-        lastPosition = computePosition(jd);
-        positionCacheValid = true;
-    }
-
-    return lastPosition;
+    return positionCache.get(jd, [this](double t) { return computePosition(t); });
 }
 
 
+// The default computeVelocity() evaluates positions; the caches are
+// separate, so it doesn't evict the velocity being computed
 Vector3d CachingOrbit::velocityAtTime(double jd) const
 {
-    if (jd != lastTime)
-    {
-        lastVelocity = computeVelocity(jd);
-        lastTime = jd;  // must be set *after* call to computeVelocity
-        positionCacheValid = false;
-        velocityCacheValid = true;
-    }
-    else if (!velocityCacheValid)
-    {
-        lastVelocity = computeVelocity(jd);
-        velocityCacheValid = true;
-    }
+    return velocityCache.get(jd, [this](double t) { return computeVelocity(t); });
+}
+
+
+void CachingOrbit::positionsAtTimes(celestia::util::array_view<double> times, Vector3d* positions) const
+{
+    for (double t : times)
+        *positions++ = computePosition(t);
+}
+
 
-    return lastVelocity;
+void CachingOrbit::velocitiesAtTimes(celestia::util::array_view<double> times, Vector3d* velocities) const
+{
+    for (double t : times)
+        *velocities++ = computeVelocity(t);
 }
 
 
@@ -607,6 +649,50 @@ Vector3d MixedOrbit::velocityAtTime(double jd) const
 }
 
 
+const Orbit* MixedOrbit::orbitAtTime(double jd) const
+{
+    if (jd < begin)
+        return beforeApprox;
+    else if (jd < end)
+        return primary;
+    else
+        return afterApprox;
+}
+
+
+// Runs of times in the same part of the orbit are passed on as one batch
+void MixedOrbit::positionsAtTimes(celestia::util::array_view<double> times, Vector3d* positions) const
+{
+    const double* t = times.data();
+    std::size_t n = times.size();
+    for (std::size_t i = 0; i < n;)
+    {
+        const Orbit* o = orbitAtTime(t[i]);
+        std::size_t j = i + 1;
+        while (j < n && orbitAtTime(t[j]) == o)
+            j++;
+        o->positionsAtTimes(celestia::util::array_view<double>(t + i, j - i), positions + i);
+        i = j;
+    }
+}
+
+
+void MixedOrbit::velocitiesAtTimes(celestia::util::array_view<double> times, Vector3d* velocities) const
+{
+    const double* t = times.data();
+    std::size_t n = times.size();
+    for (std::size_t i = 0; i < n;)
+    {
+        const Orbit* o = orbitAtTime(t[i]);
+        std::size_t j = i + 1;
+        while (j < n && orbitAtTime(t[j]) == o)
+            j++;
+        o->velocitiesAtTimes(celestia::util::array_view<double>(t + i, j - i), velocities + i);
+        i = j;
+    }
+}
+
+
 double MixedOrbit::getPeriod() const
 {
     return primary->getPeriod();
@@ -619,6 +705,13 @@ double MixedOrbit::getBoundingRadius() const
 }
 
 
+// The approximations are elliptical orbits, which are always thread safe
+bool MixedOrbit::isThreadSafe() const
+{
+    return primary->isThreadSafe();
+}
+
+
 void MixedOrbit::sample(double startTime, double endTime, OrbitSampleProc& proc) const
 {
     Orbit* o;
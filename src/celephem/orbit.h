@@ -11,6 +11,8 @@
 #define _CELENGINE_ORBIT_H_
 
 #include <Eigen/Core>
+#include <celutil/array_view.h>
+#include <celutil/lastresult.h>
 
 
 class OrbitSampleProc;
@@ -32,6 +34,19 @@ class Orbit
      */
     virtual Eigen::Vector3d velocityAtTime(double) const;
 
+    /*! Compute the positions at each of the times, which needn't be in
+     * order, into an array with room for times.size() elements. The
+     * default implementation calls positionAtTime() for each time; orbits
+     * that can share work between the evaluations override it.
+     */
+    virtual void positionsAtTimes(celestia::util::array_view<double> times,
+                                  Eigen::Vector3d* positions) const;
+
+    /*! Compute the velocities at each of the times, like positionsAtTimes().
+     */
+    virtual void velocitiesAtTimes(celestia::util::array_view<double> times,
+                                   Eigen::Vector3d* velocities) const;
+
     virtual double getPeriod() const = 0;
     virtual double getBoundingRadius() const = 0;
 
@@ -39,11 +54,25 @@ class Orbit
 
     virtual bool isPeriodic() const { return true; };
 
+    // Return true if positionAtTime(), velocityAtTime() and the batch
+    // methods may be called from several threads at once. Orbits whose
+    // evaluation changes state shared between calls, such as lazily loaded
+    // data, or that call into scripts or SPICE aren't. Callers must check
+    // this before evaluating an orbit concurrently.
+    virtual bool isThreadSafe() const { return false; };
+
     // Return the time range over which the orbit is valid; if the orbit
     // is always valid, begin and end should be equal.
     virtual void getValidRange(double& begin, double& end) const
         { begin = 0.0; end = 0.0; };
 
+    // If the path of the orbit is a fixed ellipse, set its center and its
+    // semimajor and semiminor axes in the orbit frame and return true.
+    virtual bool getEllipse(Eigen::Vector3d& /* center */,
+                            Eigen::Vector3d& /* majorAxis */,
+                            Eigen::Vector3d& /* minorAxis */) const
+        { return false; };
+
     struct AdaptiveSamplingParameters
     {
         double tolerance;
@@ -66,8 +95,12 @@ class EllipticalOrbit : public Orbit
     // Compute the orbit for a specified Julian date
     virtual Eigen::Vector3d positionAtTime(double) const;
     virtual Eigen::Vector3d velocityAtTime(double) const;
+    virtual void positionsAtTimes(celestia::util::array_view<double>, Eigen::Vector3d*) const;
+    virtual void velocitiesAtTimes(celestia::util::array_view<double>, Eigen::Vector3d*) const;
     double getPeriod() const;
     double getBoundingRadius() const;
+    virtual bool isThreadSafe() const { return true; };
+    virtual bool getEllipse(Eigen::Vector3d&, Eigen::Vector3d&, Eigen::Vector3d&) const;
 
  private:
     double eccentricAnomaly(double) const;
@@ -95,6 +128,12 @@ class OrbitSampleProc
     virtual ~OrbitSampleProc() = default;
 
     virtual void sample(double t, const Eigen::Vector3d& position, const Eigen::Vector3d& velocity) = 0;
+
+    /*! Return the largest acceptable distance in kilometers between the
+     *  orbit and the cubic curve through the samples. Orbits with adaptive
+     *  sampling place fewer samples when it's larger.
+     */
+    virtual double tolerance() const { return 1.0; }
 };
 
 
@@ -105,6 +144,10 @@ class OrbitSampleProc
  * order to avoid redundant calculation, the CachingOrbit class saves the
  * result of the last calculation and uses it if the time matches the cached
  * time.
+ *
+ * The cache may be shared by several threads, so a caching orbit is thread
+ * safe if computePosition() and computeVelocity() are. Subclasses for which
+ * they aren't must override isThreadSafe().
  */
 class CachingOrbit : public Orbit
 {
@@ -120,12 +163,16 @@ class CachingOrbit : public Orbit
     Eigen::Vector3d positionAtTime(double jd) const;
     Eigen::Vector3d velocityAtTime(double jd) const;
 
+    // Batches bypass the cache and call computePosition() and
+    // computeVelocity() directly
+    void positionsAtTimes(celestia::util::array_view<double> times, Eigen::Vector3d* positions) const;
+    void velocitiesAtTimes(celestia::util::array_view<double> times, Eigen::Vector3d* velocities) const;
+
+    bool isThreadSafe() const { return true; }
+
  private:
-    mutable Eigen::Vector3d lastPosition;
-    mutable Eigen::Vector3d lastVelocity;
-    mutable double lastTime{ -1.0e30 };
-    mutable bool positionCacheValid{ false };
-    mutable bool velocityCacheValid{ false };
+    celestia::util::LastResultCache<Eigen::Vector3d> positionCache;
+    celestia::util::LastResultCache<Eigen::Vector3d> velocityCache;
 };
 
 
@@ -143,11 +190,16 @@ class MixedOrbit : public Orbit
 
     virtual Eigen::Vector3d positionAtTime(double jd) const;
     virtual Eigen::Vector3d velocityAtTime(double jd) const;
+    virtual void positionsAtTimes(celestia::util::array_view<double>, Eigen::Vector3d*) const;
+    virtual void velocitiesAtTimes(celestia::util::array_view<double>, Eigen::Vector3d*) const;
     virtual double getPeriod() const;
     virtual double getBoundingRadius() const;
     virtual void sample(double startTime, double endTime, OrbitSampleProc& proc) const;
+    virtual bool isThreadSafe() const;
 
  private:
+    const Orbit* orbitAtTime(double jd) const;
+
     Orbit* primary;
     EllipticalOrbit* afterApprox;
     EllipticalOrbit* beforeApprox;
@@ -195,6 +247,7 @@ class FixedOrbit : public Orbit
     //virtual Vec3d velocityAtTime(double) const;
     virtual double getPeriod() const;
     virtual bool isPeriodic() const;
+    virtual bool isThreadSafe() const { return true; };
     virtual double getBoundingRadius() const;
     virtual void sample(double, double, OrbitSampleProc&) const;
 
@@ -54,77 +54,58 @@ RotationModel::angularVelocityAtTime(double tdb) const
 }
 
 
-/***** CachingRotationModel *****/
+void
+RotationModel::spinsAtTimes(celestia::util::array_view<double> tjds, Quaterniond* spins) const
+{
+    for (double tjd : tjds)
+        *spins++ = spin(tjd);
+}
+
 
-CachingRotationModel::CachingRotationModel() :
-    lastTime(365.0),
-    spinCacheValid(false),
-    equatorCacheValid(false),
-    angularVelocityCacheValid(false)
+void
+RotationModel::orientationsAtTimes(celestia::util::array_view<double> tjds, Quaterniond* orientations) const
 {
+    for (double tjd : tjds)
+        *orientations++ = spin(tjd) * equatorOrientationAtTime(tjd);
 }
 
 
+/***** CachingRotationModel *****/
+
 Quaterniond
 CachingRotationModel::spin(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastSpin = computeSpin(tjd);
-        spinCacheValid = true;
-        equatorCacheValid = false;
-        angularVelocityCacheValid = false;
-    }
-    else if (!spinCacheValid)
-    {
-        lastSpin = computeSpin(tjd);
-        spinCacheValid = true;
-    }
+    return spinCache.get(tjd, [this](double t) { return computeSpin(t); });
+}
+
 
-    return lastSpin;
+void
+CachingRotationModel::spinsAtTimes(celestia::util::array_view<double> tjds, Quaterniond* spins) const
+{
+    for (double tjd : tjds)
+        *spins++ = computeSpin(tjd);
+}
+
+
+void
+CachingRotationModel::orientationsAtTimes(celestia::util::array_view<double> tjds, Quaterniond* orientations) const
+{
+    for (double tjd : tjds)
+        *orientations++ = computeSpin(tjd) * computeEquatorOrientation(tjd);
 }
 
 
 Quaterniond
 CachingRotationModel::equatorOrientationAtTime(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastEquator = computeEquatorOrientation(tjd);
-        spinCacheValid = false;
-        equatorCacheValid = true;
-        angularVelocityCacheValid = false;
-    }
-    else if (!equatorCacheValid)
-    {
-        lastEquator = computeEquatorOrientation(tjd);
-        equatorCacheValid = true;
-    }
-
-    return lastEquator;
+    return equatorCache.get(tjd, [this](double t) { return computeEquatorOrientation(t); });
 }
 
 
 Vector3d
 CachingRotationModel::angularVelocityAtTime(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        lastTime = tjd;
-        spinCacheValid = false;
-        equatorCacheValid = false;
-        angularVelocityCacheValid = true;
-    }
-    else if (!angularVelocityCacheValid)
-    {
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        angularVelocityCacheValid = true;
-    }
-
-    return lastAngularVelocity;
+    return angularVelocityCache.get(tjd, [this](double t) { return computeAngularVelocity(t); });
 }
 
 
@@ -217,6 +198,14 @@ UniformRotationModel::spin(double tjd) const
 }
 
 
+void
+UniformRotationModel::spinsAtTimes(celestia::util::array_view<double> tjds, Quaterniond* spins) const
+{
+    for (double tjd : tjds)
+        *spins++ = UniformRotationModel::spin(tjd);
+}
+
+
 Quaterniond
 UniformRotationModel::equatorOrientationAtTime(double /*unused*/) const
 {
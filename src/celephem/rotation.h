@@ -12,6 +12,8 @@
 #define _CELENGINE_ROTATION_H_
 
 #include <Eigen/Geometry>
+#include <celutil/array_view.h>
+#include <celutil/lastresult.h>
 
 
 /*! A RotationModel object describes the orientation of an object
@@ -54,6 +56,20 @@ class RotationModel
      */
     virtual Eigen::Quaterniond spin(double tjd) const = 0;
 
+    /*! Compute the spin at each of the times into an array with room for
+     *  tjds.size() elements. The default implementation calls spin() for
+     *  each time.
+     */
+    virtual void spinsAtTimes(celestia::util::array_view<double> tjds,
+                              Eigen::Quaterniond* spins) const;
+
+    /*! Compute the orientation at each of the times into an array with room
+     *  for tjds.size() elements. The default implementation calls spin() and
+     *  equatorOrientationAtTime() for each time.
+     */
+    virtual void orientationsAtTimes(celestia::util::array_view<double> tjds,
+                                     Eigen::Quaterniond* orientations) const;
+
     virtual double getPeriod() const
     {
         return 0.0;
@@ -71,6 +87,10 @@ class RotationModel
         begin = 0.0;
         end = 0.0;
     };
+
+    // Return true if the orientation, spin and angular velocity may be
+    // computed from several threads at once, like Orbit::isThreadSafe().
+    virtual bool isThreadSafe() const { return false; }
 };
 
 
@@ -83,31 +103,35 @@ class RotationModel
  *  the instantaneous angular velocity. It may be overridden if there is some
  *  better means to calculate the angular velocity for a specific rotation
  *  model.
+ *
+ *  The cache may be shared by several threads, so a caching rotation model
+ *  is thread safe if the compute methods are. Subclasses for which they
+ *  aren't must override isThreadSafe().
  */
 class CachingRotationModel : public RotationModel
 {
  public:
-    CachingRotationModel();
+    CachingRotationModel() = default;
     virtual ~CachingRotationModel() = default;
 
     Eigen::Quaterniond spin(double tjd) const;
     Eigen::Quaterniond equatorOrientationAtTime(double tjd) const;
     Eigen::Vector3d angularVelocityAtTime(double tjd) const;
+    // Batches bypass the cache and call computeSpin() directly
+    void spinsAtTimes(celestia::util::array_view<double> tjds, Eigen::Quaterniond* spins) const;
+    void orientationsAtTimes(celestia::util::array_view<double> tjds, Eigen::Quaterniond* orientations) const;
 
     virtual Eigen::Quaterniond computeEquatorOrientation(double tjd) const = 0;
     virtual Eigen::Quaterniond computeSpin(double tjd) const = 0;
     virtual Eigen::Vector3d computeAngularVelocity(double tjd) const;
     virtual double getPeriod() const = 0;
     virtual bool isPeriodic() const = 0;
+    bool isThreadSafe() const { return true; }
 
 private:
-    mutable Eigen::Quaterniond lastSpin;
-    mutable Eigen::Quaterniond lastEquator;
-    mutable Eigen::Vector3d lastAngularVelocity;
-    mutable double lastTime;
-    mutable bool spinCacheValid;
-    mutable bool equatorCacheValid;
-    mutable bool angularVelocityCacheValid;
+    celestia::util::LastResultCache<Eigen::Quaterniond> spinCache;
+    celestia::util::LastResultCache<Eigen::Quaterniond> equatorCache;
+    celestia::util::LastResultCache<Eigen::Vector3d> angularVelocityCache;
 };
 
 
@@ -122,6 +146,7 @@ class ConstantOrientation : public RotationModel
 
     virtual Eigen::Quaterniond spin(double tjd) const;
     virtual Eigen::Vector3d angularVelocityAtTime(double tjd) const;
+    virtual bool isThreadSafe() const { return true; }
 
  private:
     Eigen::Quaterniond orientation;
@@ -145,7 +170,9 @@ class UniformRotationModel : public RotationModel
     virtual double getPeriod() const;
     virtual Eigen::Quaterniond equatorOrientationAtTime(double tjd) const;
     virtual Eigen::Quaterniond spin(double tjd) const;
+    virtual void spinsAtTimes(celestia::util::array_view<double> tjds, Eigen::Quaterniond* spins) const;
     virtual Eigen::Vector3d angularVelocityAtTime(double tjd) const;
+    virtual bool isThreadSafe() const { return true; }
 
  private:
     double period;       // sidereal rotation period
@@ -174,6 +201,7 @@ class PrecessingRotationModel : public RotationModel
     virtual double getPeriod() const;
     virtual Eigen::Quaterniond equatorOrientationAtTime(double tjd) const;
     virtual Eigen::Quaterniond spin(double tjd) const;
+    virtual bool isThreadSafe() const { return true; }
 
  private:
     double period;       // sidereal rotation period (in Julian days)
@@ -13,19 +13,26 @@
 #include "orbit.h"
 #include "samporbit.h"
 #include "xyzvbinary.h"
+#include <celcompat/charconv.h>
 #include <celengine/astro.h>
 #include <celmath/mathlib.h>
 #include <celutil/bytes.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
+#include <celutil/mmapfile.h>
 #include <cmath>
+#include <cstring>
 #include <string>
 #include <algorithm>
+#include <atomic>
 #include <vector>
 #include <iostream>
+#include <iterator>
 #include <fstream>
 #include <limits>
+#include <mutex>
 #include <iomanip>
+#include <system_error>
 
 using namespace Eigen;
 using namespace std;
@@ -39,30 +46,85 @@ using celestia::util::GetLogger;
 //static const double MaxSampleInterval = 50.0;
 //static const double SampleThresholdAngle = 2.0;
 
-// Position-only sample
-template <typename T> struct Sample
+// Index of the sample times, so that the span containing a time can be
+// found without a binary search over the whole trajectory. The span of the
+// samples is divided into as many buckets of equal length as there are
+// samples, and each bucket records the first sample at or after its start.
+// The times are read through a function returning the time of sample i, so
+// that they needn't be stored in an array of their own.
+class SampleTimeIndex
 {
-    double t;
-    T x, y, z;
-};
+public:
+    template <typename Times> void build(const Times& times, int nSamples);
+    template <typename Times> int find(const Times& times, int nSamples, double jd, int hint) const;
+    bool isBuilt() const { return !buckets.empty(); }
 
-// Position + velocity sample
-template <typename T> struct SampleXYZV
-{
-    double t;
-    Eigen::Matrix<T, 3, 1> position;
-    Eigen::Matrix<T, 3, 1> velocity;
+private:
+    double start{ 0.0 };
+    double bucketsPerDay{ 0.0 };
+    vector<int> buckets;
 };
 
 
-template <typename T> bool operator<(const Sample<T>& a, const Sample<T>& b)
+template <typename Times> void SampleTimeIndex::build(const Times& times, int nSamples)
 {
-    return a.t < b.t;
+    buckets.clear();
+    if (nSamples < 2)
+        return;
+
+    int nBuckets = nSamples;
+    start = times(0);
+    double bucketLength = (times(nSamples - 1) - start) / nBuckets;
+    bucketsPerDay = 1.0 / bucketLength;
+
+    buckets.resize(nBuckets + 1);
+    int n = 0;
+    for (int i = 0; i < nBuckets; i++)
+    {
+        double bucketStart = start + i * bucketLength;
+        while (times(n) < bucketStart)
+            n++;
+        buckets[i] = n;
+    }
+    buckets[nBuckets] = nSamples - 1;
 }
 
-template <typename T> bool operator<(const SampleXYZV<T>& a, const SampleXYZV<T>& b)
+
+// Return the index of the sample ending the span that contains jd: the
+// first sample at or after jd, or the number of samples if there's none.
+// Consecutive times usually fall in the span of the previous lookup, which
+// is checked first.
+template <typename Times> int SampleTimeIndex::find(const Times& times, int nSamples, double jd, int hint) const
 {
-    return a.t < b.t;
+    if (hint >= 1 && hint < nSamples && jd > times(hint - 1) && jd <= times(hint))
+        return hint;
+
+    if (nSamples == 0 || jd <= times(0))
+        return 0;
+    if (jd > times(nSamples - 1))
+        return nSamples;
+
+    auto nBuckets = (int) buckets.size() - 1;
+    int bucket = min((int) ((jd - start) * bucketsPerDay), nBuckets - 1);
+    int lo = buckets[bucket];
+    int hi = buckets[bucket + 1] + 1;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (times(mid) < jd)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    // Rounding of the bucket number can put jd just outside of the bucket
+    int n = lo;
+    while (n > 0 && times(n - 1) >= jd)
+        n--;
+    while (n < nSamples && times(n) < jd)
+        n++;
+
+    return n;
 }
 
 
@@ -73,12 +135,13 @@ public:
     ~SampledOrbit() override = default;
 
     void addSample(double t, double x, double y, double z);
-    void setPeriod();
+    void buildTimeIndex();
 
     double getPeriod() const override;
     double getBoundingRadius() const override;
     Vector3d computePosition(double jd) const override;
     Vector3d computeVelocity(double jd) const override;
+    void positionsAtTimes(celestia::util::array_view<double> times, Vector3d* positions) const override;
 
     bool isPeriodic() const override;
     void getValidRange(double& begin, double& end) const override;
@@ -86,10 +149,18 @@ public:
     void sample(double startTime, double endTime, OrbitSampleProc& proc) const override;
 
 private:
-    vector<Sample<T> > samples;
+    Vector3d position(int n) const { return positions[n].template cast<double>(); }
+    int findSample(double jd) const;
+
+    // Times and positions in separate arrays, so that finding a span only
+    // touches the times
+    vector<double> times;
+    vector<Matrix<T, 3, 1>> positions;
+    SampleTimeIndex timeIndex;
     double boundingRadius;
-    double period;
-    mutable int lastSample;
+    // Where the last search ended, as a hint for the next one. Threads
+    // evaluating the orbit at once may overwrite each other's hints.
+    mutable std::atomic<int> lastSample;
 
     TrajectoryInterpolation interpolation;
 };
@@ -97,7 +168,6 @@ private:
 
 template <typename T> SampledOrbit<T>::SampledOrbit(TrajectoryInterpolation _interpolation) :
     boundingRadius(0.0),
-    period(1.0),
     lastSample(0),
     interpolation(_interpolation)
 {
@@ -110,17 +180,30 @@ template <typename T> void SampledOrbit<T>::addSample(double t, double x, double
     if (r > boundingRadius)
         boundingRadius = r;
 
-    Sample<T> samp;
-    samp.x = (T) x;
-    samp.y = (T) y;
-    samp.z = (T) z;
-    samp.t = t;
-    samples.push_back(samp);
+    times.push_back(t);
+    positions.emplace_back((T) x, (T) y, (T) z);
+}
+
+
+// Must be called after the last sample has been added
+template <typename T> void SampledOrbit<T>::buildTimeIndex()
+{
+    timeIndex.build([this](int i) { return times[i]; }, (int) times.size());
+}
+
+
+template <typename T> int SampledOrbit<T>::findSample(double jd) const
+{
+    int sample = timeIndex.find([this](int i) { return times[i]; }, (int) times.size(), jd,
+                                lastSample.load(std::memory_order_relaxed));
+    lastSample.store(sample, std::memory_order_relaxed);
+    return sample;
 }
 
+
 template <typename T> double SampledOrbit<T>::getPeriod() const
 {
-    return samples[samples.size() - 1].t - samples[0].t;
+    return times.back() - times.front();
 }
 
 
@@ -132,8 +215,8 @@ template <typename T> bool SampledOrbit<T>::isPeriodic() const
 
 template <typename T> void SampledOrbit<T>::getValidRange(double& begin, double& end) const
 {
-    begin = samples[0].t;
-    end = samples[samples.size() - 1].t;
+    begin = times.front();
+    end = times.back();
 }
 
 
@@ -166,85 +249,58 @@ static Vector3d cubicInterpolateVelocity(const Vector3d& p0, const Vector3d& v0,
 template <typename T> Vector3d SampledOrbit<T>::computePosition(double jd) const
 {
     Vector3d pos;
-    if (samples.size() == 0)
+    if (times.size() == 0)
     {
         pos = Vector3d::Zero();
     }
-    else if (samples.size() == 1)
+    else if (times.size() == 1)
     {
-        pos = Vector3d(samples[0].x, samples[0].y, samples[0].z);
+        pos = position(0);
     }
     else
     {
-        Sample<T> samp;
-        samp.t = jd;
-        int n = lastSample;
-
-        if (n < 1 || n >= (int) samples.size() || jd < samples[n - 1].t || jd > samples[n].t)
-        {
-            typename vector<Sample<T> >::const_iterator iter = lower_bound(samples.begin(),
-                                                                           samples.end(),
-                                                                           samp);
-            if (iter == samples.end())
-                n = samples.size();
-            else
-                n = iter - samples.begin();
-
-            lastSample = n;
-        }
+        int n = findSample(jd);
 
         if (n == 0)
         {
-            pos = Vector3d(samples[n].x, samples[n].y, samples[n].z);
+            pos = position(n);
         }
-        else if (n < (int) samples.size())
+        else if (n < (int) times.size())
         {
             if (interpolation == TrajectoryInterpolationLinear)
             {
-                Sample<T> s0 = samples[n - 1];
-                Sample<T> s1 = samples[n];
-
-                double t = (jd - s0.t) / (s1.t - s0.t);
-                pos = Vector3d(lerp(t, (double) s0.x, (double) s1.x),
-                               lerp(t, (double) s0.y, (double) s1.y),
-                               lerp(t, (double) s0.z, (double) s1.z));
+                double t = (jd - times[n - 1]) / (times[n] - times[n - 1]);
+                Vector3d p0 = position(n - 1);
+                Vector3d p1 = position(n);
+                pos = Vector3d(lerp(t, p0.x(), p1.x()),
+                               lerp(t, p0.y(), p1.y()),
+                               lerp(t, p0.z(), p1.z()));
             }
             else if (interpolation == TrajectoryInterpolationCubic)
             {
-                Sample<T> s0, s1, s2, s3;
-                if (n > 1)
-                    s0 = samples[n - 2];
-                else
-                    s0 = samples[n - 1];
-                s1 = samples[n - 1];
-                s2 = samples[n];
-                if (n < (int) samples.size() - 1)
-                    s3 = samples[n + 1];
-                else
-                    s3 = samples[n];
-
-                double h = s2.t - s1.t;
+                int n0 = n > 1 ? n - 2 : n - 1;
+                int n3 = n < (int) times.size() - 1 ? n + 1 : n;
+                double t0 = times[n0];
+                double t1 = times[n - 1];
+                double t2 = times[n];
+                double t3 = times[n3];
+
+                double h = t2 - t1;
                 double ih = 1.0 / h;
-                double t = (jd - s1.t) * ih;
-                Vector3d p0(s1.x, s1.y, s1.z);
-                Vector3d p1(s2.x, s2.y, s2.z);
-
-                Vector3d v10((double) s1.x - (double) s0.x,
-                             (double) s1.y - (double) s0.y,
-                             (double) s1.z - (double) s0.z);
-                Vector3d v21((double) s2.x - (double) s1.x,
-                             (double) s2.y - (double) s1.y,
-                             (double) s2.z - (double) s1.z);
-                Vector3d v32((double) s3.x - (double) s2.x,
-                             (double) s3.y - (double) s2.y,
-                             (double) s3.z - (double) s2.z);
+                double t = (jd - t1) * ih;
+                Vector3d p0 = position(n - 1);
+                Vector3d p1 = position(n);
+
+                Vector3d v10 = p0 - position(n0);
+                Vector3d v21 = p1 - p0;
+                Vector3d v32 = position(n3) - p1;
 
                 // Estimate velocities by averaging the differences at adjacent spans
                 // (except at the end spans, where we just use a single velocity.)
                 Vector3d v0;
                 if (n > 1)
                 {
-                    v0 = v10 * (0.5 / (s1.t - s0.t)) + v21 * (0.5 * ih);
+                    v0 = v10 * (0.5 / (t1 - t0)) + v21 * (0.5 * ih);
                     v0 *= h;
                 }
                 else
@@ -253,9 +309,9 @@ template <typename T> Vector3d SampledOrbit<T>::computePosition(double jd) const
                 }
 
                 Vector3d v1;
-                if (n < (int) samples.size() - 1)
+                if (n < (int) times.size() - 1)
                 {
-                    v1 = v21 * (0.5 * ih) + v32 * (0.5 / (s3.t - s2.t));
+                    v1 = v21 * (0.5 * ih) + v32 * (0.5 / (t3 - t2));
                     v1 *= h;
                 }
                 else
@@ -273,7 +329,7 @@ template <typename T> Vector3d SampledOrbit<T>::computePosition(double jd) const
         }
         else
         {
-            pos = Vector3d(samples[n - 1].x, samples[n - 1].y, samples[n - 1].z);
+            pos = position(n - 1);
         }
     }
 
@@ -282,81 +338,63 @@ template <typename T> Vector3d SampledOrbit<T>::computePosition(double jd) const
 }
 
 
+// Batches of increasing times find their spans with a few comparisons, and
+// the interpolation doesn't go through the position cache.
+template <typename T> void SampledOrbit<T>::positionsAtTimes(celestia::util::array_view<double> times,
+                                                             Vector3d* positions) const
+{
+    for (double t : times)
+        *positions++ = SampledOrbit<T>::computePosition(t);
+}
+
+
 template <typename T> Vector3d SampledOrbit<T>::computeVelocity(double jd) const
 {
     Vector3d vel;
-    if (samples.size() < 2)
+    if (times.size() < 2)
     {
         vel = Vector3d::Zero();
     }
     else
     {
-        Sample<T> samp;
-        samp.t = jd;
-        int n = lastSample;
-
-        if (n < 1 || n >= (int) samples.size() || jd < samples[n - 1].t || jd > samples[n].t)
-        {
-            typename vector<Sample<T> >::const_iterator iter = lower_bound(samples.begin(),
-                                                                           samples.end(),
-                                                                           samp);
-            if (iter == samples.end())
-                n = samples.size();
-            else
-                n = iter - samples.begin();
-            lastSample = n;
-        }
+        int n = findSample(jd);
 
         if (n == 0)
         {
             vel = Vector3d::Zero();
         }
-        else if (n < (int) samples.size())
+        else if (n < (int) times.size())
         {
             if (interpolation == TrajectoryInterpolationLinear)
             {
-                Sample<T> s0 = samples[n - 1];
-                Sample<T> s1 = samples[n];
-
-                double dt = (s1.t - s0.t);
-                return (Vector3d(s1.x, s1.y, s1.z) - Vector3d(s0.x, s0.y, s0.z)) * (1.0 / dt);
+                double dt = (times[n] - times[n - 1]);
+                return (position(n) - position(n - 1)) * (1.0 / dt);
             }
             if (interpolation == TrajectoryInterpolationCubic)
             {
-                Sample<T> s0, s1, s2, s3;
-                if (n > 1)
-                    s0 = samples[n - 2];
-                else
-                    s0 = samples[n - 1];
-                s1 = samples[n - 1];
-                s2 = samples[n];
-                if (n < (int) samples.size() - 1)
-                    s3 = samples[n + 1];
-                else
-                    s3 = samples[n];
-
-                double h = s2.t - s1.t;
+                int n0 = n > 1 ? n - 2 : n - 1;
+                int n3 = n < (int) times.size() - 1 ? n + 1 : n;
+                double t0 = times[n0];
+                double t1 = times[n - 1];
+                double t2 = times[n];
+                double t3 = times[n3];
+
+                double h = t2 - t1;
                 double ih = 1.0 / h;
-                double t = (jd - s1.t) * ih;
-                Vector3d p0(s1.x, s1.y, s1.z);
-                Vector3d p1(s2.x, s2.y, s2.z);
-
-                Vector3d v10((double) s1.x - (double) s0.x,
-                             (double) s1.y - (double) s0.y,
-                             (double) s1.z - (double) s0.z);
-                Vector3d v21((double) s2.x - (double) s1.x,
-                             (double) s2.y - (double) s1.y,
-                             (double) s2.z - (double) s1.z);
-                Vector3d v32((double) s3.x - (double) s2.x,
-                             (double) s3.y - (double) s2.y,
-                             (double) s3.z - (double) s2.z);
+                double t = (jd - t1) * ih;
+                Vector3d p0 = position(n - 1);
+                Vector3d p1 = position(n);
+
+                Vector3d v10 = p0 - position(n0);
+                Vector3d v21 = p1 - p0;
+                Vector3d v32 = position(n3) - p1;
 
                 // Estimate velocities by averaging the differences at adjacent spans
                 // (except at the end spans, where we just use a single velocity.)
                 Vector3d v0;
                 if (n > 1)
                 {
-                    v0 = v10 * (0.5 / (s1.t - s0.t)) + v21 * (0.5 * ih);
+                    v0 = v10 * (0.5 / (t1 - t0)) + v21 * (0.5 * ih);
                     v0 *= h;
                 }
                 else
@@ -365,9 +403,9 @@ template <typename T> Vector3d SampledOrbit<T>::computeVelocity(double jd) const
                 }
 
                 Vector3d v1;
-                if (n < (int) samples.size() - 1)
+                if (n < (int) times.size() - 1)
                 {
-                    v1 = v21 * (0.5 * ih) + v32 * (0.5 / (s3.t - s2.t));
+                    v1 = v21 * (0.5 * ih) + v32 * (0.5 / (t3 - t2));
                     v1 *= h;
                 }
                 else
@@ -397,36 +435,97 @@ template <typename T> Vector3d SampledOrbit<T>::computeVelocity(double jd) const
 template <typename T> void SampledOrbit<T>::sample(double /* startTime */, double /* endTime */,
                                                    OrbitSampleProc& proc) const
 {
-    for (unsigned int i = 0; i < samples.size(); i++)
+    for (unsigned int i = 0; i < times.size(); i++)
     {
         Vector3d v;
-        Vector3d p(samples[i].x, samples[i].y, samples[i].z);
-
-        if (samples.size() == 1)
+        Vector3d p = position(i);
+        if (times.size() == 1)
         {
             v = Vector3d::Zero();
         }
         else if (i == 0)
         {
-            double dt = samples[i + 1].t - samples[i].t;
-            v = (Vector3d(samples[i + 1].x, samples[i + 1].y, samples[i + 1].z) - p) / dt;
+            double dt = times[i + 1] - times[i];
+            v = (position(i + 1) - p) / dt;
         }
-        else if (i == samples.size() - 1)
+        else if (i == times.size() - 1)
         {
-            double dt = samples[i].t - samples[i - 1].t;
-            v = (p - Vector3d(samples[i - 1].x, samples[i - 1].y, samples[i - 1].z)) / dt;
+            double dt = times[i] - times[i - 1];
+            v = (p - position(i - 1)) / dt;
         }
         else
         {
-            double dt0 = samples[i + 1].t - samples[i].t;
-            Vector3d v0 = (Vector3d(samples[i + 1].x, samples[i + 1].y, samples[i + 1].z) - p) / dt0;
-            double dt1 = samples[i].t - samples[i - 1].t;
-            Vector3d v1 = (p - Vector3d(samples[i - 1].x, samples[i - 1].y, samples[i - 1].z)) / dt1;
+            double dt0 = times[i + 1] - times[i];
+            Vector3d v0 = (position(i + 1) - p) / dt0;
+            double dt1 = times[i] - times[i - 1];
+            Vector3d v1 = (p - position(i - 1)) / dt1;
             v = (v0 + v1) * 0.5;
         }
 
-        proc.sample(samples[i].t, Vector3d(p.x(), p.z(), -p.y()), Vector3d(v.x(), v.z(), -v.y()));
+        proc.sample(times[i], Vector3d(p.x(), p.z(), -p.y()), Vector3d(v.x(), v.z(), -v.y()));
+    }
+}
+
+
+// Position and velocity of an xyzv trajectory at jd, where n is the index
+// of the sample ending the span containing jd. The samples are read through
+// the time(), position() and velocity() members of the orbit.
+template <typename O> Vector3d XYZVPositionAtTime(const O& orbit, int nSamples, int n, double jd,
+                                                  TrajectoryInterpolation interpolation)
+{
+    if (n == 0)
+        return orbit.position(0);
+    if (n >= nSamples)
+        return orbit.position(nSamples - 1);
+
+    double t0 = orbit.time(n - 1);
+    Vector3d p0 = orbit.position(n - 1);
+    Vector3d p1 = orbit.position(n);
+
+    if (interpolation == TrajectoryInterpolationLinear)
+    {
+        double t = (jd - t0) / (orbit.time(n) - t0);
+        return p0 + t * (p1 - p0);
+    }
+
+    if (interpolation == TrajectoryInterpolationCubic)
+    {
+        double h = orbit.time(n) - t0;
+        double ih = 1.0 / h;
+        double t = (jd - t0) * ih;
+        return cubicInterpolate(p0, orbit.velocity(n - 1) * h, p1, orbit.velocity(n) * h, t);
+    }
+
+    // Unknown interpolation type
+    return Vector3d::Zero();
+}
+
+
+// Velocity is computed as the derivative of the interpolating function
+// for position.
+template <typename O> Vector3d XYZVVelocityAtTime(const O& orbit, int nSamples, int n, double jd,
+                                                  TrajectoryInterpolation interpolation)
+{
+    if (n == 0 || n >= nSamples)
+        return Vector3d::Zero();
+
+    double t0 = orbit.time(n - 1);
+    double h = orbit.time(n) - t0;
+    Vector3d p0 = orbit.position(n - 1);
+    Vector3d p1 = orbit.position(n);
+
+    if (interpolation == TrajectoryInterpolationLinear)
+        return (p1 - p0) * (1.0 / h) * astro::daysToSecs(1.0);
+
+    if (interpolation == TrajectoryInterpolationCubic)
+    {
+        double ih = 1.0 / h;
+        double t = (jd - t0) * ih;
+        return cubicInterpolateVelocity(p0, orbit.velocity(n - 1) * h, p1, orbit.velocity(n) * h, t) * ih;
     }
+
+    // Unknown interpolation type
+    return Vector3d::Zero();
 }
 
 
@@ -438,23 +537,34 @@ public:
     ~SampledOrbitXYZV() override = default;
 
     void addSample(double t, const Vector3d& position, const Vector3d& velocity);
-    void setPeriod();
+    void buildTimeIndex();
 
     double getPeriod() const override;
     double getBoundingRadius() const override;
     Vector3d computePosition(double jd) const override;
     Vector3d computeVelocity(double jd) const override;
+    void positionsAtTimes(celestia::util::array_view<double> times, Vector3d* positions) const override;
 
     bool isPeriodic() const override;
     void getValidRange(double& begin, double& end) const override;
 
     void sample(double startTime, double endTime, OrbitSampleProc& proc) const override;
 
+    double time(int n) const { return times[n]; }
+    Vector3d position(int n) const { return positions[n].template cast<double>(); }
+    Vector3d velocity(int n) const { return velocities[n].template cast<double>(); }
+
 private:
-    vector<SampleXYZV<T> > samples;
+    int findSample(double jd) const;
+
+    vector<double> times;
+    vector<Matrix<T, 3, 1>> positions;
+    vector<Matrix<T, 3, 1>> velocities;
+    SampleTimeIndex timeIndex;
     double boundingRadius;
-    double period;
-    mutable int lastSample;
+    // Where the last search ended, as a hint for the next one. Threads
+    // evaluating the orbit at once may overwrite each other's hints.
+    mutable std::atomic<int> lastSample;
 
     TrajectoryInterpolation interpolation;
 };
@@ -462,7 +572,6 @@ private:
 
 template <typename T> SampledOrbitXYZV<T>::SampledOrbitXYZV(TrajectoryInterpolation _interpolation) :
     boundingRadius(0.0),
-    period(1.0),
     lastSample(0),
     interpolation(_interpolation)
 {
@@ -478,21 +587,34 @@ template <typename T> void SampledOrbitXYZV<T>::addSample(double t, const Vector
     if (r > boundingRadius)
         boundingRadius = r;
 
-    SampleXYZV<T> samp;
-    samp.t = t;
-    //samp.position = Matrix<T, 3, 1>((T) position.x, (T) position.y, (T) position.z);
-    //samp.velocity = Matrix<T, 3, 1>((T) velocity.x, (T) velocity.y, (T) velocity.z);
-    samp.position = position.cast<T>();
-    samp.velocity = velocity.cast<T>();
-    samples.push_back(samp);
+    times.push_back(t);
+    positions.push_back(position.cast<T>());
+    velocities.push_back(velocity.cast<T>());
+}
+
+
+// Must be called after the last sample has been added
+template <typename T> void SampledOrbitXYZV<T>::buildTimeIndex()
+{
+    timeIndex.build([this](int i) { return times[i]; }, (int) times.size());
+}
+
+
+template <typename T> int SampledOrbitXYZV<T>::findSample(double jd) const
+{
+    int sample = timeIndex.find([this](int i) { return times[i]; }, (int) times.size(), jd,
+                                lastSample.load(std::memory_order_relaxed));
+    lastSample.store(sample, std::memory_order_relaxed);
+    return sample;
 }
 
+
 template <typename T> double SampledOrbitXYZV<T>::getPeriod() const
 {
-    if (samples.empty())
+    if (times.empty())
         return 0.0;
 
-    return samples[samples.size() - 1].t - samples[0].t;
+    return times.back() - times.front();
 }
 
 
@@ -504,8 +626,8 @@ template <typename T> bool SampledOrbitXYZV<T>::isPeriodic() const
 
 template <typename T> void SampledOrbitXYZV<T>::getValidRange(double& begin, double& end) const
 {
-    begin = samples[0].t;
-    end = samples[samples.size() - 1].t;
+    begin = times.front();
+    end = times.back();
 }
 
 
@@ -517,151 +639,212 @@ template <typename T> double SampledOrbitXYZV<T>::getBoundingRadius() const
 
 template <typename T> Vector3d SampledOrbitXYZV<T>::computePosition(double jd) const
 {
-    Vector3d pos;
-    if (samples.size() == 0)
-    {
-        pos = Vector3d::Zero();
-    }
-    else if (samples.size() == 1)
+    Vector3d pos = Vector3d::Zero();
+    if (!times.empty())
+        pos = XYZVPositionAtTime(*this, (int) times.size(), findSample(jd), jd, interpolation);
+
+    // Add correction for Celestia's coordinate system
+    return Vector3d(pos.x(), pos.z(), -pos.y());
+}
+
+
+// Batches of increasing times find their spans with a few comparisons, and
+// the interpolation doesn't go through the position cache.
+template <typename T> void SampledOrbitXYZV<T>::positionsAtTimes(celestia::util::array_view<double> times,
+                                                                 Vector3d* positions) const
+{
+    for (double t : times)
+        *positions++ = SampledOrbitXYZV<T>::computePosition(t);
+}
+
+
+template <typename T> Vector3d SampledOrbitXYZV<T>::computeVelocity(double jd) const
+{
+    Vector3d vel = Vector3d::Zero();
+    if (times.size() >= 2)
+        vel = XYZVVelocityAtTime(*this, (int) times.size(), findSample(jd), jd, interpolation);
+
+    // Add correction for Celestia's coordinate system
+    return Vector3d(vel.x(), vel.z(), -vel.y());
+}
+
+
+template <typename T> void SampledOrbitXYZV<T>::sample(double /* startTime */, double /* endTime */,
+                                                       OrbitSampleProc& proc) const
+{
+    for (unsigned int i = 0; i < times.size(); i++)
     {
-        pos = Vector3d(samples[0].position.x(), samples[1].position.y(), samples[2].position.z());
+        Vector3d p = position(i);
+        Vector3d v = velocity(i);
+        proc.sample(times[i], Vector3d(p.x(), p.z(), -p.y()), Vector3d(v.x(), v.z(), -v.y()));
     }
-    else
-    {
-        SampleXYZV<T> samp;
-        samp.t = jd;
-        int n = lastSample;
+}
 
-        if (n < 1 || n >= (int) samples.size() || jd < samples[n - 1].t || jd > samples[n].t)
-        {
-            typename vector<SampleXYZV<T> >::const_iterator iter = lower_bound(samples.begin(),
-                                                                               samples.end(),
-                                                                               samp);
-            if (iter == samples.end())
-                n = samples.size();
-            else
-                n = iter - samples.begin();
 
-            lastSample = n;
-        }
+/*! An xyzv trajectory read straight from a memory mapped binary file.
+ *  Only the header is checked when the orbit is created; the file is mapped
+ *  the first time a position is needed, and the operating system pages in
+ *  just the parts of it that are used. Trajectories of spacecraft that are
+ *  never visited thus use almost no memory.
+ */
+class MappedOrbitXYZV : public CachingOrbit
+{
+public:
+    MappedOrbitXYZV(const fs::path& _filename,
+                    TrajectoryInterpolation _interpolation,
+                    int _nSamples,
+                    double _startTime,
+                    double _endTime,
+                    double _boundingRadius);
+    ~MappedOrbitXYZV() override = default;
 
-        if (n == 0)
-        {
-            pos = Vector3d(samples[n].position.x(), samples[n].position.y(), samples[n].position.z());
-        }
-        else if (n < (int) samples.size())
-        {
-            SampleXYZV<T> s0 = samples[n - 1];
-            SampleXYZV<T> s1 = samples[n];
+    double getPeriod() const override;
+    double getBoundingRadius() const override;
+    Vector3d computePosition(double jd) const override;
+    Vector3d computeVelocity(double jd) const override;
+    void positionsAtTimes(celestia::util::array_view<double> times, Vector3d* positions) const override;
 
-            if (interpolation == TrajectoryInterpolationLinear)
-            {
-                double t = (jd - s0.t) / (s1.t - s0.t);
+    bool isPeriodic() const override;
+    void getValidRange(double& begin, double& end) const override;
 
-                Vector3d p0(s0.position.x(), s0.position.y(), s0.position.z());
-                Vector3d p1(s1.position.x(), s1.position.y(), s1.position.z());
-                pos = p0 + t * (p1 - p0);
-            }
-            else if (interpolation == TrajectoryInterpolationCubic)
-            {
-                double h = s1.t - s0.t;
-                double ih = 1.0 / h;
-                double t = (jd - s0.t) * ih;
+    void sample(double startTime, double endTime, OrbitSampleProc& proc) const override;
 
-                Vector3d p0(s0.position.x(), s0.position.y(), s0.position.z());
-                Vector3d v0(s0.velocity.x(), s0.velocity.y(), s0.velocity.z());
-                Vector3d p1(s1.position.x(), s1.position.y(), s1.position.z());
-                Vector3d v1(s1.velocity.x(), s1.velocity.y(), s1.velocity.z());
-                pos = cubicInterpolate(p0, v0 * h, p1, v1 * h, t);
-            }
-            else
-            {
-                // Unknown interpolation type
-                pos = Vector3d::Zero();
-            }
-        }
-        else
+    double time(int n) const { return records[n].tdb; }
+    Vector3d position(int n) const { return Map<const Vector3d>(records[n].position); }
+    // Velocities are stored in km/s
+    Vector3d velocity(int n) const { return Map<const Vector3d>(records[n].velocity) * astro::daysToSecs(1.0); }
+
+private:
+    bool map() const;
+    int findSample(double jd) const;
+
+    fs::path filename;
+    TrajectoryInterpolation interpolation;
+    int nSamples;
+    double startTime;
+    double endTime;
+    double boundingRadius;
+
+    mutable std::once_flag mapOnce;
+    mutable celestia::util::MemoryMappedFile file;
+    mutable const XYZVBinaryData* records{ nullptr };
+    mutable SampleTimeIndex timeIndex;
+    mutable std::atomic<int> lastSample{ 0 };
+};
+
+
+MappedOrbitXYZV::MappedOrbitXYZV(const fs::path& _filename,
+                                 TrajectoryInterpolation _interpolation,
+                                 int _nSamples,
+                                 double _startTime,
+                                 double _endTime,
+                                 double _boundingRadius) :
+    filename(_filename),
+    interpolation(_interpolation),
+    nSamples(_nSamples),
+    startTime(_startTime),
+    endTime(_endTime),
+    boundingRadius(_boundingRadius)
+{
+}
+
+
+// Map the file and build the time index on first use. Threads evaluating
+// the orbit at once wait for the first one to finish mapping it.
+bool MappedOrbitXYZV::map() const
+{
+    std::call_once(mapOnce, [this]
+    {
+        std::size_t size = sizeof(XYZVBinaryHeader) + (std::size_t) nSamples * sizeof(XYZVBinaryData);
+        if (!file.open(filename, celestia::util::MemoryMappedFile::AccessHint::Random) || file.size() < size)
         {
-            pos = Vector3d(samples[n - 1].position.x(), samples[n - 1].position.y(), samples[n - 1].position.z());
+            GetLogger()->error(_("Error mapping {}.\n"), filename);
+            file.close();
+            return;
         }
-    }
 
-    // Add correction for Celestia's coordinate system
-    return Vector3d(pos.x(), pos.z(), -pos.y());
+        records = reinterpret_cast<const XYZVBinaryData*>(file.data() + sizeof(XYZVBinaryHeader));
+        timeIndex.build([this](int i) { return time(i); }, nSamples);
+    });
+    return records != nullptr;
 }
 
 
-// Velocity is computed as the derivative of the interpolating function
-// for position.
-template <typename T> Vector3d SampledOrbitXYZV<T>::computeVelocity(double jd) const
+int MappedOrbitXYZV::findSample(double jd) const
 {
-    Vector3d vel(Vector3d::Zero());
+    int sample = timeIndex.find([this](int i) { return time(i); }, nSamples, jd,
+                                lastSample.load(std::memory_order_relaxed));
+    lastSample.store(sample, std::memory_order_relaxed);
+    return sample;
+}
 
-    if (samples.size() >= 2)
-    {
-        SampleXYZV<T> samp;
-        samp.t = jd;
-        int n = lastSample;
 
-        if (n < 1 || n >= (int) samples.size() || jd < samples[n - 1].t || jd > samples[n].t)
-        {
-            typename vector<SampleXYZV<T> >::const_iterator iter = lower_bound(samples.begin(),
-                                                                               samples.end(),
-                                                                               samp);
-            if (iter == samples.end())
-                n = samples.size();
-            else
-                n = iter - samples.begin();
+double MappedOrbitXYZV::getPeriod() const
+{
+    return endTime - startTime;
+}
 
-            lastSample = n;
-        }
 
-        if (n > 0 && n < (int) samples.size())
-        {
-            SampleXYZV<T> s0 = samples[n - 1];
-            SampleXYZV<T> s1 = samples[n];
+bool MappedOrbitXYZV::isPeriodic() const
+{
+    return false;
+}
 
-            if (interpolation == TrajectoryInterpolationLinear)
-            {
-                double h = s1.t - s0.t;
-                vel = Vector3d(s1.position.x() - s0.position.x(),
-                               s1.position.y() - s0.position.y(),
-                               s1.position.z() - s0.position.z()) * (1.0 / h) * astro::daysToSecs(1.0);
-            }
-            else if (interpolation == TrajectoryInterpolationCubic)
-            {
-                double h = s1.t - s0.t;
-                double ih = 1.0 / h;
-                double t = (jd - s0.t) * ih;
 
-                Vector3d p0(s0.position.x(), s0.position.y(), s0.position.z());
-                Vector3d p1(s1.position.x(), s1.position.y(), s1.position.z());
-                Vector3d v0(s0.velocity.x(), s0.velocity.y(), s0.velocity.z());
-                Vector3d v1(s1.velocity.x(), s1.velocity.y(), s1.velocity.z());
+void MappedOrbitXYZV::getValidRange(double& begin, double& end) const
+{
+    begin = startTime;
+    end = endTime;
+}
 
-                vel = cubicInterpolateVelocity(p0, v0 * h, p1, v1 * h, t) * ih;
-            }
-            else
-            {
-                // Unknown interpolation type
-                vel = Vector3d::Zero();
-            }
-        }
-    }
+
+double MappedOrbitXYZV::getBoundingRadius() const
+{
+    return boundingRadius;
+}
+
+
+Vector3d MappedOrbitXYZV::computePosition(double jd) const
+{
+    Vector3d pos = Vector3d::Zero();
+    if (map())
+        pos = XYZVPositionAtTime(*this, nSamples, findSample(jd), jd, interpolation);
+
+    // Add correction for Celestia's coordinate system
+    return Vector3d(pos.x(), pos.z(), -pos.y());
+}
+
+
+void MappedOrbitXYZV::positionsAtTimes(celestia::util::array_view<double> times,
+                                       Vector3d* positions) const
+{
+    for (double t : times)
+        *positions++ = MappedOrbitXYZV::computePosition(t);
+}
+
+
+Vector3d MappedOrbitXYZV::computeVelocity(double jd) const
+{
+    Vector3d vel = Vector3d::Zero();
+    if (nSamples >= 2 && map())
+        vel = XYZVVelocityAtTime(*this, nSamples, findSample(jd), jd, interpolation);
 
     // Add correction for Celestia's coordinate system
     return Vector3d(vel.x(), vel.z(), -vel.y());
 }
 
 
-template <typename T> void SampledOrbitXYZV<T>::sample(double /* startTime */, double /* endTime */,
-                                                       OrbitSampleProc& proc) const
+void MappedOrbitXYZV::sample(double /* startTime */, double /* endTime */,
+                             OrbitSampleProc& proc) const
 {
-    for (const auto& sample : samples)
+    if (!map())
+        return;
+
+    for (int i = 0; i < nSamples; i++)
     {
-        proc.sample(sample.t,
-                    Vector3d(sample.position.x(), sample.position.z(), -sample.position.y()),
-                    Vector3d(sample.velocity.x(), sample.velocity.z(), -sample.velocity.y()));
+        Vector3d p = position(i);
+        Vector3d v = velocity(i);
+        proc.sample(time(i), Vector3d(p.x(), p.z(), -p.y()), Vector3d(v.x(), v.z(), -v.y()));
     }
 }
 
@@ -710,6 +893,25 @@ static bool SkipComments(istream& in)
 }
 
 
+// Parse a number after white space. Returns false at the end of the text
+// or if the text isn't a number.
+static bool ParseNumber(const char*& p, const char* end, double& value)
+{
+    while (p < end && isspace(static_cast<unsigned char>(*p)) != 0)
+        p++;
+    // from_chars doesn't accept a leading plus sign
+    if (p < end && *p == '+')
+        p++;
+
+    auto [ptr, ec] = celestia::compat::from_chars(p, end, value);
+    if (ec != errc())
+        return false;
+
+    p = ptr;
+    return true;
+}
+
+
 // Load an ASCII xyz trajectory file. The file contains records with 4 double
 // precision values each:
 //
@@ -737,27 +939,27 @@ template <typename T> SampledOrbit<T>* LoadSampledOrbit(const fs::path& filename
 
     orbit = new SampledOrbit<T>(interpolation);
 
+    string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    const char* p = text.data();
+    const char* end = p + text.size();
+
     double lastSampleTime = -numeric_limits<double>::infinity();
-    while (in.good())
+    double tdb, x, y, z;
+    while (ParseNumber(p, end, tdb) &&
+           ParseNumber(p, end, x) &&
+           ParseNumber(p, end, y) &&
+           ParseNumber(p, end, z))
     {
-        double tdb, x, y, z;
-        in >> tdb;
-        in >> x;
-        in >> y;
-        in >> z;
-
-        if (in.good())
+        // Skip samples with duplicate times; such trajectories are invalid, but
+        // are unfortunately used in some existing add-ons.
+        if (tdb != lastSampleTime)
         {
-            // Skip samples with duplicate times; such trajectories are invalid, but
-            // are unfortunately used in some existing add-ons.
-            if (tdb != lastSampleTime)
-            {
-                orbit->addSample(tdb, x, y, z);
-                lastSampleTime = tdb;
-            }
+            orbit->addSample(tdb, x, y, z);
+            lastSampleTime = tdb;
         }
     }
 
+    orbit->buildTimeIndex();
     return orbit;
 }
 
@@ -792,57 +994,59 @@ template <typename T> SampledOrbitXYZV<T>* LoadSampledOrbitXYZV(const fs::path&
 
     orbit = new SampledOrbitXYZV<T>(interpolation);
 
+    string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    const char* p = text.data();
+    const char* end = p + text.size();
+
     double lastSampleTime = -numeric_limits<double>::infinity();
-    while (in.good())
+    double tdb = 0.0;
+    Vector3d position;
+    Vector3d velocity;
+    while (ParseNumber(p, end, tdb) &&
+           ParseNumber(p, end, position.x()) &&
+           ParseNumber(p, end, position.y()) &&
+           ParseNumber(p, end, position.z()) &&
+           ParseNumber(p, end, velocity.x()) &&
+           ParseNumber(p, end, velocity.y()) &&
+           ParseNumber(p, end, velocity.z()))
     {
-        double tdb = 0.0;
-        Vector3d position;
-        Vector3d velocity;
-
-        in >> tdb;
-        in >> position.x();
-        in >> position.y();
-        in >> position.z();
-        in >> velocity.x();
-        in >> velocity.y();
-        in >> velocity.z();
-
-        // Convert velocities from km/sec to km/Julian day
-        velocity = velocity * astro::daysToSecs(1.0);
-
-        if (in.good())
+        if (tdb != lastSampleTime)
         {
-            if (tdb != lastSampleTime)
-            {
-                orbit->addSample(tdb, position, velocity);
-                lastSampleTime = tdb;
-            }
+            // Convert velocities from km/sec to km/Julian day
+            orbit->addSample(tdb, position, velocity * astro::daysToSecs(1.0));
+            lastSampleTime = tdb;
         }
     }
 
+    orbit->buildTimeIndex();
     return orbit;
 }
 
-/* Load a binary xyzv sampled trajectory file.
+/* Load a binary xyzv sampled trajectory file. The file is only scanned
+ * here for the range of times and the bounding radius, and it's unmapped
+ * again afterwards; MappedOrbitXYZV maps it when it's first used. Files
+ * with samples out of order or with duplicate times are loaded into memory
+ * instead, skipping the duplicates like the text loaders do.
  */
-template <typename T> SampledOrbitXYZV<T>*
+template <typename T> Orbit*
 LoadSampledOrbitXYZVBinary(const fs::path& filename, TrajectoryInterpolation interpolation)
 {
-    ifstream in(filename, ios::binary);
-    if (!in.good())
+    celestia::util::MemoryMappedFile file;
+    if (!file.open(filename, celestia::util::MemoryMappedFile::AccessHint::Sequential))
     {
         GetLogger()->error(_("Error opening {}.\n"), filename);
         return nullptr;
     }
 
     XYZVBinaryHeader header;
-    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)))
+    if (file.size() < sizeof(header))
     {
         GetLogger()->error(_("Error reading header of {}.\n"), filename);
         return nullptr;
     }
+    memcpy(&header, file.data(), sizeof(header));
 
-    if (string(header.magic) != "CELXYZV")
+    if (string(header.magic, strnlen(header.magic, sizeof(header.magic))) != "CELXYZV")
     {
         GetLogger()->error(_("Bad binary xyzv file {}.\n"), filename);
         return nullptr;
@@ -866,20 +1070,39 @@ LoadSampledOrbitXYZVBinary(const fs::path& filename, TrajectoryInterpolation int
     if (header.count == 0)
         return nullptr;
 
-    SampledOrbitXYZV<T>* orbit = new SampledOrbitXYZV<T>(interpolation);
+    // The count is left at -1 by a writer that didn't finish, so trust
+    // the file size more than it.
+    std::size_t nRecords = (file.size() - sizeof(header)) / sizeof(XYZVBinaryData);
+    if (header.count < nRecords)
+        nRecords = (std::size_t) header.count;
+    if (nRecords == 0 || nRecords > (std::size_t) numeric_limits<int>::max())
+        return nullptr;
 
-    double lastSampleTime = -numeric_limits<T>::infinity();
+    const auto* records = reinterpret_cast<const XYZVBinaryData*>(file.data() + sizeof(header));
+    double boundingRadius = 0.0;
+    bool ordered = true;
+    for (std::size_t i = 0; i < nRecords; i++)
+    {
+        boundingRadius = max(boundingRadius, Map<const Vector3d>(records[i].position).norm());
+        if (i > 0 && !(records[i].tdb > records[i - 1].tdb))
+            ordered = false;
+    }
 
-    while (in.good())
+    if (ordered)
     {
-        XYZVBinaryData data;
+        return new MappedOrbitXYZV(filename, interpolation, (int) nRecords,
+                                   records[0].tdb, records[nRecords - 1].tdb,
+                                   boundingRadius);
+    }
 
-        if (!in.read(reinterpret_cast<char*>(&data), sizeof(data)))
-            break;
+    auto* orbit = new SampledOrbitXYZV<T>(interpolation);
 
-        double tdb = data.tdb;
-        Vector3d position = Map<Vector3d>(data.position);
-        Vector3d velocity = Map<Vector3d>(data.velocity);
+    double lastSampleTime = -numeric_limits<T>::infinity();
+    for (std::size_t i = 0; i < nRecords; i++)
+    {
+        double tdb = records[i].tdb;
+        Vector3d position = Map<const Vector3d>(records[i].position);
+        Vector3d velocity = Map<const Vector3d>(records[i].velocity);
 
         // Convert velocities from km/sec to km/Julian day
         velocity *= astro::daysToSecs(1.0);
@@ -891,6 +1114,7 @@ LoadSampledOrbitXYZVBinary(const fs::path& filename, TrajectoryInterpolation int
         }
     }
 
+    orbit->buildTimeIndex();
     return orbit;
 }
 
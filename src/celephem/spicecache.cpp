@@ -0,0 +1,284 @@
+// spicecache.cpp
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "spicecache.h"
+#include "spiceinterface.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <celcompat/numbers.h>
+
+using namespace Eigen;
+
+
+namespace
+{
+
+// Segments are halved at most this many times
+constexpr int MaxLevel = 12;
+
+// When a body has more segments than this, the cache is emptied so that it
+// doesn't grow without limit.
+constexpr std::size_t MaxCachedSegments = 1024;
+
+// Valid ranges are limited to this many days from 0, so that the indices of
+// the segments fit in their keys
+constexpr double MaxTime = 1.0e9;
+
+// Positions in the segment, from -1 to 1, where the fit is checked; none of
+// them is a Chebyshev node
+constexpr std::array<double, 4> CheckPoints = { -1.0, -0.5, 0.5, 1.0 };
+
+std::uint64_t
+makeKey(int level, std::int64_t index)
+{
+    return (static_cast<std::uint64_t>(index) << 5) | static_cast<std::uint64_t>(level);
+}
+
+// Evaluate the Chebyshev series c[0] / 2 + sum c[i] T_i(x) of n terms with
+// Clenshaw's recurrence
+Vector4d
+evaluateSeries(const Vector4d* c, std::size_t n, double x)
+{
+    Vector4d b1 = Vector4d::Zero();
+    Vector4d b2 = Vector4d::Zero();
+    for (std::size_t i = n - 1; i > 0; i--)
+    {
+        Vector4d b0 = 2.0 * x * b1 - b2 + c[i];
+        b2 = b1;
+        b1 = b0;
+    }
+
+    return x * b1 - b2 + 0.5 * c[0];
+}
+
+} // end unnamed namespace
+
+
+SpiceSegmentCache::SpiceSegmentCache(SampleFunction sample,
+                                     ErrorFunction error,
+                                     double segmentLength,
+                                     double begin,
+                                     double end,
+                                     bool antipodal) :
+    state(std::make_shared<State>())
+{
+    assert(segmentLength > 0.0);
+    state->sample = std::move(sample);
+    state->error = std::move(error);
+    state->segmentLength = segmentLength;
+    state->begin = std::clamp(begin, -MaxTime, MaxTime);
+    state->end = std::clamp(end, -MaxTime, MaxTime);
+    state->antipodal = antipodal;
+}
+
+
+Vector4d
+SpiceSegmentCache::value(double jd) const
+{
+    return evaluate(jd, false);
+}
+
+
+Vector4d
+SpiceSegmentCache::derivative(double jd) const
+{
+    return evaluate(jd, true);
+}
+
+
+Vector4d
+SpiceSegmentCache::evaluate(double jd, bool derivative) const
+{
+    jd = std::clamp(jd, state->begin, state->end);
+
+    int level = 0;
+    for (;;)
+    {
+        double length = std::ldexp(state->segmentLength, -level);
+        auto index = static_cast<std::int64_t>(std::floor(jd / length));
+        // The end of the valid range belongs to the segment before it
+        if (static_cast<double>(index) * length >= state->end && jd > state->begin)
+            index--;
+        std::uint64_t key = makeKey(level, index);
+
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            auto iter = state->segments.find(key);
+            if (iter != state->segments.end())
+            {
+                const Segment& segment = iter->second;
+                if (segment.split)
+                {
+                    level++;
+                    continue;
+                }
+
+                bool moved = key != state->lastKey;
+                state->lastKey = key;
+
+                double scale = 2.0 / (segment.end - segment.start);
+                double x = std::clamp((jd - segment.start) * scale - 1.0, -1.0, 1.0);
+                Vector4d result = derivative
+                    ? evaluateSeries(segment.derivative.data(), Degree, x) * scale
+                    : evaluateSeries(segment.value.data(), Degree + 1, x);
+
+                if (moved && !state->prefetching)
+                    prefetch(state, level, index);
+
+                return result;
+            }
+        }
+
+        // The segment isn't cached yet; fit it without holding the lock, as
+        // a background fit may be waiting for it.
+        Segment segment;
+        CallSpice([&]() { segment = state->fit(level, index); });
+        state->insert(key, std::move(segment));
+    }
+}
+
+
+// Fit the segments on both sides of the one at level and index on the
+// SPICE thread. Must be called with the lock held.
+void
+SpiceSegmentCache::prefetch(const std::shared_ptr<State>& state, int level, std::int64_t index)
+{
+    std::array<std::int64_t, 2> neighbors = { index + 1, index - 1 };
+    bool missing = false;
+    for (std::int64_t neighbor : neighbors)
+    {
+        if (state->inRange(level, neighbor) && state->segments.count(makeKey(level, neighbor)) == 0)
+            missing = true;
+    }
+    if (!missing)
+        return;
+
+    state->prefetching = true;
+    std::weak_ptr<State> weakState = state;
+    PostSpice([weakState, level, neighbors]()
+    {
+        std::shared_ptr<State> state = weakState.lock();
+        if (state == nullptr)
+            return;
+
+        for (std::int64_t neighbor : neighbors)
+        {
+            if (!state->inRange(level, neighbor))
+                continue;
+
+            std::uint64_t key = makeKey(level, neighbor);
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (state->segments.count(key) != 0)
+                    continue;
+            }
+            state->insert(key, state->fit(level, neighbor));
+        }
+
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->prefetching = false;
+    });
+}
+
+
+bool
+SpiceSegmentCache::State::inRange(int level, std::int64_t index) const
+{
+    double length = std::ldexp(segmentLength, -level);
+    return static_cast<double>(index + 1) * length > begin && static_cast<double>(index) * length < end;
+}
+
+
+void
+SpiceSegmentCache::State::insert(std::uint64_t key, Segment&& segment)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (segments.size() >= MaxCachedSegments)
+    {
+        segments.clear();
+        lastKey = ~std::uint64_t(0);
+    }
+    segments.emplace(key, std::move(segment));
+}
+
+
+// Interpolate the function at the Chebyshev nodes of the segment, clipped to
+// the valid range, and check the result between the nodes. Runs on the
+// SPICE thread.
+SpiceSegmentCache::Segment
+SpiceSegmentCache::State::fit(int level, std::int64_t index) const
+{
+    constexpr int N = Degree + 1;
+
+    double length = std::ldexp(segmentLength, -level);
+    Segment segment;
+    segment.start = std::max(static_cast<double>(index) * length, begin);
+    segment.end = std::min(static_cast<double>(index + 1) * length, end);
+    segment.split = false;
+
+    double halfLength = 0.5 * (segment.end - segment.start);
+    double center = segment.start + halfLength;
+    if (!(halfLength > 0.0))
+    {
+        // A valid range of a single instant
+        segment.value.fill(Vector4d::Zero());
+        segment.derivative.fill(Vector4d::Zero());
+        segment.value[0] = 2.0 * sample(segment.start);
+        segment.end = segment.start + 1.0;
+        return segment;
+    }
+
+    std::array<Vector4d, N> samples;
+    for (int k = 0; k < N; k++)
+    {
+        double x = std::cos(celestia::numbers::pi * (k + 0.5) / N);
+        samples[k] = sample(center + x * halfLength);
+        if (antipodal && k > 0 && samples[k].dot(samples[k - 1]) < 0.0)
+            samples[k] = -samples[k];
+    }
+
+    for (int j = 0; j < N; j++)
+    {
+        Vector4d sum = Vector4d::Zero();
+        for (int k = 0; k < N; k++)
+            sum += samples[k] * std::cos(celestia::numbers::pi * j * (k + 0.5) / N);
+        segment.value[j] = sum * (2.0 / N);
+    }
+
+    if (level < MaxLevel)
+    {
+        for (double x : CheckPoints)
+        {
+            Vector4d fitted = evaluateSeries(segment.value.data(), N, x);
+            Vector4d exact = sample(center + x * halfLength);
+            double e = error(fitted, exact);
+            if (antipodal)
+                e = std::min(e, error(fitted, -exact));
+            if (!(e <= 1.0))
+            {
+                segment.split = true;
+                return segment;
+            }
+        }
+    }
+
+    // Coefficients of the derivative, in the same form as the values
+    Vector4d next = Vector4d::Zero();
+    Vector4d current = Vector4d::Zero();
+    for (int j = Degree - 1; j >= 0; j--)
+    {
+        Vector4d d = next + (2.0 * (j + 1)) * segment.value[j + 1];
+        next = current;
+        current = d;
+        segment.derivative[j] = d;
+    }
+
+    return segment;
+}
@@ -0,0 +1,97 @@
+// spicecache.h
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <Eigen/Core>
+
+
+/*! A cache of Chebyshev approximations of a function of time that is
+ *  computed by CSPICE, such as the position of a SPICE orbit or the
+ *  orientation of a SPICE frame.
+ *
+ *  The time line is divided into segments of a base length. The polynomials
+ *  for a segment are fitted to samples taken on the SPICE thread the first
+ *  time a value in it is requested, and checked against a few more samples;
+ *  segments that miss the tolerance, e.g. across a maneuver, are split in
+ *  halves. Whenever the requests move to a new segment the ones next to it
+ *  are fitted in the background, so that time running forwards or backwards
+ *  rarely has to wait for CSPICE.
+ *
+ *  Values are up to four components; the cache can be used from any thread.
+ */
+class SpiceSegmentCache
+{
+ public:
+    static constexpr int Degree = 12;
+
+    // Sample the function at a time; always called on the SPICE thread
+    using SampleFunction = std::function<Eigen::Vector4d(double)>;
+    // The error of a fitted value compared to a sample, in units of the
+    // tolerance
+    using ErrorFunction = std::function<double(const Eigen::Vector4d&, const Eigen::Vector4d&)>;
+
+    /*! Values v and -v are the same when antipodal is true, as they are for
+     *  quaternions; samples are then flipped to be continuous before they
+     *  are fitted.
+     */
+    SpiceSegmentCache(SampleFunction sample,
+                      ErrorFunction error,
+                      double segmentLength,
+                      double begin,
+                      double end,
+                      bool antipodal = false);
+    ~SpiceSegmentCache() = default;
+
+    Eigen::Vector4d value(double jd) const;
+    // The derivative of the value per day
+    Eigen::Vector4d derivative(double jd) const;
+
+ private:
+    struct Segment
+    {
+        double start;
+        double end;
+        // Segments that missed the tolerance are replaced by their halves
+        bool split;
+        std::array<Eigen::Vector4d, Degree + 1> value;
+        std::array<Eigen::Vector4d, Degree> derivative;
+    };
+
+    // Shared with the background fits, which may outlive the cache
+    struct State
+    {
+        SampleFunction sample;
+        ErrorFunction error;
+        double segmentLength;
+        double begin;
+        double end;
+        bool antipodal;
+
+        std::mutex mutex;
+        std::unordered_map<std::uint64_t, Segment> segments;
+        std::uint64_t lastKey{ ~std::uint64_t(0) };
+        bool prefetching{ false };
+
+        Segment fit(int level, std::int64_t index) const;
+        bool inRange(int level, std::int64_t index) const;
+        void insert(std::uint64_t key, Segment&& segment);
+    };
+
+    Eigen::Vector4d evaluate(double jd, bool derivative) const;
+    static void prefetch(const std::shared_ptr<State>& state, int level, std::int64_t index);
+
+    std::shared_ptr<State> state;
+};
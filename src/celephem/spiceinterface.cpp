@@ -11,9 +11,14 @@
 
 #include "SpiceUsr.h"
 #include "spiceinterface.h"
-#include <iostream>
+#include <condition_variable>
 #include <cstdio>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <mutex>
 #include <set>
+#include <thread>
 #include <celutil/logger.h>
 
 using namespace std;
@@ -22,10 +27,111 @@ using celestia::util::GetLogger;
 
 // Track loaded SPICE kernels in order to avoid loading the same kernel
 // multiple times. This is a global variable because SPICE uses a global
-// kernel pool.
+// kernel pool. It's only used on the SPICE thread.
 static set<fs::path> ResidentSpiceKernels;
 
 
+namespace
+{
+
+class SpiceThread
+{
+ public:
+    SpiceThread() :
+        thread(&SpiceThread::run, this)
+    {
+    }
+
+    ~SpiceThread()
+    {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            done = true;
+        }
+        ready.notify_one();
+        thread.join();
+    }
+
+    bool isCurrent() const
+    {
+        return this_thread::get_id() == thread.get_id();
+    }
+
+    void push(function<void()>&& task, bool wait)
+    {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            (wait ? waitingTasks : backgroundTasks).push_back(move(task));
+        }
+        ready.notify_one();
+    }
+
+ private:
+    void run()
+    {
+        for (;;)
+        {
+            function<void()> task;
+            {
+                unique_lock<mutex> lock(queueMutex);
+                ready.wait(lock, [this]() { return done || !waitingTasks.empty() || !backgroundTasks.empty(); });
+                if (done)
+                    return;
+
+                auto& tasks = waitingTasks.empty() ? backgroundTasks : waitingTasks;
+                task = move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    mutex queueMutex;
+    condition_variable ready;
+    deque<function<void()>> waitingTasks;
+    deque<function<void()>> backgroundTasks;
+    bool done{ false };
+    std::thread thread;
+};
+
+
+SpiceThread& GetSpiceThread()
+{
+    static SpiceThread spiceThread;
+    return spiceThread;
+}
+
+} // end unnamed namespace
+
+
+/*! Run f on the SPICE thread and wait for it to return. Calls from the
+ *  SPICE thread itself run immediately.
+ */
+void CallSpice(const function<void()>& f)
+{
+    SpiceThread& spiceThread = GetSpiceThread();
+    if (spiceThread.isCurrent())
+    {
+        f();
+        return;
+    }
+
+    packaged_task<void()> task(f);
+    future<void> result = task.get_future();
+    spiceThread.push([&task]() { task(); }, true);
+    result.get();
+}
+
+
+/*! Queue f to run on the SPICE thread when there are no calls waiting for
+ *  it. Pending functions are dropped when Celestia exits.
+ */
+void PostSpice(function<void()> f)
+{
+    GetSpiceThread().push(move(f), false);
+}
+
+
 /*! Perform one-time initialization of SPICE.
  */
 bool
@@ -33,7 +139,7 @@ InitializeSpice()
 {
     // Set the error behavior to the RETURN action, so that
     // Celestia do its own handling of SPICE errors.
-    erract_c("SET", 0, (SpiceChar*)"RETURN");
+    CallSpice([]() { erract_c("SET", 0, (SpiceChar*)"RETURN"); });
 
     return true;
 }
@@ -52,7 +158,7 @@ bool GetNaifId(const string& name, int* id)
     // an error if we do.
     if (!name.empty())
     {
-        bodn2c_c(name.c_str(), &spiceID, &found);
+        CallSpice([&]() { bodn2c_c(name.c_str(), &spiceID, &found); });
         if (found)
         {
             *id = (int) spiceID;
@@ -78,7 +184,9 @@ bool GetNaifId(const string& name, int* id)
  */
 bool IsSpiceKernelLoaded(const fs::path& filepath)
 {
-    return ResidentSpiceKernels.find(filepath) != ResidentSpiceKernels.end();
+    bool loaded = false;
+    CallSpice([&]() { loaded = ResidentSpiceKernels.find(filepath) != ResidentSpiceKernels.end(); });
+    return loaded;
 }
 
 
@@ -87,29 +195,34 @@ bool IsSpiceKernelLoaded(const fs::path& filepath)
  */
 bool LoadSpiceKernel(const fs::path& filepath)
 {
-    // Only load the kernel if it is not already resident. Note that this detection
-    // of duplicate kernels will not work if a file was originally loaded through
-    // a metakernel.
-    if (IsSpiceKernelLoaded(filepath))
-        return true;
+    bool loaded = true;
+    CallSpice([&]()
+    {
+        // Only load the kernel if it is not already resident. Note that this detection
+        // of duplicate kernels will not work if a file was originally loaded through
+        // a metakernel.
+        if (IsSpiceKernelLoaded(filepath))
+            return;
 
-    ResidentSpiceKernels.insert(filepath);
-    furnsh_c(filepath.string().c_str());
+        ResidentSpiceKernels.insert(filepath);
+        furnsh_c(filepath.string().c_str());
 
-    // If there was an error loading the kernel, dump the error message.
-    if (failed_c())
-    {
-        char errMsg[1024];
-        getmsg_c("long", sizeof(errMsg), errMsg);
-        GetLogger()->error("{}\n", errMsg);
+        // If there was an error loading the kernel, dump the error message.
+        if (failed_c())
+        {
+            char errMsg[1024];
+            getmsg_c("long", sizeof(errMsg), errMsg);
+            GetLogger()->error("{}\n", errMsg);
 
-        // Reset the SPICE error state so that future calls to
-        // SPICE can still succeed.
-        reset_c();
+            // Reset the SPICE error state so that future calls to
+            // SPICE can still succeed.
+            reset_c();
 
-        return false;
-    }
+            loaded = false;
+            return;
+        }
 
-     GetLogger()->info("Loaded SPK file {}\n", filepath);
-     return true;
+        GetLogger()->info("Loaded SPK file {}\n", filepath);
+    });
+    return loaded;
 }
@@ -12,11 +12,20 @@
 #ifndef _CELENGINE_SPICEINTERFACE_H_
 #define _CELENGINE_SPICEINTERFACE_H_
 
+#include <functional>
 #include <string>
 #include <celcompat/filesystem.h>
 
 extern bool InitializeSpice();
 
+// CSPICE isn't thread safe and keeps its error state in globals, so all of
+// the calls to it are made on a single thread. CallSpice() runs a function
+// there and waits for it, PostSpice() queues one to run in the background
+// after the waiting calls.
+
+extern void CallSpice(const std::function<void()>& f);
+extern void PostSpice(std::function<void()> f);
+
 // SPICE utility functions
 
 extern bool GetNaifId(const std::string& name, int* id);
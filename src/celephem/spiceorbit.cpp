@@ -24,6 +24,49 @@ using celestia::util::GetLogger;
 
 static const double MILLISEC = astro::secsToDays(0.001);
 
+// The error allowed in the positions interpolated from the cache: a meter,
+// plus a part in 10^10 of the distance from the origin
+static const double POSITION_TOLERANCE = 1.0e-3;
+static const double RELATIVE_POSITION_TOLERANCE = 1.0e-10;
+
+// Length of the cached segments of aperiodic orbits, in days
+static const double SEGMENT_LENGTH = 1.0;
+
+
+// Compute the position of the target relative to the origin in Celestia's
+// coordinate system. Called on the SPICE thread.
+static Vector4d
+spicePosition(int targetID, int originID, double jd)
+{
+    // Input time for SPICE is seconds after J2000
+    double t = astro::daysToSecs(jd - astro::J2000);
+    double position[3];
+    double lt;          // One way light travel time
+
+    spkgps_c(targetID,
+             t,
+             "eclipj2000",
+             originID,
+             position,
+             &lt);
+
+    // This shouldn't happen, since we've already computed the valid
+    // coverage interval.
+    if (failed_c())
+    {
+        // Print the error message
+        char errMsg[1024];
+        getmsg_c("long", sizeof(errMsg), errMsg);
+        GetLogger()->warn("{}\n", errMsg);
+
+        // Reset the error state
+        reset_c();
+    }
+
+    // Transform into Celestia's coordinate system
+    return Vector4d(position[0], position[2], -position[1], 0.0);
+}
+
 /*! Create a new SPICE orbit using with a valid interval specified
  *  by beginning and ending.
  */
@@ -88,6 +131,32 @@ SpiceOrbit::getPeriod() const
 bool
 SpiceOrbit::init(const fs::path& path,
                  const list<string>* requiredKernels)
+{
+    bool ok = false;
+    CallSpice([&]() { ok = initSpice(path, requiredKernels); });
+    if (!ok)
+        return false;
+
+    int target = targetID;
+    int origin = originID;
+    cache = std::make_unique<SpiceSegmentCache>(
+        [target, origin](double jd) { return spicePosition(target, origin, jd); },
+        [](const Vector4d& fitted, const Vector4d& sampled)
+        {
+            return (fitted - sampled).norm() /
+                   (POSITION_TOLERANCE + RELATIVE_POSITION_TOLERANCE * sampled.norm());
+        },
+        isPeriodic() ? period / 16.0 : SEGMENT_LENGTH,
+        validIntervalBegin,
+        validIntervalEnd);
+
+    return true;
+}
+
+
+bool
+SpiceOrbit::initSpice(const fs::path& path,
+                      const list<string>* requiredKernels)
 {
     // Load required kernel files
     if (requiredKernels != nullptr)
@@ -236,91 +305,22 @@ SpiceOrbit::init(const fs::path& path,
 Vector3d
 SpiceOrbit::computePosition(double jd) const
 {
-    if (jd < validIntervalBegin)
-        jd = validIntervalBegin;
-    else if (jd > validIntervalEnd)
-        jd = validIntervalEnd;
-
-    if (spiceErr)
-    {
+    if (spiceErr || cache == nullptr)
         return Vector3d::Zero();
-    }
-    else
-    {
-        // Input time for SPICE is seconds after J2000
-        double t = astro::daysToSecs(jd - astro::J2000);
-        double position[3];
-        double lt;          // One way light travel time
-
-        spkgps_c(targetID,
-                 t,
-                 "eclipj2000",
-                 originID,
-                 position,
-                 &lt);
-
-        // This shouldn't happen, since we've already computed the valid
-        // coverage interval.
-        if (failed_c())
-        {
-            // Print the error message
-            char errMsg[1024];
-            getmsg_c("long", sizeof(errMsg), errMsg);
-            GetLogger()->warn("{}\n", errMsg);
-
-            // Reset the error state
-            reset_c();
-        }
 
-        // Transform into Celestia's coordinate system
-        return Vector3d(position[0], position[2], -position[1]);
-    }
+    // The cache clamps the time to the valid interval
+    return cache->value(jd).head<3>();
 }
 
 
 Vector3d
 SpiceOrbit::computeVelocity(double jd) const
 {
-    if (jd < validIntervalBegin)
-        jd = validIntervalBegin;
-    else if (jd > validIntervalEnd)
-        jd = validIntervalEnd;
-
-    if (spiceErr)
-    {
+    if (spiceErr || cache == nullptr)
         return Vector3d::Zero();
-    }
-    else
-    {
-        // Input time for SPICE is seconds after J2000
-        double t = astro::daysToSecs(jd - astro::J2000);
-        double state[6];
-        double lt;          // One way light travel time
-
-        spkgeo_c(targetID,
-                 t,
-                 "eclipj2000",
-                 originID,
-                 state,
-                 &lt);
-
-        // This shouldn't happen, since we've already computed the valid
-        // coverage interval.
-        if (failed_c())
-        {
-            // Print the error message
-            char errMsg[1024];
-            getmsg_c("long", sizeof(errMsg), errMsg);
-            GetLogger()->warn("{}\n", errMsg);
-
-            // Reset the error state
-            reset_c();
-        }
 
-        // Transform into Celestia's coordinate system, and from km/s to km/day
-        double d2s = astro::daysToSecs(1.0);
-        return Vector3d(state[3] * d2s, state[5] * d2s, -state[4] * d2s);
-    }
+    // The derivative of the cached positions is already in km/day
+    return cache->derivative(jd).head<3>();
 }
 
 
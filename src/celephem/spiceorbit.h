@@ -13,8 +13,10 @@
 #define _CELENGINE_SPICEORBIT_H_
 
 #include "orbit.h"
+#include "spicecache.h"
 #include <string>
 #include <list>
+#include <memory>
 #include <celcompat/filesystem.h>
 
 
@@ -38,6 +40,7 @@ class SpiceOrbit : public CachingOrbit
 
     virtual bool isPeriodic() const;
     virtual double getPeriod() const;
+    virtual bool isThreadSafe() const { return false; }
 
     virtual double getBoundingRadius() const
     {
@@ -50,6 +53,9 @@ class SpiceOrbit : public CachingOrbit
     virtual void getValidRange(double& begin, double& end) const;
 
  private:
+    bool initSpice(const fs::path& path,
+                   const std::list<std::string>* requiredKernels);
+
     const std::string targetBodyName;
     const std::string originName;
     double period;
@@ -64,6 +70,9 @@ class SpiceOrbit : public CachingOrbit
     double validIntervalEnd;
 
     bool useDefaultTimeInterval;
+
+    // Positions are interpolated from segments fitted to CSPICE
+    std::unique_ptr<SpiceSegmentCache> cache;
 };
 
 #endif // _CELENGINE_SPICEORBIT_H_
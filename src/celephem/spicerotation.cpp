@@ -31,6 +31,53 @@ static const double MILLISEC = astro::secsToDays(0.001);
 static const Quaterniond Rx90 = XRotation(celestia::numbers::pi / 2.0);
 static const Quaterniond Ry180 = YRotation(celestia::numbers::pi);
 
+// The error allowed in the orientations interpolated from the cache, in
+// radians
+static const double ROTATION_TOLERANCE = 1.0e-8;
+
+// Length of the cached segments of aperiodic rotations, in days
+static const double SEGMENT_LENGTH = 1.0 / 16.0;
+
+
+// Compute the orientation of the frame relative to the base frame in
+// Celestia's coordinate system, as the coefficients of a quaternion. Called
+// on the SPICE thread.
+static Vector4d
+spiceOrientation(const string& frameName, const string& baseFrameName, double jd)
+{
+    // Input time for SPICE is seconds after J2000
+    double t = astro::daysToSecs(jd - astro::J2000);
+    double xform[3][3];
+
+    pxform_c(frameName.c_str(), baseFrameName.c_str(), t, xform);
+
+    if (failed_c())
+    {
+        // Print the error message
+        char errMsg[1024];
+        getmsg_c("long", sizeof(errMsg), errMsg);
+        GetLogger()->error("{}\n", errMsg);
+
+        // Reset the error state
+        reset_c();
+    }
+
+    // Eigen stores matrices in column-major order...
+    double matrixData[9] =
+    {
+        xform[0][0], xform[0][1], xform[0][2],
+        xform[1][0], xform[1][1], xform[1][2],
+        xform[2][0], xform[2][1], xform[2][2]
+    };
+
+    // ...but Celestia's rotations are reversed, thus the extra
+    // call to conjugate()
+    Quaterniond q = Quaterniond(Map<Matrix3d>(matrixData)).conjugate();
+
+    // Transform into Celestia's coordinate system
+    return (Ry180 * Rx90.conjugate() * q.conjugate() * Rx90).coeffs();
+}
+
 /*! Create a new rotation model based on a SPICE frame. The
  *  orientation of the rotation model is the orientation of the
  *  named SPICE frame relative to the base frame orientation.
@@ -97,6 +144,34 @@ SpiceRotation::getPeriod() const
 bool
 SpiceRotation::init(const fs::path& path,
                     const list<string>* requiredKernels)
+{
+    bool ok = false;
+    CallSpice([&]() { ok = initSpice(path, requiredKernels); });
+    if (!ok)
+        return false;
+
+    string frameName = m_frameName;
+    string baseFrameName = m_baseFrameName;
+    m_cache = std::make_unique<SpiceSegmentCache>(
+        [frameName, baseFrameName](double jd) { return spiceOrientation(frameName, baseFrameName, jd); },
+        // For small differences, the angle is twice the distance between
+        // the quaternions
+        [](const Vector4d& fitted, const Vector4d& sampled)
+        {
+            return 2.0 * (fitted - sampled).norm() / ROTATION_TOLERANCE;
+        },
+        isPeriodic() ? m_period / 16.0 : SEGMENT_LENGTH,
+        m_validIntervalBegin,
+        m_validIntervalEnd,
+        true);
+
+    return true;
+}
+
+
+bool
+SpiceRotation::initSpice(const fs::path& path,
+                         const list<string>* requiredKernels)
 {
     // Load required kernel files
     if (requiredKernels != nullptr)
@@ -139,47 +214,11 @@ SpiceRotation::init(const fs::path& path,
 Quaterniond
 SpiceRotation::computeSpin(double jd) const
 {
-    if (jd < m_validIntervalBegin)
-        jd = m_validIntervalBegin;
-    else if (jd > m_validIntervalEnd)
-        jd = m_validIntervalEnd;
-
-    if (m_spiceErr)
-    {
+    if (m_spiceErr || m_cache == nullptr)
         return Quaterniond::Identity();
-    }
-    else
-    {
-        // Input time for SPICE is seconds after J2000
-        double t = astro::daysToSecs(jd - astro::J2000);
-        double xform[3][3];
-
-        pxform_c(m_frameName.c_str(), m_baseFrameName.c_str(), t, xform);
-
-        if (failed_c())
-        {
-            // Print the error message
-            char errMsg[1024];
-            getmsg_c("long", sizeof(errMsg), errMsg);
-            GetLogger()->error("{}\n", errMsg);
-
-            // Reset the error state
-            reset_c();
-        }
-
-        // Eigen stores matrices in column-major order...
-        double matrixData[9] =
-        {
-            xform[0][0], xform[0][1], xform[0][2],
-            xform[1][0], xform[1][1], xform[1][2],
-            xform[2][0], xform[2][1], xform[2][2]
-        };
 
-        // ...but Celestia's rotations are reversed, thus the extra
-        // call to conjugate()
-        Quaterniond q = Quaterniond(Map<Matrix3d>(matrixData)).conjugate();
-
-        // Transform into Celestia's coordinate system
-        return Ry180 * Rx90.conjugate() * q.conjugate() * Rx90;
-    }
+    // The cache clamps the time to the valid interval
+    Quaterniond q;
+    q.coeffs() = m_cache->value(jd);
+    return q.normalized();
 }
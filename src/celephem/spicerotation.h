@@ -14,8 +14,10 @@
 #define _CELENGINE_SPICEROTATION_H_
 
 #include "rotation.h"
+#include "spicecache.h"
 #include <string>
 #include <list>
+#include <memory>
 #include <celcompat/filesystem.h>
 
 class SpiceRotation : public CachingRotationModel
@@ -36,6 +38,7 @@ class SpiceRotation : public CachingRotationModel
 
     bool isPeriodic() const;
     double getPeriod() const;
+    bool isThreadSafe() const { return false; }
 
     // No notion of an equator for SPICE rotation models
     Eigen::Quaterniond computeEquatorOrientation(double /* tdb */) const
@@ -46,6 +49,9 @@ class SpiceRotation : public CachingRotationModel
     Eigen::Quaterniond computeSpin(double jd) const;
 
  private:
+    bool initSpice(const fs::path& path,
+                   const std::list<std::string>* requiredKernels);
+
     const std::string m_frameName;
     const std::string m_baseFrameName;
     double m_period;
@@ -53,6 +59,9 @@ class SpiceRotation : public CachingRotationModel
     double m_validIntervalBegin;
     double m_validIntervalEnd;
     bool m_useDefaultTimeInterval;
+
+    // Orientations are interpolated from segments fitted to CSPICE
+    std::unique_ptr<SpiceSegmentCache> m_cache;
 };
 
 #endif // _CELENGINE_SPICEROTATION_H_
@@ -12,7 +12,11 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstdint>
+#include <vector>
 #include <celcompat/numbers.h>
 #include <celmath/mathlib.h>
 #include <celengine/astro.h>
@@ -10999,28 +11003,209 @@ static VSOPSeries sun_Z[] = {
 };
 
 
-static double SumSeries(const VSOPSeries& series, double t)
+// Cosines of arguments up to this size are computed by VectorCos; the
+// products of the quadrant number and PiOver2Hi/PiOver2Mid are exact for
+// quadrants below 2^20. This covers the arguments of the series over the
+// range in which they're used, |t| <= 2 millennia.
+static constexpr double MaxVectorCosArgument = 1.0e6;
+
+// pi/2 split into three parts with 33, 33 and 53 bits (Cody & Waite)
+static constexpr double PiOver2Hi  = 1.57079632673412561417e+00;
+static constexpr double PiOver2Mid = 6.07710050630396597660e-11;
+static constexpr double PiOver2Lo  = 2.02226624879595063154e-21;
+static constexpr double TwoOverPi  = 6.36619772367581382433e-01;
+
+/*! Compute out[i] = cos(x[i]) for n arguments. Unlike std::cos there are
+ *  no branches or calls in the main loop, so that compilers can vectorize
+ *  it. The arguments are reduced to [-pi/4, pi/4], where sine and cosine
+ *  are approximated by the polynomials of fdlibm, with an absolute error
+ *  of a few units of the last place.
+ */
+static void VectorCos(const double* x, double* out, std::size_t n)
+{
+    int large = 0;
+    for (std::size_t i = 0; i < n; i++)
+    {
+        double y = x[i] * TwoOverPi;
+        auto k = (std::int32_t) (y + std::copysign(0.5, y));
+        auto kd = (double) k;
+        double r = ((x[i] - kd * PiOver2Hi) - kd * PiOver2Mid) - kd * PiOver2Lo;
+        double z = r * r;
+
+        double c = 1.0 - 0.5 * z + z * z * (4.16666666666666019037e-02 +
+                   z * (-1.38888888888741095749e-03 +
+                   z * (2.48015872894767294178e-05 +
+                   z * (-2.75573143513906633035e-07 +
+                   z * (2.08757232129817482790e-09 +
+                   z * -1.13596475577881948265e-11)))));
+        double s = r + r * z * (-1.66666666666666324348e-01 +
+                   z * (8.33333333332248946124e-03 +
+                   z * (-1.98412698298579493134e-04 +
+                   z * (2.75573137070700676789e-06 +
+                   z * (-2.50507602534068634195e-08 +
+                   z * 1.58969099521155010221e-10)))));
+
+        // cos(r + k pi/2) is cos r, -sin r, -cos r and sin r in the four
+        // quadrants; the selection is done arithmetically to avoid branches
+        auto odd = (double) (k & 1);
+        auto negative = (double) (((k + 1) >> 1) & 1);
+        out[i] = (1.0 - 2.0 * negative) * (c + odd * (s - c));
+        large |= (int) (std::abs(x[i]) > MaxVectorCosArgument);
+    }
+
+    if (large != 0)
+    {
+        for (std::size_t i = 0; i < n; i++)
+        {
+            if (std::abs(x[i]) > MaxVectorCosArgument)
+                out[i] = std::cos(x[i]);
+        }
+    }
+}
+
+
+// Series terms laid out as a structure of arrays for VectorCos
+struct VSOPSeriesSoA
+{
+    std::vector<double> A, B, C;
+};
+
+// A coordinate is a polynomial in t with the sums of series as coefficients
+using VSOPCoordinate = std::vector<VSOPSeriesSoA>;
+
+// Number of terms or times evaluated in one call to VectorCos
+static constexpr std::size_t VSOPBlockSize = 64;
+
+
+// Copy the series of a coordinate, dropping terms with an amplitude (in AU
+// or radians) below precision.
+static VSOPCoordinate MakeCoordinate(const VSOPSeries* series, int nSeries, double precision)
+{
+    VSOPCoordinate coord(nSeries);
+    for (int i = 0; i < nSeries; i++)
+    {
+        const VSOPTerm* term = series[i].terms;
+        for (int j = 0; j < series[i].nTerms; j++, term++)
+        {
+            if (std::abs(term->A) < precision)
+                continue;
+            coord[i].A.push_back(term->A);
+            coord[i].B.push_back(term->B);
+            coord[i].C.push_back(term->C);
+        }
+    }
+
+    return coord;
+}
+
+
+static double SumSeries(const VSOPSeriesSoA& series, double t)
 {
-    if (series.nTerms < 1)
-        return 0.0;
+    std::array<double, VSOPBlockSize> args;
+    std::array<double, VSOPBlockSize> cosines;
+
+    double x = 0.0;
+    std::size_t nTerms = series.A.size();
+    for (std::size_t base = 0; base < nTerms; base += VSOPBlockSize)
+    {
+        std::size_t n = std::min(VSOPBlockSize, nTerms - base);
+        const double* A = series.A.data() + base;
+        const double* B = series.B.data() + base;
+        const double* C = series.C.data() + base;
+
+        for (std::size_t j = 0; j < n; j++)
+            args[j] = B[j] + C[j] * t;
+        VectorCos(args.data(), cosines.data(), n);
+        for (std::size_t j = 0; j < n; j++)
+            x += A[j] * cosines[j];
+    }
+
+    return x;
+}
+
 
+static double EvaluateCoordinate(const VSOPCoordinate& coord, double t)
+{
     double x = 0.0;
-    VSOPTerm* term = &series.terms[0];
-    for (int i = 0; i < series.nTerms; i++, term++)
-        x += term->A * cos(term->B + term->C * t);
+    double T = 1.0;
+    for (const auto& series : coord)
+    {
+        x += SumSeries(series, t) * T;
+        T = t * T;
+    }
 
     return x;
 }
 
+
+// Evaluate a coordinate at several times. The cosines of a term are
+// computed for a block of times at once, while the terms are summed in the
+// same order as by EvaluateCoordinate().
+static void EvaluateCoordinate(const VSOPCoordinate& coord,
+                               const std::vector<double>& t,
+                               std::vector<double>& result)
+{
+    std::array<double, VSOPBlockSize> args;
+    std::array<double, VSOPBlockSize> cosines;
+    std::array<double, VSOPBlockSize> x;
+    std::array<double, VSOPBlockSize> T;
+
+    result.resize(t.size());
+    for (std::size_t base = 0; base < t.size(); base += VSOPBlockSize)
+    {
+        std::size_t n = std::min(VSOPBlockSize, t.size() - base);
+        const double* tb = t.data() + base;
+        std::fill_n(T.begin(), n, 1.0);
+        std::fill_n(result.begin() + base, n, 0.0);
+
+        for (const auto& series : coord)
+        {
+            std::fill_n(x.begin(), n, 0.0);
+            for (std::size_t j = 0; j < series.A.size(); j++)
+            {
+                double A = series.A[j];
+                double B = series.B[j];
+                double C = series.C[j];
+                for (std::size_t k = 0; k < n; k++)
+                    args[k] = B + C * tb[k];
+                VectorCos(args.data(), cosines.data(), n);
+                for (std::size_t k = 0; k < n; k++)
+                    x[k] += A * cosines[k];
+            }
+
+            for (std::size_t k = 0; k < n; k++)
+            {
+                result[base + k] += x[k] * T[k];
+                T[k] = tb[k] * T[k];
+            }
+        }
+    }
+}
+
+
+// Julian millenia since J2000.0
+static double VSOPTime(double jd)
+{
+    return (jd - 2451545.0) / 365250.0;
+}
+
+
+static std::vector<double> VSOPTimes(celestia::util::array_view<double> jds)
+{
+    std::vector<double> t;
+    t.reserve(jds.size());
+    for (double jd : jds)
+        t.push_back(VSOPTime(jd));
+    return t;
+}
+
+
 class VSOP87Orbit : public CachingOrbit
 {
  private:
-    VSOPSeries* vsL;
-    int nL;
-    VSOPSeries* vsB;
-    int nB;
-    VSOPSeries* vsR;
-    int nR;
+    VSOPCoordinate vsL;
+    VSOPCoordinate vsB;
+    VSOPCoordinate vsR;
     double period;
     double boundingRadius;
 
@@ -11029,10 +11214,11 @@ class VSOP87Orbit : public CachingOrbit
                 VSOPSeries* _vsB, int _nB,
                 VSOPSeries* _vsR, int _nR,
                 double _period,
-                double _boundingRadius) :
-        vsL(_vsL), nL(_nL),
-        vsB(_vsB), nB(_nB),
-        vsR(_vsR), nR(_nR),
+                double _boundingRadius,
+                double precision) :
+        vsL(MakeCoordinate(_vsL, _nL, precision)),
+        vsB(MakeCoordinate(_vsB, _nB, precision)),
+        vsR(MakeCoordinate(_vsR, _nR, precision)),
         period(_period),
         boundingRadius(_boundingRadius)
     {
@@ -11049,43 +11235,9 @@ class VSOP87Orbit : public CachingOrbit
         return boundingRadius;
     }
 
-    Vector3d computePosition(double jd) const override
+    // Convert heliocentric longitude, latitude and radius to a position
+    static Vector3d toPosition(double l, double b, double r)
     {
-        // t is Julian millenia since J2000.0
-        double t = (jd - 2451545.0) / 365250.0;
-
-        // Heliocentric coordinates
-        double l = 0.0; // longitude
-        double b = 0.0; // latitude
-        double r = 0.0; // radius
-
-        int i;
-        double T;
-
-        // Evaluate series for l
-        T = 1;
-        for (i = 0; i < nL; i++)
-        {
-            l += SumSeries(vsL[i], t) * T;
-            T = t * T;
-        }
-
-        // Evaluate series for b
-        T = 1;
-        for (i = 0; i < nB; i++)
-        {
-            b += SumSeries(vsB[i], t) * T;
-            T = t * T;
-        }
-
-        // Evaluate series for r
-        T = 1;
-        for (i = 0; i < nR; i++)
-        {
-            r += SumSeries(vsR[i], t) * T;
-            T = t * T;
-        }
-
         r *= KM_PER_AU;
 
         // Corrections for internal coordinate system
@@ -11097,25 +11249,63 @@ class VSOP87Orbit : public CachingOrbit
                         -sin(l) * sin(b) * r);
     }
 
+    Vector3d computePosition(double jd) const override
+    {
+        double t = VSOPTime(jd);
+        return toPosition(EvaluateCoordinate(vsL, t),
+                          EvaluateCoordinate(vsB, t),
+                          EvaluateCoordinate(vsR, t));
+    }
+
+    void positionsAtTimes(celestia::util::array_view<double> jds, Vector3d* positions) const override
+    {
+        std::vector<double> t = VSOPTimes(jds);
+        std::vector<double> l, b, r;
+        EvaluateCoordinate(vsL, t, l);
+        EvaluateCoordinate(vsB, t, b);
+        EvaluateCoordinate(vsR, t, r);
+
+        for (std::size_t k = 0; k < t.size(); k++)
+            positions[k] = toPosition(l[k], b[k], r[k]);
+    }
+
 
     /** Custom implementation of sample() for VSOP87 orbits. The default
       * implementation runs too slowly and produces too many samples.
+      * Samples are taken at uniform steps of between 1/150 and 1/32 of the
+      * period, with all positions computed in one batch; velocities are
+      * differentiated like CachingOrbit::computeVelocity() does it.
+      *
+      * The orbits are nearly circular, and a cubic through samples an angle
+      * a apart deviates from a circle of radius r by about r a^4 / 384, so
+      * that gives the longest step within the tolerance.
       */
     void sample(double startTime, double endTime, OrbitSampleProc& proc) const override
     {
-        double span = getPeriod();
+        constexpr double VelocityDiffDelta = 1.0 / 1440.0;
+        double angle = std::pow(384.0 * proc.tolerance() / getBoundingRadius(), 0.25);
+        double step = getPeriod() * std::clamp(angle / (2.0 * celestia::numbers::pi), 1.0 / 150.0, 1.0 / 32.0);
 
-        AdaptiveSamplingParameters samplingParams{};
-        samplingParams.tolerance = 1.0; // kilometers
+        std::vector<double> times{ startTime };
+        for (double t = startTime; t < endTime;)
+        {
+            t = t + min(step, endTime - t);
+            times.push_back(t);
+        }
+
+        std::size_t nSamples = times.size();
+        times.resize(nSamples * 2);
+        for (std::size_t i = 0; i < nSamples; i++)
+            times[nSamples + i] = times[i] + VelocityDiffDelta;
 
-        // startStep, minStep, and maxStep are all set to identical values,
-        // so the adaptive sampling function actuall behaves like uniform
-        // sampling.
-        samplingParams.startStep = span / 150.0;
-        samplingParams.minStep   = samplingParams.startStep;
-        samplingParams.maxStep   = samplingParams.startStep;
+        std::vector<Vector3d> positions(times.size());
+        positionsAtTimes(times, positions.data());
 
-        adaptiveSample(startTime, endTime, proc, samplingParams);
+        for (std::size_t i = 0; i < nSamples; i++)
+        {
+            Vector3d v = (positions[nSamples + i] - positions[i]) * (1.0 / VelocityDiffDelta);
+            proc.sample(times[i], positions[i], v);
+        }
     }
 
 };
@@ -11125,12 +11315,9 @@ class VSOP87Orbit : public CachingOrbit
 class VSOP87OrbitRect : public CachingOrbit
 {
  private:
-    VSOPSeries* vsX;
-    int nX;
-    VSOPSeries* vsY;
-    int nY;
-    VSOPSeries* vsZ;
-    int nZ;
+    VSOPCoordinate vsX;
+    VSOPCoordinate vsY;
+    VSOPCoordinate vsZ;
     double period;
     double boundingRadius;
 
@@ -11139,10 +11326,11 @@ class VSOP87OrbitRect : public CachingOrbit
                     VSOPSeries* _vsY, int _nY,
                     VSOPSeries* _vsZ, int _nZ,
                     double _period,
-                    double _boundingRadius) :
-        vsX(_vsX), nX(_nX),
-        vsY(_vsY), nY(_nY),
-        vsZ(_vsZ), nZ(_nZ),
+                    double _boundingRadius,
+                    double precision) :
+        vsX(MakeCoordinate(_vsX, _nX, precision)),
+        vsY(MakeCoordinate(_vsY, _nY, precision)),
+        vsZ(MakeCoordinate(_vsZ, _nZ, precision)),
         period(_period),
         boundingRadius(_boundingRadius)
     {
@@ -11166,42 +11354,25 @@ class VSOP87OrbitRect : public CachingOrbit
 
     Vector3d computePosition(double jd) const override
     {
-        // t is Julian millenia since J2000.0
-        double t = (jd - 2451545.0) / 365250.0;
-
-        Vector3d v(Vector3d::Zero());
+        double t = VSOPTime(jd);
 
-        int i;
-        double T;
-
-        // Evaluate series for x
-        T = 1;
-        for (i = 0; i < nX; i++)
-        {
-            v.x() += SumSeries(vsX[i], t) * T;
-            T = t * T;
-        }
-
-        // Evaluate series for y
-        T = 1;
-        for (i = 0; i < nY; i++)
-        {
-            v.y() += SumSeries(vsY[i], t) * T;
-            T = t * T;
-        }
-
-        // Evaluate series for z
-        T = 1;
-        for (i = 0; i < nZ; i++)
-        {
-            v.z() += SumSeries(vsZ[i], t) * T;
-            T = t * T;
-        }
+        // Corrections for internal coordinate system
+        return Vector3d(EvaluateCoordinate(vsX, t),
+                        EvaluateCoordinate(vsZ, t),
+                        -EvaluateCoordinate(vsY, t)) * KM_PER_AU;
+    }
 
-        v *= KM_PER_AU;
+    void positionsAtTimes(celestia::util::array_view<double> jds, Vector3d* positions) const override
+    {
+        std::vector<double> t = VSOPTimes(jds);
+        std::vector<double> x, y, z;
+        EvaluateCoordinate(vsX, t, x);
+        EvaluateCoordinate(vsY, t, y);
+        EvaluateCoordinate(vsZ, t, z);
 
         // Corrections for internal coordinate system
-        return Vector3d(v.x(), v.z(), -v.y());
+        for (std::size_t k = 0; k < t.size(); k++)
+            positions[k] = Vector3d(x[k], z[k], -y[k]) * KM_PER_AU;
     }
 };
 
@@ -11213,7 +11384,7 @@ static double yearToJD(int year)
 }
 
 
-Orbit* CreateVSOP87Orbit(const string& name)
+Orbit* CreateVSOP87Orbit(const string& name, double precision)
 {
     if (name == "vsop87-mercury")
     {
@@ -11221,7 +11392,7 @@ Orbit* CreateVSOP87Orbit(const string& name)
                                    mercury_B, 6,
                                    mercury_R, 5,
                                    0.2408 * 365.25,
-                                   60000000.0);
+                                   60000000.0, precision);
         return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
                               astro::SolarMass);
     }
@@ -11231,7 +11402,7 @@ Orbit* CreateVSOP87Orbit(const string& name)
                                    venus_B, 6,
                                    venus_R, 5,
                                    0.6152 * 365.25,
-                                   100000000.0);
+                                   100000000.0, precision);
         return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
                               astro::SolarMass);
     }
@@ -11241,7 +11412,7 @@ Orbit* CreateVSOP87Orbit(const string& name)
                                    earth_B, 3,
                                    earth_R, 6,
                                    365.25,
-                                   160000000.0);
+                                   160000000.0, precision);
         return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
                               astro::SolarMass);
     }
@@ -11251,7 +11422,7 @@ Orbit* CreateVSOP87Orbit(const string& name)
                                    mars_B, 6,
                                    mars_R, 6,
                                    1.8809 * 365.25,
-                                   240000000);
+                                   240000000, precision);
         return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
                               astro::SolarMass);
     }
@@ -11261,7 +11432,7 @@ Orbit* CreateVSOP87Orbit(const string& name)
                                    jupiter_B, 6,
                                    jupiter_R, 6,
                                    11.86 * 365.25,
-                                   800000000.0);
+                                   800000000.0, precision);
         return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
                               astro::SolarMass);
     }
@@ -11271,7 +11442,7 @@ Orbit* CreateVSOP87Orbit(const string& name)
                                    saturn_B, 6,
                                    saturn_R, 6,
                                    29.4577 * 365.25,
-                                   1.5e9);
+                                   1.5e9, precision);
         return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
                               astro::SolarMass);
     }
@@ -11281,7 +11452,7 @@ Orbit* CreateVSOP87Orbit(const string& name)
                                    uranus_B, 4,
                                    uranus_R, 5,
                                    84.0139 * 365.25,
-                                   3.0e9);
+                                   3.0e9, precision);
         return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
                               astro::SolarMass);
     }
@@ -11291,7 +11462,7 @@ Orbit* CreateVSOP87Orbit(const string& name)
                                    neptune_B, 4,
                                    neptune_R, 5,
                                    164.793 * 365.25,
-                                   4.7e9);
+                                   4.7e9, precision);
         return new MixedOrbit(o, yearToJD(-4000), yearToJD(4000),
                               astro::SolarMass);
     }
@@ -11301,7 +11472,7 @@ Orbit* CreateVSOP87Orbit(const string& name)
                                        sun_Y, 5,
                                        sun_Z, 3,
                                        0.0,
-                                       2000000);
+                                       2000000, precision);
         return new MixedOrbit(o, yearToJD(-4000), yearToJD(6000),
                               astro::SolarMass);
     }
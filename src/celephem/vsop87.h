@@ -13,6 +13,8 @@
 #include <string>
 #include "orbit.h"
 
-extern Orbit* CreateVSOP87Orbit(const std::string& name);
+// Terms of the series with amplitudes below precision, in AU or radians,
+// are dropped; the default of 0 uses all of them.
+extern Orbit* CreateVSOP87Orbit(const std::string& name, double precision = 0.0);
 
 #endif // _CELENGINE_VSOP87_H_
@@ -17,3 +17,25 @@ struct XYZVBinaryData
     double position[3];
     double velocity[3];
 };
+
+/*! Header of a binary trajectory of Chebyshev polynomials (.xyzc). It is
+ *  followed by count segments, each of which is
+ *
+ *    double start, end    TDB of the first and last instant of the segment
+ *    double x[degree + 1] coefficients of the Chebyshev series of x
+ *    double y[degree + 1] ... of y
+ *    double z[degree + 1] ... of z
+ *
+ *  The position at t in the segment is sum c[i] T_i(s), where
+ *  s = 2 (t - start) / (end - start) - 1, in kilometers and in the frame of
+ *  xyzv files. Segments are in order of time and each starts where the
+ *  previous one ends.
+ */
+struct XYZCBinaryHeader
+{
+    char magic[8];
+    uint16_t byteOrder;
+    uint16_t digits;
+    uint32_t degree;
+    uint64_t count;
+};
@@ -0,0 +1,513 @@
+// catalogloader.cpp
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// Loading of the star, deep sky and solar system catalogs.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <chrono>
+#include <system_error>
+#include <fmt/format.h>
+#include <celengine/boundaries.h>
+#include <celengine/dsodb.h>
+#include <celengine/dsoname.h>
+#include <celengine/solarsys.h>
+#include <celengine/stardb.h>
+#include <celengine/universe.h>
+#include <celutil/cachekey.h>
+#include <celutil/mmapfile.h>
+#include <celutil/threadpool.h>
+#include "catalogloader.h"
+#include "catalogwatcher.h"
+#include "celestiacore.h"
+#include "configfile.h"
+#include "startupreport.h"
+
+using celestia::util::GetLogger;
+
+namespace celestia
+{
+
+namespace
+{
+
+bool is_valid_directory(const fs::path& dir)
+{
+    if (dir.empty())
+        return false;
+
+    std::error_code ec;
+    if (!fs::is_directory(dir, ec))
+    {
+        GetLogger()->error(_("Path {} doesn't exist or isn't a directory\n"), dir);
+        return false;
+    }
+
+    return true;
+}
+
+
+void SaveCatalogCache(const PreparsedCatalog& catalog,
+                      const fs::path& cacheFile,
+                      std::uint64_t key)
+{
+    std::error_code ec;
+    fs::create_directories(cacheFile.parent_path(), ec);
+
+    // Write to a temporary file first so that an interrupted write never
+    // leaves a truncated cache behind.
+    fs::path tmpFile = cacheFile;
+    tmpFile += ".tmp";
+    bool ok;
+    {
+        std::ofstream out(tmpFile, std::ios::out | std::ios::binary);
+        ok = out.good() && catalog.write(out, key);
+    }
+
+    if (ok)
+        fs::rename(tmpFile, cacheFile, ec);
+    if (!ok || ec)
+    {
+        GetLogger()->warn(_("Error writing catalog cache {}\n"), cacheFile);
+        fs::remove(tmpFile, ec);
+    }
+}
+
+} // end unnamed namespace
+
+
+bool AcceptCatalogFile(const fs::path& filepath,
+                       ContentType type,
+                       const std::string& typeDesc,
+                       ProgressNotifier* notifier,
+                       const std::vector<fs::path>& skip)
+{
+    if (DetermineFileType(filepath) != type)
+        return false;
+
+    if (std::find(std::begin(skip), std::end(skip), filepath) != std::end(skip))
+    {
+        GetLogger()->info(_("Skipping {} catalog: {}\n"), typeDesc, filepath);
+        return false;
+    }
+    GetLogger()->info(_("Loading {} catalog: {}\n"), typeDesc, filepath);
+    if (notifier != nullptr)
+        notifier->update(filepath.filename().string());
+    return true;
+}
+
+
+void SolarSystemLoader::process(const fs::path& filepath, PreparsedCatalog* catalog)
+{
+    if (DetermineFileType(filepath) != Content_CelestiaCatalog)
+        return;
+
+    if (std::find(std::begin(skip), std::end(skip), filepath) != std::end(skip))
+    {
+        GetLogger()->info(_("Skipping solar system catalog: {}\n"), filepath);
+        return;
+    }
+    GetLogger()->info(_("Loading solar system catalog: {}\n"), filepath);
+    if (notifier != nullptr)
+        notifier->update(filepath.filename().string());
+
+    std::vector<Body*> bodies;
+    std::vector<Body*>* loadedBodies = watcher == nullptr ? nullptr : &bodies;
+    if (catalog != nullptr)
+    {
+        LoadSolarSystemObjects(*catalog, *universe, filepath.parent_path(), loadedBodies);
+    }
+    else
+    {
+        std::ifstream solarSysFile(filepath, std::ios::in);
+        if (solarSysFile.good())
+        {
+            LoadSolarSystemObjects(solarSysFile,
+                                   *universe,
+                                   filepath.parent_path(),
+                                   loadedBodies);
+        }
+    }
+
+    if (watcher != nullptr)
+        watcher->setBodies(filepath, std::move(bodies));
+}
+
+
+std::vector<fs::path> ListExtrasFiles(const fs::path& dir)
+{
+    std::vector<fs::path> entries;
+    if (!is_valid_directory(dir))
+        return entries;
+
+    std::error_code ec;
+    auto iter = fs::recursive_directory_iterator(dir, ec);
+    for (; iter != end(iter); iter.increment(ec))
+    {
+        if (ec)
+            continue;
+        if (!fs::is_directory(iter->path(), ec))
+            entries.push_back(iter->path());
+    }
+    std::sort(begin(entries), end(entries));
+    return entries;
+}
+
+
+std::unique_ptr<PreparsedCatalog> PreparseCatalogFile(const fs::path& path,
+                                                      const fs::path& cacheDir)
+{
+    util::MemoryMappedFile file;
+    if (!file.open(path, util::MemoryMappedFile::AccessHint::Sequential))
+        return nullptr;
+
+    std::string_view contents(file.data(), file.size());
+    if (cacheDir.empty())
+        return std::make_unique<PreparsedCatalog>(contents);
+
+    // Caches are named after the catalog path and validated against its
+    // contents, so edited catalogs are parsed again.
+    util::CacheKey pathKey;
+    pathKey.add(path.generic_string());
+    fs::path cacheFile = cacheDir / fmt::format("{:016x}.cat", pathKey.value());
+
+    util::CacheKey contentsKey;
+    contentsKey.add(contents);
+
+    util::MemoryMappedFile cached;
+    if (cached.open(cacheFile, util::MemoryMappedFile::AccessHint::Sequential))
+    {
+        auto catalog = PreparsedCatalog::read(std::string_view(cached.data(), cached.size()),
+                                              contentsKey.value());
+        if (catalog != nullptr)
+            return catalog;
+        GetLogger()->debug("Catalog cache {} is out of date\n", cacheFile);
+    }
+
+    auto catalog = std::make_unique<PreparsedCatalog>(contents);
+    SaveCatalogCache(*catalog, cacheFile, contentsKey.value());
+    return catalog;
+}
+
+
+void ProcessCatalogFiles(const std::vector<fs::path>& files,
+                         ContentType type,
+                         unsigned int loaderThreads,
+                         const fs::path& cacheDir,
+                         const CatalogFileHandler& handler)
+{
+    util::ThreadPool pool(loaderThreads);
+    if (pool.size() == 1 && cacheDir.empty())
+    {
+        for (const auto& file : files)
+            handler(file, nullptr);
+        return;
+    }
+
+    // Parsing runs only a few files per thread ahead of loading, which
+    // keeps the memory held by parsed files bounded.
+    const std::size_t batchSize = 4 * pool.size();
+    std::vector<std::unique_ptr<PreparsedCatalog>> catalogs;
+    for (std::size_t first = 0; first < files.size(); first += batchSize)
+    {
+        std::size_t last = std::min(files.size(), first + batchSize);
+        catalogs.clear();
+        catalogs.resize(last - first);
+        for (std::size_t i = first; i < last; i++)
+        {
+            if (DetermineFileType(files[i]) != type)
+                continue;
+
+            pool.submit([&files, &catalogs, &cacheDir, first, i]
+            {
+                catalogs[i - first] = PreparseCatalogFile(files[i], cacheDir);
+            });
+        }
+        pool.wait();
+
+        // Catalogs are applied in the original order so that later files
+        // still modify or replace objects defined by earlier ones.
+        for (std::size_t i = first; i < last; i++)
+            handler(files[i], catalogs[i - first].get());
+    }
+}
+
+
+DSODatabase* LoadDeepSkyCatalogs(const CelestiaConfig& config,
+                                 ProgressNotifier* progressNotifier,
+                                 StartupReport* report)
+{
+    DSONameDatabase* dsoNameDB  = new DSONameDatabase;
+    DSODatabase*     dsoDB      = new DSODatabase;
+    dsoDB->setNameDatabase(dsoNameDB);
+    dsoDB->setLoaderThreads(config.loaderThreads);
+
+    OctreeSplitPolicy policy = DynamicDSOOctree::defaultSplitPolicy;
+    if (config.dsoOctreeSplitThreshold > 0)
+        policy.splitThreshold = config.dsoOctreeSplitThreshold;
+    if (config.dsoOctreeMagnitudeStep > 0.0f)
+        policy.magnitudeStep = config.dsoOctreeMagnitudeStep;
+    dsoDB->setOctreeSplitPolicy(policy);
+
+    // Load first the vector of dsoCatalogFiles in the data directory (deepsky.dsc, globulars.dsc,...):
+
+    for (const auto& file : config.dsoCatalogFiles)
+    {
+        if (progressNotifier)
+            progressNotifier->update(file.string());
+
+        StartupReport::Timer timer(report, file.string());
+        timer.addFile(file);
+        std::uint32_t count = dsoDB->size();
+        if (DetermineFileType(file) == Content_CelestiaDeepSkyBinaryCatalog)
+        {
+            if (!dsoDB->loadBinary(file))
+                GetLogger()->error(_("Cannot read Deep Sky Objects database {}.\n"), file);
+            timer.setObjects(dsoDB->size() - count);
+            continue;
+        }
+
+        std::ifstream dsoFile(file, std::ios::in);
+        if (!dsoFile.good())
+        {
+            GetLogger()->error(_("Error opening deepsky catalog file {}.\n"), file);
+        }
+        if (!dsoDB->load(dsoFile, ""))
+        {
+            GetLogger()->error(_("Cannot read Deep Sky Objects database {}.\n"), file);
+        }
+        timer.setObjects(dsoDB->size() - count);
+    }
+
+    // Next, read all the deep sky files in the extras directories
+    DeepSkyLoader loader(dsoDB, "deep sky object",
+                         Content_CelestiaDeepSkyCatalog,
+                         progressNotifier,
+                         config.skipExtras);
+    for (const auto& dir : config.extrasDirs)
+    {
+        ProcessCatalogFiles(ListExtrasFiles(dir),
+                            Content_CelestiaDeepSkyCatalog,
+                            config.loaderThreads,
+                            fs::path(),
+                            [&loader, dsoDB, report](const fs::path& fn, PreparsedCatalog* catalog)
+                            {
+                                ContentType type = DetermineFileType(fn);
+                                if (report == nullptr ||
+                                    (type != Content_CelestiaDeepSkyCatalog && type != Content_CelestiaDeepSkyBinaryCatalog))
+                                {
+                                    loader.process(fn, catalog);
+                                    loader.processBinary(fn, Content_CelestiaDeepSkyBinaryCatalog);
+                                    return;
+                                }
+
+                                StartupReport::Timer timer(report, fn.string());
+                                timer.addFile(fn);
+                                std::uint32_t count = dsoDB->size();
+                                loader.process(fn, catalog);
+                                loader.processBinary(fn, Content_CelestiaDeepSkyBinaryCatalog);
+                                timer.setObjects(dsoDB->size() - count);
+                            });
+    }
+
+    dsoDB->finish();
+    return dsoDB;
+}
+
+
+AsterismList* LoadAsterisms(const CelestiaConfig& config, const StarDatabase& starDB)
+{
+    if (config.asterismsFile.empty())
+        return nullptr;
+
+    std::ifstream asterismsFile(config.asterismsFile, std::ios::in);
+    if (!asterismsFile.good())
+    {
+        GetLogger()->error(_("Error opening asterisms file {}.\n"),
+                           config.asterismsFile);
+        return nullptr;
+    }
+
+    return ReadAsterismList(asterismsFile, starDB);
+}
+
+
+ConstellationBoundaries* LoadBoundaries(const CelestiaConfig& config)
+{
+    if (config.boundariesFile.empty())
+        return nullptr;
+
+    std::ifstream boundariesFile(config.boundariesFile, std::ios::in);
+    if (!boundariesFile.good())
+    {
+        GetLogger()->error(_("Error opening constellation boundaries file {}.\n"),
+                           config.boundariesFile);
+        return nullptr;
+    }
+
+    return ReadBoundaries(boundariesFile);
+}
+
+
+// Records the progress of the worker thread for update() to report
+class BackgroundCatalogLoader::StatusNotifier : public ProgressNotifier
+{
+ public:
+    explicit StatusNotifier(BackgroundCatalogLoader& loader) : loader(loader) {}
+
+    void update(const std::string& s) override
+    {
+        std::lock_guard<std::mutex> lock(loader.mutex);
+        loader.status = s;
+    }
+
+ private:
+    BackgroundCatalogLoader& loader;
+};
+
+
+BackgroundCatalogLoader::BackgroundCatalogLoader(Universe* universe,
+                                                 const CelestiaConfig& config,
+                                                 CatalogWatcher* watcher) :
+    universe(universe),
+    config(config),
+    watcher(watcher)
+{
+    worker = std::thread(&BackgroundCatalogLoader::run, this);
+}
+
+
+BackgroundCatalogLoader::~BackgroundCatalogLoader()
+{
+    // A catalog that is being read is finished first; anything after it
+    // is abandoned.
+    cancelled = true;
+    worker.join();
+}
+
+
+void BackgroundCatalogLoader::run()
+{
+    // List the solar system catalogs first so that the main thread can
+    // start on them while the deep sky catalogs are read.
+    std::vector<fs::path> files;
+    for (const auto& dir : config.extrasDirs)
+    {
+        for (auto& fn : ListExtrasFiles(dir))
+        {
+            if (DetermineFileType(fn) == Content_CelestiaCatalog)
+                files.push_back(std::move(fn));
+        }
+    }
+
+    // Parse the solar system catalogs here too, leaving only the changes
+    // to the universe for the main thread.
+    std::vector<std::unique_ptr<PreparsedCatalog>> catalogs(files.size());
+    {
+        util::ThreadPool pool(config.loaderThreads);
+        for (std::size_t i = 0; i < files.size(); i++)
+        {
+            pool.submit([this, &files, &catalogs, i]
+            {
+                if (!cancelled)
+                    catalogs[i] = PreparseCatalogFile(files[i], config.solarSystemCacheDir);
+            });
+        }
+        pool.wait();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        solarSystemFiles = std::move(files);
+        solarSystemCatalogs = std::move(catalogs);
+        filesListed = true;
+    }
+
+    StatusNotifier notifier(*this);
+    if (!cancelled)
+    {
+        std::unique_ptr<DSODatabase> dsos(LoadDeepSkyCatalogs(config, &notifier));
+        std::lock_guard<std::mutex> lock(mutex);
+        dsoDB = std::move(dsos);
+    }
+
+    // The star catalog isn't modified after initialization, so it can be
+    // read from this thread.
+    if (!cancelled)
+    {
+        std::unique_ptr<AsterismList> asterismList(LoadAsterisms(config, *universe->getStarCatalog()));
+        std::lock_guard<std::mutex> lock(mutex);
+        asterisms = std::move(asterismList);
+    }
+
+    if (!cancelled)
+    {
+        std::unique_ptr<ConstellationBoundaries> bounds(LoadBoundaries(config));
+        std::lock_guard<std::mutex> lock(mutex);
+        boundaries = std::move(bounds);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    finished = true;
+}
+
+
+bool BackgroundCatalogLoader::update(ProgressNotifier* notifier, double timeBudget)
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!status.empty())
+    {
+        if (notifier != nullptr)
+            notifier->update(status);
+        status.clear();
+    }
+
+    if (dsoDB != nullptr)
+    {
+        // Replace the empty catalog installed by initSimulation()
+        DSODatabase* placeholder = universe->getDSOCatalog();
+        universe->setDSOCatalog(dsoDB.release());
+        if (placeholder != nullptr)
+        {
+            delete placeholder->getNameDatabase();
+            delete placeholder;
+        }
+    }
+
+    if (asterisms != nullptr)
+        universe->setAsterisms(asterisms.release());
+    if (boundaries != nullptr)
+        universe->setBoundaries(boundaries.release());
+
+    bool workerFinished = finished;
+    bool haveFiles = filesListed;
+    lock.unlock();
+
+    // The solar system files aren't touched by the worker after they are
+    // listed
+    if (haveFiles)
+    {
+        SolarSystemLoader loader(universe, notifier, config.skipExtras, watcher);
+        while (nextSolarSystemFile < solarSystemFiles.size())
+        {
+            std::size_t i = nextSolarSystemFile++;
+            loader.process(solarSystemFiles[i], solarSystemCatalogs[i].get());
+            solarSystemCatalogs[i].reset();
+
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+            if (elapsed.count() > timeBudget)
+                break;
+        }
+    }
+
+    return workerFinished && haveFiles && nextSolarSystemFile == solarSystemFiles.size();
+}
+
+} // end namespace celestia
@@ -0,0 +1,228 @@
+// catalogloader.h
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// Loading of the star, deep sky and solar system catalogs.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <celcompat/filesystem.h>
+#include <celengine/asterism.h>
+#include <celengine/parser.h>
+#include <celutil/filetype.h>
+#include <celutil/gettext.h>
+#include <celutil/logger.h>
+
+class CelestiaConfig;
+class ConstellationBoundaries;
+class DSODatabase;
+class ProgressNotifier;
+class StarDatabase;
+class Universe;
+
+namespace celestia
+{
+
+class CatalogWatcher;
+class StartupReport;
+
+/**
+ * Return true if filepath has the given content type and isn't in the
+ * list of files to skip. Accepted files are logged and reported to the
+ * notifier.
+ */
+bool AcceptCatalogFile(const fs::path& filepath,
+                       ContentType type,
+                       const std::string& typeDesc,
+                       ProgressNotifier* notifier,
+                       const std::vector<fs::path>& skip);
+
+class SolarSystemLoader
+{
+    Universe* universe;
+    ProgressNotifier* notifier;
+    const std::vector<fs::path>& skip;
+    CatalogWatcher* watcher;
+
+ public:
+    // The bodies of each file are recorded in watcher if it isn't null
+    SolarSystemLoader(Universe* u,
+                      ProgressNotifier* pn,
+                      const std::vector<fs::path>& skip,
+                      CatalogWatcher* watcher = nullptr) :
+        universe(u),
+        notifier(pn),
+        skip(skip),
+        watcher(watcher)
+    {
+    }
+
+    // If catalog isn't null, it holds the preparsed contents of filepath
+    void process(const fs::path& filepath, PreparsedCatalog* catalog = nullptr);
+};
+
+template <class OBJDB> class CatalogLoader
+{
+    OBJDB*      objDB;
+    std::string typeDesc;
+    ContentType contentType;
+    ProgressNotifier* notifier;
+    const std::vector<fs::path>& skip;
+
+ public:
+    CatalogLoader(OBJDB* db,
+                  const std::string& typeDesc,
+                  const ContentType& contentType,
+                  ProgressNotifier* pn,
+                  const std::vector<fs::path>& skip) :
+        objDB      (db),
+        typeDesc   (typeDesc),
+        contentType(contentType),
+        notifier   (pn),
+        skip       (skip)
+    {
+    }
+
+    // If catalog isn't null, it holds the preparsed contents of filepath
+    void process(const fs::path& filepath, PreparsedCatalog* catalog = nullptr)
+    {
+        if (!accept(filepath, contentType))
+            return;
+
+        if (catalog != nullptr)
+        {
+            if (!objDB->load(*catalog, filepath.parent_path()))
+                util::GetLogger()->error(_("Error reading {} catalog file: {}\n"), typeDesc, filepath);
+            return;
+        }
+
+        std::ifstream catalogFile(filepath, std::ios::in);
+        if (catalogFile.good())
+        {
+            if (!objDB->load(catalogFile, filepath.parent_path()))
+                util::GetLogger()->error(_("Error reading {} catalog file: {}\n"), typeDesc, filepath);
+        }
+    }
+
+    // Binary catalogs are mapped into memory rather than read as streams
+    void processBinary(const fs::path& filepath, ContentType binaryType)
+    {
+        if (!accept(filepath, binaryType))
+            return;
+
+        if (!objDB->loadBinary(filepath, filepath.parent_path()))
+            util::GetLogger()->error(_("Error reading {} catalog file: {}\n"), typeDesc, filepath);
+    }
+
+ private:
+    bool accept(const fs::path& filepath, ContentType type)
+    {
+        return AcceptCatalogFile(filepath, type, typeDesc, notifier, skip);
+    }
+};
+
+using StarLoader = CatalogLoader<StarDatabase>;
+using DeepSkyLoader = CatalogLoader<DSODatabase>;
+
+/**
+ * Return the files in an extras directory and all of its subdirectories,
+ * sorted by path.
+ */
+std::vector<fs::path> ListExtrasFiles(const fs::path& dir);
+
+/**
+ * Read and parse a catalog file. If cacheDir isn't empty, the parsed
+ * catalog is taken from a cache file there when one was saved for the
+ * same file contents, and saved to it otherwise. Returns null if the
+ * file can't be read.
+ */
+std::unique_ptr<PreparsedCatalog> PreparseCatalogFile(const fs::path& path,
+                                                      const fs::path& cacheDir = fs::path());
+
+using CatalogFileHandler = std::function<void(const fs::path&, PreparsedCatalog*)>;
+
+/**
+ * Call handler for each of files in order. When loaderThreads isn't 1,
+ * the files of the given content type are tokenized and parsed on a
+ * thread pool a batch at a time, and handler receives the preparsed
+ * catalog; otherwise the catalog passed to it is null. Files are also
+ * preparsed when a cache directory is given, see PreparseCatalogFile().
+ * The catalog is destroyed when handler returns.
+ */
+void ProcessCatalogFiles(const std::vector<fs::path>& files,
+                         ContentType type,
+                         unsigned int loaderThreads,
+                         const fs::path& cacheDir,
+                         const CatalogFileHandler& handler);
+
+// The files are timed as stages of report when it isn't null
+DSODatabase* LoadDeepSkyCatalogs(const CelestiaConfig&, ProgressNotifier*, StartupReport* report = nullptr);
+AsterismList* LoadAsterisms(const CelestiaConfig&, const StarDatabase&);
+ConstellationBoundaries* LoadBoundaries(const CelestiaConfig&);
+
+/**
+ * Loads the catalogs that aren't needed to draw the first frame while the
+ * simulation runs. Deep sky catalogs, asterisms and constellation
+ * boundaries are read on a worker thread. Solar system catalogs from the
+ * extras directories modify the universe in place, so they are read on
+ * the main thread a few at a time. Nothing is added to the universe
+ * outside of update(), which must be called between frames.
+ */
+class BackgroundCatalogLoader
+{
+ public:
+    BackgroundCatalogLoader(Universe*, const CelestiaConfig&, CatalogWatcher* watcher = nullptr);
+    ~BackgroundCatalogLoader();
+
+    BackgroundCatalogLoader(const BackgroundCatalogLoader&) = delete;
+    BackgroundCatalogLoader& operator=(const BackgroundCatalogLoader&) = delete;
+
+    /**
+     * Merge the catalogs read by the worker thread into the universe,
+     * then load solar system catalogs for up to timeBudget seconds.
+     * Progress is reported to notifier, which may be null. Returns true
+     * once all catalogs have been loaded.
+     */
+    bool update(ProgressNotifier* notifier, double timeBudget);
+
+ private:
+    class StatusNotifier;
+
+    void run();
+
+    Universe* universe;
+    const CelestiaConfig& config;
+    CatalogWatcher* watcher;
+
+    // Guards the members written by the worker thread
+    std::mutex mutex;
+    std::string status;
+    bool filesListed{ false };
+    std::vector<fs::path> solarSystemFiles;
+    // Preparsed solar system catalogs by file, null where parsing is left
+    // to the main thread
+    std::vector<std::unique_ptr<PreparsedCatalog>> solarSystemCatalogs;
+    std::unique_ptr<DSODatabase> dsoDB;
+    std::unique_ptr<AsterismList> asterisms;
+    std::unique_ptr<ConstellationBoundaries> boundaries;
+    bool finished{ false };
+
+    std::size_t nextSolarSystemFile{ 0 };
+    std::atomic<bool> cancelled{ false };
+    std::thread worker;
+};
+
+} // end namespace celestia
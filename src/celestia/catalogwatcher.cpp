@@ -0,0 +1,222 @@
+// catalogwatcher.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Reloading of the catalogs in the extras directories when they change.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <system_error>
+#include <celengine/body.h>
+#include <celengine/dsodb.h>
+#include <celengine/solarsys.h>
+#include <celengine/stardb.h>
+#include <celengine/universe.h>
+#include <celutil/gettext.h>
+#include <celutil/logger.h>
+#include "catalogloader.h"
+#include "catalogwatcher.h"
+
+using celestia::util::GetLogger;
+
+namespace celestia
+{
+
+CatalogWatcher::CatalogWatcher(Universe* universe,
+                               const std::vector<fs::path>& extrasDirs,
+                               const std::vector<fs::path>& skip) :
+    universe(universe),
+    extrasDirs(extrasDirs),
+    skip(skip)
+{
+}
+
+void
+CatalogWatcher::setBodies(const fs::path& path, std::vector<Body*>&& bodies)
+{
+    files[path].bodies = std::move(bodies);
+}
+
+int
+CatalogWatcher::poll()
+{
+    int changes = 0;
+    std::vector<fs::path> listed;
+    for (const auto& dir : extrasDirs)
+    {
+        std::vector<fs::path> dirFiles = ListExtrasFiles(dir);
+        listed.insert(listed.end(), dirFiles.begin(), dirFiles.end());
+    }
+
+    for (const auto& path : listed)
+    {
+        ContentType type = DetermineFileType(path);
+        if (type != Content_CelestiaCatalog &&
+            type != Content_CelestiaStarCatalog &&
+            type != Content_CelestiaDeepSkyCatalog)
+        {
+            continue;
+        }
+
+        if (std::find(skip.begin(), skip.end(), path) != skip.end())
+            continue;
+
+        std::error_code ec;
+        fs::file_time_type modified = fs::last_write_time(path, ec);
+        if (ec)
+            continue;
+
+        bool isNew = files.find(path) == files.end();
+        CatalogFile& file = files[path];
+        file.type = type;
+        if (!started || (!isNew && file.modified == modified))
+        {
+            file.modified = modified;
+            continue;
+        }
+        file.modified = modified;
+
+        GetLogger()->info(_("Reloading catalog: {}\n"), path);
+        switch (type)
+        {
+        case Content_CelestiaCatalog:
+            reloadSolarSystems(path, file);
+            changes |= SolarSystemsChanged;
+            break;
+        case Content_CelestiaStarCatalog:
+            reloadStars(path);
+            changes |= StarsChanged;
+            break;
+        default:
+            reloadDeepSky(path);
+            changes |= DeepSkyChanged;
+            break;
+        }
+    }
+
+    // The bodies of deleted solar system catalogs are hidden
+    for (auto iter = files.begin(); iter != files.end();)
+    {
+        if (std::find(listed.begin(), listed.end(), iter->first) != listed.end())
+        {
+            ++iter;
+            continue;
+        }
+
+        if (started && iter->second.type == Content_CelestiaCatalog && !iter->second.bodies.empty())
+        {
+            for (Body* body : iter->second.bodies)
+            {
+                body->setVisible(false);
+                body->setClickable(false);
+            }
+            changes |= SolarSystemsChanged;
+        }
+        iter = files.erase(iter);
+    }
+
+    started = true;
+    if (changes != 0)
+    {
+        // Star and deep sky names aren't tracked by the path cache
+        universe->invalidatePathCache();
+        notifyWatchers(changes);
+    }
+    return changes;
+}
+
+void
+CatalogWatcher::reloadSolarSystems(const fs::path& path, CatalogFile& file)
+{
+    std::ifstream in(path, std::ios::in);
+    if (!in.good())
+    {
+        GetLogger()->error(_("Error opening solar system catalog {}.\n"), path);
+        return;
+    }
+
+    std::vector<Body*> bodies;
+    ReloadSolarSystemObjects(in, *universe, path.parent_path(), &bodies);
+
+    // Bodies can't be deleted while they may be selected or followed, so
+    // the ones that are no longer defined are hidden
+    for (Body* body : file.bodies)
+    {
+        if (std::find(bodies.begin(), bodies.end(), body) != bodies.end())
+            continue;
+
+        body->setVisible(false);
+        body->setClickable(false);
+    }
+    file.bodies = std::move(bodies);
+}
+
+void
+CatalogWatcher::reloadStars(const fs::path& path)
+{
+    StarDatabase* starDB = universe->getStarCatalog();
+    std::ifstream in(path, std::ios::in);
+    if (starDB == nullptr || !in.good())
+    {
+        GetLogger()->error(_("Error opening star catalog {}\n"), path);
+        return;
+    }
+
+    std::size_t rejected = starDB->update(in, path.parent_path());
+    if (rejected > 0)
+    {
+        GetLogger()->warn(_("{} star definitions in {} will only take effect after a restart.\n"),
+                          rejected, path);
+        rejectedCount += rejected;
+    }
+}
+
+void
+CatalogWatcher::reloadDeepSky(const fs::path& path)
+{
+    DSODatabase* dsoDB = universe->getDSOCatalog();
+    std::ifstream in(path, std::ios::in);
+    if (dsoDB == nullptr || !in.good())
+    {
+        GetLogger()->error(_("Error opening deepsky catalog file {}.\n"), path);
+        return;
+    }
+
+    std::size_t rejected = dsoDB->update(in, path.parent_path());
+    if (rejected > 0)
+    {
+        GetLogger()->warn(_("{} deep sky object definitions in {} will only take effect after a restart.\n"),
+                          rejected, path);
+        rejectedCount += rejected;
+    }
+}
+
+void
+CatalogWatcher::addWatcher(CatalogWatcherObserver* watcher)
+{
+    assert(watcher != nullptr);
+    watchers.push_back(watcher);
+}
+
+void
+CatalogWatcher::removeWatcher(CatalogWatcherObserver* watcher)
+{
+    auto iter = std::find(watchers.begin(), watchers.end(), watcher);
+    if (iter != watchers.end())
+        watchers.erase(iter);
+}
+
+void
+CatalogWatcher::notifyWatchers(int changes)
+{
+    for (auto* watcher : watchers)
+        watcher->notifyChange(this, changes);
+}
+
+} // end namespace celestia
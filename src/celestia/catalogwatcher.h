@@ -0,0 +1,100 @@
+// catalogwatcher.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Reloading of the catalogs in the extras directories when they change.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <map>
+#include <vector>
+#include <celcompat/filesystem.h>
+#include <celutil/filetype.h>
+#include <celutil/watcher.h>
+
+class Body;
+class Universe;
+
+namespace celestia
+{
+
+class CatalogWatcher;
+using CatalogWatcherObserver = Watcher<CatalogWatcher>;
+
+/**
+ * Checks the solar system, star and deep sky catalogs in the extras
+ * directories for changes and loads the changed ones again, so that
+ * add-ons can be edited while Celestia is running.
+ *
+ * Bodies and locations of a solar system catalog are replaced in place;
+ * bodies removed from it are hidden rather than deleted, as the
+ * simulation and the front ends may still point to them. Stars and deep
+ * sky objects are changed in place as long as they stay in their octree
+ * node; new objects and ones that moved too far are reported as needing a
+ * restart. Nothing is reloaded while the catalogs are still loading.
+ */
+class CatalogWatcher
+{
+ public:
+    // Bits of the changes passed to the observers
+    enum
+    {
+        SolarSystemsChanged = 0x1,
+        StarsChanged        = 0x2,
+        DeepSkyChanged      = 0x4,
+    };
+
+    CatalogWatcher(Universe* universe,
+                   const std::vector<fs::path>& extrasDirs,
+                   const std::vector<fs::path>& skip);
+    ~CatalogWatcher() = default;
+
+    CatalogWatcher(const CatalogWatcher&) = delete;
+    CatalogWatcher& operator=(const CatalogWatcher&) = delete;
+
+    // Record the bodies defined by a solar system catalog when it's loaded
+    void setBodies(const fs::path& path, std::vector<Body*>&& bodies);
+
+    /**
+     * Load the catalogs that were added or modified since the last call
+     * again and notify the observers. The first call only records the
+     * modification times. Returns the changes made.
+     */
+    int poll();
+
+    // Number of definitions that need a restart to be applied, since the
+    // watcher was created
+    std::size_t getRejectedCount() const { return rejectedCount; }
+
+    void addWatcher(CatalogWatcherObserver*);
+    void removeWatcher(CatalogWatcherObserver*);
+
+ private:
+    struct CatalogFile
+    {
+        ContentType type{ Content_Unknown };
+        fs::file_time_type modified{};
+        // Bodies and reference points of a solar system catalog
+        std::vector<Body*> bodies;
+    };
+
+    void reloadSolarSystems(const fs::path& path, CatalogFile& file);
+    void reloadStars(const fs::path& path);
+    void reloadDeepSky(const fs::path& path);
+    void notifyWatchers(int changes);
+
+    Universe* universe;
+    std::vector<fs::path> extrasDirs;
+    std::vector<fs::path> skip;
+    std::map<fs::path, CatalogFile> files;
+    bool started{ false };
+    std::size_t rejectedCount{ 0 };
+    std::vector<CatalogWatcherObserver*> watchers;
+};
+
+} // end namespace celestia
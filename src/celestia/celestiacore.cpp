@@ -13,8 +13,15 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include "catalogloader.h"
+#include "catalogwatcher.h"
 #include "celestiacore.h"
+#include "celestiastate.h"
+#include "clustersync.h"
 #include "favorites.h"
+#include "imagesequencecapture.h"
+#include "remotecontrol.h"
+#include "startupreport.h"
 #include "textprintposition.h"
 #include "url.h"
 #include <celcompat/numbers.h>
@@ -26,21 +33,34 @@
 #include <celscript/legacy/execution.h>
 #include <celscript/legacy/cmdparser.h>
 #include <celengine/multitexture.h>
+#include <celengine/meshmanager.h>
+#include <celengine/modelgeometry.h>
+#include <celengine/minorbodies.h>
+#include <celengine/trajmanager.h>
 #ifdef USE_SPICE
 #include <celephem/spiceinterface.h>
 #endif
 #include <celengine/axisarrow.h>
 #include <celengine/planetgrid.h>
+#include <celengine/prefetcher.h>
 #include <celengine/visibleregion.h>
 #include <celengine/framebuffer.h>
+#include <celengine/framegovernor.h>
+#include <celengine/gpuprofiler.h>
+#include <celengine/glstate.h>
 #include <celimage/imageformats.h>
 #include <celmath/geomutil.h>
+#include <celutil/cachekey.h>
+#include <celutil/catalogalloc.h>
 #include <celutil/color.h>
 #include <celutil/filetype.h>
 #include <celutil/formatnum.h>
 #include <celutil/fsutils.h>
 #include <celutil/logger.h>
+#include <celutil/memoryusage.h>
+#include <celutil/profiler.h>
 #include <celutil/gettext.h>
+#include <celutil/jobsystem.h>
 #include <celutil/utf8.h>
 #include <celcompat/filesystem.h>
 #include <Eigen/Geometry>
@@ -52,10 +72,12 @@
 #include <cctype>
 #include <cstring>
 #include <cassert>
+#include <type_traits>
 #include <ctime>
 #include <set>
 #include <celengine/rectangle.h>
 #include <celengine/mapmanager.h>
+#include <celengine/virtualtex.h>
 #include <fmt/ostream.h>
 #ifdef USE_MINIAUDIO
 #include "miniaudiosession.h"
@@ -95,6 +117,23 @@ static const double OneFtInKm = 0.0003048;
 static const double OneLbInKg = 0.45359237;
 static const double OneLbPerFt3InKgPerM3 = OneLbInKg / pow(OneFtInKm * 1000.0, 3);
 
+// Few threads, as decoding several large textures at once takes a lot of
+// memory
+static const unsigned int TextureLoaderThreads = 2;
+static const unsigned int ModelLoaderThreads = 1;
+
+// Times a frame is drawn at most in offline rendering while the resources
+// it requests are loaded; a model may request its textures, for example.
+static const int MaxOfflineRenderPasses = 4;
+
+// Messages of a single call site, other than errors, logged between two
+// frames or while the catalogs are loaded; the rest are counted instead
+static const unsigned int RepeatedMessageLimit = 10;
+
+// Seconds a cluster render node waits for the master's next frame before
+// its front end gets control back
+static const double ClusterStateTimeout = 1.0;
+
 namespace
 {
 float KelvinToCelsius(float kelvin)
@@ -136,21 +175,6 @@ string KelvinToStr(float value, int digits, CelestiaCore::TemperatureScale tempe
     return fmt::format(unitTemplate, SigDigitNum(value, digits));
 }
 
-bool is_valid_directory(const fs::path& dir)
-{
-    if (dir.empty())
-        return false;
-
-    std::error_code ec;
-    if (!fs::is_directory(dir, ec))
-    {
-        GetLogger()->error(_("Path {} doesn't exist or isn't a directory\n"), dir);
-        return false;
-    }
-
-    return true;
-}
-
 bool ReadLeapSecondsFile(const fs::path& path, std::vector<astro::LeapSecondRecord> &leapSeconds)
 {
     std::ifstream file(path);
@@ -232,6 +256,9 @@ CelestiaCore::CelestiaCore() :
 {
 
     CreateLogger();
+    // The console is written by the main thread, between frames
+    GetLogger()->startAsync(false);
+    GetLogger()->setRepeatLimit(RepeatedMessageLimit);
 
     for (int i = 0; i < KeyCount; i++)
     {
@@ -248,12 +275,26 @@ CelestiaCore::CelestiaCore() :
 
 CelestiaCore::~CelestiaCore()
 {
+    // Wait for the catalog loader thread before the logger goes away
+    catalogLoader = nullptr;
+
     if (movieCapture != nullptr)
-        recordEnd();
+        finishMovieCapture();
+
+    // Finish the running jobs, which may use textures or the simulation
+    simulationJob = nullptr;
+    DestroyJobSystem();
 
     delete timer;
     delete renderer;
 
+    if (GetProfiler() != nullptr)
+    {
+        if (config != nullptr && !config->profilerTraceFile.empty() && !GetProfiler()->writeTrace(config->profilerTraceFile))
+            GetLogger()->error(_("Failed to write the profiler trace {}\n"), config->profilerTraceFile);
+        DestroyProfiler();
+    }
+
     if (m_logfile.good())
         m_logfile.close();
 
@@ -320,6 +361,7 @@ void CelestiaCore::writeFavoritesFile()
 
 void CelestiaCore::activateFavorite(FavoritesEntry& fav)
 {
+    waitForSimulation();
     sim->cancelMotion();
     sim->setTime(fav.jd);
     sim->setObserverPosition(fav.position);
@@ -409,6 +451,7 @@ void CelestiaCore::cancelScript()
 
 void CelestiaCore::runScript(const fs::path& filename, bool i18n)
 {
+    waitForSimulation();
     cancelScript();
     auto maybeLocaleFilename = i18n ? LocaleFilename(filename) : filename;
 
@@ -440,6 +483,7 @@ static bool checkMask(int modifiers, int mask)
 
 void CelestiaCore::mouseButtonDown(float x, float y, int button)
 {
+    waitForSimulation();
     setViewChanged();
 
     mouseMotion = 0.0f;
@@ -508,6 +552,7 @@ void CelestiaCore::mouseButtonDown(float x, float y, int button)
 
 void CelestiaCore::mouseButtonUp(float x, float y, int button)
 {
+    waitForSimulation();
     setViewChanged();
 
     // Four pixel tolerance for picking
@@ -544,13 +589,11 @@ void CelestiaCore::mouseButtonUp(float x, float y, int button)
                                            (float) y / (float) height,
                                            pickX, pickY);
             pickX *= aspectRatio;
-            if (isViewportEffectUsed)
-                viewportEffect->distortXY(pickX, pickY);
-
-            Vector3f pickRay = renderer->getProjectionMode() == Renderer::ProjectionMode::FisheyeMode ? sim->getActiveObserver()->getPickRayFisheye(pickX, pickY) : sim->getActiveObserver()->getPickRay(pickX, pickY);
+            Vector3f pickRay = getPickRay(pickX, pickY);
 
             Selection oldSel = sim->getSelection();
-            Selection newSel = sim->pickObject(pickRay, renderer->getRenderFlags(), pickTolerance);
+            Selection newSel = sim->pickObject(pickRay, renderer->getRenderFlags(), pickTolerance,
+                                               renderer->getPickGrid(*sim->getActiveObserver()));
             addToHistory();
             sim->setSelection(newSel);
             if (!oldSel.empty() && oldSel == newSel)
@@ -564,12 +607,10 @@ void CelestiaCore::mouseButtonUp(float x, float y, int button)
                                            (float) y / (float) height,
                                            pickX, pickY);
             pickX *= aspectRatio;
-            if (isViewportEffectUsed)
-                viewportEffect->distortXY(pickX, pickY);
+            Vector3f pickRay = getPickRay(pickX, pickY);
 
-            Vector3f pickRay = renderer->getProjectionMode() == Renderer::ProjectionMode::FisheyeMode ? sim->getActiveObserver()->getPickRayFisheye(pickX, pickY) : sim->getActiveObserver()->getPickRay(pickX, pickY);
-
-            Selection sel = sim->pickObject(pickRay, renderer->getRenderFlags(), pickTolerance);
+            Selection sel = sim->pickObject(pickRay, renderer->getRenderFlags(), pickTolerance,
+                                            renderer->getPickGrid(*sim->getActiveObserver()));
             if (!sel.empty())
             {
                 if (contextMenuHandler != nullptr)
@@ -598,6 +639,7 @@ void CelestiaCore::mouseButtonUp(float x, float y, int button)
 
 void CelestiaCore::mouseWheel(float motion, int modifiers)
 {
+    waitForSimulation();
     setViewChanged();
 
     if (config->reverseMouseWheel) motion = -motion;
@@ -621,6 +663,7 @@ void CelestiaCore::mouseWheel(float motion, int modifiers)
 /// x and y are the pixel coordinates relative to the widget.
 void CelestiaCore::mouseMove(float x, float y)
 {
+    waitForSimulation();
     if (m_scriptHook != nullptr && m_scriptHook->call("mousemove", x, y))
         return;
 
@@ -654,6 +697,7 @@ void CelestiaCore::mouseMove(float x, float y)
 
 void CelestiaCore::mouseMove(float dx, float dy, int modifiers)
 {
+    waitForSimulation();
     if (modifiers != 0)
         setViewChanged();
 
@@ -798,6 +842,7 @@ void CelestiaCore::mouseMove(float dx, float dy, int modifiers)
 /// Makes the view under x, y the active view.
 void CelestiaCore::pickView(float x, float y)
 {
+    waitForSimulation();
     if (x+2 < (*activeView)->x * width || x-2 > ((*activeView)->x + (*activeView)->width) * width
         || (height - y)+2 < (*activeView)->y * height ||  (height - y)-2 > ((*activeView)->y + (*activeView)->height) * height)
     {
@@ -828,6 +873,7 @@ void CelestiaCore::pickView(float x, float y)
 
 void CelestiaCore::joystickAxis(int axis, float amount)
 {
+    waitForSimulation();
     setViewChanged();
 
     float deadZone = 0.25f;
@@ -848,6 +894,7 @@ void CelestiaCore::joystickAxis(int axis, float amount)
 
 void CelestiaCore::joystickButton(int button, bool down)
 {
+    waitForSimulation();
     setViewChanged();
 
     if (button >= 0 && button < JoyButtonCount)
@@ -857,6 +904,7 @@ void CelestiaCore::joystickButton(int button, bool down)
 
 void CelestiaCore::keyDown(int key, int modifiers)
 {
+    waitForSimulation();
     setViewChanged();
 
     if (m_scriptHook != nullptr && m_scriptHook->call("keydown", float(key), float(modifiers)))
@@ -949,6 +997,7 @@ void CelestiaCore::keyDown(int key, int modifiers)
 
 void CelestiaCore::keyUp(int key, int)
 {
+    waitForSimulation();
     setViewChanged();
     KeyAccel = 1.0;
     if (islower(key))
@@ -986,6 +1035,7 @@ void CelestiaCore::charEntered(char c, int modifiers)
 
 void CelestiaCore::charEntered(const char *c_p, int modifiers)
 {
+    waitForSimulation();
     setViewChanged();
 
     Observer* observer = sim->getActiveObserver();
@@ -1034,7 +1084,7 @@ void CelestiaCore::charEntered(const char *c_p, int modifiers)
                     typedText = string(typedText, 0, typedText.size() - 1);
                     if (typedText.size() > 0)
                     {
-                        typedTextCompletion = sim->getObjectCompletion(typedText, true, (renderer->getLabelMode() & Renderer::LocationLabels) != 0);
+                        typedTextCompletion = sim->getObjectCompletion(typedText, true, (renderer->getLabelMode() & Renderer::LocationLabels) != 0, typedTextSearch);
                     } else {
                         typedTextCompletion.clear();
                     }
@@ -1805,7 +1855,23 @@ void CelestiaCore::charEntered(const char *c_p, int modifiers)
         break;
 
     case '`':
-        showFPSCounter = !showFPSCounter;
+        // The counter is followed by the page of the frame profiler, when
+        // it exists, and the page of the rendering statistics
+        if (showFPSCounter && !showProfiler && !showRenderStats && GetProfiler() != nullptr)
+        {
+            showProfiler = true;
+        }
+        else if (showFPSCounter && !showRenderStats)
+        {
+            showProfiler = false;
+            showRenderStats = true;
+        }
+        else
+        {
+            showFPSCounter = !showFPSCounter;
+            showProfiler = false;
+            showRenderStats = false;
+        }
         break;
 
     case '{':
@@ -1945,15 +2011,74 @@ void CelestiaCore::setStartURL(const string &url)
 }
 
 
+namespace
+{
+// Seconds per frame spent reading solar system catalogs in the background
+constexpr double BackgroundLoadTimeBudget = 0.008;
+
+// Shows the progress of background catalog loading as on-screen messages
+class FlashProgressNotifier : public ProgressNotifier
+{
+ public:
+    explicit FlashProgressNotifier(CelestiaCore* core) : core(core) {}
+
+    void update(const string& s) override
+    {
+        core->flash(fmt::format(_("Loading {}"), s));
+    }
+
+ private:
+    CelestiaCore* core;
+};
+}
+
 void CelestiaCore::tick()
 {
+    if (GetProfiler() != nullptr)
+        GetProfiler()->beginFrame();
+    ProfileZone zone("Tick");
+
+    finishSimulation();
+
+    // Merge catalogs loaded in the background between frames
+    if (catalogLoader != nullptr)
+    {
+        FlashProgressNotifier notifier(this);
+        if (catalogLoader->update(&notifier, BackgroundLoadTimeBudget))
+            catalogLoader = nullptr;
+    }
+    else if (catalogWatcher != nullptr)
+    {
+        double now = timer->getTime();
+        if (now - lastCatalogPoll >= config->catalogReloadInterval)
+        {
+            lastCatalogPoll = now;
+            int changes = catalogWatcher->poll();
+            if (changes != 0)
+            {
+                // Cached orbit paths may belong to orbits that changed
+                renderer->invalidateOrbitCache();
+                if ((changes & CatalogWatcher::StarsChanged) != 0)
+                    renderer->invalidateNearStars();
+                flash(_("Catalogs reloaded"));
+            }
+        }
+    }
+
+    // Write the messages logged since the last frame
+    GetLogger()->flush();
+
+    if (GetJobSystem() != nullptr)
+        GetJobSystem()->runRenderThreadJobs();
+
     double lastTime = sysTime;
     sysTime = timer->getTime();
 
     // The time step is normally driven by the system clock; however, when
     // recording a movie, we fix the time step the frame rate of the movie.
+    // Image sequences without a frame rate record at render speed.
     double dt = 0.0;
-    if (movieCapture != nullptr && recording)
+    if (movieCapture != nullptr && recording && movieCapture->getFrameRate() > 0.0f)
     {
         dt = 1.0 / movieCapture->getFrameRate();
     }
@@ -2134,20 +2259,120 @@ void CelestiaCore::tick()
     if (m_scriptHook != nullptr)
         m_scriptHook->call("tick", dt);
 
-    sim->update(dt);
+    // In pipelined mode the simulation is advanced after the frame is drawn,
+    // but no frame may be drawn after an idle tick
+    if (pipelinedSimulation && !viewIdle)
+    {
+        pendingTimeStep = pendingTimeStep.value_or(0.0) + dt;
+    }
+    else
+    {
+        sim->update(pendingTimeStep.value_or(0.0) + dt);
+        pendingTimeStep.reset();
+    }
+
+    if (remoteControl != nullptr)
+        updateRemoteControl();
+    if (cluster != nullptr && cluster->getRole() == ClusterSync::Role::Node)
+        applyClusterState();
+    viewIdle = !viewUpdateRequired();
 }
 
 
 void CelestiaCore::draw()
 {
+    finishSimulation();
+
+    bool offline = isOfflineFrame();
+    if (offline)
+        finishAsyncLoads();
+
+    if (ResourcePrefetcher* prefetcher = GetResourcePrefetcher(); prefetcher != nullptr)
+        prefetcher->update(renderer->getResolution());
+
+    // Textures decoded on the loader threads are uploaded here, where the
+    // GL context is current
+    if (config->asyncTextureLoading &&
+        GetTextureManager()->update(static_cast<std::size_t>(config->textureUploadBudget) << 20))
+    {
+        viewChanged = true;
+    }
+    // Preloaded script images aren't drawn until a script shows them
+    if (config->asyncTextureLoading)
+        GetOverlayImageManager()->update(static_cast<std::size_t>(config->textureUploadBudget) << 20);
+    if (config->asyncModelLoading &&
+        GetGeometryManager()->update(static_cast<std::size_t>(config->modelUploadBudget) << 20))
+    {
+        viewChanged = true;
+    }
+
     if (!viewUpdateRequired())
+    {
+        startSimulation();
         return;
+    }
     viewChanged = false;
+    recordDrawnState();
+    renderer->beginFrameStats();
+    if (cluster != nullptr && cluster->getRole() == ClusterSync::Role::Master)
+        cluster->sendState(captureClusterState());
+
+    if (frameGovernor != nullptr)
+    {
+        frameGovernor->beginFrame();
+        renderer->setDetailScale(frameGovernor->getDetail());
+    }
+
+    // Views looking from the same position share their visibility tests,
+    // including those drawn by viewport effects for a single view
+    bool sharedViewsSet = false;
+    if (views.size() > 1 || viewportEffect != nullptr)
+    {
+        std::vector<Renderer::SharedView> sharedViews;
+        for (const auto view : views)
+        {
+            if (view->type != View::ViewWindow)
+                continue;
+            const Observer* observer = view->isRootView() ? sim->getActiveObserver() : view->observer;
+            // The same rounding as the render region of the view
+            int viewWidth = view->width * width;
+            int viewHeight = view->height * height;
+            float aspectRatio = static_cast<float>(viewWidth) / static_cast<float>(viewHeight);
+            if (viewportEffect != nullptr && !view->stereo)
+            {
+                viewportEffect->addSharedViews(*observer, aspectRatio, sharedViews);
+            }
+            else
+            {
+                sharedViews.push_back({ observer->getPosition(),
+                                        observer->getOrientationf(),
+                                        observer->getFOV(),
+                                        aspectRatio });
+            }
+        }
+        if (sharedViews.size() > 1)
+        {
+            renderer->setSharedViews(sharedViews);
+            sharedViewsSet = true;
+        }
+    }
 
     // Render each view
     for (const auto view : views)
         draw(view);
 
+    // When rendering offline, the resources first requested by this frame
+    // are loaded and the frame is drawn again, so that the recorded frames
+    // don't depend on how long the loads took.
+    for (int pass = 1; offline && pass < MaxOfflineRenderPasses && finishAsyncLoads(); pass++)
+    {
+        for (const auto view : views)
+            draw(view);
+    }
+
+    if (sharedViewsSet)
+        renderer->clearSharedViews();
+
     // Reset to render to the main window
     if (views.size() > 1)
         renderer->setRenderRegion(0, 0, width, height, false);
@@ -2156,22 +2381,39 @@ void CelestiaCore::draw()
     if (toggleAA && (renderer->getRenderFlags() & Renderer::ShowCloudMaps))
         renderer->disableMSAA();
 
-    renderOverlay();
-    if (showConsole)
     {
-        console->setFont(font);
-        console->setColor(1.0f, 1.0f, 1.0f, 1.0f);
-        console->begin();
-        console->moveBy(safeAreaInsets.left, screenDpi / 25.4f * 53.0f);
-        console->render(Console::PageRows);
-        console->end();
+        GPUProfileZone zone(renderer->getGPUProfiler(), "Overlay");
+        renderOverlay();
+        if (showConsole)
+        {
+            console->setFont(font);
+            console->setColor(1.0f, 1.0f, 1.0f, 1.0f);
+            console->begin();
+            console->moveBy(safeAreaInsets.left, screenDpi / 25.4f * 53.0f);
+            console->render(Console::PageRows);
+            console->end();
+        }
     }
 
     if (toggleAA)
         renderer->enableMSAA();
 
-    if (movieCapture != nullptr && recording)
-        movieCapture->captureFrame();
+    if (frameGovernor != nullptr)
+        frameGovernor->endFrame();
+
+    if (movieCapture != nullptr)
+    {
+        if (recording)
+            movieCapture->captureFrame();
+        else if (movieCaptureEnding)
+            finishMovieCapture();
+    }
+
+    // Textures and models are released between frames, when no pointers
+    // to them are held
+    GetTextureManager()->evict();
+    GetGeometryManager()->evict();
+    GetOverlayImageManager()->evict();
 
     // Frame rate counter
     nFrames++;
@@ -2182,6 +2424,21 @@ void CelestiaCore::draw()
         fpsCounterStartTime = sysTime;
     }
 
+    if (config->renderStatsLogInterval > 0.0f && sysTime - lastRenderStatsLog >= config->renderStatsLogInterval)
+    {
+        logRenderStats();
+        lastRenderStatsLog = sysTime;
+    }
+
+    startSimulation();
+
+    // The machines of a cluster present their frames together
+    if (cluster != nullptr)
+    {
+        glFinish();
+        cluster->swapBarrier();
+    }
+
 #if 0
     GLenum err = glGetError();
     if (err != GL_NO_ERROR)
@@ -2194,6 +2451,7 @@ void CelestiaCore::draw()
 
 void CelestiaCore::resize(GLsizei w, GLsizei h)
 {
+    waitForSimulation();
     if (h == 0)
         h = 1;
 
@@ -2207,6 +2465,7 @@ void CelestiaCore::resize(GLsizei w, GLsizei h)
     console->setScale(w, h);
     width = w;
     height = h;
+    setViewChanged();
 
     setFOVFromZoom();
     if (m_scriptHook != nullptr && m_scriptHook->call("resize", float(w), float(h)))
@@ -2217,41 +2476,121 @@ void CelestiaCore::draw(View* view)
 {
     if (view->type != View::ViewWindow) return;
 
-    bool viewportEffectUsed = false;
+    if (view->stereo)
+    {
+        drawStereo(view);
+        return;
+    }
+
+    ViewportEffect* effectUsed = nullptr;
+
+    // Below full resolution the scene is upscaled, by the configured
+    // effect if it resamples the framebuffer of the view
+    float resolutionScale = frameGovernor != nullptr ? frameGovernor->getResolutionScale() : 1.0f;
+    ViewportEffect* effect = viewportEffect.get();
+    bool floatDepth = renderer->getReverseDepth();
+    if (effect == nullptr && (resolutionScale < 1.0f || floatDepth))
+        effect = upscaleEffect.get();
 
     FramebufferObject *fbo = nullptr;
-    if (viewportEffect != nullptr)
+    bool process = false;
+    if (effect != nullptr)
     {
-        // create/update FBO for viewport effect
-        view->updateFBO(width, height);
-        fbo = view->getFBO();
+        if (effect->usesViewFramebuffer())
+        {
+            // create/update FBO for viewport effect
+            view->updateFBO(width, height, resolutionScale, floatDepth);
+            fbo = view->getFBO();
+        }
+        process = (fbo != nullptr || !effect->usesViewFramebuffer()) &&
+                  effect->preprocess(renderer, fbo);
     }
-    bool process = fbo != nullptr && viewportEffect->preprocess(renderer, fbo);
 
     int x = view->x * width;
     int y = view->y * height;
     int viewWidth = view->width * width;
     int viewHeight = view->height * height;
     // If we need to process, we draw to the FBO which starts at point zero
-    renderer->setRenderRegion(process ? 0 : x, process ? 0 : y, viewWidth, viewHeight, !view->isRootView());
+    if (process && fbo != nullptr)
+        renderer->setRenderRegion(0, 0, fbo->width(), fbo->height(), !view->isRootView());
+    else
+        renderer->setRenderRegion(process ? 0 : x, process ? 0 : y, viewWidth, viewHeight, !view->isRootView());
 
-    if (view->isRootView())
-        sim->render(*renderer);
+    Observer* observer = view->isRootView() ? sim->getActiveObserver() : view->observer;
+    auto drawScene = [this](Observer& o) { sim->render(*renderer, o); };
+    bool drawn = true;
+    if (process)
+        drawn = effect->drawScene(renderer, fbo, viewWidth, viewHeight, *observer, drawScene);
     else
-        sim->render(*renderer, *view->observer);
+        drawScene(*observer);
 
-    // Viewport need to be reset to start from (x,y) instead of point zero
-    if (process && (x != 0 || y != 0))
+    // Viewport need to be reset to start from (x,y) instead of point zero,
+    // and to the size of the view after effects drawing views of their own
+    if (process)
         renderer->setRenderRegion(x, y, viewWidth, viewHeight);
 
-    if (process && viewportEffect->prerender(renderer, fbo))
+    if (process && effect->prerender(renderer, fbo) && drawn)
     {
-        if (viewportEffect->render(renderer, fbo, viewWidth, viewHeight))
-            viewportEffectUsed = true;
+        if (effect->render(renderer, fbo, viewWidth, viewHeight))
+            effectUsed = effect;
         else
             GetLogger()->error("Unable to render viewport effect.\n");
     }
-    isViewportEffectUsed = viewportEffectUsed;
+    usedViewportEffect = effectUsed;
+}
+
+// Draw the views of the two eyes of the observer side by side in the
+// region of view: in a single pass if the renderer supports multiview,
+// otherwise one eye after the other. Viewport effects aren't applied.
+void CelestiaCore::drawStereo(View* view)
+{
+    int x = view->x * width;
+    int y = view->y * height;
+    int eyeWidth = static_cast<int>(view->width * width) / 2;
+    int viewHeight = view->height * height;
+
+    auto render = [this, view]()
+    {
+        if (view->isRootView())
+            sim->render(*renderer);
+        else
+            sim->render(*renderer, *view->observer);
+    };
+
+    if (renderer->beginMultiview(eyeWidth, viewHeight))
+    {
+        render();
+        renderer->endMultiview(x, y);
+    }
+    else
+    {
+        renderer->setRenderRegion(x, y, eyeWidth, viewHeight, true);
+        renderer->setStereoEyes(Renderer::StereoEyes::Left);
+        render();
+        renderer->setRenderRegion(x + eyeWidth, y, eyeWidth, viewHeight, true);
+        renderer->setStereoEyes(Renderer::StereoEyes::Right);
+        render();
+        renderer->setStereoEyes(Renderer::StereoEyes::None);
+    }
+
+    usedViewportEffect = nullptr;
+}
+
+// Return the direction relative to the active observer of the point x, y
+// of the active view, in units of its height from its center
+Vector3f CelestiaCore::getPickRay(float x, float y) const
+{
+    Vector3f pickRay;
+    if (usedViewportEffect != nullptr)
+    {
+        if (usedViewportEffect->getPickRay(x, y, pickRay))
+            return pickRay;
+        usedViewportEffect->distortXY(x, y);
+    }
+
+    if (renderer->getProjectionMode() == Renderer::ProjectionMode::FisheyeMode)
+        return sim->getActiveObserver()->getPickRayFisheye(x, y);
+    return sim->getActiveObserver()->getPickRay(x, y);
 }
 
 int CelestiaCore::getSafeAreaWidth() const
@@ -2267,6 +2606,7 @@ int CelestiaCore::getSafeAreaHeight() const
 void CelestiaCore::setSafeAreaInsets(int left, int top, int right, int bottom)
 {
     safeAreaInsets = { left, top, right, bottom };
+    setViewChanged();
 }
 
 std::tuple<int, int, int, int> CelestiaCore::getSafeAreaInsets() const
@@ -2290,42 +2630,269 @@ void CelestiaCore::setPickTolerance(float newPickTolerance)
 }
 
 // Return true if anything changed that requires re-rendering. Otherwise, we
-// can skip rendering, keep the GPU idle, and save power.
+// can skip rendering, keep the GPU idle, and save power. Unless frames are
+// drawn on demand, every frame is drawn.
 bool CelestiaCore::viewUpdateRequired() const
 {
-#if 1
-    // Enable after 1.5.0
-    return true;
-#else
-    bool isPaused = sim->getPauseState() || sim->getTimeScale() == 0.0;
+    if (config == nullptr || renderer == nullptr || !config->renderOnDemand || viewChanged)
+        return true;
+
+    // Time passing or the observers moving since the last frame
+    if ((!sim->getPauseState() && sim->getTimeScale() != 0.0) ||
+        sim->getTime() != drawnTime ||
+        sim->getSelection() != drawnSelection ||
+        sim->getFaintestVisible() != drawnFaintestVisible ||
+        views.size() != drawnObservers.size())
+    {
+        return true;
+    }
 
-    // See if the camera in any of the views is moving
-    bool observersMoving = false;
+    auto drawn = drawnObservers.begin();
     for (const auto v : views)
     {
-        if (v->observer->getAngularVelocity().length() > 1.0e-10 ||
-            v->observer->getVelocity().length() > 1.0e-12)
+        const Observer* observer = v->observer;
+        if (observer->getAngularVelocity().squaredNorm() > 1.0e-20 ||
+            observer->getVelocity().squaredNorm() > 1.0e-24 ||
+            observer->getPosition().offsetFromKm(drawn->position) != Vector3d::Zero() ||
+            observer->getOrientation().coeffs() != drawn->orientation.coeffs() ||
+            observer->getFOV() != drawn->fov)
         {
-            observersMoving = true;
-            break;
+            return true;
         }
+        ++drawn;
     }
 
-    if (viewChanged ||
-        !isPaused ||
-        observersMoving ||
-        dollyMotion != 0.0 ||
+    // Input that keeps acting, scripts, whose hooks may draw anything, and
+    // movies
+    if (dollyMotion != 0.0 ||
         zoomMotion != 0.0 ||
         scriptState == ScriptRunning ||
-        renderer->settingsHaveChanged())
+        (m_script != nullptr && image != nullptr) ||
+        m_scriptHook != nullptr ||
+        (movieCapture != nullptr && recording))
     {
         return true;
     }
-    else
+
+    // Fading messages and frames, and the frame after they're gone
+    if (flashFrameDrawn ||
+        (messageDrawn && currentTime > messageStart + messageDuration - 0.5))
     {
-        return false;
+        return true;
     }
-#endif
+
+    // Catalogs, textures, models and shaders loaded in the background are
+    // only picked up by frames drawn
+    if (catalogLoader != nullptr ||
+        (config->asyncTextureLoading && GetTextureManager()->hasPendingLoads()) ||
+        (config->asyncTextureLoading && GetOverlayImageManager()->hasPendingLoads()) ||
+        (config->asyncModelLoading && GetGeometryManager()->hasPendingLoads()) ||
+        VirtualTexture::hasPendingTiles() ||
+        renderer->getShaderManager().hasPendingShaders())
+    {
+        return true;
+    }
+
+    return renderer->settingsHaveChanged();
+}
+
+
+// Seconds the front end can wait before the next tick() and draw(): none
+// while the view changes, and a longer interval while it's idle, so that
+// changes from the background are still noticed.
+double CelestiaCore::getFrameDelay() const
+{
+    if (viewUpdateRequired() || config->idleFrameRate <= 0.0f)
+        return 0.0;
+    return 1.0 / config->idleFrameRate;
+}
+
+
+// The state of the frame about to be drawn by a cluster master
+celestia::ClusterFrameState CelestiaCore::captureClusterState() const
+{
+    const Observer* observer = sim->getActiveObserver();
+
+    ClusterFrameState state;
+    state.tdb = sim->getTime();
+    state.timeScale = sim->getTimeScale();
+    state.paused = sim->getPauseState();
+    state.lightTimeDelay = lightTravelFlag;
+    state.position = observer->getPosition();
+    state.orientation = observer->getOrientation();
+    state.fov = observer->getFOV();
+    state.renderFlags = renderer->getRenderFlags();
+    state.labelMode = renderer->getLabelMode();
+    state.orbitMask = renderer->getOrbitMask();
+    state.ambientLight = renderer->getAmbientLightLevel();
+    state.faintestVisible = sim->getFaintestVisible();
+    state.selection = Url::getEncodedObjectName(sim->getSelection(), this);
+    return state;
+}
+
+
+// Render nodes draw the state of the master's frame from their own view
+// direction, instead of their own state
+void CelestiaCore::applyClusterState()
+{
+    ClusterFrameState state;
+    if (!cluster->receiveState(state, ClusterStateTimeout))
+        return;
+
+    sim->setTime(state.tdb);
+    sim->setTimeScale(state.timeScale);
+    sim->setPauseState(state.paused);
+    lightTravelFlag = state.lightTimeDelay;
+
+    // The node's own view direction is a rotation in the master's camera
+    // frame: yaw to the right, pitch up and roll clockwise
+    const Vector3f& offset = config->clusterViewOffset;
+    Quaterniond viewOffset = AngleAxisd(degToRad(-offset.x()), Vector3d::UnitY()) *
+                             AngleAxisd(degToRad(offset.y()), Vector3d::UnitX()) *
+                             AngleAxisd(degToRad(-offset.z()), Vector3d::UnitZ());
+
+    if (sim->getFrame()->getCoordinateSystem() != ObserverFrame::Universal)
+        sim->setFrame(ObserverFrame::Universal, Selection());
+    Observer* observer = sim->getActiveObserver();
+    observer->setVelocity(Vector3d::Zero());
+    observer->setAngularVelocity(Vector3d::Zero());
+    observer->setPosition(state.position);
+    observer->setOrientation(viewOffset.conjugate() * state.orientation);
+    observer->setFOV(config->clusterFOV > 0.0f ? degToRad(config->clusterFOV) : state.fov);
+
+    // Setting these marks the renderer settings as changed
+    if (renderer->getRenderFlags() != state.renderFlags)
+        renderer->setRenderFlags(state.renderFlags);
+    if (renderer->getLabelMode() != state.labelMode)
+        renderer->setLabelMode(state.labelMode);
+    if (renderer->getOrbitMask() != state.orbitMask)
+        renderer->setOrbitMask(state.orbitMask);
+    if (renderer->getAmbientLightLevel() != state.ambientLight)
+        renderer->setAmbientLightLevel(state.ambientLight);
+    sim->setFaintestVisible(state.faintestVisible);
+
+    if (state.selection != clusterSelection)
+    {
+        clusterSelection = state.selection;
+        std::string path = state.selection;
+        std::replace(path.begin(), path.end(), ':', '/');
+        sim->setSelection(path.empty() ? Selection() : sim->findObjectFromPath(path));
+    }
+
+    setViewChanged();
+}
+
+
+// Apply the commands received by the remote control, and stream the state
+// to its subscribers
+void CelestiaCore::updateRemoteControl()
+{
+    RemoteCommand command;
+    while (remoteControl->receive(command))
+    {
+        switch (command.type)
+        {
+        case RemoteCommand::SetTime:
+            sim->setTime(command.tdb);
+            sim->setTimeScale(command.timeScale);
+            sim->setPauseState(command.paused);
+            break;
+        case RemoteCommand::SetObserver:
+            {
+                if (sim->getFrame()->getCoordinateSystem() != ObserverFrame::Universal)
+                    sim->setFrame(ObserverFrame::Universal, Selection());
+                Observer* observer = sim->getActiveObserver();
+                observer->setVelocity(Vector3d::Zero());
+                observer->setAngularVelocity(Vector3d::Zero());
+                observer->setPosition(command.position);
+                observer->setOrientation(command.orientation);
+                if (command.fov > 0.0f)
+                    observer->setFOV(command.fov);
+            }
+            break;
+        case RemoteCommand::Resolve:
+            {
+                // Paths are only resolved once, the handle stands for them
+                // afterwards
+                std::uint32_t handle = remoteControl->findHandle(command.path);
+                if (handle == 0)
+                {
+                    Selection sel = sim->findObjectFromPath(command.path);
+                    if (!sel.empty())
+                        handle = remoteControl->addHandle(command.path, sel);
+                }
+                remoteControl->replyHandle(command, handle);
+            }
+            break;
+        case RemoteCommand::Select:
+            sim->setSelection(remoteControl->getHandleObject(command.handle));
+            break;
+        case RemoteCommand::SetRenderFlags:
+            // Setting these marks the renderer settings as changed
+            if (renderer->getRenderFlags() != command.renderFlags)
+                renderer->setRenderFlags(command.renderFlags);
+            if (renderer->getLabelMode() != command.labelMode)
+                renderer->setLabelMode(command.labelMode);
+            break;
+        default:
+            break;
+        }
+        setViewChanged();
+    }
+
+    if (remoteControl->isStateDue())
+    {
+        CelestiaState state(this);
+        state.captureState();
+        remoteControl->sendState(RemoteState(state));
+    }
+}
+
+
+// The rendering statistics of a frame, shown on the HUD and logged
+static std::vector<std::string> renderStatsLines(const Renderer::FrameStats& stats)
+{
+    using celestia::gl::UploadType;
+    auto kib = [&stats](UploadType type)
+    {
+        return static_cast<double>(stats.draw.uploadedBytes[static_cast<std::size_t>(type)]) / 1024.0;
+    };
+
+    return
+    {
+        fmt::format(_("Draw calls: {}, triangles: {}, lines: {}, points: {}"),
+                    stats.draw.drawCalls, stats.draw.triangles, stats.draw.lines, stats.draw.points),
+        fmt::format(_("State calls: {} made, {} skipped, program changes: {}, texture binds: {}"),
+                    stats.stateCalls, stats.stateCallsSkipped, stats.draw.programChanges, stats.draw.textureBinds),
+        fmt::format(_("Uploaded KiB: vertex {:.1f}, index {:.1f}, uniform {:.1f}, texture {:.1f}, other {:.1f}"),
+                    kib(UploadType::Vertex), kib(UploadType::Index), kib(UploadType::Uniform),
+                    kib(UploadType::Texture), kib(UploadType::Other)),
+        fmt::format(_("Octree: {} stars in {} nodes, {} DSOs in {} nodes"),
+                    stats.stars, stats.starNodes, stats.dsos, stats.dsoNodes),
+        fmt::format(_("Render list: {} entries, {} orbit paths, {} labels, {} resources loaded, {} views"),
+                    stats.renderListEntries, stats.orbitPaths, stats.annotations, stats.resourcesLoaded, stats.views),
+    };
+}
+
+
+// Remember what the frame about to be drawn shows
+void CelestiaCore::recordDrawnState()
+{
+    drawnTime = sim->getTime();
+    drawnSelection = sim->getSelection();
+    drawnFaintestVisible = sim->getFaintestVisible();
+    drawnObservers.clear();
+    for (const auto v : views)
+        drawnObservers.push_back({ v->observer->getPosition(), v->observer->getOrientation(), v->observer->getFOV() });
+}
+
+
+void CelestiaCore::logRenderStats() const
+{
+    std::string message = fmt::format(_("Rendering statistics, {:.1f} FPS"), fps);
+    for (const auto& line : renderStatsLines(renderer->getFrameStats()))
+        message += fmt::format("\n  {}", line);
+    GetLogger()->info("{}\n", message);
 }
 
 
@@ -2491,6 +3058,11 @@ void CelestiaCore::setActiveFrameVisible(bool visible)
 }
 
 
+celestia::CatalogWatcher* CelestiaCore::getCatalogWatcher() const
+{
+    return catalogWatcher.get();
+}
+
 Renderer* CelestiaCore::getRenderer() const
 {
     return renderer;
@@ -2498,6 +3070,7 @@ Renderer* CelestiaCore::getRenderer() const
 
 Simulation* CelestiaCore::getSimulation() const
 {
+    waitForSimulation();
     return sim;
 }
 
@@ -2513,6 +3086,7 @@ void CelestiaCore::showText(const std::string &s,
     messageTextPosition = std::make_unique<RelativeTextPrintPosition>(horig, vorig, hoff, voff, titleFont->getWidth("M"), titleFont->getHeight());
     messageStart = currentTime;
     messageDuration = duration;
+    setViewChanged();
 }
 
 void CelestiaCore::showTextAtPixel(const std::string &s, int x, int y, double duration)
@@ -2524,6 +3098,7 @@ void CelestiaCore::showTextAtPixel(const std::string &s, int x, int y, double du
     messageTextPosition = std::make_unique<AbsoluteTextPrintPosition>(x, y);
     messageStart = currentTime;
     messageDuration = duration;
+    setViewChanged();
 }
 
 int CelestiaCore::getTextWidth(const std::string &s) const
@@ -3108,10 +3683,39 @@ static void displaySelectionName(Overlay& overlay,
 #endif
 
 
+// Keys of the HUD text blocks, from the values their text is composed of
+template<typename T>
+static std::enable_if_t<std::is_arithmetic_v<T> || std::is_enum_v<T> || std::is_pointer_v<T>>
+addToHudKey(CacheKey& key, T value)
+{
+    key.add(&value, sizeof(value));
+}
+
+static void addToHudKey(CacheKey& key, std::string_view str)
+{
+    key.add(str);
+}
+
+static void addToHudKey(CacheKey& key, const Selection& sel)
+{
+    addToHudKey(key, sel.getType());
+    addToHudKey(key, sel.object());
+}
+
+template<typename... T>
+static std::uint64_t hudBlockKey(const T&... values)
+{
+    CacheKey key;
+    (addToHudKey(key, values), ...);
+    return key.value();
+}
+
+
 void CelestiaCore::setScriptImage(std::unique_ptr<OverlayImage> &&_image)
 {
     image = std::move(_image);
     image->setStartTime((float) currentTime);
+    setViewChanged();
 }
 
 void CelestiaCore::renderOverlay()
@@ -3154,7 +3758,8 @@ void CelestiaCore::renderOverlay()
             av->drawBorder(width, height, activeFrameColor, 2);
         }
 
-        if (currentTime < flashFrameStart + 0.5)
+        flashFrameDrawn = currentTime < flashFrameStart + 0.5;
+        if (flashFrameDrawn)
         {
             float alpha = (float) (1.0 - (currentTime - flashFrameStart) / 0.5);
             av->drawBorder(width, height, {activeFrameColor, alpha}, 8);
@@ -3196,47 +3801,49 @@ void CelestiaCore::renderOverlay()
         overlay->savePos();
         overlay->setColor(0.7f, 0.7f, 1.0f, 1.0f);
         overlay->moveBy(width - safeAreaInsets.right - dateStrWidth, height - safeAreaInsets.top - fontHeight);
-        overlay->beginText();
-
-        *overlay << dateStr;
-
-        if (lightTravelFlag && lt > 0.0)
+        std::uint64_t timeKey = hudBlockKey(font.get(), dateStr, lightTravelFlag && lt > 0.0,
+                                            sim->getTimeScale(), sim->getPauseState());
+        if (overlay->beginCachedText(timeBlock, timeKey))
         {
-            overlay->setColor(0.42f, 1.0f, 1.0f, 1.0f);
-            *overlay << _("  LT");
-            overlay->setColor(0.7f, 0.7f, 1.0f, 1.0f);
-        }
-        *overlay << '\n';
+            *overlay << dateStr;
 
-        {
-            if (abs(abs(sim->getTimeScale()) - 1) < 1e-6)
-            {
-                if (sign(sim->getTimeScale()) == 1)
-                    *overlay << _("Real time");
-                else
-                    *overlay << _("-Real time");
-            }
-            else if (abs(sim->getTimeScale()) < MinimumTimeRate)
-            {
-                *overlay << _("Time stopped");
-            }
-            else if (abs(sim->getTimeScale()) > 1.0)
+            if (lightTravelFlag && lt > 0.0)
             {
-                overlay->printf(_("%.6g x faster"), sim->getTimeScale()); // XXX: %'.12g
-            }
-            else
-            {
-                overlay->printf(_("%.6g x slower"), 1.0 / sim->getTimeScale()); // XXX: %'.12g
+                overlay->setColor(0.42f, 1.0f, 1.0f, 1.0f);
+                *overlay << _("  LT");
+                overlay->setColor(0.7f, 0.7f, 1.0f, 1.0f);
             }
+            *overlay << '\n';
 
-            if (sim->getPauseState() == true)
             {
-                overlay->setColor(1.0f, 0.0f, 0.0f, 1.0f);
-                *overlay << _(" (Paused)");
-            }
-        }
-
-        overlay->endText();
+                if (abs(abs(sim->getTimeScale()) - 1) < 1e-6)
+                {
+                    if (sign(sim->getTimeScale()) == 1)
+                        *overlay << _("Real time");
+                    else
+                        *overlay << _("-Real time");
+                }
+                else if (abs(sim->getTimeScale()) < MinimumTimeRate)
+                {
+                    *overlay << _("Time stopped");
+                }
+                else if (abs(sim->getTimeScale()) > 1.0)
+                {
+                    overlay->printf(_("%.6g x faster"), sim->getTimeScale()); // XXX: %'.12g
+                }
+                else
+                {
+                    overlay->printf(_("%.6g x slower"), 1.0 / sim->getTimeScale()); // XXX: %'.12g
+                }
+
+                if (sim->getPauseState() == true)
+                {
+                    overlay->setColor(1.0f, 0.0f, 0.0f, 1.0f);
+                    *overlay << _(" (Paused)");
+                }
+            }
+        }
+        overlay->endText();
         overlay->restorePos();
     }
 
@@ -3247,102 +3854,165 @@ void CelestiaCore::renderOverlay()
         overlay->moveBy(safeAreaInsets.left, safeAreaInsets.bottom + fontHeight * 2 + screenDpi / 25.4f * 1.3f);
         overlay->setColor(0.7f, 0.7f, 1.0f, 1.0f);
 
-        overlay->beginText();
-        *overlay << '\n';
-        if (showFPSCounter)
-#ifdef OCTREE_DEBUG
-            overlay->printf(_("FPS: %.1f, vis. stars stats: [ %zu : %zu : %zu ], vis. DSOs stats: [ %zu : %zu : %zu ]\n"),
-                         fps,
-                         getRenderer()->m_starProcStats.objects,
-                         getRenderer()->m_starProcStats.nodes,
-                         getRenderer()->m_starProcStats.height,
-                         getRenderer()->m_dsoProcStats.objects,
-                         getRenderer()->m_dsoProcStats.nodes,
-                         getRenderer()->m_dsoProcStats.height);
-#else
-            overlay->printf(_("FPS: %.1f\n"), fps);
-#endif
-        else
+        float speed = sim->getObserver().getVelocity().norm();
+        std::uint64_t velocityKey = hudBlockKey(font.get(), showFPSCounter, fps, speed, measurement);
+        if (overlay->beginCachedText(velocityBlock, velocityKey))
+        {
             *overlay << '\n';
+            if (showFPSCounter)
+                overlay->printf(_("FPS: %.1f\n"), fps);
+            else
+                *overlay << '\n';
 
-        displaySpeed(*overlay, sim->getObserver().getVelocity().norm(), measurement);
+            displaySpeed(*overlay, speed, measurement);
+        }
 
         overlay->endText();
         overlay->restorePos();
     }
 
-    Universe *u = sim->getUniverse();
-
-    if (hudDetail > 0 && (overlayElements & ShowFrame))
+    if (hudDetail > 0 && showRenderStats)
     {
-        // Field of view and camera mode in lower right corner
+        // Counters of the last frame above the FPS counter
+        auto lines = renderStatsLines(renderer->getFrameStats());
         overlay->savePos();
-        overlay->moveBy(width - safeAreaInsets.right - emWidth * 15, safeAreaInsets.bottom + fontHeight * 3 + screenDpi / 25.4f * 1.3f);
+        overlay->moveBy(safeAreaInsets.left,
+                        safeAreaInsets.bottom + fontHeight * (static_cast<float>(lines.size()) + 3.0f) + screenDpi / 25.4f * 1.3f);
+        overlay->setColor(0.7f, 0.7f, 1.0f, 1.0f);
+
         overlay->beginText();
-        overlay->setColor(0.6f, 0.6f, 1.0f, 1);
+        for (const auto& line : lines)
+            *overlay << line << '\n';
+        overlay->endText();
+        overlay->restorePos();
+    }
 
-        if (sim->getObserverMode() == Observer::Travelling)
-        {
-            double timeLeft = sim->getArrivalTime() - sim->getRealTime();
-            if (timeLeft >= 1)
-                overlay->print(_("Travelling ({})\n"),
-                               FormattedNumber(timeLeft, 0, FormattedNumber::GroupThousands));
-            else
-                overlay->print(_("Travelling\n"));
-        }
-        else
-        {
-            *overlay << '\n';
-        }
+    if (hudDetail > 0 && showProfiler && GetProfiler() != nullptr)
+    {
+        // Times of the frame profiler above the FPS counter; each zone is
+        // shown with the GPU zone of the same name
+        auto stats = GetProfiler()->getStats();
+        auto nLines = static_cast<float>((frameGovernor != nullptr ? 3 : 2) +
+                                         std::count_if(stats.begin(), stats.end(),
+                                                       [](const auto& z) { return z.source == Profiler::Source::CPU; }));
+        overlay->savePos();
+        overlay->moveBy(safeAreaInsets.left, safeAreaInsets.bottom + fontHeight * (nLines + 3.0f) + screenDpi / 25.4f * 1.3f);
+        overlay->setColor(0.7f, 0.7f, 1.0f, 1.0f);
 
-        if (!sim->getTrackedObject().empty())
+        overlay->beginText();
+        auto glStats = celestia::gl::getStateCacheStats();
+        overlay->print(_("GL state calls: {} made, {} skipped\n"), glStats.issued, glStats.skipped);
+        if (frameGovernor != nullptr)
         {
-            overlay->printf(_("Track %s\n"),
-                         CX_("Track", getSelectionName(sim->getTrackedObject(), *u)));
+            overlay->print(_("Resolution {:.0f}%, detail {:.0f}%, GPU frame {:.2f} ms\n"),
+                           frameGovernor->getResolutionScale() * 100.0f,
+                           frameGovernor->getDetail() * 100.0f,
+                           frameGovernor->getFrameTime() * 1000.0);
         }
-        else
+        *overlay << _("Frame times in ms, average (maximum):") << '\n';
+        for (const auto& zone : stats)
         {
-            *overlay << '\n';
+            if (zone.source != Profiler::Source::CPU)
+                continue;
+
+            string line = fmt::format("{:{}}{}: CPU {:.2f} ({:.2f})", "", zone.depth * 2, zone.name, zone.average, zone.maximum);
+            auto gpu = std::find_if(stats.begin(), stats.end(),
+                                    [&zone](const auto& z) { return z.source == Profiler::Source::GPU && strcmp(z.name, zone.name) == 0; });
+            if (gpu != stats.end())
+                line += fmt::format(", GPU {:.2f} ({:.2f})", gpu->average, gpu->maximum);
+            *overlay << line << '\n';
         }
+        overlay->endText();
+        overlay->restorePos();
+    }
 
+    Universe *u = sim->getUniverse();
+
+    if (hudDetail > 0 && (overlayElements & ShowFrame))
+    {
+        // Field of view and camera mode in lower right corner
+        overlay->savePos();
+        overlay->moveBy(width - safeAreaInsets.right - emWidth * 15, safeAreaInsets.bottom + fontHeight * 3 + screenDpi / 25.4f * 1.3f);
+        overlay->setColor(0.6f, 0.6f, 1.0f, 1);
+
+        // The time left is shown in whole seconds, which change at most
+        // every half second whether it's rounded or truncated
+        double travelTime = sim->getObserverMode() == Observer::Travelling
+                          ? std::floor((sim->getArrivalTime() - sim->getRealTime()) * 2.0)
+                          : 0.0;
+        float fov = radToDeg(sim->getActiveObserver()->getFOV());
+        const ObserverFrame* frame = sim->getFrame().get();
+        std::uint64_t frameKey = hudBlockKey(font.get(), sim->getObserverMode(), travelTime,
+                                             sim->getTrackedObject(),
+                                             frame->getCoordinateSystem(),
+                                             frame->getRefObject(),
+                                             frame->getTargetObject(),
+                                             PlanetarySystem::getNameGeneration(),
+                                             fov, (*activeView)->zoom);
+        if (overlay->beginCachedText(frameBlock, frameKey))
         {
-            //FrameOfReference frame = sim->getFrame();
-            Selection refObject = sim->getFrame()->getRefObject();
-            ObserverFrame::CoordinateSystem coordSys = sim->getFrame()->getCoordinateSystem();
+            if (sim->getObserverMode() == Observer::Travelling)
+            {
+                double timeLeft = sim->getArrivalTime() - sim->getRealTime();
+                if (timeLeft >= 1)
+                    overlay->print(_("Travelling ({})\n"),
+                                   FormattedNumber(timeLeft, 0, FormattedNumber::GroupThousands));
+                else
+                    overlay->print(_("Travelling\n"));
+            }
+            else
+            {
+                *overlay << '\n';
+            }
 
-            switch (coordSys)
+            if (!sim->getTrackedObject().empty())
             {
-            case ObserverFrame::Ecliptical:
-                overlay->printf(_("Follow %s\n"),
-                             CX_("Follow", getSelectionName(refObject, *u)));
-                break;
-            case ObserverFrame::BodyFixed:
-                overlay->printf(_("Sync Orbit %s\n"),
-                             CX_("Sync", getSelectionName(refObject, *u)));
-                break;
-            case ObserverFrame::PhaseLock:
-                overlay->printf(_("Lock %s -> %s\n"),
-                             CX_("Lock", getSelectionName(refObject, *u)),
-                             CX_("LockTo", getSelectionName(sim->getFrame()->getTargetObject(), *u)));
-                break;
+                overlay->printf(_("Track %s\n"),
+                             CX_("Track", getSelectionName(sim->getTrackedObject(), *u)));
+            }
+            else
+            {
+                *overlay << '\n';
+            }
 
-            case ObserverFrame::Chase:
-                overlay->printf(_("Chase %s\n"),
-                             CX_("Chase", getSelectionName(refObject, *u)));
-                break;
+            {
+                //FrameOfReference frame = sim->getFrame();
+                Selection refObject = sim->getFrame()->getRefObject();
+                ObserverFrame::CoordinateSystem coordSys = sim->getFrame()->getCoordinateSystem();
 
-            default:
-                *overlay << '\n';
-                break;
+                switch (coordSys)
+                {
+                case ObserverFrame::Ecliptical:
+                    overlay->printf(_("Follow %s\n"),
+                                 CX_("Follow", getSelectionName(refObject, *u)));
+                    break;
+                case ObserverFrame::BodyFixed:
+                    overlay->printf(_("Sync Orbit %s\n"),
+                                 CX_("Sync", getSelectionName(refObject, *u)));
+                    break;
+                case ObserverFrame::PhaseLock:
+                    overlay->printf(_("Lock %s -> %s\n"),
+                                 CX_("Lock", getSelectionName(refObject, *u)),
+                                 CX_("LockTo", getSelectionName(sim->getFrame()->getTargetObject(), *u)));
+                    break;
+
+                case ObserverFrame::Chase:
+                    overlay->printf(_("Chase %s\n"),
+                                 CX_("Chase", getSelectionName(refObject, *u)));
+                    break;
+
+                default:
+                    *overlay << '\n';
+                    break;
+                }
             }
-        }
 
-        overlay->setColor(0.7f, 0.7f, 1.0f, 1.0f);
+            overlay->setColor(0.7f, 0.7f, 1.0f, 1.0f);
 
-        // Field of view
-        float fov = radToDeg(sim->getActiveObserver()->getFOV());
-        overlay->printf(_("FOV: %s (%.2fx)\n"),
-                              angleToStr(fov), (*activeView)->zoom);
+            // Field of view
+            overlay->printf(_("FOV: %s (%.2fx)\n"),
+                                  angleToStr(fov), (*activeView)->zoom);
+        }
         overlay->endText();
         overlay->restorePos();
     }
@@ -3355,158 +4025,164 @@ void CelestiaCore::renderOverlay()
         overlay->setColor(0.7f, 0.7f, 1.0f, 1.0f);
         overlay->moveBy(safeAreaInsets.left, height - safeAreaInsets.top - titleFont->getHeight());
 
-        overlay->beginText();
         Vector3d v = sel.getPosition(sim->getTime()).offsetFromKm(sim->getObserver().getPosition());
-
-        switch (sel.getType())
-        {
-        case Selection::Type_Star:
+        std::uint64_t selectionKey = hudBlockKey(font.get(), titleFont.get(), sel, hudDetail,
+                                                 measurement, temperatureScale,
+                                                 sim->getTime(), v.x(), v.y(), v.z(),
+                                                 sim->getFrame()->getRefObject(),
+                                                 PlanetarySystem::getNameGeneration());
+        if (overlay->beginCachedText(selectionBlock, selectionKey))
+        {
+            switch (sel.getType())
             {
-                if (sel != lastSelection)
+            case Selection::Type_Star:
                 {
-                    lastSelection = sel;
-                    selectionNames = sim->getUniverse()->getStarCatalog()->getStarNameList(*sel.star());
-                }
-
-                overlay->setFont(titleFont);
-                *overlay << selectionNames;
-                overlay->setFont(font);
-                *overlay << '\n';
-                displayStarInfo(*overlay,
-                                hudDetail,
-                                *(sel.star()),
-                                *(sim->getUniverse()),
-                                astro::kilometersToLightYears(v.norm()),
-                                measurement,
-                                temperatureScale);
-            }
-            break;
+                    if (sel != lastSelection)
+                    {
+                        lastSelection = sel;
+                        selectionNames = sim->getUniverse()->getStarCatalog()->getStarNameList(*sel.star());
+                    }
 
-        case Selection::Type_DeepSky:
-            {
-                if (sel != lastSelection)
-                {
-                    lastSelection = sel;
-                    selectionNames = sim->getUniverse()->getDSOCatalog()->getDSONameList(sel.deepsky());
+                    overlay->setFont(titleFont);
+                    *overlay << selectionNames;
+                    overlay->setFont(font);
+                    *overlay << '\n';
+                    displayStarInfo(*overlay,
+                                    hudDetail,
+                                    *(sel.star()),
+                                    *(sim->getUniverse()),
+                                    astro::kilometersToLightYears(v.norm()),
+                                    measurement,
+                                    temperatureScale);
                 }
+                break;
 
-                overlay->setFont(titleFont);
-                *overlay << selectionNames;
-                overlay->setFont(font);
-                *overlay << '\n';
-                displayDSOinfo(*overlay,
-                               *sel.deepsky(),
-                               astro::kilometersToLightYears(v.norm()) - sel.deepsky()->getRadius(),
-                               measurement);
-            }
-            break;
-
-        case Selection::Type_Body:
-            {
-                // Show all names for the body
-                if (sel != lastSelection)
+            case Selection::Type_DeepSky:
                 {
-                    lastSelection = sel;
-                    auto body = sel.body();
-                    selectionNames = body->getLocalizedName(); // Primary name, might be localized
-                    const vector<string>& names = body->getNames();
+                    if (sel != lastSelection)
+                    {
+                        lastSelection = sel;
+                        selectionNames = sim->getUniverse()->getDSOCatalog()->getDSONameList(sel.deepsky());
+                    }
 
-                    // Start from the second one because primary name is already in the string
-                    auto secondName = names.begin() + 1;
+                    overlay->setFont(titleFont);
+                    *overlay << selectionNames;
+                    overlay->setFont(font);
+                    *overlay << '\n';
+                    displayDSOinfo(*overlay,
+                                   *sel.deepsky(),
+                                   astro::kilometersToLightYears(v.norm()) - sel.deepsky()->getRadius(),
+                                   measurement);
+                }
+                break;
 
-                    for (auto iter = secondName; iter != names.end(); ++iter)
+            case Selection::Type_Body:
+                {
+                    // Show all names for the body
+                    if (sel != lastSelection)
                     {
-                        selectionNames += " / ";
+                        lastSelection = sel;
+                        auto body = sel.body();
+                        selectionNames = body->getLocalizedName(); // Primary name, might be localized
+                        const vector<string>& names = body->getNames();
 
-                        // Use localized version of parent name in alternative names.
-                        string alias = *iter;
-                        Selection parent = sel.parent();
-                        if (parent.body() != nullptr)
+                        // Start from the second one because primary name is already in the string
+                        auto secondName = names.begin() + 1;
+
+                        for (auto iter = secondName; iter != names.end(); ++iter)
                         {
-                            string parentName = parent.body()->getName();
-                            string locParentName = parent.body()->getName(true);
-                            string::size_type startPos = alias.find(parentName);
-                            if (startPos != string::npos)
-                                alias.replace(startPos, parentName.length(), locParentName);
+                            selectionNames += " / ";
+
+                            // Use localized version of parent name in alternative names.
+                            string alias = *iter;
+                            Selection parent = sel.parent();
+                            if (parent.body() != nullptr)
+                            {
+                                string parentName = parent.body()->getName();
+                                string locParentName = parent.body()->getName(true);
+                                string::size_type startPos = alias.find(parentName);
+                                if (startPos != string::npos)
+                                    alias.replace(startPos, parentName.length(), locParentName);
+                            }
+
+                            selectionNames += alias;
                         }
-
-                        selectionNames += alias;
                     }
+
+                    overlay->setFont(titleFont);
+                    *overlay << selectionNames;
+                    overlay->setFont(font);
+                    *overlay << '\n';
+                    displayPlanetInfo(*overlay,
+                                      hudDetail,
+                                      *(sel.body()),
+                                      sim->getTime(),
+                                      v.norm(),
+                                      v,
+                                      measurement,
+                                      temperatureScale);
                 }
+                break;
 
+            case Selection::Type_Location:
                 overlay->setFont(titleFont);
-                *overlay << selectionNames;
+                *overlay << sel.location()->getName(true).c_str();
                 overlay->setFont(font);
                 *overlay << '\n';
-                displayPlanetInfo(*overlay,
-                                  hudDetail,
-                                  *(sel.body()),
-                                  sim->getTime(),
-                                  v.norm(),
-                                  v,
-                                  measurement,
-                                  temperatureScale);
-            }
-            break;
-
-        case Selection::Type_Location:
-            overlay->setFont(titleFont);
-            *overlay << sel.location()->getName(true).c_str();
-            overlay->setFont(font);
-            *overlay << '\n';
-            displayLocationInfo(*overlay, *(sel.location()), v.norm(), measurement);
-            break;
-
-        default:
-            break;
-        }
+                displayLocationInfo(*overlay, *(sel.location()), v.norm(), measurement);
+                break;
 
+            default:
+                break;
+            }
 
-        // Display RA/Dec for the selection, but only when the observer is near
-        // the Earth.
-        Selection refObject = sim->getFrame()->getRefObject();
-        if (refObject.body() && refObject.body()->getName() == "Earth")
-        {
-            Body* earth = refObject.body();
 
-            UniversalCoord observerPos = sim->getObserver().getPosition();
-            double distToEarthCenter = observerPos.offsetFromKm(refObject.getPosition(sim->getTime())).norm();
-            double altitude = distToEarthCenter - earth->getRadius();
-            if (altitude < 1000.0)
+            // Display RA/Dec for the selection, but only when the observer is near
+            // the Earth.
+            Selection refObject = sim->getFrame()->getRefObject();
+            if (refObject.body() && refObject.body()->getName() == "Earth")
             {
-#if 1
-                // Code to show the geocentric RA/Dec
+                Body* earth = refObject.body();
 
-                // Only show the coordinates for stars and deep sky objects, where
-                // the geocentric values will match the apparent values for observers
-                // near the Earth.
-                if (sel.star() != nullptr || sel.deepsky() != nullptr)
+                UniversalCoord observerPos = sim->getObserver().getPosition();
+                double distToEarthCenter = observerPos.offsetFromKm(refObject.getPosition(sim->getTime())).norm();
+                double altitude = distToEarthCenter - earth->getRadius();
+                if (altitude < 1000.0)
                 {
-                    Vector3d v = sel.getPosition(sim->getTime()).offsetFromKm(Selection(earth).getPosition(sim->getTime()));
-                    v = XRotation(astro::J2000Obliquity) * v;
-                    displayRADec(*overlay, v);
-                }
+#if 1
+                    // Code to show the geocentric RA/Dec
+
+                    // Only show the coordinates for stars and deep sky objects, where
+                    // the geocentric values will match the apparent values for observers
+                    // near the Earth.
+                    if (sel.star() != nullptr || sel.deepsky() != nullptr)
+                    {
+                        Vector3d v = sel.getPosition(sim->getTime()).offsetFromKm(Selection(earth).getPosition(sim->getTime()));
+                        v = XRotation(astro::J2000Obliquity) * v;
+                        displayRADec(*overlay, v);
+                    }
 #else
-                // Code to display the apparent RA/Dec for the observer
+                    // Code to display the apparent RA/Dec for the observer
 
-                // Don't show RA/Dec for the Earth itself
-                if (sel.body() != earth)
-                {
-                    Vector3d vect = sel.getPosition(sim->getTime()).offsetFromKm(observerPos);
-                    vect = XRotation(astro::J2000Obliquity) * vect;
-                    displayRADec(*overlay, vect);
-                }
+                    // Don't show RA/Dec for the Earth itself
+                    if (sel.body() != earth)
+                    {
+                        Vector3d vect = sel.getPosition(sim->getTime()).offsetFromKm(observerPos);
+                        vect = XRotation(astro::J2000Obliquity) * vect;
+                        displayRADec(*overlay, vect);
+                    }
 
-                // Show the geocentric coordinates of the observer, required for
-                // converting the selection RA/Dec from observer-centric to some
-                // other coordinate system.
-                // TODO: We should really show the planetographic (for Earth, geodetic)
-                // coordinates.
-                displayObserverPlanetocentricCoords(*overlay,
-                                                    *earth,
-                                                    observerPos,
-                                                    sim->getTime());
+                    // Show the geocentric coordinates of the observer, required for
+                    // converting the selection RA/Dec from observer-centric to some
+                    // other coordinate system.
+                    // TODO: We should really show the planetographic (for Earth, geodetic)
+                    // coordinates.
+                    displayObserverPlanetocentricCoords(*overlay,
+                                                        *earth,
+                                                        observerPos,
+                                                        sim->getTime());
 #endif
+                }
             }
         }
 
@@ -3563,7 +4239,8 @@ void CelestiaCore::renderOverlay()
     }
 
     // Text messages
-    if (messageText != "" && currentTime < messageStart + messageDuration && messageTextPosition)
+    messageDrawn = messageText != "" && currentTime < messageStart + messageDuration && messageTextPosition;
+    if (messageDrawn)
     {
         int x = 0;
         int y = 0;
@@ -3602,10 +4279,19 @@ void CelestiaCore::renderOverlay()
         overlay->moveBy((float) ((width - movieWidth) / 2),
                         (float) ((height + movieHeight) / 2 + 2));
         overlay->beginText();
-        overlay->printf(_("%dx%d at %.2f fps  %s"),
-                              movieWidth, movieHeight,
-                              movieCapture->getFrameRate(),
-                              recording ? _("Recording") : _("Paused"));
+        if (movieCapture->getFrameRate() > 0.0f)
+        {
+            overlay->printf(_("%dx%d at %.2f fps  %s"),
+                                  movieWidth, movieHeight,
+                                  movieCapture->getFrameRate(),
+                                  recording ? _("Recording") : _("Paused"));
+        }
+        else
+        {
+            overlay->printf(_("%dx%d at render speed  %s"),
+                                  movieWidth, movieHeight,
+                                  recording ? _("Recording") : _("Paused"));
+        }
 
         overlay->endText();
         overlay->restorePos();
@@ -3613,12 +4299,19 @@ void CelestiaCore::renderOverlay()
         overlay->savePos();
         overlay->moveBy((float) ((width + movieWidth) / 2 - emWidth * 5),
                         (float) ((height + movieHeight) / 2 + 2));
-        float sec = movieCapture->getFrameCount() /
-            movieCapture->getFrameRate();
-        auto min = (int) (sec / 60);
-        sec -= min * 60.0f;
         overlay->beginText();
-        overlay->print("{:3d}:{:05.2f}", min, sec);
+        if (movieCapture->getFrameRate() > 0.0f)
+        {
+            float sec = movieCapture->getFrameCount() /
+                movieCapture->getFrameRate();
+            auto min = (int) (sec / 60);
+            sec -= min * 60.0f;
+            overlay->print("{:3d}:{:05.2f}", min, sec);
+        }
+        else
+        {
+            overlay->print("{:7d}", movieCapture->getFrameCount());
+        }
         overlay->endText();
         overlay->restorePos();
 
@@ -3652,114 +4345,38 @@ void CelestiaCore::renderOverlay()
 }
 
 
-class SolarSystemLoader
-{
-    Universe* universe;
-    ProgressNotifier* notifier;
-    const vector<fs::path>& skip;
-
- public:
-    SolarSystemLoader(Universe* u,
-                      ProgressNotifier* pn,
-                      const vector<fs::path>& skip) :
-        universe(u),
-        notifier(pn),
-        skip(skip)
-    {
-    }
-
-    void process(const fs::path& filepath)
-    {
-        if (DetermineFileType(filepath) != Content_CelestiaCatalog)
-            return;
-
-        if (find(begin(skip), end(skip), filepath) != end(skip))
-        {
-            GetLogger()->info(_("Skipping solar system catalog: {}\n"), filepath);
-            return;
-        }
-        GetLogger()->info(_("Loading solar system catalog: {}\n"), filepath);
-        if (notifier != nullptr)
-            notifier->update(filepath.filename().string());
-
-        ifstream solarSysFile(filepath, ios::in);
-        if (solarSysFile.good())
-        {
-            LoadSolarSystemObjects(solarSysFile,
-                                   *universe,
-                                   filepath.parent_path());
-        }
-    }
-};
-
-template <class OBJDB> class CatalogLoader
-{
-    OBJDB*      objDB;
-    string      typeDesc;
-    ContentType contentType;
-    ProgressNotifier* notifier;
-    const vector<fs::path>& skip;
-
- public:
-    CatalogLoader(OBJDB* db,
-                  const std::string& typeDesc,
-                  const ContentType& contentType,
-                  ProgressNotifier* pn,
-                  const vector<fs::path>& skip) :
-        objDB      (db),
-        typeDesc   (typeDesc),
-        contentType(contentType),
-        notifier   (pn),
-        skip       (skip)
-    {
-    }
-
-    void process(const fs::path& filepath)
-    {
-        if (DetermineFileType(filepath) != contentType)
-            return;
-
-        if (find(begin(skip), end(skip), filepath) != end(skip))
-        {
-            GetLogger()->info(_("Skipping {} catalog: {}\n"), typeDesc, filepath);
-            return;
-        }
-        GetLogger()->info(_("Loading {} catalog: {}\n"), typeDesc, filepath);
-        if (notifier != nullptr)
-            notifier->update(filepath.filename().string());
-
-        ifstream catalogFile(filepath, ios::in);
-        if (catalogFile.good())
-        {
-            if (!objDB->load(catalogFile, filepath.parent_path()))
-                GetLogger()->error(_("Error reading {} catalog file: {}\n"), typeDesc, filepath);
-        }
-    }
-};
-
-using StarLoader = CatalogLoader<StarDatabase>;
-using DeepSkyLoader = CatalogLoader<DSODatabase>;
 
 
 bool CelestiaCore::initSimulation(const fs::path& configFileName,
                                   const vector<fs::path>& extrasDirs,
                                   ProgressNotifier* progressNotifier)
 {
-    if (!configFileName.empty())
-    {
-        config = ReadCelestiaConfig(configFileName);
-    }
-    else
     {
-        config = ReadCelestiaConfig("celestia.cfg");
+        StartupReport::Timer timer(startupReport.get(), "Configuration");
+        if (!configFileName.empty())
+        {
+            config = ReadCelestiaConfig(configFileName);
+            timer.addFile(configFileName);
+        }
+        else
+        {
+            config = ReadCelestiaConfig("celestia.cfg");
+            timer.addFile("celestia.cfg");
 
-        fs::path localConfigFile = PathExp("~/.celestia.cfg");
-        if (!localConfigFile.empty())
-            ReadCelestiaConfig(localConfigFile, config);
+            fs::path localConfigFile = PathExp("~/.celestia.cfg");
+            if (!localConfigFile.empty())
+            {
+                ReadCelestiaConfig(localConfigFile, config);
+                timer.addFile(localConfigFile);
+            }
 
-        localConfigFile = PathExp("~/.celestia-1.7.cfg");
-        if (!localConfigFile.empty())
-            ReadCelestiaConfig(localConfigFile, config);
+            localConfigFile = PathExp("~/.celestia-1.7.cfg");
+            if (!localConfigFile.empty())
+            {
+                ReadCelestiaConfig(localConfigFile, config);
+                timer.addFile(localConfigFile);
+            }
+        }
     }
 
     if (config == nullptr)
@@ -3775,6 +4392,21 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
     if (!config->leapSecondsFile.empty())
         ReadLeapSecondsFile(config->leapSecondsFile, leapSeconds);
 
+    // The intervals of the last frames are only kept for the trace
+    if (config->frameProfiler)
+        CreateProfiler(config->profilerTraceFile.empty() ? 0 : 600);
+
+    CreateJobSystem(config->workerThreads);
+
+    // The catalogs are allocated while loading, so the pages are chosen
+    // before
+    if (compareIgnoringCase(config->hugePages, "off") == 0)
+        celestia::util::setHugePageMode(celestia::util::HugePageMode::Off);
+    else if (compareIgnoringCase(config->hugePages, "explicit") == 0)
+        celestia::util::setHugePageMode(celestia::util::HugePageMode::Explicit);
+    else
+        celestia::util::setHugePageMode(celestia::util::HugePageMode::Transparent);
+
 #ifdef USE_SPICE
     if (!InitializeSpice())
     {
@@ -3828,63 +4460,36 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
 
     /***** Load the deep sky catalogs *****/
 
-    DSONameDatabase* dsoNameDB  = new DSONameDatabase;
-    DSODatabase*     dsoDB      = new DSODatabase;
-    dsoDB->setNameDatabase(dsoNameDB);
-
-    // Load first the vector of dsoCatalogFiles in the data directory (deepsky.dsc, globulars.dsc,...):
-
-    for (const auto& file : config->dsoCatalogFiles)
+    if (config->backgroundCatalogLoading)
     {
-        if (progressNotifier)
-            progressNotifier->update(file.string());
-
-        ifstream dsoFile(file, ios::in);
-        if (!dsoFile.good())
-        {
-            GetLogger()->error(_("Error opening deepsky catalog file {}.\n"), file);
-        }
-        if (!dsoDB->load(dsoFile, ""))
-        {
-            GetLogger()->error(_("Cannot read Deep Sky Objects database {}.\n"), file);
-        }
+        // Start with an empty catalog; the real one is loaded on a worker
+        // thread once the simulation is running.
+        DSODatabase* dsoDB = new DSODatabase;
+        dsoDB->setNameDatabase(new DSONameDatabase);
+        dsoDB->finish();
+        universe->setDSOCatalog(dsoDB);
     }
-
-    // Next, read all the deep sky files in the extras directories
+    else
     {
-        vector<fs::path> entries;
-        DeepSkyLoader loader(dsoDB, "deep sky object",
-                             Content_CelestiaDeepSkyCatalog,
-                             progressNotifier,
-                             config->skipExtras);
-        for (const auto& dir : config->extrasDirs)
-        {
-            if (!is_valid_directory(dir))
-                continue;
-
-            entries.clear();
-            std::error_code ec;
-            auto iter = fs::recursive_directory_iterator(dir, ec);
-            for (; iter != end(iter); iter.increment(ec))
-            {
-                if (ec)
-                    continue;
-                if (!fs::is_directory(iter->path(), ec))
-                    entries.push_back(iter->path());
-            }
-            std::sort(begin(entries), end(entries));
-            for (const auto& fn : entries)
-                loader.process(fn);
-        }
+        StartupReport::Timer timer(startupReport.get(), "Deep sky catalogs");
+        universe->setDSOCatalog(LoadDeepSkyCatalogs(*config, progressNotifier, startupReport.get()));
+        timer.setObjects(universe->getDSOCatalog()->size());
     }
-    dsoDB->finish();
-    universe->setDSOCatalog(dsoDB);
 
 
+    // The bodies of the extras catalogs are recorded as they are loaded
+    if (config->catalogReloadInterval > 0.0f)
+    {
+        catalogWatcher = make_unique<CatalogWatcher>(universe,
+                                                     config->extrasDirs,
+                                                     config->skipExtras);
+    }
+
     /***** Load the solar system catalogs *****/
     // First read the solar system files listed individually in the
     // config file.
     {
+        StartupReport::Timer timer(startupReport.get(), "Solar system catalogs");
         SolarSystemCatalog* solarSystemCatalog = new SolarSystemCatalog();
         universe->setSolarSystemCatalog(solarSystemCatalog);
         for (const auto& file : config->solarSystemFiles)
@@ -3892,6 +4497,19 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
             if (progressNotifier)
                 progressNotifier->update(file.string());
 
+            StartupReport::Timer fileTimer(startupReport.get(), file.string());
+            fileTimer.addFile(file);
+
+            if (!config->solarSystemCacheDir.empty())
+            {
+                auto catalog = PreparseCatalogFile(file, config->solarSystemCacheDir);
+                if (catalog == nullptr)
+                    GetLogger()->error(_("Error opening solar system catalog {}.\n"), file);
+                else
+                    LoadSolarSystemObjects(*catalog, *universe);
+                continue;
+            }
+
             ifstream solarSysFile(file, ios::in);
             if (!solarSysFile.good())
             {
@@ -3904,60 +4522,99 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
         }
     }
 
-    // Next, read all the solar system files in the extras directories
+    /***** Load the minor body catalogs *****/
+    if (!config->minorBodyFiles.empty())
     {
-        vector<fs::path> entries;
-        SolarSystemLoader loader(universe, progressNotifier, config->skipExtras);
-        for (const auto& dir : config->extrasDirs)
+        StartupReport::Timer timer(startupReport.get(), "Minor body catalogs");
+        Star* sun = universe->getStarCatalog()->find("Sol", false);
+        if (sun == nullptr)
         {
-            if (!is_valid_directory(dir))
-                continue;
+            GetLogger()->error(_("Minor body catalogs need the star Sol.\n"));
+        }
+        else
+        {
+            MinorBodyTable::Filter filter;
+            filter.maxAbsMag = config->minorBodyMaxAbsMag;
+            if (!config->minorBodyOrbitClasses.empty())
+            {
+                filter.orbitClasses = 0;
+                for (const auto& name : config->minorBodyOrbitClasses)
+                {
+                    unsigned int orbitClass = MinorBodyTable::parseOrbitClass(name);
+                    if (orbitClass == 0)
+                        GetLogger()->error(_("Unknown minor body orbit class {}.\n"), name);
+                    filter.orbitClasses |= orbitClass;
+                }
+            }
 
-            entries.clear();
-            std::error_code ec;
-            auto iter = fs::recursive_directory_iterator(dir, ec);
-            for (; iter != end(iter); iter.increment(ec))
+            auto* minorBodies = new MinorBodyTable(*universe, *sun);
+            for (const auto& file : config->minorBodyFiles)
             {
-                if (ec)
+                if (progressNotifier)
+                    progressNotifier->update(file.string());
+
+                StartupReport::Timer fileTimer(startupReport.get(), file.string());
+                fileTimer.addFile(file);
+
+                ifstream minorBodyFile(file, ios::in);
+                if (!minorBodyFile.good())
+                {
+                    GetLogger()->error(_("Error opening minor body catalog {}.\n"), file);
                     continue;
-                if (!fs::is_directory(iter->path(), ec))
-                    entries.push_back(iter->path());
+                }
+
+                std::size_t nRows = file.extension() == ".csv"
+                    ? minorBodies->loadSBDB(minorBodyFile, filter)
+                    : minorBodies->loadMPCORB(minorBodyFile, filter);
+                GetLogger()->info(_("Loaded {} minor bodies from {}.\n"), nRows, file);
             }
-            sort(begin(entries), end(entries));
-            for(const auto& fn : entries)
-                loader.process(fn);
+            universe->setMinorBodies(minorBodies);
         }
     }
 
-    // Load asterisms:
-    if (!config->asterismsFile.empty())
+    // Next, read all the solar system files in the extras directories and
+    // the asterisms and boundaries, unless they are loaded in the background
+    if (!config->backgroundCatalogLoading)
     {
-        ifstream asterismsFile(config->asterismsFile, ios::in);
-        if (!asterismsFile.good())
         {
-            GetLogger()->error(_("Error opening asterisms file {}.\n"),
-                               config->asterismsFile);
-        }
-        else
-        {
-            AsterismList* asterisms = ReadAsterismList(asterismsFile,
-                                                       *universe->getStarCatalog());
-            universe->setAsterisms(asterisms);
+            StartupReport::Timer timer(startupReport.get(), "Extra solar system catalogs");
+            SolarSystemLoader loader(universe, progressNotifier, config->skipExtras, catalogWatcher.get());
+            StartupReport* report = startupReport.get();
+            for (const auto& dir : config->extrasDirs)
+            {
+                ProcessCatalogFiles(ListExtrasFiles(dir),
+                                    Content_CelestiaCatalog,
+                                    config->loaderThreads,
+                                    config->solarSystemCacheDir,
+                                    [&loader, report](const fs::path& fn, PreparsedCatalog* catalog)
+                                    {
+                                        if (report == nullptr || DetermineFileType(fn) != Content_CelestiaCatalog)
+                                        {
+                                            loader.process(fn, catalog);
+                                            return;
+                                        }
+
+                                        StartupReport::Timer fileTimer(report, fn.string());
+                                        fileTimer.addFile(fn);
+                                        loader.process(fn, catalog);
+                                    });
+            }
         }
-    }
 
-    if (!config->boundariesFile.empty())
-    {
-        ifstream boundariesFile(config->boundariesFile, ios::in);
-        if (!boundariesFile.good())
         {
-            GetLogger()->error(_("Error opening constellation boundaries file {}.\n"),
-                               config->boundariesFile);
+            StartupReport::Timer timer(startupReport.get(), "Asterisms");
+            timer.addFile(config->asterismsFile);
+            universe->setAsterisms(LoadAsterisms(*config, *universe->getStarCatalog()));
+            if (const AsterismList* asterisms = universe->getAsterisms(); asterisms != nullptr)
+                timer.setObjects(asterisms->size());
         }
-        else
+
         {
-            ConstellationBoundaries* boundaries = ReadBoundaries(boundariesFile);
-            universe->setBoundaries(boundaries);
+            StartupReport::Timer timer(startupReport.get(), "Constellation boundaries");
+            timer.addFile(config->boundariesFile);
+            universe->setBoundaries(LoadBoundaries(*config));
+            if (const ConstellationBoundaries* boundaries = universe->getBoundaries(); boundaries != nullptr)
+                timer.setObjects(boundaries->getChains().size());
         }
     }
 
@@ -3986,6 +4643,17 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
     {
         if (config->viewportEffect == "passthrough")
             viewportEffect = unique_ptr<ViewportEffect>(new PassthroughViewportEffect);
+        else if (config->viewportEffect == "cubefisheye")
+        {
+            if (renderer->getProjectionMode() == Renderer::ProjectionMode::FisheyeMode)
+                GetLogger()->warn("The cubefisheye viewport effect needs the perspective projection mode\n");
+            else
+            {
+                auto effect = std::make_unique<CubeFisheyeViewportEffect>(config->domeFieldOfView);
+                effect->setFoveation(config->domeFoveaAngle, config->domeFoveaOffset, config->domePeripheryResolution);
+                viewportEffect = std::move(effect);
+            }
+        }
         else if (config->viewportEffect == "warpmesh")
         {
             if (config->warpMeshFile.empty())
@@ -4008,6 +4676,46 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
         }
     }
 
+    if (config->targetFrameRate > 0.0f)
+    {
+        if (FrameGovernor::isSupported())
+        {
+            FrameGovernor::Settings settings;
+            settings.targetFrameTime = 1.0f / config->targetFrameRate;
+            settings.minResolutionScale = config->minResolutionScale;
+            settings.minDetail = config->minDetail;
+            // The resolution can only be lowered when the scene is drawn
+            // into the framebuffer of the view
+            if (!FramebufferObject::isSupported() ||
+                (viewportEffect != nullptr && !viewportEffect->usesViewFramebuffer()))
+            {
+                settings.minResolutionScale = 1.0f;
+            }
+            frameGovernor = std::make_unique<FrameGovernor>(settings);
+            upscaleEffect = std::make_unique<PassthroughViewportEffect>();
+        }
+        else
+        {
+            GetLogger()->warn("The target frame rate needs timer queries\n");
+        }
+    }
+
+    if (config->reverseDepth)
+    {
+        // The default framebuffer rarely has a floating point depth
+        // buffer, so the scene is drawn into one of the view
+        if (Renderer::isReverseDepthSupported() && FramebufferObject::isSupported())
+        {
+            renderer->setReverseDepth(true);
+            if (upscaleEffect == nullptr)
+                upscaleEffect = std::make_unique<PassthroughViewportEffect>();
+        }
+        else
+        {
+            GetLogger()->warn("The reversed depth needs OpenGL 4.5 or GL_ARB_clip_control\n");
+        }
+    }
+
     if (!config->measurementSystem.empty())
     {
         if (compareIgnoringCase(config->measurementSystem, "imperial") == 0)
@@ -4037,7 +4745,11 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
     }
 
     View* view = new View(View::ViewWindow, renderer, sim->getActiveObserver(), 0.0f, 0.0f, 1.0f, 1.0f);
+    view->stereo = config->stereoRendering;
     views.push_back(view);
+
+    sim->getActiveObserver()->setEyeSeparation(config->eyeSeparation);
+    sim->getActiveObserver()->setConvergenceDistance(config->convergenceDistance);
     activeView = views.begin();
 
     if (!compareIgnoringCase(getConfig()->cursor, "inverting crosshair"))
@@ -4055,6 +4767,36 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
         cursorHandler->setCursorShape(defaultCursorShape);
     }
 
+    if (!config->clusterRole.empty())
+    {
+        bool master = compareIgnoringCase(config->clusterRole, "master") == 0;
+        if (master || compareIgnoringCase(config->clusterRole, "node") == 0)
+        {
+            cluster = ClusterSync::create(master ? ClusterSync::Role::Master : ClusterSync::Role::Node,
+                                          config->clusterGroup,
+                                          static_cast<std::uint16_t>(config->clusterPort),
+                                          config->clusterNodeId,
+                                          config->clusterNodes,
+                                          config->clusterBarrierTimeout);
+        }
+        else
+        {
+            GetLogger()->error(_("Unknown cluster role {}\n"), config->clusterRole);
+        }
+    }
+
+    if (config->remoteControlPort != 0)
+    {
+        remoteControl = RemoteControl::create(config->remoteControlAddress,
+                                              static_cast<std::uint16_t>(config->remoteControlPort));
+    }
+
+    // Report the messages suppressed while the catalogs were loaded
+    GetLogger()->flush();
+
+    if (config->backgroundCatalogLoading)
+        catalogLoader = make_unique<BackgroundCatalogLoader>(universe, *config, catalogWatcher.get());
+
     return true;
 }
 
@@ -4083,10 +4825,13 @@ bool CelestiaCore::initRenderer()
     detailOptions.linearFadeFraction = config->linearFadeFraction;
 
     // Prepare the scene for rendering.
-    if (!renderer->init((int) width, (int) height, detailOptions))
     {
-        fatalError(_("Failed to initialize renderer"), false);
-        return false;
+        StartupReport::Timer timer(startupReport.get(), "Renderer");
+        if (!renderer->init((int) width, (int) height, detailOptions))
+        {
+            fatalError(_("Failed to initialize renderer"), false);
+            return false;
+        }
     }
 
     if ((renderer->getRenderFlags() & Renderer::ShowAutoMag) != 0)
@@ -4095,52 +4840,135 @@ bool CelestiaCore::initRenderer()
         setFaintestAutoMag();
     }
 
-    if (config->mainFont.empty())
-        font = LoadTextureFont(renderer, "fonts/DejaVuSans.ttf,12");
-    else
-        font = LoadFontHelper(renderer, config->mainFont);
-
-    if (font == nullptr)
-        cout << _("Error loading font; text will not be visible.\n");
+    if (config->asyncTextureLoading)
+    {
+        GetTextureManager()->enableAsyncLoading(TextureLoaderThreads);
+        GetOverlayImageManager()->enableAsyncLoading(TextureLoaderThreads);
+    }
+    if (config->asyncTextureLoading && config->textureCompression)
+        SetTextureCompression(config->textureCacheDir);
+    if (config->asyncModelLoading)
+        GetGeometryManager()->enableAsyncLoading(ModelLoaderThreads);
+    if (config->asyncTextureLoading || config->asyncModelLoading)
+        EnableResourcePrefetch();
+    if (!config->modelCacheDir.empty())
+        SetModelCache(config->modelCacheDir);
+    if (!config->galaxyFormCacheDir.empty())
+        Galaxy::setFormCache(config->galaxyFormCacheDir);
+    updateAsyncLoading();
 
-    if (!config->titleFont.empty())
-        titleFont = LoadFontHelper(renderer, config->titleFont);
-    if (titleFont == nullptr)
-        titleFont = font;
+    renderer->setRenderListThreads(config->renderListThreads);
+    renderer->setCubeSphereGeometry(config->cubeSphereGeometry);
+    ModelGeometry::setPackVertices(config->packModelVertices);
+    setPipelinedSimulation(config->pipelinedSimulation);
+    renderer->setOrbitCacheBudget(static_cast<std::size_t>(config->orbitCacheMemory) << 20);
+    renderer->setStarAggregateMagnitude(config->starAggregateMagnitude);
+    renderer->setLateOrientationMargin(degToRad(std::max(config->lateOrientationMargin, 0.0f)));
+    GetTextureManager()->setMemoryBudget(static_cast<std::size_t>(config->textureMemory) << 20);
+    GetGeometryManager()->setMemoryBudget(static_cast<std::size_t>(config->modelMemory) << 20);
+    GetOverlayImageManager()->setMemoryBudget(static_cast<std::size_t>(config->overlayImageMemory) << 20);
+    if (!config->shaderCacheDir.empty())
+    {
+        renderer->getShaderManager().setProgramCache(config->shaderCacheDir);
+        if (config->shaderCacheWarmup)
+        {
+            StartupReport::Timer timer(startupReport.get(), "Shader warm-up");
+            renderer->getShaderManager().loadCachedPrograms();
+        }
+    }
 
     // Set up the overlay
     overlay = new Overlay(*renderer);
     overlay->setWindowSize(width, height);
 
-    if (config->labelFont.empty())
     {
-        renderer->setFont(Renderer::FontNormal, font);
+        StartupReport::Timer timer(startupReport.get(), "Fonts");
+        if (config->mainFont.empty())
+            font = LoadTextureFont(renderer, "fonts/DejaVuSans.ttf,12");
+        else
+            font = LoadFontHelper(renderer, config->mainFont);
+
+        if (font == nullptr)
+            cout << _("Error loading font; text will not be visible.\n");
+
+        if (!config->titleFont.empty())
+            titleFont = LoadFontHelper(renderer, config->titleFont);
+        if (titleFont == nullptr)
+            titleFont = font;
+
+        if (config->labelFont.empty())
+        {
+            renderer->setFont(Renderer::FontNormal, font);
+        }
+        else
+        {
+            auto labelFont = LoadFontHelper(renderer, config->labelFont);
+            renderer->setFont(Renderer::FontNormal, labelFont == nullptr ? font : labelFont);
+        }
+
+        renderer->setFont(Renderer::FontLarge, titleFont);
     }
+
+    logStartupReport();
+    return true;
+}
+
+
+void CelestiaCore::setStartupReport(bool enable)
+{
+    if (enable)
+        startupReport = std::make_unique<StartupReport>();
     else
+        startupReport = nullptr;
+}
+
+
+void CelestiaCore::logStartupReport()
+{
+    if (startupReport == nullptr)
+        return;
+
+    startupReport->log();
+    if (config != nullptr && config->backgroundCatalogLoading)
+        GetLogger()->info("Deep sky catalogs, asterisms, boundaries and extra solar system catalogs are loaded in the background.\n");
+    startupReport = nullptr;
+}
+
+
+MemoryUsage CelestiaCore::getMemoryUsage() const
+{
+    MemoryUsage usage("celestia");
+    if (const Universe* universe = sim == nullptr ? nullptr : sim->getUniverse(); universe != nullptr)
     {
-        auto labelFont = LoadFontHelper(renderer, config->labelFont);
-        renderer->setFont(Renderer::FontNormal, labelFont == nullptr ? font : labelFont);
+        if (const StarDatabase* stars = universe->getStarCatalog(); stars != nullptr)
+            stars->accountMemory(usage);
+        if (const DSODatabase* dsos = universe->getDSOCatalog(); dsos != nullptr)
+            dsos->accountMemory(usage);
     }
+    if (renderer != nullptr)
+        renderer->accountMemory(usage);
 
-    renderer->setFont(Renderer::FontLarge, titleFont);
-    return true;
+    GetTextureManager()->accountMemory(usage, "textures");
+    GetGeometryManager()->accountMemory(usage, "models");
+    GetOverlayImageManager()->accountMemory(usage, "overlay images");
+    GetTrajectoryManager()->accountMemory(usage, "trajectories");
+    return usage;
 }
 
 
 static void loadCrossIndex(StarDatabase* starDB,
                            StarDatabase::Catalog catalog,
-                           const fs::path& filename)
+                           const fs::path& filename,
+                           StartupReport* report)
 {
     if (!filename.empty())
     {
-        ifstream xrefFile(filename, ios::in | ios::binary);
-        if (xrefFile.good())
-        {
-            if (!starDB->loadCrossIndex(catalog, xrefFile))
-                GetLogger()->error(_("Error reading cross index {}\n"), filename);
-            else
-                GetLogger()->info(_("Loaded cross index {}\n"), filename);
-        }
+        StartupReport::Timer timer(report, fmt::format("Cross index {}", filename.filename().string()));
+        timer.addFile(filename);
+        if (!starDB->loadCrossIndex(catalog, filename))
+            GetLogger()->error(_("Error reading cross index {}\n"), filename);
+        else
+            GetLogger()->info(_("Loaded cross index {}\n"), filename);
     }
 }
 
@@ -4151,18 +4979,45 @@ bool CelestiaCore::readStars(const CelestiaConfig& cfg,
     StarDetails::SetStarTextures(cfg.starTextures);
 
     StarNameDatabase* starNameDB = nullptr;
-    ifstream starNamesFile(cfg.starNamesFile, ios::in);
-    if (starNamesFile.good())
     {
-        starNameDB = StarNameDatabase::readNames(starNamesFile);
+        StartupReport::Timer timer(startupReport.get(), "Star names");
+        timer.addFile(cfg.starNamesFile);
+
+        CacheKey namesKey;
+        namesKey.addFile(cfg.starNamesFile);
+        if (!cfg.starNamesCacheFile.empty())
+        {
+            starNameDB = new StarNameDatabase();
+            if (!starNameDB->loadCache(cfg.starNamesCacheFile, namesKey.value()))
+            {
+                delete starNameDB;
+                starNameDB = nullptr;
+            }
+        }
+
         if (starNameDB == nullptr)
-            GetLogger()->error(_("Error reading star names file\n"));
-    }
-    else
-    {
-        GetLogger()->error(_("Error opening {}\n"), cfg.starNamesFile);
+        {
+            ifstream starNamesFile(cfg.starNamesFile, ios::in);
+            if (starNamesFile.good())
+            {
+                starNameDB = StarNameDatabase::readNames(starNamesFile);
+                if (starNameDB == nullptr)
+                    GetLogger()->error(_("Error reading star names file\n"));
+                else if (!cfg.starNamesCacheFile.empty())
+                    starNameDB->saveCache(cfg.starNamesCacheFile, namesKey.value());
+            }
+            else
+            {
+                GetLogger()->error(_("Error opening {}\n"), cfg.starNamesFile);
+            }
+        }
+        if (starNameDB != nullptr)
+            timer.setObjects(starNameDB->getNameCount());
     }
 
+    // The octree allows for the space motion of the stars over this span
+    Star::SetMotionTimeSpan(cfg.starMotionTimeSpan);
+
     // First load the binary star database file.  The majority of stars
     // will be defined here.
     StarDatabase* starDB = new StarDatabase();
@@ -4171,8 +5026,10 @@ bool CelestiaCore::readStars(const CelestiaConfig& cfg,
         if (progressNotifier)
             progressNotifier->update(cfg.starDatabaseFile.string());
 
-        ifstream starFile(cfg.starDatabaseFile, ios::in | ios::binary);
-        if (!starFile.good())
+        StartupReport::Timer timer(startupReport.get(), "Stars");
+        timer.addFile(cfg.starDatabaseFile);
+        std::error_code ec;
+        if (!fs::is_regular_file(cfg.starDatabaseFile, ec))
         {
             GetLogger()->error(_("Error opening {}\n"), cfg.starDatabaseFile);
             delete starDB;
@@ -4180,22 +5037,24 @@ bool CelestiaCore::readStars(const CelestiaConfig& cfg,
             return false;
         }
 
-        if (!starDB->loadBinary(starFile))
+        if (!starDB->loadBinary(cfg.starDatabaseFile))
         {
             GetLogger()->error(_("Error reading stars file\n"));
             delete starDB;
             delete starNameDB;
             return false;
         }
+        starDB->addCatalogSource(cfg.starDatabaseFile);
+        timer.setObjects(starDB->size());
     }
 
     if (starNameDB == nullptr)
         starNameDB = new StarNameDatabase();
     starDB->setNameDatabase(starNameDB);
 
-    loadCrossIndex(starDB, StarDatabase::HenryDraper, cfg.HDCrossIndexFile);
-    loadCrossIndex(starDB, StarDatabase::SAO,         cfg.SAOCrossIndexFile);
-    loadCrossIndex(starDB, StarDatabase::Gliese,      cfg.GlieseCrossIndexFile);
+    loadCrossIndex(starDB, StarDatabase::HenryDraper, cfg.HDCrossIndexFile,     startupReport.get());
+    loadCrossIndex(starDB, StarDatabase::SAO,         cfg.SAOCrossIndexFile,    startupReport.get());
+    loadCrossIndex(starDB, StarDatabase::Gliese,      cfg.GlieseCrossIndexFile, startupReport.get());
 
     // Next, read any ASCII star catalog files specified in the StarCatalogs
     // list.
@@ -4204,43 +5063,81 @@ bool CelestiaCore::readStars(const CelestiaConfig& cfg,
         if (file.empty())
             continue;
 
+        StartupReport::Timer timer(startupReport.get(), file.string());
+        timer.addFile(file);
         ifstream starFile(file, ios::in);
         if (starFile.good())
+        {
+            std::uint32_t count = starDB->size();
             starDB->load(starFile);
+            starDB->addCatalogSource(file);
+            timer.setObjects(starDB->size() - count);
+        }
         else
+        {
             GetLogger()->error(_("Error opening star catalog {}\n"), file);
+        }
     }
 
     // Now, read supplemental star files from the extras directories
     {
-        vector<fs::path> entries;
+        StartupReport::Timer timer(startupReport.get(), "Extra star catalogs");
+        std::uint32_t count = starDB->size();
         StarLoader loader(starDB,
                           "star",
                           Content_CelestiaStarCatalog,
                           progressNotifier,
                           config->skipExtras);
+        StartupReport* report = startupReport.get();
         for (const auto& dir : config->extrasDirs)
         {
-            if (!is_valid_directory(dir))
-                continue;
+            ProcessCatalogFiles(ListExtrasFiles(dir),
+                                Content_CelestiaStarCatalog,
+                                config->loaderThreads,
+                                fs::path(),
+                                [&loader, starDB, report](const fs::path& fn, PreparsedCatalog* catalog)
+                                {
+                                    if (DetermineFileType(fn) != Content_CelestiaStarCatalog)
+                                    {
+                                        loader.process(fn, catalog);
+                                        return;
+                                    }
 
-            entries.clear();
-            std::error_code ec;
-            auto iter = fs::recursive_directory_iterator(dir, ec);
-            for (; iter != end(iter); iter.increment(ec))
-            {
-                if (ec)
-                    continue;
-                if (!fs::is_directory(iter->path(), ec))
-                    entries.push_back(iter->path());
-            }
-            std::sort(begin(entries), end(entries));
-            for (const auto& fn : entries)
-                loader.process(fn);
+                                    StartupReport::Timer fileTimer(report, fn.string());
+                                    fileTimer.addFile(fn);
+                                    std::uint32_t fileCount = starDB->size();
+                                    loader.process(fn, catalog);
+                                    starDB->addCatalogSource(fn);
+                                    fileTimer.setObjects(starDB->size() - fileCount);
+                                });
         }
+        timer.setObjects(starDB->size() - count);
     }
 
-    starDB->finish();
+    {
+        StartupReport::Timer timer(startupReport.get(), "Star octree");
+        if (!cfg.starOctreeCacheFile.empty())
+            starDB->setOctreeCacheFile(cfg.starOctreeCacheFile);
+        starDB->setLoaderThreads(cfg.loaderThreads);
+
+        OctreeSplitPolicy policy = DynamicStarOctree::defaultSplitPolicy;
+        if (cfg.starOctreeSplitThreshold > 0)
+            policy.splitThreshold = cfg.starOctreeSplitThreshold;
+        if (cfg.starOctreeMagnitudeStep > 0.0f)
+            policy.magnitudeStep = cfg.starOctreeMagnitudeStep;
+        starDB->setOctreeSplitPolicy(policy);
+
+        starDB->finish();
+        timer.setObjects(starDB->size());
+    }
+
+    // The tile sets of magnitude tiers share the memory for tiles
+    if (!cfg.starTilesFiles.empty())
+    {
+        std::size_t budget = (static_cast<std::size_t>(cfg.starTileCacheSize) << 20) / cfg.starTilesFiles.size();
+        for (const auto& file : cfg.starTilesFiles)
+            starDB->addTiles(StarTileSet::open(file, budget));
+    }
 
     universe->setStarCatalog(starDB);
 
@@ -4377,6 +5274,7 @@ bool CelestiaCore::getLightDelayActive() const
 void CelestiaCore::setLightDelayActive(bool lightDelayActive)
 {
     lightTravelFlag = lightDelayActive;
+    setViewChanged();
 }
 
 void CelestiaCore::setTextEnterMode(int mode)
@@ -4388,6 +5286,8 @@ void CelestiaCore::setTextEnterMode(int mode)
             typedText = "";
             typedTextCompletion.clear();
             typedTextCompletionIdx = -1;
+            // Catalogs may have changed since the last search
+            typedTextSearch.reset();
         }
         textEnterMode = mode;
         notifyWatchers(TextEnterModeChanged);
@@ -4438,6 +5338,7 @@ string CelestiaCore::getTimeZoneName() const
 void CelestiaCore::setTimeZoneName(const string& zone)
 {
     timeZoneName = zone;
+    setViewChanged();
 }
 
 
@@ -4461,6 +5362,7 @@ Color CelestiaCore::getTextColor()
 void CelestiaCore::setTextColor(Color newTextColor)
 {
     textColor = newTextColor;
+    setViewChanged();
 }
 
 
@@ -4473,6 +5375,7 @@ void CelestiaCore::setDateFormat(astro::Date::Format format)
 {
     dateStrWidth = 0;
     dateFormat = format;
+    setViewChanged();
 }
 
 int CelestiaCore::getOverlayElements() const
@@ -4483,6 +5386,7 @@ int CelestiaCore::getOverlayElements() const
 void CelestiaCore::setOverlayElements(int _overlayElements)
 {
     overlayElements = _overlayElements;
+    setViewChanged();
 }
 
 void CelestiaCore::initMovieCapture(MovieCapture* mc)
@@ -4493,17 +5397,43 @@ void CelestiaCore::initMovieCapture(MovieCapture* mc)
 
 void CelestiaCore::recordBegin()
 {
-    if (movieCapture != nullptr)
+    if (movieCapture != nullptr && !movieCaptureEnding)
     {
         recording = true;
         movieCapture->recordingStatus(true);
+        updateAsyncLoading();
+    }
+}
+
+bool CelestiaCore::startImageSequence(const fs::path& filename, float fps)
+{
+    if (movieCapture != nullptr)
+        return false;
+
+    int x, y, w, h;
+    renderer->getViewport(&x, &y, &w, &h);
+
+    auto* capture = new ImageSequenceCapture(renderer);
+    capture->setEncoderThreads(config->imageSequenceThreads);
+    if (compareIgnoringCase(config->imageSequenceOverflow, "drop") == 0)
+        capture->setOverflowPolicy(ImageSequenceCapture::OverflowPolicy::Drop);
+
+    if (!capture->start(filename, w, h, fps))
+    {
+        delete capture;
+        return false;
     }
+
+    initMovieCapture(capture);
+    recordBegin();
+    return true;
 }
 
 void CelestiaCore::recordPause()
 {
     recording = false;
     if (movieCapture != nullptr) movieCapture->recordingStatus(false);
+    updateAsyncLoading();
 }
 
 void CelestiaCore::recordEnd()
@@ -4511,10 +5441,131 @@ void CelestiaCore::recordEnd()
     if (movieCapture != nullptr)
     {
         recordPause();
-        movieCapture->end();
-        delete movieCapture;
-        movieCapture = nullptr;
+        // The capture may still be reading frames back from the GPU, so it
+        // is finished after the next frame, when the GL context is current.
+        movieCaptureEnding = true;
+    }
+}
+
+void CelestiaCore::finishMovieCapture()
+{
+    recordPause();
+    movieCapture->end();
+    delete movieCapture;
+    movieCapture = nullptr;
+    movieCaptureEnding = false;
+}
+
+void CelestiaCore::setOfflineRendering(bool enable)
+{
+    offlineRendering = enable;
+    updateAsyncLoading();
+}
+
+bool CelestiaCore::getOfflineRendering() const
+{
+    return offlineRendering;
+}
+
+void CelestiaCore::setPipelinedSimulation(bool enable)
+{
+    finishSimulation();
+    if (!enable && pendingTimeStep.has_value())
+    {
+        sim->update(*pendingTimeStep);
+        pendingTimeStep.reset();
     }
+
+    pipelinedSimulation = enable;
+    if (!enable && renderer != nullptr)
+        renderer->setBodySnapshot(nullptr);
+}
+
+bool CelestiaCore::getPipelinedSimulation() const
+{
+    return pipelinedSimulation;
+}
+
+void CelestiaCore::waitForSimulation() const
+{
+    if (simulationJob != nullptr)
+        simulationJob->wait();
+}
+
+// Advance the simulation by the time steps of the ticks since the last
+// frame on a worker, and compute the positions of the bodies near the
+// active observer at the new time into the back snapshot. Nothing else
+// may use the simulation until finishSimulation() is called.
+void CelestiaCore::startSimulation()
+{
+    if (!pipelinedSimulation || !pendingTimeStep.has_value() || simulationJob != nullptr)
+        return;
+
+    double dt = *pendingTimeStep;
+    pendingTimeStep.reset();
+
+    BodySnapshot& snapshot = bodySnapshots[1 - frontSnapshot];
+    float radius = renderer->getSolarSystemMaxDistance();
+    bool solarSystems = (renderer->getRenderFlags() & Renderer::ShowSolarSystemObjects) != 0;
+    simulationJob = std::make_unique<TaskGroup>(JobPriority::Interactive);
+    simulationJob->run([this, dt, &snapshot, radius, solarSystems]
+    {
+        sim->update(dt);
+        if (solarSystems)
+            snapshot.compute(*universe, sim->getActiveObserver()->getPosition(), radius, sim->getTime());
+        else
+            snapshot.clear();
+    });
+}
+
+// Wait for the simulation started after the last frame, and draw the next
+// frame from its snapshot
+void CelestiaCore::finishSimulation()
+{
+    if (simulationJob == nullptr)
+        return;
+
+    simulationJob->wait();
+    simulationJob = nullptr;
+    frontSnapshot = 1 - frontSnapshot;
+    renderer->setBodySnapshot(&bodySnapshots[frontSnapshot]);
+}
+
+// Wait for the textures and models loading in the background. Returns true
+// if any was pending.
+bool CelestiaCore::finishAsyncLoads()
+{
+    bool loaded = false;
+    if (config->asyncTextureLoading && GetTextureManager()->finishLoads())
+        loaded = true;
+    if (config->asyncTextureLoading && GetOverlayImageManager()->finishLoads())
+        loaded = true;
+    if (config->asyncModelLoading && GetGeometryManager()->finishLoads())
+        loaded = true;
+    return loaded;
+}
+
+// Offline rendering is set explicitly or, with OfflineMovieRendering, used
+// while recording a movie
+bool CelestiaCore::isOfflineFrame() const
+{
+    return offlineRendering ||
+           (config != nullptr && config->offlineMovieRendering && movieCapture != nullptr && recording);
+}
+
+// Virtual texture tiles and shaders have no placeholders to wait for, so
+// offline frames load them synchronously instead.
+void CelestiaCore::updateAsyncLoading()
+{
+    if (config == nullptr)
+        return;
+
+    bool async = !isOfflineFrame();
+    VirtualTexture::setTileLoading(async && config->asyncTextureLoading,
+                                   static_cast<std::size_t>(config->virtualTextureMemory) << 20,
+                                   config->virtualTextureAtlas,
+                                   config->sparseVirtualTextures);
+    renderer->getShaderManager().setAsyncCompilation(async && config->asyncShaderCompilation);
 }
 
 bool CelestiaCore::isCaptureActive()
@@ -4556,6 +5607,8 @@ void CelestiaCore::removeWatcher(CelestiaWatcher* watcher)
 
 void CelestiaCore::notifyWatchers(int property)
 {
+    // What the watchers are told about is shown by the view
+    viewChanged = true;
     for (const auto watcher : watchers)
     {
         watcher->notifyChange(this, property);
@@ -4565,6 +5618,7 @@ void CelestiaCore::notifyWatchers(int property)
 
 bool CelestiaCore::goToUrl(const string& urlStr)
 {
+    waitForSimulation();
     Url url(this);
     if (!url.parse(urlStr))
     {
@@ -4579,6 +5633,7 @@ bool CelestiaCore::goToUrl(const string& urlStr)
 
 void CelestiaCore::addToHistory()
 {
+    waitForSimulation();
     if (!history.empty() && historyCurrent < history.size() - 1)
     {
         // truncating history to current position
@@ -4593,6 +5648,7 @@ void CelestiaCore::addToHistory()
 
 void CelestiaCore::back()
 {
+    waitForSimulation();
     if (historyCurrent == 0)
         return;
 
@@ -4609,6 +5665,7 @@ void CelestiaCore::back()
 
 void CelestiaCore::forward()
 {
+    waitForSimulation();
     if (history.size() == 0) return;
     if (historyCurrent == history.size()-1) return;
     historyCurrent++;
@@ -4629,6 +5686,7 @@ vector<Url>::size_type CelestiaCore::getHistoryCurrent() const
 
 void CelestiaCore::setHistoryCurrent(vector<Url>::size_type curr)
 {
+    waitForSimulation();
     if (curr >= history.size()) return;
     if (historyCurrent == history.size()) {
         addToHistory();
@@ -4749,7 +5807,7 @@ bool CelestiaCore::initLuaHook(ProgressNotifier* progressNotifier)
 void CelestiaCore::setTypedText(const char *c_p)
 {
     typedText += string(c_p);
-    typedTextCompletion = sim->getObjectCompletion(typedText, true, (renderer->getLabelMode() & Renderer::LocationLabels) != 0);
+    typedTextCompletion = sim->getObjectCompletion(typedText, true, (renderer->getLabelMode() & Renderer::LocationLabels) != 0, typedTextSearch);
     typedTextCompletionIdx = -1;
 #ifdef AUTO_COMPLETION
     if (typedTextCompletion.size() == 1)
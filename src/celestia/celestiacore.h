@@ -14,11 +14,13 @@
 #include <fstream>
 #include <string>
 #include <functional>
+#include <optional>
 #include <tuple>
 #include <celutil/filetype.h>
 #include <celutil/timer.h>
 #include <celutil/watcher.h>
 // #include <celutil/watchable.h>
+#include <celengine/bodysnapshot.h>
 #include <celengine/solarsys.h>
 #include <celengine/overlay.h>
 #include <celengine/pixelformat.h>
@@ -47,10 +49,22 @@ class Url;
 class CelestiaCore;
 // class astro::Date;
 class Console;
+class FrameGovernor;
 
 namespace celestia
 {
+class BackgroundCatalogLoader;
+class CatalogWatcher;
+class ClusterFrameState;
+class ClusterSync;
+class RemoteControl;
+class StartupReport;
 class TextPrintPosition;
+namespace util
+{
+struct MemoryUsage;
+class TaskGroup;
+}
 #ifdef USE_MINIAUDIO
 class AudioSession;
 #endif
@@ -211,6 +225,11 @@ class CelestiaCore // : public Watchable<CelestiaCore>
                         const std::vector<fs::path>& extrasDirs = {},
                         ProgressNotifier* progressNotifier = nullptr);
     bool initRenderer();
+    // Report the costs of the startup stages to the logger at the end of
+    // initRenderer(); must be called before initSimulation()
+    void setStartupReport(bool enable);
+    // Estimated memory of the catalogs, caches and loaded resources
+    celestia::util::MemoryUsage getMemoryUsage() const;
     void start(double t);
     void start();
     void getLightTravelDelay(double distanceKm, int&, int&, float&);
@@ -242,10 +261,13 @@ class CelestiaCore // : public Watchable<CelestiaCore>
     void resize(GLsizei w, GLsizei h);
     void draw();
     void draw(View*);
+    void drawStereo(View*);
     void tick();
 
     Simulation* getSimulation() const;
     Renderer* getRenderer() const;
+    // Null unless CatalogReloadInterval is set in the config file
+    celestia::CatalogWatcher* getCatalogWatcher() const;
     void showText(const std::string &s,
                   int horig = 0, int vorig = 0,
                   int hoff = 0, int voff = 0,
@@ -264,6 +286,7 @@ class CelestiaCore // : public Watchable<CelestiaCore>
 
     bool viewUpdateRequired() const;
     void setViewChanged();
+    double getFrameDelay() const;
 
     const DestinationList* getDestinations();
 
@@ -278,8 +301,24 @@ class CelestiaCore // : public Watchable<CelestiaCore>
     void recordBegin();
     void recordPause();
     void recordEnd();
+    // Record the frames to images named after filename, see
+    // ImageSequenceCapture; recordEnd() stops the sequence
+    bool startImageSequence(const fs::path& filename, float fps = 0.0f);
     bool isCaptureActive();
     bool isRecording();
+    // In offline rendering, each frame waits for the resources it needs
+    // instead of drawing placeholders while they load
+    void setOfflineRendering(bool);
+    bool getOfflineRendering() const;
+    // In pipelined mode the simulation is advanced on a worker after each
+    // frame is drawn, together with the positions of the bodies near the
+    // observer, so that its cost overlaps the presentation of the frame.
+    // The state drawn then lags the input by one frame. Front ends which
+    // use the simulation other than through the methods of CelestiaCore
+    // must call waitForSimulation() first.
+    void setPipelinedSimulation(bool);
+    bool getPipelinedSimulation() const;
+    void waitForSimulation() const;
 
     void runScript(const fs::path& filename, bool i18n = true);
     void cancelScript();
@@ -416,7 +455,20 @@ class CelestiaCore // : public Watchable<CelestiaCore>
 
  protected:
     bool readStars(const CelestiaConfig&, ProgressNotifier*);
+    void logStartupReport();
     void renderOverlay();
+    void finishMovieCapture();
+    bool finishAsyncLoads();
+    bool isOfflineFrame() const;
+    void startSimulation();
+    void finishSimulation();
+    void updateAsyncLoading();
+    void recordDrawnState();
+    void logRenderStats() const;
+    celestia::ClusterFrameState captureClusterState() const;
+    void applyClusterState();
+    void updateRemoteControl();
+    Eigen::Vector3f getPickRay(float x, float y) const;
 #ifdef CELX
     bool initLuaHook(ProgressNotifier*);
 #endif // CELX
@@ -453,6 +505,7 @@ class CelestiaCore // : public Watchable<CelestiaCore>
     std::string typedText;
     std::vector<std::string> typedTextCompletion;
     int typedTextCompletionIdx{ -1 };
+    CompletionSearch typedTextSearch;
     int textEnterMode{ KbNormal };
     int hudDetail{ 2 }; // def 1
     astro::Date::Format dateFormat{ astro::Date::Locale };
@@ -488,6 +541,11 @@ class CelestiaCore // : public Watchable<CelestiaCore>
 
     // Frame rate counter variables
     bool showFPSCounter{ false };
+    // Pages of the frame profiler and the rendering statistics shown
+    // after the counter
+    bool showProfiler{ false };
+    bool showRenderStats{ false };
+    double lastRenderStatsLog{ 0.0 };
     int nFrames{ 0 };
     double fps{ 0.0 };
     double fpsCounterStartTime{ 0.0 };
@@ -503,6 +561,24 @@ class CelestiaCore // : public Watchable<CelestiaCore>
     double currentTime{ 0.0 };
 
     bool viewChanged{ true };
+    // No frame is drawn after the current tick, see tick()
+    bool viewIdle{ false };
+
+    // What the last frame drawn showed, compared with the current state by
+    // viewUpdateRequired() when frames are drawn on demand
+    struct DrawnObserver
+    {
+        UniversalCoord position;
+        Eigen::Quaterniond orientation;
+        float fov;
+    };
+    std::vector<DrawnObserver> drawnObservers;
+    double drawnTime{ 0.0 };
+    Selection drawnSelection;
+    float drawnFaintestVisible{ 0.0f };
+    // Effects of the last frame that change over real time
+    bool messageDrawn{ false };
+    bool flashFrameDrawn{ false };
 
     Eigen::Vector3f joystickRotation{ Eigen::Vector3f::Zero() };
     bool joyButtonsPressed[JoyButtonCount];
@@ -512,6 +588,17 @@ class CelestiaCore // : public Watchable<CelestiaCore>
 
     MovieCapture* movieCapture{ nullptr };
     bool recording{ false };
+    bool movieCaptureEnding{ false };
+    bool offlineRendering{ false };
+
+    bool pipelinedSimulation{ false };
+    // Time step of the ticks since the simulation was last advanced
+    std::optional<double> pendingTimeStep;
+    std::unique_ptr<celestia::util::TaskGroup> simulationJob;
+    // The renderer draws from the front snapshot while the next one is
+    // computed
+    std::array<BodySnapshot, 2> bodySnapshots;
+    std::size_t frontSnapshot{ 0 };
 
 #ifdef USE_MINIAUDIO
     std::map<int, std::shared_ptr<celestia::AudioSession>> audioSessions;
@@ -542,7 +629,16 @@ class CelestiaCore // : public Watchable<CelestiaCore>
     float pickTolerance { 4.0f };
 
     std::unique_ptr<ViewportEffect> viewportEffect { nullptr };
-    bool isViewportEffectUsed { false };
+    // The effect applied to the last frame of the active view, if any
+    ViewportEffect* usedViewportEffect { nullptr };
+
+    // Lowers the render resolution and detail to keep the target frame
+    // rate; the scene rendered at a lower resolution is upscaled by
+    // upscaleEffect unless viewportEffect resamples it anyway. The same
+    // effect copies the scene drawn into a floating point depth buffer
+    // for the reversed depth.
+    std::unique_ptr<FrameGovernor> frameGovernor;
+    std::unique_ptr<ViewportEffect> upscaleEffect;
 
     struct EdgeInsets
     {
@@ -560,12 +656,29 @@ class CelestiaCore // : public Watchable<CelestiaCore>
     Selection lastSelection;
     std::string selectionNames;
 
+    // HUD text, composed again only when what it shows changes
+    OverlayTextBlock timeBlock;
+    OverlayTextBlock velocityBlock;
+    OverlayTextBlock frameBlock;
+    OverlayTextBlock selectionBlock;
+
     std::unique_ptr<Console> console;
     std::ofstream m_logfile;
     teestream m_tee;
 
     std::vector<astro::LeapSecondRecord> leapSeconds;
 
+    std::unique_ptr<celestia::BackgroundCatalogLoader> catalogLoader;
+    std::unique_ptr<celestia::CatalogWatcher> catalogWatcher;
+    double lastCatalogPoll{ 0.0 };
+    std::unique_ptr<celestia::StartupReport> startupReport;
+
+    // Frames drawn in lockstep with other machines
+    std::unique_ptr<celestia::ClusterSync> cluster;
+    // Selection path of the last state applied by a render node
+    std::string clusterSelection;
+    std::unique_ptr<celestia::RemoteControl> remoteControl;
+
 #ifdef CELX
     friend View* getViewByObserver(CelestiaCore*, Observer*);
     friend void getObservers(CelestiaCore*, std::vector<Observer*>&);
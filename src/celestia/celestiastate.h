@@ -17,6 +17,11 @@
 
 class CelestiaCore;
 
+namespace celestia
+{
+struct RemoteState;
+}
+
 /*! The CelestiaState class holds the current observer position, orientation,
  *  frame, time, and render settings. It is designed to be serialized as a cel
  *  URL, thus strings are stored for bodies instead of Selections.
@@ -62,4 +67,5 @@ class CelestiaState
     CelestiaCore                   *m_appCore               { nullptr };
 
     friend class Url;
+    friend struct celestia::RemoteState;
 };
@@ -0,0 +1,407 @@
+// clustersync.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Synchronization of the frames drawn by a cluster of machines.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <chrono>
+#include <cstring>
+#include <set>
+#include <sstream>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
+#include <celutil/logger.h>
+#include "clustersync.h"
+
+using celestia::util::GetLogger;
+using celestia::util::readLE;
+using celestia::util::writeLE;
+
+namespace celestia
+{
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+constexpr char PacketMagic[] = "CELC";
+constexpr std::uint8_t PacketVersion = 1;
+// Magic, version, type, node and frame
+constexpr std::size_t PacketHeaderSize = 4 + 1 + 1 + 2 + 4;
+// Large enough for any state without fragmenting on Ethernet
+constexpr std::size_t MaxPacketSize = 1400;
+
+enum PacketType
+{
+    StatePacket = 1,
+    ReadyPacket = 2,
+    SwapPacket  = 3,
+};
+
+void
+writeString(std::ostream& out, std::string_view s)
+{
+    writeLE<std::uint16_t>(out, static_cast<std::uint16_t>(s.size()));
+    out.write(s.data(), static_cast<std::streamsize>(s.size()));
+}
+
+bool
+readString(std::istream& in, std::string& s)
+{
+    std::uint16_t size;
+    if (!readLE(in, size))
+        return false;
+    s.resize(size);
+    return static_cast<bool>(in.read(s.data(), size));
+}
+
+bool
+readBigFix(std::istream& in, BigFix& f)
+{
+    std::string s;
+    if (!readString(in, s))
+        return false;
+    f = BigFix::fromBase64(s);
+    return true;
+}
+
+} // end unnamed namespace
+
+std::string
+ClusterFrameState::encode() const
+{
+    std::ostringstream out(std::ios::out | std::ios::binary);
+    writeLE(out, tdb);
+    writeLE(out, timeScale);
+    writeLE<std::uint8_t>(out, (paused ? 1 : 0) | (lightTimeDelay ? 2 : 0));
+    writeString(out, position.x.toBase64());
+    writeString(out, position.y.toBase64());
+    writeString(out, position.z.toBase64());
+    writeLE(out, orientation.w());
+    writeLE(out, orientation.x());
+    writeLE(out, orientation.y());
+    writeLE(out, orientation.z());
+    writeLE(out, fov);
+    writeLE(out, renderFlags);
+    writeLE<std::int32_t>(out, labelMode);
+    writeLE<std::int32_t>(out, orbitMask);
+    writeLE(out, ambientLight);
+    writeLE(out, faintestVisible);
+    writeString(out, selection);
+    return out.str();
+}
+
+bool
+ClusterFrameState::decode(std::string_view data)
+{
+    std::istringstream in(std::string(data), std::ios::in | std::ios::binary);
+    std::uint8_t flags;
+    double w, x, y, z;
+    std::int32_t labels, orbits;
+    if (!readLE(in, tdb) || !readLE(in, timeScale) || !readLE(in, flags) ||
+        !readBigFix(in, position.x) || !readBigFix(in, position.y) || !readBigFix(in, position.z) ||
+        !readLE(in, w) || !readLE(in, x) || !readLE(in, y) || !readLE(in, z) ||
+        !readLE(in, fov) || !readLE(in, renderFlags) ||
+        !readLE(in, labels) || !readLE(in, orbits) ||
+        !readLE(in, ambientLight) || !readLE(in, faintestVisible) ||
+        !readString(in, selection))
+    {
+        return false;
+    }
+
+    paused = (flags & 1) != 0;
+    lightTimeDelay = (flags & 2) != 0;
+    orientation = Eigen::Quaterniond(w, x, y, z);
+    labelMode = labels;
+    orbitMask = orbits;
+    return true;
+}
+
+struct ClusterSync::Packet
+{
+    int type;
+    unsigned int node;
+    std::uint32_t frame;
+    std::string_view payload;
+};
+
+struct ClusterSync::Socket
+{
+    Socket() = default;
+    ~Socket();
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+
+    bool open(const std::string& group, std::uint16_t port);
+    bool send(const std::string& packet);
+    // Wait until deadline for a packet of the protocol
+    bool receive(Packet& packet, Clock::time_point deadline);
+
+#ifdef _WIN32
+    SOCKET handle{ INVALID_SOCKET };
+    bool started{ false };
+#else
+    int handle{ -1 };
+#endif
+    sockaddr_in groupAddress{};
+    char buffer[MaxPacketSize];
+};
+
+ClusterSync::Socket::~Socket()
+{
+#ifdef _WIN32
+    if (handle != INVALID_SOCKET)
+        closesocket(handle);
+    if (started)
+        WSACleanup();
+#else
+    if (handle >= 0)
+        close(handle);
+#endif
+}
+
+bool
+ClusterSync::Socket::open(const std::string& group, std::uint16_t port)
+{
+#ifdef _WIN32
+    WSADATA data;
+    if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+        return false;
+    started = true;
+    handle = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (handle == INVALID_SOCKET)
+        return false;
+#else
+    handle = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (handle < 0)
+        return false;
+#endif
+
+    groupAddress.sin_family = AF_INET;
+    groupAddress.sin_port = htons(port);
+    if (inet_pton(AF_INET, group.c_str(), &groupAddress.sin_addr) != 1)
+        return false;
+
+    // Several nodes may run on the same machine
+    int reuse = 1;
+    setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(port);
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(handle, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) != 0)
+        return false;
+
+    ip_mreq membership{};
+    membership.imr_multiaddr = groupAddress.sin_addr;
+    membership.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (setsockopt(handle, IPPROTO_IP, IP_ADD_MEMBERSHIP,
+                   reinterpret_cast<const char*>(&membership), sizeof(membership)) != 0)
+    {
+        return false;
+    }
+
+    // The packets of a cluster stay on the local network
+    int ttl = 1;
+    setsockopt(handle, IPPROTO_IP, IP_MULTICAST_TTL, reinterpret_cast<const char*>(&ttl), sizeof(ttl));
+    return true;
+}
+
+bool
+ClusterSync::Socket::send(const std::string& packet)
+{
+    auto sent = sendto(handle, packet.data(), static_cast<int>(packet.size()), 0,
+                       reinterpret_cast<const sockaddr*>(&groupAddress), sizeof(groupAddress));
+    return sent == static_cast<decltype(sent)>(packet.size());
+}
+
+bool
+ClusterSync::Socket::receive(Packet& packet, Clock::time_point deadline)
+{
+    for (;;)
+    {
+        auto wait = std::chrono::duration_cast<std::chrono::microseconds>(deadline - Clock::now());
+        if (wait.count() < 0)
+            wait = std::chrono::microseconds::zero();
+
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(handle, &readSet);
+        timeval timeout;
+        timeout.tv_sec = static_cast<long>(wait.count() / 1000000);
+        timeout.tv_usec = static_cast<long>(wait.count() % 1000000);
+        if (select(static_cast<int>(handle + 1), &readSet, nullptr, nullptr, &timeout) <= 0)
+            return false;
+
+        auto size = recv(handle, buffer, static_cast<int>(sizeof(buffer)), 0);
+        if (size < static_cast<decltype(size)>(PacketHeaderSize) ||
+            std::memcmp(buffer, PacketMagic, 4) != 0 ||
+            static_cast<std::uint8_t>(buffer[4]) != PacketVersion)
+        {
+            // Not ours, or from another version of the protocol
+            continue;
+        }
+
+        packet.type = static_cast<std::uint8_t>(buffer[5]);
+        packet.node = util::fromMemoryLE<std::uint16_t>(buffer + 6);
+        packet.frame = util::fromMemoryLE<std::uint32_t>(buffer + 8);
+        packet.payload = std::string_view(buffer + PacketHeaderSize,
+                                          static_cast<std::size_t>(size) - PacketHeaderSize);
+        return true;
+    }
+}
+
+ClusterSync::ClusterSync(Role role, std::unique_ptr<Socket>&& socket,
+                         unsigned int nodeId, unsigned int nodeCount,
+                         double barrierTimeout) :
+    role(role),
+    socket(std::move(socket)),
+    nodeId(nodeId),
+    nodeCount(nodeCount),
+    barrierTimeout(barrierTimeout)
+{
+}
+
+ClusterSync::~ClusterSync() = default;
+
+std::unique_ptr<ClusterSync>
+ClusterSync::create(Role role,
+                    const std::string& group,
+                    std::uint16_t port,
+                    unsigned int nodeId,
+                    unsigned int nodeCount,
+                    double barrierTimeout)
+{
+    auto socket = std::make_unique<Socket>();
+    if (!socket->open(group, port))
+    {
+        GetLogger()->error("Failed to join the cluster multicast group {}:{}\n", group, port);
+        return nullptr;
+    }
+
+    return std::unique_ptr<ClusterSync>(new ClusterSync(role, std::move(socket),
+                                                        nodeId, nodeCount, barrierTimeout));
+}
+
+void
+ClusterSync::send(int type, std::string_view payload)
+{
+    std::ostringstream out(std::ios::out | std::ios::binary);
+    out.write(PacketMagic, 4);
+    writeLE<std::uint8_t>(out, PacketVersion);
+    writeLE<std::uint8_t>(out, static_cast<std::uint8_t>(type));
+    writeLE<std::uint16_t>(out, static_cast<std::uint16_t>(role == Role::Master ? 0 : nodeId));
+    writeLE<std::uint32_t>(out, frame);
+    out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+
+    std::string packet = out.str();
+    if (packet.size() > MaxPacketSize)
+    {
+        GetLogger()->warn("Cluster packet of {} bytes not sent\n", packet.size());
+        return;
+    }
+    socket->send(packet);
+}
+
+void
+ClusterSync::sendState(const ClusterFrameState& state)
+{
+    ++frame;
+    send(StatePacket, state.encode());
+    inFrame = true;
+}
+
+bool
+ClusterSync::receiveState(ClusterFrameState& state, double timeout)
+{
+    // The master numbers its frames from 1 whenever it starts, so any
+    // frame other than the last one is new
+    bool found = false;
+    std::uint32_t newFrame = 0;
+    std::string newState;
+    if (hasPendingState)
+    {
+        found = true;
+        newFrame = pendingFrame;
+        newState = std::move(pendingState);
+        hasPendingState = false;
+    }
+
+    // Take the latest state that arrived, waiting for one if there's none
+    auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(timeout));
+    Packet packet;
+    while (socket->receive(packet, found ? Clock::now() : deadline))
+    {
+        if (packet.type == StatePacket && packet.frame != frame)
+        {
+            found = true;
+            newFrame = packet.frame;
+            newState.assign(packet.payload);
+        }
+    }
+
+    if (!found || !state.decode(newState))
+        return false;
+
+    frame = newFrame;
+    inFrame = true;
+    return true;
+}
+
+void
+ClusterSync::swapBarrier()
+{
+    if (!inFrame)
+        return;
+    inFrame = false;
+
+    auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(barrierTimeout));
+    Packet packet;
+    if (role == Role::Master)
+    {
+        std::set<unsigned int> readyNodes;
+        while (readyNodes.size() < nodeCount && socket->receive(packet, deadline))
+        {
+            if (packet.type == ReadyPacket && packet.frame == frame)
+                readyNodes.insert(packet.node);
+        }
+        send(SwapPacket);
+    }
+    else
+    {
+        send(ReadyPacket);
+        while (socket->receive(packet, deadline))
+        {
+            if (packet.type == SwapPacket && packet.frame == frame)
+                break;
+
+            // The swap was lost and the master went on
+            if (packet.type == StatePacket && packet.frame != frame)
+            {
+                hasPendingState = true;
+                pendingFrame = packet.frame;
+                pendingState.assign(packet.payload);
+                break;
+            }
+        }
+    }
+}
+
+} // end namespace celestia
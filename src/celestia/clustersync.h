@@ -0,0 +1,124 @@
+// clustersync.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Synchronization of the frames drawn by a cluster of machines.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <Eigen/Geometry>
+#include <celengine/univcoord.h>
+
+namespace celestia
+{
+
+/**
+ * The state of a frame drawn by the master of a cluster, which the render
+ * nodes draw instead of their own.
+ */
+struct ClusterFrameState
+{
+    double tdb{ 0.0 };
+    double timeScale{ 1.0 };
+    bool paused{ false };
+    bool lightTimeDelay{ false };
+    // Observer position and orientation in the universal frame
+    UniversalCoord position;
+    Eigen::Quaterniond orientation{ Eigen::Quaterniond::Identity() };
+    float fov{ 0.0f };
+    std::uint64_t renderFlags{ 0 };
+    int labelMode{ 0 };
+    int orbitMask{ 0 };
+    float ambientLight{ 0.0f };
+    float faintestVisible{ 0.0f };
+    // Path of the selected object, as in cel URLs
+    std::string selection;
+
+    std::string encode() const;
+    bool decode(std::string_view data);
+};
+
+/**
+ * Keeps the frames drawn by several machines, such as those driving the
+ * projectors of a dome, in lockstep over UDP multicast.
+ *
+ * The master sends the state of each frame it draws, and the render nodes
+ * wait for it and draw it from their own view direction. At the end of a
+ * frame all of them wait at a swap barrier: the nodes report that their
+ * frame is drawn, and the master tells them to present it once all of them
+ * did. The barrier gives up after a timeout, so that a node that stopped
+ * doesn't stop the others.
+ */
+class ClusterSync
+{
+ public:
+    enum class Role
+    {
+        Master,
+        Node,
+    };
+
+    ~ClusterSync();
+    ClusterSync(const ClusterSync&) = delete;
+    ClusterSync& operator=(const ClusterSync&) = delete;
+
+    /**
+     * Join the multicast group at port. The master waits for nodeCount
+     * render nodes at the swap barrier; a render node reports as nodeId.
+     * Returns null if the socket can't be set up.
+     */
+    static std::unique_ptr<ClusterSync> create(Role role,
+                                               const std::string& group,
+                                               std::uint16_t port,
+                                               unsigned int nodeId,
+                                               unsigned int nodeCount,
+                                               double barrierTimeout);
+
+    Role getRole() const { return role; }
+
+    // Master: send the state of the frame about to be drawn
+    void sendState(const ClusterFrameState& state);
+
+    // Render node: wait up to timeout seconds for the state of a frame
+    // after the last one received. Frames that were missed are skipped.
+    bool receiveState(ClusterFrameState& state, double timeout);
+
+    // Wait at the swap barrier of the frame last sent or received, once it
+    // has been drawn
+    void swapBarrier();
+
+ private:
+    struct Socket;
+    struct Packet;
+
+    ClusterSync(Role role, std::unique_ptr<Socket>&& socket,
+                unsigned int nodeId, unsigned int nodeCount,
+                double barrierTimeout);
+
+    void send(int type, std::string_view payload = {});
+
+    Role role;
+    std::unique_ptr<Socket> socket;
+    unsigned int nodeId;
+    unsigned int nodeCount;
+    double barrierTimeout;
+
+    std::uint32_t frame{ 0 };
+    // A frame was sent or received since the last swap barrier
+    bool inFrame{ false };
+    // State of the next frame, received by a node at the swap barrier
+    bool hasPendingState{ false };
+    std::uint32_t pendingFrame{ 0 };
+    std::string pendingState;
+};
+
+} // end namespace celestia
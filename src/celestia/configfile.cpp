@@ -11,6 +11,7 @@
 #include <iostream>
 #include <fstream>
 #include <cassert>
+#include <limits>
 #include <celutil/logger.h>
 #include <celutil/fsutils.h>
 #include <celengine/texmanager.h>
@@ -84,7 +85,32 @@ CelestiaConfig* ReadCelestiaConfig(const fs::path& filename, CelestiaConfig *con
     configParams->getPath("AsterismsFile", config->asterismsFile);
     configParams->getPath("BoundariesFile", config->boundariesFile);
     configParams->getPath("StarDatabase", config->starDatabaseFile);
+    configParams->getPath("StarOctreeCache", config->starOctreeCacheFile);
+    // A single tile file, or those of the magnitude tiers of a catalog
+    if (const Value* starTilesVal = configParams->getValue("StarTiles"); starTilesVal != nullptr)
+    {
+        if (starTilesVal->getType() == Value::StringType)
+        {
+            config->starTilesFiles.push_back(PathExp(starTilesVal->getString()));
+        }
+        else if (starTilesVal->getType() == Value::ArrayType)
+        {
+            for (const auto tilesVal : *starTilesVal->getArray())
+            {
+                if (tilesVal->getType() == Value::StringType)
+                    config->starTilesFiles.push_back(PathExp(tilesVal->getString()));
+                else
+                    GetLogger()->error("{}: Star tile file name must be a string.\n", filename);
+            }
+        }
+        else
+        {
+            GetLogger()->error("{}: StarTiles must be a string or an array.\n", filename);
+        }
+    }
+    configParams->getPath("SolarSystemCache", config->solarSystemCacheDir);
     configParams->getPath("StarNameDatabase", config->starNamesFile);
+    configParams->getPath("StarNameCache", config->starNamesCacheFile);
     configParams->getPath("HDCrossIndex", config->HDCrossIndexFile);
     configParams->getPath("SAOCrossIndex", config->SAOCrossIndexFile);
     configParams->getPath("GlieseCrossIndex", config->GlieseCrossIndexFile);
@@ -97,8 +123,33 @@ CelestiaConfig* ReadCelestiaConfig(const fs::path& filename, CelestiaConfig *con
     configParams->getString("ProjectionMode", config->projectionMode);
     configParams->getString("ViewportEffect", config->viewportEffect);
     configParams->getString("WarpMeshFile", config->warpMeshFile);
+    config->domeFieldOfView = 180.0f;
+    configParams->getNumber("DomeFieldOfView", config->domeFieldOfView);
+    config->domeFoveaAngle = 180.0f;
+    configParams->getNumber("DomeFoveaAngle", config->domeFoveaAngle);
+    config->domeFoveaOffset = 0.0f;
+    configParams->getNumber("DomeFoveaOffset", config->domeFoveaOffset);
+    config->domePeripheryResolution = 0.5f;
+    configParams->getNumber("DomePeripheryResolution", config->domePeripheryResolution);
+    config->targetFrameRate = 0.0f;
+    configParams->getNumber("TargetFrameRate", config->targetFrameRate);
+    config->minResolutionScale = 0.5f;
+    configParams->getNumber("MinResolutionScale", config->minResolutionScale);
+    config->minDetail = 0.25f;
+    configParams->getNumber("MinDetail", config->minDetail);
+    config->reverseDepth = false;
+    configParams->getBoolean("ReverseDepth", config->reverseDepth);
+    config->stereoRendering = false;
+    configParams->getBoolean("StereoRendering", config->stereoRendering);
+    config->eyeSeparation = 0.0;
+    configParams->getNumber("EyeSeparation", config->eyeSeparation);
+    config->convergenceDistance = 0.0;
+    configParams->getNumber("ConvergenceDistance", config->convergenceDistance);
     configParams->getString("X264EncoderOptions", config->x264EncoderOptions);
     configParams->getString("FFVHEncoderOptions", config->ffvhEncoderOptions);
+    config->imageSequenceThreads = getUint(configParams, "ImageSequenceThreads", 0);
+    config->imageSequenceOverflow = "block";
+    configParams->getString("ImageSequenceOverflow", config->imageSequenceOverflow);
     configParams->getString("MeasurementSystem", config->measurementSystem);
     configParams->getString("TemperatureScale", config->temperatureScale);
 
@@ -107,6 +158,23 @@ CelestiaConfig* ReadCelestiaConfig(const fs::path& filename, CelestiaConfig *con
     config->SolarSystemMaxDistance = min(max(maxDist, 1.0f), 10.0f);
 
     config->ShadowMapSize = getUint(configParams, "ShadowMapSize", 0);
+    config->gpuStarField = false;
+    configParams->getBoolean("GPUStarField", config->gpuStarField);
+    config->gpuOrbits = false;
+    configParams->getBoolean("GPUOrbits", config->gpuOrbits);
+    config->modelInstancing = false;
+    configParams->getBoolean("ModelInstancing", config->modelInstancing);
+    config->packModelVertices = false;
+    configParams->getBoolean("PackModelVertices", config->packModelVertices);
+    config->dsoImpostors = false;
+    configParams->getBoolean("DSOImpostors", config->dsoImpostors);
+    config->labelDeclutter = false;
+    configParams->getBoolean("LabelDeclutter", config->labelDeclutter);
+    config->frameProfiler = false;
+    configParams->getBoolean("FrameProfiler", config->frameProfiler);
+    configParams->getPath("ProfilerTraceFile", config->profilerTraceFile);
+    config->renderStatsLogInterval = 0.0f;
+    configParams->getNumber("RenderStatsLogInterval", config->renderStatsLogInterval);
 
     double aaSamples = 1;
     configParams->getNumber("AntialiasingSamples", aaSamples);
@@ -121,6 +189,8 @@ CelestiaConfig* ReadCelestiaConfig(const fs::path& filename, CelestiaConfig *con
     configParams->getPath("ScriptScreenshotDirectory", config->scriptScreenshotDirectory);
     config->scriptSystemAccessPolicy = "ask";
     configParams->getString("ScriptSystemAccessPolicy", config->scriptSystemAccessPolicy);
+    config->scriptTickBudget = 10.0;
+    configParams->getNumber("ScriptTickBudget", config->scriptTickBudget);
 
     config->orbitWindowEnd = 0.5f;
     configParams->getNumber("OrbitWindowEnd", config->orbitWindowEnd);
@@ -135,6 +205,119 @@ CelestiaConfig* ReadCelestiaConfig(const fs::path& filename, CelestiaConfig *con
 
     config->consoleLogRows = getUint(configParams, "LogSize", 200);
 
+    config->loaderThreads = getUint(configParams, "LoaderThreads", 0);
+    config->hugePages = "transparent";
+    configParams->getString("HugePages", config->hugePages);
+    config->workerThreads = getUint(configParams, "WorkerThreads", 0);
+    config->pipelinedSimulation = false;
+    configParams->getBoolean("PipelinedSimulation", config->pipelinedSimulation);
+    config->lateOrientationMargin = 2.0f;
+    configParams->getNumber("LateOrientationMargin", config->lateOrientationMargin);
+    config->renderListThreads = getUint(configParams, "RenderListThreads", 1);
+    config->cubeSphereGeometry = false;
+    configParams->getBoolean("CubeSphereGeometry", config->cubeSphereGeometry);
+    config->starTileCacheSize = getUint(configParams, "StarTileCacheSize", 256);
+    config->starAggregateMagnitude = std::numeric_limits<float>::infinity();
+    configParams->getNumber("StarAggregateMagnitude", config->starAggregateMagnitude);
+    config->starMotionTimeSpan = 10000.0f;
+    configParams->getNumber("StarMotionTimeSpan", config->starMotionTimeSpan);
+    config->starOctreeSplitThreshold = getUint(configParams, "StarOctreeSplitThreshold", 0);
+    config->starOctreeMagnitudeStep = 0.0f;
+    configParams->getNumber("StarOctreeMagnitudeStep", config->starOctreeMagnitudeStep);
+    config->dsoOctreeSplitThreshold = getUint(configParams, "DeepSkyOctreeSplitThreshold", 0);
+    config->dsoOctreeMagnitudeStep = 0.0f;
+    configParams->getNumber("DeepSkyOctreeMagnitudeStep", config->dsoOctreeMagnitudeStep);
+    config->backgroundCatalogLoading = false;
+    configParams->getBoolean("BackgroundCatalogLoading", config->backgroundCatalogLoading);
+    config->catalogReloadInterval = 0.0f;
+    configParams->getNumber("CatalogReloadInterval", config->catalogReloadInterval);
+    config->asyncTextureLoading = false;
+    configParams->getBoolean("AsyncTextureLoading", config->asyncTextureLoading);
+    config->textureUploadBudget = getUint(configParams, "TextureUploadBudget", 16);
+    config->textureCompression = false;
+    configParams->getBoolean("TextureCompression", config->textureCompression);
+    configParams->getPath("TextureCache", config->textureCacheDir);
+    config->virtualTextureMemory = getUint(configParams, "VirtualTextureMemory", 0);
+    config->virtualTextureAtlas = false;
+    configParams->getBoolean("VirtualTextureAtlas", config->virtualTextureAtlas);
+    config->sparseVirtualTextures = false;
+    configParams->getBoolean("SparseVirtualTextures", config->sparseVirtualTextures);
+    config->textureMemory = getUint(configParams, "TextureMemory", 0);
+    config->modelMemory = getUint(configParams, "ModelMemory", 0);
+    config->overlayImageMemory = getUint(configParams, "OverlayImageMemory", 256);
+    config->orbitCacheMemory = getUint(configParams, "OrbitCacheMemory", 16);
+    config->asyncModelLoading = false;
+    configParams->getBoolean("AsyncModelLoading", config->asyncModelLoading);
+    config->modelUploadBudget = getUint(configParams, "ModelUploadBudget", 8);
+    configParams->getPath("ModelCache", config->modelCacheDir);
+    configParams->getPath("ShaderCache", config->shaderCacheDir);
+    configParams->getPath("GalaxyFormCache", config->galaxyFormCacheDir);
+    config->shaderCacheWarmup = false;
+    configParams->getBoolean("ShaderCacheWarmup", config->shaderCacheWarmup);
+    config->asyncShaderCompilation = false;
+    configParams->getBoolean("AsyncShaderCompilation", config->asyncShaderCompilation);
+    config->offlineMovieRendering = false;
+    configParams->getBoolean("OfflineMovieRendering", config->offlineMovieRendering);
+    config->renderOnDemand = false;
+    configParams->getBoolean("RenderOnDemand", config->renderOnDemand);
+    config->idleFrameRate = 10.0f;
+    configParams->getNumber("IdleFrameRate", config->idleFrameRate);
+    configParams->getString("ClusterRole", config->clusterRole);
+    config->clusterGroup = "239.255.42.99";
+    configParams->getString("ClusterGroup", config->clusterGroup);
+    config->clusterPort = getUint(configParams, "ClusterPort", 4242);
+    config->clusterNodes = getUint(configParams, "ClusterNodes", 0);
+    config->clusterNodeId = getUint(configParams, "ClusterNodeId", 1);
+    config->clusterBarrierTimeout = 0.1f;
+    configParams->getNumber("ClusterBarrierTimeout", config->clusterBarrierTimeout);
+    config->clusterViewOffset = Eigen::Vector3f::Zero();
+    configParams->getVector("ClusterViewOffset", config->clusterViewOffset);
+    config->clusterFOV = 0.0f;
+    configParams->getNumber("ClusterFOV", config->clusterFOV);
+    config->remoteControlAddress = "127.0.0.1";
+    configParams->getString("RemoteControlAddress", config->remoteControlAddress);
+    config->remoteControlPort = getUint(configParams, "RemoteControlPort", 0);
+
+    Value* minorBodiesVal = configParams->getValue("MinorBodyCatalogs");
+    if (minorBodiesVal != nullptr)
+    {
+        if (minorBodiesVal->getType() != Value::ArrayType)
+        {
+            GetLogger()->error("{}: MinorBodyCatalogs must be an array.\n", filename);
+        }
+        else
+        {
+            for (const auto catalogNameVal : *minorBodiesVal->getArray())
+            {
+                if (catalogNameVal->getType() == Value::StringType)
+                    config->minorBodyFiles.push_back(PathExp(catalogNameVal->getString()));
+                else
+                    GetLogger()->error("{}: Minor body catalog name must be a string.\n", filename);
+            }
+        }
+    }
+
+    config->minorBodyMaxAbsMag = std::numeric_limits<float>::infinity();
+    configParams->getNumber("MinorBodyMagnitudeLimit", config->minorBodyMaxAbsMag);
+    Value* orbitClassesVal = configParams->getValue("MinorBodyOrbitClasses");
+    if (orbitClassesVal != nullptr)
+    {
+        if (orbitClassesVal->getType() != Value::ArrayType)
+        {
+            GetLogger()->error("{}: MinorBodyOrbitClasses must be an array.\n", filename);
+        }
+        else
+        {
+            for (const auto orbitClassVal : *orbitClassesVal->getArray())
+            {
+                if (orbitClassVal->getType() == Value::StringType)
+                    config->minorBodyOrbitClasses.push_back(orbitClassVal->getString());
+                else
+                    GetLogger()->error("{}: Orbit class name must be a string.\n", filename);
+            }
+        }
+    }
+
     Value* solarSystemsVal = configParams->getValue("SolarSystemCatalogs");
     if (solarSystemsVal != nullptr)
     {
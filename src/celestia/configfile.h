@@ -12,6 +12,7 @@
 
 #include <string>
 #include <vector>
+#include <Eigen/Core>
 #include <celengine/parser.h>
 #include <celengine/star.h>
 #include <celcompat/filesystem.h>
@@ -21,8 +22,34 @@ class CelestiaConfig
 {
 public:
     fs::path starDatabaseFile;
+    fs::path starOctreeCacheFile;
+    std::vector<fs::path> starTilesFiles;
+    // Memory for star tiles in MiB, shared by all tile files
+    unsigned int starTileCacheSize;
+    // Stars fainter than this are drawn from the combined light of
+    // distant octree nodes; infinite when not set
+    float starAggregateMagnitude;
+    // Years before and after J2000 over which stars follow their space
+    // motion
+    float starMotionTimeSpan;
+    // Split policies of the star and deep sky octrees, see
+    // OctreeSplitPolicy; zero keeps the built-in value
+    unsigned int starOctreeSplitThreshold;
+    float starOctreeMagnitudeStep;
+    unsigned int dsoOctreeSplitThreshold;
+    float dsoOctreeMagnitudeStep;
     fs::path starNamesFile;
+    fs::path starNamesCacheFile;
     std::vector<fs::path> solarSystemFiles;
+    fs::path solarSystemCacheDir;
+    // Orbit files of minor planets in the format of MPCORB.DAT, or CSV
+    // files from the small body database of JPL
+    std::vector<fs::path> minorBodyFiles;
+    // Minor planets fainter than this absolute magnitude aren't loaded;
+    // infinite when not set
+    float minorBodyMaxAbsMag;
+    // Names of the orbit classes of minor planets loaded, all when empty
+    std::vector<std::string> minorBodyOrbitClasses;
     std::vector<fs::path> starCatalogFiles;
     std::vector<fs::path> dsoCatalogFiles;
     std::vector<fs::path> extrasDirs;
@@ -49,6 +76,8 @@ public:
     double linearFadeFraction;
     fs::path scriptScreenshotDirectory;
     std::string scriptSystemAccessPolicy;
+    // Milliseconds a script may run per frame, zero for no limit
+    double scriptTickBudget;
 #ifdef CELX
     fs::path luaHook;
     Hash* configParams;
@@ -69,6 +98,77 @@ public:
 
     unsigned int consoleLogRows;
 
+    unsigned int loaderThreads;
+    // Pages backing the star and deep sky arrays: "off", "transparent" or
+    // "explicit", see celestia::util::HugePageMode
+    std::string hugePages;
+    // Threads of the shared job system, 0 for one per processor core
+    // other than the render thread's
+    unsigned int workerThreads;
+    // Advance the simulation on a worker while the front end presents a
+    // frame, see CelestiaCore::setPipelinedSimulation()
+    bool pipelinedSimulation;
+    // Widening of the culling frustum in degrees, bounding the rotation
+    // to a late orientation, see Renderer::LateOrientationSource
+    float lateOrientationMargin;
+    unsigned int renderListThreads;
+    bool cubeSphereGeometry;
+    bool backgroundCatalogLoading;
+    // Seconds between checks of the extras catalogs for changes, 0 to
+    // never reload them
+    float catalogReloadInterval;
+    bool asyncTextureLoading;
+    // Texture data uploaded per frame in MiB
+    unsigned int textureUploadBudget;
+    // Compress the textures loaded asynchronously, see
+    // SetTextureCompression()
+    bool textureCompression;
+    fs::path textureCacheDir;
+    // Memory for the tiles of each virtual texture in MiB, 0 for no limit
+    unsigned int virtualTextureMemory;
+    bool virtualTextureAtlas;
+    bool sparseVirtualTextures;
+    // Memory of the loaded textures in MiB, 0 for no limit
+    unsigned int textureMemory;
+    // Memory of the loaded models in MiB, 0 for no limit
+    unsigned int modelMemory;
+    // Memory of the images loaded by scripts in MiB, 0 for no limit
+    unsigned int overlayImageMemory;
+    // Memory of the cached orbit paths in MiB
+    unsigned int orbitCacheMemory;
+    bool asyncModelLoading;
+    // Model data uploaded per frame in MiB
+    unsigned int modelUploadBudget;
+    fs::path modelCacheDir;
+    fs::path shaderCacheDir;
+    fs::path galaxyFormCacheDir;
+    bool shaderCacheWarmup;
+    bool asyncShaderCompilation;
+    bool offlineMovieRendering;
+    // Draw frames only when the view changes, see
+    // CelestiaCore::viewUpdateRequired(); ticks while idle run at
+    // idleFrameRate per second
+    bool renderOnDemand;
+    float idleFrameRate;
+    // Empty, "master" or "node", see celestia::ClusterSync
+    std::string clusterRole;
+    std::string clusterGroup;
+    unsigned int clusterPort;
+    // Render nodes the master waits for at the swap barrier
+    unsigned int clusterNodes;
+    unsigned int clusterNodeId;
+    // Seconds to wait at the swap barrier
+    float clusterBarrierTimeout;
+    // View direction of a render node relative to the master's, as yaw,
+    // pitch and roll in degrees, and its field of view in degrees, 0 for
+    // the master's
+    Eigen::Vector3f clusterViewOffset;
+    float clusterFOV;
+    // UDP port of the remote control, none if 0, see
+    // celestia::RemoteControl
+    std::string remoteControlAddress;
+    unsigned int remoteControlPort;
+
     Hash* params;
 
     float getFloatValue(const std::string& name);
@@ -76,15 +176,49 @@ public:
 
     float SolarSystemMaxDistance;
     unsigned ShadowMapSize;
+    bool gpuStarField;
+    bool gpuOrbits;
+    bool modelInstancing;
+    bool packModelVertices;
+    bool dsoImpostors;
+    bool labelDeclutter;
+    // Time the phases of the frames, and write the last ones to
+    // profilerTraceFile on exit when it's set
+    bool frameProfiler;
+    fs::path profilerTraceFile;
+    // Seconds between log messages of the rendering statistics, 0 for none
+    float renderStatsLogInterval;
 
     std::string projectionMode;
     std::string viewportEffect;
     std::string warpMeshFile;
+    // Aperture in degrees of the dome of the cubefisheye viewport effect
+    float domeFieldOfView;
+    // Foveated drawing of the dome, see CubeFisheyeViewportEffect::setFoveation()
+    float domeFoveaAngle;
+    float domeFoveaOffset;
+    float domePeripheryResolution;
+    // Frame rate kept by lowering the render resolution and detail down
+    // to the minimums, 0 to draw at full quality, see FrameGovernor
+    float targetFrameRate;
+    float minResolutionScale;
+    float minDetail;
+    // Draw the solar system objects with a reversed floating point depth
+    // instead of partitioning the depth buffer, see Renderer::setReverseDepth()
+    bool reverseDepth;
+    bool stereoRendering;
+    // Distances in kilometers, see Observer::getEyeSeparation()
+    double eyeSeparation;
+    double convergenceDistance;
     std::string measurementSystem;
     std::string temperatureScale;
 
     std::string x264EncoderOptions;
     std::string ffvhEncoderOptions;
+    // Encoder threads of image sequences, 0 for one per hardware thread,
+    // and what to do with frames when they fall behind: "block" or "drop"
+    unsigned int imageSequenceThreads;
+    std::string imageSequenceOverflow;
 
     fs::path leapSecondsFile;
 };
@@ -10,21 +10,52 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
-#include <cstring>
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <thread>
 
 #include <Eigen/Geometry>
 
 #include "eclipsefinder.h"
+#include <celengine/timeline.h>
+#include <celengine/timelinephase.h>
 #include "celmath/ray.h"
 #include "celmath/distance.h"
+#include <celutil/jobsystem.h>
 
 using namespace Eigen;
 using namespace std;
 using namespace celmath;
 
 
+namespace
+{
+
+// Precision of eclipse start and end times: one minute
 constexpr const double dT = 1.0 / (24.0 * 60.0);
+
+// Eclipses are searched for on a grid of one hour steps; the grid is split
+// into chunks of thirty days which are searched independently.
+constexpr const double SearchStep = 1.0 / 24.0;
+constexpr const long StepsPerChunk = 24 * 30;
+
+// Largest stride in minutes taken while looking for the end of an eclipse
+// before bisecting; kept well below the shortest time between two eclipses
+// of the same pair.
+constexpr const long MaxContactStride = 64;
+
+// The rate bound used to skip steps ignores accelerations, so only trust
+// half of the span it gives, and never skip more than a sixteenth of the
+// satellite's orbit.
+constexpr const double SkipSafetyFactor = 2.0;
+constexpr const double MaxSkipPeriodFraction = 1.0 / 16.0;
+
+constexpr const auto ProgressInterval = chrono::milliseconds(50);
+
 constexpr const int EclipseObjectMask = Body::Planet      |
                                         Body::Moon        |
                                         Body::MinorMoon   |
@@ -32,24 +63,29 @@ constexpr const int EclipseObjectMask = Body::Planet      |
                                         Body::Asteroid;
 
 // TODO: share this constant and function with render.cpp
-static const float MinRelativeOccluderRadius = 0.005f;
+const float MinRelativeOccluderRadius = 0.005f;
 
-EclipseFinder::EclipseFinder(Body* _body,
-                             EclipseFinderWatcher* _watcher) :
-    body(_body),
-    watcher(_watcher)
+struct FoundEclipse
+{
+    long step; // grid step at which the eclipse was detected
+    Eclipse eclipse;
+};
+
+
+// Ignore situations where the shadow casting body is much smaller than
+// the receiver, as these shadows aren't likely to be relevant.  Also,
+// ignore eclipses where the caster is not an ellipsoid, since we can't
+// generate correct shadows in this case.
+bool canEclipse(const Body& receiver, const Body& caster)
 {
+    return caster.getRadius() >= receiver.getRadius() * MinRelativeOccluderRadius &&
+           caster.isEllipsoid();
 }
 
 
 bool testEclipse(const Body& receiver, const Body& caster, double now)
 {
-    // Ignore situations where the shadow casting body is much smaller than
-    // the receiver, as these shadows aren't likely to be relevant.  Also,
-    // ignore eclipses where the caster is not an ellipsoid, since we can't
-    // generate correct shadows in this case.
-    if (caster.getRadius() >= receiver.getRadius() * MinRelativeOccluderRadius &&
-        caster.isEllipsoid())
+    if (canEclipse(receiver, caster))
     {
         // All of the eclipse related code assumes that both the caster
         // and receiver are spherical.  Irregular receivers will work more
@@ -101,106 +137,193 @@ bool testEclipse(const Body& receiver, const Body& caster, double now)
     return false;
 }
 
-#if 1
-double findEclipseSpan(const Body& receiver, const Body& caster,
-                       double now, double dt)
-{
-    double t = now;
-    while (testEclipse(receiver, caster, t))
-        t += dt;
 
-    return t;
-}
-#else
-// Given a time during an eclipse, find the start of the eclipse to
-// a precision of minStep.
-double findEclipseStart(const Body& receiver, const Body& occulter,
-                        double now,
-                        double startStep,
-                        double minStep)
+// Given a time during an eclipse, find the first whole minute after
+// (direction = 1) or before (direction = -1) it when the receiver is no
+// longer eclipsed. This gives the same result as stepping a minute at a
+// time, but strides ahead and bisects so only the contact is resolved to
+// the minute.
+double findEclipseSpan(const Body& receiver, const Body& caster,
+                       double now, int direction)
 {
-    double step = startStep / 2;
-    double t = now - step;
-    bool eclipsed = true;
+    long inside = 0;
+    long outside = 1;
+    long stride = 1;
+    while (testEclipse(receiver, caster, now + direction * outside * dT))
+    {
+        inside = outside;
+        stride = min(stride * 2, MaxContactStride);
+        outside = inside + stride;
+    }
 
-    // Perform a binary search to find the end of the eclipse
-    while (step > minStep)
+    while (outside - inside > 1)
     {
-        eclipsed = testEclipse(receiver, occulter, t);
-        step *= 0.5;
-        if (eclipsed)
-            t -= step;
+        long mid = (inside + outside) / 2;
+        if (testEclipse(receiver, caster, now + direction * mid * dT))
+            inside = mid;
         else
-            t += step;
+            outside = mid;
     }
 
-    // Always return a time when the receiver is /not/ in eclipse
-    if (eclipsed)
-        t -= step;
+    return now + direction * outside * dT;
+}
+
 
-    return t;
+bool addEclipse(const Body& receiver, const Body& occulter,
+                double now, long step,
+                vector<FoundEclipse>& found,
+                double& previousEclipseEndTime)
+{
+    if (!testEclipse(receiver, occulter, now))
+        return false;
+
+    Eclipse eclipse;
+    eclipse.startTime = findEclipseSpan(receiver, occulter, now, -1);
+    eclipse.endTime = findEclipseSpan(receiver, occulter, now, 1);
+    eclipse.receiver = const_cast<Body*>(&receiver);
+    eclipse.occulter = const_cast<Body*>(&occulter);
+    found.push_back({ step, eclipse });
+
+    previousEclipseEndTime = eclipse.endTime;
+    return true;
 }
 
-// Given a time during an eclipse, find the end of the eclipse to
-// a precision of minStep.
-double findEclipseEnd(const Body& receiver, const Body& occulter,
-                      double now,
-                      double startStep,
-                      double minStep)
+
+// Return a span of time after the positions were sampled during which the
+// receiver can't enter the caster's shadow. How far the receiver is from
+// the shadow axis changes no faster than the speed of the pair relative
+// to each other plus the sweep of the axis as the caster moves around the
+// sun; the shadow radius grows with the distance between them. Dividing
+// the margin left before contact by that rate bounds the time to contact.
+double eclipseFreeSpan(const Body& receiver, const Body& caster,
+                       const Vector3d& posReceiver, const Vector3d& velReceiver,
+                       const Vector3d& posCaster, const Vector3d& velCaster)
 {
-    // First do a coarse search to find the eclipse end to within the precision
-    // of startStep.
-    while (testEclipse(receiver, occulter, now + startStep))
-        now += startStep;
+    double sunRadius = receiver.getSystem()->getStar()->getRadius();
+    double distToSun = posReceiver.norm();
+
+    Vector3d dir = posCaster - posReceiver;
+    double distToCaster = dir.norm() - receiver.getRadius();
+    double shadowRadius = caster.getRadius() + sunRadius / distToSun * distToCaster;
+    double dist = distance(posReceiver, Eigen::ParametrizedLine<double, 3>(posCaster, posCaster));
+    double margin = dist - (receiver.getRadius() + shadowRadius);
+    if (margin <= 0.0)
+        return 0.0;
+
+    double relativeSpeed = (velCaster - velReceiver).norm();
+    double axisRate = velCaster.norm() / posCaster.norm();
+    double rate = relativeSpeed * (1.0 + sunRadius / distToSun) + dir.norm() * axisRate;
+    if (rate <= 0.0)
+        return numeric_limits<double>::infinity();
+
+    return margin / (rate * SkipSafetyFactor);
+}
 
-    double step = startStep / 2;
-    double t = now + step;
-    bool eclipsed = true;
+
+// Return the number of grid steps after t that can be skipped because no
+// eclipse between body and testBody can be in progress at any of them.
+long eclipseFreeSteps(const Body& body, const Body& testBody,
+                      bool solar, bool lunar, double t)
+{
+    const Orbit* orbit = testBody.getOrbit(t);
+    if (!orbit->isPeriodic())
+        return 1;
+
+    Vector3d posBody = body.getAstrocentricPosition(t);
+    Vector3d posTest = testBody.getAstrocentricPosition(t);
+    Vector3d velBody = (body.getAstrocentricPosition(t + dT) - posBody) / dT;
+    Vector3d velTest = (testBody.getAstrocentricPosition(t + dT) - posTest) / dT;
+
+    double span = orbit->getPeriod() * MaxSkipPeriodFraction;
+    if (solar)
+        span = min(span, eclipseFreeSpan(body, testBody, posBody, velBody, posTest, velTest));
+    if (lunar)
+        span = min(span, eclipseFreeSpan(testBody, body, posTest, velTest, posBody, velBody));
+
+    return max(1L, static_cast<long>(span / SearchStep));
+}
 
 
-    // Perform a binary search to find the end of the eclipse
-    while (step > minStep)
+// Search grid steps [first, last) for eclipses between body and one of
+// its satellites. progress is called with the time of each step visited
+// and the number of steps covered since the last call, and returns false
+// to abort the search.
+template<typename F>
+void searchSteps(const Body& body, const Body& testBody,
+                 int eclipseTypeMask, double startDate,
+                 long first, long last,
+                 vector<FoundEclipse>& found,
+                 F&& progress)
+{
+    bool solar = (eclipseTypeMask & Eclipse::Solar) != 0 && canEclipse(body, testBody);
+    bool lunar = (eclipseTypeMask & Eclipse::Lunar) != 0 && canEclipse(testBody, body);
+    if (!solar && !lunar)
     {
-        eclipsed = testEclipse(receiver, occulter, t);
-        step *= 0.5;
-        if (eclipsed)
-            t += step;
-        else
-            t -= step;
+        progress(startDate + (last - 1) * SearchStep, last - first);
+        return;
     }
 
-    // Always return a time when the receiver is /not/ in eclipse
-    if (eclipsed)
-        t += step;
+    double previousEclipseEndTime = -numeric_limits<double>::infinity();
+    for (long step = first; step < last;)
+    {
+        double t = startDate + step * SearchStep;
+        long advance = 1;
+
+        // Only test for an eclipse if we're not in the middle of a previous
+        // one.
+        if (t <= previousEclipseEndTime)
+        {
+            advance = static_cast<long>((previousEclipseEndTime - startDate) / SearchStep) + 1 - step;
+        }
+        else
+        {
+            bool eclipsed = false;
+            if (solar)
+                eclipsed |= addEclipse(body, testBody, t, step, found, previousEclipseEndTime);
+            if (lunar)
+                eclipsed |= addEclipse(testBody, body, t, step, found, previousEclipseEndTime);
+            if (!eclipsed)
+                advance = eclipseFreeSteps(body, testBody, solar, lunar, t);
+        }
 
-    return t;
+        advance = clamp(advance, 1L, last - step);
+        if (!progress(t, advance))
+            return;
+        step += advance;
+    }
 }
-#endif
 
-void addEclipse(const Body& receiver, const Body& occulter,
-                double now,
-                double /*startStep*/, double /*minStep*/,
-                vector<Eclipse>& eclipses,
-                vector<double>& previousEclipseEndTimes, int i)
+
+// Return true if the position of the body can be computed from several
+// threads at once.
+bool isThreadSafe(const Body& body)
 {
-    if (testEclipse(receiver, occulter, now))
+    const Timeline* timeline = body.getTimeline();
+    for (unsigned int i = 0; i < timeline->phaseCount(); i++)
     {
-        Eclipse eclipse;
-#if 1
-        eclipse.startTime = findEclipseSpan(receiver, occulter, now, -dT);
-        eclipse.endTime = findEclipseSpan(receiver, occulter, now, dT);
-#else
-        eclipse.startTime = findEclipseStart(receiver, occulter, now, searchStep, minStep);
-        eclipse.endTime = findEclipseEnd(receiver, occulter, now, searchStep, minStep);
-#endif
-        eclipse.receiver = const_cast<Body*>(&receiver);
-        eclipse.occulter = const_cast<Body*>(&occulter);
-        eclipses.emplace_back(eclipse);
-
-        previousEclipseEndTimes[i] = eclipse.endTime;
+        const auto& phase = timeline->getPhase(i);
+        if (!phase->orbit()->isThreadSafe() || !phase->orbitFrame()->isThreadSafe())
+            return false;
+
+        const Body* center = phase->orbitFrame()->getCenter().body();
+        if (center != nullptr && !isThreadSafe(*center))
+            return false;
     }
+
+    return true;
+}
+
+} // end unnamed namespace
+
+
+EclipseFinder::EclipseFinder(Body* _body,
+                             EclipseFinderWatcher* _watcher) :
+    body(_body),
+    watcher(_watcher)
+{
 }
 
+
 void EclipseFinder::findEclipses(double startDate,
                                  double endDate,
                                  int eclipseTypeMask,
@@ -209,15 +332,13 @@ void EclipseFinder::findEclipses(double startDate,
     PlanetarySystem* satellites = body->getSatellites();
 
     // See if there's anything that could test
-    if (satellites == nullptr)
+    if (satellites == nullptr || endDate < startDate)
         return;
 
-    // For each body, we'll need to store the time when the last eclipse ended
-    vector<double> previousEclipseEndTimes;
-
     // Make a list of satellites that we'll actually test for eclipses; ignore
     // spacecraft and very small objects.
     vector<Body*> testBodies;
+    bool threadSafe = isThreadSafe(*body);
     for (int i = 0; i < satellites->getSystemSize(); i++)
     {
         Body* obj = satellites->getBody(i);
@@ -225,40 +346,119 @@ void EclipseFinder::findEclipses(double startDate,
             obj->getRadius() >= body->getRadius() * MinRelativeOccluderRadius)
         {
             testBodies.push_back(obj);
-            previousEclipseEndTimes.push_back(startDate - 1.0);
+            threadSafe = threadSafe && isThreadSafe(*obj);
         }
     }
 
     if (testBodies.empty())
         return;
 
-    // TODO: Use a fixed step of one hour for now; we should use a binary
-    // search instead.
-    double searchStep = 1.0 / 24.0; // one hour
+    // Each satellite is searched separately over chunks of the time range,
+    // skipping steps where the bodies are too far from alignment for an
+    // eclipse to be in progress.
+    long nSteps = static_cast<long>((endDate - startDate) / SearchStep) + 1;
+    long nChunks = (nSteps + StepsPerChunk - 1) / StepsPerChunk;
+    size_t nBodies = testBodies.size();
+    vector<vector<FoundEclipse>> found(nChunks * nBodies);
 
-    // Precision of eclipse duration calculation
-    double durationPrecision = 1.0 / (24.0 * 360.0); // ten seconds
+    auto search = [&](long chunk, size_t i, auto&& progress)
+    {
+        long first = chunk * StepsPerChunk;
+        long last = min(first + StepsPerChunk, nSteps);
+        searchSteps(*body, *testBodies[i], eclipseTypeMask, startDate,
+                    first, last, found[chunk * nBodies + i], progress);
+    };
 
-    for (double t = startDate; t <= endDate; t += searchStep)
+    if (threadSafe && celestia::util::GetJobSystem() != nullptr)
     {
-        if (watcher != nullptr)
+        // The watcher is only ever called from this thread; the workers
+        // report the steps they've covered and poll for cancellation.
+        atomic<long> stepsDone{ 0 };
+        atomic<size_t> chunksDone{ 0 };
+        atomic<bool> aborted{ false };
+        auto progress = [&](double, long steps)
         {
-            if (watcher->eclipseFinderProgressUpdate(t) == EclipseFinderWatcher::AbortOperation)
-                return;
+            stepsDone.fetch_add(steps, memory_order_relaxed);
+            return !aborted.load(memory_order_relaxed);
+        };
+
+        celestia::util::TaskGroup group(celestia::util::JobPriority::Background);
+        for (long chunk = 0; chunk < nChunks; chunk++)
+        {
+            for (size_t i = 0; i < nBodies; i++)
+            {
+                group.run([&, chunk, i]
+                {
+                    search(chunk, i, progress);
+                    chunksDone.fetch_add(1, memory_order_release);
+                });
+            }
         }
 
-        for (unsigned int i = 0; i < testBodies.size(); i++)
+        if (watcher != nullptr)
         {
-            // Only test for an eclipse if we're not in the middle of
-            // of previous one.
-            if (t <= previousEclipseEndTimes[i])
-                continue;
+            double totalSteps = static_cast<double>(nSteps) * nBodies;
+            while (chunksDone.load(memory_order_acquire) < found.size())
+            {
+                double t = startDate + (endDate - startDate) * stepsDone.load(memory_order_relaxed) / totalSteps;
+                if (watcher->eclipseFinderProgressUpdate(t) == EclipseFinderWatcher::AbortOperation)
+                {
+                    aborted = true;
+                    break;
+                }
+                this_thread::sleep_for(ProgressInterval);
+            }
+        }
 
-            if (eclipseTypeMask & Eclipse::Solar)
-                addEclipse(*body, *testBodies[i], t, searchStep, durationPrecision, eclipses, previousEclipseEndTimes, i);
+        group.wait();
+    }
+    else
+    {
+        bool aborted = false;
+        auto progress = [&](double t, long)
+        {
+            if (watcher != nullptr &&
+                watcher->eclipseFinderProgressUpdate(t) == EclipseFinderWatcher::AbortOperation)
+            {
+                aborted = true;
+            }
+            return !aborted;
+        };
+
+        for (long chunk = 0; chunk < nChunks && !aborted; chunk++)
+        {
+            for (size_t i = 0; i < nBodies && !aborted; i++)
+                search(chunk, i, progress);
+        }
+    }
 
-            if (eclipseTypeMask & Eclipse::Lunar)
-                addEclipse(*testBodies[i], *body, t, searchStep, durationPrecision, eclipses, previousEclipseEndTimes, i);
+    // Stitch the chunks back together. An eclipse in progress at the start
+    // of a chunk was already found in the previous one, so like the serial
+    // search, skip any found during a previous eclipse of the same satellite.
+    vector<FoundEclipse> merged;
+    for (size_t i = 0; i < nBodies; i++)
+    {
+        double previousEclipseEndTime = startDate - 1.0;
+        long previousStep = -1;
+        for (long chunk = 0; chunk < nChunks; chunk++)
+        {
+            for (const FoundEclipse& f : found[chunk * nBodies + i])
+            {
+                if (f.step != previousStep)
+                {
+                    if (startDate + f.step * SearchStep <= previousEclipseEndTime)
+                        continue;
+                    previousStep = f.step;
+                }
+
+                merged.push_back(f);
+                previousEclipseEndTime = f.eclipse.endTime;
+            }
         }
     }
+
+    stable_sort(merged.begin(), merged.end(),
+                [](const FoundEclipse& a, const FoundEclipse& b) { return a.step < b.step; });
+    for (const FoundEclipse& f : merged)
+        eclipses.push_back(f.eclipse);
 }
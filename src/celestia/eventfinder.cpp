@@ -0,0 +1,377 @@
+// eventfinder.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Find conjunctions, occultations and transits as seen by an observer.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <utility>
+
+#include <Eigen/Core>
+
+#include <celengine/univcoord.h>
+#include <celcompat/numbers.h>
+#include "eventfinder.h"
+
+using namespace Eigen;
+using namespace std;
+
+
+namespace
+{
+
+// Default spacing of the samples in days
+constexpr const double DefaultSearchStep = 1.0 / 24.0;
+
+// Precision of event start, end and maximum times: one second
+constexpr const double TimePrecision = 1.0 / 86400.0;
+
+// Number of samples of every object's position computed together
+constexpr const int BatchSize = 256;
+
+// 1 / golden ratio
+constexpr const double InvPhi = 0.6180339887498949;
+
+
+double angularSeparation(const Vector3d& a, const Vector3d& b)
+{
+    return std::atan2(a.cross(b).norm(), a.dot(b));
+}
+
+
+double angularRadius(double radius, double distance)
+{
+    if (radius >= distance)
+        return celestia::numbers::pi / 2.0;
+    return std::asin(radius / distance);
+}
+
+
+// Given times t0 and t1 at which f has opposite signs, find the time when
+// it crosses zero.
+template<typename F> double findRoot(F&& f, double t0, double t1)
+{
+    bool negative0 = f(t0) < 0.0;
+    while (std::abs(t1 - t0) > TimePrecision)
+    {
+        double t = (t0 + t1) * 0.5;
+        if ((f(t) < 0.0) == negative0)
+            t0 = t;
+        else
+            t1 = t;
+    }
+
+    return (t0 + t1) * 0.5;
+}
+
+
+// Golden section search for the minimum of f between t0 and t1; f is
+// assumed to have a single minimum in that range.
+template<typename F> double findMinimum(F&& f, double t0, double t1)
+{
+    double a = t1 - InvPhi * (t1 - t0);
+    double b = t0 + InvPhi * (t1 - t0);
+    double fa = f(a);
+    double fb = f(b);
+    while (t1 - t0 > TimePrecision)
+    {
+        if (fa < fb)
+        {
+            t1 = b;
+            b = a;
+            fb = fa;
+            a = t1 - InvPhi * (t1 - t0);
+            fa = f(a);
+        }
+        else
+        {
+            t0 = a;
+            a = b;
+            fa = fb;
+            b = t0 + InvPhi * (t1 - t0);
+            fb = f(b);
+        }
+    }
+
+    return (t0 + t1) * 0.5;
+}
+
+} // end unnamed namespace
+
+
+/*! Two objects tested for an event, along with the state of the scan
+ *  through the samples.
+ */
+struct CelestialEventFinder::Pair
+{
+    Pair(size_t _a, size_t _b, bool _limbContact, double _maxSeparation, int _eventTypeMask) :
+        a(_a), b(_b),
+        limbContact(_limbContact),
+        maxSeparation(_maxSeparation),
+        eventTypeMask(_eventTypeMask)
+    {
+    }
+
+    // The event is in progress while this is negative
+    double value(const Vector3d& posA, const Vector3d& posB,
+                 double radiusA, double radiusB) const
+    {
+        double separation = angularSeparation(posA, posB);
+        if (!limbContact)
+            return separation - maxSeparation;
+
+        return separation -
+               angularRadius(radiusA, posA.norm()) -
+               angularRadius(radiusB, posB.norm());
+    }
+
+    size_t a;
+    size_t b;
+    bool limbContact;
+    double maxSeparation;
+    int eventTypeMask;
+
+    int nSamples{ 0 };
+    double t0{ 0.0 };
+    double f0{ 0.0 };
+    double t1{ 0.0 };
+    double f1{ 0.0 };
+    bool inEvent{ false };
+    double eventStart{ 0.0 };
+};
+
+
+CelestialEventFinder::CelestialEventFinder(const Selection& _observer,
+                                           EclipseFinderWatcher* _watcher) :
+    observer(_observer),
+    watcher(_watcher),
+    searchStep(DefaultSearchStep)
+{
+}
+
+
+double CelestialEventFinder::getSearchStep() const
+{
+    return searchStep;
+}
+
+
+void CelestialEventFinder::setSearchStep(double step)
+{
+    if (step > TimePrecision)
+        searchStep = step;
+}
+
+
+void CelestialEventFinder::findConjunctions(const vector<Selection>& objects,
+                                            double maxSeparation,
+                                            double startDate,
+                                            double endDate,
+                                            vector<CelestialEvent>& events)
+{
+    vector<Pair> pairs;
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        for (size_t j = i + 1; j < objects.size(); j++)
+        {
+            if (objects[i] != objects[j])
+                pairs.emplace_back(i, j, false, maxSeparation, CelestialEvent::Conjunction);
+        }
+    }
+
+    search(objects, pairs, startDate, endDate, events);
+}
+
+
+void CelestialEventFinder::findOccultations(const vector<Selection>& occulters,
+                                            const vector<Selection>& targets,
+                                            int eventTypeMask,
+                                            double startDate,
+                                            double endDate,
+                                            vector<CelestialEvent>& events)
+{
+    // Objects appearing in both lists are only sampled once, and each pair
+    // is only tested once whichever list the objects came from.
+    vector<Selection> objects;
+    auto indexOf = [&objects](const Selection& sel)
+    {
+        auto iter = find(objects.begin(), objects.end(), sel);
+        if (iter != objects.end())
+            return static_cast<size_t>(iter - objects.begin());
+        objects.push_back(sel);
+        return objects.size() - 1;
+    };
+
+    vector<Pair> pairs;
+    set<pair<size_t, size_t>> tested;
+    eventTypeMask &= CelestialEvent::Occultation | CelestialEvent::Transit;
+    for (const Selection& occulter : occulters)
+    {
+        size_t a = indexOf(occulter);
+        for (const Selection& target : targets)
+        {
+            size_t b = indexOf(target);
+            if (a != b && tested.emplace(min(a, b), max(a, b)).second)
+                pairs.emplace_back(a, b, true, 0.0, eventTypeMask);
+        }
+    }
+
+    search(objects, pairs, startDate, endDate, events);
+}
+
+
+void CelestialEventFinder::search(const vector<Selection>& objects,
+                                  vector<Pair>& pairs,
+                                  double startDate,
+                                  double endDate,
+                                  vector<CelestialEvent>& events)
+{
+    if (pairs.empty() || observer.empty() || endDate < startDate)
+        return;
+
+    size_t firstEvent = events.size();
+    vector<double> radii;
+    for (const Selection& obj : objects)
+        radii.push_back(obj.radius());
+
+    auto position = [this](const Selection& obj, double t)
+    {
+        return obj.getPosition(t).offsetFromKm(observer.getPosition(t));
+    };
+
+    auto addEvent = [&](const Pair& pair, double start, double end)
+    {
+        const Selection& a = objects[pair.a];
+        const Selection& b = objects[pair.b];
+        auto separation = [&](double t)
+        {
+            return angularSeparation(position(a, t), position(b, t));
+        };
+
+        CelestialEvent event;
+        event.startTime = start;
+        event.endTime = end;
+        event.maximumTime = findMinimum(separation, start, end);
+        event.minSeparation = separation(event.maximumTime);
+        event.front = a;
+        event.back = b;
+
+        if (pair.limbContact)
+        {
+            Vector3d posA = position(a, event.maximumTime);
+            Vector3d posB = position(b, event.maximumTime);
+            double radiusA = radii[pair.a];
+            double radiusB = radii[pair.b];
+            if (posB.norm() < posA.norm())
+            {
+                swap(event.front, event.back);
+                swap(posA, posB);
+                swap(radiusA, radiusB);
+            }
+
+            if (angularRadius(radiusA, posA.norm()) >= angularRadius(radiusB, posB.norm()))
+                event.type = CelestialEvent::Occultation;
+            else
+                event.type = CelestialEvent::Transit;
+        }
+
+        if ((pair.eventTypeMask & event.type) != 0)
+            events.push_back(event);
+    };
+
+    long nSamples = static_cast<long>(ceil((endDate - startDate) / searchStep)) + 1;
+    vector<double> times;
+    vector<UniversalCoord> coords(objects.size());
+    vector<Vector3d> positions(BatchSize * objects.size());
+
+    for (long first = 0; first < nSamples; first += BatchSize)
+    {
+        // Sample the positions of all objects at once, so that ephemerides
+        // shared between pairs are only evaluated once per step.
+        times.clear();
+        for (long n = first; n < min(first + BatchSize, nSamples); n++)
+            times.push_back(min(startDate + n * searchStep, endDate));
+
+        for (size_t k = 0; k < times.size(); k++)
+        {
+            for (size_t i = 0; i < objects.size(); i++)
+                coords[i] = objects[i].getPosition(times[k]);
+            UniversalCoord::OffsetsFromKm(coords, observer.getPosition(times[k]),
+                                          &positions[k * objects.size()]);
+        }
+
+        for (Pair& pair : pairs)
+        {
+            auto value = [&](double t)
+            {
+                return pair.value(position(objects[pair.a], t), position(objects[pair.b], t),
+                                  radii[pair.a], radii[pair.b]);
+            };
+
+            for (size_t k = 0; k < times.size(); k++)
+            {
+                double t = times[k];
+                double f = pair.value(positions[k * objects.size() + pair.a],
+                                      positions[k * objects.size() + pair.b],
+                                      radii[pair.a], radii[pair.b]);
+
+                if (pair.nSamples == 0)
+                {
+                    if (f < 0.0)
+                    {
+                        pair.inEvent = true;
+                        pair.eventStart = t;
+                    }
+                }
+                else if (!pair.inEvent && f < 0.0)
+                {
+                    pair.inEvent = true;
+                    pair.eventStart = findRoot(value, pair.t1, t);
+                }
+                else if (pair.inEvent && f >= 0.0)
+                {
+                    pair.inEvent = false;
+                    addEvent(pair, pair.eventStart, findRoot(value, pair.t1, t));
+                }
+                else if (!pair.inEvent && pair.nSamples >= 2 && pair.f1 < pair.f0 && pair.f1 < f)
+                {
+                    // The objects drew closer and then apart again between
+                    // samples; check that the event didn't start and end
+                    // in between.
+                    double tMin = findMinimum(value, pair.t0, t);
+                    if (value(tMin) < 0.0)
+                        addEvent(pair, findRoot(value, pair.t0, tMin), findRoot(value, tMin, t));
+                }
+
+                pair.t0 = pair.t1;
+                pair.f0 = pair.f1;
+                pair.t1 = t;
+                pair.f1 = f;
+                pair.nSamples++;
+            }
+        }
+
+        if (watcher != nullptr &&
+            watcher->eclipseFinderProgressUpdate(times.back()) == EclipseFinderWatcher::AbortOperation)
+        {
+            break;
+        }
+    }
+
+    // Events still in progress are cut off at the end of the search
+    for (const Pair& pair : pairs)
+    {
+        if (pair.inEvent)
+            addEvent(pair, pair.eventStart, pair.t1);
+    }
+
+    sort(events.begin() + firstEvent, events.end(),
+         [](const CelestialEvent& e0, const CelestialEvent& e1) { return e0.startTime < e1.startTime; });
+}
@@ -0,0 +1,90 @@
+// eventfinder.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Find conjunctions, occultations and transits as seen by an observer.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <vector>
+#include <celengine/selection.h>
+#include "eclipsefinder.h"
+
+struct CelestialEvent
+{
+    // values must be 2^n
+    enum Type
+    {
+        Conjunction = 0x01,
+        Occultation = 0x02,
+        Transit     = 0x04,
+    };
+
+    Type type{ Conjunction };
+
+    // For occultations and transits, front is the object nearer to the
+    // observer. For conjunctions it's simply the first of the pair.
+    Selection front;
+    Selection back;
+
+    double startTime{ 0.0 };
+    double endTime{ 0.0 };
+
+    // Time of closest approach, and the angle between the centers of the
+    // two objects at that time in radians.
+    double maximumTime{ 0.0 };
+    double minSeparation{ 0.0 };
+};
+
+/*! Searches a time range for the spans when two objects appear close
+ *  together from the observer's position. Positions are sampled on a
+ *  fixed grid of searchStep days and each change of sign of the event
+ *  condition is bisected, so events much shorter than the step may be
+ *  missed. Progress is reported through the same watcher interface as
+ *  the eclipse finder.
+ */
+class CelestialEventFinder
+{
+ public:
+    CelestialEventFinder(const Selection& observer, EclipseFinderWatcher* = nullptr);
+
+    double getSearchStep() const;
+    void setSearchStep(double step);
+
+    // Find the spans when any two of the objects are less than
+    // maxSeparation radians apart.
+    void findConjunctions(const std::vector<Selection>& objects,
+                          double maxSeparation,
+                          double startDate,
+                          double endDate,
+                          std::vector<CelestialEvent>& events);
+
+    // Find the spans when the disk of any of the occulters overlaps that of
+    // any of the targets; the event is a transit if the nearer object
+    // appears smaller, and an occultation otherwise. eventTypeMask selects
+    // which of the two are reported.
+    void findOccultations(const std::vector<Selection>& occulters,
+                          const std::vector<Selection>& targets,
+                          int eventTypeMask,
+                          double startDate,
+                          double endDate,
+                          std::vector<CelestialEvent>& events);
+
+ private:
+    struct Pair;
+
+    void search(const std::vector<Selection>& objects,
+                std::vector<Pair>& pairs,
+                double startDate,
+                double endDate,
+                std::vector<CelestialEvent>& events);
+
+    Selection observer;
+    EclipseFinderWatcher* watcher;
+    double searchStep;
+};
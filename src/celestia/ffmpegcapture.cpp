@@ -13,19 +13,46 @@ extern "C"
 #include <libswscale/swscale.h>
 }
 
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <fmt/format.h>
 
+#include <celengine/framereader.h>
 #include <celengine/pixelformat.h>
 #include <celengine/render.h>
 
 using namespace std;
 using namespace celestia;
 
+namespace
+{
+// Largest number of captured frames waiting for the encoder thread; the
+// render thread waits when it is reached.
+constexpr std::size_t MaxQueuedFrames = 4;
+}
+
 // a wrapper around a single output AVStream
+//
+// Frames are read back from the GPU through a FrameReader when possible and
+// handed to an encoder thread, which converts them to the pixel format of
+// the codec and encodes them while the next frames are rendered.
 class FFMPEGCapturePrivate
 {
+    // The pixels of a captured frame waiting for the encoder thread
+    struct CapturedFrame
+    {
+        std::vector<std::uint8_t> pixels;
+        int     rowSize;
+        bool    topDown;
+        int64_t pts;
+    };
+
     FFMPEGCapturePrivate() = default;
     ~FFMPEGCapturePrivate();
 
@@ -33,7 +60,13 @@ class FFMPEGCapturePrivate
     bool addStream(int w, int h, float fps);
     bool openVideo();
     bool start();
-    bool writeVideoFrame(bool = false);
+    bool captureVideoFrame();
+    bool retrieveFrames(bool waitAll);
+    std::vector<std::uint8_t> acquireBuffer();
+    bool submitFrame(std::vector<std::uint8_t>&& pixels, int rowSize, bool topDown);
+    void encoderLoop();
+    bool encodeFrame(const CapturedFrame&);
+    bool writeVideoFrame(const AVFrame*);
     void finish();
     void setVideoCodec(int);
 
@@ -43,7 +76,6 @@ class FFMPEGCapturePrivate
 
     AVStream        *st       { nullptr };
     AVFrame         *frame    { nullptr };
-    AVFrame         *tmpfr    { nullptr };
     AVCodecContext  *enc      { nullptr };
     AVFormatContext *oc       { nullptr };
     const AVCodec   *vc       { nullptr };
@@ -66,6 +98,19 @@ class FFMPEGCapturePrivate
     fs::path        filename;
     std::string     vc_options;
 
+    std::unique_ptr<FrameReader> reader;
+    bool            readerChecked { false };
+
+    // Frames waiting for the encoder thread, and pixel buffers of encoded
+    // frames which can be reused
+    std::deque<CapturedFrame>              queue;
+    std::vector<std::vector<std::uint8_t>> freeBuffers;
+    std::mutex                             queueMutex;
+    std::condition_variable                queueChanged;
+    std::thread                            encoder;
+    bool            stopEncoder   { false };
+    bool            encoderFailed { false };
+
  public:
 #if (LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 10, 100)) // ffmpeg < 4.0
     static bool     registered;
@@ -365,36 +410,15 @@ bool FFMPEGCapturePrivate::openVideo()
         return false;
     }
 
-    if (enc->pix_fmt != format)
+    // the captured pictures are converted to the codec pixel format, or
+    // just copied if it's the same
+    swsc = sws_getContext(enc->width, enc->height, format,
+                          enc->width, enc->height, enc->pix_fmt,
+                          SWS_BITEXACT, nullptr, nullptr, nullptr);
+    if (swsc == nullptr)
     {
-        // as we only grab a RGB24 picture, we must convert it
-        // to the codec pixel format if needed
-        swsc = sws_getContext(enc->width, enc->height, format,
-                              enc->width, enc->height, enc->pix_fmt,
-                              SWS_BITEXACT, nullptr, nullptr, nullptr);
-        if (swsc == nullptr)
-        {
-            cout << "Failed to allocate SWS context\n";
-            return false;
-        }
-
-        // allocate and init a temporary frame
-        if((tmpfr = av_frame_alloc()) == nullptr)
-        {
-            cout << "Failed to allocate temp frame\n";
-            return false;
-        }
-
-        tmpfr->format = format;
-        tmpfr->width  = enc->width;
-        tmpfr->height = enc->height;
-
-        // allocate the buffers for the frame data
-        if (av_frame_get_buffer(tmpfr, 32) < 0)
-        {
-            cout << "Failed to allocate temp frame buffer\n";
-            return false;
-        }
+        cout << "Failed to allocate SWS context\n";
+        return false;
     }
 
     // copy the stream parameters to the muxer
@@ -407,52 +431,145 @@ bool FFMPEGCapturePrivate::openVideo()
     return true;
 }
 
-static void captureImage(AVFrame *pict, int width, int height, const Renderer *r)
+bool FFMPEGCapturePrivate::captureVideoFrame()
 {
     int x, y, w, h;
-    r->getViewport(&x, &y, &w, &h);
+    renderer->getViewport(&x, &y, &w, &h);
+    x += (w - enc->width) / 2;
+    y += (h - enc->height) / 2;
+
+    PixelFormat captureFormat = renderer->getPreferredCaptureFormat();
+    if (!readerChecked)
+    {
+        // the reader is created here because the GL context is current
+        readerChecked = true;
+        if (FrameReader::isSupported())
+            reader = std::make_unique<FrameReader>(enc->width, enc->height, captureFormat);
+    }
+
+    if (reader != nullptr)
+        return retrieveFrames(false) && reader->read(x, y);
+
+    // without pixel buffer objects the frame is read synchronously, but it
+    // is still converted and encoded by the encoder thread
+    const int rowSize = (enc->width * (hasAlpha ? 4 : 3) + 3) & ~3;
+    std::vector<std::uint8_t> buffer = acquireBuffer();
+    buffer.resize(static_cast<std::size_t>(rowSize) * enc->height);
+    if (!renderer->captureFrame(x, y, enc->width, enc->height, captureFormat, buffer.data()))
+        return false;
 
-    x += (w - width) / 2;
-    y += (h - height) / 2;
-    r->captureFrame(x, y, width, height,
-                    r->getPreferredCaptureFormat(),
-                    pict->data[0]);
+    // Renderer::captureFrame() returns the rows top to bottom
+    return submitFrame(std::move(buffer), rowSize, true);
 }
 
-// encode one video frame and send it to the muxer
-// return 1 when encoding is finished, 0 otherwise
-bool FFMPEGCapturePrivate::writeVideoFrame(bool finalize)
+// pass the frames read back so far to the encoder thread; unless waitAll
+// is set, only wait for the oldest frame when every pixel buffer of the
+// reader is in use
+bool FFMPEGCapturePrivate::retrieveFrames(bool waitAll)
 {
-    AVFrame *frame = finalize ? nullptr : this->frame;
-    const int bytesPerPixel = hasAlpha ? 4 : 3;
+    bool ok = true;
+    auto consumer = [this, &ok](const std::uint8_t *pixels)
+    {
+        std::size_t size = static_cast<std::size_t>(reader->getRowSize()) * enc->height;
+        std::vector<std::uint8_t> buffer = acquireBuffer();
+        buffer.assign(pixels, pixels + size);
+        ok = submitFrame(std::move(buffer), reader->getRowSize(), reader->isTopDown());
+    };
+
+    bool wait = waitAll || reader->full();
+    while (ok && reader->retrieve(wait, consumer))
+        wait = waitAll;
+
+    return ok;
+}
 
-    // check if we want to generate more frames
-    if (!finalize)
+// return a buffer for the pixels of a new frame, waiting for the encoder
+// thread when MaxQueuedFrames frames are waiting already
+std::vector<std::uint8_t> FFMPEGCapturePrivate::acquireBuffer()
+{
+    std::unique_lock<std::mutex> lock(queueMutex);
+    queueChanged.wait(lock, [this] { return queue.size() < MaxQueuedFrames || encoderFailed; });
+    if (freeBuffers.empty())
+        return {};
+
+    std::vector<std::uint8_t> buffer = std::move(freeBuffers.back());
+    freeBuffers.pop_back();
+    return buffer;
+}
+
+bool FFMPEGCapturePrivate::submitFrame(std::vector<std::uint8_t>&& pixels, int rowSize, bool topDown)
+{
     {
-        // when we pass a frame to the encoder, it may keep a reference to it
-        // internally; make sure we do not overwrite it here
-        if (av_frame_make_writable(frame) < 0)
-        {
-            cout << "Failed to make the frame writable\n";
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (encoderFailed)
             return false;
-        }
+        queue.push_back({ std::move(pixels), rowSize, topDown, nextPts++ });
+    }
+    queueChanged.notify_all();
+    return true;
+}
 
-        if (enc->pix_fmt != format)
+// body of the encoder thread: encode the queued frames until the capture
+// ends and the queue is empty
+void FFMPEGCapturePrivate::encoderLoop()
+{
+    for (;;)
+    {
+        CapturedFrame captured;
         {
-            captureImage(tmpfr, enc->width, enc->height, renderer);
-            // we need to compute the correct line width of our source data
-            const int linesize = bytesPerPixel * enc->width;
-            sws_scale(swsc, tmpfr->data, &linesize, 0, enc->height,
-                      frame->data, frame->linesize);
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueChanged.wait(lock, [this] { return !queue.empty() || stopEncoder; });
+            if (queue.empty())
+                return;
+            captured = std::move(queue.front());
+            queue.pop_front();
         }
-        else
+
+        bool ok = encodeFrame(captured);
+
         {
-            captureImage(frame, enc->width, enc->height, renderer);
+            std::lock_guard<std::mutex> lock(queueMutex);
+            freeBuffers.push_back(std::move(captured.pixels));
+            if (!ok)
+                encoderFailed = true;
         }
+        queueChanged.notify_all();
+
+        if (!ok)
+            return;
+    }
+}
+
+// convert a captured frame to the codec pixel format and encode it
+bool FFMPEGCapturePrivate::encodeFrame(const CapturedFrame &captured)
+{
+    // when we pass a frame to the encoder, it may keep a reference to it
+    // internally; make sure we do not overwrite it here
+    if (av_frame_make_writable(frame) < 0)
+    {
+        cout << "Failed to make the frame writable\n";
+        return false;
+    }
 
-        frame->pts = nextPts++;
+    // rows read back without MESA_pack_invert are bottom to top; a
+    // negative stride makes swscale flip them
+    const std::uint8_t *src = captured.pixels.data();
+    int stride = captured.rowSize;
+    if (!captured.topDown)
+    {
+        src += static_cast<std::size_t>(captured.rowSize) * (enc->height - 1);
+        stride = -stride;
     }
+    sws_scale(swsc, &src, &stride, 0, enc->height, frame->data, frame->linesize);
+
+    frame->pts = captured.pts;
+    return writeVideoFrame(frame);
+}
 
+// send one video frame to the encoder and the encoded packets to the
+// muxer; a null frame flushes the encoder
+bool FFMPEGCapturePrivate::writeVideoFrame(const AVFrame *frame)
+{
 #if (LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 133, 100))
     av_init_packet(pkt);
 #endif
@@ -489,7 +606,23 @@ bool FFMPEGCapturePrivate::writeVideoFrame(bool finalize)
 
 void FFMPEGCapturePrivate::finish()
 {
-    writeVideoFrame(true);
+    // hand the frames still being read back to the encoder thread and wait
+    // until it has encoded all of them
+    if (reader != nullptr)
+    {
+        retrieveFrames(true);
+        reader = nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopEncoder = true;
+    }
+    queueChanged.notify_all();
+    if (encoder.joinable())
+        encoder.join();
+
+    writeVideoFrame(nullptr);
 
     // Write the trailer, if any. The trailer must be written before you
     // close the CodecContexts open when you wrote the header; otherwise
@@ -503,10 +636,19 @@ void FFMPEGCapturePrivate::finish()
 
 FFMPEGCapturePrivate::~FFMPEGCapturePrivate()
 {
+    if (encoder.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopEncoder = true;
+        }
+        queueChanged.notify_all();
+        encoder.join();
+    }
+
     avcodec_free_context(&enc);
     av_frame_free(&frame);
-    if (tmpfr != nullptr)
-        av_frame_free(&tmpfr);
+    sws_freeContext(swsc);
     avformat_free_context(oc);
     av_packet_free(&pkt);
 }
@@ -555,6 +697,7 @@ bool FFMPEGCapture::start(const fs::path& filename, int width, int height, float
         return false;
     }
 
+    d->encoder = std::thread(&FFMPEGCapturePrivate::encoderLoop, d);
     d->capturing = true; // XXX
 
     return true;
@@ -574,7 +717,7 @@ bool FFMPEGCapture::end()
 
 bool FFMPEGCapture::captureFrame()
 {
-    return d->capturing && d->writeVideoFrame();
+    return d->capturing && d->captureVideoFrame();
 }
 
 void FFMPEGCapture::setVideoCodec(AVCodecID vc_id)
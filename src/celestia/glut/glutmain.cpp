@@ -13,6 +13,8 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <chrono>
+#include <thread>
 #include <cstdlib>
 #include <cctype>
 #include <cstring>
@@ -80,6 +82,7 @@ static void Display()
 {
     if (ready)
     {
+        appCore->setViewChanged();
         appCore->draw();
         glutSwapBuffers();
     }
@@ -92,7 +95,10 @@ static void Idle()
 
     appCore->tick();
 
-    Display();
+    if (appCore->viewUpdateRequired())
+        Display();
+    else
+        std::this_thread::sleep_for(std::chrono::duration<double>(appCore->getFrameDelay()));
 }
 
 static void MouseDrag(int x, int y)
@@ -530,6 +536,11 @@ int main(int argc, char* argv[])
 
     appCore->getRenderer()->setSolarSystemMaxDistance(appCore->getConfig()->SolarSystemMaxDistance);
     appCore->getRenderer()->setShadowMapSize(appCore->getConfig()->ShadowMapSize);
+    appCore->getRenderer()->setGPUStarField(appCore->getConfig()->gpuStarField);
+    appCore->getRenderer()->setGPUOrbits(appCore->getConfig()->gpuOrbits);
+    appCore->getRenderer()->setModelInstancing(appCore->getConfig()->modelInstancing);
+    appCore->getRenderer()->setDSOImpostors(appCore->getConfig()->dsoImpostors);
+    appCore->getRenderer()->setLabelDeclutter(appCore->getConfig()->labelDeclutter);
 
     // Set the simulation starting time to the current system time
     appCore->start();
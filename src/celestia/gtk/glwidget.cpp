@@ -27,6 +27,7 @@
 
 /* Declarations: Callbacks */
 static gint glarea_idle(AppData* app);
+static gint glarea_idle_timeout(AppData* app);
 static gint glarea_configure(GtkWidget* widget, GdkEventConfigure*, AppData* app);
 #if GTK_MAJOR_VERSION == 2
 static gint glarea_expose(GtkWidget* widget, GdkEventExpose* event, AppData* app);
@@ -80,7 +81,23 @@ void initGLCallbacks(AppData* app)
 static gint glarea_idle(AppData* app)
 {
     app->core->tick();
-    return glDrawFrame(app);
+    if (app->core->viewUpdateRequired())
+        return glDrawFrame(app);
+
+    /* Nothing changed: leave the idle loop until the next idle tick */
+    double delay = app->core->getFrameDelay();
+    if (delay <= 0.0)
+        return TRUE;
+    g_timeout_add((guint) (delay * 1000.0), (GSourceFunc)glarea_idle_timeout, app);
+    return FALSE;
+}
+
+
+/* CALLBACK: Return to the idle loop after waiting for an idle tick */
+static gint glarea_idle_timeout(AppData* app)
+{
+    g_idle_add((GSourceFunc)glarea_idle, app);
+    return FALSE;
 }
 
 
@@ -120,12 +137,14 @@ static gint glarea_expose(GtkWidget*, GdkEventExpose* event, AppData* app)
         return TRUE;
 
     /* Redraw -- draw checks are made in function */
+    app->core->setViewChanged();
     return glDrawFrame(app);
 }
 #else
 /* CALLBACK: GL Function for event "draw" */
 static gint glarea_draw(GtkWidget*, cairo_t*, AppData* app)
 {
+    app->core->setViewChanged();
     return glDrawFrame(app);
 }
 #endif
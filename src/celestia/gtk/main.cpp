@@ -79,6 +79,7 @@ static gchar* installDir = NULL;
 static gchar** extrasDir = NULL;
 static gboolean fullScreen = FALSE;
 static gboolean noSplash = FALSE;
+static gboolean startupReport = FALSE;
 
 /* Command-Line Options specification */
 static GOptionEntry optionEntries[] =
@@ -88,6 +89,7 @@ static GOptionEntry optionEntries[] =
     { "extrasdir", 'e', 0, G_OPTION_ARG_FILENAME_ARRAY, &extrasDir, "Additional \"extras\" directory", "directory" },
     { "fullscreen", 'f', 0, G_OPTION_ARG_NONE, &fullScreen, "Start full-screen", NULL },
     { "nosplash", 's', 0, G_OPTION_ARG_NONE, &noSplash, "Disable splash screen", NULL },
+    { "startup-report", '\0', 0, G_OPTION_ARG_NONE, &startupReport, "Log the time and memory of each startup stage", NULL },
     { NULL, '\0', 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
 };
 
@@ -403,6 +405,7 @@ int main(int argc, char* argv[])
     }
 
     /* Initialize the simulation */
+    app->core->setStartupReport(startupReport);
     if (!app->core->initSimulation(altConfig, configDirs, ss->notifier))
         return 1;
 
@@ -411,6 +414,11 @@ int main(int argc, char* argv[])
 
     app->renderer->setSolarSystemMaxDistance(app->core->getConfig()->SolarSystemMaxDistance);
     app->renderer->setShadowMapSize(app->core->getConfig()->ShadowMapSize);
+    app->renderer->setGPUStarField(app->core->getConfig()->gpuStarField);
+    app->renderer->setGPUOrbits(app->core->getConfig()->gpuOrbits);
+    app->renderer->setModelInstancing(app->core->getConfig()->modelInstancing);
+    app->renderer->setDSOImpostors(app->core->getConfig()->dsoImpostors);
+    app->renderer->setLabelDeclutter(app->core->getConfig()->labelDeclutter);
 
     #ifdef GNOME
     /* Create the main window (GNOME) */
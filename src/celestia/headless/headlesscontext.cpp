@@ -0,0 +1,214 @@
+// headlesscontext.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// OpenGL contexts without a window system.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "headlesscontext.h"
+
+#include <map>
+#include <mutex>
+#include <vector>
+#include <celutil/logger.h>
+
+using celestia::util::GetLogger;
+
+namespace celestia
+{
+
+namespace
+{
+
+// Displays are shared by the contexts created on them, and only terminated
+// when the last of those is destroyed.
+std::mutex displayMutex;
+std::map<EGLDisplay, int> displayUsers;
+
+bool hasClientExtension(const char* name)
+{
+    return epoxy_has_egl_extension(EGL_NO_DISPLAY, name);
+}
+
+std::vector<EGLDeviceEXT> queryDevices()
+{
+    if (!hasClientExtension("EGL_EXT_device_enumeration"))
+        return {};
+
+    EGLint count = 0;
+    if (!eglQueryDevicesEXT(0, nullptr, &count) || count <= 0)
+        return {};
+
+    std::vector<EGLDeviceEXT> devices(count);
+    if (!eglQueryDevicesEXT(count, devices.data(), &count))
+        return {};
+    devices.resize(count);
+    return devices;
+}
+
+EGLDisplay getDisplay(int device)
+{
+    bool hasPlatforms = hasClientExtension("EGL_EXT_platform_base");
+    if (device >= 0)
+    {
+        if (!hasPlatforms || !hasClientExtension("EGL_EXT_platform_device"))
+        {
+            GetLogger()->error("EGL devices can't be selected.\n");
+            return EGL_NO_DISPLAY;
+        }
+
+        auto devices = queryDevices();
+        if (device >= static_cast<int>(devices.size()))
+        {
+            GetLogger()->error("EGL device {} not found.\n", device);
+            return EGL_NO_DISPLAY;
+        }
+        return eglGetPlatformDisplayEXT(EGL_PLATFORM_DEVICE_EXT, devices[device], nullptr);
+    }
+
+    // Without a device, prefer the display of Mesa which needs no window
+    // system at all
+    if (hasPlatforms && hasClientExtension("EGL_MESA_platform_surfaceless"))
+        return eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+bool initializeDisplay(EGLDisplay display)
+{
+    std::lock_guard<std::mutex> lock(displayMutex);
+    int& users = displayUsers[display];
+    if (users == 0 && !eglInitialize(display, nullptr, nullptr))
+    {
+        displayUsers.erase(display);
+        return false;
+    }
+
+    users++;
+    return true;
+}
+
+void terminateDisplay(EGLDisplay display)
+{
+    std::lock_guard<std::mutex> lock(displayMutex);
+    auto iter = displayUsers.find(display);
+    if (iter != displayUsers.end() && --iter->second == 0)
+    {
+        eglTerminate(display);
+        displayUsers.erase(iter);
+    }
+}
+
+EGLConfig chooseConfig(EGLDisplay display)
+{
+    const EGLint attribs[] =
+    {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+#ifdef GL_ES
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+#else
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+#endif
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+
+    EGLConfig config = nullptr;
+    EGLint count = 0;
+    if (!eglChooseConfig(display, attribs, &config, 1, &count) || count == 0)
+        return nullptr;
+    return config;
+}
+
+} // end unnamed namespace
+
+HeadlessContext::~HeadlessContext()
+{
+    if (display == EGL_NO_DISPLAY)
+        return;
+
+    if (eglGetCurrentContext() == context)
+        release();
+    if (context != EGL_NO_CONTEXT)
+        eglDestroyContext(display, context);
+    if (surface != EGL_NO_SURFACE)
+        eglDestroySurface(display, surface);
+    terminateDisplay(display);
+}
+
+std::unique_ptr<HeadlessContext>
+HeadlessContext::create(int device, const HeadlessContext* share)
+{
+    std::unique_ptr<HeadlessContext> result(new HeadlessContext());
+
+    EGLDisplay display = share == nullptr ? getDisplay(device) : share->display;
+    if (display == EGL_NO_DISPLAY || !initializeDisplay(display))
+    {
+        GetLogger()->error("Could not initialize the EGL display.\n");
+        return nullptr;
+    }
+    result->display = display;
+
+#ifdef GL_ES
+    bool bound = eglBindAPI(EGL_OPENGL_ES_API);
+    const EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+#else
+    bool bound = eglBindAPI(EGL_OPENGL_API);
+    const EGLint contextAttribs[] = { EGL_NONE };
+#endif
+    EGLConfig config = bound ? chooseConfig(display) : nullptr;
+    if (config == nullptr)
+    {
+        GetLogger()->error("No suitable EGL configuration.\n");
+        return nullptr;
+    }
+
+    EGLContext shareContext = share == nullptr ? EGL_NO_CONTEXT : share->context;
+    result->context = eglCreateContext(display, config, shareContext, contextAttribs);
+    if (result->context == EGL_NO_CONTEXT)
+    {
+        GetLogger()->error("Could not create an EGL context.\n");
+        return nullptr;
+    }
+
+    // The default framebuffer isn't used, so a surface is only created
+    // when a context can't be made current without one
+    if (!epoxy_has_egl_extension(display, "EGL_KHR_surfaceless_context"))
+    {
+        const EGLint surfaceAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        result->surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+        if (result->surface == EGL_NO_SURFACE)
+        {
+            GetLogger()->error("Could not create an EGL pbuffer surface.\n");
+            return nullptr;
+        }
+    }
+
+    return result;
+}
+
+int
+HeadlessContext::deviceCount()
+{
+    return static_cast<int>(queryDevices().size());
+}
+
+bool
+HeadlessContext::makeCurrent() const
+{
+    return eglMakeCurrent(display, surface, surface, context);
+}
+
+void
+HeadlessContext::release() const
+{
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+} // end namespace celestia
@@ -0,0 +1,49 @@
+// headlesscontext.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// OpenGL contexts without a window system.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <memory>
+#include <epoxy/egl.h>
+
+namespace celestia
+{
+
+// HeadlessContext is an EGL context which is current without a window,
+// either surfaceless or with a small pbuffer surface. Rendering is meant
+// to go to a framebuffer object.
+class HeadlessContext
+{
+ public:
+    ~HeadlessContext();
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    // Create a context on the EGL device with the given index, or on the
+    // default display if device is negative. A context created with share
+    // uses the same display and shares its textures and buffers.
+    static std::unique_ptr<HeadlessContext> create(int device, const HeadlessContext* share = nullptr);
+
+    // Number of EGL devices, or zero if they can't be enumerated
+    static int deviceCount();
+
+    bool makeCurrent() const;
+    void release() const;
+
+ private:
+    HeadlessContext() = default;
+
+    EGLDisplay display{ EGL_NO_DISPLAY };
+    EGLSurface surface{ EGL_NO_SURFACE };
+    EGLContext context{ EGL_NO_CONTEXT };
+};
+
+} // end namespace celestia
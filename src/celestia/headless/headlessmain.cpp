@@ -0,0 +1,531 @@
+// headlessmain.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Command line front end rendering images without a window system.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cerrno>
+#include <clocale>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fmt/format.h>
+#include <celcompat/filesystem.h>
+#include <celutil/gettext.h>
+#include "headlesscontext.h"
+#include "headlessrenderer.h"
+#include "hipsgenerator.h"
+
+namespace celestia
+{
+
+namespace
+{
+
+constexpr std::string_view usage =
+    "Usage: celestia-headless [OPTION]...\n"
+    "Render images of Celestia without a window system.\n"
+    "\n"
+    "  --dir DIR          data directory\n"
+    "  --conf FILE        configuration file\n"
+    "  --extrasdir DIR    additional directory of add-ons\n"
+    "  --device N         index of the EGL device to render with\n"
+    "  --list-devices     print the number of EGL devices and exit\n"
+    "  --batch            read one request per line from standard input\n"
+    "  --workers N        render a batch with N processes sharing the catalogs\n"
+    "  --startup-report   log the time and memory of each startup stage\n"
+    "  --hips DIR         render the sky as the tiles of a HiPS survey in DIR\n"
+    "  --hips-order N     HEALPix order of the HiPS tiles, 3 by default\n"
+    "  --hips-tile N      width of the HiPS tiles, 512 by default\n"
+    "  --hips-format FMT  png or jpeg, png by default\n"
+    "\n"
+    "Request options, on the command line or on the lines of a batch:\n"
+    "  --url URL          cel:// URL setting the observer and the time\n"
+    "  --time JD          time as a TDB Julian date\n"
+    "  --fov DEGREES      vertical field of view\n"
+    "  --size WxH         size of the image, 640x480 by default\n"
+    "  --output FILE      PNG or JPEG file to write\n";
+
+struct Request
+{
+    RenderRequest render;
+    fs::path output;
+};
+
+// Parse the request options of args, returning false on errors
+bool
+parseRequest(const std::vector<std::string>& args, Request& request, bool needOutput = true)
+{
+    for (std::size_t i = 0; i < args.size(); i++)
+    {
+        const std::string& option = args[i];
+        if (i + 1 == args.size())
+        {
+            std::cerr << fmt::format("Missing value for {}\n", option);
+            return false;
+        }
+
+        const std::string& value = args[++i];
+        if (option == "--url")
+        {
+            request.render.url = value;
+        }
+        else if (option == "--time")
+        {
+            request.render.tdb = std::strtod(value.c_str(), nullptr);
+        }
+        else if (option == "--fov")
+        {
+            request.render.fov = std::strtof(value.c_str(), nullptr);
+        }
+        else if (option == "--size")
+        {
+            if (std::sscanf(value.c_str(), "%dx%d", &request.render.width, &request.render.height) != 2)
+            {
+                std::cerr << fmt::format("Invalid size {}\n", value);
+                return false;
+            }
+        }
+        else if (option == "--output")
+        {
+            request.output = value;
+        }
+        else
+        {
+            std::cerr << fmt::format("Unknown option {}\n", option);
+            return false;
+        }
+    }
+
+    if (needOutput && request.output.empty())
+    {
+        std::cerr << "No output file\n";
+        return false;
+    }
+    return true;
+}
+
+// Parse a line of a batch, using the request options of the command line
+// as defaults. Returns false for lines without any options.
+bool
+parseBatchLine(const std::string& line, const std::vector<std::string>& requestArgs, Request& request, bool& ok)
+{
+    std::vector<std::string> args = requestArgs;
+    std::istringstream in(line);
+    for (std::string word; in >> word;)
+        args.push_back(word);
+    if (args.empty())
+        return false;
+
+    ok = parseRequest(args, request);
+    return true;
+}
+
+// Read a line from fd, keeping what follows it in buffer. Returns false at
+// the end of the file.
+bool
+readLine(int fd, std::string& buffer, std::string& line)
+{
+    for (;;)
+    {
+        if (auto end = buffer.find('\n'); end != std::string::npos)
+        {
+            line = buffer.substr(0, end);
+            buffer.erase(0, end + 1);
+            return true;
+        }
+
+        char chunk[512];
+        ssize_t count = read(fd, chunk, sizeof(chunk));
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        buffer.append(chunk, static_cast<std::size_t>(count));
+    }
+}
+
+bool
+writeLine(int fd, std::string line)
+{
+    line += '\n';
+    for (std::size_t written = 0; written < line.size();)
+    {
+        ssize_t count = write(fd, line.data() + written, line.size() - written);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        written += static_cast<std::size_t>(count);
+    }
+    return true;
+}
+
+// A forked process rendering the requests sent to it one line at a time
+// and answering each with a status line
+struct Worker
+{
+    pid_t pid{ -1 };
+    int requests{ -1 };
+    int results{ -1 };
+    std::string buffer;
+    // Output of the request being rendered, empty when idle
+    std::string busyWith;
+};
+
+[[noreturn]] void
+runWorker(HeadlessRenderer& renderer, int device, const std::vector<std::string>& requestArgs,
+          int requests, int results)
+{
+    if (!renderer.initGL(device))
+    {
+        std::cerr << "Could not initialize the renderer of a worker!\n";
+        std::exit(2);
+    }
+
+    std::string buffer;
+    std::string line;
+    while (readLine(requests, buffer, line))
+    {
+        Request request;
+        bool ok = false;
+        parseBatchLine(line, requestArgs, request, ok);
+        ok = ok && renderer.render(request.render, request.output);
+        if (!writeLine(results, (ok ? "ok " : "failed ") + request.output.string()))
+            break;
+    }
+    std::exit(0);
+}
+
+// Render a batch with nWorkers processes forked after the catalogs are
+// loaded, so that they share the catalog pages with copy on write instead
+// of each loading its own copy. Each worker creates its own EGL context.
+// Requests go to the first idle worker, so the status lines are written
+// in the order the requests complete.
+int
+runWorkers(HeadlessRenderer& renderer, int device, const std::vector<std::string>& requestArgs, int nWorkers)
+{
+    // A worker that dies must not take the dispatcher with it
+    std::signal(SIGPIPE, SIG_IGN);
+    std::cout.flush();
+    std::cerr.flush();
+
+    std::vector<Worker> workers;
+    for (int i = 0; i < nWorkers; i++)
+    {
+        int requestPipe[2];
+        int resultPipe[2];
+        if (pipe(requestPipe) != 0)
+            break;
+        if (pipe(resultPipe) != 0)
+        {
+            close(requestPipe[0]);
+            close(requestPipe[1]);
+            break;
+        }
+
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            // Only keep the ends of this worker's own pipes
+            for (const Worker& worker : workers)
+            {
+                close(worker.requests);
+                close(worker.results);
+            }
+            close(requestPipe[1]);
+            close(resultPipe[0]);
+            runWorker(renderer, device, requestArgs, requestPipe[0], resultPipe[1]);
+        }
+
+        close(requestPipe[0]);
+        close(resultPipe[1]);
+        if (pid < 0)
+        {
+            close(requestPipe[1]);
+            close(resultPipe[0]);
+            break;
+        }
+        workers.push_back({ pid, requestPipe[1], resultPipe[0], {}, {} });
+    }
+
+    if (workers.empty())
+    {
+        std::cerr << "Could not start any worker!\n";
+        return 2;
+    }
+
+    auto finish = [](Worker& worker)
+    {
+        close(worker.requests);
+        close(worker.results);
+        worker.requests = -1;
+        worker.results = -1;
+    };
+
+    bool atEnd = false;
+    for (;;)
+    {
+        // Hand out requests while workers are idle
+        for (Worker& worker : workers)
+        {
+            while (!atEnd && worker.requests >= 0 && worker.busyWith.empty())
+            {
+                std::string line;
+                if (!std::getline(std::cin, line))
+                {
+                    atEnd = true;
+                    break;
+                }
+
+                Request request;
+                bool ok;
+                if (!parseBatchLine(line, requestArgs, request, ok))
+                    continue;
+                if (!ok)
+                    std::cout << "failed " << request.output.string() << std::endl;
+                else if (writeLine(worker.requests, line))
+                    worker.busyWith = request.output.string();
+                else
+                {
+                    std::cout << "failed " << request.output.string() << std::endl;
+                    finish(worker);
+                }
+            }
+        }
+
+        std::vector<pollfd> fds;
+        std::vector<Worker*> polled;
+        for (Worker& worker : workers)
+        {
+            if (worker.busyWith.empty())
+                continue;
+            fds.push_back({ worker.results, POLLIN, 0 });
+            polled.push_back(&worker);
+        }
+
+        // Done when the input is exhausted, or when no worker is left to
+        // take the remaining requests
+        bool anyAlive = std::any_of(workers.begin(), workers.end(),
+                                    [](const Worker& worker) { return worker.requests >= 0; });
+        if (fds.empty() && (atEnd || !anyAlive))
+            break;
+
+        if (poll(fds.data(), fds.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (std::size_t i = 0; i < fds.size(); i++)
+        {
+            if (fds[i].revents == 0)
+                continue;
+
+            Worker& worker = *polled[i];
+            std::string status;
+            if (readLine(worker.results, worker.buffer, status))
+            {
+                std::cout << status << std::endl;
+            }
+            else
+            {
+                std::cout << "failed " << worker.busyWith << std::endl;
+                finish(worker);
+            }
+            worker.busyWith.clear();
+        }
+    }
+
+    int result = 0;
+    for (Worker& worker : workers)
+    {
+        if (worker.requests >= 0)
+            finish(worker);
+        int status;
+        if (waitpid(worker.pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            result = 3;
+    }
+    return result;
+}
+
+int
+headlessmain(int argc, char** argv)
+{
+    setlocale(LC_ALL, "");
+    setlocale(LC_NUMERIC, "C");
+    bindtextdomain(PACKAGE, LOCALEDIR);
+    bind_textdomain_codeset(PACKAGE, "UTF-8");
+    textdomain(PACKAGE);
+
+    const char* dataDir = getenv("CELESTIA_DATA_DIR");
+    if (dataDir == nullptr)
+        dataDir = CONFIG_DATA_DIR;
+
+    fs::path configFile;
+    std::vector<fs::path> extrasDirs;
+    int device = -1;
+    bool batch = false;
+    int nWorkers = 0;
+    bool startupReport = false;
+    fs::path hipsDir;
+    HipsOptions hipsOptions;
+    std::vector<std::string> requestArgs;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        if (arg == "--help")
+        {
+            std::cout << usage;
+            return 0;
+        }
+        if (arg == "--list-devices")
+        {
+            std::cout << HeadlessContext::deviceCount() << '\n';
+            return 0;
+        }
+        if (arg == "--batch")
+        {
+            batch = true;
+            continue;
+        }
+        if (arg == "--startup-report")
+        {
+            startupReport = true;
+            continue;
+        }
+
+        if (i + 1 == argc)
+        {
+            std::cerr << fmt::format("Missing value for {}\n", arg) << usage;
+            return 1;
+        }
+        if (arg == "--dir")
+            dataDir = argv[++i];
+        else if (arg == "--conf")
+            configFile = argv[++i];
+        else if (arg == "--extrasdir")
+            extrasDirs.emplace_back(argv[++i]);
+        else if (arg == "--device")
+            device = std::atoi(argv[++i]);
+        else if (arg == "--workers")
+            nWorkers = std::atoi(argv[++i]);
+        else if (arg == "--hips")
+            hipsDir = argv[++i];
+        else if (arg == "--hips-order")
+            hipsOptions.order = std::atoi(argv[++i]);
+        else if (arg == "--hips-tile")
+            hipsOptions.tileWidth = std::atoi(argv[++i]);
+        else if (arg == "--hips-format")
+        {
+            std::string_view format = argv[++i];
+            if (format != "png" && format != "jpeg")
+            {
+                std::cerr << fmt::format("Invalid HiPS format {}\n", format) << usage;
+                return 1;
+            }
+            hipsOptions.format = format == "png" ? Content_PNG : Content_JPEG;
+        }
+        else
+        {
+            requestArgs.emplace_back(arg);
+            requestArgs.emplace_back(argv[++i]);
+        }
+    }
+
+    Request request;
+    if (!batch && !parseRequest(requestArgs, request, hipsDir.empty()))
+    {
+        std::cerr << usage;
+        return 1;
+    }
+    if (nWorkers != 0 && (!batch || !hipsDir.empty() || nWorkers < 0))
+    {
+        std::cerr << "--workers needs --batch and a positive count\n" << usage;
+        return 1;
+    }
+
+    std::error_code ec;
+    // The HiPS directory is relative to the current directory, not to the
+    // data directory
+    if (!hipsDir.empty() && hipsDir.is_relative())
+        hipsDir = fs::current_path(ec) / hipsDir;
+    fs::current_path(dataDir, ec);
+    if (ec)
+    {
+        std::cerr << fmt::format("Cannot chdir to {}, probably due to improper installation\n", dataDir);
+        return 1;
+    }
+
+    if (nWorkers > 0)
+    {
+        // The workers are forked before anything touches EGL
+        auto renderer = HeadlessRenderer::load(configFile, extrasDirs, startupReport);
+        if (renderer == nullptr)
+        {
+            std::cerr << "Could not initialize Celestia!\n";
+            return 2;
+        }
+        return runWorkers(*renderer, device, requestArgs, nWorkers);
+    }
+
+    auto renderer = HeadlessRenderer::create(device, configFile, extrasDirs, startupReport);
+    if (renderer == nullptr)
+    {
+        std::cerr << "Could not initialize Celestia!\n";
+        return 2;
+    }
+
+    if (!hipsDir.empty())
+    {
+        HipsGenerator hips(*renderer, hipsOptions);
+        return hips.generate(request.render, hipsDir) ? 0 : 3;
+    }
+
+    if (!batch)
+        return renderer->render(request.render, request.output) ? 0 : 3;
+
+    // In batch mode, the lines use the options of the command line as
+    // defaults, and the status of each request is reported on a line of
+    // the standard output.
+    std::string line;
+    while (std::getline(std::cin, line))
+    {
+        Request lineRequest;
+        bool ok;
+        if (!parseBatchLine(line, requestArgs, lineRequest, ok))
+            continue;
+
+        ok = ok && renderer->render(lineRequest.render, lineRequest.output);
+        std::cout << (ok ? "ok " : "failed ") << lineRequest.output.string() << std::endl;
+    }
+
+    return 0;
+}
+
+} // end unnamed namespace
+} // end namespace celestia
+
+int
+main(int argc, char** argv)
+{
+    return celestia::headlessmain(argc, argv);
+}
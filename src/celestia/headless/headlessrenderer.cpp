@@ -0,0 +1,278 @@
+// headlessrenderer.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Rendering of single images without a window system.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "headlessrenderer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <mutex>
+#include <celengine/framebuffer.h>
+#include <celengine/glsupport.h>
+#include <celengine/image.h>
+#include <celengine/observer.h>
+#include <celengine/simulation.h>
+#include <celimage/imageformats.h>
+#include <celmath/mathlib.h>
+#include <celutil/logger.h>
+#include <celestia/celestiacore.h>
+#include "headlesscontext.h"
+
+using celestia::util::GetLogger;
+
+namespace celestia
+{
+
+namespace
+{
+
+// The texture and model managers are global, so GL objects are shared
+// between all contexts and only one of them is used at a time
+std::mutex glMutex;
+std::vector<const HeadlessContext*> contexts;
+bool glInitialized = false;
+
+// Binds a context to the calling thread for the lifetime of the object
+class CurrentContext
+{
+ public:
+    explicit CurrentContext(const HeadlessContext& _context) :
+        context(_context),
+        current(_context.makeCurrent())
+    {
+    }
+
+    ~CurrentContext()
+    {
+        if (current)
+            context.release();
+    }
+
+    explicit operator bool() const { return current; }
+
+ private:
+    const HeadlessContext& context;
+    bool current;
+};
+
+} // end unnamed namespace
+
+class HeadlessRenderer::Alerter : public CelestiaCore::Alerter
+{
+ public:
+    void fatalError(const std::string& msg) override
+    {
+        GetLogger()->error("{}\n", msg);
+    }
+};
+
+HeadlessRenderer::~HeadlessRenderer()
+{
+    std::lock_guard<std::mutex> lock(glMutex);
+    if (context == nullptr)
+        return;
+
+    // The GL objects of the core are deleted in its context
+    {
+        CurrentContext current(*context);
+        fbo = nullptr;
+        core = nullptr;
+    }
+    contexts.erase(std::remove(contexts.begin(), contexts.end(), context.get()), contexts.end());
+}
+
+std::unique_ptr<HeadlessRenderer>
+HeadlessRenderer::create(int device,
+                         const fs::path& configFile,
+                         const std::vector<fs::path>& extrasDirs,
+                         bool startupReport)
+{
+    auto renderer = load(configFile, extrasDirs, startupReport);
+    if (renderer == nullptr || !renderer->initGL(device))
+        return nullptr;
+    return renderer;
+}
+
+std::unique_ptr<HeadlessRenderer>
+HeadlessRenderer::load(const fs::path& configFile,
+                       const std::vector<fs::path>& extrasDirs,
+                       bool startupReport)
+{
+    std::unique_ptr<HeadlessRenderer> renderer(new HeadlessRenderer());
+    renderer->alerter = std::make_unique<Alerter>();
+    renderer->core = std::make_unique<CelestiaCore>();
+    renderer->core->setAlerter(renderer->alerter.get());
+    renderer->core->setStartupReport(startupReport);
+    if (!renderer->core->initSimulation(configFile, extrasDirs))
+        return nullptr;
+    return renderer;
+}
+
+bool
+HeadlessRenderer::initGL(int device)
+{
+    std::lock_guard<std::mutex> lock(glMutex);
+    context = HeadlessContext::create(device, contexts.empty() ? nullptr : contexts.front());
+    if (context == nullptr)
+        return false;
+    contexts.push_back(context.get());
+
+    CurrentContext current(*context);
+    if (!current)
+    {
+        GetLogger()->error("Could not make the EGL context current.\n");
+        return false;
+    }
+
+    if (!glInitialized)
+    {
+        const auto* config = core->getConfig();
+        if (!gl::init(config->ignoreGLExtensions))
+            return false;
+        glInitialized = true;
+    }
+
+#ifndef GL_ES
+    if (!gl::checkVersion(gl::GL_2_1))
+    {
+        GetLogger()->error("Celestia requires OpenGL 2.1!\n");
+        return false;
+    }
+#endif
+    if (!FramebufferObject::isSupported())
+    {
+        GetLogger()->error("Framebuffer objects are not supported.\n");
+        return false;
+    }
+
+    if (!core->initRenderer())
+        return false;
+
+    const auto* config = core->getConfig();
+    Renderer* glRenderer = core->getRenderer();
+    glRenderer->setRenderFlags(Renderer::DefaultRenderFlags);
+    glRenderer->setShadowMapSize(config->ShadowMapSize);
+    glRenderer->setGPUStarField(config->gpuStarField);
+    glRenderer->setGPUOrbits(config->gpuOrbits);
+    glRenderer->setModelInstancing(config->modelInstancing);
+    glRenderer->setDSOImpostors(config->dsoImpostors);
+    glRenderer->setLabelDeclutter(config->labelDeclutter);
+    glRenderer->setSolarSystemMaxDistance(config->SolarSystemMaxDistance);
+
+    core->start();
+    core->setHudDetail(0);
+    // Every image waits for the resources it shows
+    core->setOfflineRendering(true);
+    // Time only changes with requests
+    core->getSimulation()->setPauseState(true);
+
+    return true;
+}
+
+void
+HeadlessRenderer::applyRequest(const RenderRequest& request)
+{
+    if (!request.url.empty() && !core->goToUrl(request.url))
+        GetLogger()->warn("Invalid URL {}\n", request.url);
+
+    Simulation* sim = core->getSimulation();
+    if (!std::isnan(request.tdb))
+        sim->setTime(request.tdb);
+
+    Observer* observer = sim->getActiveObserver();
+    if (request.position.has_value())
+    {
+        sim->setTrackedObject(Selection());
+        sim->setFrame(ObserverFrame::Universal, Selection());
+        observer->setPosition(*request.position);
+    }
+    if (request.orientation.has_value())
+        observer->setOrientation(*request.orientation);
+    if (request.fov > 0.0f)
+    {
+        observer->setFOV(celmath::degToRad(request.fov));
+        core->setZoomFromFOV();
+    }
+
+    sim->update(0.0);
+}
+
+std::unique_ptr<Image>
+HeadlessRenderer::render(const RenderRequest& request)
+{
+    if (request.width <= 0 || request.height <= 0)
+    {
+        GetLogger()->error("Invalid image size {}x{}\n", request.width, request.height);
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(glMutex);
+    CurrentContext current(*context);
+    if (!current)
+    {
+        GetLogger()->error("Could not make the EGL context current.\n");
+        return nullptr;
+    }
+
+    auto width = static_cast<GLuint>(request.width);
+    auto height = static_cast<GLuint>(request.height);
+    if (fbo == nullptr || fbo->width() != width || fbo->height() != height)
+    {
+        fbo = std::make_unique<FramebufferObject>(width, height,
+                                                  FramebufferObject::ColorAttachment |
+                                                  FramebufferObject::DepthAttachment);
+        if (!fbo->isValid())
+        {
+            GetLogger()->error("Could not create a {}x{} framebuffer.\n", width, height);
+            fbo = nullptr;
+            return nullptr;
+        }
+    }
+
+    fbo->bind();
+    // Resize before applying the request, as resizing may change the FOV
+    core->resize(request.width, request.height);
+    applyRequest(request);
+    core->draw();
+
+    std::array<int, 4> viewport;
+    PixelFormat format;
+    core->getCaptureInfo(viewport, format);
+    auto image = std::make_unique<Image>(format, viewport[2], viewport[3]);
+    bool captured = core->captureImage(image->getPixels(), viewport, format);
+    fbo->unbind(0);
+
+    if (!captured)
+        return nullptr;
+    return image;
+}
+
+bool
+HeadlessRenderer::render(const RenderRequest& request, const fs::path& filename, ContentType type)
+{
+    if (type == Content_Unknown)
+        type = DetermineFileType(filename);
+    if (type != Content_JPEG && type != Content_PNG)
+    {
+        GetLogger()->error("Unsupported image type: {}!\n", filename);
+        return false;
+    }
+
+    auto image = render(request);
+    if (image == nullptr)
+        return false;
+
+    return type == Content_JPEG
+        ? SaveJPEGImage(filename, *image)
+        : SavePNGImage(filename, *image);
+}
+
+} // end namespace celestia
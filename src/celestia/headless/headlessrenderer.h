@@ -0,0 +1,103 @@
+// headlessrenderer.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Rendering of single images without a window system.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include <Eigen/Geometry>
+#include <celcompat/filesystem.h>
+#include <celengine/univcoord.h>
+#include <celutil/filetype.h>
+
+class CelestiaCore;
+class FramebufferObject;
+class Image;
+
+namespace celestia
+{
+
+class HeadlessContext;
+
+struct RenderRequest
+{
+    int width{ 640 };
+    int height{ 480 };
+    // cel:// URL applied before the other settings; it sets the observer,
+    // the time and the render flags
+    std::string url;
+    // Time as a TDB Julian date; NaN keeps the current time
+    double tdb{ std::numeric_limits<double>::quiet_NaN() };
+    // Observer position and orientation in universal coordinates
+    std::optional<UniversalCoord> position;
+    std::optional<Eigen::Quaterniond> orientation;
+    // Vertical field of view in degrees; zero keeps the current one
+    float fov{ 0.0f };
+};
+
+// HeadlessRenderer renders images for requests into a framebuffer object
+// of an EGL context. Each renderer has a simulation of its own, so
+// requests don't affect each other.
+//
+// Several renderers can be used in one process, but the texture and model
+// managers are shared by all of them, so their contexts share objects and
+// are on the same device. Requests are rendered one at a time even when
+// coming from different threads. To use several GPUs, run a process on
+// each of them.
+class HeadlessRenderer
+{
+ public:
+    ~HeadlessRenderer();
+    HeadlessRenderer(const HeadlessRenderer&) = delete;
+    HeadlessRenderer& operator=(const HeadlessRenderer&) = delete;
+
+    // Create a renderer on the EGL device with the given index, or on the
+    // default display if device is negative. The first renderer created
+    // selects the device for the process; later ones share its context.
+    // The current directory must be the data directory. With startupReport,
+    // the costs of the startup stages are logged.
+    static std::unique_ptr<HeadlessRenderer> create(int device,
+                                                    const fs::path& configFile = {},
+                                                    const std::vector<fs::path>& extrasDirs = {},
+                                                    bool startupReport = false);
+    // The two steps of create(): load() reads the configuration and the
+    // catalogs without touching EGL, so that a process can load them once
+    // and fork workers sharing their pages, and initGL() then creates the
+    // context of the renderer in each worker.
+    static std::unique_ptr<HeadlessRenderer> load(const fs::path& configFile = {},
+                                                  const std::vector<fs::path>& extrasDirs = {},
+                                                  bool startupReport = false);
+    bool initGL(int device);
+
+    // Render the view described by request; the rows of the image are
+    // bottom to top.
+    std::unique_ptr<Image> render(const RenderRequest& request);
+    // Render the view described by request to a PNG or JPEG file
+    bool render(const RenderRequest& request, const fs::path& filename, ContentType type = Content_Unknown);
+
+    CelestiaCore* getCore() const { return core.get(); }
+
+ private:
+    class Alerter;
+
+    HeadlessRenderer() = default;
+    void applyRequest(const RenderRequest& request);
+
+    std::unique_ptr<HeadlessContext> context;
+    std::unique_ptr<Alerter> alerter;
+    std::unique_ptr<CelestiaCore> core;
+    std::unique_ptr<FramebufferObject> fbo;
+};
+
+} // end namespace celestia
@@ -0,0 +1,292 @@
+// hipsgenerator.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Rendering of all-sky HiPS surveys.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <system_error>
+#include <fmt/format.h>
+#include <celcompat/numbers.h>
+#include <celengine/astro.h>
+#include <celengine/image.h>
+#include <celengine/observer.h>
+#include <celengine/render.h>
+#include <celengine/simulation.h>
+#include <celestia/celestiacore.h>
+#include <celimage/imageformats.h>
+#include <celmath/geomutil.h>
+#include <celmath/healpix.h>
+#include <celmath/mathlib.h>
+#include <celutil/jobsystem.h>
+#include <celutil/logger.h>
+#include "headlessrenderer.h"
+#include "hipsgenerator.h"
+
+using celestia::util::GetLogger;
+
+namespace celestia
+{
+
+namespace
+{
+
+// Widest field of view rendered for a tile; tiles of lower orders are
+// too large for a perspective view
+constexpr double MaxFOV = celmath::degToRad(150.0);
+// Margin around the tiles in the views, so that the pixels on their
+// edges are interpolated
+constexpr double FOVMargin = 1.05;
+constexpr int MaxViewSize = 4096;
+
+// Points on the boundary of a HEALPix pixel, from 0 to 1 across it
+constexpr std::array<std::array<double, 2>, 8> BoundaryPoints
+{{
+    { 0.0, 0.0 }, { 0.5, 0.0 }, { 1.0, 0.0 }, { 1.0, 0.5 },
+    { 1.0, 1.0 }, { 0.5, 1.0 }, { 0.0, 1.0 }, { 0.0, 0.5 },
+}};
+
+// Sample the components of view at (x, y) in pixels, interpolating
+// bilinearly and clamping to the edges
+void
+sampleBilinear(Image& view, double x, double y, std::uint8_t* out)
+{
+    int width = view.getWidth();
+    int height = view.getHeight();
+    int components = view.getComponents();
+
+    x = std::clamp(x, 0.0, static_cast<double>(width - 1));
+    y = std::clamp(y, 0.0, static_cast<double>(height - 1));
+    int x0 = static_cast<int>(x);
+    int y0 = static_cast<int>(y);
+    int x1 = std::min(x0 + 1, width - 1);
+    int y1 = std::min(y0 + 1, height - 1);
+    double fx = x - x0;
+    double fy = y - y0;
+
+    const std::uint8_t* row0 = view.getPixelRow(y0);
+    const std::uint8_t* row1 = view.getPixelRow(y1);
+    for (int c = 0; c < components; c++)
+    {
+        double bottom = row0[x0 * components + c] * (1.0 - fx) + row0[x1 * components + c] * fx;
+        double top = row1[x0 * components + c] * (1.0 - fx) + row1[x1 * components + c] * fx;
+        out[c] = static_cast<std::uint8_t>(bottom * (1.0 - fy) + top * fy + 0.5);
+    }
+}
+
+} // end unnamed namespace
+
+HipsGenerator::HipsGenerator(HeadlessRenderer& _renderer, const HipsOptions& _options) :
+    renderer(_renderer),
+    options(_options)
+{
+    icrsToUniversal.col(0) = astro::equatorialToCelestialCart(0.0, 0.0, 1.0);
+    icrsToUniversal.col(1) = astro::equatorialToCelestialCart(6.0, 0.0, 1.0);
+    icrsToUniversal.col(2) = astro::equatorialToCelestialCart(0.0, 90.0, 1.0);
+}
+
+bool
+HipsGenerator::generate(const RenderRequest& request, const fs::path& outputDir)
+{
+    if (options.order < 0 || options.order > 20)
+    {
+        GetLogger()->error("Invalid HiPS order {}\n", options.order);
+        return false;
+    }
+    if (options.tileWidth < 1 || (options.tileWidth & (options.tileWidth - 1)) != 0)
+    {
+        GetLogger()->error("Invalid HiPS tile width {}\n", options.tileWidth);
+        return false;
+    }
+    if (options.format != Content_PNG && options.format != Content_JPEG)
+    {
+        GetLogger()->error("HiPS tiles are PNG or JPEG images\n");
+        return false;
+    }
+
+    std::error_code ec;
+    fs::create_directories(outputDir, ec);
+    if (ec || !writeProperties(outputDir))
+    {
+        GetLogger()->error("Could not write to {}\n", outputDir);
+        return false;
+    }
+
+    // Set the observer once, then render every view from where it is in
+    // the universal frame, where the orientations of the views are absolute
+    CelestiaCore* core = renderer.getCore();
+    Simulation* sim = core->getSimulation();
+    if (!request.url.empty() && !core->goToUrl(request.url))
+        GetLogger()->warn("Invalid URL {}\n", request.url);
+    if (!std::isnan(request.tdb))
+        sim->setTime(request.tdb);
+    sim->update(0.0);
+    UniversalCoord position = request.position.value_or(sim->getActiveObserver()->getPosition());
+
+    Renderer* glRenderer = core->getRenderer();
+    auto projectionMode = glRenderer->getProjectionMode();
+    glRenderer->setProjectionMode(Renderer::ProjectionMode::PerspectiveMode);
+
+    const std::uint64_t tileCount = celmath::HealpixPixelCount(options.order);
+    // Angle across a tile, on average
+    const double tileSpan = std::sqrt(4.0 * celestia::numbers::pi / static_cast<double>(tileCount));
+
+    // The views of a batch are resampled while the next batch is rendered
+    const util::JobSystem* jobs = util::GetJobSystem();
+    const std::uint64_t batchSize = jobs == nullptr ? 1 : jobs->size() * 2;
+    std::array<std::unique_ptr<util::TaskGroup>, 2> batches;
+    std::atomic<bool> failed{ false };
+    std::uint64_t reported = 0;
+
+    for (std::uint64_t tile = 0; tile < tileCount && !failed; tile++)
+    {
+        auto& batch = batches[(tile / batchSize) % 2];
+        if (tile % batchSize == 0)
+        {
+            // Wait for the batch rendered two batches ago
+            batch = nullptr;
+            batch = std::make_unique<util::TaskGroup>(util::JobPriority::Background);
+        }
+
+        Eigen::Vector3d centre = icrsToUniversal * celmath::HealpixNestedToVector(options.order, tile);
+        double halfAngle = 0.0;
+        for (const auto& point : BoundaryPoints)
+        {
+            Eigen::Vector3d corner = icrsToUniversal * celmath::HealpixNestedToVector(options.order, tile, point[0], point[1]);
+            halfAngle = std::max(halfAngle, std::acos(std::clamp(centre.dot(corner), -1.0, 1.0)));
+        }
+
+        double fov = 2.0 * halfAngle * FOVMargin;
+        if (fov > MaxFOV)
+        {
+            GetLogger()->error("The tiles of HiPS order {} are too large to render\n", options.order);
+            failed = true;
+            break;
+        }
+
+        // Render the view with pixels no larger than those of the tile
+        double tanHalfFov = std::tan(fov * 0.5);
+        auto size = static_cast<int>(std::ceil(options.tileWidth * 2.0 * tanHalfFov / tileSpan));
+        size = std::clamp(size, options.tileWidth, MaxViewSize);
+
+        Eigen::Vector3d up = icrsToUniversal.col(2);
+        if (std::abs(centre.dot(up)) > 0.99)
+            up = icrsToUniversal.col(0);
+
+        RenderRequest viewRequest;
+        viewRequest.width = size;
+        viewRequest.height = size;
+        viewRequest.position = position;
+        viewRequest.orientation = celmath::LookAt(Eigen::Vector3d::Zero().eval(), centre, up);
+        viewRequest.fov = static_cast<float>(celmath::radToDeg(fov));
+
+        std::shared_ptr<Image> view = renderer.render(viewRequest);
+        if (view == nullptr)
+        {
+            GetLogger()->error("Could not render HiPS tile {}\n", tile);
+            failed = true;
+            break;
+        }
+
+        batch->run([this, tile, view, orientation = *viewRequest.orientation, tanHalfFov, &outputDir, &failed]
+        {
+            if (!writeTile(tile, *view, orientation, tanHalfFov, outputDir))
+                failed = true;
+        });
+
+        if ((tile + 1) * 100 / tileCount > reported)
+        {
+            reported = (tile + 1) * 100 / tileCount;
+            GetLogger()->info("Rendered {} of {} HiPS tiles\n", tile + 1, tileCount);
+        }
+    }
+
+    for (auto& batch : batches)
+        batch = nullptr;
+    glRenderer->setProjectionMode(projectionMode);
+
+    return !failed;
+}
+
+bool
+HipsGenerator::writeProperties(const fs::path& outputDir) const
+{
+    std::ofstream out(outputDir / "properties");
+    if (!out.good())
+        return false;
+
+    out << "creator_did = ivo://celestia/P/" << outputDir.filename().string() << '\n'
+        << "obs_title = Celestia sky\n"
+        << "dataproduct_type = image\n"
+        << "hips_version = 1.4\n"
+        << "hips_frame = equatorial\n"
+        << "hips_order = " << options.order << '\n'
+        << "hips_order_min = " << options.order << '\n'
+        << "hips_tile_width = " << options.tileWidth << '\n'
+        << "hips_tile_format = " << (options.format == Content_PNG ? "png" : "jpeg") << '\n';
+    return out.good();
+}
+
+bool
+HipsGenerator::writeTile(std::uint64_t tile, Image& view, const Eigen::Quaterniond& orientation,
+                         double tanHalfFov, const fs::path& outputDir) const
+{
+    const int width = options.tileWidth;
+    const int components = view.getComponents();
+    const double viewWidth = view.getWidth();
+    const double viewHeight = view.getHeight();
+
+    Image image(view.getFormat(), width, width);
+    for (int row = 0; row < width; row++)
+    {
+        // Image rows are top to bottom, tile rows bottom to top
+        std::uint8_t* out = image.getPixelRow(width - 1 - row);
+        for (int column = 0; column < width; column++, out += components)
+        {
+            Eigen::Vector3d direction = icrsToUniversal *
+                celmath::HealpixNestedToVector(options.order, tile,
+                                               (column + 0.5) / width,
+                                               (row + 0.5) / width);
+            Eigen::Vector3d v = orientation * direction;
+            if (v.z() >= 0.0)
+            {
+                std::fill_n(out, components, std::uint8_t(0));
+                continue;
+            }
+
+            // Project into the view, whose rows are bottom to top
+            double x = (v.x() / (-v.z() * tanHalfFov) + 1.0) * 0.5 * viewWidth - 0.5;
+            double y = (v.y() / (-v.z() * tanHalfFov) + 1.0) * 0.5 * viewHeight - 0.5;
+            sampleBilinear(view, x, y, out);
+        }
+    }
+
+    std::uint64_t dir = tile / 10000 * 10000;
+    fs::path path = outputDir / fmt::format("Norder{}", options.order) / fmt::format("Dir{}", dir);
+    std::error_code ec;
+    fs::create_directories(path, ec);
+    if (ec)
+    {
+        GetLogger()->error("Could not create {}\n", path);
+        return false;
+    }
+
+    bool saved = options.format == Content_PNG
+        ? SavePNGImage(path / fmt::format("Npix{}.png", tile), image)
+        : SaveJPEGImage(path / fmt::format("Npix{}.jpg", tile), image);
+    if (!saved)
+        GetLogger()->error("Could not write HiPS tile {}\n", tile);
+    return saved;
+}
+
+} // end namespace celestia
@@ -0,0 +1,67 @@
+// hipsgenerator.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Rendering of all-sky HiPS surveys.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <celcompat/filesystem.h>
+#include <celutil/filetype.h>
+
+class Image;
+
+namespace celestia
+{
+
+class HeadlessRenderer;
+struct RenderRequest;
+
+struct HipsOptions
+{
+    // HEALPix order of the tiles
+    int order{ 3 };
+    // Width and height of the tiles in pixels; a power of two
+    int tileWidth{ 512 };
+    // Content_PNG or Content_JPEG
+    ContentType format{ Content_PNG };
+};
+
+// HipsGenerator renders the sky seen by an observer as the tiles of a
+// HiPS survey: each tile is a nested HEALPix pixel in the ICRS frame,
+// written to Norder<order>/Dir<dir>/Npix<pixel> in the output directory.
+// The pixel at column x and row y from the bottom of a tile is the point
+// (x, y) of the HEALPix pixel, so that the north corner of the tile is at
+// its top right.
+//
+// The views are rendered one at a time by the renderer, while the tiles
+// already rendered are resampled and written by the job system.
+class HipsGenerator
+{
+ public:
+    HipsGenerator(HeadlessRenderer& renderer, const HipsOptions& options);
+
+    // Render all of the tiles for the observer and time of request, whose
+    // size, orientation and field of view are ignored.
+    bool generate(const RenderRequest& request, const fs::path& outputDir);
+
+ private:
+    bool writeProperties(const fs::path& outputDir) const;
+    bool writeTile(std::uint64_t tile, Image& view, const Eigen::Quaterniond& orientation,
+                   double tanHalfFov, const fs::path& outputDir) const;
+
+    HeadlessRenderer& renderer;
+    HipsOptions options;
+    // Rotation from the ICRS frame to the universal frame
+    Eigen::Matrix3d icrsToUniversal;
+};
+
+} // end namespace celestia
@@ -0,0 +1,401 @@
+// imagesequencecapture.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Capture of the rendered frames to a sequence of PNG or JPEG images.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "imagesequencecapture.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <celengine/framereader.h>
+#include <celengine/pixelformat.h>
+#include <celengine/render.h>
+#include <celimage/imageformats.h>
+#include <celutil/filetype.h>
+#include <celutil/gettext.h>
+#include <celutil/logger.h>
+
+using celestia::PixelFormat;
+using celestia::util::GetLogger;
+
+namespace
+{
+// Frames waiting in the queue per encoder thread before the overflow
+// policy applies
+constexpr std::size_t QueuedFramesPerThread = 2;
+}
+
+class ImageSequenceCapturePrivate
+{
+    // The pixels of a captured frame waiting for an encoder thread
+    struct CapturedFrame
+    {
+        std::vector<std::uint8_t> pixels;
+        int  rowSize;
+        bool topDown;
+        int  number;
+    };
+
+    bool captureFrame();
+    bool retrieveFrames(bool waitAll);
+    bool acquireBuffer(std::vector<std::uint8_t>&);
+    bool submitFrame(std::vector<std::uint8_t>&& pixels, int rowSize, bool topDown);
+    void encoderLoop();
+    bool encodeFrame(CapturedFrame&) const;
+    void stopEncoders();
+    bool failed() const;
+
+    const Renderer *renderer{ nullptr };
+
+    std::string  nameTemplate;
+    ContentType  type{ Content_Unknown };
+    int          width{ 0 };
+    int          height{ 0 };
+    float        fps{ 0.0f };
+    bool         hasAlpha{ false };
+    bool         capturing{ false };
+
+    unsigned int nThreads{ 0 };
+    ImageSequenceCapture::OverflowPolicy policy{ ImageSequenceCapture::OverflowPolicy::Block };
+
+    std::unique_ptr<FrameReader> reader;
+    bool         readerChecked{ false };
+
+    // Frames waiting for the encoder threads, and pixel buffers of written
+    // frames which can be reused
+    std::deque<CapturedFrame>              queue;
+    std::size_t                            maxQueuedFrames{ 0 };
+    std::vector<std::vector<std::uint8_t>> freeBuffers;
+    mutable std::mutex                     queueMutex;
+    std::condition_variable                queueChanged;
+    std::vector<std::thread>               encoders;
+    bool stopEncoding{ false };
+    bool encoderFailed{ false };
+
+    // Number of the next frame queued, and of frames dropped
+    int nextFrame{ 0 };
+    int droppedFrames{ 0 };
+
+    friend class ImageSequenceCapture;
+};
+
+bool ImageSequenceCapturePrivate::captureFrame()
+{
+    int x, y, w, h;
+    renderer->getViewport(&x, &y, &w, &h);
+    x += (w - width) / 2;
+    y += (h - height) / 2;
+
+    PixelFormat captureFormat = hasAlpha ? PixelFormat::RGBA : PixelFormat::RGB;
+    if (!readerChecked)
+    {
+        // the reader is created here because the GL context is current
+        readerChecked = true;
+        if (FrameReader::isSupported())
+            reader = std::make_unique<FrameReader>(width, height, captureFormat);
+    }
+
+    if (reader != nullptr)
+        return retrieveFrames(false) && reader->read(x, y);
+
+    // without pixel buffer objects the frame is read synchronously, but it
+    // is still written by the encoder threads
+    std::vector<std::uint8_t> buffer;
+    if (!acquireBuffer(buffer))
+        return !failed();
+
+    const int rowSize = (width * (hasAlpha ? 4 : 3) + 3) & ~3;
+    buffer.resize(static_cast<std::size_t>(rowSize) * height);
+    if (!renderer->captureFrame(x, y, width, height, captureFormat, buffer.data()))
+        return false;
+
+    // Renderer::captureFrame() returns the rows top to bottom
+    return submitFrame(std::move(buffer), rowSize, true);
+}
+
+// pass the frames read back so far to the encoder threads; unless waitAll
+// is set, only wait for the oldest frame when every pixel buffer of the
+// reader is in use
+bool ImageSequenceCapturePrivate::retrieveFrames(bool waitAll)
+{
+    bool ok = true;
+    auto consumer = [this, &ok](const std::uint8_t *pixels)
+    {
+        // the pixel buffer is released even when the frame is dropped
+        std::vector<std::uint8_t> buffer;
+        if (!acquireBuffer(buffer))
+        {
+            ok = !failed();
+            return;
+        }
+
+        std::size_t size = static_cast<std::size_t>(reader->getRowSize()) * height;
+        buffer.assign(pixels, pixels + size);
+        ok = submitFrame(std::move(buffer), reader->getRowSize(), reader->isTopDown());
+    };
+
+    bool wait = waitAll || reader->full();
+    while (ok && reader->retrieve(wait, consumer))
+        wait = waitAll;
+
+    return ok;
+}
+
+// get a buffer for the pixels of a new frame. When the queue is full, wait
+// for the encoder threads or, with OverflowPolicy::Drop, return false to
+// drop the frame.
+bool ImageSequenceCapturePrivate::acquireBuffer(std::vector<std::uint8_t> &buffer)
+{
+    std::unique_lock<std::mutex> lock(queueMutex);
+    if (policy == ImageSequenceCapture::OverflowPolicy::Drop)
+    {
+        if (queue.size() >= maxQueuedFrames && !encoderFailed)
+        {
+            droppedFrames++;
+            return false;
+        }
+    }
+    else
+    {
+        queueChanged.wait(lock, [this] { return queue.size() < maxQueuedFrames || encoderFailed; });
+    }
+
+    if (encoderFailed)
+        return false;
+
+    if (!freeBuffers.empty())
+    {
+        buffer = std::move(freeBuffers.back());
+        freeBuffers.pop_back();
+    }
+    return true;
+}
+
+bool ImageSequenceCapturePrivate::submitFrame(std::vector<std::uint8_t>&& pixels, int rowSize, bool topDown)
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (encoderFailed)
+            return false;
+        queue.push_back({ std::move(pixels), rowSize, topDown, nextFrame++ });
+    }
+    queueChanged.notify_one();
+    return true;
+}
+
+// body of the encoder threads: write the queued frames until the capture
+// ends and the queue is empty
+void ImageSequenceCapturePrivate::encoderLoop()
+{
+    for (;;)
+    {
+        CapturedFrame captured;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueChanged.wait(lock, [this] { return !queue.empty() || stopEncoding || encoderFailed; });
+            if (queue.empty() || encoderFailed)
+                return;
+            captured = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        bool ok = encodeFrame(captured);
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            freeBuffers.push_back(std::move(captured.pixels));
+            if (!ok)
+                encoderFailed = true;
+        }
+        queueChanged.notify_all();
+
+        if (!ok)
+            return;
+    }
+}
+
+bool ImageSequenceCapturePrivate::encodeFrame(CapturedFrame &captured) const
+{
+    // rows read back without MESA_pack_invert are bottom to top, but the
+    // image writers expect them top to bottom
+    std::uint8_t *pixels = captured.pixels.data();
+    if (!captured.topDown)
+    {
+        auto rowSize = static_cast<std::size_t>(captured.rowSize);
+        for (int i = 0; i < height / 2; i++)
+        {
+            std::uint8_t *top = pixels + rowSize * i;
+            std::uint8_t *bottom = pixels + rowSize * (height - 1 - i);
+            std::swap_ranges(top, top + rowSize, bottom);
+        }
+    }
+
+    int number = captured.number;
+    fs::path filename = fmt::vformat(nameTemplate, fmt::make_format_args(number));
+
+    // the writers strip the alpha channel of RGBA frames in place
+    if (type == Content_JPEG)
+        return SaveJPEGImage(filename, width, height, captured.rowSize, pixels, hasAlpha);
+    return SavePNGImage(filename, width, height, captured.rowSize, pixels, hasAlpha);
+}
+
+void ImageSequenceCapturePrivate::stopEncoders()
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopEncoding = true;
+    }
+    queueChanged.notify_all();
+    for (std::thread &encoder : encoders)
+    {
+        if (encoder.joinable())
+            encoder.join();
+    }
+    encoders.clear();
+}
+
+bool ImageSequenceCapturePrivate::failed() const
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return encoderFailed;
+}
+
+ImageSequenceCapture::ImageSequenceCapture(const Renderer *r) :
+    MovieCapture(r),
+    d(std::make_unique<ImageSequenceCapturePrivate>())
+{
+    d->renderer = r;
+    d->hasAlpha = r->getPreferredCaptureFormat() == PixelFormat::RGBA;
+}
+
+ImageSequenceCapture::~ImageSequenceCapture()
+{
+    d->stopEncoders();
+}
+
+bool ImageSequenceCapture::start(const fs::path& filename, int width, int height, float fps)
+{
+    if (d->capturing)
+        return false;
+
+    d->type = DetermineFileType(filename);
+    if (d->type != Content_JPEG && d->type != Content_PNG)
+    {
+        GetLogger()->error(_("Unsupported image type: {}!\n"), filename);
+        return false;
+    }
+
+    std::string name = filename.string();
+    if (name.find('{') == std::string::npos)
+    {
+        fs::path stem = filename;
+        stem.replace_extension();
+        name = fmt::format("{}-{{:05d}}{}", stem.string(), filename.extension().string());
+    }
+
+    try
+    {
+        int number = 0;
+        fmt::vformat(name, fmt::make_format_args(number));
+    }
+    catch (const fmt::format_error&)
+    {
+        GetLogger()->error(_("Invalid frame number in image sequence name '{}'\n"), filename);
+        return false;
+    }
+
+    d->nameTemplate = std::move(name);
+    d->width = width;
+    d->height = height;
+    d->fps = fps;
+    d->readerChecked = false;
+    d->stopEncoding = false;
+    d->encoderFailed = false;
+    d->nextFrame = 0;
+    d->droppedFrames = 0;
+
+    unsigned int nThreads = d->nThreads;
+    if (nThreads == 0)
+        nThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    d->maxQueuedFrames = QueuedFramesPerThread * nThreads;
+    for (unsigned int i = 0; i < nThreads; i++)
+        d->encoders.emplace_back(&ImageSequenceCapturePrivate::encoderLoop, d.get());
+
+    d->capturing = true;
+    return true;
+}
+
+bool ImageSequenceCapture::end()
+{
+    if (!d->capturing)
+        return false;
+
+    // hand the frames still being read back to the encoder threads and
+    // wait until they have written all of them
+    if (d->reader != nullptr)
+    {
+        d->retrieveFrames(true);
+        d->reader = nullptr;
+    }
+    d->stopEncoders();
+
+    d->capturing = false;
+    return !d->encoderFailed;
+}
+
+bool ImageSequenceCapture::captureFrame()
+{
+    return d->capturing && d->captureFrame();
+}
+
+int ImageSequenceCapture::getFrameCount() const
+{
+    std::lock_guard<std::mutex> lock(d->queueMutex);
+    return d->nextFrame;
+}
+
+int ImageSequenceCapture::getWidth() const
+{
+    return d->width;
+}
+
+int ImageSequenceCapture::getHeight() const
+{
+    return d->height;
+}
+
+float ImageSequenceCapture::getFrameRate() const
+{
+    return d->fps;
+}
+
+void ImageSequenceCapture::setEncoderThreads(unsigned int nThreads)
+{
+    d->nThreads = nThreads;
+}
+
+void ImageSequenceCapture::setOverflowPolicy(OverflowPolicy policy)
+{
+    d->policy = policy;
+}
+
+int ImageSequenceCapture::getDroppedFrameCount() const
+{
+    std::lock_guard<std::mutex> lock(d->queueMutex);
+    return d->droppedFrames;
+}
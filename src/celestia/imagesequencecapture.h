@@ -0,0 +1,70 @@
+// imagesequencecapture.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Capture of the rendered frames to a sequence of PNG or JPEG images.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <memory>
+#include "moviecapture.h"
+
+class ImageSequenceCapturePrivate;
+
+// ImageSequenceCapture writes every frame rendered while recording to an
+// image file. The frames are read back through a FrameReader and written
+// by a pool of encoder threads, so the render thread doesn't wait for the
+// PNG or JPEG encoder.
+//
+// The filename passed to start() may contain a fmt replacement field for
+// the frame number, e.g. "orbit-{:04d}.png"; without one, the number is
+// inserted before the extension as "-{:05d}". The format of the images is
+// determined by the extension.
+//
+// The frame rate passed to start() only sets the time step of the
+// simulation between frames; with a frame rate of 0 the simulation runs
+// on the system clock and the sequence records at render speed.
+class ImageSequenceCapture : public MovieCapture
+{
+ public:
+    // What happens to a frame when the encoder threads are behind and the
+    // queue of frames waiting for them is full
+    enum class OverflowPolicy
+    {
+        // The render thread waits for a free place in the queue
+        Block,
+        // The frame is dropped; the frames written are still numbered
+        // consecutively
+        Drop,
+    };
+
+    ImageSequenceCapture(const Renderer *r);
+    ~ImageSequenceCapture() override;
+
+    bool start(const fs::path&, int, int, float) override;
+    bool end() override;
+    bool captureFrame() override;
+
+    int getFrameCount() const override;
+    int getWidth() const override;
+    int getHeight() const override;
+    float getFrameRate() const override;
+
+    void setAspectRatio(int, int) override {};
+    void setQuality(float) override {};
+    void recordingStatus(bool) override {};
+
+    // Number of encoder threads, 0 for one per hardware thread; must be
+    // set before start()
+    void setEncoderThreads(unsigned int);
+    void setOverflowPolicy(OverflowPolicy);
+    int getDroppedFrameCount() const;
+
+ private:
+    std::unique_ptr<ImageSequenceCapturePrivate> d;
+};
@@ -38,6 +38,8 @@
 #include <QInputDialog>
 #include <QUrl>
 #include <QScreen>
+#include <QThread>
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <celutil/gettext.h>
@@ -82,7 +84,6 @@ const QPoint DEFAULT_MAIN_WINDOW_POSITION(20, 20);
 static const int CELESTIA_MAIN_WINDOW_VERSION = 12;
 
 static int fps_to_ms(int fps) { return fps > 0 ? 1000 / fps : 0; }
-static int ms_to_fps(int ms) { return ms > 0? 1000 / ms : 0; }
 
 #if defined(USE_FFMPEG)
 static const int videoSizes[][2] =
@@ -134,6 +135,13 @@ public:
 
     void fatalError(const string& msg)
     {
+        // The core calls back from the render thread
+        if (QThread::currentThread() != parent->thread())
+        {
+            QMetaObject::invokeMethod(parent, [this, msg] { fatalError(msg); }, Qt::QueuedConnection);
+            return;
+        }
+
         QMessageBox::critical(parent, "Celestia", QString(msg.c_str()));
     }
 
@@ -199,13 +207,17 @@ CelestiaAppWindow::CelestiaAppWindow(QWidget* parent) :
 
 CelestiaAppWindow::~CelestiaAppWindow()
 {
+    if (glWidget != nullptr)
+        glWidget->stopRenderThread();
     delete(alerter);
 }
 
 
 void CelestiaAppWindow::init(const QString& qConfigFileName,
                              const QStringList& qExtrasDirectories,
-                             const QString& logFilename)
+                             const QString& logFilename,
+                             bool startupReport,
+                             bool threadedRendering)
 {
     QDir logPath = QDir(logFilename);
     if (!logPath.makeAbsolute())
@@ -257,6 +269,8 @@ void CelestiaAppWindow::init(const QString& qConfigFileName,
         m_appCore->setLogFile(fn);
     }
 
+    m_appCore->setStartupReport(startupReport);
+
     if (!m_appCore->initSimulation(configFileName,
                                    extrasDirectories,
                                    progress))
@@ -276,6 +290,7 @@ void CelestiaAppWindow::init(const QString& qConfigFileName,
     }
 
     glWidget = new CelestiaGlWidget(nullptr, "Celestia", m_appCore);
+    glWidget->setThreadedRendering(threadedRendering);
 
     m_appCore->setCursorHandler(glWidget);
     m_appCore->setContextMenuHandler(this);
@@ -411,9 +426,11 @@ void CelestiaAppWindow::init(const QString& qConfigFileName,
     connect(fullScreenAction, SIGNAL(triggered()), this, SLOT(slotToggleFullScreen()));
     viewMenu->addAction(fullScreenAction);
 
-    // We use a timer to add m_appCore->tick to Qt's event loop
+    // We use a timer to add m_appCore->tick to Qt's event loop, unless the
+    // render thread runs it
     QObject::connect(timer, SIGNAL(timeout()), SLOT(celestia_tick()));
-    timer->start();
+    if (!glWidget->isThreadedRendering())
+        timer->start();
 }
 
 
@@ -544,7 +561,7 @@ void CelestiaAppWindow::writeSettings()
     settings.setValue("TimeZoneName", QString::fromStdString(m_appCore->getTimeZoneName()));
     settings.endGroup();
 
-    settings.setValue("fps", ms_to_fps(timer->interval()));
+    settings.setValue("fps", fpsActions->lastFPS());
 }
 
 
@@ -589,7 +606,15 @@ void CelestiaAppWindow::saveBookmarks()
 void CelestiaAppWindow::celestia_tick()
 {
     m_appCore->tick();
-    glWidget->update();
+
+    // While the view doesn't change, tick at the idle rate and leave the
+    // last frame on screen
+    int interval = std::max(fps_to_ms(fpsActions->lastFPS()),
+                            static_cast<int>(m_appCore->getFrameDelay() * 1000.0));
+    if (timer->interval() != interval)
+        timer->setInterval(interval);
+    if (m_appCore->viewUpdateRequired())
+        glWidget->update();
 }
 
 
@@ -1564,6 +1589,7 @@ void CelestiaAppWindow::closeEvent(QCloseEvent* event)
 {
     writeSettings();
     saveBookmarks();
+    glWidget->stopRenderThread();
 
     event->accept();
 }
@@ -1581,6 +1607,7 @@ void CelestiaAppWindow::setCheckedFPS()
 void CelestiaAppWindow::setFPS(int fps)
 {
     timer->setInterval(fps_to_ms(fps));
+    glWidget->setFrameInterval(fps_to_ms(fps));
     fpsActions->updateFPS(fps);
 }
 
@@ -1590,7 +1617,7 @@ void CelestiaAppWindow::setCustomFPS()
     int fps = QInputDialog::getInt(this,
                                    _("Set custom FPS"),
                                    _("FPS value"),
-                                   ms_to_fps(timer->interval()),
+                                   fpsActions->lastFPS(),
                                    0, 2048, 1, &ok);
     if (ok)
         setFPS(fps);
@@ -1600,6 +1627,13 @@ void CelestiaAppWindow::setCustomFPS()
 
 void CelestiaAppWindow::requestContextMenu(float x, float y, Selection sel)
 {
+    // The core calls back from the render thread
+    if (QThread::currentThread() != thread())
+    {
+        QMetaObject::invokeMethod(this, [this, x, y, sel] { requestContextMenu(x, y, sel); }, Qt::QueuedConnection);
+        return;
+    }
+
     qreal scale = devicePixelRatioF();
     SelectionPopup* menu = new SelectionPopup(sel, m_appCore, this);
     connect(menu, SIGNAL(selectionInfoRequested(Selection&)),
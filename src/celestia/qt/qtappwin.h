@@ -43,7 +43,9 @@ class CelestiaAppWindow : public QMainWindow, public CelestiaCore::ContextMenuHa
 
     void init(const QString& configFileName,
               const QStringList& extrasDirectories,
-              const QString& logFilename);
+              const QString& logFilename,
+              bool startupReport = false,
+              bool threadedRendering = false);
 
     void readSettings();
     void writeSettings();
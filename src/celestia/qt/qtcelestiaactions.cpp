@@ -13,6 +13,7 @@
 #include <QAction>
 #include <QActionGroup>
 #include <QMenu>
+#include <QThread>
 #include <celestia/celestiacore.h>
 #include <celutil/gettext.h>
 #include "qtcelestiaactions.h"
@@ -308,6 +309,13 @@ void CelestiaActions::syncWithAppCore()
 
 void CelestiaActions::notifyRenderSettingsChanged(const Renderer* renderer)
 {
+    // The core calls back from the render thread
+    if (QThread::currentThread() != thread())
+    {
+        QMetaObject::invokeMethod(this, [this, renderer] { syncWithRenderer(renderer); }, Qt::QueuedConnection);
+        return;
+    }
+
     syncWithRenderer(renderer);
 }
 
@@ -32,7 +32,6 @@
 #include <QFontMetrics>
 #include <QCollator>
 #include <vector>
-#include <set>
 
 using namespace Eigen;
 using namespace std;
@@ -400,25 +399,6 @@ void StarTableModel::populate(const UniversalCoord& _observerPos,
     observerPos = _observerPos;
     now = _now;
 
-    typedef multiset<Star*, StarPredicate> StarSet;
-    StarPredicate pred(criterion, observerPos, universe);
-
-    // Apply the filter
-    vector<Star*> filteredStars;
-    unsigned int totalStars = stardb.size();
-    unsigned int i = 0;
-    filteredStars.reserve(totalStars);
-    for (i = 0; i < totalStars; i++)
-    {
-        Star* star = stardb.getStar(i);
-        if (!filterPred(star))
-            filteredStars.push_back(star);
-    }
-
-    // Don't try and show more stars than remain after the filter
-    if (filteredStars.size() < nStars)
-        nStars = filteredStars.size();
-
     // Clear out the results of the previous populate() call
     if (stars.size() != 0)
     {
@@ -427,41 +407,21 @@ void StarTableModel::populate(const UniversalCoord& _observerPos,
         endResetModel();
     }
 
-    if (filteredStars.empty())
-        return;
-
-    StarSet firstStars(pred);
-
-    // We'll need at least nStars in the set, so first fill
-    // up the list indiscriminately.
-    for (i = 0; i < nStars; i++)
-    {
-        firstStars.insert(filteredStars[i]);
-    }
-
-    // From here on, only add a star to the set if it's
-    // A better match than the worst matching star already
-    // in the set.
-    const Star* lastStar = *--firstStars.end();
-    for (; i < filteredStars.size(); i++)
-    {
-        Star* star = filteredStars[i];
-        if (pred(star, lastStar))
-        {
-            firstStars.insert(star);
-            firstStars.erase(--firstStars.end());
-            lastStar = *--firstStars.end();
-        }
-    }
+    // Search the star octree for the best matches that pass the filter
+    auto accept = [&filterPred](const Star& star) { return !filterPred(&star); };
+    vector<const Star*> found;
+    if (criterion == StarPredicate::Brightness)
+        found = stardb.findBrightestStars(observerPos, nStars, accept);
+    else
+        found = stardb.findNearestStars(observerPos.toLy().cast<float>(), nStars, accept);
 
-    // Move the best matching stars into the vector
-    stars.reserve(nStars);
-    for (const auto& star : firstStars)
-    {
-        stars.push_back(star);
-    }
+    if (found.empty())
+        return;
 
-    beginInsertRows(QModelIndex(), 0, stars.size());
+    beginInsertRows(QModelIndex(), 0, found.size() - 1);
+    stars.reserve(found.size());
+    for (const Star* star : found)
+        stars.push_back(const_cast<Star*>(star));
     endInsertRows();
 }
 
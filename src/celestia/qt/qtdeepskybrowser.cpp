@@ -13,6 +13,7 @@
 #include <celestia/celestiacore.h>
 #include <celutil/gettext.h>
 #include <celutil/greek.h>
+#include <celutil/jobsystem.h>
 #include "qtdeepskybrowser.h"
 #include "qtcolorswatchwidget.h"
 #include "qtinfopanel.h"
@@ -31,8 +32,11 @@
 #include <QLineEdit>
 #include <QRegExp>
 #include <QCollator>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <utility>
 #include <vector>
-#include <set>
 
 using namespace Eigen;
 using namespace std;
@@ -40,6 +44,9 @@ using namespace std;
 
 static const int MAX_LISTED_DSOS = 20000;
 
+// Number of rows added to the table at a time as it is scrolled down
+static const int DSO_FETCH_BATCH_SIZE = 500;
+
 class DSOFilterPredicate
 {
 public:
@@ -80,7 +87,7 @@ class DSOTableModel : public QAbstractTableModel, public ModelHelper
 {
 public:
     DSOTableModel(const Universe* _universe);
-    virtual ~DSOTableModel() = default;
+    virtual ~DSOTableModel();
 
     Selection objectAtIndex(const QModelIndex&) const;
 
@@ -90,6 +97,8 @@ public:
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
     int rowCount(const QModelIndex& index) const override;
     int columnCount(const QModelIndex& index) const override;
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
     void sort(int column, Qt::SortOrder order) override;
 
     // Methods from ModelHelper
@@ -117,17 +126,62 @@ public:
 
     DeepSkyObject* itemAtRow(unsigned int row) const;
 
+    // Number of objects found by the last search, of which only the first
+    // rowCount() are shown until the table is scrolled down
+    int resultCount() const { return (int) dsos.size(); }
+
 private:
+    // The parameters of a search, copied to the job that runs it
+    struct Query
+    {
+        Vector3d observerPos{ Vector3d::Zero() };
+        DSOFilterPredicate filter;
+        DSOPredicate::Criterion criterion{ DSOPredicate::Distance };
+        unsigned int nDSOs{ 0 };
+        // Order of the results, set by sort()
+        bool sorted{ false };
+        DSOPredicate::Criterion sortCriterion{ DSOPredicate::Alphabetical };
+        Qt::SortOrder sortOrder{ Qt::AscendingOrder };
+    };
+
+    // Lets a job deliver its results to the model unless the model has
+    // been destroyed in the meantime.
+    struct ResultSink
+    {
+        std::mutex mutex;
+        DSOTableModel* model{ nullptr };
+    };
+
+    static vector<DeepSkyObject*> runQuery(const Universe* universe, const Query& query);
+    void startQuery();
+    void setResults(unsigned int generation,
+                    const Vector3d& resultObserverPos,
+                    const vector<DeepSkyObject*>& results);
+
     const Universe* universe;
     Vector3d observerPos;
     vector<DeepSkyObject*> dsos;
+    int shownRows{ 0 };
+
+    Query query;
+    unsigned int generation{ 0 };
+    std::shared_ptr<ResultSink> sink;
 };
 
 
 DSOTableModel::DSOTableModel(const Universe* _universe) :
     universe(_universe),
-    observerPos(Vector3d::Zero())
+    observerPos(Vector3d::Zero()),
+    sink(std::make_shared<ResultSink>())
 {
+    sink->model = this;
+}
+
+
+DSOTableModel::~DSOTableModel()
+{
+    std::scoped_lock lock(sink->mutex);
+    sink->model = nullptr;
 }
 
 Selection DSOTableModel::objectAtIndex(const QModelIndex& _index) const
@@ -148,7 +202,7 @@ Qt::ItemFlags DSOTableModel::flags(const QModelIndex& /*unused*/) const
 QVariant DSOTableModel::data(const QModelIndex& index, int role) const
 {
     int row = index.row();
-    if (row < 0 || row >= (int) dsos.size())
+    if (row < 0 || row >= shownRows)
     {
         // Out of range
         return QVariant();
@@ -204,9 +258,9 @@ QVariant DSOTableModel::headerData(int section, Qt::Orientation /* orientation *
 
 
 // Override QAbstractDataModel::rowCount()
-int DSOTableModel::rowCount(const QModelIndex& /*unused*/) const
+int DSOTableModel::rowCount(const QModelIndex& parent) const
 {
-    return (int) dsos.size();
+    return parent.isValid() ? 0 : shownRows;
 }
 
 
@@ -217,6 +271,29 @@ int DSOTableModel::columnCount(const QModelIndex& /*unused*/) const
 }
 
 
+// Override QAbstractDataModel::canFetchMore()
+bool DSOTableModel::canFetchMore(const QModelIndex& parent) const
+{
+    return !parent.isValid() && shownRows < (int) dsos.size();
+}
+
+
+// Override QAbstractDataModel::fetchMore()
+void DSOTableModel::fetchMore(const QModelIndex& parent)
+{
+    if (parent.isValid())
+        return;
+
+    int count = std::min((int) dsos.size() - shownRows, DSO_FETCH_BATCH_SIZE);
+    if (count <= 0)
+        return;
+
+    beginInsertRows(QModelIndex(), shownRows, shownRows + count - 1);
+    shownRows += count;
+    endInsertRows();
+}
+
+
 Selection DSOTableModel::itemForInfoPanel(const QModelIndex& _index)
 {
     Selection sel = itemAtRow((unsigned int) _index.row());
@@ -311,14 +388,13 @@ void DSOTableModel::sort(int column, Qt::SortOrder order)
         break;
     }
 
-    DSOPredicate pred(criterion, observerPos, universe);
+    query.sorted = true;
+    query.sortCriterion = criterion;
+    query.sortOrder = order;
 
-    std::sort(dsos.begin(), dsos.end(), pred);
-
-    if (order == Qt::DescendingOrder)
-        reverse(dsos.begin(), dsos.end());
-
-    dataChanged(index(0, 0), index(dsos.size() - 1, 4));
+    // Nothing to sort before the first search
+    if (query.nDSOs != 0)
+        startQuery();
 }
 
 
@@ -327,80 +403,109 @@ void DSOTableModel::populate(const UniversalCoord& _observerPos,
                              DSOPredicate::Criterion criterion,
                              unsigned int nDSOs)
 {
-    const DSODatabase& dsodb = *universe->getDSOCatalog();
+    query.observerPos = _observerPos.offsetFromKm(UniversalCoord::Zero()) * astro::kilometersToLightYears(1.0);
+    query.filter = filterPred;
+    query.criterion = criterion;
+    query.nDSOs = nDSOs;
+    // A new search lists the best matches first, whatever the table was
+    // sorted by before
+    query.sorted = false;
+
+    startQuery();
+}
+
+
+// Search the database, which can take a while for large catalogs, so
+// it's done by a job and the results are passed back to the model on
+// the GUI thread. Sorting by a column runs the search again, as it
+// is no more expensive than sorting the names.
+void DSOTableModel::startQuery()
+{
+    unsigned int queryGeneration = ++generation;
 
-    observerPos = _observerPos.offsetFromKm(UniversalCoord::Zero()) * astro::kilometersToLightYears(1.0);
+    auto job = [universe = universe, query = query, sink = sink, queryGeneration]()
+    {
+        vector<DeepSkyObject*> results = runQuery(universe, query);
+
+        std::scoped_lock lock(sink->mutex);
+        if (sink->model == nullptr)
+            return;
+
+        DSOTableModel* model = sink->model;
+        QMetaObject::invokeMethod(model,
+                                  [model, queryGeneration, pos = query.observerPos, results = std::move(results)]()
+                                  {
+                                      model->setResults(queryGeneration, pos, results);
+                                  },
+                                  Qt::QueuedConnection);
+    };
 
-    typedef multiset<DeepSkyObject*, DSOPredicate> DSOSet;
+    celestia::util::JobSystem* jobSystem = celestia::util::GetJobSystem();
+    if (jobSystem != nullptr)
+        jobSystem->submit(std::move(job), celestia::util::JobPriority::Interactive);
+    else
+        job();
+}
 
-    DSOPredicate pred(criterion, observerPos, universe);
+
+vector<DeepSkyObject*> DSOTableModel::runQuery(const Universe* universe, const Query& query)
+{
+    const DSODatabase& dsodb = *universe->getDSOCatalog();
 
     // Apply the filter
-    vector<DeepSkyObject*> filteredDSOs;
+    vector<DeepSkyObject*> results;
     unsigned int totalDSOs = dsodb.size();
-    unsigned int i = 0;
-    filteredDSOs.reserve(totalDSOs);
-    for (i = 0; i < totalDSOs; i++)
+    results.reserve(totalDSOs);
+    for (unsigned int i = 0; i < totalDSOs; i++)
     {
         DeepSkyObject* dso = dsodb.getDSO(i);
-        if (!filterPred(dso))
-            filteredDSOs.push_back(dso);
+        if (!query.filter(dso))
+            results.push_back(dso);
     }
 
-    // Don't try and show more DSOs than remain after the filter
-    if (filteredDSOs.size() < nDSOs)
-        nDSOs = filteredDSOs.size();
-
-    // Clear out the results of the previous populate() call
-    if (dsos.size() != 0)
+    // Keep the best matching DSOs
+    DSOPredicate pred(query.criterion, query.observerPos, universe);
+    if (results.size() > query.nDSOs)
     {
-        beginResetModel();
-        dsos.clear();
-        endResetModel();
+        std::nth_element(results.begin(), results.begin() + query.nDSOs, results.end(), pred);
+        results.resize(query.nDSOs);
     }
 
-    if (filteredDSOs.empty())
-        return;
-
-    DSOSet firstDSOs(pred);
-
-    // We'll need at least nDSOs in the set, so first fill
-    // up the list indiscriminately.
-    for (i = 0; i < nDSOs; i++)
+    if (query.sorted)
     {
-        firstDSOs.insert(filteredDSOs[i]);
+        DSOPredicate sortPred(query.sortCriterion, query.observerPos, universe);
+        std::sort(results.begin(), results.end(), sortPred);
+        if (query.sortOrder == Qt::DescendingOrder)
+            std::reverse(results.begin(), results.end());
     }
-
-    // From here on, only add a dso to the set if it's
-    // A better match than the worst matching dso already
-    // in the set.
-    const DeepSkyObject* lastDSO = *--firstDSOs.end();
-    for (; i < filteredDSOs.size(); i++)
+    else
     {
-        DeepSkyObject* dso = filteredDSOs[i];
-        if (pred(dso, lastDSO))
-        {
-            firstDSOs.insert(dso);
-            firstDSOs.erase(--firstDSOs.end());
-            lastDSO = *--firstDSOs.end();
-        }
+        std::sort(results.begin(), results.end(), pred);
     }
 
-    // Move the best matching DSOs into the vector
-    dsos.reserve(nDSOs);
-    for (const auto& dso : firstDSOs)
-    {
-        dsos.push_back(dso);
-    }
+    return results;
+}
 
-    beginInsertRows(QModelIndex(), 0, dsos.size());
-    endInsertRows();
+
+void DSOTableModel::setResults(unsigned int resultGeneration,
+                               const Vector3d& resultObserverPos,
+                               const vector<DeepSkyObject*>& results)
+{
+    // Drop the results of a search superseded by a later one
+    if (resultGeneration != generation)
+        return;
+
+    beginResetModel();
+    observerPos = resultObserverPos;
+    dsos = results;
+    shownRows = std::min((int) dsos.size(), DSO_FETCH_BATCH_SIZE);
+    endResetModel();
 }
 
 
 DeepSkyObject* DSOTableModel::itemAtRow(unsigned int row) const
 {
-    return row >= dsos.size() ? nullptr : dsos[row];
+    return row >= (unsigned int) shownRows ? nullptr : dsos[row];
 }
 
 
@@ -420,6 +525,13 @@ DeepSkyBrowser::DeepSkyBrowser(CelestiaCore* _appCore, QWidget* parent, InfoPane
     dsoModel = new DSOTableModel(appCore->getSimulation()->getUniverse());
     treeView->setModel(dsoModel);
 
+    connect(dsoModel, &QAbstractItemModel::modelReset, this, [this]()
+    {
+        treeView->resizeColumnToContents(DSOTableModel::DistanceColumn);
+        treeView->resizeColumnToContents(DSOTableModel::AppMagColumn);
+        searchResultLabel->setText(QString(_("%1 objects found")).arg(dsoModel->resultCount()));
+    });
+
     treeView->setContextMenuPolicy(Qt::CustomContextMenu);
     connect(treeView, SIGNAL(customContextMenuRequested(const QPoint&)),
             this, SLOT(slotContextMenu(const QPoint&)));
@@ -578,11 +690,8 @@ void DeepSkyBrowser::slotRefreshTable()
         filterPred.typeFilterEnabled = false;
     }
 
+    // The table and the label are updated when the search completes
     dsoModel->populate(observerPos, filterPred, criterion, MAX_LISTED_DSOS);
-    treeView->resizeColumnToContents(DSOTableModel::DistanceColumn);
-    treeView->resizeColumnToContents(DSOTableModel::AppMagColumn);
-
-    searchResultLabel->setText(QString(_("%1 objects found")).arg(dsoModel->rowCount(QModelIndex())));
 }
 
 
@@ -17,6 +17,8 @@
 #include <QGroupBox>
 #include <QDateEdit>
 #include <QComboBox>
+#include <QDoubleSpinBox>
+#include <QLabel>
 #include <QPushButton>
 #include <QStandardItemModel>
 #include <QMessageBox>
@@ -28,6 +30,7 @@
 #include <cassert>
 #include <celestia/celestiacore.h>
 #include <celestia/eclipsefinder.h>
+#include <celestia/eventfinder.h>
 #include <celmath/distance.h>
 #include <celmath/intersect.h>
 #include <celmath/geomutil.h>
@@ -75,8 +78,10 @@ public:
     void sort(int column, Qt::SortOrder order) override;
 
     void setEclipses(const vector<Eclipse>& _eclipses);
+    void setEvents(const vector<CelestialEvent>& _events);
 
     const Eclipse* eclipseAtIndex(const QModelIndex& index) const;
+    const CelestialEvent* eventAtIndex(const QModelIndex& index) const;
 
     enum
     {
@@ -87,7 +92,13 @@ public:
     };
 
 private:
+    int eventCount() const;
+
     vector<Eclipse> eclipses;
+
+    // Conjunctions, occultations and transits; shown instead of the
+    // eclipses when not empty.
+    vector<CelestialEvent> events;
 };
 
 
@@ -99,7 +110,7 @@ Qt::ItemFlags EventTableModel::flags(const QModelIndex& /*unused*/) const
 
 QVariant EventTableModel::data(const QModelIndex& index, int role) const
 {
-    if (index.row() < 0 || index.row() >= (int) eclipses.size())
+    if (index.row() < 0 || index.row() >= eventCount())
     {
         // Out of range
         return QVariant();
@@ -110,6 +121,27 @@ QVariant EventTableModel::data(const QModelIndex& index, int role) const
         return QVariant();
     }
 
+    if (!events.empty())
+    {
+        const CelestialEvent& event = events[index.row()];
+        switch (index.column())
+        {
+        case ReceiverColumn:
+            return QString(event.back.getName(true).c_str());
+        case OcculterColumn:
+            return QString(event.front.getName(true).c_str());
+        case StartTimeColumn:
+            return TDBToQDate(event.startTime).toLocalTime().toString("dd MMM yyyy hh:mm");
+        case DurationColumn:
+        {
+            int minutes = (int) ((event.endTime - event.startTime) * 24 * 60);
+            return QString("%1:%2").arg(minutes / 60).arg(minutes % 60, 2, 10, QLatin1Char('0'));
+        }
+        default:
+            return QVariant();
+        }
+    }
+
     const Eclipse& eclipse = eclipses[index.row()];
 
     switch (index.column())
@@ -139,9 +171,9 @@ QVariant EventTableModel::headerData(int section, Qt::Orientation /*unused*/, in
     switch (section)
     {
     case 0:
-        return QString(_("Eclipsed body"));
+        return events.empty() ? QString(_("Eclipsed body")) : QString(_("Object"));
     case 1:
-        return QString(_("Occulter"));
+        return events.empty() ? QString(_("Occulter")) : QString(_("Passing object"));
     case 2:
         return QString(_("Start time"));
     case 3:
@@ -154,7 +186,13 @@ QVariant EventTableModel::headerData(int section, Qt::Orientation /*unused*/, in
 
 int EventTableModel::rowCount(const QModelIndex& /*unused*/) const
 {
-    return (int) eclipses.size();
+    return eventCount();
+}
+
+
+int EventTableModel::eventCount() const
+{
+    return events.empty() ? (int) eclipses.size() : (int) events.size();
 }
 
 
@@ -166,6 +204,35 @@ int EventTableModel::columnCount(const QModelIndex& /*unused*/) const
 
 void EventTableModel::sort(int column, Qt::SortOrder order)
 {
+    if (!events.empty())
+    {
+        switch (column)
+        {
+        case ReceiverColumn:
+            std::sort(events.begin(), events.end(),
+                      [](const CelestialEvent& e0, const CelestialEvent& e1) { return e0.back.getName() < e1.back.getName(); });
+            break;
+        case OcculterColumn:
+            std::sort(events.begin(), events.end(),
+                      [](const CelestialEvent& e0, const CelestialEvent& e1) { return e0.front.getName() < e1.front.getName(); });
+            break;
+        case StartTimeColumn:
+            std::sort(events.begin(), events.end(),
+                      [](const CelestialEvent& e0, const CelestialEvent& e1) { return e0.startTime < e1.startTime; });
+            break;
+        case DurationColumn:
+            std::sort(events.begin(), events.end(),
+                      [](const CelestialEvent& e0, const CelestialEvent& e1) { return e0.endTime - e0.startTime < e1.endTime - e1.startTime; });
+            break;
+        }
+
+        if (order == Qt::DescendingOrder)
+            reverse(events.begin(), events.end());
+
+        dataChanged(index(0, 0), index(events.size() - 1, columnCount(QModelIndex())));
+        return;
+    }
+
     switch (column)
     {
     case ReceiverColumn:
@@ -197,6 +264,16 @@ void EventTableModel::setEclipses(const vector<Eclipse>& _eclipses)
 {
     beginResetModel();
     eclipses = _eclipses;
+    events.clear();
+    endResetModel();
+}
+
+
+void EventTableModel::setEvents(const vector<CelestialEvent>& _events)
+{
+    beginResetModel();
+    eclipses.clear();
+    events = _events;
     endResetModel();
 }
 
@@ -204,13 +281,23 @@ void EventTableModel::setEclipses(const vector<Eclipse>& _eclipses)
 const Eclipse* EventTableModel::eclipseAtIndex(const QModelIndex& index) const
 {
     int row = index.row();
-    if (row >= 0 && row < (int) eclipses.size())
+    if (events.empty() && row >= 0 && row < (int) eclipses.size())
         return &eclipses[row];
     else
         return nullptr;
 }
 
 
+const CelestialEvent* EventTableModel::eventAtIndex(const QModelIndex& index) const
+{
+    int row = index.row();
+    if (row >= 0 && row < (int) events.size())
+        return &events[row];
+    else
+        return nullptr;
+}
+
+
 EventFinder::EventFinder(CelestiaCore* _appCore,
                          const QString& title,
                          QWidget* parent) :
@@ -239,10 +326,28 @@ EventFinder::EventFinder(CelestiaCore* _appCore,
     solarOnlyButton = new QRadioButton(_("Solar eclipses"));
     lunarOnlyButton = new QRadioButton(_("Lunar eclipses"));
     allEclipsesButton = new QRadioButton(_("All eclipses"));
+    conjunctionsButton = new QRadioButton(_("Conjunctions"));
+    occultationsButton = new QRadioButton(_("Occultations and transits"));
+
+    // Largest separation of the objects in a conjunction
+    QWidget* separationBox = new QWidget();
+    QHBoxLayout* separationLayout = new QHBoxLayout();
+    separationLayout->setContentsMargins(0, 0, 0, 0);
+    separationEdit = new QDoubleSpinBox();
+    separationEdit->setRange(0.01, 45.0);
+    separationEdit->setDecimals(2);
+    separationEdit->setSuffix(QString(QChar(0x00B0)));
+    separationEdit->setValue(1.0);
+    separationLayout->addWidget(new QLabel(_("Separation:")));
+    separationLayout->addWidget(separationEdit);
+    separationBox->setLayout(separationLayout);
 
     eclipseTypeLayout->addWidget(solarOnlyButton);
     eclipseTypeLayout->addWidget(lunarOnlyButton);
     eclipseTypeLayout->addWidget(allEclipsesButton);
+    eclipseTypeLayout->addWidget(conjunctionsButton);
+    eclipseTypeLayout->addWidget(separationBox);
+    eclipseTypeLayout->addWidget(occultationsButton);
     eclipseTypeBox->setLayout(eclipseTypeLayout);
 
     // Search the search range box
@@ -276,7 +381,7 @@ EventFinder::EventFinder(CelestiaCore* _appCore,
     planetSelect->addItem(_("Pluto"));
     layout->addWidget(planetSelect);
 
-    QPushButton* findButton = new QPushButton(_("Find eclipses"));
+    QPushButton* findButton = new QPushButton(_("Find events"));
     connect(findButton, SIGNAL(clicked()), this, SLOT(slotFindEclipses()));
     layout->addWidget(findButton);
 
@@ -347,12 +452,18 @@ void EventFinder::slotFindEclipses()
         return;
     }
 
-    EclipseFinder finder(obj.body(), this);
-    searchTimer.start();
-
     double startTimeTDB = QDateToTDB(startDate);
     double endTimeTDB = QDateToTDB(endDate);
 
+    if (conjunctionsButton->isChecked() || occultationsButton->isChecked())
+    {
+        findEvents(obj, startTimeTDB, endTimeTDB);
+        return;
+    }
+
+    EclipseFinder finder(obj.body(), this);
+    searchTimer.start();
+
     // Initialize values used by progress bar
     searchSpan = endTimeTDB - startTimeTDB;
     lastProgressUpdate = startTimeTDB;
@@ -378,10 +489,79 @@ void EventFinder::slotFindEclipses()
 }
 
 
+/*! Search for conjunctions or occultations and transits of the sun, moon
+ *  and major planets as seen from the observer.
+ */
+void EventFinder::findEvents(const Selection& observer, double startTimeTDB, double endTimeTDB)
+{
+    static const char* const objectNames[] =
+    {
+        "Sol", "Sol/Mercury", "Sol/Venus", "Sol/Earth", "Sol/Earth/Moon", "Sol/Mars",
+        "Sol/Jupiter", "Sol/Saturn", "Sol/Uranus", "Sol/Neptune", "Sol/Pluto",
+    };
+
+    Simulation* sim = appCore->getSimulation();
+    vector<Selection> objects;
+    for (const char* name : objectNames)
+    {
+        Selection sel = sim->findObjectFromPath(name, true);
+        if (!sel.empty() && sel != observer)
+            objects.push_back(sel);
+    }
+
+    CelestialEventFinder finder(observer, this);
+    searchTimer.start();
+
+    searchSpan = endTimeTDB - startTimeTDB;
+    lastProgressUpdate = startTimeTDB;
+
+    progress = new QProgressDialog(_("Finding events..."), "Abort", (int) startTimeTDB, (int) endTimeTDB, this);
+    progress->setWindowModality(Qt::WindowModal);
+    progress->show();
+
+    vector<CelestialEvent> events;
+    if (conjunctionsButton->isChecked())
+    {
+        finder.findConjunctions(objects, degToRad(separationEdit->value()),
+                                startTimeTDB, endTimeTDB, events);
+    }
+    else
+    {
+        finder.findOccultations(objects, objects,
+                                CelestialEvent::Occultation | CelestialEvent::Transit,
+                                startTimeTDB, endTimeTDB, events);
+    }
+
+    delete progress;
+    progress = nullptr;
+
+    model->setEvents(events);
+
+    eventTable->resizeColumnToContents(EventTableModel::OcculterColumn);
+    eventTable->resizeColumnToContents(EventTableModel::ReceiverColumn);
+    eventTable->resizeColumnToContents(EventTableModel::StartTimeColumn);
+}
+
+
 void EventFinder::slotContextMenu(const QPoint& pos)
 {
     QModelIndex index = eventTable->indexAt(pos);
     activeEclipse = model->eclipseAtIndex(index);
+    activeEvent = model->eventAtIndex(index);
+
+    if (activeEvent != nullptr)
+    {
+        if (contextMenu == nullptr)
+            contextMenu = new QMenu(this);
+        contextMenu->clear();
+
+        QAction* setTimeAction = new QAction(_("Set time to closest approach"), contextMenu);
+        connect(setTimeAction, SIGNAL(triggered()), this, SLOT(slotSetEventTime()));
+        contextMenu->addAction(setTimeAction);
+
+        contextMenu->popup(eventTable->mapToGlobal(pos), setTimeAction);
+        return;
+    }
 
     if (activeEclipse != nullptr)
     {
@@ -421,6 +601,12 @@ void EventFinder::slotSetEclipseTime()
 }
 
 
+void EventFinder::slotSetEventTime()
+{
+    appCore->getSimulation()->setTime(activeEvent->maximumTime);
+}
+
+
 // Find the point of maximum eclipse, either the intersection of the eclipsed body with the
 // ray from sun to occluder, or the nearest point to that ray if there is no intersection.
 // The returned point is relative to the center of the eclipsed body. Note that this function
@@ -16,11 +16,13 @@
 #include <QDockWidget>
 #include <QElapsedTimer>
 #include <celestia/eclipsefinder.h>
+#include <celestia/eventfinder.h>
 
 class QTreeView;
 class QRadioButton;
 class QDateEdit;
 class QComboBox;
+class QDoubleSpinBox;
 class QProgressDialog;
 class QMenu;
 class EventTableModel;
@@ -41,17 +43,24 @@ class EventFinder : public QDockWidget, EclipseFinderWatcher
     void slotContextMenu(const QPoint&);
 
     void slotSetEclipseTime();
+    void slotSetEventTime();
     void slotViewNearEclipsed();
     void slotViewEclipsedSurface();
     void slotViewOccluderSurface();
     void slotViewBehindOccluder();
 
  private:
+    void findEvents(const Selection& observer, double startTimeTDB, double endTimeTDB);
+
     CelestiaCore* appCore;
 
     QRadioButton* solarOnlyButton{ nullptr };
     QRadioButton* lunarOnlyButton{ nullptr };
     QRadioButton* allEclipsesButton{ nullptr };
+    QRadioButton* conjunctionsButton{ nullptr };
+    QRadioButton* occultationsButton{ nullptr };
+
+    QDoubleSpinBox* separationEdit{ nullptr };
 
     QDateEdit* startDateEdit{ nullptr };
     QDateEdit* endDateEdit{ nullptr };
@@ -69,6 +78,7 @@ class EventFinder : public QDockWidget, EclipseFinderWatcher
     QElapsedTimer searchTimer;
 
     const Eclipse* activeEclipse{ nullptr };
+    const CelestialEvent* activeEvent{ nullptr };
 };
 
 #endif // _QTEVENTFINDER_H_
@@ -25,6 +25,7 @@
 #include <QMouseEvent>
 #include <QSettings>
 #include <QMessageBox>
+#include <QThread>
 
 #ifndef DEBUG
 #  define G_DISABLE_ASSERT
@@ -37,6 +38,7 @@
 #include "celengine/simulation.h"
 
 #include "qtglwidget.h"
+#include "qtrenderthread.h"
 
 #include <cmath>
 #include <vector>
@@ -76,6 +78,12 @@ CelestiaGlWidget::CelestiaGlWidget(QWidget* parent, const char* /* name */, Cele
 }
 
 
+CelestiaGlWidget::~CelestiaGlWidget()
+{
+    stopRenderThread();
+}
+
+
 /*!
   Paint the box. The actual openGL commands for drawing the box are
   performed here.
@@ -83,10 +91,26 @@ CelestiaGlWidget::CelestiaGlWidget(QWidget* parent, const char* /* name */, Cele
 
 void CelestiaGlWidget::paintGL()
 {
+    // With a render thread, the frame is only drawn here when grabbing the
+    // framebuffer, while the GUI thread owns the core
+    if (renderThread != nullptr && !renderThread->guiOwnsCore())
+        return;
+
+    // Besides the updates requested by the main window, Qt repaints the
+    // widget on its own, and then the frame has to be drawn
+    appCore->setViewChanged();
     appCore->draw();
 }
 
 
+void CelestiaGlWidget::paintEvent(QPaintEvent* e)
+{
+    // The render thread draws the frames and requests their composition
+    if (renderThread == nullptr)
+        QOpenGLWidget::paintEvent(e);
+}
+
+
 /*!
   Set up the OpenGL rendering state, and define display list
 */
@@ -128,6 +152,26 @@ void CelestiaGlWidget::initializeGL()
 
     appRenderer->setSolarSystemMaxDistance(appCore->getConfig()->SolarSystemMaxDistance);
     appRenderer->setShadowMapSize(appCore->getConfig()->ShadowMapSize);
+    appRenderer->setGPUStarField(appCore->getConfig()->gpuStarField);
+    appRenderer->setGPUOrbits(appCore->getConfig()->gpuOrbits);
+    appRenderer->setModelInstancing(appCore->getConfig()->modelInstancing);
+    appRenderer->setDSOImpostors(appCore->getConfig()->dsoImpostors);
+    appRenderer->setLabelDeclutter(appCore->getConfig()->labelDeclutter);
+
+    if (threadedRendering && renderThread == nullptr)
+    {
+        renderThread = std::make_unique<CelestiaRenderThread>(this, appCore);
+        renderThread->setFrameInterval(frameInterval);
+        // Qt uses the framebuffer of the widget when composing and resizing it
+        auto waitForFrame = [this]
+        {
+            if (renderThread != nullptr)
+                renderThread->waitForFrame();
+        };
+        connect(this, &QOpenGLWidget::aboutToCompose, this, waitForFrame);
+        connect(this, &QOpenGLWidget::aboutToResize, this, waitForFrame);
+        renderThread->start();
+    }
 }
 
 
@@ -136,7 +180,36 @@ void CelestiaGlWidget::resizeGL(int w, int h)
     qreal scale = devicePixelRatioF();
     auto width = static_cast<int>(w * scale);
     auto height = static_cast<int>(h * scale);
-    appCore->resize(width, height);
+    runOnCore([width, height](CelestiaCore* core) { core->resize(width, height); });
+}
+
+
+void CelestiaGlWidget::setThreadedRendering(bool threaded)
+{
+    threadedRendering = threaded;
+}
+
+
+void CelestiaGlWidget::setFrameInterval(int ms)
+{
+    frameInterval = ms;
+    if (renderThread != nullptr)
+        renderThread->setFrameInterval(ms);
+}
+
+
+void CelestiaGlWidget::stopRenderThread()
+{
+    renderThread = nullptr;
+}
+
+
+void CelestiaGlWidget::runOnCore(std::function<void(CelestiaCore*)>&& f)
+{
+    if (renderThread != nullptr)
+        renderThread->post(std::move(f));
+    else
+        f(appCore);
 }
 
 
@@ -189,12 +262,14 @@ void CelestiaGlWidget::mouseMoveEvent(QMouseEvent* m)
         }
 
         // Calculate mouse delta from local coordinate then move it back to the saved location
-        appCore->mouseMove((m->x() - saveLocalCursorPos.rx()) * scale, (m->y() - saveLocalCursorPos.ry()) * scale, buttons);
+        float dx = (m->x() - saveLocalCursorPos.rx()) * scale;
+        float dy = (m->y() - saveLocalCursorPos.ry()) * scale;
+        runOnCore([dx, dy, buttons](CelestiaCore* core) { core->mouseMove(dx, dy, buttons); });
         QCursor::setPos(saveGlobalCursorPos);
     }
     else
     {
-        appCore->mouseMove(x, y);
+        runOnCore([x, y](CelestiaCore* core) { core->mouseMove(x, y); });
     }
 }
 
@@ -205,12 +280,16 @@ void CelestiaGlWidget::mousePressEvent( QMouseEvent* m )
     auto x = static_cast<int>(m->x() * scale);
     auto y = static_cast<int>(m->y() * scale);
 
+    int button;
     if (m->button() == LeftButton)
-        appCore->mouseButtonDown(x, y, CelestiaCore::LeftButton);
+        button = CelestiaCore::LeftButton;
     else if (m->button() == MiddleButton)
-        appCore->mouseButtonDown(x, y, CelestiaCore::MiddleButton);
+        button = CelestiaCore::MiddleButton;
     else if (m->button() == RightButton)
-        appCore->mouseButtonDown(x, y, CelestiaCore::RightButton);
+        button = CelestiaCore::RightButton;
+    else
+        return;
+    runOnCore([x, y, button](CelestiaCore* core) { core->mouseButtonDown(x, y, button); });
 }
 
 
@@ -229,11 +308,11 @@ void CelestiaGlWidget::mouseReleaseEvent( QMouseEvent* m )
             cursorVisible = true;
             QCursor::setPos(saveGlobalCursorPos);
         }
-        appCore->mouseButtonUp(x, y, CelestiaCore::LeftButton);
+        runOnCore([x, y](CelestiaCore* core) { core->mouseButtonUp(x, y, CelestiaCore::LeftButton); });
     }
     else if (m->button() == MiddleButton)
     {
-        appCore->mouseButtonUp(x, y, CelestiaCore::MiddleButton);
+        runOnCore([x, y](CelestiaCore* core) { core->mouseButtonUp(x, y, CelestiaCore::MiddleButton); });
     }
     else if (m->button() == RightButton)
     {
@@ -244,7 +323,7 @@ void CelestiaGlWidget::mouseReleaseEvent( QMouseEvent* m )
             cursorVisible = true;
             QCursor::setPos(saveGlobalCursorPos);
         }
-        appCore->mouseButtonUp(x, y, CelestiaCore::RightButton);
+        runOnCore([x, y](CelestiaCore* core) { core->mouseButtonUp(x, y, CelestiaCore::RightButton); });
     }
 }
 
@@ -257,11 +336,11 @@ void CelestiaGlWidget::wheelEvent( QWheelEvent* w )
 
     if (numDegrees.y() > 0 )
     {
-        appCore->mouseWheel(-1.0f, 0);
+        runOnCore([](CelestiaCore* core) { core->mouseWheel(-1.0f, 0); });
     }
     else
     {
-        appCore->mouseWheel(1.0f, 0);
+        runOnCore([](CelestiaCore* core) { core->mouseWheel(1.0f, 0); });
     }
 }
 
@@ -383,9 +462,9 @@ bool CelestiaGlWidget::handleSpecialKey(QKeyEvent* e, bool down)
             buttons |= CelestiaCore::ShiftKey;
 
         if (down)
-            appCore->keyDown(k, buttons);
+            runOnCore([k, buttons](CelestiaCore* core) { core->keyDown(k, buttons); });
         else
-            appCore->keyUp(k);
+            runOnCore([k](CelestiaCore* core) { core->keyUp(k); });
         return (k < 'A' || k > 'Z');
     }
 
@@ -404,10 +483,10 @@ void CelestiaGlWidget::keyPressEvent( QKeyEvent* e )
     switch (e->key())
     {
     case Key_Escape:
-        appCore->charEntered('\033');
+        runOnCore([](CelestiaCore* core) { core->charEntered('\033'); });
         break;
     case Key_Backtab:
-        appCore->charEntered(CelestiaCore::Key_BackTab);
+        runOnCore([](CelestiaCore* core) { core->charEntered(CelestiaCore::Key_BackTab); });
         break;
     default:
         if (!handleSpecialKey(e, true))
@@ -426,7 +505,8 @@ void CelestiaGlWidget::keyPressEvent( QKeyEvent* e )
                         input.replace(0, 1, QChar((uint16_t)0x7f) /* NSDeleteCharacter */);
                 }
 #endif
-                appCore->charEntered(input.toUtf8().data(), modifiers);
+                std::string text = input.toStdString();
+                runOnCore([text, modifiers](CelestiaCore* core) { core->charEntered(text.c_str(), modifiers); });
             }
         }
     }
@@ -441,6 +521,13 @@ void CelestiaGlWidget::keyReleaseEvent( QKeyEvent* e )
 
 void CelestiaGlWidget::setCursorShape(CelestiaCore::CursorShape shape)
 {
+    // The core calls back from the render thread
+    if (QThread::currentThread() != thread())
+    {
+        QMetaObject::invokeMethod(this, [this, shape] { setCursorShape(shape); }, Qt::QueuedConnection);
+        return;
+    }
+
     Qt::CursorShape cursor;
     if (currentCursor != shape)
     {
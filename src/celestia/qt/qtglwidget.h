@@ -19,9 +19,14 @@
 #include "celestia/celestiacore.h"
 #include "celengine/simulation.h"
 #include <celengine/starbrowser.h>
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
+class CelestiaRenderThread;
+
 /**
   *@author Christophe Teyssier
   */
@@ -32,14 +37,22 @@ class CelestiaGlWidget : public QOpenGLWidget, public CelestiaCore::CursorHandle
 
 public:
     CelestiaGlWidget(QWidget* parent, const char* name, CelestiaCore* core);
-    ~CelestiaGlWidget() = default;
+    ~CelestiaGlWidget();
 
     void setCursorShape(CelestiaCore::CursorShape);
     CelestiaCore::CursorShape getCursorShape() const;
 
+    // Tick and draw on a render thread once the widget is initialized
+    void setThreadedRendering(bool);
+    bool isThreadedRendering() const { return threadedRendering; }
+    // Minimum interval between the frames of the render thread
+    void setFrameInterval(int ms);
+    void stopRenderThread();
+
 protected:
     void initializeGL();
     void paintGL();
+    void paintEvent(QPaintEvent* e);
     void resizeGL( int w, int h );
     virtual void mouseMoveEvent(QMouseEvent* m );
     virtual void mousePressEvent(QMouseEvent* m );
@@ -48,6 +61,8 @@ protected:
     virtual void keyPressEvent(QKeyEvent* e );
     virtual void keyReleaseEvent(QKeyEvent* e );
     bool handleSpecialKey(QKeyEvent* e, bool down);
+    // Handle input with the core, on the render thread if there's one
+    void runOnCore(std::function<void(CelestiaCore*)>&& f);
 
     virtual QSize sizeHint() const;
 
@@ -61,7 +76,11 @@ private:
     bool cursorVisible;
     QPoint saveGlobalCursorPos;
     QPoint saveLocalCursorPos;
-    CelestiaCore::CursorShape currentCursor;
+    std::atomic<CelestiaCore::CursorShape> currentCursor;
+
+    bool threadedRendering{ false };
+    int frameInterval{ 0 };
+    std::unique_ptr<CelestiaRenderThread> renderThread;
 
     //KActionCollection* actionColl;
 
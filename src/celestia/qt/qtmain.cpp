@@ -28,6 +28,7 @@
 #include <QLibraryInfo>
 #include <vector>
 #include "qtappwin.h"
+#include "qtrenderthread.h"
 #include <fmt/printf.h>
 
 using namespace std;
@@ -45,9 +46,37 @@ static QStringList extrasDirectories;
 static QString configFileName;
 static bool useAlternateConfigFile = false;
 static bool skipSplashScreen = false;
+static bool startupReport = false;
+static bool threadedRendering = false;
 
 static bool ParseCommandLine();
 
+
+// With a render thread, the GUI thread owns the core while it handles
+// events which may use it
+class CelestiaApplication : public QApplication
+{
+public:
+    CelestiaApplication(int& argc, char** argv) :
+        QApplication(argc, argv)
+    {
+    }
+
+    bool notify(QObject* receiver, QEvent* event) override
+    {
+        CelestiaRenderThread* renderThread = CelestiaRenderThread::current();
+        if (renderThread == nullptr || !renderThread->needsCore(receiver, event))
+            return QApplication::notify(receiver, event);
+
+        renderThread->lockCore();
+        bool result = QApplication::notify(receiver, event);
+        // The render thread may have stopped while handling the event
+        if (CelestiaRenderThread::current() == renderThread)
+            renderThread->unlockCore();
+        return result;
+    }
+};
+
 int main(int argc, char *argv[])
 {
 #ifndef GL_ES
@@ -55,7 +84,7 @@ int main(int argc, char *argv[])
 #else
     QCoreApplication::setAttribute(Qt::AA_UseOpenGLES);
 #endif
-    QApplication app(argc, argv);
+    CelestiaApplication app(argc, argv);
 
     QTranslator qtTranslator;
     qtTranslator.load("qt_" + QLocale::system().name(),
@@ -111,7 +140,7 @@ int main(int argc, char *argv[])
     QObject::connect(&window, SIGNAL(progressUpdate(const QString&, int, const QColor&)),
                      &splash, SLOT(showMessage(const QString&, int, const QColor&)));
 
-    window.init(configFileName, extrasDirectories, logFilename);
+    window.init(configFileName, extrasDirectories, logFilename, startupReport, threadedRendering);
     window.show();
 
     splash.finish(&window);
@@ -201,6 +230,14 @@ bool ParseCommandLine()
         {
             skipSplashScreen = true;
         }
+        else if (args.at(i) == "--startup-report")
+        {
+            startupReport = true;
+        }
+        else if (args.at(i) == "--render-thread")
+        {
+            threadedRendering = true;
+        }
         else if (args.at(i) == "-l" || args.at(i) == "--log")
         {
             if (isLastArg)
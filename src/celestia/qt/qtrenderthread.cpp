@@ -0,0 +1,306 @@
+// qtrenderthread.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Render thread of the threaded rendering mode of the Qt front end.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+
+#include <QAbstractEventDispatcher>
+#include <QCoreApplication>
+#include <QEvent>
+#include <QOpenGLContext>
+#include <QOpenGLWidget>
+
+#include "celestia/celestiacore.h"
+#include "qtrenderthread.h"
+
+namespace
+{
+CelestiaRenderThread* currentThread = nullptr;
+}
+
+
+CelestiaRenderThread::CelestiaRenderThread(QOpenGLWidget* _widget, CelestiaCore* core) :
+    widget(_widget),
+    appCore(core)
+{
+    currentThread = this;
+
+    QAbstractEventDispatcher* dispatcher = QAbstractEventDispatcher::instance(QCoreApplication::instance()->thread());
+    connect(dispatcher, SIGNAL(aboutToBlock()), this, SLOT(suspendCore()));
+    connect(dispatcher, SIGNAL(awake()), this, SLOT(resumeCore()));
+}
+
+
+CelestiaRenderThread::~CelestiaRenderThread()
+{
+    stop();
+    if (currentThread == this)
+        currentThread = nullptr;
+}
+
+
+CelestiaRenderThread* CelestiaRenderThread::current()
+{
+    return currentThread;
+}
+
+
+void CelestiaRenderThread::post(std::function<void(CelestiaCore*)>&& f)
+{
+    Lock lock(mutex);
+    input.push_back(std::move(f));
+    changed.notify_all();
+}
+
+
+void CelestiaRenderThread::setFrameInterval(int ms)
+{
+    Lock lock(mutex);
+    frameInterval = std::chrono::milliseconds(std::max(ms, 0));
+}
+
+
+void CelestiaRenderThread::stop()
+{
+    {
+        Lock lock(mutex);
+        exiting = true;
+        changed.notify_all();
+    }
+    wait();
+}
+
+
+bool CelestiaRenderThread::needsCore(const QObject* receiver, const QEvent* event) const
+{
+    if (QThread::currentThread() != QCoreApplication::instance()->thread())
+        return false;
+
+    // The widget only forwards input, and windows pass their events on to
+    // their widgets
+    if (receiver == widget || receiver == this || receiver->isWindowType())
+        return false;
+
+    switch (event->type())
+    {
+    case QEvent::Paint:
+    case QEvent::UpdateRequest:
+    case QEvent::UpdateLater:
+    case QEvent::LayoutRequest:
+    case QEvent::Move:
+    case QEvent::Resize:
+    case QEvent::Show:
+    case QEvent::Hide:
+    case QEvent::ShowToParent:
+    case QEvent::HideToParent:
+    case QEvent::Polish:
+    case QEvent::PolishRequest:
+    case QEvent::Enter:
+    case QEvent::Leave:
+    case QEvent::HoverEnter:
+    case QEvent::HoverLeave:
+    case QEvent::HoverMove:
+    case QEvent::DeferredDelete:
+        return false;
+    default:
+        return true;
+    }
+}
+
+
+void CelestiaRenderThread::lockCore()
+{
+    if (guiDepth++ == 0 || guiSuspended)
+        acquireOnGuiThread();
+}
+
+
+void CelestiaRenderThread::unlockCore()
+{
+    if (--guiDepth > 0)
+        return;
+
+    if (guiSuspended)
+        guiSuspended = false;
+    else
+        releaseOnGuiThread();
+}
+
+
+bool CelestiaRenderThread::guiOwnsCore()
+{
+    Lock lock(mutex);
+    return owner == Owner::Gui;
+}
+
+
+void CelestiaRenderThread::waitForFrame()
+{
+    Lock lock(mutex);
+    waitOnGuiThread(lock, [this] { return !drawing; });
+}
+
+
+void CelestiaRenderThread::run()
+{
+    using Clock = std::chrono::steady_clock;
+
+    for (;;)
+    {
+        if (!acquireOnRenderThread())
+            break;
+
+        std::vector<std::function<void(CelestiaCore*)>> pending;
+        {
+            Lock lock(mutex);
+            pending.swap(input);
+        }
+        for (const auto& f : pending)
+            f(appCore);
+
+        appCore->tick();
+        if (appCore->viewUpdateRequired())
+            drawFrame();
+
+        auto idleDelay = std::chrono::milliseconds(static_cast<int>(appCore->getFrameDelay() * 1000.0));
+        releaseOnRenderThread();
+
+        // Tick at most at the frame rate, and sooner than the idle rate
+        // when there's input
+        auto tickTime = Clock::now();
+        Lock lock(mutex);
+        changed.wait_until(lock, tickTime + frameInterval, [this] { return exiting; });
+        changed.wait_until(lock, tickTime + std::max(idleDelay, frameInterval),
+                           [this] { return exiting || !input.empty(); });
+        if (exiting)
+            break;
+    }
+}
+
+
+void CelestiaRenderThread::grabContext()
+{
+    Lock lock(mutex);
+    if (contextWanted)
+        handOverContext();
+}
+
+
+void CelestiaRenderThread::suspendCore()
+{
+    // A nested event loop blocks while an event is handled
+    if (guiDepth > 0 && !guiSuspended)
+    {
+        releaseOnGuiThread();
+        guiSuspended = true;
+    }
+}
+
+
+void CelestiaRenderThread::resumeCore()
+{
+    if (guiSuspended)
+        acquireOnGuiThread();
+}
+
+
+// Wait on the GUI thread, handing the context over to the render thread
+// when it asks for it, so that it can finish its frame
+template<typename Predicate> void
+CelestiaRenderThread::waitOnGuiThread(Lock& lock, Predicate predicate)
+{
+    while (!predicate())
+    {
+        if (contextWanted)
+            handOverContext();
+        else
+            changed.wait(lock);
+    }
+}
+
+
+void CelestiaRenderThread::handOverContext()
+{
+    if (QOpenGLContext::currentContext() == widget->context())
+        widget->doneCurrent();
+    widget->context()->moveToThread(this);
+    contextWanted = false;
+    drawing = true;
+    changed.notify_all();
+}
+
+
+void CelestiaRenderThread::acquireOnGuiThread()
+{
+    Lock lock(mutex);
+    guiWaiting++;
+    waitOnGuiThread(lock, [this] { return owner == Owner::None; });
+    guiWaiting--;
+    owner = Owner::Gui;
+    guiSuspended = false;
+}
+
+
+void CelestiaRenderThread::releaseOnGuiThread()
+{
+    Lock lock(mutex);
+    owner = Owner::None;
+    changed.notify_all();
+}
+
+
+bool CelestiaRenderThread::acquireOnRenderThread()
+{
+    // The GUI thread waiting for the core goes first
+    Lock lock(mutex);
+    changed.wait(lock, [this] { return exiting || (owner == Owner::None && guiWaiting == 0); });
+    if (exiting)
+        return false;
+    owner = Owner::Render;
+    return true;
+}
+
+
+void CelestiaRenderThread::releaseOnRenderThread()
+{
+    Lock lock(mutex);
+    owner = Owner::None;
+    changed.notify_all();
+}
+
+
+void CelestiaRenderThread::drawFrame()
+{
+    {
+        Lock lock(mutex);
+        contextWanted = true;
+        QMetaObject::invokeMethod(this, "grabContext", Qt::QueuedConnection);
+        changed.wait(lock, [this] { return drawing || exiting; });
+        if (!drawing)
+        {
+            contextWanted = false;
+            return;
+        }
+    }
+
+    widget->makeCurrent();
+    appCore->draw();
+    widget->doneCurrent();
+    widget->context()->moveToThread(QCoreApplication::instance()->thread());
+
+    {
+        Lock lock(mutex);
+        drawing = false;
+        changed.notify_all();
+    }
+
+    // Compose the frame on the GUI thread
+    QMetaObject::invokeMethod(widget, "update", Qt::QueuedConnection);
+}
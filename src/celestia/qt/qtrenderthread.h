@@ -0,0 +1,112 @@
+// qtrenderthread.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Render thread of the threaded rendering mode of the Qt front end.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <QThread>
+
+class CelestiaCore;
+class QEvent;
+class QOpenGLWidget;
+
+/**
+ * The render thread runs the loop of the core, ticking it and drawing its
+ * frames into the framebuffer of the GL widget, so that the user interface
+ * and rendering don't wait for each other.
+ *
+ * Input of the GL widget is forwarded to the render thread through a queue
+ * and handled before the next tick. The rest of the user interface still
+ * uses the core directly, so the core is owned by one thread at a time:
+ * the GUI thread owns it while it handles events which may use it, and
+ * gives it back whenever its event loop blocks; the render thread owns it
+ * for a tick and the frame drawn after it.
+ *
+ * To draw a frame, the render thread asks the GUI thread for the context
+ * of the widget, and gives it back before the widget is composed.
+ */
+class CelestiaRenderThread : public QThread
+{
+    Q_OBJECT
+
+ public:
+    CelestiaRenderThread(QOpenGLWidget* widget, CelestiaCore* core);
+    ~CelestiaRenderThread() override;
+
+    // The render thread running, if any
+    static CelestiaRenderThread* current();
+
+    // Run f with the core on the render thread before its next tick
+    void post(std::function<void(CelestiaCore*)>&& f);
+    // Minimum interval between ticks in milliseconds
+    void setFrameInterval(int ms);
+    void stop();
+
+    // GUI thread: whether the handling of event by receiver may use the core
+    bool needsCore(const QObject* receiver, const QEvent* event) const;
+    // GUI thread: take and give back the core around the handling of an
+    // event; the calls may be nested
+    void lockCore();
+    void unlockCore();
+    bool guiOwnsCore();
+    // GUI thread: wait for the frame being drawn, before the framebuffer
+    // of the widget is used
+    void waitForFrame();
+
+ protected:
+    void run() override;
+
+ private slots:
+    void grabContext();
+    void suspendCore();
+    void resumeCore();
+
+ private:
+    enum class Owner
+    {
+        None,
+        Gui,
+        Render,
+    };
+
+    using Lock = std::unique_lock<std::mutex>;
+
+    template<typename Predicate> void waitOnGuiThread(Lock& lock, Predicate predicate);
+    void handOverContext();
+    void acquireOnGuiThread();
+    void releaseOnGuiThread();
+    bool acquireOnRenderThread();
+    void releaseOnRenderThread();
+    void drawFrame();
+
+    QOpenGLWidget* widget;
+    CelestiaCore* appCore;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    Owner owner{ Owner::None };
+    // Nesting of the events handled by the GUI thread while owning the core
+    int guiDepth{ 0 };
+    // The GUI thread gave the core back while handling an event, as its
+    // event loop blocked in a nested loop
+    bool guiSuspended{ false };
+    int guiWaiting{ 0 };
+    bool contextWanted{ false };
+    bool drawing{ false };
+    bool exiting{ false };
+    std::vector<std::function<void(CelestiaCore*)>> input;
+    std::chrono::milliseconds frameInterval{ 0 };
+};
@@ -26,6 +26,8 @@
 #include <QCheckBox>
 #include <QComboBox>
 #include <QLabel>
+#include <algorithm>
+#include <memory>
 #include <vector>
 #ifdef TEST_MODEL
 #include <QAbstractItemModelTester>
@@ -51,6 +53,9 @@ public:
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
     int rowCount(const QModelIndex& index) const override;
     int columnCount(const QModelIndex& index) const override;
+    bool hasChildren(const QModelIndex& parent) const override;
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
     void sort(int column, Qt::SortOrder order) override;
     QModelIndex sibling(int row, int column, const QModelIndex &index) const override;
 
@@ -66,56 +71,57 @@ public:
     void buildModel(Star* star, bool _groupByClass, int _bodyFilter);
 
 private:
+    // An object or a group of bodies to be shown as a child of a tree item
+    struct ChildInfo
+    {
+        Selection obj;
+        int classification{0};
+        vector<Body*> members;
+    };
+
     class TreeItem
     {
     public:
-        TreeItem() = default;
-        ~TreeItem();
-
         Selection obj;
         TreeItem* parent{nullptr};
-        TreeItem** children{nullptr};
-        int nChildren{0};
+        // Children are listed in pending when the item is first expanded
+        // and created from it in batches, as the view asks for more rows.
+        vector<unique_ptr<TreeItem>> children;
+        vector<ChildInfo> pending;
+        bool populated{false};
         int childIndex{0};
         int classification{0};
+        // Bodies of a group item
+        vector<Body*> members;
     };
 
-    TreeItem* createTreeItem(Selection sel, TreeItem* parent, int childIndex);
-    void addTreeItemChildren(TreeItem* item,
+    // Number of tree items created at a time by fetchMore()
+    static constexpr int FetchBatchSize = 1000;
+
+    unique_ptr<TreeItem> createTreeItem(const ChildInfo& info, TreeItem* parent, int childIndex);
+    void populate(TreeItem* item);
+    bool mayHaveChildren(const TreeItem* item) const;
+    PlanetarySystem* childSystem(Selection sel, const vector<Star*>** orbitingStars) const;
+    void listChildren(TreeItem* item,
+                      PlanetarySystem* sys,
+                      const vector<Star*>* orbitingStars) const;
+    void listChildrenFiltered(TreeItem* item,
+                              PlanetarySystem* sys) const;
+    void listChildrenGrouped(TreeItem* item,
                              PlanetarySystem* sys,
-                             const vector<Star*>* orbitingStars);
-    void addTreeItemChildrenFiltered(TreeItem* item,
-                                     PlanetarySystem* sys);
-    void addTreeItemChildrenGrouped(TreeItem* item,
-                                    PlanetarySystem* sys,
-                                    const vector<Star*>* orbitingStars,
-                                    Selection parent);
-    TreeItem* createGroupTreeItem(int classification,
-                                  const vector<Body*>& objects,
-                                  TreeItem* parent,
-                                  int childIndex);
+                             const vector<Star*>* orbitingStars,
+                             Selection parent) const;
 
     TreeItem* itemAtIndex(const QModelIndex& index) const;
 
 private:
     const Universe* universe{nullptr};
-    TreeItem* rootItem{nullptr};
+    unique_ptr<TreeItem> rootItem;
     bool groupByClass{false};
     int bodyFilter{0};
 };
 
 
-SolarSystemTreeModel::TreeItem::~TreeItem()
-{
-    if (children != nullptr)
-    {
-        for (int i = 0; i < nChildren; i++)
-            delete children[i];
-        delete[] children;
-    }
-}
-
-
 SolarSystemTreeModel::SolarSystemTreeModel(const Universe* _universe) :
     universe(_universe)
 {
@@ -124,24 +130,25 @@ SolarSystemTreeModel::SolarSystemTreeModel(const Universe* _universe) :
 }
 
 
-// Call createTreeItem() to build the parallel tree structure
+// Create the root of the tree; the rest of it is built by fetchMore() as
+// the items are expanded, so that systems with thousands of small bodies
+// don't have to be walked in full before the browser is shown.
 void SolarSystemTreeModel::buildModel(Star* star, bool _groupByClass, int _bodyFilter)
 {
     beginResetModel();
     groupByClass = _groupByClass;
     bodyFilter = _bodyFilter;
 
-    if (rootItem != nullptr)
-        delete rootItem;
-
-    rootItem = new TreeItem();
+    rootItem = make_unique<TreeItem>();
     rootItem->obj = Selection();
+    rootItem->populated = true;
 
     if (star != nullptr)
     {
-        rootItem->nChildren = 1;
-        rootItem->children = new TreeItem*[1];
-        rootItem->children[0] = createTreeItem(Selection(star), rootItem, 0);
+        ChildInfo info;
+        info.obj = Selection(star);
+        rootItem->pending.push_back(info);
+        rootItem->children.push_back(createTreeItem(info, rootItem.get(), 0));
     }
 
     endResetModel();
@@ -156,116 +163,157 @@ void SolarSystemTreeModel::buildModel(Star* star, bool _groupByClass, int _bodyF
 // their classification. It also simplifies the code because stars
 // and solar system bodies can be treated almost identically once
 // the new tree is built.
-SolarSystemTreeModel::TreeItem*
-SolarSystemTreeModel::createTreeItem(Selection sel,
+unique_ptr<SolarSystemTreeModel::TreeItem>
+SolarSystemTreeModel::createTreeItem(const ChildInfo& info,
                                      TreeItem* parent,
                                      int childIndex)
 {
-    auto* item = new TreeItem();
+    auto item = make_unique<TreeItem>();
     item->parent = parent;
-    item->obj = sel;
+    item->obj = info.obj;
     item->childIndex = childIndex;
+    item->classification = info.classification;
+    item->members = info.members;
+
+    return item;
+}
 
-    const vector<Star*>* orbitingStars = nullptr;
 
-    PlanetarySystem* sys = nullptr;
+PlanetarySystem*
+SolarSystemTreeModel::childSystem(Selection sel, const vector<Star*>** orbitingStars) const
+{
+    *orbitingStars = nullptr;
+
     if (sel.body() != nullptr)
-    {
-        sys = sel.body()->getSatellites();
-    }
-    else if (sel.star() != nullptr)
+        return sel.body()->getSatellites();
+
+    if (sel.star() != nullptr)
     {
         // Stars may have both a solar system and other stars orbiting
         // them.
+        *orbitingStars = sel.star()->getOrbitingStars();
+
         SolarSystemCatalog* solarSystems = universe->getSolarSystemCatalog();
         auto iter = solarSystems->find(sel.star()->getIndex());
         if (iter != solarSystems->end())
+            return iter->second->getPlanets();
+    }
+
+    return nullptr;
+}
+
+
+// List the children of an item without creating their tree items
+void
+SolarSystemTreeModel::populate(TreeItem* item)
+{
+    if (item->populated)
+        return;
+
+    item->populated = true;
+
+    if (item->classification != 0)
+    {
+        for (Body* body : item->members)
         {
-            sys = iter->second->getPlanets();
+            ChildInfo info;
+            info.obj = Selection(body);
+            item->pending.push_back(info);
         }
-
-        orbitingStars = sel.star()->getOrbitingStars();
+        return;
     }
 
+    const vector<Star*>* orbitingStars;
+    PlanetarySystem* sys = childSystem(item->obj, &orbitingStars);
+
     if (groupByClass && sys != nullptr)
-        addTreeItemChildrenGrouped(item, sys, orbitingStars, sel);
+        listChildrenGrouped(item, sys, orbitingStars, item->obj);
     else if (bodyFilter != 0 && sys != nullptr)
-        addTreeItemChildrenFiltered(item, sys);
+        listChildrenFiltered(item, sys);
     else
-        addTreeItemChildren(item, sys, orbitingStars);
+        listChildren(item, sys, orbitingStars);
+}
 
-    return item;
+
+// Check whether an item which hasn't been populated yet will have any
+// children, without listing them.
+bool
+SolarSystemTreeModel::mayHaveChildren(const TreeItem* item) const
+{
+    if (item->classification != 0)
+        return !item->members.empty();
+
+    const vector<Star*>* orbitingStars;
+    PlanetarySystem* sys = childSystem(item->obj, &orbitingStars);
+
+    if (orbitingStars != nullptr && !orbitingStars->empty() && (groupByClass || bodyFilter == 0 || sys == nullptr))
+        return true;
+    if (sys == nullptr)
+        return false;
+    if (groupByClass || bodyFilter == 0)
+        return sys->getSystemSize() != 0;
+
+    for (int i = 0; i < sys->getSystemSize(); i++)
+    {
+        if ((bodyFilter & sys->getBody(i)->getClassification()) != 0)
+            return true;
+    }
+
+    return false;
 }
 
 
 void
-SolarSystemTreeModel::addTreeItemChildren(TreeItem* item,
-                                          PlanetarySystem* sys,
-                                          const vector<Star*>* orbitingStars)
+SolarSystemTreeModel::listChildren(TreeItem* item,
+                                   PlanetarySystem* sys,
+                                   const vector<Star*>* orbitingStars) const
 {
-    // Calculate the number of children: the number of orbiting stars plus
-    // the number of orbiting solar system bodies.
-    item->nChildren = 0;
+    // The children are the orbiting stars followed by the orbiting
+    // solar system bodies.
+    size_t nChildren = 0;
     if (orbitingStars != nullptr)
-        item->nChildren += orbitingStars->size();
+        nChildren += orbitingStars->size();
     if (sys != nullptr)
-        item->nChildren += sys->getSystemSize();
+        nChildren += sys->getSystemSize();
+    item->pending.reserve(nChildren);
 
-    if (item->nChildren != 0)
+    // Add the stars
+    if (orbitingStars != nullptr)
     {
-        int childIndex = 0;
-        item->children = new TreeItem*[item->nChildren];
-
-        // Add the stars
-        if (orbitingStars != nullptr)
+        for (Star* star : *orbitingStars)
         {
-            for (unsigned int i = 0; i < orbitingStars->size(); i++)
-            {
-                Selection child(orbitingStars->at(i));
-                item->children[childIndex] = createTreeItem(child, item, childIndex);
-                childIndex++;
-            }
+            ChildInfo info;
+            info.obj = Selection(star);
+            item->pending.push_back(info);
         }
+    }
 
-        // Add the solar system bodies
-        if (sys != nullptr)
+    // Add the solar system bodies
+    if (sys != nullptr)
+    {
+        for (int i = 0; i < sys->getSystemSize(); i++)
         {
-            for (int i = 0; i < sys->getSystemSize(); i++)
-            {
-                Selection child(sys->getBody(i));
-                item->children[childIndex] = createTreeItem(child, item, childIndex);
-                childIndex++;
-            }
+            ChildInfo info;
+            info.obj = Selection(sys->getBody(i));
+            item->pending.push_back(info);
         }
     }
 }
 
 
 void
-SolarSystemTreeModel::addTreeItemChildrenFiltered(TreeItem* item,
-                                                  PlanetarySystem* sys)
+SolarSystemTreeModel::listChildrenFiltered(TreeItem* item,
+                                           PlanetarySystem* sys) const
 {
-    vector<Body*> bodies;
-
     for (int i = 0; i < sys->getSystemSize(); i++)
     {
         Body* body = sys->getBody(i);
         if ((bodyFilter & body->getClassification()) != 0)
-            bodies.push_back(body);
-    }
-
-    // Calculate the total number of children
-    if ((item->nChildren = bodies.size()) == 0)
-        return;
-
-    int childIndex = 0;
-    item->children = new TreeItem*[item->nChildren];
-
-    // Add the direct children
-    for (int i = 0; i < (int) bodies.size(); i++)
-    {
-        item->children[childIndex] = createTreeItem(bodies[i], item, childIndex);
-        childIndex++;
+        {
+            ChildInfo info;
+            info.obj = Selection(body);
+            item->pending.push_back(info);
+        }
     }
 }
 
@@ -276,10 +324,10 @@ SolarSystemTreeModel::addTreeItemChildrenFiltered(TreeItem* item,
 // asteroids, and spacecraft a grouped together, as there tend to be
 // large collections of such objects.
 void
-SolarSystemTreeModel::addTreeItemChildrenGrouped(TreeItem* item,
-                                                 PlanetarySystem* sys,
-                                                 const vector<Star*>* orbitingStars,
-                                                 Selection parent)
+SolarSystemTreeModel::listChildrenGrouped(TreeItem* item,
+                                          PlanetarySystem* sys,
+                                          const vector<Star*>* orbitingStars,
+                                          Selection parent) const
 {
     vector<Body*> asteroids;
     vector<Body*> spacecraft;
@@ -349,123 +397,42 @@ SolarSystemTreeModel::addTreeItemChildrenGrouped(TreeItem* item,
         }
     }
 
-    // Calculate the total number of children
-    item->nChildren = 0;
+    // Add the stars
     if (orbitingStars != nullptr)
-        item->nChildren += orbitingStars->size();
-
-    item->nChildren += normal.size();
-    if (!asteroids.empty())
-        item->nChildren++;
-    if (!spacecraft.empty())
-        item->nChildren++;
-    if (!minorMoons.empty())
-        item->nChildren++;
-    if (!surfaceFeatures.empty())
-        item->nChildren++;
-    if (!components.empty())
-        item->nChildren++;
-    if (!other.empty())
-        item->nChildren++;
-
-    if (item->nChildren != 0)
     {
-        int childIndex = 0;
-        item->children = new TreeItem*[item->nChildren];
+        for (Star* star : *orbitingStars)
         {
-            // Add the stars
-            if (orbitingStars != nullptr)
-            {
-                for (unsigned int i = 0; i < orbitingStars->size(); i++)
-                {
-                    Selection child(orbitingStars->at(i));
-                    item->children[childIndex] = createTreeItem(child, item, childIndex);
-                    childIndex++;
-                }
-            }
-
-            // Add the direct children
-            for (int i = 0; i < (int) normal.size(); i++)
-            {
-                item->children[childIndex] = createTreeItem(normal[i], item, childIndex);
-                childIndex++;
-            }
-
-            // Add the groups
-            if (!minorMoons.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(Body::MinorMoon,
-                                                                 minorMoons,
-                                                                 item, childIndex);
-                childIndex++;
-            }
-
-            if (!asteroids.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(Body::Asteroid,
-                                                                 asteroids,
-                                                                 item, childIndex);
-                childIndex++;
-            }
-
-            if (!spacecraft.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(Body::Spacecraft,
-                                                                 spacecraft,
-                                                                 item, childIndex);
-                childIndex++;
-            }
-
-            if (!surfaceFeatures.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(Body::SurfaceFeature,
-                                                                 surfaceFeatures,
-                                                                 item, childIndex);
-                childIndex++;
-            }
-
-            if (!components.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(Body::Component,
-                                                                 components,
-                                                                 item, childIndex);
-                childIndex++;
-            }
-
-            if (!other.empty())
-            {
-                item->children[childIndex] = createGroupTreeItem(Body::Unknown,
-                                                                 other,
-                                                                 item, childIndex);
-                childIndex++;
-            }
+            ChildInfo info;
+            info.obj = Selection(star);
+            item->pending.push_back(info);
         }
     }
-}
-
-
-SolarSystemTreeModel::TreeItem*
-SolarSystemTreeModel::createGroupTreeItem(int classification,
-                                          const vector<Body*>& objects,
-                                          TreeItem* parent,
-                                          int childIndex)
-{
-    auto* item = new TreeItem();
-    item->parent = parent;
-    item->childIndex = childIndex;
-    item->classification = classification;
 
-    if (!objects.empty())
+    // Add the direct children
+    for (Body* body : normal)
     {
-        item->nChildren = (int) objects.size();
-        item->children = new TreeItem*[item->nChildren];
-        for (int i = 0; i < item->nChildren; i++)
-        {
-            item->children[i] = createTreeItem(Selection(objects[i]), item, i);
-        }
+        ChildInfo info;
+        info.obj = Selection(body);
+        item->pending.push_back(info);
     }
 
-    return item;
+    // Add the groups
+    auto addGroup = [item](int classification, vector<Body*>& members)
+    {
+        if (members.empty())
+            return;
+        ChildInfo info;
+        info.classification = classification;
+        info.members = std::move(members);
+        item->pending.push_back(std::move(info));
+    };
+
+    addGroup(Body::MinorMoon, minorMoons);
+    addGroup(Body::Asteroid, asteroids);
+    addGroup(Body::Spacecraft, spacecraft);
+    addGroup(Body::SurfaceFeature, surfaceFeatures);
+    addGroup(Body::Component, components);
+    addGroup(Body::Unknown, other);
 }
 
 
@@ -473,12 +440,11 @@ SolarSystemTreeModel::TreeItem*
 SolarSystemTreeModel::itemAtIndex(const QModelIndex& index) const
 {
     if (!index.isValid())
-        return rootItem;
+        return rootItem.get();
 
     return static_cast<TreeItem*>(index.internalPointer());
 }
 
-
 Selection
 SolarSystemTreeModel::objectAtIndex(const QModelIndex& index) const
 {
@@ -497,12 +463,12 @@ QModelIndex SolarSystemTreeModel::index(int row, int column, const QModelIndex&
     TreeItem* parentItem;
 
     if (!parent.isValid())
-        parentItem = rootItem;
+        parentItem = rootItem.get();
     else
         parentItem = static_cast<TreeItem*>(parent.internalPointer());
 
-    if (row < parentItem->nChildren)
-        return createIndex(row, column, parentItem->children[row]);
+    if (row < static_cast<int>(parentItem->children.size()))
+        return createIndex(row, column, parentItem->children[row].get());
     else
         return QModelIndex();
 }
@@ -516,7 +482,7 @@ QModelIndex SolarSystemTreeModel::parent(const QModelIndex& index) const
 
     TreeItem* child = static_cast<TreeItem*>(index.internalPointer());
 
-    if (child->parent == rootItem)
+    if (child->parent == rootItem.get())
         return QModelIndex();
     else
         return createIndex(child->parent->childIndex, 0, child->parent);
@@ -667,10 +633,54 @@ int SolarSystemTreeModel::rowCount(const QModelIndex& parent) const
     if (parent.column() > 0)
         return 0;
 
-    if (!parent.isValid())
-        return rootItem->nChildren;
+    return static_cast<int>(itemAtIndex(parent)->children.size());
+}
+
+
+// Override QAbstractItemModel::hasChildren(); items are shown as
+// expandable before their children are created.
+bool SolarSystemTreeModel::hasChildren(const QModelIndex& parent) const
+{
+    if (parent.column() > 0)
+        return false;
+
+    const TreeItem* item = itemAtIndex(parent);
+    if (item->populated)
+        return !item->pending.empty();
+
+    return mayHaveChildren(item);
+}
+
+
+// Override QAbstractItemModel::canFetchMore()
+bool SolarSystemTreeModel::canFetchMore(const QModelIndex& parent) const
+{
+    if (parent.column() > 0)
+        return false;
+
+    const TreeItem* item = itemAtIndex(parent);
+    return !item->populated || item->children.size() < item->pending.size();
+}
+
+
+// Override QAbstractItemModel::fetchMore()
+void SolarSystemTreeModel::fetchMore(const QModelIndex& parent)
+{
+    if (parent.column() > 0)
+        return;
+
+    TreeItem* item = itemAtIndex(parent);
+    populate(item);
+
+    int first = static_cast<int>(item->children.size());
+    int count = std::min(static_cast<int>(item->pending.size()) - first, FetchBatchSize);
+    if (count <= 0)
+        return;
 
-    return static_cast<TreeItem*>(parent.internalPointer())->nChildren;
+    beginInsertRows(parent, first, first + count - 1);
+    for (int i = first; i < first + count; i++)
+        item->children.push_back(createTreeItem(item->pending[i], item, i));
+    endInsertRows();
 }
 
 
@@ -883,6 +893,8 @@ void SolarSystemBrowser::slotRefreshTree()
     QModelIndex primary = solarSystemModel->index(0, 0, QModelIndex());
     if (primary.isValid() && solarSystemModel->objectAtIndex(primary).star() != nullptr)
     {
+        if (solarSystemModel->canFetchMore(primary))
+            solarSystemModel->fetchMore(primary);
         treeView->setExpanded(primary, true);
         QModelIndex secondary = solarSystemModel->index(0, 0, primary);
         if (secondary.isValid() && solarSystemModel->objectAtIndex(secondary).star() != nullptr)
@@ -0,0 +1,586 @@
+// remotecontrol.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Binary remote control of Celestia and streaming of its state.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
+#include <celutil/logger.h>
+#include "celestiastate.h"
+#include "remotecontrol.h"
+
+using celestia::util::GetLogger;
+using celestia::util::readLE;
+using celestia::util::writeLE;
+
+namespace celestia
+{
+
+namespace
+{
+
+// Each datagram starts with the magic, the version of the protocol, the
+// type of the command or reply and a sequence number, and all values are
+// little endian. Strings are preceded by their size as 16 bits, and the
+// coordinates of positions are strings of the base64 of their BigFix.
+constexpr char PacketMagic[] = "CELR";
+constexpr std::uint8_t PacketVersion = 1;
+constexpr std::size_t PacketHeaderSize = 4 + 1 + 1 + 4;
+constexpr std::size_t MaxPacketSize = 1400;
+
+enum ReplyType
+{
+    // The handle of a Resolve command with the same sequence number, 0 if
+    // the object wasn't found
+    HandleReply = 64,
+    // The changes of the state, numbered from 1 for each subscription
+    StateReply  = 65,
+};
+
+void
+writeString(std::ostream& out, std::string_view s)
+{
+    writeLE<std::uint16_t>(out, static_cast<std::uint16_t>(s.size()));
+    out.write(s.data(), static_cast<std::streamsize>(s.size()));
+}
+
+bool
+readString(std::istream& in, std::string& s)
+{
+    std::uint16_t size;
+    if (!readLE(in, size))
+        return false;
+    s.resize(size);
+    return static_cast<bool>(in.read(s.data(), size));
+}
+
+void
+writePosition(std::ostream& out, const UniversalCoord& position)
+{
+    writeString(out, position.x.toBase64());
+    writeString(out, position.y.toBase64());
+    writeString(out, position.z.toBase64());
+}
+
+bool
+readPosition(std::istream& in, UniversalCoord& position)
+{
+    std::string x, y, z;
+    if (!readString(in, x) || !readString(in, y) || !readString(in, z))
+        return false;
+    position = UniversalCoord(BigFix::fromBase64(x), BigFix::fromBase64(y), BigFix::fromBase64(z));
+    return true;
+}
+
+void
+writeHeader(std::ostream& out, int type, std::uint32_t sequence)
+{
+    out.write(PacketMagic, 4);
+    writeLE<std::uint8_t>(out, PacketVersion);
+    writeLE<std::uint8_t>(out, static_cast<std::uint8_t>(type));
+    writeLE<std::uint32_t>(out, sequence);
+}
+
+} // end unnamed namespace
+
+RemoteState::RemoteState(const CelestiaState& state) :
+    coordSys(state.m_coordSys),
+    refBody(state.m_refBodyName),
+    targetBody(state.m_targetBodyName),
+    position(state.m_observerPosition),
+    orientation(state.m_observerOrientation),
+    fov(state.m_fieldOfView),
+    tdb(state.m_tdb),
+    timeScale(state.m_timeScale),
+    paused(state.m_pauseState),
+    lightTimeDelay(state.m_lightTimeDelay),
+    trackedBody(state.m_trackedBodyName),
+    selectedBody(state.m_selectedBodyName),
+    renderFlags(state.m_renderFlags),
+    labelMode(state.m_labelMode)
+{
+}
+
+unsigned int
+RemoteState::changes(const RemoteState& other) const
+{
+    unsigned int fields = 0;
+    if (coordSys != other.coordSys || refBody != other.refBody || targetBody != other.targetBody)
+        fields |= FrameField;
+    if (position.x != other.position.x || position.y != other.position.y || position.z != other.position.z ||
+        orientation.coeffs() != other.orientation.coeffs() ||
+        fov != other.fov)
+    {
+        fields |= ObserverField;
+    }
+    if (tdb != other.tdb || timeScale != other.timeScale ||
+        paused != other.paused || lightTimeDelay != other.lightTimeDelay)
+    {
+        fields |= TimeField;
+    }
+    if (trackedBody != other.trackedBody || selectedBody != other.selectedBody)
+        fields |= SelectionField;
+    if (renderFlags != other.renderFlags || labelMode != other.labelMode)
+        fields |= RenderField;
+    return fields;
+}
+
+std::string
+RemoteState::encodeDelta(unsigned int fields) const
+{
+    std::ostringstream out(std::ios::out | std::ios::binary);
+    writeLE<std::uint8_t>(out, static_cast<std::uint8_t>(fields & AllFields));
+    if (fields & FrameField)
+    {
+        writeLE<std::uint8_t>(out, static_cast<std::uint8_t>(coordSys));
+        writeString(out, refBody);
+        writeString(out, targetBody);
+    }
+    if (fields & ObserverField)
+    {
+        writePosition(out, position);
+        writeLE(out, orientation.w());
+        writeLE(out, orientation.x());
+        writeLE(out, orientation.y());
+        writeLE(out, orientation.z());
+        writeLE(out, fov);
+    }
+    if (fields & TimeField)
+    {
+        writeLE(out, tdb);
+        writeLE(out, timeScale);
+        writeLE<std::uint8_t>(out, (paused ? 1 : 0) | (lightTimeDelay ? 2 : 0));
+    }
+    if (fields & SelectionField)
+    {
+        writeString(out, trackedBody);
+        writeString(out, selectedBody);
+    }
+    if (fields & RenderField)
+    {
+        writeLE(out, renderFlags);
+        writeLE<std::int32_t>(out, labelMode);
+    }
+    return out.str();
+}
+
+bool
+RemoteState::applyDelta(std::string_view data)
+{
+    // Fields are only updated once the whole delta has been read
+    RemoteState state = *this;
+    std::istringstream in(std::string(data), std::ios::in | std::ios::binary);
+    std::uint8_t fields;
+    if (!readLE(in, fields))
+        return false;
+
+    if (fields & FrameField)
+    {
+        std::uint8_t frame;
+        if (!readLE(in, frame) || !readString(in, state.refBody) || !readString(in, state.targetBody))
+            return false;
+        state.coordSys = static_cast<ObserverFrame::CoordinateSystem>(frame);
+    }
+    if (fields & ObserverField)
+    {
+        float w, x, y, z;
+        if (!readPosition(in, state.position) ||
+            !readLE(in, w) || !readLE(in, x) || !readLE(in, y) || !readLE(in, z) ||
+            !readLE(in, state.fov))
+        {
+            return false;
+        }
+        state.orientation = Eigen::Quaternionf(w, x, y, z);
+    }
+    if (fields & TimeField)
+    {
+        std::uint8_t flags;
+        if (!readLE(in, state.tdb) || !readLE(in, state.timeScale) || !readLE(in, flags))
+            return false;
+        state.paused = (flags & 1) != 0;
+        state.lightTimeDelay = (flags & 2) != 0;
+    }
+    if (fields & SelectionField)
+    {
+        if (!readString(in, state.trackedBody) || !readString(in, state.selectedBody))
+            return false;
+    }
+    if (fields & RenderField)
+    {
+        std::int32_t labels;
+        if (!readLE(in, state.renderFlags) || !readLE(in, labels))
+            return false;
+        state.labelMode = labels;
+    }
+
+    *this = std::move(state);
+    return true;
+}
+
+std::string
+RemoteCommand::encode() const
+{
+    std::ostringstream out(std::ios::out | std::ios::binary);
+    writeHeader(out, type, sequence);
+    switch (type)
+    {
+    case SetTime:
+        writeLE(out, tdb);
+        writeLE(out, timeScale);
+        writeLE<std::uint8_t>(out, paused ? 1 : 0);
+        break;
+    case SetObserver:
+        writePosition(out, position);
+        writeLE(out, orientation.w());
+        writeLE(out, orientation.x());
+        writeLE(out, orientation.y());
+        writeLE(out, orientation.z());
+        writeLE(out, fov);
+        break;
+    case Resolve:
+        writeString(out, path);
+        break;
+    case Select:
+        writeLE(out, handle);
+        break;
+    case SetRenderFlags:
+        writeLE(out, renderFlags);
+        writeLE<std::int32_t>(out, labelMode);
+        break;
+    case Subscribe:
+        writeLE(out, interval);
+        break;
+    }
+    return out.str();
+}
+
+bool
+RemoteCommand::decode(std::string_view packet)
+{
+    if (packet.size() < PacketHeaderSize ||
+        std::memcmp(packet.data(), PacketMagic, 4) != 0 ||
+        static_cast<std::uint8_t>(packet[4]) != PacketVersion)
+    {
+        return false;
+    }
+
+    type = static_cast<Type>(static_cast<std::uint8_t>(packet[5]));
+    sequence = util::fromMemoryLE<std::uint32_t>(packet.data() + 6);
+    std::istringstream in(std::string(packet.substr(PacketHeaderSize)), std::ios::in | std::ios::binary);
+    switch (type)
+    {
+    case SetTime:
+        {
+            std::uint8_t flags;
+            if (!readLE(in, tdb) || !readLE(in, timeScale) || !readLE(in, flags))
+                return false;
+            paused = (flags & 1) != 0;
+            return true;
+        }
+    case SetObserver:
+        {
+            double w, x, y, z;
+            if (!readPosition(in, position) ||
+                !readLE(in, w) || !readLE(in, x) || !readLE(in, y) || !readLE(in, z) ||
+                !readLE(in, fov))
+            {
+                return false;
+            }
+            orientation = Eigen::Quaterniond(w, x, y, z);
+            return true;
+        }
+    case Resolve:
+        return readString(in, path);
+    case Select:
+        return readLE(in, handle);
+    case SetRenderFlags:
+        {
+            std::int32_t labels;
+            if (!readLE(in, renderFlags) || !readLE(in, labels))
+                return false;
+            labelMode = labels;
+            return true;
+        }
+    case Subscribe:
+        return readLE(in, interval);
+    default:
+        return false;
+    }
+}
+
+struct RemoteControl::Client
+{
+    std::uint32_t address{ 0 };
+    std::uint16_t port{ 0 };
+    Clock::duration interval{ 0 };
+    Clock::time_point nextState;
+    std::uint32_t sequence{ 0 };
+    // The last state sent, the client has none before the first one
+    RemoteState state;
+    bool hasState{ false };
+};
+
+struct RemoteControl::Socket
+{
+    Socket() = default;
+    ~Socket();
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+
+    bool open(const std::string& address, std::uint16_t port);
+    void send(std::uint32_t address, std::uint16_t port, const std::string& packet);
+    // The next datagram received, without waiting
+    bool receive(std::string_view& packet, std::uint32_t& address, std::uint16_t& port);
+
+#ifdef _WIN32
+    SOCKET handle{ INVALID_SOCKET };
+    bool started{ false };
+#else
+    int handle{ -1 };
+#endif
+    char buffer[MaxPacketSize];
+};
+
+RemoteControl::Socket::~Socket()
+{
+#ifdef _WIN32
+    if (handle != INVALID_SOCKET)
+        closesocket(handle);
+    if (started)
+        WSACleanup();
+#else
+    if (handle >= 0)
+        close(handle);
+#endif
+}
+
+bool
+RemoteControl::Socket::open(const std::string& address, std::uint16_t port)
+{
+#ifdef _WIN32
+    WSADATA data;
+    if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+        return false;
+    started = true;
+    handle = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (handle == INVALID_SOCKET)
+        return false;
+#else
+    handle = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (handle < 0)
+        return false;
+#endif
+
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &local.sin_addr) != 1)
+        return false;
+    return bind(handle, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) == 0;
+}
+
+void
+RemoteControl::Socket::send(std::uint32_t address, std::uint16_t port, const std::string& packet)
+{
+    sockaddr_in remote{};
+    remote.sin_family = AF_INET;
+    remote.sin_port = port;
+    remote.sin_addr.s_addr = address;
+    sendto(handle, packet.data(), static_cast<int>(packet.size()), 0,
+           reinterpret_cast<const sockaddr*>(&remote), sizeof(remote));
+}
+
+bool
+RemoteControl::Socket::receive(std::string_view& packet, std::uint32_t& address, std::uint16_t& port)
+{
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(handle, &readSet);
+    timeval timeout{};
+    if (select(static_cast<int>(handle + 1), &readSet, nullptr, nullptr, &timeout) <= 0)
+        return false;
+
+    sockaddr_in remote{};
+    socklen_t remoteSize = sizeof(remote);
+    auto size = recvfrom(handle, buffer, static_cast<int>(sizeof(buffer)), 0,
+                         reinterpret_cast<sockaddr*>(&remote), &remoteSize);
+    if (size < 0)
+        return false;
+
+    packet = std::string_view(buffer, static_cast<std::size_t>(size));
+    address = remote.sin_addr.s_addr;
+    port = remote.sin_port;
+    return true;
+}
+
+RemoteControl::RemoteControl(std::unique_ptr<Socket>&& socket) :
+    socket(std::move(socket))
+{
+}
+
+RemoteControl::~RemoteControl() = default;
+
+std::unique_ptr<RemoteControl>
+RemoteControl::create(const std::string& address, std::uint16_t port)
+{
+    auto socket = std::make_unique<Socket>();
+    if (!socket->open(address, port))
+    {
+        GetLogger()->error("Failed to open the remote control socket at {}:{}\n", address, port);
+        return nullptr;
+    }
+
+    return std::unique_ptr<RemoteControl>(new RemoteControl(std::move(socket)));
+}
+
+bool
+RemoteControl::receive(RemoteCommand& command)
+{
+    std::string_view packet;
+    while (socket->receive(packet, command.senderAddress, command.senderPort))
+    {
+        // Datagrams which aren't commands are dropped
+        if (!command.decode(packet))
+            continue;
+
+        if (command.type == RemoteCommand::Subscribe)
+            subscribe(command);
+        else
+            return true;
+    }
+    return false;
+}
+
+std::uint32_t
+RemoteControl::findHandle(const std::string& path) const
+{
+    auto it = handles.find(path);
+    return it == handles.end() ? 0 : it->second;
+}
+
+std::uint32_t
+RemoteControl::addHandle(const std::string& path, const Selection& sel)
+{
+    handleObjects.push_back(sel);
+    auto handle = static_cast<std::uint32_t>(handleObjects.size());
+    handles[path] = handle;
+    return handle;
+}
+
+Selection
+RemoteControl::getHandleObject(std::uint32_t handle) const
+{
+    if (handle == 0 || handle > handleObjects.size())
+        return Selection();
+    return handleObjects[handle - 1];
+}
+
+void
+RemoteControl::replyHandle(const RemoteCommand& command, std::uint32_t handle)
+{
+    std::ostringstream out(std::ios::out | std::ios::binary);
+    writeLE(out, handle);
+    send(command.senderAddress, command.senderPort, HandleReply, command.sequence, out.str());
+}
+
+bool
+RemoteControl::isStateDue() const
+{
+    auto now = Clock::now();
+    for (const auto& client : clients)
+    {
+        if (now >= client.nextState)
+            return true;
+    }
+    return false;
+}
+
+void
+RemoteControl::sendState(const RemoteState& state)
+{
+    auto now = Clock::now();
+    for (auto& client : clients)
+    {
+        if (now < client.nextState)
+            continue;
+
+        unsigned int fields = RemoteState::AllFields;
+        if (client.hasState)
+            fields = state.changes(client.state);
+        if (fields == 0)
+            continue;
+
+        send(client.address, client.port, StateReply, ++client.sequence, state.encodeDelta(fields));
+        client.state = state;
+        client.hasState = true;
+        client.nextState = now + client.interval;
+    }
+}
+
+void
+RemoteControl::send(std::uint32_t address, std::uint16_t port,
+                    int type, std::uint32_t sequence, std::string_view payload)
+{
+    std::ostringstream out(std::ios::out | std::ios::binary);
+    writeHeader(out, type, sequence);
+    out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+
+    std::string packet = out.str();
+    if (packet.size() > MaxPacketSize)
+    {
+        GetLogger()->warn("Remote control packet of {} bytes not sent\n", packet.size());
+        return;
+    }
+    socket->send(address, port, packet);
+}
+
+void
+RemoteControl::subscribe(const RemoteCommand& command)
+{
+    auto it = std::find_if(clients.begin(), clients.end(),
+                           [&command](const Client& client)
+                           {
+                               return client.address == command.senderAddress &&
+                                      client.port == command.senderPort;
+                           });
+    if (command.interval < 0.0f)
+    {
+        if (it != clients.end())
+            clients.erase(it);
+        return;
+    }
+
+    if (it == clients.end())
+    {
+        it = clients.emplace(clients.end());
+        it->address = command.senderAddress;
+        it->port = command.senderPort;
+    }
+
+    // Subscribing again starts over from a complete state
+    it->interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(command.interval));
+    it->nextState = Clock::now();
+    it->sequence = 0;
+    it->hasState = false;
+}
+
+} // end namespace celestia
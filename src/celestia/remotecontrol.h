@@ -0,0 +1,198 @@
+// remotecontrol.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Binary remote control of Celestia and streaming of its state.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <Eigen/Geometry>
+#include <celengine/observer.h>
+#include <celengine/selection.h>
+#include <celengine/univcoord.h>
+
+class CelestiaState;
+
+namespace celestia
+{
+
+/**
+ * The state streamed to the subscribers of a remote control, which is that
+ * of a CelestiaState. It is sent as a delta of the fields which changed
+ * since the last state sent.
+ */
+struct RemoteState
+{
+    enum Field : std::uint8_t
+    {
+        FrameField     = 0x01,
+        ObserverField  = 0x02,
+        TimeField      = 0x04,
+        SelectionField = 0x08,
+        RenderField    = 0x10,
+        AllFields      = 0x1f,
+    };
+
+    RemoteState() = default;
+    explicit RemoteState(const CelestiaState& state);
+
+    // Observer frame, and the observer's position and orientation in it
+    ObserverFrame::CoordinateSystem coordSys{ ObserverFrame::Universal };
+    std::string refBody;
+    std::string targetBody;
+    UniversalCoord position;
+    Eigen::Quaternionf orientation{ Eigen::Quaternionf::Identity() };
+    // Field of view in degrees
+    float fov{ 45.0f };
+
+    double tdb{ 0.0 };
+    float timeScale{ 1.0f };
+    bool paused{ false };
+    bool lightTimeDelay{ false };
+
+    // Paths of bodies as in cel URLs
+    std::string trackedBody;
+    std::string selectedBody;
+
+    std::uint64_t renderFlags{ 0 };
+    int labelMode{ 0 };
+
+    // The fields which differ from those of other
+    unsigned int changes(const RemoteState& other) const;
+    // The fields in the mask, preceded by the mask
+    std::string encodeDelta(unsigned int fields) const;
+    // Update the fields in a delta, returning false if it's malformed
+    bool applyDelta(std::string_view data);
+};
+
+/**
+ * A command received by a remote control.
+ */
+struct RemoteCommand
+{
+    enum Type
+    {
+        // Set the time, the time scale and pause
+        SetTime          = 1,
+        // Set the observer's universal position, orientation and field of
+        // view; the observer frame becomes universal
+        SetObserver      = 2,
+        // Get a handle for the object at path
+        Resolve          = 3,
+        // Select the object of handle
+        Select           = 4,
+        // Set the render flags and label mode
+        SetRenderFlags   = 5,
+        // Receive the state every interval seconds, or no more if it's
+        // negative; handled by the remote control
+        Subscribe        = 6,
+    };
+
+    Type type{ SetTime };
+    // Chosen by the client and sent back with the reply to Resolve
+    std::uint32_t sequence{ 0 };
+
+    double tdb{ 0.0 };
+    double timeScale{ 1.0 };
+    bool paused{ false };
+    UniversalCoord position;
+    Eigen::Quaterniond orientation{ Eigen::Quaterniond::Identity() };
+    // Field of view in radians
+    float fov{ 0.0f };
+    std::string path;
+    std::uint32_t handle{ 0 };
+    std::uint64_t renderFlags{ 0 };
+    int labelMode{ 0 };
+    float interval{ 0.0f };
+
+    // The datagram of the command
+    std::string encode() const;
+    bool decode(std::string_view packet);
+
+ private:
+    // IPv4 address and port of the client which sent the command, in
+    // network byte order
+    std::uint32_t senderAddress{ 0 };
+    std::uint16_t senderPort{ 0 };
+
+    friend class RemoteControl;
+};
+
+/**
+ * Lets other programs, such as show control systems, drive Celestia with a
+ * compact binary protocol over UDP, without going through the parsers of
+ * scripts and URLs.
+ *
+ * Each datagram holds one command or reply. Objects are selected through
+ * handles which the clients get once for a path, so that the path isn't
+ * resolved again with each command. Clients may also subscribe to the
+ * state of Celestia, which is sent to them at most at the interval they
+ * asked for, as the fields which changed since the last state sent. State
+ * packets are numbered, and a client which missed one subscribes again to
+ * start over from a complete state.
+ *
+ * There's no authentication, so the socket should only listen on trusted
+ * networks.
+ */
+class RemoteControl
+{
+ public:
+    ~RemoteControl();
+    RemoteControl(const RemoteControl&) = delete;
+    RemoteControl& operator=(const RemoteControl&) = delete;
+
+    /**
+     * Listen at address and port. Returns null if the socket can't be set
+     * up.
+     */
+    static std::unique_ptr<RemoteControl> create(const std::string& address,
+                                                 std::uint16_t port);
+
+    // The next command received, without waiting. Subscriptions are
+    // handled here.
+    bool receive(RemoteCommand& command);
+
+    // The handle of an object resolved before, or 0
+    std::uint32_t findHandle(const std::string& path) const;
+    std::uint32_t addHandle(const std::string& path, const Selection& sel);
+    Selection getHandleObject(std::uint32_t handle) const;
+    // Send the handle of the object of a Resolve command, 0 if not found
+    void replyHandle(const RemoteCommand& command, std::uint32_t handle);
+
+    // Whether a subscriber waits for a state
+    bool isStateDue() const;
+    // Send the changes of the state to the subscribers which wait for it
+    void sendState(const RemoteState& state);
+
+ private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Socket;
+    struct Client;
+
+    explicit RemoteControl(std::unique_ptr<Socket>&& socket);
+
+    void send(std::uint32_t address, std::uint16_t port,
+              int type, std::uint32_t sequence, std::string_view payload);
+    void subscribe(const RemoteCommand& command);
+
+    std::unique_ptr<Socket> socket;
+    std::vector<Client> clients;
+
+    std::unordered_map<std::string, std::uint32_t> handles;
+    std::vector<Selection> handleObjects;
+};
+
+} // end namespace celestia
@@ -176,6 +176,11 @@ SDL_Application::configure() const
 
     renderer->setRenderFlags(Renderer::DefaultRenderFlags);
     renderer->setShadowMapSize(config->ShadowMapSize);
+    renderer->setGPUStarField(config->gpuStarField);
+    renderer->setGPUOrbits(config->gpuOrbits);
+    renderer->setModelInstancing(config->modelInstancing);
+    renderer->setDSOImpostors(config->dsoImpostors);
+    renderer->setLabelDeclutter(config->labelDeclutter);
     renderer->setSolarSystemMaxDistance(config->SolarSystemMaxDistance);
 }
 
@@ -237,7 +242,17 @@ SDL_Application::run()
             }
         }
         m_appCore->tick();
-        display();
+        if (m_appCore->viewUpdateRequired())
+        {
+            display();
+        }
+        else
+        {
+            // Sleep until the next idle tick unless input comes earlier
+            auto delay = static_cast<int>(m_appCore->getFrameDelay() * 1000.0);
+            if (delay > 0)
+                SDL_WaitEventTimeout(nullptr, delay);
+        }
     }
 }
 
@@ -469,6 +484,9 @@ SDL_Application::handleWindowEvent(const SDL_WindowEvent &event)
         m_windowHeight = event.data2;
         m_appCore->resize(m_windowWidth, m_windowHeight);
         break;
+    case SDL_WINDOWEVENT_EXPOSED:
+        m_appCore->setViewChanged();
+        break;
     default:
         break;
     }
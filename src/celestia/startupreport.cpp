@@ -0,0 +1,139 @@
+// startupreport.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Timing and load statistics of the startup stages.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "startupreport.h"
+
+#include <system_error>
+#include <utility>
+#include <fmt/format.h>
+#include <celutil/logger.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using celestia::util::GetLogger;
+
+namespace celestia
+{
+
+StartupReport::Timer::Timer(StartupReport* _report, std::string name) :
+    report(_report)
+{
+    if (report == nullptr)
+        return;
+
+    index = report->stages.size();
+    report->stages.push_back({ std::move(name),
+                               static_cast<int>(report->running.size()),
+                               0.0,
+                               0,
+                               std::nullopt,
+                               0 });
+    report->running.push_back(index);
+    start = std::chrono::steady_clock::now();
+}
+
+StartupReport::Timer::~Timer()
+{
+    if (report == nullptr)
+        return;
+
+    Stage& stage = report->stages[index];
+    stage.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    stage.peakMemory = peakMemory();
+    report->running.pop_back();
+}
+
+void
+StartupReport::Timer::addFile(const fs::path& path)
+{
+    if (report == nullptr)
+        return;
+
+    std::error_code ec;
+    std::uintmax_t size = fs::file_size(path, ec);
+    if (ec)
+        return;
+
+    for (std::size_t i : report->running)
+    {
+        report->stages[i].bytesRead += size;
+        if (i == index)
+            break;
+    }
+}
+
+void
+StartupReport::Timer::setObjects(std::size_t objects)
+{
+    if (report != nullptr)
+        report->stages[index].objects = objects;
+}
+
+void
+StartupReport::log() const
+{
+    double totalTime = 0.0;
+    std::uintmax_t totalBytes = 0;
+
+    auto logger = GetLogger();
+    logger->info("Startup report:\n");
+    logger->info("{:<48} {:>10} {:>10} {:>10} {:>10}\n", "Stage", "Time (ms)", "Read (KB)", "Objects", "Peak (MB)");
+    for (const Stage& stage : stages)
+    {
+        std::string name = std::string(2 * stage.depth, ' ') + stage.name;
+        logger->info("{:<48} {:>10.1f} {:>10} {:>10} {:>10.1f}\n",
+                     name,
+                     stage.milliseconds,
+                     (stage.bytesRead + 1023) / 1024,
+                     stage.objects.has_value() ? fmt::to_string(*stage.objects) : "-",
+                     stage.peakMemory / 1024.0);
+
+        if (stage.depth == 0)
+        {
+            totalTime += stage.milliseconds;
+            totalBytes += stage.bytesRead;
+        }
+    }
+    logger->info("{:<48} {:>10.1f} {:>10} {:>10} {:>10.1f}\n",
+                 "Total",
+                 totalTime,
+                 (totalBytes + 1023) / 1024,
+                 "",
+                 peakMemory() / 1024.0);
+}
+
+long
+StartupReport::peakMemory()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return static_cast<long>(counters.PeakWorkingSetSize / 1024);
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    // Bytes rather than kilobytes on macOS
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+} // end namespace celestia
@@ -0,0 +1,83 @@
+// startupreport.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Timing and load statistics of the startup stages.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include <celcompat/filesystem.h>
+
+namespace celestia
+{
+
+// StartupReport records the wall time, the size of the files read, the
+// number of objects loaded and the peak memory of the process after each
+// stage of the startup, so that the costs of the catalogs and add-ons
+// can be compared.
+class StartupReport
+{
+ public:
+    struct Stage
+    {
+        std::string name;
+        // Stages may contain the stages of their files
+        int depth;
+        double milliseconds;
+        std::uintmax_t bytesRead;
+        // Unknown for stages which don't count what they load
+        std::optional<std::size_t> objects;
+        // Kilobytes, zero if unknown
+        long peakMemory;
+    };
+
+    // Timer measures a stage from its construction to its destruction.
+    // Timers of a null report do nothing, so that stages can be timed
+    // unconditionally.
+    class Timer
+    {
+     public:
+        Timer(StartupReport* report, std::string name);
+        ~Timer();
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+        // Count the size of a file read by the stage
+        void addFile(const fs::path& path);
+        void setObjects(std::size_t objects);
+
+     private:
+        StartupReport* report;
+        // Stages are listed in the order they start
+        std::size_t index{ 0 };
+        std::chrono::steady_clock::time_point start;
+    };
+
+    const std::vector<Stage>& getStages() const { return stages; }
+
+    // Write the stages and their totals to the logger
+    void log() const;
+
+    // Peak resident memory of the process in kilobytes, or zero if it's
+    // unknown
+    static long peakMemory();
+
+ private:
+    std::vector<Stage> stages;
+    // Indices of the stages being timed, from the outermost one; the files
+    // read by a stage are also counted in the stages containing it
+    std::vector<std::size_t> running;
+};
+
+} // end namespace celestia
@@ -7,6 +7,7 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <celengine/rectangle.h>
 #include <celengine/render.h>
 #include <celengine/framebuffer.h>
@@ -210,6 +211,7 @@ void View::split(Type type, Observer *o, float splitPos, View **split, View **vi
     (*split)->child2 = *view;
     (*view)->parent = *split;
     (*view)->zoom = zoom;
+    (*view)->stereo = stereo;
 }
 
 View* View::remove(View* v)
@@ -261,16 +263,19 @@ void View::drawBorder(int gWidth, int gHeight, const Color &color, float linewid
     renderer->drawRectangle(r, ShaderProperties::FisheyeOverrideModeDisabled, renderer->getOrthoProjectionMatrix());
 }
 
-void View::updateFBO(int gWidth, int gHeight)
+void View::updateFBO(int gWidth, int gHeight, float scale, bool floatDepth)
 {
-    int newWidth = width * gWidth;
-    int newHeight = height * gHeight;
-    if (fbo && fbo.get()->width() == newWidth && fbo.get()->height() == newHeight)
+    int newWidth = std::max(1, static_cast<int>(static_cast<int>(width * gWidth) * scale));
+    int newHeight = std::max(1, static_cast<int>(static_cast<int>(height * gHeight) * scale));
+    if (fbo && fbo.get()->width() == newWidth && fbo.get()->height() == newHeight &&
+        fbo.get()->hasFloatDepth() == floatDepth)
         return;
 
-    // recreate FBO when FBO not exisits or on size change
-    fbo = unique_ptr<FramebufferObject>(new FramebufferObject(newWidth, newHeight,
-                                                              FramebufferObject::ColorAttachment | FramebufferObject::DepthAttachment));
+    // recreate FBO when FBO not exisits or on size or depth format change
+    unsigned int attachments = FramebufferObject::ColorAttachment | FramebufferObject::DepthAttachment;
+    if (floatDepth)
+        attachments |= FramebufferObject::FloatDepth;
+    fbo = unique_ptr<FramebufferObject>(new FramebufferObject(newWidth, newHeight, attachments));
     if (!fbo->isValid())
     {
         GetLogger()->error("Error creating view FBO.\n");
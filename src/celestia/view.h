@@ -45,7 +45,9 @@ class View
     void reset();
     static View* remove(View*);
     void drawBorder(int gWidth, int gHeight, const Color &color, float linewidth = 1.0f);
-    void updateFBO(int gWidth, int gHeight);
+    // Create or resize the framebuffer of the view for a window of
+    // gWidth x gHeight, scaled by scale for rendering at a lower resolution
+    void updateFBO(int gWidth, int gHeight, float scale = 1.0f, bool floatDepth = false);
     FramebufferObject *getFBO() const;
 
  public:
@@ -64,6 +66,8 @@ class View
     int       labelMode       { 0 };
     float     zoom            { 1.0f };
     float     alternateZoom   { 1.0f };
+    // Draw the views of the two eyes of the observer side by side
+    bool      stereo          { false };
 
 private:
     std::unique_ptr<FramebufferObject> fbo;
@@ -2723,6 +2723,7 @@ static void HandleCaptureImage(HWND hWnd)
         }
 
         // Redraw to make sure that the back buffer is up to date
+        appCore->setViewChanged();
         appCore->draw();
         if (!appCore->saveScreenShot(Ofn.lpstrFile))
         {
@@ -3373,6 +3374,11 @@ int APIENTRY WinMain(HINSTANCE hInstance,
 
     appCore->getRenderer()->setSolarSystemMaxDistance(appCore->getConfig()->SolarSystemMaxDistance);
     appCore->getRenderer()->setShadowMapSize(appCore->getConfig()->ShadowMapSize);
+    appCore->getRenderer()->setGPUStarField(appCore->getConfig()->gpuStarField);
+    appCore->getRenderer()->setGPUOrbits(appCore->getConfig()->gpuOrbits);
+    appCore->getRenderer()->setModelInstancing(appCore->getConfig()->modelInstancing);
+    appCore->getRenderer()->setDSOImpostors(appCore->getConfig()->dsoImpostors);
+    appCore->getRenderer()->setLabelDeclutter(appCore->getConfig()->labelDeclutter);
 
     cursorHandler = new WinCursorHandler(hDefaultCursor);
     appCore->setCursorHandler(cursorHandler);
@@ -3578,11 +3584,18 @@ int APIENTRY WinMain(HINSTANCE hInstance,
                 DispatchMessage(&msg);
             }
         }
-        else
+        else if (appCore->viewUpdateRequired())
         {
             // And force a redraw
             InvalidateRect(mainWindow, NULL, FALSE);
         }
+        else
+        {
+            // Nothing changed; wait for input or the next idle tick
+            auto delay = static_cast<DWORD>(appCore->getFrameDelay() * 1000.0);
+            if (delay > 0)
+                MsgWaitForMultipleObjects(0, NULL, FALSE, delay, QS_ALLINPUT);
+        }
 
         if (useJoystick)
             HandleJoystick();
@@ -4445,6 +4458,7 @@ LRESULT CALLBACK MainWindowProc(HWND hWnd,
     case WM_PAINT:
         if (bReady)
         {
+            appCore->setViewChanged();
             appCore->draw();
             SwapBuffers(deviceContext);
             ValidateRect(hWnd, NULL);
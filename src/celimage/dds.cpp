@@ -13,6 +13,7 @@
 #include <fstream>
 #include <algorithm>
 #include <memory>
+#include <vector>
 #include <celengine/glsupport.h>
 #include <celengine/image.h>
 #include <celutil/logger.h>
@@ -86,50 +87,28 @@ constexpr uint32_t FourCC(const char* s)
             (uint32_t) s[0]);
 }
 
-// decompress a DXTc texture to a RGBA texture, taken from https://github.com/ptitSeb/gl4es
+// decompress a DXTc texture to a RGBA texture of width x height pixels
 uint32_t* decompressDXTc(uint32_t width, uint32_t height, GLenum format, bool transparent0, ifstream &in)
 {
-    // TODO: check with the size of the input data stream if the stream is in fact decompressed
-    // alloc memory
-    auto *pixels = new uint32_t[((width + 3) & ~3) * ((height + 3) & ~3)];
+    uint32_t paddedWidth = (width + 3) & ~3u;
+    uint32_t paddedHeight = (height + 3) & ~3u;
+    uint32_t blockSize = format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT ? 8 : 16;
 
-    int blocksize = 0;
-#define DDS_MAX_BLOCK_SIZE      16
-    switch (format)
+    // Read the whole level so that it can be decoded in parallel
+    vector<uint8_t> blocks((size_t) (paddedWidth / 4) * (paddedHeight / 4) * blockSize);
+    if (!in.read(reinterpret_cast<char*>(blocks.data()), blocks.size()).good())
+        return nullptr;
+
+    auto *pixels = new uint32_t[paddedWidth * paddedHeight];
+    DecompressDXT(static_cast<PixelFormat>(format), blocks.data(), width, height, transparent0, pixels);
+
+    // crop
+    if (paddedWidth != width)
     {
-    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
-        blocksize = 8;
-        break;
-    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
-    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
-        blocksize = 16;
-        break;
-    }
-    uint8_t block[DDS_MAX_BLOCK_SIZE]; // enough to hold DXT1/3/5 blocks
-    for (uint32_t y = 0; y < height; y += 4)
-    {
-        for (uint32_t x = 0; x < width; x += 4)
-        {
-            if (!in.good())
-            {
-                delete[] pixels;
-                return nullptr;
-            }
-            in.read((char*)block, blocksize);
-            switch(format)
-            {
-            case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
-                DecompressBlockDXT1(x, y, width, block, transparent0, pixels);
-                break;
-            case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
-                DecompressBlockDXT3(x, y, width, block, transparent0, pixels);
-                break;
-            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
-                DecompressBlockDXT5(x, y, width, block, transparent0, pixels);
-                break;
-            }
-        }
+        for (uint32_t y = 1; y < height; y++)
+            memmove(pixels + y * width, pixels + y * paddedWidth, width * 4);
     }
+
     return pixels;
 }
 
@@ -246,26 +225,8 @@ Image* LoadDDSImage(const fs::path& filename)
         if (!gl::EXT_texture_compression_s3tc)
         {
             // DXTc texture not supported, decompress DXTc to RGB/RGBA
-            uint32_t *pixels = nullptr;
             bool transparent0 = format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
-            if ((ddsd.width & 3) != 0 || (ddsd.height & 3) != 0)
-            {
-                uint32_t nw = max(ddsd.width, 4u);
-                uint32_t nh = max(ddsd.height, 4u);
-                auto *tmp = decompressDXTc(nw, nh, format, transparent0, in);
-                if (tmp != nullptr)
-                {
-                    pixels = new uint32_t[ddsd.width * ddsd.height];
-                    // crop
-                    for (uint32_t y = 0; y < ddsd.height; y++)
-                        memcpy((char *)pixels + y * ddsd.width * 4, (char *)tmp + y * nw * 4, ddsd.width * 4);
-                    delete[] tmp;
-                }
-            }
-            else
-            {
-                pixels = decompressDXTc(ddsd.width, ddsd.height, format, transparent0, in);
-            }
+            uint32_t *pixels = decompressDXTc(ddsd.width, ddsd.height, format, transparent0, in);
 
             if (pixels == nullptr)
             {
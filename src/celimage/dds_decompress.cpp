@@ -1,5 +1,10 @@
-#include <stddef.h>
-#include <stdint.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <celutil/jobsystem.h>
+#include "dds_decompress.h"
+
+using celestia::PixelFormat;
 
 /*
 DXT1/DXT3/DXT5 texture decompression
@@ -55,125 +60,182 @@ SOFTWARE.
 
 ---
 */
+namespace
+{
+
+// Surfaces smaller than this many blocks are decoded on the calling thread
+constexpr std::uint32_t MinParallelBlocks = 16384;
+
+// Number of block rows decoded by each task
+constexpr std::uint32_t BandBlockRows = 16;
+
 constexpr uint32_t PackRGBA(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
 {
     return r | (g << 8) | (b << 16) | (a << 24);
 }
 
-static void DecompressBlockDXT1Internal(const uint8_t* block,
-                                        uint32_t* output,
-                                        uint32_t outputStride,
-                                        bool transparent0,
-                                        const uint8_t* alphaValues)
+inline uint16_t Read16(const uint8_t* p)
 {
-    uint32_t temp, code;
+    return (uint16_t) (p[0] | (p[1] << 8));
+}
 
-    uint16_t color0, color1;
-    uint8_t r0, g0, b0, r1, g1, b1;
+inline uint32_t Read32(const uint8_t* p)
+{
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
 
-    int i, j;
+// Expand a RGB565 color to 8 bits per channel, with zero alpha
+inline void Expand565(uint16_t color, uint32_t& r, uint32_t& g, uint32_t& b)
+{
+    uint32_t temp = (color >> 11) * 255 + 16;
+    r = (temp / 32 + temp) / 32;
+    temp = ((color & 0x07E0) >> 5) * 255 + 32;
+    g = (temp / 64 + temp) / 64;
+    temp = (color & 0x001F) * 255 + 16;
+    b = (temp / 32 + temp) / 32;
+}
 
-    color0 = *(const uint16_t*)(block);
-    color1 = *(const uint16_t*)(block + 2);
+// Build the four colors of a color block so that each texel is a table
+// lookup rather than an interpolation. Blocks with color0 <= color1 use
+// the three color mode unless fourColors is set, as it is for DXT5.
+inline void ColorPalette(const uint8_t* block, bool fourColors, uint32_t palette[4])
+{
+    uint16_t color0 = Read16(block);
+    uint16_t color1 = Read16(block + 2);
 
-    temp = (color0 >> 11) * 255 + 16;
-    r0 = (uint8_t)((temp / 32 + temp) / 32);
-    temp = ((color0 & 0x07E0) >> 5) * 255 + 32;
-    g0 = (uint8_t)((temp / 64 + temp) / 64);
-    temp = (color0 & 0x001F) * 255 + 16;
-    b0 = (uint8_t)((temp / 32 + temp) / 32);
+    uint32_t r0, g0, b0, r1, g1, b1;
+    Expand565(color0, r0, g0, b0);
+    Expand565(color1, r1, g1, b1);
 
-    temp = (color1 >> 11) * 255 + 16;
-    r1 = (uint8_t)((temp / 32 + temp) / 32);
-    temp = ((color1 & 0x07E0) >> 5) * 255 + 32;
-    g1 = (uint8_t)((temp / 64 + temp) / 64);
-    temp = (color1 & 0x001F) * 255 + 16;
-    b1 = (uint8_t)((temp / 32 + temp) / 32);
+    palette[0] = PackRGBA(r0, g0, b0, 0);
+    palette[1] = PackRGBA(r1, g1, b1, 0);
+    if (fourColors || color0 > color1)
+    {
+        palette[2] = PackRGBA((2 * r0 + r1) / 3, (2 * g0 + g1) / 3, (2 * b0 + b1) / 3, 0);
+        palette[3] = PackRGBA((r0 + 2 * r1) / 3, (g0 + 2 * g1) / 3, (b0 + 2 * b1) / 3, 0);
+    }
+    else
+    {
+        palette[2] = PackRGBA((r0 + r1) / 2, (g0 + g1) / 2, (b0 + b1) / 2, 0);
+        palette[3] = 0;
+    }
+}
 
-    code = *(const uint32_t*)(block + 4);
+// Build the eight alpha values of a DXT5 alpha block
+inline void AlphaPalette(const uint8_t* block, uint32_t palette[8])
+{
+    uint32_t alpha0 = block[0];
+    uint32_t alpha1 = block[1];
 
-    if (color0 > color1)
+    palette[0] = alpha0;
+    palette[1] = alpha1;
+    if (alpha0 > alpha1)
     {
-        for (j = 0; j < 4; ++j)
-        {
-            for (i = 0; i < 4; ++i)
-            {
-                uint32_t finalColor, positionCode;
-                uint8_t alpha;
-
-                alpha = alphaValues[j * 4 + i];
-
-                finalColor = 0;
-                positionCode = (code >> 2 * (4 * j + i)) & 0x03;
-
-                switch (positionCode)
-                {
-                case 0:
-                    finalColor = PackRGBA(r0, g0, b0, alpha);
-                    break;
-                case 1:
-                    finalColor = PackRGBA(r1, g1, b1, alpha);
-                    break;
-                case 2:
-                    finalColor = PackRGBA((2 * r0 + r1) / 3, (2 * g0 + g1) / 3,
-                                          (2 * b0 + b1) / 3, alpha);
-                    break;
-                case 3:
-                    finalColor = PackRGBA((r0 + 2 * r1) / 3, (g0 + 2 * g1) / 3,
-                                          (b0 + 2 * b1) / 3, alpha);
-                    break;
-                }
-                if (transparent0 && (finalColor == PackRGBA(0, 0, 0, 0xff)))
-                {
-                    alpha = 0;
-                    finalColor = 0;
-                }
-                output[j * outputStride + i] = finalColor;
-            }
-        }
+        for (uint32_t code = 2; code < 8; code++)
+            palette[code] = ((8 - code) * alpha0 + (code - 1) * alpha1) / 7;
     }
     else
     {
-        for (j = 0; j < 4; ++j)
+        for (uint32_t code = 2; code < 6; code++)
+            palette[code] = ((6 - code) * alpha0 + (code - 1) * alpha1) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+// If transparent0 is set, opaque black texels are made fully transparent
+inline uint32_t MaskBlack(uint32_t color, bool transparent0)
+{
+    return (transparent0 && color == PackRGBA(0, 0, 0, 0xff)) ? 0 : color;
+}
+
+void DecodeBlockDXT1(const uint8_t* block, bool transparent0,
+                     uint32_t* output, uint32_t outputStride)
+{
+    uint32_t palette[4];
+    ColorPalette(block, false, palette);
+    for (uint32_t& color : palette)
+        color = MaskBlack(color | 0xff000000u, transparent0);
+
+    uint32_t code = Read32(block + 4);
+    for (uint32_t j = 0; j < 4; j++, code >>= 8)
+    {
+        uint32_t* row = output + j * outputStride;
+        row[0] = palette[code & 3];
+        row[1] = palette[(code >> 2) & 3];
+        row[2] = palette[(code >> 4) & 3];
+        row[3] = palette[(code >> 6) & 3];
+    }
+}
+
+void DecodeBlockDXT3(const uint8_t* block, bool transparent0,
+                     uint32_t* output, uint32_t outputStride)
+{
+    uint32_t palette[4];
+    ColorPalette(block + 8, false, palette);
+
+    uint32_t code = Read32(block + 12);
+    for (uint32_t j = 0; j < 4; j++)
+    {
+        uint32_t alphaRow = Read16(block + 2 * j);
+        uint32_t* row = output + j * outputStride;
+        for (uint32_t i = 0; i < 4; i++, code >>= 2, alphaRow >>= 4)
+            row[i] = MaskBlack(palette[code & 3] | (((alphaRow & 0xf) * 17) << 24), transparent0);
+    }
+}
+
+void DecodeBlockDXT5(const uint8_t* block, uint32_t* output, uint32_t outputStride)
+{
+    uint32_t alphas[8];
+    AlphaPalette(block, alphas);
+    uint32_t palette[4];
+    ColorPalette(block + 8, true, palette);
+
+    uint64_t alphaCode = (uint64_t) Read16(block + 2) | ((uint64_t) Read32(block + 4) << 16);
+    uint32_t code = Read32(block + 12);
+    for (uint32_t j = 0; j < 4; j++)
+    {
+        uint32_t* row = output + j * outputStride;
+        for (uint32_t i = 0; i < 4; i++, code >>= 2, alphaCode >>= 3)
+            row[i] = palette[code & 3] | (alphas[alphaCode & 7] << 24);
+    }
+}
+
+// Decode the block rows [firstRow, lastRow) of a surface
+void DecodeBlockRows(PixelFormat format,
+                     const uint8_t* blocks,
+                     uint32_t blocksWide,
+                     uint32_t firstRow,
+                     uint32_t lastRow,
+                     bool transparent0,
+                     uint32_t* image)
+{
+    uint32_t stride = blocksWide * 4;
+    uint32_t blockSize = format == PixelFormat::DXT1 ? 8 : 16;
+    const uint8_t* block = blocks + (size_t) firstRow * blocksWide * blockSize;
+    for (uint32_t by = firstRow; by < lastRow; by++)
+    {
+        uint32_t* output = image + (size_t) by * 4 * stride;
+        for (uint32_t bx = 0; bx < blocksWide; bx++, block += blockSize, output += 4)
         {
-            for (i = 0; i < 4; ++i)
+            switch (format)
             {
-                uint32_t finalColor, positionCode;
-                uint8_t alpha;
-
-                alpha = alphaValues[j * 4 + i];
-
-                finalColor = 0;
-                positionCode = (code >> 2 * (4 * j + i)) & 0x03;
-
-                switch (positionCode)
-                {
-                case 0:
-                    finalColor = PackRGBA(r0, g0, b0, alpha);
-                    break;
-                case 1:
-                    finalColor = PackRGBA(r1, g1, b1, alpha);
-                    break;
-                case 2:
-                    finalColor = PackRGBA((r0 + r1) / 2, (g0 + g1) / 2, (b0 + b1) / 2, alpha);
-                    break;
-                case 3:
-                    finalColor = PackRGBA(0, 0, 0, alpha);
-                    break;
-                }
-
-                if (transparent0 && (finalColor == PackRGBA(0, 0, 0, 0xff)))
-                {
-                    alpha = 0;
-                    finalColor = 0;
-                }
-
-                output[j * outputStride + i] = finalColor;
+            case PixelFormat::DXT1:
+                DecodeBlockDXT1(block, transparent0, output, stride);
+                break;
+            case PixelFormat::DXT3:
+                DecodeBlockDXT3(block, transparent0, output, stride);
+                break;
+            default:
+                DecodeBlockDXT5(block, output, stride);
+                break;
             }
         }
     }
 }
 
+} // end unnamed namespace
+
 /*
 void DecompressBlockDXT1(): Decompresses one block of a DXT1 texture and stores the resulting pixels at the appropriate offset in 'image'.
 
@@ -190,12 +252,7 @@ void DecompressBlockDXT1(uint32_t x,
                          bool transparent0,
                          uint32_t* image)
 {
-    static const uint8_t const_alpha[] = { 255, 255, 255, 255, 255, 255,
-                                           255, 255, 255, 255, 255, 255,
-                                           255, 255, 255, 255 };
-
-    DecompressBlockDXT1Internal(blockStorage, image + x + (y * width), width,
-                                transparent0, const_alpha);
+    DecodeBlockDXT1(blockStorage, transparent0, image + x + (y * width), width);
 }
 
 /*
@@ -211,125 +268,10 @@ void DecompressBlockDXT5(uint32_t x,
                          uint32_t y,
                          uint32_t width,
                          const uint8_t* blockStorage,
-                         bool transparent0,
+                         bool /* transparent0 */,
                          uint32_t* image)
 {
-    uint8_t alpha0, alpha1;
-    const uint8_t* bits;
-    uint32_t alphaCode1;
-    uint16_t alphaCode2;
-
-    uint16_t color0, color1;
-    uint8_t r0, g0, b0, r1, g1, b1;
-
-    int i, j;
-
-    uint32_t temp, code;
-
-    alpha0 = *(blockStorage);
-    alpha1 = *(blockStorage + 1);
-
-    bits = blockStorage + 2;
-    alphaCode1 = bits[2] | (bits[3] << 8) | (bits[4] << 16) | (bits[5] << 24);
-    alphaCode2 = bits[0] | (bits[1] << 8);
-
-    color0 = *(const uint16_t*)(blockStorage + 8);
-    color1 = *(const uint16_t*)(blockStorage + 10);
-
-    temp = (color0 >> 11) * 255 + 16;
-    r0 = (uint8_t)((temp / 32 + temp) / 32);
-    temp = ((color0 & 0x07E0) >> 5) * 255 + 32;
-    g0 = (uint8_t)((temp / 64 + temp) / 64);
-    temp = (color0 & 0x001F) * 255 + 16;
-    b0 = (uint8_t)((temp / 32 + temp) / 32);
-
-    temp = (color1 >> 11) * 255 + 16;
-    r1 = (uint8_t)((temp / 32 + temp) / 32);
-    temp = ((color1 & 0x07E0) >> 5) * 255 + 32;
-    g1 = (uint8_t)((temp / 64 + temp) / 64);
-    temp = (color1 & 0x001F) * 255 + 16;
-    b1 = (uint8_t)((temp / 32 + temp) / 32);
-
-    code = *(const uint32_t*)(blockStorage + 12);
-
-    for (j = 0; j < 4; j++)
-    {
-        for (i = 0; i < 4; i++)
-        {
-            uint8_t finalAlpha;
-            int alphaCode, alphaCodeIndex;
-            uint8_t colorCode;
-            uint32_t finalColor;
-
-            alphaCodeIndex = 3 * (4 * j + i);
-            if (alphaCodeIndex <= 12)
-            {
-                alphaCode = (alphaCode2 >> alphaCodeIndex) & 0x07;
-            }
-            else if (alphaCodeIndex == 15)
-            {
-                alphaCode = (alphaCode2 >> 15) | ((alphaCode1 << 1) & 0x06);
-            }
-            else /* alphaCodeIndex >= 18 && alphaCodeIndex <= 45 */
-            {
-                alphaCode = (alphaCode1 >> (alphaCodeIndex - 16)) & 0x07;
-            }
-
-            if (alphaCode == 0)
-            {
-                finalAlpha = alpha0;
-            }
-            else if (alphaCode == 1)
-            {
-                finalAlpha = alpha1;
-            }
-            else
-            {
-                if (alpha0 > alpha1)
-                {
-                    finalAlpha = (uint8_t)(((8 - alphaCode) * alpha0 + (alphaCode - 1) * alpha1) / 7);
-                }
-                else
-                {
-                    if (alphaCode == 6)
-                    {
-                        finalAlpha = 0;
-                    }
-                    else if (alphaCode == 7)
-                    {
-                        finalAlpha = 255;
-                    }
-                    else
-                    {
-                        finalAlpha = (uint8_t)(((6 - alphaCode) * alpha0 + (alphaCode - 1) * alpha1) / 5);
-                    }
-                }
-            }
-
-            colorCode = (code >> 2 * (4 * j + i)) & 0x03;
-            finalColor = 0;
-
-            switch (colorCode)
-            {
-            case 0:
-                finalColor = PackRGBA(r0, g0, b0, finalAlpha);
-                break;
-            case 1:
-                finalColor = PackRGBA(r1, g1, b1, finalAlpha);
-                break;
-            case 2:
-                finalColor = PackRGBA((2 * r0 + r1) / 3, (2 * g0 + g1) / 3,
-                                      (2 * b0 + b1) / 3, finalAlpha);
-                break;
-            case 3:
-                finalColor = PackRGBA((r0 + 2 * r1) / 3, (g0 + 2 * g1) / 3,
-                                      (b0 + 2 * b1) / 3, finalAlpha);
-                break;
-            }
-
-            image[i + x + (width * (y + j))] = finalColor;
-        }
-    }
+    DecodeBlockDXT5(blockStorage, image + x + (y * width), width);
 }
 
 /*
@@ -337,7 +279,7 @@ void DecompressBlockDXT3(): Decompresses one block of a DXT3 texture and stores
 
 uint32_t x:                     x-coordinate of the first pixel in the block.
 uint32_t y:                     y-coordinate of the first pixel in the block.
-uint32_t height:                height of the texture being decompressed.
+uint32_t width:                 width of the texture being decompressed.
 const uint8_t *blockStorage:    pointer to the block to decompress.
 uint32_t *image:                pointer to image where the decompressed pixel data should be stored.
 */
@@ -348,22 +290,38 @@ void DecompressBlockDXT3(uint32_t x,
                          bool transparent0,
                          uint32_t* image)
 {
-    int i;
-
-    uint8_t alphaValues[16] = { 0 };
+    DecodeBlockDXT3(blockStorage, transparent0, image + x + (y * width), width);
+}
 
-    for (i = 0; i < 4; ++i)
-    {
-        const uint16_t* alphaData = (const uint16_t*)(blockStorage);
+/*
+void DecompressDXT(): Decompresses a whole DXT1/DXT3/DXT5 surface. Large
+surfaces are split into bands of block rows which are decoded in parallel.
 
-        alphaValues[i * 4 + 0] = (((*alphaData) >> 0) & 0xF) * 17;
-        alphaValues[i * 4 + 1] = (((*alphaData) >> 4) & 0xF) * 17;
-        alphaValues[i * 4 + 2] = (((*alphaData) >> 8) & 0xF) * 17;
-        alphaValues[i * 4 + 3] = (((*alphaData) >> 12) & 0xF) * 17;
+PixelFormat format:             DXT1, DXT3 or DXT5.
+const uint8_t *blocks:          the blocks of the surface, in row order.
+uint32_t width, height:         size of the surface in pixels.
+uint32_t *image:                output of ((width + 3) & ~3) * ((height + 3) & ~3) pixels.
+*/
+void DecompressDXT(PixelFormat format,
+                   const uint8_t* blocks,
+                   uint32_t width,
+                   uint32_t height,
+                   bool transparent0,
+                   uint32_t* image)
+{
+    uint32_t blocksWide = (width + 3) / 4;
+    uint32_t blocksHigh = (height + 3) / 4;
 
-        blockStorage += 2;
+    if (celestia::util::GetJobSystem() == nullptr || blocksWide * blocksHigh < MinParallelBlocks)
+    {
+        DecodeBlockRows(format, blocks, blocksWide, 0, blocksHigh, transparent0, image);
+        return;
     }
 
-    DecompressBlockDXT1Internal(blockStorage, image + x + (y * width), width,
-                                transparent0, alphaValues);
+    celestia::util::ParallelFor(0, blocksHigh, BandBlockRows, [=](std::size_t row, std::size_t lastRow)
+    {
+        DecodeBlockRows(format, blocks, blocksWide,
+                        static_cast<uint32_t>(row), static_cast<uint32_t>(lastRow),
+                        transparent0, image);
+    }, celestia::util::JobPriority::Streaming);
 }
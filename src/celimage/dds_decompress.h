@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdint>
+#include <celengine/pixelformat.h>
+
 void DecompressBlockDXT1(uint32_t x, uint32_t y, uint32_t width,
     const uint8_t* blockStorage,
     bool transparent0,
@@ -14,3 +17,9 @@ void DecompressBlockDXT5(uint32_t x, uint32_t y, uint32_t width,
     const uint8_t* blockStorage,
     bool transparent0,
     uint32_t* image);
+
+void DecompressDXT(celestia::PixelFormat format,
+    const uint8_t* blocks,
+    uint32_t width, uint32_t height,
+    bool transparent0,
+    uint32_t* image);
@@ -0,0 +1,315 @@
+// dxt_compress.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Building of mipmaps and DXT compression of images.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <celutil/jobsystem.h>
+#include "dxt_compress.h"
+
+using celestia::PixelFormat;
+
+namespace
+{
+
+// Levels smaller than this many blocks are compressed on the calling thread
+constexpr int MinParallelBlocks = 4096;
+
+// Number of block rows compressed by each task
+constexpr int BandBlockRows = 8;
+
+int
+mipLevelCount(int width, int height)
+{
+    int n = 1;
+    while ((width >> n) > 0 || (height >> n) > 0)
+        n++;
+    return n;
+}
+
+std::uint16_t
+toRGB565(const std::uint8_t* c)
+{
+    return static_cast<std::uint16_t>(((c[0] * 31 + 127) / 255) << 11 |
+                                      ((c[1] * 63 + 127) / 255) << 5 |
+                                      ((c[2] * 31 + 127) / 255));
+}
+
+std::array<int, 3>
+fromRGB565(std::uint16_t c)
+{
+    int r = (c >> 11) & 31;
+    int g = (c >> 5) & 63;
+    int b = c & 31;
+    return { (r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2) };
+}
+
+// Encode the colors of a 4x4 block in the four color mode of DXT1, with
+// the endpoints at the extremes of the block's colors along the axis of
+// largest extent.
+void
+encodeColorBlock(const std::uint8_t rgba[16][4], std::uint8_t* out)
+{
+    int minC[3] = { 255, 255, 255 };
+    int maxC[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            minC[c] = std::min(minC[c], static_cast<int>(rgba[i][c]));
+            maxC[c] = std::max(maxC[c], static_cast<int>(rgba[i][c]));
+        }
+    }
+
+    int axis[3] = { maxC[0] - minC[0], maxC[1] - minC[1], maxC[2] - minC[2] };
+    int lo = 0;
+    int hi = 0;
+    int loDot = INT32_MAX;
+    int hiDot = INT32_MIN;
+    for (int i = 0; i < 16; i++)
+    {
+        int dot = rgba[i][0] * axis[0] + rgba[i][1] * axis[1] + rgba[i][2] * axis[2];
+        if (dot < loDot)
+        {
+            loDot = dot;
+            lo = i;
+        }
+        if (dot > hiDot)
+        {
+            hiDot = dot;
+            hi = i;
+        }
+    }
+
+    std::uint16_t c0 = toRGB565(rgba[hi]);
+    std::uint16_t c1 = toRGB565(rgba[lo]);
+    if (c0 < c1)
+        std::swap(c0, c1);
+
+    std::uint32_t indices = 0;
+    if (c0 != c1)
+    {
+        std::array<int, 3> e0 = fromRGB565(c0);
+        std::array<int, 3> e1 = fromRGB565(c1);
+        int palette[4][3];
+        for (int c = 0; c < 3; c++)
+        {
+            palette[0][c] = e0[c];
+            palette[1][c] = e1[c];
+            palette[2][c] = (2 * e0[c] + e1[c]) / 3;
+            palette[3][c] = (e0[c] + 2 * e1[c]) / 3;
+        }
+
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0;
+            int bestDist = INT32_MAX;
+            for (int p = 0; p < 4; p++)
+            {
+                int dist = 0;
+                for (int c = 0; c < 3; c++)
+                {
+                    int d = rgba[i][c] - palette[p][c];
+                    dist += d * d;
+                }
+                if (dist < bestDist)
+                {
+                    bestDist = dist;
+                    best = p;
+                }
+            }
+            indices |= static_cast<std::uint32_t>(best) << (2 * i);
+        }
+    }
+
+    out[0] = static_cast<std::uint8_t>(c0 & 0xff);
+    out[1] = static_cast<std::uint8_t>(c0 >> 8);
+    out[2] = static_cast<std::uint8_t>(c1 & 0xff);
+    out[3] = static_cast<std::uint8_t>(c1 >> 8);
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = static_cast<std::uint8_t>(indices >> (8 * i));
+}
+
+// Encode the alpha of a 4x4 block in the eight value mode of DXT5
+void
+encodeAlphaBlock(const std::uint8_t rgba[16][4], std::uint8_t* out)
+{
+    int a0 = 0;
+    int a1 = 255;
+    for (int i = 0; i < 16; i++)
+    {
+        a0 = std::max(a0, static_cast<int>(rgba[i][3]));
+        a1 = std::min(a1, static_cast<int>(rgba[i][3]));
+    }
+
+    std::uint64_t indices = 0;
+    if (a0 != a1)
+    {
+        int palette[8] = { a0, a1 };
+        for (int p = 1; p < 7; p++)
+            palette[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0;
+            for (int p = 1; p < 8; p++)
+            {
+                if (std::abs(rgba[i][3] - palette[p]) < std::abs(rgba[i][3] - palette[best]))
+                    best = p;
+            }
+            indices |= static_cast<std::uint64_t>(best) << (3 * i);
+        }
+    }
+
+    out[0] = static_cast<std::uint8_t>(a0);
+    out[1] = static_cast<std::uint8_t>(a1);
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = static_cast<std::uint8_t>(indices >> (8 * i));
+}
+
+// Fetch a 4x4 block as RGBA, repeating the last row and column at the
+// edges of levels that aren't a multiple of 4 in size
+void
+fetchBlock(Image& img, int level, int bx, int by, std::uint8_t rgba[16][4])
+{
+    int w = std::max(img.getWidth() >> level, 1);
+    int h = std::max(img.getHeight() >> level, 1);
+    int components = img.getComponents();
+    bool bgr = img.getFormat() == PixelFormat::BGR || img.getFormat() == PixelFormat::BGRA;
+
+    for (int y = 0; y < 4; y++)
+    {
+        const std::uint8_t* row = img.getPixelRow(level, std::min(by * 4 + y, h - 1));
+        for (int x = 0; x < 4; x++)
+        {
+            const std::uint8_t* p = row + std::min(bx * 4 + x, w - 1) * components;
+            std::uint8_t* dest = rgba[y * 4 + x];
+            switch (components)
+            {
+            case 1:
+                dest[0] = dest[1] = dest[2] = p[0];
+                dest[3] = 255;
+                break;
+            case 2:
+                dest[0] = dest[1] = dest[2] = p[0];
+                dest[3] = p[1];
+                break;
+            default:
+                dest[0] = p[bgr ? 2 : 0];
+                dest[1] = p[1];
+                dest[2] = p[bgr ? 0 : 2];
+                dest[3] = components == 4 ? p[3] : 255;
+                break;
+            }
+        }
+    }
+}
+
+// Compress the block rows [firstRow, lastRow) of a level
+void
+compressBlockRows(Image& img, int level, PixelFormat format,
+                  int blocksWide, int firstRow, int lastRow,
+                  std::uint8_t* blocks)
+{
+    std::size_t blockSize = format == PixelFormat::DXT1 ? 8 : 16;
+    std::uint8_t* out = blocks + static_cast<std::size_t>(firstRow) * blocksWide * blockSize;
+    for (int by = firstRow; by < lastRow; by++)
+    {
+        for (int bx = 0; bx < blocksWide; bx++, out += blockSize)
+        {
+            std::uint8_t rgba[16][4];
+            fetchBlock(img, level, bx, by, rgba);
+            if (format == PixelFormat::DXT1)
+            {
+                encodeColorBlock(rgba, out);
+            }
+            else
+            {
+                encodeAlphaBlock(rgba, out);
+                encodeColorBlock(rgba, out + 8);
+            }
+        }
+    }
+}
+
+} // end unnamed namespace
+
+std::unique_ptr<Image>
+BuildMipmaps(Image& img)
+{
+    int width = img.getWidth();
+    int height = img.getHeight();
+    int components = img.getComponents();
+    int nLevels = mipLevelCount(width, height);
+
+    auto result = std::make_unique<Image>(img.getFormat(), width, height, nLevels);
+    for (int y = 0; y < height; y++)
+        std::memcpy(result->getPixelRow(0, y), img.getPixelRow(y), width * components);
+
+    for (int level = 1; level < nLevels; level++)
+    {
+        int srcWidth = std::max(width >> (level - 1), 1);
+        int srcHeight = std::max(height >> (level - 1), 1);
+        int w = std::max(width >> level, 1);
+        int h = std::max(height >> level, 1);
+        for (int y = 0; y < h; y++)
+        {
+            const std::uint8_t* row0 = result->getPixelRow(level - 1, std::min(y * 2, srcHeight - 1));
+            const std::uint8_t* row1 = result->getPixelRow(level - 1, std::min(y * 2 + 1, srcHeight - 1));
+            std::uint8_t* dest = result->getPixelRow(level, y);
+            for (int x = 0; x < w; x++)
+            {
+                int x0 = std::min(x * 2, srcWidth - 1) * components;
+                int x1 = std::min(x * 2 + 1, srcWidth - 1) * components;
+                for (int c = 0; c < components; c++)
+                {
+                    int sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+                    dest[x * components + c] = static_cast<std::uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+std::unique_ptr<Image>
+CompressDXT(Image& img, PixelFormat format)
+{
+    int width = img.getWidth();
+    int height = img.getHeight();
+    int nLevels = img.getMipLevelCount();
+    auto result = std::make_unique<Image>(format, width, height, nLevels);
+
+    for (int level = 0; level < nLevels; level++)
+    {
+        int blocksWide = (std::max(width >> level, 1) + 3) / 4;
+        int blocksHigh = (std::max(height >> level, 1) + 3) / 4;
+        std::uint8_t* blocks = result->getMipLevel(level);
+        if (celestia::util::GetJobSystem() == nullptr || blocksWide * blocksHigh < MinParallelBlocks)
+        {
+            compressBlockRows(img, level, format, blocksWide, 0, blocksHigh, blocks);
+            continue;
+        }
+
+        celestia::util::ParallelFor(0, blocksHigh, BandBlockRows, [&](std::size_t row, std::size_t lastRow)
+        {
+            compressBlockRows(img, level, format, blocksWide,
+                              static_cast<int>(row), static_cast<int>(lastRow), blocks);
+        }, celestia::util::JobPriority::Streaming);
+    }
+
+    return result;
+}
@@ -0,0 +1,25 @@
+// dxt_compress.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Building of mipmaps and DXT compression of images.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <memory>
+#include <celengine/image.h>
+#include <celengine/pixelformat.h>
+
+// Copy an uncompressed image into an image with the complete set of
+// mipmaps, each level a box filtered version of the one above it
+std::unique_ptr<Image> BuildMipmaps(Image& img);
+
+// Compress all the mip levels of an uncompressed image to DXT1 or DXT5.
+// Luminance is expanded to gray; alpha only images aren't supported. Large
+// levels are compressed in parallel on the job system.
+std::unique_ptr<Image> CompressDXT(Image& img, celestia::PixelFormat format);
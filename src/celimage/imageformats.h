@@ -14,15 +14,23 @@
 
 Image* LoadJPEGImage(const fs::path& filename,
                      int channels = Image::ColorChannel);
+// Decode a JPEG image reduced by 1/2, 1/4 or 1/8, which is much faster than
+// decoding all of it, so that it's at most maxSize pixels wide and high, or
+// as close to that as possible; small images are decoded at full size. The
+// size of the full image is returned in width and height.
+Image* LoadJPEGPreview(const fs::path& filename, int maxSize,
+                       int& width, int& height);
 Image* LoadBMPImage(const fs::path& filename);
 Image* LoadPNGImage(const fs::path& filename);
 Image* LoadDDSImage(const fs::path& filename);
+Image* LoadKTX2Image(const fs::path& filename);
 #ifdef USE_LIBAVIF
 Image* LoadAVIFImage(const fs::path& filename);
 #endif
 
 bool SaveJPEGImage(const fs::path& filename, Image& image);
 bool SavePNGImage(const fs::path& filename, Image& image);
+bool SaveKTX2Image(const fs::path& filename, Image& image);
 
 bool SaveJPEGImage(const fs::path& filename,
                    int width, int height,
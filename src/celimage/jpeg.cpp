@@ -42,9 +42,13 @@ METHODDEF(void) my_error_exit(j_common_ptr cinfo)
     // Return control to the setjmp point
     longjmp(myerr->setjmp_buffer, 1);
 }
-} // anonymous namespace
-
-Image* LoadJPEGImage(const fs::path& filename, int /*unused*/)
+// Decode the image scaled down by 1/scale, where scale is 1, 2, 4 or 8.
+// Scaling is done in the inverse DCT, so reduced images decode much faster.
+// If maxSize is non-zero, the smallest scale for which the image fits in
+// maxSize pixels is chosen instead. The size of the full image is
+// returned in fullWidth and fullHeight.
+Image* LoadJPEG(const fs::path& filename, int maxSize,
+                int& fullWidth, int& fullHeight)
 {
     Image* img = nullptr;
 
@@ -106,8 +110,17 @@ Image* LoadJPEGImage(const fs::path& filename, int /*unused*/)
 
     // Step 4: set parameters for decompression
 
-    // In this example, we don't need to change any of the defaults set by
-    // jpeg_read_header(), so we do nothing here.
+    fullWidth = static_cast<int>(cinfo.image_width);
+    fullHeight = static_cast<int>(cinfo.image_height);
+    unsigned int scale = 1;
+    if (maxSize > 0)
+    {
+        auto size = static_cast<unsigned int>(maxSize);
+        while (scale < 8 && (cinfo.image_width > size * scale || cinfo.image_height > size * scale))
+            scale *= 2;
+    }
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = scale;
 
     // Step 5: Start decompressor
 
@@ -136,7 +149,7 @@ Image* LoadJPEGImage(const fs::path& filename, int /*unused*/)
     if (cinfo.output_components == 1)
         format = PixelFormat::LUMINANCE;
 
-    img = new Image(format, cinfo.image_width, cinfo.image_height);
+    img = new Image(format, cinfo.output_width, cinfo.output_height);
 
     // cont = cinfo.output_height - 1;
     cont = 0;
@@ -176,6 +189,20 @@ Image* LoadJPEGImage(const fs::path& filename, int /*unused*/)
 
     return img;
 }
+} // anonymous namespace
+
+Image* LoadJPEGImage(const fs::path& filename, int /*unused*/)
+{
+    int width;
+    int height;
+    return LoadJPEG(filename, 0, width, height);
+}
+
+Image* LoadJPEGPreview(const fs::path& filename, int maxSize,
+                       int& width, int& height)
+{
+    return LoadJPEG(filename, maxSize, width, height);
+}
 
 bool SaveJPEGImage(const fs::path& filename,
                    int width, int height,
@@ -0,0 +1,445 @@
+// ktx2.cpp
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// Reading and writing KTX 2.0 textures with precomputed mipmaps.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include <vector>
+#include <celengine/glsupport.h>
+#include <celengine/image.h>
+#include <celutil/binaryread.h>
+#include <celutil/binarywrite.h>
+#include <celutil/logger.h>
+#include "dds_decompress.h"
+#include "ktx2.h"
+
+using namespace celestia;
+using celestia::util::GetLogger;
+
+namespace celutil = celestia::util;
+
+namespace
+{
+
+bool isCompressed(PixelFormat format)
+{
+    return format == PixelFormat::DXT1 ||
+           format == PixelFormat::DXT3 ||
+           format == PixelFormat::DXT5;
+}
+
+// Bytes per texel, or per 4x4 block for compressed formats
+std::uint32_t texelBlockSize(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::LUMINANCE:
+    case PixelFormat::ALPHA:
+        return 1;
+    case PixelFormat::LUM_ALPHA:
+        return 2;
+    case PixelFormat::RGB:
+    case PixelFormat::BGR:
+        return 3;
+    case PixelFormat::RGBA:
+    case PixelFormat::BGRA:
+        return 4;
+    case PixelFormat::DXT1:
+        return 8;
+    case PixelFormat::DXT3:
+    case PixelFormat::DXT5:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+// Size of a level in the file, where rows aren't padded
+std::uint64_t packedLevelSize(PixelFormat format, int width, int height, int mip)
+{
+    std::uint64_t w = std::max(width >> mip, 1);
+    std::uint64_t h = std::max(height >> mip, 1);
+    if (isCompressed(format))
+        return ((w + 3) / 4) * ((h + 3) / 4) * texelBlockSize(format);
+    return w * h * texelBlockSize(format);
+}
+
+// A KTX2 level of width texels per row to the 4 byte aligned rows of Image
+void unpackRows(const std::uint8_t* src, std::uint8_t* dest, int width, int height, int components)
+{
+    int rowSize = width * components;
+    int pitch = (rowSize + 3) & ~0x3;
+    for (int y = 0; y < height; y++)
+        std::memcpy(dest + y * pitch, src + y * rowSize, rowSize);
+}
+
+// Decompress the first level of img, for drivers without S3TC support
+Image* decompressImage(Image& img)
+{
+    auto width = (std::uint32_t) img.getWidth();
+    auto height = (std::uint32_t) img.getHeight();
+    std::uint32_t paddedWidth = (width + 3) & ~3u;
+    std::uint32_t paddedHeight = (height + 3) & ~3u;
+    bool transparent0 = img.getFormat() == PixelFormat::DXT1;
+
+    std::vector<std::uint32_t> pixels(paddedWidth * paddedHeight);
+    DecompressDXT(img.getFormat(), img.getMipLevel(0), width, height, transparent0, pixels.data());
+
+    // As for DDS files, DXT1 textures are deemed not to have alpha
+    int components = transparent0 ? 3 : 4;
+    auto* result = new Image(transparent0 ? PixelFormat::RGB : PixelFormat::RGBA,
+                             (int) width, (int) height);
+    for (std::uint32_t y = 0; y < height; y++)
+    {
+        auto* src = reinterpret_cast<const std::uint8_t*>(pixels.data() + y * paddedWidth);
+        std::uint8_t* dest = result->getPixelRow((int) y);
+        for (std::uint32_t x = 0; x < width; x++)
+            std::memcpy(dest + x * components, src + x * 4, components);
+    }
+
+    return result;
+}
+
+std::uint32_t toVkFormat(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::LUMINANCE:
+        return ktx2::VK_FORMAT_R8_UNORM;
+    case PixelFormat::LUM_ALPHA:
+        return ktx2::VK_FORMAT_R8G8_UNORM;
+    case PixelFormat::RGB:
+        return ktx2::VK_FORMAT_R8G8B8_UNORM;
+    case PixelFormat::BGR:
+        return ktx2::VK_FORMAT_B8G8R8_UNORM;
+    case PixelFormat::RGBA:
+        return ktx2::VK_FORMAT_R8G8B8A8_UNORM;
+    case PixelFormat::BGRA:
+        return ktx2::VK_FORMAT_B8G8R8A8_UNORM;
+    case PixelFormat::DXT1:
+        return ktx2::VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    case PixelFormat::DXT3:
+        return ktx2::VK_FORMAT_BC2_UNORM_BLOCK;
+    case PixelFormat::DXT5:
+        return ktx2::VK_FORMAT_BC3_UNORM_BLOCK;
+    default:
+        return ktx2::VK_FORMAT_UNDEFINED;
+    }
+}
+
+// Basic data format descriptor of the Khronos Data Format specification
+std::vector<std::uint32_t> dataFormatDescriptor(PixelFormat format)
+{
+    constexpr std::uint32_t ModelRGBSDA = 1;
+    constexpr std::uint32_t ModelBC1A = 128;
+    constexpr std::uint32_t ModelBC2 = 129;
+    constexpr std::uint32_t ModelBC3 = 130;
+    constexpr std::uint32_t PrimariesBT709 = 1;
+    constexpr std::uint32_t TransferLinear = 1;
+    constexpr std::uint32_t ChannelRed = 0;
+    constexpr std::uint32_t ChannelGreen = 1;
+    constexpr std::uint32_t ChannelBlue = 2;
+    constexpr std::uint32_t ChannelAlpha = 15;
+    constexpr std::uint32_t ChannelColor = 0;
+
+    struct Sample
+    {
+        std::uint32_t channel;
+        std::uint32_t bitOffset;
+        std::uint32_t bitLength;
+        std::uint32_t upper;
+    };
+
+    std::uint32_t model = ModelRGBSDA;
+    std::vector<Sample> samples;
+    switch (format)
+    {
+    case PixelFormat::LUMINANCE:
+        samples = { { ChannelRed, 0, 8, 255 } };
+        break;
+    case PixelFormat::LUM_ALPHA:
+        samples = { { ChannelRed, 0, 8, 255 }, { ChannelGreen, 8, 8, 255 } };
+        break;
+    case PixelFormat::RGB:
+        samples = { { ChannelRed, 0, 8, 255 }, { ChannelGreen, 8, 8, 255 }, { ChannelBlue, 16, 8, 255 } };
+        break;
+    case PixelFormat::BGR:
+        samples = { { ChannelBlue, 0, 8, 255 }, { ChannelGreen, 8, 8, 255 }, { ChannelRed, 16, 8, 255 } };
+        break;
+    case PixelFormat::RGBA:
+        samples = { { ChannelRed, 0, 8, 255 }, { ChannelGreen, 8, 8, 255 },
+                    { ChannelBlue, 16, 8, 255 }, { ChannelAlpha, 24, 8, 255 } };
+        break;
+    case PixelFormat::BGRA:
+        samples = { { ChannelBlue, 0, 8, 255 }, { ChannelGreen, 8, 8, 255 },
+                    { ChannelRed, 16, 8, 255 }, { ChannelAlpha, 24, 8, 255 } };
+        break;
+    case PixelFormat::DXT1:
+        model = ModelBC1A;
+        samples = { { ChannelColor, 0, 64, 0xffffffff } };
+        break;
+    case PixelFormat::DXT3:
+        model = ModelBC2;
+        samples = { { ChannelAlpha, 0, 64, 0xffffffff }, { ChannelColor, 64, 64, 0xffffffff } };
+        break;
+    default:
+        model = ModelBC3;
+        samples = { { ChannelAlpha, 0, 64, 0xffffffff }, { ChannelColor, 64, 64, 0xffffffff } };
+        break;
+    }
+
+    auto blockSize = (std::uint32_t) (24 + 16 * samples.size());
+    std::vector<std::uint32_t> dfd;
+    dfd.push_back(4 + blockSize);
+    dfd.push_back(0); // Khronos vendor, basic descriptor type
+    dfd.push_back(2 | (blockSize << 16)); // version 1.3
+    dfd.push_back(model | (PrimariesBT709 << 8) | (TransferLinear << 16));
+    dfd.push_back(isCompressed(format) ? (3 | (3 << 8)) : 0);
+    dfd.push_back(texelBlockSize(format));
+    dfd.push_back(0);
+    for (const Sample& sample : samples)
+    {
+        dfd.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | (sample.channel << 24));
+        dfd.push_back(0);
+        dfd.push_back(0);
+        dfd.push_back(sample.upper);
+    }
+
+    return dfd;
+}
+
+void writePadding(std::ostream& out, std::uint64_t& offset, std::uint64_t alignment)
+{
+    while (offset % alignment != 0)
+    {
+        out.put('\0');
+        offset++;
+    }
+}
+
+} // anonymous namespace
+
+
+Image* LoadKTX2Image(const fs::path& filename)
+{
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in.good())
+    {
+        GetLogger()->error("Error opening KTX2 texture file {}.\n", filename);
+        return nullptr;
+    }
+
+    std::uint8_t header[ktx2::HeaderSize];
+    if (!in.read(reinterpret_cast<char*>(header), sizeof(header)).good() ||
+        std::memcmp(header, ktx2::Identifier, sizeof(ktx2::Identifier)) != 0)
+    {
+        GetLogger()->error("KTX2 texture file {} has bad header.\n", filename);
+        return nullptr;
+    }
+
+    auto vkFormat = celutil::fromMemoryLE<std::uint32_t>(header + 12);
+    auto width = celutil::fromMemoryLE<std::uint32_t>(header + 20);
+    auto height = celutil::fromMemoryLE<std::uint32_t>(header + 24);
+    auto depth = celutil::fromMemoryLE<std::uint32_t>(header + 28);
+    auto layerCount = celutil::fromMemoryLE<std::uint32_t>(header + 32);
+    auto faceCount = celutil::fromMemoryLE<std::uint32_t>(header + 36);
+    auto levelCount = celutil::fromMemoryLE<std::uint32_t>(header + 40);
+    auto supercompression = celutil::fromMemoryLE<std::uint32_t>(header + 44);
+
+    // Basis Universal and Zstandard payloads need their decoders
+    if (supercompression != ktx2::SupercompressionNone)
+    {
+        GetLogger()->error("Supercompressed KTX2 texture file {} isn't supported.\n", filename);
+        return nullptr;
+    }
+
+    if (depth > 1 || layerCount > 1 || faceCount != 1)
+    {
+        GetLogger()->error("KTX2 texture file {} isn't a 2D texture.\n", filename);
+        return nullptr;
+    }
+
+    PixelFormat format = ktx2::ToPixelFormat(vkFormat);
+    if (format == PixelFormat::INVALID)
+    {
+        GetLogger()->error("Unsupported format {} for KTX2 texture file {}.\n", vkFormat, filename);
+        return nullptr;
+    }
+
+    std::uint32_t nLevels = std::max(levelCount, 1u);
+    if (width == 0 || height == 0 || width > 65536 || height > 65536 ||
+        nLevels > 17 || (std::max(width, height) >> (nLevels - 1)) == 0)
+    {
+        GetLogger()->error("KTX2 texture file {} has bad dimensions.\n", filename);
+        return nullptr;
+    }
+
+    std::vector<std::uint8_t> levelIndex(nLevels * ktx2::LevelIndexEntrySize);
+    if (!in.read(reinterpret_cast<char*>(levelIndex.data()), levelIndex.size()).good())
+    {
+        GetLogger()->error("KTX2 texture file {} has bad level index.\n", filename);
+        return nullptr;
+    }
+
+    auto img = std::make_unique<Image>(format, (int) width, (int) height, (int) nLevels);
+    std::vector<std::uint8_t> buffer;
+    for (std::uint32_t level = 0; level < nLevels; level++)
+    {
+        const std::uint8_t* entry = levelIndex.data() + level * ktx2::LevelIndexEntrySize;
+        auto offset = celutil::fromMemoryLE<std::uint64_t>(entry);
+        auto length = celutil::fromMemoryLE<std::uint64_t>(entry + 8);
+        if (length != packedLevelSize(format, (int) width, (int) height, (int) level))
+        {
+            GetLogger()->error("KTX2 texture file {} has bad size for level {}.\n", filename, level);
+            return nullptr;
+        }
+
+        in.seekg((std::streamoff) offset);
+        std::uint8_t* dest = img->getMipLevel((int) level);
+        if (isCompressed(format))
+        {
+            in.read(reinterpret_cast<char*>(dest), (std::streamsize) length);
+        }
+        else
+        {
+            buffer.resize(length);
+            in.read(reinterpret_cast<char*>(buffer.data()), (std::streamsize) length);
+            unpackRows(buffer.data(), dest,
+                       std::max((int) width >> level, 1),
+                       std::max((int) height >> level, 1),
+                       img->getComponents());
+        }
+
+        if (!in.good())
+        {
+            GetLogger()->error("Failed reading data from KTX2 texture file {}.\n", filename);
+            return nullptr;
+        }
+    }
+
+    if (isCompressed(format) && !gl::EXT_texture_compression_s3tc)
+        return decompressImage(*img);
+
+    return img.release();
+}
+
+
+bool SaveKTX2Image(const fs::path& filename, Image& image)
+{
+    PixelFormat format = image.getFormat();
+    std::uint32_t vkFormat = toVkFormat(format);
+    if (vkFormat == ktx2::VK_FORMAT_UNDEFINED)
+    {
+        GetLogger()->error("Can't write an image in this format to KTX2 file {}.\n", filename);
+        return false;
+    }
+
+    std::ofstream out(filename, std::ios::out | std::ios::binary);
+    if (!out.good())
+    {
+        GetLogger()->error("Can't open KTX2 file {} for writing.\n", filename);
+        return false;
+    }
+
+    int width = image.getWidth();
+    int height = image.getHeight();
+    auto nLevels = (std::uint32_t) image.getMipLevelCount();
+
+    std::vector<std::uint32_t> dfd = dataFormatDescriptor(format);
+    const char writerKey[] = "KTXwriter";
+    const char writerValue[] = "Celestia";
+    auto kvdLength = (std::uint32_t) (sizeof(writerKey) + sizeof(writerValue));
+    std::uint32_t kvdPadding = (4 - kvdLength % 4) % 4;
+
+    std::uint64_t dfdOffset = ktx2::HeaderSize + nLevels * ktx2::LevelIndexEntrySize;
+    std::uint64_t kvdOffset = dfdOffset + dfd.size() * 4;
+    std::uint64_t dataOffset = kvdOffset + 4 + kvdLength + kvdPadding;
+
+    // Levels are stored from the smallest up, each aligned to a whole
+    // number of texel blocks and of 4 bytes
+    std::uint64_t alignment = std::lcm<std::uint64_t>(texelBlockSize(format), 4);
+    std::vector<std::uint64_t> levelOffsets(nLevels);
+    std::uint64_t offset = dataOffset;
+    for (std::uint32_t level = nLevels; level-- > 0;)
+    {
+        offset = (offset + alignment - 1) / alignment * alignment;
+        levelOffsets[level] = offset;
+        offset += packedLevelSize(format, width, height, (int) level);
+    }
+
+    out.write(reinterpret_cast<const char*>(ktx2::Identifier), sizeof(ktx2::Identifier));
+    celutil::writeLE<std::uint32_t>(out, vkFormat);
+    celutil::writeLE<std::uint32_t>(out, 1);
+    celutil::writeLE<std::uint32_t>(out, (std::uint32_t) width);
+    celutil::writeLE<std::uint32_t>(out, (std::uint32_t) height);
+    celutil::writeLE<std::uint32_t>(out, 0);
+    celutil::writeLE<std::uint32_t>(out, 0);
+    celutil::writeLE<std::uint32_t>(out, 1);
+    celutil::writeLE<std::uint32_t>(out, nLevels);
+    celutil::writeLE<std::uint32_t>(out, ktx2::SupercompressionNone);
+    celutil::writeLE<std::uint32_t>(out, (std::uint32_t) dfdOffset);
+    celutil::writeLE<std::uint32_t>(out, (std::uint32_t) (dfd.size() * 4));
+    celutil::writeLE<std::uint32_t>(out, (std::uint32_t) kvdOffset);
+    celutil::writeLE<std::uint32_t>(out, 4 + kvdLength + kvdPadding);
+    celutil::writeLE<std::uint64_t>(out, 0);
+    celutil::writeLE<std::uint64_t>(out, 0);
+
+    for (std::uint32_t level = 0; level < nLevels; level++)
+    {
+        std::uint64_t size = packedLevelSize(format, width, height, (int) level);
+        celutil::writeLE<std::uint64_t>(out, levelOffsets[level]);
+        celutil::writeLE<std::uint64_t>(out, size);
+        celutil::writeLE<std::uint64_t>(out, size);
+    }
+
+    for (std::uint32_t word : dfd)
+        celutil::writeLE<std::uint32_t>(out, word);
+
+    celutil::writeLE<std::uint32_t>(out, kvdLength);
+    out.write(writerKey, sizeof(writerKey));
+    out.write(writerValue, sizeof(writerValue));
+
+    for (std::uint32_t i = 0; i < kvdPadding; i++)
+        out.put('\0');
+
+    offset = dataOffset;
+    for (std::uint32_t level = nLevels; level-- > 0;)
+    {
+        writePadding(out, offset, alignment);
+        const std::uint8_t* data = image.getMipLevel((int) level);
+        std::uint64_t size = packedLevelSize(format, width, height, (int) level);
+        if (isCompressed(format))
+        {
+            out.write(reinterpret_cast<const char*>(data), (std::streamsize) size);
+        }
+        else
+        {
+            // Drop the row padding of Image
+            int w = std::max(width >> level, 1);
+            int h = std::max(height >> level, 1);
+            int rowSize = w * image.getComponents();
+            int pitch = (rowSize + 3) & ~0x3;
+            for (int y = 0; y < h; y++)
+                out.write(reinterpret_cast<const char*>(data + y * pitch), rowSize);
+        }
+        offset += size;
+    }
+
+    if (!out.good())
+    {
+        GetLogger()->error("Error writing KTX2 file {}.\n", filename);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,96 @@
+// ktx2.h
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// Constants of the KTX 2.0 texture container format.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <celengine/pixelformat.h>
+
+namespace celestia::ktx2
+{
+
+constexpr std::uint8_t Identifier[12] =
+{
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+
+// Identifier, then 9 header fields, then the index
+constexpr std::size_t HeaderSize = 80;
+constexpr std::size_t LevelIndexEntrySize = 24;
+
+constexpr std::uint32_t SupercompressionNone = 0;
+
+// The Vulkan formats which have a PixelFormat. sRGB variants are read as
+// their UNORM counterparts, as JPEG and PNG images are.
+enum VkFormat : std::uint32_t
+{
+    VK_FORMAT_UNDEFINED            = 0,
+    VK_FORMAT_R8_UNORM             = 9,
+    VK_FORMAT_R8_SRGB              = 15,
+    VK_FORMAT_R8G8_UNORM           = 16,
+    VK_FORMAT_R8G8_SRGB            = 22,
+    VK_FORMAT_R8G8B8_UNORM         = 23,
+    VK_FORMAT_R8G8B8_SRGB          = 29,
+    VK_FORMAT_B8G8R8_UNORM         = 30,
+    VK_FORMAT_B8G8R8_SRGB          = 36,
+    VK_FORMAT_R8G8B8A8_UNORM       = 37,
+    VK_FORMAT_R8G8B8A8_SRGB        = 43,
+    VK_FORMAT_B8G8R8A8_UNORM       = 44,
+    VK_FORMAT_B8G8R8A8_SRGB        = 50,
+    VK_FORMAT_BC1_RGB_UNORM_BLOCK  = 131,
+    VK_FORMAT_BC1_RGB_SRGB_BLOCK   = 132,
+    VK_FORMAT_BC1_RGBA_UNORM_BLOCK = 133,
+    VK_FORMAT_BC1_RGBA_SRGB_BLOCK  = 134,
+    VK_FORMAT_BC2_UNORM_BLOCK      = 135,
+    VK_FORMAT_BC2_SRGB_BLOCK       = 136,
+    VK_FORMAT_BC3_UNORM_BLOCK      = 137,
+    VK_FORMAT_BC3_SRGB_BLOCK       = 138,
+};
+
+inline PixelFormat ToPixelFormat(std::uint32_t vkFormat)
+{
+    switch (vkFormat)
+    {
+    case VK_FORMAT_R8_UNORM:
+    case VK_FORMAT_R8_SRGB:
+        return PixelFormat::LUMINANCE;
+    case VK_FORMAT_R8G8_UNORM:
+    case VK_FORMAT_R8G8_SRGB:
+        return PixelFormat::LUM_ALPHA;
+    case VK_FORMAT_R8G8B8_UNORM:
+    case VK_FORMAT_R8G8B8_SRGB:
+        return PixelFormat::RGB;
+    case VK_FORMAT_B8G8R8_UNORM:
+    case VK_FORMAT_B8G8R8_SRGB:
+        return PixelFormat::BGR;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        return PixelFormat::RGBA;
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+        return PixelFormat::BGRA;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        return PixelFormat::DXT1;
+    case VK_FORMAT_BC2_UNORM_BLOCK:
+    case VK_FORMAT_BC2_SRGB_BLOCK:
+        return PixelFormat::DXT3;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+        return PixelFormat::DXT5;
+    default:
+        return PixelFormat::INVALID;
+    }
+}
+
+} // end namespace celestia::ktx2
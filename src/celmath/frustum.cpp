@@ -7,7 +7,9 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <cmath>
+#include <limits>
 
 #include <Eigen/LU>
 
@@ -17,6 +19,26 @@
 namespace celmath
 {
 
+namespace
+{
+// Number of objects tested together by the batch tests; the arrays are
+// split into SIMD registers by Eigen.
+constexpr std::size_t BatchSize = 8;
+using BatchArray = Eigen::Array<float, BatchSize, 1>;
+
+void setVisibleBits(const BatchArray& minDistance,
+                    std::size_t first,
+                    std::size_t n,
+                    std::vector<std::uint32_t>& visible)
+{
+    for (std::size_t i = 0; i < n; i++)
+    {
+        if (minDistance[i] >= 0.0f)
+            visible[(first + i) / 32] |= UINT32_C(1) << ((first + i) % 32);
+    }
+}
+} // end unnamed namespace
+
 Frustum::Frustum(float fov, float aspectRatio, float n) :
     infinite(true)
 {
@@ -109,6 +131,83 @@ Frustum::testSphere(const Eigen::Vector3d& center, double radius) const
 }
 
 
+void
+Frustum::testSpheres(const Eigen::Vector3f* centers,
+                     const float* radii,
+                     std::size_t count,
+                     std::vector<std::uint32_t>& visible) const
+{
+    unsigned int nPlanes = infinite ? 5 : 6;
+    visible.assign((count + 31) / 32, 0);
+
+    BatchArray x, y, z, r;
+    for (std::size_t first = 0; first < count; first += BatchSize)
+    {
+        std::size_t n = std::min(BatchSize, count - first);
+        for (std::size_t i = 0; i < BatchSize; i++)
+        {
+            // Repeat the last sphere to fill an incomplete batch
+            std::size_t j = first + std::min(i, n - 1);
+            x[i] = centers[j].x();
+            y[i] = centers[j].y();
+            z[i] = centers[j].z();
+            r[i] = radii[j];
+        }
+
+        // A sphere is outside if it is farther than its radius behind
+        // any plane.
+        BatchArray minDistance = BatchArray::Constant(std::numeric_limits<float>::max());
+        for (unsigned int p = 0; p < nPlanes; p++)
+        {
+            const auto& coeffs = planes[p].coeffs();
+            minDistance = minDistance.min(x * coeffs[0] + y * coeffs[1] + z * coeffs[2] + coeffs[3] + r);
+        }
+
+        setVisibleBits(minDistance, first, n, visible);
+    }
+}
+
+
+void
+Frustum::testBoxes(const Eigen::AlignedBox3f* boxes,
+                   std::size_t count,
+                   std::vector<std::uint32_t>& visible) const
+{
+    unsigned int nPlanes = infinite ? 5 : 6;
+    visible.assign((count + 31) / 32, 0);
+
+    BatchArray x, y, z, ex, ey, ez;
+    for (std::size_t first = 0; first < count; first += BatchSize)
+    {
+        std::size_t n = std::min(BatchSize, count - first);
+        for (std::size_t i = 0; i < BatchSize; i++)
+        {
+            const Eigen::AlignedBox3f& box = boxes[first + std::min(i, n - 1)];
+            Eigen::Vector3f center = box.center();
+            Eigen::Vector3f extent = box.max() - center;
+            x[i] = center.x();
+            y[i] = center.y();
+            z[i] = center.z();
+            ex[i] = extent.x();
+            ey[i] = extent.y();
+            ez[i] = extent.z();
+        }
+
+        // A box is outside if its corner farthest along the normal of any
+        // plane is behind it.
+        BatchArray minDistance = BatchArray::Constant(std::numeric_limits<float>::max());
+        for (unsigned int p = 0; p < nPlanes; p++)
+        {
+            const auto& coeffs = planes[p].coeffs();
+            minDistance = minDistance.min(x * coeffs[0] + y * coeffs[1] + z * coeffs[2] + coeffs[3] +
+                                          ex * std::abs(coeffs[0]) + ey * std::abs(coeffs[1]) + ez * std::abs(coeffs[2]));
+        }
+
+        setVisibleBits(minDistance, first, n, visible);
+    }
+}
+
+
 void
 Frustum::transform(const Eigen::Matrix3f& m)
 {
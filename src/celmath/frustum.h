@@ -9,6 +9,9 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <vector>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
@@ -51,6 +54,23 @@ class Frustum
     Aspect testSphere(const Eigen::Vector3f& center, float radius) const;
     Aspect testSphere(const Eigen::Vector3d& center, double radius) const;
 
+    // Test count spheres or boxes against the frustum several at a time.
+    // Bit i % 32 of visible[i / 32] is set if object i is not entirely
+    // outside of the frustum, which is the same as testSphere() not
+    // returning Outside.
+    void testSpheres(const Eigen::Vector3f* centers,
+                     const float* radii,
+                     std::size_t count,
+                     std::vector<std::uint32_t>& visible) const;
+    void testBoxes(const Eigen::AlignedBox3f* boxes,
+                   std::size_t count,
+                   std::vector<std::uint32_t>& visible) const;
+
+    static inline bool isVisible(const std::vector<std::uint32_t>& visible, std::size_t index)
+    {
+        return (visible[index / 32] & (UINT32_C(1) << (index % 32))) != 0;
+    }
+
  private:
     void init(float, float, float, float);
 
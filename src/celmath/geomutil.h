@@ -167,6 +167,24 @@ Perspective(T fovy, T aspect, T nearZ, T farZ)
     return m;
 }
 
+/*! Return a perspective projection matrix mapping the near plane to the
+ *  depth 1 and the far plane to 0, for a depth range of 0 to 1 set with
+ *  glClipControl. With a floating point depth buffer the precision is then
+ *  nearly constant relative to the distance.
+ */
+template<class T> Eigen::Matrix<T, 4, 4>
+PerspectiveReverseZ(T fovy, T aspect, T nearZ, T farZ)
+{
+    Eigen::Matrix<T, 4, 4> m = Perspective(fovy, aspect, nearZ, farZ);
+    T deltaZ = farZ - nearZ;
+    if (m(3, 3) != static_cast<T>(0) || deltaZ == static_cast<T>(0))
+        return m;
+
+    m(2, 2) = nearZ / deltaZ;
+    m(2, 3) = nearZ * farZ / deltaZ;
+    return m;
+}
+
 /*! Return an orthographic projection matrix
  */
 template<class T> Eigen::Matrix<T, 4, 4>
@@ -0,0 +1,94 @@
+// healpix.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Geometry of the nested HEALPix tessellation of the sphere.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <array>
+#include <cmath>
+
+#include <celcompat/numbers.h>
+#include "healpix.h"
+
+namespace celmath
+{
+namespace
+{
+// Ring of the south corner of each base pixel, in units of the rings of
+// order zero, and its longitude in units of pi/4
+constexpr std::array<int, 12> jrll{ 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4 };
+constexpr std::array<int, 12> jpll{ 1, 3, 5, 7, 0, 2, 4, 6, 1, 3, 5, 7 };
+
+// Gather the even bits of v into its low half
+std::uint32_t
+compressBits(std::uint64_t v)
+{
+    v &= UINT64_C(0x5555555555555555);
+    v = (v | (v >> 1)) & UINT64_C(0x3333333333333333);
+    v = (v | (v >> 2)) & UINT64_C(0x0f0f0f0f0f0f0f0f);
+    v = (v | (v >> 4)) & UINT64_C(0x00ff00ff00ff00ff);
+    v = (v | (v >> 8)) & UINT64_C(0x0000ffff0000ffff);
+    v = (v | (v >> 16)) & UINT64_C(0x00000000ffffffff);
+    return static_cast<std::uint32_t>(v);
+}
+} // end unnamed namespace
+
+Eigen::Vector3d
+HealpixNestedToVector(int order, std::uint64_t pixel, double x, double y)
+{
+    const double nside = static_cast<double>(UINT64_C(1) << order);
+    const auto face = static_cast<int>(pixel >> (2 * order));
+    const std::uint64_t facePixel = pixel & ((UINT64_C(1) << (2 * order)) - 1);
+
+    // Position in the base pixel, from 0 to 1
+    double fx = (compressBits(facePixel) + x) / nside;
+    double fy = (compressBits(facePixel >> 1) + y) / nside;
+
+    // Distance from the north pole in rings of order zero
+    double jr = jrll[face] - fx - fy;
+    double nr;
+    double z;
+    double sinTheta;
+    if (jr < 1.0)
+    {
+        // North polar cap
+        nr = jr;
+        double t = nr * nr / 3.0;
+        z = 1.0 - t;
+        sinTheta = std::sqrt(t * (2.0 - t));
+    }
+    else if (jr > 3.0)
+    {
+        // South polar cap
+        nr = 4.0 - jr;
+        double t = nr * nr / 3.0;
+        z = t - 1.0;
+        sinTheta = std::sqrt(t * (2.0 - t));
+    }
+    else
+    {
+        nr = 1.0;
+        z = (2.0 - jr) * 2.0 / 3.0;
+        sinTheta = std::sqrt((1.0 - z) * (1.0 + z));
+    }
+
+    double phi = 0.0;
+    if (nr > 1.0e-15)
+    {
+        double t = jpll[face] * nr + fx - fy;
+        if (t < 0.0)
+            t += 8.0;
+        else if (t >= 8.0)
+            t -= 8.0;
+        phi = celestia::numbers::pi * 0.25 * t / nr;
+    }
+
+    return Eigen::Vector3d(sinTheta * std::cos(phi), sinTheta * std::sin(phi), z);
+}
+
+} // end namespace celmath
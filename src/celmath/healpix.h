@@ -0,0 +1,35 @@
+// healpix.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Geometry of the nested HEALPix tessellation of the sphere.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+
+#include <Eigen/Core>
+
+namespace celmath
+{
+
+// Number of pixels of a HEALPix order: 12 * 4^order
+constexpr std::uint64_t
+HealpixPixelCount(int order)
+{
+    return UINT64_C(12) << (2 * order);
+}
+
+// Unit vector at the point (x, y) of the nested pixel of order, with x and
+// y from 0 to 1 across the pixel: (0, 0) is its south corner, (1, 1) its
+// north corner, and x grows eastward. The vector is in the frame of the
+// sphere: z points to its north pole and x to longitude zero.
+Eigen::Vector3d HealpixNestedToVector(int order, std::uint64_t pixel,
+                                      double x = 0.5, double y = 0.5);
+
+} // end namespace celmath
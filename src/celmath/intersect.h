@@ -132,4 +132,31 @@ template<class T> bool testIntersection(const Eigen::ParametrizedLine<T, 3>& ray
     }
     return false;
 }
+
+// Return true if the object sphere is entirely hidden behind the occluder
+// sphere, as seen from the origin. The test is conservative: an object
+// that is only partly hidden, or hidden by a small margin, isn't reported.
+template<class T> bool isOccluded(const Sphere<T>& occluder,
+                                  const Sphere<T>& object)
+{
+    using std::asin;
+    using std::atan2;
+    using std::sqrt;
+
+    T occluderDistance = occluder.center.norm();
+    T objectDistance = object.center.norm();
+    if (occluderDistance <= occluder.radius || objectDistance <= object.radius)
+        return false;
+
+    // The nearest point of the object must be farther than the silhouette
+    // of the occluder, where the ray grazing it leaves the occluder.
+    T silhouetteDistance = sqrt(square(occluderDistance) - square(occluder.radius));
+    if (objectDistance - object.radius <= silhouetteDistance)
+        return false;
+
+    // And the cone around the object must be inside the cone around the
+    // occluder.
+    T angle = atan2(occluder.center.cross(object.center).norm(), occluder.center.dot(object.center));
+    return angle + asin(object.radius / objectDistance) < asin(occluder.radius / occluderDistance);
+}
 } // namespace celmath
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cmath>
+#include <cstdint>
 #include <random>
 
 #include <Eigen/Core>
@@ -60,4 +61,46 @@ Eigen::Matrix<T, 3, 1> randomOnSphere(RNG&& rng)
 }
 
 std::mt19937& getRNG();
+
+/**
+ * Counter-based random number generator: the n-th number of a stream is a
+ * hash of the seed, the stream and n. Streams drawn on different threads,
+ * in any order, give the same numbers, which makes results computed in
+ * parallel independent of the number of threads. Models
+ * UniformRandomBitGenerator, so it can be used with the standard
+ * distributions.
+ */
+class CounterRNG
+{
+ public:
+    using result_type = std::uint32_t;
+
+    constexpr CounterRNG(std::uint64_t seed, std::uint64_t stream) :
+        m_key(mix(seed ^ mix(stream + Increment)))
+    {
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT32_MAX; }
+
+    constexpr result_type operator()()
+    {
+        ++m_counter;
+        return static_cast<result_type>(mix(m_key + m_counter * Increment) >> 32);
+    }
+
+ private:
+    static constexpr std::uint64_t Increment = UINT64_C(0x9e3779b97f4a7c15);
+
+    // Finalizer of SplitMix64
+    static constexpr std::uint64_t mix(std::uint64_t z)
+    {
+        z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+        z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+        return z ^ (z >> 31);
+    }
+
+    std::uint64_t m_key;
+    std::uint64_t m_counter{ 0 };
+};
 }
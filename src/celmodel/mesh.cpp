@@ -10,9 +10,15 @@
 
 #include <algorithm>
 #include <array>
+#include <cmath>
 #include <cstring>
+#include <functional>
 #include <iterator>
+#include <limits>
+#include <memory>
+#include <numeric>
 #include <tuple>
+#include <unordered_map>
 #include <utility>
 #include <celutil/logger.h>
 
@@ -21,6 +27,7 @@
 #endif
 
 #include "mesh.h"
+#include "simplify.h"
 
 using celestia::util::GetLogger;
 
@@ -51,6 +58,284 @@ isOpaqueMaterial(const Material &material)
              material.blend != BlendMode::AdditiveBlend;
 }
 
+
+// Size of the LRU cache simulated when reordering triangles, and of the
+// FIFO cache used to measure the result
+constexpr unsigned int VertexCacheSize = 32;
+constexpr unsigned int FifoCacheSize = 16;
+
+// Largest number of triangles in a cluster sorted to reduce overdraw
+constexpr std::size_t MaxClusterTriangles = 512;
+
+// Smaller triangle lists are always drawn at full resolution
+constexpr std::size_t MinLODTriangles = 64;
+
+// Vertex scoring parameters from Tom Forsyth's "Linear-Speed Vertex Cache
+// Optimisation"
+constexpr float CacheDecayPower = 1.5f;
+constexpr float LastTriangleScore = 0.75f;
+constexpr float ValenceBoostScale = 2.0f;
+
+
+float
+vertexCacheScore(int cachePosition, unsigned int remainingTriangles)
+{
+    // Vertices with no triangles left to draw are never needed again
+    if (remainingTriangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 3)
+    {
+        float scale = 1.0f / static_cast<float>(VertexCacheSize - 3);
+        score = std::pow(1.0f - static_cast<float>(cachePosition - 3) * scale, CacheDecayPower);
+    }
+    else if (cachePosition >= 0)
+    {
+        // Vertices of the last triangle get a fixed score, so that the
+        // next triangle doesn't simply reuse its edge and produce strips
+        score = LastTriangleScore;
+    }
+
+    // Boost vertices with few triangles left so that they're finished off
+    // rather than left as isolated triangles for later
+    return score + ValenceBoostScale / std::sqrt(static_cast<float>(remainingTriangles));
+}
+
+
+/*! Return the average number of vertices transformed per triangle when
+ *  drawing a triangle list through a FIFO vertex cache.
+ */
+float
+averageCacheMissRatio(const std::vector<Index32>& indices, unsigned int nVertices)
+{
+    if (indices.size() < 3)
+        return 0.0f;
+
+    // A vertex is in the cache if fewer than FifoCacheSize misses have
+    // occurred since it was loaded.
+    std::vector<unsigned int> loadedAt(nVertices, 0);
+    unsigned int misses = 0;
+    for (Index32 index : indices)
+    {
+        if (loadedAt[index] == 0 || misses - (loadedAt[index] - 1) >= FifoCacheSize)
+        {
+            misses++;
+            loadedAt[index] = misses;
+        }
+    }
+
+    return static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+}
+
+
+/*! Reorder a triangle list to reuse the vertices most recently transformed,
+ *  greedily picking the triangle whose vertices score highest. The start
+ *  of each cluster of triangles, beginning where no triangle touched the
+ *  cache or after MaxClusterTriangles, is appended to clusters.
+ */
+std::vector<Index32>
+reorderForVertexCache(const std::vector<Index32>& indices,
+                      unsigned int nVertices,
+                      std::vector<std::size_t>& clusters)
+{
+    std::size_t nTriangles = indices.size() / 3;
+
+    // Build the list of triangles using each vertex. The first
+    // liveTriangles[v] entries are the ones not yet drawn.
+    std::vector<std::size_t> adjacencyStart(nVertices + 1, 0);
+    for (Index32 index : indices)
+        adjacencyStart[index + 1]++;
+    std::partial_sum(adjacencyStart.begin(), adjacencyStart.end(), adjacencyStart.begin());
+
+    std::vector<unsigned int> liveTriangles(nVertices, 0);
+    std::vector<std::size_t> adjacency(indices.size());
+    for (std::size_t i = 0; i < indices.size(); i++)
+    {
+        Index32 v = indices[i];
+        adjacency[adjacencyStart[v] + liveTriangles[v]] = i / 3;
+        liveTriangles[v]++;
+    }
+
+    std::vector<int> cachePosition(nVertices, -1);
+    std::vector<float> vertexScore(nVertices);
+    for (unsigned int v = 0; v < nVertices; v++)
+        vertexScore[v] = vertexCacheScore(-1, liveTriangles[v]);
+
+    std::vector<float> triangleScore(nTriangles);
+    std::vector<bool> drawn(nTriangles, false);
+    for (std::size_t t = 0; t < nTriangles; t++)
+    {
+        triangleScore[t] = vertexScore[indices[t * 3]] +
+                           vertexScore[indices[t * 3 + 1]] +
+                           vertexScore[indices[t * 3 + 2]];
+    }
+
+    std::vector<Index32> result;
+    result.reserve(indices.size());
+    std::vector<Index32> cache;
+    std::vector<Index32> newCache;
+    cache.reserve(VertexCacheSize + 3);
+    newCache.reserve(VertexCacheSize + 3);
+
+    std::size_t nextUndrawn = 0;
+    std::size_t clusterTriangles = 0;
+    std::size_t best = nTriangles;
+    for (std::size_t n = 0; n < nTriangles; n++)
+    {
+        if (best == nTriangles)
+        {
+            // Nothing in the cache is useful; start over with the next
+            // triangle in the original order.
+            while (drawn[nextUndrawn])
+                nextUndrawn++;
+            best = nextUndrawn;
+            clusters.push_back(n);
+            clusterTriangles = 0;
+        }
+        else if (clusterTriangles >= MaxClusterTriangles)
+        {
+            clusters.push_back(n);
+            clusterTriangles = 0;
+        }
+
+        drawn[best] = true;
+        clusterTriangles++;
+
+        // Draw the triangle, put its vertices at the front of the cache
+        // and remove it from the lists of live triangles
+        newCache.clear();
+        for (unsigned int k = 0; k < 3; k++)
+        {
+            Index32 v = indices[best * 3 + k];
+            result.push_back(v);
+
+            auto first = adjacency.begin() + adjacencyStart[v];
+            auto last = first + liveTriangles[v];
+            std::iter_swap(std::find(first, last, best), last - 1);
+            liveTriangles[v]--;
+
+            if (std::find(newCache.begin(), newCache.end(), v) == newCache.end())
+                newCache.push_back(v);
+        }
+
+        for (Index32 v : cache)
+        {
+            if (std::find(newCache.begin(), newCache.end(), v) == newCache.end())
+                newCache.push_back(v);
+        }
+
+        // Update the scores of the vertices that moved in or out of the
+        // cache, then those of their triangles, picking the best of the
+        // triangles that use a cached vertex.
+        for (std::size_t i = 0; i < newCache.size(); i++)
+        {
+            Index32 v = newCache[i];
+            cachePosition[v] = i < VertexCacheSize ? static_cast<int>(i) : -1;
+            vertexScore[v] = vertexCacheScore(cachePosition[v], liveTriangles[v]);
+        }
+
+        best = nTriangles;
+        float bestScore = -std::numeric_limits<float>::max();
+        for (std::size_t i = 0; i < newCache.size(); i++)
+        {
+            Index32 v = newCache[i];
+            for (std::size_t j = 0; j < liveTriangles[v]; j++)
+            {
+                std::size_t t = adjacency[adjacencyStart[v] + j];
+                triangleScore[t] = vertexScore[indices[t * 3]] +
+                                   vertexScore[indices[t * 3 + 1]] +
+                                   vertexScore[indices[t * 3 + 2]];
+                if (i < VertexCacheSize && triangleScore[t] > bestScore)
+                {
+                    best = t;
+                    bestScore = triangleScore[t];
+                }
+            }
+        }
+
+        if (newCache.size() > VertexCacheSize)
+            newCache.resize(VertexCacheSize);
+        std::swap(cache, newCache);
+    }
+
+    return result;
+}
+
+
+/*! Sort clusters of a triangle list so that those facing outward from the
+ *  center of the group are drawn first, where they're most likely to hide
+ *  the rest. The order of triangles within each cluster, and therefore
+ *  most of the vertex cache reuse, is kept.
+ */
+void
+sortClustersForOverdraw(std::vector<Index32>& indices,
+                        const std::vector<std::size_t>& clusters,
+                        const VWord* vertices,
+                        unsigned int stride,
+                        unsigned int positionOffset)
+{
+    if (clusters.size() < 2)
+        return;
+
+    auto position = [&](Index32 index)
+    {
+        float fv[3];
+        std::memcpy(fv, vertices + index * stride + positionOffset, sizeof(float) * 3);
+        return Eigen::Vector3f(fv[0], fv[1], fv[2]);
+    };
+
+    Eigen::Vector3f center = Eigen::Vector3f::Zero();
+    for (Index32 index : indices)
+        center += position(index);
+    center /= static_cast<float>(indices.size());
+
+    struct Cluster
+    {
+        std::size_t first;
+        std::size_t last;
+        float facing;
+    };
+
+    std::vector<Cluster> sorted;
+    sorted.reserve(clusters.size());
+    for (std::size_t i = 0; i < clusters.size(); i++)
+    {
+        std::size_t first = clusters[i] * 3;
+        std::size_t last = i + 1 < clusters.size() ? clusters[i + 1] * 3 : indices.size();
+
+        // Area weighted centroid and normal of the cluster
+        Eigen::Vector3f centroid = Eigen::Vector3f::Zero();
+        Eigen::Vector3f normal = Eigen::Vector3f::Zero();
+        float area = 0.0f;
+        for (std::size_t j = first; j < last; j += 3)
+        {
+            Eigen::Vector3f p0 = position(indices[j]);
+            Eigen::Vector3f p1 = position(indices[j + 1]);
+            Eigen::Vector3f p2 = position(indices[j + 2]);
+            Eigen::Vector3f n = (p1 - p0).cross(p2 - p0);
+            float a = n.norm();
+            centroid += (p0 + p1 + p2) * (a / 3.0f);
+            normal += n;
+            area += a;
+        }
+
+        float facing = 0.0f;
+        if (area > 0.0f && normal.norm() > 0.0f)
+            facing = (centroid / area - center).dot(normal.normalized());
+        sorted.push_back({ first, last, facing });
+    }
+
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const Cluster& c0, const Cluster& c1) { return c0.facing > c1.facing; });
+
+    std::vector<Index32> newIndices;
+    newIndices.reserve(indices.size());
+    for (const Cluster& cluster : sorted)
+        newIndices.insert(newIndices.end(), indices.begin() + cluster.first, indices.begin() + cluster.last);
+    indices = std::move(newIndices);
+}
+
 } // end unnamed namespace
 
 
@@ -139,6 +424,8 @@ PrimitiveGroup::clone() const
     newGroup.prim = prim;
     newGroup.materialIndex = materialIndex;
     newGroup.indices = indices;
+    newGroup.indices16 = indices16;
+    newGroup.lodIndices = lodIndices;
     newGroup.primOverride = primOverride;
     newGroup.vertexOverride = vertexOverride;
     newGroup.vertexCountOverride = vertexCountOverride;
@@ -190,6 +477,7 @@ Mesh::clone() const
 void
 Mesh::setVertices(unsigned int _nVertices, std::vector<VWord>&& vertexData)
 {
+    bvh.reset();
     nVertices = _nVertices;
     vertices = std::move(vertexData);
 }
@@ -201,6 +489,7 @@ Mesh::setVertexDescription(VertexDescription&& desc)
     if (!desc.validate())
         return false;
 
+    bvh.reset();
     vertexDesc = std::move(desc);
     return true;
 }
@@ -228,6 +517,7 @@ Mesh::getGroup(unsigned int index)
     if (index >= groups.size())
         return nullptr;
 
+    bvh.reset();
     return &groups[index];
 }
 
@@ -235,6 +525,7 @@ Mesh::getGroup(unsigned int index)
 unsigned int
 Mesh::addGroup(PrimitiveGroup&& group)
 {
+    bvh.reset();
     groups.push_back(std::move(group));
     return groups.size();
 }
@@ -353,6 +644,7 @@ Mesh::getGroupCount() const
 void
 Mesh::clearGroups()
 {
+    bvh.reset();
     groups.clear();
 }
 
@@ -374,12 +666,19 @@ Mesh::setName(std::string&& _name)
 void
 Mesh::remapIndices(const std::vector<Index32>& indexMap)
 {
+    bvh.reset();
     for (auto& group : groups)
     {
         for (auto& index : group.indices)
         {
             index = indexMap[index];
         }
+        for (auto& lod : group.lodIndices)
+        {
+            for (auto& index : lod)
+                index = indexMap[index];
+        }
+        group.indices16.clear();
     }
 }
 
@@ -395,6 +694,7 @@ Mesh::remapMaterials(const std::vector<unsigned int>& materialMap)
 void
 Mesh::aggregateByMaterial()
 {
+    bvh.reset();
     std::sort(groups.begin(), groups.end(),
               [](const PrimitiveGroup& g0, const PrimitiveGroup& g1)
               {
@@ -434,6 +734,8 @@ Mesh::mergePrimitiveGroups()
                 newIndices.push_back(z);
             }
             g.indices = std::move(newIndices);
+            g.indices16.clear();
+            g.lodIndices.clear();
             g.prim = PrimitiveGroupType::TriList;
         }
 
@@ -452,6 +754,8 @@ Mesh::mergePrimitiveGroups()
             {
                 p.indices.reserve(p.indices.size() + g.indices.size());
                 p.indices.insert(p.indices.end(), g.indices.begin(), g.indices.end());
+                p.indices16.clear();
+                p.lodIndices.clear();
             }
         }
     }
@@ -460,154 +764,180 @@ Mesh::mergePrimitiveGroups()
 }
 
 void
-Mesh::optimize()
+Mesh::optimize(const std::vector<Material>& materials)
 {
-#ifdef HAVE_MESHOPTIMIZER
-    if (groups.size() > 1)
+    if (nVertices == 0 || groups.empty())
         return;
 
-    auto &g = groups.front();
+    bvh.reset();
+    unsigned int stride = vertexDesc.strideBytes / sizeof(VWord);
+    const VertexAttribute& position = vertexDesc.getAttribute(VertexAttributeSemantic::Position);
+    bool hasPositions = position.semantic == VertexAttributeSemantic::Position &&
+                        position.format == VertexAttributeFormat::Float3;
+
+    // Merge vertices with identical data. Groups whose vertices are
+    // overridden keep their indices into the shared vertices, so remapping
+    // them is safe too.
+    auto hashVertex = [&](Index32 v)
+    {
+        std::size_t h = 0;
+        for (unsigned int i = 0; i < stride; i++)
+            h = h * 31 + std::hash<VWord>()(vertices[v * stride + i]);
+        return h;
+    };
+    auto equalVertices = [&](Index32 v0, Index32 v1)
+    {
+        return std::memcmp(vertices.data() + v0 * stride, vertices.data() + v1 * stride, stride * sizeof(VWord)) == 0;
+    };
+
+    std::unordered_map<Index32, Index32, decltype(hashVertex), decltype(equalVertices)>
+        uniqueVertices(nVertices, hashVertex, equalVertices);
+    std::vector<Index32> canonical(nVertices);
+    for (Index32 v = 0; v < nVertices; v++)
+        canonical[v] = uniqueVertices.try_emplace(v, v).first->second;
+
+    for (auto& group : groups)
+    {
+        for (auto& index : group.indices)
+            index = canonical[index];
+    }
+
+    // Reorder the triangles of each triangle list, keeping the original
+    // order if that turns out to use the cache better.
+    for (auto& group : groups)
+    {
+        if (group.prim != PrimitiveGroupType::TriList || group.vertexCountOverride != 0 ||
+            group.indices.size() < 6 || group.indices.size() % 3 != 0)
+        {
+            continue;
+        }
+
+        bool sortForOverdraw = hasPositions &&
+                               group.materialIndex < materials.size() &&
+                               isOpaqueMaterial(materials[group.materialIndex]);
 
-    meshopt_optimizeVertexCache(g.indices.data(), g.indices.data(), g.indices.size(), nVertices);
-    meshopt_optimizeOverdraw(g.indices.data(), g.indices.data(), g.indices.size(), reinterpret_cast<float*>(vertices.data()), nVertices, vertexDesc.strideBytes, 1.05f);
-    meshopt_optimizeVertexFetch(vertices.data(), g.indices.data(), g.indices.size(), vertices.data(), nVertices, vertexDesc.strideBytes);
+#ifdef HAVE_MESHOPTIMIZER
+        std::vector<Index32> newIndices(group.indices.size());
+        meshopt_optimizeVertexCache(newIndices.data(), group.indices.data(), group.indices.size(), nVertices);
+        if (sortForOverdraw)
+        {
+            meshopt_optimizeOverdraw(newIndices.data(), newIndices.data(), newIndices.size(),
+                                     reinterpret_cast<const float*>(vertices.data() + position.offsetWords),
+                                     nVertices, vertexDesc.strideBytes, 1.05f);
+        }
+#else
+        std::vector<std::size_t> clusters;
+        std::vector<Index32> newIndices = reorderForVertexCache(group.indices, nVertices, clusters);
+        if (sortForOverdraw)
+            sortClustersForOverdraw(newIndices, clusters, vertices.data(), stride, position.offsetWords);
 #endif
-}
 
-bool
-Mesh::pick(const Eigen::Vector3d& rayOrigin, const Eigen::Vector3d& rayDirection, PickResult* result) const
-{
-    double maxDistance = 1.0e30;
-    double closest = maxDistance;
+        if (averageCacheMissRatio(newIndices, nVertices) < averageCacheMissRatio(group.indices, nVertices))
+            group.indices = std::move(newIndices);
+    }
 
-    // Pick will automatically fail without vertex positions--no reasonable
-    // mesh should lack these.
-    if (vertexDesc.getAttribute(VertexAttributeSemantic::Position).semantic != VertexAttributeSemantic::Position ||
-        vertexDesc.getAttribute(VertexAttributeSemantic::Position).format != VertexAttributeFormat::Float3)
+    // Renumber the vertices in the order they're first used so that
+    // fetching them is mostly sequential. Unused vertices that weren't
+    // duplicates are kept at the end, since they still count towards the
+    // bounding box.
+    constexpr Index32 Unused = std::numeric_limits<Index32>::max();
+    std::vector<Index32> newIndex(nVertices, Unused);
+    Index32 nNewVertices = 0;
+    for (const auto& group : groups)
     {
-        return false;
+        for (Index32 index : group.indices)
+        {
+            if (newIndex[index] == Unused)
+                newIndex[index] = nNewVertices++;
+        }
+    }
+    for (Index32 v = 0; v < nVertices; v++)
+    {
+        if (canonical[v] == v && newIndex[v] == Unused)
+            newIndex[v] = nNewVertices++;
     }
 
+    std::vector<VWord> newVertices(static_cast<std::size_t>(nNewVertices) * stride);
+    for (Index32 v = 0; v < nVertices; v++)
+    {
+        if (canonical[v] == v)
+            std::memcpy(newVertices.data() + newIndex[v] * stride, vertices.data() + v * stride, stride * sizeof(VWord));
+    }
+
+    GetLogger()->debug("Optimized mesh vertices: had {}, now {}.\n", nVertices, nNewVertices);
+    remapIndices(newIndex);
+    setVertices(nNewVertices, std::move(newVertices));
+
+    // Drawing with 16-bit indices halves the index data read per frame
+    if (nVertices <= static_cast<unsigned int>(std::numeric_limits<Index16>::max()) + 1)
+    {
+        for (auto& group : groups)
+            group.indices16.assign(group.indices.begin(), group.indices.end());
+    }
+}
+
+std::vector<float>
+Mesh::generateLODs(unsigned int nLevels)
+{
+    std::vector<float> errors(nLevels, 0.0f);
+
     unsigned int stride = vertexDesc.strideBytes / sizeof(VWord);
-    unsigned int posOffset = vertexDesc.getAttribute(VertexAttributeSemantic::Position).offsetWords;
-    const VWord* vdata = vertices.data();
+    const VertexAttribute& position = vertexDesc.getAttribute(VertexAttributeSemantic::Position);
+    if (position.semantic != VertexAttributeSemantic::Position ||
+        position.format != VertexAttributeFormat::Float3)
+    {
+        return errors;
+    }
 
-    // Iterate over all primitive groups in the mesh
-    for (const auto& group : groups)
+    for (auto& group : groups)
     {
-        PrimitiveGroupType primType = group.prim;
-        Index32 nIndices = group.indices.size();
+        group.lodIndices.clear();
+        if (group.prim != PrimitiveGroupType::TriList || group.vertexCountOverride != 0 ||
+            group.indices.size() / 3 < MinLODTriangles)
+        {
+            continue;
+        }
 
-        // Only attempt to compute the intersection of the ray with triangle
-        // groups.
-        if ((primType == PrimitiveGroupType::TriList
-             || primType == PrimitiveGroupType::TriStrip
-             || primType == PrimitiveGroupType::TriFan) &&
-            (nIndices >= 3) &&
-            !(primType == PrimitiveGroupType::TriList && nIndices % 3 != 0))
+        // Each level continues simplifying from the one before
+        MeshSimplifier simplifier(vertices.data(), stride, position.offsetWords, nVertices, group.indices);
+        std::size_t targetTriangles = group.indices.size() / 3;
+        for (unsigned int level = 0; level < nLevels; level++)
         {
-            unsigned int primitiveIndex = 0;
-            Index32 index = 0;
-            Index32 i0 = group.indices[0];
-            Index32 i1 = group.indices[1];
-            Index32 i2 = group.indices[2];
-
-            // Iterate over the triangles in the primitive group
-            do
-            {
-                // Get the triangle vertices v0, v1, and v2
-                float fv[3];
-                std::memcpy(fv, vdata + i0 * stride + posOffset, sizeof(float) * 3);
-                Eigen::Vector3d v0 = Eigen::Map<Eigen::Vector3f>(fv).cast<double>();
-                std::memcpy(fv, vdata + i1 * stride + posOffset, sizeof(float) * 3);
-                Eigen::Vector3d v1 = Eigen::Map<Eigen::Vector3f>(fv).cast<double>();
-                std::memcpy(fv, vdata + i2 * stride + posOffset, sizeof(float) * 3);
-                Eigen::Vector3d v2 = Eigen::Map<Eigen::Vector3f>(fv).cast<double>();
-
-                // Compute the edge vectors e0 and e1, and the normal n
-                Eigen::Vector3d e0 = v1 - v0;
-                Eigen::Vector3d e1 = v2 - v0;
-                Eigen::Vector3d n = e0.cross(e1);
-
-                // c is the cosine of the angle between the ray and triangle normal
-                double c = n.dot(rayDirection);
-
-                // If the ray is parallel to the triangle, it either misses the
-                // triangle completely, or is contained in the triangle's plane.
-                // If it's contained in the plane, we'll still call it a miss.
-                if (c != 0.0)
-                {
-                    double t = (n.dot(v0 - rayOrigin)) / c;
-                    if (t < closest && t > 0.0)
-                    {
-                        double m00 = e0.dot(e0);
-                        double m01 = e0.dot(e1);
-                        double m10 = e1.dot(e0);
-                        double m11 = e1.dot(e1);
-                        double det = m00 * m11 - m01 * m10;
-                        if (det != 0.0)
-                        {
-                            Eigen::Vector3d p = rayOrigin + rayDirection * t;
-                            Eigen::Vector3d q = p - v0;
-                            double q0 = e0.dot(q);
-                            double q1 = e1.dot(q);
-                            double d = 1.0 / det;
-                            double s0 = (m11 * q0 - m01 * q1) * d;
-                            double s1 = (m00 * q1 - m10 * q0) * d;
-                            if (s0 >= 0.0 && s1 >= 0.0 && s0 + s1 <= 1.0)
-                            {
-                                closest = t;
-                                if (result)
-                                {
-                                    result->group = &group;
-                                    result->primitiveIndex = primitiveIndex;
-                                    result->distance = closest;
-                                }
-                            }
-                        }
-                    }
-                }
+            targetTriangles /= 2;
+            errors[level] = std::max(errors[level], simplifier.simplify(targetTriangles));
 
-                // Get the indices for the next triangle
-                if (primType == PrimitiveGroupType::TriList)
-                {
-                    index += 3;
-                    if (index < nIndices)
-                    {
-                        i0 = group.indices[index + 0];
-                        i1 = group.indices[index + 1];
-                        i2 = group.indices[index + 2];
-                    }
-                }
-                else if (primType == PrimitiveGroupType::TriStrip)
-                {
-                    index += 1;
-                    if (index < nIndices)
-                    {
-                        i0 = i1;
-                        i1 = i2;
-                        i2 = group.indices[index];
-                        // TODO: alternate orientation of triangles in a strip
-                    }
-                }
-                else // primType == TriFan
-                {
-                    index += 1;
-                    if (index < nIndices)
-                    {
-                        index += 1;
-                        i1 = i2;
-                        i2 = group.indices[index];
-                    }
-                }
+            std::vector<Index32> lod = simplifier.getIndices();
+#ifdef HAVE_MESHOPTIMIZER
+            meshopt_optimizeVertexCache(lod.data(), lod.data(), lod.size(), nVertices);
+#else
+            std::vector<std::size_t> clusters;
+            lod = reorderForVertexCache(lod, nVertices, clusters);
+#endif
+            group.lodIndices.push_back(std::move(lod));
+        }
+    }
 
-                primitiveIndex++;
+    return errors;
+}
 
-            } while (index < nIndices);
-        }
+bool
+Mesh::pick(const Eigen::Vector3d& rayOrigin, const Eigen::Vector3d& rayDirection, PickResult* result) const
+{
+    if (!bvh)
+        bvh = std::make_unique<MeshBVH>(*this);
+
+    MeshBVH::Hit hit;
+    if (!bvh->intersect(rayOrigin, rayDirection, hit))
+        return false;
+
+    if (result)
+    {
+        result->group = &groups[hit.group];
+        result->primitiveIndex = hit.primitiveIndex;
+        result->distance = hit.distance;
     }
 
-    return closest != maxDistance;
+    return true;
 }
 
 
@@ -677,6 +1007,7 @@ Mesh::transform(const Eigen::Vector3f& translation, float scale)
     if (vertexDesc.getAttribute(VertexAttributeSemantic::Position).format != VertexAttributeFormat::Float3)
         return;
 
+    bvh.reset();
     VWord* vdata = vertices.data() + vertexDesc.getAttribute(VertexAttributeSemantic::Position).offsetWords;
     unsigned int i;
 
@@ -744,12 +1075,15 @@ Mesh::getPrimitiveCount() const
 void
 Mesh::merge(const Mesh &other)
 {
+    bvh.reset();
     auto &ti = groups.front().indices;
     const auto &oi = other.groups.front().indices;
 
     ti.reserve(ti.size() + oi.size());
     for (auto i : oi)
         ti.push_back(i + nVertices);
+    groups.front().indices16.clear();
+    groups.front().lodIndices.clear();
 
     vertices.reserve(vertices.size() + other.vertices.size());
     vertices.insert(vertices.end(), other.vertices.begin(), other.vertices.end());
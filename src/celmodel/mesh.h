@@ -13,6 +13,7 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -20,6 +21,7 @@
 #include <Eigen/Geometry>
 
 #include "material.h"
+#include "meshbvh.h"
 
 
 namespace cmod
@@ -27,6 +29,9 @@ namespace cmod
 // 32-bit index type
 using Index32 = std::uint32_t;
 
+// 16-bit index type
+using Index16 = std::uint16_t;
+
 using VWord = std::uint32_t;
 
 enum class VertexAttributeSemantic : std::int16_t
@@ -55,7 +60,16 @@ enum class VertexAttributeFormat : std::int16_t
     Float3    = 2,
     Float4    = 3,
     UByte4    = 4,
-    FormatMax = 5,
+    // Two and four half precision floats
+    Half2     = 5,
+    Half4     = 6,
+    // Four signed 16-bit integers normalized to [-1, 1]; positions in this
+    // format are relative to the bounds of the mesh
+    Short4    = 7,
+    // A unit vector mapped to two signed 16-bit integers by an octahedral
+    // projection
+    Oct16     = 8,
+    FormatMax = 9,
     InvalidFormat = -1,
 };
 
@@ -98,8 +112,12 @@ struct VertexAttribute
         {
         case VertexAttributeFormat::Float1:
         case VertexAttributeFormat::UByte4:
+        case VertexAttributeFormat::Half2:
+        case VertexAttributeFormat::Oct16:
             return 1;
         case VertexAttributeFormat::Float2:
+        case VertexAttributeFormat::Half4:
+        case VertexAttributeFormat::Short4:
             return 2;
         case VertexAttributeFormat::Float3:
             return 3;
@@ -170,6 +188,12 @@ struct PrimitiveGroup
     PrimitiveGroupType prim{ PrimitiveGroupType::InvalidPrimitiveGroupType };
     unsigned int materialIndex{ 0 };
     std::vector<Index32> indices{ };
+    // Copy of indices used for drawing when the mesh has few enough
+    // vertices, filled in by Mesh::optimize(); empty otherwise.
+    std::vector<Index16> indices16{ };
+    // Simplified versions of a triangle list, each with about half the
+    // triangles of the one before; filled in by Mesh::generateLODs().
+    std::vector<std::vector<Index32>> lodIndices{ };
     PrimitiveGroupType primOverride{ PrimitiveGroupType::InvalidPrimitiveGroupType };
     std::vector<VWord> vertexOverride{ };
     unsigned int vertexCountOverride{ 0 };
@@ -226,6 +250,11 @@ class Mesh
     const std::string& getName() const;
     void setName(std::string&&);
 
+    /*! Find the nearest triangle hit by a ray. The first pick builds a
+     *  bounding volume hierarchy of the triangles, which is kept until the
+     *  mesh is changed; it isn't safe to pick the same mesh from several
+     *  threads at once.
+     */
     bool pick(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction, PickResult* result) const;
     bool pick(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction, double& distance) const;
 
@@ -239,7 +268,20 @@ class Mesh
 
     void merge(const Mesh&);
     bool canMerge(const Mesh&, const std::vector<Material> &materials) const;
-    void optimize();
+
+    /*! Prepare the mesh for rendering: merge identical vertices, reorder
+     *  triangles for the post-transform vertex cache and, in opaque
+     *  groups, to reduce overdraw, then renumber vertices in order of
+     *  first use. Meshes with at most 65536 vertices also get 16-bit
+     *  copies of their indices.
+     */
+    void optimize(const std::vector<Material>& materials);
+
+    /*! Build nLevels simplified versions of each large enough triangle
+     *  list, sharing the vertices of the full resolution mesh. Returns the
+     *  largest distance any part of the surface moved at each level.
+     */
+    std::vector<float> generateLODs(unsigned int nLevels);
 
  private:
     PrimitiveGroup createLinePrimitiveGroup(bool lineStrip, const std::vector<Index32>& indices);
@@ -253,6 +295,9 @@ class Mesh
     std::vector<PrimitiveGroup> groups;
 
     std::string name;
+
+    // Built by the first pick, and dropped when the mesh changes
+    mutable std::unique_ptr<MeshBVH> bvh;
 };
 
 } // namespace cmod
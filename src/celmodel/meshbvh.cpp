@@ -0,0 +1,359 @@
+// meshbvh.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Bounding volume hierarchy over the triangles of a mesh.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Geometry>
+
+#include "mesh.h"
+#include "meshbvh.h"
+
+
+namespace cmod
+{
+namespace
+{
+
+// Bins of the centroids along the split axis tested for each node
+constexpr unsigned int SplitBins = 12;
+
+// Leaves are made of at most this many triangles unless their centroids
+// can't be split
+constexpr std::uint32_t MaxLeafTriangles = 8;
+
+// Cost of visiting a node relative to intersecting a triangle
+constexpr float TraversalCost = 1.0f;
+
+float
+halfArea(const Eigen::AlignedBox3f& box)
+{
+    if (box.isEmpty())
+        return 0.0f;
+    Eigen::Vector3f d = box.sizes();
+    return d.x() * d.y() + d.y() * d.z() + d.z() * d.x();
+}
+
+Eigen::Vector3f
+readPosition(const VWord* vertices, unsigned int stride, unsigned int offset, Index32 index)
+{
+    Eigen::Vector3f v;
+    std::memcpy(v.data(), vertices + index * stride + offset, sizeof(float) * 3);
+    return v;
+}
+
+// Slab test of a ray against a box, returning the distance at which the
+// ray enters it
+bool
+intersectBox(const Eigen::Vector3f& lower,
+             const Eigen::Vector3f& upper,
+             const Eigen::Vector3d& origin,
+             const Eigen::Vector3d& invDirection,
+             double maxDistance,
+             double& entry)
+{
+    Eigen::Vector3d t0 = (lower.cast<double>() - origin).cwiseProduct(invDirection);
+    Eigen::Vector3d t1 = (upper.cast<double>() - origin).cwiseProduct(invDirection);
+    double tNear = std::max(t0.cwiseMin(t1).maxCoeff(), 0.0);
+    double tFar = std::min(t0.cwiseMax(t1).minCoeff(), maxDistance);
+    entry = tNear;
+    return tNear <= tFar;
+}
+
+} // end unnamed namespace
+
+
+MeshBVH::MeshBVH(const Mesh& mesh)
+{
+    const VertexAttribute& position = mesh.getVertexDescription().getAttribute(VertexAttributeSemantic::Position);
+    if (position.semantic != VertexAttributeSemantic::Position || position.format != VertexAttributeFormat::Float3)
+        return;
+
+    const VWord* vertices = mesh.getVertexData();
+    unsigned int stride = mesh.getVertexStrideWords();
+    unsigned int nVertices = mesh.getVertexCount();
+
+    std::vector<Triangle> unordered;
+    unordered.reserve(mesh.getPrimitiveCount());
+    for (unsigned int groupIndex = 0; groupIndex < mesh.getGroupCount(); groupIndex++)
+    {
+        const PrimitiveGroup* group = mesh.getGroup(groupIndex);
+        const std::vector<Index32>& indices = group->indices;
+        std::size_t nIndices = indices.size();
+        if (nIndices < 3)
+            continue;
+
+        std::size_t nTriangles;
+        switch (group->prim)
+        {
+        case PrimitiveGroupType::TriList:
+            if (nIndices % 3 != 0)
+                continue;
+            nTriangles = nIndices / 3;
+            break;
+        case PrimitiveGroupType::TriStrip:
+        case PrimitiveGroupType::TriFan:
+            nTriangles = nIndices - 2;
+            break;
+        default:
+            continue;
+        }
+
+        for (std::size_t i = 0; i < nTriangles; i++)
+        {
+            std::array<Index32, 3> tri;
+            if (group->prim == PrimitiveGroupType::TriList)
+                tri = { indices[i * 3], indices[i * 3 + 1], indices[i * 3 + 2] };
+            else if (group->prim == PrimitiveGroupType::TriStrip)
+                tri = { indices[i], indices[i + 1], indices[i + 2] };
+            else
+                tri = { indices[0], indices[i + 1], indices[i + 2] };
+
+            if (tri[0] >= nVertices || tri[1] >= nVertices || tri[2] >= nVertices)
+                continue;
+
+            Eigen::Vector3f v0 = readPosition(vertices, stride, position.offsetWords, tri[0]);
+            Eigen::Vector3f v1 = readPosition(vertices, stride, position.offsetWords, tri[1]);
+            Eigen::Vector3f v2 = readPosition(vertices, stride, position.offsetWords, tri[2]);
+            unordered.push_back({ v0, v1 - v0, v2 - v0, groupIndex, static_cast<std::uint32_t>(i) });
+        }
+    }
+
+    if (!unordered.empty())
+        build(unordered);
+}
+
+
+void
+MeshBVH::build(std::vector<Triangle>& unordered)
+{
+    auto nTriangles = static_cast<std::uint32_t>(unordered.size());
+    std::vector<Eigen::AlignedBox3f> bounds(nTriangles);
+    std::vector<Eigen::Vector3f> centroids(nTriangles);
+    for (std::uint32_t i = 0; i < nTriangles; i++)
+    {
+        const Triangle& t = unordered[i];
+        bounds[i] = Eigen::AlignedBox3f(t.v0);
+        bounds[i].extend(t.v0 + t.edge1);
+        bounds[i].extend(t.v0 + t.edge2);
+        centroids[i] = bounds[i].center();
+    }
+
+    std::vector<std::uint32_t> order(nTriangles);
+    for (std::uint32_t i = 0; i < nTriangles; i++)
+        order[i] = i;
+
+    struct Task
+    {
+        std::uint32_t node;
+        std::uint32_t first;
+        std::uint32_t last;
+    };
+
+    nodes.reserve(2 * static_cast<std::size_t>(nTriangles));
+    nodes.push_back({});
+    std::vector<Task> tasks{ { 0, 0, nTriangles } };
+    while (!tasks.empty())
+    {
+        Task task = tasks.back();
+        tasks.pop_back();
+
+        Eigen::AlignedBox3f box;
+        Eigen::AlignedBox3f centroidBox;
+        for (std::uint32_t i = task.first; i < task.last; i++)
+        {
+            box.extend(bounds[order[i]]);
+            centroidBox.extend(centroids[order[i]]);
+        }
+
+        Node& node = nodes[task.node];
+        node.lower = box.min();
+        node.upper = box.max();
+        node.offset = task.first;
+        node.count = task.last - task.first;
+        if (node.count <= 2)
+            continue;
+
+        int axis;
+        float extent = centroidBox.sizes().maxCoeff(&axis);
+        if (extent <= 0.0f)
+            continue;
+
+        // Bin the centroids along the longest axis and sweep the bins for
+        // the split with the lowest cost
+        std::array<std::uint32_t, SplitBins> binCounts{};
+        std::array<Eigen::AlignedBox3f, SplitBins> binBoxes;
+        float binScale = static_cast<float>(SplitBins) / extent;
+        auto binOf = [&](std::uint32_t triangle)
+        {
+            auto bin = static_cast<unsigned int>((centroids[triangle][axis] - centroidBox.min()[axis]) * binScale);
+            return std::min(bin, SplitBins - 1);
+        };
+        for (std::uint32_t i = task.first; i < task.last; i++)
+        {
+            unsigned int bin = binOf(order[i]);
+            binCounts[bin]++;
+            binBoxes[bin].extend(bounds[order[i]]);
+        }
+
+        std::array<float, SplitBins> rightCosts{};
+        Eigen::AlignedBox3f rightBox;
+        std::uint32_t rightCount = 0;
+        for (unsigned int bin = SplitBins - 1; bin > 0; bin--)
+        {
+            rightBox.extend(binBoxes[bin]);
+            rightCount += binCounts[bin];
+            rightCosts[bin] = rightCount == 0 ? std::numeric_limits<float>::infinity()
+                                              : static_cast<float>(rightCount) * halfArea(rightBox);
+        }
+
+        float bestCost = std::numeric_limits<float>::infinity();
+        unsigned int bestSplit = 0;
+        Eigen::AlignedBox3f leftBox;
+        std::uint32_t leftCount = 0;
+        for (unsigned int bin = 1; bin < SplitBins; bin++)
+        {
+            leftBox.extend(binBoxes[bin - 1]);
+            leftCount += binCounts[bin - 1];
+            if (leftCount == 0)
+                continue;
+            float cost = static_cast<float>(leftCount) * halfArea(leftBox) + rightCosts[bin];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestSplit = bin;
+            }
+        }
+
+        float area = halfArea(box);
+        float leafCost = static_cast<float>(node.count) * area;
+        if (bestSplit == 0 || (node.count <= MaxLeafTriangles && TraversalCost * area + bestCost >= leafCost))
+            continue;
+
+        auto middle = std::partition(order.begin() + task.first, order.begin() + task.last,
+                                     [&](std::uint32_t triangle) { return binOf(triangle) < bestSplit; });
+        auto split = static_cast<std::uint32_t>(middle - order.begin());
+        if (split == task.first || split == task.last)
+            continue;
+
+        auto left = static_cast<std::uint32_t>(nodes.size());
+        node.offset = left;
+        node.count = 0;
+        nodes.push_back({});
+        nodes.push_back({});
+        tasks.push_back({ left, task.first, split });
+        tasks.push_back({ left + 1, split, task.last });
+    }
+
+    triangles.reserve(nTriangles);
+    for (std::uint32_t i : order)
+        triangles.push_back(unordered[i]);
+}
+
+
+bool
+MeshBVH::intersect(const Eigen::Vector3d& origin,
+                   const Eigen::Vector3d& direction,
+                   Hit& hit) const
+{
+    if (nodes.empty())
+        return false;
+
+    Eigen::Vector3d invDirection = direction.cwiseInverse();
+    double closest = std::numeric_limits<double>::infinity();
+
+    double entry;
+    if (!intersectBox(nodes[0].lower, nodes[0].upper, origin, invDirection, closest, entry))
+        return false;
+
+    // Nodes left to visit, with the distances at which the ray enters them
+    std::vector<std::pair<std::uint32_t, double>> stack;
+    stack.reserve(64);
+    std::uint32_t current = 0;
+    for (;;)
+    {
+        const Node& node = nodes[current];
+        if (node.count != 0)
+        {
+            // Möller-Trumbore intersection of the triangles of a leaf
+            for (std::uint32_t i = node.offset; i < node.offset + node.count; i++)
+            {
+                const Triangle& triangle = triangles[i];
+                Eigen::Vector3d edge1 = triangle.edge1.cast<double>();
+                Eigen::Vector3d edge2 = triangle.edge2.cast<double>();
+                Eigen::Vector3d p = direction.cross(edge2);
+                double det = edge1.dot(p);
+                if (det == 0.0)
+                    continue;
+
+                double invDet = 1.0 / det;
+                Eigen::Vector3d s = origin - triangle.v0.cast<double>();
+                double u = s.dot(p) * invDet;
+                if (u < 0.0 || u > 1.0)
+                    continue;
+
+                Eigen::Vector3d q = s.cross(edge1);
+                double v = direction.dot(q) * invDet;
+                if (v < 0.0 || u + v > 1.0)
+                    continue;
+
+                double t = edge2.dot(q) * invDet;
+                if (t > 0.0 && t < closest)
+                {
+                    closest = t;
+                    hit.group = triangle.group;
+                    hit.primitiveIndex = triangle.primitiveIndex;
+                    hit.distance = t;
+                }
+            }
+        }
+        else
+        {
+            // Visit the nearer child first, and the other after it unless
+            // a closer hit has been found by then
+            std::uint32_t near = node.offset;
+            std::uint32_t far = node.offset + 1;
+            double nearEntry;
+            double farEntry;
+            bool hitNear = intersectBox(nodes[near].lower, nodes[near].upper, origin, invDirection, closest, nearEntry);
+            bool hitFar = intersectBox(nodes[far].lower, nodes[far].upper, origin, invDirection, closest, farEntry);
+            if (hitNear && hitFar)
+            {
+                if (farEntry < nearEntry)
+                    std::swap(near, far);
+                stack.emplace_back(far, std::max(nearEntry, farEntry));
+                current = near;
+                continue;
+            }
+            if (hitNear || hitFar)
+            {
+                current = hitNear ? near : far;
+                continue;
+            }
+        }
+
+        // Skip the nodes entered beyond the closest hit
+        while (!stack.empty() && stack.back().second > closest)
+            stack.pop_back();
+        if (stack.empty())
+            break;
+        current = stack.back().first;
+        stack.pop_back();
+    }
+
+    return closest != std::numeric_limits<double>::infinity();
+}
+
+} // namespace cmod
@@ -0,0 +1,87 @@
+// meshbvh.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Bounding volume hierarchy over the triangles of a mesh.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+
+
+namespace cmod
+{
+class Mesh;
+
+/**
+ * A bounding volume hierarchy over the triangles of the lists, strips and
+ * fans of a mesh, used to intersect rays with the mesh without testing
+ * every triangle. The nodes are split at the best of a few bins of the
+ * centroids by the surface area heuristic, and kept in a flat array where
+ * the two children of a node are next to each other. Each leaf refers to a
+ * range of the triangles, whose vertices are copied in the order of the
+ * leaves.
+ *
+ * The hierarchy is built from the mesh as it is; it must be built again
+ * when the vertices or the primitive groups of the mesh change.
+ */
+class MeshBVH
+{
+ public:
+    struct Hit
+    {
+        unsigned int group{ 0 };
+        // Index of the triangle within its primitive group
+        unsigned int primitiveIndex{ 0 };
+        double distance{ 0.0 };
+    };
+
+    explicit MeshBVH(const Mesh& mesh);
+
+    // Find the nearest intersection of a ray with a triangle of the mesh,
+    // at a positive distance along the ray in units of the length of
+    // direction. Triangles are hit from either side.
+    bool intersect(const Eigen::Vector3d& origin,
+                   const Eigen::Vector3d& direction,
+                   Hit& hit) const;
+
+    std::size_t getTriangleCount() const { return triangles.size(); }
+    std::size_t getNodeCount() const { return nodes.size(); }
+
+ private:
+    struct Node
+    {
+        Eigen::Vector3f lower;
+        Eigen::Vector3f upper;
+        // The first triangle of a leaf, or the first of the two children
+        // of an inner node
+        std::uint32_t offset;
+        // Triangles of a leaf; 0 for an inner node
+        std::uint32_t count;
+    };
+
+    struct Triangle
+    {
+        Eigen::Vector3f v0;
+        Eigen::Vector3f edge1;
+        Eigen::Vector3f edge2;
+        std::uint32_t group;
+        std::uint32_t primitiveIndex;
+    };
+
+    void build(std::vector<Triangle>& unordered);
+
+    std::vector<Node> nodes;
+    std::vector<Triangle> triangles;
+};
+
+} // namespace cmod
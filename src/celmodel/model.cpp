@@ -26,6 +26,15 @@ namespace cmod
 namespace
 {
 
+constexpr unsigned int MaxLODLevels = 4;
+// Models with fewer triangles aren't worth simplifying
+constexpr unsigned int MinLODPrimitives = 1024;
+// Each level must drop at least this fraction of the triangles of the
+// level before it
+constexpr float MinLODReduction = 0.25f;
+// Largest error allowed on screen, in pixels
+constexpr float MaxLODPixelError = 0.5f;
+
 // Look at the material used by last primitive group in the mesh for the
 // opacity of the whole model.  This is a very crude way to check the opacity
 // of a mesh and misses many cases.
@@ -353,9 +362,91 @@ Model::sortMeshes(const MeshComparator& comparator)
     }
     GetLogger()->info("Merged similar meshes: {} -> {}.\n", meshes.size(), newMeshes.size());
 
-    for (auto &mesh : newMeshes)
-        mesh.optimize();
     meshes = std::move(newMeshes);
+    optimizeMeshes();
+}
+
+
+void
+Model::optimizeMeshes()
+{
+    for (auto& mesh : meshes)
+        mesh.optimize(materials);
+}
+
+void
+Model::generateLODs()
+{
+    lodErrors.clear();
+    if (getPrimitiveCount() < MinLODPrimitives)
+        return;
+
+    std::vector<float> errors(MaxLODLevels, 0.0f);
+    for (auto& mesh : meshes)
+    {
+        std::vector<float> meshErrors = mesh.generateLODs(MaxLODLevels);
+        for (unsigned int level = 0; level < MaxLODLevels; level++)
+            errors[level] = std::max(errors[level], meshErrors[level]);
+    }
+
+    // Count the triangles drawn at each level, with level 0 being the full
+    // resolution model, and stop at the first level that barely helps.
+    auto triangleCount = [this](unsigned int level)
+    {
+        std::size_t count = 0;
+        for (const auto& mesh : meshes)
+        {
+            for (unsigned int i = 0; i < mesh.getGroupCount(); i++)
+            {
+                const PrimitiveGroup* group = mesh.getGroup(i);
+                if (level == 0 || group->lodIndices.empty())
+                    count += group->getPrimitiveCount();
+                else
+                    count += group->lodIndices[level - 1].size() / 3;
+            }
+        }
+        return count;
+    };
+
+    unsigned int nLevels = 0;
+    std::size_t lastCount = triangleCount(0);
+    while (nLevels < MaxLODLevels)
+    {
+        std::size_t count = triangleCount(nLevels + 1);
+        if (static_cast<float>(count) > static_cast<float>(lastCount) * (1.0f - MinLODReduction))
+            break;
+        lastCount = count;
+        nLevels++;
+    }
+
+    for (auto& mesh : meshes)
+    {
+        for (unsigned int i = 0; i < mesh.getGroupCount(); i++)
+        {
+            PrimitiveGroup* group = mesh.getGroup(i);
+            if (group->lodIndices.size() > nLevels)
+                group->lodIndices.resize(nLevels);
+        }
+    }
+
+    errors.resize(nLevels);
+    lodErrors = std::move(errors);
+    GetLogger()->debug("Generated {} levels of detail for model, {} triangles at the coarsest.\n",
+                       nLevels, lastCount);
+}
+
+
+unsigned int
+Model::getLOD(float pixelsPerUnit) const
+{
+    if (pixelsPerUnit <= 0.0f)
+        return 0;
+
+    unsigned int level = 0;
+    while (level < lodErrors.size() && lodErrors[level] * pixelsPerUnit <= MaxLODPixelError)
+        level++;
+
+    return level;
 }
 
 } // end namespace cmod
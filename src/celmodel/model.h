@@ -133,6 +133,27 @@ class Model
     /*! Optimize the model by eliminating all duplicated materials */
     void uniquifyMaterials();
 
+    /*! Optimize each mesh for rendering; see Mesh::optimize() */
+    void optimizeMeshes();
+
+    /*! Build simplified levels of detail of the meshes; see
+     *  Mesh::generateLODs(). Levels that barely reduce the triangle count
+     *  are dropped. This should be done after the model is normalized or
+     *  transformed, since the errors are measured in model coordinates.
+     */
+    void generateLODs();
+
+    /*! Return the number of levels of detail, not counting the full
+     *  resolution model, which is level 0.
+     */
+    unsigned int getLODCount() const { return lodErrors.size(); }
+
+    /*! Return the coarsest level of detail that looks the same as the full
+     *  model to within a fraction of a pixel, given the size in pixels of
+     *  one unit of model coordinates.
+     */
+    unsigned int getLOD(float pixelsPerUnit) const;
+
     /*! This comparator will roughly sort the model's meshes by
      *  opacity so that transparent meshes are rendered last.  It's far
      *  from perfect, but covers a lot of cases.  A better method of
@@ -156,6 +177,8 @@ class Model
  private:
     std::vector<Material> materials{ };
     std::vector<Mesh> meshes{ };
+    // Largest error of each level of detail in model coordinates
+    std::vector<float> lodErrors{ };
 
     std::array<bool, static_cast<std::size_t>(TextureSemantic::TextureSemanticMax)> textureUsage;
     bool opaque{ true };
@@ -11,6 +11,7 @@
 #include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <fstream>
 #include <iostream>
 #include <string>
 #include <string_view>
@@ -22,10 +23,12 @@
 #include <celutil/binaryread.h>
 #include <celutil/binarywrite.h>
 #include <celutil/logger.h>
+#include <celutil/mmapfile.h>
 #include <celutil/tokenizer.h>
 #include "mesh.h"
 #include "model.h"
 #include "modelfile.h"
+#include "vertexpacking.h"
 
 namespace celutil = celestia::util;
 
@@ -72,6 +75,8 @@ enum ModelFileToken
     CMOD_Vertices       = 1013,
     CMOD_Emissive       = 1014,
     CMOD_Blend          = 1015,
+    // Bounds of the positions of a mesh, needed when they're quantized
+    CMOD_PositionBounds = 1016,
 };
 
 enum ModelFileType
@@ -1089,42 +1094,77 @@ AsciiModelWriter::writeMaterial(const Material& material)
 
 /***** Binary loader *****/
 
-bool readToken(std::istream& in, ModelFileToken& value)
+// Cursor over binary model data held in memory
+class BinaryReader
+{
+public:
+    BinaryReader(const char* _data, std::size_t _size) : data(_data), size(_size) {}
+
+    template<typename T>
+    bool readLE(T& value)
+    {
+        if (size - offset < sizeof(T)) { return false; }
+        value = celutil::fromMemoryLE<T>(data + offset);
+        offset += sizeof(T);
+        return true;
+    }
+
+    // Return the next count bytes and move past them, or nullptr if there
+    // aren't that many left.
+    const char* readBytes(std::size_t count)
+    {
+        if (size - offset < count) { return nullptr; }
+        const char* bytes = data + offset;
+        offset += count;
+        return bytes;
+    }
+
+    bool skip(std::size_t count) { return readBytes(count) != nullptr; }
+    bool atEnd() const { return offset == size; }
+    std::size_t getOffset() const { return offset; }
+
+private:
+    const char* data;
+    std::size_t size;
+    std::size_t offset{ 0 };
+};
+
+bool readToken(BinaryReader& in, ModelFileToken& value)
 {
     std::int16_t num;
-    if (!celutil::readLE<std::int16_t>(in, num)) { return false; }
+    if (!in.readLE(num)) { return false; }
     value = static_cast<ModelFileToken>(num);
     return true;
 }
 
 
-bool readType(std::istream& in, ModelFileType& value)
+bool readType(BinaryReader& in, ModelFileType& value)
 {
     std::int16_t num;
-    if (!celutil::readLE<std::int16_t>(in, num)) { return false; }
+    if (!in.readLE(num)) { return false; }
     value = static_cast<ModelFileType>(num);
     return true;
 }
 
 
-bool readTypeFloat1(std::istream& in, float& f)
+bool readTypeFloat1(BinaryReader& in, float& f)
 {
     ModelFileType cmodType;
     return readType(in, cmodType)
         && cmodType == CMOD_Float1
-        && celutil::readLE<float>(in, f);
+        && in.readLE(f);
 }
 
 
-bool readTypeColor(std::istream& in, Color& c)
+bool readTypeColor(BinaryReader& in, Color& c)
 {
     ModelFileType cmodType;
     float r, g, b;
     if (!readType(in, cmodType)
         || cmodType != CMOD_Color
-        || !celutil::readLE<float>(in, r)
-        || !celutil::readLE<float>(in, g)
-        || !celutil::readLE<float>(in, b))
+        || !in.readLE(r)
+        || !in.readLE(g)
+        || !in.readLE(b))
     {
         return false;
     }
@@ -1134,13 +1174,13 @@ bool readTypeColor(std::istream& in, Color& c)
 }
 
 
-bool readTypeString(std::istream& in, std::string& s)
+bool readTypeString(BinaryReader& in, std::string& s)
 {
     ModelFileType cmodType;
     uint16_t len;
     if (!readType(in, cmodType)
         || cmodType != CMOD_String
-        || !celutil::readLE<std::uint16_t>(in, len))
+        || !in.readLE(len))
     {
         return false;
     }
@@ -1151,20 +1191,20 @@ bool readTypeString(std::istream& in, std::string& s)
     }
     else
     {
-        std::vector<char> buf(len);
-        if (!in.read(buf.data(), len).good()) { return false; }
-        s = std::string(buf.cbegin(), buf.cend());
+        const char* bytes = in.readBytes(len);
+        if (bytes == nullptr) { return false; }
+        s = std::string(bytes, len);
     }
 
     return true;
 }
 
 
-bool ignoreValue(std::istream& in)
+bool ignoreValue(BinaryReader& in)
 {
     ModelFileType type;
     if (!readType(in, type)) { return false; }
-    std::streamsize size = 0;
+    std::size_t size = 0;
 
     switch (type)
     {
@@ -1189,7 +1229,7 @@ bool ignoreValue(std::istream& in)
     case CMOD_String:
         {
             std::uint16_t len;
-            if (!celutil::readLE<std::uint16_t>(in, len)) { return false; }
+            if (!in.readLE(len)) { return false; }
             size = len;
         }
         break;
@@ -1198,16 +1238,21 @@ bool ignoreValue(std::istream& in)
         return false;
     }
 
-    return in.ignore(size).good();
+    return in.skip(size);
 }
 
 
 class BinaryModelLoader : public ModelLoader
 {
 public:
-    BinaryModelLoader(std::istream& _in, HandleGetter& _handleGetter) :
+    BinaryModelLoader(const char* _data, std::size_t _size, HandleGetter& _handleGetter) :
+        ModelLoader(_handleGetter),
+        in(_data, _size)
+    {}
+    BinaryModelLoader(std::vector<char>&& _buffer, HandleGetter& _handleGetter) :
         ModelLoader(_handleGetter),
-        in(_in)
+        buffer(std::move(_buffer)),
+        in(buffer.data(), buffer.size())
     {}
     ~BinaryModelLoader() override = default;
 
@@ -1217,18 +1262,21 @@ public:
     bool loadMaterial(Material& material);
     VertexDescription loadVertexDescription();
     bool loadMesh(Mesh& mesh);
+    bool loadPositionBounds(Eigen::AlignedBox3f& bounds);
     std::vector<VWord> loadVertices(const VertexDescription& vertexDesc,
                                     unsigned int& vertexCount);
 
 private:
-    std::istream& in;
+    // Model data read from a stream; data mapped from a file isn't copied
+    std::vector<char> buffer;
+    BinaryReader in;
 };
 
 
 void
 BinaryModelLoader::reportError(const std::string& msg)
 {
-    std::string s = fmt::format("{} (offset {})", msg, 0);
+    std::string s = fmt::format("{} (offset {})", msg, in.getOffset() + CEL_MODEL_HEADER_LENGTH);
     ModelLoader::reportError(s);
 }
 
@@ -1242,10 +1290,11 @@ BinaryModelLoader::load()
     // Parse material and mesh definitions
     for (;;)
     {
+        if (in.atEnd()) { break; }
+
         ModelFileToken tok;
         if (!readToken(in, tok))
         {
-            if (in.eof()) { break; }
             reportError("Failed to read token");
             return nullptr;
         }
@@ -1352,7 +1401,7 @@ BinaryModelLoader::loadMaterial(Material& material)
         case CMOD_Blend:
             {
                 std::int16_t blendMode;
-                if (!celutil::readLE<std::int16_t>(in, blendMode)
+                if (!in.readLE(blendMode)
                     || blendMode < 0 || blendMode >= static_cast<std::int16_t>(BlendMode::BlendMax))
                 {
                     reportError("Bad blend mode");
@@ -1365,7 +1414,7 @@ BinaryModelLoader::loadMaterial(Material& material)
         case CMOD_Texture:
             {
                 std::int16_t texType;
-                if (!celutil::readLE<std::int16_t>(in, texType)
+                if (!in.readLE(texType)
                     || texType < 0 || texType >= static_cast<std::int16_t>(TextureSemantic::TextureSemanticMax))
                 {
                     reportError("Bad texture type");
@@ -1423,7 +1472,7 @@ BinaryModelLoader::loadVertexDescription()
     for (;;)
     {
         std::int16_t tok;
-        if (!celutil::readLE<std::int16_t>(in, tok))
+        if (!in.readLE(tok))
         {
             reportError("Could not read token");
             return {};
@@ -1436,7 +1485,7 @@ BinaryModelLoader::loadVertexDescription()
         if (tok >= 0 && tok < static_cast<std::int16_t>(VertexAttributeSemantic::SemanticMax))
         {
             std::int16_t vfmt;
-            if (!celutil::readLE<std::int16_t>(in, vfmt)
+            if (!in.readLE(vfmt)
                 || vfmt < 0 || vfmt >= static_cast<std::int16_t>(VertexAttributeFormat::FormatMax))
             {
                 reportError("Invalid vertex attribute type");
@@ -1479,17 +1528,33 @@ BinaryModelLoader::loadMesh(Mesh& mesh)
     VertexDescription vertexDesc = loadVertexDescription();
     if (vertexDesc.attributes.empty()) { return false; }
 
+    Eigen::AlignedBox3f bounds;
+    if (vertexDesc.getAttribute(VertexAttributeSemantic::Position).format == VertexAttributeFormat::Short4
+        && !loadPositionBounds(bounds))
+    {
+        return false;
+    }
+
     unsigned int vertexCount = 0;
     std::vector<VWord> vertexData = loadVertices(vertexDesc, vertexCount);
     if (vertexData.empty()) { return false; }
 
+    // Meshes are kept with float attributes; compact formats are only
+    // used in files and in graphics memory.
+    if (isPacked(vertexDesc))
+    {
+        VertexDescription unpackedDesc = unpackVertexDescription(vertexDesc);
+        vertexData = convertVertices(vertexDesc, vertexData.data(), vertexCount, unpackedDesc, bounds);
+        vertexDesc = std::move(unpackedDesc);
+    }
+
     mesh.setVertexDescription(std::move(vertexDesc));
     mesh.setVertices(vertexCount, std::move(vertexData));
 
     for (;;)
     {
         std::int16_t tok;
-        if (!celutil::readLE<std::int16_t>(in, tok))
+        if (!in.readLE(tok))
         {
             reportError("Failed to read token type");
             return false;
@@ -1507,26 +1572,32 @@ BinaryModelLoader::loadMesh(Mesh& mesh)
 
         PrimitiveGroupType type = static_cast<PrimitiveGroupType>(tok);
         std::uint32_t materialIndex, indexCount;
-        if (!celutil::readLE<std::uint32_t>(in, materialIndex)
-            || !celutil::readLE<std::uint32_t>(in, indexCount))
+        if (!in.readLE(materialIndex)
+            || !in.readLE(indexCount))
         {
             reportError("Could not read primitive indices");
             return false;
         }
 
-        std::vector<Index32> indices;
-        indices.reserve(indexCount);
+        const char* indexData = in.readBytes(static_cast<std::size_t>(indexCount) * sizeof(std::uint32_t));
+        if (indexData == nullptr)
+        {
+            reportError("Could not read primitive indices");
+            return false;
+        }
 
+        std::vector<Index32> indices(indexCount);
+#ifdef WORDS_BIGENDIAN
         for (unsigned int i = 0; i < indexCount; i++)
+            indices[i] = celutil::fromMemoryLE<std::uint32_t>(indexData + i * sizeof(std::uint32_t));
+#else
+        std::memcpy(indices.data(), indexData, indices.size() * sizeof(Index32));
+#endif
+        if (std::any_of(indices.begin(), indices.end(),
+                        [vertexCount](Index32 index) { return index >= vertexCount; }))
         {
-            std::uint32_t index;
-            if (!celutil::readLE<std::uint32_t>(in, index) || index >= vertexCount)
-            {
-                reportError("Index out of range");
-                return false;
-            }
-
-            indices.push_back(index);
+            reportError("Index out of range");
+            return false;
         }
 
         mesh.addGroup(type, materialIndex, std::move(indices));
@@ -1536,6 +1607,30 @@ BinaryModelLoader::loadMesh(Mesh& mesh)
 }
 
 
+bool
+BinaryModelLoader::loadPositionBounds(Eigen::AlignedBox3f& bounds)
+{
+    ModelFileToken tok;
+    if (!readToken(in, tok) || tok != CMOD_PositionBounds)
+    {
+        reportError("Position bounds expected");
+        return false;
+    }
+
+    Eigen::Vector3f lower;
+    Eigen::Vector3f upper;
+    if (!in.readLE(lower.x()) || !in.readLE(lower.y()) || !in.readLE(lower.z())
+        || !in.readLE(upper.x()) || !in.readLE(upper.y()) || !in.readLE(upper.z()))
+    {
+        reportError("Failed to read position bounds");
+        return false;
+    }
+
+    bounds = Eigen::AlignedBox3f(lower, upper);
+    return true;
+}
+
+
 std::vector<VWord>
 BinaryModelLoader::loadVertices(const VertexDescription& vertexDesc,
                                 unsigned int& vertexCount)
@@ -1547,79 +1642,53 @@ BinaryModelLoader::loadVertices(const VertexDescription& vertexDesc,
         return {};
     }
 
-    if (!celutil::readLE<std::uint32_t>(in, vertexCount))
+    if (!in.readLE(vertexCount))
     {
         reportError("Vertex count expected");
         return {};
     }
 
-    unsigned int stride = vertexDesc.strideBytes / sizeof(VWord);
-    unsigned int vertexDataSize = stride * vertexCount;
-    std::vector<VWord> vertexData(vertexDataSize);
+    // The vertices are stored exactly as they're laid out in memory, apart
+    // from the byte order of the floats and 16-bit components.
+    std::size_t vertexDataSize = static_cast<std::size_t>(vertexDesc.strideBytes / sizeof(VWord)) * vertexCount;
+    const char* src = in.readBytes(vertexDataSize * sizeof(VWord));
+    if (src == nullptr)
+    {
+        reportError("Failed to read vertex data");
+        return {};
+    }
 
-    unsigned int offset = 0;
-    for (unsigned int i = 0; i < vertexCount; i++, offset += stride)
+    std::vector<VWord> vertexData(vertexDataSize);
+#ifdef WORDS_BIGENDIAN
+    unsigned int stride = vertexDesc.strideBytes / sizeof(VWord);
+    for (std::size_t offset = 0; offset < vertexDataSize; offset += stride)
     {
-        assert(offset < vertexDataSize);
         for (const auto& attr : vertexDesc.attributes)
         {
-            unsigned int base = offset + attr.offsetWords;
-            VertexAttributeFormat vfmt = attr.format;
-            float f[4];
-            /*int readCount = 0;    Unused*/
-            switch (vfmt)
+            std::size_t base = offset + attr.offsetWords;
+            if (attr.format == VertexAttributeFormat::UByte4)
             {
-            case VertexAttributeFormat::Float1:
-                if (!celutil::readLE<float>(in, f[0]))
-                {
-                    reportError("Failed to read Float1");
-                    return {};
-                }
-                std::memcpy(vertexData.data() + base, f, sizeof(float));
-                break;
-            case VertexAttributeFormat::Float2:
-                if (!celutil::readLE<float>(in, f[0])
-                    || !celutil::readLE<float>(in, f[1]))
-                {
-                    reportError("Failed to read Float2");
-                    return {};
-                }
-                std::memcpy(vertexData.data() + base, f, sizeof(float) * 2);
-                break;
-            case VertexAttributeFormat::Float3:
-                if (!celutil::readLE<float>(in, f[0])
-                    || !celutil::readLE<float>(in, f[1])
-                    || !celutil::readLE<float>(in, f[2]))
-                {
-                    reportError("Failed to read Float3");
-                    return {};
-                }
-                std::memcpy(vertexData.data() + base, f, sizeof(float) * 3);
-                break;
-            case VertexAttributeFormat::Float4:
-                if (!celutil::readLE<float>(in, f[0])
-                    || !celutil::readLE<float>(in, f[1])
-                    || !celutil::readLE<float>(in, f[2])
-                    || !celutil::readLE<float>(in, f[3]))
-                {
-                    reportError("Failed to read Float4");
-                    return {};
-                }
-                std::memcpy(vertexData.data() + base, f, sizeof(float) * 4);
-                break;
-            case VertexAttributeFormat::UByte4:
-                if (!celutil::readNative<std::uint32_t>(in, vertexData[base]))
+                vertexData[base] = celutil::fromMemoryNative<VWord>(src + base * sizeof(VWord));
+                continue;
+            }
+            if (attr.format > VertexAttributeFormat::UByte4)
+            {
+                auto* dst = reinterpret_cast<char*>(vertexData.data() + base);
+                for (unsigned int i = 0; i < VertexAttribute::getFormatSizeWords(attr.format) * 2; i++)
                 {
-                    reportError("failed to read UByte4");
-                    return {};
+                    auto value = celutil::fromMemoryLE<std::uint16_t>(src + base * sizeof(VWord) + i * 2);
+                    std::memcpy(dst + i * 2, &value, 2);
                 }
-                break;
-            default:
-                assert(0);
-                return {};
+                continue;
             }
+
+            for (unsigned int i = 0; i < VertexAttribute::getFormatSizeWords(attr.format); i++)
+                vertexData[base + i] = celutil::fromMemoryLE<VWord>(src + (base + i) * sizeof(VWord));
         }
     }
+#else
+    std::memcpy(vertexData.data(), src, vertexDataSize * sizeof(VWord));
+#endif
 
     return vertexData;
 }
@@ -1666,9 +1735,10 @@ bool writeTypeString(std::ostream& out, const std::string& s)
 class BinaryModelWriter : public ModelWriter
 {
 public:
-    BinaryModelWriter(std::ostream& _out, SourceGetter& _sourceGetter) :
+    BinaryModelWriter(std::ostream& _out, SourceGetter& _sourceGetter, unsigned int _packing) :
         ModelWriter(_sourceGetter),
-        out(_out)
+        out(_out),
+        packing(_packing)
     {}
     ~BinaryModelWriter() override = default;
 
@@ -1685,6 +1755,8 @@ private:
                        const VertexDescription& desc);
 
     std::ostream& out;
+    // VertexPackingFlags of the attributes written in compact formats
+    unsigned int packing;
 };
 
 
@@ -1729,16 +1801,41 @@ BinaryModelWriter::writeGroup(const PrimitiveGroup& group)
 bool
 BinaryModelWriter::writeMesh(const Mesh& mesh)
 {
-    if (!writeToken(out, CMOD_Mesh)
-        || !writeVertexDescription(mesh.getVertexDescription())
-        || !writeVertices(mesh.getVertexData(),
-                          mesh.getVertexCount(),
-                          mesh.getVertexStrideWords(),
-                          mesh.getVertexDescription()))
+    const VertexDescription* desc = &mesh.getVertexDescription();
+    const VWord* vertexData = mesh.getVertexData();
+    VertexDescription packedDesc;
+    std::vector<VWord> packedData;
+    Eigen::AlignedBox3f bounds;
+    if (packing != 0)
+    {
+        packedDesc = packVertexDescription(*desc, packing);
+        if (isPacked(packedDesc))
+        {
+            bounds = getPositionBounds(*desc, vertexData, mesh.getVertexCount());
+            packedData = convertVertices(*desc, vertexData, mesh.getVertexCount(), packedDesc, bounds);
+            desc = &packedDesc;
+            vertexData = packedData.data();
+        }
+    }
+
+    if (!writeToken(out, CMOD_Mesh) || !writeVertexDescription(*desc))
+        return false;
+
+    if (desc->getAttribute(VertexAttributeSemantic::Position).format == VertexAttributeFormat::Short4
+        && (!writeToken(out, CMOD_PositionBounds)
+            || !celutil::writeLE<float>(out, bounds.min().x())
+            || !celutil::writeLE<float>(out, bounds.min().y())
+            || !celutil::writeLE<float>(out, bounds.min().z())
+            || !celutil::writeLE<float>(out, bounds.max().x())
+            || !celutil::writeLE<float>(out, bounds.max().y())
+            || !celutil::writeLE<float>(out, bounds.max().z())))
     {
         return false;
     }
 
+    if (!writeVertices(vertexData, mesh.getVertexCount(), desc->strideBytes / sizeof(VWord), *desc))
+        return false;
+
     for (unsigned int groupIndex = 0; mesh.getGroup(groupIndex) != nullptr; groupIndex++)
     {
         if (!writeGroup(*mesh.getGroup(groupIndex))) { return false; }
@@ -1794,6 +1891,18 @@ BinaryModelWriter::writeVertices(const VWord* vertexData,
             case VertexAttributeFormat::UByte4:
                 result = celutil::writeNative<std::uint32_t>(out, *cdata);
                 break;
+            case VertexAttributeFormat::Half2:
+            case VertexAttributeFormat::Half4:
+            case VertexAttributeFormat::Short4:
+            case VertexAttributeFormat::Oct16:
+                {
+                    std::uint16_t sdata[4];
+                    unsigned int count = VertexAttribute::getFormatSizeWords(attr.format) * 2;
+                    std::memcpy(sdata, cdata, sizeof(std::uint16_t) * count);
+                    result = std::all_of(sdata, sdata + count,
+                                         [this](std::uint16_t s) { return celutil::writeLE<std::uint16_t>(out, s); });
+                }
+                break;
             default:
                 assert(0);
                 result = false;
@@ -1903,7 +2012,12 @@ OpenModel(std::istream& in, HandleGetter& getHandle)
     }
     if (std::strncmp(header, CEL_MODEL_HEADER_BINARY, CEL_MODEL_HEADER_LENGTH) == 0)
     {
-        return std::make_unique<BinaryModelLoader>(in, getHandle);
+        // Read the rest of the stream in one go and decode it from memory
+        std::vector<char> buffer;
+        char chunk[65536];
+        while (in.read(chunk, sizeof(chunk)) || in.gcount() > 0)
+            buffer.insert(buffer.end(), chunk, chunk + in.gcount());
+        return std::make_unique<BinaryModelLoader>(std::move(buffer), getHandle);
     }
     else
     {
@@ -1933,6 +2047,39 @@ LoadModel(std::istream& in, HandleGetter handleGetter)
 }
 
 
+std::unique_ptr<Model>
+LoadModel(const fs::path& filename, HandleGetter handleGetter)
+{
+    // Binary models are decoded straight from a mapping of the file,
+    // without reading it through a stream first.
+    celutil::MemoryMappedFile file;
+    if (file.open(filename, celutil::MemoryMappedFile::AccessHint::Sequential) &&
+        file.size() >= CEL_MODEL_HEADER_LENGTH &&
+        std::strncmp(file.data(), CEL_MODEL_HEADER_BINARY, CEL_MODEL_HEADER_LENGTH) == 0)
+    {
+        BinaryModelLoader loader(file.data() + CEL_MODEL_HEADER_LENGTH,
+                                 file.size() - CEL_MODEL_HEADER_LENGTH,
+                                 handleGetter);
+        std::unique_ptr<Model> model = loader.load();
+        if (model == nullptr)
+        {
+            celutil::GetLogger()->error("Error in model file: {}\n", loader.getErrorMessage());
+        }
+
+        return model;
+    }
+
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in.good())
+    {
+        celutil::GetLogger()->error("Could not open model file\n");
+        return nullptr;
+    }
+
+    return LoadModel(in, handleGetter);
+}
+
+
 bool
 SaveModelAscii(const Model* model, std::ostream& out, SourceGetter sourceGetter)
 {
@@ -1944,9 +2091,16 @@ SaveModelAscii(const Model* model, std::ostream& out, SourceGetter sourceGetter)
 
 bool
 SaveModelBinary(const Model* model, std::ostream& out, SourceGetter sourceGetter)
+{
+    return SaveModelBinary(model, out, sourceGetter, 0);
+}
+
+
+bool
+SaveModelBinary(const Model* model, std::ostream& out, SourceGetter sourceGetter, unsigned int packing)
 {
     if (model == nullptr) { return false; }
-    BinaryModelWriter writer(out, sourceGetter);
+    BinaryModelWriter writer(out, sourceGetter, packing);
     return writer.write(*model);
 }
 } // end namespace cmod
@@ -25,7 +25,11 @@ using HandleGetter = std::function<ResourceHandle(const fs::path&)>;
 using SourceGetter = std::function<fs::path(ResourceHandle)>;
 
 std::unique_ptr<Model> LoadModel(std::istream& in, HandleGetter getHandle);
+std::unique_ptr<Model> LoadModel(const fs::path& filename, HandleGetter getHandle);
 
 bool SaveModelAscii(const Model* model, std::ostream& out, SourceGetter getSource);
 bool SaveModelBinary(const Model* model, std::ostream& out, SourceGetter getSource);
+// Save with the attributes selected by the VertexPackingFlags in packing
+// in compact formats, which loaders of older versions can't read
+bool SaveModelBinary(const Model* model, std::ostream& out, SourceGetter getSource, unsigned int packing);
 }
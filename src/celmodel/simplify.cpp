@@ -0,0 +1,321 @@
+// simplify.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Triangle mesh simplification for model levels of detail.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+#include <Eigen/Geometry>
+
+#include "simplify.h"
+
+
+namespace cmod
+{
+
+MeshSimplifier::Quadric&
+MeshSimplifier::Quadric::operator+=(const Quadric& other)
+{
+    a += other.a;
+    b += other.b;
+    c += other.c;
+    return *this;
+}
+
+
+double
+MeshSimplifier::Quadric::error(const Eigen::Vector3d& p) const
+{
+    return std::max(p.dot(a * p) + 2.0 * b.dot(p) + c, 0.0);
+}
+
+
+MeshSimplifier::MeshSimplifier(const VWord* vertices,
+                               unsigned int strideWords,
+                               unsigned int positionOffsetWords,
+                               unsigned int nVertices,
+                               const std::vector<Index32>& indices) :
+    positions(nVertices),
+    quadrics(nVertices),
+    locked(nVertices, false),
+    collapsed(nVertices, false),
+    vertexTriangles(nVertices)
+{
+    for (unsigned int v = 0; v < nVertices; v++)
+    {
+        float p[3];
+        std::memcpy(p, vertices + v * strideWords + positionOffsetWords, sizeof(p));
+        positions[v] = Eigen::Vector3d(p[0], p[1], p[2]);
+    }
+
+    // Triangles with a repeated vertex are dropped straight away
+    for (std::size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        Index32 i0 = indices[i];
+        Index32 i1 = indices[i + 1];
+        Index32 i2 = indices[i + 2];
+        if (i0 == i1 || i1 == i2 || i0 == i2 || std::max({ i0, i1, i2 }) >= nVertices)
+            continue;
+
+        std::size_t t = triangles.size();
+        triangles.push_back({ i0, i1, i2 });
+        for (Index32 v : triangles.back())
+            vertexTriangles[v].push_back(t);
+
+        // The plane quadrics aren't weighted by area, so that the error is
+        // an upper bound on the distance moved from each original plane.
+        Eigen::Vector3d normal = (positions[i1] - positions[i0]).cross(positions[i2] - positions[i0]);
+        if (normal.squaredNorm() > 0.0)
+        {
+            normal.normalize();
+            Quadric q;
+            double d = -normal.dot(positions[i0]);
+            q.a = normal * normal.transpose();
+            q.b = d * normal;
+            q.c = d * d;
+            for (Index32 v : triangles.back())
+                quadrics[v] += q;
+        }
+    }
+    removed.assign(triangles.size(), false);
+    liveTriangles = triangles.size();
+
+    // Lock vertices on edges that aren't shared by exactly two triangles
+    std::unordered_map<std::uint64_t, unsigned int> edgeUses;
+    auto edgeKey = [](Index32 a, Index32 b)
+    {
+        return (static_cast<std::uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+    };
+    for (const auto& tri : triangles)
+    {
+        for (unsigned int k = 0; k < 3; k++)
+            edgeUses[edgeKey(tri[k], tri[(k + 1) % 3])]++;
+    }
+    for (const auto& tri : triangles)
+    {
+        for (unsigned int k = 0; k < 3; k++)
+        {
+            if (edgeUses[edgeKey(tri[k], tri[(k + 1) % 3])] != 2)
+            {
+                locked[tri[k]] = true;
+                locked[tri[(k + 1) % 3]] = true;
+            }
+        }
+    }
+
+    // Lock vertices at seams, where several vertices share a position
+    std::map<std::array<double, 3>, Index32> positionVertex;
+    for (Index32 v = 0; v < nVertices; v++)
+    {
+        if (vertexTriangles[v].empty())
+            continue;
+
+        auto result = positionVertex.try_emplace({ positions[v].x(), positions[v].y(), positions[v].z() }, v);
+        if (!result.second)
+        {
+            locked[v] = true;
+            locked[result.first->second] = true;
+        }
+    }
+
+    for (const auto& tri : triangles)
+    {
+        for (unsigned int k = 0; k < 3; k++)
+        {
+            addCollapse(tri[k], tri[(k + 1) % 3]);
+            addCollapse(tri[(k + 1) % 3], tri[k]);
+        }
+    }
+}
+
+
+void
+MeshSimplifier::addCollapse(Index32 from, Index32 to)
+{
+    if (!locked[from])
+        collapses.push({ quadrics[from].error(positions[to]), from, to });
+}
+
+
+bool
+MeshSimplifier::isAdjacent(Index32 from, Index32 to) const
+{
+    for (std::size_t t : vertexTriangles[from])
+    {
+        const auto& tri = triangles[t];
+        if (tri[0] == to || tri[1] == to || tri[2] == to)
+            return true;
+    }
+
+    return false;
+}
+
+
+bool
+MeshSimplifier::canCollapse(Index32 from, Index32 to) const
+{
+    // The only vertices adjacent to both ends of the edge may be the ones
+    // opposite it; otherwise the collapse would pinch the surface.
+    std::vector<Index32> fromNeighbors;
+    std::size_t sharedTriangles = 0;
+    for (std::size_t t : vertexTriangles[from])
+    {
+        const auto& tri = triangles[t];
+        bool shared = tri[0] == to || tri[1] == to || tri[2] == to;
+        if (shared)
+            sharedTriangles++;
+        for (Index32 v : tri)
+        {
+            if (v != from && v != to)
+                fromNeighbors.push_back(v);
+        }
+    }
+    std::sort(fromNeighbors.begin(), fromNeighbors.end());
+    fromNeighbors.erase(std::unique(fromNeighbors.begin(), fromNeighbors.end()), fromNeighbors.end());
+
+    std::vector<Index32> commonNeighbors;
+    for (std::size_t t : vertexTriangles[to])
+    {
+        for (Index32 v : triangles[t])
+        {
+            if (v != to && std::binary_search(fromNeighbors.begin(), fromNeighbors.end(), v))
+                commonNeighbors.push_back(v);
+        }
+    }
+    std::sort(commonNeighbors.begin(), commonNeighbors.end());
+    commonNeighbors.erase(std::unique(commonNeighbors.begin(), commonNeighbors.end()), commonNeighbors.end());
+    if (commonNeighbors.size() != sharedTriangles)
+        return false;
+
+    // Reject collapses that would flip or flatten a triangle
+    for (std::size_t t : vertexTriangles[from])
+    {
+        const auto& tri = triangles[t];
+        if (tri[0] == to || tri[1] == to || tri[2] == to)
+            continue;
+
+        std::array<Eigen::Vector3d, 3> p;
+        for (unsigned int k = 0; k < 3; k++)
+            p[k] = positions[tri[k]];
+        Eigen::Vector3d oldNormal = (p[1] - p[0]).cross(p[2] - p[0]);
+        for (unsigned int k = 0; k < 3; k++)
+        {
+            if (tri[k] == from)
+                p[k] = positions[to];
+        }
+        Eigen::Vector3d newNormal = (p[1] - p[0]).cross(p[2] - p[0]);
+        if (newNormal.dot(oldNormal) <= 0.0 || newNormal.squaredNorm() == 0.0)
+            return false;
+    }
+
+    return true;
+}
+
+
+void
+MeshSimplifier::removeTriangle(std::size_t triangle, Index32 vertex)
+{
+    auto& list = vertexTriangles[vertex];
+    list.erase(std::remove(list.begin(), list.end(), triangle), list.end());
+}
+
+
+void
+MeshSimplifier::collapse(Index32 from, Index32 to)
+{
+    for (std::size_t t : vertexTriangles[from])
+    {
+        auto& tri = triangles[t];
+        if (tri[0] == to || tri[1] == to || tri[2] == to)
+        {
+            removed[t] = true;
+            liveTriangles--;
+            for (Index32 v : tri)
+            {
+                if (v != from)
+                    removeTriangle(t, v);
+            }
+        }
+        else
+        {
+            std::replace(tri.begin(), tri.end(), from, to);
+            vertexTriangles[to].push_back(t);
+        }
+    }
+
+    vertexTriangles[from].clear();
+    collapsed[from] = true;
+    quadrics[to] += quadrics[from];
+
+    // The costs of the edges around the merged vertex have changed
+    for (std::size_t t : vertexTriangles[to])
+    {
+        for (Index32 v : triangles[t])
+        {
+            if (v != to)
+            {
+                addCollapse(v, to);
+                addCollapse(to, v);
+            }
+        }
+    }
+}
+
+
+float
+MeshSimplifier::simplify(std::size_t targetTriangles)
+{
+    while (liveTriangles > targetTriangles && !collapses.empty())
+    {
+        Collapse c = collapses.top();
+        collapses.pop();
+        if (collapsed[c.from] || collapsed[c.to] || !isAdjacent(c.from, c.to))
+            continue;
+
+        // Quadrics only grow, so an entry whose cost went up since it was
+        // queued goes back in the queue with its current cost.
+        double cost = quadrics[c.from].error(positions[c.to]);
+        if (cost > c.cost)
+        {
+            collapses.push({ cost, c.from, c.to });
+            continue;
+        }
+
+        if (!canCollapse(c.from, c.to))
+            continue;
+
+        collapse(c.from, c.to);
+        maxError = std::max(maxError, cost);
+    }
+
+    return static_cast<float>(std::sqrt(maxError));
+}
+
+
+std::vector<Index32>
+MeshSimplifier::getIndices() const
+{
+    std::vector<Index32> indices;
+    indices.reserve(liveTriangles * 3);
+    for (std::size_t t = 0; t < triangles.size(); t++)
+    {
+        if (!removed[t])
+            indices.insert(indices.end(), triangles[t].begin(), triangles[t].end());
+    }
+
+    return indices;
+}
+
+} // namespace cmod
@@ -0,0 +1,94 @@
+// simplify.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Triangle mesh simplification for model levels of detail.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "mesh.h"
+
+
+namespace cmod
+{
+
+/*! Simplifies a triangle list by collapsing edges in order of increasing
+ *  quadric error (Garland and Heckbert). A vertex is only ever moved onto
+ *  one of its neighbours, so the simplified triangles still index the
+ *  original vertex data. Vertices on open edges and vertices sharing their
+ *  position with another vertex (at texture or normal seams) are never
+ *  moved, which keeps the boundaries between groups and seams closed.
+ */
+class MeshSimplifier
+{
+ public:
+    MeshSimplifier(const VWord* vertices,
+                   unsigned int strideWords,
+                   unsigned int positionOffsetWords,
+                   unsigned int nVertices,
+                   const std::vector<Index32>& indices);
+
+    /*! Collapse edges until at most targetTriangles are left or no edge
+     *  can be collapsed. Returns the largest error of any collapse so far,
+     *  as a distance in the units of the vertex positions.
+     */
+    float simplify(std::size_t targetTriangles);
+
+    std::size_t getTriangleCount() const { return liveTriangles; }
+    std::vector<Index32> getIndices() const;
+
+ private:
+    struct Quadric
+    {
+        Eigen::Matrix3d a{ Eigen::Matrix3d::Zero() };
+        Eigen::Vector3d b{ Eigen::Vector3d::Zero() };
+        double c{ 0.0 };
+
+        Quadric& operator+=(const Quadric&);
+        double error(const Eigen::Vector3d&) const;
+    };
+
+    struct Collapse
+    {
+        double cost;
+        Index32 from;
+        Index32 to;
+
+        bool operator>(const Collapse& other) const { return cost > other.cost; }
+    };
+
+    void addCollapse(Index32 from, Index32 to);
+    bool isAdjacent(Index32 from, Index32 to) const;
+    bool canCollapse(Index32 from, Index32 to) const;
+    void collapse(Index32 from, Index32 to);
+    void removeTriangle(std::size_t triangle, Index32 vertex);
+
+    std::vector<Eigen::Vector3d> positions;
+    std::vector<Quadric> quadrics;
+    std::vector<bool> locked;
+    std::vector<bool> collapsed;
+
+    std::vector<std::array<Index32, 3>> triangles;
+    std::vector<bool> removed;
+    // Live triangles using each vertex
+    std::vector<std::vector<std::size_t>> vertexTriangles;
+    std::size_t liveTriangles{ 0 };
+
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> collapses;
+    double maxError{ 0.0 };
+};
+
+} // namespace cmod
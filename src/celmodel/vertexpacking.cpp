@@ -0,0 +1,426 @@
+// vertexpacking.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Conversion of vertices to and from compact attribute formats.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "vertexpacking.h"
+
+
+namespace cmod
+{
+namespace
+{
+
+template<typename T, std::size_t N>
+std::array<T, N>
+readComponents(const VWord* src)
+{
+    std::array<T, N> components;
+    std::memcpy(components.data(), src, sizeof(T) * N);
+    return components;
+}
+
+template<typename T, std::size_t N>
+void
+writeComponents(VWord* dst, const std::array<T, N>& components)
+{
+    std::memcpy(dst, components.data(), sizeof(T) * N);
+}
+
+// Positions in Short4 map the bounds of the mesh to [-1, 1]
+Eigen::Vector3f
+boundsScale(const Eigen::AlignedBox3f& bounds)
+{
+    return bounds.isEmpty() ? Eigen::Vector3f::Zero() : Eigen::Vector3f(bounds.sizes() * 0.5f);
+}
+
+Eigen::Vector4f
+readAttribute(const VertexAttribute& attr,
+              const VWord* src,
+              const Eigen::AlignedBox3f& bounds)
+{
+    Eigen::Vector4f v(0.0f, 0.0f, 0.0f, 1.0f);
+    switch (attr.format)
+    {
+    case VertexAttributeFormat::Float1:
+    case VertexAttributeFormat::Float2:
+    case VertexAttributeFormat::Float3:
+    case VertexAttributeFormat::Float4:
+        std::memcpy(v.data(), src, VertexAttribute::getFormatSizeWords(attr.format) * sizeof(float));
+        break;
+    case VertexAttributeFormat::UByte4:
+        {
+            auto c = readComponents<std::uint8_t, 4>(src);
+            for (int i = 0; i < 4; i++)
+                v[i] = static_cast<float>(c[i]) / 255.0f;
+        }
+        break;
+    case VertexAttributeFormat::Half2:
+        {
+            auto h = readComponents<std::uint16_t, 2>(src);
+            v.x() = halfToFloat(h[0]);
+            v.y() = halfToFloat(h[1]);
+        }
+        break;
+    case VertexAttributeFormat::Half4:
+        {
+            auto h = readComponents<std::uint16_t, 4>(src);
+            for (int i = 0; i < 4; i++)
+                v[i] = halfToFloat(h[i]);
+        }
+        break;
+    case VertexAttributeFormat::Short4:
+        {
+            auto s = readComponents<std::int16_t, 4>(src);
+            for (int i = 0; i < 4; i++)
+                v[i] = snorm16ToFloat(s[i]);
+            if (attr.semantic == VertexAttributeSemantic::Position)
+            {
+                Eigen::Vector3f p = bounds.center() + v.head<3>().cwiseProduct(boundsScale(bounds));
+                v = Eigen::Vector4f(p.x(), p.y(), p.z(), 1.0f);
+            }
+        }
+        break;
+    case VertexAttributeFormat::Oct16:
+        {
+            auto s = readComponents<std::int16_t, 2>(src);
+            Eigen::Vector3f n = unpackOctahedral(s[0], s[1]);
+            v = Eigen::Vector4f(n.x(), n.y(), n.z(), 0.0f);
+        }
+        break;
+    default:
+        break;
+    }
+
+    return v;
+}
+
+void
+writeAttribute(const VertexAttribute& attr,
+               const Eigen::Vector4f& v,
+               VWord* dst,
+               const Eigen::AlignedBox3f& bounds)
+{
+    switch (attr.format)
+    {
+    case VertexAttributeFormat::Float1:
+    case VertexAttributeFormat::Float2:
+    case VertexAttributeFormat::Float3:
+    case VertexAttributeFormat::Float4:
+        std::memcpy(dst, v.data(), VertexAttribute::getFormatSizeWords(attr.format) * sizeof(float));
+        break;
+    case VertexAttributeFormat::UByte4:
+        {
+            std::array<std::uint8_t, 4> c;
+            for (int i = 0; i < 4; i++)
+                c[i] = static_cast<std::uint8_t>(std::lround(std::clamp(v[i], 0.0f, 1.0f) * 255.0f));
+            writeComponents(dst, c);
+        }
+        break;
+    case VertexAttributeFormat::Half2:
+        writeComponents(dst, std::array<std::uint16_t, 2>{ floatToHalf(v.x()), floatToHalf(v.y()) });
+        break;
+    case VertexAttributeFormat::Half4:
+        writeComponents(dst, std::array<std::uint16_t, 4>{ floatToHalf(v.x()), floatToHalf(v.y()),
+                                                           floatToHalf(v.z()), floatToHalf(v.w()) });
+        break;
+    case VertexAttributeFormat::Short4:
+        {
+            Eigen::Vector4f s = v;
+            if (attr.semantic == VertexAttributeSemantic::Position)
+            {
+                Eigen::Vector3f scale = boundsScale(bounds);
+                Eigen::Vector3f p = v.head<3>() - bounds.center();
+                for (int i = 0; i < 3; i++)
+                    s[i] = scale[i] > 0.0f ? p[i] / scale[i] : 0.0f;
+                s.w() = 0.0f;
+            }
+            writeComponents(dst, std::array<std::int16_t, 4>{ floatToSnorm16(s.x()), floatToSnorm16(s.y()),
+                                                              floatToSnorm16(s.z()), floatToSnorm16(s.w()) });
+        }
+        break;
+    case VertexAttributeFormat::Oct16:
+        writeComponents(dst, packOctahedral(v.head<3>()));
+        break;
+    default:
+        break;
+    }
+}
+
+} // end unnamed namespace
+
+
+std::uint16_t
+floatToHalf(float f)
+{
+    std::uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    auto sign = static_cast<std::uint16_t>((x >> 16) & 0x8000);
+    std::uint32_t absx = x & 0x7fffffff;
+
+    // Infinity and NaN, keeping NaNs quiet
+    if (absx >= 0x7f800000)
+        return sign | 0x7c00 | (absx > 0x7f800000 ? 0x200 : 0);
+    // Values from 65520 up round to infinity
+    if (absx >= 0x477ff000)
+        return sign | 0x7c00;
+
+    // Subnormal halves, in units of 2^-24; up to 2^-25 rounds to zero
+    if (absx < 0x38800000)
+    {
+        if (absx <= 0x33000000)
+            return sign;
+        std::uint32_t mantissa = (absx & 0x7fffff) | 0x800000;
+        unsigned int shift = 126 - (absx >> 23);
+        std::uint32_t h = mantissa >> shift;
+        std::uint32_t remainder = mantissa & ((1u << shift) - 1);
+        std::uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (h & 1) != 0))
+            h++;
+        return sign | static_cast<std::uint16_t>(h);
+    }
+
+    // Rebias the exponent from 127 to 15; a carry out of the mantissa
+    // correctly moves on to the next exponent
+    std::uint32_t h = (absx - 0x38000000) >> 13;
+    std::uint32_t remainder = absx & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (h & 1) != 0))
+        h++;
+    return sign | static_cast<std::uint16_t>(h);
+}
+
+
+float
+halfToFloat(std::uint16_t h)
+{
+    std::uint32_t sign = static_cast<std::uint32_t>(h & 0x8000) << 16;
+    std::uint32_t exponent = (h >> 10) & 0x1f;
+    std::uint32_t mantissa = h & 0x3ff;
+
+    std::uint32_t x;
+    if (exponent == 0)
+    {
+        float f = static_cast<float>(mantissa) * (1.0f / 16777216.0f);
+        std::memcpy(&x, &f, sizeof(x));
+        x |= sign;
+    }
+    else if (exponent == 0x1f)
+    {
+        x = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else
+    {
+        x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+
+std::int16_t
+floatToSnorm16(float f)
+{
+    return static_cast<std::int16_t>(std::lround(std::clamp(f, -1.0f, 1.0f) * 32767.0f));
+}
+
+
+float
+snorm16ToFloat(std::int16_t s)
+{
+    return std::max(static_cast<float>(s) / 32767.0f, -1.0f);
+}
+
+
+std::array<std::int16_t, 2>
+packOctahedral(const Eigen::Vector3f& v)
+{
+    float l1 = v.cwiseAbs().sum();
+    if (l1 == 0.0f)
+        return { 0, 0 };
+
+    Eigen::Vector3f n = v / l1;
+    float x = n.x();
+    float y = n.y();
+    if (n.z() < 0.0f)
+    {
+        x = (1.0f - std::abs(n.y())) * (n.x() >= 0.0f ? 1.0f : -1.0f);
+        y = (1.0f - std::abs(n.x())) * (n.y() >= 0.0f ? 1.0f : -1.0f);
+    }
+
+    return { floatToSnorm16(x), floatToSnorm16(y) };
+}
+
+
+Eigen::Vector3f
+unpackOctahedral(std::int16_t x, std::int16_t y)
+{
+    Eigen::Vector3f n(snorm16ToFloat(x), snorm16ToFloat(y), 0.0f);
+    n.z() = 1.0f - std::abs(n.x()) - std::abs(n.y());
+    if (n.z() < 0.0f)
+    {
+        float nx = n.x();
+        n.x() = (1.0f - std::abs(n.y())) * (nx >= 0.0f ? 1.0f : -1.0f);
+        n.y() = (1.0f - std::abs(nx)) * (n.y() >= 0.0f ? 1.0f : -1.0f);
+    }
+
+    return n.normalized();
+}
+
+
+bool
+isPacked(const VertexDescription& desc)
+{
+    return std::any_of(desc.attributes.begin(), desc.attributes.end(),
+                       [](const VertexAttribute& attr) { return attr.format > VertexAttributeFormat::UByte4; });
+}
+
+
+VertexDescription
+packVertexDescription(const VertexDescription& desc, unsigned int flags)
+{
+    // Tangents are only packed along with normals, as the shaders unpack
+    // both or neither
+    bool packNormals = (flags & PackNormals) != 0 &&
+                       desc.getAttribute(VertexAttributeSemantic::Normal).format == VertexAttributeFormat::Float3;
+
+    std::vector<VertexAttribute> attributes;
+    unsigned int offset = 0;
+    for (const VertexAttribute& attr : desc.attributes)
+    {
+        VertexAttributeFormat format = attr.format;
+        switch (attr.semantic)
+        {
+        case VertexAttributeSemantic::Position:
+            if ((flags & PackPositions) != 0 && format == VertexAttributeFormat::Float3)
+                format = VertexAttributeFormat::Short4;
+            break;
+        case VertexAttributeSemantic::Normal:
+        case VertexAttributeSemantic::Tangent:
+            if (packNormals && format == VertexAttributeFormat::Float3)
+                format = VertexAttributeFormat::Oct16;
+            break;
+        case VertexAttributeSemantic::Texture0:
+        case VertexAttributeSemantic::Texture1:
+        case VertexAttributeSemantic::Texture2:
+        case VertexAttributeSemantic::Texture3:
+            if ((flags & PackTexCoords) != 0 && format == VertexAttributeFormat::Float2)
+                format = VertexAttributeFormat::Half2;
+            break;
+        default:
+            break;
+        }
+
+        attributes.emplace_back(attr.semantic, format, offset);
+        offset += VertexAttribute::getFormatSizeWords(format);
+    }
+
+    return VertexDescription(std::move(attributes));
+}
+
+
+VertexDescription
+unpackVertexDescription(const VertexDescription& desc)
+{
+    std::vector<VertexAttribute> attributes;
+    unsigned int offset = 0;
+    for (const VertexAttribute& attr : desc.attributes)
+    {
+        VertexAttributeFormat format = attr.format;
+        switch (format)
+        {
+        case VertexAttributeFormat::Half2:
+            format = VertexAttributeFormat::Float2;
+            break;
+        case VertexAttributeFormat::Half4:
+            format = VertexAttributeFormat::Float4;
+            break;
+        case VertexAttributeFormat::Short4:
+            format = attr.semantic == VertexAttributeSemantic::Position
+                ? VertexAttributeFormat::Float3
+                : VertexAttributeFormat::Float4;
+            break;
+        case VertexAttributeFormat::Oct16:
+            format = VertexAttributeFormat::Float3;
+            break;
+        default:
+            break;
+        }
+
+        attributes.emplace_back(attr.semantic, format, offset);
+        offset += VertexAttribute::getFormatSizeWords(format);
+    }
+
+    return VertexDescription(std::move(attributes));
+}
+
+
+Eigen::AlignedBox3f
+getPositionBounds(const VertexDescription& desc,
+                  const VWord* vertices,
+                  unsigned int nVertices)
+{
+    Eigen::AlignedBox3f bounds;
+    const VertexAttribute& position = desc.getAttribute(VertexAttributeSemantic::Position);
+    if (position.format != VertexAttributeFormat::Float3)
+        return bounds;
+
+    unsigned int stride = desc.strideBytes / sizeof(VWord);
+    for (unsigned int i = 0; i < nVertices; i++)
+    {
+        Eigen::Vector3f p;
+        std::memcpy(p.data(), vertices + i * stride + position.offsetWords, sizeof(float) * 3);
+        bounds.extend(p);
+    }
+
+    return bounds;
+}
+
+
+std::vector<VWord>
+convertVertices(const VertexDescription& from,
+                const VWord* vertices,
+                unsigned int nVertices,
+                const VertexDescription& to,
+                const Eigen::AlignedBox3f& bounds)
+{
+    unsigned int fromStride = from.strideBytes / sizeof(VWord);
+    unsigned int toStride = to.strideBytes / sizeof(VWord);
+    std::vector<VWord> converted(static_cast<std::size_t>(toStride) * nVertices);
+
+    for (const VertexAttribute& toAttr : to.attributes)
+    {
+        const VertexAttribute& fromAttr = from.getAttribute(toAttr.semantic);
+        if (fromAttr.format == VertexAttributeFormat::InvalidFormat)
+            continue;
+
+        const VWord* src = vertices + fromAttr.offsetWords;
+        VWord* dst = converted.data() + toAttr.offsetWords;
+        if (fromAttr.format == toAttr.format)
+        {
+            std::size_t size = VertexAttribute::getFormatSizeWords(toAttr.format) * sizeof(VWord);
+            for (unsigned int i = 0; i < nVertices; i++, src += fromStride, dst += toStride)
+                std::memcpy(dst, src, size);
+        }
+        else
+        {
+            for (unsigned int i = 0; i < nVertices; i++, src += fromStride, dst += toStride)
+                writeAttribute(toAttr, readAttribute(fromAttr, src, bounds), dst, bounds);
+        }
+    }
+
+    return converted;
+}
+
+} // namespace cmod
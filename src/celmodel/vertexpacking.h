@@ -0,0 +1,77 @@
+// vertexpacking.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Conversion of vertices to and from compact attribute formats.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "mesh.h"
+
+
+namespace cmod
+{
+
+// Attributes converted to compact formats by packVertexDescription()
+enum VertexPackingFlags : unsigned int
+{
+    // Float3 normals, and tangents along with them, to Oct16
+    PackNormals    = 0x1,
+    // Float2 texture coordinates to Half2
+    PackTexCoords  = 0x2,
+    // Float3 positions to Short4, relative to the bounds of the mesh
+    PackPositions  = 0x4,
+    PackAll        = 0x7,
+};
+
+// IEEE 754 half precision, rounding to nearest even
+std::uint16_t floatToHalf(float f);
+float halfToFloat(std::uint16_t h);
+
+// Signed normalized 16-bit integers; values outside [-1, 1] are clamped
+std::int16_t floatToSnorm16(float f);
+float snorm16ToFloat(std::int16_t s);
+
+// Map a unit vector to a point of the square [-1, 1]^2 by projecting it
+// on an octahedron whose lower half is folded over the upper one, as
+// described by Cigolle et al., "A Survey of Efficient Representations for
+// Independent Unit Vectors", 2014.
+std::array<std::int16_t, 2> packOctahedral(const Eigen::Vector3f& v);
+Eigen::Vector3f unpackOctahedral(std::int16_t x, std::int16_t y);
+
+bool isPacked(const VertexDescription& desc);
+
+// The layout of desc with the attributes selected by flags in compact
+// formats, keeping the order of the attributes
+VertexDescription packVertexDescription(const VertexDescription& desc, unsigned int flags);
+// The layout of desc with attributes in compact formats as floats
+VertexDescription unpackVertexDescription(const VertexDescription& desc);
+
+// The bounds of the Float3 positions of vertices, used to quantize them
+Eigen::AlignedBox3f getPositionBounds(const VertexDescription& desc,
+                                      const VWord* vertices,
+                                      unsigned int nVertices);
+
+// Copy vertices from the layout from to the layout to, where every
+// attribute of to has the same semantic as one of from, in the same or a
+// compact format or the float format it expands to. Short4 positions are
+// relative to bounds.
+std::vector<VWord> convertVertices(const VertexDescription& from,
+                                   const VWord* vertices,
+                                   unsigned int nVertices,
+                                   const VertexDescription& to,
+                                   const Eigen::AlignedBox3f& bounds);
+
+} // namespace cmod
@@ -58,43 +58,62 @@ CommandParser::~CommandParser()
 
 CommandSequence* CommandParser::parse()
 {
+    if (!begin())
+        return nullptr;
+
     CommandSequence* seq = new CommandSequence();
+    while (Command* cmd = next())
+        seq->push_back(cmd);
 
-    if (tokenizer->nextToken() != Tokenizer::TokenBeginGroup)
+    if (failed())
     {
-        error("'{' expected at start of script.");
+        for_each(seq->begin(), seq->end(), [](Command* cmd) { delete cmd; });
         delete seq;
         return nullptr;
     }
 
-    Tokenizer::TokenType ttype = tokenizer->nextToken();
-    while (ttype != Tokenizer::TokenEnd && ttype != Tokenizer::TokenEndGroup)
+    return seq;
+}
+
+
+bool CommandParser::begin()
+{
+    if (tokenizer->nextToken() != Tokenizer::TokenBeginGroup)
     {
-        tokenizer->pushBack();
-        Command* cmd = parseCommand();
-        if (cmd == nullptr)
-        {
-            for_each(seq->begin(), seq->end(), [](Command* cmd) { delete cmd; });
-            delete seq;
-            return nullptr;
-        }
-        else
-        {
-            seq->push_back(cmd);
-        }
+        error("'{' expected at start of script.");
+        state = State::Failed;
+        return false;
+    }
 
-        ttype = tokenizer->nextToken();
+    return true;
+}
+
+
+Command* CommandParser::next()
+{
+    if (state != State::Parsing)
+        return nullptr;
+
+    Tokenizer::TokenType ttype = tokenizer->nextToken();
+    if (ttype == Tokenizer::TokenEndGroup)
+    {
+        state = State::Finished;
+        return nullptr;
     }
 
-    if (ttype != Tokenizer::TokenEndGroup)
+    if (ttype == Tokenizer::TokenEnd)
     {
         error("Missing '}' at end of script.");
-        for_each(seq->begin(), seq->end(), [](Command* cmd) { delete cmd; });
-        delete seq;
+        state = State::Failed;
         return nullptr;
     }
 
-    return seq;
+    tokenizer->pushBack();
+    Command* cmd = parseCommand();
+    if (cmd == nullptr)
+        state = State::Failed;
+
+    return cmd;
 }
 
 
@@ -835,6 +854,12 @@ Command* CommandParser::parseCommand()
 
         cmd = new CommandScriptImage(duration, fadeafter, xoffset, yoffset, filename, fitscreen, colors);
     }
+    else if (commandName == "preloadoverlay")
+    {
+        string filename;
+        paramList->getString("filename", filename);
+        cmd = new CommandPreloadScriptImage(filename);
+    }
     else if (commandName == "verbosity")
     {
         int level;
@@ -33,7 +33,23 @@ class CommandParser
     CommandSequence* parse();
     celestia::util::array_view<std::string> getErrors() const;
 
+    // Incremental parsing: begin() reads the start of the script, then
+    // next() returns the commands one by one as they're needed. After the
+    // last command or an error, next() returns nullptr and failed() tells
+    // which of them happened.
+    bool begin();
+    Command* next();
+    bool finished() const { return state != State::Parsing; }
+    bool failed() const { return state == State::Failed; }
+
  private:
+    enum class State
+    {
+        Parsing,
+        Finished,
+        Failed,
+    };
+
     Command* parseCommand();
     void error(std::string);
 
@@ -41,6 +57,7 @@ class CommandParser
     Tokenizer* tokenizer;
     std::vector<std::string> errorList;
     std::shared_ptr<celestia::scripts::ScriptMaps> scriptMaps;
+    State state{ State::Parsing };
 };
 
 #endif // _CMDPARSER_H_
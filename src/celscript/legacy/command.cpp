@@ -49,6 +49,31 @@ double TimedCommand::getDuration() const
     return duration;
 }
 
+
+ObjectName::ObjectName(string _name) : name(std::move(_name))
+{
+}
+
+Selection ObjectName::resolve(ExecutionEnvironment& env)
+{
+    Simulation* sim = env.getSimulation();
+    // Names which weren't found aren't cached, so objects defined after
+    // the first attempt are found later.
+    if (!resolved.empty() &&
+        selection == sim->getSelection() &&
+        solarSystem == sim->getNearestSolarSystem() &&
+        catalogChanges == env.getCatalogChanges())
+    {
+        return resolved;
+    }
+
+    resolved = sim->findObjectFromPath(name);
+    selection = sim->getSelection();
+    solarSystem = sim->getNearestSolarSystem();
+    catalogChanges = env.getCatalogChanges();
+    return resolved;
+}
+
 ////////////////
 // Wait command: a no-op with no side effect other than its duration
 
@@ -70,7 +95,7 @@ CommandSelect::CommandSelect(string _target) : target(std::move(_target))
 
 void CommandSelect::process(ExecutionEnvironment& env)
 {
-    Selection sel = env.getSimulation()->findObjectFromPath(target);
+    Selection sel = target.resolve(env);
     env.getSimulation()->setSelection(sel);
 }
 
@@ -227,10 +252,10 @@ CommandSetFrame::CommandSetFrame(ObserverFrame::CoordinateSystem _coordSys,
 
 void CommandSetFrame::process(ExecutionEnvironment& env)
 {
-    Selection ref = env.getSimulation()->findObjectFromPath(refObjectName);
+    Selection ref = refObjectName.resolve(env);
     Selection target;
     if (coordSys == ObserverFrame::PhaseLock)
-        target = env.getSimulation()->findObjectFromPath(targetObjectName);
+        target = targetObjectName.resolve(env);
     env.getSimulation()->setFrame(coordSys, ref, target);
 }
 
@@ -590,7 +615,7 @@ CommandMark::CommandMark(string _target,
 
 void CommandMark::process(ExecutionEnvironment& env)
 {
-    Selection sel = env.getSimulation()->findObjectFromPath(target);
+    Selection sel = target.resolve(env);
     if (sel.empty())
         return;
 
@@ -613,7 +638,7 @@ CommandUnmark::CommandUnmark(string _target) :
 
 void CommandUnmark::process(ExecutionEnvironment& env)
 {
-    Selection sel = env.getSimulation()->findObjectFromPath(target);
+    Selection sel = target.resolve(env);
     if (sel.empty())
         return;
 
@@ -643,7 +668,7 @@ CommandPreloadTextures::CommandPreloadTextures(string _name) :
 
 void CommandPreloadTextures::process(ExecutionEnvironment& env)
 {
-    Selection target = env.getSimulation()->findObjectFromPath(name);
+    Selection target = name.resolve(env);
     if (target.body() == nullptr)
         return;
 
@@ -779,7 +804,7 @@ CommandSetRadius::CommandSetRadius(string _object, double _radius) :
 
 void CommandSetRadius::process(ExecutionEnvironment& env)
 {
-    Selection sel = env.getSimulation()->findObjectFromPath(object);
+    Selection sel = object.resolve(env);
     if (sel.body() != nullptr)
     {
         Body* body = sel.body();
@@ -977,6 +1002,17 @@ void CommandScriptImage::process(ExecutionEnvironment& env)
     env.getCelestiaCore()->setScriptImage(std::move(image));
 }
 
+// PreloadScriptImage command
+CommandPreloadScriptImage::CommandPreloadScriptImage(const fs::path& _filename) :
+    filename(_filename)
+{
+}
+
+void CommandPreloadScriptImage::process(ExecutionEnvironment& /*env*/)
+{
+    PreloadOverlayImage(filename);
+}
+
 // Verbosity command
 CommandVerbosity::CommandVerbosity(int _level) :
     level(_level)
@@ -1124,7 +1160,7 @@ CommandSetRingsTexture::CommandSetRingsTexture(string _object,
 
 void CommandSetRingsTexture::process(ExecutionEnvironment& env)
 {
-    Selection sel = env.getSimulation()->findObjectFromPath(object);
+    Selection sel = object.resolve(env);
     if (sel.body() != nullptr &&
         sel.body()->getRings() != nullptr &&
         !textureName.empty())
@@ -1149,6 +1185,7 @@ void CommandLoadFragment::process(ExecutionEnvironment& env)
     if (u == nullptr)
         return;
 
+    env.catalogChanged();
     istringstream in(fragment);
     if (compareIgnoringCase(type, "ssc") == 0)
     {
@@ -33,6 +33,27 @@ class Command
 typedef std::vector<Command*> CommandSequence;
 
 
+// Name of an object used by a command. Finding an object by its path is
+// a search of the universe, so the result is cached with the context it
+// depends on: the selection, the nearest solar system and the changes to
+// the catalogs. Commands in repeat loops then resolve their names once.
+class ObjectName
+{
+ public:
+    ObjectName(std::string);
+
+    Selection resolve(ExecutionEnvironment&);
+    const std::string& str() const { return name; }
+
+ private:
+    std::string name;
+    Selection resolved;
+    Selection selection;
+    const SolarSystem* solarSystem{ nullptr };
+    unsigned int catalogChanges{ 0 };
+};
+
+
 class InstantaneousCommand : public Command
 {
  public:
@@ -70,7 +91,7 @@ class CommandSelect : public InstantaneousCommand
     void process(ExecutionEnvironment&) override;
 
  private:
-    std::string target;
+    ObjectName target;
 };
 
 
@@ -195,8 +216,8 @@ class CommandSetFrame : public InstantaneousCommand
 
  private:
     ObserverFrame::CoordinateSystem coordSys;
-    std::string refObjectName;
-    std::string targetObjectName;
+    ObjectName refObjectName;
+    ObjectName targetObjectName;
 };
 
 
@@ -511,7 +532,7 @@ class CommandPreloadTextures : public InstantaneousCommand
     void process(ExecutionEnvironment&) override;
 
  private:
-    std::string name;
+    ObjectName name;
 };
 
 
@@ -523,7 +544,7 @@ class CommandMark : public InstantaneousCommand
     void process(ExecutionEnvironment&) override;
 
  private:
-    std::string target;
+    ObjectName target;
     celestia::MarkerRepresentation rep;
     bool occludable;
 };
@@ -537,7 +558,7 @@ class CommandUnmark : public InstantaneousCommand
     void process(ExecutionEnvironment&) override;
 
  private:
-    std::string target;
+    ObjectName target;
 };
 
 
@@ -624,7 +645,7 @@ class CommandSetRadius : public InstantaneousCommand
     void process(ExecutionEnvironment&) override;
 
  private:
-    std::string object;
+    ObjectName object;
     double radius;
 };
 
@@ -719,6 +740,17 @@ class CommandScriptImage : public InstantaneousCommand
     std::array<Color, 4> colors;
 };
 
+class CommandPreloadScriptImage : public InstantaneousCommand
+{
+ public:
+    CommandPreloadScriptImage(const fs::path&);
+
+    void process(ExecutionEnvironment&) override;
+
+ private:
+    fs::path filename;
+};
+
 class CommandVerbosity : public InstantaneousCommand
 {
  public:
@@ -751,7 +783,8 @@ class CommandSetRingsTexture : public InstantaneousCommand
     void process(ExecutionEnvironment&) override;
 
  private:
-    std::string object, textureName, path;
+    ObjectName object;
+    std::string textureName, path;
 };
 
 
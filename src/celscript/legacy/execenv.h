@@ -30,6 +30,14 @@ class ExecutionEnvironment
     virtual CelestiaCore* getCelestiaCore() const = 0;
 
     virtual void showText(std::string, int, int, int, int, double) = 0;
+
+    // Counter of the changes to the catalogs made by the script, which
+    // invalidate the object names resolved by commands
+    unsigned int getCatalogChanges() const { return catalogChanges; }
+    void catalogChanged() { ++catalogChanges; }
+
+ private:
+    unsigned int catalogChanges{ 0 };
 };
 
 #endif // _EXECENV_H_
@@ -8,13 +8,22 @@
 // of the License, or (at your option) any later version.
 
 #include "execution.h"
+#include "cmdparser.h"
 
 using namespace std;
 
 
 Execution::Execution(CommandSequence& cmd, ExecutionEnvironment& _env) :
-    currentCommand(cmd.begin()),
-    finalCommand(cmd.end()),
+    commands(&cmd),
+    env(_env),
+    commandTime(-1.0)
+{
+}
+
+
+Execution::Execution(CommandSequence& cmd, CommandParser& _parser, ExecutionEnvironment& _env) :
+    commands(&cmd),
+    parser(&_parser),
     env(_env),
     commandTime(-1.0)
 {
@@ -32,9 +41,9 @@ bool Execution::tick(double dt)
         return false;
     }
 
-    while (dt > 0.0 && currentCommand != finalCommand)
+    while (dt > 0.0 && hasCommand())
     {
-        Command* cmd = *currentCommand;
+        Command* cmd = (*commands)[currentCommand];
 
         double timeLeft = cmd->getDuration() - commandTime;
         if (dt >= timeLeft)
@@ -52,15 +61,32 @@ bool Execution::tick(double dt)
         }
     }
 
-    return currentCommand == finalCommand;
+    return !hasCommand();
 }
 
 
 void Execution::reset(CommandSequence& cmd)
 {
-    currentCommand = cmd.begin();
-    finalCommand = cmd.end();
+    commands = &cmd;
+    currentCommand = 0;
     commandTime = -1.0;
 }
 
 
+bool Execution::hasCommand()
+{
+    if (currentCommand < commands->size())
+        return true;
+
+    if (parser == nullptr)
+        return false;
+
+    Command* cmd = parser->next();
+    if (cmd == nullptr)
+        return false;
+
+    commands->push_back(cmd);
+    return true;
+}
+
+
@@ -13,18 +13,27 @@
 #include "execenv.h"
 #include "command.h"
 
+class CommandParser;
+
 
 class Execution
 {
  public:
     Execution(CommandSequence&, ExecutionEnvironment&);
+    // Execute the commands while they're parsed: the commands read by
+    // the parser are appended to the sequence when execution reaches its
+    // end. Execution stops when the parser fails.
+    Execution(CommandSequence&, CommandParser&, ExecutionEnvironment&);
 
     bool tick(double);
     void reset(CommandSequence&);
 
  private:
-    CommandSequence::const_iterator currentCommand;
-    CommandSequence::const_iterator finalCommand;
+    bool hasCommand();
+
+    CommandSequence* commands;
+    CommandSequence::size_type currentCommand{ 0 };
+    CommandParser* parser{ nullptr };
     ExecutionEnvironment& env;
     double commandTime;
 };
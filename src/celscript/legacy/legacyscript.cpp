@@ -7,6 +7,7 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <fstream>
 #include <string>
 #include <celcompat/filesystem.h>
@@ -61,24 +62,38 @@ LegacyScript::LegacyScript(CelestiaCore *core) :
 {
 }
 
+LegacyScript::~LegacyScript()
+{
+    for_each(m_commands.begin(), m_commands.end(), [](Command* cmd) { delete cmd; });
+}
+
 bool LegacyScript::load(ifstream &scriptfile, const fs::path &/*path*/, string &errorMsg)
 {
-    CommandParser parser(scriptfile, m_appCore->scriptMaps());
-    CommandSequence* script = parser.parse();
-    if (script == nullptr)
+    // Commands are parsed as the execution reaches them, so long scripts
+    // start without waiting for the whole file to be parsed.
+    m_scriptFile = std::move(scriptfile);
+    m_parser = make_unique<CommandParser>(m_scriptFile, m_appCore->scriptMaps());
+    if (!m_parser->begin())
     {
-        auto errors = parser.getErrors();
+        auto errors = m_parser->getErrors();
         if (!errors.empty())
             errorMsg = errors[0];
         return false;
     }
-    m_runningScript = unique_ptr<Execution>(new Execution(*script, *m_execEnv));
+    m_runningScript = make_unique<Execution>(m_commands, *m_parser, *m_execEnv);
     return true;
 }
 
 bool LegacyScript::tick(double dt)
 {
-    return m_runningScript->tick(dt);
+    bool finished = m_runningScript->tick(dt);
+    if (m_parser->failed())
+    {
+        auto errors = m_parser->getErrors();
+        m_appCore->fatalError(errors.empty() ? string(_("Unknown error loading script")) : errors[0]);
+        return true;
+    }
+    return finished;
 }
 
 bool LegacyScriptPlugin::isOurFile(const fs::path &p) const
@@ -10,8 +10,10 @@
 #pragma once
 
 #include <celscript/common/script.h>
-#include <iosfwd>
+#include <fstream>
+#include "command.h" // CommandSequence
 
+class CommandParser;
 class Execution;
 class ExecutionEnvironment;
 class CelestiaCore;
@@ -23,7 +25,7 @@ class LegacyScript : public IScript
 {
  public:
     LegacyScript(CelestiaCore*);
-    ~LegacyScript() override = default;
+    ~LegacyScript() override;
 
     bool load(std::ifstream&, const fs::path&, std::string&);
 
@@ -31,6 +33,10 @@ class LegacyScript : public IScript
 
  private:
     CelestiaCore *m_appCore;
+    // The script is parsed while it runs, so the file stays open
+    std::ifstream m_scriptFile;
+    std::unique_ptr<CommandParser> m_parser;
+    CommandSequence m_commands;
     std::unique_ptr<Execution> m_runningScript;
     std::unique_ptr<ExecutionEnvironment> m_execEnv;
 
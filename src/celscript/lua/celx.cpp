@@ -13,6 +13,7 @@
 #include <config.h>
 #include <cassert>
 #include <ctime>
+#include <iterator>
 #include <map>
 #include <sstream>
 #include <utility>
@@ -37,6 +38,9 @@
 #include "celx_object.h"
 #include "celx_observer.h"
 #include "celx_celestia.h"
+#ifdef CELX_LUAJIT
+#include "celx_ffi.h"
+#endif
 #include "celx_gl.h"
 #include "celx_category.h"
 
@@ -44,6 +48,8 @@
 using namespace Eigen;
 using namespace std;
 using celestia::util::GetLogger;
+using celestia::util::GetProfiler;
+using celestia::util::Profiler;
 
 const char* CelxLua::ClassNames[] =
 {
@@ -65,6 +71,11 @@ const char* CelxLua::ClassNames[] =
 
 #define CLASS(i) ClassNames[(i)]
 
+// The metatables of the classes are also stored in the registry with the
+// addresses of these as keys, so that objects can be created and checked
+// without hashing the class names.
+static char ClassKeys[std::size(CelxLua::ClassNames)];
+
 // Maximum timeslice a script may run without
 // returning control to celestia
 static const double MaxTimeslice = 5.0;
@@ -116,7 +127,7 @@ void PushClass(lua_State* l, int id)
 // Set the class (metatable) of the object on top of the stack
 void Celx_SetClass(lua_State* l, int id)
 {
-    PushClass(l, id);
+    lua_pushlightuserdata(l, &ClassKeys[id]);
     lua_rawget(l, LUA_REGISTRYINDEX);
     if (lua_type(l, -1) != LUA_TTABLE)
         cout << "Metatable for " << CelxLua::ClassNames[id] << " not found!\n";
@@ -135,6 +146,9 @@ void Celx_CreateClassMetatable(lua_State* l, int id)
     lua_pushvalue(l, -1);
     PushClass(l, id);
     lua_rawset(l, LUA_REGISTRYINDEX); // registry.metatable = name
+    lua_pushlightuserdata(l, &ClassKeys[id]);
+    lua_pushvalue(l, -2);
+    lua_rawset(l, LUA_REGISTRYINDEX); // registry[key] = metatable
 
     lua_pushliteral(l, "__index");
     lua_pushvalue(l, -2);
@@ -155,21 +169,14 @@ void Celx_RegisterMethod(lua_State* l, const char* name, lua_CFunction fn)
 // specified class
 bool Celx_istype(lua_State* l, int index, int id)
 {
-    // get registry[metatable]
     if (!lua_getmetatable(l, index))
         return false;
+    lua_pushlightuserdata(l, &ClassKeys[id]);
     lua_rawget(l, LUA_REGISTRYINDEX);
 
-    if (lua_type(l, -1) != LUA_TSTRING)
-    {
-        cout << "Celx_istype failed!  Unregistered class.\n";
-        lua_pop(l, 1);
-        return false;
-    }
-
-    const char* classname = lua_tostring(l, -1);
-    lua_pop(l, 1);
-    return classname != nullptr && strcmp(classname, CelxLua::ClassNames[id]) == 0;
+    bool result = lua_rawequal(l, -1, -2) != 0;
+    lua_pop(l, 2);
+    return result;
 }
 
 // Verify that an object at location index on the stack is of the
@@ -260,6 +267,16 @@ static void checkTimeslice(lua_State* l, lua_Debug* /*ar*/)
         lua_pushstring(l, errormsg);
         lua_error(l);
     }
+
+#if LUA_VERSION_NUM >= 503
+    // Suspend a script which used up its time for this tick as if it had
+    // called wait(0)
+    if (luastate->shouldPreempt(l))
+    {
+        luastate->preempt();
+        lua_yield(l, 0);
+    }
+#endif
 }
 
 
@@ -346,7 +363,7 @@ bool LuaState::timesliceExpired()
 }
 
 
-static int resumeLuaThread(lua_State *L, lua_State *co, int narg)
+static int resumeLuaThread(lua_State *L, lua_State *co, int narg, const bool &preempted)
 {
     int status;
 
@@ -361,6 +378,11 @@ static int resumeLuaThread(lua_State *L, lua_State *co, int narg)
 #else
     status = lua_resume(co, narg);
 #endif
+    // A thread suspended by the hook yields no values, and its stack is
+    // that of the interrupted function
+    if (status == LUA_YIELD && preempted)
+        return 0;
+
     if (status == 0 || status == LUA_YIELD)
     {
         int nres = lua_gettop(co);
@@ -381,6 +403,25 @@ bool LuaState::isAlive() const
 }
 
 
+// Return true if the script coroutine running l has used up its time for
+// the current tick and can be suspended. Coroutines created by the script
+// itself are never suspended, as that would make them return early.
+bool LuaState::shouldPreempt(lua_State* l) const
+{
+#if LUA_VERSION_NUM >= 503
+    return l == costate && tickBudget > 0.0 && getTime() > sliceEnd && lua_isyieldable(l);
+#else
+    return false;
+#endif
+}
+
+
+void LuaState::preempt()
+{
+    preempted = true;
+}
+
+
 struct ReadChunkInfo
 {
     char* buf;
@@ -683,8 +724,13 @@ int LuaState::resume()
     if (co != costate)
         return 0;
 
-    timeout = getTime() + MaxTimeslice;
-    int nArgs = resumeLuaThread(state, co, 0);
+    double startTime = getTime();
+    timeout = startTime + MaxTimeslice;
+    sliceEnd = startTime + tickBudget;
+    preempted = false;
+    int nArgs = resumeLuaThread(state, co, 0, preempted);
+    runTime += getTime() - startTime;
+    resumeCount++;
     if (nArgs < 0)
     {
         alive = false;
@@ -819,6 +865,39 @@ bool LuaState::tick(double dt)
 }
 
 
+void LuaState::beginProfileZone(std::string_view name)
+{
+    Profiler* profiler = GetProfiler();
+    if (profiler == nullptr || !profiler->isOwnerThread())
+        return;
+
+    std::size_t zone = profiler->getZone(profiler->internName(name),
+                                         Profiler::Source::CPU,
+                                         profiler->enterZone());
+    profileZones.push_back({ zone, profiler->getFrame(), Profiler::clock::now() });
+}
+
+
+bool LuaState::endProfileZone()
+{
+    Profiler* profiler = GetProfiler();
+    if (profiler == nullptr || profileZones.empty())
+        return false;
+
+    const OpenProfileZone& open = profileZones.back();
+    profiler->addTime(open.zone, open.frame, open.start, Profiler::clock::now());
+    profiler->leaveZone();
+    profileZones.pop_back();
+    return true;
+}
+
+
+void LuaState::endProfileZones()
+{
+    while (endProfileZone()) {}
+}
+
+
 void LuaState::requestIO()
 {
     // the script requested IO, set the mode
@@ -1073,6 +1152,9 @@ bool LuaState::init(CelestiaCore* appCore)
     lua_pushnumber(state, (lua_Number)KM_PER_LY/1e6);
     lua_setglobal(state, "KM_PER_MICROLY");
 
+    if (const CelestiaConfig* config = appCore->getConfig(); config != nullptr)
+        tickBudget = config->scriptTickBudget / 1000.0;
+
     loadLuaLibs(state);
 
     // Create the celestia object
@@ -1138,6 +1220,9 @@ static void loadLuaLibs(lua_State* state)
     ExtendObjectMetaTable(state);
 
     LoadLuaGraphicsLibrary(state);
+#ifdef CELX_LUAJIT
+    LoadLuaFFILibrary(state);
+#endif
 }
 
 
@@ -1204,6 +1289,7 @@ bool LuaState::callLuaHook(void* obj, const char* method)
            handled = lua_toboolean(costate, -1) == 1 ? true : false;
         }
         lua_pop(costate, 1);             // pop the return value
+        FlushLuaGraphics();
     }
     else
     {
@@ -11,11 +11,14 @@
 
 #pragma once
 
+#include <cstdint>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <lua.hpp>
 #include <celcompat/filesystem.h>
+#include <celutil/profiler.h>
 #include <celutil/timer.h>
 #include <celengine/observer.h>
 
@@ -50,8 +53,15 @@ public:
     void cleanup();
     bool isAlive() const;
     bool timesliceExpired();
+    bool shouldPreempt(lua_State*) const;
+    void preempt();
     void requestIO();
 
+    // Time in seconds the script coroutine has been running, and the number
+    // of times it was resumed
+    double getRunTime() const { return runTime; }
+    unsigned int getResumeCount() const { return resumeCount; }
+
     bool charEntered(const char*);
     double getTime() const;
     int screenshotCount;
@@ -73,6 +83,13 @@ public:
     bool callLuaHook(void* obj, const char* method, float x, float y, int b);
     bool callLuaHook(void* obj, const char* method, double dt);
 
+    // Zones of the frame profiler opened by celestia:profilebegin() and
+    // closed by profileend(), or else at the end of the hook call or tick
+    // which opened them
+    void beginProfileZone(std::string_view name);
+    bool endProfileZone();
+    void endProfileZones();
+
     enum IOMode {
         NoIO = 1,
         Asking = 2,
@@ -86,8 +103,23 @@ private:
     bool alive{ false };
     Timer* timer;
     double scriptAwakenTime{ 0.0 };
+    // Time a script may run per tick before it is suspended until the next
+    // one; zero lets it run until it yields
+    double tickBudget{ 0.0 };
+    double sliceEnd{ 0.0 };
+    bool preempted{ false };
+    double runTime{ 0.0 };
+    unsigned int resumeCount{ 0 };
     IOMode ioMode{ NoIO };
     bool eventHandlerEnabled{ false };
+
+    struct OpenProfileZone
+    {
+        std::size_t zone;
+        std::uint64_t frame;
+        celestia::util::Profiler::clock::time_point start;
+    };
+    std::vector<OpenProfileZone> profileZones;
 };
 
 View* getViewByObserver(CelestiaCore*, Observer*);
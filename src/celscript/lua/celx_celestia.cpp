@@ -9,6 +9,10 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <limits>
 #include <optional>
 #include <fmt/format.h>
 #include "celx.h"
@@ -23,12 +27,15 @@
 #include "celx_vector.h"
 #include "celx_category.h"
 #include <celestia/audiosession.h>
+#include <celestia/eventfinder.h>
 #include <celestia/url.h>
 #include <celestia/celestiacore.h>
 #include <celestia/view.h>
 #include <celscript/common/scriptmaps.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
+#include <celutil/memoryusage.h>
+#include <celutil/jobsystem.h>
 #include <celttf/truetypefont.h>
 #include <celengine/category.h>
 #include <celengine/texture.h>
@@ -40,6 +47,8 @@ using namespace Eigen;
 using namespace celestia;
 using namespace celestia::scripts;
 using celestia::util::GetLogger;
+using celestia::util::GetProfiler;
+using celestia::util::Profiler;
 
 extern const char* KbdCallback;
 extern const char* CleanupCallback;
@@ -1059,6 +1068,73 @@ static int celestia_getselection(lua_State* l)
     return 1;
 }
 
+// celestia:getpositions(objects [, t [, result]]) returns a table with the
+// x, y and z coordinates in microlight-years of the positions of the
+// objects of the array at time t, one after the other. Filling the table
+// passed as result instead of a new one, scripts can get the positions of
+// many objects each frame without creating garbage.
+static int celestia_getpositions(lua_State* l)
+{
+    CelxLua celx(l);
+    celx.checkArgs(2, 4, "One to three arguments expected to celestia:getpositions()");
+    CelestiaCore* appCore = this_celestia(l);
+
+    if (!lua_istable(l, 2))
+    {
+        celx.doError("First argument to celestia:getpositions() must be a table");
+        return 0;
+    }
+
+    double t = appCore->getSimulation()->getTime();
+    if (!lua_isnoneornil(l, 3))
+        t = celx.safeGetNumber(3, WrongType, "Second argument to celestia:getpositions() must be a number");
+
+    if (lua_isnoneornil(l, 4))
+    {
+        lua_settop(l, 3);
+        lua_newtable(l);
+    }
+    else if (!lua_istable(l, 4))
+    {
+        celx.doError("Third argument to celestia:getpositions() must be a table");
+        return 0;
+    }
+
+    int i = 1;
+    for (;; i++)
+    {
+        lua_rawgeti(l, 2, i);
+        if (lua_isnil(l, -1))
+        {
+            lua_pop(l, 1);
+            break;
+        }
+
+        Selection* sel = celx.toObject(-1);
+        if (sel == nullptr)
+        {
+            celx.doError("Objects expected in the table passed to celestia:getpositions()");
+            return 0;
+        }
+        UniversalCoord position = sel->getPosition(t);
+        lua_pop(l, 1);
+
+        lua_pushnumber(l, static_cast<double>(position.x));
+        lua_rawseti(l, 4, 3 * i - 2);
+        lua_pushnumber(l, static_cast<double>(position.y));
+        lua_rawseti(l, 4, 3 * i - 1);
+        lua_pushnumber(l, static_cast<double>(position.z));
+        lua_rawseti(l, 4, 3 * i);
+    }
+
+    // End the sequence where a reused table may have held more objects
+    lua_pushnil(l);
+    lua_rawseti(l, 4, 3 * i - 2);
+
+    lua_settop(l, 4);
+    return 1;
+}
+
 static int celestia_find(lua_State* l)
 {
     Celx_CheckArgs(l, 2, 2, "One argument expected for function celestia:find()");
@@ -1438,6 +1514,155 @@ static int celestia_getdsocount(lua_State* l)
 }
 
 
+static void pushMemoryUsage(lua_State* l, const celestia::util::MemoryUsage& usage)
+{
+    lua_createtable(l, 0, 4);
+    lua_pushstring(l, usage.name.c_str());
+    lua_setfield(l, -2, "name");
+    lua_pushnumber(l, static_cast<lua_Number>(usage.total()));
+    lua_setfield(l, -2, "bytes");
+    lua_pushnumber(l, static_cast<lua_Number>(usage.count));
+    lua_setfield(l, -2, "count");
+
+    lua_createtable(l, static_cast<int>(usage.children.size()), 0);
+    for (std::size_t i = 0; i < usage.children.size(); i++)
+    {
+        pushMemoryUsage(l, usage.children[i]);
+        lua_rawseti(l, -2, static_cast<int>(i + 1));
+    }
+    lua_setfield(l, -2, "children");
+}
+
+// celestia:getmemoryusage() returns the estimated memory of the catalogs,
+// caches and loaded resources as a tree of tables with the fields name,
+// bytes (including the children), count of objects and children.
+static int celestia_getmemoryusage(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 1, "No arguments expected to function celestia:getmemoryusage");
+
+    CelestiaCore* appCore = this_celestia(l);
+    pushMemoryUsage(l, appCore->getMemoryUsage());
+
+    return 1;
+}
+
+
+// celestia:getrenderstats() returns the counters of the work done to draw
+// the last frame as a table of numbers.
+static int celestia_getrenderstats(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 1, "No arguments expected to function celestia:getrenderstats");
+
+    CelestiaCore* appCore = this_celestia(l);
+    const Renderer::FrameStats& stats = appCore->getRenderer()->getFrameStats();
+
+    auto setField = [l](const char* name, auto value)
+    {
+        lua_pushnumber(l, static_cast<lua_Number>(value));
+        lua_setfield(l, -2, name);
+    };
+
+    using celestia::gl::UploadType;
+    auto uploaded = [&stats](UploadType type)
+    {
+        return stats.draw.uploadedBytes[static_cast<std::size_t>(type)];
+    };
+
+    lua_createtable(l, 0, 22);
+    setField("drawcalls", stats.draw.drawCalls);
+    setField("triangles", stats.draw.triangles);
+    setField("lines", stats.draw.lines);
+    setField("points", stats.draw.points);
+    setField("statecalls", stats.stateCalls);
+    setField("statecallsskipped", stats.stateCallsSkipped);
+    setField("programchanges", stats.draw.programChanges);
+    setField("texturebinds", stats.draw.textureBinds);
+    setField("vertexbytes", uploaded(UploadType::Vertex));
+    setField("indexbytes", uploaded(UploadType::Index));
+    setField("uniformbytes", uploaded(UploadType::Uniform));
+    setField("texturebytes", uploaded(UploadType::Texture));
+    setField("otherbytes", uploaded(UploadType::Other));
+    setField("starnodes", stats.starNodes);
+    setField("stars", stats.stars);
+    setField("dsonodes", stats.dsoNodes);
+    setField("dsos", stats.dsos);
+    setField("renderlist", stats.renderListEntries);
+    setField("orbitpaths", stats.orbitPaths);
+    setField("labels", stats.annotations);
+    setField("resourcesloaded", stats.resourcesLoaded);
+    setField("views", stats.views);
+
+    return 1;
+}
+
+
+// celestia:profilebegin(name) and celestia:profileend() time a zone of the
+// script with the frame profiler, nested in the zone of the hook or script
+// tick calling them. Zones left open are closed when that call returns.
+static int celestia_profilebegin(lua_State* l)
+{
+    Celx_CheckArgs(l, 2, 2, "One argument expected for celestia:profilebegin");
+    const char* name = Celx_SafeGetString(l, 2, AllErrors, "Argument to celestia:profilebegin must be a string");
+    if (name == nullptr)
+        return 0;
+
+    getLuaStateObject(l)->beginProfileZone(name);
+    return 0;
+}
+
+static int celestia_profileend(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 1, "No arguments expected for celestia:profileend");
+
+    getLuaStateObject(l)->endProfileZone();
+    return 0;
+}
+
+// celestia:getprofilestats([frames]) returns the times of the zones of the
+// frame profiler over the last frames, 120 at most, as an array of tables
+// with the fields name, source ("cpu" or "gpu"), depth, average and
+// maximum, in milliseconds per frame; nil when the profiler is off.
+static int celestia_getprofilestats(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 2, "At most one argument expected for celestia:getprofilestats");
+
+    Profiler* profiler = GetProfiler();
+    if (profiler == nullptr)
+    {
+        lua_pushnil(l);
+        return 1;
+    }
+
+    auto frames = static_cast<std::size_t>(Profiler::HistorySize);
+    if (lua_gettop(l) == 2)
+    {
+        double n = Celx_SafeGetNumber(l, 2, AllErrors, "Argument to celestia:getprofilestats must be a number");
+        frames = static_cast<std::size_t>(std::clamp(n, 1.0, static_cast<double>(Profiler::HistorySize)));
+    }
+
+    auto stats = profiler->getStats(frames);
+    lua_createtable(l, static_cast<int>(stats.size()), 0);
+    for (std::size_t i = 0; i < stats.size(); i++)
+    {
+        const Profiler::ZoneStats& zone = stats[i];
+        lua_createtable(l, 0, 5);
+        lua_pushstring(l, zone.name);
+        lua_setfield(l, -2, "name");
+        lua_pushstring(l, zone.source == Profiler::Source::GPU ? "gpu" : "cpu");
+        lua_setfield(l, -2, "source");
+        lua_pushnumber(l, zone.depth);
+        lua_setfield(l, -2, "depth");
+        lua_pushnumber(l, zone.average);
+        lua_setfield(l, -2, "average");
+        lua_pushnumber(l, zone.maximum);
+        lua_setfield(l, -2, "maximum");
+        lua_rawseti(l, -2, static_cast<int>(i + 1));
+    }
+
+    return 1;
+}
+
+
 // DSOs iterator function; two upvalues expected
 static int celestia_dsos_iter(lua_State* l)
 {
@@ -1741,6 +1966,179 @@ static int celestia_getstar(lua_State* l)
     return 1;
 }
 
+namespace
+{
+// Filter of celestia:findstars(); stars are compared with the limits
+// which are set
+struct StarQuery
+{
+    Eigen::Vector3f center;
+    float maxDistance{ std::numeric_limits<float>::infinity() };
+    float maxAppMag{ std::numeric_limits<float>::infinity() };
+    float maxAbsMag{ std::numeric_limits<float>::infinity() };
+    std::string spectral;
+
+    bool matches(const Star& star) const
+    {
+        if (star.getAbsoluteMagnitude() > maxAbsMag)
+            return false;
+        if (!spectral.empty() && std::strncmp(star.getSpectralType(), spectral.c_str(), spectral.size()) != 0)
+            return false;
+
+        if (maxDistance == std::numeric_limits<float>::infinity() &&
+            maxAppMag == std::numeric_limits<float>::infinity())
+            return true;
+        float distance = (star.getPosition() - center).norm();
+        return distance <= maxDistance && star.getApparentMagnitude(distance) <= maxAppMag;
+    }
+};
+
+class StarCollector : public StarHandler
+{
+ public:
+    explicit StarCollector(vector<const Star*>& _stars) : stars(_stars) {}
+    void process(const Star& star, float /*distance*/, float /*appMag*/) override
+    {
+        stars.push_back(&star);
+    }
+
+ private:
+    vector<const Star*>& stars;
+};
+
+// Catalogs smaller than this are scanned by the calling thread alone
+constexpr std::uint32_t ParallelStarScanSize = 262144;
+constexpr std::uint32_t StarScanChunkSize = 65536;
+
+// Find the stars of starDB matching query, in the order of the catalog
+void findStars(const StarDatabase& starDB, const StarQuery& query, vector<const Star*>& stars)
+{
+    if (query.maxDistance != std::numeric_limits<float>::infinity())
+    {
+        // Spatial queries only visit the octree nodes near the center
+        vector<const Star*> nearStars;
+        StarCollector collector(nearStars);
+        starDB.findCloseStars(collector, query.center, query.maxDistance);
+        std::copy_if(nearStars.begin(), nearStars.end(), std::back_inserter(stars),
+                     [&query](const Star* star) { return query.matches(*star); });
+        return;
+    }
+
+    std::uint32_t nStars = starDB.size();
+    auto scan = [&starDB, &query](std::uint32_t begin, std::uint32_t end, vector<const Star*>& found)
+    {
+        for (std::uint32_t i = begin; i < end; i++)
+        {
+            const Star* star = starDB.getStar(i);
+            if (query.matches(*star))
+                found.push_back(star);
+        }
+    };
+
+    if (nStars < ParallelStarScanSize || util::GetJobSystem() == nullptr)
+    {
+        scan(0, nStars, stars);
+        return;
+    }
+
+    vector<vector<const Star*>> chunks((nStars + StarScanChunkSize - 1) / StarScanChunkSize);
+    util::ParallelFor(0, chunks.size(), 1, [&scan, &chunks, nStars](std::size_t first, std::size_t last)
+    {
+        for (std::size_t chunk = first; chunk < last; chunk++)
+        {
+            auto begin = static_cast<std::uint32_t>(chunk * StarScanChunkSize);
+            std::uint32_t end = std::min(nStars, begin + StarScanChunkSize);
+            scan(begin, end, chunks[chunk]);
+        }
+    });
+
+    for (const auto& chunk : chunks)
+        stars.insert(stars.end(), chunk.begin(), chunk.end());
+}
+} // end unnamed namespace
+
+// celestia:findstars{...} returns a table with the stars of the catalog
+// matching all the criteria of the table passed to it:
+//   maxdist:   maximum distance in light years from center
+//   maxappmag: maximum apparent magnitude seen from center
+//   maxabsmag: maximum absolute magnitude
+//   spectral:  start of the spectral type, such as "G" or "M5V"
+//   center:    position of the distances, the observer by default
+//   limit:     maximum number of stars returned
+// The catalog is filtered natively, using the octree for distances.
+static int celestia_findstars(lua_State* l)
+{
+    CelxLua celx(l);
+    celx.checkArgs(2, 2, "One table expected as argument to celestia:findstars");
+
+    CelestiaCore* appCore = this_celestia(l);
+    if (!lua_istable(l, 2))
+    {
+        celx.doError("Argument to celestia:findstars must be a table");
+        return 0;
+    }
+
+    const float inf = std::numeric_limits<float>::infinity();
+    StarQuery query;
+    UniversalCoord center = appCore->getSimulation()->getActiveObserver()->getPosition();
+
+    lua_pushstring(l, "maxdist");
+    lua_gettable(l, 2);
+    query.maxDistance = static_cast<float>(celx.safeGetNumber(3, WrongType, "maxdist must be a number", inf));
+    lua_settop(l, 2);
+
+    lua_pushstring(l, "maxappmag");
+    lua_gettable(l, 2);
+    query.maxAppMag = static_cast<float>(celx.safeGetNumber(3, WrongType, "maxappmag must be a number", inf));
+    lua_settop(l, 2);
+
+    lua_pushstring(l, "maxabsmag");
+    lua_gettable(l, 2);
+    query.maxAbsMag = static_cast<float>(celx.safeGetNumber(3, WrongType, "maxabsmag must be a number", inf));
+    lua_settop(l, 2);
+
+    lua_pushstring(l, "spectral");
+    lua_gettable(l, 2);
+    if (!lua_isnil(l, 3))
+        query.spectral = celx.safeGetString(3, WrongType, "spectral must be a string");
+    lua_settop(l, 2);
+
+    lua_pushstring(l, "center");
+    lua_gettable(l, 2);
+    if (!lua_isnil(l, 3))
+    {
+        UniversalCoord* position = celx.toPosition(3);
+        if (position == nullptr)
+        {
+            celx.doError("center must be a position");
+            return 0;
+        }
+        center = *position;
+    }
+    lua_settop(l, 2);
+
+    lua_pushstring(l, "limit");
+    lua_gettable(l, 2);
+    double limit = celx.safeGetNumber(3, WrongType, "limit must be a number", -1.0);
+    lua_settop(l, 2);
+
+    query.center = center.toLy().cast<float>();
+
+    vector<const Star*> stars;
+    findStars(*appCore->getSimulation()->getUniverse()->getStarCatalog(), query, stars);
+    if (limit >= 0.0 && stars.size() > limit)
+        stars.resize(static_cast<std::size_t>(limit));
+
+    lua_createtable(l, static_cast<int>(stars.size()), 0);
+    for (std::size_t i = 0; i < stars.size(); i++)
+    {
+        object_new(l, Selection(const_cast<Star*>(stars[i])));
+        lua_rawseti(l, -2, static_cast<int>(i + 1));
+    }
+
+    return 1;
+}
+
 static int celestia_getdso(lua_State* l)
 {
     Celx_CheckArgs(l, 2, 2, "One argument expected to function celestia:getdso");
@@ -1757,6 +2155,136 @@ static int celestia_getdso(lua_State* l)
     return 1;
 }
 
+// Read a table of celestia objects at the given stack index
+static bool getObjectList(lua_State* l, int index, vector<Selection>& objects)
+{
+    if (!lua_istable(l, index))
+        return false;
+
+    lua_pushnil(l);
+    while (lua_next(l, index) != 0)
+    {
+        Selection* sel = to_object(l, -1);
+        if (sel == nullptr)
+        {
+            lua_pop(l, 2);
+            return false;
+        }
+        objects.push_back(*sel);
+        lua_pop(l, 1);
+    }
+
+    return true;
+}
+
+static void pushEvents(lua_State* l, const vector<CelestialEvent>& events)
+{
+    lua_newtable(l);
+    for (unsigned int i = 0; i < events.size(); i++)
+    {
+        const CelestialEvent& event = events[i];
+        lua_newtable(l);
+        switch (event.type)
+        {
+        case CelestialEvent::Conjunction:
+            lua_pushstring(l, "conjunction");
+            break;
+        case CelestialEvent::Occultation:
+            lua_pushstring(l, "occultation");
+            break;
+        case CelestialEvent::Transit:
+            lua_pushstring(l, "transit");
+            break;
+        }
+        lua_setfield(l, -2, "type");
+        object_new(l, event.front);
+        lua_setfield(l, -2, "front");
+        object_new(l, event.back);
+        lua_setfield(l, -2, "back");
+        setTable(l, "starttime", event.startTime);
+        setTable(l, "endtime", event.endTime);
+        setTable(l, "maxtime", event.maximumTime);
+        setTable(l, "separation", event.minSeparation);
+        lua_rawseti(l, -2, i + 1);
+    }
+}
+
+static int celestia_findconjunctions(lua_State* l)
+{
+    Celx_CheckArgs(l, 6, 7, "Five or six arguments expected to function celestia:findconjunctions");
+
+    this_celestia(l);
+    Selection* observer = to_object(l, 2);
+    if (observer == nullptr)
+    {
+        Celx_DoError(l, "First arg to celestia:findconjunctions must be an object");
+        return 0;
+    }
+
+    vector<Selection> objects;
+    if (!getObjectList(l, 3, objects))
+    {
+        Celx_DoError(l, "Second arg to celestia:findconjunctions must be a table of objects");
+        return 0;
+    }
+
+    double maxSeparation = Celx_SafeGetNumber(l, 4, AllErrors, "Third arg to celestia:findconjunctions must be a number");
+    double startTime = Celx_SafeGetNumber(l, 5, AllErrors, "Fourth arg to celestia:findconjunctions must be a number");
+    double endTime = Celx_SafeGetNumber(l, 6, AllErrors, "Fifth arg to celestia:findconjunctions must be a number");
+
+    CelestialEventFinder finder(*observer);
+    finder.setSearchStep(Celx_SafeGetNumber(l, 7, WrongType, "Sixth arg to celestia:findconjunctions must be a number",
+                                            finder.getSearchStep()));
+
+    vector<CelestialEvent> events;
+    finder.findConjunctions(objects, maxSeparation, startTime, endTime, events);
+    pushEvents(l, events);
+
+    return 1;
+}
+
+static int celestia_findoccultations(lua_State* l)
+{
+    Celx_CheckArgs(l, 6, 7, "Five or six arguments expected to function celestia:findoccultations");
+
+    this_celestia(l);
+    Selection* observer = to_object(l, 2);
+    if (observer == nullptr)
+    {
+        Celx_DoError(l, "First arg to celestia:findoccultations must be an object");
+        return 0;
+    }
+
+    vector<Selection> occulters;
+    if (!getObjectList(l, 3, occulters))
+    {
+        Celx_DoError(l, "Second arg to celestia:findoccultations must be a table of objects");
+        return 0;
+    }
+
+    vector<Selection> targets;
+    if (!getObjectList(l, 4, targets))
+    {
+        Celx_DoError(l, "Third arg to celestia:findoccultations must be a table of objects");
+        return 0;
+    }
+
+    double startTime = Celx_SafeGetNumber(l, 5, AllErrors, "Fourth arg to celestia:findoccultations must be a number");
+    double endTime = Celx_SafeGetNumber(l, 6, AllErrors, "Fifth arg to celestia:findoccultations must be a number");
+
+    CelestialEventFinder finder(*observer);
+    finder.setSearchStep(Celx_SafeGetNumber(l, 7, WrongType, "Sixth arg to celestia:findoccultations must be a number",
+                                            finder.getSearchStep()));
+
+    vector<CelestialEvent> events;
+    finder.findOccultations(occulters, targets,
+                            CelestialEvent::Occultation | CelestialEvent::Transit,
+                            startTime, endTime, events);
+    pushEvents(l, events);
+
+    return 1;
+}
+
 
 static int celestia_newvector(lua_State* l)
 {
@@ -2036,6 +2564,49 @@ static int celestia_takescreenshot(lua_State* l)
     return 1;
 }
 
+static int celestia_startimagesequence(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 4, "Need 0 to 3 arguments for celestia:startimagesequence");
+    CelestiaCore* appCore = this_celestia(l);
+
+    const char* filetype = Celx_SafeGetString(l, 2, WrongType, "First argument to celestia:startimagesequence must be a string");
+    if (filetype == nullptr)
+        filetype = "png";
+
+    // Like takescreenshot, the script only names a part of the files
+    const char* fileid_ptr = Celx_SafeGetString(l, 3, WrongType, "Second argument to celestia:startimagesequence must be a string");
+    if (fileid_ptr == nullptr)
+        fileid_ptr = "";
+    string fileid(fileid_ptr);
+    for (char& ch : fileid)
+    {
+        if (!((ch >= 'a' && ch <= 'z') ||
+              (ch >= 'A' && ch <= 'Z') ||
+              (ch >= '0' && ch <= '9')))
+            ch = '_';
+    }
+    if (fileid.length() > 16)
+        fileid = fileid.substr(0, 16);
+    if (fileid.length() > 0)
+        fileid.append("-");
+
+    // Without a frame rate the sequence records at render speed
+    auto fps = static_cast<float>(Celx_SafeGetNumber(l, 4, WrongType, "Third argument to celestia:startimagesequence must be a number", 0.0));
+
+    fs::path path = appCore->getConfig()->scriptScreenshotDirectory;
+    fs::path filepath = path / fmt::format("sequence-{}{{:06d}}.{}", fileid, filetype);
+    lua_pushboolean(l, appCore->startImageSequence(filepath, fps));
+    return 1;
+}
+
+static int celestia_endimagesequence(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 1, "No arguments expected for celestia:endimagesequence");
+    CelestiaCore* appCore = this_celestia(l);
+    appCore->recordEnd();
+    return 0;
+}
+
 static int celestia_createcelscript(lua_State* l)
 {
     Celx_CheckArgs(l, 2, 2, "Need one argument for celestia:createcelscript()");
@@ -2168,6 +2739,37 @@ static int celestia_overlay(lua_State* l)
     return 0;
 }
 
+// celestia:preloadoverlay(filename) starts loading an image, or a table of
+// images, which a later celestia:overlay() call will show, so that showing
+// it doesn't wait for the file to be read.
+static int celestia_preloadoverlay(lua_State* l)
+{
+    Celx_CheckArgs(l, 2, 2, "One argument expected to function celestia:preloadoverlay");
+
+    if (!lua_istable(l, 2))
+    {
+        const char* filename = Celx_SafeGetString(l, 2, AllErrors, "Argument to celestia:preloadoverlay must be a string or a table of strings");
+        PreloadOverlayImage(filename);
+        return 0;
+    }
+
+    for (int i = 1;; i++)
+    {
+        lua_rawgeti(l, 2, i);
+        if (lua_isnil(l, -1))
+        {
+            lua_pop(l, 1);
+            break;
+        }
+        if (!lua_isstring(l, -1))
+            Celx_DoError(l, "Values in table-argument to celestia:preloadoverlay() must be strings");
+        PreloadOverlayImage(lua_tostring(l, -1));
+        lua_pop(l, 1);
+    }
+
+    return 0;
+}
+
 static int celestia_verbosity(lua_State* l)
 {
     Celx_CheckArgs(l, 2, 2, "One argument expected to function celestia:verbosity");
@@ -2556,6 +3158,7 @@ void CreateCelestiaMetaTable(lua_State* l)
     Celx_RegisterMethod(l, "getobserver", celestia_getobserver);
     Celx_RegisterMethod(l, "getobservers", celestia_getobservers);
     Celx_RegisterMethod(l, "getselection", celestia_getselection);
+    Celx_RegisterMethod(l, "getpositions", celestia_getpositions);
     Celx_RegisterMethod(l, "find", celestia_find);
     Celx_RegisterMethod(l, "select", celestia_select);
     Celx_RegisterMethod(l, "mark", celestia_mark);
@@ -2591,8 +3194,16 @@ void CreateCelestiaMetaTable(lua_State* l)
     Celx_RegisterMethod(l, "getsystemtime", celestia_getsystemtime);
     Celx_RegisterMethod(l, "getstarcount", celestia_getstarcount);
     Celx_RegisterMethod(l, "getdsocount", celestia_getdsocount);
+    Celx_RegisterMethod(l, "getmemoryusage", celestia_getmemoryusage);
+    Celx_RegisterMethod(l, "getrenderstats", celestia_getrenderstats);
+    Celx_RegisterMethod(l, "profilebegin", celestia_profilebegin);
+    Celx_RegisterMethod(l, "profileend", celestia_profileend);
+    Celx_RegisterMethod(l, "getprofilestats", celestia_getprofilestats);
     Celx_RegisterMethod(l, "getstar", celestia_getstar);
+    Celx_RegisterMethod(l, "findstars", celestia_findstars);
     Celx_RegisterMethod(l, "getdso", celestia_getdso);
+    Celx_RegisterMethod(l, "findconjunctions", celestia_findconjunctions);
+    Celx_RegisterMethod(l, "findoccultations", celestia_findoccultations);
     Celx_RegisterMethod(l, "newframe", celestia_newframe);
     Celx_RegisterMethod(l, "newvector", celestia_newvector);
     Celx_RegisterMethod(l, "newposition", celestia_newposition);
@@ -2600,6 +3211,8 @@ void CreateCelestiaMetaTable(lua_State* l)
     Celx_RegisterMethod(l, "getscripttime", celestia_getscripttime);
     Celx_RegisterMethod(l, "requestkeyboard", celestia_requestkeyboard);
     Celx_RegisterMethod(l, "takescreenshot", celestia_takescreenshot);
+    Celx_RegisterMethod(l, "startimagesequence", celestia_startimagesequence);
+    Celx_RegisterMethod(l, "endimagesequence", celestia_endimagesequence);
     Celx_RegisterMethod(l, "createcelscript", celestia_createcelscript);
     Celx_RegisterMethod(l, "requestsystemaccess", celestia_requestsystemaccess);
     Celx_RegisterMethod(l, "getscriptpath", celestia_getscriptpath);
@@ -2613,6 +3226,7 @@ void CreateCelestiaMetaTable(lua_State* l)
     Celx_RegisterMethod(l, "seturl", celestia_seturl);
     Celx_RegisterMethod(l, "geturl", celestia_geturl);
     Celx_RegisterMethod(l, "overlay", celestia_overlay);
+    Celx_RegisterMethod(l, "preloadoverlay", celestia_preloadoverlay);
     Celx_RegisterMethod(l, "verbosity", celestia_verbosity);
 
     // Compatibility audio playback
@@ -2720,6 +3334,18 @@ static int celestia_gettitlefont(lua_State* l)
     return celx.pushClass(font);
 }
 
+// Return the time in seconds the script has been running, not counting
+// the time it waited
+static int celestia_getscriptruntime(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 1, "No arguments expected for celestia:getscriptruntime");
+
+    LuaState* luastate = getLuaStateObject(l);
+    lua_pushnumber(l, luastate->getRunTime());
+
+    return 1;
+}
+
 static int celestia_settimeslice(lua_State* l)
 {
     Celx_CheckArgs(l, 2, 2, "One argument required for celestia:settimeslice");
@@ -2875,6 +3501,7 @@ void ExtendCelestiaMetaTable(lua_State* l)
         cout << "Metatable for " << CelxLua::ClassNames[Celx_Celestia] << " not found!\n";
     celx.registerMethod("log", celestia_log);
     celx.registerMethod("settimeslice", celestia_settimeslice);
+    celx.registerMethod("getscriptruntime", celestia_getscriptruntime);
     celx.registerMethod("setluahook", celestia_setluahook);
     celx.registerMethod("getparamstring", celestia_getparamstring);
     celx.registerMethod("getfont", celestia_getfont);
@@ -0,0 +1,466 @@
+// celx_ffi.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Lua script extensions for Celestia: LuaJIT FFI value types
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <celengine/univcoord.h>
+#include <celutil/logger.h>
+#include "celx.h"
+#include "celx_internal.h"
+#include "celx_ffi.h"
+#include "celx_position.h"
+#include "celx_rotation.h"
+#include "celx_vector.h"
+
+using celestia::util::GetLogger;
+
+namespace
+{
+
+// Layouts of the values declared to the FFI, which are the layouts of the
+// Eigen and Celestia types the celx objects hold
+struct FfiVector
+{
+    double x, y, z;
+};
+
+struct FfiRotation
+{
+    double x, y, z, w;
+};
+
+struct FfiPosition
+{
+    std::uint64_t words[6];
+};
+
+static_assert(sizeof(FfiVector) == sizeof(Eigen::Vector3d));
+static_assert(sizeof(FfiRotation) == sizeof(Eigen::Quaterniond));
+static_assert(sizeof(FfiPosition) == sizeof(UniversalCoord));
+static_assert(std::is_trivially_copyable_v<UniversalCoord>);
+
+enum FfiKind
+{
+    FfiVectorKind   = 0,
+    FfiRotationKind = 1,
+    FfiPositionKind = 2,
+};
+
+Eigen::Vector3d
+toVector(const FfiVector* v)
+{
+    return Eigen::Vector3d(v->x, v->y, v->z);
+}
+
+Eigen::Quaterniond
+toQuaternion(const FfiRotation* q)
+{
+    return Eigen::Quaterniond(q->w, q->x, q->y, q->z);
+}
+
+UniversalCoord
+toUniversalCoord(const FfiPosition* p)
+{
+    UniversalCoord uc;
+    std::memcpy(static_cast<void*>(&uc), p, sizeof(uc));
+    return uc;
+}
+
+// Vector and rotation arithmetic is written in Lua below so that it's
+// compiled into the traces; the operations that need Eigen or 128-bit
+// fixed point arithmetic are called through these entry points.
+extern "C"
+{
+
+static void
+celx_ffi_slerp(const FfiRotation* q1, const FfiRotation* q2, double t, FfiRotation* result)
+{
+    Eigen::Quaterniond q = toQuaternion(q1).slerp(t, toQuaternion(q2));
+    *result = { q.x(), q.y(), q.z(), q.w() };
+}
+
+static void
+celx_ffi_offset(const FfiPosition* p, const FfiVector* v, FfiPosition* result)
+{
+    UniversalCoord uc = toUniversalCoord(p).offsetUly(toVector(v));
+    std::memcpy(result, &uc, sizeof(uc));
+}
+
+static void
+celx_ffi_difference(const FfiPosition* p1, const FfiPosition* p2, FfiVector* result)
+{
+    Eigen::Vector3d v = toUniversalCoord(p1).offsetFromUly(toUniversalCoord(p2));
+    *result = { v.x(), v.y(), v.z() };
+}
+
+static double
+celx_ffi_distance(const FfiPosition* p1, const FfiPosition* p2)
+{
+    return toUniversalCoord(p1).offsetFromKm(toUniversalCoord(p2)).norm();
+}
+
+} // extern "C"
+
+// Return the address of the value held by a celx vector, rotation or
+// position, for the module to copy it
+int
+ffi_address(lua_State* l)
+{
+    CelxLua celx(l);
+
+    void* address = nullptr;
+    switch (static_cast<int>(lua_tonumber(l, 2)))
+    {
+    case FfiVectorKind:
+        address = to_vector(l, 1);
+        break;
+    case FfiRotationKind:
+        address = to_rotation(l, 1);
+        break;
+    case FfiPositionKind:
+        address = to_position(l, 1);
+        break;
+    default:
+        break;
+    }
+
+    if (address == nullptr)
+    {
+        celx.doError("Vector, rotation or position expected");
+        return 0;
+    }
+
+    lua_pushlightuserdata(l, address);
+    return 1;
+}
+
+// Create a celx vector, rotation or position, and return it with the
+// address of its value for the module to fill in
+int
+ffi_new(lua_State* l)
+{
+    CelxLua celx(l);
+
+    void* address = nullptr;
+    switch (static_cast<int>(lua_tonumber(l, 1)))
+    {
+    case FfiVectorKind:
+        vector_new(l, Eigen::Vector3d::Zero());
+        address = to_vector(l, -1);
+        break;
+    case FfiRotationKind:
+        rotation_new(l, Eigen::Quaterniond::Identity());
+        address = to_rotation(l, -1);
+        break;
+    case FfiPositionKind:
+        position_new(l, UniversalCoord());
+        address = to_position(l, -1);
+        break;
+    default:
+        celx.doError("Bad celx object kind");
+        return 0;
+    }
+
+    lua_pushlightuserdata(l, address);
+    return 2;
+}
+
+void
+pushEntryPoint(lua_State* l, const char* name, void* entryPoint)
+{
+    lua_pushlightuserdata(l, entryPoint);
+    lua_setfield(l, -2, name);
+}
+
+// The module receives the ffi library and a table of entry points, and
+// returns the table of functions scripts get from require("celestia.ffi").
+// Vectors and positions are in microlight-years, like celx vectors.
+const char* ffiModule = R"lua(
+local ffi, api = ...
+
+ffi.cdef[[
+typedef struct { double x, y, z; } celx_vector;
+typedef struct { double x, y, z, w; } celx_rotation;
+typedef struct { uint64_t hi, lo; } celx_bigfix;
+typedef struct { celx_bigfix x, y, z; } celx_position;
+]]
+
+local sqrt, sin, cos = math.sqrt, math.sin, math.cos
+local cast, istype = ffi.cast, ffi.istype
+
+local VectorPtr = ffi.typeof("celx_vector*")
+local RotationPtr = ffi.typeof("celx_rotation*")
+local PositionPtr = ffi.typeof("celx_position*")
+
+local slerp = cast("void (*)(const celx_rotation*, const celx_rotation*, double, celx_rotation*)", api.slerp)
+local offset = cast("void (*)(const celx_position*, const celx_vector*, celx_position*)", api.offset)
+local difference = cast("void (*)(const celx_position*, const celx_position*, celx_vector*)", api.difference)
+local distance = cast("double (*)(const celx_position*, const celx_position*)", api.distance)
+local address, new = api.address, api.new
+
+local VectorKind, RotationKind, PositionKind = 0, 1, 2
+
+local Vector, Rotation, Position
+
+local function fromcelx(ct, ptr, kind, obj)
+    return ct(cast(ptr, address(obj, kind))[0])
+end
+
+local function tocelx(ptr, kind, value)
+    local obj, p = new(kind)
+    cast(ptr, p)[0] = value
+    return obj
+end
+
+local function rotation_mul(a, b)
+    if type(a) == "number" then
+        a, b = b, a
+    end
+    if type(b) == "number" then
+        return Rotation(a.x * b, a.y * b, a.z * b, a.w * b)
+    end
+    return Rotation(a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+                    a.w * b.y + a.y * b.w + a.z * b.x - a.x * b.z,
+                    a.w * b.z + a.z * b.w + a.x * b.y - a.y * b.x,
+                    a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z)
+end
+
+local function vector_mul(a, b)
+    if type(a) == "number" then
+        return Vector(a * b.x, a * b.y, a * b.z)
+    elseif type(b) == "number" then
+        return Vector(a.x * b, a.y * b, a.z * b)
+    elseif istype(Rotation, b) then
+        return rotation_mul(Rotation(a.x, a.y, a.z, 0), b)
+    end
+    return a.x * b.x + a.y * b.y + a.z * b.z
+end
+
+Vector = ffi.metatype("celx_vector", {
+    __add = function(a, b)
+        if istype(Position, b) then
+            local result = Position()
+            offset(b, a, result)
+            return result
+        end
+        return Vector(a.x + b.x, a.y + b.y, a.z + b.z)
+    end,
+    __sub = function(a, b)
+        return Vector(a.x - b.x, a.y - b.y, a.z - b.z)
+    end,
+    __unm = function(a)
+        return Vector(-a.x, -a.y, -a.z)
+    end,
+    __mul = vector_mul,
+    __pow = function(a, b)
+        return Vector(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x)
+    end,
+    __tostring = function()
+        return "[Vector]"
+    end,
+    __index = {
+        getx = function(v) return v.x end,
+        gety = function(v) return v.y end,
+        getz = function(v) return v.z end,
+        length = function(v)
+            return sqrt(v.x * v.x + v.y * v.y + v.z * v.z)
+        end,
+        normalize = function(v)
+            local length = sqrt(v.x * v.x + v.y * v.y + v.z * v.z)
+            if length > 0 then
+                return Vector(v.x / length, v.y / length, v.z / length)
+            end
+            return Vector(v)
+        end,
+        addto = function(v, w)
+            v.x, v.y, v.z = v.x + w.x, v.y + w.y, v.z + w.z
+            return v
+        end,
+        subto = function(v, w)
+            v.x, v.y, v.z = v.x - w.x, v.y - w.y, v.z - w.z
+            return v
+        end,
+        scaleby = function(v, s)
+            v.x, v.y, v.z = v.x * s, v.y * s, v.z * s
+            return v
+        end,
+        set = function(v, x, y, z)
+            v.x, v.y, v.z = x, y, z
+            return v
+        end,
+        tocelx = function(v)
+            return tocelx(VectorPtr, VectorKind, v)
+        end,
+    },
+})
+
+Rotation = ffi.metatype("celx_rotation", {
+    __add = function(a, b)
+        return Rotation(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w)
+    end,
+    __mul = rotation_mul,
+    __tostring = function()
+        return "[Rotation]"
+    end,
+    __index = {
+        real = function(q) return q.w end,
+        imag = function(q) return Vector(q.x, q.y, q.z) end,
+        -- Rotate by the conjugate, like rotation:transform
+        transform = function(q, v)
+            local x, y, z = -q.x, -q.y, -q.z
+            local tx = 2 * (y * v.z - z * v.y)
+            local ty = 2 * (z * v.x - x * v.z)
+            local tz = 2 * (x * v.y - y * v.x)
+            return Vector(v.x + q.w * tx + y * tz - z * ty,
+                          v.y + q.w * ty + z * tx - x * tz,
+                          v.z + q.w * tz + x * ty - y * tx)
+        end,
+        setaxisangle = function(q, axis, angle)
+            local length = sqrt(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z)
+            local s = length > 0 and sin(angle / 2) / length or 0
+            q.x, q.y, q.z, q.w = axis.x * s, axis.y * s, axis.z * s, cos(angle / 2)
+        end,
+        slerp = function(q1, q2, t)
+            local result = Rotation()
+            slerp(q1, q2, t, result)
+            return result
+        end,
+        tocelx = function(q)
+            return tocelx(RotationPtr, RotationKind, q)
+        end,
+    },
+})
+
+Position = ffi.metatype("celx_position", {
+    __add = function(p, v)
+        local result = Position()
+        offset(p, v, result)
+        return result
+    end,
+    __sub = function(p, q)
+        if istype(Position, q) then
+            local result = Vector()
+            difference(p, q, result)
+            return result
+        end
+        local result = Position()
+        offset(p, -q, result)
+        return result
+    end,
+    __tostring = function()
+        return "[Position]"
+    end,
+    __index = {
+        vectorto = function(p, q)
+            local result = Vector()
+            difference(q, p, result)
+            return result
+        end,
+        distanceto = function(p, q)
+            return distance(q, p)
+        end,
+        addvector = function(p, v)
+            local result = Position()
+            offset(p, v, result)
+            return result
+        end,
+        addto = function(p, v)
+            offset(p, v, p)
+            return p
+        end,
+        tocelx = function(p)
+            return tocelx(PositionPtr, PositionKind, p)
+        end,
+    },
+})
+
+local M = {}
+
+-- vector(x, y, z) or a copy of a celx vector
+function M.vector(x, y, z)
+    if type(x) == "userdata" then
+        return fromcelx(Vector, VectorPtr, VectorKind, x)
+    end
+    return Vector(x or 0, y or 0, z or 0)
+end
+
+-- rotation(w, x, y, z) or a copy of a celx rotation
+function M.rotation(w, x, y, z)
+    if type(w) == "userdata" then
+        return fromcelx(Rotation, RotationPtr, RotationKind, w)
+    end
+    return Rotation(x or 0, y or 0, z or 0, w or 1)
+end
+
+-- A copy of a celx position, or the origin
+function M.position(p)
+    if type(p) == "userdata" then
+        return fromcelx(Position, PositionPtr, PositionKind, p)
+    end
+    return Position()
+end
+
+return M
+)lua";
+
+} // end unnamed namespace
+
+
+void LoadLuaFFILibrary(lua_State* l)
+{
+    // The ffi library gives access to any memory and C function, so only
+    // the module gets it, whatever the script system access policy is.
+    lua_pushcfunction(l, luaopen_ffi);
+    lua_call(l, 0, 1);
+    lua_pushnil(l);
+    lua_setglobal(l, LUA_FFILIBNAME);
+    lua_getfield(l, LUA_REGISTRYINDEX, "_LOADED");
+    if (lua_istable(l, -1))
+    {
+        lua_pushnil(l);
+        lua_setfield(l, -2, LUA_FFILIBNAME);
+    }
+    lua_pop(l, 1);
+
+    if (luaL_loadbuffer(l, ffiModule, std::strlen(ffiModule), "=celestia.ffi") != 0)
+    {
+        GetLogger()->error("Error loading celestia.ffi: {}\n", lua_tostring(l, -1));
+        lua_pop(l, 2);
+        return;
+    }
+    lua_insert(l, -2);
+
+    lua_newtable(l);
+    pushEntryPoint(l, "slerp", reinterpret_cast<void*>(&celx_ffi_slerp));
+    pushEntryPoint(l, "offset", reinterpret_cast<void*>(&celx_ffi_offset));
+    pushEntryPoint(l, "difference", reinterpret_cast<void*>(&celx_ffi_difference));
+    pushEntryPoint(l, "distance", reinterpret_cast<void*>(&celx_ffi_distance));
+    lua_pushcfunction(l, ffi_address);
+    lua_setfield(l, -2, "address");
+    lua_pushcfunction(l, ffi_new);
+    lua_setfield(l, -2, "new");
+
+    if (lua_pcall(l, 2, 1, 0) != 0)
+    {
+        GetLogger()->error("Error running celestia.ffi: {}\n", lua_tostring(l, -1));
+        lua_pop(l, 1);
+        return;
+    }
+
+    // Make the module available to require("celestia.ffi")
+    lua_getfield(l, LUA_REGISTRYINDEX, "_LOADED");
+    lua_pushvalue(l, -2);
+    lua_setfield(l, -2, "celestia.ffi");
+    lua_pop(l, 2);
+}
@@ -0,0 +1,19 @@
+// celx_ffi.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Lua script extensions for Celestia: LuaJIT FFI value types
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+struct lua_State;
+
+// Register the celestia.ffi module, which provides vectors, rotations and
+// positions as FFI values that LuaJIT compiles arithmetic on instead of
+// calling the C API for every operation
+extern void LoadLuaFFILibrary(lua_State* l);
@@ -13,6 +13,7 @@
 #include "celx_internal.h"
 #include "celx_object.h"
 #include <celengine/glsupport.h>
+#include <celengine/glstate.h>
 #include "glcompat.h"
 
 
@@ -103,6 +104,7 @@ static int gl_TexParameter(lua_State* l)
     float x = (float)celx.safeGetNumber(1, WrongType, "argument 1 to gl.TexParameter must be a number", 0.0);
     float y = (float)celx.safeGetNumber(2, WrongType, "argument 2 to gl.TexParameter must be a number", 0.0);
     float z = (float)celx.safeGetNumber(3, WrongType, "argument 3 to gl.TexParameter must be a number", 0.0);
+    fpcFlush();
     glTexParameteri((GLint) x, (GLenum) y, (GLenum) z);
     return 0;
 }
@@ -137,6 +139,7 @@ static int gl_LineWidth(lua_State* l)
     CelxLua celx(l);
     celx.checkArgs(1, 1, "One argument expected for gl.LineWidth()");
     float n = (float)celx.safeGetNumber(1, WrongType, "argument 1 to gl.LineWidth must be a number", 1.0);
+    fpcFlush();
     glLineWidth(n);
     return 0;
 }
@@ -157,7 +160,8 @@ static int gl_BlendFunc(lua_State* l)
     celx.checkArgs(2, 2, "Two arguments expected for gl.BlendFunc()");
     int i = (int)celx.safeGetNumber(1, WrongType, "argument 1 to gl.BlendFunc must be a number", 0.0);
     int j = (int)celx.safeGetNumber(2, WrongType, "argument 2 to gl.BlendFunc must be a number", 0.0);
-    glBlendFunc(i,j);
+    fpcFlush();
+    celestia::gl::blendFunc(i, j);
     return 0;
 }
 
@@ -232,6 +236,13 @@ static int gl_PushMatrix(lua_State* l)
     return 0;
 }
 
+void FlushLuaGraphics()
+{
+    // End a primitive left open by a script which failed
+    fpcEnd();
+    fpcFlush();
+}
+
 void LoadLuaGraphicsLibrary(lua_State* l)
 {
     CelxLua celx(l);
@@ -174,6 +174,7 @@ static int font_bind(lua_State* l)
     celx.checkArgs(1, 1, "No arguments expected for font:bind()");
 
     auto font = *celx.getThis<std::shared_ptr<TextureFont>>();
+    fpcFlush();
     font->bind();
     return 0;
 }
@@ -185,6 +186,7 @@ static int font_unbind(lua_State* l)
     celx.checkArgs(1, 1, "No arguments expected for font:unbind()");
 
     auto font = *celx.getThis<std::shared_ptr<TextureFont>>();
+    fpcFlush();
     font->unbind();
     return 0;
 }
@@ -200,6 +202,7 @@ static int font_render(lua_State* l)
     Eigen::Matrix4f p, m;
     glGetFloatv(GL_PROJECTION_MATRIX, p.data());
     glGetFloatv(GL_MODELVIEW_MATRIX, m.data());
+    fpcFlush();
     font->setMVPMatrices(p, m);
     float ret = font->render(s);
     font->flush();
@@ -356,6 +359,7 @@ static int texture_bind(lua_State* l)
     celx.checkArgs(1, 1, "No arguments expected for texture:bind()");
 
     auto texture = *celx.getThis<Texture*>();
+    fpcFlush();
     texture->bind();
     return 0;
 }
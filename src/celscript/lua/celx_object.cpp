@@ -821,18 +821,35 @@ static int object_unmark(lua_State* l)
 
 // Return the object's current position.  A time argument is optional;
 // if not provided, the current master simulation time is used.
+// object:getposition([t [, result]]); a position passed as result is
+// overwritten and returned instead of creating a new one.
 static int object_getposition(lua_State* l)
 {
     CelxLua celx(l);
-    celx.checkArgs(1, 2, "Expected no or one argument to object:getposition");
+    celx.checkArgs(1, 3, "Expected no, one or two arguments to object:getposition");
 
     Selection* sel = this_object(l);
     CelestiaCore* appCore = celx.appCore(AllErrors);
 
-    double t = celx.safeGetNumber(2, WrongType, "Time expected as argument to object:getposition",
-                                  appCore->getSimulation()->getTime());
-    celx.newPosition(sel->getPosition(t));
+    double t = appCore->getSimulation()->getTime();
+    if (!lua_isnoneornil(l, 2))
+        t = celx.safeGetNumber(2, WrongType, "Time expected as argument to object:getposition");
+
+    if (lua_gettop(l) < 3)
+    {
+        celx.newPosition(sel->getPosition(t));
+        return 1;
+    }
+
+    UniversalCoord* result = celx.toPosition(3);
+    if (result == nullptr)
+    {
+        celx.doError("Position expected as second argument to object:getposition");
+        return 0;
+    }
 
+    *result = sel->getPosition(t);
+    lua_pushvalue(l, 3);
     return 1;
 }
 
@@ -319,6 +319,48 @@ static int position_addvector(lua_State* l)
 }
 
 
+// Offset the position by a vector in microlight-years in place, returning
+// the position itself
+static int position_addto(lua_State* l)
+{
+    CelxLua celx(l);
+
+    celx.checkArgs(2, 2, "One argument expected to position:addto()");
+    UniversalCoord* uc = this_position(l);
+
+    auto v3d = celx.toVector(2);
+    if (v3d == nullptr)
+    {
+        celx.doError("Vector expected as argument to position:addto");
+        return 0;
+    }
+
+    *uc = uc->offsetUly(*v3d);
+    lua_pushvalue(l, 1);
+    return 1;
+}
+
+
+// Copy another position in place, returning the position itself
+static int position_setvalue(lua_State* l)
+{
+    CelxLua celx(l);
+
+    celx.checkArgs(2, 2, "One argument expected to position:set()");
+    UniversalCoord* uc = this_position(l);
+    UniversalCoord* uc2 = to_position(l, 2);
+    if (uc2 == nullptr)
+    {
+        celx.doError("Position expected as argument to position:set");
+        return 0;
+    }
+
+    *uc = *uc2;
+    lua_pushvalue(l, 1);
+    return 1;
+}
+
+
 void CreatePositionMetaTable(lua_State* l)
 {
     CelxLua celx(l);
@@ -330,6 +372,8 @@ void CreatePositionMetaTable(lua_State* l)
     celx.registerMethod("vectorto", position_vectorto);
     celx.registerMethod("orientationto", position_orientationto);
     celx.registerMethod("addvector", position_addvector);
+    celx.registerMethod("addto", position_addto);
+    celx.registerMethod("set", position_setvalue);
     celx.registerMethod("__add", position_add);
     celx.registerMethod("__sub", position_sub);
     celx.registerMethod("__index", position_get);
@@ -274,6 +274,85 @@ static int vector_cross(lua_State* l)
 
 }
 
+// The in-place variants below modify the vector they are called on instead
+// of creating a new one, and return it for chaining; scripts doing a lot of
+// arithmetic per frame can use them to avoid creating garbage.
+static int vector_addto(lua_State* l)
+{
+    CelxLua celx(l);
+
+    celx.checkArgs(2, 2, "One argument expected for vector:addto");
+    auto v = this_vector(l);
+    auto w = celx.toVector(2);
+    if (w == nullptr)
+    {
+        celx.doError("Vector expected as argument to vector:addto");
+        return 0;
+    }
+
+    *v += *w;
+    lua_pushvalue(l, 1);
+    return 1;
+}
+
+static int vector_subto(lua_State* l)
+{
+    CelxLua celx(l);
+
+    celx.checkArgs(2, 2, "One argument expected for vector:subto");
+    auto v = this_vector(l);
+    auto w = celx.toVector(2);
+    if (w == nullptr)
+    {
+        celx.doError("Vector expected as argument to vector:subto");
+        return 0;
+    }
+
+    *v -= *w;
+    lua_pushvalue(l, 1);
+    return 1;
+}
+
+static int vector_scaleby(lua_State* l)
+{
+    CelxLua celx(l);
+
+    celx.checkArgs(2, 2, "One argument expected for vector:scaleby");
+    auto v = this_vector(l);
+    double s = celx.safeGetNumber(2, AllErrors, "Number expected as argument to vector:scaleby");
+    *v *= s;
+    lua_pushvalue(l, 1);
+    return 1;
+}
+
+// vector:set(w) copies w, vector:set(x, y, z) sets the components
+static int vector_setvalue(lua_State* l)
+{
+    CelxLua celx(l);
+
+    celx.checkArgs(2, 4, "One or three arguments expected for vector:set");
+    auto v = this_vector(l);
+    if (lua_gettop(l) == 2)
+    {
+        auto w = celx.toVector(2);
+        if (w == nullptr)
+        {
+            celx.doError("Vector expected as argument to vector:set");
+            return 0;
+        }
+        *v = *w;
+    }
+    else
+    {
+        const char* msg = "Vector components must be numbers";
+        *v = Vector3d(celx.safeGetNumber(2, AllErrors, msg),
+                      celx.safeGetNumber(3, AllErrors, msg),
+                      celx.safeGetNumber(4, AllErrors, msg));
+    }
+    lua_pushvalue(l, 1);
+    return 1;
+}
+
 static int vector_tostring(lua_State* l)
 {
     lua_pushstring(l, "[Vector]");
@@ -298,6 +377,10 @@ void CreateVectorMetaTable(lua_State* l)
     celx.registerMethod("getz", vector_getz);
     celx.registerMethod("normalize", vector_normalize);
     celx.registerMethod("length", vector_length);
+    celx.registerMethod("addto", vector_addto);
+    celx.registerMethod("subto", vector_subto);
+    celx.registerMethod("scaleby", vector_scaleby);
+    celx.registerMethod("set", vector_setvalue);
 
     lua_pop(l, 1); // remove metatable from stack
 }
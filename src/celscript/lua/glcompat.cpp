@@ -9,14 +9,19 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cstddef>
 #include <cstring>                      // memcpy
 #include <memory>
+#include <vector>
 #include <Eigen/Core>
 #include <fmt/format.h>
 #include <celengine/glsupport.h>
+#include <celengine/glstate.h>
 #include <celengine/shadermanager.h>    // CelestiaGLProgram::*Index
+#include <celengine/streambuffer.h>
 #include <celengine/vecgl.h>            // vecgl::translate
 #include "glcompat.h"
 
@@ -55,7 +60,6 @@ class GLSLProgram
 public:
     explicit GLSLProgram(GLProgram *prog) : m_prog(prog)
     {
-        m_MVPMatrix = Mat4ShaderParameter(m_prog->getID(), "MVPMatrix");
         IntegerShaderParameter(m_prog->getID(), "u_tex") = 0;
     }
     ~GLSLProgram() = default;
@@ -68,14 +72,9 @@ public:
     {
         m_prog->use();
     }
-    void setMVPMatrix(const Eigen::Matrix4f &m)
-    {
-        m_MVPMatrix = m;
-    }
 
 private:
     std::unique_ptr<GLProgram> m_prog;
-    Mat4ShaderParameter m_MVPMatrix;
 };
 
 #ifdef GL_ES
@@ -84,6 +83,8 @@ const char glsl_version[] = "100";
 const char glsl_version[] = "120";
 #endif
 
+// Vertices are transformed when they are batched, so that primitives
+// drawn with different matrices can be drawn together
 const char kVertexShader[] = R"glsl(
 #version {}
 #define SHADER_COLOR {}
@@ -93,7 +94,7 @@ const char kVertexShader[] = R"glsl(
 precision highp float;
 #endif
 
-attribute vec2 in_Position;
+attribute vec4 in_Position;
 attribute vec2 in_TexCoord0;
 #if SHADER_COLOR
 attribute vec4 in_Color;
@@ -103,10 +104,6 @@ varying vec4 v_color;
 varying vec2 v_texCoord;
 #endif
 
-//uniform mat4 ModelViewMatrix;
-//uniform mat4 ProjectionMatrix;
-uniform mat4 MVPMatrix;
-
 invariant gl_Position;
 
 void main(void)
@@ -117,7 +114,7 @@ void main(void)
 #if SHADER_TEXCOORD
     v_texCoord = in_TexCoord0;
 #endif
-    gl_Position = MVPMatrix * vec4(in_Position, 0.0, 1.0);
+    gl_Position = in_Position;
 }}
 )glsl";
 
@@ -156,17 +153,28 @@ enum ShaderAttributes
     SHADER_COUNT    = 2
 };
 
-GLenum gPrimitive = GL_NONE;
-int gVertexCounter = 0;
-int gTexCoordCounter = 0;
-int gColorCounter = 0;
-
 struct Vertex
 {
-    float x, y, u, v, r, g, b, a;
+    float x, y, z, w, u, v, r, g, b, a;
 };
 
-std::array<Vertex, 16> vertices {};
+// Size of the segments of the stream buffer; larger batches are drawn in
+// several parts
+constexpr GLsizeiptr STREAM_SEGMENT_SIZE = 1 << 20;
+
+// The primitive between glBegin and glEnd, and the current attributes
+GLenum gPrimitive = GL_NONE;
+std::vector<Vertex> gPrimitiveVertices;
+bool gPrimitiveTextured = false;
+Eigen::Matrix4f gMVPMatrix = Eigen::Matrix4f::Identity();
+std::array<float, 4> gColor { 1.0f, 1.0f, 1.0f, 1.0f };
+std::array<float, 2> gTexCoord { 0.0f, 0.0f };
+
+// Consecutive primitives with the same state are drawn together, as
+// points, lines or triangles
+GLenum gBatchMode = GL_NONE;
+bool gBatchTextured = false;
+std::vector<Vertex> gBatch;
 
 GLProgram* BuildProgram(const std::string &vertex, const std::string &fragment)
 {
@@ -201,94 +209,160 @@ GLSLProgram* FindGLProgram(ShaderAttributes attr)
         std::string fragment = fmt::format(kFragmentShader, glsl_version, color, texture);
         auto *glprog = BuildProgram(vertex, fragment);
         if (glprog != nullptr)
-            programs[attr] = new GLSLProgram(glprog);
+        {
+            prog = new GLSLProgram(glprog);
+            programs[attr] = prog;
+        }
     }
     return prog;
 }
 
-
-void Draw()
+celgl::StreamBuffer& GetStreamBuffer()
 {
-    if (gPrimitive == GL_NONE || gVertexCounter == 0)
-        return; // Do nothing
-
-    bool hasTexCoords       = gTexCoordCounter == gVertexCounter;
-    bool hasColors          = gColorCounter == gVertexCounter;
-    ShaderAttributes type   = hasTexCoords ? SHADER_TEXCOORD : SHADER_COLOR;
+    // Never destroyed, as there's no context left at exit
+    static auto* streamBuffer = new celgl::StreamBuffer(STREAM_SEGMENT_SIZE);
+    return *streamBuffer;
+}
 
-    glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
-    glVertexAttribPointer(
-        CelestiaGLProgram::VertexCoordAttributeIndex,
-        2, GL_FLOAT, false, sizeof(Vertex), &vertices[0].x
-    );
+void Flush()
+{
+    if (gBatch.empty())
+        return;
 
-    if (hasTexCoords)
+    auto *prog = FindGLProgram(gBatchTextured ? SHADER_TEXCOORD : SHADER_COLOR);
+    if (prog == nullptr)
     {
-        glEnableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
-        glVertexAttribPointer(
-            CelestiaGLProgram::TextureCoord0AttributeIndex,
-            2, GL_FLOAT, false, sizeof(Vertex), &vertices[0].u
-        );
+        gBatch.clear();
+        return;
     }
 
-    if (hasColors)
-    {
+    prog->use();
+    celgl::StreamBuffer& streamBuffer = GetStreamBuffer();
+
+    glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
+    if (gBatchTextured)
+        glEnableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
+    else
         glEnableVertexAttribArray(CelestiaGLProgram::ColorAttributeIndex);
-        glVertexAttribPointer(
-            CelestiaGLProgram::ColorAttributeIndex,
-            4, GL_FLOAT, false, sizeof(Vertex), &vertices[0].r
-        );
-    }
 
-    if (auto *prog = FindGLProgram(type); prog != nullptr)
+    // Split the batch on whole points, lines and triangles
+    constexpr std::size_t maxPartSize = STREAM_SEGMENT_SIZE / sizeof(Vertex) / 6 * 6;
+    for (std::size_t first = 0; first < gBatch.size(); first += maxPartSize)
     {
-        prog->use();
-        prog->setMVPMatrix(g_projectionStack[g_projectionPosition] * g_modelViewStack[g_modelViewPosition]);
-        glDrawArrays(gPrimitive, 0, gVertexCounter);
+        std::size_t count = std::min(maxPartSize, gBatch.size() - first);
+        auto size = static_cast<GLsizeiptr>(count * sizeof(Vertex));
+        GLintptr offset = streamBuffer.allocate(size, sizeof(Vertex));
+        streamBuffer.write(offset, gBatch.data() + first, size);
+
+        glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
+                              4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                              reinterpret_cast<const void*>(offset + offsetof(Vertex, x)));
+        if (gBatchTextured)
+        {
+            glVertexAttribPointer(CelestiaGLProgram::TextureCoord0AttributeIndex,
+                                  2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                                  reinterpret_cast<const void*>(offset + offsetof(Vertex, u)));
+        }
+        else
+        {
+            glVertexAttribPointer(CelestiaGLProgram::ColorAttributeIndex,
+                                  4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                                  reinterpret_cast<const void*>(offset + offsetof(Vertex, r)));
+        }
+        glDrawArrays(gBatchMode, 0, static_cast<GLsizei>(count));
     }
 
     glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
-    if (hasTexCoords)
-        glDisableVertexAttribArray(CelestiaGLProgram::TextureCoord3AttributeIndex);
-    if (hasColors)
+    if (gBatchTextured)
+        glDisableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
+    else
         glDisableVertexAttribArray(CelestiaGLProgram::ColorAttributeIndex);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
 
-    // reset state
-    gVertexCounter = 0;
-    gTexCoordCounter = 0;
-    gColorCounter = 0;
-    gPrimitive = GL_NONE;
+    gBatch.clear();
 }
 
-void PushVertex(float x, float y)
+// Add the primitive to the batch as independent points, lines or
+// triangles, flushing the batch first if it is drawn differently
+void BatchPrimitive()
 {
-    if (gVertexCounter < vertices.size())
+    const auto& v = gPrimitiveVertices;
+    std::size_t n = v.size();
+
+    GLenum mode;
+    switch (gPrimitive)
     {
-        vertices[gVertexCounter].x = x;
-        vertices[gVertexCounter].y = y;
-        gVertexCounter++;
+    case GL_POINTS:
+        mode = GL_POINTS;
+        break;
+    case GL_LINES:
+    case GL_LINE_STRIP:
+    case GL_LINE_LOOP:
+        mode = GL_LINES;
+        break;
+    case GL_TRIANGLES:
+    case GL_TRIANGLE_STRIP:
+    case GL_TRIANGLE_FAN:
+    case GL_QUADS:
+    case GL_POLYGON:
+        mode = GL_TRIANGLES;
+        break;
+    default:
+        return;
     }
-}
 
-void PushTexCoord(float u, float v)
-{
-    if (gTexCoordCounter < vertices.size())
+    if (mode != gBatchMode || gPrimitiveTextured != gBatchTextured)
     {
-        vertices[gTexCoordCounter].u = u;
-        vertices[gTexCoordCounter].v = v;
-        gTexCoordCounter++;
+        Flush();
+        gBatchMode = mode;
+        gBatchTextured = gPrimitiveTextured;
     }
-}
 
-void PushColor(float r, float g, float b, float a)
-{
-    if (gColorCounter < vertices.size())
+    switch (gPrimitive)
     {
-        vertices[gColorCounter].r = r;
-        vertices[gColorCounter].g = g;
-        vertices[gColorCounter].b = b;
-        vertices[gColorCounter].a = a;
-        gColorCounter++;
+    case GL_POINTS:
+        gBatch.insert(gBatch.end(), v.begin(), v.end());
+        break;
+    case GL_LINES:
+        gBatch.insert(gBatch.end(), v.begin(), v.begin() + n / 2 * 2);
+        break;
+    case GL_LINE_STRIP:
+    case GL_LINE_LOOP:
+        for (std::size_t i = 1; i < n; i++)
+        {
+            gBatch.push_back(v[i - 1]);
+            gBatch.push_back(v[i]);
+        }
+        if (gPrimitive == GL_LINE_LOOP && n > 2)
+        {
+            gBatch.push_back(v[n - 1]);
+            gBatch.push_back(v[0]);
+        }
+        break;
+    case GL_TRIANGLES:
+        gBatch.insert(gBatch.end(), v.begin(), v.begin() + n / 3 * 3);
+        break;
+    case GL_TRIANGLE_STRIP:
+        // Keep the winding of every other triangle
+        for (std::size_t i = 2; i < n; i++)
+        {
+            gBatch.push_back(v[i % 2 == 0 ? i - 2 : i - 1]);
+            gBatch.push_back(v[i % 2 == 0 ? i - 1 : i - 2]);
+            gBatch.push_back(v[i]);
+        }
+        break;
+    case GL_QUADS:
+        for (std::size_t i = 3; i < n; i += 4)
+        {
+            gBatch.insert(gBatch.end(), { v[i - 3], v[i - 2], v[i - 1] });
+            gBatch.insert(gBatch.end(), { v[i - 3], v[i - 1], v[i] });
+        }
+        break;
+    default:
+        // Triangle fans and polygons
+        for (std::size_t i = 2; i < n; i++)
+            gBatch.insert(gBatch.end(), { v[0], v[i - 1], v[i] });
+        break;
     }
 }
 } // namespace
@@ -495,7 +569,8 @@ void fpcEnable(GLenum param) noexcept
     case GL_LINE_SMOOTH:
 #endif
     case GL_BLEND:
-        orig_glEnable(param);
+        Flush();
+        celestia::gl::enable(param);
     default:
         break;
     }
@@ -509,7 +584,8 @@ void fpcDisable(GLenum param) noexcept
     case GL_LINE_SMOOTH:
 #endif
     case GL_BLEND:
-        orig_glDisable(param);
+        Flush();
+        celestia::gl::disable(param);
     default:
         break;
     }
@@ -517,31 +593,50 @@ void fpcDisable(GLenum param) noexcept
 
 void fpcBegin(GLenum param) noexcept
 {
-    if (gPrimitive == 0)
-        gPrimitive = (param == GL_POLYGON || param == GL_QUADS) ? GL_TRIANGLE_FAN : param;
+    if (gPrimitive != GL_NONE)
+        return;
+
+    gPrimitive = param;
+    gPrimitiveVertices.clear();
+    gPrimitiveTextured = false;
+    gMVPMatrix = g_projectionStack[g_projectionPosition] * g_modelViewStack[g_modelViewPosition];
 }
 
 void fpcEnd() noexcept
 {
-    Draw();
+    if (gPrimitive == GL_NONE)
+        return;
+
+    BatchPrimitive();
+    gPrimitive = GL_NONE;
+}
+
+void fpcFlush() noexcept
+{
+    Flush();
 }
 
 void fpcColor4f(float r, float g, float b, float a) noexcept
 {
-    if (gPrimitive == GL_NONE)
-        glVertexAttrib4f(CelestiaGLProgram::ColorAttributeIndex, r, g, b, a);
-    else
-        PushColor(r, g, b, a);
+    gColor = { r, g, b, a };
 }
 
 void fpcVertex2f(float x, float y) noexcept
 {
-    PushVertex(x, y);
+    if (gPrimitive == GL_NONE)
+        return;
+
+    Eigen::Vector4f p = gMVPMatrix * Eigen::Vector4f(x, y, 0.0f, 1.0f);
+    gPrimitiveVertices.push_back({ p.x(), p.y(), p.z(), p.w(),
+                                   gTexCoord[0], gTexCoord[1],
+                                   gColor[0], gColor[1], gColor[2], gColor[3] });
 }
 
 void fpcTexCoord2f(float x, float y) noexcept
 {
-    PushTexCoord(x, y);
+    gTexCoord = { x, y };
+    if (gPrimitive != GL_NONE)
+        gPrimitiveTextured = true;
 }
 
 void gluLookAt(float ix, float iy, float iz, float cx, float cy, float cz, float ux, float uy, float uz) noexcept
@@ -153,6 +153,10 @@ void fpcEnable(GLenum param) noexcept;
 void fpcDisable(GLenum param) noexcept;
 void fpcBegin(GLenum param) noexcept;
 void fpcEnd() noexcept;
+// Draw the primitives batched since the last flush. Primitives are drawn
+// together until a state they depend on changes, so this must be called
+// before changing GL state outside of this layer, and after drawing.
+void fpcFlush() noexcept;
 void fpcColor4f(float r, float g, float b, float a) noexcept;
 void fpcVertex2f(float x, float y) noexcept;
 void fpcTexCoord2f(float x, float y) noexcept;
@@ -17,6 +17,7 @@
 #include <celestia/celestiacore.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
+#include <celutil/profiler.h>
 #include "celx_internal.h"
 #include "luascript.h"
 
@@ -29,6 +30,44 @@ using util::GetLogger;
 namespace scripts
 {
 
+namespace
+{
+
+// Times a call into a script as a zone of the frame profiler, closing the
+// zones the script left open before its own
+class ScriptZone
+{
+ public:
+    ScriptZone(LuaState& _state, const char* name) :
+        state(_state),
+        zone(name)
+    {
+    }
+
+    ~ScriptZone()
+    {
+        state.endProfileZones();
+    }
+
+    ScriptZone(const ScriptZone&) = delete;
+    ScriptZone& operator=(const ScriptZone&) = delete;
+
+ private:
+    LuaState& state;
+    util::ProfileZone zone;
+};
+
+// Hooks are timed in a zone for each method
+const char* hookZoneName(const char* method)
+{
+    util::Profiler* profiler = util::GetProfiler();
+    if (profiler == nullptr)
+        return method;
+    return profiler->internName(fmt::format("Lua hook {}", method));
+}
+
+} // end unnamed namespace
+
 LuaScript::LuaScript(CelestiaCore *appcore) :
     m_appCore(appcore),
     m_celxScript(new LuaState)
@@ -39,6 +78,9 @@ LuaScript::LuaScript(CelestiaCore *appcore) :
 LuaScript::~LuaScript()
 {
     m_celxScript->cleanup();
+    GetLogger()->verbose("Script ran for {:.3f} s in {} slices\n",
+                         m_celxScript->getRunTime(),
+                         m_celxScript->getResumeCount());
 }
 
 bool LuaScript::load(ifstream &scriptfile, const fs::path &path, string &errorMsg)
@@ -73,6 +115,7 @@ bool LuaScript::handleTickEvent(double dt)
 
 bool LuaScript::tick(double dt)
 {
+    ScriptZone zone(*m_celxScript, "Lua script");
     return m_celxScript->tick(dt);
 }
 
@@ -113,26 +156,31 @@ unique_ptr<IScript> LuaScriptPlugin::loadScript(const fs::path &path)
 
 bool LuaHook::call(const char *method) const
 {
+    ScriptZone zone(*m_state, hookZoneName(method));
     return m_state->callLuaHook(appCore(), method);
 }
 
 bool LuaHook::call(const char *method, const char *keyName) const
 {
+    ScriptZone zone(*m_state, hookZoneName(method));
     return m_state->callLuaHook(appCore(), method, keyName);
 }
 
 bool LuaHook::call(const char *method, float x, float y) const
 {
+    ScriptZone zone(*m_state, hookZoneName(method));
     return m_state->callLuaHook(appCore(), method, x, y);
 }
 
 bool LuaHook::call(const char *method, float x, float y, int b) const
 {
+    ScriptZone zone(*m_state, hookZoneName(method));
     return m_state->callLuaHook(appCore(), method, x, y, b);
 }
 
 bool LuaHook::call(const char *method, double dt) const
 {
+    ScriptZone zone(*m_state, hookZoneName(method));
     return m_state->callLuaHook(appCore(), method, dt);
 }
 
@@ -9,9 +9,13 @@
 
 #include <algorithm>
 #include <array>
+#include <cstddef>
+#include <cstdint>
 #include <celcompat/charconv.h>
 #include <celengine/glsupport.h>
 #include <celengine/render.h>
+#include <celengine/glstate.h>
+#include <celutil/color.h>
 #include <celutil/logger.h>
 #include <celutil/utf8.h>
 #include <ft2build.h>
@@ -45,6 +49,42 @@ struct Glyph
 
     float tx; // x offset of glyph in texture coordinates
     float ty; // y offset of glyph in texture coordinates
+
+    int page{ -1 }; // atlas page holding the bitmap, or -1 if not loaded
+};
+
+// A page of the glyph atlas. Glyphs are packed into shelves, which are rows
+// as high as the first glyph placed in them.
+struct AtlasPage
+{
+    struct Shelf
+    {
+        int y;
+        int height;
+        int x; // start of the free part of the shelf
+    };
+
+    GLuint             texture{ 0 };
+    std::vector<Shelf> shelves;
+    int                nextShelf{ 0 }; // y of the next shelf to open
+    std::uint32_t      lastUsed{ 0 };
+};
+
+// Glyph of a laid out string, positioned at the pen position (x, y)
+struct RunGlyph
+{
+    int   glyph; // index in TextureFontPrivate::m_glyphs
+    float x;
+    float y;
+};
+
+// A laid out string; only refers to glyphs by index, so that runs stay valid
+// when glyphs are evicted from the atlas
+struct GlyphRun
+{
+    std::vector<RunGlyph> glyphs;
+    float                 advance{ 0.0f };
+    std::uint32_t         lastUsed{ 0 };
 };
 
 struct UnicodeBlock
@@ -63,6 +103,22 @@ struct TextureFontPrivate
         float u, v;
     };
 
+    // Vertex of the label batch, which carries its own depth and color
+    struct BatchVertex
+    {
+        float        x, y, z;
+        float        u, v;
+        std::uint8_t color[4];
+    };
+
+    // String queued for the label batch
+    struct BatchEntry
+    {
+        const GlyphRun *run;
+        Eigen::Vector3f position;
+        std::uint8_t    color[4];
+    };
+
     TextureFontPrivate(const Renderer *renderer);
     ~TextureFontPrivate();
     TextureFontPrivate() = delete;
@@ -73,18 +129,26 @@ struct TextureFontPrivate
 
     float render(std::string_view s, float x, float y);
     float render(wchar_t ch, float xoffset, float yoffset);
+    float render(std::string_view s, const Eigen::Vector3f &position, const Color &color);
 
     bool               buildAtlas();
-    void               computeTextureSize();
+    bool               addPage();
+    void               clearPage(int /*page*/);
+    bool               allocateCell(AtlasPage & /*page*/, int /*w*/, int /*h*/, int & /*x*/, int & /*y*/) const;
+    int                evictPage();
+    bool               makeResident(Glyph & /*g*/);
+    bool               prepareGlyph(Glyph & /*g*/);
     bool               loadGlyphInfo(wchar_t /*ch*/, Glyph & /*c*/) const;
     void               initCommonGlyphs();
     int                getCommonGlyphsCount();
     Glyph &            getGlyph(wchar_t /*ch*/);
     Glyph &            getGlyph(wchar_t /*ch*/, wchar_t /*fallback*/);
     [[nodiscard]] int  toPos(wchar_t /*ch*/) const;
-    void               optimize();
     CelestiaGLProgram *getProgram();
     void               flush();
+    void               flushBatch();
+    const GlyphRun &   getRun(std::string_view /*s*/);
+    void               evictRuns();
 
     const Renderer    *m_renderer;
     CelestiaGLProgram *m_prog{ nullptr };
@@ -95,21 +159,33 @@ struct TextureFontPrivate
     int m_maxDescent{ 0 };
     int m_maxWidth{ 0 };
 
-    int m_texWidth{ 0 };
-    int m_texHeight{ 0 };
+    std::vector<Glyph> m_glyphs; // character information
 
-    GLuint             m_texName{ 0 };   // texture object
-    std::vector<Glyph> m_glyphs;         // character information
+    // Glyph bitmaps are loaded into the atlas pages when they are first
+    // drawn. Pages used since the last flush are never evicted, as the
+    // pending vertices refer to them.
+    int                    m_pageSize{ 0 };
+    std::vector<AtlasPage> m_pages;
+    std::uint32_t          m_flushCount{ 0 };
 
     std::array<UnicodeBlock, 2> m_unicodeBlocks;
     int                         m_commonGlyphsCount{ 0 };
 
-    int m_inserted{ 0 };
-
     Eigen::Matrix4f         m_projection;
     Eigen::Matrix4f         m_modelView;
     bool                    m_shaderInUse{ false };
     std::vector<FontVertex> m_fontVertices;
+    int                     m_vertexPage{ 0 }; // page of m_fontVertices
+
+    // Laid out strings, and the number of times the font was unbound; runs
+    // which weren't used for a while are dropped when there are too many
+    std::map<std::string, GlyphRun, std::less<>> m_runs;
+    std::uint32_t                                m_useCount{ 0 };
+
+    std::vector<BatchEntry>               m_batch;
+    std::vector<std::vector<BatchVertex>> m_pageVertices;
+    std::vector<BatchVertex>              m_batchVertices;
+    GLuint                   m_batchBuffer{ 0 };
 };
 
 namespace
@@ -123,6 +199,17 @@ pt_to_px(float pt, int dpi = 96)
 
 Glyph g_badGlyph = { 0, 0, 0, 0, 0, 0, 0, 0.0f, 0.0f };
 
+// Glyph runs are dropped when the cache holds more than MaxGlyphRuns of
+// them and they weren't used since the font was unbound GlyphRunLifetime
+// times; if that isn't enough, the whole cache is cleared.
+constexpr std::size_t   MaxGlyphRuns     = 4096;
+constexpr std::uint32_t GlyphRunLifetime = 16;
+
+// The glyph atlas has at most MaxAtlasPages pages of AtlasPageSize squared
+// texels; when they are full, the least recently used page is cleared.
+constexpr std::size_t MaxAtlasPages = 4;
+constexpr int         AtlasPageSize = 1024;
+
 } // namespace
 
 /*
@@ -139,7 +226,9 @@ TextureFontPrivate::TextureFontPrivate(const Renderer *renderer) : m_renderer(re
 TextureFontPrivate::~TextureFontPrivate()
 {
     if (m_face != nullptr) FT_Done_Face(m_face);
-    if (m_texName != 0) glDeleteTextures(1, &m_texName);
+    for (const auto &page : m_pages)
+        celestia::gl::deleteTextures(1, &page.texture);
+    if (m_batchBuffer != 0) celestia::gl::deleteBuffers(1, &m_batchBuffer);
 }
 
 bool
@@ -181,65 +270,24 @@ TextureFontPrivate::initCommonGlyphs()
     }
 }
 
-void
-TextureFontPrivate::computeTextureSize()
-{
-    int roww = 0;
-    int rowh = 0;
-    int w    = 0;
-    int h    = 0;
-
-    // Find minimum size for a texture holding all visible ASCII characters
-    for (const auto &c : m_glyphs)
-    {
-        if (c.ch == 0) continue; // skip bad glyphs
-
-        if (roww + c.bw + 1 >= celestia::gl::maxTextureSize)
-        {
-            w = std::max(w, roww);
-            h += rowh;
-            roww = 0;
-            rowh = 0;
-        }
-        roww += c.bw + 1;
-        rowh = std::max(rowh, static_cast<int>(c.bh));
-    }
-
-    w = std::max(w, roww);
-    h += rowh;
-
-    m_texWidth  = w;
-    m_texHeight = h;
-}
-
 bool
-TextureFontPrivate::buildAtlas()
+TextureFontPrivate::addPage()
 {
-    FT_GlyphSlot g = m_face->glyph;
-
-    initCommonGlyphs();
-    computeTextureSize();
+    AtlasPage page;
+    glGenTextures(1, &page.texture);
+    if (page.texture == 0) return false;
 
-    // Create a texture that will be used to hold all glyphs
-    glActiveTexture(GL_TEXTURE0);
-    if (m_texName != 0) glDeleteTextures(1, &m_texName);
-    glGenTextures(1, &m_texName);
-    if (m_texName == 0) return false;
-
-    glBindTexture(GL_TEXTURE_2D, m_texName);
+    celestia::gl::bindTexture(GL_TEXTURE_2D, page.texture);
     glTexImage2D(GL_TEXTURE_2D,
                  0,
                  GL_ALPHA,
-                 m_texWidth,
-                 m_texHeight,
+                 m_pageSize,
+                 m_pageSize,
                  0,
                  GL_ALPHA,
                  GL_UNSIGNED_BYTE,
                  nullptr);
 
-    // We require 1 byte alignment when uploading texture data
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
     // Clamping to edges is important to prevent artifacts when scaling
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -252,54 +300,187 @@ TextureFontPrivate::buildAtlas()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
 #endif
 
-    // Paste all glyph bitmaps into the texture, remembering the offset
-    int ox = 0;
-    int oy = 0;
+    m_pages.push_back(page);
+    clearPage(static_cast<int>(m_pages.size()) - 1);
+    return true;
+}
 
-    int rowh = 0;
+/*
+ * Empty an atlas page. The texture is cleared as well, as linear filtering
+ * samples the gaps between glyphs.
+ */
+void
+TextureFontPrivate::clearPage(int index)
+{
+    AtlasPage &page = m_pages[index];
+    page.shelves.clear();
+    page.nextShelf = 0;
 
-    for (auto &c : m_glyphs)
+    for (auto &g : m_glyphs)
     {
-        if (c.ch == 0) continue; // skip bad glyphs
+        if (g.page == index)
+            g.page = -1;
+    }
 
-        if (FT_Load_Char(m_face, c.ch, FT_LOAD_RENDER) != 0)
+    std::vector<std::uint8_t> zeros(static_cast<std::size_t>(m_pageSize) * m_pageSize, 0);
+    celestia::gl::bindTexture(GL_TEXTURE_2D, page.texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D,
+                    0,
+                    0,
+                    0,
+                    m_pageSize,
+                    m_pageSize,
+                    GL_ALPHA,
+                    GL_UNSIGNED_BYTE,
+                    zeros.data());
+}
+
+bool
+TextureFontPrivate::allocateCell(AtlasPage &page, int w, int h, int &x, int &y) const
+{
+    // Use the first shelf which is high enough and wastes less than a
+    // third of its height
+    for (auto &shelf : page.shelves)
+    {
+        if (h <= shelf.height && h * 3 >= shelf.height * 2 && shelf.x + w <= m_pageSize)
         {
-            GetLogger()->warn("Loading character {:x} failed!\n", static_cast<unsigned>(c.ch));
-            c.ch = 0;
-            continue;
+            x = shelf.x;
+            y = shelf.y;
+            shelf.x += w;
+            return true;
         }
+    }
+
+    if (w > m_pageSize || page.nextShelf + h > m_pageSize) return false;
+
+    page.shelves.push_back({ page.nextShelf, h, w });
+    x = 0;
+    y = page.nextShelf;
+    page.nextShelf += h;
+    return true;
+}
+
+/*
+ * Clear the least recently used page which isn't used by pending vertices,
+ * and return its index, or -1 if there is none.
+ */
+int
+TextureFontPrivate::evictPage()
+{
+    int lru = -1;
+    for (int i = 0; i < static_cast<int>(m_pages.size()); i++)
+    {
+        if (m_pages[i].lastUsed == m_flushCount) continue;
+        if (lru == -1 || m_pages[i].lastUsed < m_pages[lru].lastUsed)
+            lru = i;
+    }
+
+    if (lru != -1)
+        clearPage(lru);
+    return lru;
+}
+
+/*
+ * Make sure the bitmap of a glyph is in the atlas, uploading it into a free
+ * cell if needed. Returns false if the glyph can't be drawn.
+ */
+bool
+TextureFontPrivate::makeResident(Glyph &g)
+{
+    if (g.page != -1)
+    {
+        m_pages[g.page].lastUsed = m_flushCount;
+        return true;
+    }
+
+    if (g.ch == 0 || m_pages.empty()) return false;
 
-        if (ox + int(g->bitmap.width) > int(m_texWidth))
+    // Keep a gap of one texel to the next glyphs
+    int w    = static_cast<int>(g.bw) + 1;
+    int h    = static_cast<int>(g.bh) + 1;
+    int x    = 0;
+    int y    = 0;
+    int page = -1;
+    for (int i = 0; i < static_cast<int>(m_pages.size()); i++)
+    {
+        if (allocateCell(m_pages[i], w, h, x, y))
         {
-            oy += rowh;
-            rowh = 0;
-            ox   = 0;
+            page = i;
+            break;
         }
+    }
+
+    if (page == -1 && m_pages.size() < MaxAtlasPages && addPage())
+    {
+        page = static_cast<int>(m_pages.size()) - 1;
+        if (!allocateCell(m_pages[page], w, h, x, y))
+            page = -1;
+    }
 
-        glTexSubImage2D(GL_TEXTURE_2D,
-                        0,
-                        ox,
-                        oy,
-                        g->bitmap.width,
-                        g->bitmap.rows,
-                        GL_ALPHA,
-                        GL_UNSIGNED_BYTE,
-                        g->bitmap.buffer);
-        c.tx = static_cast<float>(ox) / static_cast<float>(m_texWidth);
-        c.ty = static_cast<float>(oy) / static_cast<float>(m_texHeight);
-
-        rowh = std::max(rowh, static_cast<int>(g->bitmap.rows));
-        ox += g->bitmap.width + 1;
+    if (page == -1)
+    {
+        page = evictPage();
+        if (page == -1 || !allocateCell(m_pages[page], w, h, x, y))
+            return false;
+    }
+
+    FT_GlyphSlot slot = m_face->glyph;
+    if (FT_Load_Char(m_face, g.ch, FT_LOAD_RENDER) != 0)
+    {
+        GetLogger()->warn("Loading character {:x} failed!\n", static_cast<unsigned>(g.ch));
+        g.ch = 0;
+        return false;
+    }
+
+    // We require 1 byte alignment when uploading texture data
+    celestia::gl::bindTexture(GL_TEXTURE_2D, m_pages[page].texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D,
+                    0,
+                    x,
+                    y,
+                    slot->bitmap.width,
+                    slot->bitmap.rows,
+                    GL_ALPHA,
+                    GL_UNSIGNED_BYTE,
+                    slot->bitmap.buffer);
+
+    g.page = page;
+    g.tx   = static_cast<float>(x) / static_cast<float>(m_pageSize);
+    g.ty   = static_cast<float>(y) / static_cast<float>(m_pageSize);
+    m_pages[page].lastUsed = m_flushCount;
+    return true;
+}
+
+/*
+ * Create the first atlas page and load the common glyphs into it.
+ */
+bool
+TextureFontPrivate::buildAtlas()
+{
+    initCommonGlyphs();
+
+    m_pageSize = std::min(AtlasPageSize, static_cast<int>(celestia::gl::maxTextureSize));
+
+    celestia::gl::activeTexture(GL_TEXTURE0);
+    if (!addPage()) return false;
+
+    for (auto &c : m_glyphs)
+    {
+        if (c.bw != 0 && c.bh != 0)
+            makeResident(c);
     }
 
 #if DUMP_TEXTURE
-    fmt::print("Generated a {} x {} ({} kb) texture atlas\n",
-               m_texWidth, m_texHeight,
-               m_texWidth * m_texHeight / 1024);
-    size_t   img_size = sizeof(uint8_t) * m_texWidth * m_texHeight * 4;
+    fmt::print("Generated a {} x {} ({} kb) texture atlas page\n",
+               m_pageSize, m_pageSize,
+               m_pageSize * m_pageSize / 1024);
+    size_t   img_size = sizeof(uint8_t) * m_pageSize * m_pageSize * 4;
     uint8_t *raw_img  = new uint8_t[img_size];
+    celestia::gl::bindTexture(GL_TEXTURE_2D, m_pages[0].texture);
     glGetTexImage(GL_TEXTURE_2D, 0, GL_BGRA, GL_UNSIGNED_BYTE, raw_img);
-    ofstream f(fmt::format("/tmp/texture_{}x{}.data", m_texWidth, m_texHeight), ios::binary);
+    ofstream f(fmt::format("/tmp/texture_{}x{}.data", m_pageSize, m_pageSize), ios::binary);
     f.write(reinterpret_cast<char *>(raw_img), img_size);
     f.close();
     delete[] raw_img;
@@ -359,42 +540,36 @@ TextureFontPrivate::getGlyph(wchar_t ch)
     if (it != m_glyphs.end())
         return *it;
 
+    // The bitmap is only loaded into the atlas when the glyph is drawn
     Glyph c;
     if (!loadGlyphInfo(ch, c))
         return g_badGlyph;
 
-    flush(); // render text to avoid garbled output due to changed texture
-
     m_glyphs.push_back(c);
-    if (++m_inserted == 10) optimize();
-    buildAtlas();
-
     return m_glyphs.back();
 }
 
-void
-TextureFontPrivate::optimize()
-{
-    m_inserted = 0;
-}
-
 /*
- * Render text using the currently loaded font and currently set font size.
- * Rendering starts at coordinates (x, y), z is always 0.
- * The pixel coordinates that the FreeType2 library uses are scaled by (sx, sy).
+ * Lay out a string, or return the layout kept from an earlier call.
  */
-float
-TextureFontPrivate::render(std::string_view s, float x, float y)
+const GlyphRun &
+TextureFontPrivate::getRun(std::string_view s)
 {
-    if (m_texName == 0) return 0;
+    if (auto it = m_runs.find(s); it != m_runs.end())
+    {
+        it->second.lastUsed = m_useCount;
+        return it->second;
+    }
 
-    // Use the texture containing the atlas
-    glBindTexture(GL_TEXTURE_2D, m_texName);
+    GlyphRun run;
+    run.lastUsed = m_useCount;
 
     // Loop through all characters
-    int  len       = s.length();
-    bool validChar = true;
-    int  i         = 0;
+    int   len       = s.length();
+    bool  validChar = true;
+    int   i         = 0;
+    float x         = 0.0f;
+    float y         = 0.0f;
 
     while (i < len && validChar)
     {
@@ -405,25 +580,69 @@ TextureFontPrivate::render(std::string_view s, float x, float y)
 
         auto &g = getGlyph(ch, L'?');
 
-        // Calculate the vertex and texture coordinates
-        const float x1 = x + g.bl;
-        const float y1 = y + g.bt - g.bh;
-        const float w  = g.bw;
-        const float h  = g.bh;
-        const float x2 = x1 + w;
-        const float y2 = y1 + h;
+        // Skip glyphs that have no pixels
+        if (g.bw != 0 && g.bh != 0)
+            run.glyphs.push_back({ static_cast<int>(&g - m_glyphs.data()), x, y });
 
         // Advance the cursor to the start of the next character
         x += g.ax;
         y += g.ay;
+    }
+    run.advance = x;
 
-        // Skip glyphs that have no pixels
-        if (g.bw == 0 || g.bh == 0) continue;
+    // Queued batch entries point to the runs
+    if (m_batch.empty())
+        evictRuns();
+
+    return m_runs.emplace(s, std::move(run)).first->second;
+}
+
+void
+TextureFontPrivate::evictRuns()
+{
+    if (m_runs.size() <= MaxGlyphRuns) return;
+
+    for (auto it = m_runs.begin(); it != m_runs.end();)
+    {
+        if (m_useCount - it->second.lastUsed > GlyphRunLifetime)
+            it = m_runs.erase(it);
+        else
+            ++it;
+    }
+
+    if (m_runs.size() > MaxGlyphRuns * 2)
+        m_runs.clear();
+}
+
+/*
+ * Render text using the currently loaded font and currently set font size.
+ * Rendering starts at coordinates (x, y), z is always 0.
+ * The pixel coordinates that the FreeType2 library uses are scaled by (sx, sy).
+ */
+float
+TextureFontPrivate::render(std::string_view s, float x, float y)
+{
+    if (m_pages.empty()) return 0;
+
+    const GlyphRun &run = getRun(s);
+
+    for (const auto &rg : run.glyphs)
+    {
+        Glyph &g = m_glyphs[rg.glyph];
+        if (!prepareGlyph(g)) continue;
+
+        // Calculate the vertex and texture coordinates
+        const float x1 = x + rg.x + g.bl;
+        const float y1 = y + rg.y + g.bt - g.bh;
+        const float w  = g.bw;
+        const float h  = g.bh;
+        const float x2 = x1 + w;
+        const float y2 = y1 + h;
 
         const float tx1 = g.tx;
         const float ty1 = g.ty;
-        const float tx2 = tx1 + w / m_texWidth;
-        const float ty2 = ty1 + h / m_texHeight;
+        const float tx2 = tx1 + w / m_pageSize;
+        const float ty2 = ty1 + h / m_pageSize;
 
         m_fontVertices.emplace_back(x1, y1, tx1, ty2);
         m_fontVertices.emplace_back(x2, y1, tx2, ty2);
@@ -431,13 +650,36 @@ TextureFontPrivate::render(std::string_view s, float x, float y)
         m_fontVertices.emplace_back(x2, y2, tx2, ty1);
     }
 
-    return x;
+    return x + run.advance;
+}
+
+/*
+ * Queue a string for the label batch. The vertices are only generated when
+ * the batch is drawn, so glyphs added to the atlas in the meantime don't
+ * invalidate them.
+ */
+float
+TextureFontPrivate::render(std::string_view s, const Eigen::Vector3f &position, const Color &color)
+{
+    if (m_pages.empty()) return 0;
+
+    const GlyphRun &run = getRun(s);
+    if (!run.glyphs.empty())
+    {
+        BatchEntry &entry = m_batch.emplace_back();
+        entry.run         = &run;
+        entry.position    = position;
+        color.get(entry.color);
+    }
+
+    return position.x() + run.advance;
 }
 
 float
 TextureFontPrivate::render(wchar_t ch, float xoffset, float yoffset)
 {
     auto &g = getGlyph(ch, L'?');
+    if (g.bw == 0 || g.bh == 0 || !prepareGlyph(g)) return g.ax;
 
     // Calculate the vertex and texture coordinates
     const float x1 = xoffset + g.bl;
@@ -447,8 +689,8 @@ TextureFontPrivate::render(wchar_t ch, float xoffset, float yoffset)
 
     const float tx1 = g.tx;
     const float ty1 = g.ty;
-    const float tx2 = tx1 + static_cast<float>(g.bw) / m_texWidth;
-    const float ty2 = ty1 + static_cast<float>(g.bh) / m_texHeight;
+    const float tx2 = tx1 + static_cast<float>(g.bw) / m_pageSize;
+    const float ty2 = ty1 + static_cast<float>(g.bh) / m_pageSize;
 
     m_fontVertices.emplace_back(x1, y1, tx1, ty2);
     m_fontVertices.emplace_back(x2, y1, tx2, ty2);
@@ -458,6 +700,24 @@ TextureFontPrivate::render(wchar_t ch, float xoffset, float yoffset)
     return g.ax;
 }
 
+/*
+ * Load the glyph into the atlas if needed; when it is on another page than
+ * the pending vertices, these are drawn first.
+ */
+bool
+TextureFontPrivate::prepareGlyph(Glyph &g)
+{
+    if (!makeResident(g)) return false;
+
+    if (g.page != m_vertexPage)
+    {
+        flush();
+        m_vertexPage             = g.page;
+        m_pages[g.page].lastUsed = m_flushCount;
+    }
+    return true;
+}
+
 CelestiaGLProgram *
 TextureFontPrivate::getProgram()
 {
@@ -483,6 +743,7 @@ TextureFontPrivate::flush()
         indexes.push_back(index + 2);
     }
 
+    celestia::gl::bindTexture(GL_TEXTURE_2D, m_pages[m_vertexPage].texture);
     glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
     glEnableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
     glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
@@ -497,11 +758,109 @@ TextureFontPrivate::flush()
                           GL_FALSE,
                           sizeof(FontVertex),
                           &m_fontVertices[0].u);
-    glDrawElements(GL_TRIANGLES, indexes.size(), GL_UNSIGNED_SHORT, indexes.data());
+    celestia::gl::drawElements(GL_TRIANGLES, indexes.size(), GL_UNSIGNED_SHORT, indexes.data());
     glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
     glDisableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
 
     m_fontVertices.clear();
+    ++m_flushCount;
+}
+
+void
+TextureFontPrivate::flushBatch()
+{
+    if (m_batch.empty()) return;
+
+    // The vertices are sorted by atlas page, and the pages drawn one after
+    // another from the same buffer
+    m_pageVertices.resize(m_pages.size());
+    for (auto &vertices : m_pageVertices)
+        vertices.clear();
+
+    for (const auto &entry : m_batch)
+    {
+        for (const auto &rg : entry.run->glyphs)
+        {
+            Glyph &g = m_glyphs[rg.glyph];
+            if (!makeResident(g)) continue;
+
+            const float x1 = entry.position.x() + rg.x + g.bl;
+            const float y1 = entry.position.y() + rg.y + g.bt - g.bh;
+            const float x2 = x1 + g.bw;
+            const float y2 = y1 + g.bh;
+            const float z  = entry.position.z();
+
+            const float tx1 = g.tx;
+            const float ty1 = g.ty;
+            const float tx2 = tx1 + static_cast<float>(g.bw) / m_pageSize;
+            const float ty2 = ty1 + static_cast<float>(g.bh) / m_pageSize;
+
+            // A new page may have been added for the glyph
+            if (m_pageVertices.size() < m_pages.size())
+                m_pageVertices.resize(m_pages.size());
+            auto &vertices = m_pageVertices[g.page];
+
+            const std::uint8_t *c = entry.color;
+            vertices.push_back({ x1, y1, z, tx1, ty2, { c[0], c[1], c[2], c[3] } });
+            vertices.push_back({ x2, y1, z, tx2, ty2, { c[0], c[1], c[2], c[3] } });
+            vertices.push_back({ x1, y2, z, tx1, ty1, { c[0], c[1], c[2], c[3] } });
+            vertices.push_back({ x2, y1, z, tx2, ty2, { c[0], c[1], c[2], c[3] } });
+            vertices.push_back({ x2, y2, z, tx2, ty1, { c[0], c[1], c[2], c[3] } });
+            vertices.push_back({ x1, y2, z, tx1, ty1, { c[0], c[1], c[2], c[3] } });
+        }
+    }
+    m_batch.clear();
+
+    m_batchVertices.clear();
+    for (const auto &vertices : m_pageVertices)
+        m_batchVertices.insert(m_batchVertices.end(), vertices.begin(), vertices.end());
+    if (m_batchVertices.empty()) return;
+
+    if (m_batchBuffer == 0)
+        glGenBuffers(1, &m_batchBuffer);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, m_batchBuffer);
+    // Orphan the buffer of the previous batch before filling it
+    GLsizeiptr size = m_batchVertices.size() * sizeof(BatchVertex);
+    celestia::gl::bufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    celestia::gl::bufferSubData(GL_ARRAY_BUFFER, 0, size, m_batchVertices.data());
+
+    glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
+    glEnableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
+    glEnableVertexAttribArray(CelestiaGLProgram::ColorAttributeIndex);
+    glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
+                          3,
+                          GL_FLOAT,
+                          GL_FALSE,
+                          sizeof(BatchVertex),
+                          reinterpret_cast<const void *>(offsetof(BatchVertex, x)));
+    glVertexAttribPointer(CelestiaGLProgram::TextureCoord0AttributeIndex,
+                          2,
+                          GL_FLOAT,
+                          GL_FALSE,
+                          sizeof(BatchVertex),
+                          reinterpret_cast<const void *>(offsetof(BatchVertex, u)));
+    glVertexAttribPointer(CelestiaGLProgram::ColorAttributeIndex,
+                          4,
+                          GL_UNSIGNED_BYTE,
+                          GL_TRUE,
+                          sizeof(BatchVertex),
+                          reinterpret_cast<const void *>(offsetof(BatchVertex, color)));
+    GLint first = 0;
+    for (std::size_t page = 0; page < m_pageVertices.size(); page++)
+    {
+        auto count = static_cast<GLsizei>(m_pageVertices[page].size());
+        if (count == 0) continue;
+
+        celestia::gl::bindTexture(GL_TEXTURE_2D, m_pages[page].texture);
+        celestia::gl::drawArrays(GL_TRIANGLES, first, count);
+        first += count;
+    }
+    glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
+    glDisableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
+    glDisableVertexAttribArray(CelestiaGLProgram::ColorAttributeIndex);
+    celestia::gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+
+    ++m_flushCount;
 }
 
 TextureFont::TextureFont(const Renderer *renderer) :
@@ -541,6 +900,26 @@ TextureFont::render(std::string_view s, float xoffset, float yoffset) const
     return impl->render(s, xoffset, yoffset);
 }
 
+/**
+ * Queue a string for batched rendering
+ *
+ * Queue a string to be drawn at position with color by the next flush(),
+ * together with all other queued strings in a single draw call. The
+ * position is in the coordinates of the matrices set when the batch is
+ * drawn; the color attribute currently set is ignored. The layout of the
+ * string is kept, so strings that are drawn again in following frames
+ * don't need to be laid out again.
+ *
+ * @param s -- string to render
+ * @param position -- position of the start of the string
+ * @param color -- color of the string
+ */
+float
+TextureFont::render(std::string_view s, const Eigen::Vector3f &position, const Color &color) const
+{
+    return impl->render(s, position, color);
+}
+
 /**
  * Calculate string width in pixels
  *
@@ -552,24 +931,7 @@ TextureFont::render(std::string_view s, float xoffset, float yoffset) const
 int
 TextureFont::getWidth(std::string_view s) const
 {
-    int  width     = 0;
-    int  len       = s.length();
-    bool validChar = true;
-    int  i         = 0;
-
-    while (i < len && validChar)
-    {
-        wchar_t ch = 0;
-        validChar  = UTF8Decode(s, i, ch);
-        if (!validChar) break;
-
-        i += UTF8EncodedSize(ch);
-
-        auto &g = impl->getGlyph(ch, L'?');
-        width += g.ax;
-    }
-
-    return width;
+    return static_cast<int>(impl->getRun(s).advance);
 }
 
 /**
@@ -636,10 +998,10 @@ TextureFont::bind()
     auto *prog = impl->getProgram();
     if (prog == nullptr) return;
 
-    if (impl->m_texName != 0)
+    if (!impl->m_pages.empty())
     {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, impl->m_texName);
+        celestia::gl::activeTexture(GL_TEXTURE0);
+        celestia::gl::bindTexture(GL_TEXTURE_2D, impl->m_pages[impl->m_vertexPage].texture);
         prog->use();
         prog->samplerParam("atlasTex") = 0;
         impl->m_shaderInUse            = true;
@@ -671,6 +1033,7 @@ TextureFont::unbind()
 {
     flush();
     impl->m_shaderInUse = false;
+    ++impl->m_useCount;
 }
 
 /**
@@ -690,6 +1053,9 @@ void
 TextureFont::flush()
 {
     impl->flush();
+    // The batch is kept until it can be drawn with the text shader
+    if (impl->m_shaderInUse)
+        impl->flushBatch();
 }
 
 namespace
@@ -13,6 +13,7 @@
 #include <celcompat/filesystem.h>
 #include <string_view>
 
+class Color;
 class Renderer;
 class TextureFont;
 
@@ -36,6 +37,7 @@ class TextureFont
 
     float render(wchar_t c, float xoffset = 0.0f, float yoffset = 0.0f) const;
     float render(std::string_view str, float xoffset = 0.0f, float yoffset = 0.0f) const;
+    float render(std::string_view str, const Eigen::Vector3f &position, const Color &color) const;
 
     int getWidth(std::string_view) const;
     int getWidth(int c) const;
@@ -36,6 +36,14 @@ class array_view
 
     ~array_view() noexcept = default;
 
+    /**
+     * Wrap size elements starting at ptr.
+     */
+    constexpr array_view(const T* ptr, size_t size) noexcept :
+        m_ptr(ptr),
+        m_size(size)
+    {};
+
     /**
      * Wrap a C-style array.
      */
@@ -28,7 +28,7 @@ using celestia::util::GetLogger;
 namespace
 {
 
-constexpr double POW2_31 = 0x1p+31; // 2^31
+constexpr double POW2_63 = 0x1p+63; // 2^63
 constexpr double WORD0_FACTOR = 0x1p-64; // 2^-64
 constexpr double WORD1_FACTOR = 0x1p-32; // 2^-32
 constexpr double WORD2_FACTOR = 1.0;
@@ -73,34 +73,21 @@ BigFix::BigFix(std::uint64_t i)
 
 BigFix::BigFix(double d)
 {
-    bool isNegative = false;
-
-    // Handle negative values by inverting them before conversion,
-    // then inverting the converted value.
-    if (d < 0)
+    // Convert the magnitude and negate the result for negative values
+    double magnitude = std::abs(d);
+    if (magnitude < POW2_63)
     {
-        isNegative = true;
-        d = -d;
-    }
-
-    // Need to break the number into 32-bit chunks because a 64-bit
-    // integer has more bits of precision than a double.
-    double e = std::floor(d * (1.0 / WORD3_FACTOR));
-    if (e < POW2_31)
-    {
-        auto w3 = static_cast<std::uint32_t>(e);
-        d -= w3 * WORD3_FACTOR;
-        auto w2 = static_cast<std::uint32_t>(d * (1.0 / WORD2_FACTOR));
-        d -= w2 * WORD2_FACTOR;
-        auto w1 = static_cast<std::uint32_t>(d * (1.0 / WORD1_FACTOR));
-        d -= w1 * WORD1_FACTOR;
-        auto w0 = static_cast<std::uint32_t>(d * (1.0 / WORD0_FACTOR));
-
-        hi = (static_cast<std::uint64_t>(w3) << 32) | w2;
-        lo = (static_cast<std::uint64_t>(w1) << 32) | w0;
-
-      if (isNegative)
-          negate128(hi, lo);
+        // The 64 fraction bits are taken in 32-bit chunks, as a 64-bit
+        // integer has more bits of precision than a double. All of the
+        // subtractions are exact.
+        auto whole = static_cast<std::int64_t>(magnitude);
+        double fraction = (magnitude - static_cast<double>(whole)) * WORD3_FACTOR;
+        auto w1 = static_cast<std::int64_t>(fraction);
+        auto w0 = static_cast<std::int64_t>((fraction - static_cast<double>(w1)) * WORD3_FACTOR);
+
+        hi = static_cast<std::uint64_t>(whole);
+        lo = (static_cast<std::uint64_t>(w1) << 32) | static_cast<std::uint64_t>(w0);
+        negate128If(static_cast<std::uint64_t>(-static_cast<std::int64_t>(d < 0.0)), hi, lo);
     }
     else
     {
@@ -111,65 +98,11 @@ BigFix::BigFix(double d)
     }
 }
 
-BigFix::operator double() const
-{
-    // Handle negative values by inverting them before conversion,
-    // then inverting the converted value.
-    int sign = 1;
-    std::uint64_t l = lo;
-    std::uint64_t h = hi;
-
-    if (isNegative())
-    {
-        negate128(h, l);
-        sign = -1;
-    }
-
-    // Need to break the number into 32-bit chunks because a 64-bit
-    // integer has more bits of precision than a double.
-    std::uint32_t w0 = static_cast<std::uint32_t>(l);
-    std::uint32_t w1 = static_cast<std::uint32_t>(l >> 32);
-    std::uint32_t w2 = static_cast<std::uint32_t>(h);
-    std::uint32_t w3 = static_cast<std::uint32_t>(h >> 32);
-    double d;
-
-    d = (w0 * WORD0_FACTOR +
-         w1 * WORD1_FACTOR +
-         w2 * WORD2_FACTOR +
-         w3 * WORD3_FACTOR) * sign;
-
-    return d;
-}
-
 BigFix::operator float() const
 {
     return static_cast<float>(static_cast<double>(*this));
 }
 
-bool operator==(const BigFix& a, const BigFix& b)
-{
-    return a.hi == b.hi && a.lo == b.lo;
-}
-
-bool operator!=(const BigFix& a, const BigFix& b)
-{
-    return a.hi != b.hi || a.lo != b.lo;
-}
-
-bool operator<(const BigFix& a, const BigFix& b)
-{
-    if (a.isNegative() == b.isNegative())
-    {
-        return a.hi == b.hi ? a.lo < b.lo : a.hi < b.hi;
-    }
-    return a.isNegative();
-}
-
-bool operator>(const BigFix& a, const BigFix& b)
-{
-    return b < a;
-}
-
 // TODO: probably faster to do this by converting the double to fixed
 // point and using the fix*fix multiplication.
 BigFix operator*(BigFix f, double d)
@@ -193,6 +126,27 @@ BigFix operator*(BigFix f, double d)
  */
 BigFix operator*(const BigFix& a, const BigFix& b)
 {
+#ifdef __SIZEOF_INT128__
+    // Multiply the magnitudes and keep the middle 128 bits of the 256-bit
+    // product, then apply the sign.
+    std::uint64_t maskA = static_cast<std::uint64_t>(-static_cast<std::int64_t>(a.hi >> 63));
+    std::uint64_t maskB = static_cast<std::uint64_t>(-static_cast<std::int64_t>(b.hi >> 63));
+    std::uint64_t ah = a.hi;
+    std::uint64_t al = a.lo;
+    std::uint64_t bh = b.hi;
+    std::uint64_t bl = b.lo;
+    BigFix::negate128If(maskA, ah, al);
+    BigFix::negate128If(maskB, bh, bl);
+
+    unsigned __int128 product = (static_cast<unsigned __int128>(al) * bl) >> 64;
+    product += static_cast<unsigned __int128>(ah) * bl;
+    product += static_cast<unsigned __int128>(al) * bh;
+    product += static_cast<unsigned __int128>(ah * bh) << 64;
+
+    BigFix c = BigFix::fromUInt128(product);
+    BigFix::negate128If(maskA ^ maskB, c.hi, c.lo);
+    return c;
+#else
     // Multiply two fixed point values together using partial products.
 
     std::uint64_t ah = a.hi;
@@ -261,6 +215,7 @@ BigFix operator*(const BigFix& a, const BigFix& b)
 
     bool resultNegative = a.isNegative() != b.isNegative();
     return resultNegative ?  -c : c;
+#endif
 }
 
 int BigFix::sign() const
@@ -29,7 +29,7 @@ class BigFix
     explicit BigFix(std::uint64_t);
     explicit BigFix(double);
 
-    explicit operator double() const;
+    inline explicit operator double() const;
     explicit operator float() const;
 
     BigFix operator-() const;
@@ -40,10 +40,10 @@ class BigFix
     friend BigFix operator-(const BigFix&, const BigFix&);
     friend BigFix operator*(const BigFix&, const BigFix&);
     friend BigFix operator*(BigFix, double);
-    friend bool operator==(const BigFix&, const BigFix&);
-    friend bool operator!=(const BigFix&, const BigFix&);
-    friend bool operator<(const BigFix&, const BigFix&);
-    friend bool operator>(const BigFix&, const BigFix&);
+    friend inline bool operator==(const BigFix&, const BigFix&);
+    friend inline bool operator!=(const BigFix&, const BigFix&);
+    friend inline bool operator<(const BigFix&, const BigFix&);
+    friend inline bool operator>(const BigFix&, const BigFix&);
 
     int sign() const;
     bool isOutOfBounds() const;
@@ -58,6 +58,22 @@ class BigFix
     }
 
     static void negate128(std::uint64_t& hi, std::uint64_t& lo);
+    static void negate128If(std::uint64_t mask, std::uint64_t& hi, std::uint64_t& lo);
+
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 toUInt128() const
+    {
+        return (static_cast<unsigned __int128>(hi) << 64) | lo;
+    }
+
+    static BigFix fromUInt128(unsigned __int128 n)
+    {
+        BigFix f;
+        f.hi = static_cast<std::uint64_t>(n >> 64);
+        f.lo = static_cast<std::uint64_t>(n);
+        return f;
+    }
+#endif
 
  private:
     std::uint64_t hi;
@@ -85,6 +101,34 @@ inline void BigFix::negate128(std::uint64_t& hi, std::uint64_t& lo)
         hi++;
 }
 
+// Negate the value when mask is all ones and leave it unchanged when it is
+// zero, without branching.
+inline void BigFix::negate128If(std::uint64_t mask, std::uint64_t& hi, std::uint64_t& lo)
+{
+    std::uint64_t one = mask & 1;
+    hi ^= mask;
+    lo ^= mask;
+    lo += one;
+    hi += static_cast<std::uint64_t>(lo < one);
+}
+
+inline BigFix::operator double() const
+{
+    // Convert the magnitude and restore the sign afterwards. It is broken
+    // into 32-bit words, which convert to double exactly and faster than
+    // 64-bit unsigned integers.
+    std::uint64_t mask = static_cast<std::uint64_t>(-static_cast<std::int64_t>(hi >> 63));
+    std::uint64_t h = hi;
+    std::uint64_t l = lo;
+    negate128If(mask, h, l);
+
+    double d = static_cast<double>(static_cast<std::int64_t>(l & UINT64_C(0xffffffff))) * 0x1p-64 +
+               static_cast<double>(static_cast<std::int64_t>(l >> 32)) * 0x1p-32 +
+               static_cast<double>(static_cast<std::int64_t>(h & UINT64_C(0xffffffff))) +
+               static_cast<double>(static_cast<std::int64_t>(h >> 32)) * 0x1p+32;
+
+    return mask == 0 ? d : -d;
+}
 inline BigFix BigFix::operator-() const
 {
     BigFix result = *this;
@@ -96,52 +140,66 @@ inline BigFix BigFix::operator-() const
 
 inline BigFix BigFix::operator+=(const BigFix& a)
 {
+#ifdef __SIZEOF_INT128__
+    *this = fromUInt128(toUInt128() + a.toUInt128());
+#else
     lo += a.lo;
     hi += a.hi;
 
     // carry
     if (lo < a.lo)
         hi++;
+#endif
 
     return *this;
 }
 
 inline BigFix BigFix::operator-=(const BigFix& a)
 {
-    lo -= a.lo;
-    hi -= a.hi;
-
+#ifdef __SIZEOF_INT128__
+    *this = fromUInt128(toUInt128() - a.toUInt128());
+#else
     // borrow
-    if (lo > a.lo)
-        hi--;
+    hi -= a.hi + static_cast<std::uint64_t>(lo < a.lo);
+    lo -= a.lo;
+#endif
 
     return *this;
 }
 
 inline BigFix operator+(const BigFix& a, const BigFix& b)
 {
-    BigFix c;
-
-    c.lo = a.lo + b.lo;
-    c.hi = a.hi + b.hi;
-
-    // carry
-    if (c.lo < a.lo)
-        c.hi++;
-
+    BigFix c = a;
+    c += b;
     return c;
 }
 
 inline BigFix operator-(const BigFix& a, const BigFix& b)
 {
-    BigFix c;
+    BigFix c = a;
+    c -= b;
+    return c;
+}
 
-    c.lo = a.lo - b.lo;
-    c.hi = a.hi - b.hi;
+inline bool operator==(const BigFix& a, const BigFix& b)
+{
+    return a.hi == b.hi && a.lo == b.lo;
+}
 
-    // borrow
-    if (c.lo > a.lo)
-        c.hi--;
+inline bool operator!=(const BigFix& a, const BigFix& b)
+{
+    return a.hi != b.hi || a.lo != b.lo;
+}
 
-    return c;
+inline bool operator<(const BigFix& a, const BigFix& b)
+{
+    // The high words hold the sign, so they are compared as signed integers
+    if (a.hi == b.hi)
+        return a.lo < b.lo;
+    return static_cast<std::int64_t>(a.hi) < static_cast<std::int64_t>(b.hi);
+}
+
+inline bool operator>(const BigFix& a, const BigFix& b)
+{
+    return b < a;
 }
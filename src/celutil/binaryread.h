@@ -81,6 +81,33 @@ inline bool readReversed<unsigned char>(std::istream& in, unsigned char& value)
     return readNative(in, value);
 }
 
+/*! Decode a value stored in machine-native byte order in a memory buffer.
+ */
+template<typename T, typename = std::enable_if_t<std::is_trivially_copyable<T>::value>>
+inline T fromMemoryNative(const void* src)
+{
+    T value;
+    std::memcpy(&value, src, sizeof(T));
+    return value;
+}
+
+/*! Decode a value stored opposite to machine-native byte order in a memory buffer.
+ */
+template<typename T, typename = std::enable_if_t<std::is_trivially_copyable<T>::value>>
+inline T fromMemoryReversed(const void* src)
+{
+    char data[sizeof(T)];
+    std::memcpy(data, src, sizeof(T));
+    for (std::size_t i = 0; i < sizeof(T) / 2; ++i)
+    {
+        std::swap(data[i], data[sizeof(T) - i - 1]);
+    }
+
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
 #ifdef WORDS_BIGENDIAN
 
 /*! Read a value stored in little-endian byte order from an input stream.
@@ -99,6 +126,22 @@ inline bool readBE(std::istream& in, T& value)
     return readNative(in, value);
 }
 
+/*! Decode a value stored in little-endian byte order in a memory buffer.
+ */
+template<typename T, typename = std::enable_if_t<std::is_trivially_copyable<T>::value>>
+inline T fromMemoryLE(const void* src)
+{
+    return fromMemoryReversed<T>(src);
+}
+
+/*! Decode a value stored in big-endian byte order in a memory buffer.
+ */
+template<typename T, typename = std::enable_if_t<std::is_trivially_copyable<T>::value>>
+inline T fromMemoryBE(const void* src)
+{
+    return fromMemoryNative<T>(src);
+}
+
 #else
 
 /*! Read a value stored in little-endian byte order from an input stream.
@@ -117,6 +160,22 @@ inline bool readBE(std::istream& in, T& value)
     return readReversed(in, value);
 }
 
+/*! Decode a value stored in little-endian byte order in a memory buffer.
+ */
+template<typename T, typename = std::enable_if_t<std::is_trivially_copyable<T>::value>>
+inline T fromMemoryLE(const void* src)
+{
+    return fromMemoryNative<T>(src);
+}
+
+/*! Decode a value stored in big-endian byte order in a memory buffer.
+ */
+template<typename T, typename = std::enable_if_t<std::is_trivially_copyable<T>::value>>
+inline T fromMemoryBE(const void* src)
+{
+    return fromMemoryReversed<T>(src);
+}
+
 #endif
 
 } // end namespace celestia::util
@@ -11,6 +11,7 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <memory>
 #include <vector>
 
 // TODO: consider making it a full STL
@@ -23,12 +24,18 @@
  *  - The address of a BlockArray element is guaranteed not to
  *    change over the lifetime of the BlockArray (or until the
  *    BlockArray is cleared.)
+ *
+ *  The blocks hold blockSize elements each and are allocated with
+ *  Allocator; elements are only constructed as they're added.
  */
-template<class T> class BlockArray
+template<class T, class Allocator = std::allocator<T>> class BlockArray
 {
+    using Traits = std::allocator_traits<Allocator>;
+
 public:
-    BlockArray() :
-        m_blockSize(1000),
+    explicit BlockArray(unsigned int blockSize = 1000, const Allocator& allocator = Allocator()) :
+        m_allocator(allocator),
+        m_blockSize(blockSize),
         m_elementCount(0)
     {
     }
@@ -38,33 +45,38 @@ public:
         clear();
     }
 
+    BlockArray(const BlockArray&) = delete;
+    BlockArray& operator=(const BlockArray&) = delete;
+
     unsigned int size() const
     {
         return m_elementCount;
     }
 
+    unsigned int blockSize() const
+    {
+        return m_blockSize;
+    }
+
     /*! Append an item to the BlockArray. */
-    void add(T& element)
+    void add(const T& element)
     {
         unsigned int blockIndex = m_elementCount / m_blockSize;
         if (blockIndex == m_blocks.size())
-        {
-            T* newBlock = new T[m_blockSize];
-            m_blocks.push_back(newBlock);
-        }
+            m_blocks.push_back(Traits::allocate(m_allocator, m_blockSize));
 
         unsigned int elementIndex = m_elementCount % m_blockSize;
-        m_blocks.back()[elementIndex] = element;
+        Traits::construct(m_allocator, m_blocks.back() + elementIndex, element);
 
         ++m_elementCount;
     }
 
     void clear()
     {
-        for (typename std::vector<T*>::const_iterator iter = m_blocks.begin(); iter != m_blocks.end(); ++iter)
-        {
-            delete[] *iter;
-        }
+        for (unsigned int i = 0; i < m_elementCount; ++i)
+            Traits::destroy(m_allocator, &(*this)[i]);
+        for (T* block : m_blocks)
+            Traits::deallocate(m_allocator, block, m_blockSize);
         m_elementCount = 0;
         m_blocks.clear();
     }
@@ -84,6 +96,7 @@ public:
     }
 
 private:
+    Allocator m_allocator;
     unsigned int m_blockSize;
     unsigned int m_elementCount;
     std::vector<T*> m_blocks;
@@ -0,0 +1,58 @@
+// cachekey.cpp
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// Keys used to validate on-disk caches of derived data.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "cachekey.h"
+
+namespace celestia::util
+{
+
+void CacheKey::add(const void* data, std::size_t size)
+{
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        m_hash ^= bytes[i];
+        m_hash *= UINT64_C(1099511628211);
+    }
+}
+
+
+void CacheKey::add(std::uint64_t value)
+{
+    // Hash the bytes in a fixed order so keys don't depend on endianness
+    for (int i = 0; i < 8; ++i)
+    {
+        auto byte = static_cast<unsigned char>(value >> (i * 8));
+        add(&byte, 1);
+    }
+}
+
+
+void CacheKey::add(std::string_view str)
+{
+    add(static_cast<std::uint64_t>(str.size()));
+    add(str.data(), str.size());
+}
+
+
+void CacheKey::addFile(const fs::path& path)
+{
+    add(path.generic_string());
+
+    std::error_code ec;
+    auto size = fs::file_size(path, ec);
+    add(ec ? UINT64_MAX : static_cast<std::uint64_t>(size));
+
+    auto mtime = fs::last_write_time(path, ec);
+    add(ec ? UINT64_MAX : static_cast<std::uint64_t>(mtime.time_since_epoch().count()));
+}
+
+} // end namespace celestia::util
@@ -0,0 +1,41 @@
+// cachekey.h
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// Keys used to validate on-disk caches of derived data.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <celcompat/filesystem.h>
+
+namespace celestia::util
+{
+
+/**
+ * Incrementally computed 64-bit FNV-1a hash identifying the inputs a cache
+ * was built from. Source files contribute their path, size and modification
+ * time, so a cache is invalidated as soon as any of them is touched.
+ */
+class CacheKey
+{
+ public:
+    void add(const void* data, std::size_t size);
+    void add(std::uint64_t value);
+    void add(std::string_view str);
+    void addFile(const fs::path& path);
+
+    std::uint64_t value() const { return m_hash; }
+
+ private:
+    std::uint64_t m_hash{ UINT64_C(14695981039346656037) };
+};
+
+} // end namespace celestia::util
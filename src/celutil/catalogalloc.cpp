@@ -0,0 +1,144 @@
+// catalogalloc.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Allocation of the large arrays of the star and deep sky catalogs.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <atomic>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#include "logger.h"
+#include "catalogalloc.h"
+
+namespace celestia::util
+{
+
+namespace
+{
+
+std::atomic<HugePageMode> hugePageMode{ HugePageMode::Transparent };
+
+// Large allocations are rounded up to the most common huge page size, so
+// that they can be unmapped whether or not they got huge pages. Pages
+// that are never touched don't use memory.
+constexpr std::size_t HugePageSize = 2 * 1024 * 1024;
+
+constexpr std::size_t
+roundToHugePages(std::size_t size)
+{
+    return (size + HugePageSize - 1) & ~(HugePageSize - 1);
+}
+
+#ifdef _WIN32
+
+void*
+mapMemory(std::size_t size, HugePageMode mode)
+{
+    if (mode == HugePageMode::Explicit)
+    {
+        // Needs the SeLockMemoryPrivilege, which users rarely have
+        SIZE_T largePageSize = GetLargePageMinimum();
+        if (largePageSize != 0 && size % largePageSize == 0)
+        {
+            void* p = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if (p != nullptr)
+                return p;
+        }
+        GetLogger()->debug("Large pages unavailable for catalog memory\n");
+    }
+
+    return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+void
+unmapMemory(void* p, std::size_t /*size*/)
+{
+    VirtualFree(p, 0, MEM_RELEASE);
+}
+
+#else
+
+void*
+mapMemory(std::size_t size, HugePageMode mode)
+{
+#ifdef MAP_HUGETLB
+    if (mode == HugePageMode::Explicit)
+    {
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED)
+            return p;
+        GetLogger()->debug("No reserved huge pages for catalog memory\n");
+    }
+#endif
+
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return nullptr;
+
+#ifdef MADV_HUGEPAGE
+    if (mode != HugePageMode::Off)
+        madvise(p, size, MADV_HUGEPAGE);
+#endif
+
+    return p;
+}
+
+void
+unmapMemory(void* p, std::size_t size)
+{
+    munmap(p, size);
+}
+
+#endif
+
+} // end unnamed namespace
+
+
+void
+setHugePageMode(HugePageMode mode)
+{
+    hugePageMode.store(mode, std::memory_order_relaxed);
+}
+
+
+HugePageMode
+getHugePageMode()
+{
+    return hugePageMode.load(std::memory_order_relaxed);
+}
+
+
+void*
+allocateCatalogMemory(std::size_t size)
+{
+    if (size < LargeCatalogAllocation)
+        return ::operator new(size);
+
+    void* p = mapMemory(roundToHugePages(size), getHugePageMode());
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+
+void
+freeCatalogMemory(void* p, std::size_t size) noexcept
+{
+    if (p == nullptr)
+        return;
+
+    if (size < LargeCatalogAllocation)
+        ::operator delete(p);
+    else
+        unmapMemory(p, roundToHugePages(size));
+}
+
+} // end namespace celestia::util
@@ -0,0 +1,126 @@
+// catalogalloc.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Allocation of the large arrays of the star and deep sky catalogs.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace celestia::util
+{
+
+// How catalog arrays of at least LargeCatalogAllocation bytes are backed.
+// Traversals of a catalog of millions of stars touch pages all over the
+// array, so with 4 KiB pages most accesses miss the TLB.
+enum class HugePageMode
+{
+    // Ordinary pages
+    Off,
+    // Ask the OS to back the memory with huge pages when it can, which
+    // is madvise(MADV_HUGEPAGE) on Linux
+    Transparent,
+    // Reserved huge pages (MAP_HUGETLB on Linux, large pages on Windows),
+    // falling back to Transparent when none are available
+    Explicit,
+};
+
+// Arrays smaller than this come from the ordinary heap
+constexpr std::size_t LargeCatalogAllocation = 2 * 1024 * 1024;
+
+// Set before the catalogs are loaded; allocations made earlier keep the
+// pages they were given
+void setHugePageMode(HugePageMode mode);
+HugePageMode getHugePageMode();
+
+// Allocate memory for a catalog array, aligned to at least
+// alignof(std::max_align_t); throws std::bad_alloc. It must be freed with
+// freeCatalogMemory() and the same size.
+void* allocateCatalogMemory(std::size_t size);
+void freeCatalogMemory(void* p, std::size_t size) noexcept;
+
+
+// Standard allocator for containers holding catalog data
+template<typename T>
+class CatalogAllocator
+{
+ public:
+    using value_type = T;
+
+    CatalogAllocator() noexcept = default;
+
+    template<typename U>
+    CatalogAllocator(const CatalogAllocator<U>& /*other*/) noexcept {} // NOLINT(google-explicit-constructor)
+
+    T* allocate(std::size_t n)
+    {
+        static_assert(alignof(T) <= alignof(std::max_align_t));
+        return static_cast<T*>(allocateCatalogMemory(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        freeCatalogMemory(p, n * sizeof(T));
+    }
+
+    template<typename U>
+    bool operator==(const CatalogAllocator<U>& /*other*/) const noexcept { return true; }
+    template<typename U>
+    bool operator!=(const CatalogAllocator<U>& /*other*/) const noexcept { return false; }
+};
+
+template<typename T>
+using CatalogVector = std::vector<T, CatalogAllocator<T>>;
+
+
+// Deleter of the arrays created by makeCatalogArray(), which need their
+// size to be freed
+template<typename T>
+class CatalogArrayDeleter
+{
+ public:
+    CatalogArrayDeleter() noexcept = default;
+    explicit CatalogArrayDeleter(std::size_t _count) noexcept : count(_count) {}
+
+    void operator()(T* p) const noexcept
+    {
+        std::destroy_n(p, count);
+        CatalogAllocator<T>().deallocate(p, count);
+    }
+
+    std::size_t size() const noexcept { return count; }
+
+ private:
+    std::size_t count{ 0 };
+};
+
+template<typename T>
+using CatalogArray = std::unique_ptr<T[], CatalogArrayDeleter<T>>;
+
+// Allocate an array of count value-initialized objects
+template<typename T>
+CatalogArray<T> makeCatalogArray(std::size_t count)
+{
+    T* p = CatalogAllocator<T>().allocate(count);
+    try
+    {
+        std::uninitialized_value_construct_n(p, count);
+    }
+    catch (...)
+    {
+        CatalogAllocator<T>().deallocate(p, count);
+        throw;
+    }
+    return CatalogArray<T>(p, CatalogArrayDeleter<T>(count));
+}
+
+} // end namespace celestia::util
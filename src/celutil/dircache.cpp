@@ -0,0 +1,124 @@
+// dircache.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// In-memory listings of the directories that resources are resolved in.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include "dircache.h"
+
+namespace celestia::util
+{
+
+namespace
+{
+
+// The file systems of Windows and macOS ignore case by default, so their
+// names are compared folded
+fs::path::string_type
+fileKey(const fs::path& name)
+{
+    fs::path::string_type key = name.native();
+#if defined(_WIN32) || defined(__APPLE__)
+    std::transform(key.begin(), key.end(), key.begin(),
+                   [](auto c) -> decltype(c) { return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c; });
+#endif
+    return key;
+}
+
+fs::path
+directoryKey(const fs::path& filename)
+{
+    fs::path directory = filename.parent_path();
+    if (directory.empty())
+        return fs::path(".");
+    return directory.lexically_normal();
+}
+
+} // end unnamed namespace
+
+const DirectoryCache::Listing&
+DirectoryCache::listing(const fs::path& directory)
+{
+    auto it = directories.find(directory);
+    if (it != directories.end())
+        return it->second;
+
+    // A directory which can't be read is cached empty, as most of the
+    // directories probed don't exist
+    Listing files;
+    std::error_code ec;
+    for (fs::directory_iterator iter(directory, ec), end; !ec && iter != end; iter.increment(ec))
+    {
+        if (!iter->is_directory(ec))
+            files.insert(fileKey(iter->path().filename()));
+    }
+
+    return directories.emplace(directory, std::move(files)).first->second;
+}
+
+bool
+DirectoryCache::contains(const fs::path& filename)
+{
+    const Listing& files = listing(directoryKey(filename));
+    return files.count(fileKey(filename.filename())) > 0;
+}
+
+bool
+DirectoryCache::exists(const fs::path& filename)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return contains(filename);
+}
+
+fs::path
+DirectoryCache::resolveWildcard(const fs::path& wildcard,
+                                array_view<const char*> extensions)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    fs::path filename(wildcard);
+    for (const char* ext : extensions)
+    {
+        filename.replace_extension(ext);
+        if (contains(filename))
+            return filename;
+    }
+
+    return fs::path();
+}
+
+void
+DirectoryCache::invalidate(const fs::path& directory)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    directories.erase(directory.lexically_normal());
+}
+
+void
+DirectoryCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    directories.clear();
+}
+
+std::size_t
+DirectoryCache::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return directories.size();
+}
+
+DirectoryCache&
+GetDirectoryCache()
+{
+    static DirectoryCache cache;
+    return cache;
+}
+
+} // end namespace celestia::util
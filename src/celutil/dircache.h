@@ -0,0 +1,67 @@
+// dircache.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// In-memory listings of the directories that resources are resolved in.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <unordered_set>
+#include <celcompat/filesystem.h>
+#include <celutil/array_view.h>
+
+namespace celestia::util
+{
+
+// DirectoryCache answers whether a file exists from a listing of its
+// directory, read once the first time a file in it is looked up. The
+// texture, model and trajectory resolvers probe several directories for
+// every resource, most of which don't exist; on a network file system
+// each probe is a round trip, while a cached listing is a hash lookup.
+//
+// Files added or removed after a directory was listed are not seen until
+// it is invalidated. Lookups may come from several threads.
+class DirectoryCache
+{
+ public:
+    DirectoryCache() = default;
+    DirectoryCache(const DirectoryCache&) = delete;
+    DirectoryCache& operator=(const DirectoryCache&) = delete;
+
+    // Return true if filename is a file, rather than a directory, in the
+    // listing of its directory
+    bool exists(const fs::path& filename);
+
+    // Replace the extension of wildcard with each of extensions in turn
+    // and return the first existing file, or an empty path
+    fs::path resolveWildcard(const fs::path& wildcard,
+                             array_view<const char*> extensions);
+
+    // Drop the listing of a directory, or of all of them, so that it is
+    // read again by the next lookup
+    void invalidate(const fs::path& directory);
+    void clear();
+
+    // Number of directories listed
+    std::size_t size() const;
+
+ private:
+    using Listing = std::unordered_set<fs::path::string_type>;
+
+    const Listing& listing(const fs::path& directory);
+    bool contains(const fs::path& filename);
+
+    mutable std::mutex mutex;
+    std::map<fs::path, Listing> directories;
+};
+
+DirectoryCache& GetDirectoryCache();
+
+} // end namespace celestia::util
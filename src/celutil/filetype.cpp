@@ -28,8 +28,10 @@ static const char CelestiaMeshExt[] = ".cms";
 static const char CelestiaCatalogExt[] = ".ssc";
 static const char CelestiaStarCatalogExt[] = ".stc";
 static const char CelestiaDeepSkyCatalogExt[] = ".dsc";
+static const char CelestiaDeepSkyBinaryCatalogExt[] = ".dsb";
 static const char MKVExt[] = ".mkv";
 static const char DDSExt[] = ".dds";
+static const char KTX2Ext[] = ".ktx2";
 static const char DXT5NormalMapExt[] = ".dxt5nm";
 static const char CelestiaLegacyScriptExt[] = ".cel";
 static const char CelestiaScriptExt[] = ".clx";
@@ -38,6 +40,7 @@ static const char CelestiaModelExt[] = ".cmod";
 static const char CelestiaXYZTrajectoryExt[] = ".xyz";
 static const char CelestiaXYZVTrajectoryExt[] = ".xyzv";
 static const char ContentXYZVBinaryExt[] = ".xyzvbin";
+static const char ContentXYZCBinaryExt[] = ".xyzc";
 static const char ContentWarpMeshExt[] = ".map";
 
 ContentType DetermineFileType(const fs::path& filename)
@@ -70,10 +73,14 @@ ContentType DetermineFileType(const fs::path& filename)
         return Content_CelestiaStarCatalog;
     if (compareIgnoringCase(CelestiaDeepSkyCatalogExt, ext) == 0)
         return Content_CelestiaDeepSkyCatalog;
+    if (compareIgnoringCase(CelestiaDeepSkyBinaryCatalogExt, ext) == 0)
+        return Content_CelestiaDeepSkyBinaryCatalog;
     if (compareIgnoringCase(MKVExt, ext) == 0)
         return Content_MKV;
     if (compareIgnoringCase(DDSExt, ext) == 0)
         return Content_DDS;
+    if (compareIgnoringCase(KTX2Ext, ext) == 0)
+        return Content_KTX2;
     if (compareIgnoringCase(CelestiaLegacyScriptExt, ext) == 0)
         return Content_CelestiaLegacyScript;
     if (compareIgnoringCase(CelestiaScriptExt, ext) == 0 ||
@@ -91,5 +98,7 @@ ContentType DetermineFileType(const fs::path& filename)
         return Content_WarpMesh;
     if (compareIgnoringCase(ContentXYZVBinaryExt, ext) == 0)
         return Content_CelestiaXYZVBinary;
+    if (compareIgnoringCase(ContentXYZCBinaryExt, ext) == 0)
+        return Content_CelestiaXYZCBinary;
     return Content_Unknown;
 }
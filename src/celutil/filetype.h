@@ -40,6 +40,9 @@ enum ContentType
 #ifdef USE_LIBAVIF
     Content_AVIF                   = 23,
 #endif
+    Content_CelestiaDeepSkyBinaryCatalog = 24,
+    Content_KTX2                   = 25,
+    Content_CelestiaXYZCBinary     = 26,
     Content_Unknown                = -1,
 };
 
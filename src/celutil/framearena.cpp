@@ -0,0 +1,93 @@
+// framearena.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Monotonic allocator for data that only lives for one frame.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "framearena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace celestia::util
+{
+
+FrameArena::FrameArena(std::size_t initialSize)
+{
+    addBlock(initialSize);
+}
+
+void*
+FrameArena::allocate(std::size_t size, std::size_t alignment)
+{
+    auto align = [alignment](const Block& block, std::size_t at)
+    {
+        auto address = reinterpret_cast<std::uintptr_t>(block.data.get()) + at;
+        return at + (alignment - address % alignment) % alignment;
+    };
+
+    std::size_t start = align(blocks.back(), offset);
+    if (start + size > blocks.back().size)
+    {
+        addBlock(size + alignment);
+        start = align(blocks.back(), 0);
+    }
+
+    offset = start + size;
+    return blocks.back().data.get() + start;
+}
+
+std::string_view
+FrameArena::copy(std::string_view s)
+{
+    if (s.empty())
+        return {};
+
+    auto* data = static_cast<char*>(allocate(s.size(), 1));
+    std::memcpy(data, s.data(), s.size());
+    return { data, s.size() };
+}
+
+void
+FrameArena::reset()
+{
+    // Merge the blocks so that the next frame of the same size fits in one
+    if (blocks.size() > 1)
+    {
+        std::size_t total = capacity();
+        blocks.clear();
+        addBlock(total);
+    }
+
+    offset = 0;
+    usedBefore = 0;
+}
+
+std::size_t
+FrameArena::capacity() const
+{
+    std::size_t total = 0;
+    for (const Block& block : blocks)
+        total += block.size;
+    return total;
+}
+
+void
+FrameArena::addBlock(std::size_t minSize)
+{
+    if (!blocks.empty())
+        usedBefore += offset;
+
+    std::size_t size = std::max(minSize, blocks.empty() ? std::size_t(0) : blocks.back().size * 2);
+    blocks.push_back({ std::make_unique<std::byte[]>(size), size });
+    offset = 0;
+    nBlockAllocations++;
+}
+
+} // end namespace celestia::util
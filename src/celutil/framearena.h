@@ -0,0 +1,109 @@
+// framearena.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Monotonic allocator for data that only lives for one frame.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace celestia::util
+{
+
+// FrameArena hands out memory by advancing a pointer in a block, and frees
+// all of it at once with reset(). When a block is full another one twice
+// as large is allocated; reset() then replaces the blocks with a single one
+// large enough for all of them, so once the arena has seen its largest
+// frame it doesn't allocate from the heap any more.
+//
+// The arena isn't thread safe: memory must be allocated from one thread at
+// a time, usually the render thread.
+class FrameArena
+{
+ public:
+    explicit FrameArena(std::size_t initialSize = DefaultBlockSize);
+    ~FrameArena() = default;
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+
+    // Copy a string into the arena; the view is valid until reset()
+    std::string_view copy(std::string_view s);
+
+    // Free everything allocated since the last reset
+    void reset();
+
+    // Bytes allocated since the last reset, including alignment padding
+    std::size_t used() const { return usedBefore + offset; }
+    // Bytes of all blocks
+    std::size_t capacity() const;
+    // Number of blocks allocated from the heap since the arena was created
+    std::size_t blockAllocations() const { return nBlockAllocations; }
+
+    static constexpr std::size_t DefaultBlockSize = 64 * 1024;
+
+ private:
+    struct Block
+    {
+        std::unique_ptr<std::byte[]> data;
+        std::size_t size;
+    };
+
+    void addBlock(std::size_t minSize);
+
+    std::vector<Block> blocks;
+    // Offset of the next allocation in the last block
+    std::size_t offset{ 0 };
+    // Bytes used in the blocks before the last one
+    std::size_t usedBefore{ 0 };
+    std::size_t nBlockAllocations{ 0 };
+};
+
+
+// Standard allocator that takes the memory of containers from a
+// FrameArena. Memory is only given back by FrameArena::reset(), so the
+// containers must not outlive the frame, and growing a container leaves
+// its previous storage unused until then.
+template<typename T>
+class ArenaAllocator
+{
+ public:
+    using value_type = T;
+
+    explicit ArenaAllocator(FrameArena& _arena) noexcept : arena(&_arena) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena(other.arena) {} // NOLINT(google-explicit-constructor)
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* /*p*/, std::size_t /*n*/) noexcept {}
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const noexcept { return arena == other.arena; }
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const noexcept { return arena != other.arena; }
+
+ private:
+    template<typename U> friend class ArenaAllocator;
+
+    FrameArena* arena;
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+} // end namespace celestia::util
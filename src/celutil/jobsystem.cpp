@@ -0,0 +1,264 @@
+// jobsystem.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Shared worker threads running prioritized jobs.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <chrono>
+#include <utility>
+#include "jobsystem.h"
+
+namespace celestia::util
+{
+
+namespace
+{
+
+JobSystem* jobSystem = nullptr;
+
+// Index of the worker running on this thread, if any
+thread_local const JobSystem* currentJobSystem = nullptr;
+thread_local std::size_t currentWorker = 0;
+
+} // end unnamed namespace
+
+JobSystem::JobSystem(unsigned int nThreads)
+{
+    if (nThreads == 0)
+    {
+        unsigned int hardwareThreads = std::thread::hardware_concurrency();
+        nThreads = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+
+    m_workers.reserve(nThreads);
+    for (unsigned int i = 0; i < nThreads; ++i)
+        m_workers.push_back(std::make_unique<Worker>());
+    for (std::size_t i = 0; i < m_workers.size(); ++i)
+        m_workers[i]->thread = std::thread(&JobSystem::workerLoop, this, i);
+}
+
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stop = true;
+    }
+    m_jobAvailable.notify_all();
+
+    for (auto& worker : m_workers)
+        worker->thread.join();
+}
+
+
+unsigned int JobSystem::size() const
+{
+    return static_cast<unsigned int>(m_workers.size());
+}
+
+
+void JobSystem::submit(std::function<void()>&& job, JobPriority priority)
+{
+    // Workers keep the jobs they spawn, the others are spread evenly
+    std::size_t index = currentJobSystem == this
+        ? currentWorker
+        : m_nextWorker.fetch_add(1, std::memory_order_relaxed) % m_workers.size();
+
+    Worker& worker = *m_workers[index];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.queues[static_cast<std::size_t>(priority)].push_back(std::move(job));
+    }
+
+    m_queued.fetch_add(1, std::memory_order_release);
+    {
+        // Workers check the count with the mutex held before sleeping
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    m_jobAvailable.notify_one();
+}
+
+
+// Take the newest job of the own queues of a worker, or the oldest job of
+// another worker, preferring higher priorities over either.
+bool JobSystem::pop(std::size_t self, JobPriority lowest, std::function<void()>& job)
+{
+    if (m_queued.load(std::memory_order_acquire) == 0)
+        return false;
+
+    std::size_t nWorkers = m_workers.size();
+    for (std::size_t priority = 0; priority <= static_cast<std::size_t>(lowest); ++priority)
+    {
+        for (std::size_t i = 0; i < nWorkers; ++i)
+        {
+            std::size_t index = (self + i) % nWorkers;
+            Worker& worker = *m_workers[index];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            auto& queue = worker.queues[priority];
+            if (queue.empty())
+                continue;
+
+            if (index == self && currentJobSystem == this)
+            {
+                job = std::move(queue.back());
+                queue.pop_back();
+            }
+            else
+            {
+                job = std::move(queue.front());
+                queue.pop_front();
+            }
+            m_queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+bool JobSystem::runPending(JobPriority lowest)
+{
+    std::size_t self = currentJobSystem == this ? currentWorker : 0;
+    std::function<void()> job;
+    if (!pop(self, lowest, job))
+        return false;
+
+    job();
+    return true;
+}
+
+
+void JobSystem::workerLoop(std::size_t index)
+{
+    currentJobSystem = this;
+    currentWorker = index;
+
+    std::function<void()> job;
+    for (;;)
+    {
+        if (pop(index, JobPriority::Background, job))
+        {
+            job();
+            job = nullptr;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_jobAvailable.wait(lock, [this]
+        {
+            return m_stop || m_queued.load(std::memory_order_acquire) > 0;
+        });
+        if (m_stop)
+            return;
+    }
+}
+
+
+void JobSystem::runOnRenderThread(std::function<void()>&& job)
+{
+    std::lock_guard<std::mutex> lock(m_renderMutex);
+    m_renderJobs.push_back(std::move(job));
+}
+
+
+std::size_t JobSystem::runRenderThreadJobs()
+{
+    std::size_t count = 0;
+    std::vector<std::function<void()>> jobs;
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_renderMutex);
+            if (m_renderJobs.empty())
+                return count;
+            jobs.swap(m_renderJobs);
+        }
+
+        for (auto& job : jobs)
+            job();
+        count += jobs.size();
+        jobs.clear();
+    }
+}
+
+
+TaskGroup::TaskGroup(JobPriority priority) :
+    m_jobs(GetJobSystem()),
+    m_priority(priority)
+{
+}
+
+
+TaskGroup::~TaskGroup()
+{
+    wait();
+}
+
+
+void TaskGroup::run(std::function<void()>&& job)
+{
+    if (m_jobs == nullptr)
+    {
+        job();
+        return;
+    }
+
+    m_pending.fetch_add(1, std::memory_order_relaxed);
+    m_jobs->submit([this, job = std::move(job)]
+    {
+        job();
+        // The group may be destroyed once the count is zero and the mutex
+        // is released
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            m_finished.notify_all();
+    }, m_priority);
+}
+
+
+void TaskGroup::wait()
+{
+    using namespace std::chrono_literals;
+
+    while (m_pending.load(std::memory_order_acquire) > 0)
+    {
+        if (m_jobs->runPending(m_priority))
+            continue;
+
+        // Jobs of the group may still spawn jobs which can be helped with
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_finished.wait_for(lock, 1ms, [this] { return m_pending.load(std::memory_order_acquire) == 0; });
+    }
+
+    // The last job may still hold the mutex
+    std::lock_guard<std::mutex> lock(m_mutex);
+}
+
+
+JobSystem* GetJobSystem()
+{
+    return jobSystem;
+}
+
+
+JobSystem* CreateJobSystem(unsigned int nThreads)
+{
+    if (jobSystem == nullptr)
+        jobSystem = new JobSystem(nThreads);
+    return jobSystem;
+}
+
+
+void DestroyJobSystem()
+{
+    delete jobSystem;
+    jobSystem = nullptr;
+}
+
+} // end namespace celestia::util
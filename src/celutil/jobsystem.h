@@ -0,0 +1,157 @@
+// jobsystem.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Shared worker threads running prioritized jobs.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace celestia::util
+{
+
+// Jobs of a higher priority are started first; a lower value is a higher
+// priority.
+enum class JobPriority
+{
+    // Work a frame or a user action is waiting for
+    Interactive = 0,
+    // Loading of data which is drawn as soon as it's ready
+    Streaming   = 1,
+    // Everything else
+    Background  = 2,
+};
+
+/**
+ * Worker threads shared by all of the subsystems. Each worker has its own
+ * queues, one per priority; jobs submitted by a worker go to its queues,
+ * and idle workers steal the oldest jobs of the others. Jobs which must
+ * run on the render thread are queued separately and run by
+ * runRenderThreadJobs().
+ */
+class JobSystem
+{
+ public:
+    /**
+     * Create nThreads workers. If nThreads is 0, one worker per hardware
+     * thread other than the render thread is created.
+     */
+    explicit JobSystem(unsigned int nThreads = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    unsigned int size() const;
+
+    void submit(std::function<void()>&& job, JobPriority priority = JobPriority::Background);
+
+    /**
+     * Run one queued job of at least the given priority on the calling
+     * thread. Returns false if there was none.
+     */
+    bool runPending(JobPriority lowest = JobPriority::Background);
+
+    void runOnRenderThread(std::function<void()>&& job);
+
+    /**
+     * Run the jobs queued by runOnRenderThread(), including those which
+     * they queue themselves. Returns the number of jobs run.
+     */
+    std::size_t runRenderThreadJobs();
+
+ private:
+    static constexpr std::size_t PriorityCount = 3;
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> queues[PriorityCount];
+        std::thread thread;
+    };
+
+    void workerLoop(std::size_t index);
+    bool pop(std::size_t self, JobPriority lowest, std::function<void()>& job);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::atomic<std::size_t> m_queued{ 0 };
+    std::atomic<std::size_t> m_nextWorker{ 0 };
+    std::mutex m_sleepMutex;
+    std::condition_variable m_jobAvailable;
+    bool m_stop{ false };
+
+    std::mutex m_renderMutex;
+    std::vector<std::function<void()>> m_renderJobs;
+};
+
+/**
+ * Jobs which are waited for together. The jobs run on the shared job
+ * system, or on the calling thread if there is none. wait() runs queued
+ * jobs of the same or higher priority while the jobs of the group
+ * finish, so groups may be waited for by jobs.
+ */
+class TaskGroup
+{
+ public:
+    explicit TaskGroup(JobPriority priority = JobPriority::Interactive);
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(std::function<void()>&& job);
+    void wait();
+
+ private:
+    JobSystem* m_jobs;
+    JobPriority m_priority;
+    std::atomic<std::size_t> m_pending{ 0 };
+    std::mutex m_mutex;
+    std::condition_variable m_finished;
+};
+
+/**
+ * Call f(first, last) on ranges of at most grain indices covering
+ * [begin, end), in parallel, and return when all of the calls are done.
+ */
+template<typename F>
+void ParallelFor(std::size_t begin, std::size_t end, std::size_t grain, F&& f,
+                 JobPriority priority = JobPriority::Interactive)
+{
+    grain = std::max(grain, std::size_t(1));
+    if (end <= begin + grain)
+    {
+        if (begin < end)
+            f(begin, end);
+        return;
+    }
+
+    TaskGroup group(priority);
+    for (std::size_t first = begin; first < end; first += grain)
+    {
+        std::size_t last = std::min(end, first + grain);
+        group.run([&f, first, last] { f(first, last); });
+    }
+    group.wait();
+}
+
+JobSystem* GetJobSystem();
+JobSystem* CreateJobSystem(unsigned int nThreads = 0);
+void DestroyJobSystem();
+
+} // end namespace celestia::util
@@ -0,0 +1,94 @@
+// lastresult.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Cache of the last result of an expensive function of time that may be
+// shared by several threads.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <atomic>
+
+namespace celestia::util
+{
+
+/**
+ * Remembers the value of a function of time at the time it was last
+ * computed. The slot is guarded by a spin flag that's only ever tried:
+ * a thread that finds it taken doesn't wait, it misses or skips storing,
+ * and computes the value itself. The lock is never held while computing,
+ * so the function may call back into other caches of the same object.
+ *
+ * Copies start out empty, so objects owning a cache stay copyable.
+ */
+template<typename T>
+class LastResultCache
+{
+ public:
+    LastResultCache() = default;
+    ~LastResultCache() = default;
+    LastResultCache(const LastResultCache&) noexcept {}
+    LastResultCache& operator=(const LastResultCache&) noexcept { return *this; }
+
+    /**
+     * Copy the value cached for time t into value. Return false if the
+     * cache holds another time or is in use by another thread.
+     */
+    bool find(double t, T& value) const noexcept
+    {
+        if (m_lock.test_and_set(std::memory_order_acquire))
+            return false;
+
+        bool found = m_valid && m_time == t;
+        if (found)
+            value = m_value;
+
+        m_lock.clear(std::memory_order_release);
+        return found;
+    }
+
+    /**
+     * Replace the cached value with the value at time t, unless another
+     * thread is using the cache.
+     */
+    void store(double t, const T& value) const noexcept
+    {
+        if (m_lock.test_and_set(std::memory_order_acquire))
+            return;
+
+        m_time = t;
+        m_value = value;
+        m_valid = true;
+
+        m_lock.clear(std::memory_order_release);
+    }
+
+    /**
+     * Return the cached value at time t, or compute it with f(t) and cache
+     * it.
+     */
+    template<typename F>
+    T get(double t, F&& f) const
+    {
+        T value;
+        if (!find(t, value))
+        {
+            value = f(t);
+            store(t, value);
+        }
+        return value;
+    }
+
+ private:
+    mutable std::atomic_flag m_lock = ATOMIC_FLAG_INIT;
+    mutable double m_time{ 0.0 };
+    mutable T m_value;
+    mutable bool m_valid{ false };
+};
+
+} // end namespace celestia::util
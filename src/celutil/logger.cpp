@@ -9,7 +9,18 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
 
 #ifdef _MSC_VER
 #include <windows.h>
@@ -20,6 +31,158 @@
 namespace celestia::util
 {
 
+namespace
+{
+
+// Capacity of the queue of records, a power of two
+constexpr std::size_t QueueSize = 4096;
+
+} // end unnamed namespace
+
+// Bounded multiple producer, single consumer queue of formatted records.
+// Producers claim a cell by advancing the enqueue position, and the
+// sequence number of each cell tells whether it's free or ready, so that
+// pushing never takes a lock. Consumers are serialized by drainMutex.
+class Logger::AsyncQueue
+{
+ public:
+    AsyncQueue()
+    {
+        for (std::size_t i = 0; i < QueueSize; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bool push(Level level, std::string&& text)
+    {
+        std::size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;)
+        {
+            cell = &cells[pos & (QueueSize - 1)];
+            std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->level = level;
+        cell->text = std::move(text);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Must be called with drainMutex held
+    bool pop(Level& level, std::string& text)
+    {
+        Cell* cell = &cells[dequeuePos & (QueueSize - 1)];
+        if (cell->sequence.load(std::memory_order_acquire) != dequeuePos + 1)
+            return false;
+
+        level = cell->level;
+        text = std::move(cell->text);
+        cell->text.clear();
+        cell->sequence.store(dequeuePos + QueueSize, std::memory_order_release);
+        dequeuePos++;
+        return true;
+    }
+
+    std::size_t pushed() const
+    {
+        return enqueuePos.load(std::memory_order_relaxed);
+    }
+
+    std::mutex drainMutex;
+    // Records written, updated with drainMutex held
+    std::atomic<std::size_t> written{ 0 };
+
+    std::thread writer;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::atomic<bool> sleeping{ false };
+    std::atomic<bool> stopping{ false };
+
+ private:
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence;
+        Level level;
+        std::string text;
+    };
+
+    std::array<Cell, QueueSize> cells;
+    alignas(64) std::atomic<std::size_t> enqueuePos{ 0 };
+    alignas(64) std::size_t dequeuePos{ 0 };
+};
+
+// Counts of the messages logged with each format string, which is the
+// same for all of the messages of a call site. Slots are claimed with a
+// compare and swap; when all of them are taken, further formats aren't
+// limited.
+class Logger::RepeatFilter
+{
+ public:
+    static constexpr std::size_t Slots = 256;
+
+    explicit RepeatFilter(unsigned int _limit) : limit(_limit) {}
+
+    bool allow(const char* format)
+    {
+        std::size_t start = std::hash<const void*>()(format) % Slots;
+        for (std::size_t i = 0; i < Slots; i++)
+        {
+            Slot& slot = slots[(start + i) % Slots];
+            const char* key = slot.format.load(std::memory_order_acquire);
+            if (key == nullptr)
+            {
+                if (!slot.format.compare_exchange_strong(key, format, std::memory_order_acq_rel) && key != format)
+                    continue;
+            }
+            else if (key != format)
+            {
+                continue;
+            }
+            return slot.count.fetch_add(1, std::memory_order_relaxed) < limit;
+        }
+        return true;
+    }
+
+    // Call f with the format and the number of suppressed messages of each
+    // format over the limit, and restart the counts
+    template<typename F> void report(F&& f)
+    {
+        for (Slot& slot : slots)
+        {
+            const char* format = slot.format.load(std::memory_order_acquire);
+            if (format == nullptr)
+                continue;
+            unsigned int count = slot.count.exchange(0, std::memory_order_relaxed);
+            if (count > limit)
+                f(format, count - limit);
+        }
+    }
+
+ private:
+    struct Slot
+    {
+        std::atomic<const char*> format{ nullptr };
+        std::atomic<unsigned int> count{ 0 };
+    };
+
+    unsigned int limit;
+    std::array<Slot, Slots> slots;
+};
+
 Logger* Logger::g_logger = nullptr;
 
 Logger* GetLogger()
@@ -50,6 +213,76 @@ Logger::Logger() :
 {
 }
 
+Logger::Logger(Level level, Stream &log, Stream &err) :
+    m_log(log),
+    m_err(err),
+    m_level(level)
+{
+}
+
+Logger::~Logger()
+{
+    stopAsync();
+    flush();
+}
+
+void Logger::startAsync(bool backgroundThread)
+{
+    if (m_async != nullptr)
+        return;
+
+    m_async = std::make_unique<AsyncQueue>();
+    if (backgroundThread)
+        m_async->writer = std::thread([this] { writerLoop(); });
+}
+
+void Logger::stopAsync()
+{
+    if (m_async == nullptr)
+        return;
+
+    if (m_async->writer.joinable())
+    {
+        m_async->stopping.store(true);
+        {
+            std::lock_guard<std::mutex> lock(m_async->wakeMutex);
+            m_async->wake.notify_one();
+        }
+        m_async->writer.join();
+    }
+
+    flush();
+    m_async = nullptr;
+}
+
+void Logger::setRepeatLimit(unsigned int limit)
+{
+    if (limit == 0)
+        m_repeats = nullptr;
+    else
+        m_repeats = std::make_unique<RepeatFilter>(limit);
+}
+
+void Logger::flush() const
+{
+    if (m_async != nullptr)
+    {
+        std::lock_guard<std::mutex> lock(m_async->drainMutex);
+        drain();
+    }
+
+    if (m_repeats != nullptr)
+    {
+        m_repeats->report([this](const char* format, unsigned int count)
+        {
+            std::string_view message(format);
+            if (!message.empty() && message.back() == '\n')
+                message.remove_suffix(1);
+            write(Level::Info, fmt::format("{} more messages like \"{}\" were suppressed\n", count, message));
+        });
+    }
+}
+
 void Logger::vlog(Level level, fmt::string_view format, fmt::format_args args) const
 {
 #ifdef _MSC_VER
@@ -60,8 +293,85 @@ void Logger::vlog(Level level, fmt::string_view format, fmt::format_args args) c
     }
 #endif
 
+    if (level != Level::Error && m_repeats != nullptr && !m_repeats->allow(format.data()))
+        return;
+
+    if (m_async == nullptr)
+    {
+        write(level, format, args);
+        return;
+    }
+
+    std::string text = fmt::vformat(format, args);
+    while (!m_async->push(level, std::move(text)))
+    {
+        // The queue is full: write the records on this thread instead of
+        // waiting for the writer
+        std::lock_guard<std::mutex> lock(m_async->drainMutex);
+        drain();
+    }
+
+    // Errors are written before returning, in case the program ends
+    if (level == Level::Error)
+    {
+        std::lock_guard<std::mutex> lock(m_async->drainMutex);
+        drain();
+    }
+    else if (m_async->sleeping.load(std::memory_order_relaxed))
+    {
+        m_async->wake.notify_one();
+    }
+}
+
+void Logger::write(Level level, fmt::string_view format, fmt::format_args args) const
+{
+    // Catalogs may be loaded on other threads
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+
     auto &stream = (level <= Level::Warning || level == Level::Debug) ? m_err : m_log;
     fmt::vprint(stream, format, args);
 }
 
+void Logger::write(Level level, const std::string& text) const
+{
+    write(level, "{}", fmt::make_format_args(text));
+}
+
+// Must be called with m_async->drainMutex held
+void Logger::drain() const
+{
+    Level level;
+    std::string text;
+    while (m_async->pop(level, text))
+    {
+        write(level, text);
+        m_async->written.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Logger::writerLoop() const
+{
+    using namespace std::chrono_literals;
+
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_async->drainMutex);
+            drain();
+        }
+
+        if (m_async->stopping.load())
+            return;
+
+        // Producers only notify a sleeping writer, without the lock, so
+        // wakeups may be missed; the timeout bounds the delay
+        std::unique_lock<std::mutex> lock(m_async->wakeMutex);
+        m_async->sleeping.store(true, std::memory_order_relaxed);
+        if (m_async->written.load(std::memory_order_relaxed) == m_async->pushed())
+            m_async->wake.wait_for(lock, 10ms);
+        m_async->sleeping.store(false, std::memory_order_relaxed);
+    }
+}
+
 } // end namespace celestia::util
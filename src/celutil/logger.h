@@ -12,6 +12,7 @@
 #pragma once
 
 #include <iosfwd>
+#include <memory>
 #include <string>
 
 #include <fmt/format.h>
@@ -46,11 +47,8 @@ class Logger
     using Stream = std::basic_ostream<char>;
 
     Logger();
-    Logger(Level level, Stream &log, Stream &err) :
-        m_level(level),
-        m_log(log),
-        m_err(err)
-    {}
+    Logger(Level level, Stream &log, Stream &err);
+    ~Logger();
 
     void setLevel(Level level)
     {
@@ -75,14 +73,38 @@ class Logger
     template <typename... Args> void
     log(Level, const char *format, const Args&... args) const;
 
+    // Format the messages on the calling thread and queue them without
+    // locking. They are written by a background thread, or by flush()
+    // when backgroundThread is false, and by the callers when the queue
+    // is full. Errors are written before error() returns.
+    void startAsync(bool backgroundThread = true);
+    // Write the queued messages and return to synchronous writing
+    void stopAsync();
+
+    // Keep only the first limit messages of each call site, except
+    // errors, until the next flush(); 0 for no limit
+    void setRepeatLimit(unsigned int limit);
+
+    // Write the queued messages and the numbers of suppressed ones
+    void flush() const;
+
     static Logger* g_logger;
 
  private:
+    class AsyncQueue;
+    class RepeatFilter;
+
     void vlog(Level level, fmt::string_view format, fmt::format_args args) const;
+    void write(Level level, fmt::string_view format, fmt::format_args args) const;
+    void write(Level level, const std::string& text) const;
+    void drain() const;
+    void writerLoop() const;
 
     Stream &m_log;
     Stream &m_err;
     Level   m_level { Level::Info };
+    std::unique_ptr<AsyncQueue> m_async;
+    std::unique_ptr<RepeatFilter> m_repeats;
 };
 
 template <typename... Args> void
@@ -0,0 +1,50 @@
+// memoryusage.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Accounting of the memory used by catalogs, caches and GPU resources.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "memoryusage.h"
+
+#include <utility>
+
+namespace celestia::util
+{
+
+MemoryUsage::MemoryUsage(std::string _name, std::size_t _bytes, std::size_t _count) :
+    name(std::move(_name)),
+    bytes(_bytes),
+    count(_count)
+{
+}
+
+MemoryUsage&
+MemoryUsage::add(std::string childName, std::size_t childBytes, std::size_t childCount)
+{
+    return children.emplace_back(std::move(childName), childBytes, childCount);
+}
+
+std::size_t
+MemoryUsage::total() const
+{
+    std::size_t sum = bytes;
+    for (const MemoryUsage& child : children)
+        sum += child.total();
+    return sum;
+}
+
+std::size_t
+StringMemory(const std::string& s)
+{
+    // Short strings are stored in the object, and its capacity is then
+    // the size of the buffer within it
+    std::string empty;
+    return s.capacity() > empty.capacity() ? s.capacity() + 1 : 0;
+}
+
+} // end namespace celestia::util
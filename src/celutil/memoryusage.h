@@ -0,0 +1,63 @@
+// memoryusage.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Accounting of the memory used by catalogs, caches and GPU resources.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace celestia::util
+{
+
+// MemoryUsage is a node of a tree of byte counts. Subsystems account for
+// their memory by adding their own node below the one of their owner with
+// an accountMemory(MemoryUsage&) const member. The counts are estimates:
+// the overhead of the allocator isn't included, and containers are
+// counted by their capacity.
+struct MemoryUsage
+{
+    std::string name;
+    // Bytes used directly by this part, not by its children
+    std::size_t bytes{ 0 };
+    // Number of objects of this part, zero if it isn't meaningful
+    std::size_t count{ 0 };
+    std::vector<MemoryUsage> children;
+
+    explicit MemoryUsage(std::string _name, std::size_t _bytes = 0, std::size_t _count = 0);
+
+    // Add a child node and return it; the reference is valid until the
+    // next child is added
+    MemoryUsage& add(std::string childName, std::size_t childBytes = 0, std::size_t childCount = 0);
+
+    // Bytes of this part and all of its children
+    std::size_t total() const;
+};
+
+// Heap memory of a string, zero if it's stored within the object
+std::size_t StringMemory(const std::string& s);
+
+template<typename T>
+std::size_t VectorMemory(const std::vector<T>& v)
+{
+    return v.capacity() * sizeof(T);
+}
+
+// Estimated memory of a node of std::map and similar node based containers
+template<typename T>
+constexpr std::size_t NodeMemory()
+{
+    // Three pointers and the color of red black trees, or the hash and
+    // the next pointer of hash tables
+    return sizeof(T) + 4 * sizeof(void*);
+}
+
+} // end namespace celestia::util
@@ -0,0 +1,63 @@
+// mmapfile.h
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// Read-only memory-mapped files.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <celcompat/filesystem.h>
+
+namespace celestia::util
+{
+
+/**
+ * Read-only view of a whole file mapped into the address space of the
+ * process. The mapping is released when the object is destroyed.
+ */
+class MemoryMappedFile
+{
+ public:
+    enum class AccessHint
+    {
+        Normal,
+        Sequential,
+        Random,
+    };
+
+    MemoryMappedFile() = default;
+    ~MemoryMappedFile();
+
+    MemoryMappedFile(const MemoryMappedFile&) = delete;
+    MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+    MemoryMappedFile(MemoryMappedFile&&) noexcept;
+    MemoryMappedFile& operator=(MemoryMappedFile&&) noexcept;
+
+    /**
+     * Map the file at path. Any previously mapped file is released first.
+     * Returns false if the file can't be opened or mapped; empty files
+     * can't be mapped.
+     */
+    bool open(const fs::path& path, AccessHint hint = AccessHint::Normal);
+    void close();
+
+    bool isOpen() const { return m_data != nullptr; }
+    const char* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+
+ private:
+    const char* m_data{ nullptr };
+    std::size_t m_size{ 0 };
+#ifdef _WIN32
+    void* m_file{ nullptr };
+    void* m_mapping{ nullptr };
+#endif
+};
+
+} // end namespace celestia::util
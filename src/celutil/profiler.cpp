@@ -0,0 +1,165 @@
+// profiler.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Frame profiler timing named zones of each frame.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <fmt/format.h>
+
+namespace celestia::util
+{
+
+namespace
+{
+
+Profiler* profilerInstance = nullptr;
+
+double toMicroseconds(Profiler::clock::duration d)
+{
+    return std::chrono::duration<double, std::micro>(d).count();
+}
+
+} // end unnamed namespace
+
+Profiler::Profiler(std::size_t _traceFrames) :
+    traceFrames(_traceFrames),
+    epoch(clock::now())
+{
+}
+
+void
+Profiler::beginFrame()
+{
+    frame++;
+    while (!events.empty() && events.front().frame + traceFrames <= frame)
+        events.pop_front();
+}
+
+std::size_t
+Profiler::getZone(const char* name, Source source, int zoneDepth)
+{
+    for (std::size_t i = 0; i < zones.size(); i++)
+    {
+        if (zones[i].source == source && std::strcmp(zones[i].name, name) == 0)
+            return i;
+    }
+
+    zones.push_back({ name, source, zoneDepth });
+    return zones.size() - 1;
+}
+
+const char*
+Profiler::internName(std::string_view name)
+{
+    auto it = names.find(name);
+    if (it == names.end())
+        it = names.emplace(name).first;
+    return it->c_str();
+}
+
+void
+Profiler::addTime(std::size_t zone, std::uint64_t zoneFrame, clock::time_point start, clock::time_point end)
+{
+    if (zoneFrame + HistorySize > frame)
+    {
+        Zone& z = zones[zone];
+        std::size_t slot = zoneFrame % HistorySize;
+        if (z.frames[slot] != zoneFrame)
+        {
+            z.frames[slot] = zoneFrame;
+            z.totals[slot] = 0.0;
+        }
+        z.totals[slot] += toMicroseconds(end - start) / 1000.0;
+        z.lastFrame = std::max(z.lastFrame, zoneFrame);
+    }
+
+    if (zoneFrame + traceFrames > frame)
+        events.push_back({ zone, zoneFrame, start, end });
+}
+
+std::vector<Profiler::ZoneStats>
+Profiler::getStats(std::size_t frames) const
+{
+    std::vector<ZoneStats> stats;
+    stats.reserve(zones.size());
+    for (const Zone& zone : zones)
+    {
+        // The current frame isn't complete, and the results of the other
+        // sources come later.
+        std::uint64_t last = zone.source == Source::CPU ? std::max<std::uint64_t>(frame, 1) - 1 : zone.lastFrame;
+        std::uint64_t count = std::min<std::uint64_t>(std::min(frames, HistorySize), last);
+
+        ZoneStats s{ zone.name, zone.source, zone.depth, 0.0, 0.0 };
+        for (std::uint64_t f = last + 1 - count; f <= last && count > 0; f++)
+        {
+            std::size_t slot = f % HistorySize;
+            double t = zone.frames[slot] == f ? zone.totals[slot] : 0.0;
+            s.average += t;
+            s.maximum = std::max(s.maximum, t);
+        }
+        if (count > 0)
+            s.average /= static_cast<double>(count);
+        stats.push_back(s);
+    }
+
+    return stats;
+}
+
+bool
+Profiler::writeTrace(const fs::path& path) const
+{
+    std::ofstream out(path);
+    if (!out.good())
+        return false;
+
+    // The CPU and GPU zones are shown as two threads of one process
+    out << "{\"traceEvents\":[\n"
+        << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n"
+        << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+    for (const Event& event : events)
+    {
+        const Zone& zone = zones[event.zone];
+        out << fmt::format(",\n{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f},\"args\":{{\"frame\":{}}}}}",
+                           zone.name,
+                           zone.source == Source::CPU ? 1 : 2,
+                           toMicroseconds(event.start - epoch),
+                           toMicroseconds(event.end - event.start),
+                           event.frame);
+    }
+    out << "\n]}\n";
+
+    return out.good();
+}
+
+Profiler*
+GetProfiler()
+{
+    return profilerInstance;
+}
+
+Profiler*
+CreateProfiler(std::size_t traceFrames)
+{
+    if (profilerInstance == nullptr)
+        profilerInstance = new Profiler(traceFrames);
+    return profilerInstance;
+}
+
+void
+DestroyProfiler()
+{
+    delete profilerInstance;
+    profilerInstance = nullptr;
+}
+
+} // end namespace celestia::util
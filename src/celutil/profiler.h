@@ -0,0 +1,160 @@
+// profiler.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Frame profiler timing named zones of each frame.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <celcompat/filesystem.h>
+
+namespace celestia::util
+{
+
+// Profiler collects the time spent in named zones of each frame. CPU zones
+// are timed by ProfileZone objects; other sources such as the GPU add the
+// intervals of their zones when they're known, which may be some frames
+// later. Zone names must be string literals.
+//
+// The totals of the zones over the last frames are kept for statistics,
+// and the intervals of the last frames for traces in the Chrome trace
+// event format. The profiler isn't thread safe, so zones are only timed
+// on the thread which created it. Zones named at run time, such as those
+// of scripts, use names copied by internName().
+class Profiler
+{
+ public:
+    using clock = std::chrono::steady_clock;
+
+    enum class Source
+    {
+        CPU,
+        GPU,
+    };
+
+    // Time spent in a zone over the last frames, in milliseconds per frame
+    struct ZoneStats
+    {
+        const char* name;
+        Source source;
+        int depth;
+        double average;
+        double maximum;
+    };
+
+    // Number of frames of the statistics
+    static constexpr std::size_t HistorySize = 120;
+
+    explicit Profiler(std::size_t traceFrames);
+
+    // Start a new frame, in which the CPU zones are counted
+    void beginFrame();
+    std::uint64_t getFrame() const { return frame; }
+
+    // Index of the zone with the name and source, which is added if it's
+    // new. Zones are listed in the order of their first use.
+    std::size_t getZone(const char* name, Source source, int depth);
+    // A copy of name which lives as long as the profiler
+    const char* internName(std::string_view name);
+    // Add an interval of a zone in a frame, the current one or an earlier one
+    void addTime(std::size_t zone, std::uint64_t zoneFrame, clock::time_point start, clock::time_point end);
+
+    // Whether CPU zones are timed on the calling thread
+    bool isOwnerThread() const { return std::this_thread::get_id() == owner; }
+
+    // Nesting level of the CPU zones
+    int enterZone() { return depth++; }
+    void leaveZone() { --depth; }
+
+    // Statistics of the last frames, at most HistorySize
+    std::vector<ZoneStats> getStats(std::size_t frames = HistorySize) const;
+    // Write the intervals of the last frames as a Chrome trace
+    bool writeTrace(const fs::path& path) const;
+
+ private:
+    struct Zone
+    {
+        const char* name;
+        Source source;
+        int depth;
+        // Totals in milliseconds of the frames kept for statistics, at
+        // the index of the frame modulo HistorySize
+        std::array<double, HistorySize> totals{};
+        std::array<std::uint64_t, HistorySize> frames{};
+        std::uint64_t lastFrame{ 0 };
+    };
+
+    struct Event
+    {
+        std::size_t zone;
+        std::uint64_t frame;
+        clock::time_point start;
+        clock::time_point end;
+    };
+
+    std::vector<Zone> zones;
+    std::deque<Event> events;
+    std::set<std::string, std::less<>> names;
+    std::size_t traceFrames;
+    std::uint64_t frame{ 0 };
+    int depth{ 0 };
+    clock::time_point epoch;
+    std::thread::id owner{ std::this_thread::get_id() };
+};
+
+// The profiler of the process, or nullptr when profiling is off
+Profiler* GetProfiler();
+// Create the profiler, keeping the intervals of traceFrames frames
+Profiler* CreateProfiler(std::size_t traceFrames = 0);
+void DestroyProfiler();
+
+// ProfileZone times a CPU zone from its construction to its destruction
+// when the profiler exists.
+class ProfileZone
+{
+ public:
+    explicit ProfileZone(const char* name) :
+        profiler(GetProfiler())
+    {
+        // Zones of other threads, such as those of jobs, aren't timed
+        if (profiler != nullptr && !profiler->isOwnerThread())
+            profiler = nullptr;
+        if (profiler == nullptr)
+            return;
+        zone = profiler->getZone(name, Profiler::Source::CPU, profiler->enterZone());
+        start = Profiler::clock::now();
+    }
+
+    ~ProfileZone()
+    {
+        if (profiler == nullptr)
+            return;
+        profiler->addTime(zone, profiler->getFrame(), start, Profiler::clock::now());
+        profiler->leaveZone();
+    }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+ private:
+    Profiler* profiler;
+    std::size_t zone{ 0 };
+    Profiler::clock::time_point start;
+};
+
+} // end namespace celestia::util
@@ -10,16 +10,41 @@
 #ifndef _CELUTIL_RESMANAGER_H_
 #define _CELUTIL_RESMANAGER_H_
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
 #include <vector>
-#include <map>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <celutil/jobsystem.h>
+#include <celutil/memoryusage.h>
 #include <celutil/reshandle.h>
+#include <celutil/threadpool.h>
 #include <celcompat/filesystem.h>
 
 
+// Combine the hash of a field of a resource info with the hash of the
+// preceding fields
+inline std::size_t ResourceHashCombine(std::size_t seed, std::size_t value)
+{
+    return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+
 enum ResourceState {
     ResourceNotLoaded     = 0,
     ResourceLoaded        = 1,
     ResourceLoadingFailed = 2,
+    ResourceLoading       = 3,
 };
 
 
@@ -32,10 +57,45 @@ template<class T> class ResourceInfo
     virtual fs::path resolve(const fs::path&) = 0;
     virtual T* load(const fs::path&) = 0;
 
+    // The work of load() split for asynchronous loading: decode() is called
+    // on a loader thread, then create() on the thread calling
+    // ResourceManager::update().
+    class AsyncLoader
+    {
+     public:
+        virtual ~AsyncLoader() = default;
+        virtual bool decode() = 0;
+        virtual T* create() = 0;
+        // Number of bytes handed to create(), or to refine() once created,
+        // counted against the budget of update()
+        virtual std::size_t size() const = 0;
+
+        // Progressive loaders decode a reduced version of the resource
+        // first. If refinable() is true after decode(), decodeRefinement()
+        // is called on a loader thread at a lower priority, and once both
+        // are done, refine() replaces the contents of the created resource
+        // in place on the thread calling update().
+        virtual bool refinable() const { return false; }
+        virtual bool decodeRefinement() { return false; }
+        virtual void refine(T*) {}
+    };
+
+    // Return null if the resource must be loaded with load()
+    virtual std::unique_ptr<AsyncLoader> asyncLoader(const fs::path&) { return nullptr; }
+
+    // Bytes used by the loaded resource, zero if it's unknown
+    virtual std::size_t getMemoryUsage() const { return 0; }
+
     typedef T ResourceType;
     ResourceState state;
     fs::path resolvedName;
     T* resource;
+    // Value of the use counter of the manager when the resource was last
+    // found
+    std::uint64_t lastUsed{ 0 };
+    // Number of acquire() calls without release(); acquired resources
+    // aren't evicted
+    unsigned int references{ 0 };
 };
 
 
@@ -52,9 +112,30 @@ template<class T> class ResourceManager
     typedef typename T::ResourceType ResourceType;
 
  private:
+    struct AsyncLoad
+    {
+        fs::path name;
+        std::unique_ptr<typename ResourceInfo<ResourceType>::AsyncLoader> loader;
+        std::vector<ResourceHandle> handles;
+        bool succeeded{ false };
+        std::atomic<bool> decoded{ false };
+        // Resource created from the reduced version while it's refined,
+        // null if it was evicted
+        ResourceType* resource{ nullptr };
+        bool refineSucceeded{ false };
+        std::atomic<bool> refined{ false };
+    };
+
+    struct PathHash
+    {
+        std::size_t operator()(const fs::path& p) const { return fs::hash_value(p); }
+    };
+
+    // Handles are indexed by the hash() of their infos, so that the infos
+    // are only stored once and compared when their hashes collide
     typedef std::vector<T> ResourceTable;
-    typedef std::map<T, ResourceHandle> ResourceHandleMap;
-    typedef std::map<fs::path, ResourceType*> NameMap;
+    typedef std::unordered_multimap<std::size_t, ResourceHandle> ResourceHandleMap;
+    typedef std::unordered_map<fs::path, ResourceType*, PathHash> NameMap;
 
     typedef typename ResourceHandleMap::value_type ResourceHandleMapValue;
     typedef typename NameMap::value_type NameMapValue;
@@ -63,25 +144,60 @@ template<class T> class ResourceManager
     ResourceHandleMap handles;
     NameMap loadedResources;
 
+    // Loader threads used when there is no shared job system
+    std::unique_ptr<celestia::util::ThreadPool> loaderPool;
+    unsigned int loaderThreads{ 0 };
+    std::vector<std::shared_ptr<AsyncLoad>> pendingLoads;
+    // Loads created from a reduced version and waiting for the full one
+    std::vector<std::shared_ptr<AsyncLoad>> refiningLoads;
+
+    // Handles may be requested while catalogs are loaded on another thread
+    std::recursive_mutex mutex;
+
+    // Counter of the calls to find(), ordering the uses of the resources
+    std::uint64_t useCount{ 0 };
+    // Value of useCount at the last call to evict()
+    std::uint64_t evictMark{ 0 };
+    // Bytes of loaded resources kept by evict(), 0 for no limit
+    std::size_t memoryBudget{ 0 };
+    // Number of resources loaded, including those loaded again after
+    // they were evicted
+    std::uint64_t loadCount{ 0 };
+
  public:
     ResourceHandle getHandle(const T& info)
     {
-        typename ResourceHandleMap::iterator iter = handles.find(info);
-        if (iter != handles.end())
-        {
-            return iter->second;
-        }
-        else
-        {
-            ResourceHandle h = handles.size();
-            resources.push_back(info);
-            handles.insert(ResourceHandleMapValue(info, h));
-            return h;
-        }
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        return getHandle(info, info.hash());
+    }
+
+    // Register the infos of [first, last) at once, writing their handles
+    // to out; catalogs loading many objects avoid locking and rehashing
+    // for each of them
+    template<typename InputIt, typename OutputIt>
+    OutputIt getHandles(InputIt first, InputIt last, OutputIt out)
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag,
+                                        typename std::iterator_traits<InputIt>::iterator_category>)
+            reserve(resources.size() + static_cast<std::size_t>(std::distance(first, last)));
+
+        for (; first != last; ++first)
+            *out++ = getHandle(*first, first->hash());
+        return out;
+    }
+
+    // Make room for count handles in total
+    void reserve(std::size_t count)
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        resources.reserve(count);
+        handles.reserve(count);
     }
 
     ResourceType* find(ResourceHandle h)
     {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
         if (h >= (int) handles.size() || h < 0)
         {
             return nullptr;
@@ -98,7 +214,7 @@ template<class T> class ResourceManager
                     resources[h].resource = iter->second;
                     resources[h].state = ResourceLoaded;
                 }
-                else
+                else if (!startAsyncLoad(h))
                 {
                     resources[h].resource = resources[h].load(resources[h].resolvedName);
                     if (resources[h].resource == nullptr)
@@ -109,24 +225,417 @@ template<class T> class ResourceManager
                     {
                         resources[h].state = ResourceLoaded;
                         loadedResources.insert(NameMapValue(resources[h].resolvedName, resources[h].resource));
+                        loadCount++;
                     }
                 }
             }
 
             if (resources[h].state == ResourceLoaded)
+            {
+                resources[h].lastUsed = ++useCount;
                 return resources[h].resource;
+            }
             else
+            {
                 return nullptr;
+            }
         }
     }
 
+    // Find the resource of h and keep it loaded until release(h), for
+    // owners which hold the pointer instead of the handle
+    ResourceType* acquire(ResourceHandle h)
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        ResourceType* resource = find(h);
+        if (resource != nullptr)
+            resources[h].references++;
+        return resource;
+    }
+
+    void release(ResourceHandle h)
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        if (h >= 0 && h < (int) handles.size() && resources[h].references > 0)
+            resources[h].references--;
+    }
+
+    // Start loading the resource of h asynchronously if it isn't loaded
+    // yet, without waiting for it, and count a loaded one as used so that
+    // it isn't evicted before it's drawn. Resources which can't be loaded
+    // asynchronously are left to find(). Returns true if a load was
+    // started.
+    bool prefetch(ResourceHandle h)
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        if (h >= (int) handles.size() || h < 0 || loaderThreads == 0)
+            return false;
+
+        T& info = resources[h];
+        bool started = false;
+        if (info.state == ResourceNotLoaded)
+        {
+            info.resolvedName = info.resolve(baseDir);
+            typename NameMap::iterator iter = loadedResources.find(info.resolvedName);
+            if (iter != loadedResources.end())
+            {
+                info.resource = iter->second;
+                info.state = ResourceLoaded;
+            }
+            else
+            {
+                started = startAsyncLoad(h);
+            }
+        }
+
+        if (info.state == ResourceLoaded)
+            info.lastUsed = ++useCount;
+        return started;
+    }
+
+    // Find the resource of h, waiting for it if it's loaded
+    // asynchronously. The other decoded resources are created meanwhile.
+    ResourceType* findLoaded(ResourceHandle h)
+    {
+        ResourceType* resource = find(h);
+        while (resource == nullptr && isLoading(h))
+        {
+            if (!update(std::numeric_limits<std::size_t>::max()))
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            resource = find(h);
+        }
+        return resource;
+    }
+
+    // Number of resources loaded so far
+    std::uint64_t getLoadCount()
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        return loadCount;
+    }
+
+    // True while find() returns null because h is loaded asynchronously
+    bool isLoading(ResourceHandle h)
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        return h >= 0 && h < (int) handles.size() && resources[h].state == ResourceLoading;
+    }
+
+    // Resources with an asyncLoader() are decoded on the shared job
+    // system, or on nThreads loader threads if there is none, and find()
+    // returns null until update() has created them.
+    void enableAsyncLoading(unsigned int nThreads)
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        loaderThreads = std::max(nThreads, 1u);
+    }
+
+    // Create decoded resources, stopping once the sizes of those created
+    // reach budget bytes; at least one is created if any is ready. Returns
+    // true if a resource was created or failed to load.
+    bool update(std::size_t budget)
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        std::size_t created = 0;
+        bool changed = false;
+        for (auto iter = pendingLoads.begin(); iter != pendingLoads.end();)
+        {
+            if (changed && created >= budget)
+                break;
+
+            AsyncLoad& load = **iter;
+            if (!load.decoded.load(std::memory_order_acquire))
+            {
+                ++iter;
+                continue;
+            }
+
+            created += load.loader->size();
+            ResourceType* resource = load.succeeded ? load.loader->create() : nullptr;
+            for (ResourceHandle h : load.handles)
+            {
+                resources[h].resource = resource;
+                resources[h].state = resource == nullptr ? ResourceLoadingFailed : ResourceLoaded;
+                // Not evicted before it's drawn for the first time
+                resources[h].lastUsed = ++useCount;
+            }
+            if (resource != nullptr)
+            {
+                loadedResources.insert(NameMapValue(load.name, resource));
+                loadCount++;
+            }
+            if (resource != nullptr && load.loader->refinable())
+            {
+                load.resource = resource;
+                refiningLoads.push_back(*iter);
+            }
+
+            iter = pendingLoads.erase(iter);
+            changed = true;
+        }
+
+        for (auto iter = refiningLoads.begin(); iter != refiningLoads.end();)
+        {
+            if (changed && created >= budget)
+                break;
+
+            AsyncLoad& load = **iter;
+            if (!load.refined.load(std::memory_order_acquire))
+            {
+                ++iter;
+                continue;
+            }
+
+            if (load.resource != nullptr && load.refineSucceeded)
+            {
+                created += load.loader->size();
+                load.loader->refine(load.resource);
+                changed = true;
+            }
+            iter = refiningLoads.erase(iter);
+        }
+
+        return changed;
+    }
+
+    // True while asynchronous loads are decoding or waiting for update()
+    bool hasPendingLoads()
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        return !pendingLoads.empty() || !refiningLoads.empty();
+    }
+
+    // Wait for the pending asynchronous loads and create their resources
+    // regardless of the budget. Returns true if any load was pending.
+    bool finishLoads()
+    {
+        bool changed = false;
+        for (;;)
+        {
+            if (update(std::numeric_limits<std::size_t>::max()))
+                changed = true;
+
+            {
+                std::lock_guard<std::recursive_mutex> lock(mutex);
+                if (pendingLoads.empty() && refiningLoads.empty())
+                    return changed;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    void setMemoryBudget(std::size_t budget)
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        memoryBudget = budget;
+    }
+
+    std::size_t getMemoryBudget() const { return memoryBudget; }
+
+    // Evict resources beyond the budget set by setMemoryBudget()
+    std::size_t evict()
+    {
+        return memoryBudget == 0 ? 0 : evict(memoryBudget);
+    }
+
+    // Delete the least recently used resources until the memory of the
+    // loaded ones is at most budget bytes. Resources found since the last
+    // call and acquired ones are kept, so it should be called once per
+    // frame when no pointers returned by find() are held. Evicted
+    // resources are loaded again by the next find() of their handles.
+    // Returns the number of bytes freed.
+    std::size_t evict(std::size_t budget)
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        struct Loaded
+        {
+            ResourceType* resource;
+            std::size_t size;
+            std::uint64_t lastUsed;
+            bool acquired;
+        };
+
+        // Handles may share their resource
+        std::unordered_map<ResourceType*, Loaded> loaded;
+        std::size_t total = 0;
+        for (const T& info : resources)
+        {
+            if (info.state != ResourceLoaded)
+                continue;
+
+            auto [iter, inserted] = loaded.try_emplace(info.resource,
+                                                       Loaded{ info.resource, 0, info.lastUsed, info.references > 0 });
+            if (inserted)
+            {
+                iter->second.size = info.getMemoryUsage();
+                total += iter->second.size;
+            }
+            else
+            {
+                iter->second.lastUsed = std::max(iter->second.lastUsed, info.lastUsed);
+                iter->second.acquired = iter->second.acquired || info.references > 0;
+            }
+        }
+
+        std::uint64_t mark = evictMark;
+        evictMark = useCount;
+        if (total <= budget)
+            return 0;
+
+        std::vector<Loaded> candidates;
+        for (const auto& entry : loaded)
+        {
+            if (entry.second.lastUsed <= mark && !entry.second.acquired)
+                candidates.push_back(entry.second);
+        }
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const Loaded& a, const Loaded& b) { return a.lastUsed < b.lastUsed; });
+
+        std::unordered_set<ResourceType*> evicted;
+        std::size_t freed = 0;
+        for (const Loaded& candidate : candidates)
+        {
+            if (total - freed <= budget)
+                break;
+            evicted.insert(candidate.resource);
+            freed += candidate.size;
+        }
+        if (evicted.empty())
+            return 0;
+
+        for (T& info : resources)
+        {
+            if (info.state == ResourceLoaded && evicted.count(info.resource) != 0)
+            {
+                info.resource = nullptr;
+                info.state = ResourceNotLoaded;
+            }
+        }
+        for (auto iter = loadedResources.begin(); iter != loadedResources.end();)
+        {
+            if (evicted.count(iter->second) != 0)
+                iter = loadedResources.erase(iter);
+            else
+                ++iter;
+        }
+        for (const auto& load : refiningLoads)
+        {
+            if (evicted.count(load->resource) != 0)
+                load->resource = nullptr;
+        }
+        for (ResourceType* resource : evicted)
+            delete resource;
+
+        return freed;
+    }
+
+    // Add a node named name with the table of the resources and the
+    // loaded ones to parent
+    void accountMemory(celestia::util::MemoryUsage& parent, const char* name)
+    {
+        using namespace celestia::util;
+
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        std::unordered_set<const ResourceType*> counted;
+        std::size_t loadedBytes = 0;
+        for (const T& info : resources)
+        {
+            if (info.state == ResourceLoaded && counted.insert(info.resource).second)
+                loadedBytes += info.getMemoryUsage();
+        }
+
+        std::size_t tableBytes = VectorMemory(resources)
+                               + handles.size() * NodeMemory<ResourceHandleMapValue>()
+                               + loadedResources.size() * NodeMemory<NameMapValue>();
+        auto& usage = parent.add(name, tableBytes, resources.size());
+        usage.add("loaded", loadedBytes, counted.size());
+    }
+
     const T* getResourceInfo(ResourceHandle h)
     {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
         if (h >= (int) handles.size() || h < 0)
             return nullptr;
         else
             return &resources[h];
     }
+
+ private:
+    ResourceHandle getHandle(const T& info, std::size_t key)
+    {
+        auto [first, last] = handles.equal_range(key);
+        for (auto iter = first; iter != last; ++iter)
+        {
+            if (resources[iter->second] == info)
+                return iter->second;
+        }
+
+        ResourceHandle h = static_cast<ResourceHandle>(resources.size());
+        resources.push_back(info);
+        handles.emplace(key, h);
+        return h;
+    }
+
+    void submitLoad(std::function<void()>&& job, celestia::util::JobPriority priority)
+    {
+        if (auto* jobs = celestia::util::GetJobSystem(); jobs != nullptr)
+        {
+            jobs->submit(std::move(job), priority);
+            return;
+        }
+
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        if (loaderPool == nullptr)
+            loaderPool = std::make_unique<celestia::util::ThreadPool>(loaderThreads);
+        loaderPool->submit(std::move(job));
+    }
+
+    bool startAsyncLoad(ResourceHandle h)
+    {
+        if (loaderThreads == 0)
+            return false;
+
+        // Another handle may resolve to a file which is already loading
+        for (const auto& load : pendingLoads)
+        {
+            if (load->name == resources[h].resolvedName)
+            {
+                load->handles.push_back(h);
+                resources[h].state = ResourceLoading;
+                return true;
+            }
+        }
+
+        auto loader = resources[h].asyncLoader(resources[h].resolvedName);
+        if (loader == nullptr)
+            return false;
+
+        auto load = std::make_shared<AsyncLoad>();
+        load->name = resources[h].resolvedName;
+        load->loader = std::move(loader);
+        load->handles.push_back(h);
+        pendingLoads.push_back(load);
+        resources[h].state = ResourceLoading;
+
+        // Reduced versions of all of the pending loads are decoded before
+        // the full ones
+        submitLoad([this, load]
+        {
+            load->succeeded = load->loader->decode();
+            bool refinable = load->succeeded && load->loader->refinable();
+            load->decoded.store(true, std::memory_order_release);
+            if (!refinable)
+                return;
+
+            submitLoad([load]
+            {
+                load->refineSucceeded = load->loader->decodeRefinement();
+                load->refined.store(true, std::memory_order_release);
+            }, celestia::util::JobPriority::Background);
+        }, celestia::util::JobPriority::Streaming);
+        return true;
+    }
 };
 
 #endif // _CELUTIL_RESMANAGER_H_
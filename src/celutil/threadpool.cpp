@@ -0,0 +1,119 @@
+// threadpool.cpp
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// Fixed-size pool of worker threads.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <utility>
+#include "threadpool.h"
+
+namespace celestia::util
+{
+
+ThreadPool::ThreadPool(unsigned int nThreads)
+{
+    if (nThreads == 0)
+        nThreads = hardwareThreads();
+
+    if (nThreads > 1)
+    {
+        m_threads.reserve(nThreads);
+        for (unsigned int i = 0; i < nThreads; ++i)
+            m_threads.emplace_back(&ThreadPool::worker, this);
+    }
+}
+
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_taskAvailable.notify_all();
+
+    for (auto& thread : m_threads)
+        thread.join();
+}
+
+
+unsigned int ThreadPool::size() const
+{
+    return m_threads.empty() ? 1 : static_cast<unsigned int>(m_threads.size());
+}
+
+
+unsigned int ThreadPool::hardwareThreads()
+{
+    unsigned int n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+
+void ThreadPool::submit(std::function<void()>&& task)
+{
+    if (m_threads.empty())
+    {
+        task();
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+        ++m_pending;
+    }
+    m_taskAvailable.notify_one();
+}
+
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_pending > 0)
+    {
+        if (!runOne(lock))
+            m_finished.wait(lock);
+    }
+}
+
+
+// Pop and run a single task with the mutex released. Returns false if the
+// queue was empty.
+bool ThreadPool::runOne(std::unique_lock<std::mutex>& lock)
+{
+    if (m_tasks.empty())
+        return false;
+
+    auto task = std::move(m_tasks.front());
+    m_tasks.pop_front();
+
+    lock.unlock();
+    task();
+    lock.lock();
+
+    if (--m_pending == 0)
+        m_finished.notify_all();
+
+    return true;
+}
+
+
+void ThreadPool::worker()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        m_taskAvailable.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+        if (m_stop && m_tasks.empty())
+            return;
+        runOne(lock);
+    }
+}
+
+} // end namespace celestia::util
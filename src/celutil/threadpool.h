@@ -0,0 +1,72 @@
+// threadpool.h
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// Fixed-size pool of worker threads.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace celestia::util
+{
+
+/**
+ * Runs tasks on a fixed number of worker threads. Tasks may submit further
+ * tasks; wait() returns once every task submitted so far, including those
+ * spawned by other tasks, has finished. Tasks must not call wait().
+ */
+class ThreadPool
+{
+ public:
+    /**
+     * Create a pool with nThreads workers. If nThreads is 0, one worker per
+     * hardware thread is created. A pool with a single worker runs tasks
+     * on the submitting thread.
+     */
+    explicit ThreadPool(unsigned int nThreads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Return the number of threads executing tasks.
+     */
+    unsigned int size() const;
+
+    void submit(std::function<void()>&& task);
+
+    /**
+     * Block until all submitted tasks are done. The calling thread runs
+     * queued tasks while it waits.
+     */
+    void wait();
+
+    static unsigned int hardwareThreads();
+
+ private:
+    void worker();
+    bool runOne(std::unique_lock<std::mutex>&);
+
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_taskAvailable;
+    std::condition_variable m_finished;
+    std::size_t m_pending{ 0 };
+    bool m_stop{ false };
+};
+
+} // end namespace celestia::util
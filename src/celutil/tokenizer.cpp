@@ -87,6 +87,42 @@ bool handleUtf8Error(std::string& s, UTF8Status status)
     GetLogger()->error("Token too long\n");
     return false;
 }
+
+
+bool parseNumber(std::string_view text, double& value)
+{
+    auto [p, ec] = celestia::compat::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec == std::errc())
+    {
+        if (p != text.data() + text.size())
+        {
+            GetLogger()->warn("Incomplete parsing of numeric token");
+        }
+        return true;
+    }
+
+    if (ec == std::errc::invalid_argument)
+    {
+        GetLogger()->error("Could not parse number\n");
+    }
+    else if (ec == std::errc::result_out_of_range)
+    {
+        GetLogger()->error("Number out of range\n");
+    }
+    else
+    {
+        GetLogger()->error("Unexpected error parsing number\n");
+    }
+    return false;
+}
+
+
+const char* skipDigits(const char* p, const char* end)
+{
+    while (p != end && std::isdigit(static_cast<unsigned char>(*p)))
+        ++p;
+    return p;
+}
 } // end unnamed namespace
 
 
@@ -97,6 +133,21 @@ Tokenizer::Tokenizer(std::istream* _in) :
 }
 
 
+Tokenizer::Tokenizer(std::string_view buffer) :
+    bufferPos(buffer.data()),
+    bufferEnd(buffer.data() + buffer.size())
+{
+    textToken.reserve(maxTokenLength);
+}
+
+
+Tokenizer::Tokenizer(const std::vector<RecordedToken>* _recorded) :
+    recorded(_recorded),
+    isStart(false)
+{
+}
+
+
 Tokenizer::TokenType Tokenizer::nextToken()
 {
     if (isPushedBack)
@@ -105,6 +156,22 @@ Tokenizer::TokenType Tokenizer::nextToken()
         return tokenType;
     }
 
+    if (recorded != nullptr)
+    {
+        if (recordedIndex == recorded->size())
+        {
+            tokenType = TokenEnd;
+            return tokenType;
+        }
+
+        const RecordedToken& token = (*recorded)[recordedIndex++];
+        tokenType = token.type;
+        tokenText = token.text;
+        tokenValue = token.value;
+        lineNumber = token.lineNumber;
+        return tokenType;
+    }
+
     if (isStart)
     {
         isStart = false;
@@ -115,6 +182,16 @@ Tokenizer::TokenType Tokenizer::nextToken()
         }
     }
 
+    // Most tokens in a buffer can be read without copying; the rest go
+    // through the character by character tokenizer below.
+    if (in == nullptr)
+    {
+        tokenValue = std::nan("");
+        tokenType = scanBuffer();
+        if (tokenType != TokenBegin)
+            return tokenType;
+    }
+
     UTF8Validator validator;
     textToken.clear();
     tokenValue = std::nan("");
@@ -135,18 +212,13 @@ Tokenizer::TokenType Tokenizer::nextToken()
         else
         {
             utf8Status = UTF8Status::Ok;
-            in->get(nextChar);
-            if (in->eof())
-            {
-                isEof = true;
-            }
-            else if (in->fail())
+            if (!readChar(isEof))
             {
                 GetLogger()->error("Unexpected error reading stream\n");
                 newToken = TokenError;
                 break;
             }
-            else
+            else if (!isEof)
             {
                 uNextChar = static_cast<unsigned char>(nextChar);
                 utf8Status = validator.check(uNextChar);
@@ -514,34 +586,163 @@ Tokenizer::TokenType Tokenizer::nextToken()
     if (newToken == TokenNumber)
     {
         double value;
-        auto [p, ec] = celestia::compat::from_chars(textToken.data(), textToken.data() + textToken.size(), value);
-        if (ec == std::errc())
-        {
+        if (parseNumber(textToken, value))
             tokenValue = value;
-            if (p != textToken.data() + textToken.size())
-            {
-                GetLogger()->warn("Incomplete parsing of numeric token");
-            }
+        else
+            newToken = TokenError;
+    }
+
+    tokenText = textToken;
+    tokenType = newToken;
+    return tokenType;
+}
+
+
+// Read the next token from the buffer without copying it. Returns
+// TokenBegin, with the buffer positioned at the start of the token, if the
+// token needs escape processing, UTF-8 or error handling.
+Tokenizer::TokenType Tokenizer::scanBuffer()
+{
+    if (reprocess)
+    {
+        // Whitespace was already counted when it was read
+        reprocess = false;
+        if (!std::isspace(static_cast<unsigned char>(nextChar)))
+            --bufferPos;
+    }
+
+    for (;;)
+    {
+        if (bufferPos == bufferEnd)
+        {
+            tokenText = std::string_view();
+            return TokenEnd;
         }
-        else if (ec == std::errc::invalid_argument)
+
+        char c = *bufferPos;
+        if (c == '\n')
         {
-            GetLogger()->error("Could not parse number\n");
-            newToken = TokenError;
+            ++lineNumber;
+            ++bufferPos;
         }
-        else if (ec == std::errc::result_out_of_range)
+        else if (std::isspace(static_cast<unsigned char>(c)))
         {
-            GetLogger()->error("Number out of range\n");
-            newToken = TokenError;
+            ++bufferPos;
+        }
+        else if (c == '#')
+        {
+            while (bufferPos != bufferEnd && *bufferPos != '\n' && *bufferPos != '\r')
+                ++bufferPos;
         }
         else
         {
-            GetLogger()->error("Unexpected error parsing number\n");
-            newToken = TokenError;
+            break;
         }
     }
 
-    tokenType = newToken;
-    return tokenType;
+    const char* start = bufferPos;
+    const char* p = start;
+    auto u = static_cast<unsigned char>(*p);
+    TokenType token = TokenBegin;
+
+    if (std::isdigit(u) || *p == '-' || *p == '+')
+    {
+        // The sign must be followed by a digit, numbers starting with a
+        // period get a leading zero from the slow path.
+        if (*p == '+')
+            start = ++p;
+        else if (*p == '-')
+            ++p;
+
+        if (p == bufferEnd || !std::isdigit(static_cast<unsigned char>(*p)))
+            return TokenBegin;
+        p = skipDigits(p, bufferEnd);
+        if (p != bufferEnd && *p == '.')
+            p = skipDigits(p + 1, bufferEnd);
+        if (p != bufferEnd && (*p == 'e' || *p == 'E'))
+        {
+            ++p;
+            if (p != bufferEnd && (*p == '+' || *p == '-'))
+                ++p;
+            if (p == bufferEnd || !std::isdigit(static_cast<unsigned char>(*p)))
+                return TokenBegin;
+            p = skipDigits(p, bufferEnd);
+        }
+        if (p != bufferEnd && !isSeparator(static_cast<unsigned char>(*p)))
+            return TokenBegin;
+
+        token = TokenNumber;
+    }
+    else if (std::isalpha(u) || *p == '_')
+    {
+        while (p != bufferEnd && (std::isalnum(static_cast<unsigned char>(*p)) || *p == '_'))
+            ++p;
+        token = TokenName;
+    }
+    else if (*p == '"')
+    {
+        start = ++p;
+        int line = lineNumber;
+        UTF8Validator validator;
+        for (;;)
+        {
+            if (p == bufferEnd || *p == '\\' || validator.check(*p) != UTF8Status::Ok)
+            {
+                lineNumber = line;
+                return TokenBegin;
+            }
+            if (*p == '"')
+                break;
+            if (*p == '\n')
+                ++lineNumber;
+            ++p;
+        }
+
+        if (static_cast<std::size_t>(p - start) > maxTokenLength)
+        {
+            lineNumber = line;
+            return TokenBegin;
+        }
+
+        tokenText = std::string_view(start, static_cast<std::size_t>(p - start));
+        bufferPos = p + 1;
+        return TokenString;
+    }
+    else
+    {
+        switch (*p)
+        {
+        case '{': token = TokenBeginGroup; break;
+        case '}': token = TokenEndGroup; break;
+        case '[': token = TokenBeginArray; break;
+        case ']': token = TokenEndArray; break;
+        case '=': token = TokenEquals; break;
+        case '|': token = TokenBar; break;
+        case '<': token = TokenBeginUnits; break;
+        case '>': token = TokenEndUnits; break;
+        default: return TokenBegin;
+        }
+
+        tokenText = std::string_view();
+        bufferPos = p + 1;
+        return token;
+    }
+
+    if (static_cast<std::size_t>(p - start) > maxTokenLength)
+        return TokenBegin;
+
+    tokenText = std::string_view(start, static_cast<std::size_t>(p - start));
+    if (token == TokenNumber && !parseNumber(tokenText, tokenValue))
+        token = TokenError;
+
+    // Like the stream tokenizer, count a newline ending the token now
+    if (p != bufferEnd && *p == '\n')
+    {
+        ++lineNumber;
+        ++p;
+    }
+    bufferPos = p;
+    return token;
 }
 
 
@@ -566,7 +767,7 @@ double Tokenizer::getNumberValue() const
 bool Tokenizer::isInteger() const
 {
     return tokenType == TokenNumber
-        && textToken.find_first_of(".eE") == std::string::npos
+        && tokenText.find_first_of(".eE") == std::string_view::npos
         && tokenValue >= INT32_MIN && tokenValue <= INT32_MAX;
 }
 
@@ -579,7 +780,7 @@ std::int32_t Tokenizer::getIntegerValue() const
 
 std::string_view Tokenizer::getStringValue() const
 {
-    return textToken;
+    return tokenText;
 }
 
 
@@ -589,12 +790,23 @@ int Tokenizer::getLineNumber() const
 }
 
 
+std::size_t Tokenizer::getRecordedIndex() const
+{
+    return recordedIndex - 1;
+}
+
+
 bool Tokenizer::skipUtf8Bom()
 {
     for (int i = 0; i < 3; ++i)
     {
-        in->get(nextChar);
-        if (in->eof())
+        bool isEof = false;
+        if (!readChar(isEof))
+        {
+            GetLogger()->error("Unexpected error reading stream\n");
+            return false;
+        }
+        else if (isEof)
         {
             if (i == 0)
             {
@@ -604,11 +816,6 @@ bool Tokenizer::skipUtf8Bom()
             GetLogger()->error("Incomplete UTF-8 sequence\n");
             return false;
         }
-        else if (in->fail())
-        {
-            GetLogger()->error("Unexpected error reading stream\n");
-            return false;
-        }
         else if (i == 0)
         {
             if (nextChar != '\357')
@@ -627,3 +834,21 @@ bool Tokenizer::skipUtf8Bom()
 
     return true;
 }
+
+
+// Read a character from the stream or the buffer. Returns false if the
+// stream can't be read.
+bool Tokenizer::readChar(bool& isEof)
+{
+    if (in == nullptr)
+    {
+        isEof = bufferPos == bufferEnd;
+        if (!isEof)
+            nextChar = *bufferPos++;
+        return true;
+    }
+
+    in->get(nextChar);
+    isEof = in->eof();
+    return isEof || !in->fail();
+}
@@ -15,6 +15,7 @@
 #include <iosfwd>
 #include <string>
 #include <string_view>
+#include <vector>
 
 class Tokenizer
 {
@@ -38,7 +39,22 @@ public:
         TokenEndUnits       = 14,
     };
 
+    // A token saved for replay by a tokenizer created from a token list
+    struct RecordedToken
+    {
+        TokenType type;
+        std::string text;
+        double value;
+        int lineNumber;
+    };
+
     Tokenizer(std::istream*);
+    // Read tokens from a buffer, typically a memory mapped file. Names,
+    // numbers and strings without escapes are returned as views into the
+    // buffer, which must outlive the tokenizer.
+    explicit Tokenizer(std::string_view buffer);
+    // Replay recorded tokens; the list must outlive the tokenizer
+    explicit Tokenizer(const std::vector<RecordedToken>*);
 
     TokenType nextToken();
     TokenType getTokenType() const;
@@ -50,12 +66,21 @@ public:
 
     int getLineNumber() const;
 
+    // Index of the current token in the recorded token list
+    std::size_t getRecordedIndex() const;
+
 private:
-    std::istream* in;
+    std::istream* in{ nullptr };
+    const char* bufferPos{ nullptr };
+    const char* bufferEnd{ nullptr };
+    const std::vector<RecordedToken>* recorded{ nullptr };
+    std::size_t recordedIndex{ 0 };
     TokenType tokenType{ TokenBegin };
     bool isStart{ true };
     bool isPushedBack{ false };
     std::string textToken{};
+    // Text of the current token, either textToken or part of the buffer
+    std::string_view tokenText{};
     double tokenValue{ std::nan("") };
     int lineNumber{ 1 };
     char nextChar{ '\0' };
@@ -63,4 +88,6 @@ private:
     bool hasUtf8Errors{ false };
 
     bool skipUtf8Bom();
+    bool readChar(bool& isEof);
+    TokenType scanBuffer();
 };
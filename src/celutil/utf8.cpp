@@ -498,6 +498,50 @@ int UTF8StringCompare(std::string_view s0, std::string_view s1)
         return 0;
 }
 
+//! Convert str to the form in which UTF8StringCompare() compares strings
+//! when ignoring case, so that a case-insensitive prefix of str becomes a
+//! byte prefix of dest. Conversion stops at the first invalid UTF-8
+//! sequence, in which case false is returned.
+bool UTF8FoldCase(std::string_view str, std::string &dest)
+{
+    dest.clear();
+    int len = str.length();
+    for (int i = 0; i < len;)
+    {
+        wchar_t ch = 0;
+        if (!UTF8Decode(str, i, ch))
+            return false;
+
+        i += UTF8EncodedSize(ch);
+        ch = UTF8Normalize(ch);
+        UTF8Encode(static_cast<std::uint32_t>(std::tolower(ch)), dest);
+    }
+    return true;
+}
+
+//! Convert str to the form in which UTF8StringCompare() compares strings,
+//! so that the strings it considers equal have the same normalized form and
+//! can be used as keys of a hash table. Returns false if str isn't valid
+//! UTF-8, in which case dest is a copy of str.
+bool UTF8Normalize(std::string_view str, std::string &dest)
+{
+    dest.clear();
+    int len = str.length();
+    for (int i = 0; i < len;)
+    {
+        wchar_t ch = 0;
+        if (!UTF8Decode(str, i, ch))
+        {
+            dest.assign(str);
+            return false;
+        }
+
+        i += UTF8EncodedSize(ch);
+        UTF8Encode(static_cast<std::uint32_t>(UTF8Normalize(ch)), dest);
+    }
+    return true;
+}
+
 int UTF8StringCompare(std::string_view s0, std::string_view s1, size_t n, bool ignoreCase)
 {
     int len0 = s0.length();
@@ -15,6 +15,7 @@
 #include <cmath>
 #include <algorithm>
 #include <map>
+#include <mutex>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -25,6 +26,7 @@
 #include <celmath/ray.h>
 #include <celmath/sphere.h>
 #include <celmath/intersect.h>
+#include <celutil/jobsystem.h>
 #include <zlib.h>
 #include <png.h>
 
@@ -34,6 +36,8 @@ using namespace celmath;
 
 using celestia::numbers::pi;
 
+namespace celutil = celestia::util;
+
 // Extinction lookup table dimensions
 constexpr const unsigned int ExtinctionLUTHeightSteps = 256;
 constexpr const unsigned int ExtinctionLUTViewAngleSteps = 512;
@@ -48,6 +52,7 @@ static unsigned int IntegrateScatterSteps = 20;
 static unsigned int IntegrateDepthSteps = 20;
 static unsigned int OutputImageWidth = 600;
 static unsigned int OutputImageHeight = 450;
+static unsigned int ThreadCount = 0;
 enum LUTUsageType
 {
     NoLUT,
@@ -384,6 +389,8 @@ void usage()
     cerr << "           set the number of integration steps for depth\n";
     cerr << "   --scattersteps <value> (or -s)\n";
     cerr << "           set the number of integration steps for scattering\n";
+    cerr << "   --threads <value>\n";
+    cerr << "           set the number of threads (default: all cores)\n";
 }
 
 
@@ -1037,34 +1044,37 @@ buildExtinctionLUT(const Scene& scene)
     //Sphered planet = Sphered(scene.planet.radius);
     Sphered shell = Sphered(scene.planet.radius + scene.atmosphereShellHeight);
 
-    for (unsigned int i = 0; i < ExtinctionLUTHeightSteps; i++)
+    celutil::ParallelFor(0, ExtinctionLUTHeightSteps, 1, [&](size_t first, size_t last)
     {
-        double h = (double) i / (double) (ExtinctionLUTHeightSteps - 1) *
-            scene.atmosphereShellHeight * 0.9999;
-        Vector3d atmStart = Vector3d::Zero() +
-            Vector3d::UnitX() * (h + scene.planet.radius);
-
-        for (unsigned int j = 0; j < ExtinctionLUTViewAngleSteps; j++)
+        for (auto i = static_cast<unsigned int>(first); i < last; i++)
         {
-            double cosAngle = (double) j / (ExtinctionLUTViewAngleSteps - 1) * 2.0 - 1.0;
-            double sinAngle = sqrt(1.0 - min(1.0, cosAngle * cosAngle));
-            Vector3d viewDir(cosAngle, sinAngle, 0.0);
+            double h = (double) i / (double) (ExtinctionLUTHeightSteps - 1) *
+                scene.atmosphereShellHeight * 0.9999;
+            Vector3d atmStart = Vector3d::Zero() +
+                Vector3d::UnitX() * (h + scene.planet.radius);
 
-            Eigen::ParametrizedLine<double, 3> ray(atmStart, viewDir);
-            double dist = 0.0;
+            for (unsigned int j = 0; j < ExtinctionLUTViewAngleSteps; j++)
+            {
+                double cosAngle = (double) j / (ExtinctionLUTViewAngleSteps - 1) * 2.0 - 1.0;
+                double sinAngle = sqrt(1.0 - min(1.0, cosAngle * cosAngle));
+                Vector3d viewDir(cosAngle, sinAngle, 0.0);
 
-            if (!testIntersection(ray, shell, dist))
-                dist = 0.0;
+                Eigen::ParametrizedLine<double, 3> ray(atmStart, viewDir);
+                double dist = 0.0;
 
-            OpticalDepths depth = integrateOpticalDepth(scene, atmStart,
-                                                        ray.pointAt(dist));
-            depth.rayleigh *= 4.0 * pi;
-            depth.mie      *= 4.0 * pi;
-            Vector3d ext = scene.atmosphere.computeExtinction(depth);
+                if (!testIntersection(ray, shell, dist))
+                    dist = 0.0;
 
-            lut->setValue(i, j, ext.cwiseMax(1.0e-18));
+                OpticalDepths depth = integrateOpticalDepth(scene, atmStart,
+                                                            ray.pointAt(dist));
+                depth.rayleigh *= 4.0 * pi;
+                depth.mie      *= 4.0 * pi;
+                Vector3d ext = scene.atmosphere.computeExtinction(depth);
+
+                lut->setValue(i, j, ext.cwiseMax(1.0e-18));
+            }
         }
-    }
+    });
 
     return lut;
 }
@@ -1097,33 +1107,36 @@ buildOpticalDepthLUT(const Scene& scene)
     //Sphered planet = Sphered(scene.planet.radius);
     Sphered shell = Sphered(scene.planet.radius + scene.atmosphereShellHeight);
 
-    for (unsigned int i = 0; i < ExtinctionLUTHeightSteps; i++)
+    celutil::ParallelFor(0, ExtinctionLUTHeightSteps, 1, [&](size_t first, size_t last)
     {
-        double h = (double) i / (double) (ExtinctionLUTHeightSteps - 1) *
-            scene.atmosphereShellHeight;
-        Vector3d atmStart = Vector3d::Zero() +
-            Vector3d::UnitX() * (h + scene.planet.radius);
-
-        for (unsigned int j = 0; j < ExtinctionLUTViewAngleSteps; j++)
+        for (auto i = static_cast<unsigned int>(first); i < last; i++)
         {
-            double cosAngle = (double) j / (ExtinctionLUTViewAngleSteps - 1) * 2.0 - 1.0;
-            double sinAngle = sqrt(1.0 - min(1.0, cosAngle * cosAngle));
-            Vector3d dir(cosAngle, sinAngle, 0.0);
+            double h = (double) i / (double) (ExtinctionLUTHeightSteps - 1) *
+                scene.atmosphereShellHeight;
+            Vector3d atmStart = Vector3d::Zero() +
+                Vector3d::UnitX() * (h + scene.planet.radius);
 
-            Eigen::ParametrizedLine<double, 3> ray(atmStart, dir);
-            double dist = 0.0;
+            for (unsigned int j = 0; j < ExtinctionLUTViewAngleSteps; j++)
+            {
+                double cosAngle = (double) j / (ExtinctionLUTViewAngleSteps - 1) * 2.0 - 1.0;
+                double sinAngle = sqrt(1.0 - min(1.0, cosAngle * cosAngle));
+                Vector3d dir(cosAngle, sinAngle, 0.0);
 
-            if (!testIntersection(ray, shell, dist))
-                dist = 0.0;
+                Eigen::ParametrizedLine<double, 3> ray(atmStart, dir);
+                double dist = 0.0;
 
-            OpticalDepths depth = integrateOpticalDepth(scene, atmStart,
-                                                        ray.pointAt(dist));
-            depth.rayleigh *= 4.0 * pi;
-            depth.mie      *= 4.0 * pi;
+                if (!testIntersection(ray, shell, dist))
+                    dist = 0.0;
 
-            lut->setValue(i, j, Vector3d(depth.rayleigh, depth.mie, depth.absorption));
+                OpticalDepths depth = integrateOpticalDepth(scene, atmStart,
+                                                            ray.pointAt(dist));
+                depth.rayleigh *= 4.0 * pi;
+                depth.mie      *= 4.0 * pi;
+
+                lut->setValue(i, j, Vector3d(depth.rayleigh, depth.mie, depth.absorption));
+            }
         }
-    }
+    });
 
     return lut;
 }
@@ -1314,48 +1327,51 @@ buildScatteringLUT(const Scene& scene)
 
     Sphered shell = Sphered(scene.planet.radius + scene.atmosphereShellHeight);
 
-    for (unsigned int i = 0; i < ScatteringLUTHeightSteps; i++)
+    celutil::ParallelFor(0, ScatteringLUTHeightSteps, 1, [&](size_t first, size_t last)
     {
-        double h = (double) i / (double) (ScatteringLUTHeightSteps - 1) *
-            scene.atmosphereShellHeight * 0.9999;
-        Vector3d atmStart = Vector3d::Zero() +
-            Vector3d::UnitX() * (h + scene.planet.radius);
-
-        for (unsigned int j = 0; j < ScatteringLUTViewAngleSteps; j++)
+        for (auto i = static_cast<unsigned int>(first); i < last; i++)
         {
-            double cosAngle = unpackSNorm((double) j / (ScatteringLUTViewAngleSteps - 1));
-            double sinAngle = sqrt(1.0 - min(1.0, cosAngle * cosAngle));
-            Vector3d viewDir(cosAngle, sinAngle, 0.0);
+            double h = (double) i / (double) (ScatteringLUTHeightSteps - 1) *
+                scene.atmosphereShellHeight * 0.9999;
+            Vector3d atmStart = Vector3d::Zero() +
+                Vector3d::UnitX() * (h + scene.planet.radius);
 
-            Eigen::ParametrizedLine<double, 3> viewRay(atmStart, viewDir);
-            double dist = 0.0;
-            if (!testIntersection(viewRay, shell, dist))
-                dist = 0.0;
+            for (unsigned int j = 0; j < ScatteringLUTViewAngleSteps; j++)
+            {
+                double cosAngle = unpackSNorm((double) j / (ScatteringLUTViewAngleSteps - 1));
+                double sinAngle = sqrt(1.0 - min(1.0, cosAngle * cosAngle));
+                Vector3d viewDir(cosAngle, sinAngle, 0.0);
 
-            Vector3d atmEnd = viewRay.pointAt(dist);
+                Eigen::ParametrizedLine<double, 3> viewRay(atmStart, viewDir);
+                double dist = 0.0;
+                if (!testIntersection(viewRay, shell, dist))
+                    dist = 0.0;
 
-            for (unsigned int k = 0; k < ScatteringLUTLightAngleSteps; k++)
-            {
-                double cosLightAngle = unpackSNorm((double) k / (ScatteringLUTLightAngleSteps - 1));
-                double sinLightAngle = sqrt(1.0 - min(1.0, cosLightAngle * cosLightAngle));
-                Vector3d lightDir(cosLightAngle, sinLightAngle, 0.0);
+                Vector3d atmEnd = viewRay.pointAt(dist);
 
-#if 0
-                Vector4d inscatter = integrateInscatteringFactors_LUT(scene,
+                for (unsigned int k = 0; k < ScatteringLUTLightAngleSteps; k++)
+                {
+                    double cosLightAngle = unpackSNorm((double) k / (ScatteringLUTLightAngleSteps - 1));
+                    double sinLightAngle = sqrt(1.0 - min(1.0, cosLightAngle * cosLightAngle));
+                    Vector3d lightDir(cosLightAngle, sinLightAngle, 0.0);
+
+    #if 0
+                    Vector4d inscatter = integrateInscatteringFactors_LUT(scene,
+                                                                       atmStart,
+                                                                       atmEnd,
+                                                                       lightDir,
+                                                                       true);
+    #else
+                    Vector4d inscatter = integrateInscatteringFactors(scene,
                                                                    atmStart,
                                                                    atmEnd,
-                                                                   lightDir,
-                                                                   true);
-#else
-                Vector4d inscatter = integrateInscatteringFactors(scene,
-                                                               atmStart,
-                                                               atmEnd,
-                                                               lightDir);
-#endif
-                lut->setValue(i, j, k, inscatter);
+                                                                   lightDir);
+    #endif
+                    lut->setValue(i, j, k, inscatter);
+                }
             }
         }
-    }
+    });
 
     return lut;
 }
@@ -1607,33 +1623,42 @@ void render(const Scene& scene,
     unsigned int bottom = min(image.height, viewport.y + viewport.height);
 
     cout << "Rendering " << viewport.width << "x" << viewport.height << " view" << endl;
-    for (unsigned int i = viewport.y; i < bottom; i++)
-    {
-        unsigned int row = i - viewport.y;
-        if (row % 50 == 49)
-            cout << row + 1 << endl;
-        else if (row % 10 == 0)
-            cout << ".";
 
-        for (unsigned int j = viewport.x; j < right; j++)
+    // Rows are rendered in parallel; the progress shows the number of rows
+    // completed rather than the current one
+    std::mutex progressMutex;
+    unsigned int rowsDone = 0;
+    celutil::ParallelFor(viewport.y, bottom, 1, [&](size_t first, size_t last)
+    {
+        for (auto i = static_cast<unsigned int>(first); i < last; i++)
         {
-            double viewportX = ((double) (j - viewport.x) / (double) (viewport.width - 1) - 0.5) * aspectRatio;
-            double viewportY ((double) (i - viewport.y) / (double) (viewport.height - 1) - 0.5);
+            for (unsigned int j = viewport.x; j < right; j++)
+            {
+                double viewportX = ((double) (j - viewport.x) / (double) (viewport.width - 1) - 0.5) * aspectRatio;
+                double viewportY ((double) (i - viewport.y) / (double) (viewport.height - 1) - 0.5);
 
-            Eigen::ParametrizedLine<double, 3> viewRay = camera.getViewRay(viewportX, viewportY);
+                Eigen::ParametrizedLine<double, 3> viewRay = camera.getViewRay(viewportX, viewportY);
 
-            Color color;
-            if (LUTUsage != NoLUT)
-                color = scene.raytrace_LUT(viewRay);
-            else
-                color = scene.raytrace(viewRay);
+                Color color;
+                if (LUTUsage != NoLUT)
+                    color = scene.raytrace_LUT(viewRay);
+                else
+                    color = scene.raytrace(viewRay);
+
+                if (CameraExposure != 0.0)
+                    color = color.exposure((float) CameraExposure);
 
-            if (CameraExposure != 0.0)
-                color = color.exposure((float) CameraExposure);
+                image.setPixel(j, i, color);
+            }
 
-            image.setPixel(j, i, color);
+            std::scoped_lock lock(progressMutex);
+            unsigned int row = rowsDone++;
+            if (row % 50 == 49)
+                cout << row + 1 << endl;
+            else if (row % 10 == 0)
+                cout << "." << flush;
         }
-    }
+    });
     cout << endl << "Complete" << endl;
 }
 
@@ -1881,6 +1906,15 @@ bool parseCommandLine(int argc, char* argv[])
                     return false;
                 i++;
             }
+            else if (!strcmp(argv[i], "--threads"))
+            {
+                if (i == argc - 1)
+                    return false;
+
+                if (sscanf(argv[i + 1], " %u", &ThreadCount) != 1)
+                    return false;
+                i++;
+            }
             else if (!strcmp(argv[i], "-i") || !strcmp(argv[i], "--image"))
             {
                 if (i == argc - 1)
@@ -1953,6 +1987,8 @@ int main(int argc, char* argv[])
 
     scene.setParameters(sceneParams);
 
+    celutil::CreateJobSystem(ThreadCount);
+
     cout << "atmosphere height: " << scene.atmosphereShellHeight << '\n';
     cout << "attenuation coeffs: " << scene.atmosphere.rayleighCoeff.transpose() * 4 * pi << '\n';
 
@@ -2053,6 +2089,8 @@ int main(int argc, char* argv[])
         render(scene, cameraSurface, botright, image);
     }
 
+    celutil::DestroyJobSystem();
+
     WritePNG(outputImageName, image);
 
     exit(0);
@@ -42,13 +42,17 @@
 #include <algorithm>
 #include <map>
 #include <cassert>
+#include <cstring>
 #include <Eigen/Core>
 #include <celmath/mathlib.h>
+#include <celutil/jobsystem.h>
 
 using namespace Eigen;
 using namespace std;
 using namespace celmath;
 
+namespace celutil = celestia::util;
+
 
 constexpr const unsigned int HeightSamples = 32;
 constexpr const unsigned int ViewAngleSamples = 256;
@@ -56,6 +60,7 @@ constexpr const unsigned int SunAngleSamples = 32;
 
 // Values settable via the command line
 static unsigned int ScatteringIntegrationSteps = 25;
+static unsigned int ThreadCount = 0;
 
 typedef map<string, double> ParameterSet;
 
@@ -106,29 +111,37 @@ public:
 //     - pathLength is the distance that the ray travels through the atmosphere
 //     - H is the scale height
 //     - R is the planet radius
-float opticalDepth(float r, float mu, float l, float H, float R)
-{
-    float a = sqrt(r * 0.5 / H);
-    float bx = a * mu;
-    float by = a * (mu + l / r);
-    float sbx = sign(bx);
-    float sby = sign(by);
-    float x = sby > sbx ? exp(bx * bx) : 0.0f;
-    float yx = sbx / (2.3193f * abs(bx) + sqrt(1.52f * bx * bx + 4.0f));
-    float yy = sby / (2.3193f * abs(by) + sqrt(1.52f * by * by + 4.0f)) *
-        exp(-l / H * (l / (2.0f * r) + mu));
-
-    return sqrt(6.2831f * H * r) * exp((R - r) / H) * (x + yx - yy);
+// The depths of many paths are computed at once, which Eigen vectorizes.
+ArrayXf opticalDepth(const ArrayXf& r, const ArrayXf& mu, const ArrayXf& l, float H, float R)
+{
+    ArrayXf a = (r * (0.5f / H)).sqrt();
+    ArrayXf bx = a * mu;
+    ArrayXf by = a * (mu + l / r);
+    ArrayXf sbx = bx.sign();
+    ArrayXf sby = by.sign();
+    ArrayXf x = (sby > sbx).select((bx * bx).exp(), 0.0f);
+    ArrayXf yx = sbx / (2.3193f * bx.abs() + (1.52f * bx * bx + 4.0f).sqrt());
+    ArrayXf yy = sby / (2.3193f * by.abs() + (1.52f * by * by + 4.0f).sqrt()) *
+        (-l / H * (l / (2.0f * r) + mu)).exp();
+
+    return (6.2831f * H * r).sqrt() * ((R - r) / H).exp() * (x + yx - yy);
 }
 
 
-Vector3f transmittance(float r, float mu, float l, const Atmosphere& atm)
+// Transmittance along paths, with one column per path
+Array3Xf transmittance(const ArrayXf& r, const ArrayXf& mu, const ArrayXf& l, const Atmosphere& atm)
 {
-    float depthR = opticalDepth(r, mu, l, atm.rayleighScaleHeight, atm.planetRadius);
-    float depthM = opticalDepth(r, mu, l, atm.mieScaleHeight, atm.planetRadius);
-    return (-depthR * atm.rayleighCoeff
-            - depthM * Vector3f::Constant(atm.mieCoeff)
-            - depthM * atm.absorptionCoeff).array().exp();
+    ArrayXf depthR = opticalDepth(r, mu, l, atm.rayleighScaleHeight, atm.planetRadius);
+    ArrayXf depthM = opticalDepth(r, mu, l, atm.mieScaleHeight, atm.planetRadius);
+
+    Array3Xf t(3, r.size());
+    for (int c = 0; c < 3; ++c)
+    {
+        t.row(c) = (-depthR * atm.rayleighCoeff[c]
+                    - depthM * atm.mieCoeff
+                    - depthM * atm.absorptionCoeff[c]).exp().transpose();
+    }
+    return t;
 }
 
 
@@ -174,6 +187,9 @@ Atmosphere::computeTransmittanceTable() const
     // position just *above* the planet surface.
     float baseHeight = Rg * 1.0e-6f;
 
+    ArrayXf rs(ViewAngleSamples);
+    ArrayXf mus(ViewAngleSamples);
+    ArrayXf pathLengths(ViewAngleSamples);
     for (unsigned int i = 0; i < HeightSamples; ++i)
     {
         float v = float(i) / float(HeightSamples);
@@ -199,15 +215,24 @@ Atmosphere::computeTransmittanceTable() const
                 pathLength = -r * cosTheta + sqrt(Rt2 - r2 * sinTheta2);
             }
 
+            rs[j] = r;
+            mus[j] = mu;
+            pathLengths[j] = pathLength;
+        }
+
+        // The transmittance of a whole row of view angles at once
+        Array3Xf t = transmittance(rs, mus, pathLengths, *this);
+        for (unsigned int j = 0; j < ViewAngleSamples; ++j)
+        {
             unsigned int index = i * ViewAngleSamples + j;
-            transmittanceTable[index] = transmittance(r, mu, pathLength, *this);
+            transmittanceTable[index] = t.col(j).matrix();
 
             // Warning messages
             if (isnan(transmittanceTable[index].x()))
             {
                 cout << "NaN in transmittance table at (" << j << ", " << i << ")\n";
                 cout << transmittanceTable[index].x() << endl;
-                cout << "r=" << r << ", mu=" << mu << ", l=" << pathLength << endl;
+                cout << "r=" << rs[j] << ", mu=" << mus[j] << ", l=" << pathLengths[j] << endl;
                 exit(1);
             }
 
@@ -245,21 +270,32 @@ Atmosphere::computeInscatterTable() const
     {
         float w = float(i) / float(HeightSamples);
         float h = w * w * (Rt - Rg) + baseHeight;
-        float r = Rg + h;
-        float r2 = r * r;
-
         cout << "layer " << i << ", height=" << h << "km\n";
+    }
 
-        Vector2f eye(0.0f, r);
+    auto steps = static_cast<Eigen::Index>(ScatteringIntegrationSteps);
+    ArrayXf stepIndices = ArrayXf::LinSpaced(steps, 0.0f, float(steps - 1));
 
-        for (unsigned int j = 0; j < ViewAngleSamples; ++j)
+    // Each job integrates the rays from viewpoints at a range of heights
+    // and view angles, through all the sun angles
+    celutil::ParallelFor(0, HeightSamples * ViewAngleSamples, ViewAngleSamples / 8,
+                         [&](size_t first, size_t last)
+    {
+        for (size_t cell = first; cell < last; ++cell)
         {
+            auto i = static_cast<unsigned int>(cell / ViewAngleSamples);
+            auto j = static_cast<unsigned int>(cell % ViewAngleSamples);
+
+            float w = float(i) / float(HeightSamples);
+            float h = w * w * (Rt - Rg) + baseHeight;
+            float r = Rg + h;
+            float r2 = r * r;
+
             float v = float(j) / float(ViewAngleSamples - 1);
             float mu = max(-1.0f, min(1.0f, toMu(v)));
             float cosTheta = mu;
             float sinTheta2 = 1.0f - cosTheta * cosTheta;
             float sinTheta = sqrt(sinTheta2);
-            Vector2f view(sinTheta, cosTheta);
 
             float pathLength;
             float d = Rg2 - r2 * sinTheta2;
@@ -274,79 +310,67 @@ Atmosphere::computeInscatterTable() const
                 pathLength = -r * cosTheta + sqrt(Rt2 - r2 * sinTheta2);
             }
 
+            float stepLength = pathLength / float(ScatteringIntegrationSteps);
+
+            // The sample points along the ray from the eye at (0, r) don't
+            // depend on the sun angle, nor does the transmittance along the
+            // path to the viewer
+            ArrayXf distanceToViewer = stepIndices * stepLength;
+            ArrayXf x = distanceToViewer * sinTheta;
+            ArrayXf y = r + distanceToViewer * cosTheta;
+            ArrayXf rx2 = x.square() + y.square();
+            ArrayXf rx = rx2.sqrt();
+            Array3Xf viewPathTransmittance = transmittance(ArrayXf::Constant(steps, r),
+                                                           ArrayXf::Constant(steps, mu),
+                                                           distanceToViewer,
+                                                           *this);
+
+            ArrayXf hx = rx - Rg;
+            VectorXf rayleighWeights = ((-hx / rayleighScaleHeight).exp() * stepLength).matrix();
+            VectorXf mieWeights = ((-hx / mieScaleHeight).exp() * stepLength).matrix();
+
             for (unsigned int k = 0; k < SunAngleSamples; ++k)
             {
-                float w = float(k) / float(SunAngleSamples - 1);
-                float muS = toMuS(w);
+                float u = float(k) / float(SunAngleSamples - 1);
+                float muS = toMuS(u);
                 float cosPhi = muS;
                 float sinPhi = sqrt(max(0.0f, 1.0f - cosPhi * cosPhi));
-                Vector2f sun(sinPhi, cosPhi);
-
-                float stepLength = pathLength / float(ScatteringIntegrationSteps);
-                Vector2f step = view * stepLength;
-
-                Vector3f rayleigh = Vector3f::Zero();
-                float mie = 0.0f;
-
-                for (unsigned int m = 0; m < ScatteringIntegrationSteps; ++m)
-                {
-                    Vector2f x = eye + step * m;
-                    float distanceToViewer = stepLength * m;
-                    float rx2 = x.squaredNorm();
-                    float rx = sqrt(rx2);
-
-                    // Compute the transmittance along the path to the viewer
-                    Vector3f viewPathTransmittance = transmittance(r, mu, distanceToViewer, *this);
-
-                    // Compute the cosine and sine of the angle between the
-                    // sun direction and zenith at the current sample.
-                    float c = x.dot(sun) / rx;
-                    float s2 = 1.0f - c * c;
-
-                    // Compute the transmittance along the path to the sun
-                    // and the total transmittance t.
-                    Vector3f t;
-                    if (Rg2 - rx2 * s2 < 0.0f || -rx * c - sqrt(Rg2 - rx2 * s2) < 0.0f)
-                    {
-                        // Compute the distance through the atmosphere
-                        // in the direction of the sun
-                        float sunPathLength = -rx * c + sqrt(Rt2 - rx2 * s2);
-                        Vector3f sunPathTransmittance = transmittance(rx, c, sunPathLength, *this);
-
-                        t = viewPathTransmittance.cwiseProduct(sunPathTransmittance);
-                    }
-                    else
-                    {
-                        // Ray to sun intersects the planet; no inscattered
-                        // light at this point.
-                        t = Vector3f::Zero();
-                    }
-
-                    // Accumulate Rayleigh and Mie scattering
-                    float hx = rx - Rg;
-                    rayleigh += (exp(-hx / rayleighScaleHeight) * stepLength) * t;
-                    mie += exp(-hx / mieScaleHeight) * stepLength * t.x();
-                }
+
+                // Compute the cosine and sine of the angle between the
+                // sun direction and zenith at the samples.
+                ArrayXf c = (x * sinPhi + y * cosPhi) / rx;
+                ArrayXf s2 = 1.0f - c * c;
+
+                // Compute the transmittance along the path to the sun
+                // and the total transmittance t. Where the ray to the sun
+                // intersects the planet, there's no inscattered light.
+                ArrayXf d2 = Rg2 - rx2 * s2;
+                auto lit = (d2 < 0.0f || -rx * c - d2.sqrt() < 0.0f).eval();
+                ArrayXf sunPathLength = -rx * c + (Rt2 - rx2 * s2).sqrt();
+                Array3Xf t = viewPathTransmittance * transmittance(rx, c, sunPathLength, *this);
+                for (int channel = 0; channel < 3; ++channel)
+                    t.row(channel) = lit.transpose().select(t.row(channel), 0.0f);
+
+                // Accumulate Rayleigh and Mie scattering
+                Vector3f rayleigh = t.matrix() * rayleighWeights;
+                float mie = t.row(0).matrix().dot(mieWeights.transpose());
 
                 unsigned int index = (i * ViewAngleSamples + j) * SunAngleSamples + k;
                 inscatter[index] << rayleigh.cwiseProduct(rayleighCoeff),
                                     mie * mieCoeff;
-                if (i == HeightSamples - 1 && k == 0)
-                {
-                    cout << acos(muS) * 180.0/M_PI << ", "
-                         << acos(mu) * 180.0/M_PI << ", "
-                         << inscatter[index].transpose() << endl;
-                }
-
-#if 0
-                // Emit warnings about NaNs in scatter table
-                if (isnan(rayleigh.x()))
-                {
-                    cout << "NaN in inscatter table at (" << k << ", " << j << ", " << i << ")\n";
-                }
-#endif
             }
         }
+    });
+
+    for (unsigned int j = 0; j < ViewAngleSamples; ++j)
+    {
+        float v = float(j) / float(ViewAngleSamples - 1);
+        float mu = max(-1.0f, min(1.0f, toMu(v)));
+        float muS = toMuS(0.0f);
+        unsigned int index = ((HeightSamples - 1) * ViewAngleSamples + j) * SunAngleSamples;
+        cout << acos(muS) * 180.0/M_PI << ", "
+             << acos(mu) * 180.0/M_PI << ", "
+             << inscatter[index].transpose() << endl;
     }
 
     return inscatter;
@@ -361,6 +385,8 @@ void usage()
     cerr << "           (default is out.atm)\n";
     cerr << "   --scattersteps <value> (or -s)\n";
     cerr << "           set the number of integration steps for scattering\n";
+    cerr << "   --threads <value>\n";
+    cerr << "           set the number of threads (default: all cores)\n";
 }
 
 
@@ -400,6 +426,8 @@ void SetAtmosphereParameters(Atmosphere& atm, ParameterSet& params)
     atm.absorptionCoeff.y()   = params["AbsorbGreen"];
     atm.absorptionCoeff.z()   = params["AbsorbBlue"];
 
+    atm.mieAsymmetry          = params["MieAsymmetry"];
+
     atm.planetRadius          = params["Radius"];
 }
 
@@ -418,6 +446,7 @@ void SetDefaultParameters(ParameterSet& params)
 
     params["MieScaleHeight"]      = 1.2;
     params["Mie"]                 = 2.1e-6f * km;
+    params["MieAsymmetry"]        = 0.0;
 
     params["AbsorbRed"]           = 0.0;
     params["AbsorbGreen"]         = 0.0;
@@ -483,6 +512,15 @@ bool parseCommandLine(int argc, char* argv[])
                     return false;
                 i++;
             }
+            else if (!strcmp(argv[i], "--threads"))
+            {
+                if (i == argc - 1)
+                    return false;
+
+                if (sscanf(argv[i + 1], " %u", &ThreadCount) != 1)
+                    return false;
+                i++;
+            }
             else if (!strcmp(argv[i], "-o") || !strcmp(argv[i], "--output"))
             {
                 if (i == argc - 1)
@@ -753,7 +791,6 @@ static void WriteUint32(ostream& out, uint32_t u)
 }
 
 
-#if 0
 // Write out a single precision floating point number
 static void WriteFloat(ostream& out, float f)
 {
@@ -769,7 +806,6 @@ static void WriteFloat(ostream& out, float f)
 
     out.write(ub.bytes, sizeof(ub.bytes));
 }
-#endif
 
 
 // Convert a single precision floating point value to half precision
@@ -904,12 +940,14 @@ int main(int argc, char* argv[])
     cout << "Generating inscatter table (" << SunAngleSamples << "x"
          << ViewAngleSamples << "x" << HeightSamples << ")...\n";
 
+    celutil::CreateJobSystem(ThreadCount);
     Vector4f* inscatterTable = atmosphere.computeInscatterTable();
+    celutil::DestroyJobSystem();
 
     ByteSwapRequired = !IsLittleEndian();
 
-#if 0
-    // Write tables in a single file
+    // Write tables in a single file, which is loaded by Celestia when an
+    // atmosphere has a ScatteringTable
     ofstream out(OutputFileName, ostream::binary);
 
     // Header
@@ -962,8 +1000,8 @@ int main(int argc, char* argv[])
     }
 
     out.close();
-#else
-    // Write tables as separate DDS files
+
+    // Also write tables as separate DDS files
     ofstream transmittanceOut("transmittance.dds", ostream::binary);
     WriteTransmittanceTableDDS(transmittanceOut, transmittanceTable);
     transmittanceOut.close();
@@ -971,7 +1009,6 @@ int main(int argc, char* argv[])
     ofstream inscatterOut("inscatter.dds", ostream::binary);
     WriteInscatterTableDDS(inscatterOut, inscatterTable);
     inscatterOut.close();
-#endif
 
     return 0;
 }
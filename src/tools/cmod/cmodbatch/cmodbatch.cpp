@@ -0,0 +1,294 @@
+// cmodbatch.cpp
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Convert all of the 3DS, Wavefront and cmod models in a directory tree
+// to optimized binary cmod files, several models at a time.
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <cel3ds/3dsread.h>
+#include <celcompat/filesystem.h>
+#include <celmath/mathlib.h>
+#include <celmodel/mesh.h>
+#include <celmodel/model.h>
+#include <celmodel/modelfile.h>
+#include <celutil/filetype.h>
+#include <celutil/jobsystem.h>
+#include <celutil/logger.h>
+#include <celutil/stringutils.h>
+
+#include "cmodops.h"
+#include "convert3ds.h"
+#include "convertobj.h"
+#include "pathmanager.h"
+
+namespace celutil = celestia::util;
+
+
+namespace
+{
+
+fs::path inputDirectory;
+fs::path outputDirectory;
+float smoothAngle = 45.0f;
+bool force = false;
+unsigned int nThreads = 0;
+
+// Positions closer than this, relative to their size, are welded together
+// when generating normals
+constexpr float WeldTolerance = 1.0e-6f;
+
+
+struct Conversion
+{
+    fs::path input;
+    fs::path output;
+    std::string error;
+};
+
+
+void usage()
+{
+    std::cerr << "Usage: cmodbatch [options] <input directory> <output directory>\n";
+    std::cerr << "   --smooth (or -s) <angle> : smoothing angle for generated normals (default 45)\n";
+    std::cerr << "   --threads (or -j) <n>    : number of models converted at a time (default: all cores)\n";
+    std::cerr << "   --force (or -f)          : convert models even when the output is newer\n";
+}
+
+
+bool parseCommandLine(int argc, char* argv[])
+{
+    int fileCount = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (argv[i][0] == '-')
+        {
+            if (!std::strcmp(argv[i], "-f") || !std::strcmp(argv[i], "--force"))
+            {
+                force = true;
+            }
+            else if (!std::strcmp(argv[i], "-s") || !std::strcmp(argv[i], "--smooth"))
+            {
+                if (i == argc - 1 || std::sscanf(argv[i + 1], " %f", &smoothAngle) != 1)
+                    return false;
+                i++;
+            }
+            else if (!std::strcmp(argv[i], "-j") || !std::strcmp(argv[i], "--threads"))
+            {
+                if (i == argc - 1 || std::sscanf(argv[i + 1], " %u", &nThreads) != 1)
+                    return false;
+                i++;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        else if (fileCount == 0)
+        {
+            inputDirectory = argv[i];
+            fileCount++;
+        }
+        else if (fileCount == 1)
+        {
+            outputDirectory = argv[i];
+            fileCount++;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return fileCount == 2;
+}
+
+
+bool isWavefrontFile(const fs::path& path)
+{
+    return compareIgnoringCase(path.extension().string(), ".obj") == 0;
+}
+
+
+bool hasNormals(const cmod::Model& model)
+{
+    for (unsigned int i = 0; model.getMesh(i) != nullptr; i++)
+    {
+        const cmod::VertexDescription& desc = model.getMesh(i)->getVertexDescription();
+        if (desc.getAttribute(cmod::VertexAttributeSemantic::Normal).format != cmod::VertexAttributeFormat::Float3)
+            return false;
+    }
+    return true;
+}
+
+
+std::unique_ptr<cmod::Model>
+loadModel(const fs::path& path, PathManager& pathManager, std::string& error)
+{
+    if (isWavefrontFile(path))
+    {
+        std::ifstream in(path, std::ios::in);
+        if (!in.good())
+        {
+            error = "error opening file";
+            return nullptr;
+        }
+
+        WavefrontLoader loader(in);
+        std::unique_ptr<cmod::Model> model = loader.load();
+        if (model == nullptr)
+            error = loader.errorMessage();
+        return model;
+    }
+
+    if (DetermineFileType(path) == Content_3DStudio)
+    {
+        std::unique_ptr<M3DScene> scene = Read3DSFile(path);
+        if (scene == nullptr)
+        {
+            error = "error reading 3DS file";
+            return nullptr;
+        }
+
+        std::unique_ptr<cmod::Model> model = Convert3DSModel(*scene, pathManager.getHandle);
+        if (model == nullptr)
+            error = "error converting 3DS file";
+        return model;
+    }
+
+    std::unique_ptr<cmod::Model> model = cmod::LoadModel(path, pathManager.getHandle);
+    if (model == nullptr)
+        error = "error reading cmod file";
+    return model;
+}
+
+
+// Load, optimize and save one model; the model and its texture names are
+// private to the call, so any number of them can run at a time.
+void convert(Conversion& conversion)
+{
+    PathManager pathManager;
+    std::unique_ptr<cmod::Model> model = loadModel(conversion.input, pathManager, conversion.error);
+    if (model == nullptr)
+        return;
+
+    // 3DS files never have normals; the others only get new ones if a mesh
+    // lacks them
+    if (DetermineFileType(conversion.input) == Content_3DStudio || !hasNormals(*model))
+    {
+        model = GenerateModelNormals(*model, celmath::degToRad(smoothAngle), true, WeldTolerance);
+        if (model == nullptr)
+        {
+            conversion.error = "error generating normals";
+            return;
+        }
+    }
+
+    for (unsigned int i = 0; model->getMesh(i) != nullptr; i++)
+        UniquifyVertices(*model->getMesh(i));
+
+    // The same vertex cache and overdraw optimization that's applied when
+    // Celestia loads a model, so that it's done once here
+    model->optimizeMeshes();
+
+    std::error_code ec;
+    fs::create_directories(conversion.output.parent_path(), ec);
+    std::ofstream out(conversion.output, std::ios::out | std::ios::binary);
+    if (!out.good() || !SaveModelBinary(model.get(), out, pathManager.getSource))
+    {
+        conversion.error = "error writing " + conversion.output.string();
+        out.close();
+        fs::remove(conversion.output, ec);
+    }
+}
+
+
+bool isUpToDate(const Conversion& conversion)
+{
+    std::error_code ec;
+    auto outputTime = fs::last_write_time(conversion.output, ec);
+    if (ec)
+        return false;
+    auto inputTime = fs::last_write_time(conversion.input, ec);
+    return !ec && outputTime >= inputTime;
+}
+
+} // end unnamed namespace
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        usage();
+        return 1;
+    }
+
+    celutil::CreateLogger();
+
+    std::error_code ec;
+    std::vector<Conversion> conversions;
+    unsigned int upToDate = 0;
+    for (auto it = fs::recursive_directory_iterator(inputDirectory, ec); !ec && it != fs::end(it); it.increment(ec))
+    {
+        const fs::path& path = it->path();
+        if (!fs::is_regular_file(path, ec))
+            continue;
+
+        ContentType type = DetermineFileType(path);
+        if (type != Content_3DStudio && type != Content_CelestiaModel && !isWavefrontFile(path))
+            continue;
+
+        Conversion conversion;
+        conversion.input = path;
+        conversion.output = outputDirectory / fs::relative(path, inputDirectory, ec);
+        conversion.output.replace_extension(".cmod");
+        if (!force && isUpToDate(conversion))
+            upToDate++;
+        else
+            conversions.push_back(std::move(conversion));
+    }
+
+    if (ec)
+    {
+        std::cerr << "Error reading directory " << inputDirectory << ": " << ec.message() << '\n';
+        return 1;
+    }
+
+    // A model per job; models vary too much in size for larger batches
+    celutil::CreateJobSystem(nThreads);
+    celutil::ParallelFor(0, conversions.size(), 1, [&conversions](std::size_t first, std::size_t last)
+    {
+        for (std::size_t i = first; i < last; i++)
+            convert(conversions[i]);
+    });
+    celutil::DestroyJobSystem();
+
+    unsigned int failed = 0;
+    for (const Conversion& conversion : conversions)
+    {
+        if (!conversion.error.empty())
+        {
+            std::cerr << conversion.input.string() << ": " << conversion.error << '\n';
+            failed++;
+        }
+    }
+
+    std::cout << "Converted " << conversions.size() - failed << " models, "
+              << upToDate << " up to date, " << failed << " failed\n";
+
+    return failed == 0 ? 0 : 1;
+}
@@ -22,6 +22,7 @@
 #include <celmodel/mesh.h>
 #include <celmodel/model.h>
 #include <celmodel/modelfile.h>
+#include <celmodel/vertexpacking.h>
 
 #include "cmodops.h"
 #include "pathmanager.h"
@@ -36,6 +37,8 @@ bool genTangents = false;
 bool weldVertices = false;
 bool mergeMeshes = false;
 bool stripify = false;
+bool reorder = false;
+bool packVertices = false;
 unsigned int vertexCacheSize = 16;
 float smoothAngle = 60.0f;
 
@@ -51,6 +54,8 @@ void usage()
     std::cerr << "   --smooth (or -s) <angle> : smoothing angle for normal generation\n";
     std::cerr << "   --weld (or -w)        : join identical vertices before normal generation\n";
     std::cerr << "   --merge (or -m)       : merge submeshes to improve rendering performance\n";
+    std::cerr << "   --reorder (or -r)     : reorder vertices and triangles to improve rendering performance\n";
+    std::cerr << "   --pack (or -p)        : output a binary .cmod file with vertices in compact formats\n";
 #ifdef TRISTRIP
     std::cerr << "   --optimize (or -o)    : optimize by converting triangle lists to strips\n";
 #endif
@@ -94,6 +99,15 @@ bool parseCommandLine(int argc, char* argv[])
             {
                 mergeMeshes = true;
             }
+            else if (!std::strcmp(argv[i], "-r") || !std::strcmp(argv[i], "--reorder"))
+            {
+                reorder = true;
+            }
+            else if (!std::strcmp(argv[i], "-p") || !std::strcmp(argv[i], "--pack"))
+            {
+                outputBinary = true;
+                packVertices = true;
+            }
             else if (!std::strcmp(argv[i], "-o") || !std::strcmp(argv[i], "--optimize"))
             {
                 stripify = true;
@@ -235,6 +249,11 @@ int main(int argc, char* argv[])
         }
     }
 
+    if (reorder)
+    {
+        model->optimizeMeshes();
+    }
+
 #ifdef TRISTRIP
     if (stripify)
     {
@@ -247,10 +266,14 @@ int main(int argc, char* argv[])
     }
 #endif
 
+    unsigned int packing = 0;
+    if (packVertices)
+        packing = cmod::PackAll;
+
     if (outputFilename.empty())
     {
         if (outputBinary)
-            SaveModelBinary(model.get(), std::cout, GetPathManager()->getSource);
+            SaveModelBinary(model.get(), std::cout, GetPathManager()->getSource, packing);
         else
             SaveModelAscii(model.get(), std::cout, GetPathManager()->getSource);
     }
@@ -271,7 +294,7 @@ int main(int argc, char* argv[])
         }
 
         if (outputBinary)
-            SaveModelBinary(model.get(), out, GetPathManager()->getSource);
+            SaveModelBinary(model.get(), out, GetPathManager()->getSource, packing);
         else
             SaveModelAscii(model.get(), out, GetPathManager()->getSource);
     }
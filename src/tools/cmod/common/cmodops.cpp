@@ -13,10 +13,12 @@
 #include <array>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
 #include <cstring>
 #include <iostream>
 #include <iterator>
 #include <numeric>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -64,76 +66,6 @@ struct VertexComparator
 };
 
 
-class FullComparator : public VertexComparator
-{
-public:
-    FullComparator(int _vertexSize) :
-        vertexSize(_vertexSize)
-    {
-    }
-
-    bool compare(const Vertex& a, const Vertex& b) const override
-    {
-        return std::lexicographical_compare(a.attributes, a.attributes + vertexSize,
-                                            b.attributes, b.attributes + vertexSize);
-    }
-
-private:
-    int vertexSize;
-};
-
-
-class PointOrderingPredicate : public VertexComparator
-{
-public:
-    bool compare(const Vertex& a, const Vertex& b) const override
-    {
-        std::array<float, 3> p0;
-        std::memcpy(p0.data(), a.attributes, sizeof(float) * 3);
-
-        std::array<float, 3> p1;
-        std::memcpy(p1.data(), b.attributes, sizeof(float) * 3);
-
-        return p0 < p1;
-    }
-
-private:
-    int ignore;
-};
-
-
-class PointTexCoordOrderingPredicate : public VertexComparator
-{
-public:
-    PointTexCoordOrderingPredicate(std::uint32_t _posOffset,
-                                   std::uint32_t _texCoordOffset,
-                                   bool _wrap) :
-        posOffset(_posOffset),
-        texCoordOffset(_texCoordOffset),
-        wrap(_wrap)
-    {
-    }
-
-    bool compare(const Vertex& a, const Vertex& b) const override
-    {
-        std::array<float, 5> ptc0;
-        std::memcpy(ptc0.data(), a.attributes + posOffset, sizeof(float) * 3);
-        std::memcpy(ptc0.data() + 3, a.attributes + texCoordOffset, sizeof(float) * 2);
-
-        std::array<float, 5> ptc1;
-        std::memcpy(ptc1.data(), b.attributes + posOffset, sizeof(float) * 3);
-        std::memcpy(ptc1.data() + 3, b.attributes + texCoordOffset, sizeof(float) * 2);
-
-        return ptc0 < ptc1;
-    }
-
-private:
-    std::uint32_t posOffset;
-    std::uint32_t texCoordOffset;
-    bool wrap;
-};
-
-
 bool approxEqual(float x, float y, float prec)
 {
     return std::abs(x - y) <= prec * std::min(std::abs(x), std::abs(y));
@@ -204,24 +136,6 @@ private:
 };
 
 
-bool equal(const Vertex& a, const Vertex& b, std::uint32_t vertexSize)
-{
-    return std::equal(a.attributes, a.attributes + vertexSize, b.attributes);
-}
-
-
-bool equalPoint(const Vertex& a, const Vertex& b)
-{
-    std::array<float, 3> p0;
-    std::memcpy(p0.data(), a.attributes, sizeof(float) * 3);
-
-    std::array<float, 3> p1;
-    std::memcpy(p1.data(), b.attributes, sizeof(float) * 3);
-
-    return p0 == p1;
-}
-
-
 Eigen::Vector3f
 getVertex(const cmod::VWord* vertexData,
           int positionOffset,
@@ -249,7 +163,7 @@ getTexCoord(const cmod::VWord* vertexData,
 Eigen::Vector3f
 averageFaceVectors(const std::vector<Face>& faces,
                    std::uint32_t thisFace,
-                   std::uint32_t* vertexFaces,
+                   const std::uint32_t* vertexFaces,
                    std::uint32_t vertexFaceCount,
                    float cosSmoothingAngle)
 {
@@ -329,7 +243,9 @@ augmentVertexDescription(cmod::VertexDescription& desc,
         stride += cmod::VertexAttribute::getFormatSizeWords(format);
     }
 
-    desc.strideBytes = stride * sizeof(cmod::VWord);
+    // Rebuild the description so that its attribute lookup sees the new
+    // layout; the stride is recomputed to the same value
+    desc = cmod::VertexDescription(std::move(desc.attributes));
 }
 
 
@@ -351,12 +267,86 @@ addGroupWithOffset(cmod::Mesh& mesh,
 }
 
 
-template<typename T, typename U> void
-joinVertices(std::vector<Face>& faces,
+// Key of the cell of a grid containing a position, or of the position
+// itself when the cell size is zero
+struct CellKey
+{
+    std::int64_t x;
+    std::int64_t y;
+    std::int64_t z;
+
+    bool operator==(const CellKey& other) const
+    {
+        return x == other.x && y == other.y && z == other.z;
+    }
+};
+
+
+struct CellKeyHash
+{
+    std::size_t operator()(const CellKey& key) const
+    {
+        std::uint64_t h = static_cast<std::uint64_t>(key.x) * UINT64_C(0x9e3779b97f4a7c15);
+        h ^= static_cast<std::uint64_t>(key.y) * UINT64_C(0xc2b2ae3d27d4eb4f) + (h >> 29);
+        h ^= static_cast<std::uint64_t>(key.z) * UINT64_C(0x165667b19e3779f9) + (h >> 31);
+        return static_cast<std::size_t>(h);
+    }
+};
+
+
+// Cells are this many times as large as the weld tolerance, so that a
+// point only has to be compared with the points of a neighbouring cell
+// when it lies within the tolerance of that side of its own cell
+constexpr float WeldCellScale = 4.0f;
+
+
+/*! Get the key of the cell containing p, and the range of neighbouring
+ *  cells, from -1 to 1 along each axis, which may hold points within the
+ *  tolerance of it.
+ */
+CellKey
+getCellKey(const Eigen::Vector3f& p, float cellSize, std::array<int, 3>& lo, std::array<int, 3>& hi)
+{
+    lo = { 0, 0, 0 };
+    hi = { 0, 0, 0 };
+    if (cellSize == 0.0f)
+    {
+        // Adding zero turns -0 into +0, which compares equal to it
+        std::array<std::uint32_t, 3> bits;
+        for (int i = 0; i < 3; i++)
+        {
+            float f = p[i] + 0.0f;
+            std::memcpy(&bits[i], &f, sizeof(float));
+        }
+        return { bits[0], bits[1], bits[2] };
+    }
+
+    std::array<std::int64_t, 3> cell;
+    for (int i = 0; i < 3; i++)
+    {
+        float q = p[i] / cellSize;
+        float fq = std::floor(q);
+        cell[i] = static_cast<std::int64_t>(fq);
+        lo[i] = q - fq <= 1.0f / WeldCellScale ? -1 : 0;
+        hi[i] = q - fq >= 1.0f - 1.0f / WeldCellScale ? 1 : 0;
+    }
+    return { cell[0], cell[1], cell[2] };
+}
+
+
+/*! Set the point indices of the faces so that vertices which are
+ *  equivalent share the index of the first of them. Positions are hashed
+ *  into a grid of cells a few times larger than the tolerance, so vertices
+ *  are only compared with the ones in neighbouring cells, rather than
+ *  sorting all of them.
+ */
+template<typename T> void
+weldVertices(std::vector<Face>& faces,
+             std::uint32_t nVertices,
              const cmod::VWord* vertexData,
              const cmod::VertexDescription& desc,
-             const T& orderingPredicate,
-             const U& equivalencePredicate)
+             float tolerance,
+             const T& equivalencePredicate)
 {
     // Don't do anything if we're given no data
     if (faces.size() == 0)
@@ -366,48 +356,103 @@ joinVertices(std::vector<Face>& faces,
     assert(desc.getAttribute(cmod::VertexAttributeSemantic::Position).format == cmod::VertexAttributeFormat::Float3);
 
     std::uint32_t posOffset = desc.getAttribute(cmod::VertexAttributeSemantic::Position).offsetWords;
-    const cmod::VWord* vertexPoints = vertexData + posOffset;
-    std::uint32_t nVertices = faces.size() * 3;
-
-    // Initialize the array of vertices
-    std::vector<Vertex> vertices(nVertices);
-    std::uint32_t f;
     unsigned int stride = desc.strideBytes / sizeof(cmod::VWord);
-    for (f = 0; f < faces.size(); f++)
-    {
-        for (std::uint32_t j = 0; j < 3; j++)
-        {
-            std::uint32_t index = faces[f].i[j];
-            vertices[f * 3 + j] = Vertex(index, vertexPoints + stride * index);
 
-        }
+    // The tolerance is relative to the magnitude of the coordinates, so
+    // equivalent points are never further apart than it is relative to
+    // the largest one
+    float maxCoord = 0.0f;
+    for (const Face& face : faces)
+    {
+        for (std::uint32_t index : face.i)
+            maxCoord = std::max(maxCoord, getVertex(vertexData, posOffset, stride, index).cwiseAbs().maxCoeff());
     }
+    float cellSize = tolerance * maxCoord * WeldCellScale;
 
-    // Sort the vertices so that identical ones will be ordered consecutively
-    std::sort(vertices.begin(), vertices.end(), orderingPredicate);
+    // Each cell holds a list of the distinct vertices in it, linked
+    // through next
+    constexpr std::uint32_t NoVertex = ~0u;
+    std::unordered_map<CellKey, std::uint32_t, CellKeyHash> cells;
+    cells.reserve(faces.size());
+    std::vector<std::uint32_t> next(nVertices, NoVertex);
+    std::vector<std::uint32_t> mergeMap(nVertices, NoVertex);
 
-    // Build the vertex merge map
-    std::vector<std::uint32_t> mergeMap(nVertices);
-    std::uint32_t lastUnique = 0;
-    std::uint32_t uniqueCount = 0;
-    for (std::uint32_t i = 0; i < nVertices; i++)
+    for (Face& face : faces)
     {
-        if (i == 0 || !equivalencePredicate(vertices[i - 1], vertices[i]))
+        for (std::uint32_t k = 0; k < 3; k++)
         {
-            lastUnique = i;
-            uniqueCount++;
+            std::uint32_t index = face.i[k];
+            if (mergeMap[index] == NoVertex)
+            {
+                mergeMap[index] = index;
+                Vertex vertex(index, vertexData + stride * index);
+                Eigen::Vector3f p = getVertex(vertexData, posOffset, stride, index);
+                std::array<int, 3> lo;
+                std::array<int, 3> hi;
+                CellKey key = getCellKey(p, cellSize, lo, hi);
+
+                bool found = false;
+                for (int dx = lo[0]; dx <= hi[0] && !found; dx++)
+                {
+                    for (int dy = lo[1]; dy <= hi[1] && !found; dy++)
+                    {
+                        for (int dz = lo[2]; dz <= hi[2] && !found; dz++)
+                        {
+                            auto it = cells.find({ key.x + dx, key.y + dy, key.z + dz });
+                            if (it == cells.end())
+                                continue;
+                            for (std::uint32_t other = it->second; other != NoVertex; other = next[other])
+                            {
+                                if (equivalencePredicate(Vertex(other, vertexData + stride * other), vertex))
+                                {
+                                    mergeMap[index] = other;
+                                    found = true;
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                }
+
+                if (!found)
+                {
+                    auto cell = cells.try_emplace(key, NoVertex).first;
+                    next[index] = cell->second;
+                    cell->second = index;
+                }
+            }
+
+            face.vi[k] = mergeMap[index];
         }
+    }
+}
+
 
-        mergeMap[vertices[i].index] = vertices[lastUnique].index;
+/*! Make lists of the faces that contain each point, all in one array: the
+ *  faces of point v are faceList[faceStart[v]] up to faceStart[v + 1].
+ */
+void
+buildPointFaces(const std::vector<Face>& faces,
+                std::uint32_t nVertices,
+                std::vector<std::uint32_t>& faceStart,
+                std::vector<std::uint32_t>& faceList)
+{
+    faceStart.assign(nVertices + 1, 0);
+    for (const Face& face : faces)
+    {
+        for (std::uint32_t v : face.vi)
+            faceStart[v + 1]++;
     }
+    std::partial_sum(faceStart.begin(), faceStart.end(), faceStart.begin());
 
-    // Remap the vertex indices
-    for (f = 0; f < faces.size(); f++)
+    // Fill each list from its end, which keeps the order in which faces
+    // were always averaged
+    std::vector<std::uint32_t> fill(faceStart.begin() + 1, faceStart.end());
+    faceList.resize(faces.size() * 3);
+    for (std::uint32_t f = 0; f < faces.size(); f++)
     {
-        for (std::uint32_t k= 0; k < 3; k++)
-        {
-            faces[f].vi[k] = mergeMap[faces[f].i[k]];
-        }
+        for (std::uint32_t v : faces[f].vi)
+            faceList[--fill[v]] = f;
     }
 }
 
@@ -558,18 +603,13 @@ GenerateNormals(const cmod::Mesh& mesh, float smoothAngle, bool weld, float weld
         }
     }
 
-    // For each vertex, create a list of faces that contain it
-    std::vector<std::uint32_t> faceCounts(nVertices, 0);
-    std::vector<std::vector<std::uint32_t>> vertexFaces(nVertices);
-
     // If we're welding vertices before generating normals, find identical
     // points and merge them.  Otherwise, the point indices will be the same
     // as the attribute indices.
     if (weld)
     {
-        joinVertices(faces, vertexData, desc,
-                     PointOrderingPredicate(),
-                     PointEquivalencePredicate(0, weldTolerance));
+        weldVertices(faces, nVertices, vertexData, desc, weldTolerance,
+                     PointEquivalencePredicate(posOffset, weldTolerance));
     }
     else
     {
@@ -581,33 +621,10 @@ GenerateNormals(const cmod::Mesh& mesh, float smoothAngle, bool weld, float weld
         }
     }
 
-    // Count the number of faces in which each vertex appears
-    for (f = 0; f < nFaces; f++)
-    {
-        Face& face = faces[f];
-        faceCounts[face.vi[0]]++;
-        faceCounts[face.vi[1]]++;
-        faceCounts[face.vi[2]]++;
-    }
-
-    // Allocate space for the per-vertex face lists
-    for (i = 0; i < nVertices; i++)
-    {
-        if (faceCounts[i] > 0)
-        {
-            vertexFaces[i].resize(faceCounts[i] + 1);
-            vertexFaces[i][0] = faceCounts[i];
-        }
-    }
-
-    // Fill in the vertex/face lists
-    for (f = 0; f < nFaces; f++)
-    {
-        Face& face = faces[f];
-        vertexFaces[face.vi[0]][faceCounts[face.vi[0]]--] = f;
-        vertexFaces[face.vi[1]][faceCounts[face.vi[1]]--] = f;
-        vertexFaces[face.vi[2]][faceCounts[face.vi[2]]--] = f;
-    }
+    // For each vertex, create a list of faces that contain it
+    std::vector<std::uint32_t> faceStart;
+    std::vector<std::uint32_t> vertexFaces;
+    buildPointFaces(faces, nVertices, faceStart, vertexFaces);
 
     // Compute the vertex normals by averaging
     std::vector<Eigen::Vector3f> vertexNormals(nFaces * 3);
@@ -616,10 +633,11 @@ GenerateNormals(const cmod::Mesh& mesh, float smoothAngle, bool weld, float weld
         Face& face = faces[f];
         for (std::uint32_t j = 0; j < 3; j++)
         {
+            std::uint32_t v = face.vi[j];
             vertexNormals[f * 3 + j] =
                 averageFaceVectors(faces, f,
-                                   &vertexFaces[face.vi[j]][1],
-                                   vertexFaces[face.vi[j]][0],
+                                   &vertexFaces[faceStart[v]],
+                                   faceStart[v + 1] - faceStart[v],
                                    cosSmoothAngle);
         }
     }
@@ -824,24 +842,12 @@ GenerateTangents(const cmod::Mesh& mesh, bool weld)
             face.normal = Eigen::Vector3f::Zero();
     }
 
-    // For each vertex, create a list of faces that contain it
-    std::uint32_t* faceCounts = new std::uint32_t[nVertices];
-    std::uint32_t** vertexFaces = new std::uint32_t*[nVertices];
-
-    // Initialize the lists
-    for (i = 0; i < nVertices; i++)
-    {
-        faceCounts[i] = 0;
-        vertexFaces[i] = nullptr;
-    }
-
     // If we're welding vertices before generating normals, find identical
     // points and merge them.  Otherwise, the point indices will be the same
     // as the attribute indices.
     if (weld)
     {
-        joinVertices(faces, vertexData, desc,
-                     PointTexCoordOrderingPredicate(posOffset, texCoordOffset, true),
+        weldVertices(faces, nVertices, vertexData, desc, 1.0e-5f,
                      PointTexCoordEquivalencePredicate(posOffset, texCoordOffset, true, 1.0e-5f));
     }
     else
@@ -854,33 +860,10 @@ GenerateTangents(const cmod::Mesh& mesh, bool weld)
         }
     }
 
-    // Count the number of faces in which each vertex appears
-    for (f = 0; f < nFaces; f++)
-    {
-        Face& face = faces[f];
-        faceCounts[face.vi[0]]++;
-        faceCounts[face.vi[1]]++;
-        faceCounts[face.vi[2]]++;
-    }
-
-    // Allocate space for the per-vertex face lists
-    for (i = 0; i < nVertices; i++)
-    {
-        if (faceCounts[i] > 0)
-        {
-            vertexFaces[i] = new std::uint32_t[faceCounts[i] + 1];
-            vertexFaces[i][0] = faceCounts[i];
-        }
-    }
-
-    // Fill in the vertex/face lists
-    for (f = 0; f < nFaces; f++)
-    {
-        Face& face = faces[f];
-        vertexFaces[face.vi[0]][faceCounts[face.vi[0]]--] = f;
-        vertexFaces[face.vi[1]][faceCounts[face.vi[1]]--] = f;
-        vertexFaces[face.vi[2]][faceCounts[face.vi[2]]--] = f;
-    }
+    // For each vertex, create a list of faces that contain it
+    std::vector<std::uint32_t> faceStart;
+    std::vector<std::uint32_t> vertexFaces;
+    buildPointFaces(faces, nVertices, faceStart, vertexFaces);
 
     // Compute the vertex tangents by averaging
     std::vector<Eigen::Vector3f> vertexTangents(nFaces * 3);
@@ -889,10 +872,11 @@ GenerateTangents(const cmod::Mesh& mesh, bool weld)
         Face& face = faces[f];
         for (std::uint32_t j = 0; j < 3; j++)
         {
+            std::uint32_t v = face.vi[j];
             vertexTangents[f * 3 + j] =
                 averageFaceVectors(faces, f,
-                                   &vertexFaces[face.vi[j]][1],
-                                   vertexFaces[face.vi[j]][0],
+                                   &vertexFaces[faceStart[v]],
+                                   faceStart[v + 1] - faceStart[v],
                                    0.0f);
         }
     }
@@ -983,15 +967,6 @@ GenerateTangents(const cmod::Mesh& mesh, bool weld)
         firstIndex += faceCount * 3;
     }
 
-    // Clean up
-    delete[] faceCounts;
-    for (i = 0; i < nVertices; i++)
-    {
-        if (vertexFaces[i] != nullptr)
-            delete[] vertexFaces[i];
-    }
-    delete[] vertexFaces;
-
     return newMesh;
 }
 
@@ -1009,47 +984,51 @@ UniquifyVertices(cmod::Mesh& mesh)
     if (vertexData == nullptr)
         return false;
 
-    // Initialize the array of vertices
+    // Number the distinct vertices in the order they first appear, finding
+    // earlier copies in a hash table of the vertex contents
     unsigned int stride = desc.strideBytes / sizeof(cmod::VWord);
-    std::vector<Vertex> vertices(nVertices);
-    std::uint32_t i;
-    for (i = 0; i < nVertices; i++)
+    auto hashVertex = [vertexData, stride](std::uint32_t index)
     {
-        vertices[i] = Vertex(i, vertexData + i * stride);
-    }
-
-    // Sort the vertices so that identical ones will be ordered consecutively
-    std::sort(vertices.begin(), vertices.end(), FullComparator(stride));
+        const cmod::VWord* vertex = vertexData + index * stride;
+        std::uint64_t h = UINT64_C(0xcbf29ce484222325);
+        for (unsigned int k = 0; k < stride; k++)
+            h = (h ^ vertex[k]) * UINT64_C(0x100000001b3);
+        return static_cast<std::size_t>(h);
+    };
+    auto equalVertex = [vertexData, stride](std::uint32_t a, std::uint32_t b)
+    {
+        return std::equal(vertexData + a * stride, vertexData + (a + 1) * stride,
+                          vertexData + b * stride);
+    };
+    std::unordered_map<std::uint32_t, std::uint32_t, decltype(hashVertex), decltype(equalVertex)>
+        uniqueVertices(nVertices, hashVertex, equalVertex);
 
-    // Count the number of unique vertices
+    std::vector<std::uint32_t> vertexMap(nVertices);
     std::uint32_t uniqueVertexCount = 0;
-    for (i = 0; i < nVertices; i++)
+    for (std::uint32_t i = 0; i < nVertices; i++)
     {
-        if (i == 0 || !equal(vertices[i - 1], vertices[i], stride))
+        auto it = uniqueVertices.try_emplace(i, uniqueVertexCount).first;
+        if (it->second == uniqueVertexCount)
             uniqueVertexCount++;
+        vertexMap[i] = it->second;
     }
 
     // No work left to do if we couldn't eliminate any vertices
     if (uniqueVertexCount == nVertices)
         return true;
 
-    // Build the vertex map and the uniquified vertex data
-    std::vector<std::uint32_t> vertexMap(nVertices);
+    // Build the uniquified vertex data from the first copy of each vertex
     std::vector<cmod::VWord> newVertexData(uniqueVertexCount * stride);
-    const cmod::VWord* oldVertexData = mesh.getVertexData();
     std::uint32_t j = 0;
-    for (i = 0; i < nVertices; i++)
+    for (std::uint32_t i = 0; i < nVertices; i++)
     {
-        if (i == 0 || !equal(vertices[i - 1], vertices[i], stride))
+        if (vertexMap[i] == j)
         {
-            if (i != 0)
-                j++;
-            assert(j < uniqueVertexCount);
             std::memcpy(newVertexData.data() + j * stride,
-                        oldVertexData + vertices[i].index * stride,
+                        vertexData + i * stride,
                         desc.strideBytes);
+            j++;
         }
-        vertexMap[vertices[i].index] = j;
     }
 
     // Replace the vertex data with the compacted data
@@ -0,0 +1,122 @@
+// makektx2.cpp
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Convert a texture to a KTX2 file with a complete set of mipmaps,
+// optionally compressed to DXT1 (BC1) or DXT5 (BC3), so that Celestia
+// doesn't have to build the mipmaps or keep uncompressed textures in
+// graphics memory.
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <celengine/image.h>
+#include <celimage/dxt_compress.h>
+#include <celimage/imageformats.h>
+#include <celutil/logger.h>
+
+using namespace std;
+using celestia::PixelFormat;
+
+namespace celutil = celestia::util;
+
+
+namespace
+{
+
+enum class Compression
+{
+    Auto,
+    None,
+    DXT1,
+    DXT5,
+};
+
+
+bool hasAlpha(PixelFormat format)
+{
+    return format == PixelFormat::RGBA ||
+           format == PixelFormat::BGRA ||
+           format == PixelFormat::LUM_ALPHA;
+}
+
+
+void usage()
+{
+    cerr << "Usage: makektx2 [options] <input image> <output ktx2 file>\n"
+         << "  --dxt1         compress to DXT1\n"
+         << "  --dxt5         compress to DXT5\n"
+         << "  --uncompressed don't compress\n"
+         << "  --no-mipmaps   only store the full size image\n"
+         << "By default, images with alpha are compressed to DXT5 and the others\n"
+         << "to DXT1.\n";
+}
+
+} // end unnamed namespace
+
+
+int main(int argc, char* argv[])
+{
+    Compression compression = Compression::Auto;
+    bool mipmaps = true;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1] == '-'; i++)
+    {
+        string arg(argv[i]);
+        if (arg == "--dxt1")
+            compression = Compression::DXT1;
+        else if (arg == "--dxt5")
+            compression = Compression::DXT5;
+        else if (arg == "--uncompressed")
+            compression = Compression::None;
+        else if (arg == "--no-mipmaps")
+            mipmaps = false;
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if (argc - i != 2)
+    {
+        usage();
+        return 1;
+    }
+
+    celutil::CreateLogger();
+
+    unique_ptr<Image> img(LoadImageFromFile(argv[i]));
+    if (img == nullptr)
+    {
+        cerr << "Error reading image " << argv[i] << '\n';
+        return 1;
+    }
+
+    // Images that are compressed already are copied as they are
+    if (!img->isCompressed())
+    {
+        if (img->getFormat() == PixelFormat::ALPHA)
+        {
+            cerr << "Alpha only images aren't supported\n";
+            return 1;
+        }
+
+        if (mipmaps)
+            img = BuildMipmaps(*img);
+
+        if (compression == Compression::Auto)
+            compression = hasAlpha(img->getFormat()) ? Compression::DXT5 : Compression::DXT1;
+        if (compression == Compression::DXT1)
+            img = CompressDXT(*img, PixelFormat::DXT1);
+        else if (compression == Compression::DXT5)
+            img = CompressDXT(*img, PixelFormat::DXT5);
+    }
+
+    return SaveKTX2Image(argv[i + 1], *img) ? 0 : 1;
+}
@@ -0,0 +1,276 @@
+// makedsodb.cpp
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Convert a text deep sky catalog (.dsc) to a binary deep sky
+// catalog (.dsb) that can be mapped into memory by Celestia.
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <celutil/binarywrite.h>
+#include <celutil/stringutils.h>
+#include <celutil/tokenizer.h>
+#include <celengine/astro.h>
+#include <celengine/dsodb.h>
+#include <celengine/galaxy.h>
+#include <celengine/globular.h>
+#include <celengine/nebula.h>
+#include <celengine/opencluster.h>
+#include <celengine/parser.h>
+
+using namespace std;
+
+namespace celutil = celestia::util;
+
+
+namespace
+{
+
+// Deduplicating pool of NUL-terminated strings
+class StringPool
+{
+ public:
+    uint32_t add(const string& s)
+    {
+        if (s.empty())
+            return DSO_BINARY_NO_STRING;
+
+        auto iter = offsets.find(s);
+        if (iter != offsets.end())
+            return iter->second;
+
+        auto offset = static_cast<uint32_t>(data.size());
+        data.append(s);
+        data.push_back('\0');
+        offsets.emplace(s, offset);
+        return offset;
+    }
+
+    const string& str() const { return data; }
+
+ private:
+    string data;
+    unordered_map<string, uint32_t> offsets;
+};
+
+
+string getCategories(const Hash* params)
+{
+    string categories;
+    if (params->getString("Category", categories))
+        return categories;
+
+    const Value* v = params->getValue("Category");
+    if (v == nullptr || v->getArray() == nullptr)
+        return categories;
+
+    for (const Value* c : *v->getArray())
+    {
+        if (c->getType() != Value::StringType)
+            continue;
+        if (!categories.empty())
+            categories.push_back('\t');
+        categories.append(c->getString());
+    }
+
+    return categories;
+}
+
+
+bool writeRecord(ostream& out,
+                 StringPool& pool,
+                 AstroCatalog::IndexNumber catalogNumber,
+                 DSOBinaryClass objClass,
+                 const string& names,
+                 const Hash* params)
+{
+    unique_ptr<DeepSkyObject> obj;
+    switch (objClass)
+    {
+    case DSOBinaryClass::Galaxy:
+        obj = make_unique<Galaxy>();
+        break;
+    case DSOBinaryClass::Globular:
+        obj = make_unique<Globular>();
+        break;
+    case DSOBinaryClass::Nebula:
+        obj = make_unique<Nebula>();
+        break;
+    case DSOBinaryClass::OpenCluster:
+        obj = make_unique<OpenCluster>();
+        break;
+    }
+
+    // Only the common properties are parsed by the engine; type specific
+    // ones are stored as they appear in the catalog and resolved when the
+    // binary catalog is loaded.
+    if (!obj->DeepSkyObject::load(const_cast<Hash*>(params), fs::path()))
+        return false;
+
+    float detail = 1.0f;
+    params->getNumber("Detail", detail);
+
+    Globular defaultGlobular;
+    float coreRadius = defaultGlobular.getCoreRadius();
+    float concentration = defaultGlobular.getConcentration();
+    params->getAngle("CoreRadius", coreRadius, 1.0 / MINUTES_PER_DEG);
+    params->getNumber("KingConcentration", concentration);
+
+    string typeName;
+    string model;
+    if (objClass == DSOBinaryClass::Galaxy)
+    {
+        params->getString("Type", typeName);
+        params->getString("CustomTemplate", model);
+    }
+    else if (objClass == DSOBinaryClass::Nebula)
+    {
+        params->getString("Mesh", model);
+    }
+
+    string infoURL;
+    params->getString("InfoURL", infoURL);
+
+    uint8_t flags = 0;
+    if (obj->isVisible())
+        flags |= DSO_BINARY_VISIBLE;
+    if (obj->isClickable())
+        flags |= DSO_BINARY_CLICKABLE;
+
+    Eigen::Vector3d position = obj->getPosition();
+    Eigen::Quaternionf orientation = obj->getOrientation();
+
+    return celutil::writeLE<uint32_t>(out, catalogNumber)
+        && celutil::writeLE<uint8_t>(out, static_cast<uint8_t>(objClass))
+        && celutil::writeLE<uint8_t>(out, flags)
+        && celutil::writeLE<uint16_t>(out, 0)
+        && celutil::writeLE<double>(out, position.x())
+        && celutil::writeLE<double>(out, position.y())
+        && celutil::writeLE<double>(out, position.z())
+        && celutil::writeLE<float>(out, orientation.w())
+        && celutil::writeLE<float>(out, orientation.x())
+        && celutil::writeLE<float>(out, orientation.y())
+        && celutil::writeLE<float>(out, orientation.z())
+        && celutil::writeLE<float>(out, obj->getRadius())
+        && celutil::writeLE<float>(out, obj->getAbsoluteMagnitude())
+        && celutil::writeLE<float>(out, detail)
+        && celutil::writeLE<float>(out, coreRadius)
+        && celutil::writeLE<float>(out, concentration)
+        && celutil::writeLE<uint32_t>(out, pool.add(names))
+        && celutil::writeLE<uint32_t>(out, pool.add(typeName))
+        && celutil::writeLE<uint32_t>(out, pool.add(model))
+        && celutil::writeLE<uint32_t>(out, pool.add(infoURL))
+        && celutil::writeLE<uint32_t>(out, pool.add(getCategories(params)));
+}
+
+
+bool writeDSODatabase(istream& in, ostream& out)
+{
+    Tokenizer tokenizer(&in);
+    Parser    parser(&tokenizer);
+
+    ostringstream records(ios::out | ios::binary);
+    StringPool pool;
+    uint32_t nObjects = 0;
+
+    while (tokenizer.nextToken() != Tokenizer::TokenEnd)
+    {
+        if (tokenizer.getTokenType() != Tokenizer::TokenName)
+        {
+            cerr << "Error parsing deep sky catalog file.\n";
+            return false;
+        }
+        string objType(tokenizer.getStringValue());
+
+        DSOBinaryClass objClass;
+        if (compareIgnoringCase(objType, "Galaxy") == 0)
+            objClass = DSOBinaryClass::Galaxy;
+        else if (compareIgnoringCase(objType, "Globular") == 0)
+            objClass = DSOBinaryClass::Globular;
+        else if (compareIgnoringCase(objType, "Nebula") == 0)
+            objClass = DSOBinaryClass::Nebula;
+        else if (compareIgnoringCase(objType, "OpenCluster") == 0)
+            objClass = DSOBinaryClass::OpenCluster;
+        else
+        {
+            cerr << "Unknown deep sky object type " << objType << '\n';
+            return false;
+        }
+
+        AstroCatalog::IndexNumber catalogNumber = AstroCatalog::InvalidIndex;
+        if (tokenizer.nextToken() == Tokenizer::TokenNumber)
+        {
+            catalogNumber = (AstroCatalog::IndexNumber) tokenizer.getNumberValue();
+            tokenizer.nextToken();
+        }
+
+        if (tokenizer.getTokenType() != Tokenizer::TokenString)
+        {
+            cerr << "Error parsing deep sky catalog file: bad name.\n";
+            return false;
+        }
+        string names(tokenizer.getStringValue());
+
+        unique_ptr<Value> paramsValue(parser.readValue());
+        if (paramsValue == nullptr || paramsValue->getType() != Value::HashType)
+        {
+            cerr << "Error parsing deep sky catalog entry " << names << '\n';
+            return false;
+        }
+
+        if (!writeRecord(records, pool, catalogNumber, objClass, names, paramsValue->getHash()))
+        {
+            cerr << "Error writing deep sky catalog entry " << names << '\n';
+            return false;
+        }
+        ++nObjects;
+    }
+
+    const string& strings = pool.str();
+    out.write(DSO_BINARY_FILE_HEADER, sizeof(DSO_BINARY_FILE_HEADER) - 1);
+    celutil::writeLE<uint16_t>(out, DSO_BINARY_VERSION);
+    celutil::writeLE<uint32_t>(out, nObjects);
+    celutil::writeLE<uint32_t>(out, static_cast<uint32_t>(strings.size()));
+    out << records.str();
+    out.write(strings.data(), strings.size());
+
+    return out.good();
+}
+
+} // end unnamed namespace
+
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        cerr << "Usage: makedsodb <input deep sky catalog> <output binary catalog>\n";
+        return 1;
+    }
+
+    ifstream inputFile(argv[1], ios::in);
+    if (!inputFile.good())
+    {
+        cerr << "Error opening input file " << argv[1] << '\n';
+        return 1;
+    }
+
+    ofstream dsodbFile(argv[2], ios::out | ios::binary);
+    if (!dsodbFile.good())
+    {
+        cerr << "Error opening deep sky database file " << argv[2] << '\n';
+        return 1;
+    }
+
+    return writeDSODatabase(inputFile, dsodbFile) ? 0 : 1;
+}
@@ -7,23 +7,68 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 //
-// Convert a file with ASCII star records to a Celestia star database
-
-#include <iostream>
+// Convert a file with ASCII star records to a Celestia star database.
+//
+// The input file is mapped into memory and split into chunks at line
+// boundaries, which are parsed in parallel. Each chunk is sorted by catalog
+// number and written to a temporary run file; the runs are then merged
+// into the star database, so only a few chunks are held in memory at once
+// however large the catalog is.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
-#include <iomanip>
-#include <cctype>
-#include <cassert>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include <celcompat/charconv.h>
+#include <celcompat/filesystem.h>
 #include <celutil/bytes.h>
+#include <celutil/jobsystem.h>
+#include <celutil/mmapfile.h>
 #include <celengine/astro.h>
 #include <celengine/star.h>
 
 using namespace std;
 
+namespace celutil = celestia::util;
+
 
 static string inputFilename;
 static string outputFilename;
 static bool useSphericalCoords = false;
+static unsigned int nThreads = 0;
+static size_t chunkSize = 256;
+static fs::path tempDir;
+
+
+namespace
+{
+
+// A star as it's written to the star database, in native byte order
+struct StarRecord
+{
+    uint32_t catalogNumber;
+    float x, y, z;
+    int16_t absMag;
+    uint16_t stellarClass;
+};
+
+// Number of records read from each run at a time while merging
+constexpr size_t MergeBufferRecords = 4096;
+// Number of records encoded before each write of the star database
+constexpr size_t OutputBufferRecords = 65536;
+constexpr size_t RecordSize = 20;
+
+} // end unnamed namespace
 
 
 void Usage()
@@ -31,6 +76,16 @@ void Usage()
     cerr << "Usage: makestardb [options] <input file> <output star database>\n";
     cerr << "  Options:\n";
     cerr << "    --spherical (or -s) : input file has spherical coords (RA/dec/distance\n";
+    cerr << "    --threads <n>       : number of parser threads (default: all cores)\n";
+    cerr << "    --chunk-size <MB>   : size of the input chunks sorted in memory (default: 256)\n";
+    cerr << "    --temp-dir <dir>    : directory of the temporary run files (default: output directory)\n";
+}
+
+
+static bool parseCount(const char* arg, unsigned long& value)
+{
+    auto [ptr, ec] = celestia::compat::from_chars(arg, arg + strlen(arg), value);
+    return ec == errc() && *ptr == '\0';
 }
 
 
@@ -47,6 +102,38 @@ bool parseCommandLine(int argc, char* argv[])
             {
                 useSphericalCoords = true;
             }
+            else if (!strcmp(argv[i], "--threads"))
+            {
+                unsigned long n;
+                if (i + 1 == argc || !parseCount(argv[i + 1], n))
+                {
+                    cerr << "--threads requires a number\n";
+                    return false;
+                }
+                nThreads = static_cast<unsigned int>(n);
+                i++;
+            }
+            else if (!strcmp(argv[i], "--chunk-size"))
+            {
+                unsigned long n;
+                if (i + 1 == argc || !parseCount(argv[i + 1], n) || n == 0)
+                {
+                    cerr << "--chunk-size requires a positive number\n";
+                    return false;
+                }
+                chunkSize = n;
+                i++;
+            }
+            else if (!strcmp(argv[i], "--temp-dir"))
+            {
+                if (i + 1 == argc)
+                {
+                    cerr << "--temp-dir requires a directory\n";
+                    return false;
+                }
+                tempDir = argv[i + 1];
+                i++;
+            }
             else
             {
                 cerr << "Unknown command line switch: " << argv[i] << '\n';
@@ -81,82 +168,108 @@ bool parseCommandLine(int argc, char* argv[])
 }
 
 
-static void writeUint(ostream& out, uint32_t n)
+static char* writeUint(char* out, uint32_t n)
 {
     LE_TO_CPU_INT32(n, n);
-    out.write(reinterpret_cast<char*>(&n), sizeof n);
+    memcpy(out, &n, sizeof n);
+    return out + sizeof n;
 }
 
-static void writeFloat(ostream& out, float f)
+static char* writeFloat(char* out, float f)
 {
     LE_TO_CPU_FLOAT(f, f);
-    out.write(reinterpret_cast<char*>(&f), sizeof f);
+    memcpy(out, &f, sizeof f);
+    return out + sizeof f;
 }
 
-static void writeUshort(ostream& out, uint16_t n)
+static char* writeUshort(char* out, uint16_t n)
 {
     LE_TO_CPU_INT16(n, n);
-    out.write(reinterpret_cast<char*>(&n), sizeof n);
+    memcpy(out, &n, sizeof n);
+    return out + sizeof n;
 }
 
-static void writeShort(ostream& out, int16_t n)
+static char* writeShort(char* out, int16_t n)
 {
     LE_TO_CPU_INT16(n, n);
-    out.write(reinterpret_cast<char*>(&n), sizeof n);
+    memcpy(out, &n, sizeof n);
+    return out + sizeof n;
 }
 
 
-bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords)
+static bool isSpace(char c)
 {
-    unsigned int nStarsInFile = 0;
+    return c == ' ' || c == '\t' || c == '\r';
+}
 
-    in >> nStarsInFile;
-    if (!in.good())
-    {
-        cerr << "Error reading star count at beginning of input file.\n";
-        return 1;
-    }
+static const char* skipSpace(const char* p, const char* end)
+{
+    while (p < end && isSpace(*p))
+        p++;
+    return p;
+}
 
-    // Write the header
-    out.write("CELSTARS", 8);
+// Parse a number followed by white space or the end of the line
+template<typename T>
+static bool parseNumber(const char*& p, const char* end, T& value)
+{
+    p = skipSpace(p, end);
+    // from_chars doesn't accept a leading plus sign
+    if (p < end && *p == '+')
+        p++;
+
+    auto [ptr, ec] = celestia::compat::from_chars(p, end, value);
+    if (ec != errc() || (ptr < end && !isSpace(*ptr) && *ptr != '\n'))
+        return false;
 
-    // Write the version
-    writeShort(out, 0x0100);
+    p = ptr;
+    return true;
+}
 
-    writeUint(out, nStarsInFile);
 
-    for (unsigned int record = 0; record < nStarsInFile; record++)
+// Parse the records of the lines in [begin, end) and sort them by catalog
+// number. Returns false and reports the first malformed record on error.
+static bool parseChunk(const char* begin, const char* end, bool sphericalCoords,
+                       vector<StarRecord>& records, string& error)
+{
+    string scString;
+    const char* p = begin;
+    while (p < end)
     {
-        unsigned int catalogNumber;
-        float x, y, z;
-        float absMag;
+        const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (lineEnd == nullptr)
+            lineEnd = end;
 
-        in >> catalogNumber;
-        if (in.eof())
-            return true;
+        p = skipSpace(p, lineEnd);
+        if (p == lineEnd)
+        {
+            p = lineEnd + 1;
+            continue;
+        }
 
-        if (!in.good())
+        StarRecord record;
+        if (!parseNumber(p, lineEnd, record.catalogNumber))
         {
-            cerr << "Error parsing catalog number for record #" << record << '\n';
+            error = "Error parsing catalog number at offset " + to_string(p - begin);
             return false;
         }
 
+        float absMag;
         if (sphericalCoords)
         {
             float RA, dec, distance;
             float appMag;
-
-            in >> RA >> dec >> distance;
-            if (!in.good())
+            if (!parseNumber(p, lineEnd, RA) ||
+                !parseNumber(p, lineEnd, dec) ||
+                !parseNumber(p, lineEnd, distance))
             {
-                cerr << "Error parsing position of star " << catalogNumber << '\n';
+                error = "Error parsing position of star " + to_string(record.catalogNumber);
                 return false;
             }
 
-            in >> appMag;
-            if (!in.good())
+            if (!parseNumber(p, lineEnd, appMag))
             {
-                cerr << "Error parsing magnitude of star " << catalogNumber << '\n';
+                error = "Error parsing magnitude of star " + to_string(record.catalogNumber);
                 return false;
             }
 
@@ -164,65 +277,307 @@ bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords)
                 astro::equatorialToCelestialCart((double) RA * 24.0 / 360.0,
                                                  (double) dec,
                                                  (double) distance);
-            x = (float) pos.x();
-            y = (float) pos.y();
-            z = (float) pos.z();
+            record.x = (float) pos.x();
+            record.y = (float) pos.y();
+            record.z = (float) pos.z();
             absMag = (float) (appMag + 5 - 5 * log10(distance / 3.26));
         }
         else
         {
-            in >> x >> y >> z;
-            if (!in.good())
+            if (!parseNumber(p, lineEnd, record.x) ||
+                !parseNumber(p, lineEnd, record.y) ||
+                !parseNumber(p, lineEnd, record.z))
             {
-                cerr << "Error parsing position of star " << catalogNumber << '\n';
+                error = "Error parsing position of star " + to_string(record.catalogNumber);
                 return false;
             }
 
-            in >> absMag;
-            if (!in.good())
+            if (!parseNumber(p, lineEnd, absMag))
             {
-                cerr << "Error parsing magnitude of star " << catalogNumber << '\n';
+                error = "Error parsing magnitude of star " + to_string(record.catalogNumber);
                 return false;
             }
         }
 
-        string scString;
-        in >> scString;
-        StellarClass sc = StellarClass::parse(scString);
-#if 0
-        StarDetails* details = StarDetails::GetStarDetails(sc);
-        if (details == NULL)
+        p = skipSpace(p, lineEnd);
+        const char* scEnd = p;
+        while (scEnd < lineEnd && !isSpace(*scEnd))
+            scEnd++;
+        scString.assign(p, scEnd);
+
+        record.absMag = (int16_t) (absMag * 256.0f);
+        record.stellarClass = StellarClass::parse(scString).packV1();
+        records.push_back(record);
+
+        p = lineEnd + 1;
+    }
+
+    // A stable sort keeps duplicate catalog numbers in input order
+    stable_sort(records.begin(), records.end(),
+                [](const StarRecord& a, const StarRecord& b) { return a.catalogNumber < b.catalogNumber; });
+    return true;
+}
+
+
+// Split [begin, end) into chunks of about size bytes ending at line breaks
+static vector<pair<const char*, const char*>> splitChunks(const char* begin, const char* end, size_t size)
+{
+    vector<pair<const char*, const char*>> chunks;
+    while (begin < end)
+    {
+        const char* chunkEnd = begin + min(size, static_cast<size_t>(end - begin));
+        if (chunkEnd < end)
+        {
+            chunkEnd = static_cast<const char*>(memchr(chunkEnd, '\n', end - chunkEnd));
+            chunkEnd = chunkEnd == nullptr ? end : chunkEnd + 1;
+        }
+        chunks.emplace_back(begin, chunkEnd);
+        begin = chunkEnd;
+    }
+    return chunks;
+}
+
+
+namespace
+{
+
+// Sorted records read back from a run file
+class RunReader
+{
+ public:
+    bool open(const fs::path& path, size_t count)
+    {
+        in.open(path, ios::in | ios::binary);
+        remaining = count;
+        return in.good() && fill();
+    }
+
+    const StarRecord& current() const { return buffer[pos]; }
+
+    // Advance to the next record, returns false at the end of the run
+    bool next()
+    {
+        return ++pos < buffer.size() || fill();
+    }
+
+ private:
+    bool fill()
+    {
+        size_t n = min(remaining, MergeBufferRecords);
+        buffer.resize(n);
+        pos = 0;
+        if (n == 0)
+            return false;
+
+        in.read(reinterpret_cast<char*>(buffer.data()), n * sizeof(StarRecord));
+        if (!in.good())
         {
-            cerr << "Error parsing spectral type of star " << catalogNumber << '\n';
+            buffer.clear();
             return false;
         }
+        remaining -= n;
+        return true;
+    }
+
+    ifstream in;
+    vector<StarRecord> buffer;
+    size_t pos{ 0 };
+    size_t remaining{ 0 };
+};
+
+
+// Writes the records in the star database format
+class StarWriter
+{
+ public:
+    explicit StarWriter(ostream& _out) : out(_out)
+    {
+        buffer.reserve(OutputBufferRecords * RecordSize);
+    }
+
+    bool writeHeader(uint32_t nStars)
+    {
+        char header[14];
+        memcpy(header, "CELSTARS", 8);
+        char* p = writeShort(header + 8, 0x0100);
+        writeUint(p, nStars);
+        out.write(header, sizeof header);
+        return out.good();
+    }
+
+    void write(const StarRecord& record)
+    {
+        char encoded[RecordSize];
+        char* p = writeUint(encoded, record.catalogNumber);
+        p = writeFloat(p, record.x);
+        p = writeFloat(p, record.y);
+        p = writeFloat(p, record.z);
+        p = writeShort(p, record.absMag);
+        writeUshort(p, record.stellarClass);
+        buffer.insert(buffer.end(), encoded, encoded + RecordSize);
+        if (buffer.size() >= OutputBufferRecords * RecordSize)
+            flush();
+    }
+
+    bool flush()
+    {
+        out.write(buffer.data(), buffer.size());
+        buffer.clear();
+        return out.good();
+    }
+
+ private:
+    ostream& out;
+    vector<char> buffer;
+};
+
+} // end unnamed namespace
 
-        // For spectral type parser debugging . . .
-        cout << scString << ' ' << details->getSpectralType() << '\n';
-#endif
 
-        writeUint(out, catalogNumber);
-        writeFloat(out, x);
-        writeFloat(out, y);
-        writeFloat(out, z);
-        writeShort(out, (int16_t) (absMag * 256.0f));
-        writeUshort(out, sc.packV1());
+// Merge the sorted runs into the star database; records with the same
+// catalog number are written in the order of their runs.
+static bool mergeRuns(const vector<fs::path>& runPaths, const vector<size_t>& runSizes, StarWriter& writer)
+{
+    vector<unique_ptr<RunReader>> runs;
+    using Head = pair<uint32_t, size_t>;
+    priority_queue<Head, vector<Head>, greater<Head>> heads;
+    for (size_t i = 0; i < runPaths.size(); i++)
+    {
+        auto run = make_unique<RunReader>();
+        if (runSizes[i] > 0)
+        {
+            if (!run->open(runPaths[i], runSizes[i]))
+            {
+                cerr << "Error reading temporary file " << runPaths[i] << '\n';
+                return false;
+            }
+            heads.emplace(run->current().catalogNumber, i);
+        }
+        runs.push_back(move(run));
+    }
+
+    while (!heads.empty())
+    {
+        size_t i = heads.top().second;
+        heads.pop();
+        writer.write(runs[i]->current());
+        if (runs[i]->next())
+            heads.emplace(runs[i]->current().catalogNumber, i);
     }
 
     return true;
 }
 
 
+bool WriteStarDatabase(const char* begin, const char* end, ostream& out, bool sphericalCoords)
+{
+    unsigned int nStarsInFile = 0;
+    const char* p = skipSpace(begin, end);
+    if (!parseNumber(p, end, nStarsInFile))
+    {
+        cerr << "Error reading star count at beginning of input file.\n";
+        return false;
+    }
+
+    auto chunks = splitChunks(p, end, chunkSize << 20);
+    celutil::JobSystem* jobs = celutil::GetJobSystem();
+    size_t batchSize = jobs == nullptr ? 1 : jobs->size();
+
+    fs::path runDir = tempDir.empty() ? fs::path(outputFilename).parent_path() : tempDir;
+    string runPrefix = fs::path(outputFilename).filename().string();
+    vector<fs::path> runPaths;
+    vector<size_t> runSizes(chunks.size(), 0);
+    for (size_t i = 0; i < chunks.size(); i++)
+        runPaths.push_back(runDir / (runPrefix + '.' + to_string(i) + ".tmp"));
+
+    auto removeRuns = [&runPaths]
+    {
+        for (const auto& path : runPaths)
+        {
+            std::error_code ec;
+            fs::remove(path, ec);
+        }
+    };
+
+    // A single chunk is sorted in memory and written directly
+    vector<StarRecord> single;
+    vector<string> errors(chunks.size());
+    bool success = true;
+    for (size_t batch = 0; batch < chunks.size() && success; batch += batchSize)
+    {
+        size_t batchEnd = min(chunks.size(), batch + batchSize);
+        celutil::ParallelFor(batch, batchEnd, 1, [&](size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; i++)
+            {
+                vector<StarRecord> records;
+                if (!parseChunk(chunks[i].first, chunks[i].second, sphericalCoords, records, errors[i]))
+                    continue;
+
+                runSizes[i] = records.size();
+                if (chunks.size() == 1)
+                {
+                    single = move(records);
+                    continue;
+                }
+
+                ofstream run(runPaths[i], ios::out | ios::binary);
+                run.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(StarRecord));
+                if (!run.good())
+                    errors[i] = "Error writing temporary file " + runPaths[i].string();
+            }
+        });
+
+        for (size_t i = batch; i < batchEnd; i++)
+        {
+            if (!errors[i].empty())
+            {
+                cerr << errors[i] << '\n';
+                success = false;
+            }
+        }
+    }
+
+    size_t nStars = 0;
+    for (size_t n : runSizes)
+        nStars += n;
+    if (success && nStars != nStarsInFile)
+        cerr << "Warning: star count " << nStarsInFile << " doesn't match the " << nStars << " stars read\n";
+
+    StarWriter writer(out);
+    if (success)
+        success = writer.writeHeader(static_cast<uint32_t>(nStars));
+    if (success)
+    {
+        if (chunks.size() == 1)
+        {
+            for (const StarRecord& record : single)
+                writer.write(record);
+        }
+        else
+        {
+            success = mergeRuns(runPaths, runSizes, writer);
+        }
+    }
+    if (success)
+        success = writer.flush();
+
+    if (chunks.size() > 1)
+        removeRuns();
+    return success;
+}
+
+
 int main(int argc, char* argv[])
 {
-    if (!parseCommandLine(argc, argv) || inputFilename.empty())
+    if (!parseCommandLine(argc, argv) || inputFilename.empty() || outputFilename.empty())
     {
         Usage();
         return 1;
     }
 
-    ifstream inputFile(inputFilename, ios::in);
-    if (!inputFile.good())
+    celutil::MemoryMappedFile inputFile;
+    if (!inputFile.open(inputFilename, celutil::MemoryMappedFile::AccessHint::Sequential))
     {
         cerr << "Error opening input file " << inputFilename << '\n';
         return 1;
@@ -235,7 +590,10 @@ int main(int argc, char* argv[])
         return 1;
     }
 
-    bool success = WriteStarDatabase(inputFile, stardbFile, useSphericalCoords);
+    celutil::CreateJobSystem(nThreads);
+    bool success = WriteStarDatabase(inputFile.data(), inputFile.data() + inputFile.size(),
+                                     stardbFile, useSphericalCoords);
+    celutil::DestroyJobSystem();
 
     return success ? 0 : 1;
 }
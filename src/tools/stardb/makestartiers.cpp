@@ -0,0 +1,266 @@
+// makestartiers.cpp
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Split a binary star database (.dat) into magnitude tiers: the stars
+// brighter than the first limit, as seen from the Sun, are written to a
+// smaller star database which Celestia loads at startup, and each fainter
+// tier to a star tile file which is only read as the limiting magnitude
+// reaches its stars.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <celcompat/charconv.h>
+#include <celengine/astro.h>
+#include <celengine/stardb.h>
+#include <celutil/binaryread.h>
+#include <celutil/logger.h>
+#include <celutil/mmapfile.h>
+
+using namespace std;
+
+namespace celutil = celestia::util;
+
+
+namespace
+{
+
+constexpr const char FILE_HEADER[] = "CELSTARS";
+constexpr std::size_t HEADER_LENGTH = sizeof(FILE_HEADER) - 1;
+// version, star count
+constexpr std::size_t HEADER_SIZE = HEADER_LENGTH + 6;
+constexpr std::uint16_t MOTION_VERSION = 0x0200;
+
+// The records of the stars of a tier, in the order of the input
+struct Tier
+{
+    float faintest;
+    std::string records;
+    std::uint32_t count{ 0 };
+};
+
+
+void Usage()
+{
+    cerr << "Usage: makestartiers [options] <input star database> <output star database> <output star tiles>...\n";
+    cerr << "  Options:\n";
+    cerr << "    --tiers <m>,<m>...   : faintest apparent magnitude of each tier but the last,\n";
+    cerr << "                           one per output file (default: 6.5,9)\n";
+    cerr << "    --policy <n>,<step>  : octree split policy of the tile files, as for makestartiles\n";
+}
+
+
+template<typename T>
+bool parseNumber(const char* first, const char* last, T& value)
+{
+    auto [ptr, ec] = celestia::compat::from_chars(first, last, value);
+    return ec == errc() && ptr == last;
+}
+
+
+bool parsePolicy(const char* arg, OctreeSplitPolicy& policy)
+{
+    const char* end = arg + strlen(arg);
+    const char* comma = strchr(arg, ',');
+    return comma != nullptr
+        && parseNumber(arg, comma, policy.splitThreshold) && policy.splitThreshold > 0
+        && parseNumber(comma + 1, end, policy.magnitudeStep) && policy.magnitudeStep > 0.0f;
+}
+
+
+// Limits in increasing order of magnitude
+bool parseTiers(const char* arg, vector<float>& limits)
+{
+    limits.clear();
+    const char* end = arg + strlen(arg);
+    while (arg < end)
+    {
+        const char* comma = strchr(arg, ',');
+        if (comma == nullptr)
+            comma = end;
+        float limit;
+        if (!parseNumber(arg, comma, limit) || (!limits.empty() && limit <= limits.back()))
+            return false;
+        limits.push_back(limit);
+        arg = comma == end ? end : comma + 1;
+    }
+    return !limits.empty();
+}
+
+
+// A binary star database with the header of the input and the given records
+std::string makeDatabase(std::uint16_t version, const Tier& tier)
+{
+    std::string data(FILE_HEADER, HEADER_LENGTH);
+    data.push_back(static_cast<char>(version & 0xff));
+    data.push_back(static_cast<char>(version >> 8));
+    for (int shift = 0; shift < 32; shift += 8)
+        data.push_back(static_cast<char>((tier.count >> shift) & 0xff));
+    data += tier.records;
+    return data;
+}
+
+
+bool writeTiles(const std::string& database, const OctreeSplitPolicy& policy, const char* outputFile)
+{
+    StarDatabase starDB;
+    std::istringstream in(database);
+    if (!starDB.loadBinary(in))
+    {
+        cerr << "Error reading the stars of " << outputFile << '\n';
+        return false;
+    }
+    starDB.setOctreeSplitPolicy(policy);
+    starDB.finish();
+
+    ofstream tilesFile(outputFile, ios::out | ios::binary);
+    if (!tilesFile.good())
+    {
+        cerr << "Error opening star tiles file " << outputFile << '\n';
+        return false;
+    }
+    if (!starDB.writeTiles(tilesFile))
+    {
+        cerr << "Error writing star tiles file " << outputFile << '\n';
+        return false;
+    }
+    return true;
+}
+
+} // end unnamed namespace
+
+
+int main(int argc, char* argv[])
+{
+    vector<float> limits{ 6.5f, 9.0f };
+    OctreeSplitPolicy policy = DynamicStarOctree::defaultSplitPolicy;
+    vector<const char*> files;
+    for (int i = 1; i < argc; i++)
+    {
+        if (argv[i][0] != '-')
+        {
+            files.push_back(argv[i]);
+            continue;
+        }
+
+        if (i + 1 == argc)
+        {
+            Usage();
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (!strcmp(argv[i - 1], "--tiers"))
+        {
+            if (!parseTiers(value, limits))
+            {
+                cerr << "Bad magnitude tiers " << value << '\n';
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i - 1], "--policy"))
+        {
+            if (!parsePolicy(value, policy))
+            {
+                cerr << "Bad split policy " << value << '\n';
+                return 1;
+            }
+        }
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    // The input, the star database of the brightest tier and a tile file
+    // for each fainter one
+    if (files.size() != limits.size() + 2)
+    {
+        cerr << "Expected " << limits.size() + 2 << " files for " << limits.size() + 1 << " tiers\n";
+        Usage();
+        return 1;
+    }
+
+    celutil::CreateLogger();
+
+    celutil::MemoryMappedFile file;
+    if (!file.open(files[0], celutil::MemoryMappedFile::AccessHint::Sequential)
+        || file.size() < HEADER_SIZE
+        || std::memcmp(file.data(), FILE_HEADER, HEADER_LENGTH) != 0)
+    {
+        cerr << "Error reading star database " << files[0] << '\n';
+        return 1;
+    }
+
+    auto version = celutil::fromMemoryLE<std::uint16_t>(file.data() + HEADER_LENGTH);
+    auto nStars = celutil::fromMemoryLE<std::uint32_t>(file.data() + HEADER_LENGTH + 2);
+    std::size_t recordSize = version == MOTION_VERSION ? 32 : 20;
+    if ((version != 0x0100 && version != MOTION_VERSION)
+        || (file.size() - HEADER_SIZE) / recordSize < nStars)
+    {
+        cerr << "Bad or truncated star database " << files[0] << '\n';
+        return 1;
+    }
+
+    vector<Tier> tiers;
+    for (float limit : limits)
+        tiers.push_back({ limit, {}, 0 });
+    tiers.push_back({ INFINITY, {}, 0 });
+
+    const char* record = file.data() + HEADER_SIZE;
+    for (std::uint32_t i = 0; i < nStars; ++i, record += recordSize)
+    {
+        Eigen::Vector3f position(celutil::fromMemoryLE<float>(record + 4),
+                                 celutil::fromMemoryLE<float>(record + 8),
+                                 celutil::fromMemoryLE<float>(record + 12));
+        float absMag = static_cast<float>(celutil::fromMemoryLE<std::int16_t>(record + 16)) / 256.0f;
+        // The Sun and stars at its position belong to the brightest tier
+        float distance = std::max(position.norm(), 1.0e-6f);
+        float appMag = astro::absToAppMag(absMag, distance);
+
+        std::size_t tier = 0;
+        while (tier + 1 < tiers.size() && appMag > tiers[tier].faintest)
+            tier++;
+        tiers[tier].records.append(record, recordSize);
+        tiers[tier].count++;
+    }
+
+    for (std::size_t i = 0; i < tiers.size(); i++)
+        cout << files[i + 1] << ": " << tiers[i].count << " stars\n";
+
+    {
+        std::string database = makeDatabase(version, tiers[0]);
+        ofstream out(files[1], ios::out | ios::binary);
+        if (!out.write(database.data(), static_cast<std::streamsize>(database.size())).good())
+        {
+            cerr << "Error writing star database " << files[1] << '\n';
+            return 1;
+        }
+    }
+
+    for (std::size_t i = 1; i < tiers.size(); i++)
+    {
+        if (tiers[i].count == 0)
+        {
+            cerr << "Tier " << i + 1 << " has no stars; skipping " << files[i + 1] << '\n';
+            continue;
+        }
+        if (!writeTiles(makeDatabase(version, tiers[i]), policy, files[i + 1]))
+            return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,90 @@
+// makestartiles.cpp
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Convert a binary star database (.dat) to a star tile file that
+// Celestia reads one octree node at a time.
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+#include <celcompat/charconv.h>
+#include <celengine/stardb.h>
+#include <celutil/logger.h>
+
+using namespace std;
+
+namespace celutil = celestia::util;
+
+
+// Parse the split threshold and magnitude step of --policy
+static bool parsePolicy(const char* arg, OctreeSplitPolicy& policy)
+{
+    const char* end = arg + strlen(arg);
+    const char* comma = strchr(arg, ',');
+    if (comma == nullptr)
+        return false;
+
+    auto [ptr, ec] = celestia::compat::from_chars(arg, comma, policy.splitThreshold);
+    if (ec != errc() || ptr != comma || policy.splitThreshold == 0)
+        return false;
+
+    auto [stepPtr, stepEc] = celestia::compat::from_chars(comma + 1, end, policy.magnitudeStep);
+    return stepEc == errc() && stepPtr == end && policy.magnitudeStep > 0.0f;
+}
+
+
+int main(int argc, char* argv[])
+{
+    OctreeSplitPolicy policy = DynamicStarOctree::defaultSplitPolicy;
+    int first = 1;
+    if (argc == 5 && !strcmp(argv[1], "--policy"))
+    {
+        if (!parsePolicy(argv[2], policy))
+        {
+            cerr << "Bad split policy " << argv[2] << '\n';
+            return 1;
+        }
+        first = 3;
+    }
+    else if (argc != 3)
+    {
+        cerr << "Usage: makestartiles [--policy <n>,<step>] <input star database> <output star tiles>\n";
+        return 1;
+    }
+
+    const char* inputFile = argv[first];
+    const char* outputFile = argv[first + 1];
+
+    celutil::CreateLogger();
+
+    StarDatabase starDB;
+    if (!starDB.loadBinary(fs::path(inputFile)))
+    {
+        cerr << "Error reading star database " << inputFile << '\n';
+        return 1;
+    }
+    starDB.setOctreeSplitPolicy(policy);
+    starDB.finish();
+
+    ofstream tilesFile(outputFile, ios::out | ios::binary);
+    if (!tilesFile.good())
+    {
+        cerr << "Error opening star tiles file " << outputFile << '\n';
+        return 1;
+    }
+
+    if (!starDB.writeTiles(tilesFile))
+    {
+        cerr << "Error writing star tiles file " << outputFile << '\n';
+        return 1;
+    }
+
+    return 0;
+}
@@ -13,18 +13,20 @@
 #include <fstream>
 #include <iomanip>
 #include <string>
-#include <celutil/bytes.h>
+#include <vector>
+#include <celengine/crossindex.h>
 
 using namespace std;
 
 
 static string inputFilename;
 static string outputFilename;
+static bool packed = false;
 
 
 void Usage()
 {
-    cerr << "Usage: makexindex [input file] [output file]\n";
+    cerr << "Usage: makexindex [--packed] [input file] [output file]\n";
 }
 
 
@@ -37,6 +39,12 @@ bool parseCommandLine(int argc, char* argv[])
     {
         if (argv[i][0] == '-')
         {
+            if (string(argv[i]) == "--packed")
+            {
+                packed = true;
+                i++;
+                continue;
+            }
             cerr << "Unknown command line switch: " << argv[i] << '\n';
             return false;
         }
@@ -67,27 +75,9 @@ bool parseCommandLine(int argc, char* argv[])
 }
 
 
-static void writeUint(ostream& out, uint32_t n)
-{
-    LE_TO_CPU_INT32(n, n);
-    out.write(reinterpret_cast<char*>(&n), sizeof n);
-}
-
-
-static void writeShort(ostream& out, int16_t n)
-{
-    LE_TO_CPU_INT16(n, n);
-    out.write(reinterpret_cast<char*>(&n), sizeof n);
-}
-
-
 bool WriteCrossIndex(istream& in, ostream& out)
 {
-    // Write the header
-    out.write("CELINDEX", 8);
-
-    // Write the version
-    writeShort(out, 0x0100);
+    vector<CrossIndexEntry> entries;
 
     unsigned int record = 0;
     while (!in.eof())
@@ -97,7 +87,7 @@ bool WriteCrossIndex(istream& in, ostream& out)
 
         in >> catalogNumber;
         if (in.eof())
-            return true;
+            break;
 
         in >> celCatalogNumber;
         if (!in.good())
@@ -106,13 +96,13 @@ bool WriteCrossIndex(istream& in, ostream& out)
             return false;
         }
 
-        writeUint(out, (uint32_t) catalogNumber);
-        writeUint(out, (uint32_t) celCatalogNumber);
+        entries.push_back({ catalogNumber, celCatalogNumber });
 
         record++;
     }
 
-    return true;
+    // Unpacked cross indices are written in catalog number order
+    return CrossIndex(std::move(entries)).write(out, packed);
 }
 
 
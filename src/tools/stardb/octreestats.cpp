@@ -0,0 +1,291 @@
+// octreestats.cpp
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Build the star octree of a binary star database under several split
+// policies, and report the shape of each tree and the cost of culling it
+// for a set of sample views.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <fmt/ostream.h>
+#include <Eigen/Geometry>
+#include <celcompat/charconv.h>
+#include <celcompat/numbers.h>
+#include <celengine/stardb.h>
+#include <celutil/logger.h>
+#include <celutil/timer.h>
+
+using namespace std;
+
+namespace celutil = celestia::util;
+
+
+namespace
+{
+
+struct View
+{
+    Eigen::Vector3f position;
+    Eigen::Quaternionf orientation;
+};
+
+struct Options
+{
+    fs::path inputFile;
+    vector<OctreeSplitPolicy> policies;
+    unsigned int nViews{ 64 };
+    float radius{ 100.0f };
+    float limitingMag{ 8.0f };
+    float fov{ 45.0f };
+    unsigned int nThreads{ 0 };
+    bool showLevels{ false };
+};
+
+class CountingHandler : public StarHandler
+{
+ public:
+    void process(const Star& /*star*/, float /*distance*/, float /*appMag*/) override
+    {
+        count++;
+    }
+
+    std::uint64_t count{ 0 };
+};
+
+
+void Usage()
+{
+    cerr << "Usage: octreestats [options] <star database>\n";
+    cerr << "  Options:\n";
+    cerr << "    --policy <n>,<step>  : split threshold and magnitude step to compare; may be\n";
+    cerr << "                           repeated (default: the built-in policy and thresholds\n";
+    cerr << "                           of 25, 150 and 300 stars)\n";
+    cerr << "    --views <n>          : number of sample views (default: 64)\n";
+    cerr << "    --radius <ly>        : distance of the views from the Sun (default: 100)\n";
+    cerr << "    --limiting-mag <m>   : faintest apparent magnitude of the views (default: 8)\n";
+    cerr << "    --fov <degrees>      : vertical field of view (default: 45)\n";
+    cerr << "    --threads <n>        : threads building the octree (default: all cores)\n";
+    cerr << "    --levels             : also list the nodes and stars of each level\n";
+}
+
+
+template<typename T>
+bool parseNumber(const char* first, const char* last, T& value)
+{
+    auto [ptr, ec] = celestia::compat::from_chars(first, last, value);
+    return ec == errc() && ptr == last;
+}
+
+
+bool parsePolicy(const char* arg, OctreeSplitPolicy& policy)
+{
+    const char* end = arg + strlen(arg);
+    const char* comma = strchr(arg, ',');
+    if (comma == nullptr)
+        return false;
+
+    unsigned long threshold;
+    if (!parseNumber(arg, comma, threshold) || threshold == 0)
+        return false;
+
+    policy.splitThreshold = static_cast<unsigned int>(threshold);
+    return parseNumber(comma + 1, end, policy.magnitudeStep) && policy.magnitudeStep > 0.0f;
+}
+
+
+bool parseCommandLine(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        if (arg[0] != '-')
+        {
+            if (!options.inputFile.empty())
+                return false;
+            options.inputFile = arg;
+            continue;
+        }
+
+        if (!strcmp(arg, "--levels"))
+        {
+            options.showLevels = true;
+            continue;
+        }
+
+        if (i + 1 == argc)
+        {
+            cerr << arg << " requires a value\n";
+            return false;
+        }
+
+        const char* value = argv[++i];
+        const char* end = value + strlen(value);
+        bool ok;
+        if (!strcmp(arg, "--policy"))
+        {
+            OctreeSplitPolicy policy;
+            ok = parsePolicy(value, policy);
+            if (ok)
+                options.policies.push_back(policy);
+        }
+        else if (!strcmp(arg, "--views"))
+            ok = parseNumber(value, end, options.nViews) && options.nViews > 0;
+        else if (!strcmp(arg, "--radius"))
+            ok = parseNumber(value, end, options.radius) && options.radius >= 0.0f;
+        else if (!strcmp(arg, "--limiting-mag"))
+            ok = parseNumber(value, end, options.limitingMag);
+        else if (!strcmp(arg, "--fov"))
+            ok = parseNumber(value, end, options.fov) && options.fov > 0.0f && options.fov < 180.0f;
+        else if (!strcmp(arg, "--threads"))
+            ok = parseNumber(value, end, options.nThreads);
+        else
+        {
+            cerr << "Unknown command line switch: " << arg << '\n';
+            return false;
+        }
+
+        if (!ok)
+        {
+            cerr << "Bad value for " << arg << ": " << value << '\n';
+            return false;
+        }
+    }
+
+    return !options.inputFile.empty();
+}
+
+
+// Views from random points within radius of the Sun, looking in random
+// directions. The same seed gives every policy the same views.
+vector<View> makeViews(unsigned int nViews, float radius)
+{
+    std::mt19937 rng(1);
+    std::normal_distribution<float> normal;
+    std::uniform_real_distribution<float> uniform;
+
+    vector<View> views;
+    views.reserve(nViews);
+    for (unsigned int i = 0; i < nViews; i++)
+    {
+        Eigen::Vector3f direction(normal(rng), normal(rng), normal(rng));
+        float distance = radius * std::cbrt(uniform(rng));
+        Eigen::Quaternionf orientation(normal(rng), normal(rng), normal(rng), normal(rng));
+        views.push_back({ direction.normalized() * distance, orientation.normalized() });
+    }
+    return views;
+}
+
+
+bool analyze(const Options& options, const OctreeSplitPolicy& policy, const vector<View>& views)
+{
+    StarDatabase starDB;
+    if (!starDB.loadBinary(options.inputFile))
+    {
+        cerr << "Error reading star database " << options.inputFile << '\n';
+        return false;
+    }
+
+    starDB.setLoaderThreads(options.nThreads);
+    starDB.setOctreeSplitPolicy(policy);
+    Timer buildTimer;
+    starDB.finish();
+    double buildTime = buildTimer.getTime();
+
+    vector<OctreeLevelStatistics> levels;
+    starDB.getOctreeStatistics(levels);
+    std::uint64_t nNodes = 0;
+    for (const auto& level : levels)
+        nNodes += level.nodeCount;
+
+    // Traverse once before timing, so that the stars are in the cache as
+    // they would be while rendering
+    float fovY = options.fov * static_cast<float>(celestia::numbers::pi / 180.0);
+    float aspectRatio = 16.0f / 9.0f;
+    CountingHandler warmup;
+    for (const View& view : views)
+        starDB.findVisibleStars(warmup, view.position, view.orientation, fovY, aspectRatio, options.limitingMag);
+
+    CountingHandler handler;
+    OctreeProcStats stats;
+    std::uint64_t nodesVisited = 0;
+    std::uint64_t starsScanned = 0;
+    Timer traversalTimer;
+    for (const View& view : views)
+    {
+        stats = OctreeProcStats();
+        starDB.findVisibleStars(handler, view.position, view.orientation, fovY, aspectRatio, options.limitingMag, &stats);
+        nodesVisited += stats.nodes;
+        starsScanned += stats.objects;
+    }
+    double traversalTime = traversalTimer.getTime();
+
+    double nViews = static_cast<double>(views.size());
+    fmt::print("{:>9} {:>5.3f} {:>9} {:>5} {:>10.1f} {:>7.2f} {:>10.1f} {:>10.1f} {:>10.1f} {:>9.1f}\n",
+               policy.splitThreshold, policy.magnitudeStep,
+               nNodes, levels.size(),
+               static_cast<double>(starDB.size()) / static_cast<double>(nNodes),
+               buildTime,
+               nodesVisited / nViews, starsScanned / nViews, handler.count / nViews,
+               traversalTime * 1.0e6 / nViews);
+
+    if (options.showLevels)
+    {
+        for (std::size_t i = 0; i < levels.size(); i++)
+        {
+            fmt::print("    level {:>2}: {:>12.1f} ly {:>9} nodes {:>10} stars\n",
+                       i, levels[i].size, levels[i].nodeCount, levels[i].objectCount);
+        }
+    }
+
+    return true;
+}
+
+} // end unnamed namespace
+
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseCommandLine(argc, argv, options))
+    {
+        Usage();
+        return 1;
+    }
+
+    if (options.policies.empty())
+    {
+        OctreeSplitPolicy policy = DynamicStarOctree::defaultSplitPolicy;
+        options.policies.push_back(policy);
+        for (unsigned int threshold : { 25u, 150u, 300u })
+        {
+            policy.splitThreshold = threshold;
+            options.policies.push_back(policy);
+        }
+    }
+
+    celutil::CreateLogger();
+
+    vector<View> views = makeViews(options.nViews, options.radius);
+    fmt::print("{} views within {} ly, limiting magnitude {}, {} degree field\n",
+               views.size(), options.radius, options.limitingMag, options.fov);
+    fmt::print("threshold  step     nodes depth stars/node build s nodes/view scans/view stars/view   us/view\n");
+    for (const auto& policy : options.policies)
+    {
+        if (!analyze(options, policy, views))
+            return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,288 @@
+// makevtex.cpp
+//
+// Copyright (C) 2023, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Build a virtual texture from an equirectangular image: the image is
+// resampled to the largest power of two tile pyramid it fills, each
+// coarser level is box filtered from the one above it, and all of the
+// tiles are written to a single tile pack next to the .ctx file.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <celengine/image.h>
+#include <celengine/tilepack.h>
+#include <celutil/jobsystem.h>
+#include <celutil/logger.h>
+
+using namespace std;
+using celestia::PixelFormat;
+
+namespace celutil = celestia::util;
+
+
+namespace
+{
+
+// Rows of the levels computed by each job
+constexpr std::size_t BandRows = 16;
+
+
+// Resample img to width x height with bilinear filtering; the texture
+// wraps around horizontally
+unique_ptr<Image> resample(Image& img, int width, int height)
+{
+    int srcWidth = img.getWidth();
+    int srcHeight = img.getHeight();
+    int components = img.getComponents();
+    auto result = make_unique<Image>(img.getFormat(), width, height);
+
+    float sx = (float) srcWidth / (float) width;
+    float sy = (float) srcHeight / (float) height;
+    celutil::ParallelFor(0, height, BandRows, [&](std::size_t first, std::size_t last)
+    {
+        for (int y = (int) first; y < (int) last; y++)
+        {
+            float fy = std::clamp(((float) y + 0.5f) * sy - 0.5f, 0.0f, (float) (srcHeight - 1));
+            int y0 = (int) fy;
+            int y1 = min(y0 + 1, srcHeight - 1);
+            float ty = fy - (float) y0;
+            const uint8_t* row0 = img.getPixelRow(y0);
+            const uint8_t* row1 = img.getPixelRow(y1);
+            uint8_t* dest = result->getPixelRow(y);
+            for (int x = 0; x < width; x++)
+            {
+                float fx = ((float) x + 0.5f) * sx - 0.5f;
+                float x0f = std::floor(fx);
+                float tx = fx - x0f;
+                int x0 = ((int) x0f + srcWidth) % srcWidth;
+                int x1 = (x0 + 1) % srcWidth;
+                for (int c = 0; c < components; c++)
+                {
+                    float top = row0[x0 * components + c] * (1.0f - tx) + row0[x1 * components + c] * tx;
+                    float bottom = row1[x0 * components + c] * (1.0f - tx) + row1[x1 * components + c] * tx;
+                    dest[x * components + c] = (uint8_t) (top * (1.0f - ty) + bottom * ty + 0.5f);
+                }
+            }
+        }
+    });
+
+    return result;
+}
+
+
+// Box filter img to half of its size
+unique_ptr<Image> halve(Image& img)
+{
+    int width = img.getWidth() / 2;
+    int height = img.getHeight() / 2;
+    int components = img.getComponents();
+    auto result = make_unique<Image>(img.getFormat(), width, height);
+
+    celutil::ParallelFor(0, height, BandRows, [&](std::size_t first, std::size_t last)
+    {
+        for (int y = (int) first; y < (int) last; y++)
+        {
+            const uint8_t* row0 = img.getPixelRow(y * 2);
+            const uint8_t* row1 = img.getPixelRow(y * 2 + 1);
+            uint8_t* dest = result->getPixelRow(y);
+            for (int x = 0; x < width; x++)
+            {
+                int x0 = x * 2 * components;
+                int x1 = x0 + components;
+                for (int c = 0; c < components; c++)
+                {
+                    int sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+                    dest[x * components + c] = (uint8_t) ((sum + 2) / 4);
+                }
+            }
+        }
+    });
+
+    return result;
+}
+
+
+// Write the tiles of one level in the order of TilePack::layout()
+bool writeTiles(ostream& out, Image& level, int tileSize)
+{
+    int rowBytes = tileSize * level.getComponents();
+    int uCount = level.getWidth() / tileSize;
+    int vCount = level.getHeight() / tileSize;
+    for (int v = 0; v < vCount; v++)
+    {
+        for (int u = 0; u < uCount; u++)
+        {
+            for (int y = 0; y < tileSize; y++)
+            {
+                const uint8_t* row = level.getPixelRow(v * tileSize + y) + u * rowBytes;
+                out.write(reinterpret_cast<const char*>(row), rowBytes);
+            }
+        }
+    }
+    return out.good();
+}
+
+
+void usage()
+{
+    cerr << "Usage: makevtex [options] <input image> <output ctx file>\n"
+         << "  --tile-size <n>  size of the tiles, a power of two >= 64 (default 512)\n"
+         << "  --levels <n>     number of levels (default: as many as the image fills)\n"
+         << "  --threads <n>    number of threads (default: all cores)\n"
+         << "The tiles are written to a tile pack with the name of the ctx file\n"
+         << "and the extension .ctp.\n";
+}
+
+} // end unnamed namespace
+
+
+int main(int argc, char* argv[])
+{
+    int tileSize = 512;
+    int nLevels = 0;
+    unsigned int nThreads = 0;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1] == '-'; i++)
+    {
+        string arg(argv[i]);
+        if (i + 1 == argc)
+        {
+            usage();
+            return 1;
+        }
+
+        int value = atoi(argv[++i]);
+        if (arg == "--tile-size")
+            tileSize = value;
+        else if (arg == "--levels")
+            nLevels = value;
+        else if (arg == "--threads")
+            nThreads = (unsigned int) max(value, 0);
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if (argc - i != 2 || tileSize < 64 || (tileSize & (tileSize - 1)) != 0 || nLevels < 0)
+    {
+        usage();
+        return 1;
+    }
+
+    celutil::CreateLogger();
+
+    unique_ptr<Image> img(LoadImageFromFile(argv[i]));
+    if (img == nullptr)
+    {
+        cerr << "Error reading image " << argv[i] << '\n';
+        return 1;
+    }
+
+    if (img->isCompressed())
+    {
+        cerr << "Compressed images aren't supported\n";
+        return 1;
+    }
+
+    // Level 0 is two tiles wide and one high; each level doubles both
+    if (nLevels == 0)
+    {
+        while (tileSize << (nLevels + 1) <= img->getWidth() && nLevels < 13)
+            nLevels++;
+    }
+    if (nLevels == 0 || nLevels > 13)
+    {
+        cerr << "The image must be at least " << tileSize * 2 << " pixels wide\n";
+        return 1;
+    }
+
+    celutil::CreateJobSystem(nThreads);
+
+    // Box filter large reductions before resampling so that no texels are
+    // skipped
+    int width = tileSize << nLevels;
+    while (img->getWidth() >= width * 2 && img->getHeight() >= width &&
+           img->getWidth() % 2 == 0 && img->getHeight() % 2 == 0)
+    {
+        img = halve(*img);
+    }
+    if (img->getWidth() != width || img->getHeight() != width / 2)
+    {
+        cout << "Resampling to " << width << "x" << width / 2 << '\n';
+        img = resample(*img, width, width / 2);
+    }
+
+    // Levels from the finest to the coarsest
+    vector<unique_ptr<Image>> levels;
+    levels.push_back(move(img));
+    for (int level = 1; level < nLevels; level++)
+        levels.push_back(halve(*levels.back()));
+    reverse(levels.begin(), levels.end());
+
+    vector<TilePack::Entry> entries;
+    auto tileBytes = (std::uint64_t) tileSize * tileSize * levels[0]->getComponents();
+    for (int level = 0; level < nLevels; level++)
+    {
+        for (std::uint32_t v = 0; v < (1u << level); v++)
+        {
+            for (std::uint32_t u = 0; u < (2u << level); u++)
+            {
+                entries.push_back({ (std::uint32_t) level, u, v, levels[0]->getFormat(),
+                                    (std::uint32_t) tileSize, (std::uint32_t) tileSize, 1,
+                                    0, tileBytes });
+            }
+        }
+    }
+    TilePack::layout(entries);
+
+    fs::path ctxPath(argv[i + 1]);
+    fs::path packPath = ctxPath;
+    packPath.replace_extension(".ctp");
+
+    ofstream pack(packPath, ios::out | ios::binary);
+    if (!pack.good() || !TilePack::writeIndex(pack, entries))
+    {
+        cerr << "Error writing tile pack " << packPath << '\n';
+        return 1;
+    }
+    for (const auto& level : levels)
+    {
+        if (!writeTiles(pack, *level, tileSize))
+        {
+            cerr << "Error writing tile pack " << packPath << '\n';
+            return 1;
+        }
+    }
+    pack.close();
+
+    ofstream ctx(ctxPath, ios::out);
+    ctx << "VirtualTexture\n"
+        << "{\n"
+        << "    TilePack \"" << packPath.filename().string() << "\"\n"
+        << "    BaseSplit 0\n"
+        << "    TileSize " << tileSize << "\n"
+        << "}\n";
+    if (!ctx.good())
+    {
+        cerr << "Error writing " << ctxPath << '\n';
+        return 1;
+    }
+
+    celutil::DestroyJobSystem();
+    return 0;
+}
@@ -1,10 +1,15 @@
+#include <celcompat/charconv.h>
 #include <celephem/xyzvbinary.h>
 #include <celutil/bytes.h> // __BYTE_ORDER__
 #include <fmt/ostream.h>
+#include <cctype>
 #include <cstring> // memcpy
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <limits> // std::numeric_limits
+#include <string>
+#include <system_error>
 
 using namespace std;
 
@@ -53,6 +58,36 @@ static bool SkipComments(istream& in)
     return in.good();
 }
 
+// Parse a number after white space. Returns false at the end of the text
+// or if the text isn't a number.
+static bool parseNumber(const char*& p, const char* end, double& value)
+{
+    while (p < end && isspace(static_cast<unsigned char>(*p)) != 0)
+        p++;
+    // from_chars doesn't accept a leading plus sign
+    if (p < end && *p == '+')
+        p++;
+
+    auto [ptr, ec] = celestia::compat::from_chars(p, end, value);
+    if (ec != errc())
+        return false;
+
+    p = ptr;
+    return true;
+}
+
+// Parse the next record of a text xyzv file
+static bool parseRecord(const char*& p, const char* end, XYZVBinaryData& data)
+{
+    return parseNumber(p, end, data.tdb) &&
+           parseNumber(p, end, data.position[0]) &&
+           parseNumber(p, end, data.position[1]) &&
+           parseNumber(p, end, data.position[2]) &&
+           parseNumber(p, end, data.velocity[0]) &&
+           parseNumber(p, end, data.velocity[1]) &&
+           parseNumber(p, end, data.velocity[2]);
+}
+
 // Convert text xyzv file to binary file.
 static bool xyzvToBinary(const string& inFilename, const string& outFilename)
 {
@@ -75,21 +110,14 @@ static bool xyzvToBinary(const string& inFilename, const string& outFilename)
     if (!out.write(reinterpret_cast<char*>(&header), sizeof(header)))
         return false;
 
+    string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    const char* p = text.data();
+    const char* end = p + text.size();
+
     uint64_t counter = 0;
     XYZVBinaryData data;
-    while (in.good())
+    while (parseRecord(p, end, data))
     {
-        in >> data.tdb;
-        in >> data.position[0];
-        in >> data.position[1];
-        in >> data.position[2];
-        in >> data.velocity[0];
-        in >> data.velocity[1];
-        in >> data.velocity[2];
-
-        if (!in.good())
-            continue;
-
         if (!out.write(reinterpret_cast<char*>(&data), sizeof(data)))
             break;
         counter++;
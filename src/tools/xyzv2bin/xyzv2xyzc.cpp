@@ -0,0 +1,344 @@
+#include <celcompat/charconv.h>
+#include <celephem/xyzvbinary.h>
+#include <celutil/bytes.h> // __BYTE_ORDER__
+#include <fmt/ostream.h>
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring> // memcpy
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits> // std::numeric_limits
+#include <string>
+#include <system_error>
+#include <vector>
+
+using namespace std;
+
+constexpr char magic[8] = "CELXYZC";
+
+struct Sample
+{
+    double t;
+    double position[3];
+    // km/day, so that it scales with time in days
+    double velocity[3];
+};
+
+// Scan past comments. A comment begins with the # character and ends
+// with a newline. Return true if the stream state is good. The stream
+// position will be at the first non-comment, non-whitespace character.
+static bool SkipComments(istream& in)
+{
+    bool inComment = false;
+    bool done = false;
+
+    int c = in.get();
+    while (!done)
+    {
+        if (in.eof())
+        {
+            done = true;
+        }
+        else
+        {
+            if (inComment)
+            {
+                if (c == '\n')
+                    inComment = false;
+            }
+            else
+            {
+                if (c == '#')
+                {
+                    inComment = true;
+                }
+                else if (isspace(c) == 0)
+                {
+                    in.unget();
+                    done = true;
+                }
+            }
+        }
+
+        if (!done)
+            c = in.get();
+    }
+
+    return in.good();
+}
+
+// Parse a number after white space. Returns false at the end of the text
+// or if the text isn't a number.
+static bool parseNumber(const char*& p, const char* end, double& value)
+{
+    while (p < end && isspace(static_cast<unsigned char>(*p)) != 0)
+        p++;
+    // from_chars doesn't accept a leading plus sign
+    if (p < end && *p == '+')
+        p++;
+
+    auto [ptr, ec] = celestia::compat::from_chars(p, end, value);
+    if (ec != errc())
+        return false;
+
+    p = ptr;
+    return true;
+}
+
+// Parse the next record of a text xyzv file
+static bool parseRecord(const char*& p, const char* end, XYZVBinaryData& data)
+{
+    return parseNumber(p, end, data.tdb) &&
+           parseNumber(p, end, data.position[0]) &&
+           parseNumber(p, end, data.position[1]) &&
+           parseNumber(p, end, data.position[2]) &&
+           parseNumber(p, end, data.velocity[0]) &&
+           parseNumber(p, end, data.velocity[1]) &&
+           parseNumber(p, end, data.velocity[2]);
+}
+
+// Samples out of order or at the time of the previous one are skipped, as
+// Celestia does when it loads the file
+static void addSample(vector<Sample>& samples, const XYZVBinaryData& data)
+{
+    if (!samples.empty() && !(data.tdb > samples.back().t))
+        return;
+
+    Sample s;
+    s.t = data.tdb;
+    for (int k = 0; k < 3; k++)
+    {
+        s.position[k] = data.position[k];
+        s.velocity[k] = data.velocity[k] * 86400.0;
+    }
+    samples.push_back(s);
+}
+
+// Read a text xyzv file, or a binary one written by xyzv2bin
+static bool readSamples(const string& filename, vector<Sample>& samples)
+{
+    ifstream in(filename, ios::in | ios::binary);
+    if (!in.good())
+        return false;
+
+    XYZVBinaryHeader header;
+    if (in.read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+        string(header.magic, strnlen(header.magic, sizeof(header.magic))) == "CELXYZV")
+    {
+        if (header.byteOrder != __BYTE_ORDER__ || header.digits != std::numeric_limits<double>::digits)
+            return false;
+
+        XYZVBinaryData data;
+        for (uint64_t i = 0; i < header.count && in.read(reinterpret_cast<char*>(&data), sizeof(data)); i++)
+            addSample(samples, data);
+        return !samples.empty();
+    }
+
+    in.clear();
+    in.seekg(0);
+    if (!SkipComments(in))
+        return false;
+
+    string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    const char* p = text.data();
+    const char* end = p + text.size();
+
+    XYZVBinaryData data;
+    while (parseRecord(p, end, data))
+        addSample(samples, data);
+
+    return !samples.empty();
+}
+
+// Fit the Chebyshev series of the trajectory from sample first to sample
+// last by least squares to the positions and velocities of the samples, and
+// return the largest error of the series at the samples. Velocity errors
+// are multiplied by the mean time between samples, which bounds how far the
+// series strays from the trajectory between them. Short segments get fewer
+// terms than the degree allows, down to a cubic between two samples.
+static double fitSegment(const vector<Sample>& samples, size_t first, size_t last,
+                         int degree, vector<double>& coefficients)
+{
+    size_t m = last - first + 1;
+    int n = (int) min((size_t) degree + 1, 2 * m);
+    double t0 = samples[first].t;
+    double t1 = samples[last].t;
+    double scale = (t1 - t0) / (double) (m - 1);
+    double dxdt = 2.0 / (t1 - t0);
+
+    // Rows of the values and the derivatives of T_0 ... T_n-1 at the samples
+    Eigen::MatrixXd a(2 * m, n);
+    Eigen::MatrixXd b(2 * m, 3);
+    vector<double> t(max(n, 2));
+    vector<double> u(max(n, 2));
+    for (size_t i = 0; i < m; i++)
+    {
+        const Sample& sample = samples[first + i];
+        double x = dxdt * (sample.t - t0) - 1.0;
+        // Chebyshev polynomials of the first and second kind at x
+        t[0] = 1.0;
+        t[1] = x;
+        u[0] = 1.0;
+        u[1] = 2.0 * x;
+        for (int j = 2; j < n; j++)
+        {
+            t[j] = 2.0 * x * t[j - 1] - t[j - 2];
+            u[j] = 2.0 * x * u[j - 1] - u[j - 2];
+        }
+
+        // The derivative of T_j is j U_j-1
+        for (int j = 0; j < n; j++)
+        {
+            a(2 * i, j) = t[j];
+            a(2 * i + 1, j) = j == 0 ? 0.0 : j * u[j - 1] * dxdt * scale;
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            b(2 * i, k) = sample.position[k];
+            b(2 * i + 1, k) = sample.velocity[k] * scale;
+        }
+    }
+
+    Eigen::MatrixXd c = a.colPivHouseholderQr().solve(b);
+    double maxError = sqrt((a * c - b).rowwise().squaredNorm().maxCoeff());
+
+    coefficients.assign(3 * (degree + 1), 0.0);
+    for (int k = 0; k < 3; k++)
+    {
+        for (int j = 0; j < n; j++)
+            coefficients[k * (degree + 1) + j] = c(j, k);
+    }
+
+    return maxError;
+}
+
+// Convert an xyzv file to Chebyshev segments, each as long as possible
+// while staying within the tolerance of the samples.
+static bool xyzvToChebyshev(const string& inFilename, const string& outFilename,
+                            int degree, double tolerance)
+{
+    vector<Sample> samples;
+    if (!readSamples(inFilename, samples) || samples.size() < 2)
+        return false;
+
+    ofstream out(outFilename, ios::out | ios::binary);
+    if (!out.good())
+        return false;
+
+    XYZCBinaryHeader header;
+    memcpy(header.magic, magic, 8);
+    header.byteOrder = __BYTE_ORDER__;
+    header.digits = std::numeric_limits<double>::digits;
+    header.degree = degree;
+    header.count = 0;
+
+    // write empty header, will update it later
+    if (!out.write(reinterpret_cast<char*>(&header), sizeof(header)))
+        return false;
+
+    vector<double> coefficients;
+    vector<double> fitted;
+    size_t first = 0;
+    size_t step = 1;
+    while (first + 1 < samples.size())
+    {
+        // Grow the segment by doubling its length in samples, starting
+        // from the length of the previous one, then narrow down the longest
+        // one that fits. A segment between two samples is a cubic, which
+        // always fits.
+        size_t good = first + 1;
+        size_t bad = samples.size();
+        fitSegment(samples, first, good, degree, fitted);
+        for (size_t last = min(first + max(step, (size_t) 2), samples.size() - 1); last > good;
+             last = min(first + 2 * (last - first), samples.size() - 1))
+        {
+            if (fitSegment(samples, first, last, degree, coefficients) > tolerance)
+            {
+                bad = last;
+                break;
+            }
+            good = last;
+            fitted.swap(coefficients);
+        }
+        while (bad - good > 1)
+        {
+            size_t mid = good + (bad - good) / 2;
+            if (fitSegment(samples, first, mid, degree, coefficients) > tolerance)
+            {
+                bad = mid;
+            }
+            else
+            {
+                good = mid;
+                fitted.swap(coefficients);
+            }
+        }
+
+        double times[2] = { samples[first].t, samples[good].t };
+        if (!out.write(reinterpret_cast<char*>(times), sizeof(times)) ||
+            !out.write(reinterpret_cast<char*>(fitted.data()), fitted.size() * sizeof(double)))
+        {
+            return false;
+        }
+        header.count++;
+
+        step = good - first;
+        first = good;
+    }
+
+    fmt::print("{} samples in {} segments\n", samples.size(), header.count);
+
+    // write actual header
+    out.seekp(0);
+    return !!out.write(reinterpret_cast<char*>(&header), sizeof(header));
+}
+
+static void usage(const char* name)
+{
+    fmt::print(cerr, "Usage: {} [--degree n] [--tolerance km] infile.xyzv outfile.xyzc\n", name);
+    fmt::print(cerr, "  --degree     degree of the polynomials, 3 to 32 (default 11)\n");
+    fmt::print(cerr, "  --tolerance  largest error at the samples in km (default 0.01)\n");
+    fmt::print(cerr, "The input can also be a binary file written by xyzv2bin.\n");
+}
+
+int main(int argc, char* argv[])
+{
+    int degree = 11;
+    double tolerance = 0.01;
+
+    int i = 1;
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2)
+    {
+        if (strcmp(argv[i], "--degree") == 0)
+        {
+            degree = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--tolerance") == 0)
+        {
+            tolerance = atof(argv[i + 1]);
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (argc - i != 2 || degree < 3 || degree > 32 || !(tolerance > 0.0))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (!xyzvToChebyshev(argv[i], argv[i + 1], degree, tolerance))
+    {
+        fmt::print(cerr, "Error converting {} to {}.\n", argv[i], argv[i + 1]);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+// bench.h
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Benchmarks of Celestia, reported as JSON to compare releases.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <celcompat/filesystem.h>
+
+namespace celestia::bench
+{
+
+// Counters of the allocations made with operator new
+std::uint64_t allocationCount();
+std::uint64_t allocatedBytes();
+
+// Resident memory of the process in kilobytes, or zero if it's unknown
+long currentMemory();
+long peakMemory();
+
+struct MicroResult
+{
+    std::string name;
+    int iterations;
+    double meanNs;
+    double minNs;
+    double allocations; // per iteration
+};
+
+// Run the benchmarks of single functions on data generated with fixed
+// seeds, which don't depend on the data directory.
+std::vector<MicroResult> runMicrobenchmarks();
+
+struct ZoneResult
+{
+    std::string name;
+    bool gpu;
+    int depth;
+    double averageMs;
+    double maximumMs;
+};
+
+struct SceneResult
+{
+    std::string name;
+    int frames;
+    double meanFrameMs;
+    double minFrameMs;
+    double maxFrameMs;
+    double allocations; // per frame
+    double allocatedBytes; // per frame
+    long memory;
+    std::vector<ZoneResult> zones;
+};
+
+struct SceneOptions
+{
+    fs::path configFile;
+    int frames;
+    int width;
+    int height;
+};
+
+// Render the scenes offscreen from the data directory, which must be the
+// current directory. Returns false if rendering isn't possible.
+bool runScenes(const SceneOptions& options, std::vector<SceneResult>& results);
+
+} // end namespace celestia::bench
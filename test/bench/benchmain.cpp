@@ -0,0 +1,292 @@
+// benchmain.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Command line front end of the benchmarks.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include <fmt/format.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+#include "bench.h"
+
+namespace
+{
+
+std::atomic<std::uint64_t> allocations{ 0 };
+std::atomic<std::uint64_t> bytes{ 0 };
+
+} // end unnamed namespace
+
+// The other forms of new and delete of the standard library forward to
+// these ones
+void*
+operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size); p != nullptr)
+        return p;
+    throw std::bad_alloc();
+}
+
+void
+operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void
+operator delete(void* p, std::size_t /*size*/) noexcept
+{
+    std::free(p);
+}
+
+namespace celestia::bench
+{
+
+std::uint64_t
+allocationCount()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+std::uint64_t
+allocatedBytes()
+{
+    return bytes.load(std::memory_order_relaxed);
+}
+
+long
+currentMemory()
+{
+#ifdef _WIN32
+    return 0;
+#else
+    std::FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (statm == nullptr)
+        return 0;
+    long size = 0;
+    long resident = 0;
+    int fields = std::fscanf(statm, "%ld %ld", &size, &resident);
+    std::fclose(statm);
+    return fields == 2 ? resident * (sysconf(_SC_PAGESIZE) / 1024) : 0;
+#endif
+}
+
+long
+peakMemory()
+{
+#ifdef _WIN32
+    return 0;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+namespace
+{
+
+constexpr std::string_view usage =
+    "Usage: celestia-bench [OPTION]...\n"
+    "Run the benchmarks of Celestia and report the results as JSON.\n"
+    "\n"
+    "  --dir DIR          data directory of the scenes\n"
+    "  --conf FILE        configuration file\n"
+    "  --frames N         frames rendered of each scene, 100 by default\n"
+    "  --size WxH         size of the frames, 640x480 by default\n"
+    "  --only KIND        run only the micro or the scenes benchmarks\n"
+    "  --output FILE      JSON file to write instead of the standard output\n";
+
+void
+writeResults(std::ostream& out,
+             const std::vector<MicroResult>& micro,
+             const std::vector<SceneResult>& scenes)
+{
+    out << "{\n  \"micro\": [";
+    for (std::size_t i = 0; i < micro.size(); i++)
+    {
+        const MicroResult& result = micro[i];
+        out << fmt::format("{}\n    {{ \"name\": \"{}\", \"iterations\": {}, \"mean_ns\": {:.0f}, "
+                           "\"min_ns\": {:.0f}, \"allocations\": {:.1f} }}",
+                           i == 0 ? "" : ",",
+                           result.name,
+                           result.iterations,
+                           result.meanNs,
+                           result.minNs,
+                           result.allocations);
+    }
+    out << "\n  ],\n  \"scenes\": [";
+    for (std::size_t i = 0; i < scenes.size(); i++)
+    {
+        const SceneResult& result = scenes[i];
+        out << fmt::format("{}\n    {{\n      \"name\": \"{}\",\n      \"frames\": {},\n"
+                           "      \"mean_frame_ms\": {:.3f},\n      \"min_frame_ms\": {:.3f},\n"
+                           "      \"max_frame_ms\": {:.3f},\n      \"allocations_per_frame\": {:.1f},\n"
+                           "      \"allocated_bytes_per_frame\": {:.0f},\n      \"memory_kb\": {},\n"
+                           "      \"zones\": [",
+                           i == 0 ? "" : ",",
+                           result.name,
+                           result.frames,
+                           result.meanFrameMs,
+                           result.minFrameMs,
+                           result.maxFrameMs,
+                           result.allocations,
+                           result.allocatedBytes,
+                           result.memory);
+        for (std::size_t j = 0; j < result.zones.size(); j++)
+        {
+            const ZoneResult& zone = result.zones[j];
+            out << fmt::format("{}\n        {{ \"name\": \"{}\", \"source\": \"{}\", \"depth\": {}, "
+                               "\"average_ms\": {:.3f}, \"maximum_ms\": {:.3f} }}",
+                               j == 0 ? "" : ",",
+                               zone.name,
+                               zone.gpu ? "gpu" : "cpu",
+                               zone.depth,
+                               zone.averageMs,
+                               zone.maximumMs);
+        }
+        out << "\n      ]\n    }";
+    }
+    out << fmt::format("\n  ],\n  \"peak_memory_kb\": {}\n}}\n", peakMemory());
+}
+
+int
+benchmain(int argc, char** argv)
+{
+    const char* dataDir = std::getenv("CELESTIA_DATA_DIR");
+    if (dataDir == nullptr)
+        dataDir = CONFIG_DATA_DIR;
+
+    SceneOptions options{ {}, 100, 640, 480 };
+    fs::path output;
+    bool runMicro = true;
+    bool runScene = true;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        if (arg == "--help")
+        {
+            std::cout << usage;
+            return 0;
+        }
+
+        if (i + 1 == argc)
+        {
+            std::cerr << fmt::format("Missing value for {}\n", arg) << usage;
+            return 1;
+        }
+
+        std::string_view value = argv[++i];
+        if (arg == "--dir")
+        {
+            dataDir = argv[i];
+        }
+        else if (arg == "--conf")
+        {
+            options.configFile = value;
+        }
+        else if (arg == "--frames")
+        {
+            options.frames = std::atoi(argv[i]);
+        }
+        else if (arg == "--size")
+        {
+            if (std::sscanf(argv[i], "%dx%d", &options.width, &options.height) != 2)
+            {
+                std::cerr << fmt::format("Invalid size {}\n", value);
+                return 1;
+            }
+        }
+        else if (arg == "--only")
+        {
+            runMicro = value == "micro";
+            runScene = value == "scenes";
+            if (!runMicro && !runScene)
+            {
+                std::cerr << fmt::format("Unknown benchmarks {}\n", value) << usage;
+                return 1;
+            }
+        }
+        else if (arg == "--output")
+        {
+            output = value;
+        }
+        else
+        {
+            std::cerr << fmt::format("Unknown option {}\n", arg) << usage;
+            return 1;
+        }
+    }
+
+    std::vector<MicroResult> micro;
+    if (runMicro)
+        micro = runMicrobenchmarks();
+
+    std::vector<SceneResult> scenes;
+    if (runScene)
+    {
+        std::error_code ec;
+        fs::current_path(dataDir, ec);
+        if (ec)
+        {
+            std::cerr << fmt::format("Cannot chdir to {}\n", dataDir);
+            return 1;
+        }
+        if (!runScenes(options, scenes))
+        {
+            std::cerr << "Could not render the scenes\n";
+            if (!runMicro)
+                return 2;
+        }
+    }
+
+    if (output.empty())
+    {
+        writeResults(std::cout, micro, scenes);
+        return 0;
+    }
+
+    std::ofstream out(output);
+    writeResults(out, micro, scenes);
+    if (!out.good())
+    {
+        std::cerr << fmt::format("Error writing {}\n", output.string());
+        return 3;
+    }
+    return 0;
+}
+
+} // end unnamed namespace
+
+} // end namespace celestia::bench
+
+int
+main(int argc, char** argv)
+{
+    return celestia::bench::benchmain(argc, argv);
+}
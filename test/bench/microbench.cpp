@@ -0,0 +1,328 @@
+// microbench.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Benchmarks of single functions on generated data.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string_view>
+#include <system_error>
+#include <Eigen/Geometry>
+#include <fmt/format.h>
+#include <celcompat/numbers.h>
+#include <celengine/stardb.h>
+#include <celengine/stellarclass.h>
+#include <celengine/univcoord.h>
+#include <celephem/samporbit.h>
+#include <celephem/vsop87.h>
+#include <celutil/binarywrite.h>
+#include <celutil/tokenizer.h>
+#include "bench.h"
+
+namespace celestia::bench
+{
+
+namespace
+{
+
+// Every generator starts from the same seed, so the data and the results
+// only change with the code
+constexpr std::uint32_t Seed = 1234567;
+
+constexpr std::uint32_t StarCount = 200000;
+constexpr int CatalogBodies = 2000;
+constexpr int OrbitSamples = 20000;
+constexpr int CoordCount = 100000;
+constexpr double J2000 = 2451545.0;
+
+template<typename F>
+MicroResult
+run(const char* name, int iterations, F&& f)
+{
+    using clock = std::chrono::steady_clock;
+
+    // The results are summed so that the work isn't optimized away
+    double sink = f();
+
+    double total = 0.0;
+    double best = std::numeric_limits<double>::infinity();
+    std::uint64_t allocations = allocationCount();
+    for (int i = 0; i < iterations; i++)
+    {
+        auto start = clock::now();
+        sink += f();
+        double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+        total += ns;
+        best = std::min(best, ns);
+    }
+    allocations = allocationCount() - allocations;
+
+    volatile double result = sink;
+    static_cast<void>(result);
+
+    return { name,
+             iterations,
+             total / iterations,
+             best,
+             static_cast<double>(allocations) / iterations };
+}
+
+// Solar system catalog text with asteroids on elliptical orbits
+std::string
+makeCatalogText(std::mt19937& rng)
+{
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::string text;
+    for (int i = 0; i < CatalogBodies; i++)
+    {
+        text += fmt::format("\"Asteroid {}:A{}\" \"Sol\"\n"
+                            "{{\n"
+                            "    Class \"asteroid\"\n"
+                            "    Radius {:.3f}\n"
+                            "    Color [ {:.3f} {:.3f} {:.3f} ]\n"
+                            "    EllipticalOrbit\n"
+                            "    {{\n"
+                            "        Period {:.6f}\n"
+                            "        SemiMajorAxis {:.6f}\n"
+                            "        Eccentricity {:.6f}\n"
+                            "        Inclination {:.4f}\n"
+                            "        AscendingNode {:.4f}\n"
+                            "        ArgOfPericenter {:.4f}\n"
+                            "        MeanAnomaly {:.4f}\n"
+                            "    }}\n"
+                            "}}\n\n",
+                            i, i,
+                            1.0 + unit(rng) * 100.0,
+                            unit(rng), unit(rng), unit(rng),
+                            3.0 + unit(rng) * 3.0,
+                            2.0 + unit(rng) * 1.5,
+                            unit(rng) * 0.3,
+                            unit(rng) * 30.0,
+                            unit(rng) * 360.0,
+                            unit(rng) * 360.0,
+                            unit(rng) * 360.0);
+    }
+
+    return text;
+}
+
+double
+countTokens(Tokenizer& tokenizer)
+{
+    double count = 0.0;
+    for (;;)
+    {
+        Tokenizer::TokenType type = tokenizer.nextToken();
+        if (type == Tokenizer::TokenEnd || type == Tokenizer::TokenError)
+            return count;
+        count += 1.0;
+    }
+}
+
+// Binary star database of stars in a cube of 2000 light years
+std::string
+makeStarDatabase(std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+    std::uniform_real_distribution<float> magnitude(-5.0f, 15.0f);
+    std::uniform_int_distribution<int> spectralClass(StellarClass::Spectral_O, StellarClass::Spectral_M);
+    std::uniform_int_distribution<unsigned int> subclass(0, 9);
+
+    std::ostringstream out(std::ios::out | std::ios::binary);
+    out.write("CELSTARS", 8);
+    util::writeLE<std::uint16_t>(out, 0x0100);
+    util::writeLE<std::uint32_t>(out, StarCount);
+    for (std::uint32_t i = 0; i < StarCount; i++)
+    {
+        StellarClass sc(StellarClass::NormalStar,
+                        static_cast<StellarClass::SpectralClass>(spectralClass(rng)),
+                        subclass(rng),
+                        StellarClass::Lum_V);
+        util::writeLE<std::uint32_t>(out, i + 1);
+        util::writeLE<float>(out, position(rng));
+        util::writeLE<float>(out, position(rng));
+        util::writeLE<float>(out, position(rng));
+        util::writeLE<std::int16_t>(out, static_cast<std::int16_t>(magnitude(rng) * 256.0f));
+        util::writeLE<std::uint16_t>(out, sc.packV1());
+    }
+
+    return out.str();
+}
+
+class StarCounter : public StarHandler
+{
+ public:
+    void process(const Star& /*star*/, float /*distance*/, float /*appMag*/) override
+    {
+        count++;
+    }
+
+    std::size_t count{ 0 };
+};
+
+// Trajectory sampled every half day on an inclined circular orbit
+void
+writeTrajectory(const fs::path& path)
+{
+    std::ofstream out(path);
+    out << "# celestia-bench trajectory\n";
+    for (int i = 0; i < OrbitSamples; i++)
+    {
+        double t = J2000 + i * 0.5;
+        double angle = 2.0 * numbers::pi * (t - J2000) / 365.25;
+        out << fmt::format("{:.6f} {:.3f} {:.3f} {:.3f}\n",
+                           t,
+                           1.496e8 * std::cos(angle),
+                           1.496e8 * std::sin(angle) * std::cos(0.1),
+                           1.496e8 * std::sin(angle) * std::sin(0.1));
+    }
+}
+
+std::vector<double>
+makeTimes(std::mt19937& rng, double start, double end, std::size_t count)
+{
+    std::uniform_real_distribution<double> time(start, end);
+    std::vector<double> times(count);
+    std::generate(times.begin(), times.end(), [&]() { return time(rng); });
+    return times;
+}
+
+} // end unnamed namespace
+
+std::vector<MicroResult>
+runMicrobenchmarks()
+{
+    std::vector<MicroResult> results;
+    std::mt19937 rng(Seed);
+
+    std::string catalog = makeCatalogText(rng);
+    results.push_back(run("tokenizer/buffer", 20, [&catalog]()
+    {
+        Tokenizer tokenizer{ std::string_view(catalog) };
+        return countTokens(tokenizer);
+    }));
+    results.push_back(run("tokenizer/stream", 20, [&catalog]()
+    {
+        std::istringstream in(catalog);
+        Tokenizer tokenizer(&in);
+        return countTokens(tokenizer);
+    }));
+
+    std::string stars = makeStarDatabase(rng);
+    fs::path starsPath = fs::temp_directory_path() / "celestia-bench-stars.dat";
+    {
+        std::ofstream out(starsPath, std::ios::out | std::ios::binary);
+        out.write(stars.data(), static_cast<std::streamsize>(stars.size()));
+    }
+    results.push_back(run("stardb/loadBinary/file", 10, [&starsPath]()
+    {
+        StarDatabase db;
+        return db.loadBinary(starsPath) ? static_cast<double>(db.size()) : 0.0;
+    }));
+    results.push_back(run("stardb/loadBinary/stream", 10, [&stars]()
+    {
+        std::istringstream in(stars, std::ios::in | std::ios::binary);
+        StarDatabase db;
+        return db.loadBinary(in) ? static_cast<double>(db.size()) : 0.0;
+    }));
+
+    StarDatabase db;
+    if (db.loadBinary(starsPath))
+    {
+        db.finish();
+
+        // Views in the 26 directions of a cube's faces, edges and corners
+        // from the center and from off the center of the stars
+        std::vector<std::pair<Eigen::Vector3f, Eigen::Quaternionf>> views;
+        for (const Eigen::Vector3f& position : { Eigen::Vector3f(0.0f, 0.0f, 0.0f), Eigen::Vector3f(700.0f, -300.0f, 200.0f) })
+        {
+            for (int x = -1; x <= 1; x++)
+                for (int y = -1; y <= 1; y++)
+                    for (int z = -1; z <= 1; z++)
+                    {
+                        if (x == 0 && y == 0 && z == 0)
+                            continue;
+                        Eigen::Vector3f direction = Eigen::Vector3f(x, y, z).normalized();
+                        views.emplace_back(position, Eigen::Quaternionf::FromTwoVectors(direction, -Eigen::Vector3f::UnitZ()));
+                    }
+        }
+
+        results.push_back(run("octree/findVisibleStars", 20, [&db, &views]()
+        {
+            StarCounter counter;
+            for (const auto& [position, orientation] : views)
+                db.findVisibleStars(counter, position, orientation, 0.8f, 1.5f, 8.0f);
+            return static_cast<double>(counter.count);
+        }));
+    }
+    std::error_code ec;
+    fs::remove(starsPath, ec);
+
+    std::unique_ptr<Orbit> earth(CreateVSOP87Orbit("vsop87-earth"));
+    std::vector<double> times = makeTimes(rng, J2000 - 36525.0, J2000 + 36525.0, 1000);
+    if (earth != nullptr)
+    {
+        results.push_back(run("vsop87/earth", 20, [&earth, &times]()
+        {
+            double sum = 0.0;
+            for (double t : times)
+                sum += earth->positionAtTime(t).x();
+            return sum;
+        }));
+    }
+
+    fs::path trajectoryPath = fs::temp_directory_path() / "celestia-bench-orbit.xyz";
+    writeTrajectory(trajectoryPath);
+    results.push_back(run("sampledorbit/load", 10, [&trajectoryPath]()
+    {
+        std::unique_ptr<Orbit> orbit(LoadSampledTrajectoryDoublePrec(trajectoryPath, TrajectoryInterpolationCubic));
+        return orbit != nullptr ? orbit->getPeriod() : 0.0;
+    }));
+
+    std::unique_ptr<Orbit> sampled(LoadSampledTrajectoryDoublePrec(trajectoryPath, TrajectoryInterpolationCubic));
+    if (sampled != nullptr)
+    {
+        std::vector<double> sampleTimes = makeTimes(rng, J2000, J2000 + OrbitSamples * 0.5, 10000);
+        results.push_back(run("sampledorbit/positionAtTime", 20, [&sampled, &sampleTimes]()
+        {
+            double sum = 0.0;
+            for (double t : sampleTimes)
+                sum += sampled->positionAtTime(t).x();
+            return sum;
+        }));
+    }
+    fs::remove(trajectoryPath, ec);
+
+    // Bodies within a few hundred AU of a star 50 light years away
+    std::uniform_real_distribution<double> offset(-5.0e10, 5.0e10);
+    UniversalCoord star = UniversalCoord::CreateLy(Eigen::Vector3d(30.0, -40.0, 5.0));
+    std::vector<UniversalCoord> coords(CoordCount);
+    for (UniversalCoord& uc : coords)
+        uc = star.offsetKm(Eigen::Vector3d(offset(rng), offset(rng), offset(rng)));
+    UniversalCoord observer = star.offsetKm(Eigen::Vector3d(1.5e8, 0.0, 0.0));
+    std::vector<Eigen::Vector3d> offsets(CoordCount);
+    results.push_back(run("univcoord/offsetsFromKm", 20, [&coords, &observer, &offsets]()
+    {
+        UniversalCoord::OffsetsFromKm(coords, observer, offsets.data());
+        double sum = 0.0;
+        for (const Eigen::Vector3d& v : offsets)
+            sum += v.x();
+        return sum;
+    }));
+
+    return results;
+}
+
+} // end namespace celestia::bench
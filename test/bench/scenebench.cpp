@@ -0,0 +1,214 @@
+// scenebench.cpp
+//
+// Copyright (C) 2023, the Celestia Development Team
+//
+// Benchmarks of rendering scenes along fixed camera paths.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "bench.h"
+
+#ifdef CELESTIA_BENCH_SCENES
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <limits>
+#include <Eigen/Geometry>
+#include <celengine/body.h>
+#include <celengine/render.h>
+#include <celengine/simulation.h>
+#include <celestia/celestiacore.h>
+#include <celmath/mathlib.h>
+#include <celutil/logger.h>
+#include <celutil/profiler.h>
+#include "headlessrenderer.h"
+
+using celestia::util::GetLogger;
+using celestia::util::Profiler;
+
+namespace celestia::bench
+{
+
+namespace
+{
+
+// All scenes are rendered at 2022-01-01 00:00 TDB
+constexpr double SceneTime = 2459580.5;
+constexpr int WarmupFrames = 10;
+
+struct Scene
+{
+    const char* name;
+    const char* target;
+    // Distance from the target in radii of the target
+    double distance;
+    float latitude;
+    float fov;
+    std::uint64_t renderFlags;
+    int orbitMask;
+    float faintestVisible;
+    // Rotation of the observer about the target in each frame
+    float degreesPerFrame;
+};
+
+const std::array<Scene, 4> scenes
+{
+    Scene
+    {
+        // About 7 light years from the Sun, without automatic magnitude
+        "deep-star-field", "Sol", 1.0e8, 20.0f, 60.0f,
+        Renderer::ShowStars | Renderer::ShowGalaxies,
+        0, 10.0f, 0.5f,
+    },
+    {
+        "saturn-rings", "Sol/Saturn", 3.0, 15.0f, 45.0f,
+        Renderer::DefaultRenderFlags | Renderer::ShowRingShadows,
+        0, 7.0f, 1.0f,
+    },
+    {
+        "galaxies-wide", "Milky Way", 20.0, 30.0f, 90.0f,
+        Renderer::ShowStars | Renderer::ShowGalaxies | Renderer::ShowGlobulars | Renderer::ShowOpenClusters,
+        0, 7.0f, 0.5f,
+    },
+    {
+        "asteroid-belt", "Sol", 1000.0, 30.0f, 60.0f,
+        Renderer::DefaultRenderFlags | Renderer::ShowOrbits,
+        Body::Planet | Body::DwarfPlanet | Body::Asteroid,
+        7.0f, 0.5f,
+    },
+};
+
+bool
+setupScene(CelestiaCore& core, const Scene& scene)
+{
+    Simulation* sim = core.getSimulation();
+    Renderer* renderer = core.getRenderer();
+
+    sim->setTime(SceneTime);
+    sim->setPauseState(true);
+    sim->setFaintestVisible(scene.faintestVisible);
+    renderer->setRenderFlags(scene.renderFlags);
+    renderer->setOrbitMask(scene.orbitMask);
+    renderer->setLabelMode(Renderer::NoLabels);
+
+    Selection target = sim->findObjectFromPath(scene.target);
+    if (target.empty())
+    {
+        GetLogger()->warn("Object {} of scene {} not found.\n", scene.target, scene.name);
+        return false;
+    }
+
+    sim->setSelection(target);
+    sim->gotoSelectionLongLat(0.0,
+                              target.radius() * scene.distance,
+                              0.0f,
+                              celmath::degToRad(scene.latitude),
+                              Eigen::Vector3f::UnitY());
+    sim->update(0.0);
+    sim->follow();
+    return true;
+}
+
+} // end unnamed namespace
+
+bool
+runScenes(const SceneOptions& options, std::vector<SceneResult>& results)
+{
+    using clock = std::chrono::steady_clock;
+
+    // The zones are only timed when the profiler exists before the
+    // renderer is created
+    Profiler* profiler = util::GetProfiler();
+    if (profiler == nullptr)
+        profiler = util::CreateProfiler();
+
+    auto renderer = HeadlessRenderer::create(-1, options.configFile);
+    if (renderer == nullptr)
+        return false;
+
+    // The statistics of the profiler only cover its history
+    int frames = std::clamp(options.frames, 1, static_cast<int>(Profiler::HistorySize));
+
+    RenderRequest request;
+    request.width = options.width;
+    request.height = options.height;
+
+    CelestiaCore* core = renderer->getCore();
+    for (const Scene& scene : scenes)
+    {
+        if (!setupScene(*core, scene))
+            continue;
+
+        request.fov = scene.fov;
+        for (int i = 0; i < WarmupFrames; i++)
+            renderer->render(request);
+
+        Eigen::Quaternionf step(Eigen::AngleAxisf(celmath::degToRad(scene.degreesPerFrame),
+                                                  Eigen::Vector3f::UnitY()));
+
+        SceneResult result;
+        result.name = scene.name;
+        result.frames = frames;
+        result.minFrameMs = std::numeric_limits<double>::infinity();
+        result.maxFrameMs = 0.0;
+
+        double total = 0.0;
+        std::uint64_t allocations = allocationCount();
+        std::uint64_t bytes = allocatedBytes();
+        for (int i = 0; i < frames; i++)
+        {
+            profiler->beginFrame();
+            core->getSimulation()->orbit(step);
+
+            auto start = clock::now();
+            renderer->render(request);
+            double ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+            total += ms;
+            result.minFrameMs = std::min(result.minFrameMs, ms);
+            result.maxFrameMs = std::max(result.maxFrameMs, ms);
+        }
+        result.allocations = static_cast<double>(allocationCount() - allocations) / frames;
+        result.allocatedBytes = static_cast<double>(allocatedBytes() - bytes) / frames;
+        result.meanFrameMs = total / frames;
+        result.memory = currentMemory();
+
+        // The GPU times of the last frames are read in the next one
+        profiler->beginFrame();
+        renderer->render(request);
+
+        for (const auto& zone : profiler->getStats(static_cast<std::size_t>(frames)))
+        {
+            result.zones.push_back({ zone.name,
+                                     zone.source == Profiler::Source::GPU,
+                                     zone.depth,
+                                     zone.average,
+                                     zone.maximum });
+        }
+
+        results.push_back(std::move(result));
+    }
+
+    return true;
+}
+
+} // end namespace celestia::bench
+
+#else
+
+namespace celestia::bench
+{
+
+bool
+runScenes(const SceneOptions& /*options*/, std::vector<SceneResult>& /*results*/)
+{
+    return false;
+}
+
+} // end namespace celestia::bench
+
+#endif
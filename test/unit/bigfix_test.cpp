@@ -0,0 +1,76 @@
+#include <cmath>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celengine/univcoord.h>
+#include <celutil/bigfix.h>
+
+#include <catch.hpp>
+
+TEST_CASE("BigFix", "[BigFix]")
+{
+    SECTION("Conversion from and to double")
+    {
+        for (double d : { 0.0, 1.0, -1.0, 0.5, -0.25, 0x1p-40, -0x1p-60,
+                          123456789.123456789, -987654321.0078125, 0x1p62, -0x1p62 })
+        {
+            REQUIRE(static_cast<double>(BigFix(d)) == d);
+        }
+    }
+
+    SECTION("Fractions of negative values keep their precision")
+    {
+        // A few meters in micro-light years; the differences are exact
+        double x = 1.0 + 3.0e-10;
+        BigFix f = BigFix(1.0) - BigFix(x);
+        REQUIRE(static_cast<double>(f) == 1.0 - x);
+    }
+
+    SECTION("Carry and borrow between the words")
+    {
+        BigFix a(0.75);
+        BigFix b(0.5);
+        REQUIRE(static_cast<double>(a + b) == 1.25);
+        REQUIRE(static_cast<double>(b - a) == -0.25);
+        REQUIRE(static_cast<double>(a - b - a - b) == -1.0);
+
+        BigFix c = b;
+        c -= a;
+        REQUIRE(c == b - a);
+        c += a;
+        REQUIRE(c == b);
+    }
+
+    SECTION("Comparison")
+    {
+        REQUIRE(BigFix(-2.0) < BigFix(-1.5));
+        REQUIRE(BigFix(-0.5) < BigFix(0.25));
+        REQUIRE(BigFix(3.0) > BigFix(2.75));
+        REQUIRE(!(BigFix(1.0) < BigFix(1.0)));
+    }
+
+    SECTION("Multiplication")
+    {
+        REQUIRE(static_cast<double>(BigFix(1.0e12) * BigFix(0.5)) == 5.0e11);
+        REQUIRE(static_cast<double>(BigFix(-1.0e12) * BigFix(0.25)) == -2.5e11);
+        REQUIRE(static_cast<double>(BigFix(-3.0) * BigFix(-0.5)) == 1.5);
+        REQUIRE(static_cast<double>(BigFix(1.0e10) * 0.125) == 1.25e9);
+    }
+}
+
+TEST_CASE("UniversalCoord offsets", "[UniversalCoord]")
+{
+    UniversalCoord origin = UniversalCoord::CreateLy(Eigen::Vector3d(8.6, -2.0, 0.25));
+    std::vector<UniversalCoord> coords;
+    for (int i = 0; i < 10; i++)
+        coords.push_back(origin.offsetKm(Eigen::Vector3d(i * 1.0e6, -i * 0.001, i * i * 1.5e8)));
+
+    std::vector<Eigen::Vector3d> offsets(coords.size());
+    UniversalCoord::OffsetsFromKm(coords, origin, offsets.data());
+    for (std::size_t i = 0; i < coords.size(); i++)
+    {
+        REQUIRE(offsets[i] == coords[i].offsetFromKm(origin));
+        REQUIRE(offsets[i].x() == Approx(i * 1.0e6).margin(1.0e-5));
+    }
+}
@@ -0,0 +1,69 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <celutil/blockarray.h>
+#include <celutil/catalogalloc.h>
+
+#include <catch.hpp>
+
+using celestia::util::CatalogAllocator;
+using celestia::util::CatalogVector;
+using celestia::util::HugePageMode;
+using celestia::util::LargeCatalogAllocation;
+
+TEST_CASE("Catalog allocations", "[CatalogAllocator]")
+{
+    HugePageMode mode = GENERATE(HugePageMode::Off, HugePageMode::Transparent, HugePageMode::Explicit);
+    HugePageMode previous = celestia::util::getHugePageMode();
+    celestia::util::setHugePageMode(mode);
+
+    SECTION("Small and large arrays are usable")
+    {
+        for (std::size_t count : { std::size_t(10), LargeCatalogAllocation / sizeof(std::uint64_t) + 1 })
+        {
+            auto array = celestia::util::makeCatalogArray<std::uint64_t>(count);
+            REQUIRE(reinterpret_cast<std::uintptr_t>(array.get()) % alignof(std::max_align_t) == 0);
+            REQUIRE(array.get_deleter().size() == count);
+            REQUIRE(array[0] == 0);
+            REQUIRE(array[count - 1] == 0);
+            for (std::size_t i = 0; i < count; i++)
+                array[i] = i;
+            REQUIRE(array[count - 1] == count - 1);
+        }
+    }
+
+    SECTION("Vectors grow across the large allocation threshold")
+    {
+        CatalogVector<int> v;
+        for (int i = 0; i < static_cast<int>(LargeCatalogAllocation / sizeof(int)) * 2; i++)
+            v.push_back(i);
+        REQUIRE(v.front() == 0);
+        REQUIRE(v.back() == static_cast<int>(v.size()) - 1);
+    }
+
+    SECTION("Block array elements keep their address")
+    {
+        BlockArray<std::string, CatalogAllocator<std::string>> strings(7);
+        REQUIRE(strings.blockSize() == 7);
+
+        std::string first = "a string longer than the small string buffer";
+        strings.add(first);
+        const std::string* address = &strings[0];
+        for (int i = 1; i < 100; i++)
+        {
+            std::string s = std::to_string(i);
+            strings.add(s);
+        }
+
+        REQUIRE(strings.size() == 100);
+        REQUIRE(&strings[0] == address);
+        REQUIRE(strings[0] == first);
+        REQUIRE(strings[99] == "99");
+
+        strings.clear();
+        REQUIRE(strings.size() == 0);
+    }
+
+    celestia::util::setHugePageMode(previous);
+}
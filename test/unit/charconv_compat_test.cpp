@@ -322,3 +322,51 @@ TEMPLATE_TEST_CASE("Floating point format failures", "[charconv][floating-point]
         REQUIRE(length == example.length);
     }
 }
+
+TEST_CASE("Floating point rounding", "[charconv][floating-point]")
+{
+    SECTION("double")
+    {
+        TestCase<double> examples[] = {
+            { "0.1", 3, 0x1.999999999999ap-4, 3 },
+            { "9007199254740993", 16, 0x1p53, 16 },
+            { "9007199254740993.0000000000000000001", 36, 0x1.0000000000001p53, 36 },
+            { "1e23", 4, 0x1.52d02c7e14af6p76, 4 },
+            { "3.14159265358979323846264338327950288", 36, 0x1.921fb54442d18p1, 36 },
+            { "2.2250738585072014e-308", 23, 0x1p-1022, 23 },
+            { "1.7976931348623157e308", 22, 0x1.fffffffffffffp1023, 22 },
+            { "-6.02214076e23", 14, -0x1.fe185ca57c517p78, 14 },
+        };
+
+        for (const auto& example : examples)
+        {
+            double actual;
+            auto result = celcompat::from_chars(example.source, example.source + example.size, actual);
+            REQUIRE(result.ec == std::errc{});
+            REQUIRE(actual == example.expected);
+            auto length = static_cast<std::size_t>(result.ptr - example.source);
+            REQUIRE(length == example.length);
+        }
+    }
+
+    SECTION("float")
+    {
+        TestCase<float> examples[] = {
+            { "0.1", 3, 0x1.99999ap-4f, 3 },
+            { "16777217", 8, 0x1p24f, 8 },
+            { "1.00000005960464477550", 22, 0x1.000002p0f, 22 },
+            { "7.038531e-26", 12, 0x1.5c87fap-84f, 12 },
+            { "3.4028234e38", 12, 0x1.fffffep127f, 12 },
+        };
+
+        for (const auto& example : examples)
+        {
+            float actual;
+            auto result = celcompat::from_chars(example.source, example.source + example.size, actual);
+            REQUIRE(result.ec == std::errc{});
+            REQUIRE(actual == example.expected);
+            auto length = static_cast<std::size_t>(result.ptr - example.source);
+            REQUIRE(length == example.length);
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#include <string>
+
+#include <celestia/clustersync.h>
+
+#include <catch.hpp>
+
+using celestia::ClusterFrameState;
+
+TEST_CASE("ClusterFrameState", "[ClusterFrameState]")
+{
+    ClusterFrameState state;
+    state.tdb = 2451545.25;
+    state.timeScale = -100.0;
+    state.paused = true;
+    state.lightTimeDelay = false;
+    state.position = UniversalCoord(BigFix(1.0e12), BigFix(-2.5e3), BigFix(0.125));
+    state.orientation = Eigen::Quaterniond(0.5, -0.5, 0.5, 0.5);
+    state.fov = 0.75f;
+    state.renderFlags = 0x123456789abcdefULL;
+    state.labelMode = 7;
+    state.orbitMask = -1;
+    state.ambientLight = 0.1f;
+    state.faintestVisible = 6.5f;
+    state.selection = "Sol:Earth:Moon";
+
+    std::string data = state.encode();
+
+    SECTION("Decoded states are the states encoded")
+    {
+        ClusterFrameState decoded;
+        REQUIRE(decoded.decode(data));
+        REQUIRE(decoded.tdb == state.tdb);
+        REQUIRE(decoded.timeScale == state.timeScale);
+        REQUIRE(decoded.paused);
+        REQUIRE_FALSE(decoded.lightTimeDelay);
+        REQUIRE(decoded.position.x == state.position.x);
+        REQUIRE(decoded.position.y == state.position.y);
+        REQUIRE(decoded.position.z == state.position.z);
+        REQUIRE(decoded.orientation.coeffs() == state.orientation.coeffs());
+        REQUIRE(decoded.fov == state.fov);
+        REQUIRE(decoded.renderFlags == state.renderFlags);
+        REQUIRE(decoded.labelMode == 7);
+        REQUIRE(decoded.orbitMask == -1);
+        REQUIRE(decoded.ambientLight == state.ambientLight);
+        REQUIRE(decoded.faintestVisible == state.faintestVisible);
+        REQUIRE(decoded.selection == state.selection);
+    }
+
+    SECTION("Truncated states are not decoded")
+    {
+        ClusterFrameState decoded;
+        REQUIRE_FALSE(decoded.decode(std::string_view(data).substr(0, data.size() - 1)));
+        REQUIRE_FALSE(decoded.decode({}));
+    }
+}
@@ -0,0 +1,98 @@
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include <celengine/crossindex.h>
+#include <celutil/binarywrite.h>
+
+#include <catch.hpp>
+
+namespace celutil = celestia::util;
+
+namespace
+{
+
+constexpr AstroCatalog::IndexNumber INVALID = AstroCatalog::InvalidIndex;
+
+std::vector<CrossIndexEntry> makeEntries()
+{
+    std::mt19937 rng(42);
+    std::vector<CrossIndexEntry> entries;
+    // Odd numbers only, so that even numbers are missing
+    for (AstroCatalog::IndexNumber i = 0; i < 5000; i++)
+        entries.push_back({ 2 * i + 1, i * 7 });
+    std::shuffle(entries.begin(), entries.end(), rng);
+    return entries;
+}
+
+void checkIndex(const CrossIndex& xindex)
+{
+    REQUIRE(xindex.size() == 5000);
+    REQUIRE(xindex.find(0) == INVALID);
+    REQUIRE(xindex.find(10001) == INVALID);
+    std::vector<AstroCatalog::IndexNumber> numbers;
+    for (AstroCatalog::IndexNumber i = 0; i <= 10000; i++)
+    {
+        AstroCatalog::IndexNumber expected = i % 2 == 1 ? (i / 2) * 7 : INVALID;
+        REQUIRE(xindex.find(i) == expected);
+        numbers.push_back(i);
+    }
+
+    std::vector<AstroCatalog::IndexNumber> results(numbers.size());
+    xindex.find(numbers.data(), numbers.size(), results.data());
+    for (std::size_t i = 0; i < numbers.size(); i++)
+        REQUIRE(results[i] == xindex.find(numbers[i]));
+
+    REQUIRE(xindex.findCatalogNumber(7 * 123) == 247);
+    REQUIRE(xindex.findCatalogNumber(3) == INVALID);
+}
+
+} // end unnamed namespace
+
+TEST_CASE("CrossIndex", "[CrossIndex]")
+{
+    SECTION("Lookups")
+    {
+        for (std::size_t n : { 0, 1, 2, 3, 7, 8, 100 })
+        {
+            std::vector<CrossIndexEntry> entries;
+            for (AstroCatalog::IndexNumber i = 0; i < n; i++)
+                entries.push_back({ i * 10, i });
+            CrossIndex xindex(entries);
+            for (AstroCatalog::IndexNumber i = 0; i < n * 10 + 5; i++)
+                REQUIRE(xindex.find(i) == (i % 10 == 0 && i < n * 10 ? i / 10 : INVALID));
+        }
+
+        checkIndex(CrossIndex(makeEntries()));
+    }
+
+    SECTION("Files")
+    {
+        std::ostringstream unsorted(std::ios::out | std::ios::binary);
+        unsorted.write("CELINDEX", 8);
+        celutil::writeLE<std::uint16_t>(unsorted, CrossIndex::FILE_VERSION);
+        for (const CrossIndexEntry& entry : makeEntries())
+        {
+            celutil::writeLE<std::uint32_t>(unsorted, entry.catalogNumber);
+            celutil::writeLE<std::uint32_t>(unsorted, entry.celCatalogNumber);
+        }
+
+        std::istringstream in(unsorted.str(), std::ios::in | std::ios::binary);
+        auto xindex = CrossIndex::read(in);
+        REQUIRE(xindex != nullptr);
+        checkIndex(*xindex);
+
+        for (bool packed : { false, true })
+        {
+            std::ostringstream out(std::ios::out | std::ios::binary);
+            REQUIRE(xindex->write(out, packed));
+            std::istringstream written(out.str(), std::ios::in | std::ios::binary);
+            auto copy = CrossIndex::read(written);
+            REQUIRE(copy != nullptr);
+            checkIndex(*copy);
+        }
+
+        std::istringstream truncated(unsorted.str().substr(0, 15), std::ios::in | std::ios::binary);
+        REQUIRE(CrossIndex::read(truncated) == nullptr);
+    }
+}
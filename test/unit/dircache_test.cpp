@@ -0,0 +1,66 @@
+#include <array>
+#include <fstream>
+
+#include <celutil/dircache.h>
+
+#include <catch.hpp>
+
+using celestia::util::DirectoryCache;
+
+namespace
+{
+
+void
+touch(const fs::path& p)
+{
+    std::ofstream f(p);
+    f << "x";
+}
+
+} // end unnamed namespace
+
+TEST_CASE("DirectoryCache", "[DirectoryCache]")
+{
+    fs::path dir = fs::temp_directory_path() / "celestia_dircache_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir / "sub");
+    touch(dir / "earth.png");
+    touch(dir / "moon.jpg");
+
+    DirectoryCache cache;
+
+    SECTION("Files are found in their listing")
+    {
+        REQUIRE(cache.exists(dir / "earth.png"));
+        REQUIRE(cache.exists(dir / "moon.jpg"));
+        REQUIRE_FALSE(cache.exists(dir / "mars.png"));
+        REQUIRE_FALSE(cache.exists(dir / "sub"));
+        REQUIRE(cache.size() == 1);
+    }
+
+    SECTION("Missing directories are cached empty")
+    {
+        REQUIRE_FALSE(cache.exists(dir / "lores" / "earth.png"));
+        REQUIRE_FALSE(cache.exists(dir / "lores" / "moon.jpg"));
+        REQUIRE(cache.size() == 1);
+    }
+
+    SECTION("Wildcards resolve to the first extension found")
+    {
+        std::array<const char*, 3> extensions = { "dds", "jpg", "png" };
+        REQUIRE(cache.resolveWildcard(dir / "earth.*", extensions) == dir / "earth.png");
+        REQUIRE(cache.resolveWildcard(dir / "moon.*", extensions) == dir / "moon.jpg");
+        REQUIRE(cache.resolveWildcard(dir / "mars.*", extensions).empty());
+    }
+
+    SECTION("New files are seen after invalidation")
+    {
+        REQUIRE_FALSE(cache.exists(dir / "mars.png"));
+        touch(dir / "mars.png");
+        REQUIRE_FALSE(cache.exists(dir / "mars.png"));
+        cache.invalidate(dir);
+        REQUIRE(cache.exists(dir / "mars.png"));
+    }
+
+    fs::remove_all(dir);
+}
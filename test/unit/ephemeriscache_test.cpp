@@ -0,0 +1,69 @@
+#include <memory>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celengine/ephemeriscache.h>
+#include <celengine/selection.h>
+#include <celengine/star.h>
+#include <celephem/orbit.h>
+#include <celephem/rotation.h>
+
+#include <catch.hpp>
+
+TEST_CASE("Ephemeris cache shares identical objects", "[EphemerisCache]")
+{
+    EphemerisCache cache;
+
+    SECTION("Orbits")
+    {
+        Orbit* fixed = cache.fixedOrbit(Eigen::Vector3d(1.0, 2.0, 3.0));
+        REQUIRE(cache.fixedOrbit(Eigen::Vector3d(1.0, 2.0, 3.0)) == fixed);
+        REQUIRE(cache.fixedOrbit(Eigen::Vector3d(1.0, 2.0, 3.5)) != fixed);
+        REQUIRE(fixed->positionAtTime(0.0) == Eigen::Vector3d(1.0, 2.0, 3.0));
+
+        Orbit* elliptical = cache.ellipticalOrbit(1.0, 0.1, 0.2, 0.3, 0.4, 0.5, 365.25, 2451545.0);
+        REQUIRE(cache.ellipticalOrbit(1.0, 0.1, 0.2, 0.3, 0.4, 0.5, 365.25, 2451545.0) == elliptical);
+        REQUIRE(cache.ellipticalOrbit(1.0, 0.1, 0.2, 0.3, 0.4, 0.5, 365.25, 2451546.0) != elliptical);
+        REQUIRE(elliptical->getPeriod() == 365.25);
+
+        REQUIRE(cache.requestCount() == 6);
+        REQUIRE(cache.createdCount() == 4);
+    }
+
+    SECTION("Rotation models")
+    {
+        RotationModel* fixed = cache.constantOrientation(Eigen::Quaterniond::Identity());
+        REQUIRE(cache.constantOrientation(Eigen::Quaterniond::Identity()) == fixed);
+        REQUIRE(cache.constantOrientation(Eigen::Quaterniond(0.0, 1.0, 0.0, 0.0)) != fixed);
+
+        RotationModel* uniform = cache.uniformRotation(1.0, 0.0f, 2451545.0, 0.0f, 0.0f);
+        REQUIRE(cache.uniformRotation(1.0, 0.0f, 2451545.0, 0.0f, 0.0f) == uniform);
+        REQUIRE(cache.uniformRotation(2.0, 0.0f, 2451545.0, 0.0f, 0.0f) != uniform);
+        REQUIRE(uniform->getPeriod() == 1.0);
+
+        // Rotation models and orbits with the same parameters are distinct
+        REQUIRE(cache.createdCount() == 4);
+    }
+
+    SECTION("Frames are shared while they're in use")
+    {
+        Star sun;
+        Star other;
+
+        auto ecliptic = cache.j2000EclipticFrame(Selection(&sun));
+        REQUIRE(cache.j2000EclipticFrame(Selection(&sun)) == ecliptic);
+        REQUIRE(cache.j2000EclipticFrame(Selection(&other)) != ecliptic);
+        REQUIRE(cache.j2000EquatorFrame(Selection(&sun)) != ecliptic);
+        REQUIRE(ecliptic->getCenter() == Selection(&sun));
+
+        auto bodyFixed = cache.bodyFixedFrame(Selection(&sun), Selection(&sun));
+        REQUIRE(cache.bodyFixedFrame(Selection(&sun), Selection(&sun)) == bodyFixed);
+        REQUIRE(cache.bodyFixedFrame(Selection(&sun), Selection(&other)) != bodyFixed);
+
+        std::weak_ptr<const ReferenceFrame> released = ecliptic;
+        ecliptic.reset();
+        REQUIRE(released.expired());
+        REQUIRE(cache.j2000EclipticFrame(Selection(&sun)) != nullptr);
+    }
+}
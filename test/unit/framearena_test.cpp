@@ -0,0 +1,59 @@
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <celutil/framearena.h>
+
+#include <catch.hpp>
+
+using celestia::util::ArenaAllocator;
+using celestia::util::ArenaVector;
+using celestia::util::FrameArena;
+
+TEST_CASE("FrameArena allocations", "[FrameArena]")
+{
+    FrameArena arena(256);
+
+    SECTION("Alignment")
+    {
+        arena.allocate(1, 1);
+        void* p = arena.allocate(8, 8);
+        REQUIRE(reinterpret_cast<std::uintptr_t>(p) % 8 == 0);
+        p = arena.allocate(16, 16);
+        REQUIRE(reinterpret_cast<std::uintptr_t>(p) % 16 == 0);
+    }
+
+    SECTION("Strings")
+    {
+        std::string s = "a label longer than the small string buffer";
+        std::string_view copy = arena.copy(s);
+        REQUIRE(copy == s);
+        REQUIRE(copy.data() != s.data());
+        REQUIRE(arena.copy(std::string_view()).empty());
+    }
+
+    SECTION("Steady state frames don't allocate blocks")
+    {
+        auto frame = [&arena]
+        {
+            ArenaVector<int> v{ ArenaAllocator<int>(arena) };
+            for (int i = 0; i < 1000; i++)
+                v.push_back(i);
+            REQUIRE(v[999] == 999);
+        };
+
+        frame();
+        REQUIRE(arena.blockAllocations() > 1);
+        REQUIRE(arena.used() >= 1000 * sizeof(int));
+
+        arena.reset();
+        REQUIRE(arena.used() == 0);
+        std::size_t blocks = arena.blockAllocations();
+        for (int i = 0; i < 10; i++)
+        {
+            frame();
+            arena.reset();
+        }
+        REQUIRE(arena.blockAllocations() == blocks);
+    }
+}
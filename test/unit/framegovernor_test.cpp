@@ -0,0 +1,79 @@
+#include <celengine/framegovernor.h>
+
+#include <catch.hpp>
+
+namespace
+{
+
+constexpr double Target = 1.0 / 60.0;
+
+FrameGovernor::Settings
+makeSettings()
+{
+    FrameGovernor::Settings settings;
+    settings.targetFrameTime = static_cast<float>(Target);
+    settings.minResolutionScale = 0.5f;
+    settings.minDetail = 0.25f;
+    return settings;
+}
+
+void
+addFrames(FrameGovernor& governor, double seconds, int count)
+{
+    for (int i = 0; i < count; i++)
+        governor.addFrameTime(seconds);
+}
+
+} // end unnamed namespace
+
+TEST_CASE("FrameGovernor", "[FrameGovernor]")
+{
+    SECTION("Frames within the band change nothing")
+    {
+        FrameGovernor governor(makeSettings());
+        addFrames(governor, Target, 1000);
+        REQUIRE(governor.getResolutionScale() == 1.0f);
+        REQUIRE(governor.getDetail() == 1.0f);
+    }
+
+    SECTION("Slow frames lower the resolution, then the detail")
+    {
+        FrameGovernor governor(makeSettings());
+
+        addFrames(governor, Target * 2.0, 10);
+        REQUIRE(governor.getResolutionScale() < 1.0f);
+        REQUIRE(governor.getDetail() == 1.0f);
+
+        float lastScale = governor.getResolutionScale();
+        while (governor.getResolutionScale() > 0.5f)
+        {
+            addFrames(governor, Target * 2.0, 20);
+            REQUIRE(governor.getResolutionScale() < lastScale);
+            lastScale = governor.getResolutionScale();
+        }
+        REQUIRE(governor.getResolutionScale() == Approx(0.5f));
+
+        addFrames(governor, Target * 2.0, 1000);
+        REQUIRE(governor.getResolutionScale() == Approx(0.5f));
+        REQUIRE(governor.getDetail() == Approx(0.25f));
+    }
+
+    SECTION("Fast frames restore the detail, then the resolution")
+    {
+        FrameGovernor governor(makeSettings());
+        addFrames(governor, Target * 2.0, 1000);
+        REQUIRE(governor.getDetail() == Approx(0.25f));
+
+        // A short run of fast frames isn't enough
+        addFrames(governor, Target * 0.5, 20);
+        REQUIRE(governor.getDetail() == Approx(0.25f));
+
+        addFrames(governor, Target * 0.5, 100);
+        REQUIRE(governor.getDetail() > 0.25f);
+        REQUIRE(governor.getResolutionScale() == Approx(0.5f));
+
+        addFrames(governor, Target * 0.5, 10000);
+        REQUIRE(governor.getDetail() == 1.0f);
+        REQUIRE(governor.getResolutionScale() == Approx(1.0f));
+    }
+}
@@ -0,0 +1,97 @@
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <celmath/frustum.h>
+
+#include <catch.hpp>
+
+using celmath::Frustum;
+
+namespace
+{
+
+constexpr int OBJECT_COUNT = 1001;
+
+Frustum makeFrustum(bool infinite)
+{
+    Frustum frustum = infinite
+        ? Frustum(0.8f, 1.5f, 1.0f)
+        : Frustum(0.8f, 1.5f, 1.0f, 100.0f);
+    // Tilt the frustum so that none of the planes is axis-aligned
+    frustum.transform(Eigen::AngleAxisf(0.3f, Eigen::Vector3f(1.0f, 2.0f, 3.0f).normalized()).toRotationMatrix());
+    return frustum;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Frustum batch tests", "[Frustum]")
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> coord(-120.0f, 120.0f);
+    std::uniform_real_distribution<float> size(0.0f, 20.0f);
+
+    for (bool infinite : { true, false })
+    {
+        Frustum frustum = makeFrustum(infinite);
+
+        SECTION(infinite ? "Spheres, infinite" : "Spheres, finite")
+        {
+            std::vector<Eigen::Vector3f> centers;
+            std::vector<float> radii;
+            for (int i = 0; i < OBJECT_COUNT; i++)
+            {
+                centers.emplace_back(coord(rng), coord(rng), coord(rng));
+                radii.push_back(size(rng));
+            }
+
+            std::vector<std::uint32_t> visible;
+            frustum.testSpheres(centers.data(), radii.data(), centers.size(), visible);
+            REQUIRE(visible.size() == (OBJECT_COUNT + 31) / 32);
+
+            for (int i = 0; i < OBJECT_COUNT; i++)
+            {
+                bool expected = frustum.testSphere(centers[i], radii[i]) != Frustum::Outside;
+                REQUIRE(Frustum::isVisible(visible, i) == expected);
+            }
+
+            // Bits past the last object stay clear
+            REQUIRE((visible.back() >> (OBJECT_COUNT % 32)) == 0);
+        }
+
+        SECTION(infinite ? "Boxes, infinite" : "Boxes, finite")
+        {
+            std::vector<Eigen::AlignedBox3f> boxes;
+            for (int i = 0; i < OBJECT_COUNT; i++)
+            {
+                Eigen::Vector3f corner(coord(rng), coord(rng), coord(rng));
+                Eigen::Vector3f extent(size(rng), size(rng), size(rng));
+                boxes.emplace_back(corner, corner + extent);
+            }
+
+            std::vector<std::uint32_t> visible;
+            frustum.testBoxes(boxes.data(), boxes.size(), visible);
+
+            for (int i = 0; i < OBJECT_COUNT; i++)
+            {
+                const Eigen::AlignedBox3f& box = boxes[i];
+
+                // A box with a corner inside the frustum must be visible
+                bool cornerInside = false;
+                for (int c = 0; c < 8; c++)
+                {
+                    auto corner = box.corner(static_cast<Eigen::AlignedBox3f::CornerType>(c));
+                    if (frustum.test(corner) == Frustum::Inside)
+                        cornerInside = true;
+                }
+                if (cornerInside)
+                    REQUIRE(Frustum::isVisible(visible, i));
+
+                // A box whose bounding sphere is outside must be culled
+                float radius = box.sizes().norm() * 0.5f;
+                if (frustum.testSphere(box.center(), radius) == Frustum::Outside)
+                    REQUIRE(!Frustum::isVisible(visible, i));
+            }
+        }
+    }
+}
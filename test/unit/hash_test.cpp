@@ -100,4 +100,23 @@ TEST_CASE("AssociativeArray", "[AssociativeArray]")
             REQUIRE(c.alpha() == Approx(0x78 / 255.).epsilon(EPSILON));
         }
     }
+    SECTION("Keys")
+    {
+        AssociativeArray h;
+        h.addValue("Radius", *new Value(2.0));
+        h.addValue("Mass", *new Value(3.0));
+        h.addValue("Radius", *new Value(5.0));
+
+        double radius = 0.0;
+        REQUIRE(h.getNumber("Radius", radius));
+        REQUIRE(radius == 2.0);
+        REQUIRE(h.getValue("Albedo") == nullptr);
+
+        auto iter = h.begin();
+        REQUIRE(iter->first == "Mass");
+        ++iter;
+        REQUIRE(iter->first == "Radius");
+        ++iter;
+        REQUIRE(iter == h.end());
+    }
 }
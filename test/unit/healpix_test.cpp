@@ -0,0 +1,54 @@
+#include <cmath>
+#include <cstdint>
+
+#include <celcompat/numbers.h>
+#include <celmath/healpix.h>
+
+#include <catch.hpp>
+
+using celmath::HealpixNestedToVector;
+using celmath::HealpixPixelCount;
+
+TEST_CASE("HEALPix nested pixels", "[HEALPix]")
+{
+    constexpr double eps = 1.0e-12;
+
+    SECTION("Pixel counts")
+    {
+        REQUIRE(HealpixPixelCount(0) == 12);
+        REQUIRE(HealpixPixelCount(3) == 768);
+        REQUIRE(HealpixPixelCount(9) == UINT64_C(3145728));
+    }
+
+    SECTION("Centres of base pixels")
+    {
+        Eigen::Vector3d north = HealpixNestedToVector(0, 0);
+        REQUIRE(north.z() == Approx(2.0 / 3.0).margin(eps));
+        REQUIRE(std::atan2(north.y(), north.x()) == Approx(celestia::numbers::pi / 4.0).margin(eps));
+
+        Eigen::Vector3d equator = HealpixNestedToVector(0, 4);
+        REQUIRE(equator.isApprox(Eigen::Vector3d::UnitX(), eps));
+
+        Eigen::Vector3d south = HealpixNestedToVector(0, 11);
+        REQUIRE(south.z() == Approx(-2.0 / 3.0).margin(eps));
+    }
+
+    SECTION("North corners of the northern base pixels are the pole")
+    {
+        for (std::uint64_t pixel = 0; pixel < 4; pixel++)
+            REQUIRE(HealpixNestedToVector(0, pixel, 1.0, 1.0).isApprox(Eigen::Vector3d::UnitZ(), eps));
+    }
+
+    SECTION("Children meet at the centre of their parent")
+    {
+        for (std::uint64_t pixel = 0; pixel < HealpixPixelCount(2); pixel++)
+        {
+            Eigen::Vector3d centre = HealpixNestedToVector(2, pixel);
+            REQUIRE(centre.norm() == Approx(1.0).margin(eps));
+            REQUIRE(HealpixNestedToVector(3, pixel * 4, 1.0, 1.0).isApprox(centre, eps));
+            REQUIRE(HealpixNestedToVector(3, pixel * 4 + 1, 0.0, 1.0).isApprox(centre, eps));
+            REQUIRE(HealpixNestedToVector(3, pixel * 4 + 2, 1.0, 0.0).isApprox(centre, eps));
+            REQUIRE(HealpixNestedToVector(3, pixel * 4 + 3, 0.0, 0.0).isApprox(centre, eps));
+        }
+    }
+}
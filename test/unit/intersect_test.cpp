@@ -0,0 +1,72 @@
+#include <cmath>
+#include <random>
+#include <celmath/intersect.h>
+
+#include <catch.hpp>
+
+using namespace celmath;
+
+TEST_CASE("isOccluded", "[isOccluded]")
+{
+    Sphered planet(Eigen::Vector3d(0.0, 0.0, -10.0), 2.0);
+
+    SECTION("An object straight behind the occluder is hidden")
+    {
+        REQUIRE(isOccluded(planet, Sphered(Eigen::Vector3d(0.0, 0.0, -20.0), 1.0)));
+        REQUIRE(isOccluded(planet, Sphered(Eigen::Vector3d(0.5, 0.5, -100.0), 5.0)));
+    }
+
+    SECTION("An object in front of or beside the occluder isn't hidden")
+    {
+        REQUIRE(!isOccluded(planet, Sphered(Eigen::Vector3d(0.0, 0.0, -5.0), 1.0)));
+        REQUIRE(!isOccluded(planet, Sphered(Eigen::Vector3d(5.0, 0.0, -20.0), 1.0)));
+        REQUIRE(!isOccluded(planet, Sphered(Eigen::Vector3d(0.0, 0.0, 20.0), 1.0)));
+    }
+
+    SECTION("An object partly behind the occluder isn't hidden")
+    {
+        REQUIRE(!isOccluded(planet, Sphered(Eigen::Vector3d(0.0, 0.0, -20.0), 5.0)));
+        REQUIRE(!isOccluded(planet, Sphered(Eigen::Vector3d(0.0, 0.0, -9.0), 1.5)));
+    }
+
+    SECTION("Nothing is hidden from a viewer inside a sphere")
+    {
+        REQUIRE(!isOccluded(Sphered(Eigen::Vector3d(0.0, 0.0, -1.0), 2.0),
+                            Sphered(Eigen::Vector3d(0.0, 0.0, -20.0), 0.1)));
+        REQUIRE(!isOccluded(planet, Sphered(Eigen::Vector3d(0.0, 0.0, -0.5), 1.0)));
+    }
+
+    SECTION("Every point of a hidden object is behind the occluder")
+    {
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<double> coord(-4.0, 4.0);
+        std::uniform_real_distribution<double> depth(-40.0, -8.0);
+        std::uniform_real_distribution<double> radius(0.01, 2.0);
+        std::uniform_real_distribution<double> unit(-1.0, 1.0);
+
+        int hidden = 0;
+        for (int i = 0; i < 10000; i++)
+        {
+            Sphered object(Eigen::Vector3d(coord(rng), coord(rng), depth(rng)), radius(rng));
+            if (!isOccluded(planet, object))
+                continue;
+            hidden++;
+
+            for (int j = 0; j < 20; j++)
+            {
+                Eigen::Vector3d dir(unit(rng), unit(rng), unit(rng));
+                if (dir.squaredNorm() < 1.0e-6)
+                    continue;
+                Eigen::Vector3d point = object.center + dir.normalized() * object.radius;
+
+                // The ray from the viewer to the point must hit the
+                // occluder before it reaches the point
+                Eigen::ParametrizedLine<double, 3> ray(Eigen::Vector3d::Zero(), point);
+                double distance = 0.0;
+                REQUIRE(testIntersection(ray, planet, distance));
+                REQUIRE(distance < 1.0);
+            }
+        }
+        REQUIRE(hidden > 0);
+    }
+}
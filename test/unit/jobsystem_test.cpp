@@ -0,0 +1,78 @@
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include <celutil/jobsystem.h>
+
+#include <catch.hpp>
+
+using namespace celestia::util;
+
+TEST_CASE("Job system", "[JobSystem]")
+{
+    SECTION("Without a job system groups run inline")
+    {
+        REQUIRE(GetJobSystem() == nullptr);
+        auto id = std::this_thread::get_id();
+        bool sameThread = false;
+        TaskGroup group;
+        group.run([&] { sameThread = std::this_thread::get_id() == id; });
+        group.wait();
+        REQUIRE(sameThread);
+    }
+
+    SECTION("Parallel for covers the range once")
+    {
+        CreateJobSystem(4);
+        std::vector<std::atomic<int>> counts(10000);
+        ParallelFor(0, counts.size(), 64, [&](std::size_t first, std::size_t last)
+        {
+            for (std::size_t i = first; i < last; i++)
+                counts[i]++;
+        });
+        for (const auto& count : counts)
+            REQUIRE(count.load() == 1);
+        DestroyJobSystem();
+    }
+
+    SECTION("Nested groups")
+    {
+        CreateJobSystem(2);
+        std::atomic<int> total{ 0 };
+        TaskGroup outer;
+        for (int i = 0; i < 8; i++)
+        {
+            outer.run([&total]
+            {
+                TaskGroup inner;
+                for (int j = 0; j < 100; j++)
+                    inner.run([&total] { total++; });
+                inner.wait();
+            });
+        }
+        outer.wait();
+        REQUIRE(total.load() == 800);
+        DestroyJobSystem();
+    }
+
+    SECTION("Render thread jobs")
+    {
+        JobSystem jobs(2);
+        std::atomic<int> done{ 0 };
+        int ranOnRenderThread = 0;
+        for (int i = 0; i < 10; i++)
+        {
+            jobs.submit([&]
+            {
+                jobs.runOnRenderThread([&ranOnRenderThread] { ranOnRenderThread++; });
+                done++;
+            }, JobPriority::Streaming);
+        }
+        while (done.load() < 10)
+            std::this_thread::yield();
+        REQUIRE(jobs.runRenderThreadJobs() == 10);
+        REQUIRE(ranOnRenderThread == 10);
+        REQUIRE(jobs.runRenderThreadJobs() == 0);
+    }
+}
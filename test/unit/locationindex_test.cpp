@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celengine/location.h>
+#include <celengine/locationindex.h>
+
+#include <catch.hpp>
+
+namespace
+{
+
+constexpr float Radius = 1737.0f;
+
+// Return true if the segment from a to b passes through the sphere of
+// the given radius around the origin
+bool
+segmentHitsSphere(const Eigen::Vector3d& a, const Eigen::Vector3d& b, double radius)
+{
+    Eigen::Vector3d d = b - a;
+    double t = std::clamp(-a.dot(d) / d.squaredNorm(), 0.0, 1.0);
+    return (a + t * d).norm() < radius;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("LocationIndex", "[LocationIndex]")
+{
+    std::mt19937 rng(7);
+    std::normal_distribution<float> direction;
+    std::exponential_distribution<float> size(0.05f);
+    std::uniform_int_distribution<int> type(0, 3);
+
+    std::vector<Location> storage(5000);
+    std::vector<Location*> locations;
+    for (Location& location : storage)
+    {
+        Eigen::Vector3f v(direction(rng), direction(rng), direction(rng));
+        location.setPosition(v.normalized() * Radius);
+        location.setSize(size(rng));
+        location.setFeatureType(static_cast<Location::FeatureType>(Location::Crater << type(rng)));
+        locations.push_back(&location);
+    }
+    // Importance overrides the size
+    storage[10].setImportance(5000.0f);
+
+    LocationIndex index(locations);
+    REQUIRE(index.size() == locations.size());
+
+    const std::uint64_t featureTypes = Location::Crater | Location::Mons | Location::Vallis;
+    const double minSizePerDistance = 0.002;
+
+    auto passes = [&](const Location& location, const LocationIndex::Query& query)
+    {
+        Eigen::Vector3d position = location.getPosition().cast<double>();
+        Eigen::Vector3d offset = position - query.viewerPosition;
+        double effSize = location.getImportance() < 0.0f ? location.getSize() : location.getImportance();
+        return (location.getFeatureType() & featureTypes) != 0 &&
+               effSize > minSizePerDistance * offset.norm() &&
+               offset.dot(query.viewDirection) > 0.0 &&
+               !segmentHitsSphere(query.viewerPosition, position * 1.0001, Radius);
+    };
+
+    for (double distance : { 1800.0, 3000.0, 20000.0 })
+    {
+        Eigen::Vector3d viewer = Eigen::Vector3d(0.3, -1.0, 0.2).normalized() * distance;
+
+        LocationIndex::Query query;
+        query.viewerPosition = viewer;
+        query.viewDirection = -viewer.normalized();
+        query.minSizePerDistance = minSizePerDistance;
+        query.featureTypes = featureTypes;
+        query.occluderRadius = Radius;
+
+        std::vector<const Location*> found;
+        index.find(query, found);
+
+        // In the order of the locations
+        REQUIRE(std::is_sorted(found.begin(), found.end()));
+
+        std::size_t expected = 0;
+        for (const Location* location : locations)
+        {
+            if (!passes(*location, query))
+                continue;
+            expected++;
+            REQUIRE(std::binary_search(found.begin(), found.end(), location));
+        }
+
+        REQUIRE(expected > 0);
+        REQUIRE(found.size() < locations.size() / 2);
+    }
+}
@@ -1,5 +1,7 @@
 #include <catch.hpp>
 #include <sstream>
+#include <thread>
+#include <vector>
 #include <iostream>
 #include <celutil/logger.h>
 
@@ -155,3 +157,87 @@ TEST_CASE("logger", "[logger]")
         REQUIRE(log.str().empty());
     }
 }
+
+TEST_CASE("async logger", "[logger]")
+{
+    SECTION("Written by flush")
+    {
+        std::ostringstream err, log;
+        auto *logger = new Logger(Level::Info, log, err);
+        logger->startAsync(false);
+
+        logger->info("hello {}\n", "world");
+        logger->warn("number={}\n", 123);
+        REQUIRE(log.str().empty());
+        REQUIRE(err.str().empty());
+
+        logger->flush();
+        REQUIRE(log.str() == "hello world\n");
+        REQUIRE(err.str() == "number=123\n");
+        CLEAR(err);
+
+        // Errors are written at once
+        logger->error("failed\n");
+        REQUIRE(err.str() == "failed\n");
+
+        logger->info("last\n");
+        logger->stopAsync();
+        REQUIRE(log.str() == "hello world\nlast\n");
+        delete logger;
+    }
+
+    SECTION("Written by the background thread and producers")
+    {
+        std::ostringstream err, log;
+        auto *logger = new Logger(Level::Info, log, err);
+        logger->startAsync();
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++)
+        {
+            threads.emplace_back([logger, t]
+            {
+                for (int i = 0; i < 5000; i++)
+                    logger->info("{} {}\n", t, i);
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        logger->stopAsync();
+
+        std::istringstream lines(log.str());
+        std::vector<int> next(4, 0);
+        int t, i;
+        while (lines >> t >> i)
+        {
+            // Each thread's messages stay in order
+            REQUIRE(i == next[t]);
+            next[t]++;
+        }
+        for (int n : next)
+            REQUIRE(n == 5000);
+        delete logger;
+    }
+}
+
+TEST_CASE("repeat limit", "[logger]")
+{
+    std::ostringstream err, log;
+    auto *logger = new Logger(Level::Info, log, err);
+    logger->setRepeatLimit(2);
+
+    for (int i = 0; i < 5; i++)
+        logger->warn("duplicate {}\n", i);
+    for (int i = 0; i < 3; i++)
+        logger->error("error {}\n", i);
+    REQUIRE(err.str() == "duplicate 0\nduplicate 1\nerror 0\nerror 1\nerror 2\n");
+
+    logger->flush();
+    REQUIRE(log.str() == "3 more messages like \"duplicate {}\" were suppressed\n");
+
+    // The counts restart after a flush
+    CLEAR(err);
+    logger->warn("duplicate {}\n", 5);
+    REQUIRE(err.str() == "duplicate 5\n");
+    delete logger;
+}
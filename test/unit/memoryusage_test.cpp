@@ -0,0 +1,37 @@
+#include <string>
+#include <vector>
+
+#include <celutil/memoryusage.h>
+
+#include <catch.hpp>
+
+using celestia::util::MemoryUsage;
+
+TEST_CASE("MemoryUsage totals", "[MemoryUsage]")
+{
+    MemoryUsage root("root", 10);
+    REQUIRE(root.total() == 10);
+
+    auto& catalog = root.add("catalog", 100, 5);
+    catalog.add("index", 20);
+    catalog.add("names", 30);
+    root.add("cache", 40);
+
+    REQUIRE(root.children.size() == 2);
+    REQUIRE(root.children[0].name == "catalog");
+    REQUIRE(root.children[0].count == 5);
+    REQUIRE(root.children[0].total() == 150);
+    REQUIRE(root.total() == 200);
+}
+
+TEST_CASE("MemoryUsage container estimates", "[MemoryUsage]")
+{
+    std::vector<int> v;
+    REQUIRE(celestia::util::VectorMemory(v) == 0);
+    v.reserve(16);
+    REQUIRE(celestia::util::VectorMemory(v) == v.capacity() * sizeof(int));
+
+    REQUIRE(celestia::util::StringMemory(std::string()) == 0);
+    std::string s(1000, 'x');
+    REQUIRE(celestia::util::StringMemory(s) > 1000);
+}
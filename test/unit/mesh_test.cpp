@@ -0,0 +1,290 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celmodel/material.h>
+#include <celmodel/mesh.h>
+
+#include <catch.hpp>
+
+namespace
+{
+
+constexpr unsigned int GridSize = 24;
+
+// Build an unindexed grid of quads with its triangles in random order, so
+// that every vertex appears several times and the triangle order makes
+// poor use of the vertex cache.
+cmod::Mesh makeGrid()
+{
+    std::vector<std::array<float, 3>> triangles;
+    for (unsigned int i = 0; i < GridSize; i++)
+    {
+        for (unsigned int j = 0; j < GridSize; j++)
+        {
+            float x0 = static_cast<float>(i);
+            float y0 = static_cast<float>(j);
+            triangles.push_back({ x0, y0, 0.0f });
+            triangles.push_back({ x0 + 1.0f, y0, 0.0f });
+            triangles.push_back({ x0 + 1.0f, y0 + 1.0f, 0.0f });
+            triangles.push_back({ x0, y0, 0.0f });
+            triangles.push_back({ x0 + 1.0f, y0 + 1.0f, 0.0f });
+            triangles.push_back({ x0, y0 + 1.0f, 0.0f });
+        }
+    }
+
+    std::vector<unsigned int> order(triangles.size() / 3);
+    for (unsigned int i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::shuffle(order.begin(), order.end(), std::mt19937(1));
+
+    std::vector<cmod::VWord> vertices;
+    std::vector<cmod::Index32> indices;
+    for (unsigned int t : order)
+    {
+        for (unsigned int k = 0; k < 3; k++)
+        {
+            cmod::VWord words[3];
+            std::memcpy(words, triangles[t * 3 + k].data(), sizeof(words));
+            vertices.insert(vertices.end(), words, words + 3);
+            indices.push_back(static_cast<cmod::Index32>(indices.size()));
+        }
+    }
+
+    cmod::Mesh mesh;
+    std::vector<cmod::VertexAttribute> attributes;
+    attributes.emplace_back(cmod::VertexAttributeSemantic::Position, cmod::VertexAttributeFormat::Float3, 0);
+    mesh.setVertexDescription(cmod::VertexDescription(std::move(attributes)));
+    mesh.setVertices(static_cast<unsigned int>(indices.size()), std::move(vertices));
+    mesh.addGroup(cmod::PrimitiveGroupType::TriList, 0, std::move(indices));
+    return mesh;
+}
+
+std::vector<std::array<float, 9>> getTriangles(const cmod::Mesh& mesh)
+{
+    const cmod::PrimitiveGroup* group = mesh.getGroup(0);
+    std::vector<std::array<float, 9>> triangles;
+    for (std::size_t i = 0; i < group->indices.size(); i += 3)
+    {
+        std::array<float, 9> triangle;
+        for (unsigned int k = 0; k < 3; k++)
+            std::memcpy(triangle.data() + k * 3, mesh.getVertexData() + group->indices[i + k] * 3, sizeof(float) * 3);
+        triangles.push_back(triangle);
+    }
+
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+// Vertices transformed per triangle with a 16 entry FIFO cache
+float cacheMissRatio(const cmod::Mesh& mesh)
+{
+    const cmod::PrimitiveGroup* group = mesh.getGroup(0);
+    std::vector<cmod::Index32> cache;
+    unsigned int misses = 0;
+    for (cmod::Index32 index : group->indices)
+    {
+        if (std::find(cache.begin(), cache.end(), index) != cache.end())
+            continue;
+        misses++;
+        cache.push_back(index);
+        if (cache.size() > 16)
+            cache.erase(cache.begin());
+    }
+
+    return static_cast<float>(misses) / static_cast<float>(group->indices.size() / 3);
+}
+
+// Random triangles in a unit cube
+cmod::Mesh makeTriangleSoup(unsigned int nTriangles, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> coord(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> offset(-0.1f, 0.1f);
+    std::vector<cmod::VWord> vertices;
+    std::vector<cmod::Index32> indices;
+    for (unsigned int t = 0; t < nTriangles; t++)
+    {
+        std::array<float, 3> center = { coord(rng), coord(rng), coord(rng) };
+        for (unsigned int k = 0; k < 3; k++)
+        {
+            std::array<float, 3> v = { center[0] + offset(rng), center[1] + offset(rng), center[2] + offset(rng) };
+            cmod::VWord words[3];
+            std::memcpy(words, v.data(), sizeof(words));
+            vertices.insert(vertices.end(), words, words + 3);
+            indices.push_back(static_cast<cmod::Index32>(indices.size()));
+        }
+    }
+
+    cmod::Mesh mesh;
+    std::vector<cmod::VertexAttribute> attributes;
+    attributes.emplace_back(cmod::VertexAttributeSemantic::Position, cmod::VertexAttributeFormat::Float3, 0);
+    mesh.setVertexDescription(cmod::VertexDescription(std::move(attributes)));
+    mesh.setVertices(static_cast<unsigned int>(indices.size()), std::move(vertices));
+    mesh.addGroup(cmod::PrimitiveGroupType::TriList, 0, std::move(indices));
+    return mesh;
+}
+
+// Intersect a ray with every triangle of a triangle list
+double bruteForcePick(const cmod::Mesh& mesh, const Eigen::Vector3d& origin, const Eigen::Vector3d& direction)
+{
+    const cmod::PrimitiveGroup* group = mesh.getGroup(0);
+    double closest = -1.0;
+    for (std::size_t i = 0; i < group->indices.size(); i += 3)
+    {
+        Eigen::Vector3d v[3];
+        for (unsigned int k = 0; k < 3; k++)
+        {
+            Eigen::Vector3f p;
+            std::memcpy(p.data(), mesh.getVertexData() + group->indices[i + k] * 3, sizeof(float) * 3);
+            v[k] = p.cast<double>();
+        }
+
+        Eigen::Vector3d n = (v[1] - v[0]).cross(v[2] - v[0]);
+        double t = n.dot(v[0] - origin) / n.dot(direction);
+        if (t <= 0.0 || (closest >= 0.0 && t >= closest))
+            continue;
+
+        Eigen::Vector3d p = origin + t * direction;
+        if ((v[1] - v[0]).cross(p - v[0]).dot(n) >= 0.0 &&
+            (v[2] - v[1]).cross(p - v[1]).dot(n) >= 0.0 &&
+            (v[0] - v[2]).cross(p - v[2]).dot(n) >= 0.0)
+        {
+            closest = t;
+        }
+    }
+
+    return closest;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Mesh optimization", "[Mesh]")
+{
+    cmod::Mesh mesh = makeGrid();
+    auto triangles = getTriangles(mesh);
+    float originalMissRatio = cacheMissRatio(mesh);
+
+    std::vector<cmod::Material> materials(1);
+    mesh.optimize(materials);
+
+    SECTION("Duplicate vertices are merged")
+    {
+        REQUIRE(mesh.getVertexCount() == (GridSize + 1) * (GridSize + 1));
+    }
+
+    SECTION("Triangles are preserved")
+    {
+        REQUIRE(getTriangles(mesh) == triangles);
+    }
+
+    SECTION("Vertex cache use improves")
+    {
+        REQUIRE(originalMissRatio == 3.0f);
+        REQUIRE(cacheMissRatio(mesh) < 0.8f);
+    }
+
+    SECTION("Vertices are numbered in order of first use")
+    {
+        cmod::Index32 next = 0;
+        for (cmod::Index32 index : mesh.getGroup(0)->indices)
+        {
+            REQUIRE(index <= next);
+            if (index == next)
+                next++;
+        }
+    }
+
+    SECTION("16-bit indices match")
+    {
+        const cmod::PrimitiveGroup* group = mesh.getGroup(0);
+        REQUIRE(group->indices16.size() == group->indices.size());
+        REQUIRE(std::equal(group->indices.begin(), group->indices.end(), group->indices16.begin()));
+    }
+}
+
+TEST_CASE("Mesh levels of detail", "[Mesh]")
+{
+    cmod::Mesh mesh = makeGrid();
+    std::vector<cmod::Material> materials(1);
+    mesh.optimize(materials);
+
+    std::vector<float> errors = mesh.generateLODs(2);
+    REQUIRE(errors.size() == 2);
+
+    const cmod::PrimitiveGroup* group = mesh.getGroup(0);
+    REQUIRE(group->lodIndices.size() == 2);
+
+    for (unsigned int level = 0; level < 2; level++)
+    {
+        // The grid is flat, so simplifying it costs nothing
+        REQUIRE(errors[level] == 0.0f);
+
+        const auto& indices = group->lodIndices[level];
+        REQUIRE(indices.size() % 3 == 0);
+        REQUIRE(indices.size() <= group->indices.size() >> (level + 1));
+
+        // The boundary is kept and no triangle is flipped, so the
+        // triangles still cover the whole grid.
+        float area = 0.0f;
+        for (std::size_t i = 0; i < indices.size(); i += 3)
+        {
+            std::array<float, 3> p[3];
+            for (unsigned int k = 0; k < 3; k++)
+                std::memcpy(p[k].data(), mesh.getVertexData() + indices[i + k] * 3, sizeof(float) * 3);
+            float z = (p[1][0] - p[0][0]) * (p[2][1] - p[0][1]) - (p[1][1] - p[0][1]) * (p[2][0] - p[0][0]);
+            REQUIRE(z > 0.0f);
+            area += z * 0.5f;
+        }
+        REQUIRE(area == Approx(static_cast<float>(GridSize * GridSize)));
+    }
+}
+
+TEST_CASE("Mesh picking", "[Mesh]")
+{
+    SECTION("Picks match testing every triangle")
+    {
+        std::mt19937 rng(7);
+        cmod::Mesh mesh = makeTriangleSoup(2000, rng);
+        std::uniform_real_distribution<double> coord(-1.0, 1.0);
+        unsigned int hits = 0;
+        for (int i = 0; i < 500; i++)
+        {
+            Eigen::Vector3d origin = Eigen::Vector3d(coord(rng), coord(rng), coord(rng)).normalized() * 3.0;
+            Eigen::Vector3d target(coord(rng), coord(rng), coord(rng));
+            Eigen::Vector3d direction = (target - origin).normalized();
+
+            double expected = bruteForcePick(mesh, origin, direction);
+            cmod::Mesh::PickResult result;
+            bool hit = mesh.pick(origin, direction, &result);
+            REQUIRE(hit == (expected >= 0.0));
+            if (hit)
+            {
+                hits++;
+                REQUIRE(result.distance == Approx(expected).epsilon(1.0e-6));
+                REQUIRE(result.group == mesh.getGroup(0));
+            }
+        }
+        REQUIRE(hits > 100);
+    }
+
+    SECTION("Picks follow changes to the mesh")
+    {
+        cmod::Mesh mesh = makeGrid();
+        Eigen::Vector3d origin(3.3, 5.7, 10.0);
+        Eigen::Vector3d down(0.0, 0.0, -1.0);
+        double distance;
+        REQUIRE(mesh.pick(origin, down, distance));
+        REQUIRE(distance == Approx(10.0));
+
+        mesh.transform(Eigen::Vector3f(0.0f, 0.0f, 2.0f), 1.0f);
+        REQUIRE(mesh.pick(origin, down, distance));
+        REQUIRE(distance == Approx(8.0));
+
+        REQUIRE(!mesh.pick(Eigen::Vector3d(-1.0, -1.0, 10.0), down, distance));
+    }
+}
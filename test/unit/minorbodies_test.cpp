@@ -0,0 +1,182 @@
+#include <sstream>
+#include <string>
+
+#include <Eigen/Core>
+
+#include <celengine/astro.h>
+#include <celengine/minorbodies.h>
+#include <celengine/star.h>
+#include <celengine/universe.h>
+#include <celephem/orbit.h>
+#include <celmath/mathlib.h>
+
+#include <catch.hpp>
+
+namespace
+{
+
+// A line of MPCORB.DAT, with each field at its column
+std::string mpcorbLine(const std::string& packedEpoch,
+                       const std::string& h,
+                       const std::string& meanAnomaly,
+                       const std::string& argOfPeriapsis,
+                       const std::string& ascendingNode,
+                       const std::string& inclination,
+                       const std::string& eccentricity,
+                       const std::string& meanMotion,
+                       const std::string& semiMajorAxis,
+                       const std::string& designation)
+{
+    std::string line(194, ' ');
+    auto put = [&line](std::size_t end, const std::string& field)
+    {
+        line.replace(end - field.size(), field.size(), field);
+    };
+    put(13, h);
+    put(19, "0.15");
+    line.replace(20, 5, packedEpoch);
+    put(35, meanAnomaly);
+    put(46, argOfPeriapsis);
+    put(57, ascendingNode);
+    put(68, inclination);
+    put(79, eccentricity);
+    put(91, meanMotion);
+    put(103, semiMajorAxis);
+    line.replace(166, designation.size(), designation);
+    return line;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("MinorBodyTable", "[MinorBodyTable]")
+{
+    std::stringstream in;
+    in << "MINOR PLANET CENTER ORBIT DATABASE (MPCORB)\n"
+       << "----------------------------------------------------------------------\n"
+       << mpcorbLine("K239D", "3.33", "60.07881", "73.42179", "80.25496", "10.58688",
+                     "0.0789126", "0.21410680", "2.7672543", "(1) Ceres") << '\n'
+       << "\n"
+       << mpcorbLine("K239D", "18.4", "321.15010", "150.60720", "126.41010", "1.89810",
+                     "0.6104700", "0.68930250", "1.4560140", "2023 AB1") << '\n';
+
+    Universe universe;
+    Star sun;
+    MinorBodyTable table(universe, sun);
+    REQUIRE(table.loadMPCORB(in) == 2);
+    REQUIRE(table.size() == 2);
+
+    SECTION("Names")
+    {
+        REQUIRE(table.getName(0) == "Ceres");
+        REQUIRE(table.getName(1) == "2023 AB1");
+        REQUIRE(table.find("ceres") == 0);
+        REQUIRE(table.find("(1)") == 0);
+        REQUIRE(table.find("2023 ab1") == 1);
+        REQUIRE(table.find("Vesta") == MinorBodyTable::InvalidRow);
+        REQUIRE(table.find("(2)") == MinorBodyTable::InvalidRow);
+    }
+
+    SECTION("Positions match EllipticalOrbit")
+    {
+        double epoch = static_cast<double>(astro::Date(2023, 9, 13));
+        for (std::uint32_t row = 0; row < table.size(); row++)
+        {
+            double a = row == 0 ? 2.7672543 : 1.4560140;
+            double e = row == 0 ? 0.0789126 : 0.6104700;
+            double n = row == 0 ? 0.21410680 : 0.68930250;
+            EllipticalOrbit orbit(astro::AUtoKilometers(a) * (1.0 - e),
+                                  e,
+                                  celmath::degToRad(row == 0 ? 10.58688 : 1.89810),
+                                  celmath::degToRad(row == 0 ? 80.25496 : 126.41010),
+                                  celmath::degToRad(row == 0 ? 73.42179 : 150.60720),
+                                  celmath::degToRad(row == 0 ? 60.07881 : 321.15010),
+                                  360.0 / n,
+                                  epoch);
+
+            for (double t = epoch - 5000.0; t < epoch + 5000.0; t += 137.3)
+            {
+                Eigen::Vector3d expected = orbit.positionAtTime(t);
+                REQUIRE(table.getPosition(row, t).isApprox(expected, 1.0e-6));
+            }
+        }
+    }
+
+    SECTION("Brightness")
+    {
+        // Seen from 1 AU from the Sun, Ceres is around magnitude 7 to 9
+        // and the small near Earth asteroid fainter than 12 unless it's
+        // close
+        Eigen::Vector3d observer(astro::AUtoKilometers(1.0), 0.0, 0.0);
+        double t = static_cast<double>(astro::Date(2023, 9, 13));
+        std::vector<MinorBodyTable::VisibleBody> visible;
+        table.findVisible(observer, t, 10.0f, 0.0f, visible);
+        REQUIRE(visible.size() >= 1);
+        REQUIRE(visible[0].row == 0);
+        REQUIRE(visible[0].appMag > 6.0f);
+        REQUIRE(visible[0].appMag < 10.0f);
+
+        table.findVisible(observer, t, 5.0f, 0.0f, visible);
+        REQUIRE(visible.empty());
+    }
+}
+
+TEST_CASE("MinorBodyTable SBDB", "[MinorBodyTable]")
+{
+    std::stringstream in;
+    in << "\"full_name\",\"epoch\",\"e\",\"a\",\"q\",\"i\",\"om\",\"w\",\"ma\",\"H\"\n"
+       << "\"     1 Ceres (A801 AA)\",2460200.5,.0789126,2.7672543,2.5488882,10.58688,80.25496,73.42179,60.07881,3.33\n"
+       << "\"       (2023 AB1)\",2460200.5,.61047,1.456014,.567156,1.8981,126.4101,150.6072,321.1501,18.4\n"
+       << "\"     C/2020 F3 (NEOWISE)\",2459031.5,1.0001,,.2946,128.94,61.01,37.28,0,\n";
+
+    Universe universe;
+    Star sun;
+    MinorBodyTable table(universe, sun);
+    REQUIRE(table.loadSBDB(in) == 2);
+    REQUIRE(table.getName(0) == "Ceres");
+    REQUIRE(table.getName(1) == "2023 AB1");
+    REQUIRE(table.find("(1)") == 0);
+
+    // The mean motion follows from the semi-major axis
+    double epoch = 2460200.5;
+    EllipticalOrbit orbit(astro::AUtoKilometers(2.7672543) * (1.0 - 0.0789126),
+                          0.0789126,
+                          celmath::degToRad(10.58688),
+                          celmath::degToRad(80.25496),
+                          celmath::degToRad(73.42179),
+                          celmath::degToRad(60.07881),
+                          360.0 / 0.21410680,
+                          epoch);
+    REQUIRE(table.getPosition(0, epoch + 1000.0).isApprox(orbit.positionAtTime(epoch + 1000.0), 1.0e-5));
+}
+
+TEST_CASE("MinorBodyTable filters", "[MinorBodyTable]")
+{
+    REQUIRE(MinorBodyTable::classifyOrbit(0.57, 1.46) == MinorBodyTable::NearEarth);
+    REQUIRE(MinorBodyTable::classifyOrbit(2.55, 2.77) == MinorBodyTable::MainBelt);
+    REQUIRE(MinorBodyTable::classifyOrbit(4.9, 5.2) == MinorBodyTable::JupiterTrojan);
+    REQUIRE(MinorBodyTable::classifyOrbit(29.7, 39.5) == MinorBodyTable::TransNeptunian);
+    REQUIRE(MinorBodyTable::parseOrbitClass("neo") == MinorBodyTable::NearEarth);
+    REQUIRE(MinorBodyTable::parseOrbitClass("Asteroid") == 0);
+
+    std::string lines = mpcorbLine("K239D", "3.33", "60.07881", "73.42179", "80.25496", "10.58688",
+                                   "0.0789126", "0.21410680", "2.7672543", "(1) Ceres") + '\n'
+                      + mpcorbLine("K239D", "18.4", "321.15010", "150.60720", "126.41010", "1.89810",
+                                   "0.6104700", "0.68930250", "1.4560140", "2023 AB1") + '\n';
+
+    Universe universe;
+    Star sun;
+
+    MinorBodyTable::Filter bright;
+    bright.maxAbsMag = 10.0f;
+    MinorBodyTable brightTable(universe, sun);
+    std::stringstream in1(lines);
+    REQUIRE(brightTable.loadMPCORB(in1, bright) == 1);
+    REQUIRE(brightTable.getName(0) == "Ceres");
+
+    MinorBodyTable::Filter nearEarth;
+    nearEarth.orbitClasses = MinorBodyTable::NearEarth;
+    MinorBodyTable nearEarthTable(universe, sun);
+    std::stringstream in2(lines);
+    REQUIRE(nearEarthTable.loadMPCORB(in2, nearEarth) == 1);
+    REQUIRE(nearEarthTable.getName(0) == "2023 AB1");
+}
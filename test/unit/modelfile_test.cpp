@@ -0,0 +1,185 @@
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+#include <celmodel/mesh.h>
+#include <celmodel/model.h>
+#include <celmodel/modelfile.h>
+#include <celmodel/vertexpacking.h>
+
+#include <catch.hpp>
+
+namespace
+{
+
+constexpr unsigned int VertexCount = 4;
+
+std::unique_ptr<cmod::Model> makeModel()
+{
+    std::vector<cmod::VertexAttribute> attributes;
+    attributes.emplace_back(cmod::VertexAttributeSemantic::Position, cmod::VertexAttributeFormat::Float3, 0);
+    attributes.emplace_back(cmod::VertexAttributeSemantic::Color0, cmod::VertexAttributeFormat::UByte4, 3);
+
+    std::vector<cmod::VWord> vertices;
+    for (unsigned int i = 0; i < VertexCount; i++)
+    {
+        float position[3] = { static_cast<float>(i), 0.5f * static_cast<float>(i), -1.0f };
+        unsigned char color[4] = { 10, 20, 30, static_cast<unsigned char>(i) };
+        cmod::VWord words[4];
+        std::memcpy(words, position, sizeof(position));
+        std::memcpy(words + 3, color, sizeof(color));
+        vertices.insert(vertices.end(), words, words + 4);
+    }
+
+    cmod::Mesh mesh;
+    mesh.setVertexDescription(cmod::VertexDescription(std::move(attributes)));
+    mesh.setVertices(VertexCount, std::move(vertices));
+    mesh.addGroup(cmod::PrimitiveGroupType::TriList, 0, { 0, 1, 2, 0, 2, 3 });
+
+    auto model = std::make_unique<cmod::Model>();
+    model->addMaterial(cmod::Material());
+    model->addMesh(std::move(mesh));
+    return model;
+}
+
+ResourceHandle getHandle(const fs::path&)
+{
+    return InvalidResource;
+}
+
+void checkModel(const cmod::Model* model)
+{
+    auto expected = makeModel();
+    REQUIRE(model != nullptr);
+    REQUIRE(model->getMaterialCount() == 1);
+    REQUIRE(model->getMeshCount() == 1);
+
+    const cmod::Mesh* mesh = model->getMesh(0);
+    const cmod::Mesh* expectedMesh = expected->getMesh(0);
+    REQUIRE(mesh->getVertexCount() == VertexCount);
+    REQUIRE(mesh->getVertexDescription() == expectedMesh->getVertexDescription());
+    REQUIRE(std::memcmp(mesh->getVertexData(), expectedMesh->getVertexData(),
+                        VertexCount * expectedMesh->getVertexDescription().strideBytes) == 0);
+    REQUIRE(mesh->getGroupCount() == 1);
+    REQUIRE(mesh->getGroup(0)->indices == expectedMesh->getGroup(0)->indices);
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Binary model files", "[ModelFile]")
+{
+    auto model = makeModel();
+    std::ostringstream out(std::ios::out | std::ios::binary);
+    REQUIRE(cmod::SaveModelBinary(model.get(), out, [](ResourceHandle) { return fs::path(); }));
+    std::string data = out.str();
+
+    SECTION("Load from a stream")
+    {
+        std::istringstream in(data, std::ios::in | std::ios::binary);
+        auto loaded = cmod::LoadModel(in, getHandle);
+        checkModel(loaded.get());
+    }
+
+    SECTION("Load from a file")
+    {
+        fs::path filename = fs::temp_directory_path() / "celestia_modelfile_test.cmod";
+        {
+            std::ofstream file(filename, std::ios::out | std::ios::binary);
+            file.write(data.data(), data.size());
+        }
+
+        auto loaded = cmod::LoadModel(filename, getHandle);
+        fs::remove(filename);
+        checkModel(loaded.get());
+    }
+
+    SECTION("Truncated files are rejected")
+    {
+        std::istringstream in(data.substr(0, data.size() - 6), std::ios::in | std::ios::binary);
+        REQUIRE(cmod::LoadModel(in, getHandle) == nullptr);
+    }
+}
+
+TEST_CASE("Packed vertex formats", "[ModelFile]")
+{
+    SECTION("Half floats")
+    {
+        REQUIRE(cmod::floatToHalf(1.0f) == 0x3c00);
+        REQUIRE(cmod::floatToHalf(-2.0f) == 0xc000);
+        REQUIRE(cmod::floatToHalf(65504.0f) == 0x7bff);
+        REQUIRE(cmod::floatToHalf(1.0e6f) == 0x7c00);
+        REQUIRE(cmod::floatToHalf(std::ldexp(1.0f, -24)) == 0x0001);
+        REQUIRE(cmod::halfToFloat(0x0001) == std::ldexp(1.0f, -24));
+        for (float f = -4.0f; f <= 4.0f; f += 0.0137f)
+            REQUIRE(std::abs(cmod::halfToFloat(cmod::floatToHalf(f)) - f) <= std::abs(f) * 0.0005f + 1.0e-7f);
+    }
+
+    SECTION("Octahedral normals")
+    {
+        for (float theta = 0.05f; theta < 3.14f; theta += 0.1f)
+        {
+            for (float phi = 0.0f; phi < 6.28f; phi += 0.1f)
+            {
+                Eigen::Vector3f n(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta));
+                auto packed = cmod::packOctahedral(n);
+                REQUIRE(cmod::unpackOctahedral(packed[0], packed[1]).dot(n) > 0.99999f);
+            }
+        }
+    }
+}
+
+TEST_CASE("Binary model files with packed vertices", "[ModelFile]")
+{
+    constexpr unsigned int Count = 64;
+    std::vector<cmod::VertexAttribute> attributes;
+    attributes.emplace_back(cmod::VertexAttributeSemantic::Position, cmod::VertexAttributeFormat::Float3, 0);
+    attributes.emplace_back(cmod::VertexAttributeSemantic::Normal, cmod::VertexAttributeFormat::Float3, 3);
+    attributes.emplace_back(cmod::VertexAttributeSemantic::Texture0, cmod::VertexAttributeFormat::Float2, 6);
+
+    std::vector<cmod::VWord> vertices(Count * 8);
+    for (unsigned int i = 0; i < Count; i++)
+    {
+        float t = static_cast<float>(i) * 0.1f;
+        Eigen::Vector3f normal = Eigen::Vector3f(std::cos(t), std::sin(t), 0.3f * t - 3.0f).normalized();
+        float v[8] = { 100.0f * std::cos(t), 20.0f * std::sin(t), t - 3.0f,
+                       normal.x(), normal.y(), normal.z(),
+                       0.5f * t, 1.0f - 0.25f * t };
+        std::memcpy(vertices.data() + i * 8, v, sizeof(v));
+    }
+
+    cmod::Mesh mesh;
+    mesh.setVertexDescription(cmod::VertexDescription(std::move(attributes)));
+    mesh.setVertices(Count, std::vector<cmod::VWord>(vertices));
+    mesh.addGroup(cmod::PrimitiveGroupType::PointList, 0, { 0, 1, 2, 3 });
+    cmod::Model model;
+    model.addMaterial(cmod::Material());
+    model.addMesh(std::move(mesh));
+
+    std::ostringstream out(std::ios::out | std::ios::binary);
+    REQUIRE(cmod::SaveModelBinary(&model, out, [](ResourceHandle) { return fs::path(); }, cmod::PackAll));
+    std::istringstream in(out.str(), std::ios::in | std::ios::binary);
+    auto loaded = cmod::LoadModel(in, getHandle);
+    REQUIRE(loaded != nullptr);
+
+    // Meshes are loaded with float attributes
+    const cmod::Mesh* loadedMesh = loaded->getMesh(0);
+    REQUIRE(loadedMesh->getVertexDescription() == model.getMesh(0)->getVertexDescription());
+    REQUIRE(loadedMesh->getVertexCount() == Count);
+    for (unsigned int i = 0; i < Count * 8; i++)
+    {
+        float expected;
+        float actual;
+        std::memcpy(&expected, vertices.data() + i, sizeof(float));
+        std::memcpy(&actual, loadedMesh->getVertexData() + i, sizeof(float));
+        // Positions to 1/65534 of the extent of the mesh, normals to
+        // the precision of the octahedral mapping and texture coordinates
+        // to a half float
+        float tolerance = i % 8 < 3 ? 200.0f / 65534.0f : (i % 8 < 6 ? 1.0e-4f : 0.002f);
+        REQUIRE(std::abs(actual - expected) <= tolerance);
+    }
+}
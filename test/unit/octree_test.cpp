@@ -0,0 +1,671 @@
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+
+#include <celengine/astro.h>
+#include <celengine/flatoctree.h>
+#include <celengine/staraggregates.h>
+#include <celengine/staroctree.h>
+#include <celengine/startiles.h>
+#include <celutil/threadpool.h>
+
+#include <catch.hpp>
+
+namespace
+{
+
+constexpr float ROOT_SIZE = 1.0e9f;
+constexpr int STAR_COUNT = 100000;
+
+std::vector<Star> makeStars()
+{
+    std::mt19937 rng(42);
+    std::normal_distribution<float> pos(0.0f, 300.0f);
+    std::uniform_real_distribution<float> mag(-5.0f, 15.0f);
+
+    std::vector<Star> stars(STAR_COUNT);
+    for (int i = 0; i < STAR_COUNT; i++)
+    {
+        stars[i].setPosition(pos(rng), pos(rng), pos(rng));
+        stars[i].setAbsoluteMagnitude(mag(rng));
+        stars[i].setDetails(StarDetails::GetBarycenterDetails());
+        stars[i].setIndex(i);
+    }
+    return stars;
+}
+
+class CollectingProcessor : public StarHandler
+{
+ public:
+    void process(const Star& star, float /*distance*/, float /*appMag*/) override
+    {
+        visited.push_back(star.getIndex());
+    }
+
+    std::vector<std::uint32_t> visited;
+};
+
+float rootAbsMag()
+{
+    return astro::appToAbsMag(6.0f, ROOT_SIZE * 1.7320508f);
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Parallel octree build matches serial build", "[Octree]")
+{
+    std::vector<Star> stars = makeStars();
+
+    DynamicStarOctree serialRoot(Eigen::Vector3f(1000.0f, 1000.0f, 1000.0f), rootAbsMag());
+    for (const Star& star : stars)
+        serialRoot.insertObject(star, ROOT_SIZE);
+    std::vector<Star> serialSorted(STAR_COUNT);
+    Star* serialEnd = serialSorted.data();
+    StarOctree* serialTree = nullptr;
+    serialRoot.rebuildAndSort(serialTree, serialEnd);
+
+    celestia::util::ThreadPool pool(4);
+    DynamicStarOctree parallelRoot(Eigen::Vector3f(1000.0f, 1000.0f, 1000.0f), rootAbsMag());
+    std::vector<const Star*> objects;
+    for (const Star& star : stars)
+        objects.push_back(&star);
+    parallelRoot.insertObjects(std::move(objects), ROOT_SIZE, &pool);
+    std::vector<Star> parallelSorted(STAR_COUNT);
+    Star* parallelEnd = parallelSorted.data();
+    StarOctree* parallelTree = nullptr;
+    parallelRoot.rebuildAndSort(parallelTree, parallelEnd, &pool);
+
+    REQUIRE(serialEnd - serialSorted.data() == STAR_COUNT);
+    REQUIRE(parallelEnd - parallelSorted.data() == STAR_COUNT);
+
+    std::vector<OctreeNodeLayout<float>> serialLayout;
+    std::vector<OctreeNodeLayout<float>> parallelLayout;
+    serialTree->getLayout(serialLayout);
+    parallelTree->getLayout(parallelLayout);
+
+    REQUIRE(serialLayout.size() == parallelLayout.size());
+    for (std::size_t i = 0; i < serialLayout.size(); i++)
+    {
+        REQUIRE(serialLayout[i].cellCenterPos == parallelLayout[i].cellCenterPos);
+        REQUIRE(serialLayout[i].exclusionFactor == parallelLayout[i].exclusionFactor);
+        REQUIRE(serialLayout[i].nObjects == parallelLayout[i].nObjects);
+        REQUIRE(serialLayout[i].hasChildren == parallelLayout[i].hasChildren);
+    }
+
+    for (int i = 0; i < STAR_COUNT; i++)
+        REQUIRE(serialSorted[i].getIndex() == parallelSorted[i].getIndex());
+
+    SECTION("Objects of each node are sorted by magnitude")
+    {
+        const Star* first = serialSorted.data();
+        for (const OctreeNodeLayout<float>& node : serialLayout)
+        {
+            for (std::uint32_t i = 1; i < node.nObjects; i++)
+                REQUIRE(first[i - 1].getAbsoluteMagnitude() <= first[i].getAbsoluteMagnitude());
+            first += node.nObjects;
+        }
+    }
+
+    SECTION("Layout round trip")
+    {
+        StarOctree* rebuilt = StarOctree::fromLayout(serialLayout, serialSorted.data(), STAR_COUNT);
+        REQUIRE(rebuilt != nullptr);
+        REQUIRE(rebuilt->countObjects() == STAR_COUNT);
+        REQUIRE(rebuilt->countChildren() == serialTree->countChildren());
+        REQUIRE(StarOctree::fromLayout(serialLayout, serialSorted.data(), STAR_COUNT - 1) == nullptr);
+        delete rebuilt;
+    }
+
+    SECTION("Flattened octree visits the same stars")
+    {
+        FlatStarOctree flatTree(*serialTree, ROOT_SIZE);
+        REQUIRE(flatTree.nodeCount() == serialLayout.size());
+
+        Eigen::Vector3f obsPos(10.0f, -20.0f, 5.0f);
+        Eigen::Hyperplane<float, 3> planes[5];
+        planes[0] = Eigen::Hyperplane<float, 3>(Eigen::Vector3f(1.0f, 0.0f, 0.2f).normalized(), obsPos);
+        planes[1] = Eigen::Hyperplane<float, 3>(Eigen::Vector3f(-1.0f, 0.0f, 0.2f).normalized(), obsPos);
+        planes[2] = Eigen::Hyperplane<float, 3>(Eigen::Vector3f(0.0f, 1.0f, 0.2f).normalized(), obsPos);
+        planes[3] = Eigen::Hyperplane<float, 3>(Eigen::Vector3f(0.0f, -1.0f, 0.2f).normalized(), obsPos);
+        planes[4] = Eigen::Hyperplane<float, 3>(Eigen::Vector3f::UnitZ(), obsPos);
+
+        CollectingProcessor expected;
+        CollectingProcessor actual;
+        serialTree->processVisibleObjects(expected, obsPos, planes, 8.0f, ROOT_SIZE);
+        flatTree.processVisibleObjects(actual, obsPos, planes, 8.0f);
+        REQUIRE(!expected.visited.empty());
+        REQUIRE(actual.visited == expected.visited);
+
+        std::vector<std::uint32_t> batched;
+        flatTree.visitVisibleNodes([&](const Star* objects, std::uint32_t nObjects, float dimmest)
+                                   {
+                                       for (std::uint32_t i = 0; i < nObjects; i++)
+                                       {
+                                           const Star& star = objects[i];
+                                           if (star.getAbsoluteMagnitude() >= dimmest)
+                                               continue;
+                                           float distance = (obsPos - star.getPosition()).norm();
+                                           if (star.getApparentMagnitude(distance) < 8.0f)
+                                               batched.push_back(star.getIndex());
+                                       }
+                                   },
+                                   obsPos, planes, 8.0f);
+        REQUIRE(batched == expected.visited);
+
+        CollectingProcessor expectedClose;
+        CollectingProcessor actualClose;
+        serialTree->processCloseObjects(expectedClose, obsPos, 50.0f, ROOT_SIZE);
+        flatTree.processCloseObjects(actualClose, obsPos, 50.0f);
+        REQUIRE(!expectedClose.visited.empty());
+        REQUIRE(actualClose.visited == expectedClose.visited);
+    }
+
+    SECTION("Cone query finds the stars near a ray")
+    {
+        FlatStarOctree flatTree(*serialTree, ROOT_SIZE);
+        Eigen::Vector3f obsPos(10.0f, -20.0f, 5.0f);
+        Eigen::Vector3f direction = Eigen::Vector3f(0.3f, -0.2f, 1.0f).normalized();
+        float angle = 0.05f;
+
+        auto inCone = [&](const Star& star)
+        {
+            Eigen::Vector3f offset = star.getPosition() - obsPos;
+            float distance = offset.norm();
+            return std::acos(std::clamp(offset.dot(direction) / distance, -1.0f, 1.0f)) <= angle
+                && star.getApparentMagnitude(distance) < 9.0f;
+        };
+
+        std::vector<std::uint32_t> expected;
+        for (const Star& star : serialSorted)
+        {
+            if (inCone(star))
+                expected.push_back(star.getIndex());
+        }
+
+        CollectingProcessor processor;
+        flatTree.processObjectsInCone(processor, obsPos, direction, angle, 9.0f);
+        std::vector<std::uint32_t> actual;
+        for (std::uint32_t index : processor.visited)
+        {
+            if (inCone(stars[index]))
+                actual.push_back(index);
+        }
+
+        std::sort(expected.begin(), expected.end());
+        std::sort(actual.begin(), actual.end());
+        REQUIRE(!expected.empty());
+        REQUIRE(actual == expected);
+        // Fewer stars are tested than by a frustum around the cone
+        Eigen::Quaternionf orientation = Eigen::Quaternionf::FromTwoVectors(direction, -Eigen::Vector3f::UnitZ());
+        Eigen::Matrix3f toWorld = orientation.conjugate().toRotationMatrix();
+        float t = std::tan(angle);
+        Eigen::Hyperplane<float, 3> planes[5];
+        planes[0] = Eigen::Hyperplane<float, 3>(toWorld * Eigen::Vector3f(-1.0f, 0.0f, -t).normalized(), obsPos);
+        planes[1] = Eigen::Hyperplane<float, 3>(toWorld * Eigen::Vector3f(1.0f, 0.0f, -t).normalized(), obsPos);
+        planes[2] = Eigen::Hyperplane<float, 3>(toWorld * Eigen::Vector3f(0.0f, -1.0f, -t).normalized(), obsPos);
+        planes[3] = Eigen::Hyperplane<float, 3>(toWorld * Eigen::Vector3f(0.0f, 1.0f, -t).normalized(), obsPos);
+        planes[4] = Eigen::Hyperplane<float, 3>(toWorld * -Eigen::Vector3f::UnitZ(), obsPos);
+        CollectingProcessor frustumProcessor;
+        flatTree.processVisibleObjects(frustumProcessor, obsPos, planes, 9.0f);
+        REQUIRE(processor.visited.size() < frustumProcessor.visited.size());
+    }
+
+    SECTION("Best-first search finds the nearest and brightest stars")
+    {
+        FlatStarOctree flatTree(*serialTree, ROOT_SIZE);
+        Eigen::Vector3f obsPos(10.0f, -20.0f, 5.0f);
+        constexpr std::size_t Count = 50;
+
+        // Keep the Count stars with the lowest keys, as StarDatabase does
+        auto search = [&](auto&& key, auto&& bound)
+        {
+            std::vector<std::pair<float, std::uint32_t>> best;
+            std::size_t tested = 0;
+            flatTree.visitNodesByBound(bound,
+                                       [&](const Star* objects, std::uint32_t nObjects)
+                                       {
+                                           tested += nObjects;
+                                           for (std::uint32_t i = 0; i < nObjects; i++)
+                                               best.emplace_back(key(objects[i]), objects[i].getIndex());
+                                           std::sort(best.begin(), best.end());
+                                           if (best.size() > Count)
+                                               best.resize(Count);
+                                           return best.size() == Count
+                                               ? best.back().first
+                                               : std::numeric_limits<float>::infinity();
+                                       },
+                                       obsPos);
+            REQUIRE(tested < stars.size());
+            return best;
+        };
+
+        auto bruteForce = [&](auto&& key)
+        {
+            std::vector<std::pair<float, std::uint32_t>> all;
+            for (const Star& star : stars)
+                all.emplace_back(key(star), star.getIndex());
+            std::partial_sort(all.begin(), all.begin() + Count, all.end());
+            all.resize(Count);
+            return all;
+        };
+
+        auto distance = [&](const Star& star) { return (star.getPosition() - obsPos).norm(); };
+        REQUIRE(search(distance, [](float minDistance, float) { return minDistance; }) == bruteForce(distance));
+
+        auto appMag = [&](const Star& star) { return star.getApparentMagnitude(distance(star)); };
+        REQUIRE(search(appMag,
+                       [](float minDistance, float brightest)
+                       {
+                           return minDistance <= 1.0f
+                               ? -std::numeric_limits<float>::infinity()
+                               : astro::absToAppMag(brightest, minDistance);
+                       }) == bruteForce(appMag));
+    }
+
+    SECTION("Shared node lists match the traversal of each view")
+    {
+        FlatStarOctree flatTree(*serialTree, ROOT_SIZE);
+        Eigen::Vector3f obsPos(10.0f, -20.0f, 5.0f);
+
+        auto makePlanes = [&obsPos](Eigen::Hyperplane<float, 3>* planes, float x, float slope)
+        {
+            planes[0] = Eigen::Hyperplane<float, 3>(Eigen::Vector3f(1.0f, 0.0f, slope - x).normalized(), obsPos);
+            planes[1] = Eigen::Hyperplane<float, 3>(Eigen::Vector3f(-1.0f, 0.0f, slope + x).normalized(), obsPos);
+            planes[2] = Eigen::Hyperplane<float, 3>(Eigen::Vector3f(0.0f, 1.0f, slope).normalized(), obsPos);
+            planes[3] = Eigen::Hyperplane<float, 3>(Eigen::Vector3f(0.0f, -1.0f, slope).normalized(), obsPos);
+            planes[4] = Eigen::Hyperplane<float, 3>(Eigen::Vector3f::UnitZ(), obsPos);
+        };
+
+        // Nodes are only guaranteed to match where they intersect the
+        // frustum, so stars outside of it are left out
+        auto collect = [&obsPos](std::vector<std::uint32_t>& visited, const Eigen::Hyperplane<float, 3>* planes)
+        {
+            return [&visited, &obsPos, planes](const Star* objects, std::uint32_t nObjects, float dimmest)
+            {
+                for (std::uint32_t i = 0; i < nObjects; i++)
+                {
+                    const Star& star = objects[i];
+                    if (star.getAbsoluteMagnitude() >= dimmest)
+                        continue;
+                    if (std::any_of(planes, planes + 5,
+                                    [&star](const auto& plane) { return plane.signedDistance(star.getPosition()) < 0.0f; }))
+                    {
+                        continue;
+                    }
+                    float distance = (obsPos - star.getPosition()).norm();
+                    if (star.getApparentMagnitude(distance) < 8.0f)
+                        visited.push_back(star.getIndex());
+                }
+            };
+        };
+
+        // The frustum of the traversal contains those of both views
+        Eigen::Hyperplane<float, 3> sharedPlanes[5];
+        makePlanes(sharedPlanes, 0.0f, 0.4f);
+        std::vector<FlatStarOctree::VisibleNode> nodes;
+        flatTree.visitVisibleNodeIndices([&nodes](std::uint32_t node, std::uint32_t /*count*/, float dimmest)
+                                         {
+                                             nodes.push_back({ node, dimmest });
+                                         },
+                                         obsPos, sharedPlanes, 8.0f);
+        REQUIRE(!nodes.empty());
+
+        for (float x : { -0.3f, 0.3f })
+        {
+            Eigen::Hyperplane<float, 3> planes[5];
+            makePlanes(planes, x, 0.1f);
+
+            std::vector<std::uint32_t> expected;
+            std::vector<std::uint32_t> actual;
+            flatTree.visitVisibleNodes(collect(expected, planes), obsPos, planes, 8.0f);
+            flatTree.visitNodesInFrustum(collect(actual, planes), nodes, planes);
+            std::sort(expected.begin(), expected.end());
+            std::sort(actual.begin(), actual.end());
+            REQUIRE(!expected.empty());
+            REQUIRE(actual == expected);
+        }
+    }
+
+    SECTION("Star tiles visit the same stars")
+    {
+        FlatStarOctree flatTree(*serialTree, ROOT_SIZE);
+        fs::path tilesPath = fs::temp_directory_path() / "octree_test_tiles.dat";
+        {
+            std::ofstream out(tilesPath, std::ios::out | std::ios::binary);
+            REQUIRE(StarTileSet::write(out, flatTree));
+        }
+
+        // A small budget forces tiles to be evicted and read again
+        auto tiles = StarTileSet::open(tilesPath, 64 * 1024);
+        REQUIRE(tiles != nullptr);
+        REQUIRE(tiles->starCount() == STAR_COUNT);
+
+        Eigen::Vector3f obsPos(10.0f, -20.0f, 5.0f);
+        Eigen::Hyperplane<float, 3> planes[5];
+        planes[0] = Eigen::Hyperplane<float, 3>(Eigen::Vector3f(1.0f, 0.0f, 0.2f).normalized(), obsPos);
+        planes[1] = Eigen::Hyperplane<float, 3>(Eigen::Vector3f(-1.0f, 0.0f, 0.2f).normalized(), obsPos);
+        planes[2] = Eigen::Hyperplane<float, 3>(Eigen::Vector3f(0.0f, 1.0f, 0.2f).normalized(), obsPos);
+        planes[3] = Eigen::Hyperplane<float, 3>(Eigen::Vector3f(0.0f, -1.0f, 0.2f).normalized(), obsPos);
+        planes[4] = Eigen::Hyperplane<float, 3>(Eigen::Vector3f::UnitZ(), obsPos);
+
+        auto collect = [&obsPos](std::vector<std::uint32_t>& visited)
+        {
+            return [&visited, &obsPos](const Star* objects, std::uint32_t nObjects, float dimmest)
+            {
+                for (std::uint32_t i = 0; i < nObjects; i++)
+                {
+                    const Star& star = objects[i];
+                    if (star.getAbsoluteMagnitude() >= dimmest)
+                        continue;
+                    float distance = (obsPos - star.getPosition()).norm();
+                    if (star.getApparentMagnitude(distance) < 8.0f)
+                        visited.push_back(star.getIndex());
+                }
+            };
+        };
+
+        std::vector<std::uint32_t> expected;
+        flatTree.visitVisibleNodes(collect(expected), obsPos, planes, 8.0f);
+        std::sort(expected.begin(), expected.end());
+        REQUIRE(!expected.empty());
+
+        for (int pass = 0; pass < 2; pass++)
+        {
+            std::vector<std::uint32_t> actual;
+            tiles->visitVisibleStars(collect(actual), obsPos, planes, 8.0f);
+            tiles->trim();
+            REQUIRE(tiles->loadedSize() <= 64 * 1024);
+            std::sort(actual.begin(), actual.end());
+            REQUIRE(actual == expected);
+        }
+
+        tiles.reset();
+        fs::remove(tilesPath);
+    }
+
+    SECTION("Cached visible nodes match a full traversal")
+    {
+        FlatStarOctree flatTree(*serialTree, ROOT_SIZE);
+        FlatStarOctree::VisibleNodeCache cache(1.0f, 1.0e-3f);
+
+        auto collect = [](std::vector<std::uint32_t>& visited)
+        {
+            return [&visited](const Star* objects, std::uint32_t nObjects, float /*dimmest*/)
+            {
+                for (std::uint32_t i = 0; i < nObjects; i++)
+                    visited.push_back(objects[i].getIndex());
+            };
+        };
+
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float> step(-0.4f, 0.4f);
+        Eigen::Vector3f obsPos(10.0f, -20.0f, 5.0f);
+        Eigen::Vector3f direction(0.2f, 0.3f, 1.0f);
+        for (int frame = 0; frame < 50; frame++)
+        {
+            obsPos += Eigen::Vector3f(step(rng), step(rng), step(rng));
+            direction += 1.0e-4f * Eigen::Vector3f(step(rng), step(rng), step(rng));
+            Eigen::Quaternionf orientation = Eigen::Quaternionf::FromTwoVectors(-Eigen::Vector3f::UnitZ(), direction.normalized());
+            Eigen::Matrix3f rot = orientation.toRotationMatrix();
+
+            Eigen::Hyperplane<float, 3> planes[5];
+            Eigen::Vector3f normals[5] = {
+                Eigen::Vector3f(0.0f, 1.0f, -0.5f),
+                Eigen::Vector3f(0.0f, -1.0f, -0.5f),
+                Eigen::Vector3f(1.0f, 0.0f, -0.7f),
+                Eigen::Vector3f(-1.0f, 0.0f, -0.7f),
+                Eigen::Vector3f(0.0f, 0.0f, -1.0f),
+            };
+            for (int i = 0; i < 5; i++)
+                planes[i] = Eigen::Hyperplane<float, 3>(rot * normals[i].normalized(), obsPos);
+
+            std::vector<std::uint32_t> expected;
+            std::vector<std::uint32_t> actual;
+            flatTree.visitVisibleNodes(collect(expected), obsPos, planes, 9.0f);
+            flatTree.visitVisibleNodes(collect(actual), obsPos, planes, 9.0f, cache);
+            std::sort(expected.begin(), expected.end());
+            std::sort(actual.begin(), actual.end());
+            REQUIRE(!expected.empty());
+            REQUIRE(actual == expected);
+        }
+    }
+
+    SECTION("Objects are updated in place only within their node")
+    {
+        FlatStarOctree flatTree(*serialTree, ROOT_SIZE);
+
+        // A child of the root with stars
+        std::uint32_t firstChild = flatTree.node(0).firstChild;
+        REQUIRE(firstChild != 0);
+        std::uint32_t child = firstChild;
+        while (child < firstChild + 8 && flatTree.node(child).objectCount < 2)
+            child++;
+        REQUIRE(child < firstChild + 8);
+
+        auto node = flatTree.node(child);
+        const Star* star = node.firstObject;
+        float parentFactor = flatTree.node(0).exclusionFactor;
+        float nextMag = star[1].getAbsoluteMagnitude();
+
+        REQUIRE(flatTree.canUpdateObject(star, star->getPosition(), 0.0f, star->getAbsoluteMagnitude()));
+        REQUIRE(flatTree.canUpdateObject(star, node.center, 0.0f, std::max(parentFactor, nextMag - 0.5f)));
+        // Out of the cell of the node
+        Eigen::Vector3f outside = node.center + Eigen::Vector3f::Constant(node.scale * 1.5f);
+        REQUIRE_FALSE(flatTree.canUpdateObject(star, outside, 0.0f, star->getAbsoluteMagnitude()));
+        REQUIRE_FALSE(flatTree.canUpdateObject(star, node.center, node.scale * 2.0f, star->getAbsoluteMagnitude()));
+        // Brighter than the objects of the children of the root may be
+        REQUIRE_FALSE(flatTree.canUpdateObject(star, star->getPosition(), 0.0f, parentFactor - 1.0f));
+        // Fainter than the next star of the node
+        REQUIRE_FALSE(flatTree.canUpdateObject(star, star->getPosition(), 0.0f, nextMag + 1.0f));
+        // Not an object of the octree
+        Star other;
+        REQUIRE_FALSE(flatTree.canUpdateObject(&other, other.getPosition(), 0.0f, 0.0f));
+    }
+
+    SECTION("Moving stars are found anywhere within their drift")
+    {
+        // Give the sorted stars space velocities of up to 2e-3 ly per
+        // year, and move them for 10000 years
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float> speed(-1.0e-3f, 1.0e-3f);
+        for (Star& star : serialSorted)
+            star.setSpaceVelocity(Eigen::Vector3f(speed(rng), speed(rng), speed(rng)));
+        constexpr float years = 10000.0f;
+
+        FlatStarOctree flatTree(*serialTree, ROOT_SIZE);
+        flatTree.setObjectDrift([](const Star& star) { return star.getSpaceVelocity().norm() * years; });
+        REQUIRE(flatTree.memoryUsage() > FlatStarOctree(*serialTree, ROOT_SIZE).memoryUsage());
+
+        Eigen::Vector3f obsPos(10.0f, -20.0f, 5.0f);
+        Eigen::Hyperplane<float, 3> planes[5];
+        planes[0] = Eigen::Hyperplane<float, 3>(Eigen::Vector3f(1.0f, 0.0f, 0.2f).normalized(), obsPos);
+        planes[1] = Eigen::Hyperplane<float, 3>(Eigen::Vector3f(-1.0f, 0.0f, 0.2f).normalized(), obsPos);
+        planes[2] = Eigen::Hyperplane<float, 3>(Eigen::Vector3f(0.0f, 1.0f, 0.2f).normalized(), obsPos);
+        planes[3] = Eigen::Hyperplane<float, 3>(Eigen::Vector3f(0.0f, -1.0f, 0.2f).normalized(), obsPos);
+        planes[4] = Eigen::Hyperplane<float, 3>(Eigen::Vector3f::UnitZ(), obsPos);
+
+        auto isVisible = [&](const Star& star)
+        {
+            Eigen::Vector3f position = star.getPositionAfter(years);
+            for (const auto& plane : planes)
+            {
+                if (plane.signedDistance(position) < 0.0f)
+                    return false;
+            }
+            return star.getApparentMagnitude((obsPos - position).norm()) < 8.0f;
+        };
+
+        std::vector<std::uint32_t> expected;
+        for (const Star& star : serialSorted)
+        {
+            if (isVisible(star))
+                expected.push_back(star.getIndex());
+        }
+
+        std::vector<std::uint32_t> actual;
+        flatTree.visitVisibleNodes([&](const Star* objects, std::uint32_t nObjects, float /*dimmest*/)
+                                   {
+                                       for (std::uint32_t i = 0; i < nObjects; i++)
+                                       {
+                                           if (isVisible(objects[i]))
+                                               actual.push_back(objects[i].getIndex());
+                                       }
+                                   },
+                                   obsPos, planes, 8.0f);
+
+        std::sort(expected.begin(), expected.end());
+        std::sort(actual.begin(), actual.end());
+        REQUIRE(!expected.empty());
+        REQUIRE(actual == expected);
+    }
+
+    SECTION("Star aggregates hold the light of all stars below a node")
+    {
+        FlatStarOctree flatTree(*serialTree, ROOT_SIZE);
+        StarAggregates aggregates(flatTree);
+        REQUIRE(aggregates.nodeCount() == flatTree.nodeCount());
+
+        double totalFlux = 0.0;
+        for (const Star& star : stars)
+            totalFlux += std::pow(10.0, -0.4 * star.getAbsoluteMagnitude());
+        REQUIRE(aggregates.getAbsoluteMagnitude(0) == Approx(-2.5 * std::log10(totalFlux)).epsilon(1.0e-4));
+
+        // Planes that cull nothing
+        Eigen::Hyperplane<float, 3> planes[5];
+        std::fill(std::begin(planes), std::end(planes), Eigen::Hyperplane<float, 3>(Eigen::Vector3f::Zero(), 1.0f));
+        float infinity = std::numeric_limits<float>::infinity();
+
+        // Every star is either passed by itself or in the aggregate of a
+        // node, for any node size
+        for (float maxAngle : { 0.0f, 0.01f, 10.0f })
+        {
+            Eigen::Vector3f obsPos(10.0f, -20.0f, 5.0f);
+            std::vector<std::uint32_t> visited;
+            double flux = 0.0;
+            aggregates.visit([&](const Star* objects, std::uint32_t nObjects)
+                             {
+                                 for (std::uint32_t i = 0; i < nObjects; i++)
+                                 {
+                                     visited.push_back(objects[i].getIndex());
+                                     flux += std::pow(10.0, -0.4 * objects[i].getAbsoluteMagnitude());
+                                 }
+                             },
+                             [&](const Eigen::Vector3f& /*position*/, float absMag, float /*temperature*/)
+                             {
+                                 flux += std::pow(10.0, -0.4 * absMag);
+                             },
+                             flatTree, obsPos, planes, -infinity, infinity, maxAngle);
+
+            REQUIRE(flux == Approx(totalFlux).epsilon(1.0e-4));
+            if (maxAngle == 0.0f)
+                REQUIRE(visited.size() == STAR_COUNT);
+
+            std::sort(visited.begin(), visited.end());
+            REQUIRE(std::adjacent_find(visited.begin(), visited.end()) == visited.end());
+        }
+
+        // Seen from far away, all of the stars are between apparent
+        // magnitudes 12 and 33. Nodes outside of the range are skipped;
+        // the stars of the nodes that aren't, like the root, which contains
+        // every position, are selected as the caller would.
+        Eigen::Vector3f farPos(1.0e5f, 0.0f, 0.0f);
+        float brightMag = 0.0f;
+        float limitingMag = 0.0f;
+        std::uint32_t starCount = 0;
+        std::uint32_t aggregateCount = 0;
+        auto countStars = [&](const Star* objects, std::uint32_t nObjects)
+        {
+            for (std::uint32_t i = 0; i < nObjects; i++)
+            {
+                float appMag = objects[i].getApparentMagnitude((farPos - objects[i].getPosition()).norm());
+                if (appMag >= brightMag && appMag < limitingMag)
+                    starCount++;
+            }
+        };
+        auto countAggregates = [&](const Eigen::Vector3f&, float, float) { aggregateCount++; };
+
+        brightMag = 40.0f;
+        limitingMag = infinity;
+        aggregates.visit(countStars, countAggregates, flatTree, farPos, planes, brightMag, limitingMag, 10.0f);
+        REQUIRE(starCount + aggregateCount == 0);
+
+        brightMag = -infinity;
+        limitingMag = 5.0f;
+        aggregates.visit(countStars, countAggregates, flatTree, farPos, planes, brightMag, limitingMag, 10.0f);
+        REQUIRE(starCount + aggregateCount == 0);
+
+        brightMag = 20.0f;
+        limitingMag = 25.0f;
+        aggregates.visit(countStars, countAggregates, flatTree, farPos, planes, brightMag, limitingMag, 10.0f);
+        REQUIRE(aggregateCount > 0);
+    }
+
+    delete serialTree;
+    delete parallelTree;
+}
+
+namespace
+{
+
+FlatStarOctree buildFlatOctree(const std::vector<Star>& stars,
+                               std::vector<Star>& sorted,
+                               const OctreeSplitPolicy& policy)
+{
+    DynamicStarOctree root(Eigen::Vector3f(1000.0f, 1000.0f, 1000.0f), rootAbsMag(), policy);
+    for (const Star& star : stars)
+        root.insertObject(star, ROOT_SIZE);
+
+    sorted.resize(stars.size());
+    Star* end = sorted.data();
+    StarOctree* tree = nullptr;
+    root.rebuildAndSort(tree, end);
+    FlatStarOctree flatTree(*tree, ROOT_SIZE);
+    delete tree;
+    return flatTree;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Octree split policies", "[Octree]")
+{
+    std::vector<Star> stars = makeStars();
+
+    OctreeSplitPolicy coarsePolicy = DynamicStarOctree::defaultSplitPolicy;
+    coarsePolicy.splitThreshold = 300;
+    coarsePolicy.magnitudeStep = 3.0f;
+
+    std::vector<Star> defaultSorted;
+    std::vector<Star> coarseSorted;
+    FlatStarOctree defaultTree = buildFlatOctree(stars, defaultSorted, DynamicStarOctree::defaultSplitPolicy);
+    FlatStarOctree coarseTree = buildFlatOctree(stars, coarseSorted, coarsePolicy);
+    REQUIRE(coarseTree.nodeCount() < defaultTree.nodeCount());
+
+    // The children of the root hold stars a magnitude step fainter
+    REQUIRE(coarseTree.node(coarseTree.node(0).firstChild).exclusionFactor
+            == Approx(coarseTree.node(0).exclusionFactor + 3.0f));
+
+    std::vector<OctreeLevelStatistics> levels;
+    defaultTree.computeStatistics(levels);
+    REQUIRE(levels.size() > 2);
+    REQUIRE(levels[0].nodeCount == 1);
+    REQUIRE(levels[0].size == Approx(2.0 * ROOT_SIZE));
+
+    std::uint32_t nNodes = 0;
+    std::uint32_t nStars = 0;
+    for (std::size_t i = 0; i < levels.size(); i++)
+    {
+        nNodes += levels[i].nodeCount;
+        nStars += levels[i].objectCount;
+        if (i > 0)
+        {
+            REQUIRE(levels[i].nodeCount % 8 == 0);
+            REQUIRE(levels[i].size == Approx(levels[i - 1].size * 0.5));
+        }
+    }
+    REQUIRE(nNodes == defaultTree.nodeCount());
+    REQUIRE(nStars == STAR_COUNT);
+}
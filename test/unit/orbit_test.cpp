@@ -0,0 +1,349 @@
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celephem/chebyshevorbit.h>
+#include <celephem/interpolatedrotation.h>
+#include <celephem/orbit.h>
+#include <celephem/vsop87.h>
+#include <celephem/xyzvbinary.h>
+#include <celcompat/filesystem.h>
+#include <celcompat/numbers.h>
+#include <celutil/bytes.h>
+
+#include <catch.hpp>
+
+namespace
+{
+
+std::vector<double> makeTimes()
+{
+    std::vector<double> times;
+    for (int i = 0; i < 100; i++)
+        times.push_back(2451545.0 + i * 3.7);
+    // Out of order and repeated times
+    times.push_back(2440000.0);
+    times.push_back(2440000.0);
+    return times;
+}
+
+void checkBatch(const Orbit& orbit)
+{
+    std::vector<double> times = makeTimes();
+    std::vector<Eigen::Vector3d> positions(times.size());
+    std::vector<Eigen::Vector3d> velocities(times.size());
+    orbit.positionsAtTimes(times, positions.data());
+    orbit.velocitiesAtTimes(times, velocities.data());
+
+    for (std::size_t i = 0; i < times.size(); i++)
+    {
+        Eigen::Vector3d p = orbit.positionAtTime(times[i]);
+        Eigen::Vector3d v = orbit.velocityAtTime(times[i]);
+        REQUIRE(positions[i].isApprox(p, 1.0e-12));
+        REQUIRE(velocities[i].isApprox(v, 1.0e-9));
+    }
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Batched orbit evaluation", "[Orbit]")
+{
+    SECTION("Elliptical orbit")
+    {
+        EllipticalOrbit orbit(1.5e8, 0.3, 0.1, 0.2, 0.3, 0.4, 365.25);
+        checkBatch(orbit);
+    }
+
+    SECTION("VSOP87 planet")
+    {
+        std::unique_ptr<Orbit> orbit(CreateVSOP87Orbit("vsop87-mars"));
+        REQUIRE(orbit != nullptr);
+        checkBatch(*orbit);
+    }
+
+    SECTION("VSOP87 Sun")
+    {
+        std::unique_ptr<Orbit> orbit(CreateVSOP87Orbit("vsop87-sun"));
+        REQUIRE(orbit != nullptr);
+        checkBatch(*orbit);
+    }
+}
+
+TEST_CASE("Concurrent caching orbit evaluation", "[Orbit]")
+{
+    std::unique_ptr<Orbit> orbit(CreateVSOP87Orbit("vsop87-jupiter"));
+    REQUIRE(orbit != nullptr);
+    REQUIRE(orbit->isThreadSafe());
+
+    std::vector<double> times = makeTimes();
+    std::vector<Eigen::Vector3d> expected(times.size());
+    orbit->positionsAtTimes(times, expected.data());
+
+    // Each thread walks the times from a different start, so that they
+    // keep replacing each other's cached positions
+    constexpr int nThreads = 4;
+    std::vector<std::vector<Eigen::Vector3d>> results(nThreads, std::vector<Eigen::Vector3d>(times.size()));
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nThreads; i++)
+    {
+        threads.emplace_back([&orbit, &times, &result = results[i], i]
+        {
+            for (int pass = 0; pass < 20; pass++)
+            {
+                for (std::size_t j = 0; j < times.size(); j++)
+                {
+                    std::size_t k = (j + i * 7) % times.size();
+                    result[k] = orbit->positionAtTime(times[k]);
+                    orbit->velocityAtTime(times[k]);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    for (const auto& result : results)
+    {
+        for (std::size_t i = 0; i < times.size(); i++)
+            REQUIRE(result[i] == expected[i]);
+    }
+}
+
+TEST_CASE("Chebyshev orbit approximation", "[Orbit]")
+{
+    // Eccentric enough for the polynomials to have some work to do
+    EllipticalOrbit reference(4.0e5, 0.2, 0.1, 0.2, 0.3, 0.4, 27.3);
+    ChebyshevOrbit orbit(new EllipticalOrbit(reference), 27.3 / 16.0);
+
+    for (double t : makeTimes())
+    {
+        Eigen::Vector3d p = reference.positionAtTime(t);
+        Eigen::Vector3d v = reference.velocityAtTime(t);
+        REQUIRE((orbit.positionAtTime(t) - p).norm() < 1.0e-3);
+        REQUIRE((orbit.velocityAtTime(t) - v).norm() < 1.0e-3 * v.norm());
+    }
+}
+
+namespace
+{
+
+class SampleCollector : public OrbitSampleProc
+{
+public:
+    explicit SampleCollector(double tolerance) : m_tolerance(tolerance) {}
+
+    void sample(double t, const Eigen::Vector3d& position, const Eigen::Vector3d& velocity) override
+    {
+        times.push_back(t);
+        positions.push_back(position);
+        velocities.push_back(velocity);
+    }
+
+    double tolerance() const override { return m_tolerance; }
+
+    std::vector<double> times;
+    std::vector<Eigen::Vector3d> positions;
+    std::vector<Eigen::Vector3d> velocities;
+
+private:
+    double m_tolerance;
+};
+
+// Largest distance between the orbit and the cubic Hermite curve through
+// the samples, checked at the middle of each span
+double maxSampleError(const Orbit& orbit, const SampleCollector& samples)
+{
+    double maxError = 0.0;
+    for (std::size_t i = 1; i < samples.times.size(); i++)
+    {
+        double dt = samples.times[i] - samples.times[i - 1];
+        Eigen::Vector3d mid = 0.5 * (samples.positions[i - 1] + samples.positions[i])
+                            + 0.125 * dt * (samples.velocities[i - 1] - samples.velocities[i]);
+        double error = (mid - orbit.positionAtTime(samples.times[i - 1] + dt * 0.5)).norm();
+        maxError = std::max(maxError, error);
+    }
+    return maxError;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Adaptive orbit sampling", "[Orbit]")
+{
+    SECTION("Coarser tolerance takes fewer samples")
+    {
+        EllipticalOrbit orbit(1.5e8, 0.01, 0.1, 0.2, 0.3, 0.4, 365.25);
+        SampleCollector fine(1.0);
+        SampleCollector coarse(1.0e5);
+        orbit.sample(2451545.0, 2451545.0 + 365.25, fine);
+        orbit.sample(2451545.0, 2451545.0 + 365.25, coarse);
+
+        REQUIRE(coarse.times.size() < fine.times.size() / 2);
+        REQUIRE(coarse.times.size() >= 32);
+        REQUIRE(coarse.times.back() == Approx(2451545.0 + 365.25));
+    }
+
+    SECTION("Eccentric orbits stay within the tolerance")
+    {
+        EllipticalOrbit orbit(1.0e7, 0.95, 0.1, 0.2, 0.3, 0.4, 3000.0);
+        SampleCollector samples(1.0e4);
+        orbit.sample(2451545.0, 2451545.0 + 3000.0, samples);
+
+        // A step is accepted when it's the first one beyond the tolerance,
+        // so the error can exceed it by the growth of one step
+        REQUIRE(maxSampleError(orbit, samples) < 1.0e4 * 3.0);
+    }
+}
+
+TEST_CASE("Elliptical orbit path", "[Orbit]")
+{
+    EllipticalOrbit orbit(2.0e8, 0.6, 0.1, 0.2, 0.3, 0.4, 1200.0);
+    Eigen::Vector3d center, majorAxis, minorAxis;
+    REQUIRE(orbit.getEllipse(center, majorAxis, minorAxis));
+
+    // Every position is center + cos(E) * majorAxis + sin(E) * minorAxis
+    // for some eccentric anomaly E
+    for (double t : makeTimes())
+    {
+        Eigen::Vector3d p = orbit.positionAtTime(t) - center;
+        double c = p.dot(majorAxis) / majorAxis.squaredNorm();
+        double s = p.dot(minorAxis) / minorAxis.squaredNorm();
+        REQUIRE(c * c + s * s == Approx(1.0));
+        REQUIRE((c * majorAxis + s * minorAxis - p).norm() < 1.0e-6 * majorAxis.norm());
+    }
+
+    EllipticalOrbit hyperbola(2.0e8, 1.5, 0.1, 0.2, 0.3, 0.4, 1200.0);
+    REQUIRE(!hyperbola.getEllipse(center, majorAxis, minorAxis));
+}
+
+namespace
+{
+
+// Write a quadratic trajectory of two segments, [0, 2] and [start1, 4]
+void writeXYZC(const fs::path& path, double start1)
+{
+    XYZCBinaryHeader header;
+    std::memcpy(header.magic, "CELXYZC", 8);
+    header.byteOrder = __BYTE_ORDER__;
+    header.digits = std::numeric_limits<double>::digits;
+    header.degree = 2;
+    header.count = 2;
+
+    // x = 10 + 4 T_1, y = T_2, z = 5 in the first segment and
+    // x = 18 + 4 T_1, y = T_2, z = 5 in the second one
+    double segments[2][11] =
+    {
+        { 0.0, 2.0, 10.0, 4.0, 0.0, 0.0, 0.0, 1.0, 5.0, 0.0, 0.0 },
+        { start1, 4.0, 18.0, 4.0, 0.0, 0.0, 0.0, 1.0, 5.0, 0.0, 0.0 },
+    };
+
+    std::ofstream out(path, std::ios::out | std::ios::binary);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(segments), sizeof(segments));
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Chebyshev trajectory files", "[Orbit]")
+{
+    fs::path path = fs::temp_directory_path() / "orbit_test.xyzc";
+
+    SECTION("Positions and velocities")
+    {
+        writeXYZC(path, 2.0);
+        std::unique_ptr<Orbit> orbit(LoadXYZCBinary(path));
+        REQUIRE(orbit != nullptr);
+
+        double begin, end;
+        orbit->getValidRange(begin, end);
+        REQUIRE(begin == 0.0);
+        REQUIRE(end == 4.0);
+        REQUIRE(!orbit->isPeriodic());
+
+        // Celestia's frame is (x, z, -y) of the file's
+        REQUIRE(orbit->positionAtTime(1.0).isApprox(Eigen::Vector3d(10.0, 5.0, 1.0)));
+        REQUIRE(orbit->positionAtTime(3.5).isApprox(Eigen::Vector3d(20.0, 5.0, 0.5)));
+        REQUIRE(orbit->velocityAtTime(1.5).isApprox(Eigen::Vector3d(4.0, 0.0, -2.0)));
+
+        // Times outside of the file are clamped to its range
+        REQUIRE(orbit->positionAtTime(-1.0).isApprox(Eigen::Vector3d(6.0, 5.0, -1.0)));
+        REQUIRE(orbit->positionAtTime(5.0).isApprox(Eigen::Vector3d(22.0, 5.0, -1.0)));
+        REQUIRE(orbit->getBoundingRadius() >= orbit->positionAtTime(4.0).norm());
+    }
+
+    SECTION("Gaps between segments are rejected")
+    {
+        writeXYZC(path, 2.5);
+        REQUIRE(LoadXYZCBinary(path) == nullptr);
+    }
+
+    SECTION("Truncated files are rejected")
+    {
+        writeXYZC(path, 2.0);
+        fs::resize_file(path, fs::file_size(path) - 8);
+        REQUIRE(LoadXYZCBinary(path) == nullptr);
+    }
+
+    fs::remove(path);
+}
+
+namespace
+{
+
+// A spin with a libration about the Y axis and a slowly nodding equator
+class LibratingRotationModel : public RotationModel
+{
+public:
+    LibratingRotationModel(double _libration, double _nod) : libration(_libration), nod(_nod) {}
+
+    Eigen::Quaterniond spin(double tjd) const override
+    {
+        double angle = 2.0 * tjd + libration * std::sin(0.7 * tjd);
+        return Eigen::Quaterniond(Eigen::AngleAxisd(angle, Eigen::Vector3d::UnitY()));
+    }
+
+    Eigen::Quaterniond equatorOrientationAtTime(double tjd) const override
+    {
+        return Eigen::Quaterniond(Eigen::AngleAxisd(0.4 + nod * std::cos(0.05 * tjd), Eigen::Vector3d::UnitX()));
+    }
+
+    double getPeriod() const override { return celestia::numbers::pi; }
+    bool isPeriodic() const override { return true; }
+
+private:
+    double libration;
+    double nod;
+};
+
+} // end unnamed namespace
+
+TEST_CASE("Interpolated rotation model", "[Rotation]")
+{
+    SECTION("Orientations stay within the tolerance")
+    {
+        LibratingRotationModel reference(0.01, 0.01);
+        InterpolatedRotationModel model(new LibratingRotationModel(0.01, 0.01), 1.0e-8);
+        REQUIRE(model.getSpinStep() < reference.getPeriod() / 8.0);
+
+        std::vector<double> times = makeTimes();
+        std::vector<Eigen::Quaterniond> orientations(times.size());
+        model.orientationsAtTimes(times, orientations.data());
+        for (std::size_t i = 0; i < times.size(); i++)
+        {
+            double t = times[i];
+            REQUIRE(model.orientationAtTime(t).angularDistance(reference.orientationAtTime(t)) < 2.0e-8);
+            REQUIRE(orientations[i].angularDistance(model.orientationAtTime(t)) < 1.0e-12);
+        }
+    }
+
+    SECTION("Uniform spins don't need a short step")
+    {
+        InterpolatedRotationModel model(new LibratingRotationModel(0.0, 0.0), 1.0e-8);
+        REQUIRE(model.getSpinStep() == Approx(celestia::numbers::pi / 8.0));
+    }
+}
@@ -0,0 +1,114 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <celengine/pickgrid.h>
+#include <celengine/star.h>
+
+#include <catch.hpp>
+
+namespace
+{
+
+constexpr int STAR_COUNT = 20000;
+
+struct DrawnStar
+{
+    Eigen::Vector3f relPos;
+    float appMag;
+};
+
+// The closest star within angle of direction, found by testing all of them
+const Star* closestStar(const std::vector<Star>& stars,
+                        const std::vector<DrawnStar>& drawn,
+                        const Eigen::Vector3f& direction,
+                        float angle,
+                        float faintestMag)
+{
+    const Star* closest = nullptr;
+    float sinAngle2Closest = std::sin(angle / 2.0f);
+    for (std::size_t i = 0; i < stars.size(); i++)
+    {
+        if (drawn[i].appMag >= faintestMag)
+            continue;
+        float sinAngle2 = (drawn[i].relPos.normalized() - direction).norm() / 2.0f;
+        if (sinAngle2 <= sinAngle2Closest)
+        {
+            sinAngle2Closest = sinAngle2;
+            closest = &stars[i];
+        }
+    }
+    return closest;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("PickGrid", "[PickGrid]")
+{
+    std::mt19937 rng(11);
+    std::normal_distribution<float> pos(0.0f, 100.0f);
+    std::uniform_real_distribution<float> mag(-1.0f, 8.0f);
+
+    std::vector<Star> stars(STAR_COUNT);
+    std::vector<DrawnStar> drawn(STAR_COUNT);
+    for (int i = 0; i < STAR_COUNT; i++)
+        drawn[i] = { Eigen::Vector3f(pos(rng), pos(rng), pos(rng)), mag(rng) };
+
+    Eigen::Vector3d position(1.0, 2.0, 3.0);
+    Eigen::Quaternionf orientation(Eigen::AngleAxisf(0.3f, Eigen::Vector3f(1.0f, 2.0f, 0.5f).normalized()));
+    float fovY = 0.8f;
+    float aspectRatio = 1.5f;
+
+    // Stars outside of the frame are recorded like the renderer does,
+    // which only roughly culls them
+    PickGrid grid;
+    grid.begin(position, orientation, fovY, aspectRatio, 7.0f);
+    for (int i = 0; i < STAR_COUNT; i++)
+    {
+        if (drawn[i].appMag < 7.0f)
+            grid.add(&stars[i], drawn[i].relPos, drawn[i].appMag);
+    }
+    grid.finish();
+    REQUIRE(grid.size() > 0);
+    REQUIRE(grid.size() < STAR_COUNT);
+
+    SECTION("Picks match a search of all stars")
+    {
+        std::uniform_real_distribution<float> screen(-0.9f, 0.9f);
+        Eigen::Matrix3f toWorld = orientation.conjugate().toRotationMatrix();
+        float tanY = std::tan(fovY / 2.0f);
+        int hits = 0;
+        for (int i = 0; i < 200; i++)
+        {
+            Eigen::Vector3f view(screen(rng) * tanY * aspectRatio, screen(rng) * tanY, -1.0f);
+            Eigen::Vector3f direction = (toWorld * view).normalized();
+
+            const Star* star = nullptr;
+            REQUIRE(grid.pick(position, direction, 0.02f, 6.0f, star));
+            REQUIRE(star == closestStar(stars, drawn, direction, 0.02f, 6.0f));
+            if (star != nullptr)
+                hits++;
+        }
+        REQUIRE(hits > 0);
+    }
+
+    SECTION("The frame doesn't apply to other queries")
+    {
+        Eigen::Vector3f center = orientation.conjugate() * -Eigen::Vector3f::UnitZ();
+        const Star* star = nullptr;
+
+        // Fainter stars weren't drawn
+        REQUIRE(!grid.pick(position, center, 0.02f, 8.0f, star));
+        // The cone leaves the frame
+        Eigen::Vector3f behind = -center;
+        REQUIRE(!grid.pick(position, behind, 0.02f, 6.0f, star));
+        Eigen::Vector3f edge = orientation.conjugate() * Eigen::Vector3f(0.0f, std::tan(fovY / 2.0f), -1.0f).normalized();
+        REQUIRE(!grid.pick(position, edge, 0.02f, 6.0f, star));
+        // The observer has moved too far
+        REQUIRE(!grid.pick(position + Eigen::Vector3d(10.0, 0.0, 0.0), center, 0.02f, 6.0f, star));
+        REQUIRE(grid.pick(position + Eigen::Vector3d(1.0e-7, 0.0, 0.0), center, 0.02f, 6.0f, star));
+
+        grid.clear();
+        REQUIRE(!grid.pick(position, center, 0.02f, 6.0f, star));
+    }
+}
@@ -0,0 +1,62 @@
+#include <catch.hpp>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <celutil/profiler.h>
+
+using celestia::util::Profiler;
+
+TEST_CASE("profiler", "[profiler]")
+{
+    using namespace std::chrono_literals;
+
+    Profiler profiler(0);
+    auto t0 = Profiler::clock::now();
+
+    SECTION("Averages zones over complete frames")
+    {
+        std::size_t zone = profiler.getZone("Frame", Profiler::Source::CPU, 0);
+        REQUIRE(profiler.getZone("Frame", Profiler::Source::CPU, 0) == zone);
+
+        profiler.beginFrame();
+        profiler.addTime(zone, profiler.getFrame(), t0, t0 + 2ms);
+        profiler.addTime(zone, profiler.getFrame(), t0, t0 + 2ms);
+        profiler.beginFrame();
+        profiler.addTime(zone, profiler.getFrame(), t0, t0 + 6ms);
+        // The current frame is ignored
+        profiler.beginFrame();
+        profiler.addTime(zone, profiler.getFrame(), t0, t0 + 100ms);
+
+        auto stats = profiler.getStats();
+        REQUIRE(stats.size() == 1);
+        REQUIRE(stats[0].average == Approx(5.0));
+        REQUIRE(stats[0].maximum == Approx(6.0));
+    }
+
+    SECTION("Counts late results in their frame")
+    {
+        std::size_t cpu = profiler.getZone("Stars", Profiler::Source::CPU, 0);
+        std::size_t gpu = profiler.getZone("Stars", Profiler::Source::GPU, 0);
+        REQUIRE(cpu != gpu);
+
+        for (int i = 0; i < 4; i++)
+            profiler.beginFrame();
+        profiler.addTime(gpu, 2, t0, t0 + 3ms);
+
+        auto stats = profiler.getStats();
+        REQUIRE(stats.size() == 2);
+        REQUIRE(stats[1].source == Profiler::Source::GPU);
+        REQUIRE(stats[1].average == Approx(1.5));
+        REQUIRE(stats[1].maximum == Approx(3.0));
+    }
+
+    SECTION("Interns run time zone names")
+    {
+        std::string name = "Script zone";
+        const char* interned = profiler.internName(name);
+        name = "Changed";
+        REQUIRE(std::string_view(interned) == "Script zone");
+        REQUIRE(profiler.internName("Script zone") == interned);
+        REQUIRE(profiler.internName("Other zone") != interned);
+    }
+}
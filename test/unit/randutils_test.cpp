@@ -0,0 +1,52 @@
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <celmath/randutils.h>
+
+#include <catch.hpp>
+
+using celmath::CounterRNG;
+
+TEST_CASE("CounterRNG", "[CounterRNG]")
+{
+    SECTION("Streams are reproducible")
+    {
+        CounterRNG a(42, 7);
+        CounterRNG b(42, 7);
+        for (int i = 0; i < 100; i++)
+            REQUIRE(a() == b());
+    }
+
+    SECTION("Streams and seeds differ")
+    {
+        CounterRNG a(42, 7);
+        CounterRNG b(42, 8);
+        CounterRNG c(43, 7);
+        std::vector<std::uint32_t> va, vb, vc;
+        for (int i = 0; i < 16; i++)
+        {
+            va.push_back(a());
+            vb.push_back(b());
+            vc.push_back(c());
+        }
+        REQUIRE(va != vb);
+        REQUIRE(va != vc);
+    }
+
+    SECTION("Works with the standard distributions")
+    {
+        CounterRNG rng(1, 2);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        double sum = 0.0;
+        constexpr int count = 10000;
+        for (int i = 0; i < count; i++)
+        {
+            float x = unit(rng);
+            REQUIRE(x >= 0.0f);
+            REQUIRE(x < 1.0f);
+            sum += x;
+        }
+        REQUIRE(sum / count == Approx(0.5).epsilon(0.02));
+    }
+}
@@ -0,0 +1,88 @@
+#include <string>
+
+#include <celestia/remotecontrol.h>
+
+#include <catch.hpp>
+
+using celestia::RemoteCommand;
+using celestia::RemoteState;
+
+TEST_CASE("RemoteState", "[RemoteState]")
+{
+    RemoteState state;
+    state.coordSys = ObserverFrame::Ecliptical;
+    state.refBody = "Sol:Earth";
+    state.position = UniversalCoord(BigFix(1.0e12), BigFix(-2.5e3), BigFix(0.125));
+    state.orientation = Eigen::Quaternionf(0.5f, -0.5f, 0.5f, 0.5f);
+    state.fov = 30.0f;
+    state.tdb = 2451545.25;
+    state.timeScale = -100.0f;
+    state.paused = true;
+    state.selectedBody = "Sol:Earth:Moon";
+    state.renderFlags = 0x123456789abcdefULL;
+    state.labelMode = 7;
+
+    SECTION("Complete states are decoded")
+    {
+        RemoteState decoded;
+        REQUIRE(decoded.applyDelta(state.encodeDelta(RemoteState::AllFields)));
+        REQUIRE(decoded.changes(state) == 0);
+    }
+
+    SECTION("Deltas only hold the fields which changed")
+    {
+        RemoteState changed = state;
+        changed.tdb += 1.0;
+        changed.labelMode = 3;
+        unsigned int fields = changed.changes(state);
+        REQUIRE(fields == (RemoteState::TimeField | RemoteState::RenderField));
+
+        RemoteState decoded = state;
+        std::string delta = changed.encodeDelta(fields);
+        REQUIRE(delta.size() < state.encodeDelta(RemoteState::AllFields).size());
+        REQUIRE(decoded.applyDelta(delta));
+        REQUIRE(decoded.changes(changed) == 0);
+    }
+
+    SECTION("Truncated deltas are not applied")
+    {
+        std::string delta = state.encodeDelta(RemoteState::AllFields);
+        RemoteState decoded;
+        REQUIRE_FALSE(decoded.applyDelta(std::string_view(delta).substr(0, delta.size() - 1)));
+        REQUIRE(decoded.changes(RemoteState()) == 0);
+    }
+}
+
+TEST_CASE("RemoteCommand", "[RemoteCommand]")
+{
+    RemoteCommand command;
+    command.type = RemoteCommand::SetObserver;
+    command.sequence = 42;
+    command.position = UniversalCoord(BigFix(-3.0e9), BigFix(7.0), BigFix(1.0e-3));
+    command.orientation = Eigen::Quaterniond(0.5, 0.5, -0.5, 0.5);
+    command.fov = 0.75f;
+
+    std::string packet = command.encode();
+
+    SECTION("Decoded commands are the commands encoded")
+    {
+        RemoteCommand decoded;
+        REQUIRE(decoded.decode(packet));
+        REQUIRE(decoded.type == RemoteCommand::SetObserver);
+        REQUIRE(decoded.sequence == 42);
+        REQUIRE(decoded.position.x == command.position.x);
+        REQUIRE(decoded.position.y == command.position.y);
+        REQUIRE(decoded.position.z == command.position.z);
+        REQUIRE(decoded.orientation.coeffs() == command.orientation.coeffs());
+        REQUIRE(decoded.fov == command.fov);
+    }
+
+    SECTION("Malformed commands are not decoded")
+    {
+        RemoteCommand decoded;
+        REQUIRE_FALSE(decoded.decode(std::string_view(packet).substr(0, packet.size() - 1)));
+        REQUIRE_FALSE(decoded.decode("CELR"));
+        packet[5] = 100;
+        REQUIRE_FALSE(decoded.decode(packet));
+    }
+}
@@ -0,0 +1,236 @@
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <celutil/jobsystem.h>
+#include <celutil/resmanager.h>
+
+#include <catch.hpp>
+
+namespace
+{
+
+struct Blob
+{
+    std::size_t size;
+};
+
+// Resources named after the file, each one of size bytes
+class BlobInfo : public ResourceInfo<Blob>
+{
+ public:
+    BlobInfo(std::string _name, std::size_t _size) : name(std::move(_name)), size(_size) {}
+
+    fs::path resolve(const fs::path&) override { return name; }
+    Blob* load(const fs::path&) override
+    {
+        loads[name]++;
+        return new Blob{ size };
+    }
+    std::size_t getMemoryUsage() const override
+    {
+        return resource != nullptr ? resource->size : 0;
+    }
+    std::size_t hash() const { return std::hash<std::string>()(name); }
+
+    std::string name;
+    std::size_t size;
+
+    static std::map<std::string, int> loads;
+};
+
+std::map<std::string, int> BlobInfo::loads;
+
+bool operator==(const BlobInfo& a, const BlobInfo& b)
+{
+    return a.name == b.name;
+}
+
+using BlobManager = ResourceManager<BlobInfo>;
+
+// Loads a blob of a quarter of the size first, then the full one
+class ProgressiveBlobLoader : public ResourceInfo<Blob>::AsyncLoader
+{
+ public:
+    explicit ProgressiveBlobLoader(std::size_t _size) : fullSize(_size) {}
+
+    bool decode() override { previewSize = fullSize / 4; return true; }
+    Blob* create() override { return new Blob{ previewSize }; }
+    std::size_t size() const override { return previewSize; }
+    bool refinable() const override { return true; }
+    bool decodeRefinement() override { return true; }
+    void refine(Blob* blob) override { blob->size = fullSize; }
+
+ private:
+    std::size_t fullSize;
+    std::size_t previewSize{ 0 };
+};
+
+class ProgressiveBlobInfo : public BlobInfo
+{
+ public:
+    using BlobInfo::BlobInfo;
+
+    std::unique_ptr<AsyncLoader> asyncLoader(const fs::path&) override
+    {
+        return std::make_unique<ProgressiveBlobLoader>(size);
+    }
+};
+
+bool operator==(const ProgressiveBlobInfo& a, const ProgressiveBlobInfo& b)
+{
+    return a.name == b.name;
+}
+
+std::size_t loadedBytes(BlobManager& manager)
+{
+    celestia::util::MemoryUsage usage("root");
+    manager.accountMemory(usage, "blobs");
+    return usage.children[0].children[0].bytes;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("ResourceManager handles", "[ResourceManager]")
+{
+    BlobManager manager("");
+    ResourceHandle a = manager.getHandle(BlobInfo("a", 100));
+    ResourceHandle b = manager.getHandle(BlobInfo("b", 100));
+    REQUIRE(a != b);
+    REQUIRE(manager.getHandle(BlobInfo("a", 200)) == a);
+
+    std::vector<BlobInfo> infos;
+    for (int i = 0; i < 1000; i++)
+        infos.emplace_back(std::to_string(i % 500), 1);
+    std::vector<ResourceHandle> handles;
+    manager.getHandles(infos.begin(), infos.end(), std::back_inserter(handles));
+    REQUIRE(handles.size() == 1000);
+    for (int i = 0; i < 500; i++)
+    {
+        REQUIRE(handles[i] == handles[i + 500]);
+        REQUIRE(manager.getResourceInfo(handles[i])->name == std::to_string(i));
+    }
+    REQUIRE(manager.getHandle(BlobInfo("499", 1)) == handles[499]);
+}
+
+TEST_CASE("ResourceManager evicts least recently used resources", "[ResourceManager]")
+{
+    BlobInfo::loads.clear();
+    BlobManager manager("");
+    ResourceHandle a = manager.getHandle(BlobInfo("a", 100));
+    ResourceHandle b = manager.getHandle(BlobInfo("b", 100));
+    ResourceHandle c = manager.getHandle(BlobInfo("c", 100));
+
+    // First frame
+    REQUIRE(manager.find(a) != nullptr);
+    REQUIRE(manager.find(b) != nullptr);
+    REQUIRE(manager.find(c) != nullptr);
+    REQUIRE(loadedBytes(manager) == 300);
+    // Resources found since the last call are kept
+    REQUIRE(manager.evict(150) == 0);
+
+    // Second frame only uses c after a
+    manager.find(a);
+    manager.find(c);
+    REQUIRE(manager.evict(150) == 100);
+    REQUIRE(loadedBytes(manager) == 200);
+
+    // Third frame uses c; a is older than c
+    manager.find(c);
+    REQUIRE(manager.evict(150) == 100);
+    REQUIRE(loadedBytes(manager) == 100);
+
+    // Evicted resources are loaded again
+    REQUIRE(manager.find(b) != nullptr);
+    REQUIRE(BlobInfo::loads["b"] == 2);
+    REQUIRE(BlobInfo::loads["c"] == 1);
+}
+
+TEST_CASE("ResourceManager keeps acquired resources", "[ResourceManager]")
+{
+    BlobInfo::loads.clear();
+    BlobManager manager("");
+    ResourceHandle a = manager.getHandle(BlobInfo("a", 100));
+    ResourceHandle b = manager.getHandle(BlobInfo("b", 100));
+
+    REQUIRE(manager.acquire(a) != nullptr);
+    REQUIRE(manager.find(b) != nullptr);
+    manager.evict(0);
+
+    manager.setMemoryBudget(1);
+    REQUIRE(manager.evict() == 100);
+    REQUIRE(loadedBytes(manager) == 100);
+
+    manager.release(a);
+    REQUIRE(manager.evict() == 100);
+    REQUIRE(loadedBytes(manager) == 0);
+    REQUIRE(BlobInfo::loads["a"] == 1);
+}
+
+TEST_CASE("ResourceManager refines progressive loads in place", "[ResourceManager]")
+{
+    auto check = []
+    {
+        ResourceManager<ProgressiveBlobInfo> manager("");
+        manager.enableAsyncLoading(2);
+        ResourceHandle a = manager.getHandle(ProgressiveBlobInfo("a", 100));
+        REQUIRE(manager.find(a) == nullptr);
+        REQUIRE(manager.isLoading(a));
+
+        REQUIRE(manager.finishLoads());
+        Blob* blob = manager.find(a);
+        REQUIRE(blob != nullptr);
+        REQUIRE(blob->size == 100);
+        REQUIRE(!manager.finishLoads());
+    };
+
+    SECTION("On loader threads")
+    {
+        check();
+    }
+
+    SECTION("On the job system")
+    {
+        celestia::util::CreateJobSystem(2);
+        check();
+        celestia::util::DestroyJobSystem();
+    }
+}
+
+TEST_CASE("ResourceManager prefetches asynchronous loads only", "[ResourceManager]")
+{
+    ResourceManager<ProgressiveBlobInfo> manager("");
+    ResourceHandle a = manager.getHandle(ProgressiveBlobInfo("a", 100));
+    REQUIRE(!manager.prefetch(a));
+    REQUIRE(!manager.isLoading(a));
+
+    manager.enableAsyncLoading(2);
+    REQUIRE(manager.prefetch(a));
+    REQUIRE(manager.isLoading(a));
+    REQUIRE(!manager.prefetch(a));
+
+    REQUIRE(manager.finishLoads());
+    REQUIRE(!manager.prefetch(a));
+    Blob* blob = manager.find(a);
+    REQUIRE(blob != nullptr);
+    REQUIRE(blob->size == 100);
+}
+
+TEST_CASE("ResourceManager waits for the resource of a handle", "[ResourceManager]")
+{
+    ResourceManager<ProgressiveBlobInfo> manager("");
+    manager.enableAsyncLoading(2);
+    ResourceHandle a = manager.getHandle(ProgressiveBlobInfo("a", 100));
+    ResourceHandle b = manager.getHandle(ProgressiveBlobInfo("b", 100));
+    REQUIRE(manager.prefetch(b));
+
+    Blob* blob = manager.findLoaded(a);
+    REQUIRE(blob != nullptr);
+    REQUIRE(!manager.isLoading(a));
+    REQUIRE(manager.findLoaded(a) == blob);
+
+    manager.finishLoads();
+    REQUIRE(blob->size == 100);
+    REQUIRE(manager.find(b) != nullptr);
+}
@@ -0,0 +1,101 @@
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+#include <celengine/starname.h>
+
+#include <catch.hpp>
+
+namespace
+{
+
+constexpr AstroCatalog::IndexNumber INVALID = AstroCatalog::InvalidIndex;
+
+constexpr const char NAMES[] =
+    "32349:Sirius:ALF CMa:9 CMa\n"
+    "71683:Rigil Kentaurus:ALF1 Cen\n"
+    "71681:Toliman:ALF2 Cen\n"
+    "70890:Proxima:Proxima Centauri:ALF Cen C\n"
+    "91262:Vega:ALF Lyr:3 Lyr\n";
+
+void checkNames(const StarNameDatabase& db)
+{
+    REQUIRE(db.getNameCount() == 13);
+    REQUIRE(db.getCatalogNumberByName("sirius", false) == 32349);
+    REQUIRE(db.getCatalogNumberByName("ALF CMa", false) == 32349);
+    REQUIRE(db.findCatalogNumberByName("Alpha Lyr", false) == 91262);
+    REQUIRE(db.getCatalogNumberByName("Altair", false) == INVALID);
+    REQUIRE(db.getNameByCatalogNumber(70890) == "Proxima");
+
+    std::vector<std::string> names;
+    for (auto iter = db.getFirstNameIter(70890);
+         iter != db.getFinalNameIter() && iter->first == 70890;
+         ++iter)
+    {
+        names.push_back(iter->second);
+    }
+    REQUIRE(names.size() == 3);
+    REQUIRE(names[1] == "Proxima Centauri");
+
+    auto completion = db.getCompletion("pro", false);
+    REQUIRE(completion.size() == 2);
+    completion = db.getCompletion("t", false);
+    REQUIRE(completion.size() == 1);
+    REQUIRE(completion[0] == "Toliman");
+}
+
+} // end unnamed namespace
+
+TEST_CASE("StarNameDatabase", "[StarNameDatabase]")
+{
+    std::istringstream in(NAMES);
+    std::unique_ptr<StarNameDatabase> db(StarNameDatabase::readNames(in));
+    REQUIRE(db != nullptr);
+    checkNames(*db);
+
+    fs::path path = fs::temp_directory_path() / "starname_test.cache";
+    db->saveCache(path, 1);
+
+    SECTION("Cached names match the names read")
+    {
+        StarNameDatabase cached;
+        REQUIRE(cached.loadCache(path, 1));
+        checkNames(cached);
+
+        // The loaded indexes still take new names
+        cached.add(97649, "Altair");
+        REQUIRE(cached.getCatalogNumberByName("ALTAIR", false) == 97649);
+        REQUIRE(cached.getCompletion("Al", false).size() == 1);
+    }
+
+    SECTION("Caches of other sources are not loaded")
+    {
+        StarNameDatabase cached;
+        REQUIRE_FALSE(cached.loadCache(path, 2));
+        REQUIRE(cached.getNameCount() == 0);
+    }
+
+    SECTION("Truncated caches are not loaded")
+    {
+        std::string contents;
+        {
+            std::ifstream file(path, std::ios::in | std::ios::binary);
+            contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+        {
+            std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+            file.write(contents.data(), static_cast<std::streamsize>(contents.size() - 5));
+        }
+
+        StarNameDatabase cached;
+        REQUIRE_FALSE(cached.loadCache(path, 1));
+        REQUIRE(cached.getNameCount() == 0);
+        REQUIRE(cached.getNameByCatalogNumber(32349).empty());
+    }
+
+    std::error_code ec;
+    fs::remove(path, ec);
+}
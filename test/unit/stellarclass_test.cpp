@@ -197,6 +197,30 @@ TEST_CASE("StellarClass packing", "[StellarClass]")
 
 TEST_CASE("StellarClass parsing", "[StellarClass]")
 {
+    SECTION("Common MK types")
+    {
+        StellarClass sc = StellarClass::parse("G2V");
+        REQUIRE(sc.getStarType() == StellarClass::NormalStar);
+        REQUIRE(sc.getSpectralClass() == StellarClass::Spectral_G);
+        REQUIRE(sc.getSubclass() == 2);
+        REQUIRE(sc.getLuminosityClass() == StellarClass::Lum_V);
+
+        sc = StellarClass::parse("K0III");
+        REQUIRE(sc.getSpectralClass() == StellarClass::Spectral_K);
+        REQUIRE(sc.getSubclass() == 0);
+        REQUIRE(sc.getLuminosityClass() == StellarClass::Lum_III);
+
+        sc = StellarClass::parse("M4");
+        REQUIRE(sc.getSpectralClass() == StellarClass::Spectral_M);
+        REQUIRE(sc.getSubclass() == 4);
+        REQUIRE(sc.getLuminosityClass() == StellarClass::Lum_Unknown);
+
+        sc = StellarClass::parse("B1IIIe");
+        REQUIRE(sc.getSpectralClass() == StellarClass::Spectral_B);
+        REQUIRE(sc.getSubclass() == 1);
+        REQUIRE(sc.getLuminosityClass() == StellarClass::Lum_III);
+    }
+
     SECTION("Luminosity class I-a0")
     {
         StellarClass sc = StellarClass::parse("A9I-a0");
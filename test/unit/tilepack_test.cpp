@@ -0,0 +1,94 @@
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+#include <celcompat/filesystem.h>
+#include <celengine/image.h>
+#include <celengine/tilepack.h>
+
+#include <catch.hpp>
+
+using celestia::PixelFormat;
+
+namespace
+{
+
+std::uint8_t tileByte(const TilePack::Entry& entry, std::uint64_t i)
+{
+    return static_cast<std::uint8_t>(entry.level * 31 + entry.u * 7 + entry.v * 3 + i);
+}
+
+} // end unnamed namespace
+
+TEST_CASE("TilePack", "[TilePack]")
+{
+    fs::path path = fs::temp_directory_path() / "tilepack_test.ctp";
+
+    std::vector<TilePack::Entry> entries;
+    for (std::uint32_t level = 0; level < 3; level++)
+    {
+        for (std::uint32_t v = 0; v < (1u << level); v++)
+        {
+            // Add tiles out of order to check that layout() sorts them
+            for (std::uint32_t u = 2u << level; u-- > 0;)
+                entries.push_back({ level, u, v, PixelFormat::RGB, 16, 16, 1, 0, 16 * 16 * 3 });
+        }
+    }
+    TilePack::layout(entries);
+
+    {
+        std::ofstream out(path, std::ios::out | std::ios::binary);
+        REQUIRE(TilePack::writeIndex(out, entries));
+        for (const auto& entry : entries)
+        {
+            REQUIRE(static_cast<std::uint64_t>(out.tellp()) == entry.offset);
+            for (std::uint64_t i = 0; i < entry.size; i++)
+                out.put(static_cast<char>(tileByte(entry, i)));
+        }
+        REQUIRE(out.good());
+    }
+
+    SECTION("Tiles are read back")
+    {
+        auto pack = TilePack::open(path);
+        REQUIRE(pack != nullptr);
+        REQUIRE(pack->entries().size() == entries.size());
+
+        const TilePack::Entry* entry = pack->find(2, 5, 3);
+        REQUIRE(entry != nullptr);
+        REQUIRE(entry->level == 2);
+        REQUIRE(entry->u == 5);
+        REQUIRE(entry->v == 3);
+        REQUIRE(pack->find(2, 8, 0) == nullptr);
+        REQUIRE(pack->find(3, 0, 0) == nullptr);
+
+        auto img = pack->load(*entry);
+        REQUIRE(img != nullptr);
+        REQUIRE(img->getWidth() == 16);
+        REQUIRE(img->getHeight() == 16);
+        REQUIRE(img->getFormat() == PixelFormat::RGB);
+        bool same = true;
+        for (std::uint64_t i = 0; i < entry->size; i++)
+            same = same && img->getPixels()[i] == tileByte(*entry, i);
+        REQUIRE(same);
+    }
+
+    SECTION("Truncated packs are rejected")
+    {
+        fs::resize_file(path, entries.back().offset + entries.back().size - 1);
+        REQUIRE(TilePack::open(path) == nullptr);
+        fs::resize_file(path, 20);
+        REQUIRE(TilePack::open(path) == nullptr);
+    }
+
+    SECTION("Bad headers are rejected")
+    {
+        {
+            std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+            f.put('X');
+        }
+        REQUIRE(TilePack::open(path) == nullptr);
+    }
+
+    fs::remove(path);
+}
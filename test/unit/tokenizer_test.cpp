@@ -342,3 +342,50 @@ TEST_CASE("Tokenizer skips comments", "[Tokenizer]")
 
     REQUIRE(tok.nextToken() == Tokenizer::TokenEnd);
 }
+
+TEST_CASE("Tokenizer reads buffers like streams", "[Tokenizer]")
+{
+    std::string_view source = "\357\273\277Body \"Earth:Terra\" # comment\n"
+                              "{\n"
+                              "  Radius 6378.14 Mass<kg> 5.97e24\n"
+                              "  Offset [ -1 +2 .5 -.25 1E-3 ]\n"
+                              "  Text \"escaped \\\"\\n\\u00e9\"\n"
+                              "  Invalid \"\300\"\n"
+                              "}\n"
+                              "Bad 12abc";
+
+    std::istringstream input{ std::string(source) };
+    Tokenizer streamTok(&input);
+    Tokenizer bufferTok(source);
+
+    for (;;)
+    {
+        Tokenizer::TokenType type = streamTok.nextToken();
+        REQUIRE(bufferTok.nextToken() == type);
+        REQUIRE(bufferTok.getLineNumber() == streamTok.getLineNumber());
+        if (type == Tokenizer::TokenNumber)
+        {
+            REQUIRE(bufferTok.getNumberValue() == streamTok.getNumberValue());
+            REQUIRE(bufferTok.isInteger() == streamTok.isInteger());
+        }
+        else
+        {
+            REQUIRE(bufferTok.getStringValue() == streamTok.getStringValue());
+        }
+
+        if (type == Tokenizer::TokenEnd || type == Tokenizer::TokenError)
+            break;
+    }
+
+    SECTION("Unescaped strings point into the buffer")
+    {
+        std::string_view names = "\"Sol\" Name";
+        Tokenizer tok(names);
+
+        REQUIRE(tok.nextToken() == Tokenizer::TokenString);
+        REQUIRE(tok.getStringValue().data() == names.data() + 1);
+
+        REQUIRE(tok.nextToken() == Tokenizer::TokenName);
+        REQUIRE(tok.getStringValue().data() == names.data() + 6);
+    }
+}